@@ -21,7 +21,9 @@
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
+#include <isc/once.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
@@ -95,6 +97,18 @@ dns_zoneopt_t zone_options = DNS_ZONEOPT_CHECKNS | DNS_ZONEOPT_CHECKMX |
 static isc_symtab_t *symtab = NULL;
 static isc_mem_t *sym_mctx;
 
+/*
+ * named-checkzone -B checks several zones at once; the table of names
+ * already reported is shared between them.
+ */
+static isc_once_t symonce = ISC_ONCE_INIT;
+static isc_mutex_t symlock;
+
+static void
+symlock_init(void) {
+	isc_mutex_init(&symlock);
+}
+
 static void
 freekey(char *key, unsigned int type, isc_symvalue_t value, void *userarg) {
 	UNUSED(type);
@@ -107,6 +121,9 @@ add(char *key, int value) {
 	isc_result_t result;
 	isc_symvalue_t symvalue;
 
+	isc_once_do(&symonce, symlock_init);
+	LOCK(&symlock);
+
 	if (sym_mctx == NULL) {
 		isc_mem_create(&sym_mctx);
 	}
@@ -115,7 +132,7 @@ add(char *key, int value) {
 		result = isc_symtab_create(sym_mctx, 100, freekey, sym_mctx,
 					   false, &symtab);
 		if (result != ISC_R_SUCCESS) {
-			return;
+			goto unlock;
 		}
 	}
 
@@ -127,21 +144,23 @@ add(char *key, int value) {
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_free(sym_mctx, key);
 	}
+
+unlock:
+	UNLOCK(&symlock);
 }
 
 static bool
 logged(char *key, int value) {
-	isc_result_t result;
+	isc_result_t result = ISC_R_NOTFOUND;
 
-	if (symtab == NULL) {
-		return (false);
+	isc_once_do(&symonce, symlock_init);
+	LOCK(&symlock);
+	if (symtab != NULL) {
+		result = isc_symtab_lookup(symtab, key, value, NULL);
 	}
+	UNLOCK(&symlock);
 
-	result = isc_symtab_lookup(symtab, key, value, NULL);
-	if (result == ISC_R_SUCCESS) {
-		return (true);
-	}
-	return (false);
+	return (result == ISC_R_SUCCESS);
 }
 
 static bool
@@ -403,10 +422,14 @@ checkmx(dns_zone_t *zone, const dns_name_t *name, const dns_name_t *owner) {
 		if (cur != NULL && cur->ai_canonname != NULL &&
 		    strcasecmp(cur->ai_canonname, namebuf) != 0)
 		{
-			if ((zone_options & DNS_ZONEOPT_WARNMXCNAME) != 0) {
+			if ((dns_zone_getoptions(zone) &
+			     DNS_ZONEOPT_WARNMXCNAME) != 0)
+			{
 				level = ISC_LOG_WARNING;
 			}
-			if ((zone_options & DNS_ZONEOPT_IGNOREMXCNAME) == 0) {
+			if ((dns_zone_getoptions(zone) &
+			     DNS_ZONEOPT_IGNOREMXCNAME) == 0)
+			{
 				if (!logged(namebuf, ERR_IS_MXCNAME)) {
 					dns_zone_log(zone, level,
 						     "%s/MX '%s' (out of zone)"
@@ -490,10 +513,14 @@ checksrv(dns_zone_t *zone, const dns_name_t *name, const dns_name_t *owner) {
 		if (cur != NULL && cur->ai_canonname != NULL &&
 		    strcasecmp(cur->ai_canonname, namebuf) != 0)
 		{
-			if ((zone_options & DNS_ZONEOPT_WARNSRVCNAME) != 0) {
+			if ((dns_zone_getoptions(zone) &
+			     DNS_ZONEOPT_WARNSRVCNAME) != 0)
+			{
 				level = ISC_LOG_WARNING;
 			}
-			if ((zone_options & DNS_ZONEOPT_IGNORESRVCNAME) == 0) {
+			if ((dns_zone_getoptions(zone) &
+			     DNS_ZONEOPT_IGNORESRVCNAME) == 0)
+			{
 				if (!logged(namebuf, ERR_IS_SRVCNAME)) {
 					dns_zone_log(zone, level,
 						     "%s/SRV '%s'"
@@ -551,7 +578,7 @@ setup_logging(FILE *errout) {
 isc_result_t
 load_zone(isc_mem_t *mctx, const char *zonename, const char *filename,
 	  dns_masterformat_t fileformat, const char *classname,
-	  dns_ttl_t maxttl, dns_zone_t **zonep) {
+	  dns_ttl_t maxttl, dns_zoneopt_t options, dns_zone_t **zonep) {
 	isc_result_t result;
 	dns_rdataclass_t rdclass;
 	isc_textregion_t region;
@@ -593,7 +620,7 @@ load_zone(isc_mem_t *mctx, const char *zonename, const char *filename,
 	CHECK(dns_rdataclass_fromtext(&rdclass, &region));
 
 	dns_zone_setclass(zone, rdclass);
-	dns_zone_setoption(zone, zone_options, true);
+	dns_zone_setoption(zone, options, true);
 	dns_zone_setoption(zone, DNS_ZONEOPT_NOMERGE, nomerge);
 
 	dns_zone_setmaxttl(zone, maxttl);
@@ -18,14 +18,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/commandline.h>
 #include <isc/dir.h>
 #include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
@@ -57,7 +61,7 @@ usage(void);
 static void
 usage(void) {
 	fprintf(stderr,
-		"usage: %s [-achijlvz] [-p [-x]] [-t directory] "
+		"usage: %s [-achijlTvz] [-N threads] [-p [-x]] [-t directory] "
 		"[named.conf]\n",
 		program);
 	exit(EXIT_SUCCESS);
@@ -168,13 +172,118 @@ configure_hint(const char *zfile, const char *zclass, isc_mem_t *mctx) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * The zone files are loaded (-z) after the whole configuration has been
+ * walked, by a pool of threads.
+ */
+typedef struct zonejob {
+	const char *view;
+	const char *zname;
+	char zclass[sizeof("CLASS65535")];
+	const char *zfile;
+	dns_masterformat_t masterformat;
+	dns_ttl_t maxttl;
+	dns_zoneopt_t options;
+	isc_result_t result;
+} zonejob_t;
+
+static struct {
+	isc_mem_t *mctx;
+	zonejob_t *jobs;
+	size_t count;
+	size_t size;
+	atomic_size_t next;
+} zonejobs;
+
+static void
+zonejob_add(const char *view, const char *zname, const char *zclass,
+	    const char *zfile, dns_masterformat_t masterformat,
+	    dns_ttl_t maxttl) {
+	if (zonejobs.count == zonejobs.size) {
+		size_t size = zonejobs.size == 0 ? 1024 : zonejobs.size * 2;
+		zonejobs.jobs = isc_mem_creget(zonejobs.mctx, zonejobs.jobs,
+					       zonejobs.size, size,
+					       sizeof(zonejobs.jobs[0]));
+		zonejobs.size = size;
+	}
+	zonejobs.jobs[zonejobs.count] = (zonejob_t){
+		.view = view,
+		.zname = zname,
+		.zfile = zfile,
+		.masterformat = masterformat,
+		.maxttl = maxttl,
+		.options = zone_options,
+	};
+	strlcpy(zonejobs.jobs[zonejobs.count].zclass, zclass,
+		sizeof(zonejobs.jobs[0].zclass));
+	zonejobs.count++;
+}
+
+static void *
+zonejob_run(void *arg) {
+	UNUSED(arg);
+
+	for (;;) {
+		size_t i = atomic_fetch_add_relaxed(&zonejobs.next, 1);
+		zonejob_t *job = NULL;
+
+		if (i >= zonejobs.count) {
+			break;
+		}
+		job = &zonejobs.jobs[i];
+		job->result = load_zone(zonejobs.mctx, job->zname, job->zfile,
+					job->masterformat, job->zclass,
+					job->maxttl, job->options, NULL);
+	}
+
+	return (NULL);
+}
+
+static isc_result_t
+zonejobs_run(unsigned int nthreads) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_thread_t *threads = NULL;
+
+	nthreads = ISC_MIN(nthreads, zonejobs.count);
+	if (nthreads > 0) {
+		threads = isc_mem_cget(zonejobs.mctx, nthreads,
+				       sizeof(threads[0]));
+		atomic_init(&zonejobs.next, 0);
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_create(zonejob_run, NULL, &threads[i]);
+		}
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_cput(zonejobs.mctx, threads, nthreads,
+			     sizeof(threads[0]));
+	}
+
+	for (size_t i = 0; i < zonejobs.count; i++) {
+		zonejob_t *job = &zonejobs.jobs[i];
+
+		if (job->result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s/%s/%s: %s\n", job->view,
+				job->zname, job->zclass,
+				isc_result_totext(job->result));
+			result = job->result;
+		}
+	}
+
+	if (zonejobs.jobs != NULL) {
+		isc_mem_cput(zonejobs.mctx, zonejobs.jobs, zonejobs.size,
+			     sizeof(zonejobs.jobs[0]));
+	}
+
+	return (result);
+}
+
 /*% configure the zone */
 static isc_result_t
 configure_zone(const char *vclass, const char *view, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, const cfg_obj_t *config,
 	       isc_mem_t *mctx, bool list) {
 	int i = 0;
-	isc_result_t result;
 	const char *zclass;
 	const char *zname;
 	const char *zfile = NULL;
@@ -456,13 +565,9 @@ configure_zone(const char *vclass, const char *view, const cfg_obj_t *zconfig,
 		zone_options |= DNS_ZONEOPT_CHECKTTL;
 	}
 
-	result = load_zone(mctx, zname, zfile, masterformat, zclass, maxttl,
-			   NULL);
-	if (result != ISC_R_SUCCESS) {
-		fprintf(stderr, "%s/%s/%s: %s\n", view, zname, zclass,
-			isc_result_totext(result));
-	}
-	return (result);
+	zonejob_add(view, zname, zclass, zfile, masterformat, maxttl);
+
+	return (ISC_R_SUCCESS);
 }
 
 /*% configure a view */
@@ -517,7 +622,7 @@ config_getclass(const cfg_obj_t *classobj, dns_rdataclass_t defclass,
 /*% load zones from the configuration */
 static isc_result_t
 load_zones_fromconfig(const cfg_obj_t *config, isc_mem_t *mctx,
-		      bool list_zones) {
+		      bool list_zones, unsigned int nthreads) {
 	const cfg_listelt_t *element;
 	const cfg_obj_t *views;
 	const cfg_obj_t *vconfig;
@@ -569,6 +674,11 @@ load_zones_fromconfig(const cfg_obj_t *config, isc_mem_t *mctx,
 	}
 
 cleanup:
+	tresult = zonejobs_run(nthreads);
+	if (result == ISC_R_SUCCESS) {
+		result = tresult;
+	}
+
 	return (result);
 }
 
@@ -597,13 +707,17 @@ main(int argc, char **argv) {
 	bool allconfigs = false;
 	unsigned int flags = 0;
 	unsigned int checkflags = BIND_CHECK_PLUGINS | BIND_CHECK_ALGORITHMS;
+	unsigned int nthreads = 0;
+	bool timing = false;
+	isc_nanosecs_t start = 0;
+	char *endp = NULL;
 
 	isc_commandline_errprint = false;
 
 	/*
 	 * Process memory debugging argument first.
 	 */
-#define CMDLINE_FLAGS "acdhijlm:nt:pvxz"
+#define CMDLINE_FLAGS "acdhijlm:nN:t:pTvxz"
 	while ((c = isc_commandline_parse(argc, argv, CMDLINE_FLAGS)) != -1) {
 		switch (c) {
 		case 'm':
@@ -661,6 +775,16 @@ main(int argc, char **argv) {
 			allconfigs = true;
 			break;
 
+		case 'N':
+			nthreads = strtoul(isc_commandline_argument, &endp, 10);
+			if (*endp != '\0' || nthreads == 0) {
+				fprintf(stderr,
+					"%s: -N requires a positive number\n",
+					program);
+				CHECK(ISC_R_FAILURE);
+			}
+			break;
+
 		case 't':
 			result = isc_dir_chroot(isc_commandline_argument);
 			if (result != ISC_R_SUCCESS) {
@@ -674,6 +798,10 @@ main(int argc, char **argv) {
 			print = true;
 			break;
 
+		case 'T':
+			timing = true;
+			break;
+
 		case 'v':
 			printf("%s\n", PACKAGE_VERSION);
 			result = ISC_R_SUCCESS;
@@ -739,10 +867,34 @@ main(int argc, char **argv) {
 	}
 	cfg_parser_setcallback(parser, directory_callback, NULL);
 
-	CHECK(cfg_parse_file(parser, conffile, &cfg_type_namedconf, &config));
-	CHECK(isccfg_check_namedconf(config, checkflags, mctx));
+	if (nthreads == 0) {
+		nthreads = isc_os_ncpus();
+	}
+	zonejobs.mctx = mctx;
+
+	/*
+	 * With -T, report how long each phase took.
+	 */
+#define PHASE(name, op)                                                     \
+	do {                                                                \
+		start = isc_time_monotonic();                               \
+		result = (op);                                              \
+		if (timing) {                                               \
+			fprintf(stderr, "%s: %s: %.3f s\n", program, name,  \
+				(double)(isc_time_monotonic() - start) /    \
+					NS_PER_SEC);                        \
+		}                                                           \
+		if (result != ISC_R_SUCCESS) {                              \
+			goto cleanup;                                       \
+		}                                                           \
+	} while (0)
+
+	PHASE("parse",
+	      cfg_parse_file(parser, conffile, &cfg_type_namedconf, &config));
+	PHASE("check", isccfg_check_namedconf(config, checkflags, mctx));
 	if (load_zones || list_zones) {
-		CHECK(load_zones_fromconfig(config, mctx, list_zones));
+		PHASE("zones", load_zones_fromconfig(config, mctx, list_zones,
+						     nthreads));
 	}
 
 	if (print) {
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/commandline.h>
 #include <isc/dir.h>
@@ -25,7 +26,10 @@
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/result.h>
+#include <isc/os.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -75,12 +79,198 @@ usage(void) {
 		"[-i (full|full-sibling|local|local-sibling|none)] "
 		"[-M (ignore|warn|fail)] [-S (ignore|warn|fail)] "
 		"[-W (ignore|warn)] "
-		"%s zonename [ (filename|-) ]\n",
+		"%s zonename [ (filename|-) ]\n"
+		"       %s [options] [-N threads] -B manifest\n",
 		prog_name,
-		progmode == progmode_check ? "[-o filename]" : "-o filename");
+		progmode == progmode_check ? "[-o filename]" : "-o filename",
+		prog_name);
 	exit(EXIT_FAILURE);
 }
 
+/*
+ * Batch mode (-B): the zones listed in a manifest are checked, and
+ * compiled if an output file is given for them, by a pool of threads
+ * sharing one memory context.
+ */
+typedef struct batchzone {
+	char *origin;
+	char *filename;
+	char *output;
+	isc_result_t result;
+} batchzone_t;
+
+static struct {
+	batchzone_t *zones;
+	size_t count;
+	size_t size;
+	atomic_size_t next;
+	const char *classname;
+	dns_masterformat_t inputformat;
+	dns_masterformat_t outputformat;
+	uint32_t rawversion;
+	dns_ttl_t maxttl;
+	bool snset;
+	uint32_t serialnum;
+} batch;
+
+/*
+ * Read the manifest: one zone per line, with the zone name, the zone
+ * file and, optionally, the file to dump the zone to, separated by
+ * white space.  Empty lines and lines starting with '#' are skipped.
+ */
+static isc_result_t
+batch_read(const char *manifest) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	char line[4096];
+	unsigned long lineno = 0;
+
+	result = isc_stdio_open(manifest, "r", &fp);
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", manifest,
+			isc_result_totext(result));
+		return (result);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *origin = NULL, *filename = NULL, *output = NULL;
+		char *last = NULL;
+
+		lineno++;
+		origin = strtok_r(line, " \t\r\n", &last);
+		if (origin == NULL || *origin == '#') {
+			continue;
+		}
+		filename = strtok_r(NULL, " \t\r\n", &last);
+		output = strtok_r(NULL, " \t\r\n", &last);
+		if (filename == NULL ||
+		    strtok_r(NULL, " \t\r\n", &last) != NULL ||
+		    (output == NULL && progmode == progmode_compile))
+		{
+			fprintf(stderr, "%s:%lu: syntax error\n", manifest,
+				lineno);
+			result = ISC_R_FAILURE;
+			break;
+		}
+
+		if (batch.count == batch.size) {
+			size_t size = batch.size == 0 ? 1024 : batch.size * 2;
+			batch.zones = isc_mem_creget(mctx, batch.zones,
+						     batch.size, size,
+						     sizeof(batch.zones[0]));
+			batch.size = size;
+		}
+		batch.zones[batch.count++] = (batchzone_t){
+			.origin = isc_mem_strdup(mctx, origin),
+			.filename = isc_mem_strdup(mctx, filename),
+			.output = output != NULL ? isc_mem_strdup(mctx, output)
+						 : NULL,
+			.result = ISC_R_UNSET,
+		};
+	}
+
+	(void)isc_stdio_close(fp);
+
+	return (result);
+}
+
+static void
+batch_check(batchzone_t *bz) {
+	dns_zone_t *bzone = NULL;
+	dns_masterrawheader_t header;
+	isc_result_t result;
+
+	result = load_zone(mctx, bz->origin, bz->filename, batch.inputformat,
+			   batch.classname, batch.maxttl, zone_options, &bzone);
+	if (result == ISC_R_SUCCESS && bz->output != NULL) {
+		if (batch.snset) {
+			dns_master_initrawheader(&header);
+			header.flags = DNS_MASTERRAW_SOURCESERIALSET;
+			header.sourceserial = batch.serialnum;
+			dns_zone_setrawdata(bzone, &header);
+		}
+		result = dump_zone(bz->origin, bzone, bz->output,
+				   batch.outputformat, outputstyle,
+				   batch.rawversion);
+	}
+	if (bzone != NULL) {
+		dns_zone_detach(&bzone);
+	}
+
+	bz->result = result;
+}
+
+static void *
+batch_run(void *arg) {
+	UNUSED(arg);
+
+	for (;;) {
+		size_t i = atomic_fetch_add_relaxed(&batch.next, 1);
+		if (i >= batch.count) {
+			break;
+		}
+		batch_check(&batch.zones[i]);
+	}
+
+	return (NULL);
+}
+
+/*
+ * Check all the zones in the manifest and print one line per zone, in
+ * manifest order, with the zone name, the zone file and the result,
+ * separated by tabs.
+ */
+static isc_result_t
+batch_main(const char *manifest, unsigned int nthreads) {
+	isc_thread_t *threads = NULL;
+	isc_result_t result;
+
+	result = batch_read(manifest);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	nthreads = ISC_MIN(nthreads, ISC_MAX(batch.count, 1));
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+	atomic_init(&batch.next, 0);
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_create(batch_run, NULL, &threads[i]);
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+
+	for (size_t i = 0; i < batch.count; i++) {
+		batchzone_t *bz = &batch.zones[i];
+
+		if (!quiet) {
+			printf("%s\t%s\t%s\n", bz->origin, bz->filename,
+			       isc_result_totext(bz->result));
+		}
+		if (bz->result != ISC_R_SUCCESS) {
+			result = bz->result;
+		}
+	}
+
+cleanup:
+	for (size_t i = 0; i < batch.count; i++) {
+		batchzone_t *bz = &batch.zones[i];
+
+		isc_mem_free(mctx, bz->origin);
+		isc_mem_free(mctx, bz->filename);
+		if (bz->output != NULL) {
+			isc_mem_free(mctx, bz->output);
+		}
+	}
+	if (batch.zones != NULL) {
+		isc_mem_cput(mctx, batch.zones, batch.size,
+			     sizeof(batch.zones[0]));
+	}
+
+	return (result);
+}
+
 static void
 destroy(void) {
 	if (zone != NULL) {
@@ -109,6 +299,8 @@ main(int argc, char **argv) {
 	bool logdump = false;
 	FILE *errout = stdout;
 	char *endp;
+	const char *manifest = NULL;
+	unsigned int nthreads = 0;
 
 	/*
 	 * Uncomment the following line if memory debugging is needed:
@@ -158,10 +350,14 @@ main(int argc, char **argv) {
 	isc_commandline_errprint = false;
 
 	while ((c = isc_commandline_parse(argc, argv,
-					  "c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:C:"
-					  "DF:M:R:S:T:W:")) != EOF)
+					  "B:c:df:hi:jJ:k:L:l:m:n:N:qr:s:t:o:"
+					  "vw:C:DF:M:R:S:T:W:")) != EOF)
 	{
 		switch (c) {
+		case 'B':
+			manifest = isc_commandline_argument;
+			break;
+
 		case 'c':
 			classname = isc_commandline_argument;
 			break;
@@ -298,6 +494,16 @@ main(int argc, char **argv) {
 			}
 			break;
 
+		case 'N':
+			endp = NULL;
+			nthreads = strtoul(isc_commandline_argument, &endp, 10);
+			if (*endp != '\0' || nthreads == 0) {
+				fprintf(stderr, "number of threads "
+						"must be a positive number\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
 		case 'o':
 			output_filename = isc_commandline_argument;
 			break;
@@ -500,6 +706,34 @@ main(int argc, char **argv) {
 		}
 	}
 
+	if (manifest != NULL) {
+		if (argc != isc_commandline_index || output_filename != NULL ||
+		    journal != NULL || dumpzone)
+		{
+			usage();
+		}
+
+		batch.classname = classname;
+		batch.inputformat = inputformat;
+		batch.outputformat = outputformat;
+		batch.rawversion = rawversion;
+		batch.maxttl = maxttl;
+		batch.snset = snset;
+		batch.serialnum = serialnum;
+		if (nthreads == 0) {
+			nthreads = isc_os_ncpus();
+		}
+
+		isc_mem_create(&mctx);
+		if (!quiet) {
+			RUNTIME_CHECK(setup_logging(stderr) == ISC_R_SUCCESS);
+		}
+		result = batch_main(manifest, nthreads);
+		isc_mem_destroy(&mctx);
+
+		return ((result == ISC_R_SUCCESS) ? 0 : 1);
+	}
+
 	if (progmode == progmode_compile) {
 		dumpzone = 1; /* always dump */
 		logdump = !quiet;
@@ -550,7 +784,7 @@ main(int argc, char **argv) {
 	isc_commandline_index++;
 
 	result = load_zone(mctx, origin, filename, inputformat, classname,
-			   maxttl, &zone);
+			   maxttl, zone_options, &zone);
 
 	if (snset) {
 		dns_master_initrawheader(&header);
@@ -2155,7 +2155,8 @@ run_server(void *arg) {
 
 	CHECK(dns_view_create(mctx, dispatchmgr, dns_rdataclass_in, "_default",
 			      &view));
-	CHECK(dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx, &cache));
+	CHECK(dns_cache_create(loopmgr, dns_rdataclass_in, "", NULL, mctx,
+			       &cache));
 	dns_view_setcache(view, cache, false);
 	dns_cache_detach(&cache);
 	dns_view_setdstport(view, destport);
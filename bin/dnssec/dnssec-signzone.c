@@ -45,6 +45,7 @@
 #include <isc/fips.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/iterated_hash.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/managers.h>
@@ -59,6 +60,7 @@
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -784,11 +786,26 @@ struct hashlist {
 	size_t entries;
 	size_t size;
 	size_t length;
+
+	/*
+	 * Names waiting to be hashed; they are hashed together once
+	 * there are enough of them to fill a batch.
+	 */
+	size_t npending;
+	unsigned char pending[ISC_ITERATED_HASH_BATCH][DNS_NAME_MAXWIRE];
+	int pendinglen[ISC_ITERATED_HASH_BATCH];
+	bool speculative[ISC_ITERATED_HASH_BATCH];
+	char nametext[ISC_ITERATED_HASH_BATCH][DNS_NAME_FORMATSIZE];
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_len;
 };
 
 static void
 hashlist_init(hashlist_t *l, unsigned int nodes, unsigned int length) {
 	l->entries = 0;
+	l->npending = 0;
 	l->length = length + 1;
 
 	if (nodes != 0) {
@@ -830,27 +847,65 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len) {
 	l->entries++;
 }
 
+static void
+hashlist_flush(hashlist_t *l) {
+	unsigned char hashes[ISC_ITERATED_HASH_BATCH][NSEC3_MAX_HASH_LENGTH + 1];
+	unsigned char *out[ISC_ITERATED_HASH_BATCH];
+	const unsigned char *in[ISC_ITERATED_HASH_BATCH];
+	int len;
+
+	if (l->npending == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < l->npending; i++) {
+		out[i] = hashes[i];
+		in[i] = l->pending[i];
+	}
+
+	len = isc_iterated_hash_batch(out, l->hashalg, l->iterations, l->salt,
+				      (int)l->salt_len, in, l->pendinglen,
+				      l->npending);
+	if (len == 0) {
+		fatal("unable to compute NSEC3 hashes");
+	}
+
+	for (size_t i = 0; i < l->npending; i++) {
+		if (verbose) {
+			for (int j = 0; j < len; j++) {
+				fprintf(stderr, "%02x", hashes[i][j]);
+			}
+			fprintf(stderr, " %s\n", l->nametext[i]);
+		}
+		hashes[i][len] = l->speculative[i] ? 1 : 0;
+		hashlist_add(l, hashes[i], len + 1);
+	}
+
+	l->npending = 0;
+}
+
 static void
 hashlist_add_dns_name(hashlist_t *l,
 		      /*const*/ dns_name_t *name, unsigned int hashalg,
 		      unsigned int iterations, const unsigned char *salt,
 		      size_t salt_len, bool speculative) {
-	char nametext[DNS_NAME_FORMATSIZE];
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
-	unsigned int len;
-	size_t i;
+	size_t i = l->npending;
 
-	len = isc_iterated_hash(hash, hashalg, iterations, salt, (int)salt_len,
-				name->ndata, name->length);
+	l->hashalg = hashalg;
+	l->iterations = iterations;
+	l->salt = salt;
+	l->salt_len = salt_len;
+
+	memmove(l->pending[i], name->ndata, name->length);
+	l->pendinglen[i] = name->length;
+	l->speculative[i] = speculative;
 	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0; i < len; i++) {
-			fprintf(stderr, "%02x", hash[i]);
-		}
-		fprintf(stderr, " %s\n", nametext);
+		dns_name_format(name, l->nametext[i], sizeof(l->nametext[i]));
+	}
+
+	if (++l->npending == ISC_ITERATED_HASH_BATCH) {
+		hashlist_flush(l);
 	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
 }
 
 static int
@@ -858,10 +913,144 @@ hashlist_comp(const void *a, const void *b) {
 	return (memcmp(a, b, hash_length + 1));
 }
 
+/*%
+ * Hash lists with at least HASHLIST_PARALLEL_MIN entries are sorted on
+ * 'nloops' threads: each thread sorts a slice of the list, and the
+ * sorted slices are then merged pairwise, also in parallel.
+ */
+#define HASHLIST_PARALLEL_MIN (64 * 1024)
+
+typedef struct hashlist_run {
+	const unsigned char *src;
+	unsigned char *dst;
+	size_t lo, mid, hi;
+	size_t length;
+} hashlist_run_t;
+
+static void *
+hashlist_sortrun(void *arg) {
+	hashlist_run_t *run = arg;
+
+	qsort(run->dst + run->lo * run->length, run->hi - run->lo, run->length,
+	      hashlist_comp);
+
+	return (NULL);
+}
+
+/*
+ * Merge the sorted runs src[lo..mid) and src[mid..hi) into dst[lo..hi).
+ */
+static void *
+hashlist_mergerun(void *arg) {
+	hashlist_run_t *run = arg;
+	const unsigned char *a = run->src + run->lo * run->length;
+	const unsigned char *aend = run->src + run->mid * run->length;
+	const unsigned char *b = aend;
+	const unsigned char *bend = run->src + run->hi * run->length;
+	unsigned char *out = run->dst + run->lo * run->length;
+
+	while (a < aend && b < bend) {
+		if (hashlist_comp(a, b) <= 0) {
+			memmove(out, a, run->length);
+			a += run->length;
+		} else {
+			memmove(out, b, run->length);
+			b += run->length;
+		}
+		out += run->length;
+	}
+	memmove(out, a, aend - a);
+	out += aend - a;
+	memmove(out, b, bend - b);
+
+	return (NULL);
+}
+
+static void
+hashlist_parallelsort(hashlist_t *l, unsigned int nthreads) {
+	unsigned char *src = l->hashbuf;
+	unsigned char *dst = NULL;
+	unsigned int nruns = nthreads;
+	size_t *bounds = NULL;
+	hashlist_run_t *runs = NULL;
+	isc_thread_t *threads = NULL;
+
+	dst = malloc(l->entries * l->length);
+	if (dst == NULL) {
+		qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
+		return;
+	}
+
+	bounds = isc_mem_cget(mctx, nthreads + 1, sizeof(bounds[0]));
+	runs = isc_mem_cget(mctx, nthreads, sizeof(runs[0]));
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+
+	for (unsigned int i = 0; i <= nthreads; i++) {
+		bounds[i] = l->entries * i / nthreads;
+	}
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		runs[i] = (hashlist_run_t){
+			.dst = src,
+			.lo = bounds[i],
+			.hi = bounds[i + 1],
+			.length = l->length,
+		};
+		isc_thread_create(hashlist_sortrun, &runs[i], &threads[i]);
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	while (nruns > 1) {
+		unsigned int n = 0;
+		unsigned char *tmp = NULL;
+
+		for (unsigned int i = 0; i < nruns; i += 2, n++) {
+			size_t hi = bounds[ISC_MIN(i + 2, nruns)];
+
+			runs[n] = (hashlist_run_t){
+				.src = src,
+				.dst = dst,
+				.lo = bounds[i],
+				.mid = bounds[i + 1],
+				.hi = hi,
+				.length = l->length,
+			};
+			isc_thread_create(hashlist_mergerun, &runs[n],
+					  &threads[n]);
+		}
+		for (unsigned int i = 0; i < n; i++) {
+			isc_thread_join(threads[i], NULL);
+			bounds[i] = runs[i].lo;
+		}
+		bounds[n] = l->entries;
+		nruns = n;
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+	isc_mem_cput(mctx, runs, nthreads, sizeof(runs[0]));
+	isc_mem_cput(mctx, bounds, nthreads + 1, sizeof(bounds[0]));
+
+	free(dst);
+	l->hashbuf = src;
+	l->size = l->entries;
+}
+
 static void
 hashlist_sort(hashlist_t *l) {
+	hashlist_flush(l);
 	INSIST(l->hashbuf != NULL || l->length == 0);
-	if (l->length > 0) {
+	if (l->length == 0) {
+		return;
+	}
+	if (nloops > 1 && l->entries >= HASHLIST_PARALLEL_MIN) {
+		hashlist_parallelsort(l, nloops);
+	} else {
 		qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
 	}
 }
@@ -1553,12 +1742,19 @@ abortwork(void *arg) {
 }
 
 /*%
- * Assigns a node to a worker thread.  This is protected by the main task's
- * lock.
+ * Number of nodes a worker takes from the iterator at a time.
+ */
+#define ASSIGN_BATCH 32
+
+/*%
+ * Assigns a batch of nodes to a worker thread.  This is protected by the
+ * main task's lock.
  */
 static void
 assignwork(void *arg) {
-	dns_fixedname_t fname;
+	dns_fixedname_t fnames[ASSIGN_BATCH];
+	dns_dbnode_t *nodes[ASSIGN_BATCH];
+	size_t count = 0;
 	dns_name_t *name = NULL;
 	dns_dbnode_t *node = NULL;
 	dns_rdataset_t nsec;
@@ -1584,10 +1780,10 @@ assignwork(void *arg) {
 		return;
 	}
 
-	name = dns_fixedname_initname(&fname);
-	node = NULL;
-	found = false;
-	while (!found) {
+	while (count < ASSIGN_BATCH && !atomic_load(&finished)) {
+		name = dns_fixedname_initname(&fnames[count]);
+		node = NULL;
+		found = false;
 		result = dns_dbiterator_current(gdbiter, &node, name);
 		check_dns_dbiterator_current(result);
 		/*
@@ -1636,7 +1832,9 @@ assignwork(void *arg) {
 			}
 		}
 
-		if (!found) {
+		if (found) {
+			nodes[count++] = node;
+		} else {
 			dumpnode(name, node);
 			dns_db_detachnode(gdb, &node);
 		}
@@ -1645,13 +1843,12 @@ assignwork(void *arg) {
 		result = dns_dbiterator_next(gdbiter);
 		if (result == ISC_R_NOMORE) {
 			atomic_store(&finished, true);
-			break;
 		} else if (result != ISC_R_SUCCESS) {
 			fatal("failure iterating database: %s",
 			      isc_result_totext(result));
 		}
 	}
-	if (!found) {
+	if (count == 0) {
 		ended++;
 		if (ended == nloops) {
 			isc_loopmgr_shutdown(loopmgr);
@@ -1662,13 +1859,16 @@ assignwork(void *arg) {
 
 	UNLOCK(&namelock);
 
-	signname(node, false, dns_fixedname_name(&fname));
-
 	/*%
-	 * Write a node to the output file, and restart the worker task.
+	 * Sign the nodes, write them to the output file, and restart the
+	 * worker task.
 	 */
-	lock_and_dumpnode(dns_fixedname_name(&fname), node);
-	dns_db_detachnode(gdb, &node);
+	for (size_t i = 0; i < count; i++) {
+		name = dns_fixedname_name(&fnames[i]);
+		signname(nodes[i], false, name);
+		lock_and_dumpnode(name, nodes[i]);
+		dns_db_detachnode(gdb, &nodes[i]);
+	}
 
 	isc_async_current(assignwork, NULL);
 }
@@ -4051,7 +4251,7 @@ main(int argc, char *argv[]) {
 	} else {
 		vresult = dns_zoneverify_dnssec(NULL, gdb, gversion, gorigin,
 						NULL, mctx, ignore_kskflag,
-						keyset_kskonly, report);
+						keyset_kskonly, nloops, report);
 		if (vresult != ISC_R_SUCCESS) {
 			fprintf(output_stdout ? stderr : stdout,
 				"Zone verification failed (%s)\n",
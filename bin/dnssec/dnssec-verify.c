@@ -73,6 +73,7 @@ static dns_rdataclass_t gclass;		 /* The class */
 static dns_name_t *gorigin = NULL;	 /* The database origin */
 static bool ignore_kskflag = false;
 static bool keyset_kskonly = false;
+static unsigned int nthreads = 0;
 
 static void
 report(const char *format, ...) {
@@ -157,6 +158,7 @@ usage(void) {
 	fprintf(stderr, "\t-I format:\n");
 	fprintf(stderr, "\t\tfile format of input zonefile (text)\n");
 	fprintf(stderr, "\t-c class (IN)\n");
+	fprintf(stderr, "\t-n ncpus (number of cpus present)\n");
 	fprintf(stderr, "\t-x:\tDNSKEY record signed with KSKs only, "
 			"not ZSKs\n");
 	fprintf(stderr, "\t-z:\tAll records signed with KSKs\n");
@@ -173,7 +175,7 @@ main(int argc, char *argv[]) {
 	char *endp;
 	int ch;
 
-#define CMDLINE_FLAGS "c:E:hJ:m:o:I:qv:Vxz"
+#define CMDLINE_FLAGS "c:E:hJ:m:n:o:I:qv:Vxz"
 
 	/*
 	 * Process memory debugging argument first.
@@ -225,6 +227,14 @@ main(int argc, char *argv[]) {
 		case 'm':
 			break;
 
+		case 'n':
+			endp = NULL;
+			nthreads = strtol(isc_commandline_argument, &endp, 0);
+			if (*endp != '\0' || nthreads > INT32_MAX) {
+				fatal("number of cpus must be numeric");
+			}
+			break;
+
 		case 'o':
 			origin = isc_commandline_argument;
 			break;
@@ -320,7 +330,8 @@ main(int argc, char *argv[]) {
 	check_result(result, "dns_db_newversion()");
 
 	result = dns_zoneverify_dnssec(NULL, gdb, gversion, gorigin, NULL, mctx,
-				       ignore_kskflag, keyset_kskonly, report);
+				       ignore_kskflag, keyset_kskonly, nthreads,
+				       report);
 
 	dns_db_closeversion(gdb, &gversion, false);
 	dns_db_detach(&gdb);
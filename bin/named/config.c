@@ -50,7 +50,9 @@ options {\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 #	blackhole {none;};\n\
+	cache-snapshot-interval 0;\n\
 	cookie-algorithm siphash24;\n\
+	cpu-steering no;\n\
 #	directory <none>\n\
 	dnssec-policy \"none\";\n\
 	dump-file \"named_dump.db\";\n\
@@ -66,6 +68,7 @@ options {\n\
 	interface-interval 60;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
+	maintenance-threads 0;\n\
 	match-mapped-addresses no;\n\
 	max-ixfr-ratio 100%;\n\
 	max-rsa-exponent-size 0; /* no limit */\n\
@@ -98,6 +101,7 @@ options {\n\
 #	querylog <boolean>;\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
+	recursive-clients-adaptive no;\n\
 	request-nsid false;\n\
 	resolver-query-timeout 10;\n\
 #	responselog <boolean>;\n\
@@ -127,8 +131,10 @@ options {\n\
 	transfers-out 10;\n\
 	transfers-per-ns 2;\n\
 	trust-anchor-telemetry yes;\n\
+	udp-busy-poll 0;\n\
 	udp-receive-buffer 0;\n\
 	udp-send-buffer 0;\n\
+	udp-send-coalescing no;\n\
 	update-quota 100;\n\
 \n\
 	/* view */\n\
@@ -141,7 +147,12 @@ options {\n\
 	allow-recursion { localnets; localhost; };\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
+	answer-qname-case no;\n\
 	auth-nxdomain false;\n\
+	auth-response-cache 0;\n\
+	cache-eviction-policy lru;\n\
+	cache-pack-records no;\n\
+	cache-type " CACHEDB_DEFAULT ";\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -192,6 +203,9 @@ options {\n\
 	require-server-cookie no;\n\
 	root-key-sentinel yes;\n\
 	servfail-ttl 1;\n\
+	share-cache no;\n\
+	shared-zone-data no;\n\
+	shared-zone-trie no;\n\
 #	sortlist <none>\n\
 	stale-answer-client-timeout off;\n\
 	stale-answer-enable false;\n\
@@ -220,6 +234,8 @@ options {\n\
 #	forwarders <none>\n\
 #	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	journal-group-commit no;\n\
+	load-on-demand no;\n\
 	max-journal-size default;\n\
 	max-records 0;\n\
 	max-records-per-type 100;\n\
@@ -238,6 +254,7 @@ options {\n\
 	notify-to-soa no;\n\
 	send-report-channel .;\n\
 	serial-update-method increment;\n\
+	sig-cache no;\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
 	sig-signing-type 65534;\n\
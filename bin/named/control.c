@@ -202,6 +202,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		   command_compare(command, NAMED_COMMAND_MODZONE))
 	{
 		result = named_server_changezone(named_g_server, cmdline, text);
+	} else if (command_compare(command, NAMED_COMMAND_ADDZONES)) {
+		result = named_server_addzones(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_CLOSELOGS)) {
 		isc_log_closefilelogs();
 		result = ISC_R_SUCCESS;
@@ -233,6 +235,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		   command_compare(command, NAMED_COMMAND_SIGN))
 	{
 		result = named_server_rekey(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_LOCKSTATS)) {
+		result = named_server_lockstats(lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_MKEYS)) {
 		result = named_server_mkeys(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_NOTIFY)) {
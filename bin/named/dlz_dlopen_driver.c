@@ -310,6 +310,7 @@ dlopen_dlz_create(const char *dlzname, unsigned int argc, char *argv[],
 	MAYBE_LOCK(cd);
 	result = cd->dlz_create(dlzname, argc - 1, argv + 1, &cd->dbdata, "log",
 				dlopen_log, "putrr", dns_sdlz_putrr,
+				"putrdata", dns_sdlz_putrdata,
 				"putnamedrr", dns_sdlz_putnamedrr,
 				"writeable_zone", dns_dlz_writeablezone, NULL);
 	MAYBE_UNLOCK(cd);
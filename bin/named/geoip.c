@@ -18,12 +18,15 @@
 #endif /* if defined(HAVE_GEOIP2) */
 
 #include <isc/dir.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/geoip.h>
+#include <dns/stats.h>
 
 #include <named/geoip.h>
+#include <named/globals.h>
 #include <named/log.h>
 
 static dns_geoip_databases_t geoip_table;
@@ -68,6 +71,8 @@ named_geoip_init(void) {
 #if defined(HAVE_GEOIP2)
 	if (named_g_geoip == NULL) {
 		named_g_geoip = &geoip_table;
+		isc_stats_create_sharded(named_g_mctx, &named_g_geoip->stats,
+					 dns_geoipstatscounter_max);
 	}
 #else  /* if defined(HAVE_GEOIP2) */
 	return;
@@ -115,6 +120,7 @@ named_geoip_load(char *dir) {
 void
 named_geoip_unload(void) {
 #ifdef HAVE_GEOIP2
+	dns_geoip_flushcache();
 	if (named_g_geoip->country != NULL) {
 		MMDB_close(named_g_geoip->country);
 		named_g_geoip->country = NULL;
@@ -142,5 +148,8 @@ void
 named_geoip_shutdown(void) {
 #ifdef HAVE_GEOIP2
 	named_geoip_unload();
+	if (named_g_geoip->stats != NULL) {
+		isc_stats_detach(&named_g_geoip->stats);
+	}
 #endif /* HAVE_GEOIP2 */
 }
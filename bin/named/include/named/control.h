@@ -29,6 +29,7 @@
 #define NAMED_CONTROL_PORT 953
 
 #define NAMED_COMMAND_ADDZONE	   "addzone"
+#define NAMED_COMMAND_ADDZONES	   "addzones"
 #define NAMED_COMMAND_CLOSELOGS	   "closelogs"
 #define NAMED_COMMAND_DELZONE	   "delzone"
 #define NAMED_COMMAND_DNSSEC	   "dnssec"
@@ -43,6 +44,7 @@
 #define NAMED_COMMAND_FREEZE	   "freeze"
 #define NAMED_COMMAND_HALT	   "halt"
 #define NAMED_COMMAND_LOADKEYS	   "loadkeys"
+#define NAMED_COMMAND_LOCKSTATS	   "lockstats"
 #define NAMED_COMMAND_MKEYS	   "managed-keys"
 #define NAMED_COMMAND_MODZONE	   "modzone"
 #define NAMED_COMMAND_NOTIFY	   "notify"
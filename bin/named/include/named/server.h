@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/quota.h>
@@ -61,6 +62,7 @@ struct named_server {
 	dns_loadmgr_t	  *loadmgr;
 	dns_zonemgr_t	  *zonemgr;
 	dns_viewlist_t	   viewlist;
+	dns_viewselect_t  *viewselect; /*%< Compiled view match ACLs */
 	dns_kasplist_t	   kasplist;
 	dns_keystorelist_t keystorelist;
 	ns_interfacemgr_t *interfacemgr;
@@ -70,8 +72,22 @@ struct named_server {
 	isc_timer_t *heartbeat_timer;
 	isc_timer_t *pps_timer;
 	isc_timer_t *tat_timer;
+	isc_timer_t *snapshot_timer;
+	isc_timer_t *recursion_timer;
 
 	uint32_t interface_interval;
+	uint32_t snapshot_interval; /*%< Automatic cache snapshots */
+	atomic_uint snapshots_running;
+
+	/*
+	 * Adaptive recursive-clients limit ("recursive-clients-adaptive").
+	 */
+	unsigned int   recursion_max;	   /*%< Configured limit */
+	bool	       recursion_congested;
+	isc_nanosecs_t recursion_tick;	   /*%< Last controller run */
+	uint64_t       recursion_rtts;	   /*%< Resolver query totals */
+	uint64_t       recursion_slowrtts; /*%< ... that were slow */
+	uint32_t maintthreads; /*%< Worker threads reserved for zones */
 
 	atomic_int reload_status;
 
@@ -80,6 +96,7 @@ struct named_server {
 	named_cachelist_t cachelist; /*%< Possibly shared caches
 				      * */
 	isc_stats_t *zonestats;	     /*% Zone management stats */
+	dns_zonecounters_t *zonecounters; /*%< Compact zone counters */
 	isc_stats_t *resolverstats;  /*% Resolver stats */
 	isc_stats_t *sockstats;	     /*%< Socket stats */
 
@@ -298,6 +315,13 @@ isc_result_t
 named_server_changezone(named_server_t *server, char *command,
 			isc_buffer_t **text);
 
+/*%
+ * Add all the zones configured in a file to a running process
+ */
+isc_result_t
+named_server_addzones(named_server_t *server, isc_lex_t *lex,
+		      isc_buffer_t **text);
+
 /*%
  * Deletes a zone from a running process
  */
@@ -388,3 +412,9 @@ named_server_fetchlimit(named_server_t *server, isc_lex_t *lex,
  */
 isc_result_t
 named_server_skr(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text);
+
+/*%
+ * Enable, disable or reset lock profiling, or report lock statistics.
+ */
+isc_result_t
+named_server_lockstats(isc_lex_t *lex, isc_buffer_t **text);
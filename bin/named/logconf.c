@@ -213,11 +213,13 @@ channel_fromconf(const cfg_obj_t *channel, isc_logconfig_t *logconfig) {
 		const cfg_obj_t *printsev = NULL;
 		const cfg_obj_t *printtime = NULL;
 		const cfg_obj_t *buffered = NULL;
+		const cfg_obj_t *async = NULL;
 
 		(void)cfg_map_get(channel, "print-category", &printcat);
 		(void)cfg_map_get(channel, "print-severity", &printsev);
 		(void)cfg_map_get(channel, "print-time", &printtime);
 		(void)cfg_map_get(channel, "buffered", &buffered);
+		(void)cfg_map_get(channel, "async", &async);
 
 		if (printcat != NULL && cfg_obj_asboolean(printcat)) {
 			flags |= ISC_LOG_PRINTCATEGORY;
@@ -228,6 +230,16 @@ channel_fromconf(const cfg_obj_t *channel, isc_logconfig_t *logconfig) {
 		if (buffered != NULL && cfg_obj_asboolean(buffered)) {
 			flags |= ISC_LOG_BUFFERED;
 		}
+		if (async != NULL && cfg_obj_isboolean(async)) {
+			if (cfg_obj_asboolean(async)) {
+				flags |= ISC_LOG_ASYNC;
+			}
+		} else if (async != NULL) { /* drop/block */
+			flags |= ISC_LOG_ASYNC;
+			if (strcasecmp(cfg_obj_asstring(async), "block") == 0) {
+				flags |= ISC_LOG_ASYNCBLOCK;
+			}
+		}
 		if (printtime != NULL && cfg_obj_isboolean(printtime)) {
 			if (cfg_obj_asboolean(printtime)) {
 				flags |= ISC_LOG_PRINTTIME;
@@ -120,6 +120,7 @@
 extern unsigned int dns_zone_mkey_hour;
 extern unsigned int dns_zone_mkey_day;
 extern unsigned int dns_zone_mkey_month;
+extern unsigned int dns_xfrin_maxqueued;
 
 static bool want_stats = false;
 static char program_name[NAME_MAX] = "named";
@@ -772,6 +773,11 @@ parse_T_opt(char *option) {
 		transferslowly = true;
 	} else if (!strcmp(option, "transferstuck")) {
 		transferstuck = true;
+	} else if (!strncmp(option, "xfrinmaxqueued=", 15)) {
+		dns_xfrin_maxqueued = atoi(option + 15);
+		if (dns_xfrin_maxqueued == 0) {
+			named_main_earlyfatal("bad xfrinmaxqueued");
+		}
 	} else if (!strncmp(option, "tat=", 4)) {
 		named_g_tat_interval = atoi(option + 4);
 	} else {
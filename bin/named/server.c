@@ -33,6 +33,7 @@
 #endif
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/base64.h>
 #include <isc/commandline.h>
@@ -45,6 +46,7 @@
 #include <isc/httpd.h>
 #include <isc/job.h>
 #include <isc/lex.h>
+#include <isc/lockprof.h>
 #include <isc/loop.h>
 #include <isc/meminfo.h>
 #include <isc/netmgr.h>
@@ -61,6 +63,7 @@
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/adb.h>
 #include <dns/badcache.h>
@@ -94,10 +97,14 @@
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
+#include <dns/refresh.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
+#include <dns/sdlz.h>
 #include <dns/secalg.h>
+#include <dns/slabstore.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/time.h>
@@ -105,7 +112,9 @@
 #include <dns/tsig.h>
 #include <dns/ttl.h>
 #include <dns/view.h>
+#include <dns/viewselect.h>
 #include <dns/zone.h>
+#include <dns/zonecounters.h>
 #include <dns/zt.h>
 
 #include <dst/dst.h>
@@ -119,6 +128,7 @@
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/listenlist.h>
+#include <ns/sortlist.h>
 
 #include <named/config.h>
 #include <named/control.h>
@@ -231,6 +241,21 @@
  */
 #define MAX_ADB_SIZE_FOR_CACHESHARE 8388608U
 
+/*%
+ * The number of popular RRsets that each recursive view keeps track of
+ * for refreshing, and the number of refresh fetches it may have in
+ * flight at once.
+ */
+#define REFRESH_SIZE	1024
+#define REFRESH_FETCHES 16
+
+/*%
+ * The number of responses per worker thread that clients of the same
+ * fetch may share; entries are only needed until the fetch's clients
+ * have been answered.
+ */
+#define RESPSHARE_SIZE 256
+
 struct named_dispatch {
 	isc_sockaddr_t addr;
 	unsigned int dispatchgen;
@@ -243,6 +268,7 @@ struct named_cache {
 	dns_view_t *primaryview;
 	bool needflush;
 	bool adbsizeadjusted;
+	bool autoshare; /* other views may share it with "share-cache" */
 	dns_rdataclass_t rdclass;
 	ISC_LINK(named_cache_t) link;
 };
@@ -264,6 +290,31 @@ struct dumpcontext {
 	dns_db_t *cache;
 	isc_loop_t *loop;
 	dns_dbversion_t *version;
+	dns_fixedname_t filtername;
+	dns_dumpfilter_t filter;
+};
+
+/*
+ * A cache snapshot being written for "rndc dumpdb -binary" or by the
+ * "cache-snapshot-interval" timer.
+ */
+struct snapshotdump {
+	named_server_t *server;
+	isc_mem_t *mctx;
+	dns_dumpctx_t *mdctx;
+	char *filename;
+	char *viewname;
+};
+
+/*
+ * A cache snapshot of another named process being imported by the
+ * "cache-snapshot-interval" timer.
+ */
+struct snapshotimport {
+	named_server_t *server;
+	isc_mem_t *mctx;
+	char *filename;
+	char *viewname;
 };
 
 struct viewlistentry {
@@ -295,6 +346,9 @@ typedef struct matching_view_ctx {
 	isc_result_t quota_result;
 	dns_view_t **viewp;
 	dns_view_t *view;
+	unsigned int index;
+	dns_viewselect_t *viewselect;
+	dns_viewselect_match_t match;
 } matching_view_ctx_t;
 
 /*%
@@ -328,18 +382,28 @@ typedef struct {
 	isc_refcount_t refs;
 } ns_zoneload_t;
 
+typedef struct catz_chgzone catz_chgzone_t;
+typedef ISC_LIST(catz_chgzone_t) catz_chgzone_list_t;
+
 typedef struct {
 	named_server_t *server;
+	isc_mutex_t lock;
+	catz_chgzone_list_t changes; /* queued member zone changes */
 } catz_cb_data_t;
 
-typedef struct catz_chgzone {
+struct catz_chgzone {
 	isc_mem_t *mctx;
 	dns_catz_entry_t *entry;
 	dns_catz_zone_t *origin;
 	dns_view_t *view;
 	catz_cb_data_t *cbd;
 	bool mod;
-} catz_chgzone_t;
+	bool del;
+	ns_cfgctx_t *cfg;
+	cfg_obj_t *zoneconf; /* configuration of the member zone */
+	dns_zone_t *zone;    /* member zone to load */
+	ISC_LINK(catz_chgzone_t) link;
+};
 
 typedef struct catz_reconfig_data {
 	dns_catz_zone_t *catz;
@@ -493,6 +557,16 @@ add_keydata_zone(dns_view_t *view, const char *directory, isc_mem_t *mctx);
 static void
 newzone_cfgctx_destroy(void **cfgp);
 
+static void
+snapshot_timer_tick(void *arg);
+
+static void
+snapshot_saveall(named_server_t *server);
+
+static void
+snapshot_import(named_server_t *server, dns_view_t *view,
+		const char *filename);
+
 static isc_result_t
 putstr(isc_buffer_t **b, const char *str);
 
@@ -1819,6 +1893,14 @@ setquerystats(dns_zone_t *zone, isc_mem_t *mctx, dns_zonestat_level_t level) {
 	if (zoneqrystats != NULL) {
 		isc_stats_detach(&zoneqrystats);
 	}
+
+	if (dns_zone_setcounters(zone, level == dns_zonestat_compact
+					       ? named_g_server->zonecounters
+					       : NULL) != ISC_R_SUCCESS)
+	{
+		dns_zone_log(zone, ISC_LOG_WARNING,
+			     "no compact zone counters available");
+	}
 }
 
 static named_cache_t *
@@ -1841,8 +1923,10 @@ cachelist_find(named_cachelist_t *cachelist, const char *cachename,
 
 static bool
 cache_reusable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl) {
+	       bool new_zero_no_soattl, const char *new_cache_type) {
 	if (originview->rdclass != view->rdclass ||
+	    strcmp(dns_cache_getdbtype(originview->cache), new_cache_type) !=
+		    0 ||
 	    originview->checknames != view->checknames ||
 	    dns_resolver_getzeronosoattl(originview->resolver) !=
 		    new_zero_no_soattl ||
@@ -1859,13 +1943,17 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 
 static bool
 cache_sharable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl, uint64_t new_max_cache_size,
-	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time) {
+	       bool new_zero_no_soattl, const char *new_cache_type,
+	       uint64_t new_max_cache_size, uint32_t new_stale_ttl,
+	       uint32_t new_stale_refresh_time,
+	       dns_cacheeviction_t new_eviction_policy) {
 	/*
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
 	 */
-	if (!cache_reusable(originview, view, new_zero_no_soattl)) {
+	if (!cache_reusable(originview, view, new_zero_no_soattl,
+			    new_cache_type))
+	{
 		return (false);
 	}
 
@@ -1876,7 +1964,9 @@ cache_sharable(dns_view_t *originview, dns_view_t *view,
 	if (dns_cache_getservestalettl(originview->cache) != new_stale_ttl ||
 	    dns_cache_getservestalerefresh(originview->cache) !=
 		    new_stale_refresh_time ||
-	    dns_cache_getcachesize(originview->cache) != new_max_cache_size)
+	    dns_cache_getcachesize(originview->cache) != new_max_cache_size ||
+	    dns_cache_getevictionpolicy(originview->cache) !=
+		    new_eviction_policy)
 	{
 		return (false);
 	}
@@ -1884,6 +1974,55 @@ cache_sharable(dns_view_t *originview, dns_view_t *view,
 	return (true);
 }
 
+/*
+ * Fill 'cache' from the snapshot in 'filename', if it exists.
+ */
+static void
+snapshot_load(dns_cache_t *cache, const char *filename, const char *viewname) {
+	isc_result_t result = dns_cache_load(cache, filename);
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO,
+			      "loaded cache snapshot '%s' for view %s",
+			      filename, viewname);
+	} else if (result != ISC_R_FILENOTFOUND) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_WARNING,
+			      "could not load cache snapshot '%s' for view "
+			      "%s: %s",
+			      filename, viewname, isc_result_totext(result));
+	}
+}
+
+/*
+ * Find a cache that a view with "share-cache yes;" can share: one that
+ * was created by an earlier view which allows sharing too, and that
+ * has the same caching policy.
+ */
+static named_cache_t *
+cachelist_find_sharable(named_cachelist_t *cachelist, dns_view_t *view,
+			bool new_zero_no_soattl, const char *new_cache_type,
+			uint64_t new_max_cache_size, uint32_t new_stale_ttl,
+			uint32_t new_stale_refresh_time,
+			dns_cacheeviction_t new_eviction_policy) {
+	named_cache_t *nsc;
+
+	for (nsc = ISC_LIST_HEAD(*cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (nsc->autoshare && nsc->rdclass == view->rdclass &&
+		    cache_sharable(nsc->primaryview, view, new_zero_no_soattl,
+				   new_cache_type, new_max_cache_size,
+				   new_stale_ttl, new_stale_refresh_time,
+				   new_eviction_policy))
+		{
+			return (nsc);
+		}
+	}
+
+	return (NULL);
+}
+
 /*
  * Callback from DLZ configure when the driver sets up a writeable zone
  */
@@ -2371,24 +2510,16 @@ configure_rpz(dns_view_t *view, dns_view_t *pview, const cfg_obj_t *rpz_obj,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Generate and parse the configuration of a member zone to be added or
+ * modified. This is done before the loops are paused.
+ */
 static void
-catz_addmodzone_cb(void *arg) {
-	catz_chgzone_t *cz = (catz_chgzone_t *)arg;
+catz_addmodzone_prepare(catz_chgzone_t *cz) {
 	isc_result_t result;
-	dns_forwarders_t *dnsforwarders = NULL;
-	dns_name_t *name = NULL;
-	isc_buffer_t namebuf;
 	isc_buffer_t *confbuf = NULL;
 	char nameb[DNS_NAME_FORMATSIZE];
-	const cfg_obj_t *zlist = NULL;
-	cfg_obj_t *zoneconf = NULL;
-	cfg_obj_t *zoneobj = NULL;
 	ns_cfgctx_t *cfg = NULL;
-	dns_zone_t *zone = NULL;
-
-	if (isc_loop_shuttingdown(isc_loop_get(named_g_loopmgr, isc_tid()))) {
-		goto cleanup;
-	}
 
 	/*
 	 * A non-empty 'catalog-zones' statement implies that 'allow-new-zones'
@@ -2396,7 +2527,52 @@ catz_addmodzone_cb(void *arg) {
 	 */
 	cfg = (ns_cfgctx_t *)cz->view->new_zone_config;
 	if (cfg == NULL) {
-		CHECK(ISC_R_FAILURE);
+		return;
+	}
+
+	result = dns_catz_generate_zonecfg(cz->origin, cz->entry, &confbuf);
+	if (result == ISC_R_SUCCESS) {
+		cfg_parser_reset(cfg->add_parser);
+		result = cfg_parse_buffer(cfg->add_parser, confbuf, "catz", 0,
+					  &cfg_type_addzoneconf, 0,
+					  &cz->zoneconf);
+		isc_buffer_free(&confbuf);
+	}
+	/*
+	 * Fail if either dns_catz_generate_zonecfg() or cfg_parse_buffer()
+	 * failed.
+	 */
+	if (result != ISC_R_SUCCESS) {
+		dns_name_format(dns_catz_entry_getname(cz->entry), nameb,
+				sizeof(nameb));
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "catz: error \"%s\" while trying to generate "
+			      "config for zone '%s'",
+			      isc_result_totext(result), nameb);
+		return;
+	}
+
+	cz->cfg = cfg;
+}
+
+/*
+ * Add or modify a member zone. The loops are paused; the zone is
+ * loaded after they are resumed.
+ */
+static void
+catz_addmodzone_cb(catz_chgzone_t *cz) {
+	isc_result_t result;
+	dns_forwarders_t *dnsforwarders = NULL;
+	dns_name_t *name = NULL;
+	isc_buffer_t namebuf;
+	char nameb[DNS_NAME_FORMATSIZE];
+	const cfg_obj_t *zlist = NULL;
+	cfg_obj_t *zoneobj = NULL;
+	dns_zone_t *zone = NULL;
+
+	if (cz->zoneconf == NULL) {
+		return;
 	}
 
 	name = dns_catz_entry_getname(cz->entry);
@@ -2495,28 +2671,8 @@ catz_addmodzone_cb(void *arg) {
 		}
 	}
 	RUNTIME_CHECK(zone == NULL);
-	/* Create a config for new zone */
-	confbuf = NULL;
-	result = dns_catz_generate_zonecfg(cz->origin, cz->entry, &confbuf);
-	if (result == ISC_R_SUCCESS) {
-		cfg_parser_reset(cfg->add_parser);
-		result = cfg_parse_buffer(cfg->add_parser, confbuf, "catz", 0,
-					  &cfg_type_addzoneconf, 0, &zoneconf);
-		isc_buffer_free(&confbuf);
-	}
-	/*
-	 * Fail if either dns_catz_generate_zonecfg() or cfg_parse_buffer()
-	 * failed.
-	 */
-	if (result != ISC_R_SUCCESS) {
-		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
-			      ISC_LOG_ERROR,
-			      "catz: error \"%s\" while trying to generate "
-			      "config for zone '%s'",
-			      isc_result_totext(result), nameb);
-		goto cleanup;
-	}
-	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+
+	CHECK(cfg_map_get(cz->zoneconf, "zone", &zlist));
 	if (!cfg_obj_islist(zlist)) {
 		CHECK(ISC_R_FAILURE);
 	}
@@ -2525,15 +2681,13 @@ catz_addmodzone_cb(void *arg) {
 	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 
 	/* Mark view unfrozen so that zone can be added */
-	isc_loopmgr_pause(named_g_loopmgr);
 	dns_view_thaw(cz->view);
-	result = configure_zone(cfg->config, zoneobj, cfg->vconfig, cz->view,
-				&cz->cbd->server->viewlist,
+	result = configure_zone(cz->cfg->config, zoneobj, cz->cfg->vconfig,
+				cz->view, &cz->cbd->server->viewlist,
 				&cz->cbd->server->kasplist,
-				&cz->cbd->server->keystorelist, cfg->actx, true,
-				false, true, cz->mod);
+				&cz->cbd->server->keystorelist, cz->cfg->actx,
+				true, false, true, cz->mod);
 	dns_view_freeze(cz->view);
-	isc_loopmgr_resume(named_g_loopmgr);
 
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
@@ -2547,63 +2701,64 @@ catz_addmodzone_cb(void *arg) {
 	CHECK(dns_view_findzone(cz->view, name, DNS_ZTFIND_EXACT, &zone));
 
 	/*
-	 * Load the zone from the master file.	If this fails, we'll
-	 * need to undo the configuration we've done already.
+	 * Flag the zone as having been added at runtime, so that a later
+	 * change in the same batch finds it as it would after the load.
 	 */
-	result = dns_zone_load(zone, true);
-	if (result != ISC_R_SUCCESS) {
-		dns_db_t *dbp = NULL;
-		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
-			      ISC_LOG_ERROR,
-			      "catz: dns_zone_load() failed "
-			      "with %s; reverting.",
-			      isc_result_totext(result));
-
-		/* If the zone loaded partially, unload it */
-		if (dns_zone_getdb(zone, &dbp) == ISC_R_SUCCESS) {
-			dns_db_detach(&dbp);
-			dns_zone_unload(zone);
-		}
-
-		/* Remove the zone from the zone table */
-		dns_view_delzone(cz->view, zone);
-		goto cleanup;
-	}
-
-	/* Flag the zone as having been added at runtime */
 	dns_zone_setadded(zone, true);
 	dns_zone_set_parentcatz(zone, cz->origin);
 
+	cz->zone = zone;
+	zone = NULL;
+
 cleanup:
 	if (zone != NULL) {
 		dns_zone_detach(&zone);
 	}
-	if (zoneconf != NULL) {
-		cfg_obj_destroy(cfg->add_parser, &zoneconf);
-	}
 	if (dnsforwarders != NULL) {
 		dns_forwarders_detach(&dnsforwarders);
 	}
-	dns_catz_entry_detach(cz->origin, &cz->entry);
-	dns_catz_zone_detach(&cz->origin);
-	dns_view_weakdetach(&cz->view);
-	isc_mem_putanddetach(&cz->mctx, cz, sizeof(*cz));
 }
 
+/*
+ * Load a member zone that was added or modified. If this fails, we'll
+ * need to undo the configuration we've done already.
+ */
 static void
-catz_delzone_cb(void *arg) {
-	catz_chgzone_t *cz = (catz_chgzone_t *)arg;
+catz_loadzone(catz_chgzone_t *cz) {
 	isc_result_t result;
-	dns_zone_t *zone = NULL;
 	dns_db_t *dbp = NULL;
-	char cname[DNS_NAME_FORMATSIZE];
-	const char *file = NULL;
 
-	if (isc_loop_shuttingdown(isc_loop_get(named_g_loopmgr, isc_tid()))) {
-		goto cleanup;
+	result = dns_zone_load(cz->zone, true);
+	if (result == ISC_R_SUCCESS) {
+		return;
 	}
 
-	isc_loopmgr_pause(named_g_loopmgr);
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_ERROR,
+		      "catz: dns_zone_load() failed "
+		      "with %s; reverting.",
+		      isc_result_totext(result));
+
+	/* If the zone loaded partially, unload it */
+	if (dns_zone_getdb(cz->zone, &dbp) == ISC_R_SUCCESS) {
+		dns_db_detach(&dbp);
+		dns_zone_unload(cz->zone);
+	}
+
+	/* Remove the zone from the zone table */
+	dns_view_delzone(cz->view, cz->zone);
+}
+
+/*
+ * Delete a member zone. The loops are paused.
+ */
+static void
+catz_delzone_cb(catz_chgzone_t *cz) {
+	isc_result_t result;
+	dns_zone_t *zone = NULL;
+	dns_db_t *dbp = NULL;
+	char cname[DNS_NAME_FORMATSIZE];
+	const char *file = NULL;
 
 	dns_name_format(dns_catz_entry_getname(cz->entry), cname,
 			DNS_NAME_FORMATSIZE);
@@ -2615,7 +2770,7 @@ catz_delzone_cb(void *arg) {
 			      "catz: catz_delzone_cb: "
 			      "zone '%s' not found",
 			      cname);
-		goto resume;
+		goto cleanup;
 	}
 
 	if (!dns_zone_getadded(zone)) {
@@ -2624,7 +2779,7 @@ catz_delzone_cb(void *arg) {
 			      "catz: catz_delzone_cb: "
 			      "zone '%s' is not a dynamically added zone",
 			      cname);
-		goto resume;
+		goto cleanup;
 	}
 
 	if (dns_zone_get_parentcatz(zone) != cz->origin) {
@@ -2633,7 +2788,7 @@ catz_delzone_cb(void *arg) {
 			      "catz: catz_delzone_cb: zone "
 			      "'%s' exists in multiple catalog zones",
 			      cname);
-		goto resume;
+		goto cleanup;
 	}
 
 	/* Stop answering for this zone */
@@ -2643,7 +2798,7 @@ catz_delzone_cb(void *arg) {
 	}
 
 	if (dns_view_delzone(cz->view, zone) != ISC_R_SUCCESS) {
-		goto resume;
+		goto cleanup;
 	}
 	file = dns_zone_getfile(zone);
 	if (file != NULL) {
@@ -2659,41 +2814,96 @@ catz_delzone_cb(void *arg) {
 		      "catz: catz_delzone_cb: "
 		      "zone '%s' deleted",
 		      cname);
-resume:
-	isc_loopmgr_resume(named_g_loopmgr);
 cleanup:
 	if (zone != NULL) {
 		dns_zone_detach(&zone);
 	}
+}
+
+static void
+catz_chgzone_free(catz_chgzone_t *cz) {
+	if (cz->zone != NULL) {
+		dns_zone_detach(&cz->zone);
+	}
+	if (cz->zoneconf != NULL) {
+		cfg_obj_destroy(cz->cfg->add_parser, &cz->zoneconf);
+	}
 	dns_catz_entry_detach(cz->origin, &cz->entry);
 	dns_catz_zone_detach(&cz->origin);
 	dns_view_weakdetach(&cz->view);
 	isc_mem_putanddetach(&cz->mctx, cz, sizeof(*cz));
 }
 
+/*
+ * Apply the member zone changes queued by the catalog zones. They are
+ * applied in the order they were queued, with the loops paused once
+ * for the whole batch rather than once for every zone; the zone
+ * configurations are generated before, and the zones loaded after.
+ */
+static void
+catz_changezones_cb(void *arg) {
+	catz_cb_data_t *cbd = (catz_cb_data_t *)arg;
+	catz_chgzone_list_t changes;
+	catz_chgzone_t *cz = NULL, *next = NULL;
+
+	ISC_LIST_INIT(changes);
+	LOCK(&cbd->lock);
+	ISC_LIST_MOVE(changes, cbd->changes);
+	UNLOCK(&cbd->lock);
+
+	if (isc_loop_shuttingdown(isc_loop_get(named_g_loopmgr, isc_tid()))) {
+		goto cleanup;
+	}
+
+	for (cz = ISC_LIST_HEAD(changes); cz != NULL;
+	     cz = ISC_LIST_NEXT(cz, link))
+	{
+		if (!cz->del) {
+			catz_addmodzone_prepare(cz);
+		}
+	}
+
+	isc_loopmgr_pause(named_g_loopmgr);
+	for (cz = ISC_LIST_HEAD(changes); cz != NULL;
+	     cz = ISC_LIST_NEXT(cz, link))
+	{
+		if (cz->del) {
+			catz_delzone_cb(cz);
+		} else {
+			catz_addmodzone_cb(cz);
+		}
+	}
+	isc_loopmgr_resume(named_g_loopmgr);
+
+	for (cz = ISC_LIST_HEAD(changes); cz != NULL;
+	     cz = ISC_LIST_NEXT(cz, link))
+	{
+		if (cz->zone != NULL) {
+			catz_loadzone(cz);
+		}
+	}
+
+cleanup:
+	for (cz = ISC_LIST_HEAD(changes); cz != NULL; cz = next) {
+		next = ISC_LIST_NEXT(cz, link);
+		ISC_LIST_UNLINK(changes, cz, link);
+		catz_chgzone_free(cz);
+	}
+}
+
 static isc_result_t
 catz_run(dns_catz_entry_t *entry, dns_catz_zone_t *origin, dns_view_t *view,
 	 void *udata, catz_type_t type) {
+	catz_cb_data_t *cbd = (catz_cb_data_t *)udata;
 	catz_chgzone_t *cz = NULL;
-	isc_job_cb action = NULL;
-
-	switch (type) {
-	case CATZ_ADDZONE:
-	case CATZ_MODZONE:
-		action = catz_addmodzone_cb;
-		break;
-	case CATZ_DELZONE:
-		action = catz_delzone_cb;
-		break;
-	default:
-		REQUIRE(0);
-		UNREACHABLE();
-	}
+	bool first;
 
 	cz = isc_mem_get(view->mctx, sizeof(*cz));
 	*cz = (catz_chgzone_t){
-		.cbd = (catz_cb_data_t *)udata,
+		.cbd = cbd,
 		.mod = (type == CATZ_MODZONE),
+		.del = (type == CATZ_DELZONE),
+		.link = ISC_LINK_INITIALIZER,
 	};
 	isc_mem_attach(view->mctx, &cz->mctx);
 
@@ -2701,7 +2911,17 @@ catz_run(dns_catz_entry_t *entry, dns_catz_zone_t *origin, dns_view_t *view,
 	dns_catz_zone_attach(origin, &cz->origin);
 	dns_view_weakattach(view, &cz->view);
 
-	isc_async_run(named_g_mainloop, action, cz);
+	/*
+	 * Changes queued while a batch is waiting to run join it.
+	 */
+	LOCK(&cbd->lock);
+	first = ISC_LIST_EMPTY(cbd->changes);
+	ISC_LIST_APPEND(cbd->changes, cz, link);
+	UNLOCK(&cbd->lock);
+
+	if (first) {
+		isc_async_run(named_g_mainloop, catz_changezones_cb, cbd);
+	}
 
 	return (ISC_R_SUCCESS);
 }
@@ -2994,7 +3214,7 @@ cleanup:
 		} else {                                                    \
 			rrl->rate.r = def;                                  \
 		}                                                           \
-		rrl->rate.scaled = rrl->rate.r;                             \
+		atomic_init(&rrl->rate.scaled, rrl->rate.r);               \
 	} while (0)
 
 static isc_result_t
@@ -3068,7 +3288,6 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 		CHECK_RRL(i >= 1, "invalid 'qps-scale %d'%s", i, "");
 	}
 	rrl->qps_scale = i;
-	rrl->qps = 1.0;
 
 	i = 24;
 	obj = NULL;
@@ -3123,6 +3342,14 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 		rrl->log_only = false;
 	}
 
+	obj = NULL;
+	result = cfg_map_get(map, "early-drop", &obj);
+	if (result == ISC_R_SUCCESS && cfg_obj_asboolean(obj)) {
+		rrl->early_drop = true;
+	} else {
+		rrl->early_drop = false;
+	}
+
 	return (ISC_R_SUCCESS);
 
 cleanup:
@@ -3673,6 +3900,16 @@ configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
 		dns_dt_setversion(named_g_server->dtenv, cfg_obj_asstring(obj));
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-sample", &obj);
+	if (result == ISC_R_SUCCESS) {
+		uint32_t sample = cfg_obj_asuint32(obj);
+
+		dns_dt_setsample(named_g_server->dtenv, ISC_MAX(sample, 1));
+	} else {
+		dns_dt_setsample(named_g_server->dtenv, 1);
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "dnstap-identity", &obj);
 	if (result == ISC_R_SUCCESS && cfg_obj_isboolean(obj)) {
@@ -3795,9 +4032,42 @@ minimal_cache_allowed(const cfg_obj_t *maps[4],
 
 static const char *const response_synonyms[] = { "response", NULL };
 
+static void
+hash_config(void *arg, const char *text, int textlen) {
+	isc_hash64_hash(arg, text, textlen, true);
+}
+
 /*
- * Configure 'view' according to 'vconfig', taking defaults from
- * 'config' where values are missing in 'vconfig'.
+ * Hash the clauses of the configuration map 'mapobj' other than the
+ * zone and view statements, i.e. the configuration that the zones
+ * configured below it can inherit.
+ */
+static void
+hash_zone_context(isc_hash64_t *state, const cfg_obj_t *mapobj) {
+	const void *clauses = NULL;
+	unsigned int idx = 0;
+	const char *name = NULL;
+
+	for (name = cfg_map_firstclause(mapobj->type, &clauses, &idx);
+	     name != NULL;
+	     name = cfg_map_nextclause(mapobj->type, &clauses, &idx))
+	{
+		const cfg_obj_t *obj = NULL;
+
+		if (strcasecmp(name, "zone") == 0 ||
+		    strcasecmp(name, "view") == 0 ||
+		    cfg_map_get(mapobj, name, &obj) != ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		isc_hash64_hash(state, name, strlen(name), true);
+		cfg_printx(obj, CFG_PRINTER_ONELINE, hash_config, state);
+	}
+}
+
+/*
+ * Configure 'view' according to 'vconfig', taking defaults from
+ * 'config' where values are missing in 'vconfig'.
  *
  * When configuring the default view, 'vconfig' will be NULL and the
  * global defaults in 'config' used exclusively.
@@ -3828,6 +4098,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	const cfg_obj_t *obj, *obj2;
 	const cfg_listelt_t *element = NULL;
 	const cfg_listelt_t *zone_element_latest = NULL;
+	isc_hash64_t state;
 	in_port_t port;
 	dns_cache_t *cache = NULL;
 	isc_result_t result;
@@ -3837,6 +4108,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	uint32_t lame_ttl, fail_ttl;
 	uint32_t max_stale_ttl = 0;
 	uint32_t stale_refresh_time = 0;
+	dns_cacheeviction_t eviction_policy = dns_cacheeviction_lru;
+	bool pack_records = false;
+	const char *cache_type = NULL;
 	dns_tsigkeyring_t *ring = NULL;
 	dns_transport_list_t *transports = NULL;
 	dns_view_t *pview = NULL; /* Production view */
@@ -3845,6 +4119,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	bool rpz_configured = false;
 	bool catz_configured = false;
 	bool shared_cache = false;
+	bool share_cache = false;
+	bool new_cache = false;
 	int i = 0, j = 0, k = 0;
 	const char *str;
 	const char *cachename = NULL;
@@ -3944,6 +4220,21 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		(void)cfg_map_get(config, "zone", &zonelist);
 	}
 
+	/*
+	 * Hash what the zones inherit from the view and the global
+	 * options, so that configure_zone() can tell whether a zone's
+	 * configuration has changed since it was last configured.
+	 */
+	isc_hash64_init(&state);
+	hash_zone_context(&state, config);
+	if (voptions != NULL) {
+		hash_zone_context(&state, voptions);
+	}
+	view->zone_confighash = isc_hash64_finalize(&state);
+	if (view->zone_confighash == 0) {
+		view->zone_confighash = 1;
+	}
+
 	/*
 	 * Load zone configuration
 	 */
@@ -4009,7 +4300,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		(void)cfg_map_get(dlz, "database", &obj);
 		if (obj != NULL) {
 			dns_dlzdb_t *dlzdb = NULL;
-			const cfg_obj_t *name, *search = NULL;
+			const cfg_obj_t *name, *search = NULL, *cachettl = NULL;
+			const cfg_obj_t *async = NULL;
 			char *s = isc_mem_strdup(mctx, cfg_obj_asstring(obj));
 
 			if (s == NULL) {
@@ -4034,6 +4326,29 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				goto cleanup;
 			}
 
+			(void)cfg_map_get(dlz, "cache-ttl", &cachettl);
+			if (cachettl != NULL &&
+			    dns_sdlz_setcachettl(dlzdb,
+						 cfg_obj_asduration(cachettl)) !=
+				    ISC_R_SUCCESS)
+			{
+				cfg_obj_log(cachettl, ISC_LOG_WARNING,
+					    "dlz '%s': cache-ttl is not "
+					    "supported by this driver",
+					    cfg_obj_asstring(name));
+			}
+
+			(void)cfg_map_get(dlz, "async-lookups", &async);
+			if (async != NULL &&
+			    dns_sdlz_setasync(dlzdb, cfg_obj_asuint32(async)) !=
+				    ISC_R_SUCCESS)
+			{
+				cfg_obj_log(async, ISC_LOG_WARNING,
+					    "dlz '%s': async-lookups is not "
+					    "supported by this driver",
+					    cfg_obj_asstring(name));
+			}
+
 			/*
 			 * If the DLZ backend supports configuration,
 			 * and is searchable, then call its configure
@@ -4387,6 +4702,23 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	stale_refresh_time = cfg_obj_asduration(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-eviction-policy", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "sieve") == 0) {
+		eviction_policy = dns_cacheeviction_sieve;
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-pack-records", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	pack_records = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-type", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_type = cfg_obj_asstring(obj);
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -4409,6 +4741,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 * forwarder, changes in the forwarder configuration may invalidate
 	 * the cache.  At the moment, it's the administrator's responsibility to
 	 * ensure these configuration options don't invalidate reusing/sharing.
+	 *
+	 * Without attach-cache, "share-cache yes;" makes the view share the
+	 * cache of the first earlier view that has it too and whose caching
+	 * policy is the same.
 	 */
 	obj = NULL;
 	result = named_config_get(maps, "attach-cache", &obj);
@@ -4416,13 +4752,30 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		cachename = cfg_obj_asstring(obj);
 	} else {
 		cachename = view->name;
+
+		obj = NULL;
+		result = named_config_get(maps, "share-cache", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		share_cache = cfg_obj_asboolean(obj);
 	}
 	cache = NULL;
 	nsc = cachelist_find(cachelist, cachename, view->rdclass);
+	if (nsc == NULL && share_cache) {
+		nsc = cachelist_find_sharable(cachelist, view, zero_no_soattl,
+					      cache_type, max_cache_size,
+					      max_stale_ttl, stale_refresh_time,
+					      eviction_policy);
+		if (nsc != NULL) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_DEBUG(1),
+				      "view %s shares the cache of view %s",
+				      view->name, nsc->primaryview->name);
+		}
+	}
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
-				    max_cache_size, max_stale_ttl,
-				    stale_refresh_time))
+				    cache_type, max_cache_size, max_stale_ttl,
+				    stale_refresh_time, eviction_policy))
 		{
 			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -4445,7 +4798,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			}
 			if (pview != NULL) {
 				if (!cache_reusable(pview, view,
-						    zero_no_soattl))
+						    zero_no_soattl, cache_type))
 				{
 					isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 						      NAMED_LOGMODULE_SERVER,
@@ -4480,7 +4833,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			 * is simply a named cache that is not shared.
 			 */
 			CHECK(dns_cache_create(named_g_loopmgr, view->rdclass,
-					       cachename, mctx, &cache));
+					       cachename, cache_type, mctx,
+					       &cache));
+			new_cache = true;
 		}
 		nsc = isc_mem_get(mctx, sizeof(*nsc));
 		nsc->cache = NULL;
@@ -4488,6 +4843,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		nsc->primaryview = view;
 		nsc->needflush = false;
 		nsc->adbsizeadjusted = false;
+		nsc->autoshare = share_cache;
 		nsc->rdclass = view->rdclass;
 		ISC_LINK_INIT(nsc, link);
 		ISC_LIST_APPEND(*cachelist, nsc, link);
@@ -4497,6 +4853,58 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	dns_cache_setcachesize(cache, max_cache_size);
 	dns_cache_setservestalettl(cache, max_stale_ttl);
 	dns_cache_setservestalerefresh(cache, stale_refresh_time);
+	dns_cache_setevictionpolicy(cache, eviction_policy);
+	dns_cache_setpackrecords(cache, pack_records);
+
+	/*
+	 * A newly created cache is warmed up from the snapshot written by
+	 * "rndc dumpdb -binary", if there is one, and then, on worker
+	 * threads so as not to hold up reconfiguration, from the snapshots
+	 * of the other named processes listed in "cache-snapshot-import".
+	 */
+	if (!shared_cache) {
+		const char *snapshot = NULL;
+		const char **imports = NULL;
+		size_t nimports = 0;
+
+		obj = NULL;
+		result = named_config_get(maps, "cache-snapshot-file", &obj);
+		if (result == ISC_R_SUCCESS) {
+			snapshot = cfg_obj_asstring(obj);
+		}
+		dns_cache_setfilename(cache, snapshot);
+
+		obj = NULL;
+		(void)named_config_get(maps, "cache-snapshot-import", &obj);
+		if (obj != NULL) {
+			nimports = cfg_list_length(obj, false);
+		}
+		if (nimports != 0) {
+			const cfg_listelt_t *element = cfg_list_first(obj);
+
+			imports = isc_mem_cget(mctx, nimports,
+					       sizeof(imports[0]));
+			for (size_t i = 0; element != NULL;
+			     element = cfg_list_next(element), i++)
+			{
+				imports[i] = cfg_obj_asstring(
+					cfg_listelt_value(element));
+			}
+		}
+		dns_cache_setimports(cache, imports, nimports);
+
+		if (new_cache && snapshot != NULL) {
+			snapshot_load(cache, snapshot, view->name);
+		}
+		for (size_t i = 0; new_cache && i < nimports; i++) {
+			snapshot_import(named_g_server, view, imports[i]);
+		}
+
+		if (imports != NULL) {
+			isc_mem_cput(mctx, imports, nimports,
+				     sizeof(imports[0]));
+		}
+	}
 
 	dns_cache_detach(&cache);
 
@@ -4526,11 +4934,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				      dispatch4, dispatch6));
 
 	if (resstats == NULL) {
-		isc_stats_create(mctx, &resstats, dns_resstatscounter_max);
+		isc_stats_create_sharded(mctx, &resstats,
+					 dns_resstatscounter_max);
 	}
 	dns_resolver_setstats(view->resolver, resstats);
 	if (resquerystats == NULL) {
-		dns_rdatatypestats_create(mctx, &resquerystats);
+		dns_rdatatypestats_create_sharded(mctx, &resquerystats);
 	}
 	dns_resolver_setquerystats(view->resolver, resquerystats);
 
@@ -5148,6 +5557,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->msgcompression = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "answer-qname-case", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->answerqnamecase = cfg_obj_asboolean(obj);
+
 	/*
 	 * Filter setting on addresses in the answer section.
 	 */
@@ -5173,6 +5587,23 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 */
 	CHECK(configure_view_sortlist(vconfig, config, actx, named_g_mctx,
 				      &view->sortlist));
+	if (view->sortlistindex != NULL) {
+		view->sortlistindex_free(view->mctx, &view->sortlistindex);
+	}
+	if (view->sortlist != NULL) {
+		ns_sortlistindex_t *index = NULL;
+
+		/*
+		 * Sortlists that use more than IP prefixes to match
+		 * the client are evaluated statement by statement.
+		 */
+		if (ns_sortlist_compile(view->mctx, view->sortlist, &index) ==
+		    ISC_R_SUCCESS)
+		{
+			view->sortlistindex = index;
+			view->sortlistindex_free = ns_sortlist_freeindex;
+		}
+	}
 
 	/*
 	 * Configure default allow-update and allow-update-forwarding ACLs,
@@ -5281,6 +5712,31 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_view_setmaxtypepername(view, cfg_obj_asuint32(obj));
 
+	obj = NULL;
+	result = named_config_get(maps, "shared-zone-trie", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->sharedzonetrie = cfg_obj_asboolean(obj);
+
+	/*
+	 * Keep the slab store of the previous instance of the view, so the
+	 * zones loaded after reconfiguring share records with the others.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "shared-zone-data", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj)) {
+		result = dns_viewlist_find(&named_g_server->viewlist,
+					   view->name, view->rdclass, &pview);
+		if (result == ISC_R_SUCCESS && pview->slabstore != NULL) {
+			view->slabstore = dns_slabstore_ref(pview->slabstore);
+		} else {
+			dns_slabstore_create(view->mctx, &view->slabstore);
+		}
+		if (pview != NULL) {
+			dns_view_detach(&pview);
+		}
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "max-recursion-depth", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -5360,6 +5816,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		view->prefetch_eligible = view->prefetch_trigger + 6;
 	}
 
+	/*
+	 * Popular RRsets are refreshed in the same window in which
+	 * prefetch would have been triggered by a query.
+	 */
+	if (view->recursion && view->prefetch_trigger > 0) {
+		dns_refresh_create(view, named_g_loopmgr, REFRESH_SIZE,
+				   REFRESH_FETCHES, &view->refresh);
+	}
+
 	/*
 	 * For now, there is only one kind of trusted keys, the
 	 * "security roots".
@@ -5523,6 +5988,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				statlevel = dns_zonestat_full;
 			} else if (strcasecmp(levelstr, "terse") == 0) {
 				statlevel = dns_zonestat_terse;
+			} else if (strcasecmp(levelstr, "compact") == 0) {
+				statlevel = dns_zonestat_compact;
 			} else if (strcasecmp(levelstr, "none") == 0) {
 				statlevel = dns_zonestat_none;
 			} else {
@@ -5716,6 +6183,37 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 	dns_view_setfailttl(view, fail_ttl);
 
+	/*
+	 * Set the authoritative response cache size.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "auth-response-cache", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (view->respcache != NULL) {
+		dns_respcache_destroy(&view->respcache);
+	}
+	if (cfg_obj_asuint32(obj) > 0) {
+		uint32_t respcache_size = cfg_obj_asuint32(obj);
+		if (respcache_size > (1 << 20)) {
+			respcache_size = 1 << 20;
+		}
+		dns_respcache_create(view->mctx,
+				     isc_loopmgr_nloops(named_g_loopmgr),
+				     respcache_size, &view->respcache);
+	}
+
+	/*
+	 * Clients waiting for the same fetch share one rendered response.
+	 */
+	if (view->respshare != NULL) {
+		dns_respcache_destroy(&view->respshare);
+	}
+	if (view->recursion) {
+		dns_respcache_create(view->mctx,
+				     isc_loopmgr_nloops(named_g_loopmgr),
+				     RESPSHARE_SIZE, &view->respshare);
+	}
+
 	/*
 	 * Name space to look up redirect information in.
 	 */
@@ -6275,6 +6773,42 @@ create_view(const cfg_obj_t *vconfig, dns_viewlist_t *viewlist,
 /*
  * Configure or reconfigure a zone.
  */
+/*
+ * Point a zone that is reused without being configured again at the
+ * policies of the same names in the new 'kasplist'.
+ */
+static isc_result_t
+zone_rebind_kasp(dns_zone_t *zone, dns_kasplist_t *kasplist) {
+	isc_result_t result;
+	dns_kasp_t *kasp = NULL;
+	dns_kasp_t *oldkasp = NULL;
+	dns_zonetype_t ztype = dns_zone_gettype(zone);
+
+	if (ztype == dns_zone_stub || ztype == dns_zone_staticstub ||
+	    ztype == dns_zone_redirect)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_kasplist_find(kasplist, "default", &kasp);
+	INSIST(result == ISC_R_SUCCESS && kasp != NULL);
+	dns_zone_setdefaultkasp(zone, kasp);
+	dns_kasp_detach(&kasp);
+
+	oldkasp = dns_zone_getkasp(zone);
+	if (oldkasp != NULL) {
+		result = dns_kasplist_find(kasplist, dns_kasp_getname(oldkasp),
+					   &kasp);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		dns_zone_setkasp(zone, kasp);
+		dns_kasp_detach(&kasp);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       const cfg_obj_t *vconfig, dns_view_t *view,
@@ -6305,6 +6839,8 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	bool zone_maybe_inline = false;
 	bool inline_signing = false;
 	bool fullsign = false;
+	bool reused = false;
+	uint64_t confighash = 0;
 
 	options = NULL;
 	(void)cfg_map_get(config, "options", &options);
@@ -6564,6 +7100,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		 * new view.
 		 */
 		dns_zone_setview(zone, view);
+		reused = true;
 	} else {
 		/*
 		 * We cannot reuse an existing zone, we have
@@ -6645,10 +7182,30 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	/*
-	 * Configure the zone.
+	 * Configure the zone, unless it is being reused and neither its
+	 * own configuration nor what it inherits from the view and the
+	 * global options has changed since it was last configured.
 	 */
-	CHECK(named_zone_configure(config, vconfig, zconfig, aclconf, kasplist,
-				   keystores, zone, raw));
+	if (view->zone_confighash != 0) {
+		isc_hash64_t state;
+
+		isc_hash64_init(&state);
+		isc_hash64_hash(&state, &view->zone_confighash,
+				sizeof(view->zone_confighash), true);
+		cfg_printx(zconfig, CFG_PRINTER_ONELINE, hash_config, &state);
+		confighash = isc_hash64_finalize(&state);
+	}
+	if (reused && confighash != 0 &&
+	    dns_zone_getconfighash(zone) == confighash)
+	{
+		dns_zone_log(zone, ISC_LOG_DEBUG(3), "configuration unchanged");
+		CHECK(zone_rebind_kasp(zone, kasplist));
+	} else {
+		dns_zone_setconfighash(zone, 0);
+		CHECK(named_zone_configure(config, vconfig, zconfig, aclconf,
+					   kasplist, keystores, zone, raw));
+		dns_zone_setconfighash(zone, confighash);
+	}
 
 	/*
 	 * Add the zone to its view in the new view list.
@@ -7148,6 +7705,154 @@ pps_timer_tick(void *arg) {
 	oldrequests = requests;
 }
 
+/*
+ * The adaptive recursive-clients controller considers the server
+ * congested when the main loop runs its once a second timer more than
+ * RECURSION_LOOPLAG milliseconds late, when a client has been recursing
+ * for longer than the resolver works on any query, or when more than
+ * RECURSION_SLOWRTT per mille of the queries sent upstream since the
+ * last run took 800 milliseconds or more or timed out (this needs at
+ * least RECURSION_MINRTTS queries to judge).  While it is congested,
+ * the limit is lowered by an eighth every second, down to an eighth
+ * of the configured limit; otherwise it is raised back by 1/32 of the
+ * configured limit every second.
+ */
+#define RECURSION_LOOPLAG 100
+#define RECURSION_SLOWRTT 250
+#define RECURSION_MINRTTS 50
+
+/*
+ * The recursive-clients soft quota that goes with a hard quota of 'max'.
+ */
+static unsigned int
+recursion_margin(void) {
+	return (ISC_MAX(100, named_g_cpus + 1));
+}
+
+static unsigned int
+recursion_softquota(unsigned int max) {
+	if (max > 1000 && max >= recursion_margin() + 100) {
+		return (max - recursion_margin());
+	}
+	return ((max * 90) / 100);
+}
+
+static void
+recursion_setlimit(named_server_t *server, unsigned int max) {
+	isc_quota_max(&server->sctx->recursionquota, max);
+	isc_quota_soft(&server->sctx->recursionquota,
+		       recursion_softquota(max));
+	isc_stats_set(ns_stats_get(server->sctx->nsstats), max,
+		      ns_statscounter_recurslimit);
+}
+
+static void
+recursion_timer_tick(void *arg) {
+	named_server_t *server = (named_server_t *)arg;
+	isc_stats_t *nsstats = ns_stats_get(server->sctx->nsstats);
+	isc_nanosecs_t now = isc_time_monotonic();
+	isc_nanosecs_t oldest;
+	uint64_t lag = 0, age = 0, slow = 0, timeout = 0;
+	uint64_t rtts = 0, slowrtts = 0;
+	unsigned int limit, next;
+	bool congested;
+
+	/*
+	 * How late the main loop ran this timer.
+	 */
+	if (server->recursion_tick != 0 &&
+	    now - server->recursion_tick > NS_PER_SEC)
+	{
+		lag = (now - server->recursion_tick - NS_PER_SEC) / NS_PER_MS;
+	}
+	server->recursion_tick = now;
+
+	/*
+	 * How long the oldest recursing client has been waiting.
+	 */
+	oldest = ns_interfacemgr_oldestrecursion(server->interfacemgr);
+	if (oldest != 0 && now > oldest) {
+		age = (now - oldest) / NS_PER_MS;
+	}
+
+	/*
+	 * How many upstream queries were slow or timed out.
+	 */
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		isc_stats_t *resstats = NULL;
+
+		if (view->resolver == NULL) {
+			continue;
+		}
+		timeout = ISC_MAX(timeout,
+				  dns_resolver_gettimeout(view->resolver));
+		dns_resolver_getstats(view->resolver, &resstats);
+		if (resstats == NULL) {
+			continue;
+		}
+		for (isc_statscounter_t c = dns_resstatscounter_queryrtt0;
+		     c <= dns_resstatscounter_queryrtt5; c++)
+		{
+			rtts += isc_stats_get_counter(resstats, c);
+		}
+		slowrtts += isc_stats_get_counter(
+			resstats, dns_resstatscounter_queryrtt4);
+		slowrtts += isc_stats_get_counter(
+			resstats, dns_resstatscounter_queryrtt5);
+		slowrtts += isc_stats_get_counter(
+			resstats, dns_resstatscounter_querytimeout);
+		rtts += isc_stats_get_counter(
+			resstats, dns_resstatscounter_querytimeout);
+		isc_stats_detach(&resstats);
+	}
+	if (rtts >= server->recursion_rtts &&
+	    slowrtts >= server->recursion_slowrtts &&
+	    rtts - server->recursion_rtts >= RECURSION_MINRTTS)
+	{
+		slow = (slowrtts - server->recursion_slowrtts) * 1000 /
+		       (rtts - server->recursion_rtts);
+	}
+	if (rtts < server->recursion_rtts ||
+	    rtts - server->recursion_rtts >= RECURSION_MINRTTS)
+	{
+		server->recursion_rtts = rtts;
+		server->recursion_slowrtts = slowrtts;
+	}
+
+	isc_stats_set(nsstats, lag, ns_statscounter_recurslooplag);
+	isc_stats_set(nsstats, age, ns_statscounter_recursfetchage);
+	isc_stats_set(nsstats, slow, ns_statscounter_recursslowrtt);
+
+	congested = lag > RECURSION_LOOPLAG ||
+		    (timeout != 0 && age > timeout) || slow > RECURSION_SLOWRTT;
+	if (congested != server->recursion_congested) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_NOTICE,
+			      "%s the recursive-clients limit "
+			      "(loop lag %" PRIu64 " ms, oldest recursion "
+			      "%" PRIu64 " ms, slow upstream queries "
+			      "%" PRIu64 "/1000)",
+			      congested ? "lowering" : "restoring", lag, age,
+			      slow);
+		server->recursion_congested = congested;
+	}
+
+	limit = isc_quota_getmax(&server->sctx->recursionquota);
+	next = ns_server_recursionlimit(limit, server->recursion_max,
+					congested);
+	if (next == limit) {
+		return;
+	}
+	if (next < limit) {
+		ns_stats_increment(server->sctx->nsstats,
+				   ns_statscounter_recurslimitlowered);
+	}
+
+	recursion_setlimit(server, next);
+}
+
 /*
  * Replace the current value of '*field', a dynamically allocated
  * string or NULL, with a dynamically allocated copy of the
@@ -7922,6 +8627,22 @@ cleanup:
 
 #endif /* HAVE_LMDB */
 
+/*
+ * Log how long each phase of load_configuration() took, so that slow
+ * startups and reconfigurations can be broken down.
+ */
+static void
+log_phase(const char *phase, isc_time_t *last) {
+	isc_time_t now = isc_time_now();
+	uint64_t us = isc_time_microdiff(&now, last);
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_INFO,
+		      "load_configuration: %s took %" PRIu64 ".%03u ms", phase,
+		      us / 1000, (unsigned int)(us % 1000));
+	*last = now;
+}
+
 static isc_result_t
 load_configuration(const char *filename, named_server_t *server,
 		   bool first_time) {
@@ -7964,13 +8685,13 @@ load_configuration(const char *filename, named_server_t *server,
 	named_cachelist_t cachelist, tmpcachelist;
 	ns_altsecret_t *altsecret;
 	ns_altsecretlist_t altsecrets, tmpaltsecrets;
-	uint32_t softquota = 0;
 	uint32_t max;
 	uint64_t initial, idle, keepalive, advertised;
 	bool loadbalancesockets;
-	bool exclusive = true;
+	bool exclusive = false;
 	dns_aclenv_t *env =
 		ns_interfacemgr_getaclenv(named_g_server->interfacemgr);
+	isc_time_t start = isc_time_now(), phase = start;
 
 	/*
 	 * Require the reconfiguration to happen always on the main loop
@@ -7984,23 +8705,6 @@ load_configuration(const char *filename, named_server_t *server,
 	ISC_LIST_INIT(cachelist);
 	ISC_LIST_INIT(altsecrets);
 
-	/* Ensure exclusive access to configuration data. */
-	isc_loopmgr_pause(named_g_loopmgr);
-
-	/* Create the ACL configuration context */
-	if (named_g_aclconfctx != NULL) {
-		cfg_aclconfctx_detach(&named_g_aclconfctx);
-	}
-	result = cfg_aclconfctx_create(named_g_mctx, &named_g_aclconfctx);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup_exclusive;
-	}
-
-	/*
-	 * Shut down all dyndb instances.
-	 */
-	dns_dyndb_cleanup(false);
-
 	/*
 	 * Parse the global default pseudo-config file.
 	 */
@@ -8060,6 +8764,32 @@ load_configuration(const char *filename, named_server_t *server,
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_config;
 	}
+	log_phase("parsing", &phase);
+
+	/*
+	 * Parsing and checking the configuration does not touch the
+	 * running server (other than the working directory), and with
+	 * many zones it takes a good share of the time, so the loops keep
+	 * running until here.  Ensure exclusive access to configuration
+	 * data from now on.
+	 */
+	isc_loopmgr_pause(named_g_loopmgr);
+	exclusive = true;
+	log_phase("pausing the loops", &phase);
+
+	/* Create the ACL configuration context */
+	if (named_g_aclconfctx != NULL) {
+		cfg_aclconfctx_detach(&named_g_aclconfctx);
+	}
+	result = cfg_aclconfctx_create(named_g_mctx, &named_g_aclconfctx);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_config;
+	}
+
+	/*
+	 * Shut down all dyndb instances.
+	 */
+	dns_dyndb_cleanup(false);
 
 	/* Let's recreate the TLS context cache */
 	if (server->tlsctx_server_cache != NULL) {
@@ -8188,23 +8918,31 @@ load_configuration(const char *filename, named_server_t *server,
 			       &server->sctx->sig0checksquota);
 
 	max = isc_quota_getmax(&server->sctx->recursionquota);
-	if (max > 1000) {
-		unsigned int margin = ISC_MAX(100, named_g_cpus + 1);
-		if (margin + 100 > max) {
-			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
-				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
-				      "'recursive-clients %d' too low when "
-				      "running with %d worker threads",
-				      max, named_g_cpus);
-			result = ISC_R_RANGE;
+	if (max > 1000 && recursion_margin() + 100 > max) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "'recursive-clients %d' too low when "
+			      "running with %d worker threads",
+			      max, named_g_cpus);
+		result = ISC_R_RANGE;
 
-			goto cleanup_bindkeys_parser;
-		}
-		softquota = max - margin;
+		goto cleanup_bindkeys_parser;
+	}
+	recursion_setlimit(server, max);
+	server->recursion_max = max;
+
+	obj = NULL;
+	result = named_config_get(maps, "recursive-clients-adaptive", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj) && max != 0) {
+		isc_interval_set(&interval, 1, 0);
+		isc_timer_start(server->recursion_timer, isc_timertype_ticker,
+				&interval);
 	} else {
-		softquota = (max * 90) / 100;
+		isc_timer_stop(server->recursion_timer);
 	}
-	isc_quota_soft(&server->sctx->recursionquota, softquota);
+	server->recursion_congested = false;
+	server->recursion_tick = 0;
 
 	obj = NULL;
 	result = named_config_get(maps, "sig0checks-quota-exempt", &obj);
@@ -8344,6 +9082,18 @@ load_configuration(const char *filename, named_server_t *server,
 			     send_tcp_buffer_size, recv_udp_buffer_size,
 			     send_udp_buffer_size);
 
+	obj = NULL;
+	result = named_config_get(maps, "udp-busy-poll", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+#if defined(SO_BUSY_POLL)
+	isc_nm_setudpbusypoll(named_g_netmgr, cfg_obj_asuint32(obj));
+#else
+	if (cfg_obj_asuint32(obj) != 0) {
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "udp-busy-poll has no effect on this system");
+	}
+#endif
+
 #undef CAP_IF_NOT_ZERO
 
 	/*
@@ -8483,6 +9233,20 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	ns_interfacemgr_setbacklog(server->interfacemgr, backlog);
 
+	/*
+	 * This must be set before the views are configured, so that any
+	 * new caches pick it up; existing caches keep their memory until
+	 * they are flushed.
+	 */
+	obj = NULL;
+	if (options != NULL &&
+	    cfg_map_get(options, "memory-hugepages", &obj) == ISC_R_SUCCESS)
+	{
+		dns_cache_sethugepages(cfg_obj_asboolean(obj));
+	} else {
+		dns_cache_sethugepages(false);
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "reuseport", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8504,6 +9268,76 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "cpu-steering", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (first_time && cfg_obj_asboolean(obj)) {
+		result = isc_loopmgr_setaffinity(named_g_loopmgr);
+		if (result != ISC_R_SUCCESS) {
+			cfg_obj_log(obj, ISC_LOG_WARNING,
+				    "unable to pin worker threads to CPUs: %s",
+				    isc_result_totext(result));
+		}
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+		isc_nm_setcpusteering(named_g_netmgr, loadbalancesockets);
+#else
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "cpu-steering of UDP sockets is not supported "
+			    "on this system");
+#endif
+	} else if (!first_time &&
+		   cfg_obj_asboolean(obj) !=
+			   isc_loopmgr_getaffinity(named_g_loopmgr))
+	{
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "changing cpu-steering value requires server "
+			    "restart");
+	}
+
+	/*
+	 * Keep the zones on the last worker threads, and the listeners on
+	 * the others, so that zone maintenance does not compete with the
+	 * queries.  This must be done before the interfaces are scanned
+	 * and the zones are created below.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "maintenance-threads", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (first_time) {
+		uint32_t maintthreads = cfg_obj_asuint32(obj);
+
+		if (maintthreads >= named_g_cpus && maintthreads > 0) {
+			cfg_obj_log(obj, ISC_LOG_WARNING,
+				    "maintenance-threads %u leaves no worker "
+				    "threads for queries; using %u",
+				    maintthreads, named_g_cpus - 1);
+			maintthreads = named_g_cpus - 1;
+		}
+		if (maintthreads > 0) {
+			isc_nm_setlistenloops(named_g_netmgr,
+					      named_g_cpus - maintthreads);
+			dns_zonemgr_setmaintloops(server->zonemgr,
+						  maintthreads);
+		}
+		server->maintthreads = maintthreads;
+	} else if (cfg_obj_asuint32(obj) != server->maintthreads) {
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "changing maintenance-threads value requires "
+			    "server restart");
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "udp-send-coalescing", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+#if HAVE_SENDMMSG
+	isc_nm_setudpsendcoalesce(named_g_netmgr, cfg_obj_asboolean(obj));
+#else
+	if (cfg_obj_asboolean(obj)) {
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "udp-send-coalescing has no effect on this system");
+	}
+#endif
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8611,6 +9445,11 @@ load_configuration(const char *filename, named_server_t *server,
 	interface_interval = cfg_obj_asduration(obj);
 	server->interface_interval = interface_interval;
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-snapshot-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	server->snapshot_interval = cfg_obj_asduration(obj);
+
 	/*
 	 * Enable automatic interface scans.
 	 */
@@ -8654,6 +9493,14 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_interval_set(&interval, named_g_tat_interval, 0);
 	isc_timer_start(server->tat_timer, isc_timertype_ticker, &interval);
 
+	if (server->snapshot_interval == 0) {
+		isc_timer_stop(server->snapshot_timer);
+	} else {
+		isc_interval_set(&interval, server->snapshot_interval, 0);
+		isc_timer_start(server->snapshot_timer, isc_timertype_ticker,
+				&interval);
+	}
+
 	/*
 	 * Write the PID file.
 	 */
@@ -8769,6 +9616,8 @@ load_configuration(const char *filename, named_server_t *server,
 	server->kasplist = kasplist;
 	kasplist = tmpkasplist;
 
+	log_phase("server options", &phase);
+
 	/*
 	 * Configure the views.
 	 */
@@ -8821,6 +9670,8 @@ load_configuration(const char *filename, named_server_t *server,
 		}
 	}
 
+	log_phase("creating views", &phase);
+
 	/*
 	 * Configure and freeze all explicit views.  Explicit
 	 * views that have zones were already created at parsing
@@ -8831,6 +9682,7 @@ load_configuration(const char *filename, named_server_t *server,
 	{
 		cfg_obj_t *vconfig = cfg_listelt_value(element);
 		dns_view_t *view = NULL;
+		isc_time_t vstart = isc_time_now(), vnow;
 
 		view = NULL;
 		result = find_view(vconfig, &viewlist, &view);
@@ -8847,6 +9699,12 @@ load_configuration(const char *filename, named_server_t *server,
 			goto cleanup_cachelist;
 		}
 		dns_view_freeze(view);
+
+		vnow = isc_time_now();
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_DEBUG(1),
+			      "configuring view '%s' took %" PRIu64 " us",
+			      view->name, isc_time_microdiff(&vnow, &vstart));
 		dns_view_detach(&view);
 	}
 
@@ -8872,6 +9730,8 @@ load_configuration(const char *filename, named_server_t *server,
 		dns_view_detach(&view);
 	}
 
+	log_phase("configuring views", &phase);
+
 	/*
 	 * Create (or recreate) the built-in views.
 	 */
@@ -8901,6 +9761,8 @@ load_configuration(const char *filename, named_server_t *server,
 		dns_view_detach(&view);
 	}
 
+	log_phase("built-in views", &phase);
+
 	/* Now combine the two viewlists into one */
 	ISC_LIST_APPENDLIST(viewlist, builtin_viewlist, link);
 
@@ -8926,6 +9788,13 @@ load_configuration(const char *filename, named_server_t *server,
 		view->viewlist = &server->viewlist;
 	}
 
+	/* Compile the view selector for the new view list. */
+	if (server->viewselect != NULL) {
+		dns_viewselect_detach(&server->viewselect);
+	}
+	dns_viewselect_create(server->mctx, &server->viewlist,
+			      &server->viewselect);
+
 	/* Swap our new cache list with the production one. */
 	tmpcachelist = server->cachelist;
 	server->cachelist = cachelist;
@@ -9308,6 +10177,7 @@ load_configuration(const char *filename, named_server_t *server,
 
 	isc_loopmgr_resume(named_g_loopmgr);
 	exclusive = false;
+	log_phase("committing", &phase);
 
 	/* Take back root privileges temporarily */
 	if (first_time) {
@@ -9338,6 +10208,7 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 
 	(void)ns_interfacemgr_scan(server->interfacemgr, true, true);
+	log_phase("listeners", &phase);
 
 	/*
 	 * Permanently drop root privileges now.
@@ -9427,6 +10298,10 @@ cleanup_exclusive:
 		isc_loopmgr_resume(named_g_loopmgr);
 	}
 
+	if (result == ISC_R_SUCCESS) {
+		log_phase("the whole reload", &start);
+	}
+
 	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
 		      ISC_LOG_DEBUG(1), "load_configuration: %s",
 		      isc_result_totext(result));
@@ -9615,6 +10490,12 @@ run_server(void *arg) {
 	isc_timer_create(named_g_mainloop, pps_timer_tick, server,
 			 &server->pps_timer);
 
+	isc_timer_create(named_g_mainloop, snapshot_timer_tick, server,
+			 &server->snapshot_timer);
+
+	isc_timer_create(named_g_mainloop, recursion_timer_tick, server,
+			 &server->recursion_timer);
+
 	CHECKFATAL(cfg_parser_create(named_g_mctx, &named_g_parser),
 		   "creating default configuration parser");
 
@@ -9684,6 +10565,10 @@ shutdown_server(void *arg) {
 
 	(void)named_server_saventa(server);
 
+	if (server->snapshot_interval != 0) {
+		snapshot_saveall(server);
+	}
+
 	for (kasp = ISC_LIST_HEAD(server->kasplist); kasp != NULL;
 	     kasp = kasp_next)
 	{
@@ -9708,6 +10593,9 @@ shutdown_server(void *arg) {
 		dns_view_flushonshutdown(view, flush);
 		dns_view_detach(&view);
 	}
+	if (server->viewselect != NULL) {
+		dns_viewselect_detach(&server->viewselect);
+	}
 
 	/*
 	 * Shut down all dyndb instances.
@@ -9723,6 +10611,8 @@ shutdown_server(void *arg) {
 	isc_timer_destroy(&server->interface_timer);
 	isc_timer_destroy(&server->pps_timer);
 	isc_timer_destroy(&server->tat_timer);
+	isc_timer_destroy(&server->snapshot_timer);
+	isc_timer_destroy(&server->recursion_timer);
 
 	ns_interfacemgr_detach(&server->interfacemgr);
 
@@ -9743,11 +10633,44 @@ shutdown_server(void *arg) {
 	isc_loopmgr_resume(named_g_loopmgr);
 }
 
+/*
+ * Return the next view after 'view' (or the first one if 'view' is NULL)
+ * that serves 'rdclass' and that the view selector has not ruled out for
+ * the request, keeping '*indexp' at the position of the view in the view
+ * list.
+ */
+static dns_view_t *
+get_matching_view_next(dns_view_t *view, unsigned int *indexp,
+		       const dns_viewselect_match_t *match,
+		       dns_rdataclass_t rdclass) {
+	if (view == NULL) {
+		view = ISC_LIST_HEAD(named_g_server->viewlist);
+		*indexp = 0;
+	} else {
+		view = ISC_LIST_NEXT(view, link);
+		(*indexp)++;
+	}
+	while (view != NULL) {
+		if ((rdclass == view->rdclass ||
+		     rdclass == dns_rdataclass_any) &&
+		    (match == NULL || dns_viewselect_candidate(match, *indexp)))
+		{
+			return (view);
+		}
+		view = ISC_LIST_NEXT(view, link);
+		(*indexp)++;
+	}
+
+	return (NULL);
+}
+
 static isc_result_t
 get_matching_view_sync(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		       dns_message_t *message, dns_aclenv_t *env,
 		       isc_result_t *sigresult, dns_view_t **viewp) {
-	dns_view_t *view;
+	dns_viewselect_match_t match, *matchp = NULL;
+	dns_view_t *view = NULL;
+	unsigned int index = 0;
 
 	/*
 	 * We should not be running synchronous view matching if signature
@@ -9757,31 +10680,34 @@ get_matching_view_sync(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 	INSIST(message->tsigkey != NULL || message->tsig != NULL ||
 	       message->sig0 == NULL);
 
-	for (view = ISC_LIST_HEAD(named_g_server->viewlist); view != NULL;
-	     view = ISC_LIST_NEXT(view, link))
-	{
-		if (message->rdclass == view->rdclass ||
-		    message->rdclass == dns_rdataclass_any)
-		{
-			const dns_name_t *tsig = NULL;
+	if (named_g_server->viewselect != NULL) {
+		dns_viewselect_lookup(named_g_server->viewselect, srcaddr,
+				      destaddr, env, &match);
+		matchp = &match;
+	}
 
-			dns_message_resetsig(message);
-			*sigresult = dns_message_checksig(message, view);
-			if (*sigresult == ISC_R_SUCCESS) {
-				tsig = dns_tsigkey_identity(message->tsigkey);
-			}
+	view = get_matching_view_next(NULL, &index, matchp, message->rdclass);
+	while (view != NULL) {
+		const dns_name_t *tsig = NULL;
 
-			if (dns_acl_allowed(srcaddr, tsig, view->matchclients,
-					    env) &&
-			    dns_acl_allowed(destaddr, tsig,
-					    view->matchdestinations, env) &&
-			    !(view->matchrecursiveonly &&
-			      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
-			{
-				dns_view_attach(view, viewp);
-				return (ISC_R_SUCCESS);
-			}
+		dns_message_resetsig(message);
+		*sigresult = dns_message_checksig(message, view);
+		if (*sigresult == ISC_R_SUCCESS) {
+			tsig = dns_tsigkey_identity(message->tsigkey);
 		}
+
+		if (dns_acl_allowed(srcaddr, tsig, view->matchclients, env) &&
+		    dns_acl_allowed(destaddr, tsig, view->matchdestinations,
+				    env) &&
+		    !(view->matchrecursiveonly &&
+		      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
+		{
+			dns_view_attach(view, viewp);
+			return (ISC_R_SUCCESS);
+		}
+
+		view = get_matching_view_next(view, &index, matchp,
+					      message->rdclass);
 	}
 
 	return (ISC_R_NOTFOUND);
@@ -9805,29 +10731,15 @@ get_matching_view_done(void *cbarg) {
 	if (mvctx->view != NULL) {
 		dns_view_detach(&mvctx->view);
 	}
+	if (mvctx->viewselect != NULL) {
+		dns_viewselect_detach(&mvctx->viewselect);
+	}
 	isc_loop_detach(&mvctx->loop);
 	ns_server_detach(&mvctx->sctx);
 	isc_mem_put(message->mctx, mvctx, sizeof(*mvctx));
 	dns_message_detach(&message);
 }
 
-static dns_view_t *
-get_matching_view_next(dns_view_t *view, dns_rdataclass_t rdclass) {
-	if (view == NULL) {
-		view = ISC_LIST_HEAD(named_g_server->viewlist);
-	} else {
-		view = ISC_LIST_NEXT(view, link);
-	}
-	while (true) {
-		if (view == NULL || rdclass == view->rdclass ||
-		    rdclass == dns_rdataclass_any)
-		{
-			return (view);
-		}
-		view = ISC_LIST_NEXT(view, link);
-	};
-}
-
 static void
 get_matching_view_continue(void *cbarg, isc_result_t result) {
 	matching_view_ctx_t *mvctx = cbarg;
@@ -9857,7 +10769,10 @@ get_matching_view_continue(void *cbarg, isc_result_t result) {
 
 	dns_message_resetsig(mvctx->message);
 
-	view = get_matching_view_next(mvctx->view, mvctx->message->rdclass);
+	view = get_matching_view_next(
+		mvctx->view, &mvctx->index,
+		(mvctx->viewselect != NULL) ? &mvctx->match : NULL,
+		mvctx->message->rdclass);
 	dns_view_detach(&mvctx->view);
 	if (view != NULL) {
 		/*
@@ -9887,7 +10802,9 @@ get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		  isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 		  isc_result_t *sigresult, isc_result_t *viewmatchresult,
 		  dns_view_t **viewp) {
+	dns_viewselect_match_t match, *matchp = NULL;
 	dns_view_t *view = NULL;
+	unsigned int index = 0;
 	isc_result_t result;
 
 	REQUIRE(message != NULL);
@@ -9904,8 +10821,16 @@ get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		return (*viewmatchresult);
 	}
 
-	/* Also no offloading when there is no view at all to match against. */
-	view = get_matching_view_next(NULL, message->rdclass);
+	/*
+	 * Also no offloading when there is no view at all to match against,
+	 * or when the view selector rules them all out.
+	 */
+	if (named_g_server->viewselect != NULL) {
+		dns_viewselect_lookup(named_g_server->viewselect, srcaddr,
+				      destaddr, env, &match);
+		matchp = &match;
+	}
+	view = get_matching_view_next(NULL, &index, matchp, message->rdclass);
 	if (view == NULL) {
 		*viewmatchresult = ISC_R_NOTFOUND;
 		return (*viewmatchresult);
@@ -9924,7 +10849,13 @@ get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		.viewmatchresult = viewmatchresult,
 		.quota_result = ISC_R_UNSET,
 		.viewp = viewp,
+		.index = index,
 	};
+	if (matchp != NULL) {
+		dns_viewselect_attach(named_g_server->viewselect,
+				      &mvctx->viewselect);
+		mvctx->match = match;
+	}
 	ns_server_attach(sctx, &mvctx->sctx);
 	isc_loop_attach(loop, &mvctx->loop);
 	dns_message_attach(message, &mvctx->message);
@@ -9990,6 +10921,9 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 	ISC_LIST_INIT(server->keystorelist);
 	ISC_LIST_INIT(server->viewlist);
 
+	isc_mutex_init(&ns_catz_cbdata.lock);
+	ISC_LIST_INIT(ns_catz_cbdata.changes);
+
 	CHECKFATAL(dns_rootns_create(mctx, dns_rdataclass_in, NULL,
 				     &server->in_roothints),
 		   "setting up root hints");
@@ -10031,6 +10965,7 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 
 	isc_stats_create(named_g_mctx, &server->zonestats,
 			 dns_zonestatscounter_max);
+	dns_zonecounters_create(named_g_mctx, &server->zonecounters);
 
 	isc_stats_create(named_g_mctx, &server->resolverstats,
 			 dns_resstatscounter_max);
@@ -10060,7 +10995,10 @@ named_server_destroy(named_server_t **serverp) {
 
 	named_controls_destroy(&server->controls);
 
+	isc_mutex_destroy(&ns_catz_cbdata.lock);
+
 	isc_stats_detach(&server->zonestats);
+	dns_zonecounters_detach(&server->zonecounters);
 	isc_stats_detach(&server->sockstats);
 	isc_stats_detach(&server->resolverstats);
 
@@ -10792,6 +11730,7 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 	const cfg_obj_t *portobj = NULL;
 	const cfg_obj_t *http_server = NULL;
 	const cfg_obj_t *proxyobj = NULL;
+	const cfg_obj_t *batchobj = NULL;
 	in_port_t port = 0;
 	const char *key = NULL, *cert = NULL, *ca_file = NULL,
 		   *dhparam_file = NULL, *ciphers = NULL, *cipher_suites = NULL;
@@ -11023,6 +11962,11 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 					  &delt));
 	}
 
+	batchobj = cfg_tuple_get(ltup, "udp-recv-batch");
+	if (cfg_obj_isuint32(batchobj)) {
+		delt->udp_recv_batch = cfg_obj_asuint32(batchobj);
+	}
+
 	result = cfg_acl_fromconfig(cfg_tuple_get(listener, "acl"), config,
 				    actx, mctx, family, &delt->acl);
 	if (result != ISC_R_SUCCESS) {
@@ -11274,7 +12218,8 @@ resume:
 				dns_cache_getname(dctx->view->view->cache));
 			result = dns_master_dumptostreamasync(
 				dctx->mctx, dctx->cache, NULL, style, dctx->fp,
-				named_g_mainloop, dumpdone, dctx, &dctx->mdctx);
+				&dctx->filter, named_g_mainloop, dumpdone, dctx,
+				&dctx->mdctx);
 			if (result == ISC_R_SUCCESS) {
 				return;
 			}
@@ -11339,8 +12284,9 @@ resume:
 			dns_db_currentversion(dctx->db, &dctx->version);
 			result = dns_master_dumptostreamasync(
 				dctx->mctx, dctx->db, dctx->version, style,
-				dctx->fp, dns_zone_getloop(dctx->zone->zone),
-				dumpdone, dctx, &dctx->mdctx);
+				dctx->fp, NULL,
+				dns_zone_getloop(dctx->zone->zone), dumpdone,
+				dctx, &dctx->mdctx);
 			if (result == ISC_R_SUCCESS) {
 				return;
 			}
@@ -11378,134 +12324,475 @@ cleanup:
 	dumpcontext_destroy(dctx);
 }
 
-isc_result_t
-named_server_dumpdb(named_server_t *server, isc_lex_t *lex,
-		    isc_buffer_t **text) {
-	struct dumpcontext *dctx = NULL;
-	dns_view_t *view;
+/*
+ * Parse the "-name <name>" and "-type <type>" options of "rndc dumpdb",
+ * which restrict a cache dump to the names at or below <name> and to
+ * the RRsets of <type>.  '*ptrp' is the current token on entry, and
+ * the first one after the options on return.
+ */
+static isc_result_t
+dumpdb_filter(isc_lex_t *lex, char **ptrp, dns_fixedname_t *fixed,
+	      dns_dumpfilter_t *filter) {
+	char *ptr = *ptrp;
 	isc_result_t result;
-	char *ptr;
-	const char *sep;
-	bool found;
-
-	REQUIRE(text != NULL);
-
-	/* Skip the command name. */
-	ptr = next_token(lex, NULL);
-	if (ptr == NULL) {
-		return (ISC_R_UNEXPECTEDEND);
-	}
-
-	dctx = isc_mem_get(server->mctx, sizeof(*dctx));
-	*dctx = (struct dumpcontext){
-		.mctx = server->mctx,
-		.dumpcache = true,
-		.dumpadb = true,
-		.dumpbad = true,
-		.dumpfail = true,
-		.viewlist = ISC_LIST_INITIALIZER,
-	};
 
-	CHECKMF(isc_stdio_open(server->dumpfile, "w", &dctx->fp),
-		"could not open dump file", server->dumpfile);
-
-	ptr = next_token(lex, NULL);
-	sep = (ptr == NULL) ? "" : ": ";
-	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
-		      ISC_LOG_INFO, "dumpdb started%s%s", sep,
-		      (ptr != NULL) ? ptr : "");
+	while (ptr != NULL) {
+		if (strcmp(ptr, "-name") == 0) {
+			dns_name_t *name = dns_fixedname_initname(fixed);
 
-	if (ptr != NULL && strcmp(ptr, "-all") == 0) {
-		/* also dump zones */
-		dctx->dumpzones = true;
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-cache") == 0) {
-		/* this is the default */
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-expired") == 0) {
-		/* this is the same as -cache but includes expired data */
-		dctx->dumpexpired = true;
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-zones") == 0) {
-		/* only dump zones, suppress caches */
-		dctx->dumpadb = false;
-		dctx->dumpbad = false;
-		dctx->dumpcache = false;
-		dctx->dumpfail = false;
-		dctx->dumpzones = true;
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-adb") == 0) {
-		/* only dump adb, suppress other caches */
-		dctx->dumpbad = false;
-		dctx->dumpcache = false;
-		dctx->dumpfail = false;
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-bad") == 0) {
-		/* only dump badcache, suppress other caches */
-		dctx->dumpadb = false;
-		dctx->dumpcache = false;
-		dctx->dumpfail = false;
-		ptr = next_token(lex, NULL);
-	} else if (ptr != NULL && strcmp(ptr, "-fail") == 0) {
-		/* only dump servfail cache, suppress other caches */
-		dctx->dumpadb = false;
-		dctx->dumpbad = false;
-		dctx->dumpcache = false;
-		ptr = next_token(lex, NULL);
-	}
+			ptr = next_token(lex, NULL);
+			if (ptr == NULL) {
+				return (ISC_R_UNEXPECTEDEND);
+			}
+			result = dns_name_fromstring(name, ptr, dns_rootname,
+						     0, NULL);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+			filter->name = name;
+		} else if (strcmp(ptr, "-type") == 0) {
+			isc_textregion_t r;
 
-nextview:
-	found = false;
-	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
-	     view = ISC_LIST_NEXT(view, link))
-	{
-		if (ptr != NULL && strcmp(view->name, ptr) != 0) {
-			continue;
-		}
-		found = true;
-		CHECK(add_view_tolist(dctx, view));
-	}
-	if (ptr != NULL) {
-		if (!found) {
-			CHECK(putstr(text, "view '"));
-			CHECK(putstr(text, ptr));
-			CHECK(putstr(text, "' not found"));
-			CHECK(putnull(text));
-			result = ISC_R_NOTFOUND;
-			dumpdone(dctx, result);
-			return (result);
+			ptr = next_token(lex, NULL);
+			if (ptr == NULL) {
+				return (ISC_R_UNEXPECTEDEND);
+			}
+			r.base = ptr;
+			r.length = strlen(ptr);
+			result = dns_rdatatype_fromtext(&filter->type, &r);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+		} else {
+			break;
 		}
 		ptr = next_token(lex, NULL);
-		if (ptr != NULL) {
-			goto nextview;
-		}
 	}
-	dumpdone(dctx, ISC_R_SUCCESS);
+
+	*ptrp = ptr;
 	return (ISC_R_SUCCESS);
+}
 
-cleanup:
-	dumpcontext_destroy(dctx);
-	return (result);
+static void
+snapshotdump_done(void *arg, isc_result_t result) {
+	struct snapshotdump *sd = arg;
+
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO,
+			      "wrote cache snapshot '%s' for view %s",
+			      sd->filename, sd->viewname);
+	} else {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "could not write cache snapshot '%s' for view "
+			      "%s: %s",
+			      sd->filename, sd->viewname,
+			      isc_result_totext(result));
+	}
+
+	atomic_fetch_sub_release(&sd->server->snapshots_running, 1);
+	dns_dumpctx_detach(&sd->mdctx);
+	isc_mem_free(sd->mctx, sd->filename);
+	isc_mem_free(sd->mctx, sd->viewname);
+	isc_mem_putanddetach(&sd->mctx, sd, sizeof(*sd));
 }
 
-isc_result_t
-named_server_dumpsecroots(named_server_t *server, isc_lex_t *lex,
-			  isc_buffer_t **text) {
-	dns_view_t *view;
-	dns_keytable_t *secroots = NULL;
-	dns_ntatable_t *ntatable = NULL;
+/*
+ * Start writing the cache of 'view' to 'filename' on a worker thread.
+ */
+static isc_result_t
+snapshot_start(named_server_t *server, dns_view_t *view, const char *filename,
+	       const dns_dumpfilter_t *filter) {
+	struct snapshotdump *sd = NULL;
 	isc_result_t result;
-	char *ptr;
-	FILE *fp = NULL;
-	isc_time_t now;
-	char tbuf[64];
-	unsigned int used = isc_buffer_usedlength(*text);
-	bool first = true;
 
-	REQUIRE(text != NULL);
+	sd = isc_mem_get(server->mctx, sizeof(*sd));
+	*sd = (struct snapshotdump){
+		.server = server,
+		.filename = isc_mem_strdup(server->mctx, filename),
+		.viewname = isc_mem_strdup(server->mctx, view->name),
+	};
+	isc_mem_attach(server->mctx, &sd->mctx);
 
-	/* Skip the command name. */
-	ptr = next_token(lex, text);
+	atomic_fetch_add_relaxed(&server->snapshots_running, 1);
+	result = dns_cache_dumpasync(view->cache, filename, filter,
+				     named_g_mainloop, snapshotdump_done, sd,
+				     &sd->mdctx);
+	if (result != ISC_R_SUCCESS) {
+		atomic_fetch_sub_release(&server->snapshots_running, 1);
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "could not write cache snapshot '%s' for view "
+			      "%s: %s",
+			      filename, view->name, isc_result_totext(result));
+		isc_mem_free(sd->mctx, sd->filename);
+		isc_mem_free(sd->mctx, sd->viewname);
+		isc_mem_putanddetach(&sd->mctx, sd, sizeof(*sd));
+		return (result);
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_INFO, "writing cache snapshot '%s' for view %s",
+		      filename, view->name);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The file that the cache of 'view' is saved to, or NULL if it has
+ * none.  A shared cache is saved by the view that owns it.
+ */
+static const char *
+snapshot_filename(dns_view_t *view) {
+	if (view->cache == NULL || dns_view_iscacheshared(view)) {
+		return (NULL);
+	}
+	return (dns_cache_getfilename(view->cache));
+}
+
+static void
+snapshotimport_done(void *arg, isc_result_t result) {
+	struct snapshotimport *si = arg;
+
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_DEBUG(1),
+			      "imported cache snapshot '%s' for view %s",
+			      si->filename, si->viewname);
+	} else {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_WARNING,
+			      "could not import cache snapshot '%s' for view "
+			      "%s: %s",
+			      si->filename, si->viewname,
+			      isc_result_totext(result));
+	}
+
+	atomic_fetch_sub_release(&si->server->snapshots_running, 1);
+	isc_mem_free(si->mctx, si->filename);
+	isc_mem_free(si->mctx, si->viewname);
+	isc_mem_putanddetach(&si->mctx, si, sizeof(*si));
+}
+
+/*
+ * Start adding the snapshot of another named process in 'filename' to
+ * the cache of 'view' on a worker thread.
+ */
+static void
+snapshot_import(named_server_t *server, dns_view_t *view,
+		const char *filename) {
+	struct snapshotimport *si = NULL;
+	isc_result_t result;
+
+	si = isc_mem_get(server->mctx, sizeof(*si));
+	*si = (struct snapshotimport){
+		.server = server,
+		.filename = isc_mem_strdup(server->mctx, filename),
+		.viewname = isc_mem_strdup(server->mctx, view->name),
+	};
+	isc_mem_attach(server->mctx, &si->mctx);
+
+	atomic_fetch_add_relaxed(&server->snapshots_running, 1);
+	result = dns_cache_loadasync(view->cache, filename, named_g_mainloop,
+				     snapshotimport_done, si);
+	if (result != ISC_R_SUCCESS) {
+		atomic_fetch_sub_release(&server->snapshots_running, 1);
+		if (result != ISC_R_FILENOTFOUND) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+				      "could not import cache snapshot '%s' "
+				      "for view %s: %s",
+				      filename, view->name,
+				      isc_result_totext(result));
+		}
+		isc_mem_free(si->mctx, si->filename);
+		isc_mem_free(si->mctx, si->viewname);
+		isc_mem_putanddetach(&si->mctx, si, sizeof(*si));
+	}
+}
+
+/*
+ * Write the snapshots of all views periodically, so that a restart
+ * after a crash starts with a cache that is at most
+ * "cache-snapshot-interval" old, and import the snapshots that the
+ * other named processes listed in "cache-snapshot-import" have
+ * written, so that each process benefits from what the others have
+ * resolved.
+ */
+static void
+snapshot_timer_tick(void *arg) {
+	named_server_t *server = (named_server_t *)arg;
+
+	if (atomic_load_acquire(&server->snapshots_running) != 0) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_DEBUG(1),
+			      "cache snapshots still being written, "
+			      "skipping this interval");
+		return;
+	}
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		const char *filename = snapshot_filename(view);
+		if (filename != NULL) {
+			(void)snapshot_start(server, view, filename, NULL);
+		}
+	}
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		const char *filename = NULL;
+
+		if (view->cache == NULL || dns_view_iscacheshared(view)) {
+			continue;
+		}
+		for (size_t i = 0;
+		     (filename = dns_cache_getimport(view->cache, i)) != NULL;
+		     i++)
+		{
+			snapshot_import(server, view, filename);
+		}
+	}
+}
+
+/*
+ * Write the snapshots of all views before shutting down, so that the
+ * next named process, possibly a newer version, starts warm.  The
+ * loops are paused, so the snapshots are written synchronously.
+ */
+static void
+snapshot_saveall(named_server_t *server) {
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		const char *filename = snapshot_filename(view);
+		isc_result_t result;
+
+		if (filename == NULL) {
+			continue;
+		}
+
+		result = dns_cache_dump(view->cache, filename);
+		if (result == ISC_R_SUCCESS) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+				      "wrote cache snapshot '%s' for view %s",
+				      filename, view->name);
+		} else {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "could not write cache snapshot '%s' "
+				      "for view %s: %s",
+				      filename, view->name,
+				      isc_result_totext(result));
+		}
+	}
+}
+
+/*
+ * Write the cache of each of the given views (or of all views) to its
+ * "cache-snapshot-file" in the raw format, for "rndc dumpdb -binary".
+ * The snapshots are written on worker threads, so this returns once
+ * they have been started.
+ */
+static isc_result_t
+dumpdb_binary(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
+	dns_view_t *view;
+	isc_result_t result = ISC_R_SUCCESS;
+	char *ptr;
+	bool found;
+	unsigned int dumped = 0;
+	dns_fixedname_t fixed;
+	dns_dumpfilter_t filter = { 0 };
+
+	ptr = next_token(lex, NULL);
+	CHECK(dumpdb_filter(lex, &ptr, &fixed, &filter));
+	do {
+		found = false;
+		for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+		     view = ISC_LIST_NEXT(view, link))
+		{
+			const char *filename = NULL;
+
+			if (ptr != NULL && strcmp(view->name, ptr) != 0) {
+				continue;
+			}
+			found = true;
+
+			filename = snapshot_filename(view);
+			if (filename == NULL) {
+				continue;
+			}
+
+			result = snapshot_start(server, view, filename,
+						&filter);
+			if (result != ISC_R_SUCCESS) {
+				CHECK(putstr(text, "could not write '"));
+				CHECK(putstr(text, filename));
+				CHECK(putstr(text, "': "));
+				CHECK(putstr(text, isc_result_totext(result)));
+				CHECK(putnull(text));
+				return (result);
+			}
+			dumped++;
+		}
+		if (ptr != NULL) {
+			if (!found) {
+				CHECK(putstr(text, "view '"));
+				CHECK(putstr(text, ptr));
+				CHECK(putstr(text, "' not found"));
+				CHECK(putnull(text));
+				return (ISC_R_NOTFOUND);
+			}
+			ptr = next_token(lex, NULL);
+		}
+	} while (ptr != NULL);
+
+	if (dumped == 0) {
+		CHECK(putstr(text, "no cache-snapshot-file configured"));
+		CHECK(putnull(text));
+	}
+
+cleanup:
+	return (result);
+}
+
+isc_result_t
+named_server_dumpdb(named_server_t *server, isc_lex_t *lex,
+		    isc_buffer_t **text) {
+	struct dumpcontext *dctx = NULL;
+	dns_view_t *view;
+	isc_result_t result;
+	char *ptr;
+	const char *sep;
+	bool found;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, NULL);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	ptr = next_token(lex, NULL);
+	if (ptr != NULL && strcmp(ptr, "-binary") == 0) {
+		return (dumpdb_binary(server, lex, text));
+	}
+
+	dctx = isc_mem_get(server->mctx, sizeof(*dctx));
+	*dctx = (struct dumpcontext){
+		.mctx = server->mctx,
+		.dumpcache = true,
+		.dumpadb = true,
+		.dumpbad = true,
+		.dumpfail = true,
+		.viewlist = ISC_LIST_INITIALIZER,
+	};
+
+	CHECKMF(isc_stdio_open(server->dumpfile, "w", &dctx->fp),
+		"could not open dump file", server->dumpfile);
+
+	sep = (ptr == NULL) ? "" : ": ";
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_INFO, "dumpdb started%s%s", sep,
+		      (ptr != NULL) ? ptr : "");
+
+	if (ptr != NULL && strcmp(ptr, "-all") == 0) {
+		/* also dump zones */
+		dctx->dumpzones = true;
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-cache") == 0) {
+		/* this is the default */
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-expired") == 0) {
+		/* this is the same as -cache but includes expired data */
+		dctx->dumpexpired = true;
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-zones") == 0) {
+		/* only dump zones, suppress caches */
+		dctx->dumpadb = false;
+		dctx->dumpbad = false;
+		dctx->dumpcache = false;
+		dctx->dumpfail = false;
+		dctx->dumpzones = true;
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-adb") == 0) {
+		/* only dump adb, suppress other caches */
+		dctx->dumpbad = false;
+		dctx->dumpcache = false;
+		dctx->dumpfail = false;
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-bad") == 0) {
+		/* only dump badcache, suppress other caches */
+		dctx->dumpadb = false;
+		dctx->dumpcache = false;
+		dctx->dumpfail = false;
+		ptr = next_token(lex, NULL);
+	} else if (ptr != NULL && strcmp(ptr, "-fail") == 0) {
+		/* only dump servfail cache, suppress other caches */
+		dctx->dumpadb = false;
+		dctx->dumpbad = false;
+		dctx->dumpcache = false;
+		ptr = next_token(lex, NULL);
+	}
+
+	CHECK(dumpdb_filter(lex, &ptr, &dctx->filtername, &dctx->filter));
+
+nextview:
+	found = false;
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (ptr != NULL && strcmp(view->name, ptr) != 0) {
+			continue;
+		}
+		found = true;
+		CHECK(add_view_tolist(dctx, view));
+	}
+	if (ptr != NULL) {
+		if (!found) {
+			CHECK(putstr(text, "view '"));
+			CHECK(putstr(text, ptr));
+			CHECK(putstr(text, "' not found"));
+			CHECK(putnull(text));
+			result = ISC_R_NOTFOUND;
+			dumpdone(dctx, result);
+			return (result);
+		}
+		ptr = next_token(lex, NULL);
+		if (ptr != NULL) {
+			goto nextview;
+		}
+	}
+	dumpdone(dctx, ISC_R_SUCCESS);
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	dumpcontext_destroy(dctx);
+	return (result);
+}
+
+isc_result_t
+named_server_dumpsecroots(named_server_t *server, isc_lex_t *lex,
+			  isc_buffer_t **text) {
+	dns_view_t *view;
+	dns_keytable_t *secroots = NULL;
+	dns_ntatable_t *ntatable = NULL;
+	isc_result_t result;
+	char *ptr;
+	FILE *fp = NULL;
+	isc_time_t now;
+	char tbuf[64];
+	unsigned int used = isc_buffer_usedlength(*text);
+	bool first = true;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
 	if (ptr == NULL) {
 		return (ISC_R_UNEXPECTEDEND);
 	}
@@ -12068,6 +13355,28 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 	snprintf(line, sizeof(line), "worker threads: %u\n", named_g_cpus);
 	CHECK(putstr(text, line));
 
+	if (server->maintthreads > 0) {
+		snprintf(line, sizeof(line),
+			 "zone maintenance threads: %u (of %u)\n",
+			 server->maintthreads, named_g_cpus);
+		CHECK(putstr(text, line));
+	}
+
+	if (isc_loopmgr_getaffinity(named_g_loopmgr)) {
+		CHECK(putstr(text, "worker thread CPUs:"));
+		for (uint32_t i = 0; i < isc_loopmgr_nloops(named_g_loopmgr);
+		     i++)
+		{
+			isc_loop_t *loop = isc_loop_get(named_g_loopmgr, i);
+			snprintf(line, sizeof(line), " %u:%d", i,
+				 isc_loop_getcpu(loop));
+			CHECK(putstr(text, line));
+		}
+		snprintf(line, sizeof(line), " (udp steering %s)\n",
+			 isc_nm_getcpusteering(named_g_netmgr) ? "on" : "off");
+		CHECK(putstr(text, line));
+	}
+
 	snprintf(line, sizeof(line), "number of zones: %u (%u automatic)\n",
 		 zonecount, automatic);
 	CHECK(putstr(text, line));
@@ -12658,13 +13967,17 @@ dumpzone(void *arg, const char *buf, int len) {
 	}
 }
 
+/*
+ * Store the configuration of 'zone' in the open transaction 'txn', or
+ * remove it if 'zconfig' is NULL.  '*changedp' is set to true if the
+ * database was changed, so the transaction needs to be committed.
+ */
 static isc_result_t
-nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
-	 const cfg_obj_t *zconfig) {
+nzd_put(MDB_txn *txn, MDB_dbi dbi, dns_zone_t *zone, const cfg_obj_t *zconfig,
+	bool *changedp) {
 	isc_result_t result;
 	int status;
 	dns_view_t *view;
-	bool commit = false;
 	isc_buffer_t *text = NULL;
 	char namebuf[1024];
 	MDB_val key, data;
@@ -12676,7 +13989,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 
 	if (zconfig == NULL) {
 		/* We're deleting the zone from the database */
-		status = mdb_del(*txnp, dbi, &key, NULL);
+		status = mdb_del(txn, dbi, &key, NULL);
 		if (status != MDB_SUCCESS && status != MDB_NOTFOUND) {
 			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -12686,7 +13999,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		} else if (status != MDB_NOTFOUND) {
-			commit = true;
+			*changedp = true;
 		}
 	} else {
 		/* We're creating or overwriting the zone */
@@ -12721,7 +14034,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 		data.mv_data = isc_buffer_base(text);
 		data.mv_size = isc_buffer_usedlength(text);
 
-		status = mdb_put(*txnp, dbi, &key, &data, 0);
+		status = mdb_put(txn, dbi, &key, &data, 0);
 		if (status != MDB_SUCCESS) {
 			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -12732,16 +14045,30 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			goto cleanup;
 		}
 
-		commit = true;
+		*changedp = true;
 	}
 
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (text != NULL) {
+		isc_buffer_free(&text);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
+	 const cfg_obj_t *zconfig) {
+	isc_result_t result;
+	bool commit = false;
+
+	result = nzd_put(*txnp, dbi, zone, zconfig, &commit);
 	if (!commit || result != ISC_R_SUCCESS) {
 		(void)mdb_txn_abort(*txnp);
 	} else {
-		status = mdb_txn_commit(*txnp);
+		int status = mdb_txn_commit(*txnp);
 		if (status != MDB_SUCCESS) {
 			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -12753,10 +14080,6 @@ cleanup:
 	}
 	*txnp = NULL;
 
-	if (text != NULL) {
-		isc_buffer_free(&text);
-	}
-
 	return (result);
 }
 
@@ -13116,6 +14439,80 @@ cleanup:
 }
 #endif /* HAVE_LMDB */
 
+/*
+ * Check that the zone configured by 'zoneobj' can be added by the
+ * command 'bn', and find the view it belongs to.
+ */
+static isc_result_t
+newzone_check(named_server_t *server, const cfg_obj_t *zoneobj, const char *bn,
+	      dns_view_t **viewp, bool *redirectp, isc_buffer_t **text) {
+	isc_result_t result;
+	bool redirect = false;
+	const cfg_obj_t *zoptions = NULL;
+	const cfg_obj_t *obj = NULL;
+	const char *viewname = NULL;
+	dns_rdataclass_t rdclass;
+
+	REQUIRE(viewp != NULL && *viewp == NULL);
+
+	/* Check the zone type for ones that are not supported by addzone. */
+	zoptions = cfg_tuple_get(zoneobj, "options");
+
+	obj = NULL;
+	(void)cfg_map_get(zoptions, "type", &obj);
+	if (obj == NULL) {
+		(void)cfg_map_get(zoptions, "in-view", &obj);
+		if (obj != NULL) {
+			(void)putstr(text, "'in-view' zones not supported by ");
+			(void)putstr(text, bn);
+		} else {
+			(void)putstr(text, "zone type not specified");
+		}
+		CHECK(ISC_R_FAILURE);
+	}
+
+	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
+	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0)
+	{
+		(void)putstr(text, "'");
+		(void)putstr(text, cfg_obj_asstring(obj));
+		(void)putstr(text, "' zones not supported by ");
+		(void)putstr(text, bn);
+		CHECK(ISC_R_FAILURE);
+	}
+
+	if (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0) {
+		redirect = true;
+	}
+
+	/* Make sense of optional class argument */
+	obj = cfg_tuple_get(zoneobj, "class");
+	CHECK(named_config_getclass(obj, dns_rdataclass_in, &rdclass));
+
+	/* Make sense of optional view argument */
+	obj = cfg_tuple_get(zoneobj, "view");
+	if (obj && cfg_obj_isstring(obj)) {
+		viewname = cfg_obj_asstring(obj);
+	}
+	if (viewname == NULL || *viewname == '\0') {
+		viewname = "_default";
+	}
+	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, viewp);
+	if (result == ISC_R_NOTFOUND) {
+		(void)putstr(text, "no matching view found for '");
+		(void)putstr(text, viewname);
+		(void)putstr(text, "'");
+		goto cleanup;
+	} else if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	*redirectp = redirect;
+
+cleanup:
+	return (result);
+}
+
 static isc_result_t
 newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
@@ -13126,10 +14523,6 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	cfg_obj_t *zoneconf = NULL;
 	const cfg_obj_t *zlist = NULL;
 	const cfg_obj_t *zoneobj = NULL;
-	const cfg_obj_t *zoptions = NULL;
-	const cfg_obj_t *obj = NULL;
-	const char *viewname = NULL;
-	dns_rdataclass_t rdclass;
 	dns_view_t *view = NULL;
 	const char *bn = NULL;
 
@@ -13147,77 +14540,27 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	} else if (strncasecmp(command, "mod", 3) == 0) {
 		bn = "modzone";
 	} else {
-		UNREACHABLE();
-	}
-
-	/*
-	 * Convert the "addzone" or "modzone" to just "zone", for
-	 * the benefit of the parser
-	 */
-	isc_buffer_forward(&argbuf, 3);
-
-	cfg_parser_reset(named_g_addparser);
-	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
-			       &cfg_type_addzoneconf, 0, &zoneconf));
-	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
-	if (!cfg_obj_islist(zlist)) {
-		CHECK(ISC_R_FAILURE);
-	}
-
-	/* For now we only support adding one zone at a time */
-	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
-
-	/* Check the zone type for ones that are not supported by addzone. */
-	zoptions = cfg_tuple_get(zoneobj, "options");
-
-	obj = NULL;
-	(void)cfg_map_get(zoptions, "type", &obj);
-	if (obj == NULL) {
-		(void)cfg_map_get(zoptions, "in-view", &obj);
-		if (obj != NULL) {
-			(void)putstr(text, "'in-view' zones not supported by ");
-			(void)putstr(text, bn);
-		} else {
-			(void)putstr(text, "zone type not specified");
-		}
-		CHECK(ISC_R_FAILURE);
+		UNREACHABLE();
 	}
 
-	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
-	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0)
-	{
-		(void)putstr(text, "'");
-		(void)putstr(text, cfg_obj_asstring(obj));
-		(void)putstr(text, "' zones not supported by ");
-		(void)putstr(text, bn);
-		CHECK(ISC_R_FAILURE);
-	}
+	/*
+	 * Convert the "addzone" or "modzone" to just "zone", for
+	 * the benefit of the parser
+	 */
+	isc_buffer_forward(&argbuf, 3);
 
-	if (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0) {
-		redirect = true;
+	cfg_parser_reset(named_g_addparser);
+	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
+			       &cfg_type_addzoneconf, 0, &zoneconf));
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	if (!cfg_obj_islist(zlist)) {
+		CHECK(ISC_R_FAILURE);
 	}
 
-	/* Make sense of optional class argument */
-	obj = cfg_tuple_get(zoneobj, "class");
-	CHECK(named_config_getclass(obj, dns_rdataclass_in, &rdclass));
+	/* For now we only support adding one zone at a time */
+	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 
-	/* Make sense of optional view argument */
-	obj = cfg_tuple_get(zoneobj, "view");
-	if (obj && cfg_obj_isstring(obj)) {
-		viewname = cfg_obj_asstring(obj);
-	}
-	if (viewname == NULL || *viewname == '\0') {
-		viewname = "_default";
-	}
-	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, &view);
-	if (result == ISC_R_NOTFOUND) {
-		(void)putstr(text, "no matching view found for '");
-		(void)putstr(text, viewname);
-		(void)putstr(text, "'");
-		goto cleanup;
-	} else if (result != ISC_R_SUCCESS) {
-		goto cleanup;
-	}
+	CHECK(newzone_check(server, zoneobj, bn, &view, &redirect, text));
 
 	*viewp = view;
 	*zoneobjp = zoneobj;
@@ -13682,109 +15025,509 @@ cleanup:
 	if (txn != NULL) {
 		(void)nzd_close(&txn, false);
 	}
-	if (locked) {
-		UNLOCK(&view->new_zone_lock);
+	if (locked) {
+		UNLOCK(&view->new_zone_lock);
+	}
+#endif /* HAVE_LMDB */
+
+	if (zone != NULL) {
+		dns_zone_detach(&zone);
+	}
+
+	return (result);
+}
+
+/*
+ * Act on an "addzone" or "modzone" command from the command channel.
+ */
+isc_result_t
+named_server_changezone(named_server_t *server, char *command,
+			isc_buffer_t **text) {
+	isc_result_t result;
+	bool addzone;
+	bool redirect = false;
+	ns_cfgctx_t *cfg = NULL;
+	cfg_obj_t *zoneconf = NULL;
+	const cfg_obj_t *zoneobj = NULL;
+	const char *zonename;
+	dns_view_t *view = NULL;
+	isc_buffer_t buf;
+	dns_fixedname_t fname;
+	dns_name_t *dnsname;
+
+	REQUIRE(text != NULL);
+
+	if (strncasecmp(command, "add", 3) == 0) {
+		addzone = true;
+	} else {
+		INSIST(strncasecmp(command, "mod", 3) == 0);
+		addzone = false;
+	}
+
+	CHECK(newzone_parse(server, command, &view, &zoneconf, &zoneobj,
+			    &redirect, text));
+
+	/* Are we accepting new zones in this view? */
+#ifdef HAVE_LMDB
+	if (view->new_zone_db == NULL)
+#else  /* ifdef HAVE_LMDB */
+	if (view->new_zone_file == NULL)
+#endif /* HAVE_LMDB */
+	{
+		(void)putstr(text, "Not allowing new zones in view '");
+		(void)putstr(text, view->name);
+		(void)putstr(text, "'");
+		result = ISC_R_NOPERM;
+		goto cleanup;
+	}
+
+	cfg = (ns_cfgctx_t *)view->new_zone_config;
+	if (cfg == NULL) {
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+	isc_buffer_constinit(&buf, zonename, strlen(zonename));
+	isc_buffer_add(&buf, strlen(zonename));
+
+	dnsname = dns_fixedname_initname(&fname);
+	CHECK(dns_name_fromtext(dnsname, &buf, dns_rootname, 0, NULL));
+
+	if (redirect) {
+		if (!dns_name_equal(dnsname, dns_rootname)) {
+			(void)putstr(text, "redirect zones must be called "
+					   "\".\"");
+			CHECK(ISC_R_FAILURE);
+		}
+	}
+
+	if (addzone) {
+		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf, zoneobj,
+				 redirect, text));
+	} else {
+		CHECK(do_modzone(server, cfg, view, dnsname, zonename, zoneobj,
+				 redirect, text));
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_INFO, "%s zone %s in view %s via %s",
+		      addzone ? "added" : "updated", zonename, view->name,
+		      addzone ? NAMED_COMMAND_ADDZONE : NAMED_COMMAND_MODZONE);
+
+	/* Changing a zone counts as reconfiguration */
+	named_g_configtime = isc_time_now();
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+	if (zoneconf != NULL) {
+		cfg_obj_destroy(named_g_addparser, &zoneconf);
+	}
+	if (view != NULL) {
+		dns_view_detach(&view);
+	}
+
+	return (result);
+}
+
+typedef struct {
+	const cfg_obj_t *zoneobj;
+	dns_view_t *view;
+	dns_fixedname_t fname;
+	dns_zone_t *zone;
+} ns_addzone_t;
+
+static int
+addzone_cmp(const void *a, const void *b) {
+	uintptr_t va = (uintptr_t)(*(ns_addzone_t *const *)a)->view;
+	uintptr_t vb = (uintptr_t)(*(ns_addzone_t *const *)b)->view;
+
+	return ((va > vb) - (va < vb));
+}
+
+/*
+ * Check that the zone configured in 'az->zoneobj' can be added, and find
+ * the view it is to be added to.
+ */
+static isc_result_t
+addzones_check(named_server_t *server, ns_addzone_t *az, isc_buffer_t **text) {
+	isc_result_t result;
+	bool redirect = false;
+	dns_zone_t *zone = NULL;
+	dns_name_t *name = dns_fixedname_initname(&az->fname);
+	const char *zonename;
+
+	CHECK(newzone_check(server, az->zoneobj, NAMED_COMMAND_ADDZONES,
+			    &az->view, &redirect, text));
+	if (redirect) {
+		(void)putstr(text, "'redirect' zones not supported by ");
+		(void)putstr(text, NAMED_COMMAND_ADDZONES);
+		CHECK(ISC_R_FAILURE);
+	}
+
+	/* Are we accepting new zones in this view? */
+#ifdef HAVE_LMDB
+	if (az->view->new_zone_db == NULL)
+#else  /* ifdef HAVE_LMDB */
+	if (az->view->new_zone_file == NULL)
+#endif /* HAVE_LMDB */
+	{
+		(void)putstr(text, "Not allowing new zones in view '");
+		(void)putstr(text, az->view->name);
+		(void)putstr(text, "'");
+		CHECK(ISC_R_NOPERM);
+	}
+
+	if (az->view->new_zone_config == NULL) {
+		CHECK(ISC_R_FAILURE);
+	}
+
+	zonename = cfg_obj_asstring(cfg_tuple_get(az->zoneobj, "name"));
+	CHECK(dns_name_fromstring(name, zonename, dns_rootname, 0, NULL));
+
+	/* Zone shouldn't already exist */
+	result = dns_view_findzone(az->view, name, DNS_ZTFIND_EXACT, &zone);
+	if (result == ISC_R_SUCCESS) {
+		dns_zone_detach(&zone);
+		result = ISC_R_EXISTS;
+	} else if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	return (result);
+}
+
+/*
+ * Configure the 'n' zones in 'zones', which all belong to the same view.
+ * The configured zones are flagged as added at runtime and kept in
+ * 'zones[i]->zone'.
+ *
+ * The caller must have paused the loops.
+ */
+static isc_result_t
+addzones_configure(named_server_t *server, ns_addzone_t **zones, size_t n,
+		   isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_view_t *view = zones[0]->view;
+	ns_cfgctx_t *cfg = view->new_zone_config;
+
+	/* Mark view unfrozen and configure the zones */
+	dns_view_thaw(view);
+	for (size_t i = 0; i < n; i++) {
+		ns_addzone_t *az = zones[i];
+
+		result = configure_zone(cfg->config, az->zoneobj, cfg->vconfig,
+					view, &server->viewlist,
+					&server->kasplist,
+					&server->keystorelist, cfg->actx,
+					true, false, false, false);
+		if (result != ISC_R_SUCCESS) {
+			(void)putstr(text, "configure_zone failed: ");
+			(void)putstr(text, isc_result_totext(result));
+			break;
+		}
+
+		/* Is it there yet? */
+		result = dns_view_findzone(view, dns_fixedname_name(&az->fname),
+					   DNS_ZTFIND_EXACT, &az->zone);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "added new zone was not found: %s",
+				      isc_result_totext(result));
+			break;
+		}
+
+		/* Flag the zone as having been added at runtime */
+		dns_zone_setadded(az->zone, true);
+	}
+	dns_view_freeze(view);
+
+	return (result);
+}
+
+/*
+ * Save the configuration of the 'n' zones in 'zones', which all belong
+ * to the same view, in one NZD transaction or one rewrite of the NZF.
+ */
+static isc_result_t
+addzones_save(ns_addzone_t **zones, size_t n, isc_buffer_t **text) {
+	isc_result_t result;
+	dns_view_t *view = zones[0]->view;
+#ifdef HAVE_LMDB
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+	bool commit = false;
+
+	LOCK(&view->new_zone_lock);
+	result = nzd_open(view, 0, &txn, &dbi);
+	if (result != ISC_R_SUCCESS) {
+		(void)putstr(text, "unable to open NZD database for '");
+		(void)putstr(text, view->new_zone_db);
+		(void)putstr(text, "'");
+		goto cleanup;
+	}
+	for (size_t i = 0; i < n; i++) {
+		CHECK(nzd_put(txn, dbi, zones[i]->zone, zones[i]->zoneobj,
+			      &commit));
+	}
+	result = nzd_close(&txn, commit);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR, "Error committing NZD database");
+	}
+
+cleanup:
+	if (txn != NULL) {
+		(void)nzd_close(&txn, false);
+	}
+	UNLOCK(&view->new_zone_lock);
+#else  /* HAVE_LMDB */
+	ns_cfgctx_t *cfg = view->new_zone_config;
+	size_t added = 0;
+
+	/*
+	 * Merge the new zones into the previous newzone config, creating
+	 * an empty one if there wasn't any, and write it out in one go.
+	 */
+	if (cfg->nzf_config == NULL) {
+		isc_buffer_t empty;
+
+		isc_buffer_constinit(&empty, "", 0);
+		CHECK(cfg_parse_buffer(cfg->add_parser, &empty,
+				       NAMED_COMMAND_ADDZONES, 0,
+				       &cfg_type_addzoneconf, 0,
+				       &cfg->nzf_config));
+	}
+	for (added = 0; added < n; added++) {
+		cfg_obj_t *z = UNCONST(zones[added]->zoneobj);
+		CHECK(cfg_parser_mapadd(cfg->add_parser, cfg->nzf_config, z,
+					"zone"));
+	}
+
+	LOCK(&view->new_zone_lock);
+	result = nzf_writeconf(cfg->nzf_config, view);
+	UNLOCK(&view->new_zone_lock);
+	if (result != ISC_R_SUCCESS) {
+		(void)putstr(text, "unable to write '");
+		(void)putstr(text, view->new_zone_file);
+		(void)putstr(text, "': ");
+		(void)putstr(text, isc_result_totext(result));
 	}
-#endif /* HAVE_LMDB */
 
-	if (zone != NULL) {
-		dns_zone_detach(&zone);
+cleanup:
+	if (result != ISC_R_SUCCESS) {
+		while (added-- > 0) {
+			isc_result_t tresult = delete_zoneconf(
+				view, cfg->add_parser, cfg->nzf_config,
+				dns_fixedname_name(&zones[added]->fname), NULL);
+			RUNTIME_CHECK(tresult == ISC_R_SUCCESS);
+		}
 	}
+#endif /* HAVE_LMDB */
 
 	return (result);
 }
 
 /*
- * Act on an "addzone" or "modzone" command from the command channel.
+ * Act on an "addzones" command from the command channel: add all the
+ * zones configured in a file.  The loops are paused only once for all of
+ * the zones, the new zone configuration is saved once per view, and the
+ * zones are loaded in the background through the zone manager.
+ *
+ * Nothing is added if any of the zones cannot be configured.
  */
 isc_result_t
-named_server_changezone(named_server_t *server, char *command,
-			isc_buffer_t **text) {
+named_server_addzones(named_server_t *server, isc_lex_t *lex,
+		      isc_buffer_t **text) {
 	isc_result_t result;
-	bool addzone;
-	bool redirect = false;
-	ns_cfgctx_t *cfg = NULL;
 	cfg_obj_t *zoneconf = NULL;
-	const cfg_obj_t *zoneobj = NULL;
-	const char *zonename;
-	dns_view_t *view = NULL;
-	isc_buffer_t buf;
-	dns_fixedname_t fname;
-	dns_name_t *dnsname;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *elt = NULL;
+	ns_addzone_t *zones = NULL;
+	ns_addzone_t **order = NULL;
+	size_t nzones = 0, saved = 0, i;
+	const char *ptr = NULL;
+	char zonesfile[PATH_MAX];
+	char buf[100];
 
 	REQUIRE(text != NULL);
 
-	if (strncasecmp(command, "add", 3) == 0) {
-		addzone = true;
-	} else {
-		INSIST(strncasecmp(command, "mod", 3) == 0);
-		addzone = false;
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
 	}
 
-	CHECK(newzone_parse(server, command, &view, &zoneconf, &zoneobj,
-			    &redirect, text));
+	ptr = next_token(lex, NULL);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+	(void)snprintf(zonesfile, sizeof(zonesfile), "%s", ptr);
 
-	/* Are we accepting new zones in this view? */
-#ifdef HAVE_LMDB
-	if (view->new_zone_db == NULL)
-#else  /* ifdef HAVE_LMDB */
-	if (view->new_zone_file == NULL)
-#endif /* HAVE_LMDB */
-	{
-		(void)putstr(text, "Not allowing new zones in view '");
-		(void)putstr(text, view->name);
-		(void)putstr(text, "'");
-		result = ISC_R_NOPERM;
+	cfg_parser_reset(named_g_addparser);
+	result = cfg_parse_file(named_g_addparser, zonesfile,
+				&cfg_type_addzoneconf, &zoneconf);
+	if (result != ISC_R_SUCCESS) {
+		(void)putstr(text, "unable to load '");
+		(void)putstr(text, zonesfile);
+		(void)putstr(text, "': ");
+		(void)putstr(text, isc_result_totext(result));
 		goto cleanup;
 	}
 
-	cfg = (ns_cfgctx_t *)view->new_zone_config;
-	if (cfg == NULL) {
-		result = ISC_R_FAILURE;
-		goto cleanup;
+	(void)cfg_map_get(zoneconf, "zone", &zlist);
+	if (!cfg_obj_islist(zlist)) {
+		(void)putstr(text, "no zones found in '");
+		(void)putstr(text, zonesfile);
+		(void)putstr(text, "'");
+		CHECK(ISC_R_NOTFOUND);
 	}
 
-	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
-	isc_buffer_constinit(&buf, zonename, strlen(zonename));
-	isc_buffer_add(&buf, strlen(zonename));
+	for (elt = cfg_list_first(zlist); elt != NULL;
+	     elt = cfg_list_next(elt))
+	{
+		nzones++;
+	}
+	zones = isc_mem_cget(server->mctx, nzones, sizeof(zones[0]));
+	order = isc_mem_cget(server->mctx, nzones, sizeof(order[0]));
 
-	dnsname = dns_fixedname_initname(&fname);
-	CHECK(dns_name_fromtext(dnsname, &buf, dns_rootname, 0, NULL));
+	i = 0;
+	for (elt = cfg_list_first(zlist); elt != NULL;
+	     elt = cfg_list_next(elt))
+	{
+		ns_addzone_t *az = &zones[i];
 
-	if (redirect) {
-		if (!dns_name_equal(dnsname, dns_rootname)) {
-			(void)putstr(text, "redirect zones must be called "
-					   "\".\"");
-			CHECK(ISC_R_FAILURE);
+		order[i++] = az;
+		az->zoneobj = cfg_listelt_value(elt);
+		result = addzones_check(server, az, text);
+		if (result != ISC_R_SUCCESS) {
+			const char *zonename = cfg_obj_asstring(
+				cfg_tuple_get(az->zoneobj, "name"));
+
+			if (isc_buffer_usedlength(*text) > 0) {
+				(void)putstr(text, " (zone '");
+				(void)putstr(text, zonename);
+				(void)putstr(text, "')");
+			} else {
+				(void)putstr(text, "zone '");
+				(void)putstr(text, zonename);
+				(void)putstr(text, "': ");
+				(void)putstr(text, isc_result_totext(result));
+			}
+			goto cleanup;
 		}
 	}
 
-	if (addzone) {
-		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf, zoneobj,
-				 redirect, text));
-	} else {
-		CHECK(do_modzone(server, cfg, view, dnsname, zonename, zoneobj,
-				 redirect, text));
+	/*
+	 * Group the zones by view, so that each view is thawed and its
+	 * new zone configuration is saved only once.
+	 */
+	qsort(order, nzones, sizeof(order[0]), addzone_cmp);
+
+	isc_loopmgr_pause(named_g_loopmgr);
+	for (i = 0; i < nzones && result == ISC_R_SUCCESS;) {
+		size_t n = 1;
+
+		while (i + n < nzones && order[i + n]->view == order[i]->view) {
+			n++;
+		}
+#ifdef HAVE_LMDB
+		/* Make sure we can open the NZD database */
+		LOCK(&order[i]->view->new_zone_lock);
+		result = nzd_writable(order[i]->view);
+		UNLOCK(&order[i]->view->new_zone_lock);
+		if (result != ISC_R_SUCCESS) {
+			(void)putstr(text, "unable to open NZD database for '");
+			(void)putstr(text, order[i]->view->new_zone_db);
+			(void)putstr(text, "'");
+			result = ISC_R_FAILURE;
+			break;
+		}
+#endif /* HAVE_LMDB */
+		result = addzones_configure(server, &order[i], n, text);
+		i += n;
 	}
+	isc_loopmgr_resume(named_g_loopmgr);
 
-	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
-		      ISC_LOG_INFO, "%s zone %s in view %s via %s",
-		      addzone ? "added" : "updated", zonename, view->name,
-		      addzone ? NAMED_COMMAND_ADDZONE : NAMED_COMMAND_MODZONE);
+	/*
+	 * Save the new zone configuration view by view, unless some zone
+	 * could not be configured.  If saving fails for a view, its zones
+	 * are removed again below, together with those of the views that
+	 * were not saved yet.
+	 */
+	for (i = 0; i < nzones && result == ISC_R_SUCCESS;) {
+		size_t n = 1;
 
-	/* Changing a zone counts as reconfiguration */
-	named_g_configtime = isc_time_now();
+		while (i + n < nzones && order[i + n]->view == order[i]->view) {
+			n++;
+		}
+		result = addzones_save(&order[i], n, text);
+		if (result == ISC_R_SUCCESS) {
+			i += n;
+			saved = i;
+		}
+	}
+
+	/*
+	 * Load the saved zones in the background; a zone that fails to
+	 * load stays configured, as it does when the server starts.
+	 */
+	for (i = 0; i < saved; i++) {
+		isc_result_t tresult = dns_zone_asyncload(order[i]->zone, true,
+							  NULL, NULL);
+		if (tresult != ISC_R_SUCCESS) {
+			dns_zone_log(order[i]->zone, ISC_LOG_ERROR,
+				     "failed to start loading: %s",
+				     isc_result_totext(tresult));
+		}
+	}
+
+	if (saved > 0) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "added %zu zones from '%s' via %s",
+			      saved, zonesfile, NAMED_COMMAND_ADDZONES);
+
+		/* Changing zones counts as reconfiguration */
+		named_g_configtime = isc_time_now();
+	}
+
+	if (result == ISC_R_SUCCESS || saved > 0) {
+		snprintf(buf, sizeof(buf), "%s%zu zones added",
+			 isc_buffer_usedlength(*text) > 0 ? "\n" : "", saved);
+		(void)putstr(text, buf);
+	}
 
 cleanup:
+	for (i = 0; order != NULL && i < nzones; i++) {
+		ns_addzone_t *az = order[i];
+
+		if (az == NULL) {
+			break;
+		}
+		if (az->zone != NULL) {
+			if (i >= saved) {
+				dns_view_delzone(az->view, az->zone);
+			}
+			dns_zone_detach(&az->zone);
+		}
+		if (az->view != NULL) {
+			dns_view_detach(&az->view);
+		}
+	}
+	if (zones != NULL) {
+		isc_mem_cput(server->mctx, order, nzones, sizeof(order[0]));
+		isc_mem_cput(server->mctx, zones, nzones, sizeof(zones[0]));
+	}
 	if (isc_buffer_usedlength(*text) > 0) {
 		(void)putnull(text);
 	}
 	if (zoneconf != NULL) {
 		cfg_obj_destroy(named_g_addparser, &zoneconf);
 	}
-	if (view != NULL) {
-		dns_view_detach(&view);
-	}
 
 	return (result);
 }
@@ -16242,6 +17985,205 @@ cleanup:
 	return (result);
 }
 
+/*
+ * A batch import of the SKR files of all offline-ksk zones, spread over
+ * the worker threads.
+ */
+typedef struct skrimport {
+	isc_mem_t *mctx;
+	char *directory;
+	dns_zone_t **zones;
+	isc_result_t *results;
+	size_t count;
+	size_t size;
+	atomic_size_t next;
+	atomic_size_t done;
+	isc_refcount_t references;
+} skrimport_t;
+
+#define SKRIMPORT_PROGRESS 1000
+
+static isc_result_t
+skrimport_addzone(dns_zone_t *zone, void *arg) {
+	skrimport_t *import = arg;
+	dns_kasp_t *kasp = dns_zone_getkasp(zone);
+
+	if (kasp == NULL || !dns_kasp_offlineksk(kasp)) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (import->count == import->size) {
+		size_t newsize = ISC_MAX(64, import->size * 2);
+		import->zones = isc_mem_creget(import->mctx, import->zones,
+					       import->size, newsize,
+					       sizeof(import->zones[0]));
+		import->size = newsize;
+	}
+	import->zones[import->count] = NULL;
+	dns_zone_attach(zone, &import->zones[import->count++]);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Import "<directory>/<zone>.skr" for the zones not taken yet by another
+ * thread.
+ */
+static void
+skrimport_work(void *arg) {
+	skrimport_t *import = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&import->next, 1)) < import->count)
+	{
+		dns_zone_t *zone = import->zones[i];
+		char filename[PATH_MAX];
+		isc_buffer_t b;
+		size_t done;
+
+		isc_buffer_init(&b, filename, sizeof(filename));
+		import->results[i] = isc_buffer_printf(&b, "%s/",
+						       import->directory);
+		if (import->results[i] == ISC_R_SUCCESS) {
+			import->results[i] = dns_name_tofilenametext(
+				dns_zone_getorigin(zone), false, &b);
+		}
+		if (import->results[i] == ISC_R_SUCCESS) {
+			import->results[i] = isc_buffer_printf(&b, "skr");
+		}
+
+		if (import->results[i] != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "skr: SKR file name too long");
+		} else if (!isc_file_exists(filename)) {
+			import->results[i] = ISC_R_FILENOTFOUND;
+		} else {
+			import->results[i] = dns_zone_import_skr(zone,
+								 filename);
+			if (import->results[i] != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "skr: importing '%s' failed: %s",
+					     filename,
+					     isc_result_totext(
+						     import->results[i]));
+			}
+		}
+
+		done = atomic_fetch_add_relaxed(&import->done, 1) + 1;
+		if (done % SKRIMPORT_PROGRESS == 0) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+				      "skr: %zu of %zu zones done", done,
+				      import->count);
+		}
+	}
+}
+
+/*
+ * Once every thread is finished, schedule a rekey of the zones with a
+ * new SKR and report the outcome.
+ */
+static void
+skrimport_done(void *arg) {
+	skrimport_t *import = arg;
+	size_t imported = 0, missing = 0, failed = 0;
+
+	if (isc_refcount_decrement(&import->references) > 1) {
+		return;
+	}
+	isc_refcount_destroy(&import->references);
+
+	for (size_t i = 0; i < import->count; i++) {
+		switch (import->results[i]) {
+		case ISC_R_SUCCESS:
+			dns_zone_rekey(import->zones[i], false);
+			imported++;
+			break;
+		case ISC_R_FILENOTFOUND:
+			missing++;
+			break;
+		default:
+			failed++;
+			break;
+		}
+		dns_zone_detach(&import->zones[i]);
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      failed > 0 ? ISC_LOG_WARNING : ISC_LOG_INFO,
+		      "skr: imported SKR files for %zu zones from '%s', "
+		      "%zu without SKR file, %zu failed",
+		      imported, import->directory, missing, failed);
+
+	isc_mem_cput(import->mctx, import->results, import->count,
+		     sizeof(import->results[0]));
+	isc_mem_cput(import->mctx, import->zones, import->size,
+		     sizeof(import->zones[0]));
+	isc_mem_free(import->mctx, import->directory);
+	isc_mem_putanddetach(&import->mctx, import, sizeof(*import));
+}
+
+static isc_result_t
+skrimport_all(named_server_t *server, const char *directory,
+	      isc_buffer_t **text) {
+	skrimport_t *import = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	char msg[128];
+	size_t helpers;
+
+	if (isc_file_isdirectory(directory) != ISC_R_SUCCESS) {
+		CHECK(putstr(text, "'"));
+		CHECK(putstr(text, directory));
+		CHECK(putstr(text, "' is not a directory"));
+		CHECK(putnull(text));
+		return (ISC_R_FAILURE);
+	}
+
+	import = isc_mem_get(server->mctx, sizeof(*import));
+	*import = (skrimport_t){
+		.directory = isc_mem_strdup(server->mctx, directory),
+	};
+	isc_mem_attach(server->mctx, &import->mctx);
+
+	isc_loopmgr_pause(named_g_loopmgr);
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		(void)dns_view_apply(view, false, NULL, skrimport_addzone,
+				     import);
+	}
+	isc_loopmgr_resume(named_g_loopmgr);
+
+	if (import->count > 0) {
+		import->results = isc_mem_cget(import->mctx, import->count,
+					       sizeof(import->results[0]));
+	}
+
+	snprintf(msg, sizeof(msg), "importing SKR files for %zu zones",
+		 import->count);
+	result = putstr(text, msg);
+	if (result == ISC_R_SUCCESS) {
+		result = putnull(text);
+	}
+
+	/* Each helper runs on a loop's thread pool. */
+	helpers = ISC_MIN(import->count, isc_loopmgr_nloops(named_g_loopmgr));
+	if (helpers == 0) {
+		isc_refcount_init(&import->references, 1);
+		skrimport_done(import);
+		return (result);
+	}
+
+	isc_refcount_init(&import->references, helpers);
+	for (size_t i = 0; i < helpers; i++) {
+		isc_work_enqueue(isc_loop_get(named_g_loopmgr, i),
+				 skrimport_work, skrimport_done, import);
+	}
+
+cleanup:
+	return (result);
+}
+
 isc_result_t
 named_server_skr(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -16274,7 +18216,8 @@ named_server_skr(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 
 	CHECK(zone_from_args(server, lex, NULL, &zone, NULL, text, false));
 	if (zone == NULL) {
-		CHECK(ISC_R_UNEXPECTEDEND);
+		/* Without a zone, 'skrfile' is a directory of SKR files. */
+		return (skrimport_all(server, skrfile, text));
 	}
 	kasp = dns_zone_getkasp(zone);
 	if (kasp == NULL) {
@@ -16306,3 +18249,56 @@ cleanup:
 
 	return (result);
 }
+
+isc_result_t
+named_server_lockstats(isc_lex_t *lex, isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	char *ptr = NULL;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		result = isc_lockprof_dump(text);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			CHECK(putstr(text, "lock profiling not supported; "
+					   "rebuild with "
+					   "--enable-lock-profiling"));
+		}
+		CHECK(result);
+	} else if (strcasecmp(ptr, "on") == 0 ||
+		   strcasecmp(ptr, "yes") == 0)
+	{
+		result = isc_lockprof_enable(true);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			CHECK(putstr(text, "lock profiling not supported; "
+					   "rebuild with "
+					   "--enable-lock-profiling"));
+		}
+		CHECK(result);
+		CHECK(putstr(text, "lock profiling is now on"));
+	} else if (strcasecmp(ptr, "off") == 0 ||
+		   strcasecmp(ptr, "no") == 0)
+	{
+		(void)isc_lockprof_enable(false);
+		CHECK(putstr(text, "lock profiling is now off"));
+	} else if (strcasecmp(ptr, "reset") == 0) {
+		isc_lockprof_reset();
+		CHECK(putstr(text, "lock statistics reset"));
+	} else {
+		CHECK(DNS_R_SYNTAX);
+	}
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return (result);
+}
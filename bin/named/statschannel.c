@@ -20,6 +20,7 @@
 #include <isc/httpd.h>
 #include <isc/mem.h>
 #include <isc/once.h>
+#include <isc/parseint.h>
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -27,7 +28,10 @@
 #include <dns/adb.h>
 #include <dns/cache.h>
 #include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/geoip.h>
 #include <dns/opcode.h>
+#include <dns/qp.h>
 #include <dns/rcode.h>
 #include <dns/rdataclass.h>
 #include <dns/rdatatype.h>
@@ -36,10 +40,12 @@
 #include <dns/transport.h>
 #include <dns/view.h>
 #include <dns/xfrin.h>
+#include <dns/zonecounters.h>
 #include <dns/zt.h>
 
 #include <ns/stats.h>
 
+#include <named/globals.h>
 #include <named/log.h>
 #include <named/server.h>
 #include <named/statschannel.h>
@@ -57,11 +63,11 @@
 #include "xsl_p.h"
 
 #define STATS_XML_VERSION_MAJOR "3"
-#define STATS_XML_VERSION_MINOR "14"
+#define STATS_XML_VERSION_MINOR "15"
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "8"
+#define STATS_JSON_VERSION_MINOR "9"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
 #define CHECK(m)                               \
@@ -159,6 +165,7 @@ static const char *tcpinsizestats_desc[dns_sizecounter_in_max];
 static const char *tcpoutsizestats_desc[dns_sizecounter_out_max];
 static const char *dnstapstats_desc[dns_dnstapcounter_max];
 static const char *gluecachestats_desc[dns_gluecachestatscounter_max];
+static const char *geoipstats_desc[dns_geoipstatscounter_max];
 #if defined(EXTENDED_STATS)
 static const char *nsstats_xmldesc[ns_statscounter_max];
 static const char *resstats_xmldesc[dns_resstatscounter_max];
@@ -172,6 +179,7 @@ static const char *tcpinsizestats_xmldesc[dns_sizecounter_in_max];
 static const char *tcpoutsizestats_xmldesc[dns_sizecounter_out_max];
 static const char *dnstapstats_xmldesc[dns_dnstapcounter_max];
 static const char *gluecachestats_xmldesc[dns_gluecachestatscounter_max];
+static const char *geoipstats_xmldesc[dns_geoipstatscounter_max];
 #else /* if defined(EXTENDED_STATS) */
 #define nsstats_xmldesc		NULL
 #define resstats_xmldesc	NULL
@@ -185,6 +193,7 @@ static const char *gluecachestats_xmldesc[dns_gluecachestatscounter_max];
 #define tcpoutsizestats_xmldesc NULL
 #define dnstapstats_xmldesc	NULL
 #define gluecachestats_xmldesc	NULL
+#define geoipstats_xmldesc	NULL
 #endif /* EXTENDED_STATS */
 
 #define TRY0(a)                       \
@@ -211,6 +220,28 @@ static int tcpinsizestats_index[dns_sizecounter_in_max];
 static int tcpoutsizestats_index[dns_sizecounter_out_max];
 static int dnstapstats_index[dns_dnstapcounter_max];
 static int gluecachestats_index[dns_gluecachestatscounter_max];
+static int geoipstats_index[dns_geoipstatscounter_max];
+
+/*%
+ * Compact zone counters ("zone-statistics compact"); their names are the
+ * same in all formats.
+ */
+static const char *zonecounters_desc[dns_zonecounter_max] = {
+	[dns_zonecounter_queries] = "Queries",
+	[dns_zonecounter_nxdomain] = "NXDOMAIN",
+	[dns_zonecounter_bytesout] = "BytesOut",
+	[dns_zonecounter_latency0] = "LatencyLT100us",
+	[dns_zonecounter_latency1] = "LatencyLT1ms",
+	[dns_zonecounter_latency2] = "LatencyLT10ms",
+	[dns_zonecounter_latency3] = "LatencyLT100ms",
+	[dns_zonecounter_latency4] = "LatencyGE100ms",
+};
+static int zonecounters_index[dns_zonecounter_max] = {
+	dns_zonecounter_queries,  dns_zonecounter_nxdomain,
+	dns_zonecounter_bytesout, dns_zonecounter_latency0,
+	dns_zonecounter_latency1, dns_zonecounter_latency2,
+	dns_zonecounter_latency3, dns_zonecounter_latency4,
+};
 
 static void
 set_desc(int counter, int maxcounter, const char *fdesc, const char **fdescs,
@@ -379,6 +410,49 @@ init_desc(void) {
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
 	SET_NSSTATDESC(updatequota, "Update quota exceeded", "UpdateQuota");
+	SET_NSSTATDESC(clientreused, "clients reused from the per-loop cache",
+		       "ClientReused");
+	SET_NSSTATDESC(clientallocated, "clients allocated", "ClientAllocated");
+	SET_NSSTATDESC(respcachehit, "queries answered from the response cache",
+		       "RespCacheHit");
+	SET_NSSTATDESC(respcachemiss, "response cache misses",
+		       "RespCacheMiss");
+	SET_NSSTATDESC(rpzfilterskip,
+		       "RPZ trigger searches skipped by the filter",
+		       "RPZFilterSkip");
+	SET_NSSTATDESC(rpzfilterpass,
+		       "RPZ trigger searches passed by the filter",
+		       "RPZFilterPass");
+	SET_NSSTATDESC(rpzfilterfalse,
+		       "RPZ trigger searches passed by the filter that "
+		       "found no trigger",
+		       "RPZFilterFalse");
+	SET_NSSTATDESC(aclmatch, "client ACLs evaluated", "ACLMatch");
+	SET_NSSTATDESC(aclcachehit,
+		       "client ACL checks answered from the request's cache",
+		       "ACLCacheHit");
+	SET_NSSTATDESC(respshared,
+		       "recursive responses shared between clients of a fetch",
+		       "RespShared");
+	SET_NSSTATDESC(cookiereused, "COOKIE - server cookie reused",
+		       "CookieReused");
+	SET_NSSTATDESC(reclimitcostly,
+		       "queries dropped due to recursive client limit that "
+		       "were not the oldest",
+		       "RecLimitCostly");
+	SET_NSSTATDESC(recurslimit, "Recursive clients limit", "RecursLimit");
+	SET_NSSTATDESC(recurslimitlowered,
+		       "Recursive clients limit lowered due to congestion",
+		       "RecursLimitLowered");
+	SET_NSSTATDESC(recurslooplag, "Recursive clients limit: loop lag (ms)",
+		       "RecursLoopLag");
+	SET_NSSTATDESC(recursfetchage,
+		       "Recursive clients limit: oldest recursion (ms)",
+		       "RecursFetchAge");
+	SET_NSSTATDESC(recursslowrtt,
+		       "Recursive clients limit: slow upstream queries (per "
+		       "mille)",
+		       "RecursSlowRTT");
 
 	INSIST(i == ns_statscounter_max);
 
@@ -474,6 +548,37 @@ init_desc(void) {
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
 	SET_RESSTATDESC(forwardonlyfail, "all forwarders failed",
 			"ForwardOnlyFail");
+	SET_RESSTATDESC(valcachehit, "DNSSEC signatures found already verified",
+			"ValCacheHit");
+	SET_RESSTATDESC(valcachemiss, "DNSSEC signatures verified",
+			"ValCacheMiss");
+	SET_RESSTATDESC(fetchcrossloop,
+			"fetch responses delivered to another loop",
+			"FetchCrossLoop");
+	SET_RESSTATDESC(findcrossloop,
+			"ADB find events delivered to another loop",
+			"FindCrossLoop");
+	SET_RESSTATDESC(dispportretry,
+			"query source ports retried after a collision",
+			"QueryPortRetry");
+	SET_RESSTATDESC(tcpshared, "TCP queries sent over an existing connection",
+			"QueryTCPShared");
+	SET_RESSTATDESC(refresh, "popular RRsets refreshed before expiry",
+			"Refresh");
+	SET_RESSTATDESC(refreshfail, "popular RRset refreshes failed",
+			"RefreshFail");
+	SET_RESSTATDESC(refreshhit, "refreshed RRsets queried again",
+			"RefreshHit");
+	SET_RESSTATDESC(refreshskipped, "popular RRsets not refreshed",
+			"RefreshSkipped");
+	SET_RESSTATDESC(qminhint,
+			"QNAME minimization steps skipped by cached hints",
+			"QminHintSkip");
+	SET_RESSTATDESC(raced, "queries raced against a slow server",
+			"QueryRaced");
+	SET_RESSTATDESC(queryabandoned,
+			"queries abandoned without a response",
+			"QueryAbandoned");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -498,6 +603,10 @@ init_desc(void) {
 	SET_ADBSTATDESC(entriescnt, "Addresses in hash table", "entriescnt");
 	SET_ADBSTATDESC(nnames, "Name hash table size", "nnames");
 	SET_ADBSTATDESC(namescnt, "Names in hash table", "namescnt");
+	SET_ADBSTATDESC(nameslockwait, "Name hash table lock waits",
+			"nameslockwait");
+	SET_ADBSTATDESC(entrieslockwait, "Address hash table lock waits",
+			"entrieslockwait");
 
 	INSIST(i == dns_adbstats_max);
 
@@ -534,6 +643,9 @@ init_desc(void) {
 	SET_ZONESTATDESC(xfrsuccess, "transfer requests succeeded",
 			 "XfrSuccess");
 	SET_ZONESTATDESC(xfrfail, "transfer requests failed", "XfrFail");
+	SET_ZONESTATDESC(keymgrrun, "key manager runs", "KeymgrRun");
+	SET_ZONESTATDESC(keymgrtime, "key manager run time (us)",
+			 "KeymgrTime");
 	INSIST(i == dns_zonestatscounter_max);
 
 	/* Initialize socket statistics */
@@ -619,6 +731,28 @@ init_desc(void) {
 			 "TCP4Clients");
 	SET_SOCKSTATDESC(tcp6clients, "TCP/IPv6 clients currently connected",
 			 "TCP6Clients");
+	SET_SOCKSTATDESC(udp4recvbatch, "UDP/IPv4 receive batches",
+			 "UDP4RecvBatch");
+	SET_SOCKSTATDESC(udp6recvbatch, "UDP/IPv6 receive batches",
+			 "UDP6RecvBatch");
+	SET_SOCKSTATDESC(udp4recvbatchmsgs,
+			 "UDP/IPv4 datagrams received in batches",
+			 "UDP4RecvBatchMsgs");
+	SET_SOCKSTATDESC(udp6recvbatchmsgs,
+			 "UDP/IPv6 datagrams received in batches",
+			 "UDP6RecvBatchMsgs");
+	SET_SOCKSTATDESC(tcp4tlsconnect,
+			 "TCP/IPv4 outgoing TLS handshakes completed",
+			 "TCP4TLSConn");
+	SET_SOCKSTATDESC(tcp6tlsconnect,
+			 "TCP/IPv6 outgoing TLS handshakes completed",
+			 "TCP6TLSConn");
+	SET_SOCKSTATDESC(tcp4tlsresumed,
+			 "TCP/IPv4 outgoing TLS sessions resumed",
+			 "TCP4TLSResumed");
+	SET_SOCKSTATDESC(tcp6tlsresumed,
+			 "TCP/IPv6 outgoing TLS sessions resumed",
+			 "TCP6TLSResumed");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -673,6 +807,8 @@ init_desc(void) {
 	i = 0;
 	SET_DNSTAPSTATDESC(success, "dnstap messages written", "DNSTAPsuccess");
 	SET_DNSTAPSTATDESC(drop, "dnstap messages dropped", "DNSTAPdropped");
+	SET_DNSTAPSTATDESC(skipped, "dnstap messages skipped by sampling",
+			   "DNSTAPskipped");
 	INSIST(i == dns_dnstapcounter_max);
 
 #define SET_GLUECACHESTATDESC(counterid, desc, xmldesc)         \
@@ -698,6 +834,19 @@ init_desc(void) {
 			      "GLUECACHEinsertsabsent");
 	INSIST(i == dns_gluecachestatscounter_max);
 
+#define SET_GEOIPSTATDESC(counterid, desc, xmldesc)                        \
+	do {                                                               \
+		set_desc(dns_geoipstatscounter_##counterid,                \
+			 dns_geoipstatscounter_max, desc, geoipstats_desc, \
+			 xmldesc, geoipstats_xmldesc);                     \
+		geoipstats_index[i++] = dns_geoipstatscounter_##counterid; \
+	} while (0)
+	i = 0;
+	SET_GEOIPSTATDESC(lookup, "GeoIP database lookups", "GeoIPLookup");
+	SET_GEOIPSTATDESC(cachehit, "GeoIP lookups answered from cache",
+			  "GeoIPCacheHit");
+	INSIST(i == dns_geoipstatscounter_max);
+
 	/* Sanity check */
 	for (i = 0; i < ns_statscounter_max; i++) {
 		INSIST(nsstats_desc[i] != NULL);
@@ -723,6 +872,9 @@ init_desc(void) {
 	for (i = 0; i < dns_gluecachestatscounter_max; i++) {
 		INSIST(gluecachestats_desc[i] != NULL);
 	}
+	for (i = 0; i < dns_geoipstatscounter_max; i++) {
+		INSIST(geoipstats_desc[i] != NULL);
+	}
 #if defined(EXTENDED_STATS)
 	for (i = 0; i < ns_statscounter_max; i++) {
 		INSIST(nsstats_xmldesc[i] != NULL);
@@ -748,6 +900,9 @@ init_desc(void) {
 	for (i = 0; i < dns_gluecachestatscounter_max; i++) {
 		INSIST(gluecachestats_xmldesc[i] != NULL);
 	}
+	for (i = 0; i < dns_geoipstatscounter_max; i++) {
+		INSIST(geoipstats_xmldesc[i] != NULL);
+	}
 #endif /* if defined(EXTENDED_STATS) */
 
 	/* Initialize traffic size statistics */
@@ -820,6 +975,18 @@ dump_stats(isc_stats_t *stats, isc_statsformat_t type, void *arg,
 			      values, options));
 }
 
+static isc_result_t
+dump_zonecounters(dns_zonecounters_t *counters, uint32_t slot,
+		  isc_statsformat_t type, void *arg, int options) {
+	uint64_t values[dns_zonecounter_max];
+
+	dns_zonecounters_get(counters, slot, values);
+
+	return (dump_counters(type, arg, NULL, zonecounters_desc,
+			      dns_zonecounter_max, zonecounters_index, values,
+			      options));
+}
+
 #if defined(EXTENDED_STATS)
 static isc_result_t
 dump_histo(isc_histomulti_t *hm, isc_statsformat_t type, void *arg,
@@ -836,6 +1003,52 @@ dump_histo(isc_histomulti_t *hm, isc_statsformat_t type, void *arg,
 	return (dump_counters(type, arg, category, desc, ncounters, indices,
 			      values, options));
 }
+
+/*
+ * Query processing latency, in microseconds: the number of samples, the
+ * mean, and the percentiles in 'latency_quantiles'.
+ */
+static const char *latency_names[ns_latency_max] = {
+	[ns_latency_total] = "total",
+	[ns_latency_lookup] = "lookup",
+	[ns_latency_recursion] = "recursion",
+	[ns_latency_render] = "render",
+};
+
+#define LATENCY_QUANTILES 4
+/* isc_histo_quantiles() wants these in decreasing order */
+static const double latency_quantiles[LATENCY_QUANTILES] = { 0.999, 0.99,
+							     0.9, 0.5 };
+static const char *latency_quantile_names[LATENCY_QUANTILES] = {
+	"p999", "p99", "p90", "p50"
+};
+
+/*
+ * Run time of zone maintenance jobs, in microseconds.
+ */
+static const char *zonejob_names[dns_zonejob_max] = {
+	[dns_zonejob_sign] = "sign",
+	[dns_zonejob_resign] = "resign",
+	[dns_zonejob_nsec3chain] = "nsec3chain",
+};
+
+static void
+latency_summary(isc_histomulti_t *hm, uint64_t *countp, double *meanp,
+		uint64_t *values) {
+	isc_histo_t *hg = NULL;
+	double count;
+	isc_result_t result;
+
+	isc_histomulti_merge(&hg, hm);
+	isc_histo_moments(hg, &count, meanp, NULL);
+	*countp = (uint64_t)count;
+	result = isc_histo_quantiles(hg, LATENCY_QUANTILES, latency_quantiles,
+				     values);
+	if (result != ISC_R_SUCCESS) {
+		memset(values, 0, sizeof(values[0]) * LATENCY_QUANTILES);
+	}
+	isc_histo_destroy(&hg);
+}
 #endif /* defined(EXTENDED_STATS) */
 
 static isc_result_t
@@ -1274,6 +1487,119 @@ cleanup:
 #define STATS_XML_TRAFFIC 0x20
 #define STATS_XML_ALL	  0xff
 
+/*
+ * Render the query processing latency, in microseconds.
+ */
+static isc_result_t
+latency_xmlrender(xmlTextWriterPtr writer, ns_server_t *sctx) {
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "latency"));
+	for (int i = 0; i < ns_latency_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+
+		latency_summary(sctx->latency[i], &count, &mean, values);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "stage"));
+		TRY0(xmlTextWriterWriteAttribute(
+			writer, ISC_XMLCHAR "name",
+			ISC_XMLCHAR latency_names[i]));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "count", "%" PRIu64, count));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "mean", "%.1f", mean));
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			TRY0(xmlTextWriterWriteFormatElement(
+				writer, ISC_XMLCHAR latency_quantile_names[q],
+				"%" PRIu64, values[q]));
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* stage */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* latency */
+
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	return (ISC_R_FAILURE);
+}
+
+/*
+ * Render the run time of zone maintenance jobs, in microseconds.
+ */
+static isc_result_t
+zonejob_xmlrender(xmlTextWriterPtr writer, dns_zonemgr_t *zmgr) {
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "zone-jobs"));
+	for (int i = 0; i < dns_zonejob_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+
+		latency_summary(dns_zonemgr_jobtime(zmgr, i), &count, &mean,
+				values);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "job"));
+		TRY0(xmlTextWriterWriteAttribute(
+			writer, ISC_XMLCHAR "name",
+			ISC_XMLCHAR zonejob_names[i]));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "count", "%" PRIu64, count));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "mean", "%.1f", mean));
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			TRY0(xmlTextWriterWriteFormatElement(
+				writer, ISC_XMLCHAR latency_quantile_names[q],
+				"%" PRIu64, values[q]));
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* job */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* zone-jobs */
+
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	return (ISC_R_FAILURE);
+}
+
+/*
+ * Render the distribution of qp-trie compaction pauses, in microseconds.
+ */
+static isc_result_t
+qpgc_xmlrender(xmlTextWriterPtr writer) {
+	isc_histo_t *hg = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	int xmlrc;
+
+	dns_qp_gcpauses(&hg);
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "qp-compaction"));
+	uint64_t min, max, count;
+	for (uint key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		if (count == 0) {
+			continue;
+		}
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "pause"));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "min", "%" PRIu64, min));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "max", "%" PRIu64, max));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64, count));
+		TRY0(xmlTextWriterEndElement(writer)); /* pause */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* qp-compaction */
+
+	isc_histo_destroy(&hg);
+	return (result);
+
+cleanup:
+	isc_histo_destroy(&hg);
+	return (ISC_R_FAILURE);
+}
+
 static isc_result_t
 zone_xmlrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result;
@@ -1349,6 +1675,26 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		TRY0(xmlTextWriterEndElement(writer));
 	}
 
+	if (statlevel == dns_zonestat_compact) {
+		dns_zonecounters_t *counters = NULL;
+		uint32_t slot;
+
+		counters = dns_zone_getcounters(zone, &slot);
+		if (counters != NULL) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counters"));
+			TRY0(xmlTextWriterWriteAttribute(writer,
+							 ISC_XMLCHAR "type",
+							 ISC_XMLCHAR "compact"));
+
+			CHECK(dump_zonecounters(counters, slot,
+						isc_statsformat_xml, writer,
+						ISC_STATSDUMP_VERBOSE));
+			/* counters type="compact"*/
+			TRY0(xmlTextWriterEndElement(writer));
+		}
+	}
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -1751,6 +2097,13 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif /* ifdef HAVE_DNSTAP */
+#if defined(HAVE_GEOIP2)
+	uint64_t geoipstat_values[dns_geoipstatscounter_max];
+#endif /* HAVE_GEOIP2 */
+	uint64_t loads_pending, loads_loading, loads_done;
+	uint32_t loads_eta;
+	unsigned int notify_queued, notify_dests;
+	uint32_t notify_oldest;
 	isc_result_t result;
 
 	isc_time_formatISO8601ms(&named_g_boottime, boottime, sizeof boottime);
@@ -1789,6 +2142,52 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR PACKAGE_VERSION));
 	TRY0(xmlTextWriterEndElement(writer)); /* version */
 
+	if ((flags & (STATS_XML_SERVER | STATS_XML_ZONES)) != 0) {
+		dns_zonemgr_getloadprogress(server->zonemgr, &loads_pending,
+					    &loads_loading, &loads_done,
+					    &loads_eta);
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "zone-loads"));
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "pending"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    loads_pending));
+		TRY0(xmlTextWriterEndElement(writer)); /* pending */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loading"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    loads_loading));
+		TRY0(xmlTextWriterEndElement(writer)); /* loading */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loaded"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    loads_done));
+		TRY0(xmlTextWriterEndElement(writer)); /* loaded */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "eta"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu32,
+						    loads_eta));
+		TRY0(xmlTextWriterEndElement(writer)); /* eta */
+		TRY0(xmlTextWriterEndElement(writer)); /* zone-loads */
+	}
+
+	if ((flags & (STATS_XML_SERVER | STATS_XML_ZONES)) != 0) {
+		dns_zonemgr_getnotifyqueue(server->zonemgr, &notify_queued,
+					   &notify_dests, &notify_oldest);
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "notify-queue"));
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "queued"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    notify_queued));
+		TRY0(xmlTextWriterEndElement(writer)); /* queued */
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "destinations"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    notify_dests));
+		TRY0(xmlTextWriterEndElement(writer)); /* destinations */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "oldest"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu32,
+						    notify_oldest));
+		TRY0(xmlTextWriterEndElement(writer)); /* oldest */
+		TRY0(xmlTextWriterEndElement(writer)); /* notify-queue */
+	}
+
 	if ((flags & STATS_XML_SERVER) != 0) {
 		dumparg.result = ISC_R_SUCCESS;
 
@@ -1860,6 +2259,9 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 
 		TRY0(xmlTextWriterEndElement(writer)); /* resstat */
 
+		CHECK(latency_xmlrender(writer, server->sctx));
+		CHECK(zonejob_xmlrender(writer, server->zonemgr));
+
 #ifdef HAVE_DNSTAP
 		if (server->dtenv != NULL) {
 			isc_stats_t *dnstapstats = NULL;
@@ -1879,6 +2281,24 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 			TRY0(xmlTextWriterEndElement(writer)); /* dnstap */
 		}
 #endif /* ifdef HAVE_DNSTAP */
+
+#if defined(HAVE_GEOIP2)
+		if (named_g_geoip != NULL && named_g_geoip->stats != NULL) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counters"));
+			TRY0(xmlTextWriterWriteAttribute(writer,
+							 ISC_XMLCHAR "type",
+							 ISC_XMLCHAR "geoip"));
+			CHECK(dump_stats(named_g_geoip->stats,
+					 isc_statsformat_xml, writer, NULL,
+					 geoipstats_xmldesc,
+					 dns_geoipstatscounter_max,
+					 geoipstats_index, geoipstat_values,
+					 0));
+
+			TRY0(xmlTextWriterEndElement(writer)); /* geoip */
+		}
+#endif /* HAVE_GEOIP2 */
 	}
 
 	if ((flags & STATS_XML_NET) != 0) {
@@ -2112,6 +2532,7 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 	if ((flags & STATS_XML_MEM) != 0) {
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
 		TRY0(isc_mem_renderxml(writer));
+		CHECK(qpgc_xmlrender(writer));
 		TRY0(xmlTextWriterEndElement(writer)); /* /memory */
 	}
 
@@ -2284,6 +2705,127 @@ render_xml_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		}                                \
 	} while (0)
 
+/*
+ * Render the query processing latency, in microseconds.
+ */
+static isc_result_t
+latency_jsonrender(json_object *bindstats, ns_server_t *sctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *latency = json_object_new_object();
+	CHECKMEM(latency);
+
+	for (int i = 0; i < ns_latency_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+		json_object *stage = json_object_new_object();
+		CHECKMEM(stage);
+		json_object_object_add(latency, latency_names[i], stage);
+
+		latency_summary(sctx->latency[i], &count, &mean, values);
+
+		json_object_object_add(stage, "count",
+				       json_object_new_int64(count));
+		json_object_object_add(stage, "mean",
+				       json_object_new_double(mean));
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			json_object_object_add(stage, latency_quantile_names[q],
+					       json_object_new_int64(values[q]));
+		}
+	}
+
+	json_object_object_add(bindstats, "latency", latency);
+	latency = NULL;
+
+cleanup:
+	if (latency != NULL) {
+		json_object_put(latency);
+	}
+	return (result);
+}
+
+/*
+ * Render the run time of zone maintenance jobs, in microseconds.
+ */
+static isc_result_t
+zonejob_jsonrender(json_object *bindstats, dns_zonemgr_t *zmgr) {
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *jobs = json_object_new_object();
+	CHECKMEM(jobs);
+
+	for (int i = 0; i < dns_zonejob_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+		json_object *job = json_object_new_object();
+		CHECKMEM(job);
+		json_object_object_add(jobs, zonejob_names[i], job);
+
+		latency_summary(dns_zonemgr_jobtime(zmgr, i), &count, &mean,
+				values);
+
+		json_object_object_add(job, "count",
+				       json_object_new_int64(count));
+		json_object_object_add(job, "mean",
+				       json_object_new_double(mean));
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			json_object_object_add(job, latency_quantile_names[q],
+					       json_object_new_int64(values[q]));
+		}
+	}
+
+	json_object_object_add(bindstats, "zone-jobs", jobs);
+	jobs = NULL;
+
+cleanup:
+	if (jobs != NULL) {
+		json_object_put(jobs);
+	}
+	return (result);
+}
+
+/*
+ * Render the distribution of qp-trie compaction pauses, in microseconds.
+ */
+static isc_result_t
+qpgc_jsonrender(json_object *memory) {
+	isc_histo_t *hg = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *pauses = json_object_new_array();
+	CHECKMEM(pauses);
+
+	dns_qp_gcpauses(&hg);
+
+	uint64_t min, max, count;
+	for (uint key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		json_object *pause = NULL;
+
+		if (count == 0) {
+			continue;
+		}
+		pause = json_object_new_object();
+		CHECKMEM(pause);
+		json_object_array_add(pauses, pause);
+		json_object_object_add(pause, "min", json_object_new_int64(min));
+		json_object_object_add(pause, "max", json_object_new_int64(max));
+		json_object_object_add(pause, "count",
+				       json_object_new_int64(count));
+	}
+
+	json_object_object_add(memory, "qp-compaction", pauses);
+	pauses = NULL;
+
+cleanup:
+	if (pauses != NULL) {
+		json_object_put(pauses);
+	}
+	if (hg != NULL) {
+		isc_histo_destroy(&hg);
+	}
+	return (result);
+}
+
 static void
 wrap_jsonfree(isc_buffer_t *buffer, void *arg) {
 	json_object_put(isc_buffer_base(buffer));
@@ -2376,6 +2918,31 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 				       json_object_new_string(buf));
 	}
 
+	if (statlevel == dns_zonestat_compact) {
+		dns_zonecounters_t *zonecounters = NULL;
+		uint32_t slot;
+
+		zonecounters = dns_zone_getcounters(zone, &slot);
+		if (zonecounters != NULL) {
+			json_object *counters = json_object_new_object();
+			if (counters == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto cleanup;
+			}
+
+			result = dump_zonecounters(zonecounters, slot,
+						   isc_statsformat_json,
+						   counters,
+						   ISC_STATSDUMP_VERBOSE);
+			if (result != ISC_R_SUCCESS) {
+				json_object_put(counters);
+				goto cleanup;
+			}
+
+			json_object_object_add(zoneobj, "compact", counters);
+		}
+	}
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -2521,6 +3088,117 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Selection of the zones to render in /json/v1/zones, taken from the
+ * query string.  The walk resumes after the zone 'after' in the view
+ * 'view' (views listed before it are skipped), renders at most 'limit'
+ * zones and leaves out the zones not loaded since 'since'.  When the
+ * limit is hit, 'nextview' and 'last' tell where the next page starts.
+ */
+typedef struct zonefilter {
+	const char *view;
+	dns_name_t *after;
+	uint32_t limit;
+	isc_time_t since;
+	uint32_t count;
+	json_object *zonearray;
+	const char *nextview;
+	dns_name_t *last;
+	bool haslast;
+	dns_fixedname_t fafter;
+	dns_fixedname_t flast;
+} zonefilter_t;
+
+static isc_result_t
+zone_jsonfilter(dns_zone_t *zone, void *arg) {
+	zonefilter_t *filter = arg;
+	isc_time_t loadtime;
+	isc_result_t result;
+
+	if (dns_zone_getstatlevel(zone) == dns_zonestat_none) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (!isc_time_isepoch(&filter->since) &&
+	    (dns_zone_getloadtime(zone, &loadtime) != ISC_R_SUCCESS ||
+	     isc_time_compare(&loadtime, &filter->since) <= 0))
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	if (filter->limit != 0 && filter->count == filter->limit) {
+		return (ISC_R_NOMORE);
+	}
+
+	result = zone_jsonrender(zone, filter->zonearray);
+	if (result == ISC_R_SUCCESS) {
+		filter->count++;
+		dns_name_copy(dns_zone_getorigin(zone), filter->last);
+		filter->haslast = true;
+	}
+	return (result);
+}
+
+static isc_result_t
+zone_jsonapply(dns_view_t *view, json_object *zonearray,
+	       zonefilter_t *filter) {
+	const dns_name_t *after = NULL;
+	isc_result_t result;
+
+	if (filter == NULL) {
+		return (dns_view_apply(view, true, NULL, zone_jsonrender,
+				       zonearray));
+	}
+
+	if (filter->nextview != NULL) {
+		/* The page is already full */
+		return (ISC_R_SUCCESS);
+	}
+
+	if (filter->view != NULL) {
+		if (strcmp(view->name, filter->view) != 0) {
+			return (ISC_R_SUCCESS);
+		}
+		filter->view = NULL;
+		after = filter->after;
+	} else if (filter->after != NULL) {
+		/* 'after' without 'view' applies to the first view */
+		after = filter->after;
+		filter->after = NULL;
+	}
+
+	filter->zonearray = zonearray;
+	filter->haslast = false;
+	result = dns_view_applyfrom(view, after, true, NULL, zone_jsonfilter,
+				    filter);
+	if (result == ISC_R_NOMORE) {
+		filter->nextview = view->name;
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
+static isc_result_t
+zone_jsonnext(json_object *bindstats, zonefilter_t *filter) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	json_object *next = json_object_new_object();
+
+	if (next == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+
+	json_object_object_add(next, "view",
+			       json_object_new_string(filter->nextview));
+	if (filter->haslast) {
+		dns_name_format(filter->last, namebuf, sizeof(namebuf));
+		json_object_object_add(next, "after",
+				       json_object_new_string(namebuf));
+	}
+	json_object_object_add(bindstats, "next", next);
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 xfrin_jsonrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result;
@@ -2777,7 +3455,7 @@ cleanup:
 
 static isc_result_t
 generatejson(named_server_t *server, size_t *msglen, const char **msg,
-	     json_object **rootp, uint32_t flags) {
+	     json_object **rootp, uint32_t flags, zonefilter_t *filter) {
 	dns_view_t *view;
 	isc_result_t result = ISC_R_SUCCESS;
 	json_object *bindstats, *viewlist, *counters, *obj;
@@ -2798,11 +3476,18 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 #ifdef HAVE_DNSTAP
 	uint64_t dnstapstat_values[dns_dnstapcounter_max];
 #endif /* ifdef HAVE_DNSTAP */
+#if defined(HAVE_GEOIP2)
+	uint64_t geoipstat_values[dns_geoipstatscounter_max];
+#endif /* HAVE_GEOIP2 */
 	stats_dumparg_t dumparg;
 	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
 	isc_time_t now;
+	uint64_t loads_pending, loads_loading, loads_done;
+	uint32_t loads_eta;
+	unsigned int notify_queued, notify_dests;
+	uint32_t notify_oldest;
 
 	REQUIRE(msglen != NULL);
 	REQUIRE(msg != NULL && *msg == NULL);
@@ -2841,6 +3526,51 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 	CHECKMEM(obj);
 	json_object_object_add(bindstats, "version", obj);
 
+	if ((flags & (STATS_JSON_SERVER | STATS_JSON_ZONES)) != 0) {
+		dns_zonemgr_getloadprogress(server->zonemgr, &loads_pending,
+					    &loads_loading, &loads_done,
+					    &loads_eta);
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "zone-loads", counters);
+
+		obj = json_object_new_int64(loads_pending);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "pending", obj);
+
+		obj = json_object_new_int64(loads_loading);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "loading", obj);
+
+		obj = json_object_new_int64(loads_done);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "loaded", obj);
+
+		obj = json_object_new_int64(loads_eta);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "eta", obj);
+	}
+
+	if ((flags & (STATS_JSON_SERVER | STATS_JSON_ZONES)) != 0) {
+		dns_zonemgr_getnotifyqueue(server->zonemgr, &notify_queued,
+					   &notify_dests, &notify_oldest);
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "notify-queue", counters);
+
+		obj = json_object_new_int64(notify_queued);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "queued", obj);
+
+		obj = json_object_new_int64(notify_dests);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "destinations", obj);
+
+		obj = json_object_new_int64(notify_oldest);
+		CHECKMEM(obj);
+		json_object_object_add(counters, "oldest", obj);
+	}
+
 	if ((flags & STATS_JSON_SERVER) != 0) {
 		/* OPCODE counters */
 		counters = json_object_new_object();
@@ -2964,6 +3694,16 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			json_object_put(counters);
 		}
 
+		result = latency_jsonrender(bindstats, server->sctx);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		result = zonejob_jsonrender(bindstats, server->zonemgr);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
 #ifdef HAVE_DNSTAP
 		/* dnstap stat counters */
 		if (named_g_server->dtenv != NULL) {
@@ -2991,6 +3731,32 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			}
 		}
 #endif /* ifdef HAVE_DNSTAP */
+
+#if defined(HAVE_GEOIP2)
+		/* GeoIP stat counters */
+		if (named_g_geoip != NULL && named_g_geoip->stats != NULL) {
+			counters = json_object_new_object();
+			dumparg.result = ISC_R_SUCCESS;
+			dumparg.arg = counters;
+			result = dump_stats(named_g_geoip->stats,
+					    isc_statsformat_json, counters,
+					    NULL, geoipstats_xmldesc,
+					    dns_geoipstatscounter_max,
+					    geoipstats_index, geoipstat_values,
+					    0);
+			if (result != ISC_R_SUCCESS) {
+				json_object_put(counters);
+				goto cleanup;
+			}
+
+			if (json_object_get_object(counters)->count != 0) {
+				json_object_object_add(bindstats, "geoipstats",
+						       counters);
+			} else {
+				json_object_put(counters);
+			}
+		}
+#endif /* HAVE_GEOIP2 */
 	}
 
 	if ((flags &
@@ -3013,8 +3779,7 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			CHECKMEM(za);
 
 			if ((flags & STATS_JSON_ZONES) != 0) {
-				CHECK(dns_view_apply(view, true, NULL,
-						     zone_jsonrender, za));
+				CHECK(zone_jsonapply(view, za, filter));
 			}
 
 			if (json_object_array_length(za) != 0) {
@@ -3153,6 +3918,10 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 
 			view = ISC_LIST_NEXT(view, link);
 		}
+
+		if (filter != NULL && filter->nextview != NULL) {
+			CHECK(zone_jsonnext(bindstats, filter));
+		}
 	}
 
 	if ((flags & STATS_JSON_NET) != 0) {
@@ -3184,6 +3953,9 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		CHECKMEM(memory);
 
 		result = isc_mem_renderjson(memory);
+		if (result == ISC_R_SUCCESS) {
+			result = qpgc_jsonrender(memory);
+		}
 		if (result != ISC_R_SUCCESS) {
 			json_object_put(memory);
 			goto cleanup;
@@ -3347,9 +4119,9 @@ cleanup:
 }
 
 static isc_result_t
-render_json(uint32_t flags, void *arg, unsigned int *retcode,
-	    const char **retmsg, const char **mimetype, isc_buffer_t *b,
-	    isc_httpdfree_t **freecb, void **freecb_args) {
+render_json(uint32_t flags, zonefilter_t *filter, void *arg,
+	    unsigned int *retcode, const char **retmsg, const char **mimetype,
+	    isc_buffer_t *b, isc_httpdfree_t **freecb, void **freecb_args) {
 	isc_result_t result;
 	json_object *bindstats = NULL;
 	named_server_t *server = arg;
@@ -3357,7 +4129,8 @@ render_json(uint32_t flags, void *arg, unsigned int *retcode,
 	size_t msglen = 0;
 	char *p;
 
-	result = generatejson(server, &msglen, &msg, &bindstats, flags);
+	result = generatejson(server, &msglen, &msg, &bindstats, flags,
+			      filter);
 	if (result == ISC_R_SUCCESS) {
 		*retcode = 200;
 		*retmsg = "OK";
@@ -3382,8 +4155,8 @@ render_json_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_ALL, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(STATS_JSON_ALL, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3393,8 +4166,8 @@ render_json_status(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_STATUS, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(STATS_JSON_STATUS, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3404,8 +4177,8 @@ render_json_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_SERVER, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(STATS_JSON_SERVER, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3413,21 +4186,74 @@ render_json_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
+	static char badrequest_msg[] = "Bad zone selection.\r\n";
+	char text[DNS_NAME_FORMATSIZE];
+	char viewname[DNS_NAME_FORMATSIZE];
+	zonefilter_t filter = { .view = NULL };
+	uint32_t since = 0;
+	isc_result_t result;
+
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_ZONES, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
-}
 
-static isc_result_t
-render_json_xfrins(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
-		   void *arg, unsigned int *retcode, const char **retmsg,
-		   const char **mimetype, isc_buffer_t *b,
+	filter.last = dns_fixedname_initname(&filter.flast);
+
+	result = isc_httpd_queryarg(httpd, "view", viewname, sizeof(viewname));
+	if (result == ISC_R_SUCCESS) {
+		filter.view = viewname;
+	} else if (result != ISC_R_NOTFOUND) {
+		goto badrequest;
+	}
+
+	result = isc_httpd_queryarg(httpd, "after", text, sizeof(text));
+	if (result == ISC_R_SUCCESS) {
+		filter.after = dns_fixedname_initname(&filter.fafter);
+		result = dns_name_fromstring(filter.after, text, dns_rootname,
+					     0, NULL);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		goto badrequest;
+	}
+
+	result = isc_httpd_queryarg(httpd, "limit", text, sizeof(text));
+	if (result == ISC_R_SUCCESS) {
+		result = isc_parse_uint32(&filter.limit, text, 10);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		goto badrequest;
+	}
+
+	result = isc_httpd_queryarg(httpd, "since", text, sizeof(text));
+	if (result == ISC_R_SUCCESS) {
+		result = isc_parse_uint32(&since, text, 10);
+		isc_time_set(&filter.since, since, 0);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		goto badrequest;
+	}
+
+	return (render_json(STATS_JSON_ZONES, &filter, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
+
+badrequest:
+	*retcode = 400;
+	*retmsg = "Bad Request";
+	*mimetype = "text/plain";
+	isc_buffer_reinit(b, badrequest_msg, strlen(badrequest_msg));
+	isc_buffer_add(b, strlen(badrequest_msg));
+	*freecb = NULL;
+	*freecb_args = NULL;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+render_json_xfrins(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_XFRINS, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(STATS_JSON_XFRINS, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3437,8 +4263,8 @@ render_json_mem(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_MEM, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(STATS_JSON_MEM, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3448,8 +4274,8 @@ render_json_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_NET, arg, retcode, retmsg, mimetype, b,
-			    freecb, freecb_args));
+	return (render_json(STATS_JSON_NET, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 static isc_result_t
@@ -3459,12 +4285,596 @@ render_json_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		    isc_httpdfree_t **freecb, void **freecb_args) {
 	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return (render_json(STATS_JSON_TRAFFIC, arg, retcode, retmsg, mimetype,
-			    b, freecb, freecb_args));
+	return (render_json(STATS_JSON_TRAFFIC, NULL, arg, retcode, retmsg,
+			    mimetype, b, freecb, freecb_args));
 }
 
 #endif /* HAVE_JSON_C */
 
+#if defined(EXTENDED_STATS)
+/*
+ * Prometheus text exposition format.  The counters are printed straight
+ * into a text buffer as they are dumped, without building a document
+ * tree first, so that frequent scrapes stay cheap.  Zone statistics can
+ * be large and are only rendered when asked for.
+ */
+#define STATS_METRICS_SERVER 0x01
+#define STATS_METRICS_ZONES  0x02
+#define STATS_METRICS_NET    0x04
+#define STATS_METRICS_ALL    (STATS_METRICS_SERVER | STATS_METRICS_NET)
+
+#define METRICS_INITIAL_SIZE (64 * 1024)
+
+typedef struct metrics_dumparg {
+	isc_buffer_t *b;
+	const char *name;   /* metric name */
+	const char *labels; /* labels preceding the counter label */
+	const char *key;    /* name of the counter label */
+	const char **desc;  /* counter names for general statistics */
+} metrics_dumparg_t;
+
+/*
+ * Escape a label value: backslash, double quote and line feed have to
+ * be escaped, everything else is copied verbatim.
+ */
+static void
+metrics_escape(const char *value, char *buf, size_t size) {
+	size_t i = 0;
+
+	INSIST(size > 0);
+
+	for (; *value != '\0' && i + 2 < size; value++) {
+		switch (*value) {
+		case '\\':
+		case '"':
+			buf[i++] = '\\';
+			buf[i++] = *value;
+			break;
+		case '\n':
+			buf[i++] = '\\';
+			buf[i++] = 'n';
+			break;
+		default:
+			buf[i++] = *value;
+		}
+	}
+	buf[i] = '\0';
+}
+
+static void
+metrics_type(isc_buffer_t *b, const char *name, const char *type,
+	     const char *help) {
+	(void)isc_buffer_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help,
+				name, type);
+}
+
+static void
+metrics_sample(metrics_dumparg_t *marg, const char *value, uint64_t val) {
+	char buf[256];
+
+	metrics_escape(value, buf, sizeof(buf));
+	(void)isc_buffer_printf(marg->b, "%s{%s%s=\"%s\"} %" PRIu64 "\n",
+				marg->name, marg->labels, marg->key, buf, val);
+}
+
+static void
+metrics_generalstat(isc_statscounter_t counter, uint64_t val, void *arg) {
+	metrics_dumparg_t *marg = arg;
+
+	metrics_sample(marg, marg->desc[counter], val);
+}
+
+static void
+metrics_rdtypestat(dns_rdatastatstype_t type, uint64_t val, void *arg) {
+	char typebuf[64];
+	const char *typestr = "Others";
+
+	if ((DNS_RDATASTATSTYPE_ATTR(type) &
+	     DNS_RDATASTATSTYPE_ATTR_OTHERTYPE) == 0)
+	{
+		dns_rdatatype_format(DNS_RDATASTATSTYPE_BASE(type), typebuf,
+				     sizeof(typebuf));
+		typestr = typebuf;
+	}
+
+	metrics_sample(arg, typestr, val);
+}
+
+static void
+metrics_opcodestat(dns_opcode_t code, uint64_t val, void *arg) {
+	char codebuf[64];
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_opcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_sample(arg, codebuf, val);
+}
+
+static void
+metrics_rcodestat(dns_rcode_t code, uint64_t val, void *arg) {
+	char codebuf[64];
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_rcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_sample(arg, codebuf, val);
+}
+
+static void
+metrics_stats(isc_buffer_t *b, isc_stats_t *stats, const char *name,
+	      const char *labels, const char **desc, int options) {
+	metrics_dumparg_t marg = {
+		.b = b,
+		.name = name,
+		.labels = labels,
+		.key = "counter",
+		.desc = desc,
+	};
+
+	isc_stats_dump(stats, metrics_generalstat, &marg, options);
+}
+
+static void
+metrics_latency(isc_buffer_t *b, ns_server_t *sctx) {
+	const char *name = "bind_query_latency_microseconds";
+
+	metrics_type(b, name, "summary",
+		     "Query processing latency by stage.");
+	for (int i = 0; i < ns_latency_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+
+		latency_summary(sctx->latency[i], &count, &mean, values);
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			(void)isc_buffer_printf(
+				b, "%s{stage=\"%s\",quantile=\"%g\"} %" PRIu64
+				   "\n",
+				name, latency_names[i], latency_quantiles[q],
+				values[q]);
+		}
+		(void)isc_buffer_printf(b, "%s_sum{stage=\"%s\"} %.0f\n", name,
+					latency_names[i], mean * count);
+		(void)isc_buffer_printf(b,
+					"%s_count{stage=\"%s\"} %" PRIu64 "\n",
+					name, latency_names[i], count);
+	}
+}
+
+static void
+metrics_zonejob(isc_buffer_t *b, dns_zonemgr_t *zmgr) {
+	const char *name = "bind_zone_job_microseconds";
+
+	metrics_type(b, name, "summary",
+		     "Run time of zone maintenance jobs.");
+	for (int i = 0; i < dns_zonejob_max; i++) {
+		uint64_t count, values[LATENCY_QUANTILES];
+		double mean;
+
+		latency_summary(dns_zonemgr_jobtime(zmgr, i), &count, &mean,
+				values);
+		for (int q = 0; q < LATENCY_QUANTILES; q++) {
+			(void)isc_buffer_printf(
+				b, "%s{job=\"%s\",quantile=\"%g\"} %" PRIu64
+				   "\n",
+				name, zonejob_names[i], latency_quantiles[q],
+				values[q]);
+		}
+		(void)isc_buffer_printf(b, "%s_sum{job=\"%s\"} %.0f\n", name,
+					zonejob_names[i], mean * count);
+		(void)isc_buffer_printf(b, "%s_count{job=\"%s\"} %" PRIu64 "\n",
+					name, zonejob_names[i], count);
+	}
+}
+
+static void
+metrics_server(isc_buffer_t *b, named_server_t *server) {
+	metrics_dumparg_t marg = { .b = b, .labels = "" };
+	dns_view_t *view = NULL;
+
+	metrics_type(b, "bind_boot_time_seconds", "gauge",
+		     "Time the server was started.");
+	(void)isc_buffer_printf(b, "bind_boot_time_seconds %u\n",
+				isc_time_seconds(&named_g_boottime));
+	metrics_type(b, "bind_config_time_seconds", "gauge",
+		     "Time the configuration was last loaded.");
+	(void)isc_buffer_printf(b, "bind_config_time_seconds %u\n",
+				isc_time_seconds(&named_g_configtime));
+
+	metrics_type(b, "bind_opcodes_total", "counter",
+		     "Requests received by opcode.");
+	marg.name = "bind_opcodes_total";
+	marg.key = "opcode";
+	dns_opcodestats_dump(server->sctx->opcodestats, metrics_opcodestat,
+			     &marg, ISC_STATSDUMP_VERBOSE);
+
+	metrics_type(b, "bind_rcodes_total", "counter",
+		     "Responses sent by rcode.");
+	marg.name = "bind_rcodes_total";
+	marg.key = "rcode";
+	dns_rcodestats_dump(server->sctx->rcodestats, metrics_rcodestat, &marg,
+			    ISC_STATSDUMP_VERBOSE);
+
+	metrics_type(b, "bind_qtypes_total", "counter",
+		     "Queries received by type.");
+	marg.name = "bind_qtypes_total";
+	marg.key = "type";
+	dns_rdatatypestats_dump(server->sctx->rcvquerystats,
+				metrics_rdtypestat, &marg, 0);
+
+	metrics_type(b, "bind_nsstat", "untyped", "Name server statistics.");
+	metrics_stats(b, ns_stats_get(server->sctx->nsstats), "bind_nsstat", "",
+		      nsstats_xmldesc, ISC_STATSDUMP_VERBOSE);
+
+	metrics_type(b, "bind_zonestat", "untyped",
+		     "Zone maintenance statistics.");
+	metrics_stats(b, server->zonestats, "bind_zonestat", "",
+		      zonestats_xmldesc, ISC_STATSDUMP_VERBOSE);
+
+	metrics_type(b, "bind_resstat", "untyped", "Resolver statistics.");
+	metrics_stats(b, server->resolverstats, "bind_resstat", "",
+		      resstats_xmldesc, 0);
+
+	metrics_latency(b, server->sctx);
+	metrics_zonejob(b, server->zonemgr);
+
+	/*
+	 * Each family is emitted in a pass of its own, so that all of its
+	 * samples follow its HELP and TYPE lines.
+	 */
+	metrics_type(b, "bind_view_resstat", "untyped",
+		     "Resolver statistics per view.");
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		char viewname[256], labels[256 + 16];
+		isc_stats_t *istats = NULL;
+
+		if (view->resolver == NULL) {
+			continue;
+		}
+
+		dns_resolver_getstats(view->resolver, &istats);
+		if (istats != NULL) {
+			metrics_escape(view->name, viewname, sizeof(viewname));
+			snprintf(labels, sizeof(labels), "view=\"%s\",",
+				 viewname);
+			metrics_stats(b, istats, "bind_view_resstat", labels,
+				      resstats_xmldesc, ISC_STATSDUMP_VERBOSE);
+			isc_stats_detach(&istats);
+		}
+	}
+
+	metrics_type(b, "bind_view_resqtypes_total", "counter",
+		     "Queries sent by the resolver by type, per view.");
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		char viewname[256], labels[256 + 16];
+		dns_stats_t *dstats = NULL;
+
+		if (view->resolver == NULL) {
+			continue;
+		}
+
+		dns_resolver_getquerystats(view->resolver, &dstats);
+		if (dstats != NULL) {
+			metrics_escape(view->name, viewname, sizeof(viewname));
+			snprintf(labels, sizeof(labels), "view=\"%s\",",
+				 viewname);
+			marg.name = "bind_view_resqtypes_total";
+			marg.labels = labels;
+			marg.key = "type";
+			dns_rdatatypestats_dump(dstats, metrics_rdtypestat,
+						&marg, 0);
+			dns_stats_detach(&dstats);
+		}
+	}
+}
+
+/*
+ * Format the labels identifying 'zone', followed by a comma if 'comma'
+ * is set.
+ */
+static void
+metrics_zonelabels(dns_zone_t *zone, bool comma, char *labels, size_t size) {
+	char zonename[DNS_NAME_FORMATSIZE], buf[DNS_NAME_FORMATSIZE];
+	dns_view_t *view = dns_zone_getview(zone);
+
+	dns_zone_nameonly(zone, buf, sizeof(buf));
+	metrics_escape(buf, zonename, sizeof(zonename));
+	metrics_escape(view != NULL ? view->name : "", buf, sizeof(buf));
+	snprintf(labels, size, "view=\"%s\",zone=\"%s\"%s", buf, zonename,
+		 comma ? "," : "");
+}
+
+static isc_result_t
+metrics_zoneserial(dns_zone_t *zone, void *arg) {
+	isc_buffer_t *b = arg;
+	char labels[2 * DNS_NAME_FORMATSIZE + 32];
+	uint32_t serial;
+
+	if (dns_zone_getstatlevel(zone) == dns_zonestat_none) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (dns_zone_getserial(zone, &serial) == ISC_R_SUCCESS) {
+		metrics_zonelabels(zone, false, labels, sizeof(labels));
+		(void)isc_buffer_printf(b, "bind_zone_serial{%s} %u\n", labels,
+					serial);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+metrics_zonensstat(dns_zone_t *zone, void *arg) {
+	isc_buffer_t *b = arg;
+	char labels[2 * DNS_NAME_FORMATSIZE + 32];
+	isc_stats_t *zonestats = NULL;
+
+	if (dns_zone_getstatlevel(zone) != dns_zonestat_full) {
+		return (ISC_R_SUCCESS);
+	}
+
+	zonestats = dns_zone_getrequeststats(zone);
+	if (zonestats != NULL) {
+		metrics_zonelabels(zone, true, labels, sizeof(labels));
+		metrics_stats(b, zonestats, "bind_zone_nsstat", labels,
+			      nsstats_xmldesc, 0);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+metrics_zoneqtypes(dns_zone_t *zone, void *arg) {
+	isc_buffer_t *b = arg;
+	char labels[2 * DNS_NAME_FORMATSIZE + 32];
+	dns_stats_t *rcvquerystats = NULL;
+
+	if (dns_zone_getstatlevel(zone) != dns_zonestat_full) {
+		return (ISC_R_SUCCESS);
+	}
+
+	rcvquerystats = dns_zone_getrcvquerystats(zone);
+	if (rcvquerystats != NULL) {
+		metrics_dumparg_t marg = {
+			.b = b,
+			.name = "bind_zone_qtypes_total",
+			.labels = labels,
+			.key = "type",
+		};
+
+		metrics_zonelabels(zone, true, labels, sizeof(labels));
+		dns_rdatatypestats_dump(rcvquerystats, metrics_rdtypestat,
+					&marg, 0);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+metrics_zonecompact(dns_zone_t *zone, void *arg) {
+	isc_buffer_t *b = arg;
+	char labels[2 * DNS_NAME_FORMATSIZE + 32];
+	dns_zonecounters_t *counters = NULL;
+	uint32_t slot;
+
+	if (dns_zone_getstatlevel(zone) != dns_zonestat_compact) {
+		return (ISC_R_SUCCESS);
+	}
+
+	counters = dns_zone_getcounters(zone, &slot);
+	if (counters != NULL) {
+		uint64_t values[dns_zonecounter_max];
+		metrics_dumparg_t marg = {
+			.b = b,
+			.name = "bind_zone_compact",
+			.labels = labels,
+			.key = "counter",
+		};
+
+		metrics_zonelabels(zone, true, labels, sizeof(labels));
+		dns_zonecounters_get(counters, slot, values);
+		for (size_t i = 0; i < dns_zonecounter_max; i++) {
+			metrics_sample(&marg, zonecounters_desc[i], values[i]);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The per-zone families, each emitted in a pass of its own over the
+ * zones of all views.
+ */
+static const struct {
+	const char *name;
+	const char *type;
+	const char *help;
+	isc_result_t (*action)(dns_zone_t *, void *);
+} metrics_zonefamilies[] = {
+	{ "bind_zone_serial", "gauge", "Zone serial number.",
+	  metrics_zoneserial },
+	{ "bind_zone_nsstat", "untyped", "Name server statistics per zone.",
+	  metrics_zonensstat },
+	{ "bind_zone_qtypes_total", "counter",
+	  "Queries received by type, per zone.", metrics_zoneqtypes },
+	{ "bind_zone_compact", "untyped",
+	  "Compact query statistics per zone.", metrics_zonecompact },
+};
+
+static void
+metrics_free(isc_buffer_t *b, void *arg) {
+	isc_buffer_t *text = arg;
+
+	UNUSED(b);
+
+	isc_buffer_free(&text);
+}
+
+static isc_result_t
+render_metrics(uint32_t flags, void *arg, unsigned int *retcode,
+	       const char **retmsg, const char **mimetype, isc_buffer_t *b,
+	       isc_httpdfree_t **freecb, void **freecb_args) {
+	named_server_t *server = arg;
+	isc_buffer_t *text = NULL;
+	unsigned int len;
+
+	isc_buffer_allocate(server->mctx, &text, METRICS_INITIAL_SIZE);
+
+	if ((flags & STATS_METRICS_SERVER) != 0) {
+		metrics_server(text, server);
+	}
+
+	if ((flags & STATS_METRICS_NET) != 0) {
+		metrics_type(text, "bind_sockstat", "untyped",
+			     "Socket I/O statistics.");
+		metrics_stats(text, server->sockstats, "bind_sockstat", "",
+			      sockstats_xmldesc, ISC_STATSDUMP_VERBOSE);
+	}
+
+	if ((flags & STATS_METRICS_ZONES) != 0) {
+		for (size_t i = 0; i < ARRAY_SIZE(metrics_zonefamilies); i++) {
+			metrics_type(text, metrics_zonefamilies[i].name,
+				     metrics_zonefamilies[i].type,
+				     metrics_zonefamilies[i].help);
+			for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist);
+			     view != NULL; view = ISC_LIST_NEXT(view, link))
+			{
+				(void)dns_view_apply(
+					view, true, NULL,
+					metrics_zonefamilies[i].action, text);
+			}
+		}
+	}
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = "text/plain; version=0.0.4; charset=utf-8";
+	len = isc_buffer_usedlength(text);
+	isc_buffer_reinit(b, isc_buffer_base(text), len);
+	isc_buffer_add(b, len);
+	*freecb = metrics_free;
+	*freecb_args = text;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+render_metrics_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
+		   isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return (render_metrics(STATS_METRICS_ALL, arg, retcode, retmsg,
+			       mimetype, b, freecb, freecb_args));
+}
+
+static isc_result_t
+render_metrics_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		      void *arg, unsigned int *retcode, const char **retmsg,
+		      const char **mimetype, isc_buffer_t *b,
+		      isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return (render_metrics(STATS_METRICS_SERVER, arg, retcode, retmsg,
+			       mimetype, b, freecb, freecb_args));
+}
+
+static isc_result_t
+render_metrics_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
+		   isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return (render_metrics(STATS_METRICS_NET, arg, retcode, retmsg,
+			       mimetype, b, freecb, freecb_args));
+}
+
+static isc_result_t
+render_metrics_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		     void *arg, unsigned int *retcode, const char **retmsg,
+		     const char **mimetype, isc_buffer_t *b,
+		     isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return (render_metrics(STATS_METRICS_ZONES, arg, retcode, retmsg,
+			       mimetype, b, freecb, freecb_args));
+}
+
+/*
+ * The general counters in a compact binary form, for collectors that
+ * poll often: the magic "BNDC" and a version octet, then for each set
+ * of counters a one-octet name length, the name, a 32-bit count and
+ * that many 64-bit counter values, in the order of the counter indices
+ * and all in network byte order.  The names of the counters are the
+ * ones in the XML and JSON output, in the same order.
+ */
+#define COUNTERS_VERSION 1
+
+static void
+counters_stat(isc_statscounter_t counter, uint64_t val, void *arg) {
+	isc_buffer_t *b = arg;
+
+	UNUSED(counter);
+
+	isc_buffer_putuint32(b, (uint32_t)(val >> 32));
+	isc_buffer_putuint32(b, (uint32_t)val);
+}
+
+static void
+counters_set(isc_buffer_t *b, const char *name, isc_stats_t *stats) {
+	size_t len = strlen(name);
+
+	INSIST(len <= UINT8_MAX);
+
+	isc_buffer_putuint8(b, (uint8_t)len);
+	isc_buffer_putmem(b, (const unsigned char *)name, len);
+	isc_buffer_putuint32(b, isc_stats_ncounters(stats));
+	isc_stats_dump(stats, counters_stat, b, ISC_STATSDUMP_VERBOSE);
+}
+
+static isc_result_t
+render_counters(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		void *arg, unsigned int *retcode, const char **retmsg,
+		const char **mimetype, isc_buffer_t *b,
+		isc_httpdfree_t **freecb, void **freecb_args) {
+	named_server_t *server = arg;
+	isc_buffer_t *data = NULL;
+	unsigned int len;
+
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+
+	isc_buffer_allocate(server->mctx, &data, 4096);
+
+	isc_buffer_putmem(data, (const unsigned char *)"BNDC", 4);
+	isc_buffer_putuint8(data, COUNTERS_VERSION);
+	counters_set(data, "nsstat", ns_stats_get(server->sctx->nsstats));
+	counters_set(data, "zonestat", server->zonestats);
+	counters_set(data, "resstat", server->resolverstats);
+	counters_set(data, "sockstat", server->sockstats);
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = "application/octet-stream";
+	len = isc_buffer_usedlength(data);
+	isc_buffer_reinit(b, isc_buffer_base(data), len);
+	isc_buffer_add(b, len);
+	*freecb = metrics_free;
+	*freecb_args = data;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* defined(EXTENDED_STATS) */
+
 #if HAVE_LIBXML2
 /*
  * This is only needed if we have libxml2 and was confusingly returned if
@@ -3698,6 +5108,18 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
 			    false, render_json_traffic, server);
 #endif /* ifdef HAVE_JSON_C */
+#if defined(EXTENDED_STATS)
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics", false,
+			    render_metrics_all, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/server", false,
+			    render_metrics_server, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/net", false,
+			    render_metrics_net, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/zones", false,
+			    render_metrics_zones, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/counters", false,
+			    render_counters, server);
+#endif /* defined(EXTENDED_STATS) */
 
 	*listenerp = listener;
 	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
@@ -3931,6 +5353,9 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 	uint64_t zonestat_values[dns_zonestatscounter_max];
 	uint64_t sockstat_values[isc_sockstatscounter_max];
 	uint64_t gluecachestats_values[dns_gluecachestatscounter_max];
+#if defined(HAVE_GEOIP2)
+	uint64_t geoipstat_values[dns_geoipstatscounter_max];
+#endif /* HAVE_GEOIP2 */
 	isc_stdtime_t now = isc_stdtime_now();
 
 	isc_once_do(&once, init_desc);
@@ -4081,6 +5506,16 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 			 sockstats_desc, isc_sockstatscounter_max,
 			 sockstats_index, sockstat_values, 0);
 
+#if defined(HAVE_GEOIP2)
+	if (named_g_geoip != NULL && named_g_geoip->stats != NULL) {
+		fprintf(fp, "++ GeoIP Statistics ++\n");
+		(void)dump_stats(named_g_geoip->stats, isc_statsformat_file,
+				 fp, NULL, geoipstats_desc,
+				 dns_geoipstatscounter_max, geoipstats_index,
+				 geoipstat_values, 0);
+	}
+#endif /* HAVE_GEOIP2 */
+
 	fprintf(fp, "++ Per Zone Query Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
@@ -4111,6 +5546,36 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 		}
 	}
 
+	fprintf(fp, "++ Per Zone Compact Statistics ++\n");
+	zone = NULL;
+	for (result = dns_zone_first(server->zonemgr, &zone);
+	     result == ISC_R_SUCCESS;
+	     next = NULL, result = dns_zone_next(zone, &next), zone = next)
+	{
+		uint32_t slot;
+		dns_zonecounters_t *counters = dns_zone_getcounters(zone,
+								    &slot);
+		if (counters != NULL) {
+			char zonename[DNS_NAME_FORMATSIZE];
+
+			view = dns_zone_getview(zone);
+			if (view == NULL) {
+				continue;
+			}
+
+			dns_name_format(dns_zone_getorigin(zone), zonename,
+					sizeof(zonename));
+			fprintf(fp, "[%s", zonename);
+			if (strcmp(view->name, "_default") != 0) {
+				fprintf(fp, " (view: %s)", view->name);
+			}
+			fprintf(fp, "]\n");
+
+			(void)dump_zonecounters(counters, slot,
+						isc_statsformat_file, fp, 0);
+		}
+	}
+
 	fprintf(fp, "++ Per Zone Glue Cache Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
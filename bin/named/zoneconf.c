@@ -1168,6 +1168,8 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			statlevel = dns_zonestat_full;
 		} else if (strcasecmp(levelstr, "terse") == 0) {
 			statlevel = dns_zonestat_terse;
+		} else if (strcasecmp(levelstr, "compact") == 0) {
+			statlevel = dns_zonestat_compact;
 		} else if (strcasecmp(levelstr, "none") == 0) {
 			statlevel = dns_zonestat_none;
 		} else {
@@ -1200,6 +1202,14 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		dns_stats_detach(&dnssecsignstats);
 	}
 
+	if (dns_zone_setcounters(zone, statlevel == dns_zonestat_compact
+					       ? named_g_server->zonecounters
+					       : NULL) != ISC_R_SUCCESS)
+	{
+		dns_zone_log(zone, ISC_LOG_WARNING,
+			     "no compact zone counters available");
+	}
+
 	/*
 	 * Configure authoritative zone functionality.  This applies
 	 * to primary servers (type "primary") and secondaries
@@ -1636,6 +1646,12 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		/* Also save a reference to the keystore list. */
 		dns_zone_setkeystores(zone, keystorelist);
 
+		obj = NULL;
+		result = named_config_get(maps, "sig-cache", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_SIGCACHE,
+				   cfg_obj_asboolean(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "sig-signing-signatures", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1819,6 +1835,18 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			dns_zone_setserialupdatemethod(
 				zone, dns_updatemethod_increment);
 		}
+
+		obj = NULL;
+		result = named_config_get(maps, "journal-group-commit", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(mayberaw, DNS_ZONEOPT_JOURNALGROUP,
+				   cfg_obj_asboolean(obj));
+
+		obj = NULL;
+		result = named_config_get(maps, "load-on-demand", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_LOADONDEMAND,
+				   cfg_obj_asboolean(obj));
 	}
 
 	/*
@@ -21,7 +21,6 @@
 
 #include <isc/buffer.h>
 #include <isc/hash.h>
-#include <isc/ht.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -62,9 +61,9 @@
 typedef enum { NONE = 0, FILTER = 1, BREAK_DNSSEC = 2 } filter_a_t;
 
 /*
- * Persistent data for use by this module. This will be associated
- * with client object address in the hash table, and will remain
- * accessible until the client object is detached.
+ * Persistent data for use by this module. This is kept in the client's
+ * plugin scratch space, and will remain accessible until the client
+ * object is detached.
  */
 typedef struct filter_data {
 	filter_a_t mode;
@@ -75,12 +74,6 @@ typedef struct filter_instance {
 	ns_plugin_t *module;
 	isc_mem_t *mctx;
 
-	/*
-	 * Hash table associating a client object with its persistent data.
-	 */
-	isc_ht_t *ht;
-	isc_mutex_t hlock;
-
 	/*
 	 * Values configured when the module is loaded.
 	 */
@@ -343,9 +336,6 @@ plugin_register(const char *parameters, const void *cfg, const char *cfg_file,
 				       cfg_line, mctx, actx));
 	}
 
-	isc_ht_init(&inst->ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_mutex_init(&inst->hlock);
-
 	/*
 	 * Set hook points in the view's hooktable.
 	 */
@@ -396,10 +386,6 @@ void
 plugin_destroy(void **instp) {
 	filter_instance_t *inst = (filter_instance_t *)*instp;
 
-	if (inst->ht != NULL) {
-		isc_ht_destroy(&inst->ht);
-		isc_mutex_destroy(&inst->hlock);
-	}
 	if (inst->a_acl != NULL) {
 		dns_acl_detach(&inst->a_acl);
 	}
@@ -463,52 +449,33 @@ is_v6_client(ns_client_t *client) {
 	return (false);
 }
 
+/*
+ * The persistent data of a client query is kept in the client's plugin
+ * scratch space, with the plugin instance as the owner.
+ */
 static filter_data_t *
 client_state_get(const query_ctx_t *qctx, filter_instance_t *inst) {
-	filter_data_t *client_state = NULL;
-	isc_result_t result;
-
-	LOCK(&inst->hlock);
-	result = isc_ht_find(inst->ht, (const unsigned char *)&qctx->client,
-			     sizeof(qctx->client), (void **)&client_state);
-	UNLOCK(&inst->hlock);
-
-	return (result == ISC_R_SUCCESS ? client_state : NULL);
+	return (ns_client_findplugindata(qctx->client, inst));
 }
 
 static void
 client_state_create(const query_ctx_t *qctx, filter_instance_t *inst) {
-	filter_data_t *client_state;
-	isc_result_t result;
+	filter_data_t *client_state = NULL;
+
+	STATIC_ASSERT(sizeof(*client_state) <= NS_CLIENT_PLUGINDATA_SIZE,
+		      "filter_data_t does not fit the client plugin data");
 
-	client_state = isc_mem_get(inst->mctx, sizeof(*client_state));
+	client_state = ns_client_plugindata(qctx->client, inst,
+					    sizeof(*client_state));
+	RUNTIME_CHECK(client_state != NULL);
 
 	client_state->mode = NONE;
 	client_state->flags = 0;
-
-	LOCK(&inst->hlock);
-	result = isc_ht_add(inst->ht, (const unsigned char *)&qctx->client,
-			    sizeof(qctx->client), client_state);
-	UNLOCK(&inst->hlock);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 }
 
 static void
 client_state_destroy(const query_ctx_t *qctx, filter_instance_t *inst) {
-	filter_data_t *client_state = client_state_get(qctx, inst);
-	isc_result_t result;
-
-	if (client_state == NULL) {
-		return;
-	}
-
-	LOCK(&inst->hlock);
-	result = isc_ht_delete(inst->ht, (const unsigned char *)&qctx->client,
-			       sizeof(qctx->client));
-	UNLOCK(&inst->hlock);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-
-	isc_mem_put(inst->mctx, client_state, sizeof(*client_state));
+	ns_client_releaseplugindata(qctx->client, inst);
 }
 
 /*%
@@ -622,10 +589,9 @@ process_section(const section_filter_t *filter) {
 }
 
 /*
- * Initialize filter state, fetching it from a memory pool and storing it
- * in a hash table keyed according to the client object; this enables us to
- * retrieve persistent data related to a client query for as long as the
- * object persists.
+ * Initialize filter state in the client's plugin scratch space; this
+ * enables us to retrieve persistent data related to a client query for
+ * as long as the object persists.
  */
 static ns_hookresult_t
 filter_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp) {
@@ -854,8 +820,8 @@ filter_query_done_send(void *arg, void *cbdata, isc_result_t *resp) {
 }
 
 /*
- * If the client is being detached, then we can delete our persistent data
- * from hash table and return it to the memory pool.
+ * If the client is being detached, then we can release our persistent
+ * data.
  */
 static ns_hookresult_t
 filter_qctx_destroy(void *arg, void *cbdata, isc_result_t *resp) {
@@ -13,6 +13,7 @@
 
 /*! \file */
 
+#include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -31,6 +32,7 @@
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/thread.h>
@@ -78,6 +80,11 @@ static bool c_flag = false;
 static isc_mem_t *rndc_mctx = NULL;
 static char *command = NULL;
 static char *args = NULL;
+static const char *batchfile = NULL;
+static char **commands = NULL;
+static size_t ncommands = 0;
+static size_t maxcommands = 0;
+static size_t nreplies = 0;
 static char program[256];
 static uint32_t serial;
 static bool quiet = false;
@@ -95,11 +102,18 @@ usage(int status) {
 	fprintf(stderr, "\
 Usage: %s [-b address] [-c config] [-s server] [-p port]\n\
 	[-k key-file ] [-y key] [-r] [-V] [-4 | -6] command\n\
+       %s [options] -f file\n\
+\n\
+With -f, the commands are read from file (\"-\" for standard\n\
+input), one per line, and sent over a single connection.\n\
 \n\
 command is one of the following:\n\
 \n\
   addzone zone [class [view]] { zone-options }\n\
 		Add zone to given view. Requires allow-new-zones option.\n\
+  addzones file\n\
+		Add all zones configured in file, which is read by the\n\
+		server. Requires allow-new-zones option.\n\
   delzone [-clean] zone [class [view]]\n\
 		Removes zone from given view.\n\
   dnssec -checkds [-key id [-alg algorithm]] [-when time] (published|withdrawn) zone [class [view]]\n\
@@ -118,8 +132,13 @@ command is one of the following:\n\
 		Close, truncate and re-open the DNSTAP output file.\n\
   dnstap -roll [count]\n\
 		Close, rename and re-open the DNSTAP output file(s).\n\
-  dumpdb [-all|-cache|-zones|-adb|-bad|-expired|-fail] [view ...]\n\
+  dumpdb [-all|-cache|-zones|-adb|-bad|-expired|-fail]\n\
+	 [-name name] [-type type] [view ...]\n\
 		Dump cache(s) to the dump file (named_dump.db).\n\
+		-name and -type restrict the cache dump to the names\n\
+		at or below name and to RRsets of type.\n\
+  dumpdb -binary [-name name] [-type type] [view ...]\n\
+		Write cache snapshot(s) to the cache-snapshot-file(s).\n\
   flush         Flushes all of the server's caches.\n\
   flush [view]	Flushes the server's cache for a view.\n\
   flushname name [view]\n\
@@ -135,8 +154,14 @@ command is one of the following:\n\
   skr -import file zone [class [view]]\n\
 		Import a SKR file for the specified zone, for offline KSK\n\
 		signing.\n\
+  skr -import directory\n\
+		Import the SKR file named after each offline KSK zone\n\
+		from the given directory.\n\
   loadkeys zone [class [view]]\n\
 		Update keys without signing immediately.\n\
+  lockstats [on | off | reset]\n\
+		Report lock contention statistics, or enable, disable\n\
+		or reset lock profiling.\n\
   managed-keys refresh [class [view]]\n\
 		Check trust anchor for RFC 5011 key changes\n\
   managed-keys status [class [view]]\n\
@@ -221,12 +246,12 @@ command is one of the following:\n\
 		Display the current status of a zone.\n\
 \n\
 Version: %s\n",
-		progname, version);
+		progname, progname, version);
 
 	exit(status);
 }
 
-#define CMDLINE_FLAGS "46b:c:hk:Mmp:qrs:t:Vy:"
+#define CMDLINE_FLAGS "46b:c:f:hk:Mmp:qrs:t:Vy:"
 
 static void
 preparse_args(int argc, char **argv) {
@@ -291,6 +316,7 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_region_t source;
 	char *errormsg = NULL;
 	char *textmsg = NULL;
+	bool cmdfailed = false;
 
 	REQUIRE(handle != NULL);
 	REQUIRE(ccmsg != NULL);
@@ -319,8 +345,9 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	}
 	result = isccc_cc_lookupstring(data, "err", &errormsg);
 	if (result == ISC_R_SUCCESS) {
-		failed = true;
-		fprintf(stderr, "%s: '%s' failed: %s\n", progname, command,
+		failed = cmdfailed = true;
+		fprintf(stderr, "%s: '%s' failed: %s\n", progname,
+			batchfile != NULL ? commands[nreplies] : command,
 			errormsg);
 	} else if (result != ISC_R_NOTFOUND) {
 		fprintf(stderr, "%s: parsing response failed: %s\n", progname,
@@ -329,8 +356,8 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 
 	result = isccc_cc_lookupstring(data, "text", &textmsg);
 	if (result == ISC_R_SUCCESS) {
-		if ((!quiet || failed) && strlen(textmsg) != 0U) {
-			fprintf(failed ? stderr : stdout, "%s\n", textmsg);
+		if ((!quiet || cmdfailed) && strlen(textmsg) != 0U) {
+			fprintf(cmdfailed ? stderr : stdout, "%s\n", textmsg);
 		}
 	} else if (result != ISC_R_NOTFOUND) {
 		fprintf(stderr, "%s: parsing response failed: %s\n", progname,
@@ -350,10 +377,60 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 
 	isccc_sexpr_free(&response);
 
+	if (++nreplies < ncommands) {
+		isccc_ccmsg_readmessage(ccmsg, rndc_recvdone, ccmsg);
+		return;
+	}
+
 	isccc_ccmsg_disconnect(ccmsg);
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/*
+ * Append a request for the command 'text', carrying 'nonce', to
+ * 'databuf', preceded by its length.
+ */
+static void
+render_command(const char *text, uint32_t nonce) {
+	isccc_sexpr_t *request = NULL;
+	isccc_sexpr_t *data = NULL;
+	isccc_sexpr_t *_ctrl = NULL;
+	isccc_time_t now = isc_stdtime_now();
+	unsigned int start = isc_buffer_usedlength(databuf);
+	isc_buffer_t b;
+	isc_result_t result;
+
+	DO("create message", isccc_cc_createmessage(1, NULL, NULL, ++serial,
+						    now, now + 60, &request));
+	data = isccc_alist_lookup(request, "_data");
+	if (data == NULL) {
+		fatal("_data section missing");
+	}
+	if (isccc_cc_definestring(data, "type", text) == NULL) {
+		fatal("out of memory");
+	}
+	if (nonce != 0) {
+		_ctrl = isccc_alist_lookup(request, "_ctrl");
+		if (_ctrl == NULL) {
+			fatal("_ctrl section missing");
+		}
+		if (isccc_cc_defineuint32(_ctrl, "_nonce", nonce) == NULL) {
+			fatal("out of memory");
+		}
+	}
+
+	/* The length field (4 bytes) is filled in below */
+	isc_buffer_putuint32(databuf, 0);
+
+	DO("render message",
+	   isccc_cc_towire(request, &databuf, algorithm, &secret));
+
+	isc_buffer_init(&b, (unsigned char *)databuf->base + start, 4);
+	isc_buffer_putuint32(&b, databuf->used - start - 4);
+
+	isccc_sexpr_free(&request);
+}
+
 static void
 rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	       void *arg) {
@@ -362,11 +439,7 @@ rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	isccc_sexpr_t *_ctrl = NULL;
 	isccc_region_t source;
 	uint32_t nonce;
-	isccc_sexpr_t *request = NULL;
-	isccc_time_t now = isc_stdtime_now();
 	isc_region_t r;
-	isccc_sexpr_t *data = NULL;
-	isc_buffer_t b;
 
 	REQUIRE(ccmsg != NULL);
 
@@ -397,34 +470,14 @@ rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 		nonce = 0;
 	}
 
-	DO("create message", isccc_cc_createmessage(1, NULL, NULL, ++serial,
-						    now, now + 60, &request));
-	data = isccc_alist_lookup(request, "_data");
-	if (data == NULL) {
-		fatal("_data section missing");
-	}
-	if (isccc_cc_definestring(data, "type", args) == NULL) {
-		fatal("out of memory");
-	}
-	if (nonce != 0) {
-		_ctrl = isccc_alist_lookup(request, "_ctrl");
-		if (_ctrl == NULL) {
-			fatal("_ctrl section missing");
-		}
-		if (isccc_cc_defineuint32(_ctrl, "_nonce", nonce) == NULL) {
-			fatal("out of memory");
-		}
-	}
-
+	/*
+	 * Send all the commands at once; the server answers them in
+	 * order, one at a time.
+	 */
 	isc_buffer_clear(databuf);
-	/* Skip the length field (4 bytes) */
-	isc_buffer_add(databuf, 4);
-
-	DO("render message",
-	   isccc_cc_towire(request, &databuf, algorithm, &secret));
-
-	isc_buffer_init(&b, databuf->base, 4);
-	isc_buffer_putuint32(&b, databuf->used - 4);
+	for (size_t i = 0; i < ncommands; i++) {
+		render_command(commands[i], nonce);
+	}
 
 	r.base = databuf->base;
 	r.length = databuf->used;
@@ -433,10 +486,67 @@ rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	isccc_ccmsg_sendmessage(ccmsg, &r, rndc_senddone, NULL);
 
 	isccc_sexpr_free(&response);
-	isccc_sexpr_free(&request);
 	return;
 }
 
+/*
+ * Read the commands for -f from 'filename', skipping empty lines and
+ * comments.
+ */
+static void
+read_batch(const char *filename) {
+	static char line[32768];
+	FILE *fp = stdin;
+	isc_result_t result;
+
+	if (strcmp(filename, "-") != 0) {
+		DO("open batch file", isc_stdio_open(filename, "r", &fp));
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *p = line, *end = NULL;
+
+		end = line + strlen(line);
+		if (end > line && end[-1] != '\n' && !feof(fp)) {
+			fatal("line too long in '%s'", filename);
+		}
+		while (end > p && isspace((unsigned char)end[-1])) {
+			*--end = '\0';
+		}
+		while (isspace((unsigned char)*p)) {
+			p++;
+		}
+		if (*p == '\0' || *p == '#') {
+			continue;
+		}
+		if (strncmp(p, "restart", 7) == 0 &&
+		    (p[7] == '\0' || isspace((unsigned char)p[7])))
+		{
+			fatal("'restart' is not implemented");
+		}
+
+		if (ncommands == maxcommands) {
+			size_t newmax = ISC_MAX(16, maxcommands * 2);
+			commands = isc_mem_creget(rndc_mctx, commands,
+						  maxcommands, newmax,
+						  sizeof(commands[0]));
+			maxcommands = newmax;
+		}
+		commands[ncommands++] = isc_mem_strdup(rndc_mctx, p);
+	}
+	if (ferror(fp)) {
+		fatal("error reading '%s'", filename);
+	}
+
+	if (fp != stdin) {
+		(void)isc_stdio_close(fp);
+	}
+
+	if (ncommands == 0) {
+		fatal("no commands in '%s'", filename);
+	}
+}
+
 static void
 rndc_connected(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_ccmsg_t *ccmsg = (isccc_ccmsg_t *)arg;
@@ -816,7 +926,7 @@ main(int argc, char **argv) {
 	struct in_addr in;
 	struct in6_addr in6;
 	char *p = NULL;
-	size_t argslen;
+	size_t argslen = 0;
 	int ch;
 	int i;
 
@@ -869,6 +979,10 @@ main(int argc, char **argv) {
 			c_flag = true;
 			break;
 
+		case 'f':
+			batchfile = isc_commandline_argument;
+			break;
+
 		case 'k':
 			admin_keyfile = isc_commandline_argument;
 			break;
@@ -938,7 +1052,12 @@ main(int argc, char **argv) {
 	argc -= isc_commandline_index;
 	argv += isc_commandline_index;
 
-	if (argv[0] == NULL) {
+	if (batchfile != NULL) {
+		if (argv[0] != NULL) {
+			usage(1);
+		}
+		notify("commands from %s", batchfile);
+	} else if (argv[0] == NULL) {
 		usage(1);
 	} else {
 		command = argv[0];
@@ -967,6 +1086,11 @@ main(int argc, char **argv) {
 
 	isc_buffer_allocate(rndc_mctx, &databuf, 2048);
 
+	if (batchfile != NULL) {
+		read_batch(batchfile);
+		goto run;
+	}
+
 	/*
 	 * Convert argc/argv into a space-delimited command string
 	 * similar to what the user might enter in interactive mode
@@ -991,6 +1115,10 @@ main(int argc, char **argv) {
 	*p++ = '\0';
 	INSIST(p == args + argslen);
 
+	commands = &args;
+	ncommands = 1;
+
+run:
 	if (nserveraddrs == 0 && servername != NULL) {
 		get_addresses(servername, (in_port_t)remoteport);
 	}
@@ -1002,7 +1130,15 @@ main(int argc, char **argv) {
 	cfg_obj_destroy(pctx, &config);
 	cfg_parser_destroy(&pctx);
 
-	isc_mem_put(rndc_mctx, args, argslen);
+	if (batchfile != NULL) {
+		for (size_t n = 0; n < ncommands; n++) {
+			isc_mem_free(rndc_mctx, commands[n]);
+		}
+		isc_mem_cput(rndc_mctx, commands, maxcommands,
+			     sizeof(commands[0]));
+	} else {
+		isc_mem_put(rndc_mctx, args, argslen);
+	}
 
 	isc_buffer_free(&databuf);
 
@@ -12,4 +12,4 @@
 # information regarding copyright ownership.
 
 rm -rf zones
-rm -f named.conf
+rm -f named.conf named.log* named.pid rndc.conf
@@ -0,0 +1,140 @@
+#!/bin/sh
+
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+# Measure the startup time, the memory used per zone, the load time per
+# million records and the reconfiguration time of named, and append
+# them as one JSON object to a results file, so that they can be tracked
+# from one commit to the next.
+
+usage() {
+  echo "Usage: $0 [-z <zones>] [-r <records per zone>]"
+  echo "       [-l <records in the large zone>] [-o <results file>]"
+  exit 1
+}
+
+nzones=1000
+nrecords=5
+nlarge=1000000
+results=results.jsonl
+
+while getopts "l:o:r:z:" opt; do
+  case $opt in
+    l) nlarge=$OPTARG ;;
+    o) results=$OPTARG ;;
+    r) nrecords=$OPTARG ;;
+    z) nzones=$OPTARG ;;
+    *) usage ;;
+  esac
+done
+shift $((OPTIND - 1))
+[ "$#" -eq 0 ] || usage
+
+case $results in
+  /*) ;;
+  *) results="$(pwd)/$results" ;;
+esac
+
+cd "$(dirname "$0")" || exit 1
+
+if [ -z "$TOP_SRCDIR" ]; then
+  eval "$(PYTHONPATH="$(cd ../system && pwd):$PYTHONPATH" /usr/bin/env python3 -m isctest)"
+fi
+. ../system/conf.sh
+
+cat >rndc.conf <<EOF
+key rndc_key {
+        secret "1234abcd8765";
+        algorithm hmac-md5;
+};
+
+options {
+        default-key rndc_key;
+        default-server 127.0.0.1;
+        default-port 9953;
+};
+EOF
+
+now() {
+  $PERL -MTime::HiRes=time -e 'printf "%.3f\n", time'
+}
+
+elapsed() {
+  echo "$1 $2" | awk '{ printf "%.3f\n", $2 - $1 }'
+}
+
+# Start named with the current named.conf and wait until it is running;
+# set $startup to the time this took and $rss to its resident size in kB.
+start() {
+  rm -f named.log*
+  t0=$(now)
+  $NAMED -c named.conf -f >/dev/null 2>&1 &
+  pid=$!
+  while ! grep "running$" named.log >/dev/null 2>&1; do
+    if ! kill -0 $pid 2>/dev/null; then
+      echo "named failed to start" >&2
+      exit 1
+    fi
+    sleep 0.1
+  done
+  startup=$(elapsed "$t0" "$(now)")
+  rss=$(ps -o rss= -p $pid | tr -d ' ')
+}
+
+stop() {
+  $RNDC -c rndc.conf stop >/dev/null 2>&1 || kill $pid
+  wait $pid
+}
+
+# A server with no zones at all, to measure the fixed costs against.
+sh setup.sh 0 >named.conf
+start
+base_startup=$startup
+base_rss=$rss
+stop
+
+# Many small zones, and a reconfiguration of the server that has them.
+sh setup.sh "$nzones" "$nrecords" >named.conf
+start
+zones_startup=$startup
+zones_rss=$rss
+t0=$(now)
+$RNDC -c rndc.conf reconfig >/dev/null
+while $RNDC -c rndc.conf status | grep "reload/reconfig in progress" >/dev/null; do
+  sleep 0.1
+done
+reconfig=$(elapsed "$t0" "$(now)")
+stop
+
+# One large zone.
+sh setup.sh 0 >named.conf
+[ -d zones ] || mkdir zones
+$PERL mkzonefile.pl large.example "$nlarge" >zones/large.example.db
+echo 'zone large.example { type primary; file "zones/large.example.db"; };' >>named.conf
+start
+large_startup=$startup
+stop
+
+commit=$(git rev-parse HEAD 2>/dev/null || echo unknown)
+mem_per_zone=$(echo "$base_rss $zones_rss $nzones" | awk '{ printf "%.3f\n", ($2 - $1) / $3 }')
+load_per_million=$(echo "$base_startup $large_startup $nlarge" | awk '{ printf "%.3f\n", ($2 - $1) * 1000000 / $3 }')
+
+echo "startup: ${zones_startup} s for ${nzones} zones (${base_startup} s with none)"
+echo "memory: ${mem_per_zone} kB per zone"
+echo "load: ${load_per_million} s per million records"
+echo "reconfig: ${reconfig} s for ${nzones} zones"
+
+cat >>"$results" <<EOF
+{"commit": "$commit", "date": "$(date -u +%Y-%m-%dT%H:%M:%SZ)", "zones": $nzones, "records": $nrecords, "large": $nlarge, "startup_s": $zones_startup, "base_startup_s": $base_startup, "base_rss_kb": $base_rss, "rss_kb": $zones_rss, "mem_per_zone_kb": $mem_per_zone, "load_s_per_million": $load_per_million, "reconfig_s": $reconfig}
+EOF
+
+sh clean.sh
@@ -38,6 +38,7 @@ nrecords=5
 cat <<EOF
 options {
         directory "$(pwd)";
+        pid-file "$(pwd)/named.pid";
         listen-on { localhost; };
         listen-on-v6 { localhost; };
 	port 5300;
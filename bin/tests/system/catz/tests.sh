@@ -2602,6 +2602,164 @@ wait_for_message ns2/named.run "catz: adding zone 'dom19.example' from catalog '
 if [ $ret -ne 0 ]; then echo_i "failed"; fi
 status=$((status + ret))
 
+##########################################################################
+echo_i "Testing catalog zone updates from the journal"
+n=$((n + 1))
+echo_i "adding domains jnl1.example. and jnl2.example. to primary via RNDC ($n)"
+ret=0
+for zone in jnl1.example jnl2.example; do
+  echo "@ 3600 IN SOA . . 1 3600 3600 3600 3600" >ns1/$zone.db
+  echo "@ 3600 IN NS invalid." >>ns1/$zone.db
+  rndccmd 10.53.0.1 addzone $zone. in default "{ type primary; file \"$zone.db\"; };" || ret=1
+done
+wait_for_soa @10.53.0.1 jnl1.example. dig.out.test$n.1 || ret=1
+wait_for_soa @10.53.0.1 jnl2.example. dig.out.test$n.2 || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "adding domain jnl1.example. to catalog1 zone ($n)"
+ret=0
+$NSUPDATE -d <<END >>nsupdate.out.test$n 2>&1 || ret=1
+    server 10.53.0.1 ${PORT}
+    update add jnl1.zones.catalog1.example. 3600 IN PTR jnl1.example.
+    send
+END
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that the member zone was added from the journal ($n)"
+ret=0
+wait_for_message ns2/named.run "catz: catalog1.example: 1 member zones changed in the journal" \
+  && wait_for_message ns2/named.run "catz: adding zone 'jnl1.example' from catalog 'catalog1.example'" || ret=1
+wait_for_soa @10.53.0.2 jnl1.example. dig.out.test$n || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "modifying domain jnl1.example. in catalog1 zone ($n)"
+ret=0
+# default minimum update rate is once / 5 seconds
+sleep 5
+$NSUPDATE -d <<END >>nsupdate.out.test$n 2>&1 || ret=1
+    server 10.53.0.1 ${PORT}
+    update add allow-query.ext.jnl1.zones.catalog1.example. 3600 IN APL 1:10.53.0.1/32
+    send
+END
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that the member zone was modified from the journal ($n)"
+ret=0
+wait_for_message ns2/named.run "catz: catalog1.example: 1 member zones changed in the journal" \
+  && wait_for_message ns2/named.run "catz: modifying zone 'jnl1.example' from catalog 'catalog1.example'" || ret=1
+wait_for_rcode REFUSED SOA @10.53.0.2 jnl1.example. dig.out.test$n -b 10.53.0.2 || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "removing domain jnl1.example. from catalog1 zone ($n)"
+ret=0
+sleep 5
+$NSUPDATE -d <<END >>nsupdate.out.test$n 2>&1 || ret=1
+    server 10.53.0.1 ${PORT}
+    update delete jnl1.zones.catalog1.example.
+    update delete allow-query.ext.jnl1.zones.catalog1.example.
+    send
+END
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that the member zone was removed from the journal ($n)"
+ret=0
+wait_for_message ns2/named.run "catz: catalog1.example: 1 member zones changed in the journal" \
+  && wait_for_message ns2/named.run "catz: catz_delzone_cb: zone 'jnl1.example' deleted" || ret=1
+wait_for_no_soa @10.53.0.2 jnl1.example. dig.out.test$n || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "changing the version record and adding domain jnl2.example. in the same update ($n)"
+ret=0
+sleep 5
+$NSUPDATE -d <<END >>nsupdate.out.test$n 2>&1 || ret=1
+    server 10.53.0.1 ${PORT}
+    update add version.catalog1.example. 60 IN TXT "2"
+    update add jnl2.zones.catalog1.example. 3600 IN PTR jnl2.example.
+    send
+END
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that all member zones were processed ($n)"
+ret=0
+wait_for_message ns2/named.run "catz: zone 'catalog1.example' cannot be updated from the journal" \
+  && wait_for_message ns2/named.run "catz: adding zone 'jnl2.example' from catalog 'catalog1.example'" || ret=1
+wait_for_soa @10.53.0.2 jnl2.example. dig.out.test$n || ret=1
+nextpartpeek ns2/named.run | grep "member zones changed in the journal" >/dev/null && ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that the full walk left the other member zones alone ($n)"
+ret=0
+nextpartpeek ns2/named.run | grep -E "catz: (adding|modifying|deleting) zone '(dom|jnl1)" >/dev/null && ret=1
+wait_for_no_soa @10.53.0.2 jnl1.example. dig.out.test$n.1 || ret=1
+wait_for_soa @10.53.0.2 dom2.example. dig.out.test$n.2 || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "retransferring catalog1 zone ($n)"
+ret=0
+sleep 5
+rndccmd 10.53.0.2 retransfer catalog1.example >/dev/null 2>&1 || ret=1
+wait_for_message ns2/named.run "transfer of 'catalog1.example/IN/default' from 10.53.0.1#${PORT}: Transfer status: success" || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+n=$((n + 1))
+echo_i "checking that a transferred catalog zone is processed in full ($n)"
+ret=0
+wait_for_message ns2/named.run "catz: update_from_db: new zone merged" || ret=1
+nextpartpeek ns2/named.run | grep "member zones changed in the journal" >/dev/null && ret=1
+nextpartpeek ns2/named.run | grep -E "catz: (adding|modifying|deleting) zone '" >/dev/null && ret=1
+wait_for_soa @10.53.0.2 jnl2.example. dig.out.test$n.1 || ret=1
+wait_for_no_soa @10.53.0.2 jnl1.example. dig.out.test$n.2 || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+nextpart ns2/named.run >/dev/null
+
+n=$((n + 1))
+echo_i "removing domain jnl2.example. from catalog1 zone after the transfer ($n)"
+ret=0
+sleep 5
+$NSUPDATE -d <<END >>nsupdate.out.test$n 2>&1 || ret=1
+    server 10.53.0.1 ${PORT}
+    update delete jnl2.zones.catalog1.example.
+    send
+END
+wait_for_message ns2/named.run "catz: catalog1.example: 1 member zones changed in the journal" \
+  && wait_for_message ns2/named.run "catz: catz_delzone_cb: zone 'jnl2.example' deleted" || ret=1
+wait_for_no_soa @10.53.0.2 jnl2.example. dig.out.test$n || ret=1
+if [ $ret -ne 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
 ##########################################################################
 n=$((n + 1))
 echo_i "Adding a domain tls1.example. to primary via RNDC ($n)"
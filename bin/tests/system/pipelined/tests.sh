@@ -67,6 +67,21 @@ status=$((status + ret))
 n=$((n + 1))
 ret=0
 
+echo_i "check pipelined TCP queries using mdig +parallel ($n)"
+rndccmd 10.53.0.4 flush
+wait_for_log 10 "flushing caches in all views succeeded" ns4/named.run
+mdig_with_opts +noall +answer +vc +parallel=2 -f input -b 10.53.0.4 @10.53.0.4 >raw.mdig.$n
+awk '{ print $1 " " $5 }' <raw.mdig.$n >output.mdig.$n
+sort <output.mdig.$n >output-sorted.mdig.$n
+diff ref output-sorted.mdig.$n || {
+  ret=1
+  echo_i "diff sorted failed"
+}
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+n=$((n + 1))
+ret=0
+
 echo_i "check mdig -4 -6 ($n)"
 mdig_with_opts -4 -6 -f input @10.53.0.4 >output.mdig.$n 2>&1 && ret=1
 grep "only one of -4 and -6 allowed" output.mdig.$n >/dev/null || ret=1
@@ -30,10 +30,16 @@ rm -f ./ns1/dnamed.db
 rm -f ./ns1/dnamed.db.signed
 rm -f ./ns1/minimal.db
 rm -f ./ns1/minimal.db.signed
+rm -f ./ns1/nsec3.db
+rm -f ./ns1/nsec3.db.signed
+rm -f ./ns1/optout.db
+rm -f ./ns1/optout.db.signed
 rm -f ./ns1/root.db
 rm -f ./ns1/root.db.signed
 rm -f ./ns1/soa-without-dnskey.db
 rm -f ./ns1/soa-without-dnskey.db.signed
+rm -f ./ns1/too-many-iterations.db
+rm -f ./ns1/too-many-iterations.db.signed
 rm -f ./ns1/trusted.conf
 rm -f ./ns2/named_dump.db
 rm -f ./ns*/managed-keys.bind*
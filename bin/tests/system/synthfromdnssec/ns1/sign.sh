@@ -63,6 +63,34 @@ cat "$infile" "$keyname.key" >"$zonefile"
 # do not regenerate NSEC chain as there in a minimal NSEC record present
 $SIGNER -P -Z nonsecify -o $zone $zonefile >/dev/null
 
+zone=nsec3
+infile=nsec3.db.in
+zonefile=nsec3.db
+
+keyname=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} -n zone $zone)
+cat "$infile" "$keyname.key" >"$zonefile"
+
+$SIGNER -P -3 - -H 0 -o $zone $zonefile >/dev/null
+
+zone=optout
+infile=optout.db.in
+zonefile=optout.db
+
+keyname=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} -n zone $zone)
+cat "$infile" "$keyname.key" >"$zonefile"
+
+$SIGNER -P -3 - -H 0 -A -o $zone $zonefile >/dev/null
+
+zone=too-many-iterations
+infile=nsec3.db.in
+zonefile=too-many-iterations.db
+
+keyname=$($KEYGEN -q -a ${DEFAULT_ALGORITHM} -n zone $zone)
+cat "$infile" "$keyname.key" >"$zonefile"
+
+# negative answers from this zone are insecure
+$SIGNER -P -3 - -H too-many -o $zone $zonefile >/dev/null 2>&1
+
 zone=.
 infile=root.db.in
 zonefile=root.db
@@ -889,5 +889,128 @@ n=$((n + 1))
 if [ $ret != 0 ]; then echo_i "failed"; fi
 status=$((status + ret))
 
+nsec3_hash() {
+  $NSEC3HASH - 1 0 "$1" | awk '{print $1}'
+}
+
+for zone in nsec3 optout too-many-iterations; do
+  case $zone in
+    nsec3 | optout) ad=yes ;;
+    too-many-iterations) ad=no ;;
+    *) exit 1 ;;
+  esac
+
+  echo_i "prime NSEC3 chain of ${zone}. ($n)"
+  ret=0
+  dig_with_opts a.${zone}. @10.53.0.5 a >dig.out.ns5-1.test$n || ret=1
+  check_ad_flag $ad dig.out.ns5-1.test$n || ret=1
+  check_status NXDOMAIN dig.out.ns5-1.test$n || ret=1
+  dig_with_opts nodata.${zone}. @10.53.0.5 a >dig.out.ns5-2.test$n || ret=1
+  check_ad_flag $ad dig.out.ns5-2.test$n || ret=1
+  check_status NOERROR dig.out.ns5-2.test$n || ret=1
+  dig_with_opts ns1.${zone}. @10.53.0.5 txt >dig.out.ns5-3.test$n || ret=1
+  check_ad_flag $ad dig.out.ns5-3.test$n || ret=1
+  check_status NOERROR dig.out.ns5-3.test$n || ret=1
+  n=$((n + 1))
+  if [ $ret != 0 ]; then echo_i "failed"; fi
+  status=$((status + ret))
+done
+
+#
+# ensure TTL of synthesised answers differs from direct answers.
+#
+sleep 1
+
+echo_i "check synthesized NXDOMAIN response from NSEC3 ($n)"
+ret=0
+nextpart ns1/named.run >/dev/null
+dig_with_opts b.nsec3. @10.53.0.5 a >dig.out.ns5.test$n || ret=1
+check_ad_flag yes dig.out.ns5.test$n || ret=1
+check_status NXDOMAIN dig.out.ns5.test$n || ret=1
+check_synth_soa nsec3. dig.out.ns5.test$n || ret=1
+nextpart ns1/named.run | grep b.nsec3/A >/dev/null && ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+echo_i "check synthesized NODATA response from NSEC3 ($n)"
+ret=0
+nextpart ns1/named.run >/dev/null
+dig_with_opts nodata.nsec3. @10.53.0.5 aaaa >dig.out.ns5.test$n || ret=1
+check_ad_flag yes dig.out.ns5.test$n || ret=1
+check_status NOERROR dig.out.ns5.test$n || ret=1
+check_synth_soa nsec3. dig.out.ns5.test$n || ret=1
+nextpart ns1/named.run | grep nodata.nsec3/AAAA >/dev/null && ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+echo_i "check synthesized NXDOMAIN response covered by the end of the NSEC3 chain ($n)"
+ret=0
+# find a name hashing before the first NSEC3 owner name in the zone
+first=$(for name in nsec3. ns1.nsec3. nodata.nsec3.; do nsec3_hash $name; done | LC_ALL=C sort | head -n 1)
+wrap=
+i=0
+while [ $i -lt 100 ]; do
+  i=$((i + 1))
+  hash=$(nsec3_hash wrap$i.nsec3.)
+  if [ "$(printf '%s\n%s\n' "$hash" "$first" | LC_ALL=C sort | head -n 1)" = "$hash" ]; then
+    wrap=wrap$i.nsec3.
+    break
+  fi
+done
+[ -n "$wrap" ] || ret=1
+nextpart ns1/named.run >/dev/null
+dig_with_opts $wrap @10.53.0.5 a >dig.out.ns5.test$n || ret=1
+check_ad_flag yes dig.out.ns5.test$n || ret=1
+check_status NXDOMAIN dig.out.ns5.test$n || ret=1
+check_synth_soa nsec3. dig.out.ns5.test$n || ret=1
+nextpart ns1/named.run | grep "${wrap%.}/A" >/dev/null && ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+echo_i "check NXDOMAIN response is not synthesized from opt-out NSEC3 ($n)"
+ret=0
+nextpart ns1/named.run >/dev/null
+dig_with_opts b.optout. @10.53.0.5 a >dig.out.ns5.test$n || ret=1
+check_ad_flag yes dig.out.ns5.test$n || ret=1
+check_status NXDOMAIN dig.out.ns5.test$n || ret=1
+check_nosynth_soa optout. dig.out.ns5.test$n || ret=1
+nextpart ns1/named.run | grep b.optout/A >/dev/null || ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+echo_i "check synthesized NODATA response from opt-out NSEC3 ($n)"
+ret=0
+nextpart ns1/named.run >/dev/null
+dig_with_opts nodata.optout. @10.53.0.5 aaaa >dig.out.ns5.test$n || ret=1
+check_ad_flag yes dig.out.ns5.test$n || ret=1
+check_status NOERROR dig.out.ns5.test$n || ret=1
+check_synth_soa optout. dig.out.ns5.test$n || ret=1
+nextpart ns1/named.run | grep nodata.optout/AAAA >/dev/null && ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
+echo_i "check negative responses are not synthesized from NSEC3 with too many iterations ($n)"
+ret=0
+nextpart ns1/named.run >/dev/null
+dig_with_opts b.too-many-iterations. @10.53.0.5 a >dig.out.ns5-1.test$n || ret=1
+check_ad_flag no dig.out.ns5-1.test$n || ret=1
+check_status NXDOMAIN dig.out.ns5-1.test$n || ret=1
+check_nosynth_soa too-many-iterations. dig.out.ns5-1.test$n || ret=1
+dig_with_opts nodata.too-many-iterations. @10.53.0.5 aaaa >dig.out.ns5-2.test$n || ret=1
+check_ad_flag no dig.out.ns5-2.test$n || ret=1
+check_status NOERROR dig.out.ns5-2.test$n || ret=1
+check_nosynth_soa too-many-iterations. dig.out.ns5-2.test$n || ret=1
+nextpart ns1/named.run >ns1.queries.test$n
+grep b.too-many-iterations/A ns1.queries.test$n >/dev/null || ret=1
+grep nodata.too-many-iterations/AAAA ns1.queries.test$n >/dev/null || ret=1
+n=$((n + 1))
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
 echo_i "exit status: $status"
 [ $status -eq 0 ] || exit 1
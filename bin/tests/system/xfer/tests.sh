@@ -612,6 +612,47 @@ grep -F "$msg" ns6/named.run >/dev/null || tmp=1
 if test $tmp != 0; then echo_i "failed"; fi
 status=$((status + tmp))
 
+# The large zones are transferred when ns6 starts, so search the
+# whole log.
+grep_ns6_log() {
+  grep -F "$1" ns6/named.run >/dev/null
+}
+
+n=$((n + 1))
+echo_i "test that a large AXFR is complete when reading is paused ($n)"
+tmp=0
+# ns6 pauses reading while more than 1000 changes (-T xfrinmaxqueued)
+# are waiting to be applied, i.e. after every batch.
+msg="'axfr-large/IN' from 10.53.0.1#${PORT}: Transfer status: success"
+retry_quiet 60 grep_ns6_log "$msg" || tmp=1
+msg="'axfr-large/IN' from 10.53.0.1#${PORT}: pausing receive"
+grep -F "$msg" ns6/named.run >/dev/null || tmp=1
+$DIG $DIGOPTS axfr-large. @10.53.0.6 axfr >dig.out.ns6.test$n || tmp=1
+$DIG $DIGOPTS axfr-large. @10.53.0.1 axfr >dig.out.ns1.test$n || tmp=1
+digcomp dig.out.ns1.test$n dig.out.ns6.test$n || tmp=1
+lines=$(grep -c "^host[0-9]*\.axfr-large\..*TXT" dig.out.ns6.test$n || true)
+[ "$lines" -eq 50000 ] || tmp=1
+if test $tmp != 0; then echo_i "failed"; fi
+status=$((status + tmp))
+
+n=$((n + 1))
+echo_i "test that an AXFR failing while reading is paused is cleaned up ($n)"
+tmp=0
+msg="'axfr-large-too-big/IN' from 10.53.0.1#${PORT}: Transfer status: too many records"
+retry_quiet 60 grep_ns6_log "$msg" || tmp=1
+msg="'axfr-large-too-big/IN' from 10.53.0.1#${PORT}: pausing receive"
+grep -F "$msg" ns6/named.run >/dev/null || tmp=1
+# The failed transfer is gone, so a new one can be started and fails
+# the same way.
+nextpart ns6/named.run >/dev/null
+$RNDCCMD 10.53.0.6 retransfer axfr-large-too-big 2>&1 | sed 's/^/ns6 /' | cat_i
+msg="'axfr-large-too-big/IN' from 10.53.0.1#${PORT}: Transfer status: too many records"
+wait_for_log 60 "$msg" ns6/named.run || tmp=1
+$DIG -p ${PORT} axfr-large-too-big. @10.53.0.6 soa >dig.out.ns6.test$n || tmp=1
+grep "status: SERVFAIL" dig.out.ns6.test$n >/dev/null || tmp=1
+if test $tmp != 0; then echo_i "failed"; fi
+status=$((status + tmp))
+
 n=$((n + 1))
 echo_i "checking whether dig calculates AXFR statistics correctly ($n)"
 tmp=0
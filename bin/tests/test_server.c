@@ -245,7 +245,8 @@ run(void) {
 	switch (protocol) {
 	case UDP:
 		result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &sockaddr,
-					  read_cb, NULL, &sock);
+					  ISC_NM_UDP_RECVBATCH_DEFAULT, read_cb,
+					  NULL, &sock);
 		break;
 	case TCP:
 		result = isc_nm_listenstreamdns(netmgr, ISC_NM_LISTEN_ALL,
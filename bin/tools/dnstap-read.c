@@ -41,8 +41,11 @@
 #include <isc/commandline.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/dnstap.h>
@@ -50,6 +53,9 @@
 #include <dns/masterdump.h>
 #include <dns/message.h>
 #include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
 
 #include "dnstap.pb-c.h"
 
@@ -59,6 +65,54 @@ bool printmessage = false;
 bool hexmessage = false;
 bool yaml = false;
 bool timestampmillis = false;
+bool csv = false;
+
+/*
+ * Filters, applied to the unpacked dnstap frame and the header and
+ * question of the DNS message, before the message is parsed in full.
+ */
+dns_fixedname_t fsuffix;
+dns_name_t *suffix = NULL;
+bool filterrcode = false;
+dns_rcode_t rcode = dns_rcode_noerror;
+bool filteraddr = false;
+isc_netaddr_t prefix;
+unsigned int prefixlen = 0;
+
+/*
+ * Frames are read from the file in batches of BATCH_FRAMES, and each
+ * batch is split into one contiguous slice per thread.  Every slice is
+ * formatted into a memory stream of its own, and the streams are then
+ * written out in order, so that the output does not depend on the
+ * number of threads.  The next batch is read while the current one
+ * is being formatted.
+ */
+#define BATCH_FRAMES 4096
+
+typedef struct {
+	uint8_t *data;
+	size_t size;
+} frame_t;
+
+typedef struct {
+	frame_t *frames;
+	size_t count;
+	char *text;
+	size_t length;
+	bool printed;
+} slice_t;
+
+typedef struct {
+	Dnstap__Message *m;
+	bool query;
+	dns_fixedname_t fname;
+	dns_name_t *qname;
+	dns_rdatatype_t qtype;
+	dns_rdataclass_t qclass;
+	bool hasrcode;
+	dns_rcode_t rcode;
+	size_t size;
+} summary_t;
 
 const char *program = "dnstap-read";
 
@@ -89,9 +143,15 @@ fatal(const char *format, ...) {
 
 static void
 usage(void) {
-	fprintf(stderr, "dnstap-read [-mpxy] [filename]\n");
+	fprintf(stderr, "dnstap-read [-cmptxy] [-a prefix] [-N threads] "
+			"[-q suffix] [-r rcode] [filename]\n");
+	fprintf(stderr, "\t-a\tonly messages from clients in prefix\n");
+	fprintf(stderr, "\t-c\tprint one line of CSV per message\n");
 	fprintf(stderr, "\t-m\ttrace memory allocations\n");
+	fprintf(stderr, "\t-N\tnumber of decoding threads\n");
 	fprintf(stderr, "\t-p\tprint the full DNS message\n");
+	fprintf(stderr, "\t-q\tonly messages for names at or below suffix\n");
+	fprintf(stderr, "\t-r\tonly responses with rcode\n");
 	fprintf(stderr,
 		"\t-t\tprint long timestamps with millisecond precision\n");
 	fprintf(stderr, "\t-x\tuse hex format to print DNS message\n");
@@ -99,7 +159,7 @@ usage(void) {
 }
 
 static void
-print_dtdata(dns_dtdata_t *dt) {
+print_dtdata(FILE *out, dns_dtdata_t *dt) {
 	isc_result_t result;
 	isc_buffer_t *b = NULL;
 
@@ -109,8 +169,8 @@ print_dtdata(dns_dtdata_t *dt) {
 	}
 
 	CHECKM(dns_dt_datatotext(dt, &b), "dns_dt_datatotext");
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	fprintf(out, "%.*s\n", (int)isc_buffer_usedlength(b),
+		(char *)isc_buffer_base(b));
 
 cleanup:
 	if (b != NULL) {
@@ -119,7 +179,7 @@ cleanup:
 }
 
 static void
-print_hex(dns_dtdata_t *dt) {
+print_hex(FILE *out, dns_dtdata_t *dt) {
 	isc_buffer_t *b = NULL;
 	isc_result_t result;
 	size_t textlen;
@@ -137,8 +197,8 @@ print_hex(dns_dtdata_t *dt) {
 	result = isc_hex_totext(&dt->msgdata, 0, "", b);
 	CHECKM(result, "isc_hex_totext");
 
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	fprintf(out, "%.*s\n", (int)isc_buffer_usedlength(b),
+		(char *)isc_buffer_base(b));
 
 cleanup:
 	if (b != NULL) {
@@ -147,7 +207,7 @@ cleanup:
 }
 
 static void
-print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
+print_packet(FILE *out, dns_dtdata_t *dt, const dns_master_style_t *style) {
 	isc_buffer_t *b = NULL;
 	isc_result_t result;
 
@@ -171,8 +231,9 @@ print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
 				textlen *= 2;
 				continue;
 			} else if (result == ISC_R_SUCCESS) {
-				printf("%.*s", (int)isc_buffer_usedlength(b),
-				       (char *)isc_buffer_base(b));
+				fprintf(out, "%.*s",
+					(int)isc_buffer_usedlength(b),
+					(char *)isc_buffer_base(b));
 				isc_buffer_free(&b);
 			} else {
 				isc_buffer_free(&b);
@@ -189,11 +250,10 @@ cleanup:
 }
 
 static void
-print_yaml(dns_dtdata_t *dt) {
+print_yaml(FILE *out, dns_dtdata_t *dt, bool *first) {
 	Dnstap__Dnstap *frame = dt->frame;
 	Dnstap__Message *m = frame->message;
 	const ProtobufCEnumValue *ftype, *mtype;
-	static bool first = true;
 
 	ftype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__dnstap__type__descriptor, frame->type);
@@ -201,29 +261,29 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	if (!first) {
-		printf("---\n");
+	if (!*first) {
+		fprintf(out, "---\n");
 	} else {
-		first = false;
+		*first = false;
 	}
 
-	printf("type: %s\n", ftype->name);
+	fprintf(out, "type: %s\n", ftype->name);
 
 	if (frame->has_identity) {
-		printf("identity: %.*s\n", (int)frame->identity.len,
-		       frame->identity.data);
+		fprintf(out, "identity: %.*s\n", (int)frame->identity.len,
+			frame->identity.data);
 	}
 
 	if (frame->has_version) {
-		printf("version: %.*s\n", (int)frame->version.len,
-		       frame->version.data);
+		fprintf(out, "version: %.*s\n", (int)frame->version.len,
+			frame->version.data);
 	}
 
 	if (frame->type != DNSTAP__DNSTAP__TYPE__MESSAGE) {
 		return;
 	}
 
-	printf("message:\n");
+	fprintf(out, "message:\n");
 
 	mtype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__message__type__descriptor, m->type);
@@ -231,7 +291,7 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	printf("  type: %s\n", mtype->name);
+	fprintf(out, "  type: %s\n", mtype->name);
 
 	if (!isc_time_isepoch(&dt->qtime)) {
 		char buf[100];
@@ -240,7 +300,7 @@ print_yaml(dns_dtdata_t *dt) {
 		} else {
 			isc_time_formatISO8601(&dt->qtime, buf, sizeof(buf));
 		}
-		printf("  query_time: !!timestamp %s\n", buf);
+		fprintf(out, "  query_time: !!timestamp %s\n", buf);
 	}
 
 	if (!isc_time_isepoch(&dt->rtime)) {
@@ -250,13 +310,14 @@ print_yaml(dns_dtdata_t *dt) {
 		} else {
 			isc_time_formatISO8601(&dt->rtime, buf, sizeof(buf));
 		}
-		printf("  response_time: !!timestamp %s\n", buf);
+		fprintf(out, "  response_time: !!timestamp %s\n", buf);
 	}
 
 	if (dt->msgdata.base != NULL) {
-		printf("  message_size: %zub\n", (size_t)dt->msgdata.length);
+		fprintf(out, "  message_size: %zub\n",
+			(size_t)dt->msgdata.length);
 	} else {
-		printf("  message_size: 0b\n");
+		fprintf(out, "  message_size: 0b\n");
 	}
 
 	if (m->has_socket_family) {
@@ -265,12 +326,12 @@ print_yaml(dns_dtdata_t *dt) {
 				&dnstap__socket_family__descriptor,
 				m->socket_family);
 		if (type != NULL) {
-			printf("  socket_family: %s\n", type->name);
+			fprintf(out, "  socket_family: %s\n", type->name);
 		}
 	}
 
-	printf("  socket_protocol: %s\n",
-	       dt->transport == DNS_TRANSPORT_UDP ? "UDP" : "TCP");
+	fprintf(out, "  socket_protocol: %s\n",
+		dt->transport == DNS_TRANSPORT_UDP ? "UDP" : "TCP");
 
 	if (m->has_query_address) {
 		ProtobufCBinaryData *ip = &m->query_address;
@@ -278,7 +339,7 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  query_address: \"%s\"\n", buf);
+		fprintf(out, "  query_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_response_address) {
@@ -287,15 +348,15 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  response_address: \"%s\"\n", buf);
+		fprintf(out, "  response_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_query_port) {
-		printf("  query_port: %u\n", m->query_port);
+		fprintf(out, "  query_port: %u\n", m->query_port);
 	}
 
 	if (m->has_response_port) {
-		printf("  response_port: %u\n", m->response_port);
+		fprintf(out, "  response_port: %u\n", m->response_port);
 	}
 
 	if (m->has_query_zone) {
@@ -312,25 +373,368 @@ print_yaml(dns_dtdata_t *dt) {
 		result = dns_name_fromwire(name, &b, DNS_DECOMPRESS_NEVER,
 					   NULL);
 		if (result == ISC_R_SUCCESS) {
-			printf("  query_zone: ");
-			dns_name_print(name, stdout);
-			printf("\n");
+			fprintf(out, "  query_zone: ");
+			dns_name_print(name, out);
+			fprintf(out, "\n");
 		}
 	}
 
 	if (dt->msg != NULL) {
 		dt->msg->indent.count = 2;
 		dt->msg->indent.string = "  ";
-		printf("  %s:\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					  ? "query_message_data"
-					  : "response_message_data");
+		fprintf(out, "  %s:\n",
+			((dt->type & DNS_DTTYPE_QUERY) != 0)
+				? "query_message_data"
+				: "response_message_data");
+
+		print_packet(out, dt, &dns_master_style_yaml);
+
+		fprintf(out, "  %s: |\n",
+			((dt->type & DNS_DTTYPE_QUERY) != 0)
+				? "query_message"
+				: "response_message");
+		print_packet(out, dt, &dns_master_style_indent);
+	}
+}
+
+/*
+ * Fill in 's' from the dnstap frame and the header and question of
+ * the DNS message in it, without parsing the rest of the message.
+ * Return false if the frame does not hold a DNS message.
+ */
+static bool
+summarize(Dnstap__Dnstap *frame, summary_t *s) {
+	Dnstap__Message *m = frame->message;
+	ProtobufCBinaryData *wire = NULL;
+	isc_buffer_t b;
+
+	if (frame->type != DNSTAP__DNSTAP__TYPE__MESSAGE || m == NULL) {
+		return (false);
+	}
+
+	*s = (summary_t){
+		.m = m,
+		/* The query message types are the odd ones. */
+		.query = (m->type % 2) == 1,
+	};
+
+	if (s->query && m->has_query_message) {
+		wire = &m->query_message;
+	} else if (!s->query && m->has_response_message) {
+		wire = &m->response_message;
+	}
+	if (wire == NULL || wire->len < DNS_MESSAGE_HEADERLEN) {
+		return (true);
+	}
+
+	s->size = wire->len;
+	s->hasrcode = true;
+	s->rcode = wire->data[3] & 0x0f;
+
+	if (((wire->data[4] << 8) | wire->data[5]) == 0) {
+		return (true);
+	}
+
+	isc_buffer_init(&b, wire->data, wire->len);
+	isc_buffer_add(&b, wire->len);
+	isc_buffer_forward(&b, DNS_MESSAGE_HEADERLEN);
+	s->qname = dns_fixedname_initname(&s->fname);
+	if (dns_name_fromwire(s->qname, &b, DNS_DECOMPRESS_NEVER, NULL) !=
+		    ISC_R_SUCCESS ||
+	    isc_buffer_remaininglength(&b) < 4)
+	{
+		s->qname = NULL;
+		return (true);
+	}
+	s->qtype = isc_buffer_getuint16(&b);
+	s->qclass = isc_buffer_getuint16(&b);
+
+	return (true);
+}
+
+static bool
+match(summary_t *s) {
+	if (suffix != NULL &&
+	    (s->qname == NULL || !dns_name_issubdomain(s->qname, suffix)))
+	{
+		return (false);
+	}
+
+	if (filterrcode && (s->query || !s->hasrcode || s->rcode != rcode)) {
+		return (false);
+	}
+
+	if (filteraddr) {
+		ProtobufCBinaryData *ip = &s->m->query_address;
+		isc_netaddr_t na;
+
+		if (!s->m->has_query_address) {
+			return (false);
+		} else if (ip->len == 4) {
+			struct in_addr in;
+			memmove(&in, ip->data, 4);
+			isc_netaddr_fromin(&na, &in);
+		} else if (ip->len == 16) {
+			struct in6_addr in6;
+			memmove(&in6, ip->data, 16);
+			isc_netaddr_fromin6(&na, &in6);
+		} else {
+			return (false);
+		}
+		if (!isc_netaddr_eqprefix(&na, &prefix, prefixlen)) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+static void
+print_csvaddr(FILE *out, bool has, ProtobufCBinaryData *ip) {
+	char buf[100];
+
+	if (has && (ip->len == 4 || ip->len == 16) &&
+	    inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data, buf,
+		      sizeof(buf)) != NULL)
+	{
+		fprintf(out, "%s", buf);
+	}
+}
+
+static void
+print_csv(FILE *out, summary_t *s) {
+	Dnstap__Message *m = s->m;
+	const ProtobufCEnumValue *value = NULL;
+	char buf[DNS_NAME_FORMATSIZE];
+	isc_time_t t;
+
+	isc_time_settoepoch(&t);
+	if (s->query && m->has_query_time_sec && m->has_query_time_nsec) {
+		isc_time_set(&t, m->query_time_sec, m->query_time_nsec);
+	} else if (!s->query && m->has_response_time_sec &&
+		   m->has_response_time_nsec)
+	{
+		isc_time_set(&t, m->response_time_sec, m->response_time_nsec);
+	}
+	if (!isc_time_isepoch(&t)) {
+		isc_time_formatISO8601ms(&t, buf, sizeof(buf));
+		fprintf(out, "%s", buf);
+	}
+
+	value = protobuf_c_enum_descriptor_get_value(
+		&dnstap__message__type__descriptor, m->type);
+	fprintf(out, ",%s,", value != NULL ? value->name : "");
+
+	if (m->has_socket_protocol) {
+		value = protobuf_c_enum_descriptor_get_value(
+			&dnstap__socket_protocol__descriptor,
+			m->socket_protocol);
+		if (value != NULL) {
+			fprintf(out, "%s", value->name);
+		}
+	}
+
+	fputc(',', out);
+	print_csvaddr(out, m->has_query_address, &m->query_address);
+	fputc(',', out);
+	if (m->has_query_port) {
+		fprintf(out, "%u", m->query_port);
+	}
+	fputc(',', out);
+	print_csvaddr(out, m->has_response_address, &m->response_address);
+	fputc(',', out);
+	if (m->has_response_port) {
+		fprintf(out, "%u", m->response_port);
+	}
+
+	fputc(',', out);
+	if (s->qname != NULL) {
+		dns_name_format(s->qname, buf, sizeof(buf));
+		fputc('"', out);
+		for (const char *c = buf; *c != '\0'; c++) {
+			if (*c == '"') {
+				fputc('"', out);
+			}
+			fputc(*c, out);
+		}
+		fputc('"', out);
+		dns_rdataclass_format(s->qclass, buf, sizeof(buf));
+		fprintf(out, ",%s", buf);
+		dns_rdatatype_format(s->qtype, buf, sizeof(buf));
+		fprintf(out, ",%s,", buf);
+	} else {
+		fprintf(out, ",,,");
+	}
+
+	if (s->hasrcode && !s->query) {
+		isc_buffer_t b;
+
+		isc_buffer_init(&b, buf, sizeof(buf) - 1);
+		if (dns_rcode_totext(s->rcode, &b) == ISC_R_SUCCESS) {
+			fprintf(out, "%.*s", (int)isc_buffer_usedlength(&b),
+				buf);
+		}
+	}
+
+	fprintf(out, ",%zu\n", s->size);
+}
+
+static void
+process_frame(FILE *out, frame_t *f, bool *first) {
+	isc_result_t result;
+	isc_region_t input;
+	dns_dtdata_t *dt = NULL;
+
+	/*
+	 * Unpacking the frame is cheap next to parsing and printing the
+	 * DNS message, so do it first when that can save the rest.
+	 */
+	if (csv || suffix != NULL || filterrcode || filteraddr) {
+		Dnstap__Dnstap *frame = NULL;
+		summary_t s;
+		bool skip;
+
+		frame = dnstap__dnstap__unpack(NULL, f->size, f->data);
+		if (frame == NULL) {
+			return;
+		}
+		skip = !summarize(frame, &s) || !match(&s);
+		if (!skip && csv) {
+			print_csv(out, &s);
+		}
+		dnstap__dnstap__free_unpacked(frame, NULL);
+		if (skip || csv) {
+			return;
+		}
+	}
+
+	input.base = f->data;
+	input.length = f->size;
+
+	result = dns_dt_parse(mctx, &input, &dt);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	if (yaml) {
+		print_yaml(out, dt, first);
+	} else if (hexmessage) {
+		print_dtdata(out, dt);
+		print_hex(out, dt);
+	} else if (printmessage) {
+		print_dtdata(out, dt);
+		print_packet(out, dt, &dns_master_style_debug);
+	} else {
+		print_dtdata(out, dt);
+	}
+
+	dns_dtdata_free(&dt);
+}
 
-		print_packet(dt, &dns_master_style_yaml);
+static void *
+slice_run(void *arg) {
+	slice_t *slice = arg;
+	bool first = true;
+	FILE *out = NULL;
 
-		printf("  %s: |\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					    ? "query_message"
-					    : "response_message");
-		print_packet(dt, &dns_master_style_indent);
+	out = open_memstream(&slice->text, &slice->length);
+	if (out == NULL) {
+		fatal("out of memory");
+	}
+	for (size_t i = 0; i < slice->count; i++) {
+		process_frame(out, &slice->frames[i], &first);
+	}
+	(void)fclose(out);
+	slice->printed = !first;
+
+	return (NULL);
+}
+
+/*
+ * Read up to BATCH_FRAMES frames into 'frames', copying them out of
+ * the reader's buffer, and set '*countp' to the number read; fewer
+ * than that means the end of the file was reached.
+ */
+static isc_result_t
+read_batch(dns_dthandle_t *handle, frame_t *frames, size_t *countp) {
+	isc_result_t result = ISC_R_SUCCESS;
+	size_t count = 0;
+
+	while (count < BATCH_FRAMES) {
+		uint8_t *data = NULL;
+		size_t datalen;
+
+		result = dns_dt_getframe(handle, &data, &datalen);
+		if (result == ISC_R_NOMORE) {
+			result = ISC_R_SUCCESS;
+			break;
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		frames[count].data = isc_mem_get(mctx, datalen);
+		frames[count].size = datalen;
+		memmove(frames[count].data, data, datalen);
+		count++;
+	}
+
+	*countp = count;
+	return (result);
+}
+
+/*
+ * Split 'count' frames into at most 'nthreads' slices, and start
+ * formatting all of them but the first in threads of their own.
+ */
+static unsigned int
+batch_start(frame_t *frames, size_t count, slice_t *slices,
+	    isc_thread_t *threads, unsigned int nthreads) {
+	unsigned int nslices = ISC_MIN(nthreads, count);
+
+	for (unsigned int i = 0; i < nslices; i++) {
+		size_t start = count * i / nslices;
+		size_t end = count * (i + 1) / nslices;
+
+		slices[i] = (slice_t){
+			.frames = frames + start,
+			.count = end - start,
+		};
+		if (i > 0) {
+			isc_thread_create(slice_run, &slices[i], &threads[i]);
+		}
+	}
+
+	return (nslices);
+}
+
+/*
+ * Format the first slice in this thread, wait for the others, and
+ * write them all out in order.
+ */
+static void
+batch_finish(slice_t *slices, isc_thread_t *threads, unsigned int nslices,
+	     bool *printed) {
+	if (nslices > 0) {
+		slice_run(&slices[0]);
+	}
+
+	for (unsigned int i = 0; i < nslices; i++) {
+		slice_t *slice = &slices[i];
+
+		if (i > 0) {
+			isc_thread_join(threads[i], NULL);
+		}
+		if (yaml && slice->printed && *printed) {
+			fputs("---\n", stdout);
+		}
+		fwrite(slice->text, 1, slice->length, stdout);
+		free(slice->text);
+		*printed = *printed || slice->printed;
+
+		for (size_t j = 0; j < slice->count; j++) {
+			isc_mem_put(mctx, slice->frames[j].data,
+				    slice->frames[j].size);
+		}
 	}
 }
 
@@ -338,19 +742,94 @@ int
 main(int argc, char *argv[]) {
 	isc_result_t result;
 	dns_message_t *message = NULL;
-	dns_dtdata_t *dt = NULL;
 	dns_dthandle_t *handle = NULL;
-	int rv = 0, ch;
-
-	while ((ch = isc_commandline_parse(argc, argv, "mptxy")) != -1) {
+	frame_t *frames[2] = { NULL, NULL };
+	size_t count[2] = { 0, 0 };
+	slice_t *slices = NULL;
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads = 1;
+	bool printed = false;
+	int rv = 0, ch, cur = 0;
+	char *endp = NULL;
+
+	while ((ch = isc_commandline_parse(argc, argv, "a:cmN:pq:r:txy")) !=
+	       -1)
+	{
 		switch (ch) {
+		case 'a': {
+			char *slash = strchr(isc_commandline_argument, '/');
+			struct in_addr in;
+			struct in6_addr in6;
+
+			if (slash != NULL) {
+				*slash++ = '\0';
+			}
+			if (inet_pton(AF_INET, isc_commandline_argument, &in) ==
+			    1)
+			{
+				isc_netaddr_fromin(&prefix, &in);
+				prefixlen = 32;
+			} else if (inet_pton(AF_INET6, isc_commandline_argument,
+					     &in6) == 1)
+			{
+				isc_netaddr_fromin6(&prefix, &in6);
+				prefixlen = 128;
+			} else {
+				fatal("invalid address: %s",
+				      isc_commandline_argument);
+			}
+			if (slash != NULL) {
+				prefixlen = strtoul(slash, &endp, 10);
+				if (*slash == '\0' || *endp != '\0' ||
+				    isc_netaddr_prefixok(&prefix, prefixlen) !=
+					    ISC_R_SUCCESS)
+				{
+					fatal("invalid prefix length: %s",
+					      slash);
+				}
+			}
+			filteraddr = true;
+			break;
+		}
+		case 'c':
+			csv = true;
+			break;
 		case 'm':
 			isc_mem_debugging |= ISC_MEM_DEBUGRECORD;
 			memrecord = true;
 			break;
+		case 'N':
+			nthreads = strtoul(isc_commandline_argument, &endp, 10);
+			if (*endp != '\0' || nthreads == 0) {
+				fatal("invalid number of threads: %s",
+				      isc_commandline_argument);
+			}
+			break;
 		case 'p':
 			printmessage = true;
 			break;
+		case 'q':
+			suffix = dns_fixedname_initname(&fsuffix);
+			result = dns_name_fromstring(suffix,
+						     isc_commandline_argument,
+						     dns_rootname, 0, NULL);
+			if (result != ISC_R_SUCCESS) {
+				fatal("invalid name: %s",
+				      isc_commandline_argument);
+			}
+			break;
+		case 'r': {
+			isc_textregion_t r;
+
+			r.base = isc_commandline_argument;
+			r.length = strlen(isc_commandline_argument);
+			if (dns_rcode_fromtext(&rcode, &r) != ISC_R_SUCCESS) {
+				fatal("invalid rcode: %s",
+				      isc_commandline_argument);
+			}
+			filterrcode = true;
+			break;
+		}
 		case 't':
 			timestampmillis = true;
 			break;
@@ -378,44 +857,41 @@ main(int argc, char *argv[]) {
 	CHECKM(dns_dt_open(argv[0], dns_dtmode_file, mctx, &handle),
 	       "dns_dt_openfile");
 
-	for (;;) {
-		isc_region_t input;
-		uint8_t *data;
-		size_t datalen;
-
-		result = dns_dt_getframe(handle, &data, &datalen);
-		if (result == ISC_R_NOMORE) {
-			break;
-		} else {
-			CHECKM(result, "dns_dt_getframe");
-		}
-
-		input.base = data;
-		input.length = datalen;
-
-		result = dns_dt_parse(mctx, &input, &dt);
-		if (result != ISC_R_SUCCESS) {
-			continue;
-		}
-
-		if (yaml) {
-			print_yaml(dt);
-		} else if (hexmessage) {
-			print_dtdata(dt);
-			print_hex(dt);
-		} else if (printmessage) {
-			print_dtdata(dt);
-			print_packet(dt, &dns_master_style_debug);
-		} else {
-			print_dtdata(dt);
-		}
+	if (csv) {
+		printf("time,type,protocol,query_address,query_port,"
+		       "response_address,response_port,qname,qclass,qtype,"
+		       "rcode,size\n");
+	}
 
-		dns_dtdata_free(&dt);
+	frames[0] = isc_mem_cget(mctx, BATCH_FRAMES, sizeof(frame_t));
+	frames[1] = isc_mem_cget(mctx, BATCH_FRAMES, sizeof(frame_t));
+	slices = isc_mem_cget(mctx, nthreads, sizeof(slices[0]));
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+
+	CHECKM(read_batch(handle, frames[cur], &count[cur]), "dns_dt_getframe");
+	while (count[cur] > 0) {
+		unsigned int nslices = batch_start(frames[cur], count[cur],
+						   slices, threads, nthreads);
+
+		result = read_batch(handle, frames[!cur], &count[!cur]);
+		batch_finish(slices, threads, nslices, &printed);
+		count[cur] = 0;
+		CHECKM(result, "dns_dt_getframe");
+		cur = !cur;
 	}
 
 cleanup:
-	if (dt != NULL) {
-		dns_dtdata_free(&dt);
+	if (frames[0] != NULL) {
+		for (int i = 0; i < 2; i++) {
+			for (size_t j = 0; j < count[i]; j++) {
+				isc_mem_put(mctx, frames[i][j].data,
+					    frames[i][j].size);
+			}
+		}
+		isc_mem_cput(mctx, frames[0], BATCH_FRAMES, sizeof(frame_t));
+		isc_mem_cput(mctx, frames[1], BATCH_FRAMES, sizeof(frame_t));
+		isc_mem_cput(mctx, slices, nthreads, sizeof(slices[0]));
+		isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
 	}
 	if (handle != NULL) {
 		dns_dt_close(&handle);
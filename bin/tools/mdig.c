@@ -17,11 +17,14 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/base64.h>
 #include <isc/getaddresses.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/managers.h>
@@ -36,9 +39,12 @@
 #include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
 #include <isc/util.h>
 
 #include <dns/byaddr.h>
+#include <dns/compress.h>
 #include <dns/dispatch.h>
 #include <dns/fixedname.h>
 #include <dns/message.h>
@@ -48,6 +54,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/request.h>
+#include <dns/transport.h>
 #include <dns/types.h>
 #include <dns/view.h>
 
@@ -79,6 +86,8 @@
 #define TCPTIMEOUT 10
 #define UDPTIMEOUT 5
 #define MAXTRIES   0xffffffff
+#define MAXQPS	   10000000
+#define MAXLOOPS   1024
 
 static isc_mem_t *mctx = NULL;
 static isc_loopmgr_t *loopmgr = NULL;
@@ -90,6 +99,7 @@ static bool have_ipv4 = false;
 static bool have_ipv6 = false;
 static bool have_src = false;
 static bool tcp_mode = false;
+static bool tls_mode = false;
 static bool besteffort = true;
 static bool display_short_form = false;
 static bool display_headers = true;
@@ -115,12 +125,19 @@ static in_port_t port = 53;
 static unsigned char cookie_secret[33];
 static int onfly = 0;
 static char hexcookie[81];
+static uint32_t nloops = 1;
+static uint32_t parallel = 0;
+static uint32_t qps = 0;
+static uint32_t duration = 10;
 
 static isc_sockaddr_t bind_any;
 static isc_nm_t *netmgr = NULL;
 static dns_dispatchmgr_t *dispatchmgr = NULL;
 static dns_dispatch_t *dispatchvx = NULL;
 static dns_view_t *view = NULL;
+static dns_transport_list_t *transport_list = NULL;
+static dns_transport_t *transport = NULL;
+static isc_tlsctx_cache_t *tlsctx_cache = NULL;
 
 struct query {
 	char textname[MXNAME]; /*% Name we're going to be
@@ -146,10 +163,13 @@ struct query {
 	unsigned int timeout;
 	unsigned int udptimeout;
 	unsigned int udpretries;
+	isc_buffer_t *wire; /*%< rendered once for the load generator */
+	isc_time_t time_sent;
 	ISC_LINK(struct query) link;
 };
 static struct query default_query;
 static ISC_LIST(struct query) queries;
+static struct query *nextquery = NULL;
 
 #define EDNSOPTS 100U
 /*% opcode text */
@@ -186,11 +206,16 @@ rcode_totext(dns_rcode_t rcode) {
 	return (totext.deconsttext);
 }
 
+static void
+sendnext(void);
+
 static void
 recvresponse(void *arg) {
 	dns_request_t *request = (dns_request_t *)arg;
+	struct query *query = dns_request_getarg(request);
+	isc_time_t time_recv = isc_time_now();
 	isc_result_t result;
-	dns_message_t *query = NULL, *response = NULL;
+	dns_message_t *response = NULL;
 	unsigned int parseflags = 0;
 	isc_buffer_t *msgbuf = NULL, *buf = NULL;
 	unsigned int len = OUTPUTBUF;
@@ -198,8 +223,6 @@ recvresponse(void *arg) {
 	unsigned int styleflags = 0;
 	dns_messagetextflag_t flags;
 
-	query = dns_request_getarg(request);
-
 	result = dns_request_getresult(request);
 	if (result != ISC_R_SUCCESS) {
 		fprintf(stderr, "response failed with %s\n",
@@ -293,6 +316,7 @@ recvresponse(void *arg) {
 
 	if (yaml) {
 		char sockstr[ISC_SOCKADDR_FORMATSIZE];
+		char tbuf[100];
 		uint16_t sport;
 		char *hash;
 		int pf;
@@ -308,6 +332,11 @@ recvresponse(void *arg) {
 			printf("    type: AUTH_RESPONSE\n");
 		}
 
+		isc_time_formatISO8601us(&query->time_sent, tbuf, sizeof(tbuf));
+		printf("    query_time: !!timestamp %s\n", tbuf);
+		isc_time_formatISO8601us(&time_recv, tbuf, sizeof(tbuf));
+		printf("    response_time: !!timestamp %s\n", tbuf);
+
 		printf("    message_size: %ub\n",
 		       isc_buffer_usedlength(msgbuf));
 
@@ -529,20 +558,24 @@ repopulate_buffer:
 	       (char *)isc_buffer_base(buf));
 	isc_buffer_free(&buf);
 
+	if (display_comments && !display_short_form && !yaml) {
+		printf(";; Query time: %" PRIu64 " usec\n\n",
+		       isc_time_microdiff(&time_recv, &query->time_sent));
+	}
+
 cleanup:
 	fflush(stdout);
 	if (style != NULL) {
 		dns_master_styledestroy(&style, mctx);
 	}
-	if (query != NULL) {
-		dns_message_detach(&query);
-	}
 	if (response != NULL) {
 		dns_message_detach(&response);
 	}
 	dns_request_destroy(&request);
 
-	if (--onfly == 0) {
+	onfly--;
+	sendnext();
+	if (onfly == 0) {
 		isc_loopmgr_shutdown(loopmgr);
 	}
 	return;
@@ -573,18 +606,14 @@ compute_cookie(unsigned char *cookie, size_t len) {
 	memmove(cookie, cookie_secret, 8);
 }
 
-static isc_result_t
-sendquery(struct query *query) {
-	dns_request_t *request = NULL;
+static void
+buildquery(struct query *query, dns_message_t **messagep) {
 	dns_message_t *message = NULL;
 	dns_name_t *qname = NULL;
 	dns_rdataset_t *qrdataset = NULL;
 	isc_result_t result;
 	dns_fixedname_t queryname;
 	isc_buffer_t buf;
-	unsigned int options = 0;
-
-	onfly++;
 
 	dns_fixedname_init(&queryname);
 	isc_buffer_init(&buf, query->textname, strlen(query->textname));
@@ -619,7 +648,7 @@ sendquery(struct query *query) {
 
 	dns_message_gettemprdataset(message, &qrdataset);
 
-	dns_name_clone(dns_fixedname_name(&queryname), qname);
+	dns_name_copy(dns_fixedname_name(&queryname), qname);
 	dns_rdataset_makequestion(qrdataset, query->rdclass, query->rdtype);
 	ISC_LIST_APPEND(qname->list, qrdataset, link);
 	dns_message_addname(message, qname, DNS_SECTION_QUESTION);
@@ -745,36 +774,293 @@ sendquery(struct query *query) {
 		add_opt(message, query->udpsize, query->edns, flags, opts, i);
 	}
 
-	if (tcp_mode) {
+	*messagep = message;
+}
+
+static isc_result_t
+sendquery(struct query *query) {
+	dns_request_t *request = NULL;
+	dns_message_t *message = NULL;
+	isc_result_t result;
+	unsigned int options = 0;
+
+	onfly++;
+
+	buildquery(query, &message);
+
+	if (tcp_mode || tls_mode) {
 		options |= DNS_REQUESTOPT_TCP;
 	}
 
+	query->time_sent = isc_time_now();
 	result = dns_request_create(
-		requestmgr, message, have_src ? &srcaddr : NULL, &dstaddr, NULL,
-		NULL, options, NULL, query->timeout, query->udptimeout,
-		query->udpretries, isc_loop_main(loopmgr), recvresponse,
-		message, &request);
+		requestmgr, message, have_src ? &srcaddr : NULL, &dstaddr,
+		tls_mode ? transport : NULL, tls_mode ? tlsctx_cache : NULL,
+		options, NULL, query->timeout, query->udptimeout,
+		query->udpretries, isc_loop_main(loopmgr), recvresponse, query,
+		&request);
 	CHECK("dns_request_create", result);
+	dns_message_detach(&message);
 
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Send queries from the list until there are 'parallel' of them in
+ * flight (or all of them, if 'parallel' is 0).  Called again as each
+ * response arrives, to keep the window full.
+ */
 static void
-sendqueries(void *arg) {
-	struct query *query = (struct query *)arg;
-
-	while (query != NULL) {
-		struct query *next = ISC_LIST_NEXT(query, link);
+sendnext(void) {
+	while (nextquery != NULL &&
+	       (parallel == 0 || (uint32_t)onfly < parallel))
+	{
+		struct query *query = nextquery;
 
+		nextquery = ISC_LIST_NEXT(query, link);
 		sendquery(query);
-		query = next;
 	}
+}
+
+static void
+sendqueries(void *arg) {
+	nextquery = (struct query *)arg;
+	sendnext();
 
 	if (onfly == 0) {
 		isc_loopmgr_shutdown(loopmgr);
 	}
 }
 
+/*%
+ * Load generator (+qps).  Each loop sends its share of the target rate
+ * from a 1ms ticker without waiting for the answers, cycling through
+ * queries that were rendered once up front.  The latency of every
+ * answer is recorded in a histogram shared by all the loops.
+ */
+typedef struct loadgen {
+	isc_loop_t *loop;
+	isc_timer_t *timer;
+	size_t next;
+	uint64_t rate;
+	uint64_t start;
+	uint64_t sent;
+	uint64_t received;
+	uint64_t failed;
+	uint64_t outstanding;
+	uint64_t rcodes[16];
+} loadgen_t;
+
+typedef struct loadreq {
+	loadgen_t *gen;
+	uint64_t sent;
+} loadreq_t;
+
+static struct query **loadq = NULL;
+static size_t nloadq = 0;
+static loadgen_t *loadgens = NULL;
+static isc_histomulti_t *latency = NULL;
+static atomic_uint_fast32_t running;
+
+static void
+renderquery(struct query *query) {
+	dns_message_t *message = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t *buf = NULL;
+	isc_region_t r;
+	isc_result_t result;
+
+	buildquery(query, &message);
+
+	isc_buffer_allocate(mctx, &buf, COMMSIZE);
+	dns_compress_init(&cctx, mctx, 0);
+	result = dns_message_renderbegin(message, &cctx, buf);
+	CHECK("dns_message_renderbegin", result);
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_rendersection(message, DNS_SECTION_ADDITIONAL, 0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_renderend(message);
+	CHECK("dns_message_renderend", result);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&message);
+
+	isc_buffer_usedregion(buf, &r);
+	isc_buffer_allocate(mctx, &query->wire, r.length);
+	isc_buffer_putmem(query->wire, r.base, r.length);
+	isc_buffer_free(&buf);
+}
+
+static void
+loaddone(void *arg ISC_ATTR_UNUSED) {
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+loadresponse(void *arg) {
+	dns_request_t *request = (dns_request_t *)arg;
+	loadreq_t *req = dns_request_getarg(request);
+	loadgen_t *gen = req->gen;
+
+	if (dns_request_getresult(request) == ISC_R_SUCCESS) {
+		isc_buffer_t *answer = dns_request_getanswer(request);
+		unsigned char *base = isc_buffer_base(answer);
+
+		isc_histomulti_inc(latency, isc_time_monotonic() - req->sent);
+		gen->received++;
+		if (isc_buffer_usedlength(answer) >= DNS_MESSAGE_HEADERLEN) {
+			gen->rcodes[base[3] & 0x0f]++;
+		}
+	} else {
+		gen->failed++;
+	}
+
+	gen->outstanding--;
+	isc_mem_put(mctx, req, sizeof(*req));
+	dns_request_destroy(&request);
+}
+
+static void
+loadgen_tick(void *arg) {
+	loadgen_t *gen = (loadgen_t *)arg;
+	uint64_t elapsed = (isc_time_monotonic() - gen->start) / NS_PER_MS;
+	unsigned int options = 0;
+	uint64_t due;
+
+	if (elapsed >= (uint64_t)duration * MS_PER_SEC) {
+		/*
+		 * Stop sending, and finish once every query in flight
+		 * has been answered or has timed out.
+		 */
+		if (gen->outstanding == 0) {
+			isc_timer_destroy(&gen->timer);
+			if (atomic_fetch_sub_release(&running, 1) == 1) {
+				isc_async_run(isc_loop_main(loopmgr), loaddone,
+					      NULL);
+			}
+		}
+		return;
+	}
+
+	if (tcp_mode || tls_mode) {
+		options |= DNS_REQUESTOPT_TCP;
+	}
+
+	/*
+	 * Open loop: catch up with the schedule whatever the number of
+	 * queries still waiting for an answer.
+	 */
+	due = elapsed * gen->rate / MS_PER_SEC;
+	while (gen->sent < due) {
+		struct query *query = loadq[gen->next];
+		dns_request_t *request = NULL;
+		loadreq_t *req = isc_mem_get(mctx, sizeof(*req));
+		isc_result_t result;
+
+		*req = (loadreq_t){ .gen = gen, .sent = isc_time_monotonic() };
+		gen->next = (gen->next + 1) % nloadq;
+		gen->sent++;
+
+		result = dns_request_createraw(
+			requestmgr, query->wire, have_src ? &srcaddr : NULL,
+			&dstaddr, tls_mode ? transport : NULL,
+			tls_mode ? tlsctx_cache : NULL, options, query->timeout,
+			query->udptimeout, query->udpretries, gen->loop,
+			loadresponse, req, &request);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, req, sizeof(*req));
+			gen->failed++;
+			continue;
+		}
+		gen->outstanding++;
+	}
+}
+
+static void
+loadgen_start(void *arg) {
+	loadgen_t *gen = (loadgen_t *)arg;
+	isc_interval_t interval;
+
+	gen->start = isc_time_monotonic();
+	isc_timer_create(gen->loop, loadgen_tick, gen, &gen->timer);
+	isc_interval_set(&interval, 0, NS_PER_MS);
+	isc_timer_start(gen->timer, isc_timertype_ticker, &interval);
+}
+
+static void
+loadqueries(void *arg) {
+	struct query *query = NULL;
+	size_t i = 0;
+
+	for (query = arg; query != NULL; query = ISC_LIST_NEXT(query, link)) {
+		nloadq++;
+	}
+	loadq = isc_mem_cget(mctx, nloadq, sizeof(loadq[0]));
+	for (query = arg; query != NULL; query = ISC_LIST_NEXT(query, link)) {
+		renderquery(query);
+		loadq[i++] = query;
+	}
+
+	isc_histomulti_create(mctx, isc_histo_digits_to_bits(2), &latency);
+	loadgens = isc_mem_cget(mctx, nloops, sizeof(loadgens[0]));
+
+	atomic_init(&running, nloops);
+	for (i = 0; i < nloops; i++) {
+		loadgens[i] = (loadgen_t){
+			.loop = isc_loop_get(loopmgr, i),
+			.rate = qps / nloops + (i < qps % nloops ? 1 : 0),
+			.next = i % nloadq,
+		};
+		isc_async_run(loadgens[i].loop, loadgen_start, &loadgens[i]);
+	}
+}
+
+static void
+loadreport(void) {
+	const double fraction[] = { 1.0, 0.999, 0.99, 0.9, 0.5 };
+	uint64_t value[ARRAY_SIZE(fraction)];
+	uint64_t sent = 0, received = 0, failed = 0, rcodes[16] = { 0 };
+	isc_histo_t *hg = NULL;
+	isc_result_t result;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		sent += loadgens[i].sent;
+		received += loadgens[i].received;
+		failed += loadgens[i].failed;
+		for (size_t r = 0; r < ARRAY_SIZE(rcodes); r++) {
+			rcodes[r] += loadgens[i].rcodes[r];
+		}
+	}
+
+	printf(";; %" PRIu64 " queries sent in %u s (%" PRIu64
+	       " qps) from %u loops\n",
+	       sent, duration, sent / duration, nloops);
+	printf(";; %" PRIu64 " responses received, %" PRIu64 " failed\n",
+	       received, failed);
+	for (size_t r = 0; r < ARRAY_SIZE(rcodes); r++) {
+		if (rcodes[r] != 0) {
+			printf(";; %s: %" PRIu64 "\n", rcode_totext(r),
+			       rcodes[r]);
+		}
+	}
+
+	isc_histomulti_merge(&hg, latency);
+	result = isc_histo_quantiles(hg, ARRAY_SIZE(fraction), fraction,
+				     value);
+	if (result == ISC_R_SUCCESS) {
+		printf(";; latency us: p50 %" PRIu64 " p90 %" PRIu64
+		       " p99 %" PRIu64 " p99.9 %" PRIu64 " max %" PRIu64 "\n",
+		       value[4] / NS_PER_US, value[3] / NS_PER_US,
+		       value[2] / NS_PER_US, value[1] / NS_PER_US,
+		       value[0] / NS_PER_US);
+	}
+	isc_histo_destroy(&hg);
+	isc_histomulti_destroy(&latency);
+
+	isc_mem_cput(mctx, loadgens, nloops, sizeof(loadgens[0]));
+	isc_mem_cput(mctx, loadq, nloadq, sizeof(loadq[0]));
+}
+
 ISC_NORETURN static void
 usage(void);
 
@@ -807,9 +1093,18 @@ help(void) {
 	       "                 -p port             (specify port number)\n"
 	       "                 -m                  (enable memory usage "
 	       "debugging)\n"
+	       "                 -n loops            (number of event loops "
+	       "for +qps)\n"
 	       "                 +[no]vc             (TCP mode)\n"
 	       "                 +[no]tcp            (TCP mode, alternate "
 	       "syntax)\n"
+	       "                 +[no]tls            (DNS-over-TLS mode)\n"
+	       "                 +[no]parallel=###   (Limit the queries in "
+	       "flight)\n"
+	       "                 +qps=###            (Send the queries "
+	       "repeatedly at this rate)\n"
+	       "                 +duration=###       (Seconds to send for "
+	       "with +qps) [10]\n"
 	       "                 +[no]besteffort     (Try to parse even "
 	       "illegal "
 	       "messages)\n"
@@ -1309,6 +1604,22 @@ plus_option(char *option, struct query *query, bool global) {
 			}
 			query->dnssec = state;
 			break;
+		case 'u': /* duration */
+			FULLCHECK("duration");
+			GLOBAL();
+			if (value == NULL) {
+				goto need_value;
+			}
+			if (!state) {
+				goto invalid_option;
+			}
+			result = parse_uint(&duration, value, MAXTIMEOUT,
+					    "duration");
+			CHECK("parse_uint(duration)", result);
+			if (duration == 0) {
+				duration = 1;
+			}
+			break;
 		default:
 			goto invalid_option;
 		}
@@ -1411,10 +1722,42 @@ plus_option(char *option, struct query *query, bool global) {
 		}
 		query->nsid = state;
 		break;
-	case 'q':
-		FULLCHECK("question");
+	case 'p': /* parallel */
+		FULLCHECK("parallel");
 		GLOBAL();
-		display_question = state;
+		if (!state) {
+			parallel = 0;
+			break;
+		}
+		if (value == NULL) {
+			goto need_value;
+		}
+		result = parse_uint(&parallel, value, UINT32_MAX, "parallel");
+		CHECK("parse_uint(parallel)", result);
+		break;
+	case 'q':
+		switch (cmd[1]) {
+		case 'p': /* qps */
+			FULLCHECK("qps");
+			GLOBAL();
+			if (!state) {
+				qps = 0;
+				break;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&qps, value, MAXQPS, "qps");
+			CHECK("parse_uint(qps)", result);
+			break;
+		case 'u': /* question */
+			FULLCHECK("question");
+			GLOBAL();
+			display_question = state;
+			break;
+		default:
+			goto invalid_option;
+		}
 		break;
 	case 'r':
 		switch (cmd[1]) {
@@ -1529,6 +1872,11 @@ plus_option(char *option, struct query *query, bool global) {
 			GLOBAL();
 			tcp_mode = state;
 			break;
+		case 'l': /* tls */
+			FULLCHECK("tls");
+			GLOBAL();
+			tls_mode = state;
+			break;
 		case 'i': /* timeout */
 			FULLCHECK("timeout");
 			if (value == NULL) {
@@ -1641,7 +1989,7 @@ plus_option(char *option, struct query *query, bool global) {
  * #true returned if value was used
  */
 static const char *single_dash_opts = "46himv";
-static const char *dash_opts = "46bcfhiptvx";
+static const char *dash_opts = "46bcfhinptvx";
 static bool
 dash_option(const char *option, char *next, struct query *query, bool global,
 	    bool *setname) {
@@ -1763,6 +2111,12 @@ dash_option(const char *option, char *next, struct query *query, bool global,
 	case 'f':
 		batchname = value;
 		return (value_from_next);
+	case 'n':
+		GLOBAL();
+		/*
+		 * handled by preparse_args()
+		 */
+		return (value_from_next);
 	case 'p':
 		GLOBAL();
 		result = parse_uint(&num, value, MAXPORT, "port number");
@@ -1810,7 +2164,8 @@ clone_default_query(void) {
 	}
 
 	if (query->timeout == 0) {
-		query->timeout = tcp_mode ? TCPTIMEOUT : UDPTIMEOUT;
+		query->timeout = (tcp_mode || tls_mode) ? TCPTIMEOUT
+							: UDPTIMEOUT;
 	}
 
 	return (query);
@@ -1825,6 +2180,21 @@ clone_default_query(void) {
  * fix the problem.  Argument parsing in mdig involves memory allocation
  * by its nature, so it can't be done in the main argument parser.
  */
+static void
+parse_loops(const char *value) {
+	isc_result_t result;
+
+	/*
+	 * The number of loops has to be known before the loop manager
+	 * is created, which is before the main argument parsing.
+	 */
+	result = parse_uint(&nloops, value, MAXLOOPS, "loops");
+	CHECK("parse_uint(loops)", result);
+	if (nloops == 0) {
+		nloops = 1;
+	}
+}
+
 static void
 preparse_args(int argc, char **argv) {
 	int rc;
@@ -1864,10 +2234,15 @@ preparse_args(int argc, char **argv) {
 			continue;
 		}
 		/* Look for dash value option. */
-		if (strpbrk(option, dash_opts) != &option[0] ||
-		    strlen(option) > 1U)
-		{
-			/* Error or value in option. */
+		if (strpbrk(option, dash_opts) != &option[0]) {
+			/* Error in option. */
+			continue;
+		}
+		if (strlen(option) > 1U) {
+			/* Value in option. */
+			if (option[0] == 'n') {
+				parse_loops(&option[1]);
+			}
 			continue;
 		}
 		/* Dash value is next argument so we need to skip it. */
@@ -1876,6 +2251,9 @@ preparse_args(int argc, char **argv) {
 		if (rc == 0) {
 			break;
 		}
+		if (option[0] == 'n') {
+			parse_loops(rv[0]);
+		}
 	}
 }
 
@@ -2078,6 +2456,12 @@ set_source_ports(dns_dispatchmgr_t *manager) {
 
 static void
 teardown(void *arg ISC_ATTR_UNUSED) {
+	if (tlsctx_cache != NULL) {
+		isc_tlsctx_cache_detach(&tlsctx_cache);
+	}
+	if (transport_list != NULL) {
+		dns_transport_list_detach(&transport_list);
+	}
 	dns_view_detach(&view);
 	dns_requestmgr_shutdown(requestmgr);
 	dns_requestmgr_detach(&requestmgr);
@@ -2104,6 +2488,20 @@ setup(void *arg ISC_ATTR_UNUSED) {
 		have_ipv6 ? dispatchvx : NULL, &requestmgr));
 
 	RUNCHECK(dns_view_create(mctx, NULL, 0, "_mdig", &view));
+
+	if (tls_mode) {
+		dns_fixedname_t fname;
+		dns_name_t *name = dns_fixedname_initname(&fname);
+
+		RUNCHECK(dns_name_fromstring(name, "tls-non-auth-client",
+					     dns_rootname, 0, NULL));
+		transport_list = dns_transport_list_new(mctx);
+		isc_tlsctx_cache_create(mctx, &tlsctx_cache);
+		transport = dns_transport_new(name, DNS_TRANSPORT_TLS,
+					      transport_list);
+		dns_transport_set_tlsname(transport, "tls-non-auth-client");
+		dns_transport_set_always_verify_remote(transport, false);
+	}
 }
 
 /*% Main processing routine for mdig */
@@ -2126,7 +2524,7 @@ main(int argc, char *argv[]) {
 
 	preparse_args(argc, argv);
 
-	isc_managers_create(&mctx, 1, &loopmgr, &netmgr);
+	isc_managers_create(&mctx, nloops, &loopmgr, &netmgr);
 
 	isc_nonce_buf(cookie_secret, sizeof(cookie_secret));
 
@@ -2155,9 +2553,13 @@ main(int argc, char *argv[]) {
 	}
 
 	query = ISC_LIST_HEAD(queries);
-	isc_loopmgr_setup(loopmgr, setup, NULL);
-	isc_loopmgr_setup(loopmgr, sendqueries, query);
-	isc_loopmgr_teardown(loopmgr, teardown, NULL);
+	if (qps > 0 && query == NULL) {
+		fatal("+qps needs at least one query");
+	}
+	isc_loop_setup(isc_loop_main(loopmgr), setup, NULL);
+	isc_loop_setup(isc_loop_main(loopmgr),
+		       qps > 0 ? loadqueries : sendqueries, query);
+	isc_loop_teardown(isc_loop_main(loopmgr), teardown, NULL);
 
 	/*
 	 * Stall to the start of a new second.
@@ -2187,6 +2589,10 @@ main(int argc, char *argv[]) {
 
 	isc_loopmgr_run(loopmgr);
 
+	if (qps > 0) {
+		loadreport();
+	}
+
 	query = ISC_LIST_HEAD(queries);
 	while (query != NULL) {
 		struct query *next = ISC_LIST_NEXT(query, link);
@@ -2204,6 +2610,9 @@ main(int argc, char *argv[]) {
 			isc_mem_free(mctx, query->ecs_addr);
 			query->ecs_addr = NULL;
 		}
+		if (query->wire != NULL) {
+			isc_buffer_free(&query->wire);
+		}
 		isc_mem_free(mctx, query);
 		query = next;
 	}
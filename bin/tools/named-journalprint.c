@@ -28,10 +28,52 @@ const char *progname = NULL;
 
 static void
 usage(void) {
-	fprintf(stderr, "Usage: %s [-dux] journal\n", progname);
+	fprintf(stderr,
+		"Usage: %s [-dux] [-s serial] [-e serial] [-o file] "
+		"journal\n",
+		progname);
 	exit(EXIT_FAILURE);
 }
 
+static uint32_t
+parse_serial(const char *arg) {
+	unsigned long serial;
+	char *endp = NULL;
+
+	serial = strtoul(arg, &endp, 0);
+	if (endp == arg || *endp != 0 || serial > UINT32_MAX) {
+		fprintf(stderr, "invalid serial: %s\n", arg);
+		exit(EXIT_FAILURE);
+	}
+	return ((uint32_t)serial);
+}
+
+/*
+ * Fill in the ends of the journal for the serials not given with
+ * -s and -e.
+ */
+static isc_result_t
+journal_range(isc_mem_t *mctx, const char *file, bool setbegin,
+	      uint32_t *beginp, bool setend, uint32_t *endp) {
+	dns_journal_t *j = NULL;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, file, DNS_JOURNAL_READ, &j);
+	if (result == ISC_R_NOTFOUND) {
+		return (DNS_R_NOJOURNAL);
+	} else if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (!setbegin) {
+		*beginp = dns_journal_first_serial(j);
+	}
+	if (!setend) {
+		*endp = dns_journal_last_serial(j);
+	}
+	dns_journal_destroy(&j);
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Setup logging to use stderr.
  */
@@ -56,9 +98,12 @@ main(int argc, char **argv) {
 	bool upgrade = false;
 	unsigned int serial = 0;
 	char *endp = NULL;
+	bool setbegin = false, setend = false;
+	uint32_t begin = 0, end = 0;
+	const char *outfile = NULL;
 
 	progname = argv[0];
-	while ((ch = isc_commandline_parse(argc, argv, "c:dux")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "c:de:o:s:ux")) != -1) {
 		switch (ch) {
 		case 'c':
 			compact = true;
@@ -72,6 +117,17 @@ main(int argc, char **argv) {
 		case 'd':
 			downgrade = true;
 			break;
+		case 'e':
+			setend = true;
+			end = parse_serial(isc_commandline_argument);
+			break;
+		case 'o':
+			outfile = isc_commandline_argument;
+			break;
+		case 's':
+			setbegin = true;
+			begin = parse_serial(isc_commandline_argument);
+			break;
 		case 'u':
 			upgrade = true;
 			break;
@@ -103,6 +159,19 @@ main(int argc, char **argv) {
 	} else if (compact) {
 		flags = 0;
 		result = dns_journal_compact(mctx, file, serial, flags, 0);
+	} else if (setbegin || setend || outfile != NULL) {
+		result = journal_range(mctx, file, setbegin, &begin, setend,
+				       &end);
+		if (result == ISC_R_SUCCESS && outfile != NULL) {
+			result = dns_journal_extract(mctx, file, begin, end,
+						     outfile);
+		} else if (result == ISC_R_SUCCESS) {
+			result = dns_journal_printrange(mctx, flags, file,
+							begin, end, stdout);
+		}
+		if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s\n", isc_result_totext(result));
+		}
 	} else {
 		result = dns_journal_print(mctx, flags, file, stdout);
 		if (result == DNS_R_NOJOURNAL) {
@@ -173,6 +173,10 @@ typedef isc_result_t
 dns_sdlz_putrr_t(dns_sdlzlookup_t *lookup, const char *type, dns_ttl_t ttl,
 		 const char *data);
 
+typedef isc_result_t
+dns_sdlz_putrdata_t(dns_sdlzlookup_t *lookup, uint16_t type, dns_ttl_t ttl,
+		    const unsigned char *rdata, unsigned int length);
+
 typedef isc_result_t
 dns_sdlz_putnamedrr_t(dns_sdlzallnodes_t *allnodes, const char *name,
 		      const char *type, dns_ttl_t ttl, const char *data);
@@ -69,6 +69,21 @@
 #define ADB_HASH_BITS 12
 #endif /* ifndef ADB_HASH_BITS */
 
+/*%
+ * The names and entries tables are each split into shards by the low
+ * bits of the hash value, each shard with its own lock, LRU list and
+ * hash table, so that lookups from different loops rarely wait for
+ * each other.
+ */
+#ifndef ADB_SHARD_BITS
+#define ADB_SHARD_BITS 4
+#endif /* ifndef ADB_SHARD_BITS */
+#if ADB_SHARD_BITS >= ADB_HASH_BITS
+#error "ADB_SHARD_BITS is too large"
+#endif /* if ADB_SHARD_BITS >= ADB_HASH_BITS */
+#define ADB_SHARDS	 (1U << ADB_SHARD_BITS)
+#define ADB_SHARD(hashval) ((hashval) & (ADB_SHARDS - 1))
+
 /*%
  * The period in seconds after which an ADB name entry is regarded as stale
  * and forced to be cleaned up.
@@ -87,6 +102,22 @@ typedef ISC_LIST(dns_adbentry_t) dns_adbentrylist_t;
 typedef struct dns_adbfetch dns_adbfetch_t;
 typedef struct dns_adbfetch6 dns_adbfetch6_t;
 
+/*% a shard of the names table */
+typedef struct dns_adbnames {
+	isc_rwlock_t lock;
+	isc_hashmap_t *table;
+	dns_adbnamelist_t lru;
+	isc_stdtime_t last_update;
+} dns_adbnames_t;
+
+/*% a shard of the entries table */
+typedef struct dns_adbentries {
+	isc_rwlock_t lock;
+	isc_hashmap_t *table;
+	dns_adbentrylist_t lru;
+	isc_stdtime_t last_update;
+} dns_adbentries_t;
+
 /*% dns adb structure */
 struct dns_adb {
 	unsigned int magic;
@@ -99,15 +130,8 @@ struct dns_adb {
 
 	isc_refcount_t references;
 
-	dns_adbnamelist_t names_lru;
-	isc_stdtime_t names_last_update;
-	isc_hashmap_t *names;
-	isc_rwlock_t names_lock;
-
-	dns_adbentrylist_t entries_lru;
-	isc_stdtime_t entries_last_update;
-	isc_hashmap_t *entries;
-	isc_rwlock_t entries_lock;
+	dns_adbnames_t names[ADB_SHARDS];
+	dns_adbentries_t entries[ADB_SHARDS];
 
 	isc_stats_t *stats;
 
@@ -124,7 +148,7 @@ struct dns_adb {
  * dns_adbname structure:
  *
  * This is the structure representing a nameserver name; it can be looked
- * up via the adb->names hash table. It holds references to fetches
+ * up via the adb->names hash tables. It holds references to fetches
  * for A and AAAA records while they are ongoing (fetch_a, fetch_aaaa), and
  * lists of records pointing to address information when the fetches are
  * complete (v4, v6).
@@ -197,7 +221,7 @@ struct dns_adbnamehook {
  * dns_adbentry structure:
  *
  * This is the structure representing a nameserver address; it can be looked
- * up via the adb->entries hash table. Also, each dns_adbnamehook and
+ * up via the adb->entries hash tables. Also, each dns_adbnamehook and
  * and dns_adbaddrinfo object will contain a pointer to one of these.
  *
  * The structure holds quite a bit of information about addresses,
@@ -217,6 +241,7 @@ struct dns_adbentry {
 
 	atomic_uint flags;
 	atomic_uint srtt;
+	atomic_uint rttvar;
 	unsigned int completed;
 	unsigned int timeouts;
 	unsigned char plain;
@@ -293,18 +318,22 @@ new_adbfetch(dns_adb_t *);
 static void
 free_adbfetch(dns_adb_t *, dns_adbfetch_t **);
 static void
-purge_stale_names(dns_adb_t *adb, isc_stdtime_t now);
+purge_stale_names(dns_adb_t *adb, dns_adbnames_t *names, isc_stdtime_t now);
 static dns_adbname_t *
 get_attached_and_locked_name(dns_adb_t *, const dns_name_t *,
 			     unsigned int flags, isc_stdtime_t now);
 static void
-purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now);
+purge_stale_entries(dns_adb_t *adb, dns_adbentries_t *entries,
+		    isc_stdtime_t now);
 static dns_adbentry_t *
 get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 			      const isc_sockaddr_t *addr);
 static void
 dump_adb(dns_adb_t *, FILE *, bool debug, isc_stdtime_t);
 static void
+dump_names(dns_adb_t *adb, dns_adbnames_t *names, FILE *f, bool debug,
+	   isc_stdtime_t now);
+static void
 print_namehook_list(FILE *, const char *legend, dns_adb_t *adb,
 		    dns_adbnamehooklist_t *list, bool debug, isc_stdtime_t now);
 static void
@@ -520,6 +549,33 @@ inc_adbstats(dns_adb_t *adb, isc_statscounter_t counter) {
 	}
 }
 
+/*%
+ * Lock or upgrade the lock on a names or entries shard, counting the
+ * times it is held by another thread in 'counter'.
+ */
+static void
+shard_lock(dns_adb_t *adb, isc_rwlock_t *lock, isc_rwlocktype_t type,
+	   isc_statscounter_t counter) {
+	if (isc_rwlock_trylock(lock, type) != ISC_R_SUCCESS) {
+		inc_adbstats(adb, counter);
+		RWLOCK(lock, type);
+	}
+}
+
+static void
+shard_upgrade(dns_adb_t *adb, isc_rwlock_t *lock, isc_rwlocktype_t *typep,
+	      isc_statscounter_t counter) {
+	if (*typep == isc_rwlocktype_write) {
+		return;
+	}
+	if (isc_rwlock_tryupgrade(lock) != ISC_R_SUCCESS) {
+		inc_adbstats(adb, counter);
+		RWUNLOCK(lock, *typep);
+		RWLOCK(lock, isc_rwlocktype_write);
+	}
+	*typep = isc_rwlocktype_write;
+}
+
 static dns_ttl_t
 ttlclamp(dns_ttl_t ttl) {
 	if (ttl < ADB_CACHE_MINIMUM) {
@@ -652,6 +708,8 @@ match_ptr(void *node, const void *key) {
 static void
 expire_name(dns_adbname_t *adbname, dns_adbstatus_t astat) {
 	isc_result_t result;
+	dns_adbnames_t *names = NULL;
+	uint32_t hashval;
 
 	REQUIRE(DNS_ADBNAME_VALID(adbname));
 
@@ -684,11 +742,12 @@ expire_name(dns_adbname_t *adbname, dns_adbstatus_t astat) {
 	/*
 	 * Remove the adbname from the hashtable...
 	 */
-	result = isc_hashmap_delete(adb->names, hash_adbname(adbname),
-				    match_ptr, adbname);
+	hashval = hash_adbname(adbname);
+	names = &adb->names[ADB_SHARD(hashval)];
+	result = isc_hashmap_delete(names->table, hashval, match_ptr, adbname);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	/* ... and LRU list */
-	ISC_LIST_UNLINK(adb->names_lru, adbname, link);
+	ISC_LIST_UNLINK(names->lru, adbname, link);
 
 	dns_adbname_unref(adbname);
 }
@@ -740,39 +799,46 @@ maybe_expire_namehooks(dns_adbname_t *adbname, isc_stdtime_t now) {
 
 static void
 shutdown_names(dns_adb_t *adb) {
-	dns_adbname_t *next = NULL;
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbnames_t *names = &adb->names[i];
+		dns_adbname_t *next = NULL;
 
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
-	for (dns_adbname_t *name = ISC_LIST_HEAD(adb->names_lru); name != NULL;
-	     name = next)
-	{
-		next = ISC_LIST_NEXT(name, link);
-		dns_adbname_ref(name);
-		LOCK(&name->lock);
-		/*
-		 * Run through the list.  For each name, clean up finds
-		 * found there, and cancel any fetches running.  When
-		 * all the fetches are canceled, the name will destroy
-		 * itself.
-		 */
-		expire_name(name, DNS_ADB_SHUTTINGDOWN);
-		UNLOCK(&name->lock);
-		dns_adbname_detach(&name);
+		RWLOCK(&names->lock, isc_rwlocktype_write);
+		for (dns_adbname_t *name = ISC_LIST_HEAD(names->lru);
+		     name != NULL; name = next)
+		{
+			next = ISC_LIST_NEXT(name, link);
+			dns_adbname_ref(name);
+			LOCK(&name->lock);
+			/*
+			 * Run through the list.  For each name, clean up finds
+			 * found there, and cancel any fetches running.  When
+			 * all the fetches are canceled, the name will destroy
+			 * itself.
+			 */
+			expire_name(name, DNS_ADB_SHUTTINGDOWN);
+			UNLOCK(&name->lock);
+			dns_adbname_detach(&name);
+		}
+		RWUNLOCK(&names->lock, isc_rwlocktype_write);
 	}
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 }
 
 static void
 shutdown_entries(dns_adb_t *adb) {
-	dns_adbentry_t *next = NULL;
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = next)
-	{
-		next = ISC_LIST_NEXT(adbentry, link);
-		expire_entry(adbentry);
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbentries_t *entries = &adb->entries[i];
+		dns_adbentry_t *next = NULL;
+
+		RWLOCK(&entries->lock, isc_rwlocktype_write);
+		for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(entries->lru);
+		     adbentry != NULL; adbentry = next)
+		{
+			next = ISC_LIST_NEXT(adbentry, link);
+			expire_entry(adbentry);
+		}
+		RWUNLOCK(&entries->lock, isc_rwlocktype_write);
 	}
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 }
 
 /*
@@ -942,6 +1008,10 @@ clean_finds_at_name(dns_adbname_t *name, dns_adbstatus_t astat,
 
 			DP(DEF_LEVEL, "cfan: sending find %p to caller", find);
 
+			if (find->loop != isc_loop()) {
+				inc_resstats(name->adb,
+					     dns_resstatscounter_findcrossloop);
+			}
 			isc_async_run(find->loop, find->cb, find);
 			find->flags |= FIND_EVENT_SENT;
 		} else {
@@ -1197,6 +1267,7 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	ai = isc_mem_get(adb->mctx, sizeof(*ai));
 	*ai = (dns_adbaddrinfo_t){
 		.srtt = atomic_load(&entry->srtt),
+		.rttvar = atomic_load(&entry->rttvar),
 		.flags = atomic_load(&entry->flags),
 		.publink = ISC_LINK_INITIALIZER,
 		.sockaddr = entry->sockaddr,
@@ -1271,46 +1342,49 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 		.flags = flags & ADBNAME_FLAGS_MASK,
 	};
 	uint32_t hashval = hash_adbname(&key);
+	dns_adbnames_t *names = &adb->names[ADB_SHARD(hashval)];
 	isc_rwlocktype_t locktype = isc_rwlocktype_read;
 
 	isc_time_set(&timenow, now, 0);
 
-	RWLOCK(&adb->names_lock, locktype);
-	last_update = adb->names_last_update;
+	shard_lock(adb, &names->lock, locktype, dns_adbstats_nameslockwait);
+	last_update = names->last_update;
 
 	if (last_update + ADB_STALE_MARGIN >= now ||
 	    isc_mem_isovermem(adb->mctx))
 	{
 		last_update = now;
-		UPGRADELOCK(&adb->names_lock, locktype);
-		purge_stale_names(adb, now);
-		adb->names_last_update = last_update;
+		shard_upgrade(adb, &names->lock, &locktype,
+			      dns_adbstats_nameslockwait);
+		purge_stale_names(adb, names, now);
+		names->last_update = last_update;
 	}
 
-	result = isc_hashmap_find(adb->names, hashval, match_adbname,
+	result = isc_hashmap_find(names->table, hashval, match_adbname,
 				  (void *)&key, (void **)&adbname);
 	switch (result) {
 	case ISC_R_NOTFOUND:
-		UPGRADELOCK(&adb->names_lock, locktype);
+		shard_upgrade(adb, &names->lock, &locktype,
+			      dns_adbstats_nameslockwait);
 
 		/* Allocate a new name and add it to the hash table. */
 		adbname = new_adbname(adb, name, key.flags);
 
 		void *found = NULL;
-		result = isc_hashmap_add(adb->names, hashval, match_adbname,
+		result = isc_hashmap_add(names->table, hashval, match_adbname,
 					 (void *)&key, adbname, &found);
 		if (result == ISC_R_EXISTS) {
 			destroy_adbname(adbname);
 			adbname = found;
 			result = ISC_R_SUCCESS;
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
+			ISC_LIST_UNLINK(names->lru, adbname, link);
 		}
 		INSIST(result == ISC_R_SUCCESS);
 
 		break;
 	case ISC_R_SUCCESS:
 		if (locktype == isc_rwlocktype_write) {
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
+			ISC_LIST_UNLINK(names->lru, adbname, link);
 		}
 		break;
 	default:
@@ -1324,7 +1398,7 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 		adbname->last_used = now;
 	}
 	if (locktype == isc_rwlocktype_write) {
-		ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+		ISC_LIST_PREPEND(names->lru, adbname, link);
 	}
 
 	/*
@@ -1332,18 +1406,19 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 	 * expire_name() - the unused adbname stored in the hashtable and lru
 	 * has always refcount == 1
 	 */
-	RWUNLOCK(&adb->names_lock, locktype);
+	RWUNLOCK(&names->lock, locktype);
 
 	return (adbname);
 }
 
 static void
-upgrade_entries_lock(dns_adb_t *adb, isc_rwlocktype_t *locktypep,
-		     isc_stdtime_t now) {
+upgrade_entries_lock(dns_adb_t *adb, dns_adbentries_t *entries,
+		     isc_rwlocktype_t *locktypep, isc_stdtime_t now) {
 	if (*locktypep == isc_rwlocktype_read) {
-		UPGRADELOCK(&adb->entries_lock, *locktypep);
-		purge_stale_entries(adb, now);
-		adb->entries_last_update = now;
+		shard_upgrade(adb, &entries->lock, locktypep,
+			      dns_adbstats_entrieslockwait);
+		purge_stale_entries(adb, entries, now);
+		entries->last_update = now;
 	}
 }
 
@@ -1365,26 +1440,28 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 	isc_time_t timenow;
 	isc_stdtime_t last_update;
 	uint32_t hashval = isc_sockaddr_hash(addr, true);
+	dns_adbentries_t *entries = &adb->entries[ADB_SHARD(hashval)];
 	isc_rwlocktype_t locktype = isc_rwlocktype_read;
 
 	isc_time_set(&timenow, now, 0);
 
-	RWLOCK(&adb->entries_lock, locktype);
-	last_update = adb->entries_last_update;
+	shard_lock(adb, &entries->lock, locktype,
+		   dns_adbstats_entrieslockwait);
+	last_update = entries->last_update;
 
 	if (now - last_update > ADB_STALE_MARGIN ||
 	    isc_mem_isovermem(adb->mctx))
 	{
 		last_update = now;
 
-		upgrade_entries_lock(adb, &locktype, now);
+		upgrade_entries_lock(adb, entries, &locktype, now);
 	}
 
-	result = isc_hashmap_find(adb->entries, hashval, match_adbentry,
+	result = isc_hashmap_find(entries->table, hashval, match_adbentry,
 				  (const unsigned char *)addr,
 				  (void **)&adbentry);
 	if (result == ISC_R_NOTFOUND) {
-		upgrade_entries_lock(adb, &locktype, now);
+		upgrade_entries_lock(adb, entries, &locktype, now);
 
 	create:
 		INSIST(locktype == isc_rwlocktype_write);
@@ -1393,10 +1470,11 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 		adbentry = new_adbentry(adb, addr, now);
 
 		void *found = NULL;
-		result = isc_hashmap_add(adb->entries, hashval, match_adbentry,
-					 &adbentry->sockaddr, adbentry, &found);
+		result = isc_hashmap_add(entries->table, hashval,
+					 match_adbentry, &adbentry->sockaddr,
+					 adbentry, &found);
 		if (result == ISC_R_SUCCESS) {
-			ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
+			ISC_LIST_PREPEND(entries->lru, adbentry, link);
 		} else if (result == ISC_R_EXISTS) {
 			dns_adbentry_detach(&adbentry);
 			adbentry = found;
@@ -1419,7 +1497,7 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 
 		/* We need to upgrade the LRU lock */
 		UNLOCK(&adbentry->lock);
-		upgrade_entries_lock(adb, &locktype, now);
+		upgrade_entries_lock(adb, entries, &locktype, now);
 		LOCK(&adbentry->lock);
 		FALLTHROUGH;
 	case isc_rwlocktype_write:
@@ -1437,12 +1515,12 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 	if (adbentry->last_used + ADB_CACHE_MINIMUM <= last_update) {
 		adbentry->last_used = now;
 		if (locktype == isc_rwlocktype_write) {
-			ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
-			ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
+			ISC_LIST_UNLINK(entries->lru, adbentry, link);
+			ISC_LIST_PREPEND(entries->lru, adbentry, link);
 		}
 	}
 
-	RWUNLOCK(&adb->entries_lock, locktype);
+	RWUNLOCK(&entries->lock, locktype);
 
 	return (adbentry);
 }
@@ -1522,7 +1600,7 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find, dns_adbname_t *name) {
 }
 
 /*
- * The name must be locked and write lock on adb->names_lock must be held.
+ * The name must be locked and write lock on its names shard must be held.
  */
 static bool
 maybe_expire_name(dns_adbname_t *adbname, isc_stdtime_t now) {
@@ -1557,14 +1635,15 @@ expire_entry(dns_adbentry_t *adbentry) {
 	dns_adb_t *adb = adbentry->adb;
 
 	if (!ENTRY_DEAD(adbentry)) {
+		uint32_t hashval = isc_sockaddr_hash(&adbentry->sockaddr, true);
+		dns_adbentries_t *entries = &adb->entries[ADB_SHARD(hashval)];
+
 		(void)atomic_fetch_or(&adbentry->flags, ENTRY_IS_DEAD);
 
-		result = isc_hashmap_delete(
-			adb->entries,
-			isc_sockaddr_hash(&adbentry->sockaddr, true), match_ptr,
-			adbentry);
+		result = isc_hashmap_delete(entries->table, hashval, match_ptr,
+					    adbentry);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-		ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
+		ISC_LIST_UNLINK(entries->lru, adbentry, link);
 	}
 
 	dns_adbentry_detach(&adbentry);
@@ -1603,10 +1682,10 @@ maybe_expire_entry(dns_adbentry_t *adbentry, isc_stdtime_t now) {
  * We don't care about a race on 'overmem' at the risk of causing some
  * collateral damage or a small delay in starting cleanup.
  *
- * adb->names_lock MUST be write locked
+ * names->lock MUST be write locked
  */
 static void
-purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
+purge_stale_names(dns_adb_t *adb, dns_adbnames_t *names, isc_stdtime_t now) {
 	bool overmem = isc_mem_isovermem(adb->mctx);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
@@ -1619,7 +1698,7 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 	 * happen).
 	 */
 
-	for (dns_adbname_t *adbname = ISC_LIST_TAIL(adb->names_lru);
+	for (dns_adbname_t *adbname = ISC_LIST_TAIL(names->lru);
 	     adbname != NULL && removed < max_removed && scans < 10;
 	     adbname = prev)
 	{
@@ -1676,28 +1755,32 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 
 static void
 cleanup_names(dns_adb_t *adb, isc_stdtime_t now) {
-	dns_adbname_t *next = NULL;
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbnames_t *names = &adb->names[i];
+		dns_adbname_t *next = NULL;
 
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
-	for (dns_adbname_t *adbname = ISC_LIST_HEAD(adb->names_lru);
-	     adbname != NULL; adbname = next)
-	{
-		next = ISC_LIST_NEXT(adbname, link);
+		RWLOCK(&names->lock, isc_rwlocktype_write);
+		for (dns_adbname_t *adbname = ISC_LIST_HEAD(names->lru);
+		     adbname != NULL; adbname = next)
+		{
+			next = ISC_LIST_NEXT(adbname, link);
 
-		dns_adbname_ref(adbname);
-		LOCK(&adbname->lock);
-		/*
-		 * Name hooks expire after the address record's TTL
-		 * or 30 minutes, whichever is shorter. If after cleaning
-		 * those up there are no name hooks left, and no active
-		 * fetches, we can remove this name from the bucket.
-		 */
-		maybe_expire_namehooks(adbname, now);
-		(void)maybe_expire_name(adbname, now);
-		UNLOCK(&adbname->lock);
-		dns_adbname_detach(&adbname);
+			dns_adbname_ref(adbname);
+			LOCK(&adbname->lock);
+			/*
+			 * Name hooks expire after the address record's TTL
+			 * or 30 minutes, whichever is shorter. If after
+			 * cleaning those up there are no name hooks left,
+			 * and no active fetches, we can remove this name
+			 * from the bucket.
+			 */
+			maybe_expire_namehooks(adbname, now);
+			(void)maybe_expire_name(adbname, now);
+			UNLOCK(&adbname->lock);
+			dns_adbname_detach(&adbname);
+		}
+		RWUNLOCK(&names->lock, isc_rwlocktype_write);
 	}
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 }
 
 /*%
@@ -1708,10 +1791,11 @@ cleanup_names(dns_adb_t *adb, isc_stdtime_t now) {
  * We don't care about a race on 'overmem' at the risk of causing some
  * collateral damage or a small delay in starting cleanup.
  *
- * adb->entries_lock MUST be write locked
+ * entries->lock MUST be write locked
  */
 static void
-purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
+purge_stale_entries(dns_adb_t *adb, dns_adbentries_t *entries,
+		    isc_stdtime_t now) {
 	bool overmem = isc_mem_isovermem(adb->mctx);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
@@ -1724,7 +1808,7 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 	 * happen).
 	 */
 
-	for (dns_adbentry_t *adbentry = ISC_LIST_TAIL(adb->entries_lru);
+	for (dns_adbentry_t *adbentry = ISC_LIST_TAIL(entries->lru);
 	     adbentry != NULL && removed < max_removed && scans < 10;
 	     adbentry = prev)
 	{
@@ -1779,21 +1863,24 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 
 static void
 cleanup_entries(dns_adb_t *adb, isc_stdtime_t now) {
-	dns_adbentry_t *next = NULL;
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbentries_t *entries = &adb->entries[i];
+		dns_adbentry_t *next = NULL;
 
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = next)
-	{
-		next = ISC_LIST_NEXT(adbentry, link);
+		RWLOCK(&entries->lock, isc_rwlocktype_write);
+		for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(entries->lru);
+		     adbentry != NULL; adbentry = next)
+		{
+			next = ISC_LIST_NEXT(adbentry, link);
 
-		dns_adbentry_ref(adbentry);
-		LOCK(&adbentry->lock);
-		maybe_expire_entry(adbentry, now);
-		UNLOCK(&adbentry->lock);
-		dns_adbentry_detach(&adbentry);
+			dns_adbentry_ref(adbentry);
+			LOCK(&adbentry->lock);
+			maybe_expire_entry(adbentry, now);
+			UNLOCK(&adbentry->lock);
+			dns_adbentry_detach(&adbentry);
+		}
+		RWUNLOCK(&entries->lock, isc_rwlocktype_write);
 	}
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 }
 
 static void
@@ -1802,18 +1889,23 @@ destroy(dns_adb_t *adb) {
 
 	adb->magic = 0;
 
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
-	INSIST(isc_hashmap_count(adb->names) == 0);
-	isc_hashmap_destroy(&adb->names);
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
-	isc_rwlock_destroy(&adb->names_lock);
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbnames_t *names = &adb->names[i];
+		dns_adbentries_t *entries = &adb->entries[i];
+
+		RWLOCK(&names->lock, isc_rwlocktype_write);
+		INSIST(isc_hashmap_count(names->table) == 0);
+		isc_hashmap_destroy(&names->table);
+		RWUNLOCK(&names->lock, isc_rwlocktype_write);
+		isc_rwlock_destroy(&names->lock);
 
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	/* There are no unassociated entries */
-	INSIST(isc_hashmap_count(adb->entries) == 0);
-	isc_hashmap_destroy(&adb->entries);
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	isc_rwlock_destroy(&adb->entries_lock);
+		RWLOCK(&entries->lock, isc_rwlocktype_write);
+		/* There are no unassociated entries */
+		INSIST(isc_hashmap_count(entries->table) == 0);
+		isc_hashmap_destroy(&entries->table);
+		RWUNLOCK(&entries->lock, isc_rwlocktype_write);
+		isc_rwlock_destroy(&entries->lock);
+	}
 
 	isc_mem_detach(&adb->hmctx);
 
@@ -1844,10 +1936,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, dns_adb_t **newadb) {
 	REQUIRE(newadb != NULL && *newadb == NULL);
 
 	adb = isc_mem_get(mem, sizeof(dns_adb_t));
-	*adb = (dns_adb_t){
-		.names_lru = ISC_LIST_INITIALIZER,
-		.entries_lru = ISC_LIST_INITIALIZER,
-	};
+	*adb = (dns_adb_t){ 0 };
 
 	/*
 	 * Initialize things here that cannot fail, and especially things
@@ -1865,11 +1954,20 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, dns_adb_t **newadb) {
 	isc_mem_create(&adb->hmctx);
 	isc_mem_setname(adb->hmctx, "ADB_hashmaps");
 
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS, &adb->names);
-	isc_rwlock_init(&adb->names_lock);
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbnames_t *names = &adb->names[i];
+		dns_adbentries_t *entries = &adb->entries[i];
+
+		ISC_LIST_INIT(names->lru);
+		isc_hashmap_create(adb->hmctx, ADB_HASH_BITS - ADB_SHARD_BITS,
+				   &names->table);
+		isc_rwlock_init(&names->lock);
 
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS, &adb->entries);
-	isc_rwlock_init(&adb->entries_lock);
+		ISC_LIST_INIT(entries->lru);
+		isc_hashmap_create(adb->hmctx, ADB_HASH_BITS - ADB_SHARD_BITS,
+				   &entries->table);
+		isc_rwlock_init(&entries->lock);
+	}
 
 	isc_mutex_init(&adb->lock);
 
@@ -2375,9 +2473,48 @@ dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 	/*
 	 * Ensure this operation is applied to both hash tables at once.
 	 */
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		RWLOCK(&adb->names[i].lock, isc_rwlocktype_write);
+	}
+
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dump_names(adb, &adb->names[i], f, debug, now);
+	}
+
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		RWLOCK(&adb->entries[i].lock, isc_rwlocktype_write);
+	}
+
+	fprintf(f, ";\n; Unassociated entries\n;\n");
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbentries_t *entries = &adb->entries[i];
+
+		for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(entries->lru);
+		     adbentry != NULL; adbentry = ISC_LIST_NEXT(adbentry, link))
+		{
+			LOCK(&adbentry->lock);
+			if (ISC_LIST_EMPTY(adbentry->nhs)) {
+				dump_entry(f, adb, adbentry, debug, now);
+			}
+			UNLOCK(&adbentry->lock);
+		}
+	}
 
-	for (dns_adbname_t *name = ISC_LIST_HEAD(adb->names_lru); name != NULL;
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		RWUNLOCK(&adb->entries[i].lock, isc_rwlocktype_write);
+	}
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		RWUNLOCK(&adb->names[i].lock, isc_rwlocktype_write);
+	}
+}
+
+/*
+ * names->lock MUST be write locked
+ */
+static void
+dump_names(dns_adb_t *adb, dns_adbnames_t *names, FILE *f, bool debug,
+	   isc_stdtime_t now) {
+	for (dns_adbname_t *name = ISC_LIST_HEAD(names->lru); name != NULL;
 	     name = ISC_LIST_NEXT(name, link))
 	{
 		LOCK(&name->lock);
@@ -2413,21 +2550,6 @@ dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 		}
 		UNLOCK(&name->lock);
 	}
-
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	fprintf(f, ";\n; Unassociated entries\n;\n");
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = ISC_LIST_NEXT(adbentry, link))
-	{
-		LOCK(&adbentry->lock);
-		if (ISC_LIST_EMPTY(adbentry->nhs)) {
-			dump_entry(f, adb, adbentry, debug, now);
-		}
-		UNLOCK(&adbentry->lock);
-	}
-
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 }
 
 static void
@@ -2449,6 +2571,9 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry, bool debug,
 		"[plain %u/%u]",
 		addrbuf, atomic_load(&entry->srtt), atomic_load(&entry->flags),
 		entry->edns, entry->ednsto, entry->plain, entry->plainto);
+	if (atomic_load(&entry->rttvar) != 0U) {
+		fprintf(f, " [rttvar %u]", atomic_load(&entry->rttvar));
+	}
 	if (entry->udpsize != 0U) {
 		fprintf(f, " [udpsize %u]", entry->udpsize);
 	}
@@ -2586,39 +2711,42 @@ isc_result_t
 dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	REQUIRE(DNS_ADB_VALID(adb));
 
-	isc_hashmap_iter_t *it = NULL;
-	isc_result_t result;
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbentries_t *entries = &adb->entries[i];
+		isc_hashmap_iter_t *it = NULL;
+		isc_result_t result;
 
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(adb->entries, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		dns_adbentry_t *entry = NULL;
-		isc_hashmap_iter_current(it, (void **)&entry);
+		RWLOCK(&entries->lock, isc_rwlocktype_read);
+		isc_hashmap_iter_create(entries->table, &it);
+		for (result = isc_hashmap_iter_first(it);
+		     result == ISC_R_SUCCESS; result = isc_hashmap_iter_next(it))
+		{
+			dns_adbentry_t *entry = NULL;
+			isc_hashmap_iter_current(it, (void **)&entry);
 
-		LOCK(&entry->lock);
-		char addrbuf[ISC_NETADDR_FORMATSIZE];
-		char text[ISC_NETADDR_FORMATSIZE + BUFSIZ];
-		isc_netaddr_t netaddr;
+			LOCK(&entry->lock);
+			char addrbuf[ISC_NETADDR_FORMATSIZE];
+			char text[ISC_NETADDR_FORMATSIZE + BUFSIZ];
+			isc_netaddr_t netaddr;
 
-		if (entry->atr == 0.0 && entry->quota == adb->quota) {
-			goto unlock;
-		}
+			if (entry->atr == 0.0 && entry->quota == adb->quota) {
+				goto unlock;
+			}
 
-		isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
-		isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+			isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
+			isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
 
-		snprintf(text, sizeof(text),
-			 "\n- quota %s (%" PRIuFAST32 "/%d) atr %0.2f", addrbuf,
-			 atomic_load_relaxed(&entry->quota), adb->quota,
-			 entry->atr);
-		putstr(buf, text);
-	unlock:
-		UNLOCK(&entry->lock);
+			snprintf(text, sizeof(text),
+				 "\n- quota %s (%" PRIuFAST32 "/%d) atr %0.2f",
+				 addrbuf, atomic_load_relaxed(&entry->quota),
+				 adb->quota, entry->atr);
+			putstr(buf, text);
+		unlock:
+			UNLOCK(&entry->lock);
+		}
+		isc_hashmap_iter_destroy(&it);
+		RWUNLOCK(&entries->lock, isc_rwlocktype_read);
 	}
-	isc_hashmap_iter_destroy(&it);
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
 
 	return (ISC_R_SUCCESS);
 }
@@ -3063,8 +3191,29 @@ adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 			addr->srtt = new_srtt;
 		}
 	} else {
-		new_srtt = ((uint64_t)atomic_load(&addr->entry->srtt) / 10 *
-			    factor) +
+		unsigned int srtt = atomic_load(&addr->entry->srtt);
+
+		if (factor == DNS_ADB_RTTADJDEFAULT) {
+			/*
+			 * A real sample: track the mean deviation of the
+			 * round trip time as well (RFC 6298, section 2).
+			 * Timeout penalties don't count as samples.
+			 */
+			unsigned int rttvar = atomic_load(&addr->entry->rttvar);
+			unsigned int delta = (rtt > srtt) ? rtt - srtt
+							  : srtt - rtt;
+
+			if (rttvar == 0) {
+				rttvar = rtt / 2;
+			} else {
+				rttvar = ((uint64_t)rttvar * 3 + delta) / 4;
+			}
+			rttvar = ISC_MAX(rttvar, 1);
+			atomic_store(&addr->entry->rttvar, rttvar);
+			addr->rttvar = rttvar;
+		}
+
+		new_srtt = ((uint64_t)srtt / 10 * factor) +
 			   ((uint64_t)rtt / 10 * (10 - factor));
 		atomic_store(&addr->entry->srtt, new_srtt);
 		addr->srtt = new_srtt;
@@ -3400,6 +3549,8 @@ dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 	bool start_at_zone = false;
 	bool static_stub = false;
 	dns_adbname_t key = { .name = UNCONST(name) };
+	dns_adbnames_t *names = NULL;
+	uint32_t hashval;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(name != NULL);
@@ -3408,16 +3559,19 @@ dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 		return;
 	}
 
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
 again:
 	/*
 	 * Delete all entries - with and without DNS_ADBFIND_STARTATZONE set
-	 * and with and without DNS_ADBFIND_STATICSTUB set.
+	 * and with and without DNS_ADBFIND_STATICSTUB set.  Each of them
+	 * may be in a different shard.
 	 */
 	key.flags = ((static_stub) ? DNS_ADBFIND_STATICSTUB : 0) |
 		    ((start_at_zone) ? DNS_ADBFIND_STARTATZONE : 0);
+	hashval = hash_adbname(&key);
+	names = &adb->names[ADB_SHARD(hashval)];
 
-	result = isc_hashmap_find(adb->names, hash_adbname(&key), match_adbname,
+	RWLOCK(&names->lock, isc_rwlocktype_write);
+	result = isc_hashmap_find(names->table, hashval, match_adbname,
 				  (void *)&key, (void **)&adbname);
 	if (result == ISC_R_SUCCESS) {
 		dns_adbname_ref(adbname);
@@ -3428,6 +3582,8 @@ again:
 		UNLOCK(&adbname->lock);
 		dns_adbname_detach(&adbname);
 	}
+	RWUNLOCK(&names->lock, isc_rwlocktype_write);
+
 	if (!start_at_zone) {
 		start_at_zone = true;
 		goto again;
@@ -3436,13 +3592,10 @@ again:
 		static_stub = true;
 		goto again;
 	}
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 }
 
 void
 dns_adb_flushnames(dns_adb_t *adb, const dns_name_t *name) {
-	dns_adbname_t *next = NULL;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(name != NULL);
 
@@ -3450,20 +3603,25 @@ dns_adb_flushnames(dns_adb_t *adb, const dns_name_t *name) {
 		return;
 	}
 
-	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
-	for (dns_adbname_t *adbname = ISC_LIST_HEAD(adb->names_lru);
-	     adbname != NULL; adbname = next)
-	{
-		next = ISC_LIST_NEXT(adbname, link);
-		dns_adbname_ref(adbname);
-		LOCK(&adbname->lock);
-		if (dns_name_issubdomain(adbname->name, name)) {
-			expire_name(adbname, DNS_ADB_CANCELED);
+	for (size_t i = 0; i < ADB_SHARDS; i++) {
+		dns_adbnames_t *names = &adb->names[i];
+		dns_adbname_t *next = NULL;
+
+		RWLOCK(&names->lock, isc_rwlocktype_write);
+		for (dns_adbname_t *adbname = ISC_LIST_HEAD(names->lru);
+		     adbname != NULL; adbname = next)
+		{
+			next = ISC_LIST_NEXT(adbname, link);
+			dns_adbname_ref(adbname);
+			LOCK(&adbname->lock);
+			if (dns_name_issubdomain(adbname->name, name)) {
+				expire_name(adbname, DNS_ADB_CANCELED);
+			}
+			UNLOCK(&adbname->lock);
+			dns_adbname_detach(&adbname);
 		}
-		UNLOCK(&adbname->lock);
-		dns_adbname_detach(&adbname);
+		RWUNLOCK(&names->lock, isc_rwlocktype_write);
 	}
-	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 }
 
 void
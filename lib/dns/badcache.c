@@ -39,13 +39,7 @@
 #include <dns/types.h>
 
 typedef struct dns_bcentry dns_bcentry_t;
-
-struct dns_badcache {
-	unsigned int magic;
-	isc_mem_t *mctx;
-	struct cds_lfht *ht;
-	atomic_bool purge_in_progress;
-};
+typedef ISC_LIST(dns_bcentry_t) dns_bclist_t;
 
 #define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
 #define VALID_BADCACHE(m) ISC_MAGIC_VALID(m, BADCACHE_MAGIC)
@@ -53,6 +47,38 @@ struct dns_badcache {
 #define BADCACHE_INIT_SIZE (1 << 10) /* Must be power of 2 */
 #define BADCACHE_MIN_SIZE  (1 << 8)  /* Must be power of 2 */
 
+/*
+ * The number of entries is bounded, so that a flood of queries for
+ * random names cannot make the cache grow without limit.  When it is
+ * full, the entries closest to expiring are evicted first.
+ */
+#ifndef BADCACHE_MAX_ENTRIES
+#define BADCACHE_MAX_ENTRIES (1 << 16)
+#endif /* ifndef BADCACHE_MAX_ENTRIES */
+
+/*
+ * Expiry timing wheel: one slot per second, an entry being linked
+ * into the slot for its expiry time modulo BADCACHE_WHEEL.  Entries
+ * that expire further in the future than the wheel size share the
+ * slots, and are skipped until their time comes round.
+ */
+#define BADCACHE_WHEEL 64
+
+struct dns_badcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	struct cds_lfht *ht;
+
+	/*
+	 * Lookups are lock-free; the lock serializes adding and
+	 * removing entries, and protects the wheel.
+	 */
+	isc_mutex_t lock;
+	size_t count;
+	isc_stdtime_t wheel_time;
+	dns_bclist_t wheel[BADCACHE_WHEEL];
+};
+
 struct dns_bcentry {
 	isc_mem_t *mctx;
 	dns_rdatatype_t type;
@@ -61,6 +87,7 @@ struct dns_bcentry {
 	dns_fixedname_t fname;
 	dns_name_t *name;
 
+	ISC_LINK(dns_bcentry_t) link;
 	struct cds_lfht_node ht_node;
 	struct rcu_head rcu_head;
 };
@@ -78,12 +105,18 @@ dns_badcache_new(isc_mem_t *mctx) {
 	dns_badcache_t *bc = isc_mem_get(mctx, sizeof(*bc));
 	*bc = (dns_badcache_t){
 		.magic = BADCACHE_MAGIC,
+		.wheel_time = isc_stdtime_now(),
 	};
 
 	bc->ht = cds_lfht_new(BADCACHE_INIT_SIZE, BADCACHE_MIN_SIZE, 0,
 			      CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	INSIST(bc->ht != NULL);
 
+	isc_mutex_init(&bc->lock);
+	for (size_t i = 0; i < BADCACHE_WHEEL; i++) {
+		ISC_LIST_INIT(bc->wheel[i]);
+	}
+
 	isc_mem_attach(mctx, &bc->mctx);
 
 	return (bc);
@@ -106,6 +139,7 @@ dns_badcache_destroy(dns_badcache_t **bcp) {
 	}
 	RUNTIME_CHECK(!cds_lfht_destroy(bc->ht, NULL));
 
+	isc_mutex_destroy(&bc->lock);
 	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
 }
 
@@ -126,6 +160,7 @@ bcentry_new(dns_badcache_t *bc, const dns_name_t *name,
 		.type = type,
 		.flags = flags,
 		.expire = expire,
+		.link = ISC_LINK_INITIALIZER,
 	};
 	isc_mem_attach(bc->mctx, &bad->mctx);
 
@@ -143,58 +178,68 @@ bcentry_destroy(struct rcu_head *rcu_head) {
 	isc_mem_putanddetach(&bad->mctx, bad, sizeof(*bad));
 }
 
-static void
-bcentry_evict(struct cds_lfht *ht, dns_bcentry_t *bad) {
-	/*
-	 * The hashtable isn't locked in a traditional sense, so multiple
-	 * threads can lookup and evict the same record at the same time.
-	 *
-	 * This is amplified by the bcentry_purge_next() that walks a few more
-	 * records in the hashtable and evicts them if they are expired.
-	 *
-	 * We need to destroy the bcentry only once - from the thread that has
-	 * deleted the entry from the hashtable, all other calls to this
-	 * function were redundant.
-	 */
-	if (!cds_lfht_del(ht, &bad->ht_node)) {
-		call_rcu(&bad->rcu_head, bcentry_destroy);
-	}
+static dns_bclist_t *
+bcentry_slot(dns_badcache_t *bc, isc_stdtime_t expire) {
+	return (&bc->wheel[expire % BADCACHE_WHEEL]);
 }
 
-static bool
-bcentry_alive(struct cds_lfht *ht, dns_bcentry_t *bad, isc_stdtime_t now) {
-	if (cds_lfht_is_node_deleted(&bad->ht_node)) {
-		return (false);
-	} else if (atomic_load_relaxed(&bad->expire) < now) {
-		bcentry_evict(ht, bad);
-		return (false);
+/*
+ * Remove the entry from the hashtable and the timing wheel.
+ *
+ * The bc->lock must be held.  If the hashtable has been replaced by
+ * dns_badcache_flush() since 'ht' was read, the old entries are
+ * destroyed there and must be left alone here.
+ */
+static void
+bcentry_evict(dns_badcache_t *bc, struct cds_lfht *ht, dns_bcentry_t *bad) {
+	if (bc->ht != ht || cds_lfht_del(ht, &bad->ht_node) != 0) {
+		return;
 	}
 
-	return (true);
+	ISC_LIST_UNLINK(*bcentry_slot(bc, atomic_load_relaxed(&bad->expire)),
+			bad, link);
+	bc->count--;
+	call_rcu(&bad->rcu_head, bcentry_destroy);
 }
 
-#define cds_lfht_for_each_entry_next(ht, iter, pos, member)     \
-	for (cds_lfht_next(ht, iter),                           \
-	     pos = cds_lfht_entry(cds_lfht_iter_get_node(iter), \
-				  __typeof__(*(pos)), member);  \
-	     pos != NULL; /**/                                  \
-	     cds_lfht_next(ht, iter),                           \
-	     pos = cds_lfht_entry(cds_lfht_iter_get_node(iter), \
-				  __typeof__(*(pos)), member))
+static bool
+bcentry_alive(dns_bcentry_t *bad, isc_stdtime_t now) {
+	return (!cds_lfht_is_node_deleted(&bad->ht_node) &&
+		atomic_load_relaxed(&bad->expire) >= now);
+}
 
+/*
+ * Evict the entries in the wheel slots that have been passed since the
+ * last call, then make room for a new entry if the cache is full by
+ * evicting the entries closest to expiring.  The bc->lock must be held.
+ */
 static void
-bcentry_purge_next(struct cds_lfht *ht, struct cds_lfht_iter *iter,
-		   isc_stdtime_t now) {
-	/* Lazy-purge the table */
-	size_t count = 10;
-	dns_bcentry_t *bad;
-	cds_lfht_for_each_entry_next(ht, iter, bad, ht_node) {
-		if (!bcentry_alive(ht, bad, now)) {
-			break;
+bcentry_expire(dns_badcache_t *bc, struct cds_lfht *ht, isc_stdtime_t now) {
+	dns_bcentry_t *bad = NULL, *next = NULL;
+
+	for (isc_stdtime_t t = bc->wheel_time;
+	     t < now && t - bc->wheel_time < BADCACHE_WHEEL; t++)
+	{
+		dns_bclist_t *slot = bcentry_slot(bc, t);
+
+		for (bad = ISC_LIST_HEAD(*slot); bad != NULL; bad = next) {
+			next = ISC_LIST_NEXT(bad, link);
+			if (atomic_load_relaxed(&bad->expire) < now) {
+				bcentry_evict(bc, ht, bad);
+			}
 		}
-		if (--count == 0) {
-			break;
+	}
+	if (bc->wheel_time < now) {
+		bc->wheel_time = now;
+	}
+
+	for (isc_stdtime_t t = now; bc->count >= BADCACHE_MAX_ENTRIES;) {
+		bad = ISC_LIST_HEAD(*bcentry_slot(bc, t));
+		if (bad == NULL) {
+			t++;
+			continue;
 		}
+		bcentry_evict(bc, ht, bad);
 	}
 }
 
@@ -210,10 +255,13 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		expire = now;
 	}
 
+	LOCK(&bc->lock);
 	rcu_read_lock();
 	struct cds_lfht *ht = rcu_dereference(bc->ht);
 	INSIST(ht != NULL);
 
+	bcentry_expire(bc, ht, now);
+
 	dns_bcentry_t *bad = NULL;
 	uint32_t hashval = dns_name_hash(name);
 
@@ -221,31 +269,28 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 	dns_bcentry_t *found = NULL;
 	cds_lfht_for_each_entry_duplicate(ht, hashval, bcentry_match, name,
 					  &iter, bad, ht_node) {
-		if (bcentry_alive(ht, bad, now) && bad->type == type) {
+		if (bad->type == type && bcentry_alive(bad, now)) {
 			found = bad;
-			/*
-			 * We could bail-out on first match, but:
-			 * 1. there could be duplicate .type entries
-			 * 2. we want to check expire for all entries
-			 */
+			break;
 		}
 	}
 
 	if (found == NULL) {
-		/*
-		 * In theory, this could result in multiple entries for the same
-		 * type, but we don't care much, as they are going to be roughly
-		 * the same, and the last will always trump and the former
-		 * entries will expire (see above).
-		 */
 		bad = bcentry_new(bc, name, type, flags, expire);
 		cds_lfht_add(ht, hashval, &bad->ht_node);
+		ISC_LIST_APPEND(*bcentry_slot(bc, expire), bad, link);
+		bc->count++;
 	} else if (update) {
+		ISC_LIST_UNLINK(
+			*bcentry_slot(bc, atomic_load_relaxed(&found->expire)),
+			found, link);
 		atomic_store_relaxed(&found->expire, expire);
 		atomic_store_relaxed(&found->flags, flags);
+		ISC_LIST_APPEND(*bcentry_slot(bc, expire), found, link);
 	}
 
 	rcu_read_unlock();
+	UNLOCK(&bc->lock);
 }
 
 isc_result_t
@@ -267,9 +312,23 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 	dns_bcentry_t *found = NULL;
 	cds_lfht_for_each_entry_duplicate(ht, hashval, bcentry_match, name,
 					  &iter, bad, ht_node) {
-		if (bad->type == type && bcentry_alive(ht, bad, now)) {
-			found = bad;
+		if (bad->type != type ||
+		    cds_lfht_is_node_deleted(&bad->ht_node))
+		{
+			continue;
+		}
+		if (atomic_load_relaxed(&bad->expire) < now) {
+			/*
+			 * Do not wait for the wheel to get round to it.
+			 */
+			LOCK(&bc->lock);
+			if (atomic_load_relaxed(&bad->expire) < now) {
+				bcentry_evict(bc, ht, bad);
+			}
+			UNLOCK(&bc->lock);
+			continue;
 		}
+		found = bad;
 	}
 
 	if (found) {
@@ -277,8 +336,6 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		if (flagp != NULL) {
 			*flagp = atomic_load_relaxed(&found->flags);
 		}
-
-		bcentry_purge_next(ht, &iter, now);
 	}
 
 	rcu_read_unlock();
@@ -295,10 +352,16 @@ dns_badcache_flush(dns_badcache_t *bc) {
 			     CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	INSIST(ht != NULL);
 
-	/* First swap the hashtables */
+	/* First swap the hashtables and empty the wheel */
+	LOCK(&bc->lock);
 	rcu_read_lock();
 	ht = rcu_xchg_pointer(&bc->ht, ht);
 	rcu_read_unlock();
+	for (size_t i = 0; i < BADCACHE_WHEEL; i++) {
+		ISC_LIST_INIT(bc->wheel[i]);
+	}
+	bc->count = 0;
+	UNLOCK(&bc->lock);
 
 	/* Make sure nobody is using the old hash table */
 	synchronize_rcu();
@@ -318,6 +381,7 @@ dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
+	LOCK(&bc->lock);
 	rcu_read_lock();
 	struct cds_lfht *ht = rcu_dereference(bc->ht);
 	INSIST(ht != NULL);
@@ -328,10 +392,11 @@ dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry_duplicate(ht, hashval, bcentry_match, name,
 					  &iter, bad, ht_node) {
-		bcentry_evict(ht, bad);
+		bcentry_evict(bc, ht, bad);
 	}
 
 	rcu_read_unlock();
+	UNLOCK(&bc->lock);
 }
 
 void
@@ -342,20 +407,23 @@ dns_badcache_flushtree(dns_badcache_t *bc, const dns_name_t *name) {
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
+	LOCK(&bc->lock);
 	rcu_read_lock();
 	struct cds_lfht *ht = rcu_dereference(bc->ht);
 	INSIST(ht != NULL);
 
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
-		if (dns_name_issubdomain(bad->name, name)) {
-			bcentry_evict(ht, bad);
-		} else if (!bcentry_alive(ht, bad, now)) {
-			/* Flush all the expired entries */
+		/* Flush all the expired entries as well */
+		if (dns_name_issubdomain(bad->name, name) ||
+		    atomic_load_relaxed(&bad->expire) < now)
+		{
+			bcentry_evict(bc, ht, bad);
 		}
 	}
 
 	rcu_read_unlock();
+	UNLOCK(&bc->lock);
 }
 
 static void
@@ -385,7 +453,7 @@ dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
 
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
-		if (bcentry_alive(ht, bad, now)) {
+		if (bcentry_alive(bad, now)) {
 			bcentry_print(bad, now, fp);
 		}
 	}
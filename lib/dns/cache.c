@@ -15,7 +15,9 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 
+#include <isc/atomic.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
@@ -28,12 +30,16 @@
 #include <isc/util.h>
 
 #include <dns/cache.h>
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
+#include <dns/rdataslab.h>
 #include <dns/stats.h>
 
 #ifdef HAVE_JSON_C
@@ -58,6 +64,11 @@
  ***	Types
  ***/
 
+/*%
+ * Whether new cache databases are backed by huge pages.
+ */
+static atomic_bool cache_hugepages = false;
+
 /*%
  * The actual cache object.
  */
@@ -82,12 +93,33 @@ struct dns_cache {
 	isc_stats_t *stats;
 	uint32_t maxrrperset;
 	uint32_t maxtypepername;
+	dns_cacheeviction_t evictionpolicy;
+	bool packrecords;
+	char *dbtype;
+	char *filename;
+	char **imports;
+	size_t nimports;
 };
 
+/*%
+ * A snapshot being imported by dns_cache_loadasync().
+ */
+typedef struct cache_load {
+	isc_mem_t *mctx;
+	dns_db_t *db;
+	dns_rdatacallbacks_t callbacks;
+	dns_loadctx_t *lctx;
+	dns_loaddonefunc_t done;
+	void *done_arg;
+} cache_load_t;
+
 /***
  ***	Functions
  ***/
 
+static void
+cache_clearimports(dns_cache_t *cache);
+
 static isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 		isc_mem_t **hmctxp) {
@@ -95,13 +127,21 @@ cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 	char *argv[1] = { 0 };
 	dns_db_t *db = NULL;
 	isc_mem_t *tmctx = NULL, *hmctx = NULL;
+	char name[64];
 
 	/*
 	 * This will be the cache memory context, which is subject
 	 * to cleaning when the configured memory limits are exceeded.
+	 * Both the qp-trie chunks and the rdataslabs are allocated here,
+	 * so this is what benefits from huge pages.
 	 */
-	isc_mem_create(&tmctx);
-	isc_mem_setname(tmctx, "cache");
+	if (atomic_load_relaxed(&cache_hugepages)) {
+		isc_mem_create_hugepages(&tmctx);
+	} else {
+		isc_mem_create(&tmctx);
+	}
+	snprintf(name, sizeof(name), "cache/%s", cache->name);
+	isc_mem_setname(tmctx, name);
 
 	/*
 	 * This will be passed to RBTDB to use for heaps. This is separate
@@ -110,19 +150,28 @@ cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 	 * aggressively.
 	 */
 	isc_mem_create(&hmctx);
-	isc_mem_setname(hmctx, "cache_heap");
+	snprintf(name, sizeof(name), "cache_heap/%s", cache->name);
+	isc_mem_setname(hmctx, name);
 
 	/*
-	 * For databases of type "qpcache" or "rbt" (which are the
-	 * only cache implementations currently in existence) we pass
-	 * hmctx to dns_db_create() via argv[0].
+	 * Every cache implementation is passed hmctx via argv[0];
+	 * "qpcache" and "rbt" use it for their heaps, and other
+	 * implementations are free to ignore it.
 	 */
 	argv[0] = (char *)hmctx;
-	result = dns_db_create(tmctx, CACHEDB_DEFAULT, dns_rootname,
+	result = dns_db_create(tmctx, cache->dbtype, dns_rootname,
 			       dns_dbtype_cache, cache->rdclass, 1, argv, &db);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_mctx;
 	}
+	if (!dns_db_iscache(db)) {
+		isc_log_write(DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+			      ISC_LOG_ERROR,
+			      "database type '%s' cannot be used for a cache",
+			      cache->dbtype);
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup_db;
+	}
 	result = dns_db_setcachestats(db, cache->stats);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_db;
@@ -132,6 +181,8 @@ cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 	dns_db_setservestalerefresh(db, cache->serve_stale_refresh);
 	dns_db_setmaxrrperset(db, cache->maxrrperset);
 	dns_db_setmaxtypepername(db, cache->maxtypepername);
+	dns_db_setevictionpolicy(db, cache->evictionpolicy);
+	dns_db_setpackrecords(db, cache->packrecords);
 
 	/*
 	 * XXX this is only used by the RBT cache, and can
@@ -159,6 +210,11 @@ cache_destroy(dns_cache_t *cache) {
 	isc_stats_detach(&cache->stats);
 	isc_mutex_destroy(&cache->lock);
 	isc_mem_free(cache->mctx, cache->name);
+	isc_mem_free(cache->mctx, cache->dbtype);
+	if (cache->filename != NULL) {
+		isc_mem_free(cache->mctx, cache->filename);
+	}
+	cache_clearimports(cache);
 	if (cache->hmctx != NULL) {
 		isc_mem_detach(&cache->hmctx);
 	}
@@ -168,9 +224,15 @@ cache_destroy(dns_cache_t *cache) {
 	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
 }
 
+void
+dns_cache_sethugepages(bool enable) {
+	atomic_store_relaxed(&cache_hugepages, enable);
+}
+
 isc_result_t
 dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
-		 const char *cachename, isc_mem_t *mctx, dns_cache_t **cachep) {
+		 const char *cachename, const char *dbtype, isc_mem_t *mctx,
+		 dns_cache_t **cachep) {
 	isc_result_t result;
 	dns_cache_t *cache = NULL;
 
@@ -178,10 +240,15 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 	REQUIRE(cachename != NULL);
 	REQUIRE(cachep != NULL && *cachep == NULL);
 
+	if (dbtype == NULL) {
+		dbtype = CACHEDB_DEFAULT;
+	}
+
 	cache = isc_mem_get(mctx, sizeof(*cache));
 	*cache = (dns_cache_t){
 		.rdclass = rdclass,
 		.name = isc_mem_strdup(mctx, cachename),
+		.dbtype = isc_mem_strdup(mctx, dbtype),
 		.loopmgr = loopmgr,
 		.references = ISC_REFCOUNT_INITIALIZER(1),
 		.magic = CACHE_MAGIC,
@@ -250,10 +317,13 @@ static void
 updatewater(dns_cache_t *cache) {
 	size_t hi = cache->size - (cache->size >> 3); /* ~ 7/8ths. */
 	size_t lo = cache->size - (cache->size >> 2); /* ~ 3/4ths. */
+	size_t reclaim = hi - (cache->size >> 4);     /* ~ 13/16ths. */
 	if (cache->size == 0U || hi == 0U || lo == 0U) {
 		isc_mem_clearwater(cache->tmctx);
+		dns_db_setreclaimwater(cache->db, 0, 0);
 	} else {
 		isc_mem_setwater(cache->tmctx, hi, lo);
+		dns_db_setreclaimwater(cache->db, reclaim, lo);
 	}
 }
 
@@ -354,9 +424,9 @@ dns_cache_flush(dns_cache_t *cache) {
 	cache->hmctx = hmctx;
 	oldtmctx = cache->tmctx;
 	cache->tmctx = tmctx;
-	updatewater(cache);
 	olddb = cache->db;
 	cache->db = db;
+	updatewater(cache);
 	UNLOCK(&cache->lock);
 
 	dns_db_detach(&olddb);
@@ -500,7 +570,10 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 	}
 
 	if (tree) {
-		result = cleartree(cache->db, name);
+		result = dns_db_expiretree(cache->db, name);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			result = cleartree(cache->db, name);
+		}
 	} else {
 		result = dns_db_findnode(cache->db, name, false, &node);
 		if (result == ISC_R_NOTFOUND) {
@@ -570,6 +643,273 @@ dns_cache_setmaxtypepername(dns_cache_t *cache, uint32_t value) {
 	}
 }
 
+void
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_cacheeviction_t policy) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->evictionpolicy = policy;
+	if (cache->db != NULL) {
+		dns_db_setevictionpolicy(cache->db, policy);
+	}
+	UNLOCK(&cache->lock);
+}
+
+dns_cacheeviction_t
+dns_cache_getevictionpolicy(dns_cache_t *cache) {
+	dns_cacheeviction_t policy;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	policy = cache->evictionpolicy;
+	UNLOCK(&cache->lock);
+
+	return (policy);
+}
+
+const char *
+dns_cache_getdbtype(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (cache->dbtype);
+}
+
+void
+dns_cache_setpackrecords(dns_cache_t *cache, bool value) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->packrecords = value;
+	if (cache->db != NULL) {
+		dns_db_setpackrecords(cache->db, value);
+	}
+	UNLOCK(&cache->lock);
+}
+
+void
+dns_cache_setfilename(dns_cache_t *cache, const char *filename) {
+	char *newname = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	if (filename != NULL) {
+		newname = isc_mem_strdup(cache->mctx, filename);
+	}
+
+	LOCK(&cache->lock);
+	if (cache->filename != NULL) {
+		isc_mem_free(cache->mctx, cache->filename);
+	}
+	cache->filename = newname;
+	UNLOCK(&cache->lock);
+}
+
+const char *
+dns_cache_getfilename(dns_cache_t *cache) {
+	const char *filename;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	filename = cache->filename;
+	UNLOCK(&cache->lock);
+
+	return (filename);
+}
+
+static void
+cache_clearimports(dns_cache_t *cache) {
+	for (size_t i = 0; i < cache->nimports; i++) {
+		isc_mem_free(cache->mctx, cache->imports[i]);
+	}
+	if (cache->imports != NULL) {
+		isc_mem_cput(cache->mctx, cache->imports, cache->nimports,
+			     sizeof(cache->imports[0]));
+	}
+	cache->nimports = 0;
+}
+
+void
+dns_cache_setimports(dns_cache_t *cache, const char *const *filenames,
+		     size_t count) {
+	char **imports = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filenames != NULL || count == 0);
+
+	if (count != 0) {
+		imports = isc_mem_cget(cache->mctx, count, sizeof(imports[0]));
+		for (size_t i = 0; i < count; i++) {
+			imports[i] = isc_mem_strdup(cache->mctx, filenames[i]);
+		}
+	}
+
+	LOCK(&cache->lock);
+	cache_clearimports(cache);
+	cache->imports = imports;
+	cache->nimports = count;
+	UNLOCK(&cache->lock);
+}
+
+const char *
+dns_cache_getimport(dns_cache_t *cache, size_t idx) {
+	const char *filename = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	if (idx < cache->nimports) {
+		filename = cache->imports[idx];
+	}
+	UNLOCK(&cache->lock);
+
+	return (filename);
+}
+
+isc_result_t
+dns_cache_dump(dns_cache_t *cache, const char *filename) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_master_dump(cache->mctx, db, NULL, &dns_master_style_cache,
+				 filename, dns_masterformat_raw, NULL);
+	dns_db_detach(&db);
+
+	return (result);
+}
+
+isc_result_t
+dns_cache_dumpasync(dns_cache_t *cache, const char *filename,
+		    const dns_dumpfilter_t *filter, isc_loop_t *loop,
+		    dns_dumpdonefunc_t done, void *done_arg,
+		    dns_dumpctx_t **dctxp) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_master_dumpasync(cache->mctx, db, NULL,
+				      &dns_master_style_cache, filename, loop,
+				      done, done_arg, dctxp,
+				      dns_masterformat_raw, NULL, filter);
+	dns_db_detach(&db);
+
+	return (result);
+}
+
+static isc_result_t
+load_add(void *arg, const dns_name_t *owner,
+	 dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	dns_db_t *db = arg;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	/* Expired while the server was down. */
+	if (rdataset->ttl == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_db_findnode(db, owner, true, &node);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_db_addrdataset(db, node, NULL, 0, rdataset, 0, NULL);
+	dns_db_detachnode(db, &node);
+
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+isc_result_t
+dns_cache_load(dns_cache_t *cache, const char *filename) {
+	dns_rdatacallbacks_t callbacks;
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_name_copy(dns_rootname, origin);
+	dns_cache_attachdb(cache, &db);
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = load_add;
+	callbacks.add_private = db;
+
+	result = dns_master_loadfile(filename, origin, origin,
+				     cache->rdclass, DNS_MASTER_AGETTL, 0,
+				     &callbacks, NULL, NULL, cache->mctx,
+				     dns_masterformat_raw, 0);
+	dns_db_detach(&db);
+
+	return (result);
+}
+
+static void
+loadasync_done(void *arg, isc_result_t result) {
+	cache_load_t *cl = arg;
+	dns_loaddonefunc_t done = cl->done;
+	void *done_arg = cl->done_arg;
+
+	dns_loadctx_detach(&cl->lctx);
+	dns_db_detach(&cl->db);
+	isc_mem_putanddetach(&cl->mctx, cl, sizeof(*cl));
+
+	(done)(done_arg, result);
+}
+
+isc_result_t
+dns_cache_loadasync(dns_cache_t *cache, const char *filename,
+		    isc_loop_t *loop, dns_loaddonefunc_t done, void *done_arg) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	cache_load_t *cl = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+	REQUIRE(loop != NULL);
+	REQUIRE(done != NULL);
+
+	dns_name_copy(dns_rootname, origin);
+
+	cl = isc_mem_get(cache->mctx, sizeof(*cl));
+	*cl = (cache_load_t){
+		.done = done,
+		.done_arg = done_arg,
+	};
+	isc_mem_attach(cache->mctx, &cl->mctx);
+	dns_cache_attachdb(cache, &cl->db);
+
+	dns_rdatacallbacks_init(&cl->callbacks);
+	cl->callbacks.add = load_add;
+	cl->callbacks.add_private = cl->db;
+
+	result = dns_master_loadfileasync(
+		filename, origin, origin, cache->rdclass, DNS_MASTER_AGETTL, 0,
+		&cl->callbacks, loop, loadasync_done, cl, &cl->lctx, NULL, NULL,
+		cache->mctx, dns_masterformat_raw, 0);
+	if (result != ISC_R_SUCCESS) {
+		dns_db_detach(&cl->db);
+		isc_mem_putanddetach(&cl->mctx, cl, sizeof(*cl));
+	}
+
+	return (result);
+}
+
 /*
  * XXX: Much of the following code has been copied in from statschannel.c.
  * We should refactor this into a generic function in stats.c that can be
@@ -636,10 +976,29 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_coveringnsec],
 		"covering nsec returned");
+	fprintf(fp, "%20" PRIu64 " %s\n", values[dns_cachestatscounter_admitted],
+		"cache records admitted during memory exhaustion");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_probation],
+		"cache records put on probation during memory exhaustion");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_reclaimbatches],
+		"background cache reclaim batches");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_reclaimbytes],
+		"bytes freed by background cache reclaim");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_reclaimusecs],
+		"microseconds spent in background cache reclaim");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_overmemusecs],
+		"microseconds spent purging during memory exhaustion");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_main),
 		"cache database nodes");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec),
 		"cache NSEC auxiliary database nodes");
+	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec3),
+		"cache NSEC3 auxiliary database nodes");
 	fprintf(fp, "%20" PRIu64 " %s\n", (uint64_t)dns_db_hashsize(cache->db),
 		"cache database hash buckets");
 
@@ -648,6 +1007,9 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 
 	fprintf(fp, "%20" PRIu64 " %s\n", (uint64_t)isc_mem_inuse(cache->hmctx),
 		"cache heap memory in use");
+
+	fprintf(fp, "%20zu %s\n", sizeof(dns_slabheader_t),
+		"cache RRset header size");
 }
 
 #ifdef HAVE_LIBXML2
@@ -696,16 +1058,32 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 			writer));
 	TRY0(renderstat("CoveringNSEC",
 			values[dns_cachestatscounter_coveringnsec], writer));
+	TRY0(renderstat("AdmitOvermem", values[dns_cachestatscounter_admitted],
+			writer));
+	TRY0(renderstat("ProbationOvermem",
+			values[dns_cachestatscounter_probation], writer));
+	TRY0(renderstat("ReclaimBatches",
+			values[dns_cachestatscounter_reclaimbatches], writer));
+	TRY0(renderstat("ReclaimBytes",
+			values[dns_cachestatscounter_reclaimbytes], writer));
+	TRY0(renderstat("ReclaimUsecs",
+			values[dns_cachestatscounter_reclaimusecs], writer));
+	TRY0(renderstat("OvermemUsecs",
+			values[dns_cachestatscounter_overmemusecs], writer));
 
 	TRY0(renderstat("CacheNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_main), writer));
 	TRY0(renderstat("CacheNSECNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_nsec), writer));
+	TRY0(renderstat("CacheNSEC3Nodes",
+			dns_db_nodecount(cache->db, dns_dbtree_nsec3), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
 
 	TRY0(renderstat("TreeMemInUse", isc_mem_inuse(cache->tmctx), writer));
 
 	TRY0(renderstat("HeapMemInUse", isc_mem_inuse(cache->hmctx), writer));
+
+	TRY0(renderstat("RRsetHeaderSize", sizeof(dns_slabheader_t), writer));
 error:
 	return (xmlrc);
 }
@@ -761,6 +1139,32 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CoveringNSEC", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_admitted]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "AdmitOvermem", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_probation]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ProbationOvermem", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_reclaimbatches]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ReclaimBatches", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_reclaimbytes]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ReclaimBytes", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_reclaimusecs]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ReclaimUsecs", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_overmemusecs]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "OvermemUsecs", obj);
+
 	obj = json_object_new_int64(
 		dns_db_nodecount(cache->db, dns_dbtree_main));
 	CHECKMEM(obj);
@@ -771,6 +1175,11 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheNSECNodes", obj);
 
+	obj = json_object_new_int64(
+		dns_db_nodecount(cache->db, dns_dbtree_nsec3));
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CacheNSEC3Nodes", obj);
+
 	obj = json_object_new_int64(dns_db_hashsize(cache->db));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheBuckets", obj);
@@ -783,6 +1192,10 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "HeapMemInUse", obj);
 
+	obj = json_object_new_int64(sizeof(dns_slabheader_t));
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "RRsetHeaderSize", obj);
+
 	result = ISC_R_SUCCESS;
 error:
 	return (result);
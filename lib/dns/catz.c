@@ -30,6 +30,7 @@
 
 #include <dns/catz.h>
 #include <dns/dbiterator.h>
+#include <dns/journal.h>
 #include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -95,6 +96,9 @@ struct dns_catz_zone {
 	dns_dbversion_t *dbversion;   /* version we will be updating to */
 	dns_db_t *updb;		      /* zones database we're working on */
 	dns_dbversion_t *updbversion; /* version we're working on */
+	char *journal;		      /* journal of the catalog zone */
+	bool merged;		      /* 'serial' has been merged */
+	uint32_t serial;	      /* serial of the merged version */
 
 	isc_timer_t *updatetimer;
 
@@ -124,10 +128,10 @@ static isc_result_t
 catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 			     dns_label_t *mhash, dns_name_t *name);
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname);
+catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht,
+		      isc_ht_t *oldentries, unsigned char *key, size_t keysize,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname);
 
 /*%
  * Collection of catalog zones for a view
@@ -477,19 +481,28 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 
 	dns_catz_options_free(&catz->defoptions, catz->catzs->mctx);
 	dns_catz_options_init(&catz->defoptions);
+
+	/*
+	 * The default options are merged into the catalog zone options,
+	 * so the next update has to process all the member zones again.
+	 */
+	LOCK(&catz->catzs->lock);
+	catz->merged = false;
+	UNLOCK(&catz->catzs->lock);
 }
 
 /*%<
- * Merge 'newcatz' into 'catz', calling addzone/delzone/modzone
- * (from catz->catzs->zmm) for appropriate member zones.
+ * Compare the member zones in 'newentries' with the ones in 'oldentries',
+ * calling addzone/delzone/modzone (from catz->catzs->zmm) for the member
+ * zones that were added, deleted or modified. Spurious entries are
+ * removed from 'newentries', and 'oldentries' is left empty.
  *
  * Requires:
- * \li	'catz' is a valid dns_catz_zone_t.
- * \li	'newcatz' is a valid dns_catz_zone_t.
- *
+ * \li	'catz' is a valid dns_catz_zone_t, and 'catz->lock' is held.
  */
-static isc_result_t
-dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
+static void
+catz_entries_merge(dns_catz_zone_t *catz, isc_ht_t *oldentries,
+		   isc_ht_t *newentries) {
 	isc_result_t result;
 	isc_ht_iter_t *iter1 = NULL, *iter2 = NULL;
 	isc_ht_iter_t *iteradd = NULL, *itermod = NULL;
@@ -499,31 +512,18 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	char zname[DNS_NAME_FORMATSIZE];
 	dns_catz_zoneop_fn_t addzone, modzone, delzone;
 
-	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
-	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
-
-	LOCK(&catz->lock);
-
-	/* TODO verify the new zone first! */
-
 	addzone = catz->catzs->zmm->addzone;
 	modzone = catz->catzs->zmm->modzone;
 	delzone = catz->catzs->zmm->delzone;
 
-	/* Copy zoneoptions from newcatz into catz. */
-
-	dns_catz_options_free(&catz->zoneoptions, catz->catzs->mctx);
-	dns_catz_options_copy(catz->catzs->mctx, &newcatz->zoneoptions,
-			      &catz->zoneoptions);
-	dns_catz_options_setdefault(catz->catzs->mctx, &catz->defoptions,
-				    &catz->zoneoptions);
-
 	dns_name_format(&catz->name, czname, DNS_NAME_FORMATSIZE);
 
-	isc_ht_init(&toadd, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_ht_init(&tomod, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_ht_iter_create(newcatz->entries, &iter1);
-	isc_ht_iter_create(catz->entries, &iter2);
+	isc_ht_init_sized(&toadd, catz->catzs->mctx, isc_ht_count(newentries),
+			  ISC_HT_CASE_SENSITIVE | ISC_HT_FLAT);
+	isc_ht_init_sized(&tomod, catz->catzs->mctx, isc_ht_count(newentries),
+			  ISC_HT_CASE_SENSITIVE | ISC_HT_FLAT);
+	isc_ht_iter_create(newentries, &iter1);
+	isc_ht_iter_create(oldentries, &iter2);
 
 	/*
 	 * We can create those iterators now, even though toadd and tomod are
@@ -558,7 +558,7 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 		 * xxxwpk: make it a separate verification phase?
 		 */
 		if (dns_name_countlabels(&nentry->name) == 0) {
-			dns_catz_entry_detach(newcatz, &nentry);
+			dns_catz_entry_detach(catz, &nentry);
 			delcur = true;
 			continue;
 		}
@@ -624,7 +624,7 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 		}
 
 		/* Try to find the zone in the old catalog zone */
-		result = isc_ht_find(catz->entries, key, (uint32_t)keysize,
+		result = isc_ht_find(oldentries, key, (uint32_t)keysize,
 				     (void **)&oentry);
 		if (result != ISC_R_SUCCESS) {
 			if (find_result == ISC_R_SUCCESS && parentcatz == catz)
@@ -649,8 +649,9 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 					      zname);
 			}
 
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      NULL, "adding", zname, czname);
+			catz_entry_add_or_mod(catz, toadd, oldentries, key,
+					      keysize, nentry, NULL, "adding",
+					      zname, czname);
 			continue;
 		}
 
@@ -660,15 +661,16 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 				      "catz: zone '%s' was expected to exist "
 				      "but can not be found, will be restored",
 				      zname);
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      oentry, "adding", zname, czname);
+			catz_entry_add_or_mod(catz, toadd, oldentries, key,
+					      keysize, nentry, oentry, "adding",
+					      zname, czname);
 			continue;
 		}
 
 		if (dns_catz_entry_cmp(oentry, nentry) != true) {
-			catz_entry_add_or_mod(catz, tomod, key, keysize, nentry,
-					      oentry, "modifying", zname,
-					      czname);
+			catz_entry_add_or_mod(catz, tomod, oldentries, key,
+					      keysize, nentry, oentry,
+					      "modifying", zname, czname);
 			continue;
 		}
 
@@ -677,7 +679,7 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 		 * removed as a non-existing entry below.
 		 */
 		dns_catz_entry_detach(catz, &oentry);
-		result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
+		result = isc_ht_delete(oldentries, key, (uint32_t)keysize);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
@@ -703,9 +705,8 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
 	isc_ht_iter_destroy(&iter2);
-	/* At this moment catz->entries has to be be empty. */
-	INSIST(isc_ht_count(catz->entries) == 0);
-	isc_ht_destroy(&catz->entries);
+	/* At this moment oldentries has to be be empty. */
+	INSIST(isc_ht_count(oldentries) == 0);
 
 	for (result = isc_ht_iter_first(iteradd); result == ISC_R_SUCCESS;
 	     result = isc_ht_iter_delcurrent_next(iteradd))
@@ -739,6 +740,43 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 			      zname, czname, isc_result_totext(result));
 	}
 
+	isc_ht_iter_destroy(&iteradd);
+	isc_ht_iter_destroy(&itermod);
+	isc_ht_destroy(&toadd);
+	isc_ht_destroy(&tomod);
+}
+
+/*%<
+ * Merge 'newcatz' into 'catz', calling addzone/delzone/modzone
+ * (from catz->catzs->zmm) for appropriate member zones.
+ *
+ * Requires:
+ * \li	'catz' is a valid dns_catz_zone_t.
+ * \li	'newcatz' is a valid dns_catz_zone_t.
+ *
+ */
+static isc_result_t
+dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
+	isc_result_t result;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
+
+	LOCK(&catz->lock);
+
+	/* TODO verify the new zone first! */
+
+	/* Copy zoneoptions from newcatz into catz. */
+
+	dns_catz_options_free(&catz->zoneoptions, catz->catzs->mctx);
+	dns_catz_options_copy(catz->catzs->mctx, &newcatz->zoneoptions,
+			      &catz->zoneoptions);
+	dns_catz_options_setdefault(catz->catzs->mctx, &catz->defoptions,
+				    &catz->zoneoptions);
+
+	catz_entries_merge(catz, catz->entries, newcatz->entries);
+	isc_ht_destroy(&catz->entries);
+
 	catz->entries = newcatz->entries;
 	newcatz->entries = NULL;
 
@@ -771,16 +809,121 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 
 	result = ISC_R_SUCCESS;
 
-	isc_ht_iter_destroy(&iteradd);
-	isc_ht_iter_destroy(&itermod);
-	isc_ht_destroy(&toadd);
-	isc_ht_destroy(&tomod);
-
 	UNLOCK(&catz->lock);
 
 	return (result);
 }
 
+/*%<
+ * Merge 'newcatz', which only holds the member zones with the unique
+ * labels in 'members', into 'catz'. The other member zones of 'catz',
+ * and its catalog zone options, are left as they are.
+ *
+ * Requires:
+ * \li	'catz' is a valid dns_catz_zone_t.
+ * \li	'newcatz' is a valid dns_catz_zone_t.
+ */
+static void
+dns__catz_zones_patch(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+		      isc_ht_t *members) {
+	isc_result_t result;
+	isc_ht_t *oldentries = NULL;
+	isc_ht_iter_t *iter = NULL;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
+
+	LOCK(&catz->lock);
+
+	/*
+	 * Take the old entries of the changed member zones, and their
+	 * coo records, out of the catalog zone.
+	 */
+	isc_ht_init_sized(&oldentries, catz->catzs->mctx, isc_ht_count(members),
+			  ISC_HT_CASE_INSENSITIVE | ISC_HT_FLAT);
+	isc_ht_iter_create(members, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		dns_catz_coo_t *coo = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		if (isc_ht_find(catz->entries, key, (uint32_t)keysize,
+				(void **)&entry) != ISC_R_SUCCESS)
+		{
+			continue;
+		}
+
+		if (isc_ht_find(catz->coos, entry->name.ndata,
+				entry->name.length,
+				(void **)&coo) == ISC_R_SUCCESS)
+		{
+			catz_coo_detach(catz, &coo);
+			RUNTIME_CHECK(isc_ht_delete(catz->coos,
+						    entry->name.ndata,
+						    entry->name.length) ==
+				      ISC_R_SUCCESS);
+		}
+
+		RUNTIME_CHECK(isc_ht_add(oldentries, key, (uint32_t)keysize,
+					 entry) == ISC_R_SUCCESS);
+		RUNTIME_CHECK(isc_ht_delete(catz->entries, key,
+					    (uint32_t)keysize) ==
+			      ISC_R_SUCCESS);
+	}
+	INSIST(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	catz_entries_merge(catz, oldentries, newcatz->entries);
+	isc_ht_destroy(&oldentries);
+
+	/* Then put the new entries and coo records in their place. */
+	isc_ht_iter_create(newcatz->entries, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_current(iter, (void **)&entry);
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		RUNTIME_CHECK(isc_ht_add(catz->entries, key, (uint32_t)keysize,
+					 entry) == ISC_R_SUCCESS);
+	}
+	INSIST(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	isc_ht_iter_create(newcatz->coos, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		dns_catz_coo_t *coo = NULL, *oldcoo = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_current(iter, (void **)&coo);
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		if (isc_ht_find(catz->coos, key, (uint32_t)keysize,
+				(void **)&oldcoo) == ISC_R_SUCCESS)
+		{
+			catz_coo_detach(catz, &oldcoo);
+			RUNTIME_CHECK(isc_ht_delete(catz->coos, key,
+						    (uint32_t)keysize) ==
+				      ISC_R_SUCCESS);
+		}
+		RUNTIME_CHECK(isc_ht_add(catz->coos, key, (uint32_t)keysize,
+					 coo) == ISC_R_SUCCESS);
+	}
+	INSIST(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	UNLOCK(&catz->lock);
+}
+
 dns_catz_zones_t *
 dns_catz_zones_new(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 		   dns_catz_zonemodmethods_t *zmm) {
@@ -836,7 +979,7 @@ dns_catz_zone_new(dns_catz_zones_t *catzs, const dns_name_t *name) {
 	dns_catz_zones_attach(catzs, &catz->catzs);
 	isc_mutex_init(&catz->lock);
 	isc_refcount_init(&catz->references, 1);
-	isc_ht_init(&catz->entries, catzs->mctx, 4, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&catz->entries, catzs->mctx, 4, ISC_HT_CASE_INSENSITIVE);
 	isc_ht_init(&catz->coos, catzs->mctx, 4, ISC_HT_CASE_INSENSITIVE);
 	isc_time_settoepoch(&catz->lastupdated);
 	dns_catz_options_init(&catz->defoptions);
@@ -1038,6 +1181,9 @@ dns__catz_zone_destroy(dns_catz_zone_t *catz) {
 
 	INSIST(!catz->updaterunning);
 
+	if (catz->journal != NULL) {
+		isc_mem_free(mctx, catz->journal);
+	}
 	dns_name_free(&catz->name, mctx);
 	dns_catz_options_free(&catz->defoptions, mctx);
 	dns_catz_options_free(&catz->zoneoptions, mctx);
@@ -1713,10 +1859,10 @@ catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 }
 
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname) {
+catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht,
+		      isc_ht_t *oldentries, unsigned char *key, size_t keysize,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname) {
 	isc_result_t result = isc_ht_add(ht, key, (uint32_t)keysize, nentry);
 
 	if (result != ISC_R_SUCCESS) {
@@ -1727,7 +1873,7 @@ catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
 	}
 	if (oentry != NULL) {
 		dns_catz_entry_detach(catz, &oentry);
-		result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
+		result = isc_ht_delete(oldentries, key, (uint32_t)keysize);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 }
@@ -2117,8 +2263,8 @@ dns__catz_timer_cb(void *arg) {
 		      ISC_LOG_INFO, "catz: %s: reload start", domain);
 
 	dns_catz_zone_ref(catz);
-	isc_work_enqueue(catz->loop, dns__catz_update_cb, dns__catz_done_cb,
-			 catz);
+	isc_work_enqueue_bulk(catz->loop, dns__catz_update_cb,
+			      dns__catz_done_cb, catz);
 
 exit:
 	isc_timer_destroy(&catz->updatetimer);
@@ -2158,6 +2304,9 @@ dns_catz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 
 	/* New zone came as AXFR */
 	if (catz->db != NULL && catz->db != db) {
+		/* Its journal does not follow from the merged version. */
+		catz->merged = false;
+
 		/* Old db cleanup. */
 		if (catz->dbversion != NULL) {
 			dns_db_closeversion(catz->db, &catz->dbversion, false);
@@ -2198,6 +2347,32 @@ cleanup:
 	return (result);
 }
 
+void
+dns_catz_setjournal(dns_catz_zones_t *catzs, const dns_name_t *name,
+		    const char *journal) {
+	dns_catz_zone_t *catz = NULL;
+
+	REQUIRE(DNS_CATZ_ZONES_VALID(catzs));
+	REQUIRE(ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
+
+	LOCK(&catzs->lock);
+	if (catzs->zones == NULL ||
+	    isc_ht_find(catzs->zones, name->ndata, name->length,
+			(void **)&catz) != ISC_R_SUCCESS)
+	{
+		goto unlock;
+	}
+	if (catz->journal != NULL) {
+		isc_mem_free(catzs->mctx, catz->journal);
+		catz->journal = NULL;
+	}
+	if (journal != NULL) {
+		catz->journal = isc_mem_strdup(catzs->mctx, journal);
+	}
+unlock:
+	UNLOCK(&catzs->lock);
+}
+
 void
 dns_catz_dbupdate_unregister(dns_db_t *db, dns_catz_zones_t *catzs) {
 	REQUIRE(DNS_DB_VALID(db));
@@ -2220,10 +2395,297 @@ catz_rdatatype_is_processable(const dns_rdatatype_t type) {
 		type != dns_rdatatype_cdnskey && type != dns_rdatatype_zonemd);
 }
 
+/*
+ * Process the rdatasets of 'node', named 'name', in the version of the
+ * catalog zone database being updated to, into 'newcatz'.
+ */
+static isc_result_t
+catz_process_node(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+		  dns_dbnode_t *node, const dns_name_t *name) {
+	isc_result_t result;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_allrdatasets(catz->updb, node, catz->updbversion, 0, 0,
+				     &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+			      ISC_LOG_ERROR,
+			      "catz: failed to fetch rrdatasets - %s",
+			      isc_result_totext(result));
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatasetiter_first(rdsiter);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		/*
+		 * Skip processing DNSSEC-related and ZONEMD types,
+		 * because we are not interested in them in the context
+		 * of a catalog zone, and processing them will fail
+		 * and produce an unnecessary warning message.
+		 */
+		if (!catz_rdatatype_is_processable(rdataset.type)) {
+			goto next;
+		}
+
+		/*
+		 * Although newcatz->coos is accessed in
+		 * catz_process_coo() in the call-chain below, we don't
+		 * need to hold the newcatz->lock, because the newcatz
+		 * is still local to this thread and function and
+		 * newcatz->coos can't be accessed from the outside
+		 * until dns__catz_zones_merge() has been called.
+		 */
+		result = dns__catz_update_process(newcatz, name, &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			dns_name_format(name, cname, DNS_NAME_FORMATSIZE);
+			dns_rdataclass_format(rdataset.rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset.type, typebuf,
+					     sizeof(typebuf));
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+				      "catz: invalid record in catalog "
+				      "zone - %s %s %s (%s) - ignoring",
+				      cname, classbuf, typebuf,
+				      isc_result_totext(result));
+		}
+	next:
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_rdatasetiter_next(rdsiter);
+	}
+
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Collect the unique labels of the member zones changed by the journal
+ * transactions from 'serial' to 'end'. A change to anything else, such
+ * as the schema version or a global property, can affect all of the
+ * member zones, and is reported as ISC_R_NOTIMPLEMENTED.
+ */
+static isc_result_t
+catz_journal_members(dns_catz_zone_t *catz, const char *journal,
+		     uint32_t serial, uint32_t end, const dns_name_t *zones,
+		     isc_ht_t *members) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+
+	result = dns_journal_open(catz->catzs->mctx, journal, DNS_JOURNAL_READ,
+				  &j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_iter_init(j, serial, end, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		dns_label_t mhash;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		if (!catz_rdatatype_is_processable(rdata->type)) {
+			continue;
+		}
+		if (dns_name_equal(name, &catz->name) &&
+		    (rdata->type == dns_rdatatype_soa ||
+		     rdata->type == dns_rdatatype_ns))
+		{
+			continue;
+		}
+		if (!dns_name_issubdomain(name, zones) ||
+		    dns_name_equal(name, zones))
+		{
+			result = ISC_R_NOTIMPLEMENTED;
+			goto cleanup;
+		}
+
+		dns_name_getlabel(name, name->labels - zones->labels - 1,
+				  &mhash);
+		result = isc_ht_add(members, mhash.base, mhash.length, NULL);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			goto cleanup;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	dns_journal_destroy(&j);
+	return (result);
+}
+
+/*
+ * Process the member zone named 'member', and the names of its
+ * properties below it, into 'newcatz'.
+ */
+static isc_result_t
+catz_process_member(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+		    dns_dbiterator_t *updbit, const dns_name_t *member) {
+	isc_result_t result;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+
+	result = dns_dbiterator_seek(updbit, member);
+	switch (result) {
+	case ISC_R_SUCCESS:
+		break;
+	case DNS_R_PARTIALMATCH:
+		/* There may still be properties without the member zone */
+		result = dns_dbiterator_next(updbit);
+		break;
+	case ISC_R_NOTFOUND:
+		return (ISC_R_SUCCESS);
+	default:
+		return (result);
+	}
+
+	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(updbit, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (!dns_name_issubdomain(name, member)) {
+			dns_db_detachnode(catz->updb, &node);
+			result = ISC_R_NOMORE;
+			break;
+		}
+
+		result = dns_dbiterator_pause(updbit);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		result = catz_process_node(catz, newcatz, node, name);
+		dns_db_detachnode(catz->updb, &node);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		result = dns_dbiterator_next(updbit);
+	}
+
+	return ((result == ISC_R_NOMORE) ? ISC_R_SUCCESS : result);
+}
+
+/*
+ * Update the catalog zone from the journal between the version merged
+ * last and the version being updated to, processing only the member
+ * zones changed in between.
+ */
+static isc_result_t
+catz_update_from_journal(dns_catz_zone_t *catz, const char *journal,
+			 uint32_t serial, uint32_t end) {
+	isc_result_t result;
+	isc_ht_t *members = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_catz_zone_t *newcatz = NULL;
+	dns_dbiterator_t *updbit = NULL;
+	dns_fixedname_t fixzones, fixmember;
+	dns_name_t *zones = dns_fixedname_initname(&fixzones);
+	dns_name_t *member = dns_fixedname_initname(&fixmember);
+	char bname[DNS_NAME_FORMATSIZE];
+
+	result = dns_name_fromstring(zones, "zones", &catz->name, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	isc_ht_init(&members, catz->catzs->mctx, 1,
+		    ISC_HT_CASE_INSENSITIVE | ISC_HT_FLAT);
+	result = catz_journal_members(catz, journal, serial, end, zones,
+				      members);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = dns_db_createiterator(catz->updb, DNS_DB_NONSEC3, &updbit);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/*
+	 * The member zones are processed with the schema version of the
+	 * catalog zone, which has not changed.
+	 */
+	newcatz = dns_catz_zone_new(catz->catzs, &catz->name);
+	newcatz->version = catz->version;
+
+	isc_ht_iter_create(members, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_name_t mhash;
+		isc_region_t region;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		if (atomic_load(&catz->catzs->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+			break;
+		}
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		region.base = key;
+		region.length = (unsigned int)keysize;
+		dns_name_init(&mhash, NULL);
+		dns_name_fromregion(&mhash, &region);
+
+		result = dns_name_concatenate(&mhash, zones, member, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		result = catz_process_member(catz, newcatz, updbit, member);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+	dns_dbiterator_destroy(&updbit);
+	if (result == ISC_R_NOMORE) {
+		result = newcatz->broken ? ISC_R_FAILURE : ISC_R_SUCCESS;
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		dns__catz_zones_patch(catz, newcatz, members);
+
+		dns_name_format(&catz->name, bname, DNS_NAME_FORMATSIZE);
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+			      ISC_LOG_DEBUG(1),
+			      "catz: %s: %zu member zones changed in the "
+			      "journal",
+			      bname, isc_ht_count(members));
+	}
+	dns_catz_zone_detach(&newcatz);
+
+cleanup:
+	isc_ht_destroy(&members);
+	return (result);
+}
+
 /*
  * Process an updated database for a catalog zone.
- * It creates a new catz, iterates over database to fill it with content, and
- * then merges new catz into old catz.
+ * If the version merged last can be reached through the journal, only the
+ * changed member zones are processed.  Otherwise, it creates a new catz,
+ * iterates over database to fill it with content, and then merges new catz
+ * into old catz.
  */
 static void
 dns__catz_update_cb(void *data) {
@@ -2238,12 +2700,12 @@ dns__catz_update_cb(void *data) {
 	dns_dbiterator_t *updbit = NULL;
 	dns_fixedname_t fixname;
 	dns_name_t *name = NULL;
-	dns_rdatasetiter_t *rdsiter = NULL;
-	dns_rdataset_t rdataset;
 	char bname[DNS_NAME_FORMATSIZE];
 	char cname[DNS_NAME_FORMATSIZE];
+	char *journal = NULL;
 	bool is_vers_processed = false;
 	bool is_active;
+	uint32_t serial;
 	uint32_t vers;
 	uint32_t catz_vers;
 
@@ -2306,6 +2768,30 @@ dns__catz_update_cb(void *data) {
 		      "catz: updating catalog zone '%s' with serial %" PRIu32,
 		      bname, vers);
 
+	LOCK(&catzs->lock);
+	if (oldcatz->merged && oldcatz->journal != NULL) {
+		journal = isc_mem_strdup(catzs->mctx, oldcatz->journal);
+	}
+	serial = oldcatz->serial;
+	UNLOCK(&catzs->lock);
+
+	if (journal != NULL) {
+		result = catz_update_from_journal(oldcatz, journal, serial,
+						  vers);
+		isc_mem_free(catzs->mctx, journal);
+		if (result == ISC_R_SUCCESS ||
+		    result == ISC_R_SHUTTINGDOWN)
+		{
+			goto exit;
+		}
+
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+			      ISC_LOG_DEBUG(1),
+			      "catz: zone '%s' cannot be updated from the "
+			      "journal (%s), processing all member zones",
+			      bname, isc_result_totext(result));
+	}
+
 	result = dns_db_createiterator(updb, DNS_DB_NONSEC3, &updbit);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
@@ -2377,68 +2863,12 @@ dns__catz_update_cb(void *data) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(updb, node, oldcatz->updbversion,
-					     0, 0, &rdsiter);
+		result = catz_process_node(oldcatz, newcatz, node, name);
 		if (result != ISC_R_SUCCESS) {
-			isc_log_write(DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "catz: failed to fetch rrdatasets - %s",
-				      isc_result_totext(result));
 			dns_db_detachnode(updb, &node);
 			break;
 		}
 
-		dns_rdataset_init(&rdataset);
-		result = dns_rdatasetiter_first(rdsiter);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdatasetiter_current(rdsiter, &rdataset);
-
-			/*
-			 * Skip processing DNSSEC-related and ZONEMD types,
-			 * because we are not interested in them in the context
-			 * of a catalog zone, and processing them will fail
-			 * and produce an unnecessary warning message.
-			 */
-			if (!catz_rdatatype_is_processable(rdataset.type)) {
-				goto next;
-			}
-
-			/*
-			 * Although newcatz->coos is accessed in
-			 * catz_process_coo() in the call-chain below, we don't
-			 * need to hold the newcatz->lock, because the newcatz
-			 * is still local to this thread and function and
-			 * newcatz->coos can't be accessed from the outside
-			 * until dns__catz_zones_merge() has been called.
-			 */
-			result = dns__catz_update_process(newcatz, name,
-							  &rdataset);
-			if (result != ISC_R_SUCCESS) {
-				char typebuf[DNS_RDATATYPE_FORMATSIZE];
-				char classbuf[DNS_RDATACLASS_FORMATSIZE];
-
-				dns_name_format(name, cname,
-						DNS_NAME_FORMATSIZE);
-				dns_rdataclass_format(rdataset.rdclass,
-						      classbuf,
-						      sizeof(classbuf));
-				dns_rdatatype_format(rdataset.type, typebuf,
-						     sizeof(typebuf));
-				isc_log_write(DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_WARNING,
-					      "catz: invalid record in catalog "
-					      "zone - %s %s %s (%s) - ignoring",
-					      cname, classbuf, typebuf,
-					      isc_result_totext(result));
-			}
-		next:
-			dns_rdataset_disassociate(&rdataset);
-			result = dns_rdatasetiter_next(rdsiter);
-		}
-
-		dns_rdatasetiter_destroy(&rdsiter);
-
 		dns_db_detachnode(updb, &node);
 
 		if (!is_vers_processed) {
@@ -2519,6 +2949,10 @@ dns__catz_done_cb(void *data) {
 
 	LOCK(&catz->catzs->lock);
 	catz->updaterunning = false;
+	catz->merged = (catz->updateresult == ISC_R_SUCCESS &&
+			catz->updb == catz->db &&
+			dns_db_getsoaserial(catz->updb, catz->updbversion,
+					    &catz->serial) == ISC_R_SUCCESS);
 
 	dns_name_format(&catz->name, dname, DNS_NAME_FORMATSIZE);
 
@@ -0,0 +1,2320 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/log.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/qp.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/rdataslab.h>
+#include <dns/view.h>
+
+#include "compactdb_p.h"
+#include "qpzone_p.h"
+
+#define COMPACTDB_MAGIC ISC_MAGIC('C', 'D', 'B', '-')
+#define VALID_COMPACTDB(cdb) \
+	((cdb) != NULL && (cdb)->common.impmagic == COMPACTDB_MAGIC)
+
+/*%
+ * Zones with more rdatasets than this are loaded into a full "qpzone"
+ * database: the blob is meant for small zones, and rebuilding it for
+ * a big one on the first update would be slow.
+ */
+#define COMPACT_MAXRDATASETS 512
+
+#define COMPACT_ALIGN sizeof(void *)
+
+/*%
+ * The blob starts with the array of the nodes, in DNSSEC order, then
+ * the array of the offsets of their rdatasets, the owner names, and
+ * the rdatasets themselves, each a slab header followed by its slab.
+ */
+typedef struct compact_node {
+	uint32_t name; /* offset of the owner name */
+	uint32_t sets; /* index of the first rdataset in 'sets' */
+	uint16_t namelen;
+	uint16_t nsets;
+} compact_node_t;
+
+/*%
+ * An rdataset collected while loading, before the blob is built.
+ */
+typedef struct compact_item {
+	dns_name_t name;
+	dns_slabheader_t *header;
+} compact_item_t;
+
+typedef struct compactdb compactdb_t;
+
+typedef struct compact_load {
+	compactdb_t *cdb;
+	compact_item_t *items;
+	size_t nitems;
+	size_t nalloc;
+	bool transaction;
+	/*
+	 * Set when the zone turned out not to fit in a blob; everything
+	 * is then loaded into this database instead.
+	 */
+	dns_db_t *full;
+	dns_rdatacallbacks_t fullcallbacks;
+} compact_load_t;
+
+struct compactdb {
+	/* Unlocked. */
+	dns_db_t common;
+	int dummy_version;
+	struct rcu_head rcu_head;
+
+	/* Set by endload() and immutable afterwards. */
+	unsigned char *blob;
+	size_t size;
+	compact_node_t *nodes;
+	uint32_t *sets;
+	uint32_t nnodes;
+	compact_node_t *origin;
+	uint64_t records;
+	uint64_t xfrsize;
+
+	/* Locked by 'lock'. */
+	isc_mutex_t lock;
+	uint32_t maxrrperset;
+	uint32_t maxtypepername;
+	isc_loop_t *loop;
+	isc_stats_t *gluecachestats;
+
+	/*
+	 * The full database the zone has been promoted to, if any.  It
+	 * is only set once, with 'lock' held.
+	 */
+	_Atomic(dns_db_t *) full;
+
+	/*
+	 * The view whose shared trie has the names of the zone, set
+	 * before the zone is loaded; 'shared' is cleared when the names
+	 * are removed from the trie.
+	 */
+	dns_view_t *view;
+	atomic_bool shared;
+};
+
+/*
+ * A name in the trie shared by the compact zones of a view, with the
+ * node of each zone that has it.  Leaves are never changed once they
+ * are in the trie: adding or removing a zone replaces them.
+ */
+typedef struct compact_entry {
+	compactdb_t *cdb;
+	compact_node_t *node;
+} compact_entry_t;
+
+typedef struct compact_shared {
+	isc_mem_t *mctx;
+	struct rcu_head rcu_head;
+	dns_name_t name; /* points into the blob of entries[0] */
+	unsigned int count;
+	compact_entry_t entries[];
+} compact_shared_t;
+
+typedef struct compact_rdatasetiter {
+	dns_rdatasetiter_t common;
+	uint16_t current;
+} compact_rdatasetiter_t;
+
+typedef struct compact_dbiterator {
+	dns_dbiterator_t common;
+	isc_result_t result;
+	uint32_t current;
+	bool nsec3only;
+} compact_dbiterator_t;
+
+static dns_dbmethods_t compactdb_methods;
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp DNS__DB_FLARG);
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *iterator DNS__DB_FLARG);
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *iterator DNS__DB_FLARG);
+static void
+rdatasetiter_current(dns_rdatasetiter_t *iterator,
+		     dns_rdataset_t *rdataset DNS__DB_FLARG);
+
+static dns_rdatasetitermethods_t rdatasetiter_methods = {
+	rdatasetiter_destroy, rdatasetiter_first, rdatasetiter_next,
+	rdatasetiter_current
+};
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp DNS__DB_FLARG);
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator DNS__DB_FLARG);
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator DNS__DB_FLARG);
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator,
+		const dns_name_t *name DNS__DB_FLARG);
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator DNS__DB_FLARG);
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator DNS__DB_FLARG);
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name DNS__DB_FLARG);
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy, dbiterator_first, dbiterator_last,
+	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
+	dbiterator_current, dbiterator_pause, dbiterator_origin
+};
+
+/*
+ * Node references are references to the database: the blob lives as
+ * long as the database does.
+ */
+static void
+newref(compactdb_t *cdb) {
+	dns_db_ref(&cdb->common);
+}
+
+static void
+decref(compactdb_t *cdb) {
+	dns_db_unref(&cdb->common);
+}
+
+/*
+ * Is 'node' answered from the blob?  Until the zone is promoted, every
+ * node is; afterwards, only the nodes handed out before the promotion.
+ */
+static bool
+iscompact(compactdb_t *cdb, dns_dbnode_t *node) {
+	unsigned char *p = (unsigned char *)node;
+
+	return (atomic_load_acquire(&cdb->full) == NULL ||
+		(cdb->blob != NULL && p >= cdb->blob &&
+		 p < cdb->blob + cdb->size));
+}
+
+/*
+ * Return the full database if the zone has been promoted and 'version'
+ * isn't the blob's, or NULL if the request is for the blob.
+ */
+static dns_db_t *
+fullversion(compactdb_t *cdb, dns_dbversion_t *version) {
+	if (version == (void *)&cdb->dummy_version) {
+		return (NULL);
+	}
+	return (atomic_load_acquire(&cdb->full));
+}
+
+static void
+nodename(compactdb_t *cdb, compact_node_t *node, dns_name_t *name) {
+	isc_region_t r = {
+		.base = cdb->blob + node->name,
+		.length = node->namelen,
+	};
+
+	dns_name_init(name, NULL);
+	dns_name_fromregion(name, &r);
+}
+
+static dns_slabheader_t *
+nodeheader(compactdb_t *cdb, compact_node_t *node, unsigned int i) {
+	INSIST(i < node->nsets);
+	return ((dns_slabheader_t *)(cdb->blob + cdb->sets[node->sets + i]));
+}
+
+static dns_slabheader_t *
+findheader(compactdb_t *cdb, compact_node_t *node, dns_typepair_t type) {
+	for (unsigned int i = 0; i < node->nsets; i++) {
+		dns_slabheader_t *header = nodeheader(cdb, node, i);
+		if (header->type == type) {
+			return (header);
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Binary search for 'name': return true and its index if there is a
+ * node for it, and false and the index of the first node that sorts
+ * after it otherwise.
+ */
+static bool
+lookup(compactdb_t *cdb, const dns_name_t *name, uint32_t *indexp) {
+	uint32_t lo = 0, hi = cdb->nnodes;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		dns_name_t nname;
+		int order;
+
+		nodename(cdb, &cdb->nodes[mid], &nname);
+		order = dns_name_compare(name, &nname);
+		if (order == 0) {
+			*indexp = mid;
+			return (true);
+		} else if (order < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	*indexp = lo;
+	return (false);
+}
+
+/*
+ * In DNSSEC order a name is followed by its subdomains, so a name that
+ * has no node is an empty non-terminal if the node after it is one of
+ * them.
+ */
+static bool
+emptynonterminal(compactdb_t *cdb, const dns_name_t *name, uint32_t index) {
+	dns_name_t nname;
+
+	if (index >= cdb->nnodes) {
+		return (false);
+	}
+	nodename(cdb, &cdb->nodes[index], &nname);
+	return (dns_name_issubdomain(&nname, name));
+}
+
+static bool
+exists(compactdb_t *cdb, const dns_name_t *name) {
+	uint32_t index;
+
+	return (lookup(cdb, name, &index) ||
+		emptynonterminal(cdb, name, index));
+}
+
+static void
+bindrdataset(compactdb_t *cdb, dns_dbnode_t *node, dns_slabheader_t *header,
+	     dns_rdataset_t *rdataset) {
+	if (rdataset == NULL) {
+		return;
+	}
+
+	newref(cdb);
+
+	INSIST(rdataset->methods == NULL); /* We must be disassociated. */
+
+	rdataset->methods = &dns_rdataslab_rdatasetmethods;
+	rdataset->rdclass = cdb->common.rdclass;
+	rdataset->type = DNS_TYPEPAIR_TYPE(header->type);
+	rdataset->covers = DNS_TYPEPAIR_COVERS(header->type);
+	rdataset->ttl = header->ttl;
+	rdataset->trust = header->trust;
+	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+
+	rdataset->slab.db = (dns_db_t *)cdb;
+	rdataset->slab.node = node;
+	rdataset->slab.raw = dns_slabheader_raw(header);
+	rdataset->slab.iter_pos = NULL;
+	rdataset->slab.iter_count = 0;
+	rdataset->slab.noqname = NULL;
+	rdataset->slab.closest = NULL;
+}
+
+static unsigned int
+slabsize(dns_slabheader_t *header) {
+	return (dns_rdataslab_size((unsigned char *)header, sizeof(*header)));
+}
+
+static uint64_t
+recordsize(dns_slabheader_t *header, unsigned int namelen) {
+	return (dns_rdataslab_rdatasize((unsigned char *)header,
+					sizeof(*header)) +
+		sizeof(dns_ttl_t) + sizeof(dns_rdatatype_t) +
+		sizeof(dns_rdataclass_t) + namelen);
+}
+
+/*
+ * The trie shared by the compact zones of a view
+ */
+
+static void
+sharedattach(void *uctx ISC_ATTR_UNUSED, void *pval ISC_ATTR_UNUSED,
+	     uint32_t ival ISC_ATTR_UNUSED) {}
+
+static void
+sharedfree_cb(struct rcu_head *rcu_head) {
+	compact_shared_t *shared = caa_container_of(rcu_head,
+						    compact_shared_t, rcu_head);
+
+	isc_mem_putanddetach(&shared->mctx, shared,
+			     STRUCT_FLEX_SIZE(shared, entries, shared->count));
+}
+
+static void
+shareddetach(void *uctx ISC_ATTR_UNUSED, void *pval,
+	     uint32_t ival ISC_ATTR_UNUSED) {
+	compact_shared_t *shared = pval;
+
+	call_rcu(&shared->rcu_head, sharedfree_cb);
+}
+
+static size_t
+sharedmakekey(dns_qpkey_t key, void *uctx ISC_ATTR_UNUSED, void *pval,
+	      uint32_t ival ISC_ATTR_UNUSED) {
+	compact_shared_t *shared = pval;
+
+	return (dns_qpkey_fromname(key, &shared->name));
+}
+
+static void
+sharedtriename(void *uctx, char *buf, size_t size) {
+	dns_view_t *view = uctx;
+
+	snprintf(buf, size, "view %s shared zone trie", view->name);
+}
+
+static dns_qpmethods_t sharedmethods = {
+	sharedattach,
+	shareddetach,
+	sharedmakekey,
+	sharedtriename,
+};
+
+/*
+ * Make a copy of the leaf 'old' (which may be NULL) without the entry of
+ * 'cdb', and with 'node' as its new entry if it is not NULL.  Return
+ * NULL if the copy would have no entries.
+ */
+static compact_shared_t *
+sharedcopy(isc_mem_t *mctx, compact_shared_t *old, compactdb_t *cdb,
+	   compact_node_t *node) {
+	compact_shared_t *new = NULL;
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; old != NULL && i < old->count; i++) {
+		if (old->entries[i].cdb != cdb) {
+			count++;
+		}
+	}
+	if (node != NULL) {
+		count++;
+	}
+	if (count == 0) {
+		return (NULL);
+	}
+
+	new = isc_mem_get(mctx, STRUCT_FLEX_SIZE(new, entries, count));
+	*new = (compact_shared_t){ .count = 0 };
+	isc_mem_attach(mctx, &new->mctx);
+
+	for (unsigned int i = 0; old != NULL && i < old->count; i++) {
+		if (old->entries[i].cdb != cdb) {
+			new->entries[new->count++] = old->entries[i];
+		}
+	}
+	if (node != NULL) {
+		new->entries[new->count++] = (compact_entry_t){
+			.cdb = cdb,
+			.node = node,
+		};
+	}
+	nodename(new->entries[0].cdb, new->entries[0].node, &new->name);
+
+	return (new);
+}
+
+/*
+ * Add the names of the zone to the shared trie, or remove them.
+ */
+static void
+sharenames(compactdb_t *cdb, bool add) {
+	dns_qpmulti_t *multi = cdb->view->zonetrie;
+	isc_mem_t *mctx = cdb->view->mctx;
+	dns_qp_t *qp = NULL;
+
+	dns_qpmulti_write(multi, &qp);
+
+	for (uint32_t i = 0; i < cdb->nnodes; i++) {
+		compact_node_t *node = &cdb->nodes[i];
+		compact_shared_t *old = NULL, *new = NULL;
+		isc_result_t result;
+		dns_name_t name;
+
+		nodename(cdb, node, &name);
+		result = dns_qp_getname(qp, &name, (void **)&old, NULL);
+		if (result != ISC_R_SUCCESS) {
+			old = NULL;
+		}
+
+		new = sharedcopy(mctx, old, cdb, add ? node : NULL);
+
+		/* The old leaf is freed after an RCU grace period. */
+		if (old != NULL) {
+			dns_qp_deletename(qp, &name, NULL, NULL);
+		}
+		if (new != NULL) {
+			result = dns_qp_insert(qp, new, 0);
+			INSIST(result == ISC_R_SUCCESS);
+		}
+	}
+
+	dns_qp_compact(qp, DNS_QPGC_MAYBE);
+	dns_qpmulti_commit(multi, &qp);
+}
+
+static void
+sharezone(compactdb_t *cdb) {
+	if (cdb->view != NULL && cdb->nnodes > 0) {
+		sharenames(cdb, true);
+		atomic_store_release(&cdb->shared, true);
+	}
+}
+
+static void
+unsharezone(compactdb_t *cdb) {
+	bool shared = true;
+
+	if (atomic_compare_exchange_strong_acq_rel(&cdb->shared, &shared,
+						   false))
+	{
+		sharenames(cdb, false);
+	}
+}
+
+/*
+ * Create the full database, configured like this one.
+ */
+static isc_result_t
+createfull(compactdb_t *cdb, dns_db_t **fullp) {
+	isc_result_t result;
+
+	result = dns__qpzone_create(cdb->common.mctx, &cdb->common.origin,
+				    dns_dbtype_zone, cdb->common.rdclass, 0,
+				    NULL, NULL, fullp);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	dns_db_setmaxrrperset(*fullp, cdb->maxrrperset);
+	dns_db_setmaxtypepername(*fullp, cdb->maxtypepername);
+	if (cdb->loop != NULL) {
+		dns_db_setloop(*fullp, cdb->loop);
+	}
+	if (cdb->gluecachestats != NULL) {
+		(void)dns_db_setgluecachestats(*fullp, cdb->gluecachestats);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Copy the zone into a full database, which answers every request
+ * that isn't for the blob from then on.
+ */
+static isc_result_t
+promote(compactdb_t *cdb, dns_db_t **fullp) {
+	dns_rdatacallbacks_t callbacks;
+	dns_db_t *full = NULL;
+	isc_result_t result, tresult;
+
+	LOCK(&cdb->lock);
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		result = ISC_R_SUCCESS;
+		goto unlock;
+	}
+
+	result = createfull(cdb, &full);
+	if (result != ISC_R_SUCCESS) {
+		goto unlock;
+	}
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(full, &callbacks);
+	if (result != ISC_R_SUCCESS) {
+		dns_db_detach(&full);
+		goto unlock;
+	}
+
+	if (callbacks.setup != NULL) {
+		callbacks.setup(callbacks.add_private);
+	}
+	for (uint32_t i = 0; i < cdb->nnodes && result == ISC_R_SUCCESS; i++)
+	{
+		compact_node_t *node = &cdb->nodes[i];
+		dns_name_t name;
+
+		nodename(cdb, node, &name);
+		for (unsigned int j = 0;
+		     j < node->nsets && result == ISC_R_SUCCESS; j++)
+		{
+			dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+			bindrdataset(cdb, (dns_dbnode_t *)node,
+				     nodeheader(cdb, node, j), &rdataset);
+			result = callbacks.add(callbacks.add_private, &name,
+					       &rdataset DNS__DB_FILELINE);
+			dns_rdataset_disassociate(&rdataset);
+		}
+	}
+	if (callbacks.commit != NULL) {
+		callbacks.commit(callbacks.add_private);
+	}
+
+	tresult = dns_db_endload(full, &callbacks);
+	if (result == ISC_R_SUCCESS) {
+		result = tresult;
+	}
+	if (result != ISC_R_SUCCESS) {
+		dns_db_detach(&full);
+		goto unlock;
+	}
+
+	atomic_store_release(&cdb->full, full);
+
+	/*
+	 * The blob now only answers for the versions opened before the
+	 * promotion, so it is searched on its own.
+	 */
+	unsharezone(cdb);
+
+	if (isc_log_wouldlog(ISC_LOG_DEBUG(1))) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(&cdb->common.origin, namebuf, sizeof(namebuf));
+		isc_log_write(DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_DB,
+			      ISC_LOG_DEBUG(1),
+			      "compact database of '%s' promoted to qpzone",
+			      namebuf);
+	}
+
+unlock:
+	UNLOCK(&cdb->lock);
+
+	if (result == ISC_R_SUCCESS) {
+		*fullp = full;
+	}
+	return (result);
+}
+
+/*
+ * Find the database that answers a request for 'node' in '*versionp':
+ * '*fullp' is left NULL for the blob.  Otherwise '*fnodep' is the node
+ * to pass to the full database, which the caller must detach.  Callers
+ * that straddled the promotion may mix the blob's nodes and versions
+ * with the full database's; the node is then looked up by name, or the
+ * blob's version replaced with the current one.
+ */
+static isc_result_t
+route(compactdb_t *cdb, dns_dbnode_t *node, dns_dbversion_t **versionp,
+      bool create, dns_db_t **fullp, dns_dbnode_t **fnodep DNS__DB_FLARG) {
+	dns_db_t *full = NULL;
+	dns_name_t name;
+
+	if (!iscompact(cdb, node)) {
+		if (*versionp == (void *)&cdb->dummy_version) {
+			*versionp = NULL;
+		}
+		full = atomic_load_acquire(&cdb->full);
+		dns__db_attachnode(full, node, fnodep DNS__DB_FLARG_PASS);
+		*fullp = full;
+		return (ISC_R_SUCCESS);
+	}
+
+	full = fullversion(cdb, *versionp);
+	if (full == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	nodename(cdb, (compact_node_t *)node, &name);
+	*fullp = full;
+	return (dns__db_findnode(full, &name, create,
+				 fnodep DNS__DB_FLARG_PASS));
+}
+
+static void
+free_compactdb_rcu(struct rcu_head *rcu_head) {
+	compactdb_t *cdb = caa_container_of(rcu_head, compactdb_t, rcu_head);
+
+	if (cdb->common.update_listeners != NULL) {
+		INSIST(!cds_lfht_destroy(cdb->common.update_listeners, NULL));
+	}
+
+	/*
+	 * The shared trie may still be read by queries for other zones,
+	 * which compare their keys with the names in the blob.
+	 */
+	if (cdb->blob != NULL) {
+		isc_mem_put(cdb->common.mctx, cdb->blob, cdb->size);
+	}
+
+	isc_mem_putanddetach(&cdb->common.mctx, cdb, sizeof(*cdb));
+}
+
+static void
+destroy(dns_db_t *db) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = atomic_load_acquire(&cdb->full);
+
+	if (full != NULL) {
+		dns_db_detach(&full);
+	}
+	unsharezone(cdb);
+	if (cdb->view != NULL) {
+		dns_view_weakdetach(&cdb->view);
+	}
+	if (cdb->loop != NULL) {
+		isc_loop_detach(&cdb->loop);
+	}
+	if (cdb->gluecachestats != NULL) {
+		isc_stats_detach(&cdb->gluecachestats);
+	}
+	dns_name_free(&cdb->common.origin, cdb->common.mctx);
+	isc_mutex_destroy(&cdb->lock);
+	isc_refcount_destroy(&cdb->common.references);
+
+	cdb->common.magic = 0;
+	cdb->common.impmagic = 0;
+
+	call_rcu(&cdb->rcu_head, free_compactdb_rcu);
+}
+
+/*
+ * Loading
+ */
+
+static void
+freeitem(isc_mem_t *mctx, compact_item_t *item) {
+	isc_mem_put(mctx, item->header, slabsize(item->header));
+	item->header = NULL;
+	dns_name_free(&item->name, mctx);
+}
+
+static void
+freeitems(compact_load_t *loadctx) {
+	isc_mem_t *mctx = loadctx->cdb->common.mctx;
+
+	for (size_t i = 0; i < loadctx->nitems; i++) {
+		if (loadctx->items[i].header != NULL) {
+			freeitem(mctx, &loadctx->items[i]);
+		}
+	}
+	if (loadctx->items != NULL) {
+		isc_mem_cput(mctx, loadctx->items, loadctx->nalloc,
+			     sizeof(loadctx->items[0]));
+	}
+	loadctx->items = NULL;
+	loadctx->nitems = 0;
+	loadctx->nalloc = 0;
+}
+
+/*
+ * Can the zone still be loaded into a blob after 'rdataset'?  Signed
+ * zones need the NSEC chains, the re-signing heap and the glue cache of
+ * a full database.
+ */
+static bool
+compactable(compact_load_t *loadctx, dns_rdataset_t *rdataset) {
+	if (loadctx->nitems >= COMPACT_MAXRDATASETS) {
+		return (false);
+	}
+	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
+		return (false);
+	}
+	switch (rdataset->type) {
+	case dns_rdatatype_rrsig:
+	case dns_rdatatype_nsec:
+	case dns_rdatatype_nsec3:
+	case dns_rdatatype_nsec3param:
+		return (false);
+	default:
+		return (true);
+	}
+}
+
+/*
+ * Move the load to a full database, starting with the rdatasets
+ * collected so far.
+ */
+static isc_result_t
+loading_switch(compact_load_t *loadctx) {
+	compactdb_t *cdb = loadctx->cdb;
+	dns_rdatacallbacks_t *callbacks = &loadctx->fullcallbacks;
+	isc_result_t result;
+
+	LOCK(&cdb->lock);
+	result = createfull(cdb, &loadctx->full);
+	UNLOCK(&cdb->lock);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	dns_rdatacallbacks_init(callbacks);
+	result = dns_db_beginload(loadctx->full, callbacks);
+	if (result != ISC_R_SUCCESS) {
+		dns_db_detach(&loadctx->full);
+		return (result);
+	}
+
+	if (loadctx->transaction && callbacks->setup != NULL) {
+		callbacks->setup(callbacks->add_private);
+	}
+	for (size_t i = 0; i < loadctx->nitems && result == ISC_R_SUCCESS; i++)
+	{
+		compact_item_t *item = &loadctx->items[i];
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+		bindrdataset(cdb, (dns_dbnode_t *)item, item->header,
+			     &rdataset);
+		result = callbacks->add(callbacks->add_private, &item->name,
+					&rdataset DNS__DB_FILELINE);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	freeitems(loadctx);
+
+	return (result);
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	compact_load_t *loadctx = arg;
+	compactdb_t *cdb = loadctx->cdb;
+	dns_rdatacallbacks_t *callbacks = &loadctx->fullcallbacks;
+	dns_slabheader_t *header = NULL;
+	compact_item_t *item = NULL;
+	isc_region_t region;
+	isc_result_t result;
+
+	REQUIRE(rdataset->rdclass == cdb->common.rdclass);
+
+	if (loadctx->full == NULL && !compactable(loadctx, rdataset)) {
+		result = loading_switch(loadctx);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	if (loadctx->full != NULL) {
+		return (callbacks->add(callbacks->add_private, name,
+				       rdataset DNS__DB_FLARG_PASS));
+	}
+
+	/*
+	 * SOA records are only allowed at top of zone.
+	 */
+	if (rdataset->type == dns_rdatatype_soa &&
+	    !dns_name_equal(name, &cdb->common.origin))
+	{
+		return (DNS_R_NOTZONETOP);
+	}
+
+	/*
+	 * NS owners cannot legally be wild cards.
+	 */
+	if (rdataset->type == dns_rdatatype_ns && dns_name_iswildcard(name)) {
+		return (DNS_R_INVALIDNS);
+	}
+
+	result = dns_rdataslab_fromrdataset(rdataset, cdb->common.mctx,
+					    &region, sizeof(dns_slabheader_t),
+					    cdb->maxrrperset);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	header = (dns_slabheader_t *)region.base;
+	*header = (dns_slabheader_t){
+		.type = DNS_TYPEPAIR_VALUE(rdataset->type, rdataset->covers),
+		.ttl = rdataset->ttl,
+		.trust = rdataset->trust,
+		.serial = 1,
+		.count = 1,
+	};
+	dns_slabheader_reset(header, (dns_db_t *)cdb, NULL);
+	dns_slabheader_setownercase(header, name);
+
+	if (loadctx->nitems == loadctx->nalloc) {
+		size_t nalloc = ISC_MAX(16, loadctx->nalloc * 2);
+
+		loadctx->items = isc_mem_creget(
+			cdb->common.mctx, loadctx->items, loadctx->nalloc,
+			nalloc, sizeof(loadctx->items[0]));
+		loadctx->nalloc = nalloc;
+	}
+
+	item = &loadctx->items[loadctx->nitems++];
+	*item = (compact_item_t){
+		.name = DNS_NAME_INITEMPTY,
+		.header = header,
+	};
+	dns_name_dup(name, cdb->common.mctx, &item->name);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+loading_setup(void *arg) {
+	compact_load_t *loadctx = arg;
+	dns_rdatacallbacks_t *callbacks = &loadctx->fullcallbacks;
+
+	loadctx->transaction = true;
+	if (loadctx->full != NULL && callbacks->setup != NULL) {
+		callbacks->setup(callbacks->add_private);
+	}
+}
+
+static void
+loading_commit(void *arg) {
+	compact_load_t *loadctx = arg;
+	dns_rdatacallbacks_t *callbacks = &loadctx->fullcallbacks;
+
+	loadctx->transaction = false;
+	if (loadctx->full != NULL && callbacks->commit != NULL) {
+		callbacks->commit(callbacks->add_private);
+	}
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	compact_load_t *loadctx = NULL;
+
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(cdb->blob == NULL && atomic_load_acquire(&cdb->full) == NULL);
+
+	loadctx = isc_mem_get(cdb->common.mctx, sizeof(*loadctx));
+	*loadctx = (compact_load_t){ .cdb = cdb };
+
+	callbacks->add = loading_addrdataset;
+	callbacks->setup = loading_setup;
+	callbacks->commit = loading_commit;
+	callbacks->add_private = loadctx;
+
+	return (ISC_R_SUCCESS);
+}
+
+static int
+item_compare(const void *a, const void *b) {
+	const compact_item_t *ia = a, *ib = b;
+	int order = dns_name_compare(&ia->name, &ib->name);
+
+	if (order != 0) {
+		return (order);
+	}
+	return ((ia->header->type > ib->header->type) -
+		(ia->header->type < ib->header->type));
+}
+
+/*
+ * Sort the collected rdatasets, merge the ones that were loaded in
+ * pieces, and lay them all out in the blob.
+ */
+static isc_result_t
+build(compactdb_t *cdb, compact_load_t *loadctx) {
+	isc_mem_t *mctx = cdb->common.mctx;
+	compact_item_t *items = loadctx->items;
+	compact_item_t *last = NULL;
+	compact_node_t *node = NULL;
+	size_t nitems = loadctx->nitems;
+	size_t nnodes = 0, nsets = 0, namebytes = 0, slabbytes = 0;
+	size_t nameoff, slaboff, size;
+	unsigned int ntypes = 0;
+	uint32_t setindex = 0, index;
+	isc_result_t result;
+
+	if (nitems == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	qsort(items, nitems, sizeof(items[0]), item_compare);
+
+	for (size_t i = 0; i < nitems; i++) {
+		compact_item_t *item = &items[i];
+		unsigned char *merged = NULL;
+
+		if (last == NULL || !dns_name_equal(&item->name, &last->name))
+		{
+			nnodes++;
+			namebytes += item->name.length;
+			ntypes = 0;
+		} else if (item->header->type == last->header->type) {
+			result = dns_rdataslab_merge(
+				(unsigned char *)last->header,
+				(unsigned char *)item->header,
+				sizeof(dns_slabheader_t), mctx,
+				cdb->common.rdclass,
+				DNS_TYPEPAIR_TYPE(item->header->type), 0,
+				cdb->maxrrperset, &merged);
+			if (result == ISC_R_SUCCESS) {
+				slabbytes -= ISC_ALIGN(slabsize(last->header),
+						       COMPACT_ALIGN);
+				isc_mem_put(mctx, last->header,
+					    slabsize(last->header));
+				last->header = (dns_slabheader_t *)merged;
+				slabbytes += ISC_ALIGN(slabsize(last->header),
+						       COMPACT_ALIGN);
+			} else if (result != DNS_R_UNCHANGED) {
+				return (result);
+			}
+			freeitem(mctx, item);
+			continue;
+		}
+
+		if (cdb->maxtypepername > 0 && ++ntypes > cdb->maxtypepername)
+		{
+			return (DNS_R_TOOMANYRECORDS);
+		}
+
+		nsets++;
+		slabbytes += ISC_ALIGN(slabsize(item->header), COMPACT_ALIGN);
+		last = item;
+	}
+
+	nameoff = nnodes * sizeof(compact_node_t) + nsets * sizeof(uint32_t);
+	slaboff = ISC_ALIGN(nameoff + namebytes, COMPACT_ALIGN);
+	size = slaboff + slabbytes;
+	if (size > UINT32_MAX) {
+		return (ISC_R_RANGE);
+	}
+
+	cdb->blob = isc_mem_get(mctx, size);
+	cdb->size = size;
+	cdb->nodes = (compact_node_t *)cdb->blob;
+	cdb->sets = (uint32_t *)(cdb->blob + nnodes * sizeof(compact_node_t));
+
+	last = NULL;
+	for (size_t i = 0; i < nitems; i++) {
+		compact_item_t *item = &items[i];
+		dns_slabheader_t *header = NULL;
+		unsigned int length;
+
+		if (item->header == NULL) {
+			continue;
+		}
+
+		if (last == NULL || !dns_name_equal(&item->name, &last->name))
+		{
+			node = &cdb->nodes[cdb->nnodes++];
+			*node = (compact_node_t){
+				.name = nameoff,
+				.sets = setindex,
+				.namelen = item->name.length,
+			};
+			memmove(cdb->blob + nameoff, item->name.ndata,
+				item->name.length);
+			nameoff += item->name.length;
+		}
+
+		length = slabsize(item->header);
+		header = (dns_slabheader_t *)(cdb->blob + slaboff);
+		memmove(header, item->header, length);
+		header->node = (dns_dbnode_t *)node;
+
+		cdb->sets[setindex++] = slaboff;
+		node->nsets++;
+		slaboff += ISC_ALIGN(length, COMPACT_ALIGN);
+
+		cdb->records += dns_rdataslab_count((unsigned char *)header,
+						    sizeof(*header));
+		cdb->xfrsize += recordsize(header, node->namelen);
+
+		last = item;
+	}
+
+	INSIST(cdb->nnodes == nnodes && setindex == nsets);
+	INSIST(slaboff == size);
+
+	if (lookup(cdb, &cdb->common.origin, &index)) {
+		cdb->origin = &cdb->nodes[index];
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	compact_load_t *loadctx = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	loadctx = callbacks->add_private;
+	REQUIRE(loadctx != NULL);
+	REQUIRE(loadctx->cdb == cdb);
+
+	if (loadctx->full != NULL) {
+		result = dns_db_endload(loadctx->full, &loadctx->fullcallbacks);
+		if (result == ISC_R_SUCCESS) {
+			LOCK(&cdb->lock);
+			atomic_store_release(&cdb->full, loadctx->full);
+			UNLOCK(&cdb->lock);
+		} else {
+			dns_db_detach(&loadctx->full);
+		}
+	} else {
+		result = build(cdb, loadctx);
+		if (result == ISC_R_SUCCESS) {
+			sharezone(cdb);
+		}
+	}
+
+	freeitems(loadctx);
+
+	callbacks->add = NULL;
+	callbacks->setup = NULL;
+	callbacks->commit = NULL;
+	callbacks->add_private = NULL;
+
+	isc_mem_put(cdb->common.mctx, loadctx, sizeof(*loadctx));
+
+	return (result);
+}
+
+/*
+ * Versions
+ */
+
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(versionp != NULL && *versionp == NULL);
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		dns_db_currentversion(full, versionp);
+		return;
+	}
+
+	*versionp = (void *)&cdb->dummy_version;
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	result = promote(cdb, &full);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	return (dns_db_newversion(full, versionp));
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = fullversion(cdb, source);
+	if (full != NULL) {
+		dns_db_attachversion(full, source, targetp);
+		return;
+	}
+
+	REQUIRE(source == (void *)&cdb->dummy_version);
+	*targetp = source;
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp,
+	     bool commit DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(versionp != NULL);
+
+	full = fullversion(cdb, *versionp);
+	if (full != NULL) {
+		dns__db_closeversion(full, versionp,
+				     commit DNS__DB_FLARG_PASS);
+		return;
+	}
+
+	REQUIRE(*versionp == (void *)&cdb->dummy_version);
+	*versionp = NULL;
+}
+
+/*
+ * Lookups
+ */
+
+static isc_result_t
+findnode(dns_db_t *db, const dns_name_t *name, bool create,
+	 dns_dbnode_t **nodep DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+	uint32_t index;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full == NULL && create) {
+		result = promote(cdb, &full);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	if (full != NULL) {
+		return (dns__db_findnode(full, name, create,
+					 nodep DNS__DB_FLARG_PASS));
+	}
+
+	if (!lookup(cdb, name, &index)) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	newref(cdb);
+	*nodep = (dns_dbnode_t *)&cdb->nodes[index];
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Return the NS or DNAME rdataset that makes 'node' a zone cut, if any.
+ * NS has precedence over DNAME if both exist, and is ignored at the
+ * zone apex.
+ */
+static dns_slabheader_t *
+zonecut(compactdb_t *cdb, compact_node_t *node) {
+	dns_slabheader_t *header = NULL;
+
+	if (node != cdb->origin) {
+		header = findheader(cdb, node, dns_rdatatype_ns);
+	}
+	if (header == NULL) {
+		header = findheader(cdb, node, dns_rdatatype_dname);
+	}
+	return (header);
+}
+
+static isc_result_t
+delegation(compactdb_t *cdb, compact_node_t *node, dns_slabheader_t *header,
+	   dns_dbnode_t **nodep, dns_name_t *foundname,
+	   dns_rdataset_t *rdataset) {
+	dns_name_t name;
+
+	nodename(cdb, node, &name);
+	dns_name_copy(&name, foundname);
+
+	if (nodep != NULL) {
+		newref(cdb);
+		*nodep = (dns_dbnode_t *)node;
+	}
+	bindrdataset(cdb, (dns_dbnode_t *)node, header, rdataset);
+
+	if (header->type == dns_rdatatype_dname) {
+		return (DNS_R_DNAME);
+	}
+	return (DNS_R_DELEGATION);
+}
+
+/*
+ * Find the node for 'name', if there is one, and the highest zone cut
+ * above it, if any.
+ */
+static void
+blobfind(compactdb_t *cdb, const dns_name_t *name, compact_node_t **nodep,
+	 compact_node_t **cutp, dns_slabheader_t **cutheaderp) {
+	unsigned int olabels = dns_name_countlabels(&cdb->common.origin);
+	unsigned int nlabels = dns_name_countlabels(name);
+	uint32_t index;
+
+	for (unsigned int l = olabels; l < nlabels && *cutp == NULL; l++) {
+		dns_name_t ancestor;
+
+		dns_name_init(&ancestor, NULL);
+		dns_name_getlabelsequence(name, nlabels - l, l, &ancestor);
+		if (lookup(cdb, &ancestor, &index)) {
+			*cutheaderp = zonecut(cdb, &cdb->nodes[index]);
+			if (*cutheaderp != NULL) {
+				*cutp = &cdb->nodes[index];
+			}
+		}
+	}
+
+	if (lookup(cdb, name, &index)) {
+		*nodep = &cdb->nodes[index];
+	}
+}
+
+/*
+ * The same, with a single walk of the trie shared with the other
+ * compact zones of the view: the leaves in the chain of the walk are
+ * the ancestors of the name, in any of the zones.
+ */
+static void
+sharedfind(compactdb_t *cdb, const dns_name_t *name, compact_node_t **nodep,
+	   compact_node_t **cutp, dns_slabheader_t **cutheaderp) {
+	dns_qpmulti_t *multi = cdb->view->zonetrie;
+	dns_qpchain_t chain;
+	dns_qpread_t qpr;
+	isc_result_t result;
+
+	dns_qpmulti_query(multi, &qpr);
+	result = dns_qp_lookup(&qpr, name, NULL, NULL, &chain, NULL, NULL);
+	if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH) {
+		goto done;
+	}
+
+	for (unsigned int i = 0; i < dns_qpchain_length(&chain); i++) {
+		compact_shared_t *shared = NULL;
+		compact_node_t *node = NULL;
+
+		dns_qpchain_node(&chain, i, NULL, (void **)&shared, NULL);
+		for (unsigned int j = 0; j < shared->count; j++) {
+			if (shared->entries[j].cdb == cdb) {
+				node = shared->entries[j].node;
+				break;
+			}
+		}
+		if (node == NULL) {
+			continue;
+		}
+
+		if (result == ISC_R_SUCCESS &&
+		    i == dns_qpchain_length(&chain) - 1)
+		{
+			*nodep = node;
+		} else if (*cutp == NULL) {
+			*cutheaderp = zonecut(cdb, node);
+			if (*cutheaderp != NULL) {
+				*cutp = node;
+			}
+		}
+	}
+
+done:
+	dns_qpread_destroy(multi, &qpr);
+}
+
+/*
+ * Find the wildcard that matches 'name', which does not exist: the one
+ * below the closest encloser, the deepest ancestor of 'name' that does
+ * (RFC 4592).
+ */
+static compact_node_t *
+findwildcard(compactdb_t *cdb, const dns_name_t *name) {
+	unsigned int olabels = dns_name_countlabels(&cdb->common.origin);
+	unsigned int nlabels = dns_name_countlabels(name);
+
+	for (unsigned int l = nlabels - 1; l >= olabels; l--) {
+		dns_fixedname_t fixed;
+		dns_name_t *wname = dns_fixedname_initname(&fixed);
+		dns_name_t ancestor;
+		uint32_t index;
+
+		dns_name_init(&ancestor, NULL);
+		dns_name_getlabelsequence(name, nlabels - l, l, &ancestor);
+		if (!exists(cdb, &ancestor)) {
+			continue;
+		}
+
+		if (dns_name_concatenate(dns_wildcardname, &ancestor, wname,
+					 NULL) == ISC_R_SUCCESS &&
+		    lookup(cdb, wname, &index))
+		{
+			return (&cdb->nodes[index]);
+		}
+		break;
+	}
+
+	return (NULL);
+}
+
+static isc_result_t
+find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+     dns_dbnode_t **nodep, dns_name_t *foundname, dns_rdataset_t *rdataset,
+     dns_rdataset_t *sigrdataset DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	compact_node_t *node = NULL, *cut = NULL;
+	dns_slabheader_t *header = NULL, *found = NULL, *cutheader = NULL;
+	bool cname_ok = true, wild = false;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+	dns_name_t nname;
+	uint32_t index;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = fullversion(cdb, version);
+	if (full != NULL) {
+		return (dns__db_find(full, name, version, type, options, now,
+				     nodep, foundname, rdataset,
+				     sigrdataset DNS__DB_FLARG_PASS));
+	}
+
+	if ((options & DNS_DBFIND_FORCENSEC3) != 0 ||
+	    !dns_name_issubdomain(name, &cdb->common.origin))
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (atomic_load_acquire(&cdb->shared)) {
+		sharedfind(cdb, name, &node, &cut, &cutheader);
+	} else {
+		blobfind(cdb, name, &node, &cut, &cutheader);
+	}
+	if (cut != NULL && (options & DNS_DBFIND_GLUEOK) == 0) {
+		return (delegation(cdb, cut, cutheader, nodep, foundname,
+				   rdataset));
+	}
+
+	if (node != NULL) {
+		nodename(cdb, node, &nname);
+		dns_name_copy(&nname, foundname);
+	} else if (cut != NULL) {
+		return (delegation(cdb, cut, cutheader, nodep, foundname,
+				   rdataset));
+	} else if (!lookup(cdb, name, &index) &&
+		   emptynonterminal(cdb, name, index))
+	{
+		return (DNS_R_EMPTYNAME);
+	} else if ((options & DNS_DBFIND_NOWILD) == 0 &&
+		   (node = findwildcard(cdb, name)) != NULL)
+	{
+		dns_name_copy(name, foundname);
+		wild = true;
+	} else {
+		return (DNS_R_NXDOMAIN);
+	}
+
+	/*
+	 * Beneath a zone cut, CNAMEs are not legitimate zone glue, and
+	 * certain DNSSEC types are not subject to CNAME matching
+	 * (RFC4035, section 2.5 and RFC3007).
+	 */
+	if (cut != NULL || type == dns_rdatatype_key ||
+	    type == dns_rdatatype_nsec)
+	{
+		cname_ok = false;
+	}
+
+	/*
+	 * The node may be a zone cut itself.  DS records live above the
+	 * zone cut, so we want to ignore the referral for them.
+	 */
+	if (cut == NULL && node != cdb->origin &&
+	    !dns_rdatatype_atparent(type))
+	{
+		cutheader = findheader(cdb, node, dns_rdatatype_ns);
+		if (cutheader != NULL) {
+			cut = node;
+			if ((options & DNS_DBFIND_GLUEOK) == 0 &&
+			    type != dns_rdatatype_nsec &&
+			    type != dns_rdatatype_key)
+			{
+				return (delegation(cdb, cut, cutheader, nodep,
+						   foundname, rdataset));
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < node->nsets; i++) {
+		header = nodeheader(cdb, node, i);
+		if (header->type == type || type == dns_rdatatype_any) {
+			found = header;
+			break;
+		}
+		if (header->type == dns_rdatatype_cname && cname_ok) {
+			found = header;
+		}
+	}
+
+	if (found == NULL) {
+		if (cut != NULL) {
+			return (delegation(cdb, cut, cutheader, nodep,
+					   foundname, rdataset));
+		}
+		if (nodep != NULL) {
+			newref(cdb);
+			*nodep = (dns_dbnode_t *)node;
+		}
+		if (wild) {
+			foundname->attributes.wildcard = true;
+		}
+		return (DNS_R_NXRRSET);
+	}
+
+	if (type != found->type && type != dns_rdatatype_any &&
+	    found->type == dns_rdatatype_cname)
+	{
+		result = DNS_R_CNAME;
+	} else if (cut == node) {
+		/*
+		 * At the zone cut, only NSEC and KEY are not glue.
+		 */
+		if (type == dns_rdatatype_nsec || type == dns_rdatatype_key) {
+			result = ISC_R_SUCCESS;
+		} else if (type == dns_rdatatype_any) {
+			result = DNS_R_ZONECUT;
+		} else {
+			result = DNS_R_GLUE;
+		}
+	} else if (cut != NULL) {
+		result = DNS_R_GLUE;
+	} else {
+		result = ISC_R_SUCCESS;
+	}
+
+	if (nodep != NULL) {
+		newref(cdb);
+		*nodep = (dns_dbnode_t *)node;
+	}
+	if (type != dns_rdatatype_any) {
+		bindrdataset(cdb, (dns_dbnode_t *)node, found, rdataset);
+	}
+	if (wild) {
+		foundname->attributes.wildcard = true;
+	}
+
+	return (result);
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source,
+	   dns_dbnode_t **targetp DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	if (!iscompact(cdb, source)) {
+		dns__db_attachnode(atomic_load_acquire(&cdb->full), source,
+				   targetp DNS__DB_FLARG_PASS);
+		return;
+	}
+
+	newref(cdb);
+	*targetp = source;
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(targetp != NULL && *targetp != NULL);
+
+	if (!iscompact(cdb, *targetp)) {
+		dns__db_detachnode(atomic_load_acquire(&cdb->full),
+				   targetp DNS__DB_FLARG_PASS);
+		return;
+	}
+
+	*targetp = NULL;
+	decref(cdb);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	compact_dbiterator_t *iter = NULL;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		return (dns_db_createiterator(full, options, iteratorp));
+	}
+
+	iter = isc_mem_get(cdb->common.mctx, sizeof(*iter));
+	*iter = (compact_dbiterator_t){
+		.common.magic = DNS_DBITERATOR_MAGIC,
+		.common.methods = &dbiterator_methods,
+		.common.relative_names = ((options & DNS_DB_RELATIVENAMES) !=
+					  0),
+		.result = ISC_R_NOMORE,
+		.nsec3only = ((options & DNS_DB_NSEC3ONLY) != 0),
+	};
+
+	dns_db_attach(db, &iter->common.db);
+
+	*iteratorp = (dns_dbiterator_t *)iter;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     dns_rdatatype_t type, dns_rdatatype_t covers, isc_stdtime_t now,
+	     dns_rdataset_t *rdataset,
+	     dns_rdataset_t *sigrdataset DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_slabheader_t *header = NULL;
+	dns_dbnode_t *fnode = NULL;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(type != dns_rdatatype_any);
+
+	result = route(cdb, node, &version, false, &full,
+		       &fnode DNS__DB_FLARG_PASS);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (full != NULL) {
+		result = dns__db_findrdataset(full, fnode, version, type,
+					      covers, now, rdataset,
+					      sigrdataset DNS__DB_FLARG_PASS);
+		dns__db_detachnode(full, &fnode DNS__DB_FLARG_PASS);
+		return (result);
+	}
+
+	header = findheader(cdb, (compact_node_t *)node,
+			    DNS_TYPEPAIR_VALUE(type, covers));
+	if (header == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	bindrdataset(cdb, node, header, rdataset);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     unsigned int options, isc_stdtime_t now,
+	     dns_rdatasetiter_t **iteratorp DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	compact_rdatasetiter_t *iterator = NULL;
+	dns_dbnode_t *fnode = NULL;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	result = route(cdb, node, &version, false, &full,
+		       &fnode DNS__DB_FLARG_PASS);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (full != NULL) {
+		result = dns__db_allrdatasets(full, fnode, version, options,
+					      now,
+					      iteratorp DNS__DB_FLARG_PASS);
+		dns__db_detachnode(full, &fnode DNS__DB_FLARG_PASS);
+		return (result);
+	}
+
+	iterator = isc_mem_get(cdb->common.mctx, sizeof(*iterator));
+	*iterator = (compact_rdatasetiter_t){
+		.common.methods = &rdatasetiter_methods,
+		.common.db = db,
+		.common.node = node,
+		.common.version = version,
+		.common.options = options,
+		.common.now = now,
+		.common.magic = DNS_RDATASETITER_MAGIC,
+	};
+
+	newref(cdb);
+
+	*iteratorp = (dns_rdatasetiter_t *)iterator;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The blob can't be changed: the zone has to be promoted first, with
+ * dns_db_newversion(), and the changes made in a version of the full
+ * database.
+ */
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_dbnode_t *fnode = NULL;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	result = route(cdb, node, &version, true, &full,
+		       &fnode DNS__DB_FLARG_PASS);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (full == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = dns__db_addrdataset(full, fnode, version, now, rdataset,
+				     options, addedrdataset DNS__DB_FLARG_PASS);
+	dns__db_detachnode(full, &fnode DNS__DB_FLARG_PASS);
+	return (result);
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_dbnode_t *fnode = NULL;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	result = route(cdb, node, &version, true, &full,
+		       &fnode DNS__DB_FLARG_PASS);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (full == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = dns__db_subtractrdataset(full, fnode, version, rdataset,
+					  options,
+					  newrdataset DNS__DB_FLARG_PASS);
+	dns__db_detachnode(full, &fnode DNS__DB_FLARG_PASS);
+	return (result);
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_dbnode_t *fnode = NULL;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	result = route(cdb, node, &version, true, &full,
+		       &fnode DNS__DB_FLARG_PASS);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (full == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = dns__db_deleterdataset(full, fnode, version, type,
+					covers DNS__DB_FLARG_PASS);
+	dns__db_detachnode(full, &fnode DNS__DB_FLARG_PASS);
+	return (result);
+}
+
+static bool
+issecure(dns_db_t *db) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	return (full != NULL && dns_db_issecure(full));
+}
+
+static unsigned int
+nodecount(dns_db_t *db, dns_dbtree_t tree) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		return (dns_db_nodecount(full, tree));
+	}
+
+	return ((tree == dns_dbtree_main) ? cdb->nnodes : 0);
+}
+
+static void
+setloop(dns_db_t *db, isc_loop_t *loop) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	LOCK(&cdb->lock);
+	if (cdb->loop != NULL) {
+		isc_loop_detach(&cdb->loop);
+	}
+	if (loop != NULL) {
+		isc_loop_attach(loop, &cdb->loop);
+	}
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		dns_db_setloop(full, loop);
+	}
+	UNLOCK(&cdb->lock);
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		return (dns__db_getoriginnode(full, nodep DNS__DB_FLARG_PASS));
+	}
+
+	if (cdb->origin == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	newref(cdb);
+	*nodep = (dns_dbnode_t *)cdb->origin;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
+		   uint8_t *flags, uint16_t *iterations, unsigned char *salt,
+		   size_t *salt_length) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = fullversion(cdb, version);
+	if (full == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (dns_db_getnsec3parameters(full, version, hash, flags,
+					  iterations, salt, salt_length));
+}
+
+static isc_result_t
+findnsec3node(dns_db_t *db, const dns_name_t *name, bool create,
+	      dns_dbnode_t **nodep DNS__DB_FLARG) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full == NULL && create) {
+		result = promote(cdb, &full);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	if (full == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (dns__db_findnsec3node(full, name, create,
+				      nodep DNS__DB_FLARG_PASS));
+}
+
+static isc_result_t
+setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	return (dns_db_setsigningtime(full, rdataset, resign));
+}
+
+static isc_result_t
+getsigningtime(dns_db_t *db, isc_stdtime_t *resign, dns_name_t *foundname,
+	       dns_typepair_t *typepair) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = atomic_load_acquire(&cdb->full);
+	if (full == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (dns_db_getsigningtime(full, resign, foundname, typepair));
+}
+
+static isc_result_t
+getsize(dns_db_t *db, dns_dbversion_t *version, uint64_t *records,
+	uint64_t *xfrsize) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = fullversion(cdb, version);
+	if (full != NULL) {
+		return (dns_db_getsize(full, version, records, xfrsize));
+	}
+
+	SET_IF_NOT_NULL(records, cdb->records);
+	SET_IF_NOT_NULL(xfrsize, cdb->xfrsize);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(stats != NULL);
+
+	LOCK(&cdb->lock);
+	isc_stats_attach(stats, &cdb->gluecachestats);
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		(void)dns_db_setgluecachestats(full, stats);
+	}
+	UNLOCK(&cdb->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+locknode(dns_db_t *db, dns_dbnode_t *node, isc_rwlocktype_t type) {
+	compactdb_t *cdb = (compactdb_t *)db;
+
+	if (!iscompact(cdb, node)) {
+		dns_db_locknode(atomic_load_acquire(&cdb->full), node, type);
+	}
+}
+
+static void
+unlocknode(dns_db_t *db, dns_dbnode_t *node, isc_rwlocktype_t type) {
+	compactdb_t *cdb = (compactdb_t *)db;
+
+	if (!iscompact(cdb, node)) {
+		dns_db_unlocknode(atomic_load_acquire(&cdb->full), node, type);
+	}
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_name_t nname;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+	REQUIRE(node != NULL);
+	REQUIRE(name != NULL);
+
+	if (!iscompact(cdb, node)) {
+		return (dns_db_nodefullname(atomic_load_acquire(&cdb->full),
+					    node, name));
+	}
+
+	nodename(cdb, (compact_node_t *)node, &nname);
+	dns_name_copy(&nname, name);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+setmaxrrperset(dns_db_t *db, uint32_t value) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	LOCK(&cdb->lock);
+	cdb->maxrrperset = value;
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		dns_db_setmaxrrperset(full, value);
+	}
+	UNLOCK(&cdb->lock);
+}
+
+static void
+setmaxtypepername(dns_db_t *db, uint32_t value) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	LOCK(&cdb->lock);
+	cdb->maxtypepername = value;
+	full = atomic_load_acquire(&cdb->full);
+	if (full != NULL) {
+		dns_db_setmaxtypepername(full, value);
+	}
+	UNLOCK(&cdb->lock);
+}
+
+static uint64_t
+versionid(dns_db_t *db, dns_dbversion_t *version) {
+	compactdb_t *cdb = (compactdb_t *)db;
+	dns_db_t *full = NULL;
+
+	REQUIRE(VALID_COMPACTDB(cdb));
+
+	full = fullversion(cdb, version);
+	if (full == NULL) {
+		return (0);
+	}
+
+	return (dns_db_versionid(full, version));
+}
+
+/*
+ * There is no glue cache for the blob, so 'addglue' isn't implemented:
+ * the callers fall back to the regular additional section processing.
+ */
+static dns_dbmethods_t compactdb_methods = {
+	.destroy = destroy,
+	.beginload = beginload,
+	.endload = endload,
+	.currentversion = currentversion,
+	.newversion = newversion,
+	.attachversion = attachversion,
+	.closeversion = closeversion,
+	.findnode = findnode,
+	.find = find,
+	.attachnode = attachnode,
+	.detachnode = detachnode,
+	.createiterator = createiterator,
+	.findrdataset = findrdataset,
+	.allrdatasets = allrdatasets,
+	.addrdataset = addrdataset,
+	.subtractrdataset = subtractrdataset,
+	.deleterdataset = deleterdataset,
+	.issecure = issecure,
+	.nodecount = nodecount,
+	.setloop = setloop,
+	.getoriginnode = getoriginnode,
+	.getnsec3parameters = getnsec3parameters,
+	.findnsec3node = findnsec3node,
+	.setsigningtime = setsigningtime,
+	.getsigningtime = getsigningtime,
+	.getsize = getsize,
+	.setgluecachestats = setgluecachestats,
+	.locknode = locknode,
+	.unlocknode = unlocknode,
+	.nodefullname = nodefullname,
+	.setmaxrrperset = setmaxrrperset,
+	.setmaxtypepername = setmaxtypepername,
+	.versionid = versionid,
+};
+
+isc_result_t
+dns__compactdb_create(isc_mem_t *mctx, const dns_name_t *origin,
+		      dns_dbtype_t type, dns_rdataclass_t rdclass,
+		      unsigned int argc, char **argv, void *driverarg,
+		      dns_db_t **dbp) {
+	compactdb_t *cdb = NULL;
+
+	switch (type) {
+	case dns_dbtype_zone:
+		break;
+	case dns_dbtype_stub:
+		return (dns__qpzone_create(mctx, origin, type, rdclass, argc,
+					   argv, driverarg, dbp));
+	default:
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	cdb = isc_mem_get(mctx, sizeof(*cdb));
+	*cdb = (compactdb_t){
+		.common.origin = DNS_NAME_INITEMPTY,
+		.common.rdclass = rdclass,
+		.common.methods = &compactdb_methods,
+	};
+
+	isc_refcount_init(&cdb->common.references, 1);
+	isc_mutex_init(&cdb->lock);
+
+	cdb->common.update_listeners = cds_lfht_new(16, 16, 0, 0, NULL);
+
+	isc_mem_attach(mctx, &cdb->common.mctx);
+	dns_name_dupwithoffsets(origin, mctx, &cdb->common.origin);
+
+	cdb->common.magic = DNS_DB_MAGIC;
+	cdb->common.impmagic = COMPACTDB_MAGIC;
+
+	*dbp = (dns_db_t *)cdb;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns__compactdb_share(dns_db_t *db, dns_view_t *view) {
+	compactdb_t *cdb = (compactdb_t *)db;
+
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(DNS_VIEW_VALID(view));
+
+	if (!VALID_COMPACTDB(cdb)) {
+		return;
+	}
+
+	REQUIRE(cdb->blob == NULL && cdb->view == NULL);
+
+	LOCK(&view->lock);
+	if (view->zonetrie == NULL) {
+		dns_qpmulti_create(view->mctx, &sharedmethods, view,
+				   &view->zonetrie);
+	}
+	UNLOCK(&view->lock);
+
+	dns_view_weakattach(view, &cdb->view);
+}
+
+/*
+ * Rdataset Iterator Methods
+ */
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp DNS__DB_FLARG) {
+	compact_rdatasetiter_t *iterator = (compact_rdatasetiter_t *)*iteratorp;
+	dns_db_t *db = iterator->common.db;
+	dns_dbnode_t *node = iterator->common.node;
+
+	*iteratorp = NULL;
+
+	/* Detaching the node may free the database. */
+	isc_mem_put(db->mctx, iterator, sizeof(*iterator));
+	dns__db_detachnode(db, &node DNS__DB_FLARG_PASS);
+}
+
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *iterator DNS__DB_FLARG) {
+	compact_rdatasetiter_t *citer = (compact_rdatasetiter_t *)iterator;
+	compact_node_t *node = (compact_node_t *)iterator->node;
+
+	citer->current = 0;
+	return ((node->nsets > 0) ? ISC_R_SUCCESS : ISC_R_NOMORE);
+}
+
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *iterator DNS__DB_FLARG) {
+	compact_rdatasetiter_t *citer = (compact_rdatasetiter_t *)iterator;
+	compact_node_t *node = (compact_node_t *)iterator->node;
+
+	if (citer->current + 1 >= node->nsets) {
+		citer->current = node->nsets;
+		return (ISC_R_NOMORE);
+	}
+
+	citer->current++;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+rdatasetiter_current(dns_rdatasetiter_t *iterator,
+		     dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	compact_rdatasetiter_t *citer = (compact_rdatasetiter_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+	compact_node_t *node = (compact_node_t *)iterator->node;
+
+	REQUIRE(citer->current < node->nsets);
+
+	bindrdataset(cdb, iterator->node,
+		     nodeheader(cdb, node, citer->current), rdataset);
+}
+
+/*
+ * Database Iterator Methods
+ */
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)*iteratorp;
+	dns_db_t *db = iter->common.db;
+
+	*iteratorp = NULL;
+
+	isc_mem_put(db->mctx, iter, sizeof(*iter));
+	dns_db_detach(&db);
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+
+	if (iter->nsec3only || cdb->nnodes == 0) {
+		iter->result = ISC_R_NOMORE;
+	} else {
+		iter->current = 0;
+		iter->result = ISC_R_SUCCESS;
+	}
+	return (iter->result);
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+
+	if (iter->nsec3only || cdb->nnodes == 0) {
+		iter->result = ISC_R_NOMORE;
+	} else {
+		iter->current = cdb->nnodes - 1;
+		iter->result = ISC_R_SUCCESS;
+	}
+	return (iter->result);
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator,
+		const dns_name_t *name DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+	unsigned int nlabels = dns_name_countlabels(name);
+
+	iter->result = ISC_R_NOTFOUND;
+	if (iter->nsec3only) {
+		return (iter->result);
+	}
+
+	if (lookup(cdb, name, &iter->current)) {
+		iter->result = ISC_R_SUCCESS;
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Stop at the closest ancestor of the name.
+	 */
+	for (unsigned int l = nlabels - 1; l > 0; l--) {
+		dns_name_t ancestor;
+
+		dns_name_init(&ancestor, NULL);
+		dns_name_getlabelsequence(name, nlabels - l, l, &ancestor);
+		if (lookup(cdb, &ancestor, &iter->current)) {
+			iter->result = ISC_R_SUCCESS;
+			return (DNS_R_PARTIALMATCH);
+		}
+	}
+
+	return (iter->result);
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+
+	if (iter->result != ISC_R_SUCCESS) {
+		return (iter->result);
+	}
+
+	if (iter->current == 0) {
+		iter->result = ISC_R_NOMORE;
+	} else {
+		iter->current--;
+	}
+	return (iter->result);
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+
+	if (iter->result != ISC_R_SUCCESS) {
+		return (iter->result);
+	}
+
+	if (iter->current + 1 >= cdb->nnodes) {
+		iter->result = ISC_R_NOMORE;
+	} else {
+		iter->current++;
+	}
+	return (iter->result);
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name DNS__DB_FLARG) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+	compactdb_t *cdb = (compactdb_t *)iterator->db;
+	compact_node_t *node = NULL;
+
+	REQUIRE(iter->result == ISC_R_SUCCESS);
+
+	node = &cdb->nodes[iter->current];
+	if (name != NULL) {
+		dns_name_t nname;
+
+		nodename(cdb, node, &nname);
+		dns_name_copy(&nname, name);
+	}
+
+	newref(cdb);
+	*nodep = (dns_dbnode_t *)node;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator ISC_ATTR_UNUSED) {
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	compact_dbiterator_t *iter = (compact_dbiterator_t *)iterator;
+
+	if (iter->result != ISC_R_SUCCESS) {
+		return (iter->result);
+	}
+
+	dns_name_copy(dns_rootname, name);
+	return (ISC_R_SUCCESS);
+}
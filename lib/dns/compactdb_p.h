@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+/*****
+***** Module Info
+*****/
+
+/*! \file
+ * \brief
+ * Compact read-only zone DB implementation
+ *
+ * A "compact" zone keeps all of its records in a single immutable block
+ * of memory, with the owner names in DNSSEC order so that lookups are a
+ * binary search, and without any of the locks, trees and version
+ * bookkeeping of a full "qpzone" database.  It is meant for the many
+ * small zones that are never changed by dynamic updates.
+ *
+ * The first request to change the zone (dns_db_newversion(), or
+ * dns_db_findnode() with 'create' set) copies the zone into a "qpzone"
+ * database, which serves every later request; the callers keep using
+ * the same dns_db_t.  Zones that are too big, or that are signed, are
+ * loaded into a "qpzone" database from the start.
+ *
+ * The compact zones of a view with "shared-zone-trie" enabled also put
+ * their names in a qp-trie shared by the view, where a single walk from
+ * the query name finds both the node and the zone cuts above it.
+ */
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns__compactdb_create(isc_mem_t *mctx, const dns_name_t *base,
+		      dns_dbtype_t type, dns_rdataclass_t rdclass,
+		      unsigned int argc, char **argv, void *driverarg,
+		      dns_db_t **dbp);
+/*%<
+ * Create a new database of type "compact". Called via dns_db_create();
+ * see documentation for that function for more details.
+ *
+ * Stub zone databases are created as "qpzone" databases, and cache
+ * databases are not supported.
+ */
+
+void
+dns__compactdb_share(dns_db_t *db, dns_view_t *view);
+/*%<
+ * Put the names of the zone in the trie shared by the compact zones of
+ * 'view' when it is loaded.  Does nothing if 'db' isn't a compact
+ * database.
+ *
+ * Requires:
+ * \li	'db' is a valid database that has not been loaded yet.
+ * \li	'view' is a valid view.
+ */
+ISC_LANG_ENDDECLS
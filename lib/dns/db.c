@@ -59,6 +59,7 @@ struct dns_dbimplementation {
  * Built in database implementations are registered here.
  */
 
+#include "compactdb_p.h"
 #include "db_p.h"
 #include "qpcache_p.h"
 #include "qpzone_p.h"
@@ -73,6 +74,7 @@ static isc_once_t once = ISC_ONCE_INIT;
 static dns_dbimplementation_t rbtimp;
 static dns_dbimplementation_t qpimp;
 static dns_dbimplementation_t qpzoneimp;
+static dns_dbimplementation_t compactimp;
 
 static void
 initialize(void) {
@@ -98,9 +100,16 @@ initialize(void) {
 		.link = ISC_LINK_INITIALIZER,
 	};
 
+	compactimp = (dns_dbimplementation_t){
+		.name = "compact",
+		.create = dns__compactdb_create,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
 	ISC_LIST_APPEND(implementations, &rbtimp, link);
 	ISC_LIST_APPEND(implementations, &qpimp, link);
 	ISC_LIST_APPEND(implementations, &qpzoneimp, link);
+	ISC_LIST_APPEND(implementations, &compactimp, link);
 }
 
 static dns_dbimplementation_t *
@@ -1131,6 +1140,24 @@ dns_db_addglue(dns_db_t *db, dns_dbversion_t *version, dns_rdataset_t *rdataset,
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+dns_db_addadditional(dns_db_t *db, dns_dbversion_t *version,
+		     dns_rdataset_t *rdataset, bool dnssec, dns_message_t *msg) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->methods != NULL);
+	REQUIRE(rdataset->type == dns_rdatatype_mx ||
+		rdataset->type == dns_rdatatype_srv);
+
+	if (db->methods->addadditional != NULL) {
+		return ((db->methods->addadditional)(db, version, rdataset,
+						     dnssec, msg));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 void
 dns_db_locknode(dns_db_t *db, dns_dbnode_t *node, isc_rwlocktype_t type) {
 	if (db->methods->locknode != NULL) {
@@ -1159,6 +1186,19 @@ dns_db_deletedata(dns_db_t *db, dns_dbnode_t *node, void *data) {
 	}
 }
 
+isc_result_t
+dns_db_expiretree(dns_db_t *db, const dns_name_t *name) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iscache(db));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (db->methods->expiretree != NULL) {
+		return ((db->methods->expiretree)(db, name));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_db_nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
 	REQUIRE(db != NULL);
@@ -1188,3 +1228,43 @@ dns_db_setmaxtypepername(dns_db_t *db, uint32_t value) {
 		(db->methods->setmaxtypepername)(db, value);
 	}
 }
+
+void
+dns_db_setevictionpolicy(dns_db_t *db, dns_cacheeviction_t policy) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->setevictionpolicy != NULL) {
+		(db->methods->setevictionpolicy)(db, policy);
+	}
+}
+
+void
+dns_db_setpackrecords(dns_db_t *db, bool value) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->setpackrecords != NULL) {
+		(db->methods->setpackrecords)(db, value);
+	}
+}
+
+void
+dns_db_setreclaimwater(dns_db_t *db, size_t hiwater, size_t lowater) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(hiwater >= lowater);
+
+	if (db->methods->setreclaimwater != NULL) {
+		(db->methods->setreclaimwater)(db, hiwater, lowater);
+	}
+}
+
+uint64_t
+dns_db_versionid(dns_db_t *db, dns_dbversion_t *version) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(version != NULL);
+
+	if (db->methods->versionid != NULL) {
+		return ((db->methods->versionid)(db, version));
+	}
+
+	return (0);
+}
@@ -268,6 +268,7 @@ diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
 	t = ISC_LIST_HEAD(diff->tuples);
 	while (t != NULL) {
 		dns_name_t *name;
+		bool nsec3node = false;
 
 		INSIST(node == NULL);
 		name = &t->name;
@@ -278,6 +279,10 @@ diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
 		 * contains a deletion of an RR at a nonexistent name,
 		 * but such diffs should never be created in the first
 		 * place.
+		 *
+		 * The node is looked up once for all the tuples with the
+		 * same owner name, unless they switch between the main and
+		 * the NSEC3 tree.
 		 */
 
 		while (t != NULL && dns_name_equal(&t->name, name)) {
@@ -315,14 +320,20 @@ diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
 			rdl.rdclass = t->rdata.rdclass;
 			rdl.ttl = t->ttl;
 
-			node = NULL;
-			if (type != dns_rdatatype_nsec3 &&
-			    covers != dns_rdatatype_nsec3)
-			{
-				CHECK(dns_db_findnode(db, name, true, &node));
-			} else {
-				CHECK(dns_db_findnsec3node(db, name, true,
-							   &node));
+			bool nsec3 = (type == dns_rdatatype_nsec3 ||
+				      covers == dns_rdatatype_nsec3);
+			if (node != NULL && nsec3 != nsec3node) {
+				dns_db_detachnode(db, &node);
+			}
+			if (node == NULL) {
+				if (!nsec3) {
+					CHECK(dns_db_findnode(db, name, true,
+							      &node));
+				} else {
+					CHECK(dns_db_findnsec3node(db, name,
+								   true, &node));
+				}
+				nsec3node = nsec3;
 			}
 
 			while (t != NULL && dns_name_equal(&t->name, name) &&
@@ -478,11 +489,13 @@ diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
 				}
 				CHECK(result);
 			}
-			dns_db_detachnode(db, &node);
 			if (dns_rdataset_isassociated(&ardataset)) {
 				dns_rdataset_disassociate(&ardataset);
 			}
 		}
+		if (node != NULL) {
+			dns_db_detachnode(db, &node);
+		}
 	}
 	return (ISC_R_SUCCESS);
 
@@ -45,6 +45,8 @@
 #include <dns/transport.h>
 #include <dns/types.h>
 
+#include "probes.h"
+
 typedef ISC_LIST(dns_dispentry_t) dns_displist_t;
 
 struct dns_dispatchmgr {
@@ -60,7 +62,12 @@ struct dns_dispatchmgr {
 
 	struct cds_lfht **tcps;
 
-	struct cds_lfht *qids;
+	/*
+	 * Every dispatch, and so every dispatch entry, belongs to a
+	 * single loop, so each loop has its own QID table and the
+	 * outgoing query path never touches another thread's buckets.
+	 */
+	struct cds_lfht **qids;
 
 	in_port_t *v4ports;    /*%< available ports for IPv4 */
 	unsigned int nv4ports; /*%< # of available ports for IPv4 */
@@ -618,6 +625,8 @@ done:
 		dispentry_log(resp, ISC_LOG_DEBUG(90),
 			      "UDP read callback on %p: %s", handle,
 			      isc_result_totext(eresult));
+		LIBDNS_DISPATCH_RECV(resp, eresult,
+				     region != NULL ? region->length : 0);
 		resp->response(eresult, region, resp->arg);
 	}
 
@@ -688,8 +697,8 @@ tcp_recv_success(dns_dispatch_t *disp, isc_region_t *region,
 		.port = isc_sockaddr_getport(&disp->local),
 	};
 	struct cds_lfht_iter iter;
-	cds_lfht_lookup(disp->mgr->qids, qid_hash(&key), qid_match, &key,
-			&iter);
+	cds_lfht_lookup(disp->mgr->qids[disp->tid], qid_hash(&key), qid_match,
+			&key, &iter);
 
 	dns_dispentry_t *resp = cds_lfht_entry(cds_lfht_iter_get_node(&iter),
 					       dns_dispentry_t, ht_node);
@@ -751,6 +760,8 @@ tcp_recv_processall(dns_displist_t *resps, isc_region_t *region) {
 
 		dispentry_log(resp, ISC_LOG_DEBUG(90), "read callback: %s",
 			      isc_result_totext(resp->result));
+		LIBDNS_DISPATCH_RECV(resp, resp->result,
+				     region != NULL ? region->length : 0);
 		resp->response(resp->result, region, resp->arg);
 		dns_dispentry_detach(&resp); /* DISPENTRY009 */
 	}
@@ -998,10 +1009,14 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_nm_attach(nm, &mgr->nm);
 
 	mgr->tcps = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->tcps[0]));
+	mgr->qids = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->qids[0]));
 	for (size_t i = 0; i < mgr->nloops; i++) {
 		mgr->tcps[i] = cds_lfht_new(
 			2, 2, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
 			NULL);
+		mgr->qids[i] = cds_lfht_new(
+			QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	}
 
 	create_default_portset(mgr->mctx, AF_INET, &v4portset);
@@ -1012,10 +1027,6 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_portset_destroy(mgr->mctx, &v4portset);
 	isc_portset_destroy(mgr->mctx, &v6portset);
 
-	mgr->qids = cds_lfht_new(QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
-				 CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
-				 NULL);
-
 	mgr->magic = DNS_DISPATCHMGR_MAGIC;
 
 	*mgrp = mgr;
@@ -1058,11 +1069,11 @@ dispatchmgr_destroy(dns_dispatchmgr_t *mgr) {
 
 	mgr->magic = 0;
 
-	RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids, NULL));
-
 	for (size_t i = 0; i < mgr->nloops; i++) {
+		RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids[i], NULL));
 		RUNTIME_CHECK(!cds_lfht_destroy(mgr->tcps[i], NULL));
 	}
+	isc_mem_cput(mgr->mctx, mgr->qids, mgr->nloops, sizeof(mgr->qids[0]));
 	isc_mem_cput(mgr->mctx, mgr->tcps, mgr->nloops, sizeof(mgr->tcps[0]));
 
 	if (mgr->blackhole != NULL) {
@@ -1163,9 +1174,23 @@ dispatch_match(struct cds_lfht_node *node, const void *key0) {
 		peer = disp->peer;
 	}
 
-	return (isc_sockaddr_equal(&peer, key->peer) &&
-		disp->transport == key->transport &&
-		(key->local == NULL || isc_sockaddr_equal(&local, key->local)));
+	if (!isc_sockaddr_equal(&peer, key->peer) ||
+	    disp->transport != key->transport)
+	{
+		return (false);
+	}
+
+	/*
+	 * A local port of zero asks for any source port, which is what
+	 * a connected dispatch created with that address will have.
+	 */
+	if (key->local == NULL) {
+		return (true);
+	} else if (isc_sockaddr_getport(key->local) == 0) {
+		return (isc_sockaddr_eqaddr(&local, key->local));
+	} else {
+		return (isc_sockaddr_equal(&local, key->local));
+	}
 }
 
 isc_result_t
@@ -1492,8 +1517,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 				   : (dns_messageid_t)isc_random16();
 
 		struct cds_lfht_node *node =
-			cds_lfht_add_unique(disp->mgr->qids, qid_hash(resp),
-					    qid_match, resp, &resp->ht_node);
+			cds_lfht_add_unique(disp->mgr->qids[disp->tid],
+					    qid_hash(resp), qid_match, resp,
+					    &resp->ht_node);
 
 		if (node != &resp->ht_node) {
 			if ((options & DNS_DISPATCHOPT_FIXEDID) != 0) {
@@ -1626,7 +1652,7 @@ udp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_disprequdp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1723,7 +1749,7 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_dispreqtcp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1924,11 +1950,13 @@ udp_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 		isc_result_t result;
 
 		/* probably a port collision; try a different one */
+		inc_stats(disp->mgr, dns_resstatscounter_dispportretry);
 		result = setup_socket(disp, resp, &resp->peer, &localport);
 		if (result == ISC_R_SUCCESS) {
 			udp_dispatch_connect(disp, resp);
 			goto detach;
 		}
+		inc_stats(disp->mgr, dns_resstatscounter_dispsockfail);
 		resp->state = DNS_DISPATCHSTATE_NONE;
 		break;
 	}
@@ -2178,6 +2206,7 @@ dns_dispatch_send(dns_dispentry_t *resp, isc_region_t *r) {
 		UNREACHABLE();
 	}
 	dns_dispentry_ref(resp); /* DISPENTRY007 */
+	LIBDNS_DISPATCH_SEND(resp, r->length);
 	isc_nm_send(sendhandle, r, send_done, resp);
 }
 
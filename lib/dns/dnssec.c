@@ -20,11 +20,13 @@
 
 #include <isc/buffer.h>
 #include <isc/dir.h>
+#include <isc/file.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
@@ -1339,62 +1341,95 @@ failure:
 /*%
  * Get a list of DNSSEC keys from the key repository.
  */
+/*%
+ * Call 'action' for each directory that holds key files for 'kasp': the
+ * key-directory 'keydir' if there is no policy, or else the directory of
+ * each key store used by the policy.
+ */
+static isc_result_t
+foreach_keydir(dns_kasp_t *kasp, const char *keydir,
+	       dns_keystorelist_t *keystores,
+	       isc_result_t (*action)(const char *directory, void *arg),
+	       void *arg) {
+	if (kasp == NULL || (strcmp(dns_kasp_getname(kasp), "none") == 0) ||
+	    (strcmp(dns_kasp_getname(kasp), "insecure") == 0))
+	{
+		return (action(keydir, arg));
+	}
+
+	if (keystores == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (dns_keystore_t *keystore = ISC_LIST_HEAD(*keystores);
+	     keystore != NULL; keystore = ISC_LIST_NEXT(keystore, link))
+	{
+		for (dns_kasp_key_t *kkey = ISC_LIST_HEAD(dns_kasp_keys(kasp));
+		     kkey != NULL; kkey = ISC_LIST_NEXT(kkey, link))
+		{
+			if (dns_kasp_key_keystore(kkey) == keystore) {
+				isc_result_t result = action(
+					dns_keystore_directory(keystore,
+							       keydir),
+					arg);
+				if (result != ISC_R_SUCCESS) {
+					return (result);
+				}
+				break;
+			}
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+typedef struct {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	unsigned int len;
+	isc_mem_t *mctx;
+	isc_stdtime_t now;
+	dns_dnsseckeylist_t list;
+} findkeys_t;
+
+static isc_result_t
+findkeys_action(const char *directory, void *arg) {
+	findkeys_t *find = arg;
+
+	return (findmatchingkeys(directory, find->namebuf, find->len,
+				 find->mctx, find->now, &find->list));
+}
+
 isc_result_t
 dns_dnssec_findmatchingkeys(const dns_name_t *origin, dns_kasp_t *kasp,
 			    const char *keydir, dns_keystorelist_t *keystores,
 			    isc_stdtime_t now, isc_mem_t *mctx,
 			    dns_dnsseckeylist_t *keylist) {
 	isc_result_t result = ISC_R_SUCCESS;
-	dns_dnsseckeylist_t list;
+	findkeys_t find = { .mctx = mctx, .now = now };
 	dns_dnsseckey_t *key = NULL;
-	char namebuf[DNS_NAME_FORMATSIZE];
 	isc_buffer_t b;
-	unsigned int len;
 
 	REQUIRE(keylist != NULL);
-	ISC_LIST_INIT(list);
+	ISC_LIST_INIT(find.list);
 
-	isc_buffer_init(&b, namebuf, sizeof(namebuf) - 1);
+	isc_buffer_init(&b, find.namebuf, sizeof(find.namebuf) - 1);
 	RETERR(dns_name_tofilenametext(origin, false, &b));
-	len = isc_buffer_usedlength(&b);
-	namebuf[len] = '\0';
+	find.len = isc_buffer_usedlength(&b);
+	find.namebuf[find.len] = '\0';
 
-	if (kasp == NULL || (strcmp(dns_kasp_getname(kasp), "none") == 0) ||
-	    (strcmp(dns_kasp_getname(kasp), "insecure") == 0))
-	{
-		RETERR(findmatchingkeys(keydir, namebuf, len, mctx, now,
-					&list));
-	} else if (keystores != NULL) {
-		for (dns_keystore_t *keystore = ISC_LIST_HEAD(*keystores);
-		     keystore != NULL; keystore = ISC_LIST_NEXT(keystore, link))
-		{
-			for (dns_kasp_key_t *kkey =
-				     ISC_LIST_HEAD(dns_kasp_keys(kasp));
-			     kkey != NULL; kkey = ISC_LIST_NEXT(kkey, link))
-			{
-				if (dns_kasp_key_keystore(kkey) == keystore) {
-					const char *directory =
-						dns_keystore_directory(keystore,
-								       keydir);
-					RETERR(findmatchingkeys(
-						directory, namebuf, len, mctx,
-						now, &list));
-					break;
-				}
-			}
-		}
-	}
+	RETERR(foreach_keydir(kasp, keydir, keystores, findkeys_action,
+			      &find));
 
-	if (!ISC_LIST_EMPTY(list)) {
+	if (!ISC_LIST_EMPTY(find.list)) {
 		result = ISC_R_SUCCESS;
-		ISC_LIST_APPENDLIST(*keylist, list, link);
+		ISC_LIST_APPENDLIST(*keylist, find.list, link);
 	} else {
 		result = ISC_R_NOTFOUND;
 	}
 
 failure:
-	while ((key = ISC_LIST_HEAD(list)) != NULL) {
-		ISC_LIST_UNLINK(list, key, link);
+	while ((key = ISC_LIST_HEAD(find.list)) != NULL) {
+		ISC_LIST_UNLINK(find.list, key, link);
 		INSIST(key->key != NULL);
 		dst_key_free(&key->key);
 		dns_dnsseckey_destroy(mctx, &key);
@@ -1402,6 +1437,262 @@ failure:
 	return (result);
 }
 
+#define KEYCACHE_MAGIC	  ISC_MAGIC('K', 'y', 'C', 'h')
+#define VALID_KEYCACHE(c) ISC_MAGIC_VALID(c, KEYCACHE_MAGIC)
+
+typedef struct keycachefile keycachefile_t;
+struct keycachefile {
+	char *path;
+	isc_time_t modtime; /*%< zero if the file did not exist */
+	ISC_LINK(keycachefile_t) link;
+};
+
+typedef ISC_LIST(keycachefile_t) keycachefilelist_t;
+
+struct dns_dnsseckeycache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	keycachefilelist_t dirs;
+	keycachefilelist_t files;
+	dst_key_t **keys;
+	size_t nkeys;
+	size_t maxkeys;
+};
+
+static isc_time_t
+modtime(const char *path) {
+	isc_time_t when;
+
+	if (isc_file_getmodtime(path, &when) != ISC_R_SUCCESS) {
+		isc_time_settoepoch(&when);
+	}
+	return (when);
+}
+
+static void
+keycache_addfile(dns_dnsseckeycache_t *cache, keycachefilelist_t *list,
+		 const char *path) {
+	keycachefile_t *file = isc_mem_get(cache->mctx, sizeof(*file));
+
+	*file = (keycachefile_t){
+		.path = isc_mem_strdup(cache->mctx, path),
+		.modtime = modtime(path),
+		.link = ISC_LINK_INITIALIZER,
+	};
+	ISC_LIST_APPEND(*list, file, link);
+}
+
+static void
+keycache_clearfiles(dns_dnsseckeycache_t *cache, keycachefilelist_t *list) {
+	keycachefile_t *file = NULL;
+
+	while ((file = ISC_LIST_HEAD(*list)) != NULL) {
+		ISC_LIST_UNLINK(*list, file, link);
+		isc_mem_free(cache->mctx, file->path);
+		isc_mem_put(cache->mctx, file, sizeof(*file));
+	}
+}
+
+static void
+keycache_clear(dns_dnsseckeycache_t *cache) {
+	keycache_clearfiles(cache, &cache->dirs);
+	keycache_clearfiles(cache, &cache->files);
+	for (size_t i = 0; i < cache->nkeys; i++) {
+		dst_key_free(&cache->keys[i]);
+	}
+	if (cache->keys != NULL) {
+		isc_mem_cput(cache->mctx, cache->keys, cache->maxkeys,
+			     sizeof(cache->keys[0]));
+	}
+	cache->keys = NULL;
+	cache->nkeys = cache->maxkeys = 0;
+}
+
+static bool
+keycache_fileunchanged(keycachefile_t *file) {
+	isc_time_t when = modtime(file->path);
+
+	return (isc_time_compare(&when, &file->modtime) == 0);
+}
+
+static isc_result_t
+keycache_adddir(const char *directory, void *arg) {
+	dns_dnsseckeycache_t *cache = arg;
+
+	keycache_addfile(cache, &cache->dirs,
+			 directory != NULL ? directory : ".");
+	return (ISC_R_SUCCESS);
+}
+
+typedef struct {
+	keycachefile_t *next;
+} checkdirs_t;
+
+static isc_result_t
+keycache_checkdir(const char *directory, void *arg) {
+	checkdirs_t *check = arg;
+	keycachefile_t *dir = check->next;
+
+	if (directory == NULL) {
+		directory = ".";
+	}
+	if (dir == NULL || strcmp(dir->path, directory) != 0 ||
+	    !keycache_fileunchanged(dir))
+	{
+		return (ISC_R_NOTFOUND);
+	}
+	check->next = ISC_LIST_NEXT(dir, link);
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Check that the policy still uses the same key directories, and that
+ * neither they nor the key files have been modified.
+ */
+static bool
+keycache_current(dns_dnsseckeycache_t *cache, dns_kasp_t *kasp,
+		 const char *keydir, dns_keystorelist_t *keystores) {
+	checkdirs_t check = { .next = ISC_LIST_HEAD(cache->dirs) };
+	isc_result_t result;
+
+	if (check.next == NULL) {
+		return (false);
+	}
+
+	result = foreach_keydir(kasp, keydir, keystores, keycache_checkdir,
+				&check);
+	if (result != ISC_R_SUCCESS || check.next != NULL) {
+		return (false);
+	}
+
+	for (keycachefile_t *file = ISC_LIST_HEAD(cache->files); file != NULL;
+	     file = ISC_LIST_NEXT(file, link))
+	{
+		if (!keycache_fileunchanged(file)) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+void
+dns_dnsseckeycache_create(isc_mem_t *mctx, dns_dnsseckeycache_t **cachep) {
+	dns_dnsseckeycache_t *cache = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_dnsseckeycache_t){
+		.dirs = ISC_LIST_INITIALIZER,
+		.files = ISC_LIST_INITIALIZER,
+		.magic = KEYCACHE_MAGIC,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+
+	*cachep = cache;
+}
+
+void
+dns_dnsseckeycache_destroy(dns_dnsseckeycache_t **cachep) {
+	dns_dnsseckeycache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_KEYCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	keycache_clear(cache);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_dnsseckeycache_find(dns_dnsseckeycache_t *cache, const dns_name_t *origin,
+			dns_kasp_t *kasp, const char *keydir,
+			dns_keystorelist_t *keystores, isc_stdtime_t now,
+			isc_mem_t *mctx, dns_dnsseckeylist_t *keylist) {
+	isc_result_t result;
+
+	REQUIRE(VALID_KEYCACHE(cache));
+	REQUIRE(keylist != NULL);
+
+	if (!keycache_current(cache, kasp, keydir, keystores)) {
+		keycache_clear(cache);
+		return (dns_dnssec_findmatchingkeys(origin, kasp, keydir,
+						    keystores, now, mctx,
+						    keylist));
+	}
+
+	for (size_t i = 0; i < cache->nkeys; i++) {
+		dns_dnsseckey_t *key = NULL;
+		dst_key_t *dstkey = NULL;
+
+		dst_key_attach(cache->keys[i], &dstkey);
+		dns_dnsseckey_create(mctx, &dstkey, &key);
+		key->source = dns_keysource_repository;
+		dns_dnssec_get_hints(key, now);
+		ISC_LIST_APPEND(*keylist, key, link);
+	}
+	result = (cache->nkeys > 0) ? ISC_R_SUCCESS : ISC_R_NOTFOUND;
+
+	keycache_clear(cache);
+	return (result);
+}
+
+void
+dns_dnsseckeycache_update(dns_dnsseckeycache_t *cache, dns_kasp_t *kasp,
+			  const char *keydir, dns_keystorelist_t *keystores,
+			  dns_dnsseckeylist_t *keylist) {
+	static const int types[] = { DST_TYPE_PUBLIC, DST_TYPE_PRIVATE,
+				     DST_TYPE_STATE };
+
+	REQUIRE(VALID_KEYCACHE(cache));
+	REQUIRE(keylist != NULL);
+
+	keycache_clear(cache);
+
+	for (dns_dnsseckey_t *key = ISC_LIST_HEAD(*keylist); key != NULL;
+	     key = ISC_LIST_NEXT(key, link))
+	{
+		cache->maxkeys += key->purge ? 0 : 1;
+	}
+	if (cache->maxkeys > 0) {
+		cache->keys = isc_mem_cget(cache->mctx, cache->maxkeys,
+					   sizeof(cache->keys[0]));
+	}
+
+	(void)foreach_keydir(kasp, keydir, keystores, keycache_adddir, cache);
+
+	for (dns_dnsseckey_t *key = ISC_LIST_HEAD(*keylist); key != NULL;
+	     key = ISC_LIST_NEXT(key, link))
+	{
+		const char *directory = dst_key_directory(key->key);
+
+		if (key->purge) {
+			continue;
+		}
+
+		for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+			char filename[PATH_MAX];
+			isc_buffer_t b;
+			isc_result_t result;
+
+			isc_buffer_init(&b, filename, sizeof(filename));
+			result = dst_key_buildfilename(key->key, types[i],
+						       directory, &b);
+			if (result != ISC_R_SUCCESS) {
+				keycache_clear(cache);
+				return;
+			}
+			keycache_addfile(cache, &cache->files, filename);
+		}
+
+		dst_key_attach(key->key, &cache->keys[cache->nkeys++]);
+	}
+}
+
 /*%
  * Add 'newkey' to 'keylist' if it's not already there.
  *
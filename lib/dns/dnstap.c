@@ -55,6 +55,7 @@
 #include <stdlib.h>
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/file.h>
 #include <isc/log.h>
@@ -81,8 +82,16 @@
 #define DTENV_MAGIC	 ISC_MAGIC('D', 't', 'n', 'v')
 #define VALID_DTENV(env) ISC_MAGIC_VALID(env, DTENV_MAGIC)
 
-#define DNSTAP_CONTENT_TYPE	"protobuf:dnstap.Dnstap"
-#define DNSTAP_INITIAL_BUF_SIZE 256
+#define DNSTAP_CONTENT_TYPE "protobuf:dnstap.Dnstap"
+
+/*
+ * Protocol buffer wire types and field keys; every field number used
+ * here fits in a one octet key.
+ */
+#define PB_VARINT	 0
+#define PB_LENGTH	 2
+#define PB_FIXED32	 5
+#define PB_KEY(field, wt) (((field) << 3) | (wt))
 
 struct dns_dtmsg {
 	void *buf;
@@ -118,6 +127,7 @@ struct dns_dtenv {
 	int rolls;
 	isc_log_rollsuffix_t suffix;
 	isc_stats_t *stats;
+	atomic_uint_fast32_t sample;
 };
 
 #define CHECK(x)                             \
@@ -134,6 +144,13 @@ typedef struct ioq {
 
 static thread_local dt__ioq_t dt_ioq = { 0 };
 
+/*
+ * Per-thread sampling counters, one for each dnstap message type.
+ */
+#define DT_NTYPES (DNSTAP__MESSAGE__TYPE__UPDATE_RESPONSE + 1)
+
+static thread_local uint32_t dt_sampled[DT_NTYPES];
+
 static atomic_uint_fast32_t global_generation;
 
 isc_result_t
@@ -161,6 +178,7 @@ dns_dt_create(isc_mem_t *mctx, dns_dtmode_t mode, const char *path,
 	*env = (dns_dtenv_t){
 		.loop = loop,
 		.reopen_queued = false,
+		.sample = 1,
 	};
 
 	isc_mem_attach(mctx, &env->mctx);
@@ -421,6 +439,14 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version) {
 	return (toregion(env, &env->version, version));
 }
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t sample) {
+	REQUIRE(VALID_DTENV(env));
+	REQUIRE(sample > 0);
+
+	atomic_store_relaxed(&env->sample, sample);
+}
+
 static void
 set_dt_ioq(unsigned int generation, struct fstrm_iothr_queue *ioq) {
 	dt_ioq.generation = generation;
@@ -516,34 +542,179 @@ dns_dt_detach(dns_dtenv_t **envp) {
 	}
 }
 
+/*
+ * The outgoing Dnstap messages are encoded here rather than with
+ * protobuf-c, whose packer walks the message descriptors and keeps
+ * growing its output buffer: the frame is first measured, by running
+ * the encoder with a NULL output pointer, and then written in one pass
+ * into a buffer of the exact size.  Fields are written in field number
+ * order, so the output is the same as protobuf-c's.
+ */
+typedef struct pbuf {
+	uint8_t *p;
+	size_t len;
+} pbuf_t;
+
+static void
+pb_putvarint(pbuf_t *pb, uint64_t v) {
+	do {
+		uint8_t octet = v & 0x7f;
+
+		v >>= 7;
+		if (pb->p != NULL) {
+			*pb->p++ = octet | ((v != 0) ? 0x80 : 0);
+		}
+		pb->len++;
+	} while (v != 0);
+}
+
+static void
+pb_varint(pbuf_t *pb, unsigned int field, uint64_t v) {
+	pb_putvarint(pb, PB_KEY(field, PB_VARINT));
+	pb_putvarint(pb, v);
+}
+
+static void
+pb_fixed32(pbuf_t *pb, unsigned int field, uint32_t v) {
+	pb_putvarint(pb, PB_KEY(field, PB_FIXED32));
+	if (pb->p != NULL) {
+		pb->p[0] = v & 0xff;
+		pb->p[1] = (v >> 8) & 0xff;
+		pb->p[2] = (v >> 16) & 0xff;
+		pb->p[3] = (v >> 24) & 0xff;
+		pb->p += 4;
+	}
+	pb->len += 4;
+}
+
+static void
+pb_bytes(pbuf_t *pb, unsigned int field, const ProtobufCBinaryData *data) {
+	pb_putvarint(pb, PB_KEY(field, PB_LENGTH));
+	pb_putvarint(pb, data->len);
+	if (pb->p != NULL && data->len != 0) {
+		memmove(pb->p, data->data, data->len);
+		pb->p += data->len;
+	}
+	pb->len += data->len;
+}
+
+static void
+pack_message(pbuf_t *pb, const Dnstap__Message *m) {
+	INSIST(m->policy == NULL);
+
+	pb_varint(pb, 1, m->type);
+	if (m->has_socket_family) {
+		pb_varint(pb, 2, m->socket_family);
+	}
+	if (m->has_socket_protocol) {
+		pb_varint(pb, 3, m->socket_protocol);
+	}
+	if (m->has_query_address) {
+		pb_bytes(pb, 4, &m->query_address);
+	}
+	if (m->has_response_address) {
+		pb_bytes(pb, 5, &m->response_address);
+	}
+	if (m->has_query_port) {
+		pb_varint(pb, 6, m->query_port);
+	}
+	if (m->has_response_port) {
+		pb_varint(pb, 7, m->response_port);
+	}
+	if (m->has_query_time_sec) {
+		pb_varint(pb, 8, m->query_time_sec);
+	}
+	if (m->has_query_time_nsec) {
+		pb_fixed32(pb, 9, m->query_time_nsec);
+	}
+	if (m->has_query_message) {
+		pb_bytes(pb, 10, &m->query_message);
+	}
+	if (m->has_query_zone) {
+		pb_bytes(pb, 11, &m->query_zone);
+	}
+	if (m->has_response_time_sec) {
+		pb_varint(pb, 12, m->response_time_sec);
+	}
+	if (m->has_response_time_nsec) {
+		pb_fixed32(pb, 13, m->response_time_nsec);
+	}
+	if (m->has_response_message) {
+		pb_bytes(pb, 14, &m->response_message);
+	}
+}
+
+static void
+pack_dnstap(pbuf_t *pb, const Dnstap__Dnstap *d, size_t msglen) {
+	if (d->has_identity) {
+		pb_bytes(pb, 1, &d->identity);
+	}
+	if (d->has_version) {
+		pb_bytes(pb, 2, &d->version);
+	}
+	if (d->has_extra) {
+		pb_bytes(pb, 3, &d->extra);
+	}
+	pb_putvarint(pb, PB_KEY(14, PB_LENGTH));
+	pb_putvarint(pb, msglen);
+	pack_message(pb, d->message);
+	pb_varint(pb, 15, d->type);
+}
+
 static isc_result_t
 pack_dt(const Dnstap__Dnstap *d, void **buf, size_t *sz) {
-	ProtobufCBufferSimple sbuf;
+	pbuf_t pb = { 0 };
+	size_t msglen, len;
 
-	REQUIRE(d != NULL);
+	REQUIRE(d != NULL && d->message != NULL);
 	REQUIRE(sz != NULL);
 
-	memset(&sbuf, 0, sizeof(sbuf));
-	sbuf.base.append = protobuf_c_buffer_simple_append;
-	sbuf.len = 0;
-	sbuf.alloced = DNSTAP_INITIAL_BUF_SIZE;
+	pack_message(&pb, d->message);
+	msglen = pb.len;
+
+	pb.len = 0;
+	pack_dnstap(&pb, d, msglen);
+	len = pb.len;
 
-	/* Need to use malloc() here because protobuf uses free() */
-	sbuf.data = malloc(sbuf.alloced);
-	if (sbuf.data == NULL) {
+	/* Need to use malloc() here because fstrm uses free() */
+	pb = (pbuf_t){ .p = malloc(len) };
+	if (pb.p == NULL) {
 		return (ISC_R_NOMEMORY);
 	}
-	sbuf.must_free_data = 1;
+	*buf = pb.p;
 
-	*sz = dnstap__dnstap__pack_to_buffer(d, (ProtobufCBuffer *)&sbuf);
-	if (sbuf.data == NULL) {
-		return (ISC_R_FAILURE);
-	}
-	*buf = sbuf.data;
+	pack_dnstap(&pb, d, msglen);
+	INSIST(pb.len == len);
+	*sz = len;
 
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return true if this message should be skipped to honour the sampling
+ * rate.  Each message type is sampled separately, so that every type
+ * is logged at the configured rate whatever the traffic mix.
+ */
+static bool
+sample_skip(dns_dtenv_t *env, Dnstap__Message__Type mtype) {
+	uint32_t sample = atomic_load_relaxed(&env->sample);
+
+	INSIST(mtype < ARRAY_SIZE(dt_sampled));
+
+	if (sample <= 1) {
+		return (false);
+	}
+	if (++dt_sampled[mtype] < sample) {
+		if (env->stats != NULL) {
+			isc_stats_increment(env->stats,
+					    dns_dnstapcounter_skipped);
+		}
+		return (true);
+	}
+	dt_sampled[mtype] = 0;
+	return (false);
+}
+
 static void
 send_dt(dns_dtenv_t *env, void *buf, size_t len) {
 	struct fstrm_iothr_queue *ioq;
@@ -761,6 +932,10 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 
 	REQUIRE(VALID_DTENV(view->dtenv));
 
+	if (sample_skip(view->dtenv, dnstap_type(msgtype))) {
+		return;
+	}
+
 	if (view->dtenv->max_size != 0) {
 		check_file_size_and_maybe_reopen(view->dtenv);
 	}
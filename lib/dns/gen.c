@@ -169,6 +169,9 @@ upper(char *);
 static char *
 funname(const char *, char *);
 static void
+fastpaths(const char *, const char *, const char *, const char *,
+	  const char *);
+static void
 doswitch(const char *, const char *, const char *, const char *, const char *,
 	 const char *);
 static void
@@ -277,6 +280,39 @@ funname(const char *s, char *buf) {
 	return (buf);
 }
 
+/*%
+ * Class IN types that are common enough to be tested for before the
+ * switch, so that they do not go through the nested class switch.
+ * Class independent types are reached with a single jump already.
+ */
+static const char *const fastpath_types[] = { "a", "aaaa" };
+
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void
+fastpaths(const char *function, const char *args, const char *tsw,
+	  const char *csw, const char *result) {
+	struct tt *tt;
+	char buf1[TYPECLASSBUF], buf2[TYPECLASSBUF];
+	size_t n;
+
+	for (tt = types; tt != NULL; tt = tt->next) {
+		if (tt->rdclass != 1) {
+			continue;
+		}
+		for (n = 0; n < ARRAYSIZE(fastpath_types); n++) {
+			if (strcmp(tt->typebuf, fastpath_types[n]) != 0) {
+				continue;
+			}
+			printf("\tif (%s == %d && %s == %d) {%s %s_%s_%s(%s); "
+			       "} else \\\n",
+			       tsw, tt->type, csw, tt->rdclass, result,
+			       function, funname(tt->classbuf, buf1),
+			       funname(tt->typebuf, buf2), args);
+		}
+	}
+}
+
 static void
 doswitch(const char *name, const char *function, const char *args,
 	 const char *tsw, const char *csw, const char *res) {
@@ -294,6 +330,7 @@ doswitch(const char *name, const char *function, const char *args,
 	for (tt = types; tt != NULL; tt = tt->next) {
 		if (first) {
 			printf("\n#define %s \\\n", name);
+			fastpaths(function, args, tsw, csw, result);
 			printf("\tswitch (%s) { \\\n" /*}*/, tsw);
 			first = 0;
 		}
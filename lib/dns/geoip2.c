@@ -24,78 +24,124 @@
 #include <maxminddb.h>
 #include <netinet/in.h>
 
+#include <isc/atomic.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
 #include <dns/geoip.h>
+#include <dns/stats.h>
 
 /*
- * This structure preserves state from the previous GeoIP lookup,
- * so that successive lookups for the same data from the same IP
- * address will not require repeated database lookups.
- * This should improve performance somewhat.
+ * Each thread keeps the results of its most recent GeoIP lookups, so
+ * that clients from the same network do not require repeated database
+ * lookups.  A single query often has to process several geoip ACLs,
+ * for example when there are multiple views with match-clients
+ * statements that search for different countries, and successive
+ * queries tend to come from the same networks.
  *
- * For all lookups we preserve pointers to the MMDB_lookup_result_s
- * and MMDB_entry_s structures, a pointer to the database from which
- * the lookup was answered, and a copy of the request address.
+ * Every MMDB lookup result applies to the whole network containing the
+ * address (the result's netmask), so each cache entry records the
+ * database, the network, and the MMDB entry for it, or that there is
+ * none.  The entries are kept in most recently used order, and the
+ * least recently used one is replaced when the cache is full.
  *
- * If the next geoip ACL lookup is for the same database and from the
- * same address, we can reuse the MMDB entry without repeating the
- * lookup. This is for the case when a single query has to process
- * multiple geoip ACLs: for example, when there are multiple views with
- * match-clients statements that search for different countries.
- *
- * (XXX: Currently the persistent state is stored in thread specific
- * memory, but it could more simply be stored in the client object.
- * Also multiple entries could be stored in case the ACLs require
- * searching in more than one GeoIP database.)
+ * MMDB entries point into the database, so the whole cache is
+ * invalidated by dns_geoip_flushcache() when the databases are closed.
  */
 
+#define GEOIP_CACHE_SIZE 16
+
 typedef struct geoip_state {
-	uint16_t subtype;
 	const MMDB_s *db;
+	uint_fast32_t generation;
 	isc_netaddr_t addr;
-	MMDB_lookup_result_s mmresult;
+	unsigned int prefixlen;
+	bool found;
 	MMDB_entry_s entry;
 } geoip_state_t;
 
-static thread_local geoip_state_t geoip_state = { 0 };
+static atomic_uint_fast32_t geoip_generation = 0;
+
+static thread_local geoip_state_t geoip_cache[GEOIP_CACHE_SIZE];
+static thread_local unsigned int geoip_cached = 0;
 
 static void
-set_state(const MMDB_s *db, const isc_netaddr_t *addr,
-	  MMDB_lookup_result_s mmresult, MMDB_entry_s entry) {
-	geoip_state.db = db;
-	geoip_state.addr = *addr;
-	geoip_state.mmresult = mmresult;
-	geoip_state.entry = entry;
+geoip_stats_increment(const dns_geoip_databases_t *geoip,
+		      isc_statscounter_t counter) {
+	if (geoip->stats != NULL) {
+		isc_stats_increment(geoip->stats, counter);
+	}
 }
 
 static geoip_state_t *
-get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
+get_entry_for(const dns_geoip_databases_t *geoip, MMDB_s *const db,
+	      const isc_netaddr_t *addr) {
+	uint_fast32_t generation = atomic_load_acquire(&geoip_generation);
+	geoip_state_t state;
 	isc_sockaddr_t sa;
 	MMDB_lookup_result_s match;
+	unsigned int bits = (addr->family == AF_INET) ? 32 : 128;
+	unsigned int i;
 	int err;
 
-	if (db == geoip_state.db && isc_netaddr_equal(addr, &geoip_state.addr))
-	{
-		return (&geoip_state);
+	for (i = 0; i < geoip_cached; i++) {
+		if (geoip_cache[i].db == db &&
+		    geoip_cache[i].generation == generation &&
+		    isc_netaddr_eqprefix(addr, &geoip_cache[i].addr,
+					 geoip_cache[i].prefixlen))
+		{
+			geoip_stats_increment(geoip,
+					      dns_geoipstatscounter_cachehit);
+			state = geoip_cache[i];
+			goto found;
+		}
 	}
 
+	geoip_stats_increment(geoip, dns_geoipstatscounter_lookup);
+
 	isc_sockaddr_fromnetaddr(&sa, addr, 0);
 	match = MMDB_lookup_sockaddr(db, &sa.type.sa, &err);
-	if (err != MMDB_SUCCESS || !match.found_entry) {
+	if (err != MMDB_SUCCESS) {
 		return (NULL);
 	}
 
-	set_state(db, addr, match, match.entry);
+	state = (geoip_state_t){
+		.db = db,
+		.generation = generation,
+		.addr = *addr,
+		.prefixlen = match.netmask,
+		.found = match.found_entry,
+		.entry = match.entry,
+	};
+
+	/*
+	 * An IPv4 address looked up in an IPv6 database may get a netmask
+	 * that counts the 96 bits above the IPv4 subtree.
+	 */
+	if (state.prefixlen > bits) {
+		state.prefixlen = (bits == 32 && state.prefixlen >= 96)
+					  ? state.prefixlen - 96
+					  : bits;
+	}
+
+	if (geoip_cached < GEOIP_CACHE_SIZE) {
+		geoip_cached++;
+	}
+	i = geoip_cached - 1;
+
+found:
+	/* Move the entry to the front */
+	memmove(&geoip_cache[1], &geoip_cache[0], i * sizeof(geoip_cache[0]));
+	geoip_cache[0] = state;
 
-	return (&geoip_state);
+	return (state.found ? &geoip_cache[0] : NULL);
 }
 
 static dns_geoip_subtype_t
@@ -235,7 +281,7 @@ dns_geoip_match(const isc_netaddr_t *reqaddr,
 		return (false);
 	}
 
-	state = get_entry_for(db, reqaddr);
+	state = get_entry_for(geoip, db, reqaddr);
 	if (state == NULL) {
 		return (false);
 	}
@@ -380,3 +426,8 @@ dns_geoip_match(const isc_netaddr_t *reqaddr,
 	 */
 	return (false);
 }
+
+void
+dns_geoip_flushcache(void) {
+	atomic_fetch_add_release(&geoip_generation, 1);
+}
@@ -153,6 +153,13 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data);
 
 struct dst_hmac_key {
 	uint8_t key[ISC_MAX_BLOCK_SIZE];
+	/*
+	 * A context initialized with the key when the key is loaded.
+	 * Setting up the key schedule is a good part of the cost of
+	 * signing or verifying a short message, so new contexts copy
+	 * this one instead.
+	 */
+	isc_hmac_t *ctx;
 };
 
 static isc_result_t
@@ -175,8 +182,12 @@ hmac_createctx(const isc_md_type_t *type, const dst_key_t *key,
 	const dst_hmac_key_t *hkey = key->keydata.hmac_key;
 	isc_hmac_t *ctx = isc_hmac_new(); /* Either returns or abort()s */
 
-	result = isc_hmac_init(ctx, hkey->key, isc_md_type_get_block_size(type),
-			       type);
+	if (hkey->ctx != NULL) {
+		result = isc_hmac_copy(ctx, hkey->ctx);
+	} else {
+		result = isc_hmac_init(ctx, hkey->key,
+				       isc_md_type_get_block_size(type), type);
+	}
 	if (result != ISC_R_SUCCESS) {
 		isc_hmac_free(ctx);
 		return (DST_R_UNSUPPORTEDALG);
@@ -314,6 +325,7 @@ hmac_isprivate(const dst_key_t *key) {
 static void
 hmac_destroy(dst_key_t *key) {
 	dst_hmac_key_t *hkey = key->keydata.hmac_key;
+	isc_hmac_free(hkey->ctx);
 	isc_safe_memwipe(hkey, sizeof(*hkey));
 	isc_mem_put(key->mctx, hkey, sizeof(*hkey));
 	key->keydata.hmac_key = NULL;
@@ -348,6 +360,7 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data) {
 	hkey = isc_mem_get(key->mctx, sizeof(dst_hmac_key_t));
 
 	memset(hkey->key, 0, sizeof(hkey->key));
+	hkey->ctx = NULL;
 
 	/* Hash the key if the key is longer then chosen MD block size */
 	if (r.length > (unsigned int)isc_md_type_get_block_size(type)) {
@@ -362,6 +375,19 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data) {
 		keylen = r.length;
 	}
 
+	/*
+	 * If the digest can't be used right now, hmac_createctx() will
+	 * report it.
+	 */
+	hkey->ctx = isc_hmac_new();
+	if (isc_hmac_init(hkey->ctx, hkey->key,
+			  isc_md_type_get_block_size(type),
+			  type) != ISC_R_SUCCESS)
+	{
+		isc_hmac_free(hkey->ctx);
+		hkey->ctx = NULL;
+	}
+
 	key->key_size = keylen * 8;
 	key->keydata.hmac_key = hkey;
 
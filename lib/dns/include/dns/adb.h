@@ -205,6 +205,7 @@ struct dns_adbaddrinfo {
 
 	isc_sockaddr_t	 sockaddr; /*%< [rw] */
 	unsigned int	 srtt;	   /*%< [rw] microsecs */
+	unsigned int	 rttvar;   /*%< [rw] microsecs, 0 if unknown */
 	dns_transport_t *transport;
 
 	unsigned int	flags; /*%< [rw] */
@@ -463,6 +464,9 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
  *
  *\li	The srtt in addr will be updated to reflect the new global
  *	srtt value.  This may include changes made by others.
+ *
+ *\li	When 'factor' is DNS_ADB_RTTADJDEFAULT, 'rtt' is taken to be
+ *	a measured sample and the rtt variance in addr is updated too.
  */
 
 void
@@ -29,6 +29,10 @@
  *	cache" in the resolver and for the "servfail cache" in
  *	the view.
  *
+ *\li	The number of entries is bounded; expired entries are removed
+ *	by a timing wheel as new entries are added, and when the cache
+ *	is full the entries closest to expiring are evicted first.
+ *
  * Reliability:
  *
  * Resources:
@@ -71,20 +71,33 @@ ISC_REFCOUNT_TRACE_DECL(dns_cache);
 ISC_REFCOUNT_DECL(dns_cache);
 #endif
 
+void
+dns_cache_sethugepages(bool enable);
+/*%<
+ * Set whether the databases of caches that are created or flushed from
+ * now on keep their memory in a context backed by huge pages (see
+ * isc_mem_create_hugepages()). The default is not to.
+ */
+
 isc_result_t
 dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
-		 const char *cachename, isc_mem_t *mctx, dns_cache_t **cachep);
+		 const char *cachename, const char *dbtype, isc_mem_t *mctx,
+		 dns_cache_t **cachep);
 /*%<
  * Create a new DNS cache.
  *
- * dns_cache_create() will create a named cache (based on dns_rbtdb).
+ * dns_cache_create() will create a named cache, whose database is of
+ * the registered implementation 'dbtype' (see dns_db_register()), or
+ * of the default cache implementation if 'dbtype' is NULL.  The
+ * implementation must create databases with cache semantics; see
+ * "Cache Database Implementations" in dns/db.h.
  *
  * Requires:
  *
  *\li	'loopmgr' is a valid loop manager.
  *
  *\li	'cachename' is a valid string.  This must not be NULL.
-
+ *
  *\li	'mctx' is a valid memory context.
  *
  *\li	'cachep' is a valid pointer, and *cachep == NULL
@@ -96,7 +109,18 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
  * Returns:
  *
  *\li	#ISC_R_SUCCESS
- *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_NOTFOUND		'dbtype' is not a registered implementation
+ *\li	#ISC_R_NOTIMPLEMENTED	'dbtype' does not support cache semantics
+ */
+
+const char *
+dns_cache_getdbtype(dns_cache_t *cache);
+/*%<
+ * Return the name of the database implementation used by 'cache'.
+ *
+ * Requires:
+ *
+ *\li	'cache' is a valid cache.
  */
 
 void
@@ -196,6 +220,120 @@ dns_cache_flush(dns_cache_t *cache);
  *\li	#ISC_R_NOMEMORY
  */
 
+void
+dns_cache_setfilename(dns_cache_t *cache, const char *filename);
+/*%<
+ * Set the name of the file that snapshots of the cache are written to
+ * (see dns_cache_dump()).  NULL clears it.
+ */
+
+const char *
+dns_cache_getfilename(dns_cache_t *cache);
+/*%<
+ * Get the name of the snapshot file, or NULL if none is set.  The
+ * string is only valid until the next call to dns_cache_setfilename().
+ */
+
+void
+dns_cache_setimports(dns_cache_t *cache, const char *const *filenames,
+		     size_t count);
+/*%<
+ * Set the names of the snapshot files written by other caches, e.g.
+ * those of other name server processes on the same host, that are
+ * imported into this cache (see dns_cache_loadasync()).  A 'count' of
+ * zero clears them.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filenames' to be non NULL if 'count' is non zero.
+ */
+
+const char *
+dns_cache_getimport(dns_cache_t *cache, size_t idx);
+/*%<
+ * Get the name of the 'idx'th snapshot file to import, or NULL if
+ * there are no more.  The string is only valid until the next call to
+ * dns_cache_setimports().
+ */
+
+isc_result_t
+dns_cache_dump(dns_cache_t *cache, const char *filename);
+/*%<
+ * Write a snapshot of the cache contents to 'filename' in the "raw"
+ * master file format, including the trust level of each RRset.
+ * Stale and negative entries are not included.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	other error returns from dns_master_dump().
+ */
+
+isc_result_t
+dns_cache_dumpasync(dns_cache_t *cache, const char *filename,
+		    const dns_dumpfilter_t *filter, isc_loop_t *loop,
+		    dns_dumpdonefunc_t done, void *done_arg,
+		    dns_dumpctx_t **dctxp);
+/*%<
+ * Like dns_cache_dump(), but write the snapshot on a worker thread,
+ * and call 'done' on 'loop' when it has been written.  Only the part
+ * of the cache selected by 'filter' is written, if it is not NULL.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be non NULL.
+ *\li	'done' to be non NULL.
+ *\li	'dctxp' to be non NULL and '*dctxp' to be NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	other error returns from dns_master_dumpasync().
+ */
+
+isc_result_t
+dns_cache_load(dns_cache_t *cache, const char *filename);
+/*%<
+ * Add the contents of a snapshot written by dns_cache_dump() to the
+ * cache.  The TTLs are reduced by the time that has passed since the
+ * snapshot was written; RRsets which have expired in the meantime are
+ * skipped.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FILENOTFOUND
+ *\li	other error returns from dns_master_loadfile().
+ */
+
+isc_result_t
+dns_cache_loadasync(dns_cache_t *cache, const char *filename,
+		    isc_loop_t *loop, dns_loaddonefunc_t done, void *done_arg);
+/*%<
+ * Like dns_cache_load(), but the snapshot is read on a worker thread
+ * while the cache keeps serving lookups.  When it has been read, or
+ * reading has failed, 'done' is called on 'loop' with 'done_arg' and
+ * the result.  RRsets in the cache that are more trusted than those in
+ * the snapshot are kept.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be non NULL.
+ *\li	'loop' to be valid.
+ *\li	'done' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		'done' will be called
+ *\li	#ISC_R_FILENOTFOUND
+ *\li	other error returns from dns_master_loadfileasync(); 'done'
+ *	will not be called.
+ */
+
 isc_result_t
 dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree);
 /*
@@ -258,6 +396,35 @@ dns_cache_setmaxtypepername(dns_cache_t *cache, uint32_t value);
  * Set the maximum resource record types per owner name that can be cached.
  */
 
+void
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_cacheeviction_t policy);
+/*%<
+ * Set the policy used to purge entries when the cache exceeds its
+ * size limit (see dns_db_setevictionpolicy()).
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+dns_cacheeviction_t
+dns_cache_getevictionpolicy(dns_cache_t *cache);
+/*%<
+ * Get the eviction policy set by dns_cache_setevictionpolicy().
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+void
+dns_cache_setpackrecords(dns_cache_t *cache, bool value);
+/*%<
+ * Set whether large TXT, SVCB and HTTPS RRsets are packed in the cache
+ * (see dns_db_setpackrecords()).
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
 #ifdef HAVE_LIBXML2
 int
 dns_cache_renderxml(dns_cache_t *cache, void *writer0);
@@ -356,6 +356,21 @@ dns_catz_dbupdate_callback(dns_db_t *db, void *fn_arg);
  * \li	'fn_arg' is not NULL (casted to dns_catz_zones_t*).
  */
 
+void
+dns_catz_setjournal(dns_catz_zones_t *catzs, const dns_name_t *name,
+		    const char *journal);
+/*%<
+ * Set the journal of the catalog zone 'name' in 'catzs'. When a new
+ * version of the catalog zone follows the last one that was merged,
+ * only the member zones changed by the journal transactions between
+ * the two are processed. A NULL 'journal' disables this, and so does
+ * a catalog zone that is not in 'catzs'.
+ *
+ * Requires:
+ * \li	'catzs' is a valid dns_catz_zones_t.
+ * \li	'name' is a valid dns_name_t.
+ */
+
 void
 dns_catz_dbupdate_register(dns_db_t *db, dns_catz_zones_t *catzs);
 /*%<
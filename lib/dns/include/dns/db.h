@@ -179,12 +179,20 @@ typedef struct dns_dbmethods {
 			   isc_rwlocktype_t t);
 	void (*addglue)(dns_db_t *db, dns_dbversion_t *version,
 			dns_rdataset_t *rdataset, dns_message_t *msg);
+	isc_result_t (*addadditional)(dns_db_t *db, dns_dbversion_t *version,
+				      dns_rdataset_t *rdataset, bool dnssec,
+				      dns_message_t *msg);
 	void (*expiredata)(dns_db_t *db, dns_dbnode_t *node, void *data);
 	void (*deletedata)(dns_db_t *db, dns_dbnode_t *node, void *data);
 	isc_result_t (*nodefullname)(dns_db_t *db, dns_dbnode_t *node,
 				     dns_name_t *name);
 	void (*setmaxrrperset)(dns_db_t *db, uint32_t value);
 	void (*setmaxtypepername)(dns_db_t *db, uint32_t value);
+	uint64_t (*versionid)(dns_db_t *db, dns_dbversion_t *version);
+	void (*setevictionpolicy)(dns_db_t *db, dns_cacheeviction_t policy);
+	void (*setreclaimwater)(dns_db_t *db, size_t hiwater, size_t lowater);
+	isc_result_t (*expiretree)(dns_db_t *db, const dns_name_t *name);
+	void (*setpackrecords)(dns_db_t *db, bool value);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -239,10 +247,12 @@ struct dns_dbonupdatelistener {
  * exists in a specal tree for NSEC or NSEC3.
  */
 enum {
-	DNS_DB_NSEC_NORMAL = 0,	  /* in main tree */
-	DNS_DB_NSEC_HAS_NSEC = 1, /* also has node in nsec tree */
-	DNS_DB_NSEC_NSEC = 2,	  /* in nsec tree */
-	DNS_DB_NSEC_NSEC3 = 3	  /* in nsec3 tree */
+	DNS_DB_NSEC_NORMAL = 0,	   /* in main tree */
+	DNS_DB_NSEC_HAS_NSEC = 1,  /* also has node in nsec tree */
+	DNS_DB_NSEC_NSEC = 2,	   /* in nsec tree */
+	DNS_DB_NSEC_NSEC3 = 3,	   /* in nsec3 tree */
+	DNS_DB_NSEC_HAS_NSEC3 = 4, /* also has node in nsec3 tree */
+	DNS_DB_NSEC_HAS_BOTH = 5   /* also has nodes in nsec and nsec3 trees */
 };
 
 /*@{*/
@@ -804,7 +814,9 @@ dns__db_findext(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
  *	NSEC record that potentially covers 'name' if a answer cannot
  *	be found.  Note the returned NSEC needs to be checked to ensure
  *	that it is correct.  This only affects answers returned from the
- *	cache.
+ *	cache.  If #DNS_DBFIND_FORCENSEC3 is also set, 'name' is a hashed
+ *	NSEC3 owner name and the cache looks for the NSEC3 record that
+ *	potentially covers it instead.
  *
  * \li	If the #DNS_DBFIND_FORCENSEC3 option is set, then we are looking
  *	in the NSEC3 tree and not the main tree.  Without this option being
@@ -1441,6 +1453,90 @@ dns_db_ispersistent(dns_db_t *db);
  * \li	#false	'db' is not persistent.
  */
 
+/*%
+ * Cache Database Implementations
+ *
+ * A database implementation registered with dns_db_register() can be
+ * used for the cache of a view (see dns_cache_create() and the
+ * "cache-type" option) if it honors the following contract, which is
+ * what the resolver, the ADB and ns_query rely on.  The conformance
+ * tests in tests/dns/cachedb_test.c check it for each cache
+ * implementation, and tests/bench/dbmix can be used to compare their
+ * performance.
+ *
+ * Creation:
+ *
+ *\li	The create function is called with type #dns_dbtype_cache, the
+ *	root name as origin, and argc == 1; argv[0] is a (isc_mem_t *)
+ *	that may be used for auxiliary structures such as heaps.  It must
+ *	return #ISC_R_NOTIMPLEMENTED if it cannot provide cache semantics,
+ *	and otherwise set #DNS_DBATTR_CACHE in the new database.
+ *
+ *\li	The database must be usable from any loop thread: the methods
+ *	are called concurrently without external locking, and nodes and
+ *	rdatasets may be released on a different thread than the one
+ *	that found them.
+ *
+ * Required methods:
+ *
+ *\li	'destroy', 'findnode', 'find', 'findzonecut', 'attachnode',
+ *	'detachnode', 'createiterator', 'findrdataset', 'allrdatasets',
+ *	'addrdataset', 'deleterdataset', 'nodecount' and 'setcachestats'.
+ *	There are no versions: 'version' is always NULL.
+ *
+ *\li	'find' returns #ISC_R_SUCCESS, #DNS_R_CNAME or #DNS_R_DNAME
+ *	with the rdataset found, #DNS_R_NCACHENXDOMAIN or
+ *	#DNS_R_NCACHENXRRSET with the negative cache entry, or, when
+ *	nothing that answers the question is cached, #DNS_R_DELEGATION
+ *	with the NS rdataset of the deepest cached zone cut and
+ *	'foundname' set to its owner, or #ISC_R_NOTFOUND if there is no
+ *	such zone cut.  With #DNS_DBFIND_COVERINGNSEC it may return
+ *	#DNS_R_COVERINGNSEC.  Data whose TTL has expired at 'now' is never
+ *	returned, except as described for the DNS_DBFIND_STALE* options,
+ *	in which case the rdataset has #DNS_RDATASETATTR_STALE set.  Data
+ *	pending validation is only returned with #DNS_DBFIND_PENDINGOK,
+ *	glue only with #DNS_DBFIND_GLUEOK, and additional data only with
+ *	#DNS_DBFIND_ADDITIONALOK.
+ *
+ *\li	'findzonecut' returns #ISC_R_SUCCESS with the NS rdataset of the
+ *	deepest cached zone cut at or above 'name' (strictly above with
+ *	#DNS_DBFIND_NOEXACT), or #ISC_R_NOTFOUND.
+ *
+ *\li	'addrdataset' keeps an existing active rdataset of the same type
+ *	whose trust is higher than that of the new one, and returns
+ *	#DNS_R_UNCHANGED with 'addedrdataset' bound to it; otherwise the
+ *	new rdataset replaces it.  Negative entries (type 0, with the
+ *	type that does not exist in 'covers', or #dns_rdatatype_any for
+ *	NXDOMAIN) replace positive data for the type and vice versa, and
+ *	an NXDOMAIN entry hides all the other data at the node.  #DNS_DBADD_FORCE replaces data regardless of trust,
+ *	and with #DNS_DBADD_PREFETCH an identical rdataset is replaced
+ *	rather than kept, so that its TTL is renewed.  The
+ *	#DNS_RDATASETATTR_PREFETCH attribute of the new rdataset must
+ *	be returned by later lookups.  The rdataset bound to
+ *	'addedrdataset' has its TTL reduced to the time left at 'now'.
+ *
+ *\li	'deleterdataset' makes an rdataset inaccessible to subsequent
+ *	lookups at once; rdatasets already bound stay valid until they
+ *	are disassociated.
+ *
+ * Optional methods:
+ *
+ *\li	'setservestalettl', 'getservestalettl', 'setservestalerefresh'
+ *	and 'getservestalerefresh' are needed for serve-stale;
+ *	'setmaxrrperset', 'setmaxtypepername', 'setevictionpolicy',
+ *	'setpackrecords' and 'setreclaimwater' apply the corresponding
+ *	cache options and may be ignored; 'expiretree' speeds up
+ *	"rndc flushtree", which otherwise iterates over the names;
+ *	'getrrsetstats', 'locknode', 'unlocknode', 'expiredata' and
+ *	'deletedata' are used for statistics and by the rdatasets the
+ *	implementation binds, and 'setloop' is only used by "rbt".
+ *
+ *\li	Memory use is controlled with isc_mem_setwater() on the memory
+ *	context passed to the create function; the implementation is
+ *	expected to purge data, preferring expired and least recently
+ *	used data, when the high water mark is reached.
+ */
+
 isc_result_t
 dns_db_register(const char *name, dns_dbcreatefunc_t create, void *driverarg,
 		isc_mem_t *mctx, dns_dbimplementation_t **dbimp);
@@ -1777,6 +1873,32 @@ dns_db_addglue(dns_db_t *db, dns_dbversion_t *version, dns_rdataset_t *rdataset,
  *\li	Any error that dns_rdata_additionaldata() can return.
  */
 
+isc_result_t
+dns_db_addadditional(dns_db_t *db, dns_dbversion_t *version,
+		     dns_rdataset_t *rdataset, bool dnssec, dns_message_t *msg);
+/*%<
+ * Add the additional data for the MX or SRV RRset 'rdataset', the
+ * address and TLSA records of its targets, to the additional section
+ * of 'msg', from a cache kept with 'version' of 'db'.  RRsets already
+ * in 'msg' are not added again.  Signatures are added if 'dnssec' is
+ * true and the zone is secure.
+ *
+ * This only succeeds if the lookups for all of the targets can be
+ * answered from 'db' alone; otherwise nothing is added, and the caller
+ * has to do regular additional section processing.
+ *
+ * Requires:
+ * \li	'db' is a database with 'zone' semantics.
+ * \li	'version' is the DB version.
+ * \li	'rdataset' is a valid MX or SRV rdataset.
+ * \li	'msg' is the DNS message to which the data should be added.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND		the cache cannot be used for 'rdataset'.
+ *\li	#ISC_R_NOTIMPLEMENTED
+ */
+
 void
 dns_db_expiredata(dns_db_t *db, dns_dbnode_t *node, void *data);
 /*%<
@@ -1792,6 +1914,25 @@ dns_db_deletedata(dns_db_t *db, dns_dbnode_t *node, void *data);
  * data from an LRU list or a heap.
  */
 
+isc_result_t
+dns_db_expiretree(dns_db_t *db, const dns_name_t *name);
+/*%<
+ * Mark all the data at and below 'name' in the cache database 'db' as
+ * expired, so that it is no longer returned, and is cleaned up the way
+ * data whose TTL has run out is.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid cache database.
+ *
+ * \li	'name' is a valid absolute name.
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED if the database does not support it.
+ */
+
 isc_result_t
 dns_db_nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name);
 /*%<
@@ -1821,4 +1962,72 @@ dns_db_setmaxtypepername(dns_db_t *db, uint32_t value);
  * stored at a given node, then any subsequent attempt to add an rdataset
  * with a new RR type will return ISC_R_TOOMANYRECORDS.
  */
+
+void
+dns_db_setevictionpolicy(dns_db_t *db, dns_cacheeviction_t policy);
+/*%<
+ * Set the policy used to choose which entries to purge when a cache
+ * database exceeds its memory limit:
+ *
+ *\li	#dns_cacheeviction_lru: purge the least recently used entries.
+ *\li	#dns_cacheeviction_sieve: SIEVE; lookups only mark entries as
+ *	visited, and the purge scan gives visited entries a second chance.
+ *
+ * This has no effect on databases that do not support it.
+ *
+ * Requires:
+ *
+ * \li 'db' is a valid database
+ */
+
+void
+dns_db_setpackrecords(dns_db_t *db, bool value);
+/*%<
+ * If 'value' is true, store the TXT, SVCB and HTTPS RRsets that are
+ * added to a cache database from now on in the packed form made by
+ * dns_rdataslab_pack(), when that saves memory.
+ *
+ * This has no effect on databases that do not support it.
+ *
+ * Requires:
+ *
+ * \li 'db' is a valid database
+ */
+
+void
+dns_db_setreclaimwater(dns_db_t *db, size_t hiwater, size_t lowater);
+/*%<
+ * Set the water marks of the background reclaimer of a cache database:
+ * once the memory used by the database exceeds 'hiwater', entries are
+ * purged in small batches from idle loop callbacks until it drops to
+ * 'lowater'.  This should be set below the high water mark of the
+ * memory context, so that the purging done while adding new entries
+ * (see isc_mem_isovermem()) is only needed when the reclaimer can't keep
+ * up.  If 'hiwater' is 0, the background reclaimer is disabled.
+ *
+ * This has no effect on databases that do not support it.
+ *
+ * Requires:
+ *
+ * \li 'db' is a valid database
+ * \li 'hiwater' >= 'lowater'
+ */
+
+uint64_t
+dns_db_versionid(dns_db_t *db, dns_dbversion_t *version);
+/*%<
+ * Return an identifier for 'version' that is unique across all versions
+ * of all databases for the lifetime of the process, so that it can be
+ * used to tell whether data derived from a database is still current.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database
+ * \li	'version' is a valid version
+ *
+ * Returns:
+ *
+ * \li	The version identifier, or zero if the database implementation
+ *	does not support version identifiers.
+ */
 ISC_LANG_ENDDECLS
@@ -274,8 +274,9 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
  * parameters that match destaddr, localaddr and transport.
  *
  * If localaddr is NULL, we ignore the dispatch's localaddr when looking
- * for a match.  However, if transport is NULL, then the matching dispatch
- * must also have been created with a NULL transport.
+ * for a match, and if its port is zero, only the address is compared.
+ * However, if transport is NULL, then the matching dispatch must also
+ * have been created with a NULL transport.
  *
  * Requires:
  *\li	mgr to be valid dispatch manager.
@@ -129,6 +129,49 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
  *	DNS_R_DISALLOWED	if there is no match.
  */
 
+isc_result_t
+dns_dns64_match(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		const dns_name_t *reqsigner, dns_aclenv_t *env,
+		unsigned int flags);
+/*
+ * dns_dns64_match() determines whether 'dns64' applies to a request from
+ * 'reqaddr' signed by 'reqsigner' with 'flags'.  This is the part of
+ * dns_dns64_aaaafroma() that doesn't depend on the A record, so callers
+ * synthesising several A records for the same request can do it once.
+ *
+ * If 'reqaddr' is NULL the 'client' acl is ignored.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'reqaddr'	to be NULL or valid
+ *	'reqsigner'	to be NULL or valid.
+ *	'env'		to be valid.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS		if the record applies.
+ *	DNS_R_DISALLOWED	if there is no match.
+ */
+
+isc_result_t
+dns_dns64_synthesize(const dns_dns64_t *dns64, dns_aclenv_t *env,
+		     const unsigned char *a, unsigned char *aaaa);
+/*
+ * dns_dns64_synthesize() performs the synthesis of dns_dns64_aaaafroma()
+ * for a request that dns_dns64_match() has already accepted: if 'a' is
+ * allowed by the 'mapped' acl, the synthesised address is written to
+ * '*aaaa'.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'env'		to be valid.
+ *	'a'		to point to a IPv4 address in network order.
+ *	'aaaa'		to point to a IPv6 address buffer in network order.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS		if synthesis was performed.
+ *	DNS_R_DISALLOWED	if 'a' is not to be mapped.
+ */
+
 dns_dns64_t *
 dns_dns64_next(dns_dns64_t *dns64);
 /*
@@ -308,6 +308,58 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, dns_kasp_t *kasp,
  *\li		On error, keylist is unchanged
  */
 
+void
+dns_dnsseckeycache_create(isc_mem_t *mctx, dns_dnsseckeycache_t **cachep);
+/*%<
+ * Create an empty cache of the key files of a zone, and store it in
+ * '*cachep'.
+ *
+ *	Requires:
+ *\li		'mctx' is a valid memory context
+ *\li		'cachep' is not NULL and '*cachep' is NULL
+ */
+
+void
+dns_dnsseckeycache_destroy(dns_dnsseckeycache_t **cachep);
+/*%<
+ * Free the key cache in '*cachep', and set '*cachep' to NULL.
+ */
+
+isc_result_t
+dns_dnsseckeycache_find(dns_dnsseckeycache_t *cache, const dns_name_t *origin,
+			dns_kasp_t *kasp, const char *keydir,
+			dns_keystorelist_t *keystores, isc_stdtime_t now,
+			isc_mem_t *mctx, dns_dnsseckeylist_t *keylist);
+/*%<
+ * Like dns_dnssec_findmatchingkeys(), but if neither the key directories
+ * nor the files of the keys stored by dns_dnsseckeycache_update() have
+ * been modified since, append those keys to 'keylist' instead of reading
+ * the key files again.  The cache is emptied either way, so that keys
+ * that are changed in memory and not written back are never reused.
+ *
+ *	Requires:
+ *\li		'cache' is a valid key cache
+ *\li		'keylist' is not NULL
+ *
+ *	Returns:
+ *\li		as dns_dnssec_findmatchingkeys()
+ */
+
+void
+dns_dnsseckeycache_update(dns_dnsseckeycache_t *cache, dns_kasp_t *kasp,
+			  const char *keydir, dns_keystorelist_t *keystores,
+			  dns_dnsseckeylist_t *keylist);
+/*%<
+ * Store the keys in 'keylist' that are not being purged in 'cache',
+ * along with the modification times of their files and of the key
+ * directories.  This must only be called once the keys have been
+ * written to their files, with the key files locked.
+ *
+ *	Requires:
+ *\li		'cache' is a valid key cache
+ *\li		'keylist' is not NULL
+ */
+
 isc_result_t
 dns_dnssec_keylistfromrdataset(const dns_name_t *origin, dns_kasp_t *kasp,
 			       const char *directory, isc_mem_t *mctx,
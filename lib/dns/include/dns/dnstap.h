@@ -213,6 +213,19 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version);
  *\li	'env' is a valid dnstap environment.
  */
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t sample);
+/*%<
+ * Log only one in every 'sample' messages of each message type; the
+ * others are counted as skipped.  The default, 1, logs every message.
+ *
+ * Requires:
+ *
+ *\li	'env' is a valid dnstap environment.
+ *
+ *\li	'sample' is greater than zero.
+ */
+
 void
 dns_dt_attach(dns_dtenv_t *source, dns_dtenv_t **destp);
 /*%<
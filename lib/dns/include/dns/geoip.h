@@ -93,6 +93,8 @@ struct dns_geoip_databases {
 	void *domain;  /* GeoIP2-Domain */
 	void *isp;     /* GeoIP2-ISP */
 	void *as;      /* GeoIP2-ASN or GeoLite2-ASN */
+
+	isc_stats_t *stats; /* dns_geoipstatscounter_*, may be NULL */
 };
 
 /***
@@ -106,6 +108,13 @@ dns_geoip_match(const isc_netaddr_t	    *reqaddr,
 		const dns_geoip_databases_t *geoip,
 		const dns_geoip_elem_t	    *elt);
 
+void
+dns_geoip_flushcache(void);
+/*%<
+ * Invalidate the per-thread caches of GeoIP lookup results.  This must
+ * be called when the databases are closed, before they are reopened.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* HAVE_GEOIP2 */
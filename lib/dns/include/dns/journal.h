@@ -45,6 +45,7 @@
 #define DNS_JOURNAL_READ   0x00000000 /* false */
 #define DNS_JOURNAL_CREATE 0x00000001 /* true */
 #define DNS_JOURNAL_WRITE  0x00000002
+#define DNS_JOURNAL_GROUP  0x00000004
 
 #define DNS_JOURNAL_SIZE_MAX INT32_MAX
 #define DNS_JOURNAL_SIZE_MIN 4096
@@ -71,6 +72,12 @@
  */
 typedef struct dns_journal dns_journal_t;
 
+/*%
+ * A dns_journalcompact_t holds the state of a journal compaction that
+ * runs in the background.  This is an opaque type.
+ */
+typedef struct dns_journalcompact dns_journalcompact_t;
+
 /***
  *** Functions
  ***/
@@ -112,6 +119,11 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * DNS_JOURNAL_GROUP, together with DNS_JOURNAL_CREATE or DNS_JOURNAL_WRITE,
+ * makes dns_journal_commit() write the transaction without syncing
+ * the file, so that a group of transactions can be made durable at
+ * once by dns_journal_sync().
  */
 
 void
@@ -161,6 +173,21 @@ dns_journal_commit(dns_journal_t *j);
  *      sequence.
  */
 
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Make the transactions committed to 'j' since it was opened with
+ * DNS_JOURNAL_GROUP, or since the last call, durable: sync the
+ * transaction data, then write and sync the journal header.  Until
+ * then, the journal header on disk does not include them.
+ *
+ * dns_journal_destroy() calls this if needed, but cannot report
+ * errors.
+ *
+ * Requires:
+ * \li     'j' is a valid journal.
+ */
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
 /*%
@@ -281,6 +308,39 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file);
 /* For debugging not general use */
 
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin_serial, uint32_t end_serial, FILE *file);
+/*%<
+ * Like dns_journal_print(), but only print the transactions from
+ * 'begin_serial' to 'end_serial'.  The journal index is used to find
+ * the first of them, so the transactions before it are not read.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	DNS_R_NOJOURNAL
+ *\li	ISC_R_RANGE if either serial is not the start or end of a
+ *	transaction in the journal.
+ */
+
+isc_result_t
+dns_journal_extract(isc_mem_t *mctx, const char *filename,
+		    uint32_t begin_serial, uint32_t end_serial,
+		    const char *outfile);
+/*%<
+ * Copy the transactions from 'begin_serial' to 'end_serial' of the
+ * journal 'filename' into a new journal 'outfile', which can then be
+ * printed, compared or applied like any other journal.  'outfile' is
+ * removed again if the copy fails.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_EXISTS if 'outfile' already exists.
+ *\li	DNS_R_NOJOURNAL
+ *\li	ISC_R_RANGE if either serial is not the start or end of a
+ *	transaction in the journal.
+ */
+
 isc_result_t
 dns_db_diff(isc_mem_t *mctx, dns_db_t *dba, dns_dbversion_t *dbvera,
 	    dns_db_t *dbb, dns_dbversion_t *dbverb,
@@ -324,6 +384,39 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
  * Other errors may be returned from file operations.
  */
 
+isc_result_t
+dns_journal_compact_begin(isc_mem_t *mctx, char *filename, uint32_t serial,
+			  uint32_t flags, uint32_t target_size,
+			  dns_journalcompact_t **compactp);
+isc_result_t
+dns_journal_compact_copy(dns_journalcompact_t *compact);
+isc_result_t
+dns_journal_compact_finish(dns_journalcompact_t **compactp);
+void
+dns_journal_compact_cancel(dns_journalcompact_t **compactp);
+/*%<
+ * dns_journal_compact() in three steps, so that the journal can be
+ * written to while the expensive middle step is running.
+ *
+ * dns_journal_compact_begin() opens the journal and decides whether it
+ * needs to be compacted.  If it does, '*compactp' is set; otherwise it
+ * is left NULL.  The arguments and results are as for
+ * dns_journal_compact().
+ *
+ * dns_journal_compact_copy() writes the compacted journal to a
+ * temporary file.  It only reads the journal as it was when
+ * dns_journal_compact_begin() was called, and may run on any thread,
+ * while new transactions are committed to the journal.
+ *
+ * dns_journal_compact_finish() must be called after a successful
+ * dns_journal_compact_copy(), while nothing else is writing the
+ * journal.  It appends the transactions committed in the meantime to
+ * the compacted journal and then renames it over the original one.
+ *
+ * dns_journal_compact_cancel() abandons the compaction at any point
+ * after dns_journal_compact_begin().
+ */
+
 bool
 dns_journal_get_sourceserial(dns_journal_t *j, uint32_t *sourceserial);
 void
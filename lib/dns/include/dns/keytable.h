@@ -62,6 +62,14 @@ dns_keytable_create(dns_view_t *view, dns_keytable_t **keytablep);
  *\li	keytablep != NULL && *keytablep == NULL
  */
 
+uint64_t
+dns_keytable_generation(void);
+/*%<
+ * Return a number that is incremented whenever any key table is created,
+ * or has a key node added or deleted.  A lookup done after reading the
+ * same number gives the same answer.
+ */
+
 isc_result_t
 dns_keytable_add(dns_keytable_t *keytable, bool managed, bool initial,
 		 dns_name_t *name, dns_rdata_ds_t *ds,
@@ -238,6 +246,64 @@ dns_keytable_issecuredomain(dns_keytable_t *keytable, const dns_name_t *name,
  *\li	Any other result is an error.
  */
 
+isc_result_t
+dns_keytable_dstkey(dns_keytable_t *keytable, const dns_name_t *name,
+		    dns_rdata_t *rdata, dst_key_t **keyp);
+/*%<
+ * Get the dst key for the DNSKEY record 'rdata' owned by 'name'.
+ *
+ * Parsed keys are cached in 'keytable', so asking for the same DNSKEY
+ * again, as the validator does for every RRset signed by it, does not
+ * parse it again. The cache is not limited to trust anchors, and a key
+ * that is found in it is not any more trusted than one that is not.
+ *
+ * Requires:
+ *
+ *\li	'keytable' is a valid keytable.
+ *
+ *\li	'name' is a valid absolute name.
+ *
+ *\li	'rdata' is a DNSKEY record.
+ *
+ *\li	keyp != NULL && *keyp == NULL
+ *
+ * Returns:
+ *
+ *\li	ISC_R_SUCCESS
+ *
+ *\li	Any other result indicates that the key could not be parsed.
+ */
+
+bool
+dns_keytable_sigverified(dns_keytable_t *keytable, const dns_name_t *name,
+			 dns_rdataset_t *rdataset, dst_key_t *key,
+			 dns_rdata_t *sigrdata, uint64_t *hashp);
+void
+dns_keytable_setsigverified(dns_keytable_t *keytable, uint64_t hash,
+			    dns_rdata_t *sigrdata);
+/*%<
+ * A small cache of signatures that have already been verified.
+ *
+ * dns_keytable_sigverified() returns true if the RRSIG 'sigrdata' has
+ * already been found to be a valid signature by 'key' over 'rdataset',
+ * owned by 'name'; it only remembers the cryptographic result, so the
+ * caller still has to check the signature's validity period. In either
+ * case '*hashp' is set to the value to pass to
+ * dns_keytable_setsigverified() to record a successful verification;
+ * zero means that the signature cannot be cached.
+ *
+ * The cache is flushed when trust anchors are added to or removed from
+ * 'keytable'.
+ *
+ * Requires:
+ *
+ *\li	'keytable' is a valid keytable.
+ *
+ *\li	'rdataset' is a valid rdataset.
+ *
+ *\li	'sigrdata' is an RRSIG record.
+ */
+
 isc_result_t
 dns_keytable_dump(dns_keytable_t *keytable, FILE *fp);
 /*%<
@@ -60,6 +60,7 @@
 #define DNS_MASTER_NOTTL     0x00008000 /*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL  0x00010000 /*%< Check max-zone-ttl */
 #define DNS_MASTER_CHECKSVCB 0x00020000 /*%< Check SVBC records */
+#define DNS_MASTER_PARALLEL  0x00040000 /*%< Parse large files in parallel */
 
 ISC_LANG_BEGINDECLS
 
@@ -77,6 +78,8 @@ ISC_LANG_BEGINDECLS
 #define DNS_MASTERRAW_COMPAT	      0x01
 #define DNS_MASTERRAW_SOURCESERIALSET 0x02
 #define DNS_MASTERRAW_LASTXFRINSET    0x04
+#define DNS_MASTERRAW_TRUST	      0x08 /*%< Each RRset carries its trust \
+					    * level (cache snapshots) */
 
 /* Common header */
 struct dns_masterrawheader {
@@ -84,8 +87,9 @@ struct dns_masterrawheader {
 				* dns_masterformat_raw */
 	uint32_t version;      /* compatibility for future
 				* extensions */
-	uint32_t dumptime;     /* timestamp on creation
-				* (currently unused) */
+	uint32_t dumptime;     /* timestamp on creation (used
+				* to age the TTLs of cache
+				* snapshots) */
 	uint32_t flags;	       /* Flags */
 	uint32_t sourceserial; /* Source serial number (used
 				* by inline-signing zones) */
@@ -103,7 +107,11 @@ typedef struct {
 	dns_rdatatype_t	 covers;  /* same as type */
 	dns_ttl_t	 ttl;	  /* 32-bit TTL */
 	uint32_t	 nrdata;  /* number of RRs in this set */
-	/* followed by encoded owner name, and then rdata */
+	/*
+	 * followed by a 16-bit trust level if DNS_MASTERRAW_TRUST is
+	 * set in the file header, then by the encoded owner name, and
+	 * then rdata
+	 */
 } dns_masterrawrdataset_t;
 
 /*
@@ -155,6 +163,16 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
  * If 'DNS_MASTER_AGETTL' is set and the master file contains one or more
  * $DATE directives, the TTLs of the data will be aged accordingly.
  *
+ * If 'DNS_MASTER_PARALLEL' is set and a large text format file is
+ * loaded from disk, the file is split at record boundaries and the
+ * pieces are parsed on several threads.  'callbacks->add' is then
+ * called from those threads, although never concurrently, and
+ * rdatasets belonging to the same name may be added more than once.
+ * Files that use $INCLUDE or $DATE, or that have no $TTL before the
+ * first split point, are parsed on a single thread.  The number of
+ * threads parsing files in parallel is limited to the number of CPUs
+ * across all the loads in progress.
+ *
  * 'callbacks->commit' is assumed to call 'callbacks->error' or
  * 'callbacks->warn' to generate any error messages required.
  *
@@ -229,4 +247,13 @@ dns_master_initrawheader(dns_masterrawheader_t *header);
  * Initializes the header for a raw master file, setting all
  * values to zero.
  */
+
+void
+dns__master_setparallel(size_t chunksize, unsigned int maxthreads);
+/*%<
+ * Set the size of the pieces that files loaded with DNS_MASTER_PARALLEL
+ * are split into, and the maximum number of extra threads parsing them;
+ * 0 restores the defaults.  (Not currently intended for use outside of
+ * this module and associated tests.)
+ */
 ISC_LANG_ENDDECLS
@@ -31,6 +31,17 @@
 
 typedef struct dns_master_style dns_master_style_t;
 
+/*%
+ * Restricts a dump to part of a database.  When 'name' is not NULL,
+ * only the names at or below it are dumped; when 'type' is not 0,
+ * only the RRsets of that type are, along with their signatures and
+ * negative cache entries.
+ */
+struct dns_dumpfilter {
+	const dns_name_t *name;
+	dns_rdatatype_t	  type;
+};
+
 /***
  *** Definitions
  ***/
@@ -251,8 +262,9 @@ isc_result_t
 dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 			     dns_dbversion_t	      *version,
 			     const dns_master_style_t *style, FILE *f,
-			     isc_loop_t *loop, dns_dumpdonefunc_t done,
-			     void *done_arg, dns_dumpctx_t **dctxp);
+			     const dns_dumpfilter_t *filter, isc_loop_t *loop,
+			     dns_dumpdonefunc_t done, void *done_arg,
+			     dns_dumpctx_t **dctxp);
 
 isc_result_t
 dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
@@ -267,6 +279,9 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * If 'format' is dns_masterformat_raw, then 'header' can contain
  * information to be written to the file header.
  *
+ * The asynchronous version dumps only what 'filter' selects, if it
+ * is not NULL.
+ *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
  * Require:
@@ -288,7 +303,8 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		     const dns_master_style_t *style, const char *filename,
 		     isc_loop_t *loop, dns_dumpdonefunc_t done, void *done_arg,
 		     dns_dumpctx_t **dctxp, dns_masterformat_t format,
-		     dns_masterrawheader_t *header);
+		     dns_masterrawheader_t *header,
+		     const dns_dumpfilter_t *filter);
 
 isc_result_t
 dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
@@ -303,6 +319,9 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * If 'format' is dns_masterformat_raw, then 'header' can contain
  * information to be written to the file header.
  *
+ * The asynchronous version dumps only what 'filter' selects, if it
+ * is not NULL.
+ *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
  * Returns:
@@ -350,4 +369,13 @@ dns_master_stylecreate(dns_master_style_t    **style,
 void
 dns_master_styledestroy(dns_master_style_t **style, isc_mem_t *mctx);
 
+void
+dns__master_setdumpparallel(size_t minnodes, unsigned int nthreads);
+/*%<
+ * Set the number of nodes from which databases are dumped in parallel,
+ * and the number of threads formatting them; 0 restores the defaults.
+ * (Not currently intended for use outside of this module and associated
+ * tests.)
+ */
+
 ISC_LANG_ENDDECLS
@@ -26,6 +26,7 @@
 
 #include <dns/compress.h>
 #include <dns/masterdump.h>
+#include <dns/name.h>
 #include <dns/types.h>
 
 #include <dst/dst.h>
@@ -226,6 +227,10 @@ typedef enum dns_message_intent {
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION \
 	0x0008 /*%< truncation errors are \
 		* not fatal. */
+#define DNS_MESSAGEPARSE_STREAMANSWER    \
+	0x0010 /*%< leave the answer    \
+		* section to be read   \
+		* one RR at a time. */
 
 /*
  * Control behavior of rendering
@@ -240,6 +245,11 @@ typedef enum dns_message_intent {
 	0x0010 /*%< prefer AAAA records in \
 		*   additional section. */
 /* Obsolete: DNS_MESSAGERENDER_FILTER_AAAA	0x0020	*/
+#define DNS_MESSAGERENDER_QNAMECASE      \
+	0x0040 /*%< render owner names   \
+		*   equal to the question \
+		*   name as the question  \
+		*   name. */
 
 typedef struct dns_msgblock dns_msgblock_t;
 
@@ -291,7 +301,7 @@ struct dns_message {
 	unsigned int	     tkey	      : 1; /* 13 */
 	unsigned int	     rdclass_set      : 1; /* 14 */
 	unsigned int	     fuzzing	      : 1; /* 15 */
-	unsigned int	     free_pools	      : 1; /* 16 */
+	unsigned int	     streamed	      : 1; /* 16 */
 	unsigned int			      : 0;
 
 	unsigned int opt_reserved;
@@ -314,9 +324,13 @@ struct dns_message {
 	ISC_LIST(dns_msgblock_t) rdatas;
 	ISC_LIST(dns_msgblock_t) rdatalists;
 	ISC_LIST(dns_msgblock_t) offsets;
+	ISC_LIST(dns_msgblock_t) names;
+	ISC_LIST(dns_msgblock_t) rdatasets;
 
 	ISC_LIST(dns_rdata_t) freerdata;
 	ISC_LIST(dns_rdatalist_t) freerdatalist;
+	ISC_LIST(dns_name_t) freename;
+	ISC_LIST(dns_rdataset_t) freerdataset;
 
 	dns_rcode_t tsigstatus;
 	dns_rcode_t querytsigstatus;
@@ -335,6 +349,20 @@ struct dns_message {
 	isc_region_t query;
 	isc_region_t saved;
 
+	/*
+	 * The answer section, when it is left in 'saved' by
+	 * DNS_MESSAGEPARSE_STREAMANSWER, and the RR it is being read at.
+	 */
+	unsigned int	 streamstart;
+	unsigned int	 streamend;
+	isc_buffer_t	 streamsource;
+	dns_name_t	 streamname;
+	dns_ttl_t	 streamttl;
+	dns_rdatatype_t	 streamtype;
+	dns_rdataclass_t streamclass;
+	isc_region_t	 streamrdata;
+	unsigned char	*streamdata;
+
 	/*
 	 * Time to be used when fuzzing.
 	 */
@@ -378,7 +406,11 @@ dns_message_create(isc_mem_t *mctx, isc_mempool_t *namepool,
  *\li	'msgp' be non-null and '*msg' be NULL.
  *
  *\li	'namepool' and 'rdspool' must be either both NULL or both valid
- *	isc_mempool_t
+ *	isc_mempool_t.  When they are NULL, temporary names and rdatasets
+ *	are carved out of blocks owned by the message, which are released
+ *	all at once by dns_message_reset() and dns_message_detach(); this
+ *	is the cheapest choice for a message that is reused many times.
+ *	Shared pools are better for short-lived messages.
  *
  *\li	'intent' must be one of DNS_MESSAGE_INTENTPARSE or
  *	#DNS_MESSAGE_INTENTRENDER.
@@ -564,6 +596,17 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_STREAMANSWER is set, the owner names and lengths of
+ * the RRs in the answer section are checked, but no names, rdatasets or
+ * rdata are created for them: the section is empty, and its RRs are read
+ * one at a time, straight from the wire, with dns_message_firstrr() and
+ * dns_message_nextrr().  This saves the allocations of parsing large
+ * responses, such as zone transfers, that are only walked once.  Errors
+ * in the rdata are then reported by those functions, and are never
+ * recoverable.  The option is ignored for UPDATE messages.  The wire data
+ * must stay valid for as long as the RRs are read, unless
+ * #DNS_MESSAGEPARSE_CLONEBUFFER is also set.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -699,6 +742,32 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, dns_section_t section,
+		      const isc_region_t *data, unsigned int count);
+/*%<
+ * Append 'count' records that have already been rendered into 'data'
+ * to the given section.
+ *
+ * The records must have been rendered at the same offset in an
+ * identical message, and any compression pointers in them must point
+ * within 'data'; this is the case for the answer section of a message
+ * without a question, so this is only allowed straight after the
+ * header.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section.
+ *
+ *\li	dns_message_renderbegin() was called, and nothing has been
+ *	rendered since.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
@@ -808,6 +877,60 @@ dns_message_currentname(dns_message_t *msg, dns_section_t section,
  *	#ISC_R_SUCCESS.
  */
 
+isc_result_t
+dns_message_firstrr(dns_message_t *msg);
+/*%<
+ * Read the first RR of the answer section of a message parsed with
+ * #DNS_MESSAGEPARSE_STREAMANSWER.
+ *
+ * Requires:
+ *
+ *\li	'msg' be valid, and its answer section have been left on the wire
+ *	by dns_message_parse().
+ *
+ * Returns:
+ *
+ *\li	#ISC_R_SUCCESS		-- an RR was read.
+ *
+ *\li	#ISC_R_NOMORE		-- the answer section is empty.
+ *
+ *\li	Others			-- the RR is malformed.
+ */
+
+isc_result_t
+dns_message_nextrr(dns_message_t *msg);
+/*%<
+ * Read the next RR of the answer section, as for dns_message_firstrr().
+ *
+ * Requires:
+ *
+ *\li	'msg' be valid.
+ *
+ *\li	The last call to dns_message_firstrr() or dns_message_nextrr()
+ *	returned #ISC_R_SUCCESS.
+ */
+
+void
+dns_message_currentrr(dns_message_t *msg, dns_name_t **name, dns_ttl_t *ttl,
+		      dns_rdata_t *rdata);
+/*%<
+ * Return the owner name, TTL and rdata of the RR that was last read.
+ * The name and the rdata are only valid until the next RR is read.
+ *
+ * Requires:
+ *
+ *\li	'msg' be valid.
+ *
+ *\li	'name' be non-NULL, and *name be NULL.
+ *
+ *\li	'ttl' be non-NULL.
+ *
+ *\li	'rdata' be a valid, empty rdata.
+ *
+ *\li	The last call to dns_message_firstrr() or dns_message_nextrr()
+ *	returned #ISC_R_SUCCESS.
+ */
+
 isc_result_t
 dns_message_findname(dns_message_t *msg, dns_section_t section,
 		     const dns_name_t *target, dns_rdatatype_t type,
@@ -153,6 +153,42 @@ dns_nsec3_addnsec3sx(dns_db_t *db, dns_dbversion_t *version,
  *	'diff' to be valid.
  */
 
+isc_result_t
+dns_nsec3_buildchain(dns_db_t *db, dns_dbversion_t *version,
+		     const dns_rdata_nsec3param_t *nsec3param,
+		     dns_ttl_t nsecttl, bool *seen_nsec, dns_diff_t *diff);
+/*%<
+ * Build the whole NSEC3 chain identified by 'nsec3param' in one pass,
+ * recording the change in 'diff'.  The result is the same as calling
+ * dns_nsec3_addnsec3() for each name in the zone, but rather than
+ * looking up the neighbours of every new NSEC3 record in the database,
+ * the zone is walked once, every name that needs an NSEC3 record,
+ * including the empty non-terminals, is hashed with
+ * isc_iterated_hash_batch(), and the hashes are sorted into the chain.
+ *
+ * The new records are appended to 'diff' without looking for tuples
+ * they cancel, so 'diff' must not hold changes to this chain.
+ *
+ * '*seen_nsec' is set to whether any name in the zone has an NSEC
+ * record.
+ *
+ * Requires:
+ *	'db' to be valid.
+ *	'version' to be valid.
+ *	'nsec3param' to be valid.
+ *	'seen_nsec' != NULL.
+ *	'diff' to be valid.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS
+ *	ISC_R_EXISTS		the zone already has NSEC3 records for this
+ *				chain, which must be updated one name at a
+ *				time instead
+ *	ISC_R_NOTIMPLEMENTED	the hash algorithm cannot be batched
+ *	DNS_R_NSEC3RESALT	two names have the same hash
+ *	other errors from the database
+ */
+
 isc_result_t
 dns_nsec3_delnsec3(dns_db_t *db, dns_dbversion_t *version,
 		   const dns_name_t		*name,
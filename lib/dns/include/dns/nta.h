@@ -64,6 +64,14 @@ dns_ntatable_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
  *\li	*ntatablep is a valid, empty NTA table.
  */
 
+uint64_t
+dns_ntatable_generation(void);
+/*%<
+ * Return a number that is incremented whenever any NTA table is created,
+ * or has an NTA added, changed or deleted.  A lookup done at the same
+ * time after reading the same number gives the same answer.
+ */
+
 #if DNS_NTA_TRACE
 #define dns_ntatable_ref(ptr) \
 	dns_ntatable__ref(ptr, __func__, __FILE__, __LINE__)
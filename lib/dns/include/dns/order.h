@@ -41,7 +41,8 @@ dns_order_add(dns_order_t *order, const dns_name_t *name,
 	      dns_rdatatype_t rdtype, dns_rdataclass_t rdclass,
 	      unsigned int mode);
 /*%<
- * Add a entry to the end of the order list.
+ * Add a entry to the end of the order list.  Entries must not be
+ * added once the list is in use by dns_order_find().
  *
  * Requires:
  * \li	'order' to be valid.
@@ -58,7 +59,9 @@ unsigned int
 dns_order_find(dns_order_t *order, const dns_name_t *name,
 	       dns_rdatatype_t rdtype, dns_rdataclass_t rdclass);
 /*%<
- * Find the first matching entry on the list.
+ * Find the first matching entry on the list.  Short lists are walked
+ * in order; longer ones are looked up in a trie of the entry names,
+ * which must be done from an isc_loop thread.
  *
  * Requires:
  *\li	'order' to be valid.
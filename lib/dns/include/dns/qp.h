@@ -85,6 +85,7 @@
  */
 
 #include <isc/attributes.h>
+#include <isc/histo.h>
 
 #include <dns/name.h>
 #include <dns/types.h>
@@ -250,6 +251,20 @@ typedef struct dns_qpchain {
 	} chain[DNS_NAME_MAXLABELS];
 } dns_qpchain_t;
 
+/*%
+ * One entry in a batch of exact-match lookups for `dns_qp_lookup_batch()`.
+ * The caller fills in the key; the `tag` is not used by the qp-trie code,
+ * so that callers can keep track of entries after they have been sorted.
+ */
+typedef struct dns_qpbatch {
+	dns_qpkey_t  key;    /*%< search key (in) */
+	size_t	     keylen; /*%< length of search key (in) */
+	size_t	     tag;    /*%< for the caller */
+	void	    *pval;   /*%< leaf pointer value (out) */
+	uint32_t     ival;   /*%< leaf integer value (out) */
+	isc_result_t result; /*%< ISC_R_SUCCESS or ISC_R_NOTFOUND (out) */
+} dns_qpbatch_t;
+
 /*%
  * These leaf methods allow the qp-trie code to call back to the code
  * responsible for the leaf values that are stored in the trie. The
@@ -319,6 +334,7 @@ typedef enum dns_qpgc {
 	DNS_QPGC_MAYBE,
 	DNS_QPGC_NOW,
 	DNS_QPGC_ALL,
+	DNS_QPGC_STEP,
 } dns_qpgc_t;
 
 /***********************************************************************
@@ -370,6 +386,19 @@ dns_qpmulti_create(isc_mem_t *mctx, const dns_qpmethods_t *methods, void *uctx,
  * \li  `*qpmp` is a pointer to a valid multi-threaded qp-trie
  */
 
+void
+dns_qpmulti_interleave(dns_qpmulti_t *multi);
+/*%<
+ * Spread the memory used by a multi-threaded qp-trie across all NUMA
+ * nodes, so that lookups from every node see the same latency. This
+ * is meant for big read-mostly tries; it has no effect on systems with
+ * one node, or where interleaving is not supported.
+ *
+ * Requires:
+ * \li  `multi` is a pointer to a valid multi-threaded qp-trie
+ * \li  no transactions have been made on `multi` yet
+ */
+
 void
 dns_qpmulti_destroy(dns_qpmulti_t **qpmp);
 /*%<
@@ -407,6 +436,16 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode);
  *
  * \li	If `mode == DNS_QPGC_ALL`, the entire trie is compacted
  *
+ * \li	If `mode == DNS_QPGC_STEP`, and the trie is fragmented, or a
+ *	full pass is pending, or an earlier step did not finish, a
+ *	bounded part of the trie is cleaned, continuing where the
+ *	previous step stopped
+ *
+ * Automatic compaction, and compaction when an update transaction is
+ * committed, work in bounded steps like DNS_QPGC_STEP, so that a large
+ * trie is cleaned over several modifications or transactions instead of
+ * in one long pause.
+ *
  * Requires:
  * \li  `qp` is a pointer to a valid qp-trie
  */
@@ -418,8 +457,20 @@ dns_qp_gctime(uint64_t *compact_us, uint64_t *recover_us,
  * Get the total times spent on garbage collection in microseconds.
  *
  * These counters are global, covering every qp-trie in the program.
+ */
+
+void
+dns_qp_gcpauses(isc_histo_t **hgp);
+/*%<
+ * Add the distribution of the durations of individual compactions,
+ * in microseconds, to the histogram `*hgp`, creating it if `*hgp` is
+ * NULL.
+ *
+ * Like dns_qp_gctime(), this covers every qp-trie in the program.
  *
- * XXXFANF This is a placeholder until we can record times in histograms.
+ * Requires:
+ * \li  `hgp != NULL`
+ * \li  `*hgp` is NULL or a pointer to a valid histogram
  */
 
 dns_qp_memusage_t
@@ -526,6 +577,38 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
  * \li  ISC_R_SUCCESS if the leaf was found
  */
 
+void
+dns_qpbatch_sort(dns_qpbatch_t *batch, size_t count);
+/*%<
+ * Sort a batch of lookups into key order, ready for
+ * `dns_qp_lookup_batch()`.
+ *
+ * Requires:
+ * \li  `batch` points to an array of `count` entries with valid keys
+ */
+
+void
+dns_qp_lookup_batch(dns_qpreadable_t qpr, dns_qpbatch_t *batch, size_t count);
+/*%<
+ * Find the leaves in a qp-trie that match each of the keys in a batch,
+ * like `dns_qp_getkey()` for each entry.
+ *
+ * Because the keys are in order, the walk down the trie towards a key
+ * reuses the part of the previous walk that tested the key prefix they
+ * share. The leaves are compared with their keys after all the walks
+ * are done, so that their memory can be prefetched and the cache misses
+ * overlap.
+ *
+ * The `result` of each entry is set to ISC_R_SUCCESS or ISC_R_NOTFOUND,
+ * and the `pval` and `ival` are set from the leaf if it was found, or to
+ * zero otherwise.
+ *
+ * Requires:
+ * \li  `qpr` is a pointer to a readable qp-trie
+ * \li  `batch` points to an array of `count` entries with valid keys,
+ *	sorted as by `dns_qpbatch_sort()`
+ */
+
 isc_result_t
 dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	      dns_name_t *foundname, dns_qpiter_t *iter, dns_qpchain_t *chain,
@@ -99,6 +99,7 @@ typedef struct dns_rdatasetmethods {
 	void (*getownercase)(const dns_rdataset_t *rdataset, dns_name_t *name);
 	isc_result_t (*addglue)(dns_rdataset_t	*rdataset,
 				dns_dbversion_t *version, dns_message_t *msg);
+	unsigned int (*rdatasize)(dns_rdataset_t *rdataset);
 } dns_rdatasetmethods_t;
 
 #define DNS_RDATASET_MAGIC	ISC_MAGIC('D', 'N', 'S', 'R')
@@ -181,7 +182,10 @@ struct dns_rdataset {
 		 * memory immediately following a slabheader. (There
 		 * is an exception in the case of rdatasets returned by
 		 * the `getnoqname` and `getclosest` methods; see
-		 * comments in rbtdb.c for details.)
+		 * comments in rbtdb.c for details.)  If the slab is packed,
+		 * 'unpacked' holds a decoded copy while it is iterated over.
+		 * If it is in a slab store, 'shared' is set and 'raw' points
+		 * at the pointer to it that follows the slabheader.
 		 */
 		struct {
 			struct dns_db	       *db;
@@ -189,7 +193,9 @@ struct dns_rdataset {
 			unsigned char	       *raw;
 			unsigned char	       *iter_pos;
 			unsigned int		iter_count;
+			bool			shared;
 			dns_slabheader_proof_t *noqname, *closest;
+			unsigned char	       *unpacked;
 		} slab;
 
 		/*
@@ -232,6 +238,14 @@ struct dns_rdataset {
  *	Set on rdatasets that were added during a stale-answer-client-timeout
  *	lookup. In other words, the RRset was added during a lookup of stale
  *	data and does not necessarily mean that the rdataset itself is stale.
+ *
+ * \def DNS_RDATASETATTR_POPULAR
+ *	Set by the cache on the lookup that makes a prefetch-eligible
+ *	RRset popular enough to be refreshed before it expires.
+ *
+ * \def DNS_RDATASETATTR_PACKED
+ *	Set by the cache on rdatasets bound to a slab that was packed by
+ *	dns_rdataslab_pack().
  */
 
 #define DNS_RDATASETATTR_NONE	      0x00000000 /*%< No ordering. */
@@ -266,6 +280,8 @@ struct dns_rdataset {
 #define DNS_RDATASETATTR_STALE_ADDED  0x08000000
 #define DNS_RDATASETATTR_KEEPCASE     0x10000000
 #define DNS_RDATASETATTR_STATICSTUB   0x20000000
+#define DNS_RDATASETATTR_POPULAR      0x40000000
+#define DNS_RDATASETATTR_PACKED	      0x80000000
 
 /*%
  * _OMITDNSSEC:
@@ -273,6 +289,14 @@ struct dns_rdataset {
  */
 #define DNS_RDATASETTOWIRE_OMITDNSSEC 0x0001
 
+/*%
+ * _QNAMECASE:
+ *	Render the owner name with the case of 'owner_name', instead of the
+ *	case stored in the rdataset.  Used when 'owner_name' is the question
+ *	name of the message being rendered.
+ */
+#define DNS_RDATASETTOWIRE_QNAMECASE 0x0002
+
 void
 dns_rdataset_init(dns_rdataset_t *rdataset);
 /*%<
@@ -375,6 +399,23 @@ dns_rdataset_count(dns_rdataset_t *rdataset);
  *\li	The number of records in 'rdataset'.
  */
 
+unsigned int
+dns_rdataset_minsize(dns_rdataset_t *rdataset);
+/*%<
+ * Return a lower bound on the number of octets 'rdataset' takes when it
+ * is rendered with dns_rdataset_towire(), computed without rendering
+ * it: each record takes at least a compression pointer for its owner
+ * name, the fixed fields, and its rdata unless names in the rdata may
+ * be compressed.
+ *
+ * Requires:
+ *\li	'rdataset' is a valid, associated rdataset.
+ *
+ * Returns:
+ *\li	The lower bound, or 0 if the rdataset implementation can't
+ *	compute it cheaply.
+ */
+
 isc_result_t
 dns_rdataset_first(dns_rdataset_t *rdataset);
 /*%<
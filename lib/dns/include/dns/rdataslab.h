@@ -83,16 +83,45 @@ struct dns_slabheader {
 	 */
 
 	isc_stdtime_t resign;
-	unsigned int  resign_lsb : 1;
 
-	atomic_uint_fast16_t count;
+	_Atomic(isc_stdtime_t) last_used;
+	/*%<
+	 * Updated by cache lookups while holding only the node read lock.
+	 */
+
+	atomic_uint_least32_t last_refresh_fail_ts;
+
+	/*
+	 * The counters below are deliberately the narrowest atomic types
+	 * that fit: the "fast" types are 64 bits wide on common platforms,
+	 * and every cached RRset carries one of these headers.
+	 */
+	atomic_uint_least16_t count;
 	/*%<
 	 * Monotonically increased every time this rdataset is bound so that
 	 * it is used as the base of the starting point in DNS responses
 	 * when the "cyclic" rrset-order is required.
 	 */
 
-	atomic_uint_fast32_t last_refresh_fail_ts;
+	atomic_uint_least16_t hits;
+	/*%<
+	 * Number of times this rdataset has been bound for a lookup while
+	 * eligible for prefetch; used to find the popular RRsets that are
+	 * worth refreshing before they expire.  It saturates at the
+	 * popularity threshold rather than wrapping.
+	 */
+
+	unsigned int resign_lsb : 1;
+	unsigned int packed	: 1;
+	/*%<
+	 * Set if the records were re-encoded by dns_rdataslab_pack().
+	 */
+	unsigned int shared : 1;
+	/*%<
+	 * Set if the records are held by a slab store; the header is then
+	 * followed by a pointer to them instead of by the records
+	 * themselves.  See dns_slabheader_share().
+	 */
 
 	dns_slabheader_proof_t *noqname;
 	dns_slabheader_proof_t *closest;
@@ -122,17 +151,16 @@ struct dns_slabheader {
 	 * this rdataset, if any.
 	 */
 
-	isc_stdtime_t last_used;
 	ISC_LINK(struct dns_slabheader) link;
 
+	isc_heap_t *heap;
+
 	/*%
 	 * Case vector.  If the bit is set then the corresponding
 	 * character in the owner name needs to be AND'd with 0x20,
 	 * rendering that character upper case.
 	 */
 	unsigned char upper[32];
-
-	isc_heap_t *heap;
 };
 
 enum {
@@ -150,6 +178,8 @@ enum {
 	DNS_SLABHEADERATTR_CASEFULLYLOWER = 1 << 11,
 	DNS_SLABHEADERATTR_ANCIENT = 1 << 12,
 	DNS_SLABHEADERATTR_STALE_WINDOW = 1 << 13,
+	DNS_SLABHEADERATTR_VISITED = 1 << 14,
+	DNS_SLABHEADERATTR_PROBATION = 1 << 15,
 };
 
 #define DNS_SLABHEADER_GETATTR(header, attribute) \
@@ -220,6 +250,41 @@ dns_rdataslab_count(unsigned char *slab, unsigned int reservelen);
  *\li	The number of records in the slab.
  */
 
+bool
+dns_rdataslab_pack(isc_mem_t *mctx, isc_region_t *region,
+		   unsigned int reservelen, dns_rdataclass_t rdclass,
+		   dns_rdatatype_t type);
+/*%<
+ * Re-encode the records of the slab in 'region', which was made by
+ * dns_rdataslab_fromrdataset() with the same 'reservelen', using a
+ * dictionary of the substrings that are common in TXT, SVCB and HTTPS
+ * records.  This is only done for those types, and only if it saves a
+ * worthwhile amount of memory; if it is done, the slab in 'region' is
+ * freed and replaced by the packed one, and true is returned.
+ *
+ * A packed slab has the same layout as an ordinary one, so its size and
+ * number of records can be found as usual, but its records must be
+ * passed through dns_rdataslab_unpack() before use, and it must not be
+ * merged with, subtracted from or compared to another slab.  Rdatasets
+ * bound to a packed slab must have #DNS_RDATASETATTR_PACKED set; they
+ * unpack it the first time they are iterated over.
+ *
+ * Requires:
+ *\li	'region' contains a slab, with the reserved area at the start.
+ */
+
+unsigned char *
+dns_rdataslab_unpack(unsigned char *slab, unsigned int reservelen,
+		     isc_mem_t *mctx);
+/*%<
+ * Return a newly allocated copy of the packed 'slab', including its
+ * reserved area, with the records decoded.  The copy is
+ * dns_rdataslab_size() bytes long.
+ *
+ * Requires:
+ *\li	'slab' is a slab packed by dns_rdataslab_pack().
+ */
+
 isc_result_t
 dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 		    unsigned int reservelen, isc_mem_t *mctx,
@@ -227,7 +292,10 @@ dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 		    unsigned int flags, uint32_t maxrrperset,
 		    unsigned char **tslabp);
 /*%<
- * Merge 'oslab' and 'nslab'.
+ * Merge 'oslab' and 'nslab'.  Records of 'nslab' that are already in
+ * 'oslab' are skipped; if there are no others, DNS_R_UNCHANGED is
+ * returned unless DNS_RDATASLAB_FORCE is set.  DNS_RDATASLAB_EXACT
+ * has no effect.
  */
 
 isc_result_t
@@ -279,7 +347,26 @@ dns_slabheader_fromrdataset(const dns_rdataset_t *rdataset);
 void *
 dns_slabheader_raw(dns_slabheader_t *header);
 /*%
- * Returns the address of the raw memory following a dns_slabheader.
+ * Returns the address of the slab holding the records of 'header': the
+ * raw memory following it or, if it is shared, the copy in the slab
+ * store.
+ */
+
+dns_slabheader_t *
+dns_slabheader_share(dns_slabheader_t *header, dns_slabstore_t *store);
+/*%
+ * Move the records of 'header' into 'store', and return a new header,
+ * with the contents of 'header', that refers to them.  'header' is
+ * freed.  The records are released back to the store when the new
+ * header is destroyed.
+ *
+ * Merging with or subtracting from a shared slab with
+ * dns_rdataslab_merge() or dns_rdataslab_subtract(), which expect the
+ * records to follow the header, needs a private copy of it.
+ *
+ * Requires:
+ *\li	'header' is followed by its (unpacked) slab, and its 'db' is set.
+ *\li	'store' is a valid slab store.
  */
 
 void
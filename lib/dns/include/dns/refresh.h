@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file
+ * \brief
+ * The refresh module keeps popular cached RRsets fresh.
+ *
+ * The cache counts the lookups that hit each prefetch-eligible RRset and
+ * flags it as popular (#DNS_RDATASETATTR_POPULAR) once it has been hit
+ * often enough; the query code then registers the RRset here.  A timer
+ * on the main loop refetches registered RRsets when they enter the
+ * prefetch window, with a bounded number of fetches in flight, so that
+ * popular names don't see a cache miss when they expire.
+ *
+ * The number of refreshes started, the refreshes that failed, the
+ * refreshed RRsets that were queried again, and the popular RRsets that
+ * could not be refreshed are counted in the resolver statistics.
+ */
+
+#include <isc/lang.h>
+#include <isc/loop.h>
+#include <isc/refcount.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/* Add -DDNS_REFRESH_TRACE=1 to CFLAGS for detailed reference tracing */
+
+ISC_LANG_BEGINDECLS
+
+void
+dns_refresh_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+		   unsigned int size, unsigned int fetches,
+		   dns_refresh_t **refreshp);
+/*%<
+ * Create a refresher for the cache of 'view' that tracks at most 'size'
+ * popular RRsets and has at most 'fetches' refreshes in flight.
+ *
+ * Requires:
+ *
+ *\li	'view' is a valid view with a resolver.
+ *\li	'loopmgr' is a valid loopmgr.
+ *\li	'size' and 'fetches' are greater than zero.
+ *\li	refreshp != NULL && *refreshp == NULL
+ */
+
+void
+dns_refresh_shutdown(dns_refresh_t *refresh);
+/*%<
+ * Stop the refresh timer, cancel the refreshes in flight, and stop
+ * accepting new RRsets.
+ *
+ * Requires:
+ *
+ *\li	'refresh' is a valid refresher.
+ */
+
+void
+dns_refresh_add(dns_refresh_t *refresh, const dns_name_t *name,
+		dns_rdatatype_t type, isc_stdtime_t expire);
+/*%<
+ * Register the popular RRset 'name'/'type', which expires from the cache
+ * at 'expire', to be refreshed before it does.  If the RRset is already
+ * registered, only its expiry time is updated.  If the table is full,
+ * the RRset is not registered.
+ *
+ * Requires:
+ *
+ *\li	'refresh' is a valid refresher.
+ *\li	'name' is a valid absolute name.
+ */
+
+#if DNS_REFRESH_TRACE
+#define dns_refresh_ref(ptr) dns_refresh__ref(ptr, __func__, __FILE__, __LINE__)
+#define dns_refresh_unref(ptr) \
+	dns_refresh__unref(ptr, __func__, __FILE__, __LINE__)
+#define dns_refresh_attach(ptr, ptrp) \
+	dns_refresh__attach(ptr, ptrp, __func__, __FILE__, __LINE__)
+#define dns_refresh_detach(ptrp) \
+	dns_refresh__detach(ptrp, __func__, __FILE__, __LINE__)
+ISC_REFCOUNT_TRACE_DECL(dns_refresh);
+#else
+ISC_REFCOUNT_DECL(dns_refresh);
+#endif
+/*%
+ * Reference counting for dns_refresh
+ */
+
+ISC_LANG_ENDDECLS
@@ -380,6 +380,19 @@ dns_resolver_logfetch(dns_fetch_t *fetch, isc_logcategory_t category,
  *\li	'fetch' is a valid fetch, and has completed.
  */
 
+uint64_t
+dns_resolver_fetchid(dns_fetch_t *fetch);
+/*%<
+ * Return the identifier of the fetch context that 'fetch' joined.  All
+ * the fetches that were joined to the same fetch context, and therefore
+ * received the same response, return the same non-zero identifier; no
+ * other fetch context created by the same resolver does.
+ *
+ * Requires:
+ *
+ *\li	'fetch' is a valid fetch.
+ */
+
 dns_dispatch_t *
 dns_resolver_dispatchv4(dns_resolver_t *resolver);
 
@@ -503,6 +516,18 @@ dns_resolver_setfetchesperzone(dns_resolver_t *resolver, uint32_t clients);
 uint32_t
 dns_resolver_getfetchesperzone(dns_resolver_t *resolver);
 
+unsigned int
+dns_resolver_zonefetches(dns_resolver_t *resolver, const dns_name_t *domain);
+/*%<
+ * Return the number of fetches currently outstanding for the zone
+ * 'domain', as counted for fetches-per-zone.  This is 0 if
+ * fetches-per-zone is disabled.
+ *
+ * Requires:
+ * \li  resolver to be valid.
+ * \li  domain to be a valid name.
+ */
+
 void
 dns_resolver_getclientsperquery(dns_resolver_t *resolver, uint32_t *cur,
 				uint32_t *min, uint32_t *max);
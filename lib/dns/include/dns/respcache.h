@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * Defines dns_respcache_t, the authoritative response cache.
+ *
+ * Notes:
+ *\li	A response cache holds fully rendered responses to authoritative
+ *	queries, keyed by the query name, type and class, by an opaque
+ *	set of request flags supplied by the caller, and by the identifier
+ *	of the database version the response was built from (see
+ *	dns_db_versionid()).  A response is only found while that version
+ *	is current, so zone updates invalidate cached responses implicitly.
+ *
+ *\li	The cache is split into one direct-mapped table per loop.  Each
+ *	table is only ever accessed from its own loop, so no locking is
+ *	needed; a colliding entry simply replaces the previous one.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	At most 'size' entries per loop, each holding one response of up
+ *	to #DNS_RESPCACHE_MAXWIRE octets.
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+
+#include <isc/mem.h>
+#include <isc/region.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/*%
+ * Responses larger than this are not cached.
+ */
+#define DNS_RESPCACHE_MAXWIRE 4096
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_respcache_create(isc_mem_t *mctx, uint32_t nloops, uint32_t size,
+		     dns_respcache_t **cachep);
+/*%
+ * Create a response cache with 'size' entries for each of 'nloops' loops
+ * and store it in '*cachep'.  'size' is rounded up to a power of two.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	nloops > 0
+ * \li	size > 0
+ * \li	cachep != NULL && *cachep == NULL
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **cachep);
+/*%
+ * Free the response cache in '*cachep' and set '*cachep' to NULL.
+ *
+ * Requires:
+ * \li	'*cachep' to be a valid response cache
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_name_t *name,
+		   dns_rdatatype_t type, dns_rdataclass_t rdclass,
+		   uint32_t flags, uint64_t versionid, isc_stdtime_t now,
+		   isc_region_t *region, unsigned int *auxp);
+/*%
+ * Look up the response to 'name'/'type'/'class' queried with 'flags',
+ * built from database version 'versionid', in the current loop's table.
+ * Name comparison is case-sensitive.
+ *
+ * On success, 'region' is set to the cached response and '*auxp' to the
+ * value passed to dns_respcache_add().  The region remains valid until
+ * the next call to dns_respcache_add() on the same loop.
+ *
+ * Requires:
+ * \li	'cache' to be a valid response cache
+ * \li	'name' to be a valid absolute name
+ * \li	region != NULL && auxp != NULL
+ * \li	the caller to be running on one of the cache's loops
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		no current response is cached
+ */
+
+void
+dns_respcache_add(dns_respcache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, dns_rdataclass_t rdclass,
+		  uint32_t flags, uint64_t versionid, isc_stdtime_t expire,
+		  const isc_region_t *region, unsigned int aux);
+/*%
+ * Store a copy of the response in 'region' in the current loop's table,
+ * replacing any entry in the same slot.  The entry is not returned by
+ * dns_respcache_find() after 'expire'.  Responses larger than
+ * #DNS_RESPCACHE_MAXWIRE octets are silently ignored.
+ *
+ * Requires:
+ * \li	'cache' to be a valid response cache
+ * \li	'name' to be a valid absolute name
+ * \li	versionid != 0
+ * \li	the caller to be running on one of the cache's loops
+ */
+
+ISC_LANG_ENDDECLS
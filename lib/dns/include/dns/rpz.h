@@ -164,6 +164,9 @@ struct dns_rpz_zone {
 					 * on */
 	bool	     addsoa;		/* add soa to the additional section */
 	isc_timer_t *updatetimer;
+	char	    *journal;		/* journal of the zone, if any */
+	bool	     summarized;	/* 'serial' is in the summary */
+	uint32_t     serial;		/* serial of 'db' last summarized */
 };
 
 /*
@@ -171,6 +174,11 @@ struct dns_rpz_zone {
  */
 typedef struct dns_rpz_cidr_node dns_rpz_cidr_node_t;
 
+/*
+ * Filter of all triggers of all policy zones of a view
+ */
+typedef struct dns_rpz_filter dns_rpz_filter_t;
+
 /*
  * Bitfields indicating which policy zones have policies of
  * which type.
@@ -256,9 +264,10 @@ struct dns_rpz_zones {
 
 	/*
 	 * One lock for short term read-only search that guarantees the
-	 * consistency of the pointers.
-	 * A second lock for maintenance that guarantees no other thread
-	 * is adding or deleting nodes.
+	 * consistency of the pointers.  Policy zone updates build the
+	 * next radix tree, trigger counts and name table aside and only
+	 * take it for writing to publish them together.
+	 * A second lock for maintenance of the update state.
 	 */
 	isc_rwlock_t search_lock;
 	isc_mutex_t  maint_lock;
@@ -267,6 +276,7 @@ struct dns_rpz_zones {
 
 	dns_rpz_cidr_node_t *cidr;
 	dns_qpmulti_t	    *table;
+	dns_rpz_filter_t    *filter; /* RCU protected */
 };
 
 /*
@@ -392,6 +402,13 @@ dns_rpz_dbupdate_unregister(dns_db_t *db, dns_rpz_zone_t *rpz);
 void
 dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz);
 
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal);
+/*%<
+ * Set the name of the journal file of the policy zone, from which
+ * updates are read to change the summary incrementally.
+ */
+
 void
 dns_rpz_zones_shutdown(dns_rpz_zones_t *rpzs);
 
@@ -419,4 +436,16 @@ dns_rpz_zbits_t
 dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		  dns_rpz_zbits_t zbits, dns_name_t *trig_name);
 
+bool
+dns_rpz_filter_name(dns_rpz_zones_t *rpzs, const dns_name_t *trig_name);
+bool
+dns_rpz_filter_ip(dns_rpz_zones_t *rpzs, const isc_netaddr_t *netaddr);
+/*%<
+ * Quickly check whether any trigger of any policy zone could match
+ * 'trig_name', or an address block containing 'netaddr'.  The check
+ * uses a filter rebuilt with every policy zone update, so false
+ * means that dns_rpz_find_name() or dns_rpz_find_ip() would find
+ * nothing, while true may be a false positive.
+ */
+
 ISC_LANG_ENDDECLS
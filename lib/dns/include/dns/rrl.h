@@ -20,7 +20,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/lang.h>
+#include <isc/mutex.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -187,39 +189,27 @@ struct dns_rrl_qname_buf {
 
 typedef struct dns_rrl_rate dns_rrl_rate_t;
 struct dns_rrl_rate {
-	int	    r;
-	int	    scaled;
-	const char *str;
+	int		    r;
+	atomic_int_fast32_t scaled;
+	const char	   *str;
 };
 
+typedef struct dns_rrl dns_rrl_t;
+
 /*
- * Per-view query rate limit parameters and a pointer to database.
+ * The rate-limit entries are split into shards by client address
+ * block, each with its own lock, so that responses to different
+ * clients do not serialize on one lock.  All the entries for one
+ * client block are in the same shard, so its limits are the same as
+ * with a single table.
  */
-typedef struct dns_rrl dns_rrl_t;
-struct dns_rrl {
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
 	isc_mutex_t lock;
-	isc_mem_t  *mctx;
-
-	bool	       log_only;
-	dns_rrl_rate_t responses_per_second;
-	dns_rrl_rate_t referrals_per_second;
-	dns_rrl_rate_t nodata_per_second;
-	dns_rrl_rate_t nxdomains_per_second;
-	dns_rrl_rate_t errors_per_second;
-	dns_rrl_rate_t all_per_second;
-	dns_rrl_rate_t slip;
-	int	       window;
-	double	       qps_scale;
-	int	       max_entries;
-
-	dns_acl_t *exempt;
+	dns_rrl_t  *rrl;
 
 	int num_entries;
 
-	int	      qps_responses;
-	isc_stdtime_t qps_time;
-	double	      qps;
-
 	unsigned int probes;
 	unsigned int searches;
 
@@ -234,11 +224,6 @@ struct dns_rrl {
 #define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
 	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
 
-	int	 ipv4_prefixlen;
-	uint32_t ipv4_mask;
-	int	 ipv6_prefixlen;
-	uint32_t ipv6_mask[4];
-
 	isc_stdtime_t	 log_stops_time;
 	dns_rrl_entry_t *last_logged;
 	int		 num_logged;
@@ -248,6 +233,43 @@ struct dns_rrl {
 	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
 };
 
+/*
+ * Per-view query rate limit parameters and a pointer to database.
+ */
+struct dns_rrl {
+	isc_mem_t *mctx;
+
+	bool	       log_only;
+	bool	       early_drop;
+	dns_rrl_rate_t responses_per_second;
+	dns_rrl_rate_t referrals_per_second;
+	dns_rrl_rate_t nodata_per_second;
+	dns_rrl_rate_t nxdomains_per_second;
+	dns_rrl_rate_t errors_per_second;
+	dns_rrl_rate_t all_per_second;
+	dns_rrl_rate_t slip;
+	int	       window;
+	double	       qps_scale;
+	int	       max_entries; /*%< for all the shards together */
+
+	dns_acl_t *exempt;
+
+	/*
+	 * The total query rate, shared by all the shards.
+	 */
+	atomic_uint_fast32_t qps_responses;
+	atomic_uint_fast32_t qps_time;
+	atomic_uint_fast32_t qps;
+
+	int	 ipv4_prefixlen;
+	uint32_t ipv4_mask;
+	int	 ipv6_prefixlen;
+	uint32_t ipv6_mask[4];
+
+	unsigned int	 nshards;
+	dns_rrl_shard_t *shards;
+};
+
 typedef enum {
 	DNS_RRL_RESULT_OK,
 	DNS_RRL_RESULT_DROP,
@@ -260,6 +282,19 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	const dns_name_t *qname, isc_result_t resp_result, isc_stdtime_t now,
 	bool wouldlog, char *log_buf, unsigned int log_buf_len);
 
+dns_rrl_result_t
+dns_rrl_early(dns_view_t *view, const isc_sockaddr_t *client_addr,
+	      dns_rdataclass_t rdclass, dns_rdatatype_t qtype,
+	      const dns_name_t *qname, isc_stdtime_t now, bool wouldlog,
+	      char *log_buf, unsigned int log_buf_len);
+/*%<
+ * Decide before the answer is looked up whether a UDP response for
+ * 'qname' to 'client_addr' would be dropped or slipped because
+ * responses for that name are already being limited.  Returns
+ * DNS_RRL_RESULT_OK, without debiting anything, when there is no such
+ * limit; the response is then checked with dns_rrl() once it is known.
+ */
+
 void
 dns_rrl_view_destroy(dns_view_t *view);
 
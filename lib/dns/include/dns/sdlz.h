@@ -53,6 +53,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/loop.h>
+
 #include <dns/clientinfo.h>
 #include <dns/dlz.h>
 
@@ -331,6 +333,21 @@ dns_sdlz_putrr_t dns_sdlz_putrr;
  * parsed into a query response.
  */
 
+typedef isc_result_t
+dns_sdlz_putrdata_t(dns_sdlzlookup_t *lookup, dns_rdatatype_t type,
+		    dns_ttl_t ttl, const unsigned char *rdata,
+		    unsigned int length);
+dns_sdlz_putrdata_t dns_sdlz_putrdata;
+/*%<
+ * Like dns_sdlz_putrr(), but with the record data given in uncompressed
+ * wire format, which saves parsing it from text.  Backends that store
+ * wire format data can pass it through unchanged.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#DNS_R_SERVFAIL if 'rdata' is not valid for 'type'.
+ */
+
 typedef isc_result_t
 		  dns_sdlz_putsoa_t(dns_sdlzlookup_t *lookup, const char *mname,
 				    const char *rname, uint32_t serial);
@@ -353,4 +370,58 @@ dns_sdlz_setdb_t dns_sdlz_setdb;
  * Create the database pointers for a writeable SDLZ zone
  */
 
+isc_result_t
+dns_sdlz_setcachettl(dns_dlzdb_t *dlzdatabase, dns_ttl_t ttl);
+/*%<
+ * Cache the answers of the driver behind 'dlzdatabase' for at most
+ * 'ttl' seconds, and never longer than the TTL of the records.  The
+ * answers are cached by zone and name only, so a driver whose answers
+ * depend on the client must not be cached.  The cache is flushed when
+ * a dynamic update is committed.  A 'ttl' of zero disables the cache.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if 'dlzdatabase' is not an SDLZ database.
+ */
+
+isc_result_t
+dns_sdlz_setasync(dns_dlzdb_t *dlzdatabase, unsigned int max);
+/*%<
+ * Allow at most 'max' lookups of the driver behind 'dlzdatabase' to
+ * run on worker threads at the same time (see dns_sdlz_prefetch()).
+ * A 'max' of zero, the default, disables them.  The answers are only
+ * kept if the cache is enabled with dns_sdlz_setcachettl().
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if 'dlzdatabase' is not an SDLZ database.
+ */
+
+bool
+dns_sdlz_needprefetch(dns_dlzdb_t *dlzdatabase, const dns_name_t *name);
+/*%<
+ * Return true if lookups on worker threads are enabled for
+ * 'dlzdatabase' and answering a query for 'name' would have to ask
+ * the driver, because the answers it needs are not in the cache.
+ */
+
+isc_result_t
+dns_sdlz_prefetch(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
+		  const dns_name_t *name, isc_loop_t *loop, isc_job_cb cb,
+		  void *cbarg);
+/*%<
+ * Ask the driver behind 'dlzdatabase' for the zone of 'name' and for
+ * the nodes from the zone apex down to 'name' on a worker thread, so
+ * that the answers are in the cache when the query for 'name' is
+ * answered, then call 'cb' with 'cbarg' on 'loop'.  The lookup can't be
+ * interrupted; the driver's own timeouts apply.
+ *
+ * 'dlzdatabase' must stay valid until 'cb' is called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS if the lookup was started.
+ *\li	#ISC_R_QUOTA if as many lookups as allowed are running.
+ *\li	#ISC_R_NOTIMPLEMENTED if 'dlzdatabase' is not an SDLZ database.
+ */
+
 ISC_LANG_ENDDECLS
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, a store of the RRSIGs computed for a zone.
+ *
+ * Notes:
+ *\li	A signature cache remembers each signature made for a zone, keyed
+ *	by a SHA-256 digest of the owner name, of the RRset in canonical
+ *	form with its TTL, and of the signing key.  When the same RRset
+ *	has to be signed with the same key again, for instance because it
+ *	was deleted and added back, or because the zone was signed again
+ *	from its unsigned contents, a cached signature that is still valid
+ *	for long enough is used instead of computing a new one.
+ *
+ *\li	The cache can be saved to a file and loaded back from it, so that
+ *	the signatures outlive the server.  Expired signatures are dropped
+ *	when the cache is saved.
+ *
+ * MP:
+ *\li	All functions can be called from any thread.
+ *
+ * Resources:
+ *\li	One entry, holding the digest and the RRSIG rdata, per signature
+ *	made since the cache was last saved, or still valid when it was.
+ *
+ * Security:
+ *\li	The cache file is trusted: a signature read from it is served as
+ *	is, so it must only be writable by the server.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/mem.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_sigcache_create(isc_mem_t *mctx, dns_sigcache_t **cachep);
+/*%
+ * Create an empty signature cache and store it in '*cachep'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	cachep != NULL && *cachep == NULL
+ */
+
+void
+dns_sigcache_destroy(dns_sigcache_t **cachep);
+/*%
+ * Free the signature cache in '*cachep' and set '*cachep' to NULL.
+ *
+ * Requires:
+ * \li	'*cachep' to be a valid signature cache
+ */
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_name_t *name,
+		  dns_rdataset_t *rdataset, dst_key_t *key, isc_stdtime_t now,
+		  isc_stdtime_t minexpire, isc_buffer_t *buffer,
+		  dns_rdata_t *sigrdata);
+/*%
+ * Look up a signature of 'rdataset', owned by 'name', made with 'key',
+ * that is valid at 'now' and does not expire before 'minexpire'.  On
+ * success the RRSIG is copied into 'buffer' and 'sigrdata' is set to it,
+ * as dns_dnssec_sign() would do.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	'name' to be a valid absolute name
+ * \li	'rdataset' to be a valid, associated rdataset
+ * \li	'sigrdata' to be a valid, empty rdata
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		no such signature is cached
+ * \li	#ISC_R_NOSPACE		'buffer' is too small
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const dns_name_t *name,
+		 dns_rdataset_t *rdataset, dst_key_t *key,
+		 const dns_rdata_t *sigrdata);
+/*%
+ * Store 'sigrdata', the signature of 'rdataset' owned by 'name' just
+ * made with 'key', replacing any signature cached for the same RRset and
+ * key that expires earlier.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	'name' to be a valid absolute name
+ * \li	'rdataset' to be a valid, associated rdataset
+ * \li	'sigrdata' to be a valid RRSIG rdata
+ */
+
+isc_result_t
+dns_sigcache_load(dns_sigcache_t *cache, const char *filename);
+/*%
+ * Add the signatures saved in 'filename' to the cache.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	filename != NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_FILENOTFOUND	the file does not exist
+ * \li	#DNS_R_FORMERR		the file is not a valid cache file; the
+ *				signatures read before the error are kept
+ * \li	other errors from reading the file
+ */
+
+isc_result_t
+dns_sigcache_save(dns_sigcache_t *cache, const char *filename,
+		  isc_stdtime_t now);
+/*%
+ * Drop the signatures that expired before 'now' and write the others to
+ * 'filename', replacing it atomically.  Nothing is written if the cache
+ * has not changed since it was last loaded or saved.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	filename != NULL
+ */
+
+ISC_LANG_ENDDECLS
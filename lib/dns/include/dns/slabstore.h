@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/slabstore.h
+ * \brief
+ * Defines dns_slabstore_t, a store of rdata slabs shared by the zones
+ * of a view.
+ *
+ * Notes:
+ *\li	Zones hosted for many customers often have identical RRsets, such
+ *	as the NS and MX records pointing to the operator's own servers.
+ *	When a zone is loaded into a database that uses a slab store, the
+ *	slab holding the records of each of its RRsets is looked up in the
+ *	store by its contents, and a copy already there is used instead of
+ *	a new one.  The copies are reference counted, and freed when the
+ *	last RRset using them is.
+ *
+ *\li	Slabs in the store are never changed: a database that needs to
+ *	change an RRset makes a new slab for it.
+ *
+ * MP:
+ *\li	All functions can be called from any thread.
+ *
+ * Resources:
+ *\li	One entry, holding a copy of the slab, per distinct slab in use
+ *	by the databases using the store.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/mem.h>
+#include <isc/refcount.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_slabstore_create(isc_mem_t *mctx, dns_slabstore_t **storep);
+/*%
+ * Create an empty slab store and store it in '*storep'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	storep != NULL && *storep == NULL
+ */
+
+unsigned char *
+dns_slabstore_intern(dns_slabstore_t *store, const unsigned char *slab);
+/*%
+ * Return a copy of 'slab', a slab with no reserved area, held by
+ * 'store': if the store already has a slab with the same contents, that
+ * one is returned, otherwise a new copy is added to it.  The caller must
+ * release the copy with dns_slabstore_release() when it is done with it.
+ *
+ * Requires:
+ * \li	'store' to be a valid slab store
+ * \li	slab != NULL
+ */
+
+void
+dns_slabstore_release(unsigned char **slabp);
+/*%
+ * Release the slab in '*slabp', returned by dns_slabstore_intern(), and
+ * set '*slabp' to NULL.  The slab is freed once every caller that was
+ * given it has released it.
+ *
+ * Requires:
+ * \li	slabp != NULL and '*slabp' to be a slab from a slab store
+ */
+
+unsigned int
+dns_slabstore_count(dns_slabstore_t *store);
+/*%
+ * Return the number of distinct slabs held by 'store'.
+ *
+ * Requires:
+ * \li	'store' to be a valid slab store
+ */
+
+ISC_REFCOUNT_DECL(dns_slabstore);
+
+ISC_LANG_ENDDECLS
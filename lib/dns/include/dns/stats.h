@@ -75,7 +75,20 @@ enum {
 	dns_resstatscounter_nextitem = 44,
 	dns_resstatscounter_priming = 45,
 	dns_resstatscounter_forwardonlyfail = 46,
-	dns_resstatscounter_max = 47,
+	dns_resstatscounter_valcachehit = 47,
+	dns_resstatscounter_valcachemiss = 48,
+	dns_resstatscounter_fetchcrossloop = 49,
+	dns_resstatscounter_findcrossloop = 50,
+	dns_resstatscounter_dispportretry = 51,
+	dns_resstatscounter_tcpshared = 52,
+	dns_resstatscounter_refresh = 53,
+	dns_resstatscounter_refreshfail = 54,
+	dns_resstatscounter_refreshhit = 55,
+	dns_resstatscounter_refreshskipped = 56,
+	dns_resstatscounter_qminhint = 57,
+	dns_resstatscounter_raced = 58,
+	dns_resstatscounter_queryabandoned = 59,
+	dns_resstatscounter_max = 60,
 
 	/*
 	 * DNSSEC stats.
@@ -103,8 +116,10 @@ enum {
 	dns_zonestatscounter_ixfrreqv6 = 10,
 	dns_zonestatscounter_xfrsuccess = 11,
 	dns_zonestatscounter_xfrfail = 12,
+	dns_zonestatscounter_keymgrrun = 13,
+	dns_zonestatscounter_keymgrtime = 14,
 
-	dns_zonestatscounter_max = 13,
+	dns_zonestatscounter_max = 15,
 
 	/*
 	 * Adb statistics values.
@@ -113,8 +128,10 @@ enum {
 	dns_adbstats_entriescnt = 1,
 	dns_adbstats_nnames = 2,
 	dns_adbstats_namescnt = 3,
+	dns_adbstats_nameslockwait = 4,
+	dns_adbstats_entrieslockwait = 5,
 
-	dns_adbstats_max = 4,
+	dns_adbstats_max = 6,
 
 	/*
 	 * Cache statistics values.
@@ -126,8 +143,14 @@ enum {
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
 	dns_cachestatscounter_coveringnsec = 7,
+	dns_cachestatscounter_admitted = 8,
+	dns_cachestatscounter_probation = 9,
+	dns_cachestatscounter_reclaimbatches = 10,
+	dns_cachestatscounter_reclaimbytes = 11,
+	dns_cachestatscounter_reclaimusecs = 12,
+	dns_cachestatscounter_overmemusecs = 13,
 
-	dns_cachestatscounter_max = 8,
+	dns_cachestatscounter_max = 14,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -146,7 +169,8 @@ enum {
 	 */
 	dns_dnstapcounter_success = 0,
 	dns_dnstapcounter_drop = 1,
-	dns_dnstapcounter_max = 2,
+	dns_dnstapcounter_skipped = 2,
+	dns_dnstapcounter_max = 3,
 
 	/*
 	 * Glue cache statistics counters.
@@ -157,6 +181,14 @@ enum {
 	dns_gluecachestatscounter_inserts_absent = 3,
 
 	dns_gluecachestatscounter_max = 4,
+
+	/*
+	 * GeoIP statistics counters.
+	 */
+	dns_geoipstatscounter_lookup = 0,
+	dns_geoipstatscounter_cachehit = 1,
+
+	dns_geoipstatscounter_max = 2,
 };
 
 /*%
@@ -284,6 +316,13 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' == NULL.
  */
 
+void
+dns_rdatatypestats_create_sharded(isc_mem_t *mctx, dns_stats_t **statsp);
+/*%<
+ * Like dns_rdatatypestats_create(), but with per-loop counters, see
+ * isc_stats_create_sharded().
+ */
+
 void
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
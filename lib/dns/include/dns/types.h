@@ -79,12 +79,14 @@ typedef struct dns_dns64	      dns_dns64_t;
 typedef ISC_LIST(dns_dns64_t) dns_dns64list_t;
 typedef struct dns_dnsseckey dns_dnsseckey_t;
 typedef ISC_LIST(dns_dnsseckey_t) dns_dnsseckeylist_t;
+typedef struct dns_dnsseckeycache dns_dnsseckeycache_t;
 typedef uint8_t			   dns_dsdigest_t;
 typedef struct dns_dtdata	   dns_dtdata_t;
 typedef struct dns_dtenv	   dns_dtenv_t;
 typedef struct dns_dtmsg	   dns_dtmsg_t;
 typedef uint16_t		   dns_dtmsgtype_t;
 typedef struct dns_dumpctx	   dns_dumpctx_t;
+typedef struct dns_dumpfilter	   dns_dumpfilter_t;
 typedef struct dns_ecs		   dns_ecs_t;
 typedef struct dns_ednsopt	   dns_ednsopt_t;
 typedef struct dns_fetch	   dns_fetch_t;
@@ -141,16 +143,20 @@ typedef struct dns_rdataset	  dns_rdataset_t;
 typedef ISC_LIST(dns_rdataset_t) dns_rdatasetlist_t;
 typedef struct dns_rdatasetiter dns_rdatasetiter_t;
 typedef uint16_t		dns_rdatatype_t;
+typedef struct dns_refresh	dns_refresh_t;
 typedef struct dns_remote	dns_remote_t;
 typedef struct dns_request	dns_request_t;
 typedef struct dns_requestmgr	dns_requestmgr_t;
 typedef struct dns_resolver	dns_resolver_t;
+typedef struct dns_respcache	dns_respcache_t;
 typedef struct dns_qpnode	dns_qpnode_t;
 typedef uint8_t			dns_secalg_t;
 typedef uint8_t			dns_secproto_t;
+typedef struct dns_sigcache	dns_sigcache_t;
 typedef struct dns_signature	dns_signature_t;
 typedef struct dns_skr		dns_skr_t;
 typedef struct dns_slabheader	dns_slabheader_t;
+typedef struct dns_slabstore	dns_slabstore_t;
 typedef ISC_LIST(dns_slabheader_t) dns_slabheaderlist_t;
 typedef struct dns_sortlist_arg	  dns_sortlist_arg_t;
 typedef struct dns_ssurule	  dns_ssurule_t;
@@ -169,8 +175,10 @@ typedef struct dns_update_state	  dns_update_state_t;
 typedef struct dns_validator	  dns_validator_t;
 typedef struct dns_view		  dns_view_t;
 typedef ISC_LIST(dns_view_t) dns_viewlist_t;
-typedef struct dns_zone dns_zone_t;
+typedef struct dns_viewselect dns_viewselect_t;
+typedef struct dns_zone	      dns_zone_t;
 typedef ISC_LIST(dns_zone_t) dns_zonelist_t;
+typedef struct dns_zonecounters dns_zonecounters_t;
 typedef struct dns_zonemgr   dns_zonemgr_t;
 typedef struct dns_zt	     dns_zt_t;
 typedef struct dns_ipkeylist dns_ipkeylist_t;
@@ -239,6 +247,11 @@ typedef enum {
 	dns_expire_flush = 2,
 } dns_expire_t;
 
+typedef enum {
+	dns_cacheeviction_lru = 0,
+	dns_cacheeviction_sieve = 1,
+} dns_cacheeviction_t;
+
 /*
  * These are generated by gen.c.
  */
@@ -57,6 +57,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <isc/atomic.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
@@ -71,6 +72,7 @@
 #include <dns/dnstap.h>
 #include <dns/fixedname.h>
 #include <dns/nta.h>
+#include <dns/qp.h>
 #include <dns/rdatastruct.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
@@ -142,6 +144,7 @@ struct dns_view {
 	dns_acl_t	     *proxyacl;
 	dns_acl_t	     *proxyonacl;
 	bool		      msgcompression;
+	bool		      answerqnamecase;
 	dns_nametree_t	     *answeracl_exclude;
 	dns_nametree_t	     *denyanswernames;
 	dns_nametree_t	     *answernames_exclude;
@@ -159,6 +162,7 @@ struct dns_view {
 	char		     *nta_file;
 	dns_ttl_t	      prefetch_trigger;
 	dns_ttl_t	      prefetch_eligible;
+	dns_refresh_t	     *refresh;
 	in_port_t	      dstport;
 	dns_aclenv_t	     *aclenv;
 	dns_rdatatype_t	      preferred_glue;
@@ -182,10 +186,17 @@ struct dns_view {
 	dns_dlzdblist_t	      dlz_unsearched;
 	uint32_t	      fail_ttl;
 	dns_badcache_t	     *failcache;
+	dns_badcache_t	     *outagecache;
+	atomic_uint_least32_t outageuntil;
+	dns_respcache_t	     *respcache;
+	dns_respcache_t	     *respshare;
 	unsigned int	      udpsize;
 	uint32_t	      maxrrperset;
 	uint32_t	      maxtypepername;
 	uint8_t		      max_restarts;
+	bool		      sharedzonetrie;
+	dns_slabstore_t	     *slabstore; /* records shared by the zones */
+	dns_qpmulti_t	     *zonetrie;  /* names of the compact zones */
 
 	/*
 	 * Configurable data for server use only,
@@ -226,6 +237,13 @@ struct dns_view {
 	void (*cfg_destroy)(void **);
 	isc_mutex_t new_zone_lock;
 
+	/*
+	 * Hash of the configuration that the zones in this view inherit
+	 * from the view and the global options (only used in BIND9);
+	 * zero if not known.
+	 */
+	uint64_t zone_confighash;
+
 	unsigned char secret[32]; /* Client secret */
 	unsigned int  v6bias;
 
@@ -240,6 +258,10 @@ struct dns_view {
 	/* Hook table */
 	void *hooktable; /* ns_hooktable */
 	void (*hooktable_free)(isc_mem_t *, void **);
+
+	/* Compiled sortlist */
+	void *sortlistindex; /* ns_sortlistindex */
+	void (*sortlistindex_free)(isc_mem_t *, void **);
 };
 
 #define DNS_VIEW_MAGIC	     ISC_MAGIC('V', 'i', 'e', 'w')
@@ -1014,6 +1036,18 @@ dns_view_issecuredomain(dns_view_t *view, const dns_name_t *name,
  *\li	Any other value indicates failure
  */
 
+uint64_t
+dns_view_trustgeneration(dns_view_t *view);
+/*%<
+ * Return a number that changes whenever the answer of
+ * dns_view_issecuredomain() may change, other than by the passing of
+ * time: as long as it stays the same, an answer obtained for a name at
+ * the same 'now' can be reused.
+ *
+ * Requires:
+ * \li	'view' is valid.
+ */
+
 bool
 dns_view_ntacovers(dns_view_t *view, isc_stdtime_t now, const dns_name_t *name,
 		   const dns_name_t *anchor);
@@ -1187,6 +1221,49 @@ dns_view_staleanswerenabled(dns_view_t *view);
  *\li	'view' to be valid.
  */
 
+void
+dns_view_setoutage(dns_view_t *view, const dns_name_t *name,
+		   isc_stdtime_t now);
+/*%<
+ * Record that a fetch for 'name' timed out, and put the deepest zone cut
+ * known in the cache that encloses 'name' into an outage state for the
+ * 'stale-refresh-time' interval.  While the outage lasts, stale answers
+ * for any name below the cut may be used immediately, without attempting
+ * to refresh them.
+ *
+ * Does nothing if 'stale-refresh-time' is zero or no zone cut is known.
+ *
+ * Requires:
+ *\li	'view' to be valid.
+ *\li	'name' to be a valid absolute name.
+ */
+
+bool
+dns_view_inoutage(dns_view_t *view, const dns_name_t *name, isc_stdtime_t now,
+		  dns_name_t *cutname);
+/*%<
+ * Return true if 'name' is at or below a zone cut that is in an outage
+ * state at 'now'.  If 'cutname' is not NULL, the name of that zone cut is
+ * copied into it.
+ *
+ * Requires:
+ *\li	'view' to be valid.
+ *\li	'name' to be a valid absolute name.
+ *\li	'cutname' to be NULL or a valid name with a dedicated buffer.
+ */
+
+void
+dns_view_clearoutage(dns_view_t *view, const dns_name_t *name,
+		     isc_stdtime_t now);
+/*%<
+ * Record that a fetch for 'name' succeeded, ending the outage of the zone
+ * cut that encloses it, if there is one.
+ *
+ * Requires:
+ *\li	'view' to be valid.
+ *\li	'name' to be a valid absolute name.
+ */
+
 void
 dns_view_flushonshutdown(dns_view_t *view, bool flush);
 /*%<
@@ -1311,6 +1388,18 @@ dns_view_apply(dns_view_t *view, bool stop, isc_result_t *sub,
  * \li ISC_R_SHUTTINGDOWN if the view is in the process of shutting down.
  */
 
+isc_result_t
+dns_view_applyfrom(dns_view_t *view, const dns_name_t *after, bool stop,
+		   isc_result_t *sub,
+		   isc_result_t (*action)(dns_zone_t *, void *), void *uap);
+/*%<
+ * Call dns_zt_applyfrom on the view's zonetable, skipping the zones
+ * that sort before or equal to 'after' if it is not NULL.
+ *
+ * Returns:
+ * \li	As for dns_view_apply().
+ */
+
 void
 dns_view_getadb(dns_view_t *view, dns_adb_t **adbp);
 /*%<
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file
+ * \brief
+ * The view selector narrows down the views that can match a request
+ * before they are tried one by one.
+ *
+ * When the view list is configured, the match-clients and
+ * match-destinations ACLs of all the views are compiled into two radix
+ * trees, one for the client and one for the destination address.  Each
+ * prefix in a tree carries a bitset of the views whose ACL allows the
+ * addresses that prefix is the longest match for, so a single search
+ * per address gives the views that can possibly match.
+ *
+ * ACLs that match more than addresses (keys, GeoIP, "localhost",
+ * "localnets", nested ACLs that could not be merged) can't be compiled;
+ * their views are always candidates, and the view list is still walked
+ * in order, so the view that gets selected is the same as without the
+ * selector.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <isc/lang.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/refcount.h>
+
+#include <dns/types.h>
+
+/* Add -DDNS_VIEWSELECT_TRACE=1 to CFLAGS for detailed reference tracing */
+
+typedef struct dns_viewselect_match {
+	unsigned int	nviews;
+	const uint64_t *clients;
+	const uint64_t *destinations;
+} dns_viewselect_match_t;
+/*%<
+ * The candidate views for one request, as bitsets indexed by the
+ * position of the view in the view list.
+ */
+
+ISC_LANG_BEGINDECLS
+
+void
+dns_viewselect_create(isc_mem_t *mctx, dns_viewlist_t *viewlist,
+		      dns_viewselect_t **vselp);
+/*%<
+ * Compile the match-clients and match-destinations ACLs of the views
+ * in 'viewlist'.  The selector does not keep references to the views
+ * and must be rebuilt whenever the view list changes.
+ *
+ * Requires:
+ *
+ *\li	'mctx' is a valid memory context.
+ *\li	'viewlist' is a valid view list.
+ *\li	vselp != NULL && *vselp == NULL
+ */
+
+void
+dns_viewselect_lookup(dns_viewselect_t *vsel, const isc_netaddr_t *srcaddr,
+		      const isc_netaddr_t *destaddr, dns_aclenv_t *env,
+		      dns_viewselect_match_t *match);
+/*%<
+ * Look up the views that can match a request from 'srcaddr' to
+ * 'destaddr', and store them in 'match'.  The result stays valid as
+ * long as the reference to 'vsel' is held.
+ *
+ * Requires:
+ *
+ *\li	'vsel' is a valid view selector.
+ *\li	'srcaddr', 'destaddr' and 'match' are not NULL.
+ */
+
+bool
+dns_viewselect_candidate(const dns_viewselect_match_t *match,
+			 unsigned int index);
+/*%<
+ * Return true if the view at position 'index' of the view list may
+ * match the request 'match' was looked up for, and false if its ACLs
+ * are known to reject it.  Views past the end of the list the selector
+ * was built for are always candidates.
+ */
+
+#if DNS_VIEWSELECT_TRACE
+#define dns_viewselect_ref(ptr) \
+	dns_viewselect__ref(ptr, __func__, __FILE__, __LINE__)
+#define dns_viewselect_unref(ptr) \
+	dns_viewselect__unref(ptr, __func__, __FILE__, __LINE__)
+#define dns_viewselect_attach(ptr, ptrp) \
+	dns_viewselect__attach(ptr, ptrp, __func__, __FILE__, __LINE__)
+#define dns_viewselect_detach(ptrp) \
+	dns_viewselect__detach(ptrp, __func__, __FILE__, __LINE__)
+ISC_REFCOUNT_TRACE_DECL(dns_viewselect);
+#else
+ISC_REFCOUNT_DECL(dns_viewselect);
+#endif
+/*%
+ * Reference counting for dns_viewselect
+ */
+
+ISC_LANG_ENDDECLS
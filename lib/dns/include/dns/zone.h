@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include <isc/formatcheck.h>
+#include <isc/histo.h>
 #include <isc/lang.h>
 #include <isc/rwlock.h>
 #include <isc/tls.h>
@@ -64,7 +65,8 @@ typedef enum {
 typedef enum {
 	dns_zonestat_none = 0,
 	dns_zonestat_terse,
-	dns_zonestat_full
+	dns_zonestat_full,
+	dns_zonestat_compact
 } dns_zonestat_level_t;
 
 typedef enum {
@@ -103,6 +105,9 @@ typedef enum {
 	DNS_ZONEOPT_CHECKTTL = 1 << 28,	      /*%< check max-zone-ttl */
 	DNS_ZONEOPT_AUTOEMPTY = 1 << 29,      /*%< automatic empty zone */
 	DNS_ZONEOPT_CHECKSVCB = 1 << 30,      /*%< check SVBC records */
+	DNS_ZONEOPT_JOURNALGROUP = 1ULL << 31, /*%< journal-group-commit */
+	DNS_ZONEOPT_LOADONDEMAND = 1ULL << 32, /*%< load-on-demand */
+	DNS_ZONEOPT_SIGCACHE = 1ULL << 33,     /*%< sig-cache */
 	DNS_ZONEOPT___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneopt_t;
 
@@ -129,6 +134,19 @@ typedef enum {
 	DNS_ZONESTATE_AUTOMATIC,
 } dns_zonestate_t;
 
+/*
+ * Zone maintenance jobs with a run time histogram, in microseconds.
+ */
+typedef enum {
+	dns_zonejob_sign = 0,	    /*%< signing with new keys */
+	dns_zonejob_resign = 1,	    /*%< re-signing expiring signatures */
+	dns_zonejob_nsec3chain = 2, /*%< building NSEC/NSEC3 chains */
+
+	dns_zonejob_max = 3,
+} dns_zonejob_t;
+
+#define DNS_ZONEJOB_SIGBITS 3
+
 #ifndef DNS_ZONE_MINREFRESH
 #define DNS_ZONE_MINREFRESH 300 /*%< 5 minutes */
 #endif				/* ifndef DNS_ZONE_MINREFRESH */
@@ -150,6 +168,19 @@ typedef enum {
 	    * exponential backoff */
 #endif	   /* ifndef DNS_ZONE_DEFAULTRETRY */
 
+/*%
+ * Maximum number of zone files each loop loads at the same time; further
+ * loads wait in the loop's queue.  This bounds the number of open files
+ * and partially loaded databases when many zones are loaded at once,
+ * while still keeping the offload threadpool (one thread per loop) busy.
+ */
+#define DNS_ZONEMGR_LOADS_PER_LOOP 4
+
+/*%
+ * Called by dns_zone_writejournal() when a journal group is synced.
+ */
+typedef void (*dns_zone_journalcb_t)(isc_result_t result, void *arg);
+
 ISC_LANG_BEGINDECLS
 
 /***
@@ -1332,6 +1363,33 @@ dns_zone_getjournal(dns_zone_t *zone);
  *\li	'zone' to be valid initialised zone.
  */
 
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff,
+		      dns_zone_journalcb_t cb, void *arg);
+/*%<
+ * Write the transaction in 'diff' to the journal of 'zone', if it
+ * has one.
+ *
+ * If the DNS_ZONEOPT_JOURNALGROUP option is set, the transaction is
+ * added to a group of transactions that are synced to disk together
+ * once everything that is currently queued on the zone's loop has
+ * run, or earlier if something else needs the journal file.  'cb' is
+ * then called with the result of the sync.
+ * The transaction is not durable, and should not be acknowledged,
+ * until then.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'cb' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the transaction is durable; 'cb' will not
+ *				be called
+ *\li	#DNS_R_CONTINUE		'cb' will be called
+ *\li	Others			the transaction could not be written;
+ *				'cb' will not be called
+ */
+
 dns_zonetype_t
 dns_zone_gettype(dns_zone_t *zone);
 /*%<
@@ -1753,6 +1811,19 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep);
  *\li	'zonep' != NULL and '*zonep' == NULL.
  */
 
+void
+dns_zonemgr_setmaintloops(dns_zonemgr_t *zmgr, uint32_t nloops);
+/*%<
+ *	Place the zones created from now on on the last 'nloops' loops
+ *	only, so that their timers, loads, transfers in and NOTIFY
+ *	processing run apart from the other loops.  Zero, the default,
+ *	spreads the zones over all the loops.
+ *
+ * Require:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'nloops' to be no more than the number of loops.
+ */
+
 isc_result_t
 dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone);
 /*%<
@@ -1866,7 +1937,10 @@ dns_zonemgr_setcheckdsrate(dns_zonemgr_t *zmgr, unsigned int value);
 void
 dns_zonemgr_setnotifyrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
- *	Set the number of NOTIFY requests sent per second.
+ *	Set the number of NOTIFY requests sent per second to each
+ *	destination.  The rate for a destination grows while it keeps
+ *	answering, up to 16 times 'value', and is halved whenever a
+ *	NOTIFY request to it times out.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager
@@ -1884,7 +1958,9 @@ dns_zonemgr_setstartupnotifyrate(dns_zonemgr_t *zmgr, unsigned int value);
 void
 dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
- *	Set the number of SOA queries sent per second.
+ *	Set the number of SOA queries sent per second to each primary.
+ *	The rate for a primary grows while it keeps answering, up to 16
+ *	times 'value', and is halved whenever an SOA query to it times out.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager
@@ -1893,7 +1969,8 @@ dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
 unsigned int
 dns_zonemgr_getnotifyrate(dns_zonemgr_t *zmgr);
 /*%<
- *	Return the number of NOTIFY requests sent per second.
+ *	Return the initial number of NOTIFY requests sent per second to
+ *	each destination.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager.
@@ -1908,10 +1985,56 @@ dns_zonemgr_getstartupnotifyrate(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+void
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr, uint64_t *pendingp,
+			    uint64_t *loadingp, uint64_t *loadedp,
+			    uint32_t *etap);
+/*%<
+ *	Return the progress of zone file loading: the number of zones
+ *	that are queued for loading or being loaded, the number being
+ *	loaded right now (at most #DNS_ZONEMGR_LOADS_PER_LOOP per loop),
+ *	the number loaded since loading last started from an idle state,
+ *	and the estimated number of seconds until the pending loads
+ *	complete (0 if there is no estimate yet).
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'pendingp', 'loadingp', 'loadedp' and 'etap' to be non NULL.
+ */
+
+void
+dns_zonemgr_getnotifyqueue(dns_zonemgr_t *zmgr, unsigned int *queuedp,
+			   unsigned int *destsp, uint32_t *oldestp);
+/*%<
+ *	Return the number of NOTIFY requests waiting to be sent, the
+ *	number of destinations NOTIFY requests have been paced for, and
+ *	the number of seconds the oldest waiting request has been queued
+ *	(0 if there is none).
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'queuedp', 'destsp' and 'oldestp' to be non NULL.
+ */
+
+isc_histomulti_t *
+dns_zonemgr_jobtime(dns_zonemgr_t *zmgr, dns_zonejob_t job);
+/*%<
+ *	Return the histogram of the time, in microseconds, that each run of
+ *	the zone maintenance job 'job' took.  Long jobs stop early when
+ *	isc_loop_shouldyield() says so and continue in a later run.  A
+ *	dns_zonejob_sign run whose signatures are computed on the offload
+ *	threads is timed until its records have been committed.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'job' < dns_zonejob_max.
+ */
+
 unsigned int
 dns_zonemgr_getserialqueryrate(dns_zonemgr_t *zmgr);
 /*%<
- *	Return the number of SOA queries sent per second.
+ *	Return the initial number of SOA queries sent per second to each
+ *	primary.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager.
@@ -2095,6 +2218,34 @@ dns_zone_getdnssecsignstats(dns_zone_t *zone);
  *	otherwise NULL.
  */
 
+isc_result_t
+dns_zone_setcounters(dns_zone_t *zone, dns_zonecounters_t *counters);
+/*%<
+ * Count the responses for 'zone' in a slot of the compact zone counters
+ * 'counters', or stop counting them if 'counters' is NULL.  Like the
+ * statistics sets above, the counters are not counted in the zone
+ * module.  The slot is kept, and counting resumes in it, if counters
+ * are installed again; they cannot be replaced by a different set.
+ *
+ * Requires:
+ * \li	'zone' to be a valid zone.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOSPACE		no slot is available in 'counters'
+ */
+
+dns_zonecounters_t *
+dns_zone_getcounters(dns_zone_t *zone, uint32_t *slotp);
+/*%<
+ * Return the compact zone counters installed in 'zone' and store the
+ * zone's slot in '*slotp', or return NULL if there are none.
+ *
+ * Requires:
+ * \li	'zone' to be a valid zone.
+ * \li	slotp != NULL
+ */
+
 void
 dns_zone_logv(dns_zone_t *zone, isc_logcategory_t category, int level,
 	      const char *prefix, const char *msg, va_list ap);
@@ -2327,6 +2478,26 @@ dns_zone_getadded(dns_zone_t *zone);
  * \li	'zone' to be valid.
  */
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, uint64_t hash);
+/*%
+ * Sets the hash of the configuration the zone has been configured
+ * with, so that reconfiguring the zone can be skipped while the hash
+ * stays the same.  Zero means that the hash is not known.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
+uint64_t
+dns_zone_getconfighash(dns_zone_t *zone);
+/*%
+ * Returns the hash set by dns_zone_setconfighash(), or zero.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
 void
 dns_zone_setautomatic(dns_zone_t *zone, bool automatic);
 /*%
@@ -2684,6 +2855,18 @@ dns_zone_isloaded(dns_zone_t *zone);
  * false otherwise.
  */
 
+void
+dns_zone_demand(dns_zone_t *zone);
+/*%<
+ * Note that 'zone' is being queried.  If the DNS_ZONEOPT_LOADONDEMAND
+ * option is set, this postpones unloading the zone when idle, and
+ * starts loading it asynchronously if it is not loaded.  Otherwise
+ * this does nothing.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ */
+
 isc_result_t
 dns_zone_verifydb(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver);
 /*%<
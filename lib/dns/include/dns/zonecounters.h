@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/zonecounters.h
+ * \brief
+ * Defines dns_zonecounters_t, a compact set of per-zone query counters
+ * for "zone-statistics compact".
+ *
+ * Notes:
+ *\li	Each zone using the counters is given a slot, which holds a small
+ *	fixed set of counters (see dns_zonecounter_*) instead of a full
+ *	set of statistics counters of its own.
+ *
+ *\li	The counters are kept in one shard per loop, plus a shared shard
+ *	used by all the other threads.  Each loop is the only writer of
+ *	its own shard, so it updates its counters with a plain load and
+ *	store; the values reported are the sums over all the shards.
+ *
+ *\li	The counters of a shard are allocated in chunks of
+ *	#DNS_ZONECOUNTERS_CHUNKSIZE slots, the first time one of those
+ *	slots is counted on that loop, so zones that receive no queries
+ *	cost next to nothing.
+ *
+ * Resources:
+ *\li	At most #DNS_ZONECOUNTERS_MAXSLOTS slots.  Each chunk holds
+ *	dns_zonecounter_max 64-bit counters per slot, i.e. one cache line.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/time.h>
+
+#include <dns/types.h>
+
+/*%
+ * Counters kept for each zone.  The latency counters count the
+ * responses by the time from receiving the request to sending the
+ * response.
+ */
+enum {
+	dns_zonecounter_queries = 0,  /*%< responses sent */
+	dns_zonecounter_nxdomain = 1, /*%< ... with rcode NXDOMAIN */
+	dns_zonecounter_bytesout = 2, /*%< octets sent */
+	dns_zonecounter_latency0 = 3, /*%< less than 100 microseconds */
+	dns_zonecounter_latency1 = 4, /*%< less than 1 millisecond */
+	dns_zonecounter_latency2 = 5, /*%< less than 10 milliseconds */
+	dns_zonecounter_latency3 = 6, /*%< less than 100 milliseconds */
+	dns_zonecounter_latency4 = 7, /*%< 100 milliseconds or more */
+
+	dns_zonecounter_max = 8,
+};
+
+#define DNS_ZONECOUNTERS_CHUNKSIZE 1024
+#define DNS_ZONECOUNTERS_CHUNKS	   4096
+#define DNS_ZONECOUNTERS_MAXSLOTS \
+	(DNS_ZONECOUNTERS_CHUNKSIZE * DNS_ZONECOUNTERS_CHUNKS)
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_zonecounters_create(isc_mem_t *mctx, dns_zonecounters_t **zcp);
+/*%
+ * Create a set of compact zone counters, with one shard for each loop
+ * of the loop manager that is running, and store it in '*zcp'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	zcp != NULL && *zcp == NULL
+ */
+
+isc_result_t
+dns_zonecounters_alloc(dns_zonecounters_t *zc, uint32_t *slotp);
+/*%
+ * Allocate a slot with all its counters set to zero and store it in
+ * '*slotp'.
+ *
+ * Requires:
+ * \li	'zc' to be valid
+ * \li	slotp != NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOSPACE		all #DNS_ZONECOUNTERS_MAXSLOTS slots are in use
+ */
+
+void
+dns_zonecounters_release(dns_zonecounters_t *zc, uint32_t slot);
+/*%
+ * Release 'slot' for reuse.  The caller must not count anything in it
+ * afterwards.
+ *
+ * Requires:
+ * \li	'zc' to be valid
+ * \li	'slot' to have been allocated by dns_zonecounters_alloc()
+ */
+
+void
+dns_zonecounters_response(dns_zonecounters_t *zc, uint32_t slot,
+			  dns_rcode_t rcode, size_t length,
+			  isc_nanosecs_t latency);
+/*%
+ * Count a response with rcode 'rcode' and 'length' octets, sent
+ * 'latency' nanoseconds after the request was received, in 'slot'.
+ *
+ * Requires:
+ * \li	'zc' to be valid
+ * \li	slot < #DNS_ZONECOUNTERS_MAXSLOTS
+ */
+
+void
+dns_zonecounters_get(dns_zonecounters_t *zc, uint32_t slot,
+		     uint64_t values[dns_zonecounter_max]);
+/*%
+ * Store the current values of the counters of 'slot', summed over all
+ * the shards, in 'values'.
+ *
+ * Requires:
+ * \li	'zc' to be valid
+ * \li	slot < #DNS_ZONECOUNTERS_MAXSLOTS
+ * \li	values != NULL
+ */
+
+ISC_REFCOUNT_DECL(dns_zonecounters);
+
+ISC_LANG_ENDDECLS
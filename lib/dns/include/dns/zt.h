@@ -108,6 +108,20 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
  * \li	#ISC_R_NOTFOUND
  */
 
+isc_result_t
+dns_zt_lookup(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
+	      dns_zone_t **zone);
+/*%<
+ * Like dns_zt_find(), but '*zone' is not attached: it remains valid
+ * only until the caller leaves the RCU read-side critical section it
+ * called dns_zt_lookup() from.  This avoids touching the zone's
+ * reference count on lookups that do not need to keep the zone.
+ *
+ * Requires:
+ * \li	the caller to hold rcu_read_lock()
+ * \li	as for dns_zt_find()
+ */
+
 void
 dns_zt_detach(dns_zt_t **ztp);
 /*%<
@@ -186,6 +200,26 @@ dns_zt_apply(dns_zt_t *zt, bool stop, isc_result_t *sub,
  *	the first error code from 'action' is returned.
  */
 
+isc_result_t
+dns_zt_applyfrom(dns_zt_t *zt, const dns_name_t *after, bool stop,
+		 isc_result_t *sub,
+		 isc_result_t (*action)(dns_zone_t *, void *), void *uap);
+/*%<
+ * Like dns_zt_apply(), but if 'after' is not NULL, skip the zones
+ * whose names sort before or equal to 'after' in DNSSEC order.  This
+ * allows a caller to walk a large zone table in several steps by
+ * passing the name of the last zone it processed.  'after' does not
+ * need to be the name of a zone in the table.
+ *
+ * Requires:
+ * \li	'zt' to be valid.
+ * \li	'after' to be NULL or an absolute name.
+ * \li	'action' to be non NULL.
+ *
+ * Returns:
+ * \li	As for dns_zt_apply().
+ */
+
 bool
 dns_zt_loadspending(dns_zt_t *zt);
 /*%<
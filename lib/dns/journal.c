@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/log.h>
@@ -321,6 +324,8 @@ struct dns_journal {
 				      *   mode is allowed */
 	bool recovered;		     /*%< A recoverable error was found
 				      *   while reading the journal */
+	bool group;		     /*%< Sync commits in dns_journal_sync() */
+	bool unsynced;		     /*%< Commits waiting to be synced */
 	char *filename;		     /*%< Journal file name */
 	FILE *fp;		     /*%< File handle */
 	off_t offset;		     /*%< Current file offset */
@@ -329,6 +334,12 @@ struct dns_journal {
 	unsigned char *rawindex;     /*%< In-core buffer for journal index
 				      * in on-disk format */
 	journal_pos_t *index;	     /*%< In-core journal index */
+	unsigned char *map;	     /*%< Read-only mapping of the file */
+	size_t mapsize;		     /*%< Size of the mapping */
+	journal_pos_t *xindex;	     /*%< Consecutive transactions seen
+				      *   so far (read-only journals) */
+	unsigned int xindex_count;   /*%< Used entries in 'xindex' */
+	unsigned int xindex_size;    /*%< Allocated entries in 'xindex' */
 
 	/*% Current transaction state (when writing). */
 	struct {
@@ -404,11 +415,20 @@ journal_header_encode(journal_header_t *cooked, journal_rawheader_t *raw) {
 
 /*
  * Journal file I/O subroutines, with error checking and reporting.
+ *
+ * Journals opened for reading only are mapped into memory when
+ * possible, so that seeking and reading, which IXFR does once per
+ * transaction and once per RR, do not need a system call each.
  */
 static isc_result_t
 journal_seek(dns_journal_t *j, uint32_t offset) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		j->offset = offset;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_seek(j->fp, (off_t)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
@@ -420,10 +440,38 @@ journal_seek(dns_journal_t *j, uint32_t offset) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return a pointer to the next 'nbytes' of the mapped journal file
+ * in '*memp' and advance the file offset past them.
+ */
+static isc_result_t
+journal_peek(dns_journal_t *j, size_t nbytes, unsigned char **memp) {
+	REQUIRE(j->map != NULL);
+
+	if (j->offset < 0 || (size_t)j->offset > j->mapsize ||
+	    nbytes > j->mapsize - (size_t)j->offset)
+	{
+		return (ISC_R_NOMORE);
+	}
+	*memp = j->map + j->offset;
+	j->offset += (off_t)nbytes;
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		unsigned char *p = NULL;
+
+		result = journal_peek(j, nbytes, &p);
+		if (result == ISC_R_SUCCESS) {
+			memmove(mem, p, nbytes);
+		}
+		return (result);
+	}
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF) {
@@ -611,6 +659,37 @@ journal_file_create(isc_mem_t *mctx, bool downgrade, const char *filename) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map the journal 'j' into memory.  The file is only ever appended to
+ * or replaced by renaming a new file over it, so the part of it that
+ * the in-core header describes stays valid for the lifetime of the
+ * mapping.  If the file cannot be mapped, it is read with stdio.
+ */
+static void
+journal_map(dns_journal_t *j) {
+	struct stat sb;
+	void *map = NULL;
+
+	if (fstat(fileno(j->fp), &sb) != 0 || sb.st_size <= 0 ||
+	    (uintmax_t)sb.st_size > SIZE_MAX ||
+	    (uintmax_t)sb.st_size < j->header.end.offset)
+	{
+		return;
+	}
+
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE,
+		   fileno(j->fp), 0);
+	if (map == MAP_FAILED) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_DEBUG(1), "%s: mmap: %s", j->filename,
+			      strerror(errno));
+		return;
+	}
+
+	j->map = map;
+	j->mapsize = (size_t)sb.st_size;
+}
+
 static isc_result_t
 journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 	     bool downgrade, dns_journal_t **journalp) {
@@ -736,6 +815,9 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 	j->it.dctx = DNS_DECOMPRESS_NEVER;
 
 	j->state = writable ? JOURNAL_STATE_WRITE : JOURNAL_STATE_READ;
+	if (!writable) {
+		journal_map(j);
+	}
 
 	*journalp = j;
 	return (ISC_R_SUCCESS);
@@ -769,6 +851,8 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 	create = ((mode & DNS_JOURNAL_CREATE) != 0);
 	writable = ((mode & (DNS_JOURNAL_WRITE | DNS_JOURNAL_CREATE)) != 0);
 
+	REQUIRE((mode & DNS_JOURNAL_GROUP) == 0 || writable);
+
 	result = journal_open(mctx, filename, writable, create, false,
 			      journalp);
 	if (result == ISC_R_NOTFOUND) {
@@ -786,6 +870,9 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 		result = journal_open(mctx, backup, writable, writable, false,
 				      journalp);
 	}
+	if (result == ISC_R_SUCCESS) {
+		(*journalp)->group = ((mode & DNS_JOURNAL_GROUP) != 0);
+	}
 	return (result);
 }
 
@@ -1094,6 +1181,60 @@ index_invalidate(dns_journal_t *j, uint32_t serial) {
 	}
 }
 
+/*
+ * Read-only journals cannot change under us, so every transaction
+ * visited while searching is remembered in 'j->xindex', which always
+ * holds a run of consecutive transactions in journal order.  Use it
+ * to improve '*best_guess' with a binary search.
+ *
+ * Returns true if '*best_guess' is the last transaction in the run,
+ * so that the transactions found by walking forward from it can be
+ * appended to the run.
+ */
+static bool
+xindex_find(dns_journal_t *j, uint32_t serial, journal_pos_t *best_guess) {
+	unsigned int lo = 0, hi;
+
+	if (j->state != JOURNAL_STATE_READ) {
+		return (false);
+	}
+	if (j->xindex_count == 0) {
+		return (true);
+	}
+	if (DNS_SERIAL_GT(j->xindex[0].serial, serial)) {
+		return (false);
+	}
+
+	/* Find the last entry not greater than 'serial'. */
+	hi = j->xindex_count;
+	while (hi - lo > 1) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (DNS_SERIAL_GT(j->xindex[mid].serial, serial)) {
+			hi = mid;
+		} else {
+			lo = mid;
+		}
+	}
+
+	if (DNS_SERIAL_GE(j->xindex[lo].serial, best_guess->serial)) {
+		*best_guess = j->xindex[lo];
+		return (lo == j->xindex_count - 1);
+	}
+	return (false);
+}
+
+static void
+xindex_add(dns_journal_t *j, journal_pos_t *pos) {
+	if (j->xindex_count == j->xindex_size) {
+		unsigned int newsize = ISC_MAX(2 * j->xindex_size, 64);
+
+		j->xindex = isc_mem_creget(j->mctx, j->xindex, j->xindex_size,
+					   newsize, sizeof(journal_pos_t));
+		j->xindex_size = newsize;
+	}
+	j->xindex[j->xindex_count++] = *pos;
+}
+
 /*
  * Try to find a transaction with initial serial number 'serial'
  * in the journal 'j'.
@@ -1117,6 +1258,7 @@ static isc_result_t
 journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 	isc_result_t result;
 	journal_pos_t current_pos;
+	bool record;
 
 	REQUIRE(DNS_JOURNAL_VALID(j));
 
@@ -1133,6 +1275,10 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
+	record = xindex_find(j, serial, &current_pos);
+	if (record && j->xindex_count == 0) {
+		xindex_add(j, &current_pos);
+	}
 
 	while (current_pos.serial != serial) {
 		if (DNS_SERIAL_GT(current_pos.serial, serial)) {
@@ -1142,6 +1288,9 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 		if (result != ISC_R_SUCCESS) {
 			return (result);
 		}
+		if (record) {
+			xindex_add(j, &current_pos);
+		}
 	}
 	*pos = current_pos;
 	return (ISC_R_SUCCESS);
@@ -1283,6 +1432,33 @@ failure:
 	return (result);
 }
 
+/*
+ * Write the in-core header and index of 'j' to the file and sync it.
+ */
+static isc_result_t
+journal_sync_header(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+
+	/*
+	 * Convert the index into on-disk format and write
+	 * it to disk.
+	 */
+	CHECK(index_to_disk(j));
+
+	/*
+	 * Commit the header to stable storage.
+	 */
+	CHECK(journal_fsync(j));
+
+failure:
+	return (result);
+}
+
 isc_result_t
 dns_journal_commit(dns_journal_t *j) {
 	isc_result_t result;
@@ -1371,9 +1547,12 @@ dns_journal_commit(dns_journal_t *j) {
 #endif /* ifdef notyet */
 
 	/*
-	 * Commit the transaction data to stable storage.
+	 * Commit the transaction data to stable storage.  In a group,
+	 * this is done for all of its transactions by dns_journal_sync().
 	 */
-	CHECK(journal_fsync(j));
+	if (!j->group) {
+		CHECK(journal_fsync(j));
+	}
 
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		off_t offset;
@@ -1396,9 +1575,6 @@ dns_journal_commit(dns_journal_t *j) {
 		j->header.begin = j->x.pos[0];
 	}
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
@@ -1406,15 +1582,16 @@ dns_journal_commit(dns_journal_t *j) {
 	index_add(j, &j->x.pos[0]);
 
 	/*
-	 * Convert the index into on-disk format and write
-	 * it to disk.
-	 */
-	CHECK(index_to_disk(j));
-
-	/*
-	 * Commit the header to stable storage.
+	 * Write out the updated header, unless that is deferred to
+	 * dns_journal_sync().  Until then, the header on disk still
+	 * ends before this transaction, so it is simply ignored if
+	 * we crash before the group is synced.
 	 */
-	CHECK(journal_fsync(j));
+	if (j->group) {
+		j->unsynced = true;
+	} else {
+		CHECK(journal_sync_header(j));
+	}
 
 	/*
 	 * We no longer have a transaction open.
@@ -1427,6 +1604,24 @@ failure:
 	return (result);
 }
 
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+
+	if (!j->unsynced) {
+		return (ISC_R_SUCCESS);
+	}
+
+	CHECK(journal_fsync(j));
+	CHECK(journal_sync_header(j));
+	j->unsynced = false;
+
+failure:
+	return (result);
+}
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff) {
 	isc_result_t result;
@@ -1450,6 +1645,10 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	j = *journalp;
 	*journalp = NULL;
 
+	if (j->unsynced) {
+		(void)dns_journal_sync(j);
+	}
+
 	j->it.result = ISC_R_FAILURE;
 	dns_name_invalidate(&j->it.name);
 	if (j->rawindex != NULL) {
@@ -1460,10 +1659,16 @@ dns_journal_destroy(dns_journal_t **journalp) {
 		isc_mem_cput(j->mctx, j->index, j->header.index_size,
 			     sizeof(journal_pos_t));
 	}
+	if (j->xindex != NULL) {
+		isc_mem_cput(j->mctx, j->xindex, j->xindex_size,
+			     sizeof(journal_pos_t));
+	}
 	if (j->it.target.base != NULL) {
 		isc_mem_put(j->mctx, j->it.target.base, j->it.target.length);
 	}
-	if (j->it.source.base != NULL) {
+	if (j->map != NULL) {
+		RUNTIME_CHECK(munmap(j->map, j->mapsize) == 0);
+	} else if (j->it.source.base != NULL) {
 		isc_mem_put(j->mctx, j->it.source.base, j->it.source.length);
 	}
 	if (j->filename != NULL) {
@@ -1632,9 +1837,56 @@ failure:
 	return (result);
 }
 
-isc_result_t
-dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
-		  FILE *file) {
+static isc_result_t
+journal_openread(isc_mem_t *mctx, const char *filename,
+		 dns_journal_t **journalp) {
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, journalp);
+	if (result == ISC_R_NOTFOUND) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_DEBUG(3), "no journal file");
+		return (DNS_R_NOJOURNAL);
+	} else if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "journal open failure: %s: %s",
+			      isc_result_totext(result), filename);
+	}
+	return (result);
+}
+
+/*
+ * Position the iterator of 'j' at 'begin_serial', using the journal
+ * index to skip the transactions before it, and fail with ISC_R_RANGE
+ * if either serial is not a transaction boundary in the journal.
+ */
+static isc_result_t
+journal_iter_range(dns_journal_t *j, uint32_t begin_serial,
+		   uint32_t end_serial) {
+	isc_result_t result;
+
+	if (isc_serial_gt(begin_serial, end_serial)) {
+		return (ISC_R_RANGE);
+	}
+	result = dns_journal_iter_init(j, begin_serial, end_serial, NULL);
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_RANGE;
+	}
+	if (result == ISC_R_RANGE) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR,
+			      "%s: serials %u to %u are not in the journal "
+			      "(%u to %u)",
+			      j->filename, begin_serial, end_serial,
+			      dns_journal_first_serial(j),
+			      dns_journal_last_serial(j));
+	}
+	return (result);
+}
+
+static isc_result_t
+journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
+	      bool range, uint32_t from, uint32_t to, FILE *file) {
 	dns_journal_t *j = NULL;
 	isc_buffer_t source;   /* Transaction data from disk */
 	isc_buffer_t target;   /* Ditto after _fromwire check */
@@ -1644,19 +1896,13 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 	dns_diff_t diff;
 	unsigned int n_soa = 0;
 	unsigned int n_put = 0;
+	uint32_t i = 0;
 	bool printxhdr = ((flags & DNS_JOURNAL_PRINTXHDR) != 0);
 
 	REQUIRE(filename != NULL);
 
-	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, &j);
-	if (result == ISC_R_NOTFOUND) {
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
-			      ISC_LOG_DEBUG(3), "no journal file");
-		return (DNS_R_NOJOURNAL);
-	} else if (result != ISC_R_SUCCESS) {
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
-			      ISC_LOG_ERROR, "journal open failure: %s: %s",
-			      isc_result_totext(result), filename);
+	result = journal_openread(mctx, filename, &j);
+	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
 
@@ -1688,10 +1934,27 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 	isc_buffer_init(&source, NULL, 0);
 	isc_buffer_init(&target, NULL, 0);
 
-	start_serial = dns_journal_first_serial(j);
-	end_serial = dns_journal_last_serial(j);
+	if (range) {
+		result = journal_iter_range(j, from, to);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	} else {
+		start_serial = dns_journal_first_serial(j);
+		end_serial = dns_journal_last_serial(j);
+		CHECK(dns_journal_iter_init(j, start_serial, end_serial, NULL));
+	}
 
-	CHECK(dns_journal_iter_init(j, start_serial, end_serial, NULL));
+	/*
+	 * Skip the index entries for the transactions before the
+	 * start of the range, so that the offset check below lines
+	 * up with the first transaction printed.
+	 */
+	while (i < j->header.index_size && j->index[i].offset != 0 &&
+	       j->index[i].offset < j->it.bpos.offset)
+	{
+		i++;
+	}
 
 	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
 	     result = dns_journal_next_rr(j))
@@ -1699,7 +1962,6 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		dns_name_t *name = NULL;
 		dns_rdata_t *rdata = NULL;
 		dns_difftuple_t *tuple = NULL;
-		static uint32_t i = 0;
 		bool print = false;
 		uint32_t ttl;
 
@@ -1730,13 +1992,19 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 				j->xhdr_version, (long long)j->it.cpos.offset,
 				j->curxhdr.size, j->curxhdr.count,
 				j->curxhdr.serial0, j->curxhdr.serial1);
-			if (j->it.cpos.offset > j->index[i].offset) {
-				fprintf(file,
-					"ERROR: Offset mismatch, "
-					"expected %lld\n",
-					(long long)j->index[i].offset);
-			} else if (j->it.cpos.offset == j->index[i].offset) {
-				i++;
+			if (i < j->header.index_size &&
+			    j->index[i].offset != 0)
+			{
+				if (j->it.cpos.offset > j->index[i].offset) {
+					fprintf(file,
+						"ERROR: Offset mismatch, "
+						"expected %lld\n",
+						(long long)j->index[i].offset);
+				} else if (j->it.cpos.offset ==
+					   j->index[i].offset)
+				{
+					i++;
+				}
 			}
 		}
 		dns_difftuple_create(
@@ -1783,6 +2051,119 @@ cleanup:
 	return (result);
 }
 
+isc_result_t
+dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		  FILE *file) {
+	return (journal_print(mctx, flags, filename, false, 0, 0, file));
+}
+
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin_serial, uint32_t end_serial,
+		       FILE *file) {
+	return (journal_print(mctx, flags, filename, true, begin_serial,
+			      end_serial, file));
+}
+
+isc_result_t
+dns_journal_extract(isc_mem_t *mctx, const char *filename,
+		    uint32_t begin_serial, uint32_t end_serial,
+		    const char *outfile) {
+	dns_journal_t *j = NULL;
+	dns_journal_t *out = NULL;
+	isc_result_t result;
+	dns_diff_t diff;
+	unsigned int n_soa = 0;
+
+	REQUIRE(filename != NULL);
+	REQUIRE(outfile != NULL);
+
+	if (isc_file_exists(outfile)) {
+		return (ISC_R_EXISTS);
+	}
+
+	result = journal_openread(mctx, filename, &j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	dns_diff_init(mctx, &diff);
+
+	result = journal_iter_range(j, begin_serial, end_serial);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	CHECK(dns_journal_open(mctx, outfile, DNS_JOURNAL_CREATE, &out));
+
+	/*
+	 * Copy the transactions one at a time: each one starts with
+	 * the deletion of the old SOA, the first SOA after an addition.
+	 */
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		dns_difftuple_t *tuple = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+
+		if (rdata->type == dns_rdatatype_soa) {
+			n_soa++;
+			if (n_soa == 3) {
+				n_soa = 1;
+			}
+			if (n_soa == 1 && !ISC_LIST_EMPTY(diff.tuples)) {
+				CHECK(dns_journal_write_transaction(out,
+								    &diff));
+				dns_diff_clear(&diff);
+			}
+		}
+		if (n_soa == 0) {
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_JOURNAL, ISC_LOG_ERROR,
+				      "%s: journal file corrupt: missing "
+				      "initial SOA",
+				      j->filename);
+			FAIL(ISC_R_UNEXPECTED);
+		}
+
+		dns_difftuple_create(
+			diff.mctx, n_soa == 1 ? DNS_DIFFOP_DEL : DNS_DIFFOP_ADD,
+			name, ttl, rdata, &tuple);
+		dns_diff_append(&diff, &tuple);
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+	CHECK(result);
+
+	if (!ISC_LIST_EMPTY(diff.tuples)) {
+		CHECK(dns_journal_write_transaction(out, &diff));
+	}
+
+failure:
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "%s: cannot extract to %s: %s",
+			      j->filename, outfile, isc_result_totext(result));
+	}
+
+cleanup:
+	dns_diff_clear(&diff);
+	if (out != NULL) {
+		dns_journal_destroy(&out);
+		if (result != ISC_R_SUCCESS) {
+			(void)isc_file_remove(outfile);
+		}
+	}
+	dns_journal_destroy(&j);
+
+	return (result);
+}
+
 /**************************************************************************/
 /*
  * Miscellaneous accessors.
@@ -2034,8 +2415,16 @@ read_one_rr(dns_journal_t *j) {
 		FAIL(ISC_R_UNEXPECTED);
 	}
 
-	CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
-	CHECK(journal_read(j, j->it.source.base, rrhdr.size));
+	if (j->map != NULL) {
+		unsigned char *p = NULL;
+
+		/* Parse the RR straight out of the mapped file. */
+		CHECK(journal_peek(j, rrhdr.size, &p));
+		isc_buffer_init(&j->it.source, p, rrhdr.size);
+	} else {
+		CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
+		CHECK(journal_read(j, j->it.source.base, rrhdr.size));
+	}
 	isc_buffer_add(&j->it.source, rrhdr.size);
 
 	/*
@@ -2473,55 +2862,125 @@ check_delta(unsigned char *buf, size_t size) {
 	return (true);
 }
 
+/*
+ * Copy 'len' bytes from the current position of 'src' to the current
+ * position of 'dst'.
+ */
+static isc_result_t
+journal_copy(isc_mem_t *mctx, dns_journal_t *src, dns_journal_t *dst,
+	     unsigned int len) {
+	unsigned char *buf = NULL;
+	unsigned int size;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (len == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (src->map != NULL) {
+		CHECK(journal_peek(src, len, &buf));
+		return (journal_write(dst, buf, len));
+	}
+
+	size = ISC_MIN(64 * 1024, len);
+	buf = isc_mem_get(mctx, size);
+	for (unsigned int i = 0; i < len; i += size) {
+		unsigned int blob = ISC_MIN(size, len - i);
+		CHECK(journal_read(src, buf, blob));
+		CHECK(journal_write(dst, buf, blob));
+	}
+
+failure:
+	if (buf != NULL && src->map == NULL) {
+		isc_mem_put(mctx, buf, size);
+	}
+	return (result);
+}
+
+/*
+ * State of a journal compaction; see dns_journal_compact_begin().
+ */
+struct dns_journalcompact {
+	isc_mem_t *mctx;
+	dns_journal_t *j1; /*%< The journal when compaction began */
+	dns_journal_t *j2; /*%< The compacted journal */
+	char *filename;
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+	uint32_t serial;
+	uint32_t target_size;
+	unsigned int indexend;
+	bool is_backup;
+	bool rewrite;
+	bool downgrade;
+	bool copying; /*%< The temporary file may exist */
+};
+
+static void
+compact_free(dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *c = *compactp;
+
+	*compactp = NULL;
+
+	if (c->j1 != NULL) {
+		dns_journal_destroy(&c->j1);
+	}
+	if (c->j2 != NULL) {
+		dns_journal_destroy(&c->j2);
+	}
+	if (c->copying) {
+		(void)isc_file_remove(c->newname);
+	}
+	isc_mem_free(c->mctx, c->filename);
+	isc_mem_putanddetach(&c->mctx, c, sizeof(*c));
+}
+
 isc_result_t
-dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
-		    uint32_t flags, uint32_t target_size) {
-	unsigned int i;
-	journal_pos_t best_guess;
-	journal_pos_t current_pos;
+dns_journal_compact_begin(isc_mem_t *mctx, char *filename, uint32_t serial,
+			  uint32_t flags, uint32_t target_size,
+			  dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *c = NULL;
 	dns_journal_t *j1 = NULL;
-	dns_journal_t *j2 = NULL;
-	journal_rawheader_t rawheader;
-	unsigned int len;
 	size_t namelen;
-	unsigned char *buf = NULL;
-	unsigned int size = 0;
 	isc_result_t result;
-	unsigned int indexend;
-	char newname[PATH_MAX];
-	char backup[PATH_MAX];
-	bool is_backup = false;
-	bool rewrite = false;
-	bool downgrade = false;
 
 	REQUIRE(filename != NULL);
+	REQUIRE(compactp != NULL && *compactp == NULL);
+
+	c = isc_mem_get(mctx, sizeof(*c));
+	*c = (dns_journalcompact_t){
+		.filename = isc_mem_strdup(mctx, filename),
+	};
+	isc_mem_attach(mctx, &c->mctx);
 
 	namelen = strlen(filename);
 	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
 		namelen -= 4;
 	}
 
-	result = snprintf(newname, sizeof(newname), "%.*s.jnw", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(newname));
+	result = snprintf(c->newname, sizeof(c->newname), "%.*s.jnw",
+			  (int)namelen, filename);
+	RUNTIME_CHECK(result < sizeof(c->newname));
 
-	result = snprintf(backup, sizeof(backup), "%.*s.jbk", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(backup));
+	result = snprintf(c->backup, sizeof(c->backup), "%.*s.jbk",
+			  (int)namelen, filename);
+	RUNTIME_CHECK(result < sizeof(c->backup));
 
-	result = journal_open(mctx, filename, false, false, false, &j1);
+	result = journal_open(mctx, filename, false, false, false, &c->j1);
 	if (result == ISC_R_NOTFOUND) {
-		is_backup = true;
-		result = journal_open(mctx, backup, false, false, false, &j1);
+		c->is_backup = true;
+		result = journal_open(mctx, c->backup, false, false, false,
+				      &c->j1);
 	}
 	if (result != ISC_R_SUCCESS) {
-		return (result);
+		goto failure;
 	}
+	j1 = c->j1;
 
 	/*
 	 * Always perform a re-write when processing a version 1 journal.
 	 */
-	rewrite = j1->header_ver1;
+	c->rewrite = j1->header_ver1;
 
 	/*
 	 * Check whether we need to rewrite the whole journal
@@ -2529,44 +2988,82 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	 */
 	if ((flags & DNS_JOURNAL_COMPACTALL) != 0) {
 		if ((flags & DNS_JOURNAL_VERSION1) != 0) {
-			downgrade = true;
+			c->downgrade = true;
 		}
-		rewrite = true;
+		c->rewrite = true;
 		serial = dns_journal_first_serial(j1);
 	} else if (JOURNAL_EMPTY(&j1->header)) {
-		dns_journal_destroy(&j1);
-		return (ISC_R_SUCCESS);
+		goto failure;
 	}
 
 	if (DNS_SERIAL_GT(j1->header.begin.serial, serial) ||
 	    DNS_SERIAL_GT(serial, j1->header.end.serial))
 	{
-		dns_journal_destroy(&j1);
-		return (ISC_R_RANGE);
+		result = ISC_R_RANGE;
+		goto failure;
 	}
 
 	/*
 	 * Cope with very small target sizes.
 	 */
-	indexend = sizeof(journal_rawheader_t) +
-		   ISC_CHECKED_MUL(j1->header.index_size,
-				   sizeof(journal_rawpos_t));
+	c->indexend = sizeof(journal_rawheader_t) +
+		      ISC_CHECKED_MUL(j1->header.index_size,
+				      sizeof(journal_rawpos_t));
 	if (target_size < DNS_JOURNAL_SIZE_MIN) {
 		target_size = DNS_JOURNAL_SIZE_MIN;
 	}
-	if (target_size < indexend * 2) {
-		target_size = target_size / 2 + indexend;
+	if (target_size < c->indexend * 2) {
+		target_size = target_size / 2 + c->indexend;
 	}
 
 	/*
 	 * See if there is any work to do.
 	 */
-	if (!rewrite && (uint32_t)j1->header.end.offset < target_size) {
-		dns_journal_destroy(&j1);
-		return (ISC_R_SUCCESS);
+	if (!c->rewrite && (uint32_t)j1->header.end.offset < target_size) {
+		goto failure;
 	}
 
-	CHECK(journal_open(mctx, newname, true, true, downgrade, &j2));
+	c->serial = serial;
+	c->target_size = target_size;
+	*compactp = c;
+	return (ISC_R_SUCCESS);
+
+failure:
+	compact_free(&c);
+	return (result);
+}
+
+isc_result_t
+dns_journal_compact_copy(dns_journalcompact_t *c) {
+	unsigned int i;
+	journal_pos_t best_guess;
+	journal_pos_t current_pos;
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	journal_rawheader_t rawheader;
+	unsigned int len;
+	unsigned char *buf = NULL;
+	unsigned int size = 0;
+	isc_result_t result;
+	unsigned int indexend;
+	uint32_t serial;
+	uint32_t target_size;
+	bool rewrite;
+	isc_mem_t *mctx = NULL;
+
+	REQUIRE(c != NULL && c->j1 != NULL && c->j2 == NULL);
+
+	mctx = c->mctx;
+	j1 = c->j1;
+	indexend = c->indexend;
+	serial = c->serial;
+	target_size = c->target_size;
+	rewrite = c->rewrite;
+
+	c->copying = true;
+	CHECK(journal_open(mctx, c->newname, true, true, c->downgrade,
+			   &c->j2));
+	j2 = c->j2;
 	CHECK(journal_seek(j2, indexend));
 
 	/*
@@ -2630,7 +3127,6 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		j2->header.sourceserial = j1->header.sourceserial;
 		j2->header.serialset = j1->header.serialset;
 		j2->header.end.serial = j1->header.end.serial;
-
 		/*
 		 * Only use this method if we're rewriting the
 		 * journal to fix outdated transaction headers;
@@ -2751,14 +3247,7 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		 * this faster method instead.
 		 */
 		if (!rewrite) {
-			size = ISC_MIN(64 * 1024, len);
-			buf = isc_mem_get(mctx, size);
-			for (i = 0; i < len; i += size) {
-				unsigned int blob = ISC_MIN(size, len - i);
-				CHECK(journal_read(j1, buf, blob));
-				CHECK(journal_write(j2, buf, blob));
-			}
-
+			CHECK(journal_copy(mctx, j1, j2, len));
 			j2->header.end.offset = indexend + len;
 		}
 
@@ -2791,11 +3280,104 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		POST(indexend);
 	}
 
+	result = ISC_R_SUCCESS;
+
+failure:
+	if (buf != NULL) {
+		isc_mem_put(mctx, buf, size);
+	}
+	return (result);
+}
+
+/*
+ * Append the transactions that were committed to the journal since
+ * dns_journal_compact_begin() to the compacted journal, and pick up
+ * any change of the source serial.
+ */
+static isc_result_t
+compact_tail(dns_journalcompact_t *c) {
+	dns_journal_t *j1 = c->j1, *j2 = c->j2, *j3 = NULL;
+	journal_pos_t pos, current_pos;
+	uint32_t offset;
+	unsigned int len;
+	isc_result_t result;
+
+	CHECK(journal_open(c->mctx, j1->filename, false, false, false, &j3));
+
+	if (j3->header.end.serial != j1->header.end.serial) {
+		if (c->rewrite) {
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_JOURNAL, ISC_LOG_ERROR,
+				      "%s: journal changed while it was "
+				      "being rewritten",
+				      j1->filename);
+			CHECK(ISC_R_FAILURE);
+		}
+
+		/*
+		 * The new transactions follow the end of the journal as
+		 * it was when compaction began.  If that is not a
+		 * transaction boundary any more, the journal has been
+		 * replaced in the meantime.
+		 */
+		CHECK(journal_find(j3, j1->header.end.serial, &pos));
+		len = j3->header.end.offset - pos.offset;
+
+		offset = JOURNAL_EMPTY(&j2->header) ? c->indexend
+						    : j2->header.end.offset;
+		CHECK(journal_seek(j3, pos.offset));
+		CHECK(journal_seek(j2, offset));
+		CHECK(journal_copy(c->mctx, j3, j2, len));
+		CHECK(journal_fsync(j2));
+
+		current_pos.serial = j1->header.end.serial;
+		current_pos.offset = offset;
+		if (JOURNAL_EMPTY(&j2->header)) {
+			j2->header.begin = current_pos;
+		}
+		j2->header.end.serial = j3->header.end.serial;
+		j2->header.end.offset = offset + len;
+
+		while (current_pos.serial != j2->header.end.serial) {
+			index_add(j2, &current_pos);
+			CHECK(journal_next(j2, &current_pos));
+		}
+	} else if (j3->header.sourceserial == j2->header.sourceserial &&
+		   j3->header.serialset == j2->header.serialset)
+	{
+		/* Nothing has changed. */
+		goto failure;
+	}
+
+	j2->header.sourceserial = j3->header.sourceserial;
+	j2->header.serialset = j3->header.serialset;
+	CHECK(journal_sync_header(j2));
+
+failure:
+	if (j3 != NULL) {
+		dns_journal_destroy(&j3);
+	}
+	return (result);
+}
+
+isc_result_t
+dns_journal_compact_finish(dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *c = NULL;
+	isc_result_t result;
+
+	REQUIRE(compactp != NULL && *compactp != NULL);
+	REQUIRE((*compactp)->j2 != NULL);
+
+	c = *compactp;
+	*compactp = NULL;
+
+	CHECK(compact_tail(c));
+
 	/*
 	 * Close both journals before trying to rename files.
 	 */
-	dns_journal_destroy(&j1);
-	dns_journal_destroy(&j2);
+	dns_journal_destroy(&c->j1);
+	dns_journal_destroy(&c->j2);
 
 	/*
 	 * With a UFS file system this should just succeed and be atomic.
@@ -2808,21 +3390,21 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	 * if so, hopefully they'll be finished by the next time we
 	 * compact.)
 	 */
-	if (rename(newname, filename) == -1) {
-		if (errno == EEXIST && !is_backup) {
-			result = isc_file_remove(backup);
+	if (rename(c->newname, c->filename) == -1) {
+		if (errno == EEXIST && !c->is_backup) {
+			result = isc_file_remove(c->backup);
 			if (result != ISC_R_SUCCESS &&
 			    result != ISC_R_FILENOTFOUND)
 			{
 				goto failure;
 			}
-			if (rename(filename, backup) == -1) {
+			if (rename(c->filename, c->backup) == -1) {
 				goto maperrno;
 			}
-			if (rename(newname, filename) == -1) {
+			if (rename(c->newname, c->filename) == -1) {
 				goto maperrno;
 			}
-			(void)isc_file_remove(backup);
+			(void)isc_file_remove(c->backup);
 		} else {
 		maperrno:
 			result = ISC_R_FAILURE;
@@ -2833,17 +3415,36 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	result = ISC_R_SUCCESS;
 
 failure:
-	(void)isc_file_remove(newname);
-	if (buf != NULL) {
-		isc_mem_put(mctx, buf, size);
-	}
-	if (j1 != NULL) {
-		dns_journal_destroy(&j1);
+	compact_free(&c);
+	return (result);
+}
+
+void
+dns_journal_compact_cancel(dns_journalcompact_t **compactp) {
+	REQUIRE(compactp != NULL && *compactp != NULL);
+
+	compact_free(compactp);
+}
+
+isc_result_t
+dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
+		    uint32_t flags, uint32_t target_size) {
+	dns_journalcompact_t *c = NULL;
+	isc_result_t result;
+
+	result = dns_journal_compact_begin(mctx, filename, serial, flags,
+					   target_size, &c);
+	if (result != ISC_R_SUCCESS || c == NULL) {
+		return (result);
 	}
-	if (j2 != NULL) {
-		dns_journal_destroy(&j2);
+
+	result = dns_journal_compact_copy(c);
+	if (result != ISC_R_SUCCESS) {
+		dns_journal_compact_cancel(&c);
+		return (result);
 	}
-	return (result);
+
+	return (dns_journal_compact_finish(&c));
 }
 
 static isc_result_t
@@ -15,7 +15,10 @@
 
 #include <stdbool.h>
 
+#include <isc/atomic.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -38,12 +41,51 @@
 #define KEYNODE_MAGIC	  ISC_MAGIC('K', 'N', 'o', 'd')
 #define VALID_KEYNODE(kn) ISC_MAGIC_VALID(kn, KEYNODE_MAGIC)
 
+/*
+ * Parsed DNSKEY records, so that the validator does not have to turn
+ * the same DNSKEY into a dst key for every RRset it verifies with it.
+ * The cache is direct-mapped on a hash of the DNSKEY rdata.
+ */
+#define KEYCACHE_SIZE 256
+
+/*
+ * Incremented whenever a key table is created or changed, so that the
+ * answer of a lookup can be reused for as long as it stays the same.
+ */
+static atomic_uint_fast64_t generation = 1;
+
+typedef struct keycache_entry {
+	dns_name_t name;
+	unsigned char *data;
+	unsigned int length;
+	dst_key_t *key;
+} keycache_entry_t;
+
+/*
+ * Signatures that have been verified, so that an RRset that is validated
+ * again, because it was refreshed or because several fetches raced to
+ * validate it, is not verified again. An entry is found by a hash of the
+ * owner name, the RRset and the key, and holds a copy of the RRSIG, which
+ * has to match exactly.
+ */
+#define SIGCACHE_SIZE 1024
+
+typedef struct sigcache_entry {
+	uint64_t hash;
+	unsigned char *data;
+	unsigned int length;
+} sigcache_entry_t;
+
 struct dns_keytable {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	isc_rwlock_t rwlock;
 	dns_qpmulti_t *table;
+	isc_mutex_t keylock;
+	keycache_entry_t keycache[KEYCACHE_SIZE];
+	isc_mutex_t siglock;
+	sigcache_entry_t sigcache[SIGCACHE_SIZE];
 };
 
 struct dns_keynode {
@@ -142,9 +184,48 @@ dns_keytable_create(dns_view_t *view, dns_keytable_t **keytablep) {
 	isc_mem_attach(view->mctx, &keytable->mctx);
 	dns_qpmulti_create(view->mctx, &qpmethods, view, &keytable->table);
 	isc_refcount_init(&keytable->references, 1);
+	isc_mutex_init(&keytable->keylock);
+	for (size_t i = 0; i < KEYCACHE_SIZE; i++) {
+		dns_name_init(&keytable->keycache[i].name, NULL);
+	}
+	isc_mutex_init(&keytable->siglock);
+	atomic_fetch_add_release(&generation, 1);
 	*keytablep = keytable;
 }
 
+uint64_t
+dns_keytable_generation(void) {
+	return (atomic_load_acquire(&generation));
+}
+
+static void
+sigcache_flush(dns_keytable_t *keytable) {
+	LOCK(&keytable->siglock);
+	for (size_t i = 0; i < SIGCACHE_SIZE; i++) {
+		sigcache_entry_t *entry = &keytable->sigcache[i];
+		if (entry->data != NULL) {
+			isc_mem_put(keytable->mctx, entry->data,
+				    entry->length);
+			*entry = (sigcache_entry_t){ 0 };
+		}
+	}
+	UNLOCK(&keytable->siglock);
+}
+
+static void
+keycache_clear(dns_keytable_t *keytable, keycache_entry_t *entry) {
+	if (entry->key == NULL) {
+		return;
+	}
+
+	dst_key_free(&entry->key);
+	dns_name_free(&entry->name, keytable->mctx);
+	dns_name_init(&entry->name, NULL);
+	isc_mem_put(keytable->mctx, entry->data, entry->length);
+	entry->data = NULL;
+	entry->length = 0;
+}
+
 static void
 destroy_keytable(dns_keytable_t *keytable) {
 	dns_qpread_t qpr;
@@ -163,6 +244,13 @@ destroy_keytable(dns_keytable_t *keytable) {
 
 	dns_qpmulti_destroy(&keytable->table);
 
+	for (size_t i = 0; i < KEYCACHE_SIZE; i++) {
+		keycache_clear(keytable, &keytable->keycache[i]);
+	}
+	isc_mutex_destroy(&keytable->keylock);
+	sigcache_flush(keytable);
+	isc_mutex_destroy(&keytable->siglock);
+
 	isc_mem_putanddetach(&keytable->mctx, keytable, sizeof(*keytable));
 }
 
@@ -353,6 +441,8 @@ insert(dns_keytable_t *keytable, bool managed, bool initial,
 
 	REQUIRE(VALID_KEYTABLE(keytable));
 
+	sigcache_flush(keytable);
+
 	dns_qpmulti_write(keytable->table, &qp);
 
 	result = dns_qp_getname(qp, keyname, &pval, NULL);
@@ -381,6 +471,7 @@ insert(dns_keytable_t *keytable, bool managed, bool initial,
 
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(keytable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 
 	return (result);
 }
@@ -411,6 +502,8 @@ dns_keytable_delete(dns_keytable_t *keytable, const dns_name_t *keyname,
 	REQUIRE(VALID_KEYTABLE(keytable));
 	REQUIRE(keyname != NULL);
 
+	sigcache_flush(keytable);
+
 	dns_qpmulti_write(keytable->table, &qp);
 	result = dns_qp_deletename(qp, keyname, &pval, NULL);
 	if (result == ISC_R_SUCCESS) {
@@ -422,6 +515,7 @@ dns_keytable_delete(dns_keytable_t *keytable, const dns_name_t *keyname,
 	}
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(keytable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 
 	return (result);
 }
@@ -441,6 +535,8 @@ dns_keytable_deletekey(dns_keytable_t *keytable, const dns_name_t *keyname,
 	REQUIRE(VALID_KEYTABLE(keytable));
 	REQUIRE(dnskey != NULL);
 
+	sigcache_flush(keytable);
+
 	dns_qpmulti_write(keytable->table, &qp);
 	result = dns_qp_getname(qp, keyname, &pval, NULL);
 	if (result != ISC_R_SUCCESS) {
@@ -475,6 +571,7 @@ dns_keytable_deletekey(dns_keytable_t *keytable, const dns_name_t *keyname,
 finish:
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(keytable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 
 	return (result);
 }
@@ -852,3 +949,143 @@ qp_triename(void *uctx, char *buf, size_t size) {
 	dns_view_t *view = uctx;
 	snprintf(buf, size, "view %s secroots table", view->name);
 }
+
+isc_result_t
+dns_keytable_dstkey(dns_keytable_t *keytable, const dns_name_t *name,
+		    dns_rdata_t *rdata, dst_key_t **keyp) {
+	isc_result_t result;
+	keycache_entry_t *entry = NULL;
+	dst_key_t *key = NULL;
+
+	REQUIRE(VALID_KEYTABLE(keytable));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(rdata != NULL && rdata->type == dns_rdatatype_dnskey);
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	entry = &keytable->keycache[isc_hash32(rdata->data, rdata->length,
+					       true) %
+				    KEYCACHE_SIZE];
+
+	LOCK(&keytable->keylock);
+	if (entry->key != NULL && entry->length == rdata->length &&
+	    memcmp(entry->data, rdata->data, rdata->length) == 0 &&
+	    dns_name_equal(&entry->name, name))
+	{
+		dst_key_attach(entry->key, keyp);
+		UNLOCK(&keytable->keylock);
+		return (ISC_R_SUCCESS);
+	}
+	UNLOCK(&keytable->keylock);
+
+	/*
+	 * Parse the key without holding the lock; it is the slow part.
+	 */
+	result = dns_dnssec_keyfromrdata(name, rdata, keytable->mctx, &key);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	LOCK(&keytable->keylock);
+	keycache_clear(keytable, entry);
+	dns_name_dup(name, keytable->mctx, &entry->name);
+	entry->data = isc_mem_get(keytable->mctx, rdata->length);
+	memmove(entry->data, rdata->data, rdata->length);
+	entry->length = rdata->length;
+	dst_key_attach(key, &entry->key);
+	UNLOCK(&keytable->keylock);
+
+	*keyp = key;
+	return (ISC_R_SUCCESS);
+}
+
+static uint64_t
+sigcache_hash(const dns_name_t *name, dns_rdataset_t *rdataset,
+	      dst_key_t *key) {
+	isc_hash64_t state;
+	isc_result_t result;
+	isc_buffer_t b;
+	unsigned char keydata[DST_KEY_MAXSIZE + 4];
+	uint16_t rdtype = rdataset->type, rdclass = rdataset->rdclass;
+
+	isc_hash64_init(&state);
+	isc_hash64_hash(&state, name->ndata, name->length, false);
+	isc_hash64_hash(&state, &rdtype, sizeof(rdtype), true);
+	isc_hash64_hash(&state, &rdclass, sizeof(rdclass), true);
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	if (dst_key_todns(key, &b) != ISC_R_SUCCESS) {
+		return (0);
+	}
+	isc_hash64_hash(&state, keydata, isc_buffer_usedlength(&b), true);
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		uint16_t length;
+
+		dns_rdataset_current(rdataset, &rdata);
+		length = rdata.length;
+		isc_hash64_hash(&state, &length, sizeof(length), true);
+		isc_hash64_hash(&state, rdata.data, rdata.length, true);
+	}
+
+	return (isc_hash64_finalize(&state));
+}
+
+bool
+dns_keytable_sigverified(dns_keytable_t *keytable, const dns_name_t *name,
+			 dns_rdataset_t *rdataset, dst_key_t *key,
+			 dns_rdata_t *sigrdata, uint64_t *hashp) {
+	sigcache_entry_t *entry = NULL;
+	uint64_t hash;
+	bool found;
+
+	REQUIRE(VALID_KEYTABLE(keytable));
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+	REQUIRE(hashp != NULL);
+
+	*hashp = hash = sigcache_hash(name, rdataset, key);
+	if (hash == 0) {
+		return (false);
+	}
+
+	entry = &keytable->sigcache[hash % SIGCACHE_SIZE];
+	LOCK(&keytable->siglock);
+	found = entry->data != NULL && entry->hash == hash &&
+		entry->length == sigrdata->length &&
+		memcmp(entry->data, sigrdata->data, sigrdata->length) == 0;
+	UNLOCK(&keytable->siglock);
+
+	return (found);
+}
+
+void
+dns_keytable_setsigverified(dns_keytable_t *keytable, uint64_t hash,
+			    dns_rdata_t *sigrdata) {
+	sigcache_entry_t *entry = NULL;
+	unsigned char *data = NULL;
+
+	REQUIRE(VALID_KEYTABLE(keytable));
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+
+	if (hash == 0) {
+		return;
+	}
+
+	entry = &keytable->sigcache[hash % SIGCACHE_SIZE];
+	data = isc_mem_get(keytable->mctx, sigrdata->length);
+	memmove(data, sigrdata->data, sigrdata->length);
+
+	LOCK(&keytable->siglock);
+	if (entry->data != NULL) {
+		isc_mem_put(keytable->mctx, entry->data, entry->length);
+	}
+	*entry = (sigcache_entry_t){
+		.hash = hash,
+		.data = data,
+		.length = sigrdata->length,
+	};
+	UNLOCK(&keytable->siglock);
+}
@@ -18,16 +18,20 @@
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -87,6 +91,15 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Text files are split into chunks of about PARALLEL_CHUNKSIZE bytes for
+ * parallel loading, and are only split if they are at least twice that
+ * size.  PARALLEL_READSIZE is the buffer size used when scanning for
+ * split points.
+ */
+#define PARALLEL_CHUNKSIZE (16 * 1024 * 1024)
+#define PARALLEL_READSIZE  (64 * 1024)
+
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
@@ -128,11 +141,13 @@ struct dns_loadctx {
 	dns_rdataclass_t zclass;
 	dns_fixedname_t fixed_top;
 	dns_name_t *top; /*%< top of zone */
+	char *master_file; /*%< file to split when loading in parallel */
 
 	/* Members specific to the raw format: */
 	FILE *f;
 	bool first;
 	dns_masterrawheader_t header;
+	dns_trust_t trust; /*%< trust level of the RRset being committed */
 
 	/* Which fixed buffers we are using? */
 	isc_result_t result;
@@ -459,6 +474,10 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		}
 	}
 
+	if (lctx->master_file != NULL) {
+		isc_mem_free(lctx->mctx, lctx->master_file);
+	}
+
 	/* isc_lex_destroy() will close all open streams */
 	if (lctx->lex != NULL && !lctx->keep_lex) {
 		isc_lex_destroy(&lctx->lex);
@@ -532,6 +551,7 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 		.include_cb = include_cb,
 		.include_arg = include_arg,
 		.first = true,
+		.trust = dns_trust_ultimate,
 		.done = done,
 		.callbacks = callbacks,
 		.done_arg = done_arg,
@@ -2364,6 +2384,8 @@ load_raw(dns_loadctx_t *lctx) {
 	isc_buffer_t target, buf;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
+	uint32_t ttl_offset = 0;
+	bool has_trust;
 
 	callbacks = lctx->callbacks;
 	dctx = DNS_DECOMPRESS_NEVER;
@@ -2375,6 +2397,18 @@ load_raw(dns_loadctx_t *lctx) {
 		}
 	}
 
+	/*
+	 * Cache snapshots carry the trust level of each RRset, and
+	 * their TTLs are aged by the time elapsed since the dump, like
+	 * $DATE does for text files.
+	 */
+	has_trust = (lctx->header.flags & DNS_MASTERRAW_TRUST) != 0;
+	if ((lctx->options & DNS_MASTER_AGETTL) != 0 &&
+	    lctx->header.dumptime < lctx->now)
+	{
+		ttl_offset = lctx->now - lctx->header.dumptime;
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2429,6 +2463,9 @@ load_raw(dns_loadctx_t *lctx) {
 		minlen = sizeof(totallen) + sizeof(uint16_t) +
 			 sizeof(uint16_t) + sizeof(uint16_t) +
 			 sizeof(uint32_t) + sizeof(uint32_t);
+		if (has_trust) {
+			minlen += sizeof(uint16_t);
+		}
 		if (totallen < minlen) {
 			result = ISC_R_RANGE;
 			goto cleanup;
@@ -2480,8 +2517,21 @@ load_raw(dns_loadctx_t *lctx) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
+		if (has_trust) {
+			lctx->trust = isc_buffer_getuint16(&target);
+			if (lctx->trust > dns_trust_ultimate) {
+				result = ISC_R_RANGE;
+				goto cleanup;
+			}
+		}
 		INSIST(isc_buffer_consumedlength(&target) <= readlen);
 
+		if (rdatalist.ttl < ttl_offset) {
+			rdatalist.ttl = 0;
+		} else {
+			rdatalist.ttl -= ttl_offset;
+		}
+
 		/* Owner name: length followed by name */
 		result = read_and_check(sequential_read, &target,
 					sizeof(namelen), lctx->f, &totallen);
@@ -2652,6 +2702,476 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Parallel loading of large text format files.
+ *
+ * The file is first scanned once, without being parsed, to find lines
+ * which start a new owner name outside of any parenthesized or quoted
+ * text.  The file is cut at such lines roughly every PARALLEL_CHUNKSIZE
+ * bytes, and the $ORIGIN and $TTL in effect at each cut are recorded
+ * so that every chunk can be parsed by load_text() on its own.  The
+ * chunks are then parsed by the calling thread and by worker threads,
+ * and the resulting rdatasets are handed to the database one at a time.
+ *
+ * Every worker holds a chunk of the file in memory while parsing it, so
+ * the number of worker threads is bounded across all the loads running
+ * in the process, not per load: a load that finds no free worker slot
+ * simply parses all of its chunks in the calling thread.
+ */
+static atomic_uint_fast32_t parallel_threads = 0;
+static uint32_t parallel_maxthreads = 0; /* isc_os_ncpus() - 1 if 0 */
+static size_t parallel_chunksize = PARALLEL_CHUNKSIZE;
+
+typedef struct parallel_chunk {
+	off_t offset;
+	size_t length;
+	unsigned long line;
+	dns_fixedname_t origin;
+	bool ttl_known;
+	uint32_t ttl;
+	isc_result_t result;
+} parallel_chunk_t;
+
+typedef struct parallel_load {
+	dns_loadctx_t *lctx;
+	dns_rdatacallbacks_t callbacks;
+	isc_mutex_t lock; /*%< serializes lctx->callbacks->add */
+	parallel_chunk_t *chunks;
+	size_t nchunks;
+	size_t allocated;
+	atomic_size_t next;
+	atomic_bool failed;
+} parallel_load_t;
+
+static parallel_chunk_t *
+parallel_newchunk(parallel_load_t *pl, off_t offset, unsigned long line,
+		  const dns_name_t *origin, bool ttl_known, uint32_t ttl) {
+	parallel_chunk_t *chunk = NULL;
+
+	if (pl->nchunks == pl->allocated) {
+		size_t allocated = pl->allocated + 64;
+		pl->chunks = isc_mem_creget(pl->lctx->mctx, pl->chunks,
+					    pl->allocated, allocated,
+					    sizeof(pl->chunks[0]));
+		pl->allocated = allocated;
+	}
+
+	chunk = &pl->chunks[pl->nchunks++];
+	*chunk = (parallel_chunk_t){
+		.offset = offset,
+		.line = line,
+		.ttl_known = ttl_known,
+		.ttl = ttl,
+	};
+	dns_name_copy(origin, dns_fixedname_initname(&chunk->origin));
+
+	return (chunk);
+}
+
+/*
+ * Apply the $ORIGIN or $TTL directive in 'text' to the split state.
+ * Returns false if the directive prevents the file from being split.
+ */
+static bool
+parallel_directive(char *text, size_t length, dns_name_t *origin,
+		   bool *ttl_knownp, uint32_t *ttlp) {
+	char *directive = NULL, *arg = NULL;
+	char *end = text + length;
+	char *p = text;
+	isc_textregion_t r;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	directive = p;
+	while (p < end && *p != ' ' && *p != '\t') {
+		p++;
+	}
+	r = (isc_textregion_t){ .base = directive,
+				.length = p - directive };
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	arg = p;
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+		if (*p == '\\' && p + 1 < end) {
+			p++;
+		}
+		p++;
+	}
+
+	if (r.length == 7 && strncasecmp(directive, "$ORIGIN", 7) == 0) {
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+
+		isc_buffer_init(&buffer, arg, p - arg);
+		isc_buffer_add(&buffer, p - arg);
+		result = dns_name_fromtext(name, &buffer, origin, 0, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+		dns_name_copy(name, origin);
+	} else if (r.length == 4 && strncasecmp(directive, "$TTL", 4) == 0) {
+		r = (isc_textregion_t){ .base = arg, .length = p - arg };
+		result = dns_ttl_fromtext(&r, ttlp);
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+		if (*ttlp > 0x7fffffffUL) {
+			*ttlp = 0;
+		}
+		*ttl_knownp = true;
+	} else if ((r.length == 8 && strncasecmp(directive, "$INCLUDE", 8) == 0) ||
+		   (r.length == 5 && strncasecmp(directive, "$DATE", 5) == 0))
+	{
+		/*
+		 * $INCLUDE may change the $TTL, and $DATE changes the
+		 * TTL of everything that follows it.
+		 */
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * Scan 'lctx->master_file' and split it into chunks.  Returns false if the
+ * file cannot be split, in which case it is loaded serially.
+ */
+static bool
+parallel_split(parallel_load_t *pl) {
+	dns_loadctx_t *lctx = pl->lctx;
+	dns_fixedname_t forigin;
+	dns_name_t *origin = dns_fixedname_initname(&forigin);
+	bool ttl_known = lctx->default_ttl_known;
+	uint32_t ttl = lctx->default_ttl;
+	char directive[1024];
+	size_t dlen = 0;
+	bool indirective = false, splittable = true;
+	bool linestart = true, escaped = false, quoted = false;
+	bool comment = false;
+	unsigned int depth = 0;
+	unsigned long line = 1;
+	off_t offset = 0, cut = parallel_chunksize;
+	unsigned char *buf = NULL;
+	FILE *f = NULL;
+	isc_result_t result;
+
+	result = isc_stdio_open(lctx->master_file, "rb", &f);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	dns_name_copy(lctx->inc->origin, origin);
+	parallel_newchunk(pl, 0, 1, origin, ttl_known, ttl);
+
+	buf = isc_mem_get(lctx->mctx, PARALLEL_READSIZE);
+	while (splittable) {
+		size_t n = 0;
+
+		result = isc_stdio_read(buf, 1, PARALLEL_READSIZE, f, &n);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EOF) {
+			splittable = false;
+			break;
+		}
+
+		for (size_t i = 0; i < n && splittable; i++, offset++) {
+			unsigned char c = buf[i];
+			bool literal = escaped;
+
+			if (linestart) {
+				linestart = false;
+				if (c == '$') {
+					indirective = true;
+					dlen = 0;
+				} else if (offset >= cut && ttl_known &&
+					   c != ' ' && c != '\t' &&
+					   c != '\r' && c != '\n' && c != ';')
+				{
+					parallel_chunk_t *prev =
+						&pl->chunks[pl->nchunks - 1];
+					prev->length = offset - prev->offset;
+					parallel_newchunk(pl, offset, line,
+							  origin, ttl_known,
+							  ttl);
+					cut = offset + parallel_chunksize;
+				}
+			}
+
+			if (c == '\n') {
+				line++;
+			}
+
+			if (comment) {
+				if (c == '\n') {
+					comment = false;
+				} else {
+					continue;
+				}
+			} else if (escaped) {
+				escaped = false;
+			} else if (c == '\\') {
+				escaped = true;
+			} else if (c == '"') {
+				quoted = !quoted;
+			} else if (quoted) {
+				/* nothing is special inside quotes */
+			} else if (c == ';') {
+				comment = true;
+				continue;
+			} else if (c == '(') {
+				depth++;
+			} else if (c == ')' && depth > 0) {
+				depth--;
+			}
+
+			if (c == '\n' && !literal && !quoted) {
+				if (indirective) {
+					indirective = false;
+					if (depth != 0 ||
+					    !parallel_directive(directive, dlen,
+								origin,
+								&ttl_known,
+								&ttl))
+					{
+						splittable = false;
+					}
+				}
+				linestart = (depth == 0);
+			} else if (indirective && !comment) {
+				if (dlen == sizeof(directive)) {
+					splittable = false;
+				} else {
+					directive[dlen++] = c;
+				}
+			}
+		}
+
+		if (result == ISC_R_EOF) {
+			break;
+		}
+	}
+
+	if (splittable && indirective) {
+		splittable = depth == 0 && parallel_directive(directive, dlen,
+							      origin,
+							      &ttl_known, &ttl);
+	}
+	if (splittable) {
+		parallel_chunk_t *last = &pl->chunks[pl->nchunks - 1];
+		last->length = offset - last->offset;
+	}
+
+	isc_mem_put(lctx->mctx, buf, PARALLEL_READSIZE);
+	(void)isc_stdio_close(f);
+
+	return (splittable && pl->nchunks > 1);
+}
+
+static isc_result_t
+parallel_add(void *arg, const dns_name_t *owner,
+	     dns_rdataset_t *dataset DNS__DB_FLARG) {
+	parallel_load_t *pl = arg;
+	dns_rdatacallbacks_t *callbacks = pl->lctx->callbacks;
+	isc_result_t result;
+
+	LOCK(&pl->lock);
+	result = callbacks->add(callbacks->add_private, owner,
+				dataset DNS__DB_FLARG_PASS);
+	UNLOCK(&pl->lock);
+
+	return (result);
+}
+
+static isc_result_t
+parallel_loadchunk(parallel_load_t *pl, parallel_chunk_t *chunk) {
+	dns_loadctx_t *lctx = pl->lctx;
+	dns_loadctx_t *clctx = NULL;
+	unsigned char *base = NULL;
+	isc_buffer_t buffer;
+	FILE *f = NULL;
+	isc_result_t result;
+
+	if (chunk->length == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	base = isc_mem_get(lctx->mctx, chunk->length);
+
+	result = isc_stdio_open(lctx->master_file, "rb", &f);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = isc_stdio_seek(f, chunk->offset, SEEK_SET);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_read(base, 1, chunk->length, f, NULL);
+	}
+	(void)isc_stdio_close(f);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	loadctx_create(dns_masterformat_text, lctx->mctx, lctx->options,
+		       lctx->resign, lctx->top, lctx->zclass,
+		       dns_fixedname_name(&chunk->origin), &pl->callbacks,
+		       NULL, NULL, NULL, NULL, NULL, &clctx);
+	clctx->maxttl = lctx->maxttl;
+	if (chunk->ttl_known) {
+		clctx->ttl_known = true;
+		clctx->default_ttl_known = true;
+		clctx->ttl = chunk->ttl;
+		clctx->default_ttl = chunk->ttl;
+	}
+
+	isc_buffer_init(&buffer, base, chunk->length);
+	isc_buffer_add(&buffer, chunk->length);
+	result = isc_lex_openbuffer(clctx->lex, &buffer);
+	if (result == ISC_R_SUCCESS) {
+		RUNTIME_CHECK(isc_lex_setsourcename(clctx->lex,
+						    lctx->master_file) ==
+			      ISC_R_SUCCESS);
+		RUNTIME_CHECK(isc_lex_setsourceline(clctx->lex, chunk->line) ==
+			      ISC_R_SUCCESS);
+		result = load_text(clctx);
+	}
+	dns_loadctx_detach(&clctx);
+
+cleanup:
+	isc_mem_put(lctx->mctx, base, chunk->length);
+	return (result);
+}
+
+/*
+ * Reserve one of the process wide worker thread slots.
+ */
+static bool
+parallel_reserve(void) {
+	uint_fast32_t max = parallel_maxthreads;
+	uint_fast32_t n = atomic_load_relaxed(&parallel_threads);
+
+	if (max == 0) {
+		max = isc_os_ncpus() - 1;
+	}
+
+	do {
+		if (n >= max) {
+			return (false);
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(&parallel_threads, &n,
+						       n + 1));
+
+	return (true);
+}
+
+static void *
+parallel_worker(void *arg) {
+	parallel_load_t *pl = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&pl->next, 1)) < pl->nchunks) {
+		parallel_chunk_t *chunk = &pl->chunks[i];
+
+		if (atomic_load_acquire(&pl->failed) ||
+		    atomic_load_acquire(&pl->lctx->canceled))
+		{
+			chunk->result = ISC_R_CANCELED;
+			continue;
+		}
+
+		chunk->result = parallel_loadchunk(pl, chunk);
+		if (chunk->result != ISC_R_SUCCESS && !LCTX_MANYERRORS(pl->lctx))
+		{
+			atomic_store_release(&pl->failed, true);
+		}
+	}
+
+	return (NULL);
+}
+
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	parallel_load_t pl = { .lctx = lctx };
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads, started = 0;
+	off_t size = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	if ((parallel_maxthreads == 0 && isc_os_ncpus() < 2) ||
+	    isc_file_getsize(lctx->master_file, &size) != ISC_R_SUCCESS ||
+	    (size_t)size < 2 * parallel_chunksize || !parallel_split(&pl))
+	{
+		if (pl.chunks != NULL) {
+			isc_mem_cput(lctx->mctx, pl.chunks, pl.allocated,
+				     sizeof(pl.chunks[0]));
+		}
+		return (load_text(lctx));
+	}
+	/* The calling thread parses chunks too */
+	nthreads = pl.nchunks - 1;
+
+	pl.callbacks = *callbacks;
+	pl.callbacks.add = parallel_add;
+	pl.callbacks.add_private = &pl;
+	pl.callbacks.setup = NULL;
+	pl.callbacks.commit = NULL;
+	isc_mutex_init(&pl.lock);
+	atomic_init(&pl.next, 0);
+	atomic_init(&pl.failed, false);
+
+	if (callbacks->setup != NULL) {
+		callbacks->setup(callbacks->add_private);
+	}
+
+	threads = isc_mem_cget(lctx->mctx, nthreads, sizeof(threads[0]));
+	while (started < nthreads && parallel_reserve()) {
+		isc_thread_create(parallel_worker, &pl, &threads[started++]);
+	}
+	(void)parallel_worker(&pl);
+	for (unsigned int i = 0; i < started; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	atomic_fetch_sub_relaxed(&parallel_threads, started);
+	isc_mem_cput(lctx->mctx, threads, nthreads, sizeof(threads[0]));
+
+	if (callbacks->commit != NULL) {
+		callbacks->commit(callbacks->add_private);
+	}
+
+	/*
+	 * Chunks are handed out in order, so the first failure in file
+	 * order is the one that caused any later chunks to be skipped.
+	 */
+	for (size_t i = 0; i < pl.nchunks; i++) {
+		if (pl.chunks[i].result != ISC_R_SUCCESS) {
+			result = pl.chunks[i].result;
+			break;
+		}
+	}
+
+	isc_mutex_destroy(&pl.lock);
+	isc_mem_cput(lctx->mctx, pl.chunks, pl.allocated, sizeof(pl.chunks[0]));
+
+	return (result);
+}
+
+void
+dns__master_setparallel(size_t chunksize, unsigned int maxthreads) {
+	parallel_chunksize = (chunksize != 0) ? chunksize : PARALLEL_CHUNKSIZE;
+	parallel_maxthreads = maxthreads;
+}
+
+static void
+setparallel(dns_loadctx_t *lctx, const char *master_file) {
+	if (lctx->format == dns_masterformat_text &&
+	    (lctx->options & DNS_MASTER_PARALLEL) != 0)
+	{
+		lctx->master_file = isc_mem_strdup(lctx->mctx, master_file);
+		lctx->load = load_parallel;
+	}
+}
+
 isc_result_t
 dns_master_loadfile(const char *master_file, dns_name_t *top,
 		    dns_name_t *origin, dns_rdataclass_t zclass,
@@ -2673,6 +3193,7 @@ dns_master_loadfile(const char *master_file, dns_name_t *top,
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
+	setparallel(lctx, master_file);
 
 	result = (lctx->load)(lctx);
 	INSIST(result != DNS_R_CONTINUE);
@@ -2723,9 +3244,10 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
 		dns_loadctx_detach(&lctx);
 		return (result);
 	}
+	setparallel(lctx, master_file);
 
 	dns_loadctx_attach(lctx, lctxp);
-	isc_work_enqueue(loop, load, load_done, lctx);
+	isc_work_enqueue_bulk(loop, load, load_done, lctx);
 
 	return (ISC_R_SUCCESS);
 }
@@ -2938,7 +3460,7 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 	while (this != NULL) {
 		dns_rdataset_init(&dataset);
 		dns_rdatalist_tordataset(this, &dataset);
-		dataset.trust = dns_trust_ultimate;
+		dataset.trust = lctx->trust;
 		/*
 		 * If this is a secure dynamic zone set the re-signing time.
 		 */
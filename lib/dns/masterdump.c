@@ -15,20 +15,25 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -86,6 +91,8 @@ struct dns_master_style {
 #define STALE(r) (((r)->attributes & DNS_RDATASETATTR_STALE) != 0)
 /*% Does the rdataset 'r' contain an expired answer? */
 #define ANCIENT(r) (((r)->attributes & DNS_RDATASETATTR_ANCIENT) != 0)
+/*% Is the rdataset 'r' a negative cache entry? */
+#define NEGATIVE(r) (((r)->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
 
 /*%
  * Context structure for a masterfile dump in progress.
@@ -102,6 +109,8 @@ typedef struct dns_totext_ctx {
 	bool current_ttl_valid;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
+	bool raw_trust; /* raw cache snapshot: write trust levels */
+	dns_rdatatype_t filtertype; /* only dump this type, if not 0 */
 } dns_totext_ctx_t;
 
 const dns_master_style_t dns_master_style_keyzone = {
@@ -265,6 +274,8 @@ struct dns_dumpctx {
 	char *tmpfile;
 	dns_masterformat_t format;
 	dns_masterrawheader_t header;
+	dns_fixedname_t filterfixed;
+	dns_name_t *filtername; /* only dump names below this, if set */
 	isc_result_t (*dumpsets)(isc_mem_t *mctx, const dns_name_t *name,
 				 dns_rdatasetiter_t *rdsiter,
 				 dns_totext_ctx_t *ctx, isc_buffer_t *buffer,
@@ -363,6 +374,7 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 
 	ctx->style = *style;
 	ctx->class_printed = false;
+	ctx->raw_trust = false;
 
 	dns_fixedname_init(&ctx->origin_fixname);
 
@@ -1075,6 +1087,16 @@ dump_order_compare(const void *a, const void *b) {
 		dump_order(*((const dns_rdataset_t *const *)b)));
 }
 
+/*
+ * Whether 'rds' is selected by the type filter of the dump; the
+ * signatures and negative entries for a type go with it.
+ */
+static bool
+filtertype_match(const dns_totext_ctx_t *ctx, const dns_rdataset_t *rds) {
+	return (ctx->filtertype == 0 || rds->type == ctx->filtertype ||
+		rds->covers == ctx->filtertype);
+}
+
 /*
  * Dump all the rdatasets of a domain name to a master file.  We make
  * a "best effort" attempt to sort the RRsets in a nice order, but if
@@ -1115,11 +1137,16 @@ dump_rdatasets_text(isc_mem_t *mctx, const dns_name_t *name,
 
 again:
 	for (i = 0; itresult == ISC_R_SUCCESS && i < MAXSORT;
-	     itresult = dns_rdatasetiter_next(rdsiter), i++)
+	     itresult = dns_rdatasetiter_next(rdsiter))
 	{
 		dns_rdataset_init(&rdatasets[i]);
 		dns_rdatasetiter_current(rdsiter, &rdatasets[i]);
+		if (!filtertype_match(ctx, &rdatasets[i])) {
+			dns_rdataset_disassociate(&rdatasets[i]);
+			continue;
+		}
 		sorted[i] = &rdatasets[i];
+		i++;
 	}
 	n = i;
 
@@ -1220,7 +1247,8 @@ again:
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, const dns_name_t *name,
-		  dns_rdataset_t *rdataset, isc_buffer_t *buffer, FILE *f) {
+		  dns_rdataset_t *rdataset, bool trust, isc_buffer_t *buffer,
+		  FILE *f) {
 	isc_result_t result;
 	uint32_t totallen;
 	uint16_t dlen;
@@ -1250,8 +1278,11 @@ restart:
 	isc_buffer_putuint16(buffer, rdataset->covers);	 /* same as type */
 	isc_buffer_putuint32(buffer, rdataset->ttl);	 /* 32-bit TTL */
 	isc_buffer_putuint32(buffer, dns_rdataset_count(rdataset));
+	if (trust) {
+		isc_buffer_putuint16(buffer, rdataset->trust);
+	}
 	totallen = isc_buffer_usedlength(buffer);
-	INSIST(totallen <= sizeof(dns_masterrawrdataset_t));
+	INSIST(totallen <= sizeof(dns_masterrawrdataset_t) + sizeof(uint16_t));
 
 	dns_name_toregion(name, &r);
 	INSIST(isc_buffer_availablelength(buffer) >= (sizeof(dlen) + r.length));
@@ -1341,13 +1372,25 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 
 		dns_rdataset_getownercase(&rdataset, name);
 
-		if (((rdataset.attributes & DNS_RDATASETATTR_NEGATIVE) != 0) &&
-		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
+		if (!filtertype_match(ctx, &rdataset)) {
+			/* Not selected by the filter */
+		} else if (((rdataset.attributes & DNS_RDATASETATTR_NEGATIVE) !=
+			    0) &&
+			   (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
 		{
 			/* Omit negative cache entries */
+		} else if (ctx->raw_trust && (STALE(&rdataset) ||
+					      ANCIENT(&rdataset) ||
+					      NEGATIVE(&rdataset)))
+		{
+			/*
+			 * Omit data that would come back to life with a
+			 * fresh TTL when the cache snapshot is loaded,
+			 * and negative entries, which cannot be loaded.
+			 */
 		} else {
 			result = dump_rdataset_raw(mctx, name, &rdataset,
-						   buffer, f);
+						   ctx->raw_trust, buffer, f);
 		}
 		dns_rdataset_disassociate(&rdataset);
 		if (result != ISC_R_SUCCESS) {
@@ -1374,6 +1417,47 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
  */
 static const int initial_buffer_length = 1200;
 
+/*%
+ * Databases with at least DUMP_PARALLEL_MIN nodes are dumped in
+ * parallel: the nodes are collected in order into batches of
+ * DUMP_BATCHSIZE, one per thread, the batches are formatted into memory
+ * by the dumping thread and by worker threads started for the whole
+ * dump, and they are then written out in order.  At most
+ * DUMP_MAXTHREADS threads are used.
+ */
+#define DUMP_BATCHSIZE	  4096
+#define DUMP_PARALLEL_MIN (256 * 1024)
+#define DUMP_MAXTHREADS	  16
+
+static size_t dump_parallelmin = DUMP_PARALLEL_MIN;
+static unsigned int dump_maxthreads = 0; /* isc_os_ncpus() if 0 */
+
+typedef struct dump_batch {
+	dns_dbnode_t *nodes[DUMP_BATCHSIZE];
+	dns_fixedname_t names[DUMP_BATCHSIZE];
+	size_t count;
+	dns_totext_ctx_t tctx;
+	char *text;
+	size_t length;
+	isc_result_t result;
+} dump_batch_t;
+
+typedef struct dump_parallel {
+	dns_dumpctx_t *dctx;
+	unsigned int options;
+	dump_batch_t *batches;
+
+	/* Locked by lock. */
+	isc_mutex_t lock;
+	isc_condition_t ready; /* a round was started, or exiting */
+	isc_condition_t done;  /* every batch of the round was formatted */
+	unsigned int round;
+	size_t nbatches;
+	size_t next;	   /* next batch of the round to format */
+	size_t formatted;  /* batches of the round formatted */
+	bool exiting;
+} dump_parallel_t;
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx);
 
@@ -1558,7 +1642,8 @@ master_dump_done_cb(void *data) {
 static isc_result_t
 dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	       const dns_master_style_t *style, FILE *f, dns_dumpctx_t **dctxp,
-	       dns_masterformat_t format, dns_masterrawheader_t *header) {
+	       dns_masterformat_t format, dns_masterrawheader_t *header,
+	       const dns_dumpfilter_t *filter) {
 	dns_dumpctx_t *dctx;
 	isc_result_t result;
 	unsigned int options;
@@ -1592,6 +1677,15 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		goto cleanup;
 	}
 
+	if (filter != NULL) {
+		if (filter->name != NULL) {
+			dctx->filtername =
+				dns_fixedname_initname(&dctx->filterfixed);
+			dns_name_copy(filter->name, dctx->filtername);
+		}
+		dctx->tctx.filtertype = filter->type;
+	}
+
 	dctx->now = isc_stdtime_now();
 	dns_db_attach(db, &dctx->db);
 
@@ -1599,10 +1693,18 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	if (dctx->do_date) {
 		(void)dns_db_getservestalettl(dctx->db,
 					      &dctx->tctx.serve_stale_ttl);
+		if (format == dns_masterformat_raw) {
+			dctx->header.flags |= DNS_MASTERRAW_TRUST;
+			dctx->tctx.raw_trust = true;
+		}
 	}
 
+	/*
+	 * The name filter needs absolute names to compare against.
+	 */
 	if (dctx->format == dns_masterformat_text &&
-	    (dctx->tctx.style.flags & DNS_STYLEFLAG_REL_OWNER) != 0)
+	    (dctx->tctx.style.flags & DNS_STYLEFLAG_REL_OWNER) != 0 &&
+	    dctx->filtername == NULL)
 	{
 		options = DNS_DB_RELATIVENAMES;
 	} else {
@@ -1709,6 +1811,313 @@ writeheader(dns_dumpctx_t *dctx) {
 	return (result);
 }
 
+/*
+ * Position the database iterator on the first node to dump.  The
+ * names at or below the filter name follow it directly in DNSSEC
+ * order, so a filtered dump starts there rather than at the top.
+ */
+static isc_result_t
+dump_first(dns_dumpctx_t *dctx) {
+	isc_result_t result;
+
+	if (dctx->filtername == NULL) {
+		return (dns_dbiterator_first(dctx->dbiter));
+	}
+
+	result = dns_dbiterator_seek(dctx->dbiter, dctx->filtername);
+	if (result == DNS_R_PARTIALMATCH) {
+		/* The iterator is on the closest ancestor. */
+		result = dns_dbiterator_next(dctx->dbiter);
+	} else if (result == ISC_R_NOTFOUND) {
+		result = dns_dbiterator_first(dctx->dbiter);
+	}
+
+	return (result);
+}
+
+/*
+ * Check the name of a node against the filter name of the dump.
+ * Returns ISC_R_SUCCESS if the node is to be dumped, ISC_R_NOTFOUND if
+ * it comes before the names to dump, and ISC_R_NOMORE if it comes
+ * after all of them.
+ */
+static isc_result_t
+dump_filtername(dns_dumpctx_t *dctx, const dns_name_t *name) {
+	if (dctx->filtername == NULL ||
+	    dns_name_issubdomain(name, dctx->filtername))
+	{
+		return (ISC_R_SUCCESS);
+	}
+	if (dns_name_compare(name, dctx->filtername) < 0) {
+		return (ISC_R_NOTFOUND);
+	}
+	return (ISC_R_NOMORE);
+}
+
+static isc_result_t
+dumpnode(dns_dumpctx_t *dctx, dns_dbnode_t *node, const dns_name_t *name,
+	 unsigned int options, dns_totext_ctx_t *tctx, isc_buffer_t *buffer,
+	 FILE *f) {
+	dns_rdatasetiter_t *rdsiter = NULL;
+	isc_result_t result;
+
+	result = dns_db_allrdatasets(dctx->db, node, dctx->version, options,
+				     dctx->now, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = (dctx->dumpsets)(dctx->mctx, name, rdsiter, tctx, buffer, f);
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (result);
+}
+
+/*
+ * Fill 'batch' with nodes from the current position of the database
+ * iterator onwards.  The batch is cut short where the origin changes,
+ * so that all of its nodes are formatted relative to the same origin;
+ * the iterator is then left on the node with the new origin.
+ *
+ * Each batch starts with no TTL or class printed, so the directives
+ * that depend on them are repeated at the start of every batch.
+ */
+static isc_result_t
+dump_fillbatch(dns_dumpctx_t *dctx, dump_batch_t *batch) {
+	dns_totext_ctx_t *tctx = &batch->tctx;
+	dns_name_t *origin = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	batch->count = 0;
+	batch->text = NULL;
+	batch->length = 0;
+	batch->result = ISC_R_SUCCESS;
+
+	*tctx = dctx->tctx;
+	tctx->class_printed = false;
+	tctx->current_ttl_valid = false;
+	tctx->neworigin = NULL;
+	origin = dns_fixedname_initname(&tctx->origin_fixname);
+	if (dctx->tctx.origin != NULL) {
+		dns_name_copy(dctx->tctx.origin, origin);
+		tctx->origin = origin;
+	}
+
+	while (result == ISC_R_SUCCESS && batch->count < DUMP_BATCHSIZE) {
+		dns_fixedname_t *fixed = &batch->names[batch->count];
+		dns_name_t *name = dns_fixedname_initname(fixed);
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(dctx->dbiter, &node, name);
+		if (result == DNS_R_NEWORIGIN) {
+			if (batch->count > 0) {
+				dns_db_detachnode(dctx->db, &node);
+				return (ISC_R_SUCCESS);
+			}
+
+			result = dns_dbiterator_origin(dctx->dbiter, origin);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			if ((tctx->style.flags & DNS_STYLEFLAG_REL_DATA) != 0) {
+				dns_name_t *current = dns_fixedname_initname(
+					&dctx->tctx.origin_fixname);
+				dns_name_copy(origin, current);
+				dctx->tctx.origin = current;
+				tctx->origin = origin;
+			}
+			tctx->neworigin = origin;
+		}
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+
+		result = dump_filtername(dctx, name);
+		if (result != ISC_R_SUCCESS) {
+			dns_db_detachnode(dctx->db, &node);
+			if (result == ISC_R_NOTFOUND) {
+				result = dns_dbiterator_next(dctx->dbiter);
+			}
+			continue;
+		}
+
+		batch->nodes[batch->count++] = node;
+		result = dns_dbiterator_next(dctx->dbiter);
+	}
+
+	return (result);
+}
+
+/*
+ * Format the nodes of 'batch' into memory, releasing them as we go.
+ */
+static isc_result_t
+dump_formatbatch(dns_dumpctx_t *dctx, dump_batch_t *batch,
+		 unsigned int options) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_buffer_t buffer;
+	FILE *f = NULL;
+
+	f = open_memstream(&batch->text, &batch->length);
+	if (f == NULL) {
+		result = ISC_R_NOMEMORY;
+	}
+
+	isc_buffer_init(&buffer, isc_mem_get(dctx->mctx, initial_buffer_length),
+			initial_buffer_length);
+
+	for (size_t i = 0; i < batch->count; i++) {
+		if (result == ISC_R_SUCCESS) {
+			result = dumpnode(dctx, batch->nodes[i],
+					  dns_fixedname_name(&batch->names[i]),
+					  options, &batch->tctx, &buffer, f);
+		}
+		dns_db_detachnode(dctx->db, &batch->nodes[i]);
+	}
+
+	if (f != NULL && fclose(f) != 0 && result == ISC_R_SUCCESS) {
+		result = ISC_R_NOMEMORY;
+	}
+
+	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
+	return (result);
+}
+
+/*
+ * Format the batches of the current round that no other thread has
+ * taken yet.  Called, and returns, with 'dp->lock' held.
+ */
+static void
+dump_formatround(dump_parallel_t *dp) {
+	while (dp->next < dp->nbatches) {
+		dump_batch_t *batch = &dp->batches[dp->next++];
+
+		UNLOCK(&dp->lock);
+		batch->result = dump_formatbatch(dp->dctx, batch, dp->options);
+		LOCK(&dp->lock);
+
+		if (++dp->formatted == dp->nbatches) {
+			SIGNAL(&dp->done);
+		}
+	}
+}
+
+static void *
+dump_worker(void *arg) {
+	dump_parallel_t *dp = arg;
+	unsigned int round = 0;
+
+	LOCK(&dp->lock);
+	for (;;) {
+		while (!dp->exiting && dp->round == round) {
+			WAIT(&dp->ready, &dp->lock);
+		}
+		if (dp->exiting) {
+			break;
+		}
+		round = dp->round;
+		dump_formatround(dp);
+	}
+	UNLOCK(&dp->lock);
+
+	return (NULL);
+}
+
+static isc_result_t
+dump_parallel(dns_dumpctx_t *dctx, unsigned int options,
+	      unsigned int nthreads) {
+	dump_parallel_t dp = { .dctx = dctx, .options = options };
+	isc_thread_t *threads = NULL;
+	isc_result_t result;
+
+	dp.batches = isc_mem_cget(dctx->mctx, nthreads, sizeof(dp.batches[0]));
+	threads = isc_mem_cget(dctx->mctx, nthreads, sizeof(threads[0]));
+
+	isc_mutex_init(&dp.lock);
+	isc_condition_init(&dp.ready);
+	isc_condition_init(&dp.done);
+
+	/*
+	 * This thread formats batches too, so one worker fewer than
+	 * there are batches in a round is needed.
+	 */
+	for (size_t i = 1; i < nthreads; i++) {
+		isc_thread_create(dump_worker, &dp, &threads[i]);
+	}
+
+	result = dump_first(dctx);
+	while (result == ISC_R_SUCCESS) {
+		isc_result_t wresult = ISC_R_SUCCESS;
+		size_t nbatches = 0;
+
+		if (atomic_load_acquire(&dctx->canceled)) {
+			result = ISC_R_CANCELED;
+			break;
+		}
+
+		/*
+		 * Collect one batch per thread, then format them all.
+		 */
+		while (result == ISC_R_SUCCESS && nbatches < nthreads) {
+			result = dump_fillbatch(dctx, &dp.batches[nbatches]);
+			nbatches++;
+		}
+		RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) ==
+			      ISC_R_SUCCESS);
+
+		LOCK(&dp.lock);
+		dp.nbatches = nbatches;
+		dp.next = 0;
+		dp.formatted = 0;
+		dp.round++;
+		BROADCAST(&dp.ready);
+		dump_formatround(&dp);
+		while (dp.formatted < dp.nbatches) {
+			WAIT(&dp.done, &dp.lock);
+		}
+		UNLOCK(&dp.lock);
+
+		/*
+		 * Write out the batches in order, stopping at the first
+		 * one that failed.
+		 */
+		for (size_t i = 0; i < nbatches; i++) {
+			dump_batch_t *batch = &dp.batches[i];
+
+			if (wresult == ISC_R_SUCCESS) {
+				wresult = batch->result;
+			}
+			if (wresult == ISC_R_SUCCESS && batch->length > 0) {
+				wresult = isc_stdio_write(batch->text, 1,
+							  batch->length,
+							  dctx->f, NULL);
+			}
+			free(batch->text);
+		}
+		if (wresult != ISC_R_SUCCESS) {
+			result = wresult;
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	LOCK(&dp.lock);
+	dp.exiting = true;
+	BROADCAST(&dp.ready);
+	UNLOCK(&dp.lock);
+	for (size_t i = 1; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	isc_condition_destroy(&dp.done);
+	isc_condition_destroy(&dp.ready);
+	isc_mutex_destroy(&dp.lock);
+
+	isc_mem_cput(dctx->mctx, threads, nthreads, sizeof(threads[0]));
+	isc_mem_cput(dctx->mctx, dp.batches, nthreads, sizeof(dp.batches[0]));
+
+	return (result);
+}
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1717,6 +2126,7 @@ dumptostream(dns_dumpctx_t *dctx) {
 	dns_name_t *name;
 	dns_fixedname_t fixname;
 	unsigned int options = DNS_DB_STALEOK;
+	unsigned int nthreads;
 
 	if ((dctx->tctx.style.flags & DNS_STYLEFLAG_EXPIRED) != 0) {
 		options |= DNS_DB_EXPIREDOK;
@@ -1730,13 +2140,21 @@ dumptostream(dns_dumpctx_t *dctx) {
 
 	CHECK(writeheader(dctx));
 
-	result = dns_dbiterator_first(dctx->dbiter);
+	nthreads = (dump_maxthreads != 0) ? dump_maxthreads : isc_os_ncpus();
+	nthreads = ISC_MIN(nthreads, DUMP_MAXTHREADS);
+	if (nthreads > 1 &&
+	    dns_db_nodecount(dctx->db, dns_dbtree_main) >= dump_parallelmin)
+	{
+		result = dump_parallel(dctx, options, nthreads);
+		goto cleanup;
+	}
+
+	result = dump_first(dctx);
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
 		goto cleanup;
 	}
 
 	while (result == ISC_R_SUCCESS) {
-		dns_rdatasetiter_t *rdsiter = NULL;
 		dns_dbnode_t *node = NULL;
 
 		result = dns_dbiterator_current(dctx->dbiter, &node, name);
@@ -1756,23 +2174,24 @@ dumptostream(dns_dumpctx_t *dctx) {
 			dctx->tctx.neworigin = origin;
 		}
 
-		result = dns_dbiterator_pause(dctx->dbiter);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-
-		result = dns_db_allrdatasets(dctx->db, node, dctx->version,
-					     options, dctx->now, &rdsiter);
+		result = dump_filtername(dctx, name);
 		if (result != ISC_R_SUCCESS) {
 			dns_db_detachnode(dctx->db, &node);
-			goto cleanup;
+			if (result == ISC_R_NOTFOUND) {
+				result = dns_dbiterator_next(dctx->dbiter);
+			}
+			continue;
 		}
-		result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
-					  &dctx->tctx, &buffer, dctx->f);
-		dns_rdatasetiter_destroy(&rdsiter);
+
+		result = dns_dbiterator_pause(dctx->dbiter);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		result = dumpnode(dctx, node, name, options, &dctx->tctx,
+				  &buffer, dctx->f);
+		dns_db_detachnode(dctx->db, &node);
 		if (result != ISC_R_SUCCESS) {
-			dns_db_detachnode(dctx->db, &node);
 			goto cleanup;
 		}
-		dns_db_detachnode(dctx->db, &node);
 		result = dns_dbiterator_next(dctx->dbiter);
 	}
 
@@ -1789,8 +2208,9 @@ isc_result_t
 dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 			     dns_dbversion_t *version,
 			     const dns_master_style_t *style, FILE *f,
-			     isc_loop_t *loop, dns_dumpdonefunc_t done,
-			     void *done_arg, dns_dumpctx_t **dctxp) {
+			     const dns_dumpfilter_t *filter, isc_loop_t *loop,
+			     dns_dumpdonefunc_t done, void *done_arg,
+			     dns_dumpctx_t **dctxp) {
 	dns_dumpctx_t *dctx = NULL;
 	isc_result_t result;
 
@@ -1799,7 +2219,7 @@ dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 	REQUIRE(done != NULL);
 
 	result = dumpctx_create(mctx, db, version, style, f, &dctx,
-				dns_masterformat_text, NULL);
+				dns_masterformat_text, NULL, filter);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
@@ -1807,7 +2227,8 @@ dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 	dctx->done_arg = done_arg;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueue_bulk(loop, master_dump_cb, master_dump_done_cb,
+			      dctx);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1821,7 +2242,7 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	isc_result_t result;
 
 	result = dumpctx_create(mctx, db, version, style, f, &dctx, format,
-				header);
+				header, NULL);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
@@ -1876,7 +2297,8 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		     const dns_master_style_t *style, const char *filename,
 		     isc_loop_t *loop, dns_dumpdonefunc_t done, void *done_arg,
 		     dns_dumpctx_t **dctxp, dns_masterformat_t format,
-		     dns_masterrawheader_t *header) {
+		     dns_masterrawheader_t *header,
+		     const dns_dumpfilter_t *filter) {
 	FILE *f = NULL;
 	isc_result_t result;
 	char *tempname = NULL;
@@ -1891,7 +2313,7 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	}
 
 	result = dumpctx_create(mctx, db, version, style, f, &dctx, format,
-				header);
+				header, filter);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_tempname;
 	}
@@ -1902,7 +2324,8 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	dctx->tmpfile = tempname;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueue_bulk(loop, master_dump_cb, master_dump_done_cb,
+			      dctx);
 
 	return (ISC_R_SUCCESS);
 
@@ -1932,7 +2355,7 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	}
 
 	result = dumpctx_create(mctx, db, version, style, f, &dctx, format,
-				header);
+				header, NULL);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
@@ -1987,3 +2410,9 @@ dns_master_styledestroy(dns_master_style_t **stylep, isc_mem_t *mctx) {
 	*stylep = NULL;
 	isc_mem_put(mctx, style, sizeof(*style));
 }
+
+void
+dns__master_setdumpparallel(size_t minnodes, unsigned int nthreads) {
+	dump_parallelmin = (minnodes != 0) ? minnodes : DUMP_PARALLEL_MIN;
+	dump_maxthreads = nthreads;
+}
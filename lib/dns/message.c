@@ -120,9 +120,17 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define OFFSET_COUNT	   4
 #define RDATA_COUNT	   8
 #define RDATALIST_COUNT	   8
+#define NAME_COUNT	   16
+#define RDATASET_COUNT	   16
 #define RDATASET_FILLCOUNT 1024
 #define RDATASET_FREEMAX   8 * RDATASET_FILLCOUNT
 
+/*%
+ * Room for the owner name and rdata of an RR read from a section that
+ * was left on the wire.
+ */
+#define STREAMDATA_SIZE (DNS_NAME_MAXWIRE + DNS_RDATA_MAXLENGTH)
+
 /*%
  * Text representation of the different items, for message_totext
  * functions.
@@ -366,6 +374,72 @@ out:
 	return (rdatalist);
 }
 
+/*
+ * Messages that were not given shared pools take their names and
+ * rdatasets from message blocks, like the rdata and rdatalists above.
+ * Everything is released at once when the message is reset; the first
+ * block is kept, so a message that is reused for every request of a
+ * client does not allocate at all once it has warmed up.
+ */
+static void
+releasename(dns_message_t *msg, dns_name_t *name) {
+	ISC_LIST_PREPEND(msg->freename, name, link);
+}
+
+static dns_fixedname_t *
+newname(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_fixedname_t *fn;
+
+	/* 'name' is the first field in dns_fixedname_t */
+	fn = (dns_fixedname_t *)ISC_LIST_HEAD(msg->freename);
+	if (fn != NULL) {
+		ISC_LIST_UNLINK(msg->freename, &fn->name, link);
+		return (fn);
+	}
+
+	msgblock = ISC_LIST_TAIL(msg->names);
+	fn = msgblock_get(msgblock, dns_fixedname_t);
+	if (fn == NULL) {
+		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_fixedname_t),
+					     NAME_COUNT);
+		ISC_LIST_APPEND(msg->names, msgblock, link);
+
+		fn = msgblock_get(msgblock, dns_fixedname_t);
+	}
+
+	return (fn);
+}
+
+static void
+releaserdataset(dns_message_t *msg, dns_rdataset_t *rdataset) {
+	ISC_LIST_PREPEND(msg->freerdataset, rdataset, link);
+}
+
+static dns_rdataset_t *
+newrdataset(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_rdataset_t *rdataset;
+
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	if (rdataset != NULL) {
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+		return (rdataset);
+	}
+
+	msgblock = ISC_LIST_TAIL(msg->rdatasets);
+	rdataset = msgblock_get(msgblock, dns_rdataset_t);
+	if (rdataset == NULL) {
+		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_rdataset_t),
+					     RDATASET_COUNT);
+		ISC_LIST_APPEND(msg->rdatasets, msgblock, link);
+
+		rdataset = msgblock_get(msgblock, dns_rdataset_t);
+	}
+
+	return (rdataset);
+}
+
 static dns_offsets_t *
 newoffsets(dns_message_t *msg) {
 	dns_msgblock_t *msgblock;
@@ -451,6 +525,10 @@ msginit(dns_message_t *m) {
 	m->saved.base = NULL;
 	m->saved.length = 0;
 	m->free_saved = 0;
+	m->streamed = 0;
+	m->streamdata = NULL;
+	m->streamrdata.base = NULL;
+	m->streamrdata.length = 0;
 	m->cc_ok = 0;
 	m->cc_bad = 0;
 	m->tkey = 0;
@@ -510,7 +588,6 @@ msgresetsigs(dns_message_t *msg, bool replying) {
 	}
 	if (msg->tsig != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->tsig));
-		INSIST(msg->namepool != NULL);
 		if (replying) {
 			INSIST(msg->querytsig == NULL);
 			msg->querytsig = msg->tsig;
@@ -571,6 +648,13 @@ msgreset(dns_message_t *msg, bool everything) {
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
 
+	/*
+	 * Names and rdatasets are initialized again when they are handed
+	 * out, so there is no need to unlink them one by one.
+	 */
+	ISC_LIST_INIT(msg->freename);
+	ISC_LIST_INIT(msg->freerdataset);
+
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
 	if (!everything) {
@@ -624,6 +708,34 @@ msgreset(dns_message_t *msg, bool everything) {
 		msgblock = next_msgblock;
 	}
 
+	/*
+	 * names and rdatasets are only used without shared pools.
+	 */
+
+	msgblock = ISC_LIST_HEAD(msg->names);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->names, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_fixedname_t));
+		msgblock = next_msgblock;
+	}
+
+	msgblock = ISC_LIST_HEAD(msg->rdatasets);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->rdatasets, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdataset_t));
+		msgblock = next_msgblock;
+	}
+
 	if (msg->tsigkey != NULL) {
 		dns_tsigkey_detach(&msg->tsigkey);
 		msg->tsigkey = NULL;
@@ -651,6 +763,11 @@ msgreset(dns_message_t *msg, bool everything) {
 		msg->saved.length = 0;
 	}
 
+	if (msg->streamdata != NULL) {
+		isc_mem_put(msg->mctx, msg->streamdata, STREAMDATA_SIZE);
+		msg->streamdata = NULL;
+	}
+
 	/*
 	 * cleanup the buffer cleanup list
 	 */
@@ -738,20 +855,19 @@ dns_message_create(isc_mem_t *mctx, isc_mempool_t *namepool,
 		.rdatas = ISC_LIST_INITIALIZER,
 		.rdatalists = ISC_LIST_INITIALIZER,
 		.offsets = ISC_LIST_INITIALIZER,
+		.names = ISC_LIST_INITIALIZER,
+		.rdatasets = ISC_LIST_INITIALIZER,
 		.freerdata = ISC_LIST_INITIALIZER,
 		.freerdatalist = ISC_LIST_INITIALIZER,
+		.freename = ISC_LIST_INITIALIZER,
+		.freerdataset = ISC_LIST_INITIALIZER,
 		.magic = DNS_MESSAGE_MAGIC,
 		.namepool = namepool,
 		.rdspool = rdspool,
-		.free_pools = (namepool == NULL && rdspool == NULL),
 	};
 
 	isc_mem_attach(mctx, &msg->mctx);
 
-	if (msg->free_pools) {
-		dns_message_createpools(mctx, &msg->namepool, &msg->rdspool);
-	}
-
 	msginit(msg);
 
 	for (size_t i = 0; i < DNS_SECTION_MAX; i++) {
@@ -784,10 +900,6 @@ dns__message_destroy(dns_message_t *msg) {
 
 	msg->magic = 0;
 
-	if (msg->free_pools) {
-		dns_message_destroypools(&msg->namepool, &msg->rdspool);
-	}
-
 	isc_mem_putanddetach(&msg->mctx, msg, sizeof(dns_message_t));
 }
 
@@ -961,6 +1073,73 @@ getrdata(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		}                            \
 	} while (0)
 
+/*
+ * Check the RRs of a section that is left on the wire, without reading
+ * their rdata, and note where they are for dns_message_firstrr().
+ */
+static isc_result_t
+skipsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
+	    dns_section_t sectionid) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	isc_region_t r;
+	unsigned int count, rdatalen;
+	dns_rdatatype_t rdtype;
+	dns_rdataclass_t rdclass;
+	isc_result_t result;
+
+	msg->streamed = 1;
+	msg->streamstart = source->current;
+	msg->streamend = source->current;
+
+	for (count = 0; count < msg->counts[sectionid]; count++) {
+		name = dns_fixedname_initname(&fixed);
+		isc_buffer_remainingregion(source, &r);
+		isc_buffer_setactive(source, r.length);
+		result = dns_name_fromwire(name, source, dctx, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+
+		isc_buffer_remainingregion(source, &r);
+		if (r.length < 2 + 2 + 4 + 2) {
+			return (ISC_R_UNEXPECTEDEND);
+		}
+		rdtype = isc_buffer_getuint16(source);
+		rdclass = isc_buffer_getuint16(source);
+		isc_buffer_forward(source, 4);
+		rdatalen = isc_buffer_getuint16(source);
+		if (r.length - (2 + 2 + 4 + 2) < rdatalen) {
+			return (ISC_R_UNEXPECTEDEND);
+		}
+		isc_buffer_forward(source, rdatalen);
+
+		/*
+		 * The pseudo-RRs that getsection() handles specially
+		 * never belong in a section that is read this way.
+		 */
+		if (rdtype == dns_rdatatype_tsig) {
+			return (DNS_R_BADTSIG);
+		}
+		if (rdtype == dns_rdatatype_opt) {
+			return (DNS_R_FORMERR);
+		}
+
+		if (msg->rdclass_set == 0) {
+			msg->rdclass = rdclass;
+			msg->rdclass_set = 1;
+		} else if (msg->rdclass != dns_rdataclass_any &&
+			   msg->rdclass != rdclass)
+		{
+			return (DNS_R_FORMERR);
+		}
+
+		msg->streamend = source->current;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static void
 cleanup_name_hashmaps(dns_namelist_t *section) {
 	dns_name_t *name = NULL;
@@ -1808,7 +1987,14 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	}
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER, options);
+	if ((options & DNS_MESSAGEPARSE_STREAMANSWER) != 0 &&
+	    msg->opcode != dns_opcode_update)
+	{
+		ret = skipsection(source, msg, dctx, DNS_SECTION_ANSWER);
+	} else {
+		ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER,
+				 options);
+	}
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -2026,6 +2212,21 @@ maybe_clear_ad(dns_message_t *msg, dns_section_t sectionid) {
 	}
 }
 
+/*
+ * Check whether 'rdataset' can fit in the rest of the buffer, from a
+ * lower bound on its rendered size, so a whole rdataset that is sure not
+ * to fit is not rendered only to be rolled back.  A partial rdataset may
+ * always fit.
+ */
+static bool
+fits(dns_message_t *msg, dns_rdataset_t *rdataset, bool partial) {
+	if (partial) {
+		return (true);
+	}
+	return (dns_rdataset_minsize(rdataset) <=
+		isc_buffer_availablelength(msg->buffer));
+}
+
 static void
 update_min_section_ttl(dns_message_t *restrict msg,
 		       const dns_section_t sectionid,
@@ -2043,6 +2244,7 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 			  unsigned int options) {
 	dns_namelist_t *section;
 	dns_name_t *name, *next_name;
+	dns_name_t *qname = NULL, *owner = NULL;
 	dns_rdataset_t *rdataset, *next_rdataset;
 	unsigned int count, total;
 	isc_result_t result;
@@ -2080,6 +2282,17 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 		rd_options = DNS_RDATASETTOWIRE_OMITDNSSEC;
 	}
 
+	/*
+	 * Owner names that are the question name are rendered with the
+	 * question name itself, in the case the client sent, so they
+	 * compress to a pointer to the question.
+	 */
+	if ((options & DNS_MESSAGERENDER_QNAMECASE) != 0 &&
+	    sectionid != DNS_SECTION_QUESTION)
+	{
+		qname = ISC_LIST_HEAD(msg->sections[DNS_SECTION_QUESTION]);
+	}
+
 	/*
 	 * Shrink the space in the buffer by the reserved amount.
 	 */
@@ -2107,7 +2320,9 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 			const void *order_arg = &msg->order_arg;
 			st = *(msg->buffer);
 			count = 0;
-			if (partial) {
+			if (!fits(msg, rdataset, partial)) {
+				result = ISC_R_NOSPACE;
+			} else if (partial) {
 				result = dns_rdataset_towirepartial(
 					rdataset, name, msg->cctx, msg->buffer,
 					msg->order, order_arg, rd_options,
@@ -2151,8 +2366,18 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 		}
 
 		while (name != NULL) {
+			unsigned int name_options = rd_options;
+
 			next_name = ISC_LIST_NEXT(name, link);
 
+			owner = name;
+			if (qname != NULL && name != qname &&
+			    dns_name_equal(name, qname))
+			{
+				owner = qname;
+				name_options |= DNS_RDATASETTOWIRE_QNAMECASE;
+			}
+
 			rdataset = ISC_LIST_HEAD(name->list);
 			while (rdataset != NULL) {
 				next_rdataset = ISC_LIST_NEXT(rdataset, link);
@@ -2175,17 +2400,19 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 				st = *(msg->buffer);
 
 				count = 0;
-				if (partial) {
+				if (!fits(msg, rdataset, partial)) {
+					result = ISC_R_NOSPACE;
+				} else if (partial) {
 					result = dns_rdataset_towirepartial(
-						rdataset, name, msg->cctx,
+						rdataset, owner, msg->cctx,
 						msg->buffer, msg->order,
-						&msg->order_arg, rd_options,
+						&msg->order_arg, name_options,
 						&count, NULL);
 				} else {
 					result = dns_rdataset_towiresorted(
-						rdataset, name, msg->cctx,
+						rdataset, owner, msg->cctx,
 						msg->buffer, msg->order,
-						&msg->order_arg, rd_options,
+						&msg->order_arg, name_options,
 						&count);
 				}
 
@@ -2254,6 +2481,29 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, dns_section_t sectionid,
+		      const isc_region_t *data, unsigned int count) {
+	isc_region_t r;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(data != NULL);
+	REQUIRE(isc_buffer_usedlength(msg->buffer) == DNS_MESSAGE_HEADERLEN);
+
+	isc_buffer_availableregion(msg->buffer, &r);
+	if (r.length < msg->reserved || r.length - msg->reserved < data->length)
+	{
+		return (ISC_R_NOSPACE);
+	}
+
+	isc_buffer_putmem(msg->buffer, data->base, data->length);
+	msg->counts[sectionid] += count;
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	uint16_t tmp;
@@ -2534,6 +2784,110 @@ dns_message_currentname(dns_message_t *msg, dns_section_t section,
 	*name = msg->cursors[section];
 }
 
+/*
+ * Read the RR at the current position of the streamed answer section,
+ * decompressing its owner name and rdata into 'streamdata', which is
+ * allocated once and reused for every RR.
+ */
+static isc_result_t
+readrr(dns_message_t *msg) {
+	isc_buffer_t *source = &msg->streamsource;
+	isc_buffer_t target;
+	isc_region_t r;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned int rdatalen;
+	isc_result_t result;
+
+	msg->streamrdata.base = NULL;
+	msg->streamrdata.length = 0;
+
+	if (isc_buffer_remaininglength(source) == 0) {
+		return (ISC_R_NOMORE);
+	}
+
+	if (msg->streamdata == NULL) {
+		msg->streamdata = isc_mem_get(msg->mctx, STREAMDATA_SIZE);
+	}
+
+	/*
+	 * skipsection() has checked the name and the lengths.
+	 */
+	dns_name_init(&msg->streamname, NULL);
+	isc_buffer_init(&target, msg->streamdata, DNS_NAME_MAXWIRE);
+	isc_buffer_remainingregion(source, &r);
+	isc_buffer_setactive(source, r.length);
+	result = dns_name_fromwire(&msg->streamname, source,
+				   DNS_DECOMPRESS_ALWAYS, &target);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	msg->streamtype = isc_buffer_getuint16(source);
+	msg->streamclass = isc_buffer_getuint16(source);
+	msg->streamttl = isc_buffer_getuint32(source);
+	rdatalen = isc_buffer_getuint16(source);
+
+	isc_buffer_init(&target, msg->streamdata + DNS_NAME_MAXWIRE,
+			DNS_RDATA_MAXLENGTH);
+	isc_buffer_setactive(source, rdatalen);
+	result = dns_rdata_fromwire(&rdata, msg->streamclass, msg->streamtype,
+				    source, DNS_DECOMPRESS_ALWAYS, &target);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * The same checks as getsection() makes on the rdata.
+	 */
+	if (msg->streamtype == dns_rdatatype_rrsig &&
+	    dns_rdata_covers(&rdata) == 0)
+	{
+		return (DNS_R_FORMERR);
+	}
+	if (msg->streamtype == dns_rdatatype_nsec3 &&
+	    !dns_rdata_checkowner(&msg->streamname, msg->rdclass,
+				  msg->streamtype, false))
+	{
+		return (DNS_R_BADOWNERNAME);
+	}
+
+	dns_rdata_toregion(&rdata, &msg->streamrdata);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_message_firstrr(dns_message_t *msg) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->streamed);
+
+	isc_buffer_init(&msg->streamsource, msg->saved.base, msg->streamend);
+	isc_buffer_add(&msg->streamsource, msg->streamend);
+	isc_buffer_forward(&msg->streamsource, msg->streamstart);
+
+	return (readrr(msg));
+}
+
+isc_result_t
+dns_message_nextrr(dns_message_t *msg) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->streamrdata.base != NULL);
+
+	return (readrr(msg));
+}
+
+void
+dns_message_currentrr(dns_message_t *msg, dns_name_t **name, dns_ttl_t *ttl,
+		      dns_rdata_t *rdata) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(name != NULL && *name == NULL);
+	REQUIRE(ttl != NULL);
+	REQUIRE(msg->streamrdata.base != NULL);
+
+	*name = &msg->streamname;
+	*ttl = msg->streamttl;
+	dns_rdata_fromregion(rdata, msg->streamclass, msg->streamtype,
+			     &msg->streamrdata);
+}
+
 isc_result_t
 dns_message_findname(dns_message_t *msg, dns_section_t section,
 		     const dns_name_t *target, dns_rdatatype_t type,
@@ -2615,7 +2969,11 @@ dns_message_gettempname(dns_message_t *msg, dns_name_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	fn = isc_mempool_get(msg->namepool);
+	if (msg->namepool != NULL) {
+		fn = isc_mempool_get(msg->namepool);
+	} else {
+		fn = newname(msg);
+	}
 	*item = dns_fixedname_initname(fn);
 }
 
@@ -2632,7 +2990,11 @@ dns_message_gettemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->rdspool);
+	if (msg->rdspool != NULL) {
+		*item = isc_mempool_get(msg->rdspool);
+	} else {
+		*item = newrdataset(msg);
+	}
 	dns_rdataset_init(*item);
 }
 
@@ -2673,7 +3035,11 @@ dns_message_puttempname(dns_message_t *msg, dns_name_t **itemp) {
 	 * back the address of name is the same as putting back
 	 * the fixedname.
 	 */
-	isc_mempool_put(msg->namepool, item);
+	if (msg->namepool != NULL) {
+		isc_mempool_put(msg->namepool, item);
+	} else {
+		releasename(msg, item);
+	}
 }
 
 void
@@ -2697,7 +3063,11 @@ dns_message_puttemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(item != NULL && *item != NULL);
 
 	REQUIRE(!dns_rdataset_isassociated(*item));
-	isc_mempool_put(msg->rdspool, *item);
+	if (msg->rdspool != NULL) {
+		isc_mempool_put(msg->rdspool, *item);
+	} else {
+		releaserdataset(msg, *item);
+	}
 	*item = NULL;
 }
 
@@ -5039,12 +5409,12 @@ dns_message_createpools(isc_mem_t *mctx, isc_mempool_t **namepoolp,
 	isc_mempool_create(mctx, sizeof(dns_fixedname_t), namepoolp);
 	isc_mempool_setfillcount(*namepoolp, NAME_FILLCOUNT);
 	isc_mempool_setfreemax(*namepoolp, NAME_FREEMAX);
-	isc_mempool_setname(*namepoolp, "dns_fixedname_pool");
+	isc_mempool_setname(*namepoolp, "dns_fixedname");
 
 	isc_mempool_create(mctx, sizeof(dns_rdataset_t), rdspoolp);
 	isc_mempool_setfillcount(*rdspoolp, RDATASET_FILLCOUNT);
 	isc_mempool_setfreemax(*rdspoolp, RDATASET_FREEMAX);
-	isc_mempool_setname(*rdspoolp, "dns_rdataset_pool");
+	isc_mempool_setname(*rdspoolp, "dns_rdataset");
 }
 
 void
@@ -239,6 +239,26 @@ dns_nsec3_generate_salt(unsigned char *salt, size_t saltlen) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Set 'name' to the owner name of the NSEC3 record for 'hash'.
+ */
+static isc_result_t
+hashtoname(unsigned char *hash, size_t length, const dns_name_t *origin,
+	   dns_name_t *name) {
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	isc_buffer_t namebuffer;
+	isc_region_t region;
+
+	/* convert the hash to base32hex non-padded */
+	region.base = hash;
+	region.length = (unsigned int)length;
+	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
+	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+
+	/* convert the hex to a domain name */
+	return (dns_name_fromtext(name, &namebuffer, origin, 0, NULL));
+}
+
 isc_result_t
 dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
@@ -247,11 +267,8 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned int iterations, const unsigned char *salt,
 		   size_t saltlength) {
 	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
-	unsigned char nametext[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t fixed;
 	dns_name_t *downcased;
-	isc_buffer_t namebuffer;
-	isc_region_t region;
 	size_t len;
 
 	if (rethash == NULL) {
@@ -273,16 +290,8 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 
 	SET_IF_NOT_NULL(hash_length, len);
 
-	/* convert the hash to base32hex non-padded */
-	region.base = rethash;
-	region.length = (unsigned int)len;
-	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
-	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
-
-	/* convert the hex to a domain name */
-	dns_fixedname_init(result);
-	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
-				  origin, 0, NULL));
+	return (hashtoname(rethash, len, origin,
+			   dns_fixedname_initname(result)));
 }
 
 unsigned int
@@ -896,6 +905,352 @@ failure:
 	return (result);
 }
 
+/*
+ * The names that dns_nsec3_buildchain() has found so far, each with its
+ * hash and node; the hashes of the last 'npending' names have not been
+ * computed yet.
+ */
+#define BUILD_BATCH   (ISC_ITERATED_HASH_BATCH * 8)
+#define BUILD_HASHLEN 20 /* SHA-1 */
+
+typedef struct chainentry {
+	unsigned char hash[BUILD_HASHLEN];
+	dns_dbnode_t *node; /* NULL for an empty non-terminal */
+} chainentry_t;
+
+typedef struct chainbuild {
+	isc_mem_t *mctx;
+	const dns_rdata_nsec3param_t *nsec3param;
+	chainentry_t *entries;
+	size_t count;
+	size_t size;
+	unsigned int npending;
+	unsigned char pending[BUILD_BATCH][DNS_NAME_MAXWIRE];
+	int pendinglen[BUILD_BATCH];
+} chainbuild_t;
+
+static isc_result_t
+chainbuild_flush(chainbuild_t *build) {
+	const dns_rdata_nsec3param_t *nsec3param = build->nsec3param;
+	const unsigned char *in[BUILD_BATCH];
+	unsigned char *out[BUILD_BATCH];
+	size_t first = build->count - build->npending;
+	int len;
+
+	if (build->npending == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (unsigned int i = 0; i < build->npending; i++) {
+		in[i] = build->pending[i];
+		out[i] = build->entries[first + i].hash;
+	}
+	len = isc_iterated_hash_batch(out, nsec3param->hash,
+				      nsec3param->iterations, nsec3param->salt,
+				      nsec3param->salt_length, in,
+				      build->pendinglen, build->npending);
+	build->npending = 0;
+	if (len != BUILD_HASHLEN) {
+		return (DNS_R_BADALG);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Queue 'name' for hashing.  The reference to '*nodep', if any, is kept
+ * until the chain has been built.
+ */
+static isc_result_t
+chainbuild_add(chainbuild_t *build, const dns_name_t *name,
+	       dns_dbnode_t **nodep) {
+	dns_fixedname_t fixed;
+	dns_name_t *downcased = dns_fixedname_initname(&fixed);
+	chainentry_t *entry = NULL;
+
+	if (build->count == build->size) {
+		size_t size = build->size * 2 + 1024;
+		build->entries = isc_mem_creget(build->mctx, build->entries,
+						build->size, size,
+						sizeof(build->entries[0]));
+		build->size = size;
+	}
+	entry = &build->entries[build->count++];
+	entry->node = NULL;
+	if (nodep != NULL) {
+		entry->node = *nodep;
+		*nodep = NULL;
+	}
+
+	dns_name_downcase(name, downcased, NULL);
+	memmove(build->pending[build->npending], downcased->ndata,
+		downcased->length);
+	build->pendinglen[build->npending] = downcased->length;
+	if (++build->npending == BUILD_BATCH) {
+		return (chainbuild_flush(build));
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static int
+chainentry_compare(const void *a, const void *b) {
+	const chainentry_t *ea = a, *eb = b;
+
+	return (memcmp(ea->hash, eb->hash, sizeof(ea->hash)));
+}
+
+/*
+ * Set '*exists' to whether the zone apex has an NSEC3 record in the
+ * chain identified by 'nsec3param'; every chain has one.
+ */
+static isc_result_t
+chain_exists(dns_db_t *db, dns_dbversion_t *version,
+	     const dns_rdata_nsec3param_t *nsec3param, bool *exists) {
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdata_nsec3_t nsec3;
+	isc_result_t result;
+
+	*exists = false;
+
+	CHECK(dns_nsec3_hashname(&fixed, NULL, NULL, dns_db_origin(db),
+				 dns_db_origin(db), nsec3param->hash,
+				 nsec3param->iterations, nsec3param->salt,
+				 nsec3param->salt_length));
+	result = dns_db_findnsec3node(db, dns_fixedname_name(&fixed), false,
+				      &node);
+	if (result == ISC_R_NOTFOUND) {
+		return (ISC_R_SUCCESS);
+	}
+	CHECK(result);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, version, dns_rdatatype_nsec3,
+				     0, (isc_stdtime_t)0, &rdataset, NULL);
+	dns_db_detachnode(db, &node);
+	if (result == ISC_R_NOTFOUND) {
+		return (ISC_R_SUCCESS);
+	}
+	CHECK(result);
+
+	result = find_nsec3(&nsec3, &rdataset, nsec3param);
+	dns_rdataset_disassociate(&rdataset);
+	if (result == ISC_R_SUCCESS) {
+		*exists = true;
+	} else if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+failure:
+	return (result);
+}
+
+isc_result_t
+dns_nsec3_buildchain(dns_db_t *db, dns_dbversion_t *version,
+		     const dns_rdata_nsec3param_t *nsec3param,
+		     dns_ttl_t nsecttl, bool *seen_nsec, dns_diff_t *diff) {
+	chainbuild_t *build = NULL;
+	dns_dbiterator_t *dbit = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *iter = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_difftuple_t *tuple = NULL;
+	dns_diff_t chain;
+	dns_fixedname_t fname, fprev, fcut, fhash;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *prev = dns_fixedname_initname(&fprev);
+	dns_name_t *cut = dns_fixedname_initname(&fcut);
+	dns_name_t *hashname = dns_fixedname_initname(&fhash);
+	dns_name_t *origin = dns_db_origin(db);
+	unsigned int originlabels = dns_name_countlabels(origin);
+	unsigned char nsec3buf[DNS_NSEC3_BUFFERSIZE];
+	uint8_t flags = nsec3param->flags & DNS_NSEC3FLAG_OPTOUT;
+	bool exists;
+	isc_result_t result;
+
+	REQUIRE(version != NULL);
+	REQUIRE(seen_nsec != NULL);
+	REQUIRE(DNS_DIFF_VALID(diff));
+
+	*seen_nsec = false;
+
+	if (nsec3param->hash != dns_hash_sha1) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	CHECK(chain_exists(db, version, nsec3param, &exists));
+	if (exists) {
+		return (ISC_R_EXISTS);
+	}
+
+	dns_diff_init(diff->mctx, &chain);
+	dns_rdataset_init(&rdataset);
+	build = isc_mem_get(diff->mctx, sizeof(*build));
+	*build = (chainbuild_t){
+		.mctx = diff->mctx,
+		.nsec3param = nsec3param,
+	};
+
+	/*
+	 * Find the names that need an NSEC3 record, in the same way as
+	 * zone_nsec3chain() does: skip the names below a zone cut or a
+	 * DNAME, and the insecure delegations if the chain is opt-out.
+	 * The names come in canonical order, so the empty non-terminals
+	 * above a name that have not been seen yet are those below its
+	 * closest common ancestor with the previous name.
+	 */
+	CHECK(dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit));
+	for (result = dns_dbiterator_first(dbit); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbit))
+	{
+		bool seen_soa = false, seen_ns = false, seen_ds = false;
+		bool seen_dname = false, seen_rr = false;
+		unsigned int labels, common = originlabels;
+
+		CHECK(dns_dbiterator_current(dbit, &node, name));
+		CHECK(dns_dbiterator_pause(dbit));
+
+		if (dns_name_countlabels(cut) != 0 &&
+		    dns_name_issubdomain(name, cut))
+		{
+			dns_db_detachnode(db, &node);
+			continue;
+		}
+
+		result = dns_db_allrdatasets(db, node, version, 0, 0, &iter);
+		if (result == ISC_R_NOTFOUND) {
+			dns_db_detachnode(db, &node);
+			continue;
+		}
+		CHECK(result);
+		for (result = dns_rdatasetiter_first(iter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(iter))
+		{
+			dns_rdatasetiter_current(iter, &rdataset);
+			switch (rdataset.type) {
+			case dns_rdatatype_soa:
+				seen_soa = true;
+				break;
+			case dns_rdatatype_ns:
+				seen_ns = true;
+				break;
+			case dns_rdatatype_ds:
+				seen_ds = true;
+				break;
+			case dns_rdatatype_dname:
+				seen_dname = true;
+				break;
+			case dns_rdatatype_nsec:
+				*seen_nsec = true;
+				break;
+			default:
+				break;
+			}
+			seen_rr = true;
+			dns_rdataset_disassociate(&rdataset);
+		}
+		dns_rdatasetiter_destroy(&iter);
+		if (result != ISC_R_NOMORE) {
+			goto failure;
+		}
+		if (!seen_rr) {
+			dns_db_detachnode(db, &node);
+			continue;
+		}
+
+		if ((seen_ns && !seen_soa) || seen_dname) {
+			dns_name_copy(name, cut);
+		}
+		if (seen_ns && !seen_soa && !seen_ds && OPTOUT(flags)) {
+			dns_db_detachnode(db, &node);
+			continue;
+		}
+
+		labels = dns_name_countlabels(name);
+		if (dns_name_countlabels(prev) != 0) {
+			int order;
+			unsigned int nlabels;
+
+			(void)dns_name_fullcompare(name, prev, &order,
+						   &nlabels);
+			common = ISC_MAX(common, nlabels);
+		}
+		for (unsigned int n = labels - 1; n > common; n--) {
+			dns_name_t empty;
+
+			dns_name_init(&empty, NULL);
+			dns_name_getlabelsequence(name, labels - n, n, &empty);
+			CHECK(chainbuild_add(build, &empty, NULL));
+		}
+		CHECK(chainbuild_add(build, name, &node));
+		dns_name_copy(name, prev);
+	}
+	if (result != ISC_R_NOMORE) {
+		goto failure;
+	}
+	dns_dbiterator_destroy(&dbit);
+	CHECK(chainbuild_flush(build));
+
+	/*
+	 * Link the hashes into a chain.
+	 */
+	qsort(build->entries, build->count, sizeof(build->entries[0]),
+	      chainentry_compare);
+	for (size_t i = 0; i < build->count; i++) {
+		chainentry_t *entry = &build->entries[i];
+		chainentry_t *next = &build->entries[(i + 1) % build->count];
+
+		if (i > 0 && chainentry_compare(entry - 1, entry) == 0) {
+			CHECK(DNS_R_NSEC3RESALT);
+		}
+
+		CHECK(dns_nsec3_buildrdata(
+			db, version, entry->node, nsec3param->hash, flags,
+			nsec3param->iterations, nsec3param->salt,
+			nsec3param->salt_length, next->hash,
+			sizeof(next->hash), nsec3buf, &rdata));
+		CHECK(hashtoname(entry->hash, sizeof(entry->hash), origin,
+				 hashname));
+		dns_difftuple_create(diff->mctx, DNS_DIFFOP_ADD, hashname,
+				     nsecttl, &rdata, &tuple);
+		dns_diff_append(&chain, &tuple);
+		dns_rdata_reset(&rdata);
+	}
+
+	/*
+	 * None of the records existed, so there is nothing in 'diff' for
+	 * them to cancel.
+	 */
+	CHECK(dns_diff_apply(&chain, db, version));
+	ISC_LIST_APPENDLIST(diff->tuples, chain.tuples, link);
+
+failure:
+	if (build != NULL) {
+		for (size_t i = 0; i < build->count; i++) {
+			if (build->entries[i].node != NULL) {
+				dns_db_detachnode(db, &build->entries[i].node);
+			}
+		}
+		if (build->entries != NULL) {
+			isc_mem_cput(build->mctx, build->entries, build->size,
+				     sizeof(build->entries[0]));
+		}
+		isc_mem_put(build->mctx, build, sizeof(*build));
+		dns_diff_clear(&chain);
+	}
+	if (dbit != NULL) {
+		dns_dbiterator_destroy(&dbit);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	return (result);
+}
+
 /*%
  * Add NSEC3 records for "name", recording the change in "diff".
  * The existing NSEC3 records are removed.
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/loop.h>
@@ -64,6 +65,12 @@ struct dns__nta {
 	bool shuttingdown;
 };
 
+/*
+ * Incremented whenever an NTA table is created or changed, so that the
+ * answer of a lookup can be reused for as long as it stays the same.
+ */
+static atomic_uint_fast64_t generation = 1;
+
 #define NTA_MAGIC     ISC_MAGIC('N', 'T', 'A', 'n')
 #define VALID_NTA(nn) ISC_MAGIC_VALID(nn, NTA_MAGIC)
 
@@ -133,9 +140,15 @@ dns_ntatable_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 	isc_refcount_init(&ntatable->references, 1);
 
 	ntatable->magic = NTATABLE_MAGIC;
+	atomic_fetch_add_release(&generation, 1);
 	*ntatablep = ntatable;
 }
 
+uint64_t
+dns_ntatable_generation(void) {
+	return (atomic_load_acquire(&generation));
+}
+
 static void
 dns__ntatable_destroy(dns_ntatable_t *ntatable) {
 	ntatable->magic = 0;
@@ -339,6 +352,7 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(ntatable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
 
 	return (result);
@@ -362,6 +376,7 @@ dns_ntatable_delete(dns_ntatable_t *ntatable, const dns_name_t *name) {
 	}
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(ntatable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 
 	return (result);
 }
@@ -392,6 +407,7 @@ delete_expired(void *arg) {
 	}
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(ntatable->table, &qp);
+	atomic_fetch_add_release(&generation, 1);
 	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
 	dns__nta_detach(&nta);
 	dns_ntatable_detach(&ntatable);
@@ -24,25 +24,69 @@
 #include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/order.h>
+#include <dns/qp.h>
 #include <dns/rdataset.h>
 #include <dns/types.h>
 
+/*
+ * With up to this many entries, dns_order_find() just walks the list;
+ * beyond it, it uses the trie.
+ */
+#define ORDER_LINEAR_MAX 8
+
 typedef struct dns_order_ent dns_order_ent_t;
 struct dns_order_ent {
 	dns_fixedname_t name;
 	dns_rdataclass_t rdclass;
 	dns_rdatatype_t rdtype;
 	unsigned int mode;
+	unsigned int index;
 	ISC_LINK(dns_order_ent_t) link;
+	ISC_LINK(dns_order_ent_t) nodelink;
+};
+
+/*
+ * The entries are also kept in a QP trie, by name for the exact
+ * entries and by the parent of the wildcard for the wildcard ones.
+ * A lookup then only has to consider the entries hanging off the
+ * name and its ancestors, which the trie finds in a single walk.
+ */
+typedef struct order_node order_node_t;
+struct order_node {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	dns_name_t name;
+	ISC_LIST(dns_order_ent_t) exact;
+	ISC_LIST(dns_order_ent_t) wild;
 };
 
 struct dns_order {
 	unsigned int magic;
 	isc_refcount_t references;
 	ISC_LIST(dns_order_ent_t) ents;
+	unsigned int count;
+	dns_qpmulti_t *table;
 	isc_mem_t *mctx;
 };
 
+ISC_REFCOUNT_STATIC_DECL(order_node);
+
+static void
+qp_attach(void *uctx, void *pval, uint32_t ival);
+static void
+qp_detach(void *uctx, void *pval, uint32_t ival);
+static size_t
+qp_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival);
+static void
+qp_triename(void *uctx, char *buf, size_t size);
+
+static dns_qpmethods_t qpmethods = {
+	qp_attach,
+	qp_detach,
+	qp_makekey,
+	qp_triename,
+};
+
 #define DNS_ORDER_MAGIC	       ISC_MAGIC('O', 'r', 'd', 'r')
 #define DNS_ORDER_VALID(order) ISC_MAGIC_VALID(order, DNS_ORDER_MAGIC)
 
@@ -55,6 +99,9 @@ dns_order_create(isc_mem_t *mctx, dns_order_t **orderp) {
 	order = isc_mem_get(mctx, sizeof(*order));
 
 	ISC_LIST_INIT(order->ents);
+	order->count = 0;
+	order->table = NULL;
+	dns_qpmulti_create(mctx, &qpmethods, order, &order->table);
 
 	/* Implicit attach. */
 	isc_refcount_init(&order->references, 1);
@@ -71,6 +118,12 @@ dns_order_add(dns_order_t *order, const dns_name_t *name,
 	      dns_rdatatype_t rdtype, dns_rdataclass_t rdclass,
 	      unsigned int mode) {
 	dns_order_ent_t *ent;
+	order_node_t *node = NULL;
+	dns_name_t parent;
+	const dns_name_t *key = name;
+	bool wild = dns_name_iswildcard(name);
+	dns_qp_t *qp = NULL;
+	isc_result_t result;
 
 	REQUIRE(DNS_ORDER_VALID(order));
 	REQUIRE(mode == DNS_RDATASETATTR_RANDOMIZE ||
@@ -85,8 +138,49 @@ dns_order_add(dns_order_t *order, const dns_name_t *name,
 	ent->rdtype = rdtype;
 	ent->rdclass = rdclass;
 	ent->mode = mode;
+	ent->index = order->count++;
 	ISC_LINK_INIT(ent, link);
+	ISC_LINK_INIT(ent, nodelink);
 	ISC_LIST_INITANDAPPEND(order->ents, ent, link);
+
+	if (wild) {
+		dns_name_init(&parent, NULL);
+		dns_name_getlabelsequence(name, 1,
+					  dns_name_countlabels(name) - 1,
+					  &parent);
+		key = &parent;
+	}
+
+	/*
+	 * The order is only changed while it is being configured, before
+	 * it is used, so the entries can be added to a node in place.
+	 */
+	dns_qpmulti_write(order->table, &qp);
+	result = dns_qp_getname(qp, key, (void **)&node, NULL);
+	if (result != ISC_R_SUCCESS) {
+		order_node_t *new = isc_mem_get(order->mctx, sizeof(*new));
+		*new = (order_node_t){
+			.name = DNS_NAME_INITEMPTY,
+			.exact = ISC_LIST_INITIALIZER,
+			.wild = ISC_LIST_INITIALIZER,
+		};
+		isc_mem_attach(order->mctx, &new->mctx);
+		isc_refcount_init(&new->references, 1);
+		dns_name_dupwithoffsets(key, order->mctx, &new->name);
+		result = dns_qp_insert(qp, new, 0);
+		INSIST(result == ISC_R_SUCCESS);
+
+		/* The trie holds a reference now. */
+		node = new;
+		order_node_detach(&new);
+	}
+	if (wild) {
+		ISC_LIST_APPEND(node->wild, ent, nodelink);
+	} else {
+		ISC_LIST_APPEND(node->exact, ent, nodelink);
+	}
+	dns_qpmulti_commit(order->table, &qp);
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -98,12 +192,78 @@ match(const dns_name_t *name1, const dns_name_t *name2) {
 	return (dns_name_equal(name1, name2));
 }
 
+static bool
+entmatch(dns_order_ent_t *ent, dns_rdatatype_t rdtype,
+	 dns_rdataclass_t rdclass) {
+	return ((ent->rdtype == rdtype || ent->rdtype == dns_rdatatype_any) &&
+		(ent->rdclass == rdclass || ent->rdclass == dns_rdataclass_any));
+}
+
+/*
+ * Find the first entry in 'list' that matches, if it comes before
+ * '*bestp'.
+ */
+static void
+findbest(dns_order_ent_t *ent, dns_rdatatype_t rdtype,
+	 dns_rdataclass_t rdclass, dns_order_ent_t **bestp) {
+	for (; ent != NULL; ent = ISC_LIST_NEXT(ent, nodelink)) {
+		if (*bestp != NULL && ent->index > (*bestp)->index) {
+			return;
+		}
+		if (entmatch(ent, rdtype, rdclass)) {
+			*bestp = ent;
+			return;
+		}
+	}
+}
+
+static unsigned int
+find_trie(dns_order_t *order, const dns_name_t *name, dns_rdatatype_t rdtype,
+	  dns_rdataclass_t rdclass) {
+	isc_result_t result;
+	dns_qpread_t qpr;
+	dns_qpchain_t chain;
+	dns_order_ent_t *best = NULL;
+	order_node_t *node = NULL;
+	unsigned int len;
+
+	dns_qpmulti_query(order->table, &qpr);
+	result = dns_qp_lookup(&qpr, name, NULL, NULL, &chain, NULL, NULL);
+	if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH) {
+		dns_qpread_destroy(order->table, &qpr);
+		return (DNS_RDATASETATTR_NONE);
+	}
+
+	/*
+	 * The exact entries apply to the name itself, and the wildcard
+	 * entries to the names below their node.
+	 */
+	len = dns_qpchain_length(&chain);
+	for (unsigned int i = 0; i < len; i++) {
+		dns_qpchain_node(&chain, i, NULL, (void **)&node, NULL);
+		if (i == len - 1 && result == ISC_R_SUCCESS) {
+			findbest(ISC_LIST_HEAD(node->exact), rdtype, rdclass,
+				 &best);
+		} else {
+			findbest(ISC_LIST_HEAD(node->wild), rdtype, rdclass,
+				 &best);
+		}
+	}
+	dns_qpread_destroy(order->table, &qpr);
+
+	return (best != NULL ? best->mode : DNS_RDATASETATTR_NONE);
+}
+
 unsigned int
 dns_order_find(dns_order_t *order, const dns_name_t *name,
 	       dns_rdatatype_t rdtype, dns_rdataclass_t rdclass) {
 	dns_order_ent_t *ent;
 	REQUIRE(DNS_ORDER_VALID(order));
 
+	if (order->count > ORDER_LINEAR_MAX) {
+		return (find_trie(order, name, rdtype, rdclass));
+	}
+
 	for (ent = ISC_LIST_HEAD(order->ents); ent != NULL;
 	     ent = ISC_LIST_NEXT(ent, link))
 	{
@@ -140,6 +300,7 @@ dns_order_detach(dns_order_t **orderp) {
 	if (isc_refcount_decrement(&order->references) == 1) {
 		isc_refcount_destroy(&order->references);
 		order->magic = 0;
+		dns_qpmulti_destroy(&order->table);
 		dns_order_ent_t *ent;
 		while ((ent = ISC_LIST_HEAD(order->ents)) != NULL) {
 			ISC_LIST_UNLINK(order->ents, ent, link);
@@ -148,3 +309,37 @@ dns_order_detach(dns_order_t **orderp) {
 		isc_mem_putanddetach(&order->mctx, order, sizeof(*order));
 	}
 }
+
+static void
+destroy_order_node(order_node_t *node) {
+	dns_name_free(&node->name, node->mctx);
+	isc_mem_putanddetach(&node->mctx, node, sizeof(*node));
+}
+
+ISC_REFCOUNT_STATIC_IMPL(order_node, destroy_order_node);
+
+static void
+qp_attach(void *uctx ISC_ATTR_UNUSED, void *pval,
+	  uint32_t ival ISC_ATTR_UNUSED) {
+	order_node_t *node = pval;
+	order_node_ref(node);
+}
+
+static void
+qp_detach(void *uctx ISC_ATTR_UNUSED, void *pval,
+	  uint32_t ival ISC_ATTR_UNUSED) {
+	order_node_t *node = pval;
+	order_node_detach(&node);
+}
+
+static size_t
+qp_makekey(dns_qpkey_t key, void *uctx ISC_ATTR_UNUSED, void *pval,
+	   uint32_t ival ISC_ATTR_UNUSED) {
+	order_node_t *node = pval;
+	return (dns_qpkey_fromname(key, &node->name));
+}
+
+static void
+qp_triename(void *uctx ISC_ATTR_UNUSED, char *buf, size_t size) {
+	snprintf(buf, size, "rrset-order");
+}
@@ -19,19 +19,24 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+#include <limits.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #endif
 
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -46,6 +51,7 @@
 #include <dns/qp.h>
 #include <dns/types.h>
 
+#include "probes.h"
 #include "qp_p.h"
 
 #ifndef DNS_QP_LOG_STATS
@@ -58,13 +64,37 @@
 /*
  * very basic garbage collector statistics
  *
- * XXXFANF for now we're logging GC times, but ideally we should
- * accumulate stats more quietly and report via the statschannel
+ * Total GC times are logged, and the durations of individual
+ * compactions are collected in a histogram for the statschannel.
  */
 static atomic_uint_fast64_t compact_time;
 static atomic_uint_fast64_t recycle_time;
 static atomic_uint_fast64_t rollback_time;
 
+static isc_mem_t *compact_mctx = NULL;
+static isc_histo_t *compact_histo = NULL;
+
+/* three significant bits are plenty for pause times */
+#define COMPACT_HISTO_SIGBITS 3
+
+void
+dns__qp_initialize(void) ISC_CONSTRUCTOR;
+void
+dns__qp_shutdown(void) ISC_DESTRUCTOR;
+
+void
+dns__qp_initialize(void) {
+	isc_mem_create(&compact_mctx);
+	isc_mem_setname(compact_mctx, "qp-gc");
+	isc_histo_create(compact_mctx, COMPACT_HISTO_SIGBITS, &compact_histo);
+}
+
+void
+dns__qp_shutdown(void) {
+	isc_histo_destroy(&compact_histo);
+	isc_mem_destroy(&compact_mctx);
+}
+
 /* for LOG_STATS() format strings */
 #define PRItime " %" PRIu64 " ns "
 
@@ -233,12 +263,19 @@ dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name) {
 	while (label-- > 0) {
 		const uint8_t *ldata = name->ndata + name->offsets[label];
 		size_t label_len = *ldata++;
+		/*
+		 * Branch-free: always store both halves, and only step
+		 * over bit_two if it is an escape. A stray zero is
+		 * overwritten by the next byte or the label terminator;
+		 * the key has room because names are at most
+		 * DNS_NAME_MAXWIRE bytes and each becomes at most two
+		 * elements.
+		 */
 		while (label_len-- > 0) {
 			uint16_t bits = dns_qp_bits_for_byte[*ldata++];
-			key[len++] = bits & 0xFF;	/* bit_one */
-			if ((bits >> 8) != 0) {		/* escape? */
-				key[len++] = bits >> 8; /* bit_two */
-			}
+			key[len] = bits & 0xFF;	 /* bit_one */
+			key[len + 1] = bits >> 8; /* bit_two or zero */
+			len += 1 + ((bits >> 8) != 0);
 		}
 		/* label terminator */
 		key[len++] = SHIFT_NOBYTE;
@@ -381,7 +418,7 @@ chunk_size_raw(void) {
 }
 
 static void *
-chunk_get_raw(dns_qp_t *qp) {
+chunk_get_raw(dns_qp_t *qp, dns_qpchunk_t chunk ISC_ATTR_UNUSED) {
 	if (qp->write_protect) {
 		size_t size = chunk_size_raw();
 		void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
@@ -394,7 +431,8 @@ chunk_get_raw(dns_qp_t *qp) {
 }
 
 static void
-chunk_free_raw(dns_qp_t *qp, void *ptr) {
+chunk_free_raw(dns_qp_t *qp, dns_qpchunk_t chunk) {
+	void *ptr = qp->base->ptr[chunk];
 	if (qp->write_protect) {
 		RUNTIME_CHECK(munmap(ptr, chunk_size_raw()) == 0);
 	} else {
@@ -403,7 +441,8 @@ chunk_free_raw(dns_qp_t *qp, void *ptr) {
 }
 
 static void *
-chunk_shrink_raw(dns_qp_t *qp, void *ptr, size_t bytes) {
+chunk_shrink_raw(dns_qp_t *qp, dns_qpchunk_t chunk, size_t bytes) {
+	void *ptr = qp->base->ptr[chunk];
 	if (qp->write_protect) {
 		return (ptr);
 	} else {
@@ -425,12 +464,81 @@ write_protect(dns_qp_t *qp, dns_qpchunk_t chunk) {
 	}
 }
 
+#elif defined(__linux__) && defined(SYS_mbind)
+
+/*
+ * On a multi-socket machine, the chunks of a big read-mostly trie
+ * would all be placed on the node of the thread that loaded it, so
+ * that readers running on the other nodes pay for remote memory on
+ * every lookup. When the `interleave` flag is set, the pages of each
+ * chunk are spread across all nodes, which evens out the lookup latency.
+ *
+ * Chunks are still allocated from the trie's memory context, so they
+ * are accounted as usual and do not each need a separate mapping; only
+ * the pages that lie entirely within the chunk are rebound. We only do
+ * this once the trie has outgrown its first chunk, since small tries
+ * are rarely hot enough for it to matter, and interleaved chunks are
+ * not shrunk, because reallocating them would undo it.
+ */
+
+#define QP_MPOL_INTERLEAVE 3
+#define QP_MPOL_MF_MOVE	   (1 << 1)
+
+static void
+chunk_interleave(void *ptr, size_t size) {
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGE_SIZE);
+	uintptr_t start = ((uintptr_t)ptr + page - 1) & ~(page - 1);
+	uintptr_t end = ((uintptr_t)ptr + size) & ~(page - 1);
+	unsigned long nodemask = ~0UL;
+	unsigned int nodes = ISC_MIN(isc_os_numanodes(),
+				     sizeof(nodemask) * CHAR_BIT);
+
+	if (end <= start) {
+		return;
+	}
+	if (nodes < sizeof(nodemask) * CHAR_BIT) {
+		nodemask = (1UL << nodes) - 1;
+	}
+	/* failure only means the pages stay on the local node */
+	(void)syscall(SYS_mbind, (void *)start, end - start,
+		      QP_MPOL_INTERLEAVE, &nodemask, nodes + 1,
+		      QP_MPOL_MF_MOVE);
+}
+
+static void *
+chunk_get_raw(dns_qp_t *qp, dns_qpchunk_t chunk) {
+	void *ptr = isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES);
+	if (qp->interleave && qp->used_count >= QP_CHUNK_SIZE) {
+		chunk_interleave(ptr, QP_CHUNK_BYTES);
+		qp->usage[chunk].interleaved = true;
+	}
+	return (ptr);
+}
+
+static void
+chunk_free_raw(dns_qp_t *qp, dns_qpchunk_t chunk) {
+	isc_mem_free(qp->mctx, qp->base->ptr[chunk]);
+}
+
+static void *
+chunk_shrink_raw(dns_qp_t *qp, dns_qpchunk_t chunk, size_t bytes) {
+	void *ptr = qp->base->ptr[chunk];
+	if (qp->usage[chunk].interleaved) {
+		return (ptr);
+	} else {
+		return (isc_mem_reallocate(qp->mctx, ptr, bytes));
+	}
+}
+
+#define write_protect(qp, chunk)
+
 #else
 
-#define chunk_get_raw(qp)	isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES)
-#define chunk_free_raw(qp, ptr) isc_mem_free(qp->mctx, ptr)
+#define chunk_get_raw(qp, chunk) isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES)
+#define chunk_free_raw(qp, chunk) isc_mem_free(qp->mctx, qp->base->ptr[chunk])
 
-#define chunk_shrink_raw(qp, ptr, size) isc_mem_reallocate(qp->mctx, ptr, size)
+#define chunk_shrink_raw(qp, chunk, size) \
+	isc_mem_reallocate(qp->mctx, qp->base->ptr[chunk], size)
 
 #define write_protect(qp, chunk)
 
@@ -465,8 +573,8 @@ chunk_alloc(dns_qp_t *qp, dns_qpchunk_t chunk, dns_qpweight_t size) {
 	INSIST(qp->usage[chunk].used == 0);
 	INSIST(qp->usage[chunk].free == 0);
 
-	qp->base->ptr[chunk] = chunk_get_raw(qp);
 	qp->usage[chunk] = (qp_usage_t){ .exists = true, .used = size };
+	qp->base->ptr[chunk] = chunk_get_raw(qp, chunk);
 	qp->used_count += size;
 	qp->bump = chunk;
 	qp->fender = 0;
@@ -654,7 +762,7 @@ chunk_free(dns_qp_t *qp, dns_qpchunk_t chunk) {
 		}
 	}
 	chunk_discount(qp, chunk);
-	chunk_free_raw(qp, qp->base->ptr[chunk]);
+	chunk_free_raw(qp, chunk);
 	qp->base->ptr[chunk] = NULL;
 	qp->usage[chunk] = (qp_usage_t){};
 }
@@ -925,6 +1033,70 @@ compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent) {
 	return (twigs_ref);
 }
 
+/*
+ * Incremental version of compact_recursive(), which gives up when the
+ * `budget` of twigs has been used, and records the path to where it
+ * stopped so that the next step can carry on from there. The twigs
+ * that were moved before stopping are still linked back up to the root
+ * as the recursion unwinds.
+ */
+static dns_qpref_t
+compact_step_recursive(dns_qp_t *qp, dns_qpnode_t *parent, unsigned int depth,
+		       bool resume, dns_qpcell_t *budget) {
+	dns_qpweight_t size = branch_twigs_size(parent);
+	dns_qpref_t twigs_ref = branch_twigs_ref(parent);
+	dns_qpchunk_t chunk = ref_chunk(twigs_ref);
+	dns_qpweight_t start = 0;
+
+	INSIST(depth < ARRAY_SIZE(qp->compact_path));
+
+	if (resume && depth < qp->compact_depth) {
+		start = qp->compact_path[depth];
+	} else {
+		resume = false;
+	}
+
+	if (qp->compact_all ||
+	    (chunk != qp->bump && chunk_usage(qp, chunk) < QP_MIN_USED))
+	{
+		twigs_ref = evacuate(qp, parent);
+	}
+	*budget -= ISC_MIN(*budget, size);
+
+	bool immutable = cells_immutable(qp, twigs_ref);
+	for (dns_qpweight_t pos = start; pos < size; pos++) {
+		dns_qpnode_t *child = ref_ptr(qp, twigs_ref) + pos;
+		if (!is_branch(child)) {
+			continue;
+		}
+		if (*budget == 0) {
+			qp->compact_stopped = true;
+			qp->compact_depth = depth + 1;
+		}
+		if (qp->compact_stopped) {
+			qp->compact_path[depth] = pos;
+			break;
+		}
+		dns_qpref_t old_grandtwigs = branch_twigs_ref(child);
+		dns_qpref_t new_grandtwigs = compact_step_recursive(
+			qp, child, depth + 1, resume && pos == start, budget);
+		if (old_grandtwigs != new_grandtwigs) {
+			if (immutable) {
+				twigs_ref = evacuate(qp, parent);
+				/* the twigs have moved */
+				child = ref_ptr(qp, twigs_ref) + pos;
+				immutable = false;
+			}
+			*child = make_node(branch_index(child), new_grandtwigs);
+		}
+		if (qp->compact_stopped) {
+			qp->compact_path[depth] = pos;
+			break;
+		}
+	}
+	return (twigs_ref);
+}
+
 static void
 compact(dns_qp_t *qp) {
 	LOG_STATS("qp compact before leaf %u live %u used %u free %u hold %u",
@@ -941,9 +1113,13 @@ compact(dns_qp_t *qp) {
 		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp));
 	}
 	qp->compact_all = false;
+	qp->compact_depth = 0;
 
 	isc_nanosecs_t time = isc_time_monotonic() - start;
 	atomic_fetch_add_relaxed(&compact_time, time);
+	isc_histo_inc(compact_histo, time / NS_PER_US);
+	LIBDNS_QP_COMPACT(qp, qp->used_count - qp->free_count, qp->free_count,
+			  time);
 
 	LOG_STATS("qp compact" PRItime
 		  "leaf %u live %u used %u free %u hold %u",
@@ -951,12 +1127,61 @@ compact(dns_qp_t *qp) {
 		  qp->used_count, qp->free_count, qp->hold_count);
 }
 
+/*
+ * Do one bounded step of an incremental compaction pass. Returns true
+ * when the pass has covered the whole trie.
+ */
+static bool
+compact_step(dns_qp_t *qp) {
+	dns_qpcell_t budget = QP_COMPACT_STEP;
+	isc_nanosecs_t start = isc_time_monotonic();
+	bool finished;
+
+	if (qp->usage[qp->bump].free > QP_MAX_FREE) {
+		alloc_reset(qp);
+	}
+
+	qp->compact_stopped = false;
+	if (qp->leaf_count > 0) {
+		qp->root_ref = compact_step_recursive(qp, MOVABLE_ROOT(qp), 0,
+						      true, &budget);
+	}
+	finished = !qp->compact_stopped;
+	if (finished) {
+		qp->compact_all = false;
+		qp->compact_depth = 0;
+	}
+
+	isc_nanosecs_t time = isc_time_monotonic() - start;
+	atomic_fetch_add_relaxed(&compact_time, time);
+	isc_histo_inc(compact_histo, time / NS_PER_US);
+	LIBDNS_QP_COMPACT(qp, qp->used_count - qp->free_count, qp->free_count,
+			  time);
+
+	LOG_STATS("qp compact step" PRItime
+		  "%s leaf %u live %u used %u free %u hold %u",
+		  time, finished ? "finished" : "stopped", qp->leaf_count,
+		  qp->used_count - qp->free_count, qp->used_count,
+		  qp->free_count, qp->hold_count);
+
+	return (finished);
+}
+
 void
 dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
 	REQUIRE(QP_VALID(qp));
 	if (mode == DNS_QPGC_MAYBE && !QP_NEEDGC(qp)) {
 		return;
 	}
+	if (mode == DNS_QPGC_STEP) {
+		if (QP_NEEDGC(qp) || qp->compact_all ||
+		    qp->compact_depth > 0)
+		{
+			compact_step(qp);
+			recycle(qp);
+		}
+		return;
+	}
 	if (mode == DNS_QPGC_ALL) {
 		alloc_reset(qp);
 		qp->compact_all = true;
@@ -989,15 +1214,15 @@ static inline bool
 squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 	bool destroyed = free_twigs(qp, twigs, size);
 	if (destroyed && QP_AUTOGC(qp)) {
-		compact(qp);
+		bool finished = compact_step(qp);
 		recycle(qp);
 		/*
-		 * This shouldn't happen if the garbage collector is
-		 * working correctly. We can recover at the cost of some
-		 * time and space, but recovery should be cheaper than
-		 * letting compact+recycle fail repeatedly.
+		 * This shouldn't happen after a whole pass if the garbage
+		 * collector is working correctly. We can recover at the
+		 * cost of some time and space, but recovery should be
+		 * cheaper than letting compact+recycle fail repeatedly.
 		 */
-		if (QP_AUTOGC(qp)) {
+		if (finished && QP_AUTOGC(qp)) {
 			isc_log_write(DNS_LOGCATEGORY_DATABASE,
 				      DNS_LOGMODULE_QP, ISC_LOG_NOTICE,
 				      "qp %p uctx \"%s\" compact/recycle "
@@ -1076,6 +1301,13 @@ dns_qp_gctime(isc_nanosecs_t *compact_p, isc_nanosecs_t *recycle_p,
 	*rollback_p = atomic_load_relaxed(&rollback_time);
 }
 
+void
+dns_qp_gcpauses(isc_histo_t **hgp) {
+	REQUIRE(hgp != NULL);
+
+	isc_histo_merge(hgp, compact_histo);
+}
+
 /***********************************************************************
  *
  *  read-write transactions
@@ -1199,6 +1431,9 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 	dns_qp_t *qp = *qptp;
 	TRACE("");
 
+	isc_nanosecs_t start = LIBDNS_QP_COMMIT_ENABLED() ? isc_time_monotonic()
+							 : 0;
+
 	if (qp->transaction_mode == QP_UPDATE) {
 		INSIST(multi->rollback != NULL);
 		/* paired with dns_qpmulti_update() */
@@ -1219,11 +1454,11 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 	}
 
 	if (qp->transaction_mode == QP_UPDATE) {
-		/* minimize memory overhead */
-		compact(qp);
+		/* minimize memory overhead, a step at a time */
+		compact_step(qp);
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
 		qp->base->ptr[qp->bump] = chunk_shrink_raw(
-			qp, qp->base->ptr[qp->bump],
+			qp, qp->bump,
 			qp->usage[qp->bump].used * sizeof(dns_qpnode_t));
 	} else {
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
@@ -1245,6 +1480,9 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 	/* schedule the rest for later */
 	reclaim_chunks(multi);
 
+	LIBDNS_QP_COMMIT(multi, qp->leaf_count, isc_time_monotonic() - start);
+	UNUSED(start);
+
 	*qptp = NULL;
 	UNLOCK(&multi->mutex);
 }
@@ -1464,6 +1702,14 @@ dns_qpmulti_create(isc_mem_t *mctx, const dns_qpmethods_t *methods, void *uctx,
 	*qpmp = multi;
 }
 
+void
+dns_qpmulti_interleave(dns_qpmulti_t *multi) {
+	REQUIRE(QPMULTI_VALID(multi));
+	REQUIRE(multi->writer.chunk_max == 0);
+
+	multi->writer.interleave = isc_os_numanodes() > 1;
+}
+
 static void
 destroy_guts(dns_qp_t *qp) {
 	if (qp->chunk_max == 0) {
@@ -2016,6 +2262,121 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
 	return (dns_qp_getkey(qpr, key, keylen, pval_r, ival_r));
 }
 
+static int
+qpbatch_compare(const void *va, const void *vb) {
+	const dns_qpbatch_t *a = va;
+	const dns_qpbatch_t *b = vb;
+	size_t offset = qpkey_compare(a->key, a->keylen, b->key, b->keylen);
+	if (offset == QPKEY_EQUAL) {
+		return (0);
+	}
+	return (qpkey_bit(a->key, a->keylen, offset) <
+				qpkey_bit(b->key, b->keylen, offset)
+			? -1
+			: 1);
+}
+
+void
+dns_qpbatch_sort(dns_qpbatch_t *batch, size_t count) {
+	REQUIRE(count == 0 || batch != NULL);
+
+	qsort(batch, count, sizeof(batch[0]), qpbatch_compare);
+}
+
+void
+dns_qp_lookup_batch(dns_qpreadable_t qpr, dns_qpbatch_t *batch, size_t count) {
+	dns_qpreader_t *qp = dns_qpreader(qpr);
+	dns_qpnode_t *path[DNS_QP_MAXKEY + 1];
+	dns_qpnode_t *root = NULL;
+	size_t depth = 0;
+
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(count == 0 || batch != NULL);
+
+	root = get_root(qp);
+
+	/*
+	 * First walk down to the leaves. The `pval` of each entry holds
+	 * the leaf node until it has been checked.
+	 */
+	for (size_t i = 0; i < count; i++) {
+		dns_qpbatch_t *b = &batch[i];
+		dns_qpnode_t *n = root;
+		size_t reuse = 0;
+
+		REQUIRE(b->keylen < sizeof(dns_qpkey_t));
+
+		b->pval = NULL;
+		b->ival = 0;
+		b->result = ISC_R_NOTFOUND;
+
+		if (root == NULL) {
+			continue;
+		}
+
+		/*
+		 * The branches that tested offsets inside the prefix this
+		 * key shares with the previous key lead the same way, so
+		 * the walk can resume below them.
+		 */
+		if (i > 0 && depth > 0) {
+			const dns_qpbatch_t *prev = &batch[i - 1];
+			size_t common = qpkey_compare(prev->key, prev->keylen,
+						      b->key, b->keylen);
+			REQUIRE(common == QPKEY_EQUAL ||
+				qpkey_bit(prev->key, prev->keylen, common) <
+					qpkey_bit(b->key, b->keylen, common));
+			while (reuse + 1 < depth &&
+			       branch_key_offset(path[reuse]) < common)
+			{
+				reuse++;
+			}
+			n = path[reuse];
+		}
+
+		depth = reuse;
+		for (;;) {
+			INSIST(depth < ARRAY_SIZE(path));
+			path[depth++] = n;
+			if (!is_branch(n)) {
+				__builtin_prefetch(leaf_pval(n));
+				b->pval = n;
+				break;
+			}
+			prefetch_twigs(qp, n);
+			dns_qpshift_t bit = branch_keybit(n, b->key, b->keylen);
+			if (!branch_has_twig(n, bit)) {
+				break;
+			}
+			n = branch_twig_ptr(qp, n, bit);
+		}
+	}
+
+	/*
+	 * Then check that the leaves match.
+	 */
+	for (size_t i = 0; i < count; i++) {
+		dns_qpbatch_t *b = &batch[i];
+		dns_qpnode_t *n = b->pval;
+		dns_qpkey_t found_key;
+		size_t found_keylen;
+
+		if (n == NULL) {
+			continue;
+		}
+		b->pval = NULL;
+
+		found_keylen = leaf_qpkey(qp, n, found_key);
+		if (qpkey_compare(b->key, b->keylen, found_key,
+				  found_keylen) == QPKEY_EQUAL)
+		{
+			b->pval = leaf_pval(n);
+			b->ival = leaf_ival(n);
+			b->result = ISC_R_SUCCESS;
+		}
+	}
+}
+
 static inline void
 add_link(dns_qpchain_t *chain, dns_qpnode_t *node, size_t offset) {
 	/* prevent duplication */
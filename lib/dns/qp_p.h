@@ -180,6 +180,12 @@ STATIC_ASSERT(6 <= QP_CHUNK_LOG && QP_CHUNK_LOG <= 20,
 #define QP_GC_HEURISTIC(qp, free) \
 	((free) > QP_CHUNK_SIZE * 4 && (free) > (qp)->used_count / 2)
 
+/*
+ * Incremental compaction stops after looking at about this many twigs,
+ * and picks up from there in the next step.
+ */
+#define QP_COMPACT_STEP (QP_CHUNK_SIZE * 64)
+
 #define QP_NEEDGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count)
 #define QP_AUTOGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count - (qp)->hold_count)
 
@@ -280,6 +286,8 @@ typedef struct qp_usage {
 	bool snapfree : 1;
 	/*% for mark/sweep snapshot flag updates [MT] */
 	bool snapmark : 1;
+	/*% spread across NUMA nodes, see chunk_get_raw() [MT] */
+	bool interleaved : 1;
 } qp_usage_t;
 
 /*
@@ -446,6 +454,13 @@ struct dns_qpsnap {
  *    normal compaction failed to clear the QP_MAX_GARBAGE() condition.
  *    (This emergency is a bug even tho we have a rescue mechanism.)
  *
+ *  - Incremental compaction records the twig positions on the path to
+ *    where it stopped in `compact_path`, and the length of the path in
+ *    `compact_depth`, which is zero when no pass is in progress. If the
+ *    trie changes between steps the path may lead somewhere else, which
+ *    only means that part of the trie is skipped or visited twice in
+ *    this pass. `compact_stopped` is set when a step runs out of budget.
+ *
  *  - When a qp-trie is destroyed while it has pending cleanup work, its
  *    `destroy` flag is set so that it is destroyed by the reclaim worker.
  *    (Because items cannot be removed from the middle of the cleanup list.)
@@ -455,6 +470,13 @@ struct dns_qpsnap {
  *    `write_protect` flag must be set straight after the `dns_qpmulti_t`
  *    is created, then left unchanged.
  *
+ *  - On Linux machines with more than one NUMA node, the `interleave`
+ *    flag makes the chunks of a read-mostly trie be spread across all
+ *    the nodes, once it has grown beyond one chunk. It is set by
+ *    dns_qpmulti_interleave() before the trie is used, then left
+ *    unchanged; each chunk's `interleaved` flag records that its
+ *    pages were spread, so that it is not reallocated when shrunk.
+ *
  * Some of the dns_qp_t fields are only needed for multithreaded transactions
  * (marked [MT] below) but the same code paths are also used for single-
  * threaded writes.
@@ -481,8 +503,15 @@ struct dns_qp {
 	enum { QP_NONE, QP_WRITE, QP_UPDATE } transaction_mode : 2;
 	/*% compact the entire trie [MT] */
 	bool compact_all : 1;
+	/*% incremental compaction ran out of budget */
+	bool compact_stopped : 1;
 	/*% optionally when compiled with fuzzing support [MT] */
 	bool write_protect : 1;
+	/*% spread chunks across NUMA nodes [MT] */
+	bool interleave : 1;
+	/*% where the next incremental compaction step starts */
+	unsigned int compact_depth;
+	uint8_t compact_path[DNS_QP_MAXKEY];
 };
 
 /*
@@ -682,14 +711,6 @@ branch_twigs(dns_qpreadable_t qpr, dns_qpnode_t *n) {
 	return (ref_ptr(qpr, branch_twigs_ref(n)));
 }
 
-/*
- * Warm up the cache while calculating which twig we want.
- */
-static inline void
-prefetch_twigs(dns_qpreadable_t qpr, dns_qpnode_t *n) {
-	__builtin_prefetch(ref_ptr(qpr, branch_twigs_ref(n)));
-}
-
 /* root node **********************************************************/
 
 /*
@@ -756,6 +777,19 @@ branch_twig_pos(dns_qpnode_t *n, dns_qpshift_t bit) {
 	return (branch_count_bitmap_before(n, bit));
 }
 
+/*
+ * Warm up the cache while calculating which twig we want. A twig
+ * vector does not have to start on a cache line boundary, so we also
+ * fetch the line holding its last twig; between them, the two lines
+ * cover any vector of up to four twigs, which is most of them.
+ */
+static inline void
+prefetch_twigs(dns_qpreadable_t qpr, dns_qpnode_t *n) {
+	dns_qpnode_t *twigs = ref_ptr(qpr, branch_twigs_ref(n));
+	__builtin_prefetch(twigs);
+	__builtin_prefetch(twigs + branch_twigs_size(n) - 1);
+}
+
 /*
  * Get a pointer to the twig for a given bit number.
  */
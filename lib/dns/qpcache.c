@@ -25,6 +25,7 @@
 #include <isc/hashmap.h>
 #include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/job.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
@@ -59,6 +60,7 @@
 #include <dns/zonekey.h>
 
 #include "db_p.h"
+#include "probes.h"
 #include "qpcache_p.h"
 
 #define CHECK(op)                            \
@@ -98,6 +100,9 @@
 #define ZEROTTL(header)                                \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_ZEROTTL) != 0)
+#define PROBATION(header)                              \
+	((atomic_load_acquire(&(header)->attributes) & \
+	  DNS_SLABHEADERATTR_PROBATION) != 0)
 #define ANCIENT(header)                                \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_ANCIENT) != 0)
@@ -148,6 +153,39 @@
 /*% Time after which we update LRU for all other records, 10 minutes */
 #define DNS_QPDB_LRUUPDATE_REGULAR 600
 
+/*%
+ * Maximum number of recently used headers that expire_lru_headers() moves
+ * from the tail back to the head of an LRU list in one call.
+ */
+#define DNS_QPDB_LRU_REQUEUE_MAX 16
+
+/*%
+ * Maximum number of headers that expire_sieve_headers() examines in one
+ * call; the hand remembers where to continue next time.
+ */
+#define DNS_QPDB_SIEVE_SCAN_MAX 1024
+
+/*%
+ * The admission filter sketch: DNS_QPDB_SKETCH_ROWS rows of
+ * DNS_QPDB_SKETCH_WIDTH saturating counters (the width must be a power
+ * of two), halved after every DNS_QPDB_SKETCH_SAMPLE additions so that
+ * it follows the recent history.  While the cache is over its memory
+ * limit, new entries for names added fewer than DNS_QPDB_ADMIT_MIN
+ * times are put on probation; see admit().
+ */
+#define DNS_QPDB_SKETCH_ROWS   4
+#define DNS_QPDB_SKETCH_WIDTH  4096
+#define DNS_QPDB_SKETCH_MAX    15
+#define DNS_QPDB_SKETCH_SAMPLE (10 * DNS_QPDB_SKETCH_WIDTH)
+#define DNS_QPDB_ADMIT_MIN     2
+
+/*%
+ * Approximate number of bytes the background reclaimer purges from one
+ * locking bucket before it releases the node lock and yields to the
+ * loop; see reclaim_batch().
+ */
+#define DNS_QPDB_RECLAIM_BUDGET (64 * 1024)
+
 /*
  * This defines the number of headers that we try to expire each time the
  * expire_ttl_headers() is run.  The number should be small enough, so the
@@ -156,6 +194,12 @@
  */
 #define DNS_QPDB_EXPIRE_TTL_COUNT 10
 
+/*
+ * The number of lookups that make a prefetch-eligible RRset popular; see
+ * DNS_RDATASETATTR_POPULAR.
+ */
+#define DNS_QPDB_POPULAR 8
+
 /*%
  * This is the structure that is used for each node in the qp trie of trees.
  */
@@ -166,7 +210,7 @@ struct qpcnode {
 
 	uint8_t			: 0;
 	unsigned int delegating : 1;
-	unsigned int nsec	: 2; /*%< range is 0..3 */
+	unsigned int nsec	: 3; /*%< range is 0..5 */
 	uint8_t			: 0;
 
 	isc_refcount_t references;
@@ -230,6 +274,26 @@ struct qpcache {
 	 */
 	dns_slabheaderlist_t *lru;
 
+	/*
+	 * How entries are chosen for purging; see
+	 * dns_db_setevictionpolicy().
+	 */
+	_Atomic(dns_cacheeviction_t) evictionpolicy;
+
+	/*
+	 * Whether to pack TXT, SVCB and HTTPS RRsets; see
+	 * dns_db_setpackrecords().
+	 */
+	atomic_bool packrecords;
+
+	/*
+	 * The SIEVE "hand" for each LRU list: the next header to be
+	 * examined, moving from the tail towards the head. NULL means
+	 * start again at the tail. Protected by the node lock of the
+	 * corresponding bucket, like the list itself.
+	 */
+	dns_slabheader_t **sieve_hand;
+
 	/*
 	 * Start point % node_lock_count for next LRU cleanup.
 	 */
@@ -241,6 +305,24 @@ struct qpcache {
 	 */
 	_Atomic(isc_stdtime_t) last_used;
 
+	/*
+	 * The count-min sketch of the admission filter, with
+	 * DNS_QPDB_SKETCH_ROWS * DNS_QPDB_SKETCH_WIDTH counters, and the
+	 * number of additions since it was last aged.
+	 */
+	_Atomic(uint8_t) *sketch;
+	atomic_uint sketch_adds;
+
+	/*
+	 * The water marks of the background reclaimer (0 when disabled),
+	 * and for each bucket, the job that purges it on its loop and
+	 * whether it is scheduled; see reclaim_start().
+	 */
+	atomic_size_t reclaim_hiwater;
+	atomic_size_t reclaim_lowater;
+	isc_job_t *reclaim_jobs;
+	atomic_bool *reclaiming;
+
 	/*%
 	 * Temporary storage for stale cache nodes and dynamically deleted
 	 * nodes that await being cleaned up.
@@ -259,6 +341,7 @@ struct qpcache {
 	/* Locked by tree_lock. */
 	dns_qp_t *tree;
 	dns_qp_t *nsec;
+	dns_qp_t *nsec3;
 };
 
 /*%
@@ -381,10 +464,8 @@ static dns_dbiteratormethods_t dbiterator_methods = {
 /*
  * Note that the QP cache database only needs a single QP iterator, because
  * unlike the QP zone database, NSEC3 records are cached in the main tree.
- *
- * If we ever implement synth-from-dnssec using NSEC3 records, we'll need
- * to have a separate tree for NSEC3 records, and to copy in the more complex
- * iterator implementation from qpzone.c.
+ * The auxiliary NSEC3 tree only indexes their owner names so that
+ * synth-from-dnssec can find a covering NSEC3, and it is never iterated.
  */
 typedef struct qpc_dbit {
 	dns_dbiterator_t common;
@@ -464,14 +545,18 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 		 * Glue records are updated if at least DNS_QPDB_LRUUPDATE_GLUE
 		 * seconds have passed since the previous update time.
 		 */
-		return (header->last_used + DNS_QPDB_LRUUPDATE_GLUE <= now);
+		return (atomic_load_relaxed(&header->last_used) +
+				DNS_QPDB_LRUUPDATE_GLUE <=
+			now);
 	}
 
 	/*
 	 * Other records are updated if DNS_QPDB_LRUUPDATE_REGULAR seconds
 	 * have passed.
 	 */
-	return (header->last_used + DNS_QPDB_LRUUPDATE_REGULAR <= now);
+	return (atomic_load_relaxed(&header->last_used) +
+			DNS_QPDB_LRUUPDATE_REGULAR <=
+		now);
 #else
 	UNUSED(now);
 
@@ -480,21 +565,109 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 }
 
 /*%
- * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * Update the timestamp of a given cache entry, or mark it as visited
+ * when the SIEVE eviction policy is in use.
  *
- * Caller must hold the node (write) lock.
+ * Caller must hold the node (read or write) lock.
+ *
+ * Only the timestamp is updated, atomically, so lookups never need to
+ * upgrade to the node write lock. Moving the header to the head of its
+ * LRU list is deferred to expire_lru_headers(), which already holds the
+ * write lock when it finds the header at the tail of the list.
  *
  * Note that the we do NOT touch the heap here, as the TTL has not changed.
  */
 static void
 update_header(qpcache_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
-	/* To be checked: can we really assume this? XXXMLG */
-	INSIST(ISC_LINK_LINKED(header, link));
+	if (atomic_load_relaxed(&qpdb->evictionpolicy) ==
+	    dns_cacheeviction_sieve)
+	{
+		/*
+		 * SIEVE only needs to know that the entry was used at
+		 * least once since the hand last passed it. Test the bit
+		 * first so popular entries are not written to over and
+		 * over again.
+		 */
+		if (DNS_SLABHEADER_GETATTR(header,
+					   DNS_SLABHEADERATTR_VISITED) == 0)
+		{
+			DNS_SLABHEADER_SETATTR(header,
+					       DNS_SLABHEADERATTR_VISITED);
+		}
+		return;
+	}
+
+	if (need_headerupdate(header, now)) {
+		atomic_store_relaxed(&header->last_used, now);
+	}
+}
+
+/*%
+ * Remove a header from its LRU list, moving the SIEVE hand past it
+ * if necessary.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_unlink(qpcache_t *qpdb, unsigned int locknum, dns_slabheader_t *header) {
+	if (qpdb->sieve_hand[locknum] == header) {
+		qpdb->sieve_hand[locknum] = ISC_LIST_PREV(header, link);
+	}
+	ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
+}
+
+/*%
+ * An existing cache entry has been added again: update its timestamp
+ * and move it to the head of the LRU list, or mark it as visited.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+refresh_header(qpcache_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
+	unsigned int locknum = HEADERNODE(header)->locknum;
+
+	if (atomic_load_relaxed(&qpdb->evictionpolicy) ==
+	    dns_cacheeviction_sieve)
+	{
+		DNS_SLABHEADER_SETATTR(header, DNS_SLABHEADERATTR_VISITED);
+	} else if (header->last_used != now) {
+		lru_unlink(qpdb, locknum, header);
+		header->last_used = now;
+		ISC_LIST_PREPEND(qpdb->lru[locknum], header, link);
+	}
+}
 
-	ISC_LIST_UNLINK(qpdb->lru[HEADERNODE(header)->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(qpdb->lru[HEADERNODE(header)->locknum], header, link);
+/*%
+ * Put a new header on its LRU list.
+ *
+ * Zero-TTL entries, NXDOMAIN entries and entries on probation start at
+ * the cold end of the list.  Random subdomain floods fill the cache with
+ * entries that are never looked up again, so under memory pressure they
+ * are evicted before the rest of the cache unless they have been used
+ * since they were added.  With SIEVE, that means placing them where the
+ * hand will look next.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_add(qpcache_t *qpdb, unsigned int locknum, dns_slabheader_t *header) {
+	dns_slabheader_t *hand = qpdb->sieve_hand[locknum];
+
+	if (ZEROTTL(header)) {
+		header->last_used = qpdb->last_used + 1;
+		ISC_LIST_APPEND(qpdb->lru[locknum], header, link);
+	} else if (!NXDOMAIN(header) && !PROBATION(header)) {
+		ISC_LIST_PREPEND(qpdb->lru[locknum], header, link);
+	} else if (atomic_load_relaxed(&qpdb->evictionpolicy) ==
+			   dns_cacheeviction_sieve &&
+		   hand != NULL)
+	{
+		ISC_LIST_INSERTAFTER(qpdb->lru[locknum], hand, header, link);
+		qpdb->sieve_hand[locknum] = header;
+	} else {
+		header->last_used = qpdb->last_used;
+		ISC_LIST_APPEND(qpdb->lru[locknum], header, link);
+	}
 }
 
 /*
@@ -561,6 +734,41 @@ clean_cache_node(qpcache_t *qpdb, qpcnode_t *node) {
 	node->dirty = 0;
 }
 
+/*
+ * Return what the 'nsec' field of a node in the main tree becomes once
+ * it also has a node in the auxiliary tree for 'type', NSEC or NSEC3.
+ * A name can own both, e.g. when a zone has just moved from one to the
+ * other, and must then be found in both auxiliary trees.
+ */
+static unsigned int
+nsec_with(unsigned int nsec, dns_rdatatype_t type) {
+	unsigned int has = (type == dns_rdatatype_nsec3)
+				   ? DNS_DB_NSEC_HAS_NSEC3
+				   : DNS_DB_NSEC_HAS_NSEC;
+
+	if (nsec == DNS_DB_NSEC_NORMAL || nsec == has) {
+		return (has);
+	}
+	return (DNS_DB_NSEC_HAS_BOTH);
+}
+
+/*
+ * Delete the node named as 'node' from the auxiliary NSEC or NSEC3 'tree'.
+ */
+static void
+delete_auxnode(dns_qp_t *tree, qpcnode_t *node) {
+	isc_result_t result;
+
+	result = dns_qp_deletename(tree, &node->name, NULL, NULL);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+			      ISC_LOG_WARNING,
+			      "delete_node(): "
+			      "dns_qp_deletename: %s",
+			      isc_result_totext(result));
+	}
+}
+
 /*
  * tree_lock(write) must be held.
  */
@@ -579,17 +787,17 @@ delete_node(qpcache_t *qpdb, qpcnode_t *node) {
 
 	switch (node->nsec) {
 	case DNS_DB_NSEC_HAS_NSEC:
+	case DNS_DB_NSEC_HAS_NSEC3:
+	case DNS_DB_NSEC_HAS_BOTH:
 		/*
-		 * Delete the corresponding node from the auxiliary NSEC
-		 * tree before deleting from the main tree.
+		 * Delete the corresponding nodes from the auxiliary NSEC
+		 * and NSEC3 trees before deleting from the main tree.
 		 */
-		result = dns_qp_deletename(qpdb->nsec, &node->name, NULL, NULL);
-		if (result != ISC_R_SUCCESS) {
-			isc_log_write(DNS_LOGCATEGORY_DATABASE,
-				      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
-				      "delete_node(): "
-				      "dns_qp_deletename: %s",
-				      isc_result_totext(result));
+		if (node->nsec != DNS_DB_NSEC_HAS_NSEC3) {
+			delete_auxnode(qpdb->nsec, node);
+		}
+		if (node->nsec != DNS_DB_NSEC_HAS_NSEC) {
+			delete_auxnode(qpdb->nsec3, node);
 		}
 		/* FALLTHROUGH */
 	case DNS_DB_NSEC_NORMAL:
@@ -598,6 +806,10 @@ delete_node(qpcache_t *qpdb, qpcnode_t *node) {
 	case DNS_DB_NSEC_NSEC:
 		result = dns_qp_deletename(qpdb->nsec, &node->name, NULL, NULL);
 		break;
+	case DNS_DB_NSEC_NSEC3:
+		result = dns_qp_deletename(qpdb->nsec3, &node->name, NULL,
+					   NULL);
+		break;
 	}
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
@@ -958,6 +1170,63 @@ expireheader(dns_slabheader_t *header, isc_rwlocktype_t *nlocktypep,
 	}
 }
 
+/*%
+ * TinyLFU-style admission: count the addition of 'name' in the sketch,
+ * and while the cache is over its memory limit, put the new entry on
+ * probation unless the name has been added often enough recently.
+ * Entries on probation are still added and answered from, but they are
+ * the first ones to be evicted unless they are used again, so one-off
+ * names don't push frequently used data out of a full cache.
+ */
+static void
+admit(qpcache_t *qpdb, const dns_name_t *name, dns_slabheader_t *newheader,
+      bool overmem) {
+	uint32_t hash = dns_name_hash(name);
+	uint32_t step = ((hash >> 17) | (hash << 15)) | 1;
+	unsigned int estimate = DNS_QPDB_SKETCH_MAX;
+
+	for (size_t i = 0; i < DNS_QPDB_SKETCH_ROWS; i++) {
+		size_t slot = (hash + i * step) & (DNS_QPDB_SKETCH_WIDTH - 1);
+		_Atomic(uint8_t) *counter =
+			&qpdb->sketch[i * DNS_QPDB_SKETCH_WIDTH + slot];
+		unsigned int count = atomic_load_relaxed(counter);
+
+		/* Concurrent additions can overshoot a little; that's fine */
+		if (count < DNS_QPDB_SKETCH_MAX) {
+			count = atomic_fetch_add_relaxed(counter, 1) + 1;
+		}
+		estimate = ISC_MIN(estimate, count);
+	}
+
+	if (atomic_fetch_add_relaxed(&qpdb->sketch_adds, 1) + 1 ==
+	    DNS_QPDB_SKETCH_SAMPLE)
+	{
+		for (size_t i = 0;
+		     i < DNS_QPDB_SKETCH_ROWS * DNS_QPDB_SKETCH_WIDTH; i++)
+		{
+			atomic_store_relaxed(
+				&qpdb->sketch[i],
+				atomic_load_relaxed(&qpdb->sketch[i]) >> 1);
+		}
+		atomic_store_relaxed(&qpdb->sketch_adds, 0);
+	}
+
+	if (!overmem) {
+		return;
+	}
+
+	if (estimate < DNS_QPDB_ADMIT_MIN) {
+		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_PROBATION);
+	}
+
+	if (qpdb->cachestats != NULL) {
+		isc_stats_increment(qpdb->cachestats,
+				    estimate < DNS_QPDB_ADMIT_MIN
+					    ? dns_cachestatscounter_probation
+					    : dns_cachestatscounter_admitted);
+	}
+}
+
 static void
 update_cachestats(qpcache_t *qpdb, isc_result_t result) {
 	if (qpdb->cachestats == NULL) {
@@ -984,6 +1253,52 @@ update_cachestats(qpcache_t *qpdb, isc_result_t result) {
 	}
 }
 
+static void
+trace_cachefind(qpcache_t *qpdb, const dns_name_t *name, dns_rdatatype_t type,
+		isc_result_t result) {
+	if (!LIBDNS_CACHE_HIT_ENABLED() && !LIBDNS_CACHE_MISS_ENABLED()) {
+		return;
+	}
+
+	char namebuf[DNS_NAME_FORMATSIZE];
+	dns_name_format(name, namebuf, sizeof(namebuf));
+
+	/* Classified the same way as the cache hit/miss counters */
+	switch (result) {
+	case DNS_R_COVERINGNSEC:
+	case ISC_R_SUCCESS:
+	case DNS_R_CNAME:
+	case DNS_R_DNAME:
+	case DNS_R_DELEGATION:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+		LIBDNS_CACHE_HIT(qpdb, namebuf, type, result);
+		break;
+	default:
+		LIBDNS_CACHE_MISS(qpdb, namebuf, type, result);
+	}
+}
+
+/*
+ * Count a lookup of 'header' and return true if it is the one that makes
+ * it popular.  The count stops at DNS_QPDB_POPULAR, so a busy RRset can
+ * neither wrap the counter nor be flagged again.
+ */
+static bool
+popular(dns_slabheader_t *header) {
+	uint_least16_t hits = atomic_load_relaxed(&header->hits);
+
+	while (hits < DNS_QPDB_POPULAR) {
+		if (atomic_compare_exchange_weak_relaxed(&header->hits, &hits,
+							 hits + 1))
+		{
+			return (hits + 1 == DNS_QPDB_POPULAR);
+		}
+	}
+
+	return (false);
+}
+
 static void
 bindrdataset(qpcache_t *qpdb, qpcnode_t *node, dns_slabheader_t *header,
 	     isc_stdtime_t now, isc_rwlocktype_t nlocktype,
@@ -1048,8 +1363,14 @@ bindrdataset(qpcache_t *qpdb, qpcnode_t *node, dns_slabheader_t *header,
 	if (OPTOUT(header)) {
 		rdataset->attributes |= DNS_RDATASETATTR_OPTOUT;
 	}
+	if (header->packed) {
+		rdataset->attributes |= DNS_RDATASETATTR_PACKED;
+	}
 	if (PREFETCH(header)) {
 		rdataset->attributes |= DNS_RDATASETATTR_PREFETCH;
+		if (!stale && !ancient && popular(header)) {
+			rdataset->attributes |= DNS_RDATASETATTR_POPULAR;
+		}
 	}
 
 	if (stale && !ancient) {
@@ -1391,24 +1712,10 @@ find_deepest_zonecut(qpc_search_t *search, qpcnode_t *node,
 					     isc_rwlocktype_none,
 					     sigrdataset DNS__DB_FLARG_PASS);
 			}
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now)))
-			{
-				if (nlocktype != isc_rwlocktype_write) {
-					NODE_FORCEUPGRADE(lock, &nlocktype);
-					POST(nlocktype);
-				}
-				if (need_headerupdate(found, search->now)) {
-					update_header(search->qpdb, found,
-						      search->now);
-				}
-				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now))
-				{
-					update_header(search->qpdb, foundsig,
-						      search->now);
-				}
+			update_header(search->qpdb, found, search->now);
+			if (foundsig != NULL) {
+				update_header(search->qpdb, foundsig,
+					      search->now);
 			}
 		}
 
@@ -1422,17 +1729,90 @@ find_deepest_zonecut(qpc_search_t *search, qpcnode_t *node,
 	return (result);
 }
 
+/*
+ * Step 'iter' back from the position left by dns_qp_lookup() to the
+ * nearest NSEC3 owner name in 'zone', i.e. a single hashed label below
+ * the apex; owners from NSEC3 chains of child zones sort in between.
+ */
+static isc_result_t
+nsec3_predecessor(dns_qpiter_t *iter, const dns_name_t *zone,
+		  dns_name_t *predecessor) {
+	unsigned int labels = dns_name_countlabels(zone) + 1;
+	isc_result_t result;
+
+	result = dns_qpiter_current(iter, predecessor, NULL, NULL);
+	while (result == ISC_R_SUCCESS) {
+		if (!dns_name_issubdomain(predecessor, zone)) {
+			break;
+		}
+		if (dns_name_countlabels(predecessor) == labels) {
+			return (ISC_R_SUCCESS);
+		}
+		result = dns_qpiter_prev(iter, predecessor, NULL, NULL);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Find the NSEC3 owner name in the auxiliary NSEC3 tree that matches
+ * or precedes the hashed name 'name' in the same zone.  If there is
+ * none, the hash sorts before the whole chain, which then wraps around
+ * and is covered by the last NSEC3 in the zone.
+ */
+static isc_result_t
+find_nsec3predecessor(qpcache_t *qpdb, const dns_name_t *name,
+		      dns_name_t *predecessor) {
+	static unsigned char lastdata[] = "\001\377";
+	static unsigned char lastoffsets[] = { 0 };
+	dns_name_t lastlabel = DNS_NAME_INITNONABSOLUTE(lastdata, lastoffsets);
+	dns_fixedname_t fzone, flast;
+	dns_name_t *zone = NULL, *last = NULL;
+	unsigned int labels = dns_name_countlabels(name);
+	dns_qpiter_t iter;
+	isc_result_t result;
+
+	if (labels < 2) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	zone = dns_fixedname_initname(&fzone);
+	dns_name_getlabelsequence(name, 1, labels - 1, zone);
+
+	(void)dns_qp_lookup(qpdb->nsec3, name, NULL, &iter, NULL, NULL, NULL);
+	result = nsec3_predecessor(&iter, zone, predecessor);
+	if (result == ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * Look up a name that sorts after every hashed label in the
+	 * zone to find the end of the chain.
+	 */
+	last = dns_fixedname_initname(&flast);
+	result = dns_name_concatenate(&lastlabel, zone, last, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_NOTFOUND);
+	}
+	(void)dns_qp_lookup(qpdb->nsec3, last, NULL, &iter, NULL, NULL, NULL);
+	return (nsec3_predecessor(&iter, zone, predecessor));
+}
+
 /*
  * Look for a potentially covering NSEC in the cache where `name`
  * is known not to exist.  This uses the auxiliary NSEC tree to find
  * the potential NSEC owner. If found, we update 'foundname', 'nodep',
  * 'rdataset' and 'sigrdataset', and return DNS_R_COVERINGNSEC.
  * Otherwise, return ISC_R_NOTFOUND.
+ *
+ * If 'type' is NSEC3, 'name' is a hashed owner name and the auxiliary
+ * NSEC3 tree is used to find the potentially covering NSEC3 instead.
  */
 static isc_result_t
 find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
-		  dns_dbnode_t **nodep, isc_stdtime_t now,
-		  dns_name_t *foundname, dns_rdataset_t *rdataset,
+		  dns_rdatatype_t type, dns_dbnode_t **nodep,
+		  isc_stdtime_t now, dns_name_t *foundname,
+		  dns_rdataset_t *rdataset,
 		  dns_rdataset_t *sigrdataset DNS__DB_FLARG) {
 	dns_fixedname_t fpredecessor, fixed;
 	dns_name_t *predecessor = NULL, *fname = NULL;
@@ -1446,6 +1826,20 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 	dns_slabheader_t *header = NULL;
 	dns_slabheader_t *header_next = NULL, *header_prev = NULL;
 
+	fname = dns_fixedname_initname(&fixed);
+	predecessor = dns_fixedname_initname(&fpredecessor);
+	matchtype = DNS_TYPEPAIR_VALUE(type, 0);
+	sigmatchtype = DNS_SIGTYPE(type);
+
+	if (type == dns_rdatatype_nsec3) {
+		result = find_nsec3predecessor(search->qpdb, name,
+					       predecessor);
+		if (result != ISC_R_SUCCESS) {
+			return (ISC_R_NOTFOUND);
+		}
+		goto lookup;
+	}
+
 	/*
 	 * Look for the node in the auxilary tree.
 	 */
@@ -1455,11 +1849,6 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 		return (ISC_R_NOTFOUND);
 	}
 
-	fname = dns_fixedname_initname(&fixed);
-	predecessor = dns_fixedname_initname(&fpredecessor);
-	matchtype = DNS_TYPEPAIR_VALUE(dns_rdatatype_nsec, 0);
-	sigmatchtype = DNS_SIGTYPE(dns_rdatatype_nsec);
-
 	/*
 	 * Extract predecessor from iterator.
 	 */
@@ -1468,6 +1857,7 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 		return (ISC_R_NOTFOUND);
 	}
 
+lookup:
 	/*
 	 * Lookup the predecessor in the main tree.
 	 */
@@ -1550,12 +1940,17 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_slabheader_t *update = NULL, *updatesig = NULL;
 	dns_slabheader_t *nsecheader = NULL, *nsecsig = NULL;
 	dns_typepair_t sigtype, negtype;
+	dns_rdatatype_t nsectype = dns_rdatatype_nsec;
 
 	UNUSED(version);
 
 	REQUIRE(VALID_QPDB((qpcache_t *)db));
 	REQUIRE(version == NULL);
 
+	if ((options & DNS_DBFIND_FORCENSEC3) != 0) {
+		nsectype = dns_rdatatype_nsec3;
+	}
+
 	if (now == 0) {
 		now = isc_stdtime_now();
 	}
@@ -1619,8 +2014,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		     search.zonecut_header->type != dns_rdatatype_dname))
 		{
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, nsectype, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -1781,8 +2176,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		NODE_UNLOCK(lock, &nlocktype);
 		if ((search.options & DNS_DBFIND_COVERINGNSEC) != 0) {
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, nsectype, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -1815,16 +2210,12 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			bindrdataset(search.qpdb, node, nsecheader, search.now,
 				     nlocktype, tlocktype,
 				     rdataset DNS__DB_FLARG_PASS);
-			if (need_headerupdate(nsecheader, search.now)) {
-				update = nsecheader;
-			}
+			update = nsecheader;
 			if (nsecsig != NULL) {
 				bindrdataset(search.qpdb, node, nsecsig,
 					     search.now, nlocktype, tlocktype,
 					     sigrdataset DNS__DB_FLARG_PASS);
-				if (need_headerupdate(nsecsig, search.now)) {
-					updatesig = nsecsig;
-				}
+				updatesig = nsecsig;
 			}
 			result = DNS_R_COVERINGNSEC;
 			goto node_exit;
@@ -1838,8 +2229,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		{
 			NODE_UNLOCK(lock, &nlocktype);
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, nsectype, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -1859,16 +2250,12 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			bindrdataset(search.qpdb, node, nsheader, search.now,
 				     nlocktype, tlocktype,
 				     rdataset DNS__DB_FLARG_PASS);
-			if (need_headerupdate(nsheader, search.now)) {
-				update = nsheader;
-			}
+			update = nsheader;
 			if (nssig != NULL) {
 				bindrdataset(search.qpdb, node, nssig,
 					     search.now, nlocktype, tlocktype,
 					     sigrdataset DNS__DB_FLARG_PASS);
-				if (need_headerupdate(nssig, search.now)) {
-					updatesig = nssig;
-				}
+				updatesig = nssig;
 			}
 			result = DNS_R_DELEGATION;
 			goto node_exit;
@@ -1921,30 +2308,20 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	{
 		bindrdataset(search.qpdb, node, found, search.now, nlocktype,
 			     tlocktype, rdataset DNS__DB_FLARG_PASS);
-		if (need_headerupdate(found, search.now)) {
-			update = found;
-		}
+		update = found;
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bindrdataset(search.qpdb, node, foundsig, search.now,
 				     nlocktype, tlocktype,
 				     sigrdataset DNS__DB_FLARG_PASS);
-			if (need_headerupdate(foundsig, search.now)) {
-				updatesig = foundsig;
-			}
+			updatesig = foundsig;
 		}
 	}
 
 node_exit:
-	if ((update != NULL || updatesig != NULL) &&
-	    nlocktype != isc_rwlocktype_write)
-	{
-		NODE_FORCEUPGRADE(lock, &nlocktype);
-		POST(nlocktype);
-	}
-	if (update != NULL && need_headerupdate(update, search.now)) {
+	if (update != NULL) {
 		update_header(search.qpdb, update, search.now);
 	}
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now)) {
+	if (updatesig != NULL) {
 		update_header(search.qpdb, updatesig, search.now);
 	}
 
@@ -1970,6 +2347,7 @@ tree_exit:
 	}
 
 	update_cachestats(search.qpdb, result);
+	trace_cachefind(search.qpdb, name, type, result);
 	return (result);
 }
 
@@ -2118,20 +2496,9 @@ findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 			     tlocktype, sigrdataset DNS__DB_FLARG_PASS);
 	}
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL && need_headerupdate(foundsig, search.now)))
-	{
-		if (nlocktype != isc_rwlocktype_write) {
-			NODE_FORCEUPGRADE(lock, &nlocktype);
-			POST(nlocktype);
-		}
-		if (need_headerupdate(found, search.now)) {
-			update_header(search.qpdb, found, search.now);
-		}
-		if (foundsig != NULL && need_headerupdate(foundsig, search.now))
-		{
-			update_header(search.qpdb, foundsig, search.now);
-		}
+	update_header(search.qpdb, found, search.now);
+	if (foundsig != NULL) {
+		update_header(search.qpdb, foundsig, search.now);
 	}
 
 	NODE_UNLOCK(lock, &nlocktype);
@@ -2343,14 +2710,30 @@ expire_lru_headers(qpcache_t *qpdb, unsigned int locknum,
 		   size_t purgesize DNS__DB_FLARG) {
 	dns_slabheader_t *header = NULL;
 	size_t purged = 0;
+	unsigned int requeued = 0;
 
 	for (header = ISC_LIST_TAIL(qpdb->lru[locknum]);
-	     header != NULL && header->last_used <= qpdb->last_used &&
-	     purged <= purgesize;
+	     header != NULL && purged <= purgesize;
 	     header = ISC_LIST_TAIL(qpdb->lru[locknum]))
 	{
 		size_t header_size = rdataset_size(header);
 
+		/*
+		 * Lookups only update the timestamp (see update_header()),
+		 * so an entry that was used since it was put on the list
+		 * is moved back to the head now, while the write lock is
+		 * held, instead of being purged.
+		 */
+		if (atomic_load_relaxed(&header->last_used) > qpdb->last_used)
+		{
+			if (requeued++ >= DNS_QPDB_LRU_REQUEUE_MAX) {
+				break;
+			}
+			lru_unlink(qpdb, locknum, header);
+			ISC_LIST_PREPEND(qpdb->lru[locknum], header, link);
+			continue;
+		}
+
 		/*
 		 * Unlink the entry at this point to avoid checking it
 		 * again even if it's currently used someone else and
@@ -2358,7 +2741,55 @@ expire_lru_headers(qpcache_t *qpdb, unsigned int locknum,
 		 * referenced any more (so unlinking is safe) since the
 		 * TTL will be reset to 0.
 		 */
-		ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
+		lru_unlink(qpdb, locknum, header);
+		expireheader(header, nlocktypep, tlocktypep,
+			     dns_expire_lru DNS__DB_FLARG_PASS);
+		purged += header_size;
+	}
+
+	return (purged);
+}
+
+/*%
+ * SIEVE eviction: the hand moves from the tail of the list towards the
+ * head, clearing the visited bit of the entries it passes and purging
+ * the first entry that has not been visited. Entries are never moved
+ * within the list, so lookups only need to set a bit.
+ *
+ * expireheader() can free other headers in this bucket; lru_unlink()
+ * keeps the hand valid when that happens, so it is re-read instead of
+ * remembering the previous header across the call.
+ */
+static size_t
+expire_sieve_headers(qpcache_t *qpdb, unsigned int locknum,
+		     isc_rwlocktype_t *nlocktypep, isc_rwlocktype_t *tlocktypep,
+		     size_t purgesize DNS__DB_FLARG) {
+	size_t purged = 0;
+
+	for (unsigned int scanned = 0;
+	     purged <= purgesize && scanned < DNS_QPDB_SIEVE_SCAN_MAX;
+	     scanned++)
+	{
+		dns_slabheader_t *header = qpdb->sieve_hand[locknum];
+		if (header == NULL) {
+			header = ISC_LIST_TAIL(qpdb->lru[locknum]);
+			if (header == NULL) {
+				break;
+			}
+		}
+
+		if (DNS_SLABHEADER_GETATTR(header,
+					   DNS_SLABHEADERATTR_VISITED) != 0)
+		{
+			DNS_SLABHEADER_CLRATTR(header,
+					       DNS_SLABHEADERATTR_VISITED);
+			qpdb->sieve_hand[locknum] = ISC_LIST_PREV(header, link);
+			continue;
+		}
+
+		size_t header_size = rdataset_size(header);
+		qpdb->sieve_hand[locknum] = header;
+		lru_unlink(qpdb, locknum, header);
 		expireheader(header, nlocktypep, tlocktypep,
 			     dns_expire_lru DNS__DB_FLARG_PASS);
 		purged += header_size;
@@ -2385,6 +2816,7 @@ overmem(qpcache_t *qpdb, dns_slabheader_t *newheader,
 	size_t purgesize, purged = 0;
 	isc_stdtime_t min_last_used = 0;
 	size_t max_passes = 8;
+	isc_nanosecs_t start = isc_time_monotonic();
 
 	/*
 	 * Maximum estimated size of the data being added: The size
@@ -2402,19 +2834,29 @@ again:
 		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 		NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
 
-		purged += expire_lru_headers(
-			qpdb, locknum, &nlocktype, tlocktypep,
-			purgesize - purged DNS__DB_FLARG_PASS);
+		if (atomic_load_relaxed(&qpdb->evictionpolicy) ==
+		    dns_cacheeviction_sieve)
+		{
+			purged += expire_sieve_headers(
+				qpdb, locknum, &nlocktype, tlocktypep,
+				purgesize - purged DNS__DB_FLARG_PASS);
+		} else {
+			purged += expire_lru_headers(
+				qpdb, locknum, &nlocktype, tlocktypep,
+				purgesize - purged DNS__DB_FLARG_PASS);
+		}
 
 		/*
 		 * Work out the oldest remaining last_used values of the list
 		 * tails as we walk across the array of lru lists.
 		 */
 		dns_slabheader_t *header = ISC_LIST_TAIL(qpdb->lru[locknum]);
-		if (header != NULL &&
-		    (min_last_used == 0 || header->last_used < min_last_used))
-		{
-			min_last_used = header->last_used;
+		if (header != NULL) {
+			isc_stdtime_t last_used =
+				atomic_load_relaxed(&header->last_used);
+			if (min_last_used == 0 || last_used < min_last_used) {
+				min_last_used = last_used;
+			}
 		}
 		NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
 		locknum = (locknum + 1) % qpdb->node_lock_count;
@@ -2432,6 +2874,103 @@ again:
 			}
 		}
 	}
+
+	if (qpdb->cachestats != NULL) {
+		isc_stats_add(qpdb->cachestats,
+			      dns_cachestatscounter_overmemusecs,
+			      (isc_time_monotonic() - start) / NS_PER_US);
+	}
+}
+
+/*%
+ * Background reclaiming: once the cache uses more memory than
+ * 'reclaim_hiwater', every bucket is purged by the loop it belongs to,
+ * in batches of about DNS_QPDB_RECLAIM_BUDGET bytes run from the idle
+ * phase of the loop, until the usage drops to 'reclaim_lowater'.  The
+ * node lock is held for one batch at a time and the tree lock is not
+ * taken at all (nodes that can't be deleted right away go to the dead
+ * node queue), so additions aren't held up by the purging; overmem()
+ * only has to enforce the hard limit when this can't keep up.
+ *
+ * A bucket stops when nothing more can be purged from it for now (for
+ * LRU, when the tail entries are all more recent than 'last_used');
+ * the next addition over the high water mark starts it again.
+ */
+static void
+reclaim_batch(void *arg) {
+	qpcache_t *qpdb = arg;
+	uint32_t locknum = isc_tid();
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	isc_nanosecs_t start = isc_time_monotonic();
+	size_t budget = DNS_QPDB_RECLAIM_BUDGET;
+	size_t purged;
+	dns_db_t *db = NULL;
+
+	INSIST(locknum < qpdb->node_lock_count);
+
+	NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	if (atomic_load_relaxed(&qpdb->evictionpolicy) ==
+	    dns_cacheeviction_sieve)
+	{
+		purged = expire_sieve_headers(qpdb, locknum, &nlocktype,
+					      &tlocktype,
+					      budget DNS__DB_FILELINE);
+	} else {
+		purged = expire_lru_headers(qpdb, locknum, &nlocktype,
+					    &tlocktype,
+					    budget DNS__DB_FILELINE);
+	}
+	NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	INSIST(tlocktype == isc_rwlocktype_none);
+
+	if (qpdb->cachestats != NULL) {
+		isc_stats_increment(qpdb->cachestats,
+				    dns_cachestatscounter_reclaimbatches);
+		isc_stats_add(qpdb->cachestats,
+			      dns_cachestatscounter_reclaimbytes, purged);
+		isc_stats_add(qpdb->cachestats,
+			      dns_cachestatscounter_reclaimusecs,
+			      (isc_time_monotonic() - start) / NS_PER_US);
+	}
+
+	if (purged > 0 && !isc_loop_shuttingdown(isc_loop()) &&
+	    isc_mem_inuse(qpdb->common.mctx) >
+		    atomic_load_relaxed(&qpdb->reclaim_lowater))
+	{
+		isc_job_run(isc_loop(), &qpdb->reclaim_jobs[locknum],
+			    reclaim_batch, qpdb);
+		return;
+	}
+
+	atomic_store_release(&qpdb->reclaiming[locknum], false);
+
+	db = (dns_db_t *)qpdb;
+	dns_db_detach(&db);
+}
+
+static void
+reclaim_start(qpcache_t *qpdb) {
+	size_t hiwater = atomic_load_relaxed(&qpdb->reclaim_hiwater);
+
+	if (hiwater == 0 || isc_mem_inuse(qpdb->common.mctx) <= hiwater) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < qpdb->node_lock_count; i++) {
+		dns_db_t *db = NULL;
+
+		if (atomic_load_relaxed(&qpdb->reclaiming[i]) ||
+		    !atomic_compare_exchange_strong(&qpdb->reclaiming[i],
+						    &(bool){ false }, true))
+		{
+			continue;
+		}
+
+		dns_db_attach((dns_db_t *)qpdb, &db);
+		isc_async_run(isc_loop_get(qpdb->loopmgr, i), reclaim_batch,
+			      qpdb);
+	}
 }
 
 /*%
@@ -2470,7 +3009,10 @@ free_qpdb(qpcache_t *qpdb, bool log) {
 		if (*treep == NULL) {
 			treep = &qpdb->nsec;
 			if (*treep == NULL) {
-				break;
+				treep = &qpdb->nsec3;
+				if (*treep == NULL) {
+					break;
+				}
 			}
 		}
 
@@ -2506,6 +3048,23 @@ free_qpdb(qpcache_t *qpdb, bool log) {
 			     qpdb->node_lock_count,
 			     sizeof(dns_slabheaderlist_t));
 	}
+	if (qpdb->sieve_hand != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->sieve_hand,
+			     qpdb->node_lock_count, sizeof(dns_slabheader_t *));
+	}
+	if (qpdb->sketch != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->sketch,
+			     DNS_QPDB_SKETCH_ROWS * DNS_QPDB_SKETCH_WIDTH,
+			     sizeof(qpdb->sketch[0]));
+	}
+	if (qpdb->reclaim_jobs != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->reclaim_jobs,
+			     qpdb->node_lock_count, sizeof(isc_job_t));
+	}
+	if (qpdb->reclaiming != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->reclaiming,
+			     qpdb->node_lock_count, sizeof(atomic_bool));
+	}
 	/*
 	 * Clean up dead node buckets.
 	 */
@@ -3059,15 +3618,7 @@ find_header:
 			if (header->ttl > newheader->ttl) {
 				setttl(header, newheader->ttl);
 			}
-			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-			}
+			refresh_header(qpdb, header, now);
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
 			{
@@ -3121,15 +3672,7 @@ find_header:
 			if (header->ttl > newheader->ttl) {
 				setttl(header, newheader->ttl);
 			}
-			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-			}
+			refresh_header(qpdb, header, now);
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
 			{
@@ -3154,14 +3697,7 @@ find_header:
 		if (loading) {
 			newheader->down = NULL;
 			idx = HEADERNODE(newheader)->locknum;
-			if (ZEROTTL(newheader)) {
-				newheader->last_used = qpdb->last_used + 1;
-				ISC_LIST_APPEND(qpdb->lru[idx], newheader,
-						link);
-			} else {
-				ISC_LIST_PREPEND(qpdb->lru[idx], newheader,
-						 link);
-			}
+			lru_add(qpdb, idx, newheader);
 			INSIST(qpdb->heaps != NULL);
 			isc_heap_insert(qpdb->heaps[idx], newheader);
 			newheader->heap = qpdb->heaps[idx];
@@ -3184,14 +3720,7 @@ find_header:
 			INSIST(qpdb->heaps != NULL);
 			isc_heap_insert(qpdb->heaps[idx], newheader);
 			newheader->heap = qpdb->heaps[idx];
-			if (ZEROTTL(newheader)) {
-				newheader->last_used = qpdb->last_used + 1;
-				ISC_LIST_APPEND(qpdb->lru[idx], newheader,
-						link);
-			} else {
-				ISC_LIST_PREPEND(qpdb->lru[idx], newheader,
-						 link);
-			}
+			lru_add(qpdb, idx, newheader);
 			if (topheader_prev != NULL) {
 				topheader_prev->next = newheader;
 			} else {
@@ -3223,11 +3752,7 @@ find_header:
 		idx = HEADERNODE(newheader)->locknum;
 		isc_heap_insert(qpdb->heaps[idx], newheader);
 		newheader->heap = qpdb->heaps[idx];
-		if (ZEROTTL(newheader)) {
-			ISC_LIST_APPEND(qpdb->lru[idx], newheader, link);
-		} else {
-			ISC_LIST_PREPEND(qpdb->lru[idx], newheader, link);
-		}
+		lru_add(qpdb, idx, newheader);
 
 		if (topheader != NULL) {
 			/*
@@ -3400,6 +3925,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	bool cache_is_overmem = false;
 	dns_fixedname_t fixed;
 	dns_name_t *name = NULL;
+	bool packed = false;
 
 	REQUIRE(VALID_QPDB(qpdb));
 	REQUIRE(version == NULL);
@@ -3415,6 +3941,12 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		return (result);
 	}
 
+	if (atomic_load_relaxed(&qpdb->packrecords)) {
+		packed = dns_rdataslab_pack(qpdb->common.mctx, &region,
+					    sizeof(dns_slabheader_t),
+					    rdataset->rdclass, rdataset->type);
+	}
+
 	name = dns_fixedname_initname(&fixed);
 	dns_name_copy(&qpnode->name, name);
 	dns_rdataset_getownercase(rdataset, name);
@@ -3424,6 +3956,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		.type = DNS_TYPEPAIR_VALUE(rdataset->type, rdataset->covers),
 		.trust = rdataset->trust,
 		.last_used = now,
+		.packed = packed,
 		.node = qpnode,
 	};
 
@@ -3473,11 +4006,13 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 
 	/*
-	 * Add to the auxiliary NSEC tree if we're adding an NSEC record.
+	 * Add to the auxiliary NSEC or NSEC3 tree if we're adding an
+	 * NSEC or NSEC3 record.
 	 */
 	TREE_RDLOCK(&qpdb->tree_lock, &tlocktype);
-	if (qpnode->nsec != DNS_DB_NSEC_HAS_NSEC &&
-	    rdataset->type == dns_rdatatype_nsec)
+	if ((rdataset->type == dns_rdatatype_nsec ||
+	     rdataset->type == dns_rdatatype_nsec3) &&
+	    nsec_with(qpnode->nsec, rdataset->type) != qpnode->nsec)
 	{
 		newnsec = true;
 	} else {
@@ -3503,6 +4038,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		overmem(qpdb, newheader, &tlocktype DNS__DB_FLARG_PASS);
 	}
 
+	admit(qpdb, &qpnode->name, newheader, cache_is_overmem);
+	reclaim_start(qpdb);
+
 	NODE_WRLOCK(&qpdb->node_locks[qpnode->locknum].lock, &nlocktype);
 
 	if (qpdb->rrsetstats != NULL) {
@@ -3525,22 +4063,26 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 
 	result = ISC_R_SUCCESS;
-	if (newnsec) {
+	if (newnsec &&
+	    nsec_with(qpnode->nsec, rdataset->type) != qpnode->nsec)
+	{
+		bool nsec3 = (rdataset->type == dns_rdatatype_nsec3);
+		dns_qp_t *aux = nsec3 ? qpdb->nsec3 : qpdb->nsec;
 		qpcnode_t *nsecnode = NULL;
 
-		result = dns_qp_getname(qpdb->nsec, name, (void **)&nsecnode,
-					NULL);
+		result = dns_qp_getname(aux, name, (void **)&nsecnode, NULL);
 		if (result == ISC_R_SUCCESS) {
 			result = ISC_R_SUCCESS;
 		} else {
 			INSIST(nsecnode == NULL);
 			nsecnode = new_qpcnode(qpdb, name);
-			nsecnode->nsec = DNS_DB_NSEC_NSEC;
-			result = dns_qp_insert(qpdb->nsec, nsecnode, 0);
+			nsecnode->nsec = nsec3 ? DNS_DB_NSEC_NSEC3
+					       : DNS_DB_NSEC_NSEC;
+			result = dns_qp_insert(aux, nsecnode, 0);
 			INSIST(result == ISC_R_SUCCESS);
 			qpcnode_detach(&nsecnode);
 		}
-		qpnode->nsec = DNS_DB_NSEC_HAS_NSEC;
+		qpnode->nsec = nsec_with(qpnode->nsec, rdataset->type);
 	}
 
 	if (result == ISC_R_SUCCESS) {
@@ -3611,6 +4153,9 @@ nodecount(dns_db_t *db, dns_dbtree_t tree) {
 	case dns_dbtree_nsec:
 		mu = dns_qp_memusage(qpdb->nsec);
 		break;
+	case dns_dbtree_nsec3:
+		mu = dns_qp_memusage(qpdb->nsec3);
+		break;
 	default:
 		UNREACHABLE();
 	}
@@ -3702,6 +4247,18 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
 		ISC_LIST_INIT(qpdb->lru[i]);
 	}
+	qpdb->sieve_hand = isc_mem_cget(mctx, qpdb->node_lock_count,
+					sizeof(dns_slabheader_t *));
+	qpdb->sketch = isc_mem_cget(mctx,
+				    DNS_QPDB_SKETCH_ROWS * DNS_QPDB_SKETCH_WIDTH,
+				    sizeof(qpdb->sketch[0]));
+	qpdb->reclaim_jobs = isc_mem_cget(mctx, qpdb->node_lock_count,
+					  sizeof(isc_job_t));
+	qpdb->reclaiming = isc_mem_cget(mctx, qpdb->node_lock_count,
+					sizeof(atomic_bool));
+	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
+		atomic_init(&qpdb->reclaiming[i], false);
+	}
 
 	/*
 	 * Create the heaps.
@@ -3709,8 +4266,8 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	qpdb->heaps = isc_mem_cget(hmctx, qpdb->node_lock_count,
 				   sizeof(isc_heap_t *));
 	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
-		isc_heap_create(hmctx, ttl_sooner, set_index, 0,
-				&qpdb->heaps[i]);
+		isc_heap_create_ex(hmctx, ttl_sooner, set_index, 0,
+				   ISC_HEAP_QUATERNARY, &qpdb->heaps[i]);
 	}
 
 	/*
@@ -3748,6 +4305,7 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	 */
 	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->tree);
 	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->nsec);
+	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->nsec3);
 
 	qpdb->common.magic = DNS_DB_MAGIC;
 	qpdb->common.impmagic = QPDB_MAGIC;
@@ -4303,7 +4861,7 @@ deletedata(dns_db_t *db ISC_ATTR_UNUSED, dns_dbnode_t *node ISC_ATTR_UNUSED,
 
 	if (ISC_LINK_LINKED(header, link)) {
 		int idx = HEADERNODE(header)->locknum;
-		ISC_LIST_UNLINK(qpdb->lru[idx], header, link);
+		lru_unlink(qpdb, idx, header);
 	}
 
 	if (header->noqname != NULL) {
@@ -4362,6 +4920,34 @@ setmaxrrperset(dns_db_t *db, uint32_t value) {
 	qpdb->maxrrperset = value;
 }
 
+static void
+setevictionpolicy(dns_db_t *db, dns_cacheeviction_t policy) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	atomic_store_relaxed(&qpdb->evictionpolicy, policy);
+}
+
+static void
+setpackrecords(dns_db_t *db, bool value) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	atomic_store_relaxed(&qpdb->packrecords, value);
+}
+
+static void
+setreclaimwater(dns_db_t *db, size_t hiwater, size_t lowater) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	atomic_store_relaxed(&qpdb->reclaim_lowater, lowater);
+	atomic_store_relaxed(&qpdb->reclaim_hiwater, hiwater);
+}
+
 static void
 setmaxtypepername(dns_db_t *db, uint32_t value) {
 	qpcache_t *qpdb = (qpcache_t *)db;
@@ -4371,6 +4957,58 @@ setmaxtypepername(dns_db_t *db, uint32_t value) {
 	qpdb->maxtypepername = value;
 }
 
+/*
+ * Expire everything at and below 'name' in a single walk over that
+ * part of the tree.  The headers are only marked ancient, which is
+ * cheap; they are freed later, as expired data is, by the TTL-based
+ * cleaning of their lock bucket or when the node is next released.
+ * That keeps the tree lock a read lock, so lookups carry on while a
+ * large subtree is flushed.
+ */
+static isc_result_t
+expiretree(dns_db_t *db, const dns_name_t *name) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	dns_qpiter_t iter;
+	qpcnode_t *node = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	TREE_RDLOCK(&qpdb->tree_lock, &tlocktype);
+
+	/*
+	 * The names below 'name' follow it directly in the tree; if it
+	 * isn't there itself, the iterator is left on its predecessor.
+	 */
+	result = dns_qp_lookup(qpdb->tree, name, NULL, &iter, NULL,
+			       (void **)&node, NULL);
+	if (result != ISC_R_SUCCESS) {
+		result = dns_qpiter_next(&iter, NULL, (void **)&node, NULL);
+	}
+
+	while (result == ISC_R_SUCCESS &&
+	       dns_name_issubdomain(&node->name, name))
+	{
+		isc_rwlock_t *lock = &qpdb->node_locks[node->locknum].lock;
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+		NODE_WRLOCK(lock, &nlocktype);
+		for (dns_slabheader_t *header = node->data; header != NULL;
+		     header = header->next)
+		{
+			mark_ancient(header);
+		}
+		NODE_UNLOCK(lock, &nlocktype);
+
+		result = dns_qpiter_next(&iter, NULL, (void **)&node, NULL);
+	}
+
+	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
+
+	return (ISC_R_SUCCESS);
+}
+
 static dns_dbmethods_t qpdb_cachemethods = {
 	.destroy = qpdb_destroy,
 	.findnode = findnode,
@@ -4397,6 +5035,10 @@ static dns_dbmethods_t qpdb_cachemethods = {
 	.deletedata = deletedata,
 	.setmaxrrperset = setmaxrrperset,
 	.setmaxtypepername = setmaxtypepername,
+	.setevictionpolicy = setevictionpolicy,
+	.setpackrecords = setpackrecords,
+	.setreclaimwater = setreclaimwater,
+	.expiretree = expiretree,
 };
 
 static void
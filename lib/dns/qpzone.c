@@ -38,6 +38,7 @@
 #include <isc/time.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/db.h>
@@ -53,6 +54,7 @@
 #include <dns/rdatasetiter.h>
 #include <dns/rdataslab.h>
 #include <dns/rdatastruct.h>
+#include <dns/slabstore.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/view.h>
@@ -119,6 +121,7 @@ typedef struct qpz_version qpz_version_t;
 struct qpz_version {
 	/* Not locked */
 	uint32_t serial;
+	uint64_t id;
 	qpzonedb_t *qpdb;
 	isc_refcount_t references;
 	/* Locked by database lock. */
@@ -153,6 +156,7 @@ struct qpznode {
 	isc_refcount_t references;
 	isc_refcount_t erefs;
 	uint16_t locknum;
+	uint32_t changed_serial; /* last version that changed the node */
 	void *data;
 	atomic_uint_fast8_t nsec;
 	atomic_bool wild;
@@ -171,6 +175,7 @@ struct qpzonedb {
 	qpznode_t *origin;
 	qpznode_t *nsec3_origin;
 	isc_stats_t *gluecachestats;
+	dns_slabstore_t *slabstore; /* slabs shared with other zones */
 	/* Locked by lock. */
 	unsigned int active;
 	unsigned int attributes;
@@ -213,6 +218,17 @@ typedef struct {
 	isc_stdtime_t now;
 } qpz_search_t;
 
+/*
+ * An RRset found in the zone for the additional section of an answer.
+ */
+typedef struct qpz_additional qpz_additional_t;
+struct qpz_additional {
+	qpz_additional_t *next;
+	dns_fixedname_t fixedname;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+};
+
 typedef struct dns_gluenode_t {
 	isc_mem_t *mctx;
 
@@ -220,6 +236,30 @@ typedef struct dns_gluenode_t {
 
 	qpznode_t *node;
 
+	/*
+	 * The glue table holds the glue of delegations (type NS), and
+	 * the additional data of MX and SRV RRsets.  For the latter,
+	 * 'incomplete' is set if any of the targets could not be fully
+	 * resolved in this version of the zone, in which case the
+	 * caller has to fall back to regular additional section
+	 * processing.  Additional data is not carried over to new
+	 * versions, as a change anywhere above a target (a new
+	 * delegation or DNAME, say) can affect it.
+	 */
+	dns_rdatatype_t type;
+	qpz_additional_t *additional;
+	bool incomplete;
+
+	/*
+	 * The nodes of the NS targets that exist in the zone, whether or
+	 * not they have addresses, so that the glue can be carried over to
+	 * a new version unless one of them changed.  'missing' is set if
+	 * an in-zone NS target has no node at all.
+	 */
+	qpznode_t **targets;
+	size_t ntargets;
+	bool missing;
+
 	struct cds_lfht_node ht_node;
 	struct rcu_head rcu_head;
 } dns_gluenode_t;
@@ -233,6 +273,7 @@ typedef struct {
 	dns_qp_t *tree;
 	dns_qp_t *nsec;
 	dns_qp_t *nsec3;
+	qpznode_t *last; /*%< Owner of the previous rdataset */
 } qpz_load_t;
 
 static dns_dbmethods_t qpdb_zonemethods;
@@ -340,6 +381,12 @@ typedef struct qpdb_dbiterator {
  */
 static atomic_uint_fast16_t init_count = 0;
 
+/*%
+ * 'next_versionid' hands out the process-wide unique identifiers returned
+ * by dns_db_versionid(); zero is reserved for "not supported".
+ */
+static atomic_uint_fast64_t next_versionid = 1;
+
 /*
  * Locking
  *
@@ -381,6 +428,8 @@ set_index(void *what, unsigned int idx) {
 
 static void
 free_gluenode(dns_gluenode_t *gluenode);
+static void
+carryglue(qpzonedb_t *qpdb, qpz_version_t *from, qpz_version_t *to);
 
 static void
 free_gluetable(struct cds_lfht *glue_table) {
@@ -414,6 +463,9 @@ free_db_rcu(struct rcu_head *rcu_head) {
 	if (qpdb->gluecachestats != NULL) {
 		isc_stats_detach(&qpdb->gluecachestats);
 	}
+	if (qpdb->slabstore != NULL) {
+		dns_slabstore_detach(&qpdb->slabstore);
+	}
 
 	isc_mem_cput(qpdb->common.mctx, qpdb->node_locks, qpdb->node_lock_count,
 		     sizeof(db_nodelock_t));
@@ -549,6 +601,7 @@ allocate_version(isc_mem_t *mctx, uint32_t serial, unsigned int references,
 	qpz_version_t *version = isc_mem_get(mctx, sizeof(*version));
 	*version = (qpz_version_t){
 		.serial = serial,
+		.id = atomic_fetch_add_relaxed(&next_versionid, 1),
 		.writer = writer,
 		.changed_list = ISC_LIST_INITIALIZER,
 		.resigned_list = ISC_LIST_INITIALIZER,
@@ -573,6 +626,11 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	isc_result_t result;
 	dns_qp_t *qp = NULL;
 
+	/* This database implementation does not support cache semantics */
+	if (type == dns_dbtype_cache) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	qpdb = isc_mem_get(mctx, sizeof(*qpdb));
 	*qpdb = (qpzonedb_t){
 		.common.origin = DNS_NAME_INITEMPTY,
@@ -623,6 +681,9 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->tree);
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->nsec);
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->nsec3);
+	dns_qpmulti_interleave(qpdb->tree);
+	dns_qpmulti_interleave(qpdb->nsec);
+	dns_qpmulti_interleave(qpdb->nsec3);
 
 	/*
 	 * Version initialization.
@@ -685,6 +746,22 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	return (ISC_R_SUCCESS);
 }
 
+void
+dns__qpzone_setslabstore(dns_db_t *db, dns_slabstore_t *store) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(store != NULL);
+
+	if (!VALID_QPZONE(qpdb) || IS_STUB(qpdb)) {
+		return;
+	}
+
+	REQUIRE(qpdb->slabstore == NULL);
+
+	qpdb->slabstore = dns_slabstore_ref(store);
+}
+
 static void
 newref(qpzonedb_t *qpdb, qpznode_t *node DNS__DB_FLARG) {
 	uint_fast32_t refs;
@@ -948,9 +1025,10 @@ bindrdataset(qpzonedb_t *qpdb, qpznode_t *node, dns_slabheader_t *header,
 
 	rdataset->slab.db = (dns_db_t *)qpdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
-	rdataset->slab.raw = dns_slabheader_raw(header);
+	rdataset->slab.raw = (unsigned char *)(header + 1);
 	rdataset->slab.iter_pos = NULL;
 	rdataset->slab.iter_count = 0;
+	rdataset->slab.shared = header->shared;
 
 	/*
 	 * Add noqname proof.
@@ -1207,12 +1285,17 @@ newversion(dns_db_t *db, dns_dbversion_t **versionp) {
 }
 
 static void
-resigninsert(qpzonedb_t *qpdb, dns_slabheader_t *newheader) {
+resigninsert(qpzonedb_t *qpdb, dns_slabheader_t *newheader, bool loading) {
 	REQUIRE(newheader->heap_index == 0);
 	REQUIRE(!ISC_LINK_LINKED(newheader, link));
 
 	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
-	isc_heap_insert(qpdb->heap, newheader);
+	if (loading) {
+		/* Put in order by endload() */
+		isc_heap_append(qpdb->heap, newheader);
+	} else {
+		isc_heap_insert(qpdb->heap, newheader);
+	}
 	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
 
 	newheader->heap = qpdb->heap;
@@ -1273,15 +1356,103 @@ rollback_node(qpznode_t *node, uint32_t serial) {
 	}
 }
 
+/*
+ * Release the nodes on a list of changed records, rolling back the
+ * changes made in 'serial' first if 'rollback' is true.
+ */
+static void
+cleanup_changed(qpzonedb_t *qpdb, qpz_changedlist_t *cleanup_list,
+		bool rollback, uint32_t serial, uint32_t least_serial) {
+	qpz_changed_t *changed = NULL, *next_changed = NULL;
+
+	for (changed = HEAD(*cleanup_list); changed != NULL;
+	     changed = next_changed)
+	{
+		qpznode_t *node = changed->node;
+		isc_rwlock_t *lock = &qpdb->node_locks[node->locknum].lock;
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+		next_changed = NEXT(changed, link);
+
+		NODE_WRLOCK(lock, &nlocktype);
+		if (rollback) {
+			rollback_node(node, serial);
+		}
+		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FILELINE);
+
+		NODE_UNLOCK(lock, &nlocktype);
+
+		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	}
+	ISC_LIST_INIT(*cleanup_list);
+}
+
+/*
+ * When a commit, or the close of an old version that a long reader such
+ * as an outgoing zone transfer kept open, leaves many changed records
+ * to release, the release takes each of their node locks in turn.  So
+ * that the thread which happened to close the version does not pay for
+ * it, it is handed over to the thread pool if the list is longer than
+ * this and the caller runs on a loop.
+ */
+#define CLEANUP_DEFER_MIN 1024
+
+typedef struct qpz_cleanup {
+	dns_db_t *db;
+	qpz_changedlist_t list;
+} qpz_cleanup_t;
+
+static void
+cleanup_work(void *arg) {
+	qpz_cleanup_t *cleanup = arg;
+
+	/* The least serial may have moved on; decref() looks it up */
+	cleanup_changed((qpzonedb_t *)cleanup->db, &cleanup->list, false, 0,
+			0);
+}
+
+static void
+cleanup_done(void *arg) {
+	qpz_cleanup_t *cleanup = arg;
+	dns_db_t *db = cleanup->db;
+
+	isc_mem_put(db->mctx, cleanup, sizeof(*cleanup));
+	dns_db_detach(&db);
+}
+
+static bool
+cleanup_defer(qpzonedb_t *qpdb, qpz_changedlist_t *cleanup_list) {
+	qpz_changed_t *changed = HEAD(*cleanup_list);
+	qpz_cleanup_t *cleanup = NULL;
+	isc_loop_t *loop = isc_loop();
+
+	if (loop == NULL) {
+		return (false);
+	}
+	for (size_t n = 0; n < CLEANUP_DEFER_MIN; n++) {
+		if (changed == NULL) {
+			return (false);
+		}
+		changed = NEXT(changed, link);
+	}
+
+	cleanup = isc_mem_get(qpdb->common.mctx, sizeof(*cleanup));
+	*cleanup = (qpz_cleanup_t){ .list = *cleanup_list };
+	ISC_LIST_INIT(*cleanup_list);
+	dns_db_attach((dns_db_t *)qpdb, &cleanup->db);
+
+	isc_work_enqueue_bulk(loop, cleanup_work, cleanup_done, cleanup);
+
+	return (true);
+}
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	     bool commit DNS__DB_FLARG) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
 	qpz_version_t *version = NULL, *cleanup_version = NULL;
 	qpz_version_t *least_greater = NULL;
-	qpznode_t *node = NULL;
 	bool rollback = false;
-	qpz_changed_t *changed = NULL, *next_changed = NULL;
 	qpz_changedlist_t cleanup_list;
 	dns_slabheaderlist_t resigned_list;
 	dns_slabheader_t *header = NULL;
@@ -1304,7 +1475,14 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	 * it the current version.
 	 */
 	if (version->writer && commit) {
+		qpz_version_t *current = NULL;
+
 		setsecure(db, version, qpdb->origin);
+
+		RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+		current = qpdb->current_version;
+		RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+		carryglue(qpdb, current, version);
 	}
 
 	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
@@ -1465,37 +1643,20 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 		lock = &qpdb->node_locks[HEADERNODE(header)->locknum].lock;
 		NODE_WRLOCK(lock, &nlocktype);
 		if (rollback && !IGNORE(header)) {
-			resigninsert(qpdb, header);
+			resigninsert(qpdb, header, false);
 		}
 		decref(qpdb, HEADERNODE(header), least_serial,
 		       &nlocktype DNS__DB_FLARG_PASS);
 		NODE_UNLOCK(lock, &nlocktype);
 	}
 
-	if (EMPTY(cleanup_list)) {
-		*versionp = NULL;
-		return;
-	}
-
-	for (changed = HEAD(cleanup_list); changed != NULL;
-	     changed = next_changed)
-	{
-		isc_rwlock_t *lock = NULL;
-		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
-
-		next_changed = NEXT(changed, link);
-		node = changed->node;
-		lock = &qpdb->node_locks[node->locknum].lock;
-
-		NODE_WRLOCK(lock, &nlocktype);
-		if (rollback) {
-			rollback_node(node, serial);
-		}
-		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FILELINE);
-
-		NODE_UNLOCK(lock, &nlocktype);
-
-		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	/*
+	 * A rollback must be finished before the next writer reuses the
+	 * serial number, so it is never deferred.
+	 */
+	if (rollback || !cleanup_defer(qpdb, &cleanup_list)) {
+		cleanup_changed(qpdb, &cleanup_list, rollback, serial,
+				least_serial);
 	}
 
 	*versionp = NULL;
@@ -1602,35 +1763,44 @@ loading_addnode(qpz_load_t *loadctx, const dns_name_t *name,
 	isc_result_t result;
 	qpznode_t *node = NULL, *nsecnode = NULL;
 
+	/*
+	 * Most names are new when the data is loaded in order, so try
+	 * to insert the node straight away and only look for the
+	 * existing one if that fails.
+	 */
 	if (type == dns_rdatatype_nsec3 || covers == dns_rdatatype_nsec3) {
-		result = dns_qp_getname(loadctx->nsec3, name, (void **)&node,
-					NULL);
+		node = new_qpznode(qpdb, name);
+		result = dns_qp_insert(loadctx->nsec3, node, 0);
 		if (result == ISC_R_SUCCESS) {
+			node->nsec = DNS_DB_NSEC_NSEC3;
 			*nodep = node;
+			qpznode_detach(&node);
 		} else {
-			node = new_qpznode(qpdb, name);
-			result = dns_qp_insert(loadctx->nsec3, node, 0);
+			INSIST(result == ISC_R_EXISTS);
+			qpznode_detach(&node);
+			result = dns_qp_getname(loadctx->nsec3, name,
+						(void **)&node, NULL);
 			INSIST(result == ISC_R_SUCCESS);
-			node->nsec = DNS_DB_NSEC_NSEC3;
 			*nodep = node;
-			qpznode_detach(&node);
 		}
 		return;
 	}
 
-	result = dns_qp_getname(loadctx->tree, name, (void **)&node, NULL);
+	node = new_qpznode(qpdb, name);
+	result = dns_qp_insert(loadctx->tree, node, 0);
 	if (result == ISC_R_SUCCESS) {
+		qpznode_unref(node);
+	} else {
+		INSIST(result == ISC_R_EXISTS);
+		qpznode_detach(&node);
+		result = dns_qp_getname(loadctx->tree, name, (void **)&node,
+					NULL);
+		INSIST(result == ISC_R_SUCCESS);
 		if (type == dns_rdatatype_nsec &&
 		    node->nsec == DNS_DB_NSEC_HAS_NSEC)
 		{
 			goto done;
 		}
-	} else {
-		INSIST(node == NULL);
-		node = new_qpznode(qpdb, name);
-		result = dns_qp_insert(loadctx->tree, node, 0);
-		INSIST(result == ISC_R_SUCCESS);
-		qpznode_unref(node);
 	}
 	if (type != dns_rdatatype_nsec) {
 		goto done;
@@ -1732,16 +1902,52 @@ add_changed(dns_slabheader_t *header, qpz_version_t *version DNS__DB_FLARG) {
 
 	*changed = (qpz_changed_t){ .node = node };
 	ISC_LIST_INITANDAPPEND(version->changed_list, changed, link);
+	node->changed_serial = version->serial;
 	newref(qpdb, node DNS__DB_FLARG_PASS);
 	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
 
 	return (changed);
 }
 
+/*
+ * dns_rdataslab_merge() and dns_rdataslab_subtract() need the records
+ * of the old header to follow it in memory: if they are in the slab
+ * store, return a private copy of the header and its records to pass
+ * them, which is freed by freeprivateheader().
+ */
+static dns_slabheader_t *
+privateheader(qpzonedb_t *qpdb, dns_slabheader_t *header) {
+	dns_slabheader_t *copy = NULL;
+	unsigned char *raw = NULL;
+	unsigned int size;
+
+	if (!header->shared) {
+		return (header);
+	}
+
+	raw = dns_slabheader_raw(header);
+	size = dns_rdataslab_size(raw, 0);
+	copy = isc_mem_get(qpdb->common.mctx, sizeof(*copy) + size);
+	*copy = *header;
+	copy->shared = 0;
+	memmove(copy + 1, raw, size);
+
+	return (copy);
+}
+
+static void
+freeprivateheader(qpzonedb_t *qpdb, dns_slabheader_t *header,
+		  dns_slabheader_t *copy) {
+	if (copy != header) {
+		isc_mem_put(qpdb->common.mctx, copy,
+			    dns_rdataslab_size((unsigned char *)copy,
+					       sizeof(*copy)));
+	}
+}
+
 static uint64_t
 recordsize(dns_slabheader_t *header, unsigned int namelen) {
-	return (dns_rdataslab_rdatasize((unsigned char *)header,
-					sizeof(*header)) +
+	return (dns_rdataslab_rdatasize(dns_slabheader_raw(header), 0) +
 		sizeof(dns_ttl_t) + sizeof(dns_rdatatype_t) +
 		sizeof(dns_rdataclass_t) + namelen);
 }
@@ -1749,19 +1955,20 @@ recordsize(dns_slabheader_t *header, unsigned int namelen) {
 static void
 maybe_update_recordsandsize(bool add, qpz_version_t *version,
 			    dns_slabheader_t *header, unsigned int namelen) {
-	unsigned char *hdr = (unsigned char *)header;
-	size_t hdrsize = sizeof(*header);
+	unsigned char *raw = NULL;
 
 	if (NONEXISTENT(header)) {
 		return;
 	}
 
+	raw = dns_slabheader_raw(header);
+
 	RWLOCK(&version->rwlock, isc_rwlocktype_write);
 	if (add) {
-		version->records += dns_rdataslab_count(hdr, hdrsize);
+		version->records += dns_rdataslab_count(raw, 0);
 		version->xfrsize += recordsize(header, namelen);
 	} else {
-		version->records -= dns_rdataslab_count(hdr, hdrsize);
+		version->records -= dns_rdataslab_count(raw, 0);
 		version->xfrsize -= recordsize(header, namelen);
 	}
 	RWUNLOCK(&version->rwlock, isc_rwlocktype_write);
@@ -1841,13 +2048,16 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 				flags |= DNS_RDATASLAB_FORCE;
 			}
 			if (result == ISC_R_SUCCESS) {
+				dns_slabheader_t *oldheader =
+					privateheader(qpdb, header);
 				result = dns_rdataslab_merge(
-					(unsigned char *)header,
+					(unsigned char *)oldheader,
 					(unsigned char *)newheader,
 					(unsigned int)(sizeof(*newheader)),
 					qpdb->common.mctx, qpdb->common.rdclass,
 					(dns_rdatatype_t)header->type, flags,
 					qpdb->maxrrperset, &merged);
+				freeprivateheader(qpdb, header, oldheader);
 			}
 			if (result == ISC_R_SUCCESS) {
 				/*
@@ -1882,7 +2092,7 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 		if (loading) {
 			newheader->down = NULL;
 			if (RESIGN(newheader)) {
-				resigninsert(qpdb, newheader);
+				resigninsert(qpdb, newheader, true);
 				/* resigndelete not needed here */
 			}
 
@@ -1903,7 +2113,7 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 			dns_slabheader_destroy(&header);
 		} else {
 			if (RESIGN(newheader)) {
-				resigninsert(qpdb, newheader);
+				resigninsert(qpdb, newheader, false);
 				resigndelete(qpdb, version,
 					     header DNS__DB_FLARG_PASS);
 			}
@@ -1935,7 +2145,7 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 		}
 
 		if (RESIGN(newheader)) {
-			resigninsert(qpdb, newheader);
+			resigninsert(qpdb, newheader, loading);
 			resigndelete(qpdb, version, header DNS__DB_FLARG_PASS);
 		}
 
@@ -2056,6 +2266,24 @@ addwildcards(qpzonedb_t *qpdb, dns_qp_t *qp, const dns_name_t *name) {
 	}
 }
 
+/*
+ * Whether RRsets of 'type' may be the same in other zones, and are worth
+ * looking up in the slab store: the SOA and the DNSSEC records that
+ * cover the names of the zone never are.
+ */
+static bool
+shareable(dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_soa:
+	case dns_rdatatype_rrsig:
+	case dns_rdatatype_nsec:
+	case dns_rdatatype_nsec3:
+		return (false);
+	default:
+		return (true);
+	}
+}
+
 static isc_result_t
 loading_addrdataset(void *arg, const dns_name_t *name,
 		    dns_rdataset_t *rdataset DNS__DB_FLARG) {
@@ -2066,6 +2294,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	isc_region_t region;
 	dns_slabheader_t *newheader = NULL;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	bool nsec3;
 
 	REQUIRE(rdataset->rdclass == qpdb->common.rdclass);
 
@@ -2078,12 +2307,6 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		return (DNS_R_NOTZONETOP);
 	}
 
-	if (rdataset->type != dns_rdatatype_nsec3 &&
-	    rdataset->covers != dns_rdatatype_nsec3)
-	{
-		addwildcards(qpdb, loadctx->tree, name);
-	}
-
 	if (dns_name_iswildcard(name)) {
 		if (rdataset->type == dns_rdatatype_ns) {
 			/*
@@ -2098,11 +2321,35 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 			 */
 			return (DNS_R_INVALIDNSEC3);
 		}
-
-		wildcardmagic(qpdb, loadctx->tree, name);
 	}
 
-	loading_addnode(loadctx, name, rdataset->type, rdataset->covers, &node);
+	nsec3 = (rdataset->type == dns_rdatatype_nsec3 ||
+		 rdataset->covers == dns_rdatatype_nsec3);
+
+	/*
+	 * Zone transfers and master files in canonical order deliver
+	 * all the rdatasets of an owner name one after another; if
+	 * this is the owner of the previous rdataset, the node and the
+	 * wildcard bookkeeping are already in place.  NSEC records
+	 * still go through loading_addnode() to update the NSEC tree.
+	 */
+	if (loadctx->last != NULL && rdataset->type != dns_rdatatype_nsec &&
+	    (loadctx->last->nsec == DNS_DB_NSEC_NSEC3) == nsec3 &&
+	    dns_name_equal(&loadctx->last->name, name))
+	{
+		node = loadctx->last;
+	} else {
+		if (!nsec3) {
+			addwildcards(qpdb, loadctx->tree, name);
+		}
+		if (dns_name_iswildcard(name)) {
+			wildcardmagic(qpdb, loadctx->tree, name);
+		}
+
+		loading_addnode(loadctx, name, rdataset->type,
+				rdataset->covers, &node);
+		loadctx->last = node;
+	}
 	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
 					    &region, sizeof(dns_slabheader_t),
 					    qpdb->maxrrperset);
@@ -2131,6 +2378,10 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		newheader->resign_lsb = rdataset->resign & 0x1;
 	}
 
+	if (qpdb->slabstore != NULL && shareable(rdataset->type)) {
+		newheader = dns_slabheader_share(newheader, qpdb->slabstore);
+	}
+
 	NODE_WRLOCK(&qpdb->node_locks[node->locknum].lock, &nlocktype);
 	result = add(qpdb, node, name, qpdb->current_version, newheader,
 		     DNS_DBADD_MERGE, true, NULL, 0 DNS__DB_FLARG_PASS);
@@ -2223,6 +2474,9 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	qpdb->attributes &= ~QPDB_ATTR_LOADING;
 	qpdb->attributes |= QPDB_ATTR_LOADED;
 
+	/* Order the resigning heap filled by loading_addrdataset() */
+	isc_heap_heapify(qpdb->heap);
+
 	if (qpdb->origin != NULL) {
 		dns_dbversion_t *version = qpdb->current_version;
 		RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
@@ -2368,7 +2622,7 @@ setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 		RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
 	} else if (resign != 0) {
 		DNS_SLABHEADER_SETATTR(header, DNS_SLABHEADERATTR_RESIGN);
-		resigninsert(qpdb, header);
+		resigninsert(qpdb, header, false);
 	}
 	NODE_UNLOCK(&qpdb->node_locks[HEADERNODE(header)->locknum].lock,
 		    &nlocktype);
@@ -2480,7 +2734,7 @@ findnodeintree(qpzonedb_t *qpdb, const dns_name_t *name, bool create,
 	newref(qpdb, node DNS__DB_FLARG_PASS);
 
 	if (create) {
-		dns_qp_compact(qp, DNS_QPGC_MAYBE);
+		dns_qp_compact(qp, DNS_QPGC_STEP);
 		dns_qpmulti_commit(dbtree, &qp);
 	} else {
 		dns_qpread_destroy(dbtree, &qpr);
@@ -2524,7 +2778,7 @@ matchparams(dns_slabheader_t *header, qpz_search_t *search) {
 
 	REQUIRE(header->type == dns_rdatatype_nsec3);
 
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = dns_slabheader_raw(header);
 	count = raw[0] * 256 + raw[1]; /* count */
 	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
 
@@ -4784,13 +5038,16 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 			}
 		}
 		if (result == ISC_R_SUCCESS) {
+			dns_slabheader_t *oldheader = privateheader(qpdb,
+								    header);
 			result = dns_rdataslab_subtract(
-				(unsigned char *)header,
+				(unsigned char *)oldheader,
 				(unsigned char *)newheader,
 				(unsigned int)(sizeof(*newheader)),
 				qpdb->common.mctx, qpdb->common.rdclass,
 				(dns_rdatatype_t)header->type, flags,
 				&subresult);
+			freeprivateheader(qpdb, header, oldheader);
 		}
 		if (result == ISC_R_SUCCESS) {
 			dns_slabheader_destroy(&newheader);
@@ -4802,7 +5059,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 					newheader, DNS_SLABHEADERATTR_RESIGN);
 				newheader->resign = header->resign;
 				newheader->resign_lsb = header->resign_lsb;
-				resigninsert(qpdb, newheader);
+				resigninsert(qpdb, newheader, false);
 			}
 			/*
 			 * We have to set the serial since the rdataslab
@@ -5153,15 +5410,110 @@ addglue_to_message(dns_glue_t *ge, dns_message_t *msg) {
 	}
 }
 
+/*
+ * Whether 'name'/'type' is already in the response, or, if it isn't,
+ * the name in the additional section it should be added to; this is
+ * what query_isduplicate() does for regular additional data.
+ */
+static bool
+additional_isduplicate(dns_message_t *msg, const dns_name_t *name,
+		       dns_rdatatype_t type, dns_name_t **mnamep) {
+	dns_name_t *mname = NULL;
+
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL; section++)
+	{
+		isc_result_t result = dns_message_findname(
+			msg, section, name, type, 0, &mname, NULL);
+		if (result == ISC_R_SUCCESS) {
+			return (true);
+		} else if (result == DNS_R_NXRRSET &&
+			   section == DNS_SECTION_ADDITIONAL)
+		{
+			break;
+		}
+		mname = NULL;
+	}
+
+	*mnamep = mname;
+	return (false);
+}
+
+static void
+addadditional_to_message(qpz_additional_t *ae, bool dnssec,
+			 dns_message_t *msg) {
+	for (; ae != NULL; ae = ae->next) {
+		dns_name_t *aname = dns_fixedname_name(&ae->fixedname);
+		dns_name_t *name = NULL;
+		dns_rdataset_t *rdataset = NULL;
+
+		if (additional_isduplicate(msg, aname, ae->rdataset.type,
+					   &name))
+		{
+			continue;
+		}
+
+		if (name == NULL) {
+			dns_message_gettempname(msg, &name);
+			dns_name_copy(aname, name);
+			dns_message_addname(msg, name, DNS_SECTION_ADDITIONAL);
+		}
+
+		dns_message_gettemprdataset(msg, &rdataset);
+		dns_rdataset_clone(&ae->rdataset, rdataset);
+		ISC_LIST_APPEND(name->list, rdataset, link);
+
+		if (dnssec && dns_rdataset_isassociated(&ae->sigrdataset)) {
+			rdataset = NULL;
+			dns_message_gettemprdataset(msg, &rdataset);
+			dns_rdataset_clone(&ae->sigrdataset, rdataset);
+			ISC_LIST_APPEND(name->list, rdataset, link);
+		}
+	}
+}
+
+/*
+ * The NS target names of a delegation, collected so that they can be
+ * looked up in the tree in one batch.
+ */
+typedef struct glue_batch {
+	dns_qpbatch_t *entries;
+	size_t count;
+	size_t size;
+} glue_batch_t;
+
+static isc_result_t
+glue_collect_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
+		dns_rdataset_t *unused DNS__DB_FLARG) {
+	glue_batch_t *batch = arg;
+	dns_qpbatch_t *entry = NULL;
+
+	UNUSED(unused);
+
+	INSIST(qtype == dns_rdatatype_a);
+	INSIST(batch->count < batch->size);
+
+	entry = &batch->entries[batch->count];
+	entry->keylen = dns_qpkey_fromname(entry->key, name);
+	entry->tag = batch->count++;
+
+	return (ISC_R_SUCCESS);
+}
+
 static dns_glue_t *
-newglue(dns_db_t *db, qpz_version_t *version, qpznode_t *node,
+newglue(dns_db_t *db, qpz_version_t *version, dns_gluenode_t *gluenode,
 	dns_rdataset_t *rdataset) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpznode_t *node = gluenode->node;
 	dns_fixedname_t nodename;
 	dns_glue_additionaldata_ctx_t ctx = {
 		.db = db,
 		.version = (dns_dbversion_t *)version,
 		.nodename = dns_fixedname_initname(&nodename),
 	};
+	glue_batch_t batch = { .size = dns_rdataset_count(rdataset) };
+	size_t *order = NULL;
+	dns_qpread_t qpr;
 
 	/*
 	 * Get the owner name of the NS RRset - it will be necessary for
@@ -5171,23 +5523,263 @@ newglue(dns_db_t *db, qpz_version_t *version, qpznode_t *node,
 	 */
 	dns_name_copy(&node->name, ctx.nodename);
 
+	if (batch.size == 0) {
+		return (NULL);
+	}
+
+	/*
+	 * Names that have no node in the tree cannot have glue, so we
+	 * look all the NS targets up together first, and only do a full
+	 * find() for the ones that exist.
+	 */
+	batch.entries = isc_mem_cget(db->mctx, batch.size,
+				     sizeof(batch.entries[0]));
+	order = isc_mem_cget(db->mctx, batch.size, sizeof(order[0]));
+
 	(void)dns_rdataset_additionaldata(rdataset, dns_rootname,
-					  glue_nsdname_cb, &ctx);
+					  glue_collect_cb, &batch);
+
+	dns_qpbatch_sort(batch.entries, batch.count);
+	dns_qpmulti_query(qpdb->tree, &qpr);
+	dns_qp_lookup_batch(&qpr, batch.entries, batch.count);
+
+	/*
+	 * Remember the target nodes, so that the glue can be carried
+	 * over to later versions; see carryglue().
+	 */
+	for (size_t i = 0; i < batch.count; i++) {
+		if (batch.entries[i].result == ISC_R_SUCCESS) {
+			gluenode->ntargets++;
+		}
+	}
+	if (gluenode->ntargets > 0) {
+		gluenode->targets = isc_mem_cget(db->mctx, gluenode->ntargets,
+						 sizeof(gluenode->targets[0]));
+	}
+	for (size_t i = 0, j = 0; i < batch.count; i++) {
+		dns_qpbatch_t *entry = &batch.entries[i];
+
+		if (entry->result == ISC_R_SUCCESS) {
+			qpznode_attach(entry->pval, &gluenode->targets[j++]);
+		} else if (!gluenode->missing) {
+			dns_fixedname_t fixed;
+			dns_name_t *name = dns_fixedname_initname(&fixed);
+
+			dns_qpkey_toname(entry->key, entry->keylen, name);
+			gluenode->missing = dns_name_issubdomain(
+				name, &qpdb->common.origin);
+		}
+	}
+	dns_qpread_destroy(qpdb->tree, &qpr);
+
+	/*
+	 * Keep the glue in the order of the NS records.
+	 */
+	for (size_t i = 0; i < batch.count; i++) {
+		order[batch.entries[i].tag] = i;
+	}
+	for (size_t i = 0; i < batch.count; i++) {
+		dns_qpbatch_t *entry = &batch.entries[order[i]];
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+
+		if (entry->result != ISC_R_SUCCESS) {
+			continue;
+		}
+		dns_qpkey_toname(entry->key, entry->keylen, name);
+		(void)glue_nsdname_cb(&ctx, name, dns_rdatatype_a,
+				      NULL DNS__DB_FILELINE);
+	}
+
+	isc_mem_cput(db->mctx, order, batch.size, sizeof(order[0]));
+	isc_mem_cput(db->mctx, batch.entries, batch.size,
+		     sizeof(batch.entries[0]));
 
 	return (ctx.glue_list);
 }
 
+typedef struct {
+	dns_db_t *db;
+	qpz_version_t *version;
+	dns_gluenode_t *gluenode;
+	qpz_additional_t **tailp;
+} additional_ctx_t;
+
+static void
+additional_find(additional_ctx_t *ctx, const dns_name_t *name,
+		dns_rdatatype_t type DNS__DB_FLARG) {
+	dns_fixedname_t fixed;
+	dns_name_t *foundname = dns_fixedname_initname(&fixed);
+	dns_rdataset_t rdataset, sigrdataset;
+	qpznode_t *node = NULL;
+	qpz_additional_t *ae = NULL;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+	dns_rdataset_init(&sigrdataset);
+
+	/*
+	 * We are looking for authoritative data, so GLUEOK is not set,
+	 * just as in query_additionalauthfind().
+	 */
+	result = find(ctx->db, name, (dns_dbversion_t *)ctx->version, type, 0,
+		      0, (dns_dbnode_t **)&node, foundname, &rdataset,
+		      &sigrdataset DNS__DB_FLARG_PASS);
+	switch (result) {
+	case ISC_R_SUCCESS:
+		ae = isc_mem_get(ctx->db->mctx, sizeof(*ae));
+		*ae = (qpz_additional_t){ 0 };
+		dns_name_copy(foundname, dns_fixedname_initname(&ae->fixedname));
+		dns_rdataset_init(&ae->rdataset);
+		dns_rdataset_init(&ae->sigrdataset);
+		dns_rdataset_clone(&rdataset, &ae->rdataset);
+		if (dns_rdataset_isassociated(&sigrdataset) &&
+		    ctx->version->secure)
+		{
+			dns_rdataset_clone(&sigrdataset, &ae->sigrdataset);
+		}
+		*ctx->tailp = ae;
+		ctx->tailp = &ae->next;
+		break;
+	case DNS_R_NXRRSET:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_EMPTYNAME:
+		/*
+		 * Nothing to add; a lookup in the zone would find nothing
+		 * either.
+		 */
+		break;
+	default:
+		/*
+		 * A CNAME, a delegation, a name outside of the zone, and
+		 * so on: let the caller do this the regular way.
+		 */
+		ctx->gluenode->incomplete = true;
+		break;
+	}
+
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (dns_rdataset_isassociated(&sigrdataset)) {
+		dns_rdataset_disassociate(&sigrdataset);
+	}
+	if (node != NULL) {
+		dns__db_detachnode(ctx->db,
+				   (dns_dbnode_t *)&node DNS__DB_FLARG_PASS);
+	}
+}
+
+static isc_result_t
+additional_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
+	      dns_rdataset_t *unused DNS__DB_FLARG) {
+	additional_ctx_t *ctx = arg;
+
+	UNUSED(unused);
+
+	/*
+	 * Type A stands for any address type, as in query_additional_cb().
+	 */
+	if (qtype == dns_rdatatype_a) {
+		additional_find(ctx, name, dns_rdatatype_a DNS__DB_FLARG_PASS);
+		additional_find(ctx, name,
+				dns_rdatatype_aaaa DNS__DB_FLARG_PASS);
+	} else {
+		additional_find(ctx, name, qtype DNS__DB_FLARG_PASS);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+newadditional(dns_db_t *db, qpz_version_t *version, dns_gluenode_t *gluenode,
+	      dns_rdataset_t *rdataset) {
+	additional_ctx_t ctx = {
+		.db = db,
+		.version = version,
+		.gluenode = gluenode,
+		.tailp = &gluenode->additional,
+	};
+
+	(void)dns_rdataset_additionaldata(rdataset, &gluenode->node->name,
+					  additional_cb, &ctx);
+}
+
 static dns_gluenode_t *
 new_gluenode(dns_db_t *db, qpz_version_t *version, qpznode_t *node,
 	     dns_rdataset_t *rdataset) {
 	dns_gluenode_t *gluenode = isc_mem_get(db->mctx, sizeof(*gluenode));
-	*gluenode = (dns_gluenode_t){
-		.glue = newglue(db, version, node, rdataset),
-	};
+	*gluenode = (dns_gluenode_t){ .type = rdataset->type };
 
 	isc_mem_attach(db->mctx, &gluenode->mctx);
 	qpznode_attach(node, &gluenode->node);
 
+	if (rdataset->type == dns_rdatatype_ns) {
+		gluenode->glue = newglue(db, version, gluenode, rdataset);
+	} else {
+		newadditional(db, version, gluenode, rdataset);
+	}
+
+	return (gluenode);
+}
+
+static dns_glue_t *
+cloneglue(isc_mem_t *mctx, dns_glue_t *glue) {
+	dns_glue_t *head = NULL, **tailp = &head;
+
+	for (; glue != NULL; glue = glue->next) {
+		dns_glue_t *copy =
+			new_gluelist(mctx, dns_fixedname_name(&glue->fixedname));
+
+		dns_rdataset_init(&copy->rdataset_a);
+		dns_rdataset_init(&copy->sigrdataset_a);
+		dns_rdataset_init(&copy->rdataset_aaaa);
+		dns_rdataset_init(&copy->sigrdataset_aaaa);
+
+		if (dns_rdataset_isassociated(&glue->rdataset_a)) {
+			dns_rdataset_clone(&glue->rdataset_a,
+					   &copy->rdataset_a);
+		}
+		if (dns_rdataset_isassociated(&glue->sigrdataset_a)) {
+			dns_rdataset_clone(&glue->sigrdataset_a,
+					   &copy->sigrdataset_a);
+		}
+		if (dns_rdataset_isassociated(&glue->rdataset_aaaa)) {
+			dns_rdataset_clone(&glue->rdataset_aaaa,
+					   &copy->rdataset_aaaa);
+		}
+		if (dns_rdataset_isassociated(&glue->sigrdataset_aaaa)) {
+			dns_rdataset_clone(&glue->sigrdataset_aaaa,
+					   &copy->sigrdataset_aaaa);
+		}
+
+		*tailp = copy;
+		tailp = &copy->next;
+	}
+
+	return (head);
+}
+
+static dns_gluenode_t *
+clone_gluenode(dns_gluenode_t *source) {
+	isc_mem_t *mctx = source->mctx;
+	dns_gluenode_t *gluenode = isc_mem_get(mctx, sizeof(*gluenode));
+	*gluenode = (dns_gluenode_t){
+		.glue = cloneglue(mctx, source->glue),
+		.type = source->type,
+		.ntargets = source->ntargets,
+	};
+
+	isc_mem_attach(mctx, &gluenode->mctx);
+	qpznode_attach(source->node, &gluenode->node);
+	if (gluenode->ntargets > 0) {
+		gluenode->targets = isc_mem_cget(mctx, gluenode->ntargets,
+						 sizeof(gluenode->targets[0]));
+	}
+	for (size_t i = 0; i < source->ntargets; i++) {
+		qpznode_attach(source->targets[i], &gluenode->targets[i]);
+	}
+
 	return (gluenode);
 }
 
@@ -5221,14 +5813,40 @@ freeglue(isc_mem_t *mctx, dns_glue_t *glue) {
 	}
 }
 
+static void
+freeadditional(isc_mem_t *mctx, qpz_additional_t *ae) {
+	while (ae != NULL) {
+		qpz_additional_t *next = ae->next;
+
+		dns_rdataset_disassociate(&ae->rdataset);
+		if (dns_rdataset_isassociated(&ae->sigrdataset)) {
+			dns_rdataset_disassociate(&ae->sigrdataset);
+		}
+		dns_rdataset_invalidate(&ae->rdataset);
+		dns_rdataset_invalidate(&ae->sigrdataset);
+
+		isc_mem_put(mctx, ae, sizeof(*ae));
+
+		ae = next;
+	}
+}
+
 static void
 free_gluenode_rcu(struct rcu_head *rcu_head) {
 	dns_gluenode_t *gluenode = caa_container_of(rcu_head, dns_gluenode_t,
 						    rcu_head);
 
 	freeglue(gluenode->mctx, gluenode->glue);
+	freeadditional(gluenode->mctx, gluenode->additional);
 
 	qpznode_detach(&gluenode->node);
+	for (size_t i = 0; i < gluenode->ntargets; i++) {
+		qpznode_detach(&gluenode->targets[i]);
+	}
+	if (gluenode->ntargets > 0) {
+		isc_mem_cput(gluenode->mctx, gluenode->targets,
+			     gluenode->ntargets, sizeof(gluenode->targets[0]));
+	}
 
 	isc_mem_putanddetach(&gluenode->mctx, gluenode, sizeof(*gluenode));
 }
@@ -5238,30 +5856,79 @@ free_gluenode(dns_gluenode_t *gluenode) {
 	call_rcu(&gluenode->rcu_head, free_gluenode_rcu);
 }
 
+/*
+ * Glue table entries are keyed by the node and the type of the RRset.
+ */
+typedef struct {
+	const qpznode_t *node;
+	dns_rdatatype_t type;
+} gluekey_t;
+
 static uint32_t
-qpznode_hash(const qpznode_t *node) {
-	return (isc_hash32(&node, sizeof(node), true));
+gluekey_hash(const qpznode_t *node, dns_rdatatype_t type) {
+	return (isc_hash32(&node, sizeof(node), true) + type);
 }
 
 static int
-qpznode_match(struct cds_lfht_node *ht_node, const void *key) {
+gluekey_match(struct cds_lfht_node *ht_node, const void *key) {
 	const dns_gluenode_t *gluenode =
 		caa_container_of(ht_node, dns_gluenode_t, ht_node);
-	const qpznode_t *node = key;
+	const gluekey_t *gluekey = key;
 
-	return (gluenode->node == node);
+	return (gluenode->node == gluekey->node &&
+		gluenode->type == gluekey->type);
 }
 
 static uint32_t
 gluenode_hash(const dns_gluenode_t *gluenode) {
-	return (qpznode_hash(gluenode->node));
+	return (gluekey_hash(gluenode->node, gluenode->type));
 }
 
 static int
 gluenode_match(struct cds_lfht_node *ht_node, const void *key) {
 	const dns_gluenode_t *gluenode = key;
+	gluekey_t gluekey = { .node = gluenode->node, .type = gluenode->type };
+
+	return (gluekey_match(ht_node, &gluekey));
+}
+
+/*
+ * Find the entry for 'rdataset' in the glue table of 'version', and
+ * create it if there is none yet.  Must be called with the RCU read
+ * lock held.
+ */
+static dns_gluenode_t *
+getgluenode(dns_db_t *db, qpz_version_t *version, dns_rdataset_t *rdataset) {
+	qpznode_t *node = (qpznode_t *)rdataset->slab.node;
+	gluekey_t gluekey = { .node = node, .type = rdataset->type };
+	dns_gluenode_t *gluenode = NULL;
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup(version->glue_table,
+			gluekey_hash(gluekey.node, gluekey.type), gluekey_match,
+			&gluekey, &iter);
+
+	gluenode = cds_lfht_entry(cds_lfht_iter_get_node(&iter), dns_gluenode_t,
+				  ht_node);
+	if (gluenode == NULL) {
+		/* Nothing was found in the table; look it up now. */
+		gluenode = new_gluenode(db, version, node, rdataset);
+
+		struct cds_lfht_node *ht_node = cds_lfht_add_unique(
+			version->glue_table, gluenode_hash(gluenode),
+			gluenode_match, gluenode, &gluenode->ht_node);
+
+		if (ht_node != &gluenode->ht_node) {
+			free_gluenode_rcu(&gluenode->rcu_head);
+
+			gluenode = cds_lfht_entry(ht_node, dns_gluenode_t,
+						  ht_node);
+		}
+	}
 
-	return (qpznode_match(ht_node, gluenode->node));
+	INSIST(gluenode != NULL);
+
+	return (gluenode);
 }
 
 static void
@@ -5269,7 +5936,6 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	dns_message_t *msg) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
 	qpz_version_t *version = dbversion;
-	qpznode_t *node = (qpznode_t *)rdataset->slab.node;
 	dns_gluenode_t *gluenode = NULL;
 
 	REQUIRE(rdataset->type == dns_rdatatype_ns);
@@ -5282,9 +5948,10 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	 * structure is not explicitly bounded and there's no cache
 	 * cleaning. The zone data size itself is an implicit bound.
 	 *
-	 * The key into the glue hashtable is the node pointer. This is
-	 * because the glue hashtable is a property of the DB version,
-	 * and the glue is keyed for the ownername/NS tuple. We don't
+	 * The key into the glue hashtable is the node pointer and the
+	 * type. This is because the glue hashtable is a property of the
+	 * DB version, and the glue is keyed for the ownername/NS tuple
+	 * (or ownername/MX and ownername/SRV for additional data). We don't
 	 * bother with using an expensive dns_name_t comparison here as
 	 * the node pointer is a fixed value that won't change for a DB
 	 * version and can be compared directly.
@@ -5292,29 +5959,7 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 
 	rcu_read_lock();
 
-	struct cds_lfht_iter iter;
-	cds_lfht_lookup(version->glue_table, qpznode_hash(node), qpznode_match,
-			node, &iter);
-
-	gluenode = cds_lfht_entry(cds_lfht_iter_get_node(&iter), dns_gluenode_t,
-				  ht_node);
-	if (gluenode == NULL) {
-		/* No cached glue was found in the table. Get new glue. */
-		gluenode = new_gluenode(db, version, node, rdataset);
-
-		struct cds_lfht_node *ht_node = cds_lfht_add_unique(
-			version->glue_table, gluenode_hash(gluenode),
-			gluenode_match, gluenode, &gluenode->ht_node);
-
-		if (ht_node != &gluenode->ht_node) {
-			free_gluenode_rcu(&gluenode->rcu_head);
-
-			gluenode = cds_lfht_entry(ht_node, dns_gluenode_t,
-						  ht_node);
-		}
-	}
-
-	INSIST(gluenode != NULL);
+	gluenode = getgluenode(db, version, rdataset);
 
 	dns_glue_t *glue = gluenode->glue;
 	isc_statscounter_t counter = dns_gluecachestatscounter_hits_present;
@@ -5333,6 +5978,102 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	}
 }
 
+static isc_result_t
+addadditional(dns_db_t *db, dns_dbversion_t *dbversion,
+	      dns_rdataset_t *rdataset, bool dnssec, dns_message_t *msg) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpz_version_t *version = dbversion;
+	dns_gluenode_t *gluenode = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(rdataset->type == dns_rdatatype_mx ||
+		rdataset->type == dns_rdatatype_srv);
+	REQUIRE(qpdb == version->qpdb);
+	REQUIRE(!IS_STUB(qpdb));
+
+	if (qpdb != (qpzonedb_t *)rdataset->slab.db) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * The additional data of MX and SRV RRsets shares the glue
+	 * table, and its (lack of) bounds, with the glue; see addglue().
+	 */
+	rcu_read_lock();
+
+	gluenode = getgluenode(db, version, rdataset);
+	if (!gluenode->incomplete) {
+		addadditional_to_message(gluenode->additional, dnssec, msg);
+		result = ISC_R_SUCCESS;
+	}
+
+	rcu_read_unlock();
+
+	return (result);
+}
+
+static bool
+glue_unchanged(dns_gluenode_t *gluenode, uint32_t serial) {
+	if (gluenode->missing || gluenode->node->changed_serial == serial) {
+		return (false);
+	}
+	for (size_t i = 0; i < gluenode->ntargets; i++) {
+		if (gluenode->targets[i]->changed_serial == serial) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*
+ * Fill the glue table of 'to', which is about to be committed, from
+ * that of the current version 'from'.  Glue is carried over unless the
+ * delegation or one of its NS targets changed in 'to'; the glue for
+ * those delegations is looked up again here, so that the first referral
+ * after an update doesn't have to.
+ */
+static void
+carryglue(qpzonedb_t *qpdb, qpz_version_t *from, qpz_version_t *to) {
+	struct cds_lfht_iter iter;
+	dns_gluenode_t *gluenode = NULL;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(from->glue_table, &iter, gluenode, ht_node) {
+		dns_gluenode_t *copy = NULL;
+
+		if (gluenode->type != dns_rdatatype_ns) {
+			continue;
+		}
+
+		if (glue_unchanged(gluenode, to->serial)) {
+			copy = clone_gluenode(gluenode);
+		} else {
+			dns_rdataset_t rdataset;
+			isc_result_t result;
+
+			dns_rdataset_init(&rdataset);
+			result = findrdataset(
+				(dns_db_t *)qpdb, (dns_dbnode_t *)gluenode->node,
+				(dns_dbversion_t *)to, dns_rdatatype_ns, 0, 0,
+				&rdataset, NULL DNS__DB_FILELINE);
+			if (result != ISC_R_SUCCESS) {
+				continue;
+			}
+			copy = new_gluenode((dns_db_t *)qpdb, to, gluenode->node,
+					   &rdataset);
+			dns_rdataset_disassociate(&rdataset);
+		}
+
+		struct cds_lfht_node *ht_node = cds_lfht_add_unique(
+			to->glue_table, gluenode_hash(copy), gluenode_match,
+			copy, &copy->ht_node);
+		if (ht_node != &copy->ht_node) {
+			free_gluenode_rcu(&copy->rcu_head);
+		}
+	}
+	rcu_read_unlock();
+}
+
 static void
 setmaxrrperset(dns_db_t *db, uint32_t value) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
@@ -5351,6 +6092,17 @@ setmaxtypepername(dns_db_t *db, uint32_t value) {
 	qpdb->maxtypepername = value;
 }
 
+static uint64_t
+versionid(dns_db_t *db, dns_dbversion_t *dbversion) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpz_version_t *version = (qpz_version_t *)dbversion;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	INSIST(version->qpdb == qpdb);
+
+	return (version->id);
+}
+
 static dns_dbmethods_t qpdb_zonemethods = {
 	.destroy = qpdb_destroy,
 	.beginload = beginload,
@@ -5382,10 +6134,12 @@ static dns_dbmethods_t qpdb_zonemethods = {
 	.locknode = locknode,
 	.unlocknode = unlocknode,
 	.addglue = addglue,
+	.addadditional = addadditional,
 	.deletedata = deletedata,
 	.nodefullname = nodefullname,
 	.setmaxrrperset = setmaxrrperset,
 	.setmaxtypepername = setmaxtypepername,
+	.versionid = versionid,
 };
 
 static void
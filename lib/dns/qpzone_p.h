@@ -48,4 +48,17 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  *
  * \li argc == 0 or argv[0] is a valid memory context.
  */
+
+void
+dns__qpzone_setslabstore(dns_db_t *db, dns_slabstore_t *store);
+/*%<
+ * Make 'db' keep the records of the RRsets it loads in 'store', sharing
+ * them with the other databases that use the store.  Called by
+ * dns_zone_makedb(); does nothing if 'db' is not a qpzone database.
+ *
+ * Requires:
+ *
+ * \li 'db' is a valid database that has not been loaded.
+ * \li 'store' is a valid slab store.
+ */
 ISC_LANG_ENDDECLS
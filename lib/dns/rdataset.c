@@ -157,6 +157,54 @@ dns_rdataset_count(dns_rdataset_t *rdataset) {
 	return ((rdataset->methods->count)(rdataset));
 }
 
+static bool
+compressible(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_a:
+		return (rdclass == dns_rdataclass_ch);
+	case dns_rdatatype_ns:
+	case dns_rdatatype_md:
+	case dns_rdatatype_mf:
+	case dns_rdatatype_cname:
+	case dns_rdatatype_soa:
+	case dns_rdatatype_mb:
+	case dns_rdatatype_mg:
+	case dns_rdatatype_mr:
+	case dns_rdatatype_ptr:
+	case dns_rdatatype_minfo:
+	case dns_rdatatype_mx:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+unsigned int
+dns_rdataset_minsize(dns_rdataset_t *rdataset) {
+	unsigned int size;
+
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->methods != NULL);
+
+	if (rdataset->methods->rdatasize == NULL ||
+	    (rdataset->attributes &
+	     (DNS_RDATASETATTR_QUESTION | DNS_RDATASETATTR_NEGATIVE)) != 0)
+	{
+		return (0);
+	}
+
+	/*
+	 * A compression pointer to the owner name, then type, class,
+	 * TTL and rdata length.
+	 */
+	size = dns_rdataset_count(rdataset) * 12;
+	if (!compressible(rdataset->rdclass, rdataset->type)) {
+		size += (rdataset->methods->rdatasize)(rdataset);
+	}
+
+	return (size);
+}
+
 void
 dns__rdataset_clone(dns_rdataset_t *source,
 		    dns_rdataset_t *target DNS__DB_FLARG) {
@@ -235,6 +283,30 @@ swap_rdata(dns_rdata_t *in, unsigned int a, unsigned int b) {
 	in[b] = rdata;
 }
 
+/*
+ * Return true if the wire format of the rdata in 'rdataset' is the
+ * rdata as stored, so that rendering it is a plain copy.  These types
+ * carry no domain names and so are never compressed.
+ */
+static bool
+towire_verbatim(const dns_rdataset_t *rdataset) {
+	switch (rdataset->type) {
+	case dns_rdatatype_a:
+	case dns_rdatatype_aaaa:
+		return (rdataset->rdclass == dns_rdataclass_in);
+	case dns_rdatatype_txt:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_sshfp:
+	case dns_rdatatype_dnskey:
+	case dns_rdatatype_tlsa:
+	case dns_rdatatype_cds:
+	case dns_rdatatype_cdnskey:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
 static isc_result_t
 towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	     dns_compress_t *cctx, isc_buffer_t *target,
@@ -248,6 +320,7 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	unsigned int headlen;
 	bool question = false;
 	bool shuffle = false, sort = false;
+	bool verbatim = towire_verbatim(rdataset);
 	bool want_random, want_cyclic;
 	dns_rdata_t in_fixed[MAX_SHUFFLE];
 	dns_rdata_t *in = in_fixed;
@@ -373,7 +446,9 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 	name = dns_fixedname_initname(&fixed);
 	dns_name_copy(owner_name, name);
-	dns_rdataset_getownercase(rdataset, name);
+	if ((options & DNS_RDATASETTOWIRE_QNAMECASE) == 0) {
+		dns_rdataset_getownercase(rdataset, name);
+	}
 	offset = 0xffff;
 
 	name->attributes.nocompress |= owner_name->attributes.nocompress;
@@ -421,9 +496,19 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 				dns_rdata_reset(&rdata);
 				dns_rdataset_current(rdataset, &rdata);
 			}
-			result = dns_rdata_towire(&rdata, cctx, target);
-			if (result != ISC_R_SUCCESS) {
-				goto rollback;
+			if (verbatim) {
+				isc_buffer_availableregion(target, &r);
+				if (r.length < rdata.length) {
+					result = ISC_R_NOSPACE;
+					goto rollback;
+				}
+				isc_buffer_putmem(target, rdata.data,
+						  rdata.length);
+			} else {
+				result = dns_rdata_towire(&rdata, cctx, target);
+				if (result != ISC_R_SUCCESS) {
+					goto rollback;
+				}
 			}
 			INSIST((target->used >= rdlen.used + 2) &&
 			       (target->used - rdlen.used - 2 < 65536));
@@ -28,6 +28,7 @@
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdataslab.h>
+#include <dns/slabstore.h>
 #include <dns/stats.h>
 
 #define CASESET(header)                                \
@@ -89,6 +90,12 @@ struct xrdata {
 #endif /* if DNS_RDATASET_FIXED */
 };
 
+/*%
+ * Rdatasets with at most this many records are sorted on the stack
+ * instead of in a temporary allocation.
+ */
+#define XRDATA_STACKSIZE 8
+
 #define peek_uint16(buffer) ({ ((uint16_t)*(buffer) << 8) | *((buffer) + 1); })
 #define get_uint16(buffer)                            \
 	({                                            \
@@ -109,6 +116,8 @@ static void
 rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target DNS__DB_FLARG);
 static unsigned int
 rdataset_count(dns_rdataset_t *rdataset);
+static unsigned int
+rdataset_rdatasize(dns_rdataset_t *rdataset);
 static isc_result_t
 rdataset_getnoqname(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *neg, dns_rdataset_t *negsig DNS__DB_FLARG);
@@ -134,6 +143,21 @@ compare_rdata(const void *p1, const void *p2) {
 	return (dns_rdata_compare(&x1->rdata, &x2->rdata));
 }
 
+/*%
+ * Rdatasets that were built from another slab, e.g. when loading a raw
+ * zone file or transferring a zone, are normally in DNSSEC order already
+ * and do not need to be sorted again.
+ */
+static bool
+is_sorted(struct xrdata *x, unsigned int n) {
+	for (unsigned int i = 1; i < n; i++) {
+		if (compare_rdata(&x[i - 1], &x[i]) > 0) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
 #if DNS_RDATASET_FIXED
 static void
 fillin_offsets(unsigned char *offsetbase, unsigned int *offsettable,
@@ -174,6 +198,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * rdata as rdata.data == NULL is valid.
 	 */
 	static unsigned char removed;
+	struct xrdata xstack[XRDATA_STACKSIZE];
 	struct xrdata *x = NULL;
 	unsigned char *rawbuf = NULL;
 	unsigned int buflen;
@@ -220,7 +245,11 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * Remember the original number of items.
 	 */
 	nalloc = nitems;
-	x = isc_mem_cget(mctx, nalloc, sizeof(struct xrdata));
+	if (nalloc <= ARRAY_SIZE(xstack)) {
+		x = xstack;
+	} else {
+		x = isc_mem_cget(mctx, nalloc, sizeof(struct xrdata));
+	}
 
 	/*
 	 * Save all of the rdata members into an array.
@@ -253,7 +282,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	/*
 	 * Put into DNSSEC order.
 	 */
-	if (nalloc > 1U) {
+	if (nalloc > 1U && !is_sorted(x, nalloc)) {
 		qsort(x, nalloc, sizeof(struct xrdata), compare_rdata);
 	}
 
@@ -388,7 +417,9 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	result = ISC_R_SUCCESS;
 
 free_rdatas:
-	isc_mem_cput(mctx, x, nalloc, sizeof(struct xrdata));
+	if (x != xstack) {
+		isc_mem_cput(mctx, x, nalloc, sizeof(struct xrdata));
+	}
 	return (result);
 }
 
@@ -418,7 +449,7 @@ unsigned int
 dns_rdataslab_rdatasize(unsigned char *slab, unsigned int reservelen) {
 	REQUIRE(slab != NULL);
 
-	uint16_t rdatalen = 0;
+	unsigned int rdatalen = 0;
 	unsigned char *current = slab + reservelen;
 	uint16_t count = get_uint16(current);
 
@@ -448,6 +479,322 @@ dns_rdataslab_count(unsigned char *slab, unsigned int reservelen) {
 	return (count);
 }
 
+/*
+ * Packed slabs.
+ *
+ * Large TXT RRsets, such as the SPF and domain verification records at
+ * the apex of many zones, and SVCB and HTTPS RRsets are mostly made of a
+ * small set of well-known substrings.  A packed slab stores each of
+ * those substrings as PACK_ESCAPE followed by its index in 'dictionary';
+ * a literal PACK_ESCAPE is stored as PACK_ESCAPE PACK_LITERAL.  Every
+ * other byte is stored as it is.
+ */
+#define PACK_ESCAPE  0x7f
+#define PACK_LITERAL 0xff
+
+/*%
+ * Don't pack RRsets with less rdata than this, or that would shrink
+ * by less than one eighth.
+ */
+#define PACK_MINSIZE 128
+
+#define WORD(s) { (const unsigned char *)(s), sizeof(s) - 1 }
+
+static const struct {
+	const unsigned char *data;
+	unsigned int length;
+} dictionary[] = {
+	/* SPF */
+	WORD("v=spf1 include:"),
+	WORD("v=spf1 "),
+	WORD(" include:"),
+	WORD("include:"),
+	WORD(" ip4:"),
+	WORD(" ip6:"),
+	WORD(" redirect="),
+	WORD(" ~all"),
+	WORD(" -all"),
+	WORD(" ?all"),
+	WORD("_spf."),
+	WORD("spf.protection.outlook.com"),
+	WORD("_spf.google.com"),
+	WORD("amazonses.com"),
+	WORD("sendgrid.net"),
+	WORD("mailgun.org"),
+	WORD("servers.mcsv.net"),
+	WORD("spf.mandrillapp.com"),
+	WORD("_spf.salesforce.com"),
+	/* Domain verification */
+	WORD("google-site-verification="),
+	WORD("facebook-domain-verification="),
+	WORD("apple-domain-verification="),
+	WORD("atlassian-domain-verification="),
+	WORD("globalsign-domain-verification="),
+	WORD("adobe-idp-site-verification="),
+	WORD("zoom-domain-verification"),
+	WORD("stripe-verification="),
+	WORD("docusign="),
+	WORD("MS=ms"),
+	/* DMARC and DKIM */
+	WORD("v=DMARC1; p="),
+	WORD("; rua=mailto:"),
+	WORD("; ruf=mailto:"),
+	WORD("quarantine"),
+	WORD("reject"),
+	WORD("v=DKIM1; k=rsa; p="),
+	WORD("MIIBIjANBgkqhkiG9w0BAQEFAAOCAQ8AMIIBCgKCAQEA"),
+	WORD("MIGfMA0GCSqGSIb3DQEBAQUAA4GNADCBiQKBgQ"),
+	WORD("IDAQAB"),
+	/* Names */
+	WORD(".com"),
+	WORD(".net"),
+	WORD(".org"),
+	WORD("www."),
+	/* SVCB and HTTPS: priority 1, root target, alpn="h3,h2" */
+	WORD("\x00\x01\x00\x00\x01\x00\x06\x02h3\x02h2"),
+	/* alpn parameters */
+	WORD("\x00\x01\x00\x06\x02h3\x02h2"),
+	WORD("\x00\x01\x00\x06\x02h2\x02h3"),
+	WORD("\x00\x01\x00\x03\x02h2"),
+	WORD("\x00\x01\x00\x03\x02h3"),
+	WORD("\x08http/1.1"),
+	/* ipv4hint and ipv6hint parameters with one or two addresses */
+	WORD("\x00\x04\x00\x04"),
+	WORD("\x00\x04\x00\x08"),
+	WORD("\x00\x06\x00\x10"),
+	WORD("\x00\x06\x00\x20"),
+};
+
+#undef WORD
+
+STATIC_ASSERT(ARRAY_SIZE(dictionary) < PACK_LITERAL,
+	      "too many words in the packed slab dictionary");
+
+static bool
+packable(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_txt:
+		return (true);
+	case dns_rdatatype_svcb:
+	case dns_rdatatype_https:
+		return (rdclass == dns_rdataclass_in);
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Encode the 'length' bytes at 'data' into 'target', if it is not NULL,
+ * and return the encoded length.
+ */
+static unsigned int
+pack_data(const unsigned char *data, unsigned int length,
+	  unsigned char *target) {
+	unsigned int packed = 0;
+
+	for (unsigned int i = 0; i < length;) {
+		unsigned int best = 0, bestlen = 0;
+
+		for (unsigned int w = 0; w < ARRAY_SIZE(dictionary); w++) {
+			unsigned int wlen = dictionary[w].length;
+			if (wlen > bestlen && wlen <= length - i &&
+			    data[i] == dictionary[w].data[0] &&
+			    memcmp(data + i, dictionary[w].data, wlen) == 0)
+			{
+				best = w;
+				bestlen = wlen;
+			}
+		}
+
+		if (bestlen > 2) {
+			if (target != NULL) {
+				target[packed] = PACK_ESCAPE;
+				target[packed + 1] = best;
+			}
+			packed += 2;
+			i += bestlen;
+		} else if (data[i] == PACK_ESCAPE) {
+			if (target != NULL) {
+				target[packed] = PACK_ESCAPE;
+				target[packed + 1] = PACK_LITERAL;
+			}
+			packed += 2;
+			i++;
+		} else {
+			if (target != NULL) {
+				target[packed] = data[i];
+			}
+			packed++;
+			i++;
+		}
+	}
+
+	return (packed);
+}
+
+/*
+ * Decode the 'length' bytes at 'data' into 'target', if it is not NULL,
+ * and return the decoded length.
+ */
+static unsigned int
+unpack_data(const unsigned char *data, unsigned int length,
+	    unsigned char *target) {
+	unsigned int unpacked = 0;
+
+	for (unsigned int i = 0; i < length; i++) {
+		const unsigned char *word = &data[i];
+		unsigned int wlen = 1;
+
+		if (data[i] == PACK_ESCAPE) {
+			INSIST(i + 1 < length);
+			i++;
+			if (data[i] != PACK_LITERAL) {
+				INSIST(data[i] < ARRAY_SIZE(dictionary));
+				word = dictionary[data[i]].data;
+				wlen = dictionary[data[i]].length;
+			}
+		}
+		if (target != NULL) {
+			memmove(target + unpacked, word, wlen);
+		}
+		unpacked += wlen;
+	}
+
+	return (unpacked);
+}
+
+/*
+ * Make a copy of 'slab' with each record passed through pack_data()
+ * or unpack_data(), and return it along with its size in '*sizep'.
+ */
+static unsigned char *
+transcode_slab(unsigned char *slab, unsigned int reservelen, isc_mem_t *mctx,
+	       bool pack, unsigned int *sizep) {
+	unsigned int (*transcode)(const unsigned char *, unsigned int,
+				  unsigned char *) = pack ? pack_data
+							  : unpack_data;
+	unsigned char *current = slab + reservelen;
+	uint16_t count = get_uint16(current);
+	unsigned char *items = NULL;
+	unsigned char *tslab = NULL, *target = NULL;
+	unsigned int size;
+#if DNS_RDATASET_FIXED
+	unsigned char *offsetbase = NULL;
+	unsigned int *offsettable = NULL;
+
+	current += (4 * count);
+#endif /* if DNS_RDATASET_FIXED */
+
+	items = current;
+	size = items - slab;
+	for (unsigned int i = 0; i < count; i++) {
+		uint16_t length = get_uint16(current);
+		size += 2;
+#if DNS_RDATASET_FIXED
+		current += 2;
+		size += 2;
+#endif /* if DNS_RDATASET_FIXED */
+		size += transcode(current, length, NULL);
+		current += length;
+	}
+
+	tslab = isc_mem_get(mctx, size);
+	memmove(tslab, slab, items - slab);
+	target = tslab + (items - slab);
+
+#if DNS_RDATASET_FIXED
+	offsetbase = tslab + reservelen;
+	offsettable = isc_mem_cget(mctx, count, sizeof(unsigned int));
+#endif /* if DNS_RDATASET_FIXED */
+
+	current = items;
+	for (unsigned int i = 0; i < count; i++) {
+		uint16_t length = get_uint16(current);
+		unsigned char *data = target + 2;
+		unsigned int tlength;
+#if DNS_RDATASET_FIXED
+		uint16_t order = get_uint16(current);
+
+		INSIST(order < count);
+		offsettable[order] = target - offsetbase;
+		data += 2;
+#endif /* if DNS_RDATASET_FIXED */
+		tlength = transcode(current, length, data);
+		INSIST(tlength <= 0xffff);
+		target[0] = (tlength & 0xff00) >> 8;
+		target[1] = (tlength & 0x00ff);
+		target = data + tlength;
+		current += length;
+	}
+	INSIST(target == tslab + size);
+
+#if DNS_RDATASET_FIXED
+	fillin_offsets(offsetbase, offsettable, count);
+	isc_mem_cput(mctx, offsettable, count, sizeof(unsigned int));
+#endif /* if DNS_RDATASET_FIXED */
+
+	*sizep = size;
+	return (tslab);
+}
+
+bool
+dns_rdataslab_pack(isc_mem_t *mctx, isc_region_t *region,
+		   unsigned int reservelen, dns_rdataclass_t rdclass,
+		   dns_rdatatype_t type) {
+	unsigned char *current = NULL;
+	unsigned int rdatalen = 0, packedlen = 0;
+	unsigned int size;
+	uint16_t count;
+
+	REQUIRE(region != NULL && region->base != NULL);
+
+	if (!packable(rdclass, type)) {
+		return (false);
+	}
+
+	current = region->base + reservelen;
+	count = get_uint16(current);
+#if DNS_RDATASET_FIXED
+	current += (4 * count);
+#endif /* if DNS_RDATASET_FIXED */
+
+	for (unsigned int i = 0; i < count; i++) {
+		uint16_t length = get_uint16(current);
+		unsigned int plength;
+#if DNS_RDATASET_FIXED
+		current += 2;
+#endif /* if DNS_RDATASET_FIXED */
+		plength = pack_data(current, length, NULL);
+		if (plength > length) {
+			return (false);
+		}
+		rdatalen += length;
+		packedlen += plength;
+		current += length;
+	}
+
+	if (rdatalen < PACK_MINSIZE || packedlen > rdatalen - rdatalen / 8) {
+		return (false);
+	}
+
+	current = transcode_slab(region->base, reservelen, mctx, true, &size);
+	isc_mem_put(mctx, region->base, region->length);
+	region->base = current;
+	region->length = size;
+
+	return (true);
+}
+
+unsigned char *
+dns_rdataslab_unpack(unsigned char *slab, unsigned int reservelen,
+		     isc_mem_t *mctx) {
+	unsigned int size;
+
+	REQUIRE(slab != NULL);
+
+	return (transcode_slab(slab, reservelen, mctx, false, &size));
+}
+
 /*
  * Make the dns_rdata_t 'rdata' refer to the slab item
  * beginning at '*current', which is part of a slab of type
@@ -483,66 +830,96 @@ rdata_from_slab(unsigned char **current, dns_rdataclass_t rdclass,
 }
 
 /*
- * Return true iff 'slab' (slab data of type 'type' and class 'rdclass')
- * contains an rdata identical to 'rdata'.  This does case insensitive
- * comparisons per DNSSEC.
+ * The size of the slab item starting at 'item': its length field, its
+ * order field if there is one, and its data.
  */
-static bool
-rdata_in_slab(unsigned char *slab, unsigned int reservelen,
-	      dns_rdataclass_t rdclass, dns_rdatatype_t type,
-	      dns_rdata_t *rdata) {
-	unsigned char *current = slab + reservelen;
-
-	uint16_t count = get_uint16(current);
-
+static unsigned int
+item_size(const unsigned char *item) {
 #if DNS_RDATASET_FIXED
-	current += (4 * count);
+	return (4 + peek_uint16(item));
+#else  /* if DNS_RDATASET_FIXED */
+	return (2 + peek_uint16(item));
 #endif /* if DNS_RDATASET_FIXED */
+}
 
-	for (size_t i = 0; i < count; i++) {
-		dns_rdata_t trdata = DNS_RDATA_INIT;
-		rdata_from_slab(&current, rdclass, type, &trdata);
+/*
+ * Whether the DNSSEC order of the rdata of 'type' is the plain byte
+ * order of their wire format, so that slab items can be compared
+ * without turning them into rdata first.  It isn't for types that have
+ * names in their rdata, as those are compared case-insensitively.
+ */
+static bool
+bytewise_order(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_a:
+	case dns_rdatatype_aaaa:
+		return (rdclass == dns_rdataclass_in);
+	case dns_rdatatype_caa:
+	case dns_rdatatype_cdnskey:
+	case dns_rdatatype_cds:
+	case dns_rdatatype_dnskey:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_hinfo:
+	case dns_rdatatype_nsec3:
+	case dns_rdatatype_nsec3param:
+	case dns_rdatatype_openpgpkey:
+	case dns_rdatatype_spf:
+	case dns_rdatatype_sshfp:
+	case dns_rdatatype_tlsa:
+	case dns_rdatatype_txt:
+	case dns_rdatatype_zonemd:
+		return (true);
+	default:
+		return (false);
+	}
+}
 
-		int n = dns_rdata_compare(&trdata, rdata);
-		if (n == 0) {
-			return (true);
-		}
-		if (n > 0) { /* In DNSSEC order. */
-			break;
-		}
-		dns_rdata_reset(&trdata);
+/*
+ * Compare the slab items 'item1' and 'item2' of type 'type' and class
+ * 'rdclass' in DNSSEC order.
+ */
+static int
+compare_items(unsigned char *item1, unsigned char *item2,
+	      dns_rdataclass_t rdclass, dns_rdatatype_t type, bool bytewise) {
+	dns_rdata_t rdata1 = DNS_RDATA_INIT;
+	dns_rdata_t rdata2 = DNS_RDATA_INIT;
+
+	if (bytewise) {
+		isc_region_t r1 = { .length = peek_uint16(item1) };
+		isc_region_t r2 = { .length = peek_uint16(item2) };
+
+		r1.base = item1 + item_size(item1) - r1.length;
+		r2.base = item2 + item_size(item2) - r2.length;
+		return (isc_region_compare(&r1, &r2));
 	}
-	return (false);
+
+	rdata_from_slab(&item1, rdclass, type, &rdata1);
+	rdata_from_slab(&item2, rdclass, type, &rdata2);
+	return (dns_rdata_compare(&rdata1, &rdata2));
 }
 
+/*
+ * Both slabs are in DNSSEC order, so merging and subtracting them is
+ * done in a single pass over both to size the result, and another one
+ * to fill it in, copying the items as they are.
+ */
 isc_result_t
 dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 		    unsigned int reservelen, isc_mem_t *mctx,
 		    dns_rdataclass_t rdclass, dns_rdatatype_t type,
 		    unsigned int flags, uint32_t maxrrperset,
 		    unsigned char **tslabp) {
-	unsigned char *ocurrent = NULL, *ostart = NULL, *ncurrent = NULL;
-	unsigned char *tstart = NULL, *tcurrent = NULL, *data = NULL;
-	unsigned int ocount, ncount, count, olength, tlength, tcount, length;
-	dns_rdata_t ordata = DNS_RDATA_INIT;
-	dns_rdata_t nrdata = DNS_RDATA_INIT;
-	bool added_something = false;
-	unsigned int oadded = 0;
-	unsigned int nadded = 0;
-	unsigned int nncount = 0;
+	unsigned char *ocurrent = NULL, *ostart = NULL;
+	unsigned char *ncurrent = NULL, *nstart = NULL;
+	unsigned char *tstart = NULL, *tcurrent = NULL;
+	unsigned int ocount, ncount, tlength, tcount, oi, ni, size;
+	bool bytewise = bytewise_order(rdclass, type);
 #if DNS_RDATASET_FIXED
-	unsigned int oncount;
-	unsigned int norder = 0;
-	unsigned int oorder = 0;
+	unsigned int order;
 	unsigned char *offsetbase = NULL;
 	unsigned int *offsettable = NULL;
 #endif /* if DNS_RDATASET_FIXED */
 
-	/*
-	 * XXX  Need parameter to allow "delete rdatasets in nslab" merge,
-	 * or perhaps another merge routine for this purpose.
-	 */
-
 	REQUIRE(tslabp != NULL && *tslabp == NULL);
 	REQUIRE(oslab != NULL && nslab != NULL);
 
@@ -557,74 +934,48 @@ dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 #if DNS_RDATASET_FIXED
 	ncurrent += (4 * ncount);
 #endif /* if DNS_RDATASET_FIXED */
+	nstart = ncurrent;
 	INSIST(ocount > 0 && ncount > 0);
 
 	if (maxrrperset > 0 && ocount + ncount > maxrrperset) {
 		return (DNS_R_TOOMANYRECORDS);
 	}
 
-#if DNS_RDATASET_FIXED
-	oncount = ncount;
-#endif /* if DNS_RDATASET_FIXED */
-
 	/*
-	 * Yes, this is inefficient!
+	 * The whole of the old slab goes into the new one, so start from
+	 * its size, and add the records of the new slab that aren't in
+	 * the old one.
 	 */
-
-	/*
-	 * Figure out the length of the old slab's data.
-	 */
-	olength = 0;
-	for (count = 0; count < ocount; count++) {
-		length = get_uint16(ocurrent);
-#if DNS_RDATASET_FIXED
-		olength += length + 8;
-		ocurrent += length + 2;
-#else  /* if DNS_RDATASET_FIXED */
-		olength += length + 2;
-		ocurrent += length;
-#endif /* if DNS_RDATASET_FIXED */
-	}
-
-	/*
-	 * Start figuring out the target length and count.
-	 */
-	tlength = reservelen + 2 + olength;
+	tlength = dns_rdataslab_size(oslab, reservelen);
 	tcount = ocount;
-
-	/*
-	 * Add in the length of rdata in the new slab that aren't in
-	 * the old slab.
-	 */
-	do {
-		dns_rdata_init(&nrdata);
-		rdata_from_slab(&ncurrent, rdclass, type, &nrdata);
-		if (!rdata_in_slab(oslab, reservelen, rdclass, type, &nrdata)) {
-			/*
-			 * This rdata isn't in the old slab.
-			 */
+	for (oi = 0, ni = 0; ni < ncount;) {
+		int n = (oi < ocount) ? compare_items(ocurrent, ncurrent,
+						      rdclass, type, bytewise)
+				      : 1;
+		if (n <= 0) {
+			ocurrent += item_size(ocurrent);
+			oi++;
+			if (n < 0) {
+				continue;
+			}
+		} else {
 #if DNS_RDATASET_FIXED
-			tlength += nrdata.length + 8;
+			tlength += item_size(ncurrent) + 4;
 #else  /* if DNS_RDATASET_FIXED */
-			tlength += nrdata.length + 2;
+			tlength += item_size(ncurrent);
 #endif /* if DNS_RDATASET_FIXED */
-			if (type == dns_rdatatype_rrsig) {
-				tlength++;
-			}
 			tcount++;
-			nncount++;
-			added_something = true;
 		}
-		ncount--;
-	} while (ncount > 0);
-	ncount = nncount;
-
-	if (((flags & DNS_RDATASLAB_EXACT) != 0) && (tcount != ncount + ocount))
-	{
-		return (DNS_R_NOTEXACT);
+		ncurrent += item_size(ncurrent);
+		ni++;
 	}
 
-	if (!added_something && (flags & DNS_RDATASLAB_FORCE) == 0) {
+	/*
+	 * DNS_RDATASLAB_EXACT is not enforced here: records that are
+	 * already present are skipped, so that adding them again is
+	 * reported as DNS_R_UNCHANGED rather than as an error.
+	 */
+	if (tcount == ocount && (flags & DNS_RDATASLAB_FORCE) == 0) {
 		return (DNS_R_UNCHANGED);
 	}
 
@@ -665,112 +1016,60 @@ dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 	 */
 	tcurrent += (tcount * 4);
 
-	offsettable = isc_mem_cget(mctx, (ocount + oncount),
+	offsettable = isc_mem_cget(mctx, (ocount + ncount),
 				   sizeof(unsigned int));
 #endif /* if DNS_RDATASET_FIXED */
 
 	/*
-	 * Merge the two slabs.
+	 * Merge the two slabs.  Where both have the same record, the old
+	 * one is kept.
 	 */
 	ocurrent = ostart;
-	INSIST(ocount != 0);
-#if DNS_RDATASET_FIXED
-	oorder = peek_uint16(&ocurrent[2]);
-	INSIST(oorder < ocount);
-#endif /* if DNS_RDATASET_FIXED */
-	rdata_from_slab(&ocurrent, rdclass, type, &ordata);
-
-	ncurrent = nslab + reservelen + 2;
-#if DNS_RDATASET_FIXED
-	ncurrent += (4 * oncount);
-#endif /* if DNS_RDATASET_FIXED */
-
-	if (ncount > 0) {
-		do {
-			dns_rdata_reset(&nrdata);
-#if DNS_RDATASET_FIXED
-			norder = peek_uint16(&ncurrent[2]);
-
-			INSIST(norder < oncount);
-#endif /* if DNS_RDATASET_FIXED */
-			rdata_from_slab(&ncurrent, rdclass, type, &nrdata);
-		} while (rdata_in_slab(oslab, reservelen, rdclass, type,
-				       &nrdata));
-	}
-
-	while (oadded < ocount || nadded < ncount) {
-		bool fromold;
-		if (oadded == ocount) {
-			fromold = false;
-		} else if (nadded == ncount) {
-			fromold = true;
+	ncurrent = nstart;
+	for (oi = 0, ni = 0; oi < ocount || ni < ncount;) {
+		int n;
+
+		if (oi == ocount) {
+			n = 1;
+		} else if (ni == ncount) {
+			n = -1;
 		} else {
-			fromold = (dns_rdata_compare(&ordata, &nrdata) < 0);
+			n = compare_items(ocurrent, ncurrent, rdclass, type,
+					  bytewise);
 		}
-		if (fromold) {
-#if DNS_RDATASET_FIXED
-			offsettable[oorder] = tcurrent - offsetbase;
-#endif /* if DNS_RDATASET_FIXED */
-			length = ordata.length;
-			data = ordata.data;
-			if (type == dns_rdatatype_rrsig) {
-				length++;
-				data--;
-			}
-			*tcurrent++ = (length & 0xff00) >> 8;
-			*tcurrent++ = (length & 0x00ff);
-#if DNS_RDATASET_FIXED
-			tcurrent += 2; /* fill in later */
-#endif				       /* if DNS_RDATASET_FIXED */
-			memmove(tcurrent, data, length);
-			tcurrent += length;
-			oadded++;
-			if (oadded < ocount) {
-				dns_rdata_reset(&ordata);
+
+		if (n <= 0) {
+			size = item_size(ocurrent);
 #if DNS_RDATASET_FIXED
-				oorder = peek_uint16(&ocurrent[2]);
-				INSIST(oorder < ocount);
+			order = peek_uint16(&ocurrent[2]);
+			INSIST(order < ocount);
+			offsettable[order] = tcurrent - offsetbase;
 #endif /* if DNS_RDATASET_FIXED */
-				rdata_from_slab(&ocurrent, rdclass, type,
-						&ordata);
+			memmove(tcurrent, ocurrent, size);
+			tcurrent += size;
+			ocurrent += size;
+			oi++;
+			if (n < 0) {
+				continue;
 			}
 		} else {
+			size = item_size(ncurrent);
 #if DNS_RDATASET_FIXED
-			offsettable[ocount + norder] = tcurrent - offsetbase;
-#endif /* if DNS_RDATASET_FIXED */
-			length = nrdata.length;
-			data = nrdata.data;
-			if (type == dns_rdatatype_rrsig) {
-				length++;
-				data--;
-			}
-			*tcurrent++ = (length & 0xff00) >> 8;
-			*tcurrent++ = (length & 0x00ff);
-#if DNS_RDATASET_FIXED
-			tcurrent += 2; /* fill in later */
-#endif				       /* if DNS_RDATASET_FIXED */
-			memmove(tcurrent, data, length);
-			tcurrent += length;
-			nadded++;
-			if (nadded < ncount) {
-				do {
-					dns_rdata_reset(&nrdata);
-#if DNS_RDATASET_FIXED
-					norder = peek_uint16(&ncurrent[2]);
-					INSIST(norder < oncount);
+			order = peek_uint16(&ncurrent[2]);
+			INSIST(order < ncount);
+			offsettable[ocount + order] = tcurrent - offsetbase;
 #endif /* if DNS_RDATASET_FIXED */
-					rdata_from_slab(&ncurrent, rdclass,
-							type, &nrdata);
-				} while (rdata_in_slab(oslab, reservelen,
-						       rdclass, type, &nrdata));
-			}
+			memmove(tcurrent, ncurrent, size);
+			tcurrent += size;
 		}
+		ncurrent += item_size(ncurrent);
+		ni++;
 	}
 
 #if DNS_RDATASET_FIXED
-	fillin_offsets(offsetbase, offsettable, ocount + oncount);
+	fillin_offsets(offsetbase, offsettable, ocount + ncount);
 
-	isc_mem_cput(mctx, offsettable, (ocount + oncount),
+	isc_mem_cput(mctx, offsettable, (ocount + ncount),
 		     sizeof(unsigned int));
 #endif /* if DNS_RDATASET_FIXED */
 
@@ -781,16 +1080,37 @@ dns_rdataslab_merge(unsigned char *oslab, unsigned char *nslab,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Advance '*scurrent' (the 'si'th of 'scount' items) past the items
+ * that sort before 'mitem', and return whether the one it stops at is
+ * the same as 'mitem'.
+ */
+static bool
+find_item(unsigned char **scurrent, unsigned int *si, unsigned int scount,
+	  unsigned char *mitem, dns_rdataclass_t rdclass,
+	  dns_rdatatype_t type, bool bytewise) {
+	while (*si < scount) {
+		int n = compare_items(*scurrent, mitem, rdclass, type,
+				      bytewise);
+		if (n >= 0) {
+			return (n == 0);
+		}
+		*scurrent += item_size(*scurrent);
+		(*si)++;
+	}
+	return (false);
+}
+
 isc_result_t
 dns_rdataslab_subtract(unsigned char *mslab, unsigned char *sslab,
 		       unsigned int reservelen, isc_mem_t *mctx,
 		       dns_rdataclass_t rdclass, dns_rdatatype_t type,
 		       unsigned int flags, unsigned char **tslabp) {
-	unsigned char *mcurrent = NULL, *sstart = NULL, *scurrent = NULL;
+	unsigned char *mcurrent = NULL, *mstart = NULL;
+	unsigned char *scurrent = NULL, *sstart = NULL;
 	unsigned char *tstart = NULL, *tcurrent = NULL;
-	unsigned int mcount, scount, rcount, count, tlength, tcount, i;
-	dns_rdata_t srdata = DNS_RDATA_INIT;
-	dns_rdata_t mrdata = DNS_RDATA_INIT;
+	unsigned int mcount, scount, rcount, tlength, tcount, mi, si, size;
+	bool bytewise = bytewise_order(rdclass, type);
 #if DNS_RDATASET_FIXED
 	unsigned char *offsetbase = NULL;
 	unsigned int *offsettable = NULL;
@@ -806,49 +1126,32 @@ dns_rdataslab_subtract(unsigned char *mslab, unsigned char *sslab,
 	scount = get_uint16(scurrent);
 	INSIST(mcount > 0 && scount > 0);
 
-	/*
-	 * Yes, this is inefficient!
-	 */
-
-	/*
-	 * Start figuring out the target length and count.
-	 */
-	tlength = reservelen + 2;
-	tcount = 0;
-	rcount = 0;
-
 #if DNS_RDATASET_FIXED
 	mcurrent += 4 * mcount;
 	scurrent += 4 * scount;
 #endif /* if DNS_RDATASET_FIXED */
+	mstart = mcurrent;
 	sstart = scurrent;
 
 	/*
-	 * Add in the length of rdata in the mslab that aren't in
-	 * the sslab.
+	 * Start figuring out the target length and count, adding in
+	 * the length of rdata in the mslab that aren't in the sslab.
 	 */
-	for (i = 0; i < mcount; i++) {
-		unsigned char *mrdatabegin = mcurrent;
-		rdata_from_slab(&mcurrent, rdclass, type, &mrdata);
-		scurrent = sstart;
-		for (count = 0; count < scount; count++) {
-			dns_rdata_reset(&srdata);
-			rdata_from_slab(&scurrent, rdclass, type, &srdata);
-			if (dns_rdata_compare(&mrdata, &srdata) == 0) {
-				break;
-			}
-		}
-		if (count == scount) {
-			/*
-			 * This rdata isn't in the sslab, and thus isn't
-			 * being subtracted.
-			 */
-			tlength += (unsigned int)(mcurrent - mrdatabegin);
-			tcount++;
-		} else {
+	tlength = reservelen + 2;
+	tcount = 0;
+	rcount = 0;
+
+	for (mi = 0, si = 0; mi < mcount; mi++) {
+		size = item_size(mcurrent);
+		if (find_item(&scurrent, &si, scount, mcurrent, rdclass, type,
+			      bytewise))
+		{
 			rcount++;
+		} else {
+			tlength += size;
+			tcount++;
 		}
-		dns_rdata_reset(&mrdata);
+		mcurrent += size;
 	}
 
 #if DNS_RDATASET_FIXED
@@ -902,40 +1205,22 @@ dns_rdataslab_subtract(unsigned char *mslab, unsigned char *sslab,
 	/*
 	 * Copy the parts of mslab not in sslab.
 	 */
-	mcurrent = mslab + reservelen;
-	mcount = get_uint16(mcurrent);
-#if DNS_RDATASET_FIXED
-	mcurrent += (4 * mcount);
-#endif /* if DNS_RDATASET_FIXED */
-	for (i = 0; i < mcount; i++) {
-		unsigned char *mrdatabegin = mcurrent;
-#if DNS_RDATASET_FIXED
-		order = peek_uint16(&mcurrent[2]);
-		INSIST(order < mcount);
-#endif /* if DNS_RDATASET_FIXED */
-		rdata_from_slab(&mcurrent, rdclass, type, &mrdata);
-		scurrent = sstart;
-		for (count = 0; count < scount; count++) {
-			dns_rdata_reset(&srdata);
-			rdata_from_slab(&scurrent, rdclass, type, &srdata);
-			if (dns_rdata_compare(&mrdata, &srdata) == 0) {
-				break;
-			}
-		}
-		if (count == scount) {
-			/*
-			 * This rdata isn't in the sslab, and thus should be
-			 * copied to the tslab.
-			 */
-			unsigned int length;
-			length = (unsigned int)(mcurrent - mrdatabegin);
+	mcurrent = mstart;
+	scurrent = sstart;
+	for (mi = 0, si = 0; mi < mcount; mi++) {
+		size = item_size(mcurrent);
+		if (!find_item(&scurrent, &si, scount, mcurrent, rdclass, type,
+			       bytewise))
+		{
 #if DNS_RDATASET_FIXED
+			order = peek_uint16(&mcurrent[2]);
+			INSIST(order < mcount);
 			offsettable[order] = tcurrent - offsetbase;
 #endif /* if DNS_RDATASET_FIXED */
-			memmove(tcurrent, mrdatabegin, length);
-			tcurrent += length;
+			memmove(tcurrent, mcurrent, size);
+			tcurrent += size;
 		}
-		dns_rdata_reset(&mrdata);
+		mcurrent += size;
 	}
 
 #if DNS_RDATASET_FIXED
@@ -1038,7 +1323,36 @@ dns_slabheader_fromrdataset(const dns_rdataset_t *rdataset) {
 
 void *
 dns_slabheader_raw(dns_slabheader_t *header) {
-	return (header + 1);
+	unsigned char *raw = NULL;
+
+	if (!header->shared) {
+		return (header + 1);
+	}
+
+	memmove(&raw, header + 1, sizeof(raw));
+	return (raw);
+}
+
+dns_slabheader_t *
+dns_slabheader_share(dns_slabheader_t *header, dns_slabstore_t *store) {
+	isc_mem_t *mctx = header->db->mctx;
+	dns_slabheader_t *shared = NULL;
+	unsigned char *raw = NULL;
+
+	REQUIRE(!header->shared && !header->packed && !NONEXISTENT(header));
+
+	shared = isc_mem_get(mctx, sizeof(*shared) + sizeof(raw));
+	*shared = *header;
+	shared->shared = 1;
+
+	raw = dns_slabstore_intern(store, dns_slabheader_raw(header));
+	memmove(shared + 1, &raw, sizeof(raw));
+
+	isc_mem_put(mctx, header,
+		    dns_rdataslab_size((unsigned char *)header,
+				       sizeof(*header)));
+
+	return (shared);
 }
 
 void
@@ -1085,6 +1399,7 @@ dns_slabheader_reset(dns_slabheader_t *h, dns_db_t *db, dns_dbnode_t *node) {
 	h->node = node;
 
 	atomic_init(&h->attributes, 0);
+	atomic_init(&h->hits, 0);
 	atomic_init(&h->last_refresh_fail_ts, 0);
 
 	STATIC_ASSERT((sizeof(h->attributes) == 2),
@@ -1117,6 +1432,10 @@ dns_slabheader_destroy(dns_slabheader_t **headerp) {
 
 	if (NONEXISTENT(header)) {
 		size = sizeof(*header);
+	} else if (header->shared) {
+		unsigned char *raw = dns_slabheader_raw(header);
+		dns_slabstore_release(&raw);
+		size = sizeof(*header) + sizeof(raw);
 	} else {
 		size = dns_rdataslab_size((unsigned char *)header,
 					  sizeof(*header));
@@ -1156,6 +1475,7 @@ dns_rdatasetmethods_t dns_rdataslab_rdatasetmethods = {
 	.clearprefetch = rdataset_clearprefetch,
 	.setownercase = rdataset_setownercase,
 	.getownercase = rdataset_getownercase,
+	.rdatasize = rdataset_rdatasize,
 };
 
 /* Fixed RRSet helper macros */
@@ -1175,12 +1495,46 @@ rdataset_disassociate(dns_rdataset_t *rdataset DNS__DB_FLARG) {
 	dns_db_t *db = rdataset->slab.db;
 	dns_dbnode_t *node = rdataset->slab.node;
 
+	if (rdataset->slab.unpacked != NULL) {
+		isc_mem_put(db->mctx, rdataset->slab.unpacked,
+			    dns_rdataslab_size(rdataset->slab.unpacked, 0));
+	}
+
 	dns__db_detachnode(db, &node DNS__DB_FLARG_PASS);
 }
 
+/*
+ * Return the slab the rdataset is bound to, following the pointer to
+ * it if it is in a slab store.
+ */
+static unsigned char *
+rdataset_slab(const dns_rdataset_t *rdataset) {
+	if (rdataset->slab.shared) {
+		return (dns_slabheader_raw(
+			dns_slabheader_fromrdataset(rdataset)));
+	}
+	return (rdataset->slab.raw);
+}
+
+/*
+ * Return the slab to iterate over: for a packed slab, that is a copy
+ * with the records decoded, made the first time it is needed.
+ */
+static unsigned char *
+rdataset_raw(dns_rdataset_t *rdataset) {
+	if ((rdataset->attributes & DNS_RDATASETATTR_PACKED) == 0) {
+		return (rdataset_slab(rdataset));
+	}
+	if (rdataset->slab.unpacked == NULL) {
+		rdataset->slab.unpacked = dns_rdataslab_unpack(
+			rdataset->slab.raw, 0, rdataset->slab.db->mctx);
+	}
+	return (rdataset->slab.unpacked);
+}
+
 static isc_result_t
 rdataset_first(dns_rdataset_t *rdataset) {
-	unsigned char *raw = rdataset->slab.raw;
+	unsigned char *raw = rdataset_raw(rdataset);
 	uint16_t count = peek_uint16(raw);
 	if (count == 0) {
 		rdataset->slab.iter_pos = NULL;
@@ -1253,7 +1607,7 @@ rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
 		offset = ((unsigned int)raw[0] << 24) +
 			 ((unsigned int)raw[1] << 16) +
 			 ((unsigned int)raw[2] << 8) + (unsigned int)raw[3];
-		raw = rdataset->slab.raw + offset;
+		raw = rdataset_raw(rdataset) + offset;
 	}
 #endif /* if DNS_RDATASET_FIXED */
 
@@ -1287,6 +1641,7 @@ rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target DNS__DB_FLARG) {
 
 	target->slab.iter_pos = NULL;
 	target->slab.iter_count = 0;
+	target->slab.unpacked = NULL;
 }
 
 static unsigned int
@@ -1294,12 +1649,17 @@ rdataset_count(dns_rdataset_t *rdataset) {
 	unsigned char *raw = NULL;
 	unsigned int count;
 
-	raw = rdataset->slab.raw;
+	raw = rdataset_slab(rdataset);
 	count = get_uint16(raw);
 
 	return (count);
 }
 
+static unsigned int
+rdataset_rdatasize(dns_rdataset_t *rdataset) {
+	return (dns_rdataslab_rdatasize(rdataset_slab(rdataset), 0));
+}
+
 static isc_result_t
 rdataset_getnoqname(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *nsec,
@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/async.h>
+#include <isc/hashmap.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/result.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/refresh.h>
+#include <dns/resolver.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#define REFRESH_MAGIC	  ISC_MAGIC('R', 'f', 's', 'h')
+#define VALID_REFRESH(r)  ISC_MAGIC_VALID(r, REFRESH_MAGIC)
+#define REFRESH_HASH_BITS 10
+
+/*
+ * How often the table is scanned for RRsets entering the prefetch
+ * window, in seconds.
+ */
+#define REFRESH_INTERVAL 1
+
+typedef enum {
+	refresh_waiting = 0,
+	refresh_fetching,
+	refresh_refreshed,
+} refresh_state_t;
+
+typedef struct refresh_entry refresh_entry_t;
+struct refresh_entry {
+	dns_refresh_t *refresh;
+	dns_name_t name;
+	dns_rdatatype_t type;
+	refresh_state_t state;
+	isc_stdtime_t expire;
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	ISC_LINK(refresh_entry_t) link;
+};
+
+typedef struct refresh_key {
+	const dns_name_t *name;
+	dns_rdatatype_t type;
+} refresh_key_t;
+
+struct dns_refresh {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_loop_t *loop;
+	isc_refcount_t references;
+	isc_timer_t *timer;
+	dns_resolver_t *resolver;
+	dns_ttl_t window;
+	unsigned int size;
+	unsigned int fetches;
+
+	/* Locked by lock. */
+	isc_mutex_t lock;
+	isc_hashmap_t *table;
+	ISC_LIST(refresh_entry_t) entries;
+	unsigned int count;
+	unsigned int active;
+	bool shuttingdown;
+};
+
+static void
+refresh_tick(void *arg);
+
+static uint32_t
+refresh_hash(const dns_name_t *name, dns_rdatatype_t type) {
+	return (dns_name_hash(name) ^ type);
+}
+
+static bool
+refresh_match(void *node, const void *key) {
+	const refresh_entry_t *entry = node;
+	const refresh_key_t *rkey = key;
+
+	return (entry->type == rkey->type &&
+		dns_name_equal(&entry->name, rkey->name));
+}
+
+static void
+refresh_incstats(dns_refresh_t *refresh, isc_statscounter_t counter) {
+	if (refresh->resolver != NULL) {
+		dns_resolver_incstats(refresh->resolver, counter);
+	}
+}
+
+static void
+dns__refresh_destroy(dns_refresh_t *refresh) {
+	REQUIRE(refresh->timer == NULL);
+	REQUIRE(ISC_LIST_EMPTY(refresh->entries));
+
+	refresh->magic = 0;
+	isc_hashmap_destroy(&refresh->table);
+	isc_mutex_destroy(&refresh->lock);
+	isc_loop_detach(&refresh->loop);
+	isc_mem_putanddetach(&refresh->mctx, refresh, sizeof(*refresh));
+}
+
+#if DNS_REFRESH_TRACE
+ISC_REFCOUNT_TRACE_IMPL(dns_refresh, dns__refresh_destroy);
+#else
+ISC_REFCOUNT_IMPL(dns_refresh, dns__refresh_destroy);
+#endif
+
+void
+dns_refresh_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+		   unsigned int size, unsigned int fetches,
+		   dns_refresh_t **refreshp) {
+	dns_refresh_t *refresh = NULL;
+	isc_interval_t interval;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(view->resolver != NULL);
+	REQUIRE(size > 0 && fetches > 0);
+	REQUIRE(refreshp != NULL && *refreshp == NULL);
+
+	refresh = isc_mem_get(view->mctx, sizeof(*refresh));
+	*refresh = (dns_refresh_t){
+		.window = view->prefetch_trigger,
+		.size = size,
+		.fetches = fetches,
+		.entries = ISC_LIST_INITIALIZER,
+	};
+
+	isc_mem_attach(view->mctx, &refresh->mctx);
+	isc_loop_attach(isc_loop_main(loopmgr), &refresh->loop);
+	dns_resolver_attach(view->resolver, &refresh->resolver);
+	isc_mutex_init(&refresh->lock);
+	isc_hashmap_create(refresh->mctx, REFRESH_HASH_BITS, &refresh->table);
+	isc_refcount_init(&refresh->references, 1);
+
+	isc_timer_create(refresh->loop, refresh_tick, refresh,
+			 &refresh->timer);
+	isc_interval_set(&interval, REFRESH_INTERVAL, 0);
+	isc_timer_start(refresh->timer, isc_timertype_ticker, &interval);
+
+	refresh->magic = REFRESH_MAGIC;
+	*refreshp = refresh;
+}
+
+/*
+ * Requires the refresh lock.
+ */
+static void
+refresh_remove(dns_refresh_t *refresh, refresh_entry_t *entry) {
+	refresh_key_t key = { .name = &entry->name, .type = entry->type };
+	isc_result_t result;
+
+	INSIST(entry->fetch == NULL);
+
+	result = isc_hashmap_delete(refresh->table,
+				    refresh_hash(&entry->name, entry->type),
+				    refresh_match, &key);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(refresh->entries, entry, link);
+	refresh->count--;
+
+	dns_name_free(&entry->name, refresh->mctx);
+	isc_mem_put(refresh->mctx, entry, sizeof(*entry));
+}
+
+static void
+refresh_done(void *arg) {
+	dns_fetchresponse_t *resp = (dns_fetchresponse_t *)arg;
+	refresh_entry_t *entry = resp->arg;
+	dns_refresh_t *refresh = entry->refresh;
+	isc_result_t eresult = resp->result;
+
+	REQUIRE(VALID_REFRESH(refresh));
+
+	LOCK(&refresh->lock);
+	INSIST(refresh->active > 0);
+	refresh->active--;
+	entry->fetch = NULL;
+
+	if (eresult == ISC_R_SUCCESS && !refresh->shuttingdown &&
+	    dns_rdataset_isassociated(&entry->rdataset))
+	{
+		/*
+		 * Keep the entry until the new RRset expires, so that
+		 * we can tell whether the refresh was worth it.
+		 */
+		entry->state = refresh_refreshed;
+		entry->expire = isc_stdtime_now() + entry->rdataset.ttl;
+	} else if (eresult != ISC_R_CANCELED) {
+		refresh_incstats(refresh, dns_resstatscounter_refreshfail);
+	}
+
+	if (dns_rdataset_isassociated(&entry->rdataset)) {
+		dns_rdataset_disassociate(&entry->rdataset);
+	}
+	if (dns_rdataset_isassociated(&entry->sigrdataset)) {
+		dns_rdataset_disassociate(&entry->sigrdataset);
+	}
+	if (entry->state != refresh_refreshed) {
+		refresh_remove(refresh, entry);
+	}
+	UNLOCK(&refresh->lock);
+
+	dns_resolver_destroyfetch(&resp->fetch);
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+
+	dns_refresh_detach(&refresh); /* for dns_resolver_createfetch() */
+}
+
+/*
+ * Requires the refresh lock.
+ */
+static void
+refresh_start(dns_refresh_t *refresh, refresh_entry_t *entry) {
+	isc_result_t result;
+
+	dns_refresh_ref(refresh); /* for dns_resolver_createfetch() */
+	result = dns_resolver_createfetch(
+		refresh->resolver, &entry->name, entry->type, NULL, NULL, NULL,
+		NULL, 0, DNS_FETCHOPT_PREFETCH, 0, NULL, refresh->loop,
+		refresh_done, entry, &entry->rdataset, &entry->sigrdataset,
+		&entry->fetch);
+	if (result != ISC_R_SUCCESS) {
+		dns_refresh_unref(refresh); /* for dns_resolver_createfetch() */
+		refresh_incstats(refresh, dns_resstatscounter_refreshfail);
+		refresh_remove(refresh, entry);
+		return;
+	}
+
+	entry->state = refresh_fetching;
+	refresh->active++;
+	refresh_incstats(refresh, dns_resstatscounter_refresh);
+}
+
+static void
+refresh_tick(void *arg) {
+	dns_refresh_t *refresh = arg;
+	isc_stdtime_t now = isc_stdtime_now();
+	refresh_entry_t *entry = NULL, *next = NULL;
+
+	REQUIRE(VALID_REFRESH(refresh));
+
+	LOCK(&refresh->lock);
+	for (entry = ISC_LIST_HEAD(refresh->entries); entry != NULL;
+	     entry = next)
+	{
+		next = ISC_LIST_NEXT(entry, link);
+
+		switch (entry->state) {
+		case refresh_waiting:
+			if (entry->expire <= now) {
+				/*
+				 * It expired before a fetch slot was
+				 * free.
+				 */
+				refresh_incstats(
+					refresh,
+					dns_resstatscounter_refreshskipped);
+				refresh_remove(refresh, entry);
+			} else if (entry->expire - now <= refresh->window &&
+				   refresh->active < refresh->fetches)
+			{
+				refresh_start(refresh, entry);
+			}
+			break;
+		case refresh_fetching:
+			break;
+		case refresh_refreshed:
+			if (entry->expire <= now) {
+				refresh_remove(refresh, entry);
+			}
+			break;
+		default:
+			UNREACHABLE();
+		}
+	}
+	UNLOCK(&refresh->lock);
+}
+
+void
+dns_refresh_add(dns_refresh_t *refresh, const dns_name_t *name,
+		dns_rdatatype_t type, isc_stdtime_t expire) {
+	refresh_key_t key = { .name = name, .type = type };
+	refresh_entry_t *entry = NULL;
+	uint32_t hashval;
+	isc_result_t result;
+
+	REQUIRE(VALID_REFRESH(refresh));
+	REQUIRE(dns_name_isabsolute(name));
+
+	hashval = refresh_hash(name, type);
+
+	LOCK(&refresh->lock);
+	if (refresh->shuttingdown) {
+		goto unlock;
+	}
+
+	result = isc_hashmap_find(refresh->table, hashval, refresh_match, &key,
+				  (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		switch (entry->state) {
+		case refresh_refreshed:
+			/*
+			 * The refreshed RRset became popular again:
+			 * the refresh paid off.
+			 */
+			refresh_incstats(refresh,
+					 dns_resstatscounter_refreshhit);
+			entry->state = refresh_waiting;
+			entry->expire = expire;
+			break;
+		case refresh_waiting:
+			entry->expire = expire;
+			break;
+		case refresh_fetching:
+			break;
+		default:
+			UNREACHABLE();
+		}
+		goto unlock;
+	}
+
+	if (refresh->count >= refresh->size) {
+		refresh_incstats(refresh, dns_resstatscounter_refreshskipped);
+		goto unlock;
+	}
+
+	entry = isc_mem_get(refresh->mctx, sizeof(*entry));
+	*entry = (refresh_entry_t){
+		.refresh = refresh,
+		.name = DNS_NAME_INITEMPTY,
+		.type = type,
+		.expire = expire,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	dns_name_dup(name, refresh->mctx, &entry->name);
+	dns_rdataset_init(&entry->rdataset);
+	dns_rdataset_init(&entry->sigrdataset);
+
+	key.name = &entry->name;
+	result = isc_hashmap_add(refresh->table, hashval, refresh_match, &key,
+				 entry, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_APPEND(refresh->entries, entry, link);
+	refresh->count++;
+
+unlock:
+	UNLOCK(&refresh->lock);
+}
+
+static void
+refresh_shutdown(void *arg) {
+	dns_refresh_t *refresh = arg;
+	refresh_entry_t *entry = NULL, *next = NULL;
+	dns_resolver_t *resolver = NULL;
+
+	REQUIRE(VALID_REFRESH(refresh));
+
+	isc_timer_stop(refresh->timer);
+	isc_timer_destroy(&refresh->timer);
+
+	LOCK(&refresh->lock);
+	for (entry = ISC_LIST_HEAD(refresh->entries); entry != NULL;
+	     entry = next)
+	{
+		next = ISC_LIST_NEXT(entry, link);
+
+		if (entry->fetch != NULL) {
+			/* refresh_done() will remove it. */
+			dns_resolver_cancelfetch(entry->fetch);
+			continue;
+		}
+		if (dns_rdataset_isassociated(&entry->rdataset)) {
+			dns_rdataset_disassociate(&entry->rdataset);
+		}
+		refresh_remove(refresh, entry);
+	}
+	resolver = refresh->resolver;
+	refresh->resolver = NULL;
+	UNLOCK(&refresh->lock);
+
+	dns_resolver_detach(&resolver);
+	dns_refresh_detach(&refresh);
+}
+
+void
+dns_refresh_shutdown(dns_refresh_t *refresh) {
+	REQUIRE(VALID_REFRESH(refresh));
+
+	LOCK(&refresh->lock);
+	if (refresh->shuttingdown) {
+		UNLOCK(&refresh->lock);
+		return;
+	}
+	refresh->shuttingdown = true;
+	UNLOCK(&refresh->lock);
+
+	dns_refresh_ref(refresh);
+	isc_async_run(refresh->loop, refresh_shutdown, refresh);
+}
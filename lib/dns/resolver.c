@@ -73,6 +73,8 @@
 #include <dns/validator.h>
 #include <dns/zone.h>
 
+#include "probes.h"
+
 #ifdef WANT_QUERYTRACE
 #define RTRACE(m)                                                       \
 	isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER, \
@@ -165,6 +167,24 @@
 #define MAX_SINGLE_QUERY_TIMEOUT    9000U
 #define MAX_SINGLE_QUERY_TIMEOUT_US (MAX_SINGLE_QUERY_TIMEOUT * US_PER_MS)
 
+/*
+ * If a UDP query to an authoritative server has not been answered within
+ * about one and a half times the server's SRTT, bounded by these limits
+ * (the latter being the connection attempt delay of RFC 8305), one more
+ * query is raced against it; see fctx_race().
+ */
+#define RACE_DELAY_MIN_US 50000U
+#define RACE_DELAY_MAX_US 250000U
+#define RACE_MAXQUERIES	  2
+
+/*
+ * Once the round trip time variance of a server has been measured, its
+ * queries time out after the smoothed RTT plus four mean deviations
+ * (RFC 6298, section 2), but never sooner than these limits allow.
+ */
+#define RTO_GRANULARITY_US 10000U
+#define RTO_MIN_US	   100000U
+
 /*
  * The default maximum number of validations and validation failures per-fetch
  */
@@ -236,6 +256,16 @@ STATIC_ASSERT(NS_PROCESSING_LIMIT > NS_RR_LIMIT,
 #define RES_DOMAIN_HASH_BITS 12
 #endif /* ifndef RES_DOMAIN_HASH_BITS */
 
+/*
+ * The fetch contexts are spread over independently locked shards, so
+ * that creating and joining fetches for unrelated names from different
+ * loops doesn't serialize on a single lock.
+ */
+#ifndef RES_FCTXS_SHARD_BITS
+#define RES_FCTXS_SHARD_BITS 4
+#endif /* ifndef RES_FCTXS_SHARD_BITS */
+#define RES_FCTXS_SHARDS (1 << RES_FCTXS_SHARD_BITS)
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -342,6 +372,7 @@ struct fetchctx {
 	char *info;
 	isc_mem_t *mctx;
 	isc_stdtime_t now;
+	uint64_t id; /* see dns_resolver_fetchid() */
 
 	isc_loop_t *loop;
 	unsigned int tid;
@@ -364,6 +395,7 @@ struct fetchctx {
 	dns_rdataset_t nameservers;
 	atomic_uint_fast32_t attributes;
 	isc_timer_t *timer;
+	isc_timer_t *racetimer;
 	isc_time_t expires;
 	isc_time_t next_timeout;
 	isc_interval_t interval;
@@ -439,6 +471,20 @@ struct fetchctx {
 	dns_fetch_t *nsfetch;
 	dns_rdataset_t nsrrset;
 
+	/*%
+	 * The last answer of issecuredomain(), which can be reused for
+	 * the same name and time while the trust generation of the view
+	 * stays the same.
+	 */
+	dns_fixedname_t secfname;
+	dns_name_t *secname;
+	uint64_t secgeneration;
+	isc_stdtime_t secnow;
+	bool secchecknta;
+	isc_result_t secresult;
+	bool secnta;
+	bool secure;
+
 	/*%
 	 * Number of queries that reference this context.
 	 */
@@ -552,8 +598,12 @@ struct dns_resolver {
 	dns_dispatchset_t *dispatches4;
 	dns_dispatchset_t *dispatches6;
 
-	isc_hashmap_t *fctxs;
-	isc_rwlock_t fctxs_lock;
+	struct {
+		isc_hashmap_t *fctxs;
+		isc_rwlock_t lock;
+		atomic_uint_fast64_t lookups;
+		atomic_uint_fast64_t contended;
+	} fctxs[RES_FCTXS_SHARDS];
 
 	isc_hashmap_t *counters;
 	isc_rwlock_t counters_lock;
@@ -581,6 +631,7 @@ struct dns_resolver {
 	/* Atomic */
 	isc_refcount_t references;
 	atomic_uint_fast32_t zspill; /* fetches-per-zone */
+	atomic_uint_fast64_t nextid; /* fetch context ids */
 	atomic_bool exiting;
 	atomic_bool priming;
 
@@ -591,6 +642,7 @@ struct dns_resolver {
 	unsigned int spillat; /* clients-per-query */
 
 	dns_badcache_t *badcache; /* Bad cache. */
+	dns_badcache_t *qmincache; /* Names known not to be zone cuts. */
 
 	/* Locked by primelock. */
 	dns_fetch_t *primefetch;
@@ -1364,6 +1416,9 @@ fctx_cancelqueries(fetchctx_t *fctx, bool no_response, bool age_untried) {
 		 * then it will try to unlink it from fctx->queries.
 		 */
 		ISC_LIST_UNLINK(queries, query, link);
+		if (no_response && !RESQUERY_CANCELED(query)) {
+			inc_stats(fctx->res, dns_resstatscounter_queryabandoned);
+		}
 		fctx_cancelquery(&query, NULL, no_response, age_untried);
 	}
 }
@@ -1569,6 +1624,7 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 	fctx->result = result;
 	now = isc_time_now();
 	fctx->duration = isc_time_microdiff(&now, &fctx->start);
+	LIBDNS_FETCH_DONE(fctx, fctx->info, result, fctx->duration);
 
 	for (resp = ISC_LIST_HEAD(fctx->resps); resp != NULL; resp = next) {
 		next = ISC_LIST_NEXT(resp, link);
@@ -1598,6 +1654,10 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 		}
 
 		FCTXTRACE("post response event");
+		if (resp->loop != fctx->loop) {
+			inc_stats(fctx->res,
+				  dns_resstatscounter_fetchcrossloop);
+		}
 		isc_async_run(resp->loop, resp->cb, resp);
 	}
 	UNLOCK(&fctx->lock);
@@ -1704,6 +1764,7 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 
 	fctx_cancelqueries(fctx, no_response, age_untried);
 	fctx_stoptimer(fctx);
+	isc_timer_stop(fctx->racetimer);
 
 	/*
 	 * Cancel all pending validators.  Note that this must be done
@@ -1728,6 +1789,7 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	fctx_cleanup(fctx);
 
 	isc_timer_destroy(&fctx->timer);
+	isc_timer_destroy(&fctx->racetimer);
 
 	return (true);
 }
@@ -1809,7 +1871,8 @@ fctx_addopt(dns_message_t *message, unsigned int version, uint16_t udpsize,
 }
 
 static void
-fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
+fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt,
+		      unsigned int rttvar) {
 	unsigned int seconds, us;
 	uint64_t limit;
 	isc_time_t now;
@@ -1825,7 +1888,18 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 		return;
 	}
 
-	us = fctx->res->retryinterval * US_PER_MS;
+	/*
+	 * If we know how much the rtt of this server varies, derive the
+	 * timeout from it; otherwise start from the configured interval.
+	 */
+	if (rttvar != 0) {
+		us = rtt + ISC_MAX(4 * rttvar, RTO_GRANULARITY_US);
+		if (us < RTO_MIN_US) {
+			us = RTO_MIN_US;
+		}
+	} else {
+		us = fctx->res->retryinterval * US_PER_MS;
+	}
 
 	/*
 	 * Exponential backoff after the first few tries.
@@ -1838,23 +1912,25 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 		us <<= shift;
 	}
 
-	/*
-	 * Add a fudge factor to the expected rtt based on the current
-	 * estimate.
-	 */
-	if (rtt < 50000) {
-		rtt += 50000;
-	} else if (rtt < 100000) {
-		rtt += 100000;
-	} else {
-		rtt += 200000;
-	}
+	if (rttvar == 0) {
+		/*
+		 * Add a fudge factor to the expected rtt based on the
+		 * current estimate.
+		 */
+		if (rtt < 50000) {
+			rtt += 50000;
+		} else if (rtt < 100000) {
+			rtt += 100000;
+		} else {
+			rtt += 200000;
+		}
 
-	/*
-	 * Always wait for at least the expected rtt.
-	 */
-	if (us < rtt) {
-		us = rtt;
+		/*
+		 * Always wait for at least the expected rtt.
+		 */
+		if (us < rtt) {
+			us = rtt;
+		}
 	}
 
 	/*
@@ -1927,7 +2003,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		srtt = US_PER_SEC;
 	}
 
-	fctx_setretryinterval(fctx, srtt);
+	fctx_setretryinterval(fctx, srtt, addrinfo->rttvar);
 	if (isc_interval_iszero(&fctx->interval)) {
 		FCTXTRACE("fetch expired");
 		return (ISC_R_TIMEDOUT);
@@ -2043,15 +2119,26 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		}
 		isc_sockaddr_setport(&addr, 0);
 
-		result = dns_dispatch_createtcp(res->view->dispatchmgr, &addr,
-						&sockaddr, addrinfo->transport,
-						DNS_DISPATCHOPT_UNSHARED,
-						&query->dispatch);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup_query;
-		}
+		/*
+		 * Pipeline the query over an open (or opening) connection
+		 * to the same server and transport if this loop has one.
+		 */
+		result = dns_dispatch_gettcp(res->view->dispatchmgr, &sockaddr,
+					     &addr, addrinfo->transport,
+					     &query->dispatch);
+		if (result == ISC_R_SUCCESS) {
+			inc_stats(res, dns_resstatscounter_tcpshared);
+			FCTXTRACE("sharing TCP connection");
+		} else {
+			result = dns_dispatch_createtcp(
+				res->view->dispatchmgr, &addr, &sockaddr,
+				addrinfo->transport, 0, &query->dispatch);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup_query;
+			}
 
-		FCTXTRACE("connecting via TCP");
+			FCTXTRACE("connecting via TCP");
+		}
 	} else {
 		if (have_addr) {
 			result = dns_dispatch_createudp(res->view->dispatchmgr,
@@ -2292,10 +2379,13 @@ compute_cc(const resquery_t *query, uint8_t *cookie, const size_t len) {
 }
 
 static isc_result_t
-issecuredomain(dns_view_t *view, const dns_name_t *name, dns_rdatatype_t type,
+issecuredomain(fetchctx_t *fctx, const dns_name_t *name, dns_rdatatype_t type,
 	       isc_stdtime_t now, bool checknta, bool *ntap, bool *issecure) {
+	dns_view_t *view = fctx->res->view;
 	dns_name_t suffix;
 	unsigned int labels;
+	uint64_t generation;
+	bool nta = false;
 
 	/*
 	 * For DS variants we need to check fom the parent domain,
@@ -2310,8 +2400,31 @@ issecuredomain(dns_view_t *view, const dns_name_t *name, dns_rdatatype_t type,
 		name = &suffix;
 	}
 
-	return (dns_view_issecuredomain(view, name, now, checknta, ntap,
-					issecure));
+	/*
+	 * A fetch asks about the same few names over and over; answer
+	 * from the last lookup if nothing it depends on has changed.
+	 * The generation must be read before the lookup.
+	 */
+	generation = dns_view_trustgeneration(view);
+	if (generation != fctx->secgeneration || now != fctx->secnow ||
+	    checknta != fctx->secchecknta ||
+	    dns_name_countlabels(fctx->secname) == 0 ||
+	    !dns_name_equal(name, fctx->secname))
+	{
+		fctx->secresult = dns_view_issecuredomain(
+			view, name, now, checknta, &nta, &fctx->secure);
+		fctx->secnta = nta;
+		fctx->secgeneration = generation;
+		fctx->secnow = now;
+		fctx->secchecknta = checknta;
+		dns_name_copy(name, fctx->secname);
+	}
+
+	if (fctx->secresult == ISC_R_SUCCESS) {
+		SET_IF_NOT_NULL(ntap, fctx->secnta);
+		*issecure = fctx->secure;
+	}
+	return (fctx->secresult);
 }
 
 static isc_result_t
@@ -2386,7 +2499,7 @@ resquery_send(resquery_t *query) {
 	{
 		bool checknta = ((query->options & DNS_FETCHOPT_NONTA) == 0);
 		bool ntacovered = false;
-		result = issecuredomain(res->view, fctx->name, fctx->type,
+		result = issecuredomain(fctx, fctx->name, fctx->type,
 					isc_time_seconds(&query->start),
 					checknta, &ntacovered, &secure_domain);
 		if (result != ISC_R_SUCCESS) {
@@ -3986,6 +4099,128 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	return (addrinfo);
 }
 
+/*
+ * Find an untried address to race against the queries in flight,
+ * preferring the address family 'pf' and skipping servers that are not
+ * expected to answer before 'limit' microseconds.
+ */
+static dns_adbaddrinfo_t *
+fctx_raceaddress(fetchctx_t *fctx, int pf, uint64_t limit) {
+	for (int pass = 0; pass < 2; pass++) {
+		for (dns_adbfind_t *find = ISC_LIST_HEAD(fctx->finds);
+		     find != NULL; find = ISC_LIST_NEXT(find, publink))
+		{
+			for (dns_adbaddrinfo_t *addrinfo =
+				     ISC_LIST_HEAD(find->list);
+			     addrinfo != NULL;
+			     addrinfo = ISC_LIST_NEXT(addrinfo, publink))
+			{
+				if (!UNMARKED(addrinfo) ||
+				    addrinfo->srtt >= limit ||
+				    (pass == 0 &&
+				     isc_sockaddr_pf(&addrinfo->sockaddr) != pf))
+				{
+					continue;
+				}
+				possibly_mark(fctx, addrinfo);
+				if (UNMARKED(addrinfo) &&
+				    !dns_adb_overquota(fctx->adb, addrinfo))
+				{
+					addrinfo->flags |= FCTX_ADDRINFO_MARK;
+					return (addrinfo);
+				}
+			}
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Happy eyeballs for authoritative servers: if the queries in flight
+ * have not been answered when the race timer fires, send one more query
+ * to the next server, preferably over the other address family, rather
+ * than waiting for the full retry interval.  The first answer wins;
+ * fctx_cancelqueries() cancels the others.
+ */
+static void
+fctx_race(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	unsigned int nqueries = 0;
+	int pf = AF_UNSPEC;
+	isc_time_t now;
+	uint64_t limit;
+	bool active;
+
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	LOCK(&fctx->lock);
+	active = fctx->state == fetchstate_active && !ADDRWAIT(fctx);
+	UNLOCK(&fctx->lock);
+	if (!active || fctx->minimized) {
+		return;
+	}
+
+	for (resquery_t *query = ISC_LIST_HEAD(fctx->queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		if (!RESQUERY_CANCELED(query)) {
+			nqueries++;
+			pf = isc_sockaddr_pf(&query->addrinfo->sockaddr);
+		}
+	}
+	if (nqueries == 0 || nqueries >= RACE_MAXQUERIES) {
+		return;
+	}
+
+	/*
+	 * A server that is not expected to answer before the query in
+	 * flight times out can't win the race.
+	 */
+	now = isc_time_now();
+	if (isc_time_compare(&fctx->next_timeout, &now) <= 0) {
+		return;
+	}
+	limit = isc_time_microdiff(&fctx->next_timeout, &now);
+
+	addrinfo = fctx_raceaddress(fctx, pf == AF_INET ? AF_INET6 : AF_INET,
+				    limit);
+	if (addrinfo == NULL ||
+	    isc_counter_increment(fctx->qc) != ISC_R_SUCCESS)
+	{
+		return;
+	}
+
+	FCTXTRACE("race");
+	if (fctx_query(fctx, addrinfo, fctx->options) == ISC_R_SUCCESS) {
+		inc_stats(fctx->res, dns_resstatscounter_raced);
+	}
+}
+
+static void
+fctx_startrace(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	isc_interval_t interval;
+	unsigned int us;
+
+	if ((fctx->options & DNS_FETCHOPT_TCP) != 0 ||
+	    addrinfo->transport != NULL || ISFORWARDER(addrinfo))
+	{
+		return;
+	}
+
+	us = addrinfo->srtt + addrinfo->srtt / 2;
+	if (us < RACE_DELAY_MIN_US) {
+		us = RACE_DELAY_MIN_US;
+	} else if (us > RACE_DELAY_MAX_US) {
+		us = RACE_DELAY_MAX_US;
+	}
+
+	isc_interval_set(&interval, 0, us * NS_PER_US);
+	isc_timer_start(fctx->racetimer, isc_timertype_once, &interval);
+}
+
 static void
 fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	isc_result_t result;
@@ -4129,6 +4364,7 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	if (retrying) {
 		inc_stats(res, dns_resstatscounter_retry);
 	}
+	fctx_startrace(fctx, addrinfo);
 
 done:
 	if (result != ISC_R_SUCCESS) {
@@ -4164,11 +4400,31 @@ resume_qmin(void *arg) {
 		dns_db_detach(&resp->db);
 	}
 
+	result = resp->result;
+
+	/*
+	 * The NS query showed that the minimized name is not a zone cut.
+	 * We got here by walking down from the zone cut one label at a
+	 * time, skipping only names the cache already knew about, so
+	 * later minimizations need not query any of the names between
+	 * the zone cut and this one: remember that for as long as the
+	 * negative answer is cached.  If a zone cut appears there in the
+	 * meantime, the deeper query is simply answered with a referral.
+	 */
+	if ((result == DNS_R_NXRRSET || result == DNS_R_NCACHENXRRSET) &&
+	    fctx->qmintype == dns_rdatatype_ns &&
+	    dns_rdataset_isassociated(resp->rdataset) &&
+	    resp->rdataset->ttl > 0)
+	{
+		dns_badcache_add(res->qmincache, fctx->qminname,
+				 dns_rdatatype_ns, true, 0,
+				 isc_stdtime_now() + resp->rdataset->ttl);
+	}
+
 	if (dns_rdataset_isassociated(resp->rdataset)) {
 		dns_rdataset_disassociate(resp->rdataset);
 	}
 
-	result = resp->result;
 	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
 
 	LOCK(&fctx->lock);
@@ -4531,6 +4787,7 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 		.loop = loop,
 		.nvalidations = atomic_load_relaxed(&res->maxvalidations),
 		.nfails = atomic_load_relaxed(&res->maxvalidationfails),
+		.id = atomic_fetch_add_relaxed(&res->nextid, 1) + 1,
 	};
 
 	isc_mem_attach(mctx, &fctx->mctx);
@@ -4549,6 +4806,7 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	fctx->info = isc_mem_strdup(fctx->mctx, buf);
 
 	FCTXTRACE("create");
+	LIBDNS_FETCH_START(fctx, fctx->info, type);
 
 	if (qc != NULL) {
 		isc_counter_attach(qc, &fctx->qc);
@@ -4589,6 +4847,7 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 
 	fctx->name = dns_fixedname_initname(&fctx->fname);
 	fctx->nsname = dns_fixedname_initname(&fctx->nsfname);
+	fctx->secname = dns_fixedname_initname(&fctx->secfname);
 	fctx->domain = dns_fixedname_initname(&fctx->dfname);
 	fctx->qminname = dns_fixedname_initname(&fctx->qminfname);
 	fctx->qmindcname = dns_fixedname_initname(&fctx->qmindcfname);
@@ -4760,6 +5019,7 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	inc_stats(res, dns_resstatscounter_nfetch);
 
 	isc_timer_create(fctx->loop, fctx_expired, fctx, &fctx->timer);
+	isc_timer_create(fctx->loop, fctx_race, fctx, &fctx->racetimer);
 
 	*fctxp = fctx;
 
@@ -5484,7 +5744,8 @@ validated(void *arg) {
 answer_response:
 
 	/*
-	 * Cache any SOA/NS/NSEC records that happened to be validated.
+	 * Cache any SOA/NS/NSEC/NSEC3 records that happened to be
+	 * validated.
 	 */
 	result = dns_message_firstname(message, DNS_SECTION_AUTHORITY);
 	while (result == ISC_R_SUCCESS) {
@@ -5495,7 +5756,8 @@ answer_response:
 		{
 			if ((rdataset->type != dns_rdatatype_ns &&
 			     rdataset->type != dns_rdatatype_soa &&
-			     rdataset->type != dns_rdatatype_nsec) ||
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_nsec3) ||
 			    rdataset->trust != dns_trust_secure)
 			{
 				continue;
@@ -5839,7 +6101,7 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
 	}
 
 	if (res->view->enablevalidation) {
-		result = issecuredomain(res->view, name, fctx->type, now,
+		result = issecuredomain(fctx, name, fctx->type, now,
 					checknta, NULL, &secure_domain);
 		if (result != ISC_R_SUCCESS) {
 			return (result);
@@ -6394,7 +6656,6 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 	       isc_stdtime_t now) {
 	isc_result_t result, eresult = ISC_R_SUCCESS;
 	dns_name_t *name = fctx->name;
-	dns_resolver_t *res = fctx->res;
 	dns_db_t **adbp = NULL;
 	dns_dbnode_t *node = NULL, **anodep = NULL;
 	dns_rdataset_t *ardataset = NULL;
@@ -6425,7 +6686,7 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 	}
 
 	if (fctx->res->view->enablevalidation) {
-		result = issecuredomain(res->view, name, fctx->type, now,
+		result = issecuredomain(fctx, name, fctx->type, now,
 					checknta, NULL, &secure_domain);
 		if (result != ISC_R_SUCCESS) {
 			return (result);
@@ -7014,22 +7275,45 @@ fctx_match(void *node, const void *key) {
 		dns_name_equal(fctx0->name, fctx1->name));
 }
 
+static unsigned int
+fctx_shard(uint32_t hashval) {
+	return (hashval & (RES_FCTXS_SHARDS - 1));
+}
+
+/*
+ * Lock a fetch context shard, counting the times someone else was
+ * already holding it.
+ */
+static void
+fctxs_lock(dns_resolver_t *res, unsigned int shard, isc_rwlocktype_t type) {
+	atomic_fetch_add_relaxed(&res->fctxs[shard].lookups, 1);
+	if (isc_rwlock_trylock(&res->fctxs[shard].lock, type) != ISC_R_SUCCESS)
+	{
+		atomic_fetch_add_relaxed(&res->fctxs[shard].contended, 1);
+		RWLOCK(&res->fctxs[shard].lock, type);
+	}
+}
+
 /* Must be fctx locked */
 static void
 release_fctx(fetchctx_t *fctx) {
 	isc_result_t result;
 	dns_resolver_t *res = fctx->res;
+	uint32_t hashval;
+	unsigned int shard;
 
 	if (!fctx->hashed) {
 		return;
 	}
 
-	RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-	result = isc_hashmap_delete(res->fctxs, fctx_hash(fctx), match_ptr,
-				    fctx);
+	hashval = fctx_hash(fctx);
+	shard = fctx_shard(hashval);
+	fctxs_lock(res, shard, isc_rwlocktype_write);
+	result = isc_hashmap_delete(res->fctxs[shard].fctxs, hashval,
+				    match_ptr, fctx);
 	INSIST(result == ISC_R_SUCCESS);
 	fctx->hashed = false;
-	RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
+	RWUNLOCK(&res->fctxs[shard].lock, isc_rwlocktype_write);
 }
 
 static void
@@ -9232,7 +9516,7 @@ rctx_authority_dnssec(respctx_t *rctx) {
 				}
 				if (fctx->res->view->enablevalidation) {
 					result = issecuredomain(
-						fctx->res->view, name,
+						fctx, name,
 						dns_rdatatype_ds, fctx->now,
 						checknta, NULL, &secure_domain);
 					if (result != ISC_R_SUCCESS) {
@@ -9915,9 +10199,11 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	isc_mutex_destroy(&res->primelock);
 	isc_mutex_destroy(&res->lock);
 
-	INSIST(isc_hashmap_count(res->fctxs) == 0);
-	isc_hashmap_destroy(&res->fctxs);
-	isc_rwlock_destroy(&res->fctxs_lock);
+	for (size_t i = 0; i < RES_FCTXS_SHARDS; i++) {
+		INSIST(isc_hashmap_count(res->fctxs[i].fctxs) == 0);
+		isc_hashmap_destroy(&res->fctxs[i].fctxs);
+		isc_rwlock_destroy(&res->fctxs[i].lock);
+	}
 
 	INSIST(isc_hashmap_count(res->counters) == 0);
 	isc_hashmap_destroy(&res->counters);
@@ -9937,6 +10223,7 @@ dns_resolver__destroy(dns_resolver_t *res) {
 		isc_mem_put(res->mctx, a, sizeof(*a));
 	}
 	dns_badcache_destroy(&res->badcache);
+	dns_badcache_destroy(&res->qmincache);
 
 	dns_view_weakdetach(&res->view);
 
@@ -10031,9 +10318,16 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_refcount_init(&res->references, 1);
 
 	res->badcache = dns_badcache_new(res->mctx);
+	res->qmincache = dns_badcache_new(res->mctx);
 
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->fctxs);
-	isc_rwlock_init(&res->fctxs_lock);
+	for (size_t i = 0; i < RES_FCTXS_SHARDS; i++) {
+		isc_hashmap_create(view->mctx,
+				   RES_DOMAIN_HASH_BITS - RES_FCTXS_SHARD_BITS,
+				   &res->fctxs[i].fctxs);
+		isc_rwlock_init(&res->fctxs[i].lock);
+		atomic_init(&res->fctxs[i].lookups, 0);
+		atomic_init(&res->fctxs[i].contended, 0);
+	}
 
 	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->counters);
 	isc_rwlock_init(&res->counters_lock);
@@ -10191,26 +10485,28 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 	RTRACE("shutdown");
 
 	if (atomic_compare_exchange_strong(&res->exiting, &is_false, true)) {
-		isc_hashmap_iter_t *it = NULL;
-
 		RTRACE("exiting");
 
-		RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-		isc_hashmap_iter_create(res->fctxs, &it);
-		for (result = isc_hashmap_iter_first(it);
-		     result == ISC_R_SUCCESS;
-		     result = isc_hashmap_iter_next(it))
-		{
-			fetchctx_t *fctx = NULL;
+		for (size_t i = 0; i < RES_FCTXS_SHARDS; i++) {
+			isc_hashmap_iter_t *it = NULL;
+
+			RWLOCK(&res->fctxs[i].lock, isc_rwlocktype_write);
+			isc_hashmap_iter_create(res->fctxs[i].fctxs, &it);
+			for (result = isc_hashmap_iter_first(it);
+			     result == ISC_R_SUCCESS;
+			     result = isc_hashmap_iter_next(it))
+			{
+				fetchctx_t *fctx = NULL;
 
-			isc_hashmap_iter_current(it, (void **)&fctx);
-			INSIST(fctx != NULL);
+				isc_hashmap_iter_current(it, (void **)&fctx);
+				INSIST(fctx != NULL);
 
-			fetchctx_ref(fctx);
-			isc_async_run(fctx->loop, fctx_shutdown, fctx);
+				fetchctx_ref(fctx);
+				isc_async_run(fctx->loop, fctx_shutdown, fctx);
+			}
+			isc_hashmap_iter_destroy(&it);
+			RWUNLOCK(&res->fctxs[i].lock, isc_rwlocktype_write);
 		}
-		isc_hashmap_iter_destroy(&it);
-		RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
 
 		LOCK(&res->lock);
 		if (res->spillattimer != NULL) {
@@ -10266,6 +10562,24 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 		fctx->qmin_labels++;
 	}
 
+	/*
+	 * Skip straight past the deepest name that earlier minimizations
+	 * found not to be a zone cut; see resume_qmin().
+	 */
+	for (unsigned int labels = nlabels - 1; labels >= fctx->qmin_labels;
+	     labels--)
+	{
+		dns_name_split(fctx->name, labels, NULL, &name);
+		if (dns_badcache_find(fctx->res->qmincache, &name,
+				      dns_rdatatype_ns, NULL,
+				      fctx->now) == ISC_R_SUCCESS)
+		{
+			inc_stats(fctx->res, dns_resstatscounter_qminhint);
+			fctx->qmin_labels = labels + 1;
+			break;
+		}
+	}
+
 	if (fctx->ip6arpaskip) {
 		/*
 		 * For ip6.arpa we want to skip some of the labels, with
@@ -10366,11 +10680,12 @@ get_attached_fctx(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	fetchctx_t *fctx = NULL;
 	isc_rwlocktype_t locktype = isc_rwlocktype_read;
 	uint32_t hashval = fctx_hash(&key);
+	unsigned int shard = fctx_shard(hashval);
 
 again:
-	RWLOCK(&res->fctxs_lock, locktype);
-	result = isc_hashmap_find(res->fctxs, hashval, fctx_match, &key,
-				  (void **)&fctx);
+	fctxs_lock(res, shard, locktype);
+	result = isc_hashmap_find(res->fctxs[shard].fctxs, hashval, fctx_match,
+				  &key, (void **)&fctx);
 	switch (result) {
 	case ISC_R_SUCCESS:
 		break;
@@ -10381,11 +10696,11 @@ again:
 			goto unlock;
 		}
 
-		UPGRADELOCK(&res->fctxs_lock, locktype);
+		UPGRADELOCK(&res->fctxs[shard].lock, locktype);
 
 		void *found = NULL;
-		result = isc_hashmap_add(res->fctxs, hashval, fctx_match, fctx,
-					 fctx, &found);
+		result = isc_hashmap_add(res->fctxs[shard].fctxs, hashval,
+					 fctx_match, fctx, fctx, &found);
 		if (result == ISC_R_SUCCESS) {
 			*new_fctx = true;
 			fctx->hashed = true;
@@ -10401,7 +10716,7 @@ again:
 	}
 	fetchctx_ref(fctx);
 unlock:
-	RWUNLOCK(&res->fctxs_lock, locktype);
+	RWUNLOCK(&res->fctxs[shard].lock, locktype);
 	if (result == ISC_R_SUCCESS) {
 		LOCK(&fctx->lock);
 		if (SHUTTINGDOWN(fctx) || fctx->cloned) {
@@ -10640,6 +10955,14 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 	dns_resolver_detach(&res);
 }
 
+uint64_t
+dns_resolver_fetchid(dns_fetch_t *fetch) {
+	REQUIRE(DNS_FETCH_VALID(fetch));
+	REQUIRE(VALID_FCTX(fetch->private));
+
+	return (fetch->private->id);
+}
+
 void
 dns_resolver_logfetch(dns_fetch_t *fetch, isc_logcategory_t category,
 		      isc_logmodule_t module, int level, bool duplicateok) {
@@ -10726,14 +11049,21 @@ void
 dns_resolver_flushbadcache(dns_resolver_t *resolver, const dns_name_t *name) {
 	if (name != NULL) {
 		dns_badcache_flushname(resolver->badcache, name);
+		/*
+		 * A QNAME minimization hint also vouches for the names
+		 * above it.
+		 */
+		dns_badcache_flushtree(resolver->qmincache, name);
 	} else {
 		dns_badcache_flush(resolver->badcache);
+		dns_badcache_flush(resolver->qmincache);
 	}
 }
 
 void
 dns_resolver_flushbadnames(dns_resolver_t *resolver, const dns_name_t *name) {
 	dns_badcache_flushtree(resolver->badcache, name);
+	dns_badcache_flushtree(resolver->qmincache, name);
 }
 
 void
@@ -10868,6 +11198,33 @@ dns_resolver_getfetchesperzone(dns_resolver_t *resolver) {
 	return (atomic_load_relaxed(&resolver->zspill));
 }
 
+unsigned int
+dns_resolver_zonefetches(dns_resolver_t *resolver, const dns_name_t *domain) {
+	fctxcount_t *counter = NULL;
+	unsigned int count = 0;
+	isc_result_t result;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(DNS_NAME_VALID(domain));
+
+	if (atomic_load_acquire(&resolver->zspill) == 0) {
+		return (0);
+	}
+
+	RWLOCK(&resolver->counters_lock, isc_rwlocktype_read);
+	result = isc_hashmap_find(resolver->counters, dns_name_hash(domain),
+				  fcount_match, domain, (void **)&counter);
+	if (result == ISC_R_SUCCESS) {
+		INSIST(VALID_FCTXCOUNT(counter));
+		LOCK(&counter->lock);
+		count = counter->count;
+		UNLOCK(&counter->lock);
+	}
+	RWUNLOCK(&resolver->counters_lock, isc_rwlocktype_read);
+
+	return (count);
+}
+
 bool
 dns_resolver_getzeronosoattl(dns_resolver_t *resolver) {
 	REQUIRE(VALID_RESOLVER(resolver));
@@ -10981,6 +11338,42 @@ dns_resolver_dumpfetches(dns_resolver_t *res, isc_statsformat_t format,
 	isc_hashmap_iter_destroy(&it);
 }
 
+/*
+ * Report how often creating or joining a fetch had to wait for the
+ * fetch context table; only printed once there has been contention.
+ */
+static isc_result_t
+dumpcontention(dns_resolver_t *res, isc_buffer_t **buf) {
+	uint_fast64_t lookups = 0, contended = 0, busiest = 0;
+	char text[BUFSIZ];
+	isc_result_t result;
+
+	for (size_t i = 0; i < RES_FCTXS_SHARDS; i++) {
+		uint_fast64_t c = atomic_load_relaxed(&res->fctxs[i].contended);
+
+		lookups += atomic_load_relaxed(&res->fctxs[i].lookups);
+		contended += c;
+		busiest = ISC_MAX(busiest, c);
+	}
+
+	if (contended == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	snprintf(text, sizeof(text),
+		 "\n- fetch table: %" PRIuFAST64 " of %" PRIuFAST64
+		 " lookups contended (busiest shard %" PRIuFAST64 ")",
+		 contended, lookups, busiest);
+
+	result = isc_buffer_reserve(*buf, strlen(text));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_buffer_putstr(*buf, text);
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
 	isc_result_t result;
@@ -10989,6 +11382,11 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
 
 	REQUIRE(VALID_RESOLVER(res));
 
+	result = dumpcontention(res, buf);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
 	spill = atomic_load_acquire(&res->zspill);
 	if (spill == 0) {
 		return (ISC_R_SUCCESS);
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/region.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/respcache.h>
+#include <dns/types.h>
+
+#define RESPCACHE_MAGIC	   ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(m) ISC_MAGIC_VALID(m, RESPCACHE_MAGIC)
+
+typedef struct respcache_entry {
+	uint64_t versionid; /* 0 if the slot is unused */
+	isc_stdtime_t expire;
+	uint32_t flags;
+	unsigned int aux;
+	dns_rdatatype_t type;
+	dns_rdataclass_t rdclass;
+	uint16_t namelen;
+	uint16_t wirelen;
+	uint16_t alloc;
+	unsigned char *data; /* owner name followed by the response */
+} respcache_entry_t;
+
+struct dns_respcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	uint32_t nloops;
+	uint32_t bits;
+	respcache_entry_t **tables;
+};
+
+void
+dns_respcache_create(isc_mem_t *mctx, uint32_t nloops, uint32_t size,
+		     dns_respcache_t **cachep) {
+	dns_respcache_t *cache = NULL;
+	uint32_t bits = ISC_HASH_MIN_BITS;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(nloops > 0);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	while (bits < ISC_HASH_MAX_BITS - 1 && (1U << bits) < size) {
+		bits++;
+	}
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_respcache_t){
+		.nloops = nloops,
+		.bits = bits,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+
+	cache->tables = isc_mem_cget(mctx, nloops, sizeof(cache->tables[0]));
+	for (uint32_t i = 0; i < nloops; i++) {
+		cache->tables[i] = isc_mem_cget(mctx, 1U << bits,
+						sizeof(respcache_entry_t));
+	}
+
+	cache->magic = RESPCACHE_MAGIC;
+	*cachep = cache;
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **cachep) {
+	dns_respcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL);
+	REQUIRE(VALID_RESPCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+	cache->magic = 0;
+
+	for (uint32_t i = 0; i < cache->nloops; i++) {
+		respcache_entry_t *table = cache->tables[i];
+
+		for (uint32_t j = 0; j < (1U << cache->bits); j++) {
+			if (table[j].data != NULL) {
+				isc_mem_put(cache->mctx, table[j].data,
+					    table[j].alloc);
+			}
+		}
+		isc_mem_cput(cache->mctx, table, 1U << cache->bits,
+			     sizeof(respcache_entry_t));
+	}
+	isc_mem_cput(cache->mctx, cache->tables, cache->nloops,
+		     sizeof(cache->tables[0]));
+
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+static respcache_entry_t *
+respcache_slot(dns_respcache_t *cache, const dns_name_t *name,
+	       dns_rdatatype_t type, dns_rdataclass_t rdclass,
+	       uint32_t flags) {
+	isc_hash32_t state;
+	uint32_t tid = isc_tid();
+	uint16_t key[2] = { type, rdclass };
+
+	INSIST(tid < cache->nloops);
+
+	isc_hash32_init(&state);
+	isc_hash32_hash(&state, name->ndata, name->length, true);
+	isc_hash32_hash(&state, key, sizeof(key), true);
+	isc_hash32_hash(&state, &flags, sizeof(flags), true);
+
+	return (&cache->tables[tid][isc_hash_bits32(
+		isc_hash32_finalize(&state), cache->bits)]);
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *cache, const dns_name_t *name,
+		   dns_rdatatype_t type, dns_rdataclass_t rdclass,
+		   uint32_t flags, uint64_t versionid, isc_stdtime_t now,
+		   isc_region_t *region, unsigned int *auxp) {
+	respcache_entry_t *entry = NULL;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(DNS_NAME_VALID(name) && dns_name_isabsolute(name));
+	REQUIRE(region != NULL && auxp != NULL);
+
+	if (versionid == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	entry = respcache_slot(cache, name, type, rdclass, flags);
+	if (entry->versionid != versionid || entry->type != type ||
+	    entry->rdclass != rdclass || entry->flags != flags ||
+	    entry->namelen != name->length || entry->expire < now ||
+	    memcmp(entry->data, name->ndata, name->length) != 0)
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	region->base = entry->data + entry->namelen;
+	region->length = entry->wirelen;
+	*auxp = entry->aux;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_respcache_add(dns_respcache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, dns_rdataclass_t rdclass,
+		  uint32_t flags, uint64_t versionid, isc_stdtime_t expire,
+		  const isc_region_t *region, unsigned int aux) {
+	respcache_entry_t *entry = NULL;
+	size_t needed;
+
+	REQUIRE(VALID_RESPCACHE(cache));
+	REQUIRE(DNS_NAME_VALID(name) && dns_name_isabsolute(name));
+	REQUIRE(versionid != 0);
+	REQUIRE(region != NULL);
+
+	if (region->length > DNS_RESPCACHE_MAXWIRE) {
+		return;
+	}
+
+	entry = respcache_slot(cache, name, type, rdclass, flags);
+
+	needed = name->length + region->length;
+	if (entry->alloc < needed) {
+		if (entry->data != NULL) {
+			isc_mem_put(cache->mctx, entry->data, entry->alloc);
+		}
+		entry->alloc = (uint16_t)needed;
+		entry->data = isc_mem_get(cache->mctx, entry->alloc);
+	}
+
+	memmove(entry->data, name->ndata, name->length);
+	memmove(entry->data + name->length, region->base, region->length);
+
+	entry->versionid = versionid;
+	entry->expire = expire;
+	entry->flags = flags;
+	entry->aux = aux;
+	entry->type = type;
+	entry->rdclass = rdclass;
+	entry->namelen = name->length;
+	entry->wirelen = region->length;
+}
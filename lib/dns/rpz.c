@@ -19,7 +19,9 @@
 #include <stdlib.h>
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
@@ -30,12 +32,14 @@
 #include <isc/result.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/qp.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -191,10 +195,50 @@ ISC_REFCOUNT_TRACE_DECL(nmdata);
 ISC_REFCOUNT_DECL(nmdata);
 #endif
 
+/*
+ * The next version of the summary of all policy zones of a view.
+ * A policy zone update applies its changes to an update transaction
+ * on the summary name table and to private copies of the radix tree
+ * and the trigger counts.  Searches keep using the published summary
+ * until build_publish() replaces all of it at once.
+ *
+ * A small incremental update is instead applied in place: the radix
+ * tree is changed under the search write lock, which is held until
+ * the name table changes are committed, and the keys of new triggers
+ * are added to the published filter.
+ *
+ * Only one build can exist at a time, because the update transaction
+ * holds the modification mutex of the name table.
+ */
+typedef struct build build_t;
+struct build {
+	dns_rpz_zones_t	    *rpzs;
+	dns_qp_t	    *qp;
+	bool		     inplace;
+	dns_rpz_filter_t    *filter; /* only in place */
+	dns_rpz_cidr_node_t *cidr;
+	dns_rpz_have_t	     have;
+	dns_rpz_triggers_t   triggers[DNS_RPZ_MAX_ZONES];
+};
+
+static void
+build_begin(dns_rpz_zones_t *rpzs, build_t *build);
 static isc_result_t
-rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name);
+build_begin_inplace(dns_rpz_zones_t *rpzs, build_t *build);
+static void
+build_publish(build_t *build);
+static void
+build_abandon(build_t *build);
 static void
-rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name);
+build_filter_name(build_t *build, const dns_name_t *name);
+static void
+build_filter_ip(build_t *build, const dns_rpz_cidr_key_t *ip,
+		dns_rpz_prefix_t prefix);
+
+static isc_result_t
+rpz_add(build_t *build, dns_rpz_zone_t *rpz, const dns_name_t *src_name);
+static void
+rpz_del(build_t *build, dns_rpz_zone_t *rpz, const dns_name_t *src_name);
 
 static nmdata_t *
 new_nmdata(isc_mem_t *mctx, const dns_name_t *name, const nmdata_t *data);
@@ -447,9 +491,9 @@ set_sum_pair(dns_rpz_cidr_node_t *cnode) {
 	} while (cnode != NULL);
 }
 
-/* Caller must hold rpzs->maint_lock */
 static void
-fix_qname_skip_recurse(dns_rpz_zones_t *rpzs) {
+fix_qname_skip_recurse(build_t *build) {
+	dns_rpz_have_t *have = &build->have;
 	dns_rpz_zbits_t mask;
 
 	/*
@@ -522,11 +566,11 @@ fix_qname_skip_recurse(dns_rpz_zones_t *rpzs) {
 	 * other policy zones containing triggers that require that the
 	 * qname be resolved before they can be checked.
 	 */
-	rpzs->have.client_ip = rpzs->have.client_ipv4 | rpzs->have.client_ipv6;
-	rpzs->have.ip = rpzs->have.ipv4 | rpzs->have.ipv6;
-	rpzs->have.nsip = rpzs->have.nsipv4 | rpzs->have.nsipv6;
+	have->client_ip = have->client_ipv4 | have->client_ipv6;
+	have->ip = have->ipv4 | have->ipv6;
+	have->nsip = have->nsipv4 | have->nsipv6;
 
-	if (rpzs->p.qname_wait_recurse) {
+	if (build->rpzs->p.qname_wait_recurse) {
 		mask = 0;
 	} else {
 		dns_rpz_zbits_t zbits_req;
@@ -539,10 +583,10 @@ fix_qname_skip_recurse(dns_rpz_zones_t *rpzs) {
 		 * do/don't require recursion
 		 */
 
-		zbits_req = (rpzs->have.ipv4 | rpzs->have.ipv6 |
-			     rpzs->have.nsdname | rpzs->have.nsipv4 |
-			     rpzs->have.nsipv6);
-		zbits_notreq = (rpzs->have.client_ip | rpzs->have.qname);
+		zbits_req = (have->ipv4 | have->ipv6 |
+			     have->nsdname | have->nsipv4 |
+			     have->nsipv6);
+		zbits_notreq = (have->client_ip | have->qname);
 
 		if (zbits_req == 0) {
 			mask = DNS_RPZ_ALL_ZBITS;
@@ -613,13 +657,13 @@ set:
 		      DNS_RPZ_DEBUG_QUIET,
 		      "computed RPZ qname_skip_recurse mask=0x%" PRIx64,
 		      (uint64_t)mask);
-	rpzs->have.qname_skip_recurse = mask;
+	have->qname_skip_recurse = mask;
 }
 
 static void
-adj_trigger_cnt(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
-		const dns_rpz_cidr_key_t *tgt_ip, dns_rpz_prefix_t tgt_prefix,
-		bool inc) {
+adj_trigger_cnt(build_t *build, dns_rpz_zone_t *rpz,
+		dns_rpz_type_t rpz_type, const dns_rpz_cidr_key_t *tgt_ip,
+		dns_rpz_prefix_t tgt_prefix, bool inc) {
 	dns_rpz_trigger_counter_t *cnt = NULL;
 	dns_rpz_zbits_t *have = NULL;
 
@@ -627,39 +671,39 @@ adj_trigger_cnt(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	case DNS_RPZ_TYPE_CLIENT_IP:
 		REQUIRE(tgt_ip != NULL);
 		if (KEY_IS_IPV4(tgt_prefix, tgt_ip)) {
-			cnt = &rpz->rpzs->triggers[rpz->num].client_ipv4;
-			have = &rpz->rpzs->have.client_ipv4;
+			cnt = &build->triggers[rpz->num].client_ipv4;
+			have = &build->have.client_ipv4;
 		} else {
-			cnt = &rpz->rpzs->triggers[rpz->num].client_ipv6;
-			have = &rpz->rpzs->have.client_ipv6;
+			cnt = &build->triggers[rpz->num].client_ipv6;
+			have = &build->have.client_ipv6;
 		}
 		break;
 	case DNS_RPZ_TYPE_QNAME:
-		cnt = &rpz->rpzs->triggers[rpz->num].qname;
-		have = &rpz->rpzs->have.qname;
+		cnt = &build->triggers[rpz->num].qname;
+		have = &build->have.qname;
 		break;
 	case DNS_RPZ_TYPE_IP:
 		REQUIRE(tgt_ip != NULL);
 		if (KEY_IS_IPV4(tgt_prefix, tgt_ip)) {
-			cnt = &rpz->rpzs->triggers[rpz->num].ipv4;
-			have = &rpz->rpzs->have.ipv4;
+			cnt = &build->triggers[rpz->num].ipv4;
+			have = &build->have.ipv4;
 		} else {
-			cnt = &rpz->rpzs->triggers[rpz->num].ipv6;
-			have = &rpz->rpzs->have.ipv6;
+			cnt = &build->triggers[rpz->num].ipv6;
+			have = &build->have.ipv6;
 		}
 		break;
 	case DNS_RPZ_TYPE_NSDNAME:
-		cnt = &rpz->rpzs->triggers[rpz->num].nsdname;
-		have = &rpz->rpzs->have.nsdname;
+		cnt = &build->triggers[rpz->num].nsdname;
+		have = &build->have.nsdname;
 		break;
 	case DNS_RPZ_TYPE_NSIP:
 		REQUIRE(tgt_ip != NULL);
 		if (KEY_IS_IPV4(tgt_prefix, tgt_ip)) {
-			cnt = &rpz->rpzs->triggers[rpz->num].nsipv4;
-			have = &rpz->rpzs->have.nsipv4;
+			cnt = &build->triggers[rpz->num].nsipv4;
+			have = &build->have.nsipv4;
 		} else {
-			cnt = &rpz->rpzs->triggers[rpz->num].nsipv6;
-			have = &rpz->rpzs->have.nsipv6;
+			cnt = &build->triggers[rpz->num].nsipv6;
+			have = &build->have.nsipv6;
 		}
 		break;
 	default:
@@ -669,13 +713,13 @@ adj_trigger_cnt(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	if (inc) {
 		if (++*cnt == 1U) {
 			*have |= DNS_RPZ_ZBIT(rpz->num);
-			fix_qname_skip_recurse(rpz->rpzs);
+			fix_qname_skip_recurse(build);
 		}
 	} else {
 		REQUIRE(*cnt != 0U);
 		if (--*cnt == 0U) {
 			*have &= ~DNS_RPZ_ZBIT(rpz->num);
-			fix_qname_skip_recurse(rpz->rpzs);
+			fix_qname_skip_recurse(build);
 		}
 	}
 }
@@ -1165,7 +1209,7 @@ trim_zbits(dns_rpz_zbits_t zbits, dns_rpz_zbits_t found) {
 }
 
 /*
- * Search a radix tree for an IP address for ordinary lookup
+ * Search the radix tree at *rootp for an IP address for ordinary lookup
  *	or for a CIDR block adding or deleting an entry
  *
  * Return ISC_R_SUCCESS, DNS_R_PARTIALMATCH, ISC_R_NOTFOUND,
@@ -1173,10 +1217,11 @@ trim_zbits(dns_rpz_zbits_t zbits, dns_rpz_zbits_t found) {
  *	or with create==true, ISC_R_EXISTS
  */
 static isc_result_t
-search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
-       dns_rpz_prefix_t tgt_prefix, const dns_rpz_addr_zbits_t *tgt_set,
-       bool create, dns_rpz_cidr_node_t **found) {
-	dns_rpz_cidr_node_t *cur = rpzs->cidr;
+search(dns_rpz_zones_t *rpzs, dns_rpz_cidr_node_t **rootp,
+       const dns_rpz_cidr_key_t *tgt_ip, dns_rpz_prefix_t tgt_prefix,
+       const dns_rpz_addr_zbits_t *tgt_set, bool create,
+       dns_rpz_cidr_node_t **found) {
+	dns_rpz_cidr_node_t *cur = *rootp;
 	dns_rpz_cidr_node_t *parent = NULL, *child = NULL;
 	dns_rpz_cidr_node_t *new_parent = NULL, *sibling = NULL;
 	dns_rpz_addr_zbits_t set = *tgt_set;
@@ -1197,7 +1242,7 @@ search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
 			}
 			child = new_node(rpzs, tgt_ip, tgt_prefix, NULL);
 			if (parent == NULL) {
-				rpzs->cidr = child;
+				*rootp = child;
 			} else {
 				parent->child[cur_num] = child;
 			}
@@ -1278,7 +1323,7 @@ search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
 			new_parent = new_node(rpzs, tgt_ip, tgt_prefix, cur);
 			new_parent->parent = parent;
 			if (parent == NULL) {
-				rpzs->cidr = new_parent;
+				*rootp = new_parent;
 			} else {
 				parent->child[cur_num] = new_parent;
 			}
@@ -1329,7 +1374,7 @@ search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
 		new_parent = new_node(rpzs, tgt_ip, dbit, cur);
 		new_parent->parent = parent;
 		if (parent == NULL) {
-			rpzs->cidr = new_parent;
+			*rootp = new_parent;
 		} else {
 			parent->child[cur_num] = new_parent;
 		}
@@ -1349,7 +1394,7 @@ search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
  * Add an IP address to the radix tree.
  */
 static isc_result_t
-add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
+add_cidr(build_t *build, dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	 const dns_name_t *src_name) {
 	dns_rpz_cidr_key_t tgt_ip;
 	dns_rpz_prefix_t tgt_prefix;
@@ -1366,8 +1411,8 @@ add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		return (ISC_R_SUCCESS);
 	}
 
-	RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
-	result = search(rpz->rpzs, &tgt_ip, tgt_prefix, &set, true, &found);
+	result = search(rpz->rpzs, &build->cidr, &tgt_ip, tgt_prefix, &set,
+			true, &found);
 	if (result != ISC_R_SUCCESS) {
 		char namebuf[DNS_NAME_FORMATSIZE];
 
@@ -1376,8 +1421,7 @@ add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		 * because diff_apply() likes to add nodes before deleting.
 		 */
 		if (result == ISC_R_EXISTS) {
-			result = ISC_R_SUCCESS;
-			goto done;
+			return (ISC_R_SUCCESS);
 		}
 
 		/*
@@ -1388,12 +1432,11 @@ add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 			      DNS_RPZ_ERROR_LEVEL,
 			      "rpz add_cidr(%s) failed: %s", namebuf,
 			      isc_result_totext(result));
-		goto done;
+		return (result);
 	}
 
-	adj_trigger_cnt(rpz, rpz_type, &tgt_ip, tgt_prefix, true);
-done:
-	RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
+	adj_trigger_cnt(build, rpz, rpz_type, &tgt_ip, tgt_prefix, true);
+	build_filter_ip(build, &found->ip, found->prefix);
 	return (result);
 }
 
@@ -1417,20 +1460,38 @@ new_nmdata(isc_mem_t *mctx, const dns_name_t *name, const nmdata_t *data) {
 	return (newdata);
 }
 
+/*
+ * Replace the summary data for a name with a changed copy, so that
+ * searches of the published summary never see the change.
+ */
+static void
+replace_nm(build_t *build, dns_name_t *trig_name, const nmdata_t *new_data) {
+	nmdata_t *data = NULL;
+	isc_result_t result;
+
+	result = dns_qp_deletename(build->qp, trig_name, NULL, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	data = new_nmdata(build->rpzs->mctx, trig_name, new_data);
+	result = dns_qp_insert(build->qp, data, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	nmdata_detach(&data);
+}
+
 static isc_result_t
-add_nm(dns_rpz_zones_t *rpzs, dns_name_t *trig_name, const nmdata_t *new_data) {
+add_nm(build_t *build, dns_name_t *trig_name, const nmdata_t *new_data) {
 	isc_result_t result;
 	nmdata_t *data = NULL;
-	dns_qp_t *qp = NULL;
+	nmdata_t sum;
 
-	dns_qpmulti_write(rpzs->table, &qp);
-	result = dns_qp_getname(qp, trig_name, (void **)&data, NULL);
+	result = dns_qp_getname(build->qp, trig_name, (void **)&data, NULL);
 	if (result != ISC_R_SUCCESS) {
 		INSIST(data == NULL);
-		data = new_nmdata(rpzs->mctx, trig_name, new_data);
-		result = dns_qp_insert(qp, data, 0);
+		data = new_nmdata(build->rpzs->mctx, trig_name, new_data);
+		result = dns_qp_insert(build->qp, data, 0);
 		nmdata_detach(&data);
-		goto done;
+		build_filter_name(build, trig_name);
+		return (result);
 	}
 
 	/*
@@ -1445,20 +1506,22 @@ add_nm(dns_rpz_zones_t *rpzs, dns_name_t *trig_name, const nmdata_t *new_data) {
 	}
 
 	/* copy in the bits from the new data */
-	data->set.qname |= new_data->set.qname;
-	data->set.ns |= new_data->set.ns;
-	data->wild.qname |= new_data->wild.qname;
-	data->wild.ns |= new_data->wild.ns;
+	sum.set.qname = data->set.qname | new_data->set.qname;
+	sum.set.ns = data->set.ns | new_data->set.ns;
+	sum.wild.qname = data->wild.qname | new_data->wild.qname;
+	sum.wild.ns = data->wild.ns | new_data->wild.ns;
 
-done:
-	dns_qp_compact(qp, DNS_QPGC_MAYBE);
-	dns_qpmulti_commit(rpzs->table, &qp);
+	if (sum.set.qname != data->set.qname || sum.set.ns != data->set.ns ||
+	    sum.wild.qname != data->wild.qname || sum.wild.ns != data->wild.ns)
+	{
+		replace_nm(build, trig_name, &sum);
+	}
 
 	return (result);
 }
 
 static isc_result_t
-add_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
+add_name(build_t *build, dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	 const dns_name_t *src_name) {
 	nmdata_t new_data;
 	dns_fixedname_t trig_namef;
@@ -1473,7 +1536,7 @@ add_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	trig_name = dns_fixedname_initname(&trig_namef);
 	name2data(rpz, rpz_type, src_name, trig_name, &new_data);
 
-	result = add_nm(rpz->rpzs, trig_name, &new_data);
+	result = add_nm(build, trig_name, &new_data);
 
 	/*
 	 * Do not worry if the node already exists,
@@ -1483,9 +1546,7 @@ add_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		return (ISC_R_SUCCESS);
 	}
 	if (result == ISC_R_SUCCESS) {
-		RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
-		adj_trigger_cnt(rpz, rpz_type, NULL, 0, true);
-		RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
+		adj_trigger_cnt(build, rpz, rpz_type, NULL, 0, true);
 	}
 	return (result);
 }
@@ -1551,7 +1612,8 @@ dns_rpz_new_zone(dns_rpz_zones_t *rpzs, dns_rpz_zone_t **rpzp) {
 	 * simplifies update_from_db().
 	 */
 
-	isc_ht_init(&rpz->nodes, rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&rpz->nodes, rpzs->mctx, 1,
+		    ISC_HT_CASE_SENSITIVE | ISC_HT_FLAT);
 
 	dns_name_init(&rpz->origin, NULL);
 	dns_name_init(&rpz->client_ip, NULL);
@@ -1590,6 +1652,9 @@ dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 
 	/* New zone came as AXFR */
 	if (rpz->db != NULL && rpz->db != db) {
+		/* The journal does not lead to the new DB */
+		rpz->summarized = false;
+
 		/* We need to clean up the old DB */
 		if (rpz->dbversion != NULL) {
 			dns_db_closeversion(rpz->db, &rpz->dbversion, false);
@@ -1645,6 +1710,22 @@ dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz) {
 
 	dns_db_updatenotify_register(db, dns_rpz_dbupdate_callback, rpz);
 }
+
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal) {
+	REQUIRE(DNS_RPZ_ZONE_VALID(rpz));
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->journal);
+		rpz->journal = NULL;
+	}
+	if (journal != NULL) {
+		rpz->journal = isc_mem_strdup(rpz->rpzs->mctx, journal);
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+}
+
 static void
 dns__rpz_timer_start(dns_rpz_zone_t *rpz) {
 	uint64_t tdiff;
@@ -1706,6 +1787,15 @@ update_rpz_done_cb(void *data) {
 		dns__rpz_timer_start(rpz);
 	}
 
+	/*
+	 * Later updates can start from the journal if the summary is
+	 * of a version of the current DB.
+	 */
+	rpz->summarized = (rpz->updateresult == ISC_R_SUCCESS &&
+			   rpz->updb == rpz->db &&
+			   dns_db_getsoaserial(rpz->updb, rpz->updbversion,
+					       &rpz->serial) == ISC_R_SUCCESS);
+
 	dns_db_closeversion(rpz->updb, &rpz->updbversion, false);
 	dns_db_detach(&rpz->updb);
 
@@ -1719,7 +1809,7 @@ update_rpz_done_cb(void *data) {
 }
 
 static isc_result_t
-update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
+update_nodes(dns_rpz_zone_t *rpz, build_t *build, isc_ht_t *newnodes) {
 	isc_result_t result;
 	dns_dbiterator_t *updbit = NULL;
 	dns_name_t *name = NULL;
@@ -1821,14 +1911,7 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 			goto next;
 		}
 
-		/*
-		 * Only the single rpz updates are serialized, so we need to
-		 * lock here because we can be processing more updates to
-		 * different rpz zones at the same time
-		 */
-		LOCK(&rpz->rpzs->maint_lock);
-		result = rpz_add(rpz, name);
-		UNLOCK(&rpz->rpzs->maint_lock);
+		result = rpz_add(build, rpz, name);
 
 		if (result != ISC_R_SUCCESS) {
 			dns_name_format(name, namebuf, sizeof(namebuf));
@@ -1861,7 +1944,7 @@ cleanup:
 }
 
 static isc_result_t
-cleanup_nodes(dns_rpz_zone_t *rpz) {
+cleanup_nodes(dns_rpz_zone_t *rpz, build_t *build) {
 	isc_result_t result;
 	isc_ht_iter_t *iter = NULL;
 	dns_name_t *name = NULL;
@@ -1888,9 +1971,7 @@ cleanup_nodes(dns_rpz_zone_t *rpz) {
 		region.length = (unsigned int)keysize;
 		dns_name_fromregion(name, &region);
 
-		LOCK(&rpz->rpzs->maint_lock);
-		rpz_del(rpz, name);
-		UNLOCK(&rpz->rpzs->maint_lock);
+		rpz_del(build, rpz, name);
 	}
 	INSIST(result != ISC_R_SUCCESS);
 	if (result == ISC_R_NOMORE) {
@@ -1917,11 +1998,219 @@ dns__rpz_shuttingdown(dns_rpz_zones_t *rpzs) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Is there anything at 'name' in the version being updated to?
+ */
+static isc_result_t
+node_present(dns_rpz_zone_t *rpz, const dns_name_t *name, bool *presentp) {
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+
+	*presentp = false;
+
+	result = dns_db_findnode(rpz->updb, name, false, &node);
+	if (result == ISC_R_NOTFOUND) {
+		return (ISC_R_SUCCESS);
+	} else if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_db_allrdatasets(rpz->updb, node, rpz->updbversion, 0, 0,
+				     &rdsiter);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rdatasetiter_first(rdsiter);
+		dns_rdatasetiter_destroy(&rdsiter);
+	}
+	dns_db_detachnode(rpz->updb, &node);
+
+	switch (result) {
+	case ISC_R_SUCCESS:
+		*presentp = true;
+		return (ISC_R_SUCCESS);
+	case ISC_R_NOMORE: /* empty non-terminal */
+		return (ISC_R_SUCCESS);
+	default:
+		return (result);
+	}
+}
+
+/*
+ * Collect the names changed by the journal transactions from 'serial'
+ * to the version being updated to, keeping those that appeared in or
+ * disappeared from the zone.
+ */
+static isc_result_t
+journal_changes(dns_rpz_zone_t *rpz, const char *journal, uint32_t serial,
+		isc_ht_t *changes) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	uint32_t end;
+
+	result = dns_db_getsoaserial(rpz->updb, rpz->updbversion, &end);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_open(rpz->rpzs->mctx, journal, DNS_JOURNAL_READ,
+				  &j);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_iter_init(j, serial, end, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *rrname = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(j, &rrname, &ttl, &rdata);
+		dns_name_downcase(rrname, name, NULL);
+		result = isc_ht_add(changes, name->ndata, name->length, NULL);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			goto cleanup;
+		}
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	isc_ht_iter_create(changes, &iter);
+	result = isc_ht_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		isc_region_t region;
+		unsigned char *key = NULL;
+		size_t keysize;
+		bool present, known;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		region.base = key;
+		region.length = (unsigned int)keysize;
+		dns_name_fromregion(name, &region);
+
+		result = node_present(rpz, name, &present);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		known = (isc_ht_find(rpz->nodes, key, keysize, NULL) ==
+			 ISC_R_SUCCESS);
+
+		if (present == known) {
+			result = isc_ht_iter_delcurrent_next(iter);
+		} else {
+			result = isc_ht_iter_next(iter);
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	dns_journal_destroy(&j);
+	return (result);
+}
+
+/*
+ * Apply the changes from the journal to the summary in place.
+ * Nothing here can fail, the changes were checked before.
+ */
+static void
+apply_changes(dns_rpz_zone_t *rpz, build_t *build, isc_ht_t *changes) {
+	isc_ht_iter_t *iter = NULL;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+
+	isc_ht_iter_create(changes, &iter);
+	for (isc_result_t result = isc_ht_iter_first(iter);
+	     result == ISC_R_SUCCESS; result = isc_ht_iter_next(iter))
+	{
+		isc_region_t region;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		region.base = key;
+		region.length = (unsigned int)keysize;
+		dns_name_fromregion(name, &region);
+
+		if (isc_ht_find(rpz->nodes, key, keysize, NULL) ==
+		    ISC_R_SUCCESS)
+		{
+			rpz_del(build, rpz, name);
+			isc_ht_delete(rpz->nodes, key, keysize);
+		} else {
+			/* rpz_add() logs its own errors */
+			(void)rpz_add(build, rpz, name);
+			RUNTIME_CHECK(isc_ht_add(rpz->nodes, key, keysize,
+						 rpz) == ISC_R_SUCCESS);
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+}
+
+/*
+ * Update the summary from the journal of the policy zone, in time
+ * proportional to the number of changes rather than to the zone size.
+ */
+static isc_result_t
+update_from_journal(dns_rpz_zone_t *rpz, const char *journal,
+		    uint32_t serial) {
+	isc_result_t result;
+	isc_ht_t *changes = NULL;
+	char domain[DNS_NAME_FORMATSIZE];
+	build_t build;
+
+	isc_ht_init(&changes, rpz->rpzs->mctx, 1,
+		    ISC_HT_CASE_SENSITIVE | ISC_HT_FLAT);
+
+	result = journal_changes(rpz, journal, serial, changes);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = build_begin_inplace(rpz->rpzs, &build);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	apply_changes(rpz, &build, changes);
+	build_publish(&build);
+
+	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+		      ISC_LOG_DEBUG(1),
+		      "rpz: %s: %zu nodes changed from the journal", domain,
+		      isc_ht_count(changes));
+
+cleanup:
+	isc_ht_destroy(&changes);
+	return (result);
+}
+
+/*
+ * Runs on an offload thread.  A version that can be reached through
+ * the journal is applied incrementally.  Otherwise, the new version of
+ * the policy zone is compiled into a new summary aside from the one
+ * used by searches, which is only replaced when the whole version has
+ * been processed.
+ */
 static void
 update_rpz_cb(void *data) {
 	dns_rpz_zone_t *rpz = (dns_rpz_zone_t *)data;
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_ht_t *newnodes = NULL;
+	char *journal = NULL;
+	uint32_t serial;
+	build_t build;
 
 	REQUIRE(rpz->nodes != NULL);
 
@@ -1930,22 +2219,53 @@ update_rpz_cb(void *data) {
 		goto shuttingdown;
 	}
 
-	isc_ht_init(&newnodes, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->summarized && rpz->journal != NULL) {
+		journal = isc_mem_strdup(rpz->rpzs->mctx, rpz->journal);
+	}
+	serial = rpz->serial;
+	UNLOCK(&rpz->rpzs->maint_lock);
+
+	if (journal != NULL) {
+		char domain[DNS_NAME_FORMATSIZE];
+
+		result = update_from_journal(rpz, journal, serial);
+		isc_mem_free(rpz->rpzs->mctx, journal);
+		if (result == ISC_R_SUCCESS) {
+			goto shuttingdown;
+		}
+
+		dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+			      ISC_LOG_DEBUG(1),
+			      "rpz: %s: cannot update from the journal (%s), "
+			      "rescanning the zone",
+			      domain, isc_result_totext(result));
+	}
 
-	result = update_nodes(rpz, newnodes);
+	/* The new set of nodes is usually about as large as the old one */
+	isc_ht_init_sized(&newnodes, rpz->rpzs->mctx, isc_ht_count(rpz->nodes),
+			  ISC_HT_CASE_SENSITIVE | ISC_HT_FLAT);
+	build_begin(rpz->rpzs, &build);
+
+	result = update_nodes(rpz, &build, newnodes);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
-	result = cleanup_nodes(rpz);
+	result = cleanup_nodes(rpz, &build);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
 	/* Finalize the update */
+	build_publish(&build);
 	ISC_SWAP(rpz->nodes, newnodes);
 
 cleanup:
+	if (build.qp != NULL) {
+		build_abandon(&build);
+	}
 	isc_ht_destroy(&newnodes);
 
 shuttingdown:
@@ -1982,7 +2302,8 @@ dns__rpz_timer_cb(void *arg) {
 		      ISC_LOG_INFO, "rpz: %s: reload start", domain);
 
 	dns_rpz_zones_ref(rpz->rpzs);
-	isc_work_enqueue(rpz->loop, update_rpz_cb, update_rpz_done_cb, rpz);
+	isc_work_enqueue_bulk(rpz->loop, update_rpz_cb, update_rpz_done_cb,
+			      rpz);
 
 	isc_timer_destroy(&rpz->updatetimer);
 	rpz->loop = NULL;
@@ -1993,13 +2314,211 @@ unlock:
 }
 
 /*
- * Free the radix tree of a response policy database.
+ * A blocked Bloom filter over all triggers in the summary, to reject
+ * names and addresses that match no trigger, which is what almost all
+ * of them do, before searching the name table or the radix tree.
+ * Each key sets FILTER_PROBES bits in one block of FILTER_BLOCK_BITS
+ * bits, so a test touches a single cache line.
+ *
+ * Names are entered as they are in the name table, where wildcard
+ * triggers are kept at the parent name; a name is tested along with
+ * all of its parents.  Addresses are entered with their prefix length
+ * and the lengths in use are recorded, so that an address only has to
+ * be tested with those.
+ *
+ * Incremental updates add the keys of new triggers to the published
+ * filter, and leave the keys of deleted triggers in place.  Once the
+ * added keys make the filter too full, the next update rebuilds it.
  */
+#define FILTER_BLOCK_WORDS 8
+#define FILTER_BLOCK_BITS  (FILTER_BLOCK_WORDS * 64)
+#define FILTER_PROBES	   6
+#define FILTER_KEY_BITS	   10 /* about 1% false positives */
+
+struct dns_rpz_filter {
+	isc_mem_t	    *mctx;
+	struct rcu_head	     rcu_head;
+	size_t		     keys;  /* keys the filter was sized for */
+	atomic_size_t	     added; /* keys added since */
+	atomic_uint_fast64_t prefixes[3]; /* prefix lengths of addresses */
+	size_t		     nblocks;
+	atomic_uint_fast64_t blocks[][FILTER_BLOCK_WORDS];
+};
+
+static atomic_uint_fast64_t *
+filter_block(const dns_rpz_filter_t *filter, uint64_t hash) {
+	/* The upper half of the hash picks the block */
+	size_t i = ((hash >> 32) * filter->nblocks) >> 32;
+
+	return ((atomic_uint_fast64_t *)filter->blocks[i]);
+}
+
 static void
-cidr_free(dns_rpz_zones_t *rpzs) {
+filter_add(dns_rpz_filter_t *filter, uint64_t hash) {
+	atomic_uint_fast64_t *block = filter_block(filter, hash);
+
+	for (size_t i = 0; i < FILTER_PROBES; i++) {
+		unsigned int bit = (hash >> (i * 9)) % FILTER_BLOCK_BITS;
+		atomic_fetch_or_relaxed(&block[bit / 64], (uint64_t)1
+								  << (bit % 64));
+	}
+}
+
+static bool
+filter_test(const dns_rpz_filter_t *filter, uint64_t hash) {
+	atomic_uint_fast64_t *block = filter_block(filter, hash);
+
+	for (size_t i = 0; i < FILTER_PROBES; i++) {
+		unsigned int bit = (hash >> (i * 9)) % FILTER_BLOCK_BITS;
+		uint64_t word = atomic_load_relaxed(&block[bit / 64]);
+
+		if ((word & ((uint64_t)1 << (bit % 64))) == 0) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static void
+filter_add_name(dns_rpz_filter_t *filter, const dns_name_t *name) {
+	filter_add(filter, isc_hash64(name->ndata, name->length, false));
+}
+
+static uint64_t
+filter_hash_ip(const dns_rpz_cidr_key_t *ip, dns_rpz_prefix_t prefix) {
+	struct {
+		dns_rpz_cidr_key_t ip;
+		uint32_t prefix;
+	} key = { .prefix = prefix };
+	int words = prefix / DNS_RPZ_CIDR_WORD_BITS;
+	int wlen = prefix % DNS_RPZ_CIDR_WORD_BITS;
+
+	/* Mask the address like new_node() does */
+	for (int i = 0; i < words; i++) {
+		key.ip.w[i] = ip->w[i];
+	}
+	if (wlen != 0) {
+		key.ip.w[words] = ip->w[words] & DNS_RPZ_WORD_MASK(wlen);
+	}
+
+	return (isc_hash64(&key, sizeof(key), true));
+}
+
+static void
+filter_add_ip(dns_rpz_filter_t *filter, const dns_rpz_cidr_key_t *ip,
+	      dns_rpz_prefix_t prefix) {
+	filter_add(filter, filter_hash_ip(ip, prefix));
+	atomic_fetch_or_relaxed(&filter->prefixes[prefix / 64],
+				(uint64_t)1 << (prefix % 64));
+}
+
+static size_t
+filter_count_cidr(const dns_rpz_cidr_node_t *node) {
+	if (node == NULL) {
+		return (0);
+	}
+	return ((node->set.client_ip != 0 || node->set.ip != 0 ||
+		 node->set.nsip != 0) +
+		filter_count_cidr(node->child[0]) +
+		filter_count_cidr(node->child[1]));
+}
+
+static void
+filter_add_cidr(dns_rpz_filter_t *filter, const dns_rpz_cidr_node_t *node) {
+	if (node == NULL) {
+		return;
+	}
+	if (node->set.client_ip != 0 || node->set.ip != 0 ||
+	    node->set.nsip != 0)
+	{
+		filter_add_ip(filter, &node->ip, node->prefix);
+	}
+	filter_add_cidr(filter, node->child[0]);
+	filter_add_cidr(filter, node->child[1]);
+}
+
+static dns_rpz_filter_t *
+filter_create(isc_mem_t *mctx, dns_qp_t *qp, const dns_rpz_cidr_node_t *cidr) {
+	dns_rpz_filter_t *filter = NULL;
+	dns_qpiter_t iter;
+	nmdata_t *data = NULL;
+	size_t keys, nblocks;
+
+	keys = dns_qp_memusage(qp).leaves + filter_count_cidr(cidr);
+	nblocks = (keys * FILTER_KEY_BITS + FILTER_BLOCK_BITS - 1) /
+		  FILTER_BLOCK_BITS;
+	nblocks = ISC_CLAMP(nblocks, 1, UINT32_MAX);
+
+	filter = isc_mem_get(mctx, STRUCT_FLEX_SIZE(filter, blocks, nblocks));
+	*filter = (dns_rpz_filter_t){ .keys = keys, .nblocks = nblocks };
+	for (size_t i = 0; i < nblocks; i++) {
+		for (size_t j = 0; j < FILTER_BLOCK_WORDS; j++) {
+			atomic_init(&filter->blocks[i][j], 0);
+		}
+	}
+	isc_mem_attach(mctx, &filter->mctx);
+
+	dns_qpiter_init(qp, &iter);
+	while (dns_qpiter_next(&iter, NULL, (void **)&data, NULL) ==
+	       ISC_R_SUCCESS)
+	{
+		filter_add_name(filter, &data->name);
+	}
+	filter_add_cidr(filter, cidr);
+
+	return (filter);
+}
+
+static bool
+filter_full(dns_rpz_filter_t *filter) {
+	size_t keys = filter->keys + atomic_load_relaxed(&filter->added);
+
+	/* Half again as many keys as it was made for */
+	return (keys * FILTER_KEY_BITS * 2 >
+		filter->nblocks * FILTER_BLOCK_BITS * 3);
+}
+
+/*
+ * Add a new trigger to the filter of a summary changed in place.
+ */
+static void
+build_filter_name(build_t *build, const dns_name_t *name) {
+	if (build->filter != NULL) {
+		filter_add_name(build->filter, name);
+		atomic_fetch_add_relaxed(&build->filter->added, 1);
+	}
+}
+
+static void
+build_filter_ip(build_t *build, const dns_rpz_cidr_key_t *ip,
+		dns_rpz_prefix_t prefix) {
+	if (build->filter != NULL) {
+		filter_add_ip(build->filter, ip, prefix);
+		atomic_fetch_add_relaxed(&build->filter->added, 1);
+	}
+}
+
+static void
+filter_destroy(dns_rpz_filter_t *filter) {
+	isc_mem_putanddetach(&filter->mctx, filter,
+			     STRUCT_FLEX_SIZE(filter, blocks, filter->nblocks));
+}
+
+static void
+filter_destroy_rcu(struct rcu_head *rcu_head) {
+	dns_rpz_filter_t *filter = caa_container_of(rcu_head, dns_rpz_filter_t,
+						    rcu_head);
+	filter_destroy(filter);
+}
+
+/*
+ * Free a radix tree of a response policy database.
+ */
+static void
+cidr_free(isc_mem_t *mctx, dns_rpz_cidr_node_t *root) {
 	dns_rpz_cidr_node_t *cur = NULL, *child = NULL, *parent = NULL;
 
-	cur = rpzs->cidr;
+	cur = root;
 	while (cur != NULL) {
 		/* Depth first. */
 		child = cur->child[0];
@@ -2015,16 +2534,140 @@ cidr_free(dns_rpz_zones_t *rpzs) {
 
 		/* Delete this leaf and go up. */
 		parent = cur->parent;
-		if (parent == NULL) {
-			rpzs->cidr = NULL;
-		} else {
+		if (parent != NULL) {
 			parent->child[parent->child[1] == cur] = NULL;
 		}
-		isc_mem_put(rpzs->mctx, cur, sizeof(*cur));
+		isc_mem_put(mctx, cur, sizeof(*cur));
 		cur = parent;
 	}
 }
 
+/*
+ * Copy a radix tree.  The depth of the tree is limited by the
+ * number of bits in an address.
+ */
+static dns_rpz_cidr_node_t *
+cidr_copy(isc_mem_t *mctx, const dns_rpz_cidr_node_t *src,
+	  dns_rpz_cidr_node_t *parent) {
+	dns_rpz_cidr_node_t *node = NULL;
+
+	if (src == NULL) {
+		return (NULL);
+	}
+
+	node = isc_mem_get(mctx, sizeof(*node));
+	*node = *src;
+	node->parent = parent;
+	node->child[0] = cidr_copy(mctx, src->child[0], node);
+	node->child[1] = cidr_copy(mctx, src->child[1], node);
+
+	return (node);
+}
+
+/*
+ * Start building the next version of the summary from the published one.
+ */
+static void
+build_begin(dns_rpz_zones_t *rpzs, build_t *build) {
+	*build = (build_t){ .rpzs = rpzs };
+
+	/*
+	 * The update transaction keeps other updates out until the
+	 * build is published or abandoned, so the published summary
+	 * cannot change while it is being copied.
+	 */
+	dns_qpmulti_update(rpzs->table, &build->qp);
+
+	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	build->cidr = cidr_copy(rpzs->mctx, rpzs->cidr, NULL);
+	build->have = rpzs->have;
+	memmove(build->triggers, rpzs->triggers, sizeof(build->triggers));
+	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+}
+
+/*
+ * Start changing the published summary in place, unless the filter
+ * has had too many keys added to take more.
+ */
+static isc_result_t
+build_begin_inplace(dns_rpz_zones_t *rpzs, build_t *build) {
+	dns_rpz_filter_t *filter = NULL;
+
+	*build = (build_t){ .rpzs = rpzs, .inplace = true };
+
+	dns_qpmulti_write(rpzs->table, &build->qp);
+
+	/* Only a build can replace the filter, so it stays put */
+	filter = rcu_dereference(rpzs->filter);
+	if (filter == NULL || filter_full(filter)) {
+		dns_qpmulti_commit(rpzs->table, &build->qp);
+		return (ISC_R_NOSPACE);
+	}
+	build->filter = filter;
+
+	RWLOCK(&rpzs->search_lock, isc_rwlocktype_write);
+	build->cidr = rpzs->cidr;
+	build->have = rpzs->have;
+	memmove(build->triggers, rpzs->triggers, sizeof(build->triggers));
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Make the new summary visible to searches in one step.
+ */
+static void
+build_publish(build_t *build) {
+	dns_rpz_zones_t *rpzs = build->rpzs;
+	dns_rpz_cidr_node_t *oldcidr = NULL;
+	dns_rpz_filter_t *filter = NULL;
+
+	if (build->inplace) {
+		rpzs->cidr = build->cidr;
+		rpzs->have = build->have;
+		memmove(rpzs->triggers, build->triggers,
+			sizeof(rpzs->triggers));
+		dns_qp_compact(build->qp, DNS_QPGC_MAYBE);
+		dns_qpmulti_commit(rpzs->table, &build->qp);
+		RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_write);
+
+		build->cidr = NULL;
+		build->filter = NULL;
+		return;
+	}
+
+	/* Do the expensive part before blocking searches */
+	dns_qp_compact(build->qp, DNS_QPGC_ALL);
+	filter = filter_create(rpzs->mctx, build->qp, build->cidr);
+
+	RWLOCK(&rpzs->search_lock, isc_rwlocktype_write);
+	oldcidr = rpzs->cidr;
+	rpzs->cidr = build->cidr;
+	rpzs->have = build->have;
+	memmove(rpzs->triggers, build->triggers, sizeof(rpzs->triggers));
+	dns_qpmulti_commit(rpzs->table, &build->qp);
+	filter = rcu_xchg_pointer(&rpzs->filter, filter);
+	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_write);
+
+	build->cidr = NULL;
+	cidr_free(rpzs->mctx, oldcidr);
+	if (filter != NULL) {
+		call_rcu(&filter->rcu_head, filter_destroy_rcu);
+	}
+}
+
+/*
+ * Throw away an unfinished summary.
+ */
+static void
+build_abandon(build_t *build) {
+	REQUIRE(!build->inplace);
+
+	dns_qpmulti_rollback(build->rpzs->table, &build->qp);
+	cidr_free(build->rpzs->mctx, build->cidr);
+	build->cidr = NULL;
+}
+
 static void
 dns__rpz_shutdown(dns_rpz_zone_t *rpz) {
 	/* maint_lock must be locked */
@@ -2085,6 +2728,9 @@ dns_rpz_zone_destroy(dns_rpz_zone_t **rpzp) {
 	}
 	INSIST(!rpz->updaterunning);
 
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpzs->mctx, rpz->journal);
+	}
 	isc_ht_destroy(&rpz->nodes);
 
 	isc_mem_put(rpzs->mctx, rpz, sizeof(*rpz));
@@ -2103,7 +2749,12 @@ dns__rpz_zones_destroy(dns_rpz_zones_t *rpzs) {
 		dns_rpz_zone_destroy(&rpzs->zones[rpz_num]);
 	}
 
-	cidr_free(rpzs);
+	cidr_free(rpzs->mctx, rpzs->cidr);
+	rpzs->cidr = NULL;
+	if (rpzs->filter != NULL) {
+		filter_destroy(rpzs->filter);
+		rpzs->filter = NULL;
+	}
 	if (rpzs->table != NULL) {
 		dns_qpmulti_destroy(&rpzs->table);
 	}
@@ -2149,7 +2800,7 @@ ISC_REFCOUNT_IMPL(dns_rpz_zones, dns__rpz_zones_destroy);
  * Add an IP address to the radix tree or a name to the summary database.
  */
 static isc_result_t
-rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
+rpz_add(build_t *build, dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	dns_rpz_type_t rpz_type;
 	isc_result_t result = ISC_R_FAILURE;
 	dns_rpz_zones_t *rpzs = NULL;
@@ -2166,12 +2817,12 @@ rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	switch (rpz_type) {
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_NSDNAME:
-		result = add_name(rpz, rpz_type, src_name);
+		result = add_name(build, rpz, rpz_type, src_name);
 		break;
 	case DNS_RPZ_TYPE_CLIENT_IP:
 	case DNS_RPZ_TYPE_IP:
 	case DNS_RPZ_TYPE_NSIP:
-		result = add_cidr(rpz, rpz_type, src_name);
+		result = add_cidr(build, rpz, rpz_type, src_name);
 		break;
 	case DNS_RPZ_TYPE_BAD:
 		break;
@@ -2184,7 +2835,7 @@ rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
  * Remove an IP address from the radix tree.
  */
 static void
-del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
+del_cidr(build_t *build, dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	 const dns_name_t *src_name) {
 	isc_result_t result;
 	dns_rpz_cidr_key_t tgt_ip;
@@ -2203,10 +2854,10 @@ del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		return;
 	}
 
-	RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
-	result = search(rpz->rpzs, &tgt_ip, tgt_prefix, &tgt_set, false, &tgt);
+	result = search(rpz->rpzs, &build->cidr, &tgt_ip, tgt_prefix, &tgt_set,
+			false, &tgt);
 	if (result != ISC_R_SUCCESS) {
-		goto done;
+		return;
 	}
 
 	/*
@@ -2220,7 +2871,7 @@ del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	tgt->set.nsip &= ~tgt_set.nsip;
 	set_sum_pair(tgt);
 
-	adj_trigger_cnt(rpz, rpz_type, &tgt_ip, tgt_prefix, false);
+	adj_trigger_cnt(build, rpz, rpz_type, &tgt_ip, tgt_prefix, false);
 
 	/*
 	 * We might need to delete 2 nodes.
@@ -2250,7 +2901,7 @@ del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		 */
 		parent = tgt->parent;
 		if (parent == NULL) {
-			rpz->rpzs->cidr = child;
+			build->cidr = child;
 		} else {
 			parent->child[parent->child[1] == tgt] = child;
 		}
@@ -2265,26 +2916,19 @@ del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 
 		tgt = parent;
 	} while (tgt != NULL);
-
-done:
-	RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
 }
 
 static void
-del_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
+del_name(build_t *build, dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	 const dns_name_t *src_name) {
 	isc_result_t result;
 	char namebuf[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t trig_namef;
 	dns_name_t *trig_name = NULL;
-	dns_rpz_zones_t *rpzs = rpz->rpzs;
 	nmdata_t *data = NULL;
-	nmdata_t del_data;
-	dns_qp_t *qp = NULL;
+	nmdata_t del_data, rest;
 	bool exists;
 
-	dns_qpmulti_write(rpzs->table, &qp);
-
 	/*
 	 * We need a summary database of names even with 1 policy zone,
 	 * because wildcard triggers are handled differently.
@@ -2293,7 +2937,7 @@ del_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	trig_name = dns_fixedname_initname(&trig_namef);
 	name2data(rpz, rpz_type, src_name, trig_name, &del_data);
 
-	result = dns_qp_getname(qp, trig_name, (void **)&data, NULL);
+	result = dns_qp_getname(build->qp, trig_name, (void **)&data, NULL);
 	if (result != ISC_R_SUCCESS) {
 		return;
 	}
@@ -2308,15 +2952,21 @@ del_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	exists = (del_data.set.qname != 0 || del_data.set.ns != 0 ||
 		  del_data.wild.qname != 0 || del_data.wild.ns != 0);
 
-	data->set.qname &= ~del_data.set.qname;
-	data->set.ns &= ~del_data.set.ns;
-	data->wild.qname &= ~del_data.wild.qname;
-	data->wild.ns &= ~del_data.wild.ns;
+	if (!exists) {
+		return;
+	}
+
+	rest.set.qname = data->set.qname & ~del_data.set.qname;
+	rest.set.ns = data->set.ns & ~del_data.set.ns;
+	rest.wild.qname = data->wild.qname & ~del_data.wild.qname;
+	rest.wild.ns = data->wild.ns & ~del_data.wild.ns;
 
-	if (data->set.qname == 0 && data->set.ns == 0 &&
-	    data->wild.qname == 0 && data->wild.ns == 0)
+	if (rest.set.qname != 0 || rest.set.ns != 0 || rest.wild.qname != 0 ||
+	    rest.wild.ns != 0)
 	{
-		result = dns_qp_deletename(qp, trig_name, NULL, NULL);
+		replace_nm(build, trig_name, &rest);
+	} else {
+		result = dns_qp_deletename(build->qp, trig_name, NULL, NULL);
 		if (result != ISC_R_SUCCESS) {
 			/*
 			 * bin/tests/system/rpz/tests.sh looks for
@@ -2331,21 +2981,14 @@ del_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		}
 	}
 
-	if (exists) {
-		RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
-		adj_trigger_cnt(rpz, rpz_type, NULL, 0, false);
-		RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
-	}
-
-	dns_qp_compact(qp, DNS_QPGC_MAYBE);
-	dns_qpmulti_commit(rpzs->table, &qp);
+	adj_trigger_cnt(build, rpz, rpz_type, NULL, 0, false);
 }
 
 /*
  * Remove an IP address from the radix tree or a name from the summary database.
  */
 static void
-rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
+rpz_del(build_t *build, dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	dns_rpz_type_t rpz_type;
 	dns_rpz_zones_t *rpzs = NULL;
 	dns_rpz_num_t rpz_num;
@@ -2361,12 +3004,12 @@ rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	switch (rpz_type) {
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_NSDNAME:
-		del_name(rpz, rpz_type, src_name);
+		del_name(build, rpz, rpz_type, src_name);
 		break;
 	case DNS_RPZ_TYPE_CLIENT_IP:
 	case DNS_RPZ_TYPE_IP:
 	case DNS_RPZ_TYPE_NSIP:
-		del_cidr(rpz, rpz_type, src_name);
+		del_cidr(build, rpz, rpz_type, src_name);
 		break;
 	case DNS_RPZ_TYPE_BAD:
 		break;
@@ -2455,7 +3098,8 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	make_addr_set(&tgt_set, zbits, rpz_type);
 
 	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
-	result = search(rpzs, &tgt_ip, 128, &tgt_set, false, &found);
+	result = search(rpzs, &rpzs->cidr, &tgt_ip, 128, &tgt_set, false,
+			&found);
 	if (result == ISC_R_NOTFOUND) {
 		/*
 		 * There are no eligible zones for this IP address.
@@ -2562,6 +3206,82 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	return (zbits & found_zbits);
 }
 
+bool
+dns_rpz_filter_name(dns_rpz_zones_t *rpzs, const dns_name_t *trig_name) {
+	const unsigned char *ndata = trig_name->ndata;
+	unsigned int length = trig_name->length;
+	dns_rpz_filter_t *filter = NULL;
+	bool found = true;
+
+	REQUIRE(DNS_RPZ_ZONES_VALID(rpzs));
+
+	rcu_read_lock();
+	filter = rcu_dereference(rpzs->filter);
+	if (filter == NULL) {
+		goto unlock;
+	}
+
+	/* The name, then each of its parents, down to the root */
+	found = false;
+	while (length > 0 && !found) {
+		unsigned int step = ndata[0] + 1;
+
+		found = filter_test(filter, isc_hash64(ndata, length, false));
+		ndata += step;
+		length -= step;
+	}
+
+unlock:
+	rcu_read_unlock();
+	return (found);
+}
+
+bool
+dns_rpz_filter_ip(dns_rpz_zones_t *rpzs, const isc_netaddr_t *netaddr) {
+	dns_rpz_cidr_key_t tgt_ip = { .w = { 0 } };
+	dns_rpz_filter_t *filter = NULL;
+	bool found = true;
+
+	REQUIRE(DNS_RPZ_ZONES_VALID(rpzs));
+
+	if (netaddr->family == AF_INET) {
+		tgt_ip.w[2] = ADDR_V4MAPPED;
+		tgt_ip.w[3] = ntohl(netaddr->type.in.s_addr);
+	} else if (netaddr->family == AF_INET6) {
+		dns_rpz_cidr_key_t src_ip6;
+
+		memmove(src_ip6.w, &netaddr->type.in6, sizeof(src_ip6.w));
+		for (int i = 0; i < DNS_RPZ_CIDR_WORDS; i++) {
+			tgt_ip.w[i] = ntohl(src_ip6.w[i]);
+		}
+	} else {
+		return (false);
+	}
+
+	rcu_read_lock();
+	filter = rcu_dereference(rpzs->filter);
+	if (filter == NULL) {
+		goto unlock;
+	}
+
+	found = false;
+	for (size_t i = 0; i < ARRAY_SIZE(filter->prefixes) && !found; i++) {
+		uint64_t prefixes = atomic_load_relaxed(&filter->prefixes[i]);
+
+		while (prefixes != 0 && !found) {
+			dns_rpz_prefix_t prefix = i * 64 +
+						  __builtin_ctzll(prefixes);
+			found = filter_test(filter,
+					    filter_hash_ip(&tgt_ip, prefix));
+			prefixes &= prefixes - 1;
+		}
+	}
+
+unlock:
+	rcu_read_unlock();
+	return (found);
+}
+
 /*
  * Translate CNAME rdata to a QNAME response policy action.
  */
@@ -53,19 +53,26 @@
 #include <string.h>
 
 #include <isc/ascii.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
+#include <dns/compress.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/dlz.h>
@@ -92,10 +99,56 @@ struct dns_sdlzimplementation {
 	dns_dlzimplementation_t *dlz_imp;
 };
 
+typedef struct sdlz_cacheent sdlz_cacheent_t;
+
+/*
+ * What dns_sdlzcreate() hands to the DLZ layer as 'dbdata': the driver's
+ * own 'dbdata', and the answer cache of the DLZ database.  The cache is
+ * only used when 'cachettl' is not zero.  At most 'maxasync' lookups
+ * run on worker threads to fill it; 'nasync' are running.
+ */
+typedef struct sdlz_data {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	void *dbdata;
+	atomic_uint_fast32_t maxasync;
+	atomic_uint_fast32_t nasync;
+
+	/* Locked by lock. */
+	isc_mutex_t lock;
+	dns_ttl_t cachettl;
+	isc_hashmap_t *cache;
+	ISC_LIST(sdlz_cacheent_t) entries;
+	unsigned int count;
+} sdlz_data_t;
+
+ISC_REFCOUNT_STATIC_DECL(sdlz_data);
+
+/*
+ * A cached driver answer.  The key is the kind of answer followed by
+ * the lowercase zone and name strings passed to the driver.  'node' is
+ * NULL for negative answers and for findzone() answers.
+ */
+struct sdlz_cacheent {
+	char *key;
+	size_t keylen;
+	uint32_t hashval;
+	isc_result_t result;
+	dns_sdlzlookup_t *node;
+	isc_stdtime_t expire;
+	ISC_LINK(sdlz_cacheent_t) link;
+};
+
+typedef struct sdlz_cachekey {
+	const char *key;
+	size_t keylen;
+} sdlz_cachekey_t;
+
 struct dns_sdlz_db {
 	/* Unlocked */
 	dns_db_t common;
 	void *dbdata;
+	sdlz_data_t *data;
 	dns_sdlzimplementation_t *dlzimp;
 
 	/* Locked */
@@ -156,6 +209,15 @@ typedef struct sdlz_rdatasetiter {
 /* This is a reasonable value */
 #define SDLZ_DEFAULT_TTL (60 * 60 * 24)
 
+/* The initial size of the answer cache, and its bound */
+#define SDLZ_CACHE_HASH_BITS 10
+#define SDLZ_CACHE_SIZE	     10000
+
+/* The kinds of cached answers */
+#define SDLZ_CACHE_FINDZONE	'z'
+#define SDLZ_CACHE_LOOKUP	'l'
+#define SDLZ_CACHE_LOOKUPNOWILD 'n'
+
 #ifdef __COVERITY__
 #define MAYBE_LOCK(imp)	  LOCK(&imp->driverlock)
 #define MAYBE_UNLOCK(imp) UNLOCK(&imp->driverlock)
@@ -190,6 +252,9 @@ list_tordataset(dns_rdatalist_t *rdatalist, dns_db_t *db, dns_dbnode_t *node,
 static void
 detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG);
 
+static void
+cache_flush(sdlz_data_t *data);
+
 static void
 dbiterator_destroy(dns_dbiterator_t **iteratorp DNS__DB_FLARG);
 static isc_result_t
@@ -306,6 +371,7 @@ destroy(dns_db_t *db) {
 	sdlz->common.impmagic = 0;
 
 	dns_name_free(&sdlz->common.origin, sdlz->common.mctx);
+	sdlz_data_detach(&sdlz->data);
 
 	isc_refcount_destroy(&sdlz->common.references);
 	isc_mem_putanddetach(&sdlz->common.mctx, sdlz, sizeof(dns_sdlz_db_t));
@@ -386,6 +452,11 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 			 origin);
 	}
 
+	/* The cached answers may be stale now. */
+	if (commit) {
+		cache_flush(sdlz->data);
+	}
+
 	sdlz->future_version = NULL;
 }
 
@@ -452,34 +523,209 @@ destroynode(dns_sdlznode_t *node) {
 	dns_db_detach(&db);
 }
 
-static isc_result_t
-getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
-	    unsigned int options, dns_clientinfomethods_t *methods,
-	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
-	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
-	dns_sdlznode_t *node = NULL;
+/*
+ * The answer cache.
+ */
+
+static bool
+cache_match(void *node, const void *key) {
+	const sdlz_cacheent_t *entry = node;
+	const sdlz_cachekey_t *ckey = key;
+
+	return (entry->keylen == ckey->keylen &&
+		memcmp(entry->key, ckey->key, ckey->keylen) == 0);
+}
+
+/*
+ * Build the cache key for the answer of 'kind' for 'zone' and 'name'
+ * into 'buf', which must have room for both strings and two bytes more.
+ */
+static void
+cache_key(char kind, const char *zone, const char *name, char *buf,
+	  sdlz_cachekey_t *ckey) {
+	size_t zlen = (zone != NULL) ? strlen(zone) + 1 : 0;
+	size_t nlen = strlen(name);
+
+	buf[0] = kind;
+	if (zone != NULL) {
+		memmove(buf + 1, zone, zlen);
+	}
+	memmove(buf + 1 + zlen, name, nlen);
+
+	*ckey = (sdlz_cachekey_t){ .key = buf, .keylen = 1 + zlen + nlen };
+}
+
+/*
+ * Requires the data lock.
+ */
+static void
+cache_remove(sdlz_data_t *data, sdlz_cacheent_t *entry) {
+	sdlz_cachekey_t ckey = { .key = entry->key, .keylen = entry->keylen };
 	isc_result_t result;
-	isc_buffer_t b;
-	char namestr[DNS_NAME_MAXTEXT + 1];
-	isc_buffer_t b2;
-	char zonestr[DNS_NAME_MAXTEXT + 1];
-	bool isorigin;
-	dns_sdlzauthorityfunc_t authority;
 
-	REQUIRE(VALID_SDLZDB(sdlz));
-	REQUIRE(nodep != NULL && *nodep == NULL);
+	result = isc_hashmap_delete(data->cache, entry->hashval, cache_match,
+				    &ckey);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(data->entries, entry, link);
+	data->count--;
 
-	if (sdlz->dlzimp->methods->newversion == NULL) {
-		REQUIRE(!create);
+	if (entry->node != NULL &&
+	    isc_refcount_decrement(&entry->node->references) == 1)
+	{
+		destroynode(entry->node);
 	}
+	isc_mem_put(data->mctx, entry->key, entry->keylen);
+	isc_mem_put(data->mctx, entry, sizeof(*entry));
+}
 
-	isc_buffer_init(&b, namestr, sizeof(namestr));
-	if ((sdlz->dlzimp->flags & DNS_SDLZFLAG_RELATIVEOWNER) != 0) {
+static void
+cache_flush(sdlz_data_t *data) {
+	sdlz_cacheent_t *entry = NULL;
+
+	LOCK(&data->lock);
+	while ((entry = ISC_LIST_HEAD(data->entries)) != NULL) {
+		cache_remove(data, entry);
+	}
+	UNLOCK(&data->lock);
+}
+
+/*
+ * Look up the answer for 'ckey'.  Return false if there is none, or
+ * the result the driver gave and, for positive lookup answers if
+ * 'nodep' is not NULL, a new reference to the node in '*nodep'.
+ */
+static bool
+cache_get(sdlz_data_t *data, const sdlz_cachekey_t *ckey,
+	  isc_result_t *resultp, dns_sdlznode_t **nodep) {
+	sdlz_cacheent_t *entry = NULL;
+	uint32_t hashval = isc_hash32(ckey->key, ckey->keylen, true);
+	bool found = false;
+	isc_result_t result;
+
+	LOCK(&data->lock);
+	if (data->cachettl == 0) {
+		goto unlock;
+	}
+
+	result = isc_hashmap_find(data->cache, hashval, cache_match, ckey,
+				  (void **)&entry);
+	if (result != ISC_R_SUCCESS) {
+		goto unlock;
+	}
+
+	if (entry->expire <= isc_stdtime_now()) {
+		cache_remove(data, entry);
+		goto unlock;
+	}
+
+	/* Keep the most recently used answers at the tail. */
+	ISC_LIST_UNLINK(data->entries, entry, link);
+	ISC_LIST_APPEND(data->entries, entry, link);
+
+	*resultp = entry->result;
+	if (entry->node != NULL && nodep != NULL) {
+		isc_refcount_increment(&entry->node->references);
+		*nodep = entry->node;
+	}
+	found = true;
+
+unlock:
+	UNLOCK(&data->lock);
+	return (found);
+}
+
+/*
+ * Cache the driver's answer for 'ckey', keeping a reference to 'node'
+ * if it is not NULL.  The answer is kept for the cache TTL, or for the
+ * lowest TTL of the records in 'node' if that is lower.
+ */
+static void
+cache_put(sdlz_data_t *data, const sdlz_cachekey_t *ckey,
+	  isc_result_t result, dns_sdlznode_t *node) {
+	sdlz_cacheent_t *entry = NULL;
+	dns_rdatalist_t *list = NULL;
+	dns_ttl_t ttl;
+
+	LOCK(&data->lock);
+	ttl = data->cachettl;
+	if (ttl == 0) {
+		goto unlock;
+	}
+
+	if (node != NULL) {
+		ISC_LIST_FOREACH (node->lists, list, link) {
+			ttl = ISC_MIN(ttl, list->ttl);
+		}
+		if (ttl == 0) {
+			goto unlock;
+		}
+	}
+
+	while (data->count >= SDLZ_CACHE_SIZE) {
+		cache_remove(data, ISC_LIST_HEAD(data->entries));
+	}
+
+	entry = isc_mem_get(data->mctx, sizeof(*entry));
+	*entry = (sdlz_cacheent_t){
+		.keylen = ckey->keylen,
+		.hashval = isc_hash32(ckey->key, ckey->keylen, true),
+		.result = result,
+		.expire = isc_stdtime_now() + ttl,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	entry->key = isc_mem_get(data->mctx, entry->keylen);
+	memmove(entry->key, ckey->key, entry->keylen);
+
+	result = isc_hashmap_add(data->cache, entry->hashval, cache_match,
+				 ckey, entry, NULL);
+	if (result != ISC_R_SUCCESS) {
+		/* Another thread cached the same answer first. */
+		isc_mem_put(data->mctx, entry->key, entry->keylen);
+		isc_mem_put(data->mctx, entry, sizeof(*entry));
+		goto unlock;
+	}
+
+	if (node != NULL) {
+		isc_refcount_increment(&node->references);
+		entry->node = node;
+	}
+	ISC_LIST_APPEND(data->entries, entry, link);
+	data->count++;
+
+unlock:
+	UNLOCK(&data->lock);
+}
+
+static void
+sdlz_data_destroy(sdlz_data_t *data) {
+	INSIST(ISC_LIST_EMPTY(data->entries));
+
+	isc_hashmap_destroy(&data->cache);
+	isc_mutex_destroy(&data->lock);
+	isc_mem_putanddetach(&data->mctx, data, sizeof(*data));
+}
+
+ISC_REFCOUNT_STATIC_IMPL(sdlz_data, sdlz_data_destroy);
+
+/*
+ * Format the zone and name strings the driver is given to look up
+ * 'name' in the zone 'origin'.  Both buffers must have room for
+ * DNS_NAME_MAXTEXT + 1 characters.
+ */
+static isc_result_t
+lookup_strings(dns_sdlzimplementation_t *imp, const dns_name_t *origin,
+	       const dns_name_t *name, char *zonestr, char *namestr) {
+	isc_result_t result;
+	isc_buffer_t b;
+	isc_buffer_t b2;
+
+	isc_buffer_init(&b, namestr, DNS_NAME_MAXTEXT + 1);
+	if ((imp->flags & DNS_SDLZFLAG_RELATIVEOWNER) != 0) {
 		dns_name_t relname;
 		unsigned int labels;
 
 		labels = dns_name_countlabels(name) -
-			 dns_name_countlabels(&sdlz->common.origin);
+			 dns_name_countlabels(origin);
 		dns_name_init(&relname, NULL);
 		dns_name_getlabelsequence(name, 0, labels, &relname);
 		result = dns_name_totext(&relname, DNS_NAME_OMITFINALDOT, &b);
@@ -494,14 +740,63 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	}
 	isc_buffer_putuint8(&b, 0);
 
-	isc_buffer_init(&b2, zonestr, sizeof(zonestr));
-	result = dns_name_totext(&sdlz->common.origin, DNS_NAME_OMITFINALDOT,
-				 &b2);
+	isc_buffer_init(&b2, zonestr, DNS_NAME_MAXTEXT + 1);
+	result = dns_name_totext(origin, DNS_NAME_OMITFINALDOT, &b2);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
 	isc_buffer_putuint8(&b2, 0);
 
+	/* make sure strings are always lowercase */
+	isc_ascii_strtolower(zonestr);
+	isc_ascii_strtolower(namestr);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
+	    unsigned int options, dns_clientinfomethods_t *methods,
+	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	dns_sdlznode_t *node = NULL;
+	isc_result_t result;
+	isc_buffer_t b;
+	char namestr[DNS_NAME_MAXTEXT + 1];
+	char zonestr[DNS_NAME_MAXTEXT + 1];
+	char keybuf[2 * (DNS_NAME_MAXTEXT + 1) + 2];
+	sdlz_cachekey_t ckey = { 0 };
+	bool isorigin;
+	dns_sdlzauthorityfunc_t authority;
+
+	REQUIRE(VALID_SDLZDB(sdlz));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	if (sdlz->dlzimp->methods->newversion == NULL) {
+		REQUIRE(!create);
+	}
+
+	result = lookup_strings(sdlz->dlzimp, &sdlz->common.origin, name,
+				zonestr, namestr);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * Answers to lookups that don't create the node may be cached;
+	 * whether wildcards are searched is part of the question.
+	 */
+	if (!create) {
+		cache_key(((options & DNS_DBFIND_NOWILD) != 0)
+				  ? SDLZ_CACHE_LOOKUPNOWILD
+				  : SDLZ_CACHE_LOOKUP,
+			  zonestr, namestr, keybuf, &ckey);
+		if (cache_get(sdlz->data, &ckey, &result, &node)) {
+			*nodep = node;
+			return (result);
+		}
+	}
+
 	result = createnode(sdlz, &node);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
@@ -509,10 +804,6 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 
 	isorigin = dns_name_equal(name, &sdlz->common.origin);
 
-	/* make sure strings are always lowercase */
-	isc_ascii_strtolower(zonestr);
-	isc_ascii_strtolower(namestr);
-
 	MAYBE_LOCK(sdlz->dlzimp);
 
 	/* try to lookup the host (namestr) */
@@ -584,6 +875,9 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	if (result != ISC_R_SUCCESS) {
 		isc_refcount_decrementz(&node->references);
 		destroynode(node);
+		if (result == ISC_R_NOTFOUND && !create) {
+			cache_put(sdlz->data, &ckey, result, NULL);
+		}
 		return (result);
 	}
 
@@ -606,6 +900,10 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 		dns_name_dup(name, sdlz->common.mctx, node->name);
 	}
 
+	if (!create) {
+		cache_put(sdlz->data, &ckey, ISC_R_SUCCESS, node);
+	}
+
 	*nodep = node;
 	return (ISC_R_SUCCESS);
 }
@@ -1353,7 +1651,7 @@ list_tordataset(dns_rdatalist_t *rdatalist, dns_db_t *db, dns_dbnode_t *node,
  */
 
 static isc_result_t
-dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
+dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, sdlz_data_t *data,
 		  const dns_name_t *name, dns_rdataclass_t rdclass,
 		  dns_db_t **dbp) {
 	dns_sdlz_db_t *sdlzdb;
@@ -1372,8 +1670,9 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 		.dlzimp = imp,
 		.common = { .methods = &sdlzdb_methods,
 			.rdclass = rdclass, },
-			.dbdata = dbdata,
+			.dbdata = data->dbdata,
 	};
+	sdlz_data_attach(data, &sdlzdb->data);
 
 	/* initialize and set origin */
 	dns_name_init(&sdlzdb->common.origin, NULL);
@@ -1405,6 +1704,7 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	isc_netaddr_t netaddr;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1442,15 +1742,16 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 		isc_result_t rresult = ISC_R_SUCCESS;
 
 		MAYBE_LOCK(imp);
-		result = imp->methods->allowzonexfr(imp->driverarg, dbdata,
-						    namestr, clientstr);
+		result = imp->methods->allowzonexfr(imp->driverarg,
+						    data->dbdata, namestr,
+						    clientstr);
 		MAYBE_UNLOCK(imp);
 		/*
 		 * if zone is supported and transfers are (or might be)
 		 * allowed, build a 'bind' database driver
 		 */
 		if (result == ISC_R_SUCCESS || result == ISC_R_DEFAULT) {
-			rresult = dns_sdlzcreateDBP(mctx, driverarg, dbdata,
+			rresult = dns_sdlzcreateDBP(mctx, driverarg, data,
 						    name, rdclass, dbp);
 		}
 		if (rresult != ISC_R_SUCCESS) {
@@ -1466,6 +1767,7 @@ static isc_result_t
 dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	       char *argv[], void *driverarg, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = NULL;
 	isc_result_t result = ISC_R_NOTFOUND;
 
 	/* Write debugging message to log */
@@ -1477,15 +1779,19 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	REQUIRE(driverarg != NULL);
 	REQUIRE(dlzname != NULL);
 	REQUIRE(dbdata != NULL);
-	UNUSED(mctx);
 
 	imp = driverarg;
 
+	data = isc_mem_get(mctx, sizeof(*data));
+	*data = (sdlz_data_t){
+		.entries = ISC_LIST_INITIALIZER,
+	};
+
 	/* If the create method exists, call it. */
 	if (imp->methods->create != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->create(dlzname, argc, argv,
-					      imp->driverarg, dbdata);
+					      imp->driverarg, &data->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
 
@@ -1494,26 +1800,43 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 		sdlz_log(ISC_LOG_DEBUG(2), "SDLZ driver loaded successfully.");
 	} else {
 		sdlz_log(ISC_LOG_ERROR, "SDLZ driver failed to load.");
+		isc_mem_put(mctx, data, sizeof(*data));
+		return (result);
 	}
 
-	return (result);
+	isc_mem_attach(mctx, &data->mctx);
+	isc_refcount_init(&data->references, 1);
+	isc_mutex_init(&data->lock);
+	isc_hashmap_create(data->mctx, SDLZ_CACHE_HASH_BITS, &data->cache);
+
+	*dbdata = data;
+	return (ISC_R_SUCCESS);
 }
 
 static void
 dns_sdlzdestroy(void *driverdata, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = (sdlz_data_t *)dbdata;
 
 	/* Write debugging message to log */
 	sdlz_log(ISC_LOG_DEBUG(2), "Unloading SDLZ driver.");
 
 	imp = driverdata;
 
+	/*
+	 * The cached nodes hold references to databases, which hold
+	 * references to 'data'.
+	 */
+	cache_flush(data);
+
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
-		imp->methods->destroy(imp->driverarg, dbdata);
+		imp->methods->destroy(imp->driverarg, data->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
+
+	sdlz_data_detach(&data);
 }
 
 static isc_result_t
@@ -1523,8 +1846,11 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 		 dns_db_t **dbp) {
 	isc_buffer_t b;
 	char namestr[DNS_NAME_MAXTEXT + 1];
+	char keybuf[DNS_NAME_MAXTEXT + 2];
+	sdlz_cachekey_t ckey;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = dbdata;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1546,18 +1872,25 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	/* make sure strings are always lowercase */
 	isc_ascii_strtolower(namestr);
 
-	/* Call SDLZ driver's find zone method */
-	MAYBE_LOCK(imp);
-	result = imp->methods->findzone(imp->driverarg, dbdata, namestr,
-					methods, clientinfo);
-	MAYBE_UNLOCK(imp);
+	/* Call SDLZ driver's find zone method, unless it already told us */
+	cache_key(SDLZ_CACHE_FINDZONE, NULL, namestr, keybuf, &ckey);
+	if (!cache_get(data, &ckey, &result, NULL)) {
+		MAYBE_LOCK(imp);
+		result = imp->methods->findzone(imp->driverarg, data->dbdata,
+						namestr, methods, clientinfo);
+		MAYBE_UNLOCK(imp);
+
+		if (result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND) {
+			cache_put(data, &ckey, result, NULL);
+		}
+	}
 
 	/*
 	 * if zone is supported build a 'bind' database driver
 	 * structure to return
 	 */
 	if (result == ISC_R_SUCCESS) {
-		result = dns_sdlzcreateDBP(mctx, driverarg, dbdata, name,
+		result = dns_sdlzcreateDBP(mctx, driverarg, data, name,
 					   rdclass, dbp);
 	}
 
@@ -1569,6 +1902,7 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view,
 		  dns_dlzdb_t *dlzdb) {
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = dbdata;
 
 	REQUIRE(driverarg != NULL);
 
@@ -1578,7 +1912,7 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view,
 	if (imp->methods->configure != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->configure(view, dlzdb, imp->driverarg,
-						 dbdata);
+						 data->dbdata);
 		MAYBE_UNLOCK(imp);
 	} else {
 		result = ISC_R_SUCCESS;
@@ -1592,6 +1926,7 @@ dns_sdlzssumatch(const dns_name_t *signer, const dns_name_t *name,
 		 const isc_netaddr_t *tcpaddr, dns_rdatatype_t type,
 		 const dst_key_t *key, void *driverarg, void *dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data = dbdata;
 	char b_signer[DNS_NAME_FORMATSIZE];
 	char b_name[DNS_NAME_FORMATSIZE];
 	char b_addr[ISC_NETADDR_FORMATSIZE];
@@ -1645,7 +1980,7 @@ dns_sdlzssumatch(const dns_name_t *signer, const dns_name_t *name,
 	ret = imp->methods->ssumatch(b_signer, b_name, b_addr, b_type, b_key,
 				     token_len,
 				     token_len != 0 ? token_region.base : NULL,
-				     imp->driverarg, dbdata);
+				     imp->driverarg, data->dbdata);
 	MAYBE_UNLOCK(imp);
 	return (ret);
 }
@@ -1654,6 +1989,45 @@ static dns_dlzmethods_t sdlzmethods = { dns_sdlzcreate,	   dns_sdlzdestroy,
 					dns_sdlzfindzone,  dns_sdlzallowzonexfr,
 					dns_sdlzconfigure, dns_sdlzssumatch };
 
+/*
+ * Return the rdatalist of 'type' in 'lookup', creating it if needed,
+ * with its TTL lowered to 'ttl'.
+ */
+static dns_rdatalist_t *
+lookup_rdatalist(dns_sdlzlookup_t *lookup, dns_rdatatype_t type,
+		 dns_ttl_t ttl) {
+	dns_rdatalist_t *rdatalist;
+
+	rdatalist = ISC_LIST_HEAD(lookup->lists);
+	while (rdatalist != NULL) {
+		if (rdatalist->type == type) {
+			break;
+		}
+		rdatalist = ISC_LIST_NEXT(rdatalist, link);
+	}
+
+	if (rdatalist == NULL) {
+		rdatalist = isc_mem_get(lookup->sdlz->common.mctx,
+					sizeof(dns_rdatalist_t));
+		dns_rdatalist_init(rdatalist);
+		rdatalist->rdclass = lookup->sdlz->common.rdclass;
+		rdatalist->type = type;
+		rdatalist->ttl = ttl;
+		ISC_LIST_APPEND(lookup->lists, rdatalist, link);
+	} else if (rdatalist->ttl > ttl) {
+		/*
+		 * BIND9 doesn't enforce all RRs in an RRset
+		 * having the same TTL, as per RFC 2136,
+		 * section 7.12. If a DLZ backend has
+		 * different TTLs, then the best
+		 * we can do is return the lowest.
+		 */
+		rdatalist->ttl = ttl;
+	}
+
+	return (rdatalist);
+}
+
 /*
  * Public functions.
  */
@@ -1686,31 +2060,7 @@ dns_sdlz_putrr(dns_sdlzlookup_t *lookup, const char *type, dns_ttl_t ttl,
 		return (result);
 	}
 
-	rdatalist = ISC_LIST_HEAD(lookup->lists);
-	while (rdatalist != NULL) {
-		if (rdatalist->type == typeval) {
-			break;
-		}
-		rdatalist = ISC_LIST_NEXT(rdatalist, link);
-	}
-
-	if (rdatalist == NULL) {
-		rdatalist = isc_mem_get(mctx, sizeof(dns_rdatalist_t));
-		dns_rdatalist_init(rdatalist);
-		rdatalist->rdclass = lookup->sdlz->common.rdclass;
-		rdatalist->type = typeval;
-		rdatalist->ttl = ttl;
-		ISC_LIST_APPEND(lookup->lists, rdatalist, link);
-	} else if (rdatalist->ttl > ttl) {
-		/*
-		 * BIND9 doesn't enforce all RRs in an RRset
-		 * having the same TTL, as per RFC 2136,
-		 * section 7.12. If a DLZ backend has
-		 * different TTLs, then the best
-		 * we can do is return the lowest.
-		 */
-		rdatalist->ttl = ttl;
-	}
+	rdatalist = lookup_rdatalist(lookup, typeval, ttl);
 
 	rdata = isc_mem_get(mctx, sizeof(dns_rdata_t));
 	dns_rdata_init(rdata);
@@ -1778,6 +2128,50 @@ failure:
 	return (result);
 }
 
+isc_result_t
+dns_sdlz_putrdata(dns_sdlzlookup_t *lookup, dns_rdatatype_t type,
+		  dns_ttl_t ttl, const unsigned char *data,
+		  unsigned int length) {
+	dns_rdatalist_t *rdatalist;
+	dns_rdata_t *rdata;
+	isc_buffer_t source;
+	isc_buffer_t *rdatabuf = NULL;
+	isc_result_t result;
+	isc_mem_t *mctx;
+
+	REQUIRE(VALID_SDLZLOOKUP(lookup));
+	REQUIRE(data != NULL || length == 0);
+
+	mctx = lookup->sdlz->common.mctx;
+
+	/*
+	 * The rdata must not be compressed, so its wire format is
+	 * exactly as long as the input.
+	 */
+	isc_buffer_constinit(&source, data, length);
+	isc_buffer_add(&source, length);
+	isc_buffer_setactive(&source, length);
+	isc_buffer_allocate(mctx, &rdatabuf, length);
+
+	rdata = isc_mem_get(mctx, sizeof(dns_rdata_t));
+	dns_rdata_init(rdata);
+
+	result = dns_rdata_fromwire(rdata, lookup->sdlz->common.rdclass, type,
+				    &source, DNS_DECOMPRESS_NEVER, rdatabuf);
+	if (result != ISC_R_SUCCESS || isc_buffer_remaininglength(&source) != 0)
+	{
+		isc_buffer_free(&rdatabuf);
+		isc_mem_put(mctx, rdata, sizeof(dns_rdata_t));
+		return (DNS_R_SERVFAIL);
+	}
+
+	rdatalist = lookup_rdatalist(lookup, type, ttl);
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	ISC_LIST_APPEND(lookup->buffers, rdatabuf, link);
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_sdlz_putnamedrr(dns_sdlzallnodes_t *allnodes, const char *name,
 		    const char *type, dns_ttl_t ttl, const char *data) {
@@ -1962,3 +2356,207 @@ dns_sdlz_setdb(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
 				   dlzdatabase->dbdata, name, rdclass, dbp);
 	return (result);
 }
+
+isc_result_t
+dns_sdlz_setcachettl(dns_dlzdb_t *dlzdatabase, dns_ttl_t ttl) {
+	sdlz_data_t *data = NULL;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	data = dlzdatabase->dbdata;
+
+	LOCK(&data->lock);
+	data->cachettl = ttl;
+	UNLOCK(&data->lock);
+
+	if (ttl == 0) {
+		cache_flush(data);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_sdlz_setasync(dns_dlzdb_t *dlzdatabase, unsigned int max) {
+	sdlz_data_t *data = NULL;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	data = dlzdatabase->dbdata;
+	atomic_store_relaxed(&data->maxasync, max);
+
+	return (ISC_R_SUCCESS);
+}
+
+bool
+dns_sdlz_needprefetch(dns_dlzdb_t *dlzdatabase, const dns_name_t *name) {
+	dns_sdlzimplementation_t *imp = NULL;
+	sdlz_data_t *data = NULL;
+	dns_fixedname_t fzone;
+	dns_name_t *zonename = NULL;
+	unsigned int namelabels;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+	REQUIRE(name != NULL);
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods) {
+		return (false);
+	}
+
+	imp = dlzdatabase->implementation->driverarg;
+	data = dlzdatabase->dbdata;
+	if (atomic_load_relaxed(&data->maxasync) == 0) {
+		return (false);
+	}
+
+	zonename = dns_fixedname_initname(&fzone);
+	namelabels = dns_name_countlabels(name);
+
+	/*
+	 * Walk down the zone names like dns_view_searchdlz() does, and
+	 * stop at the first answer that isn't cached.
+	 */
+	for (unsigned int i = namelabels; i > 1; i--) {
+		char zonestr[DNS_NAME_MAXTEXT + 1];
+		char namestr[DNS_NAME_MAXTEXT + 1];
+		char keybuf[2 * (DNS_NAME_MAXTEXT + 1) + 2];
+		sdlz_cachekey_t ckey;
+		isc_result_t result;
+
+		dns_name_split(name, i, NULL, zonename);
+		result = lookup_strings(imp, zonename, name, zonestr, namestr);
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+
+		cache_key(SDLZ_CACHE_FINDZONE, NULL, zonestr, keybuf, &ckey);
+		if (!cache_get(data, &ckey, &result, NULL)) {
+			return (true);
+		}
+		if (result == ISC_R_NOTFOUND) {
+			continue;
+		}
+
+		cache_key(SDLZ_CACHE_LOOKUP, zonestr, namestr, keybuf, &ckey);
+		return (!cache_get(data, &ckey, &result, NULL));
+	}
+
+	return (false);
+}
+
+typedef struct sdlz_prefetch {
+	isc_mem_t *mctx;
+	dns_sdlzimplementation_t *imp;
+	sdlz_data_t *data;
+	dns_rdataclass_t rdclass;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_job_cb cb;
+	void *cbarg;
+} sdlz_prefetch_t;
+
+/*
+ * Run on a worker thread: ask the driver what the query for 'name'
+ * will ask it, so that the answers are in the cache.
+ */
+static void
+prefetch_work(void *arg) {
+	sdlz_prefetch_t *pf = arg;
+	dns_fixedname_t fzone, fxname;
+	dns_name_t *zonename = dns_fixedname_initname(&fzone);
+	dns_name_t *xname = dns_fixedname_initname(&fxname);
+	unsigned int nlabels = dns_name_countlabels(pf->name);
+	unsigned int olabels;
+	dns_db_t *db = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	for (unsigned int i = nlabels; i > 1; i--) {
+		dns_name_split(pf->name, i, NULL, zonename);
+		result = dns_sdlzfindzone(pf->imp, pf->data, pf->mctx,
+					  pf->rdclass, zonename, NULL, NULL,
+					  &db);
+		if (result != ISC_R_NOTFOUND) {
+			break;
+		}
+	}
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/* The nodes findext() looks at, from the origin down. */
+	olabels = dns_name_countlabels(zonename);
+	for (unsigned int i = olabels; i <= nlabels; i++) {
+		dns_dbnode_t *node = NULL;
+
+		dns_name_getlabelsequence(pf->name, nlabels - i, i, xname);
+		result = getnodedata(db, xname, false, 0, NULL, NULL, &node);
+		if (result == ISC_R_SUCCESS) {
+			dns_db_detachnode(db, &node);
+		} else if (result != ISC_R_NOTFOUND) {
+			break;
+		}
+	}
+
+	dns_db_detach(&db);
+}
+
+static void
+prefetch_done(void *arg) {
+	sdlz_prefetch_t *pf = arg;
+	isc_job_cb cb = pf->cb;
+	void *cbarg = pf->cbarg;
+
+	(void)atomic_fetch_sub_relaxed(&pf->data->nasync, 1);
+	sdlz_data_detach(&pf->data);
+	isc_mem_putanddetach(&pf->mctx, pf, sizeof(*pf));
+
+	cb(cbarg);
+}
+
+isc_result_t
+dns_sdlz_prefetch(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
+		  const dns_name_t *name, isc_loop_t *loop, isc_job_cb cb,
+		  void *cbarg) {
+	sdlz_data_t *data = NULL;
+	sdlz_prefetch_t *pf = NULL;
+	uint_fast32_t max;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+	REQUIRE(name != NULL);
+	REQUIRE(loop != NULL && cb != NULL);
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	data = dlzdatabase->dbdata;
+	max = atomic_load_relaxed(&data->maxasync);
+	if (atomic_fetch_add_relaxed(&data->nasync, 1) >= max) {
+		(void)atomic_fetch_sub_relaxed(&data->nasync, 1);
+		return (ISC_R_QUOTA);
+	}
+
+	pf = isc_mem_get(dlzdatabase->mctx, sizeof(*pf));
+	*pf = (sdlz_prefetch_t){
+		.imp = dlzdatabase->implementation->driverarg,
+		.rdclass = rdclass,
+		.cb = cb,
+		.cbarg = cbarg,
+	};
+	isc_mem_attach(dlzdatabase->mctx, &pf->mctx);
+	sdlz_data_attach(data, &pf->data);
+	pf->name = dns_fixedname_initname(&pf->fname);
+	dns_name_copy(name, pf->name);
+
+	isc_work_enqueue(loop, prefetch_work, prefetch_done, pf);
+
+	return (ISC_R_SUCCESS);
+}
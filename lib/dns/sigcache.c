@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/hashmap.h>
+#include <isc/magic.h>
+#include <isc/md.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/stdio.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#define SIGCACHE_MAGIC	   ISC_MAGIC('S', 'i', 'g', 'C')
+#define VALID_SIGCACHE(m) ISC_MAGIC_VALID(m, SIGCACHE_MAGIC)
+
+#define CHECK(op)                            \
+	do {                                 \
+		result = (op);               \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
+/*
+ * The length of a SHA-256 digest.
+ */
+#define DIGESTLEN 32
+
+/*
+ * The cache file starts with this header, and then has one record per
+ * signature: the digest, the length of the RRSIG rdata in two octets in
+ * network byte order, and the rdata.
+ */
+static const char fileheader[] = "BIND signature cache 1\n";
+
+typedef struct sigentry {
+	unsigned char digest[DIGESTLEN];
+	isc_stdtime_t inception;
+	isc_stdtime_t expire;
+	uint16_t length;
+	unsigned char rdata[];
+} sigentry_t;
+
+struct dns_sigcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+	isc_hashmap_t *entries; /* protected by 'lock' */
+	bool changed;		/* protected by 'lock' */
+};
+
+static bool
+entry_match(void *node, const void *key) {
+	const sigentry_t *entry = node;
+
+	return (memcmp(entry->digest, key, DIGESTLEN) == 0);
+}
+
+static uint32_t
+entry_hash(const unsigned char *digest) {
+	uint32_t hashval;
+
+	memmove(&hashval, digest, sizeof(hashval));
+	return (hashval);
+}
+
+static void
+entry_free(dns_sigcache_t *cache, sigentry_t *entry) {
+	isc_mem_put(cache->mctx, entry, sizeof(*entry) + entry->length);
+}
+
+static int
+rdata_compare_wrapper(const void *rdata1, const void *rdata2) {
+	return (dns_rdata_compare((const dns_rdata_t *)rdata1,
+				  (const dns_rdata_t *)rdata2));
+}
+
+static isc_result_t
+digest_callback(void *arg, isc_region_t *data) {
+	return (isc_md_update(arg, data->base, data->length));
+}
+
+/*
+ * Digest the owner name, the RRset in canonical form with its TTL, and
+ * the public key and name of 'key'.
+ */
+static isc_result_t
+sigdigest(isc_mem_t *mctx, const dns_name_t *name, dns_rdataset_t *rdataset,
+	  dst_key_t *key, unsigned char *digest) {
+	isc_result_t result;
+	isc_md_t *md = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	dns_rdataset_t clone;
+	dns_rdata_t *rdatas = NULL;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char header[8];
+	isc_buffer_t buffer;
+	isc_region_t r;
+	unsigned int count = 0, i = 0, digestlen;
+
+	md = isc_md_new();
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+
+	/*
+	 * The key.
+	 */
+	isc_buffer_init(&buffer, keydata, sizeof(keydata));
+	CHECK(dst_key_todns(key, &buffer));
+	isc_buffer_usedregion(&buffer, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+	dns_name_downcase(dst_key_name(key), lname, NULL);
+	dns_name_toregion(lname, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	/*
+	 * The owner name, type, class and TTL.
+	 */
+	dns_name_downcase(name, lname, NULL);
+	dns_name_toregion(lname, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+	isc_buffer_init(&buffer, header, sizeof(header));
+	isc_buffer_putuint16(&buffer, rdataset->type);
+	isc_buffer_putuint16(&buffer, rdataset->rdclass);
+	isc_buffer_putuint32(&buffer, rdataset->ttl);
+	CHECK(isc_md_update(md, header, sizeof(header)));
+
+	/*
+	 * The rdata, sorted and without duplicates, as they are signed.
+	 */
+	count = dns_rdataset_count(rdataset);
+	rdatas = isc_mem_cget(mctx, count, sizeof(rdatas[0]));
+	dns_rdataset_init(&clone);
+	dns_rdataset_clone(rdataset, &clone);
+	for (result = dns_rdataset_first(&clone);
+	     result == ISC_R_SUCCESS && i < count;
+	     result = dns_rdataset_next(&clone))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&clone, &rdatas[i++]);
+	}
+	dns_rdataset_disassociate(&clone);
+	qsort(rdatas, i, sizeof(rdatas[0]), rdata_compare_wrapper);
+
+	for (unsigned int j = 0; j < i; j++) {
+		if (j > 0 && dns_rdata_compare(&rdatas[j], &rdatas[j - 1]) == 0)
+		{
+			continue;
+		}
+		isc_buffer_init(&buffer, header, sizeof(header));
+		isc_buffer_putuint16(&buffer, rdatas[j].length);
+		CHECK(isc_md_update(md, header, 2));
+		CHECK(dns_rdata_digest(&rdatas[j], digest_callback, md));
+	}
+
+	CHECK(isc_md_final(md, digest, &digestlen));
+	INSIST(digestlen == DIGESTLEN);
+
+cleanup:
+	if (rdatas != NULL) {
+		isc_mem_cput(mctx, rdatas, count, sizeof(rdatas[0]));
+	}
+	isc_md_free(md);
+	return (result);
+}
+
+/*
+ * Make an entry for the RRSIG 'sigrdata'.
+ */
+static sigentry_t *
+entry_new(dns_sigcache_t *cache, const unsigned char *digest,
+	  const dns_rdata_t *sigrdata) {
+	dns_rdata_rrsig_t sig;
+	sigentry_t *entry = NULL;
+	isc_result_t result;
+
+	result = dns_rdata_tostruct(sigrdata, &sig, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry) + sigrdata->length);
+	*entry = (sigentry_t){
+		.inception = sig.timesigned,
+		.expire = sig.timeexpire,
+		.length = sigrdata->length,
+	};
+	memmove(entry->digest, digest, DIGESTLEN);
+	memmove(entry->rdata, sigrdata->data, sigrdata->length);
+
+	return (entry);
+}
+
+/*
+ * Add 'entry' to the cache, unless a signature for the same RRset and
+ * key that expires later is already there.
+ */
+static void
+entry_add(dns_sigcache_t *cache, sigentry_t *entry) {
+	sigentry_t *found = NULL;
+	isc_result_t result;
+	uint32_t hashval = entry_hash(entry->digest);
+
+	LOCK(&cache->lock);
+	result = isc_hashmap_add(cache->entries, hashval, entry_match,
+				 entry->digest, entry, (void **)&found);
+	if (result == ISC_R_EXISTS) {
+		if (found->expire < entry->expire) {
+			result = isc_hashmap_delete(cache->entries, hashval,
+						    entry_match, found->digest);
+			INSIST(result == ISC_R_SUCCESS);
+			entry_free(cache, found);
+			result = isc_hashmap_add(cache->entries, hashval,
+						 entry_match, entry->digest,
+						 entry, NULL);
+			INSIST(result == ISC_R_SUCCESS);
+		} else {
+			entry_free(cache, entry);
+		}
+	}
+	if (result == ISC_R_SUCCESS) {
+		cache->changed = true;
+	}
+	UNLOCK(&cache->lock);
+}
+
+void
+dns_sigcache_create(isc_mem_t *mctx, dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_sigcache_t){
+		.magic = SIGCACHE_MAGIC,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_mutex_init(&cache->lock);
+	isc_hashmap_create(mctx, ISC_HASH_MIN_BITS, &cache->entries);
+
+	*cachep = cache;
+}
+
+void
+dns_sigcache_destroy(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache = NULL;
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(cachep != NULL && VALID_SIGCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+	cache->magic = 0;
+
+	isc_hashmap_iter_create(cache->entries, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(it))
+	{
+		sigentry_t *entry = NULL;
+		isc_hashmap_iter_current(it, (void **)&entry);
+		entry_free(cache, entry);
+	}
+	isc_hashmap_iter_destroy(&it);
+	isc_hashmap_destroy(&cache->entries);
+	isc_mutex_destroy(&cache->lock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_name_t *name,
+		  dns_rdataset_t *rdataset, dst_key_t *key, isc_stdtime_t now,
+		  isc_stdtime_t minexpire, isc_buffer_t *buffer,
+		  dns_rdata_t *sigrdata) {
+	unsigned char digest[DIGESTLEN];
+	sigentry_t *entry = NULL;
+	isc_region_t r;
+	isc_result_t result;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(dns_rdataset_isassociated(rdataset));
+	REQUIRE(sigrdata != NULL && DNS_RDATA_INITIALIZED(sigrdata));
+
+	result = sigdigest(cache->mctx, name, rdataset, key, digest);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	LOCK(&cache->lock);
+	result = isc_hashmap_find(cache->entries, entry_hash(digest),
+				  entry_match, digest, (void **)&entry);
+	if (result != ISC_R_SUCCESS || entry->inception > now ||
+	    entry->expire < minexpire)
+	{
+		result = ISC_R_NOTFOUND;
+	} else if (isc_buffer_availablelength(buffer) < entry->length) {
+		result = ISC_R_NOSPACE;
+	} else {
+		isc_buffer_availableregion(buffer, &r);
+		memmove(r.base, entry->rdata, entry->length);
+		r.length = entry->length;
+		isc_buffer_add(buffer, entry->length);
+		dns_rdata_fromregion(sigrdata, rdataset->rdclass,
+				     dns_rdatatype_rrsig, &r);
+	}
+	UNLOCK(&cache->lock);
+
+	return (result);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const dns_name_t *name,
+		 dns_rdataset_t *rdataset, dst_key_t *key,
+		 const dns_rdata_t *sigrdata) {
+	unsigned char digest[DIGESTLEN];
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(dns_rdataset_isassociated(rdataset));
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+
+	if (sigdigest(cache->mctx, name, rdataset, key, digest) !=
+	    ISC_R_SUCCESS)
+	{
+		return;
+	}
+
+	entry_add(cache, entry_new(cache, digest, sigrdata));
+}
+
+isc_result_t
+dns_sigcache_load(dns_sigcache_t *cache, const char *filename) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	char header[sizeof(fileheader) - 1];
+	unsigned char *data = NULL;
+	bool changed;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(filename != NULL);
+
+	CHECK(isc_stdio_open(filename, "r", &fp));
+
+	result = isc_stdio_read(header, sizeof(header), 1, fp, NULL);
+	if (result == ISC_R_EOF ||
+	    (result == ISC_R_SUCCESS &&
+	     memcmp(header, fileheader, sizeof(header)) != 0))
+	{
+		result = DNS_R_FORMERR;
+	}
+	CHECK(result);
+
+	LOCK(&cache->lock);
+	changed = cache->changed;
+	UNLOCK(&cache->lock);
+
+	data = isc_mem_get(cache->mctx, DIGESTLEN + 2 + UINT16_MAX);
+	for (;;) {
+		dns_rdata_t sigrdata = DNS_RDATA_INIT;
+		unsigned char *rdata = data + DIGESTLEN + 2;
+		unsigned char check[UINT16_MAX];
+		isc_buffer_t source, target;
+		unsigned int length;
+
+		result = isc_stdio_read(data, DIGESTLEN + 2, 1, fp, NULL);
+		if (result == ISC_R_EOF) {
+			result = ISC_R_SUCCESS;
+			break;
+		}
+		CHECK(result);
+
+		length = (data[DIGESTLEN] << 8) | data[DIGESTLEN + 1];
+		result = isc_stdio_read(rdata, length, 1, fp, NULL);
+		if (result == ISC_R_EOF) {
+			result = DNS_R_FORMERR;
+		}
+		CHECK(result);
+
+		/*
+		 * Make sure that the rdata is a well-formed RRSIG.
+		 */
+		isc_buffer_init(&source, rdata, length);
+		isc_buffer_add(&source, length);
+		isc_buffer_setactive(&source, length);
+		isc_buffer_init(&target, check, sizeof(check));
+		result = dns_rdata_fromwire(&sigrdata, dns_rdataclass_in,
+					    dns_rdatatype_rrsig, &source,
+					    DNS_DECOMPRESS_NEVER, &target);
+		if (result != ISC_R_SUCCESS ||
+		    isc_buffer_remaininglength(&source) != 0)
+		{
+			CHECK(DNS_R_FORMERR);
+		}
+
+		entry_add(cache, entry_new(cache, data, &sigrdata));
+	}
+
+	/*
+	 * Loading alone does not make the file out of date.
+	 */
+	LOCK(&cache->lock);
+	cache->changed = changed;
+	UNLOCK(&cache->lock);
+
+cleanup:
+	if (data != NULL) {
+		isc_mem_put(cache->mctx, data, DIGESTLEN + 2 + UINT16_MAX);
+	}
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	return (result);
+}
+
+isc_result_t
+dns_sigcache_save(dns_sigcache_t *cache, const char *filename,
+		  isc_stdtime_t now) {
+	isc_result_t result;
+	isc_hashmap_iter_t *it = NULL;
+	char template[PATH_MAX] = { 0 };
+	FILE *fp = NULL;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(filename != NULL);
+
+	LOCK(&cache->lock);
+	if (!cache->changed) {
+		UNLOCK(&cache->lock);
+		return (ISC_R_SUCCESS);
+	}
+
+	CHECK(isc_file_mktemplate(filename, template, sizeof(template)));
+	CHECK(isc_file_openunique(template, &fp));
+	CHECK(isc_stdio_write(fileheader, sizeof(fileheader) - 1, 1, fp,
+			      NULL));
+
+	isc_hashmap_iter_create(cache->entries, &it);
+	result = isc_hashmap_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		sigentry_t *entry = NULL;
+		unsigned char length[2];
+
+		isc_hashmap_iter_current(it, (void **)&entry);
+		if (entry->expire < now) {
+			result = isc_hashmap_iter_delcurrent_next(it);
+			entry_free(cache, entry);
+			continue;
+		}
+
+		length[0] = entry->length >> 8;
+		length[1] = entry->length & 0xff;
+		CHECK(isc_stdio_write(entry->digest, DIGESTLEN, 1, fp, NULL));
+		CHECK(isc_stdio_write(length, 2, 1, fp, NULL));
+		CHECK(isc_stdio_write(entry->rdata, entry->length, 1, fp,
+				      NULL));
+		result = isc_hashmap_iter_next(it);
+	}
+	INSIST(result == ISC_R_NOMORE);
+
+	CHECK(isc_stdio_flush(fp));
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	CHECK(result);
+	CHECK(isc_file_rename(template, filename));
+	cache->changed = false;
+
+cleanup:
+	if (it != NULL) {
+		isc_hashmap_iter_destroy(&it);
+	}
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	if (result != ISC_R_SUCCESS && template[0] != '\0') {
+		(void)isc_file_remove(template);
+	}
+	UNLOCK(&cache->lock);
+	return (result);
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/util.h>
+
+#include <dns/rdataslab.h>
+#include <dns/slabstore.h>
+
+#define SLABSTORE_MAGIC	   ISC_MAGIC('S', 'l', 'b', 'S')
+#define VALID_SLABSTORE(m) ISC_MAGIC_VALID(m, SLABSTORE_MAGIC)
+
+/*
+ * Each entry holds a reference to its store, so the store outlives the
+ * databases that still have slabs from it.
+ */
+typedef struct slabentry {
+	dns_slabstore_t *store;
+	uint32_t hashval;
+	uint32_t references; /* protected by the store's lock */
+	unsigned int length;
+	unsigned char slab[];
+} slabentry_t;
+
+typedef struct slabkey {
+	const unsigned char *slab;
+	unsigned int length;
+} slabkey_t;
+
+struct dns_slabstore {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	isc_mutex_t lock;
+	isc_hashmap_t *entries; /* protected by 'lock' */
+	unsigned int count;	/* protected by 'lock' */
+};
+
+static bool
+entry_match(void *node, const void *key) {
+	const slabentry_t *entry = node;
+	const slabkey_t *k = key;
+
+	return (entry->length == k->length &&
+		memcmp(entry->slab, k->slab, k->length) == 0);
+}
+
+void
+dns_slabstore_create(isc_mem_t *mctx, dns_slabstore_t **storep) {
+	dns_slabstore_t *store = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(storep != NULL && *storep == NULL);
+
+	store = isc_mem_get(mctx, sizeof(*store));
+	*store = (dns_slabstore_t){
+		.references = ISC_REFCOUNT_INITIALIZER(1),
+	};
+	isc_mem_attach(mctx, &store->mctx);
+	isc_mutex_init(&store->lock);
+	isc_hashmap_create(mctx, ISC_HASH_MIN_BITS, &store->entries);
+
+	store->magic = SLABSTORE_MAGIC;
+	*storep = store;
+}
+
+static void
+slabstore_destroy(dns_slabstore_t *store) {
+	store->magic = 0;
+
+	INSIST(store->count == 0);
+	isc_hashmap_destroy(&store->entries);
+	isc_mutex_destroy(&store->lock);
+	isc_mem_putanddetach(&store->mctx, store, sizeof(*store));
+}
+
+ISC_REFCOUNT_IMPL(dns_slabstore, slabstore_destroy);
+
+unsigned char *
+dns_slabstore_intern(dns_slabstore_t *store, const unsigned char *slab) {
+	slabkey_t key;
+	slabentry_t *entry = NULL;
+	uint32_t hashval;
+	isc_result_t result;
+
+	REQUIRE(VALID_SLABSTORE(store));
+	REQUIRE(slab != NULL);
+
+	key = (slabkey_t){
+		.slab = slab,
+		.length = dns_rdataslab_size(UNCONST(slab), 0),
+	};
+	hashval = isc_hash32(slab, key.length, true);
+
+	LOCK(&store->lock);
+	result = isc_hashmap_find(store->entries, hashval, entry_match, &key,
+				  (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		INSIST(entry->references < UINT32_MAX);
+		entry->references++;
+	} else {
+		entry = isc_mem_get(store->mctx, sizeof(*entry) + key.length);
+		*entry = (slabentry_t){
+			.store = dns_slabstore_ref(store),
+			.hashval = hashval,
+			.references = 1,
+			.length = key.length,
+		};
+		memmove(entry->slab, slab, key.length);
+		key.slab = entry->slab;
+		result = isc_hashmap_add(store->entries, hashval, entry_match,
+					 &key, entry, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		store->count++;
+	}
+	UNLOCK(&store->lock);
+
+	return (entry->slab);
+}
+
+void
+dns_slabstore_release(unsigned char **slabp) {
+	slabentry_t *entry = NULL;
+	dns_slabstore_t *store = NULL;
+	slabkey_t key;
+	isc_result_t result;
+
+	REQUIRE(slabp != NULL && *slabp != NULL);
+
+	entry = (slabentry_t *)(*slabp - offsetof(slabentry_t, slab));
+	*slabp = NULL;
+	store = entry->store;
+
+	REQUIRE(VALID_SLABSTORE(store));
+
+	LOCK(&store->lock);
+	INSIST(entry->references > 0);
+	if (--entry->references > 0) {
+		UNLOCK(&store->lock);
+		return;
+	}
+
+	key = (slabkey_t){
+		.slab = entry->slab,
+		.length = entry->length,
+	};
+	result = isc_hashmap_delete(store->entries, entry->hashval,
+				    entry_match, &key);
+	INSIST(result == ISC_R_SUCCESS);
+	store->count--;
+	UNLOCK(&store->lock);
+
+	isc_mem_put(store->mctx, entry, sizeof(*entry) + entry->length);
+	dns_slabstore_detach(&store);
+}
+
+unsigned int
+dns_slabstore_count(dns_slabstore_t *store) {
+	unsigned int count;
+
+	REQUIRE(VALID_SLABSTORE(store));
+
+	LOCK(&store->lock);
+	count = store->count;
+	UNLOCK(&store->lock);
+
+	return (count);
+}
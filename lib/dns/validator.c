@@ -24,6 +24,8 @@
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/serial.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/tid.h>
 #include <isc/util.h>
@@ -43,9 +45,12 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
+#include "probes.h"
+
 /*! \file
  * \brief
  * Basic processing sequences:
@@ -236,6 +241,12 @@ validator_done(dns_validator_t *val, isc_result_t result) {
 	val->attributes |= VALATTR_COMPLETE;
 	val->result = result;
 
+	if (LIBDNS_VALIDATOR_DONE_ENABLED()) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		dns_name_format(val->name, namebuf, sizeof(namebuf));
+		LIBDNS_VALIDATOR_DONE(val, namebuf, val->type, result);
+	}
+
 	isc_async_run(val->loop, val->cb, val);
 }
 
@@ -1012,7 +1023,6 @@ select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 	isc_buffer_t b;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
 	dst_key_t *oldkey = val->key;
-	bool no_rdata = false;
 
 	if (oldkey == NULL) {
 		result = dns_rdataset_first(rdataset);
@@ -1032,32 +1042,32 @@ select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 		isc_buffer_add(&b, rdata.length);
 		INSIST(val->key == NULL);
 		result = dst_key_fromdns_ex(&siginfo->signer, rdata.rdclass, &b,
-					    val->view->mctx, no_rdata,
-					    &val->key);
+					    val->view->mctx, true, &val->key);
 		if (result == ISC_R_SUCCESS) {
-			if (siginfo->algorithm ==
-				    (dns_secalg_t)dst_key_alg(val->key) &&
-			    siginfo->keyid ==
-				    (dns_keytag_t)dst_key_id(val->key) &&
-			    (dst_key_flags(val->key) & DNS_KEYFLAG_REVOKE) ==
-				    0 &&
-			    dst_key_iszonekey(val->key))
+			bool match =
+				siginfo->algorithm ==
+					(dns_secalg_t)dst_key_alg(val->key) &&
+				siginfo->keyid ==
+					(dns_keytag_t)dst_key_id(val->key) &&
+				(dst_key_flags(val->key) &
+				 DNS_KEYFLAG_REVOKE) == 0 &&
+				dst_key_iszonekey(val->key);
+			dst_key_free(&val->key);
+			/*
+			 * Get the full key from the key table, which
+			 * only has to parse it the first time around.
+			 */
+			if (match &&
+			    dns_keytable_dstkey(val->keytable, &siginfo->signer,
+						&rdata,
+						&val->key) == ISC_R_SUCCESS)
 			{
-				if (no_rdata) {
-					/* Retry with full key */
-					dns_rdata_reset(&rdata);
-					dst_key_free(&val->key);
-					no_rdata = false;
-					continue;
-				}
 				/* This is the key we're looking for. */
 				goto done;
 			}
-			dst_key_free(&val->key);
 		}
 		dns_rdata_reset(&rdata);
 		result = dns_rdataset_next(rdataset);
-		no_rdata = true;
 	} while (result == ISC_R_SUCCESS);
 
 done:
@@ -1408,6 +1418,28 @@ selfsigned_dnskey(dns_validator_t *val) {
 	return (DNS_R_NOKEYMATCH);
 }
 
+static void
+inc_stats(dns_validator_t *val, isc_statscounter_t counter) {
+	if (val->view->resolver != NULL) {
+		dns_resolver_incstats(val->view->resolver, counter);
+	}
+}
+
+/*
+ * Is the RRSIG 'rdata' within its validity period?
+ */
+static bool
+sig_current(dns_rdata_t *rdata) {
+	dns_rdata_rrsig_t sig;
+	isc_stdtime_t now = isc_stdtime_now();
+
+	RUNTIME_CHECK(dns_rdata_tostruct(rdata, &sig, NULL) == ISC_R_SUCCESS);
+
+	return (!isc_serial_lt(sig.timeexpire, sig.timesigned) &&
+		!isc_serial_lt((uint32_t)now, sig.timesigned) &&
+		!isc_serial_lt(sig.timeexpire, (uint32_t)now));
+}
+
 /*%
  * Attempt to verify the rdataset using the given key and rdata (RRSIG).
  * The signature was good and from a wildcard record and the QNAME does
@@ -1424,9 +1456,28 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	dns_fixedname_t fixed;
 	bool ignore = false;
 	dns_name_t *wild;
+	uint64_t hash;
 
 	val->attributes |= VALATTR_TRIEDVERIFY;
 	wild = dns_fixedname_initname(&fixed);
+
+	/*
+	 * A signature that has been verified recently does not need the
+	 * crypto again, provided that it is still within its validity
+	 * period.
+	 */
+	if (dns_keytable_sigverified(val->keytable, val->name, val->rdataset,
+				     key, rdata, &hash) &&
+	    sig_current(rdata))
+	{
+		inc_stats(val, dns_resstatscounter_valcachehit);
+		validator_log(val, ISC_LOG_DEBUG(3),
+			      "verify rdataset (keyid=%u): already verified",
+			      keyid);
+		return (ISC_R_SUCCESS);
+	}
+	inc_stats(val, dns_resstatscounter_valcachemiss);
+
 	if (over_max_validations(val)) {
 		return (ISC_R_QUOTA);
 	}
@@ -1434,6 +1485,9 @@ again:
 	result = dns_dnssec_verify(val->name, val->rdataset, key, ignore,
 				   val->view->maxbits, val->view->mctx, rdata,
 				   wild);
+	if (result == ISC_R_SUCCESS && !ignore) {
+		dns_keytable_setsigverified(val->keytable, hash, rdata);
+	}
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
@@ -1853,8 +1907,8 @@ check_signer(dns_validator_t *val, dns_rdata_t *keyrdata, uint16_t keyid,
 			continue;
 		}
 		if (dstkey == NULL) {
-			result = dns_dnssec_keyfromrdata(
-				val->name, keyrdata, val->view->mctx, &dstkey);
+			result = dns_keytable_dstkey(val->keytable, val->name,
+						     keyrdata, &dstkey);
 			if (result != ISC_R_SUCCESS) {
 				/*
 				 * This really shouldn't happen, but...
@@ -3302,6 +3356,12 @@ validator_start(void *arg) {
 
 	validator_log(val, ISC_LOG_DEBUG(3), "starting");
 
+	if (LIBDNS_VALIDATOR_START_ENABLED()) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		dns_name_format(val->name, namebuf, sizeof(namebuf));
+		LIBDNS_VALIDATOR_START(val, namebuf, val->type);
+	}
+
 	if (val->rdataset != NULL && val->sigrdataset != NULL) {
 		/*
 		 * This looks like a simple validation.  We say "looks like"
@@ -53,10 +53,13 @@
 #include <dns/peer.h>
 #include <dns/rbt.h>
 #include <dns/rdataset.h>
+#include <dns/refresh.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/slabstore.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/transport.h>
@@ -151,6 +154,7 @@ dns_view_create(isc_mem_t *mctx, dns_dispatchmgr_t *dispatchmgr,
 	dns_tsigkeyring_create(view->mctx, &view->dynamickeys);
 
 	view->failcache = dns_badcache_new(view->mctx);
+	view->outagecache = dns_badcache_new(view->mctx);
 
 	isc_mutex_init(&view->new_zone_lock);
 
@@ -181,6 +185,7 @@ cleanup_order:
 cleanup_new_zone_lock:
 	isc_mutex_destroy(&view->new_zone_lock);
 	dns_badcache_destroy(&view->failcache);
+	dns_badcache_destroy(&view->outagecache);
 
 	if (view->dynamickeys != NULL) {
 		dns_tsigkeyring_detach(&view->dynamickeys);
@@ -364,12 +369,21 @@ destroy(dns_view_t *view) {
 	if (view->sfd != NULL) {
 		dns_nametree_detach(&view->sfd);
 	}
+	if (view->zonetrie != NULL) {
+		dns_qpmulti_destroy(&view->zonetrie);
+	}
+	if (view->slabstore != NULL) {
+		dns_slabstore_detach(&view->slabstore);
+	}
 	if (view->secroots_priv != NULL) {
 		dns_keytable_detach(&view->secroots_priv);
 	}
 	if (view->ntatable_priv != NULL) {
 		dns_ntatable_detach(&view->ntatable_priv);
 	}
+	if (view->refresh != NULL) {
+		dns_refresh_detach(&view->refresh);
+	}
 	for (dns64 = ISC_LIST_HEAD(view->dns64); dns64 != NULL;
 	     dns64 = ISC_LIST_HEAD(view->dns64))
 	{
@@ -411,6 +425,15 @@ destroy(dns_view_t *view) {
 	if (view->failcache != NULL) {
 		dns_badcache_destroy(&view->failcache);
 	}
+	if (view->outagecache != NULL) {
+		dns_badcache_destroy(&view->outagecache);
+	}
+	if (view->respcache != NULL) {
+		dns_respcache_destroy(&view->respcache);
+	}
+	if (view->respshare != NULL) {
+		dns_respcache_destroy(&view->respshare);
+	}
 	isc_mutex_destroy(&view->new_zone_lock);
 	isc_mutex_destroy(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -423,6 +446,9 @@ destroy(dns_view_t *view) {
 	if (view->plugins != NULL && view->plugins_free != NULL) {
 		view->plugins_free(view->mctx, &view->plugins);
 	}
+	if (view->sortlistindex != NULL && view->sortlistindex_free != NULL) {
+		view->sortlistindex_free(view->mctx, &view->sortlistindex);
+	}
 	isc_mem_putanddetach(&view->mctx, view, sizeof(*view));
 }
 
@@ -515,6 +541,9 @@ dns_view_detach(dns_view_t **viewp) {
 		if (view->ntatable_priv != NULL) {
 			dns_ntatable_shutdown(view->ntatable_priv);
 		}
+		if (view->refresh != NULL) {
+			dns_refresh_shutdown(view->refresh);
+		}
 		UNLOCK(&view->lock);
 
 		/* Detach outside view lock */
@@ -834,11 +863,11 @@ dns_view_find(dns_view_t *view, const dns_name_t *name, dns_rdatatype_t type,
 	rcu_read_lock();
 	zonetable = rcu_dereference(view->zonetable);
 	if (zonetable != NULL) {
-		result = dns_zt_find(zonetable, name, DNS_ZTFIND_MIRROR, &zone);
+		result = dns_zt_lookup(zonetable, name, DNS_ZTFIND_MIRROR,
+				       &zone);
 	} else {
 		result = ISC_R_SHUTTINGDOWN;
 	}
-	rcu_read_unlock();
 	if (zone != NULL && dns_zone_gettype(zone) == dns_zone_staticstub &&
 	    !use_static_stub)
 	{
@@ -846,19 +875,21 @@ dns_view_find(dns_view_t *view, const dns_name_t *name, dns_rdatatype_t type,
 	}
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
 		result = dns_zone_getdb(zone, &db);
-		if (result != ISC_R_SUCCESS && view->cachedb != NULL) {
-			dns_db_attach(view->cachedb, &db);
-		} else if (result != ISC_R_SUCCESS) {
-			goto cleanup;
-		}
-		if (dns_zone_gettype(zone) == dns_zone_staticstub &&
+		if (result == ISC_R_SUCCESS &&
+		    dns_zone_gettype(zone) == dns_zone_staticstub &&
 		    dns_name_equal(name, dns_zone_getorigin(zone)))
 		{
 			is_staticstub_zone = true;
+		} else if (result != ISC_R_SUCCESS && view->cachedb != NULL) {
+			result = ISC_R_NOTFOUND;
 		}
-	} else if (result == ISC_R_NOTFOUND && view->cachedb != NULL) {
+	}
+	rcu_read_unlock();
+	zone = NULL;
+
+	if (result == ISC_R_NOTFOUND && view->cachedb != NULL) {
 		dns_db_attach(view->cachedb, &db);
-	} else {
+	} else if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
@@ -1010,10 +1041,6 @@ cleanup:
 		INSIST(node == NULL);
 	}
 
-	if (zone != NULL) {
-		dns_zone_detach(&zone);
-	}
-
 	return (result);
 }
 
@@ -1071,6 +1098,7 @@ dns_view_findzonecut(dns_view_t *view, const dns_name_t *name,
 	isc_result_t result;
 	dns_db_t *db = NULL;
 	bool is_cache, use_zone = false, try_hints = false;
+	bool is_staticstub_zone = false;
 	dns_zone_t *zone = NULL;
 	dns_name_t *zfname = NULL;
 	dns_zt_t *zonetable = NULL;
@@ -1097,14 +1125,18 @@ dns_view_findzonecut(dns_view_t *view, const dns_name_t *name,
 	rcu_read_lock();
 	zonetable = rcu_dereference(view->zonetable);
 	if (zonetable != NULL) {
-		result = dns_zt_find(zonetable, name, ztoptions, &zone);
+		result = dns_zt_lookup(zonetable, name, ztoptions, &zone);
 	} else {
 		result = ISC_R_SHUTTINGDOWN;
 	}
-	rcu_read_unlock();
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
 		result = dns_zone_getdb(zone, &db);
+		is_staticstub_zone = (dns_zone_gettype(zone) ==
+				      dns_zone_staticstub);
 	}
+	rcu_read_unlock();
+	zone = NULL;
+
 	if (result == ISC_R_NOTFOUND) {
 		/*
 		 * We're not directly authoritative for this query name, nor
@@ -1151,7 +1183,7 @@ db_find:
 		 * Tag static stub NS RRset so that when we look for
 		 * addresses we use the configured server addresses.
 		 */
-		if (dns_zone_gettype(zone) == dns_zone_staticstub) {
+		if (is_staticstub_zone) {
 			rdataset->attributes |= DNS_RDATASETATTR_STATICSTUB;
 		}
 
@@ -1180,7 +1212,7 @@ db_find:
 		if (result == ISC_R_SUCCESS) {
 			if (zfname != NULL &&
 			    (!dns_name_issubdomain(fname, zfname) ||
-			     (dns_zone_gettype(zone) == dns_zone_staticstub &&
+			     (is_staticstub_zone &&
 			      dns_name_equal(fname, zfname))))
 			{
 				/*
@@ -1265,9 +1297,6 @@ cleanup:
 	if (db != NULL) {
 		dns_db_detach(&db);
 	}
-	if (zone != NULL) {
-		dns_zone_detach(&zone);
-	}
 
 	return (result);
 }
@@ -1460,6 +1489,9 @@ dns_view_flushcache(dns_view_t *view, bool fixuponly) {
 	if (view->failcache != NULL) {
 		dns_badcache_flush(view->failcache);
 	}
+	if (view->outagecache != NULL) {
+		dns_badcache_flush(view->outagecache);
+	}
 
 	rcu_read_lock();
 	adb = rcu_dereference(view->adb);
@@ -1496,6 +1528,9 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushtree(view->failcache, name);
 		}
+		if (view->outagecache != NULL) {
+			dns_badcache_flushtree(view->outagecache, name);
+		}
 	} else {
 		rcu_read_lock();
 		adb = rcu_dereference(view->adb);
@@ -1509,6 +1544,9 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushname(view->failcache, name);
 		}
+		if (view->outagecache != NULL) {
+			dns_badcache_flushname(view->outagecache, name);
+		}
 	}
 
 	if (view->cache != NULL) {
@@ -1628,6 +1666,14 @@ dns_view_issecuredomain(dns_view_t *view, const dns_name_t *name,
 	return (ISC_R_SUCCESS);
 }
 
+uint64_t
+dns_view_trustgeneration(dns_view_t *view) {
+	REQUIRE(DNS_VIEW_VALID(view));
+
+	/* Both only ever grow, so their sum changes when either does */
+	return (dns_keytable_generation() + dns_ntatable_generation());
+}
+
 void
 dns_view_untrust(dns_view_t *view, const dns_name_t *keyname,
 		 const dns_rdata_dnskey_t *dnskey) {
@@ -2283,6 +2329,112 @@ dns_view_staleanswerenabled(dns_view_t *view) {
 	return (result);
 }
 
+/*
+ * Outages are recorded per zone cut in 'outagecache', using the NS type
+ * for the entries.  'outageuntil' holds the latest expiry of any of them,
+ * so that while nothing is in an outage the lookups below cost a single
+ * atomic load.
+ */
+void
+dns_view_setoutage(dns_view_t *view, const dns_name_t *name,
+		   isc_stdtime_t now) {
+	dns_fixedname_t fixed;
+	dns_name_t *cutname = dns_fixedname_initname(&fixed);
+	uint32_t interval = 0;
+	isc_stdtime_t expire, until;
+	isc_result_t result;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (view->outagecache == NULL || view->cachedb == NULL ||
+	    dns_db_getservestalerefresh(view->cachedb, &interval) !=
+		    ISC_R_SUCCESS ||
+	    interval == 0)
+	{
+		return;
+	}
+
+	result = dns_db_findzonecut(view->cachedb, name, DNS_DBFIND_STALEOK,
+				    now, NULL, cutname, NULL, NULL, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	expire = now + interval;
+	dns_badcache_add(view->outagecache, cutname, dns_rdatatype_ns, true, 0,
+			 expire);
+
+	until = atomic_load_acquire(&view->outageuntil);
+	while (until < expire &&
+	       !atomic_compare_exchange_weak_acq_rel(&view->outageuntil,
+						     &until, expire))
+	{
+		/* retry */
+	}
+}
+
+/*
+ * Find the entry in 'outagecache' covering 'name', copying its owner
+ * into 'cutname'.
+ */
+static bool
+findoutage(dns_view_t *view, const dns_name_t *name, isc_stdtime_t now,
+	   dns_name_t *cutname) {
+	unsigned int labels;
+
+	if (view->outagecache == NULL ||
+	    atomic_load_acquire(&view->outageuntil) < now)
+	{
+		return (false);
+	}
+
+	labels = dns_name_countlabels(name);
+	for (unsigned int i = 0; i < labels; i++) {
+		dns_name_getlabelsequence(name, i, labels - i, cutname);
+		if (dns_badcache_find(view->outagecache, cutname,
+				      dns_rdatatype_ns, NULL,
+				      now) == ISC_R_SUCCESS)
+		{
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+bool
+dns_view_inoutage(dns_view_t *view, const dns_name_t *name, isc_stdtime_t now,
+		  dns_name_t *cutname) {
+	dns_name_t suffix;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(dns_name_isabsolute(name));
+
+	dns_name_init(&suffix, NULL);
+	if (!findoutage(view, name, now, &suffix)) {
+		return (false);
+	}
+	if (cutname != NULL) {
+		dns_name_copy(&suffix, cutname);
+	}
+	return (true);
+}
+
+void
+dns_view_clearoutage(dns_view_t *view, const dns_name_t *name,
+		     isc_stdtime_t now) {
+	dns_name_t suffix;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(dns_name_isabsolute(name));
+
+	dns_name_init(&suffix, NULL);
+	if (findoutage(view, name, now, &suffix)) {
+		dns_badcache_flushname(view->outagecache, &suffix);
+	}
+}
+
 void
 dns_view_flushonshutdown(dns_view_t *view, bool flush) {
 	REQUIRE(DNS_VIEW_VALID(view));
@@ -2419,6 +2571,13 @@ cleanup:
 isc_result_t
 dns_view_apply(dns_view_t *view, bool stop, isc_result_t *sub,
 	       isc_result_t (*action)(dns_zone_t *, void *), void *uap) {
+	return (dns_view_applyfrom(view, NULL, stop, sub, action, uap));
+}
+
+isc_result_t
+dns_view_applyfrom(dns_view_t *view, const dns_name_t *after, bool stop,
+		   isc_result_t *sub,
+		   isc_result_t (*action)(dns_zone_t *, void *), void *uap) {
 	isc_result_t result;
 	dns_zt_t *zonetable = NULL;
 
@@ -2427,7 +2586,8 @@ dns_view_apply(dns_view_t *view, bool stop, isc_result_t *sub,
 	rcu_read_lock();
 	zonetable = rcu_dereference(view->zonetable);
 	if (zonetable != NULL) {
-		result = dns_zt_apply(zonetable, stop, sub, action, uap);
+		result = dns_zt_applyfrom(zonetable, after, stop, sub, action,
+					  uap);
 	} else {
 		result = ISC_R_SHUTTINGDOWN;
 	}
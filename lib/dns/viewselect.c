@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/acl.h>
+#include <dns/iptable.h>
+#include <dns/view.h>
+#include <dns/viewselect.h>
+
+#define VIEWSELECT_MAGIC    ISC_MAGIC('V', 's', 'e', 'l')
+#define VALID_VIEWSELECT(v) ISC_MAGIC_VALID(v, VIEWSELECT_MAGIC)
+
+/*
+ * The compiled form of one kind of ACL across all the views.
+ *
+ * 'radix' holds every prefix of the compiled ACLs, inserted longest
+ * first so that isc_radix_search() returns the longest match instead
+ * of the first one.  The data of each prefix points to its bitset in
+ * 'sets', which has room for 'nalloc' of them.  'fallback' has the
+ * bits of the views whose ACL could not be compiled; it is included in
+ * every set and is the answer for the addresses no prefix matches.
+ */
+typedef struct vsel_table {
+	isc_radix_tree_t *radix;
+	uint64_t *sets;
+	size_t nsets;
+	size_t nalloc;
+	uint64_t *fallback;
+} vsel_table_t;
+
+struct dns_viewselect {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	unsigned int nviews;
+	size_t words;
+	vsel_table_t clients;
+	vsel_table_t destinations;
+};
+
+static dns_acl_t *
+view_acl(dns_view_t *view, bool clients) {
+	return (clients ? view->matchclients : view->matchdestinations);
+}
+
+/*
+ * Only ACLs made of address prefixes alone give the same answer for
+ * every address under a prefix, whoever signed the request.
+ */
+static bool
+compilable(dns_acl_t *acl) {
+	return (acl != NULL && acl->length == 0);
+}
+
+static void
+set_bit(uint64_t *set, unsigned int index) {
+	set[index / 64] |= UINT64_C(1) << (index % 64);
+}
+
+static int
+prefix_cmp(const void *a, const void *b) {
+	const isc_prefix_t *pa = a, *pb = b;
+
+	return ((int)pb->bitlen - (int)pa->bitlen);
+}
+
+static size_t
+count_prefixes(dns_viewlist_t *viewlist, bool clients) {
+	isc_radix_node_t *node = NULL;
+	dns_view_t *view = NULL;
+	size_t count = 0;
+
+	ISC_LIST_FOREACH (*viewlist, view, link) {
+		dns_acl_t *acl = view_acl(view, clients);
+
+		if (!compilable(acl)) {
+			continue;
+		}
+		RADIX_WALK(acl->iptable->radix->head, node) {
+			for (size_t i = 0; i < RADIX_FAMILIES; i++) {
+				if (node->node_num[i] != -1) {
+					count++;
+				}
+			}
+		}
+		RADIX_WALK_END;
+	}
+
+	return (count);
+}
+
+static size_t
+collect_prefixes(dns_viewlist_t *viewlist, bool clients,
+		 isc_prefix_t *prefixes) {
+	isc_radix_node_t *node = NULL;
+	dns_view_t *view = NULL;
+	size_t count = 0;
+
+	ISC_LIST_FOREACH (*viewlist, view, link) {
+		dns_acl_t *acl = view_acl(view, clients);
+
+		if (!compilable(acl)) {
+			continue;
+		}
+		RADIX_WALK(acl->iptable->radix->head, node) {
+			for (size_t i = 0; i < RADIX_FAMILIES; i++) {
+				isc_prefix_t *p = &prefixes[count];
+
+				if (node->node_num[i] == -1) {
+					continue;
+				}
+				memset(p, 0, sizeof(*p));
+				p->family = (i == RADIX_V6) ? AF_INET6
+							    : AF_INET;
+				p->bitlen = node->prefix->bitlen;
+				memmove(&p->add, &node->prefix->add,
+					sizeof(p->add));
+				isc_refcount_init(&p->refcount, 0);
+				count++;
+			}
+		}
+		RADIX_WALK_END;
+	}
+
+	return (count);
+}
+
+/*
+ * Fill 'set' with the views that allow the addresses 'prefix' is the
+ * longest match for: as no other compiled prefix lies between them and
+ * 'prefix', every ACL makes the same decision for all of them.
+ */
+static void
+fill_set(dns_viewselect_t *vsel, dns_viewlist_t *viewlist, bool clients,
+	 isc_prefix_t *prefix, uint64_t *set) {
+	vsel_table_t *table = clients ? &vsel->clients : &vsel->destinations;
+	dns_view_t *view = NULL;
+	unsigned int index = 0;
+
+	memmove(set, table->fallback, vsel->words * sizeof(set[0]));
+
+	ISC_LIST_FOREACH (*viewlist, view, link) {
+		dns_acl_t *acl = view_acl(view, clients);
+		isc_radix_node_t *node = NULL;
+		isc_result_t result;
+
+		if (compilable(acl)) {
+			result = isc_radix_search(acl->iptable->radix, &node,
+						  prefix);
+			if (result == ISC_R_SUCCESS &&
+			    *(bool *)node->data[ISC_RADIX_FAMILY(prefix)])
+			{
+				set_bit(set, index);
+			}
+		}
+		index++;
+	}
+}
+
+static void
+table_init(dns_viewselect_t *vsel, dns_viewlist_t *viewlist, bool clients) {
+	vsel_table_t *table = clients ? &vsel->clients : &vsel->destinations;
+	isc_prefix_t *prefixes = NULL;
+	dns_view_t *view = NULL;
+	unsigned int index = 0;
+	size_t count;
+
+	table->fallback = isc_mem_cget(vsel->mctx, vsel->words,
+				       sizeof(table->fallback[0]));
+	ISC_LIST_FOREACH (*viewlist, view, link) {
+		if (!compilable(view_acl(view, clients))) {
+			set_bit(table->fallback, index);
+		}
+		index++;
+	}
+
+	isc_radix_create(vsel->mctx, &table->radix, RADIX_MAXBITS);
+
+	count = count_prefixes(viewlist, clients);
+	if (count == 0) {
+		return;
+	}
+
+	prefixes = isc_mem_cget(vsel->mctx, count, sizeof(prefixes[0]));
+	INSIST(collect_prefixes(viewlist, clients, prefixes) == count);
+	qsort(prefixes, count, sizeof(prefixes[0]), prefix_cmp);
+
+	table->nalloc = count;
+	table->sets = isc_mem_cget(vsel->mctx, count * vsel->words,
+				   sizeof(table->sets[0]));
+
+	for (size_t i = 0; i < count; i++) {
+		isc_prefix_t *prefix = &prefixes[i];
+		int fam = ISC_RADIX_FAMILY(prefix);
+		isc_radix_node_t *node = NULL;
+		isc_result_t result;
+		uint64_t *set = NULL;
+
+		result = isc_radix_insert(table->radix, &node, NULL, prefix);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (node->data[fam] == NULL) {
+			set = &table->sets[table->nsets++ * vsel->words];
+			fill_set(vsel, viewlist, clients, prefix, set);
+			node->data[fam] = set;
+		}
+		isc_refcount_destroy(&prefix->refcount);
+	}
+
+	isc_mem_cput(vsel->mctx, prefixes, count, sizeof(prefixes[0]));
+
+	isc_radix_compile(table->radix);
+}
+
+static void
+table_free(dns_viewselect_t *vsel, vsel_table_t *table) {
+	isc_radix_destroy(table->radix, NULL);
+	if (table->sets != NULL) {
+		isc_mem_cput(vsel->mctx, table->sets,
+			     table->nalloc * vsel->words,
+			     sizeof(table->sets[0]));
+	}
+	isc_mem_cput(vsel->mctx, table->fallback, vsel->words,
+		     sizeof(table->fallback[0]));
+}
+
+void
+dns_viewselect_create(isc_mem_t *mctx, dns_viewlist_t *viewlist,
+		      dns_viewselect_t **vselp) {
+	dns_viewselect_t *vsel = NULL;
+	dns_view_t *view = NULL;
+	unsigned int nviews = 0;
+
+	REQUIRE(viewlist != NULL);
+	REQUIRE(vselp != NULL && *vselp == NULL);
+
+	ISC_LIST_FOREACH (*viewlist, view, link) {
+		nviews++;
+	}
+
+	vsel = isc_mem_get(mctx, sizeof(*vsel));
+	*vsel = (dns_viewselect_t){
+		.nviews = nviews,
+		.words = nviews / 64 + 1,
+	};
+	isc_mem_attach(mctx, &vsel->mctx);
+	isc_refcount_init(&vsel->references, 1);
+
+	table_init(vsel, viewlist, true);
+	table_init(vsel, viewlist, false);
+
+	vsel->magic = VIEWSELECT_MAGIC;
+	*vselp = vsel;
+}
+
+static const uint64_t *
+table_lookup(vsel_table_t *table, const isc_netaddr_t *addr,
+	     dns_aclenv_t *env) {
+	isc_radix_node_t *node = NULL;
+	isc_netaddr_t v4addr;
+	isc_prefix_t pfx;
+	isc_result_t result;
+
+	if (env != NULL && env->match_mapped && addr->family == AF_INET6 &&
+	    IN6_IS_ADDR_V4MAPPED(&addr->type.in6))
+	{
+		isc_netaddr_fromv4mapped(&v4addr, addr);
+		addr = &v4addr;
+	}
+
+	NETADDR_TO_PREFIX_T(addr, pfx, (addr->family == AF_INET6) ? 128 : 32);
+	result = isc_radix_search(table->radix, &node, &pfx);
+	isc_refcount_destroy(&pfx.refcount);
+
+	if (result != ISC_R_SUCCESS) {
+		return (table->fallback);
+	}
+	return (node->data[ISC_RADIX_FAMILY(&pfx)]);
+}
+
+void
+dns_viewselect_lookup(dns_viewselect_t *vsel, const isc_netaddr_t *srcaddr,
+		      const isc_netaddr_t *destaddr, dns_aclenv_t *env,
+		      dns_viewselect_match_t *match) {
+	REQUIRE(VALID_VIEWSELECT(vsel));
+	REQUIRE(srcaddr != NULL && destaddr != NULL);
+	REQUIRE(match != NULL);
+
+	*match = (dns_viewselect_match_t){
+		.nviews = vsel->nviews,
+		.clients = table_lookup(&vsel->clients, srcaddr, env),
+		.destinations = table_lookup(&vsel->destinations, destaddr,
+					     env),
+	};
+}
+
+bool
+dns_viewselect_candidate(const dns_viewselect_match_t *match,
+			 unsigned int index) {
+	uint64_t bit = UINT64_C(1) << (index % 64);
+
+	REQUIRE(match != NULL);
+
+	if (index >= match->nviews) {
+		return (true);
+	}
+
+	return ((match->clients[index / 64] & match->destinations[index / 64] &
+		 bit) != 0);
+}
+
+static void
+dns__viewselect_destroy(dns_viewselect_t *vsel) {
+	vsel->magic = 0;
+	table_free(vsel, &vsel->clients);
+	table_free(vsel, &vsel->destinations);
+	isc_mem_putanddetach(&vsel->mctx, vsel, sizeof(*vsel));
+}
+
+#if DNS_VIEWSELECT_TRACE
+ISC_REFCOUNT_TRACE_IMPL(dns_viewselect, dns__viewselect_destroy);
+#else
+ISC_REFCOUNT_IMPL(dns_viewselect, dns__viewselect_destroy);
+#endif
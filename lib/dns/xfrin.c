@@ -62,6 +62,21 @@
 		}                              \
 	}
 
+/*%
+ * Received changes are handed to the apply job in batches of about
+ * XFRIN_APPLY_BATCH tuples.  Reading from the primary is paused while
+ * more than XFRIN_MAXQUEUED tuples are waiting to be applied, and is
+ * resumed once the apply job has caught up with half of them.
+ */
+#define XFRIN_APPLY_BATCH 4096
+#define XFRIN_MAXQUEUED	  (64 * XFRIN_APPLY_BATCH)
+
+/*
+ * This can be overridden by the -T xfrinmaxqueued option on the command
+ * line, so that pausing can be tested with small zones.
+ */
+unsigned int dns_xfrin_maxqueued = XFRIN_MAXQUEUED;
+
 /*%
  * The states of the *XFR state machine.  We handle both IXFR and AXFR
  * with a single integrated state machine because they cannot be
@@ -130,10 +145,13 @@ struct dns_xfrin {
 
 	dns_db_t *db;
 	dns_dbversion_t *ver;
-	dns_diff_t diff; /*%< Pending database changes */
+	dns_diff_t diff;    /*%< Pending database changes */
+	unsigned int ndiff; /*%< Number of tuples in 'diff' */
 
 	/* Diff queue */
 	bool diff_running;
+	bool recv_paused;	  /*%< Waiting for the queue to drain */
+	unsigned int diff_queued; /*%< Tuples queued but not applied */
 	struct __cds_wfcq_head diff_head;
 	struct cds_wfcq_tail diff_tail;
 
@@ -204,8 +222,15 @@ struct dns_xfrin {
 typedef struct xfrin_work {
 	dns_xfrin_t *xfr;
 	isc_result_t result;
+	unsigned int applied; /*%< Tuples applied by this run */
 } xfrin_work_t;
 
+typedef struct xfrin_diff {
+	dns_diff_t diff; /*%< Pending database changes */
+	unsigned int count;
+	struct cds_wfcq_node wfcq_node;
+} xfrin_diff_t;
+
 /**************************************************************************/
 /*
  * Forward declarations.
@@ -256,6 +281,8 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg);
 
 static void
 xfrin_end(dns_xfrin_t *xfr, isc_result_t result);
+static isc_result_t
+xfrin_readnext(dns_xfrin_t *xfr);
 
 static void
 xfrin_destroy(dns_xfrin_t *xfr);
@@ -314,13 +341,67 @@ axfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 	CHECK(dns_zone_checknames(xfr->zone, name, rdata));
 	dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata, &tuple);
 	dns_diff_append(&xfr->diff, &tuple);
+	xfr->ndiff++;
 	result = ISC_R_SUCCESS;
 failure:
 	return (result);
 }
 
 /*
- * Store a set of AXFR RRs in the database.
+ * Move the pending changes to the end of the diff queue.
+ */
+static void
+xfrin_diff_enqueue(dns_xfrin_t *xfr) {
+	xfrin_diff_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
+
+	*data = (xfrin_diff_t){ .count = xfr->ndiff };
+	cds_wfcq_node_init(&data->wfcq_node);
+
+	dns_diff_init(xfr->mctx, &data->diff);
+	/* FIXME: Should we add dns_diff_move() */
+	ISC_LIST_MOVE(data->diff.tuples, xfr->diff.tuples);
+
+	xfr->diff_queued += xfr->ndiff;
+	xfr->ndiff = 0;
+
+	(void)cds_wfcq_enqueue(&xfr->diff_head, &xfr->diff_tail,
+			       &data->wfcq_node);
+}
+
+/*
+ * Called on the transfer loop after each run of the apply job.  If
+ * reading was paused because too many changes were queued, read the
+ * next message once enough of them have been applied, or drop the
+ * reference held for the paused read if the transfer has failed.
+ */
+static void
+xfrin_resume(dns_xfrin_t *xfr, isc_result_t result) {
+	if (!xfr->recv_paused) {
+		return;
+	}
+
+	if (result == ISC_R_SUCCESS && atomic_load(&xfr->shuttingdown)) {
+		result = ISC_R_SHUTTINGDOWN;
+	}
+	if (result == ISC_R_SUCCESS &&
+	    xfr->diff_queued > dns_xfrin_maxqueued / 2)
+	{
+		return;
+	}
+
+	xfr->recv_paused = false;
+	if (result == ISC_R_SUCCESS) {
+		result = xfrin_readnext(xfr);
+		if (result == ISC_R_SUCCESS) {
+			return;
+		}
+		xfrin_fail(xfr, result, "failed while receiving responses");
+	}
+	dns_xfrin_detach(&xfr);
+}
+
+/*
+ * Store the queued sets of AXFR RRs in the database.
  */
 static void
 axfr_apply(void *arg) {
@@ -331,22 +412,45 @@ axfr_apply(void *arg) {
 
 	REQUIRE(VALID_XFRIN(xfr));
 
-	if (atomic_load(&xfr->shuttingdown)) {
-		result = ISC_R_SHUTTINGDOWN;
-		goto failure;
-	}
+	struct __cds_wfcq_head diff_head;
+	struct cds_wfcq_tail diff_tail;
 
-	CHECK(dns_diff_load(&xfr->diff, &xfr->axfr));
-	if (xfr->maxrecords != 0U) {
-		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
-		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
-			result = DNS_R_TOOMANYRECORDS;
-			goto failure;
+	/* Initialize local wfcqueue */
+	__cds_wfcq_init(&diff_head, &diff_tail);
+
+	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+		&diff_head, &diff_tail, &xfr->diff_head, &xfr->diff_tail);
+	INSIST(ret == CDS_WFCQ_RET_DEST_EMPTY);
+
+	struct cds_wfcq_node *node, *next;
+	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
+		xfrin_diff_t *data = caa_container_of(node, xfrin_diff_t,
+						      wfcq_node);
+
+		if (atomic_load(&xfr->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+		}
+
+		/* Load only until first failure */
+		if (result == ISC_R_SUCCESS) {
+			result = dns_diff_load(&data->diff, &xfr->axfr);
 		}
+		if (result == ISC_R_SUCCESS && xfr->maxrecords != 0U) {
+			result = dns_db_getsize(xfr->db, xfr->ver, &records,
+						NULL);
+			if (result == ISC_R_SUCCESS &&
+			    records > xfr->maxrecords)
+			{
+				result = DNS_R_TOOMANYRECORDS;
+			}
+		}
+
+		/* We need to clear and free all data chunks */
+		work->applied += data->count;
+		dns_diff_clear(&data->diff);
+		isc_mem_put(xfr->mctx, data, sizeof(*data));
 	}
 
-failure:
-	dns_diff_clear(&xfr->diff);
 	work->result = result;
 }
 
@@ -358,16 +462,37 @@ axfr_apply_done(void *arg) {
 
 	REQUIRE(VALID_XFRIN(xfr));
 
+	INSIST(xfr->diff_queued >= work->applied);
+	xfr->diff_queued -= work->applied;
+	work->applied = 0;
+
+	xfrin_resume(xfr, result);
+
 	if (atomic_load(&xfr->shuttingdown)) {
 		result = ISC_R_SHUTTINGDOWN;
 	}
 
-	if (result == ISC_R_SUCCESS) {
+	if (result != ISC_R_SUCCESS) {
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
+		goto failure;
+	}
+
+	/* Reschedule */
+	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
+		isc_work_enqueue_bulk(xfr->loop, axfr_apply, axfr_apply_done,
+				      work);
+		return;
+	}
+
+	/*
+	 * The final batch is queued before the state changes to
+	 * XFRST_AXFR_END, so an empty queue in that state means the
+	 * whole zone has been loaded.
+	 */
+	if (atomic_load(&xfr->state) == XFRST_AXFR_END) {
 		CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 		CHECK(dns_zone_verifydb(xfr->zone, xfr->db, NULL));
 		CHECK(axfr_finalize(xfr));
-	} else {
-		(void)dns_db_endload(xfr->db, &xfr->axfr);
 	}
 
 failure:
@@ -380,23 +505,31 @@ failure:
 			xfrin_end(xfr, result);
 		}
 	} else {
+		xfrin_resume(xfr, result);
 		xfrin_fail(xfr, result, "failed while processing responses");
 	}
 
 	dns_xfrin_detach(&xfr);
 }
 
+/*
+ * Queue the pending AXFR RRs to be loaded into the database while
+ * the rest of the zone is being received.
+ */
 static void
 axfr_commit(dns_xfrin_t *xfr) {
-	REQUIRE(!xfr->diff_running);
+	xfrin_diff_enqueue(xfr);
 
-	xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
-	*work = (xfrin_work_t){
-		.xfr = dns_xfrin_ref(xfr),
-		.result = ISC_R_UNSET,
-	};
-	xfr->diff_running = true;
-	isc_work_enqueue(xfr->loop, axfr_apply, axfr_apply_done, work);
+	if (!xfr->diff_running) {
+		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
+		*work = (xfrin_work_t){
+			.xfr = dns_xfrin_ref(xfr),
+			.result = ISC_R_UNSET,
+		};
+		xfr->diff_running = true;
+		isc_work_enqueue_bulk(xfr->loop, axfr_apply, axfr_apply_done,
+				      work);
+	}
 }
 
 static isc_result_t
@@ -415,11 +548,6 @@ axfr_finalize(dns_xfrin_t *xfr) {
  * IXFR handling
  */
 
-typedef struct ixfr_apply_data {
-	dns_diff_t diff; /*%< Pending database changes */
-	struct cds_wfcq_node wfcq_node;
-} ixfr_apply_data_t;
-
 static isc_result_t
 ixfr_init(dns_xfrin_t *xfr) {
 	isc_result_t result;
@@ -461,6 +589,7 @@ ixfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 
 	dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata, &tuple);
 	dns_diff_append(&xfr->diff, &tuple);
+	xfr->ndiff++;
 
 	xfr->ixfr.diffs++;
 failure:
@@ -492,7 +621,7 @@ failure:
 }
 
 static isc_result_t
-ixfr_apply_one(dns_xfrin_t *xfr, ixfr_apply_data_t *data) {
+ixfr_apply_one(dns_xfrin_t *xfr, xfrin_diff_t *data) {
 	isc_result_t result = ISC_R_SUCCESS;
 	uint64_t records;
 
@@ -540,8 +669,8 @@ ixfr_apply(void *arg) {
 
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+		xfrin_diff_t *data = caa_container_of(node, xfrin_diff_t,
+						      wfcq_node);
 
 		if (atomic_load(&xfr->shuttingdown)) {
 			result = ISC_R_SHUTTINGDOWN;
@@ -554,6 +683,7 @@ ixfr_apply(void *arg) {
 		}
 
 		/* We need to clear and free all data chunks */
+		work->applied += data->count;
 		dns_diff_clear(&data->diff);
 		isc_mem_put(xfr->mctx, data, sizeof(*data));
 	}
@@ -569,6 +699,12 @@ ixfr_apply_done(void *arg) {
 
 	REQUIRE(VALID_XFRIN(xfr));
 
+	INSIST(xfr->diff_queued >= work->applied);
+	xfr->diff_queued -= work->applied;
+	work->applied = 0;
+
+	xfrin_resume(xfr, result);
+
 	if (atomic_load(&xfr->shuttingdown)) {
 		result = ISC_R_SHUTTINGDOWN;
 	}
@@ -579,7 +715,8 @@ ixfr_apply_done(void *arg) {
 
 	/* Reschedule */
 	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
+		isc_work_enqueue_bulk(xfr->loop, ixfr_apply, ixfr_apply_done,
+				      work);
 		return;
 	}
 
@@ -598,6 +735,7 @@ failure:
 	} else {
 		dns_db_closeversion(xfr->db, &xfr->ver, false);
 
+		xfrin_resume(xfr, result);
 		xfrin_fail(xfr, result, "failed while processing responses");
 	}
 
@@ -610,21 +748,12 @@ failure:
 static isc_result_t
 ixfr_commit(dns_xfrin_t *xfr) {
 	isc_result_t result = ISC_R_SUCCESS;
-	ixfr_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
-
-	*data = (ixfr_apply_data_t){ 0 };
-	cds_wfcq_node_init(&data->wfcq_node);
 
 	if (xfr->ver == NULL) {
 		CHECK(dns_db_newversion(xfr->db, &xfr->ver));
 	}
 
-	dns_diff_init(xfr->mctx, &data->diff);
-	/* FIXME: Should we add dns_diff_move() */
-	ISC_LIST_MOVE(data->diff.tuples, xfr->diff.tuples);
-
-	(void)cds_wfcq_enqueue(&xfr->diff_head, &xfr->diff_tail,
-			       &data->wfcq_node);
+	xfrin_diff_enqueue(xfr);
 
 	if (!xfr->diff_running) {
 		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
@@ -633,7 +762,8 @@ ixfr_commit(dns_xfrin_t *xfr) {
 			.result = ISC_R_UNSET,
 		};
 		xfr->diff_running = true;
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
+		isc_work_enqueue_bulk(xfr->loop, ixfr_apply, ixfr_apply_done,
+				      work);
 	}
 
 failure:
@@ -852,6 +982,9 @@ redo:
 			atomic_store(&xfr->state, XFRST_AXFR_END);
 			break;
 		}
+		if (xfr->ndiff >= XFRIN_APPLY_BATCH) {
+			axfr_commit(xfr);
+		}
 		break;
 	case XFRST_AXFR_END:
 	case XFRST_IXFR_END:
@@ -1099,6 +1232,7 @@ xfrin_reset(dns_xfrin_t *xfr) {
 	}
 
 	dns_diff_clear(&xfr->diff);
+	xfr->ndiff = 0;
 
 	xfr->ixfr.diffs = 0;
 
@@ -1693,6 +1827,23 @@ xfrin_end(dns_xfrin_t *xfr, isc_result_t result) {
 	}
 }
 
+static isc_result_t
+xfrin_readnext(dns_xfrin_t *xfr) {
+	isc_result_t result;
+	isc_interval_t interval;
+
+	result = dns_dispatch_getnext(xfr->dispentry);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
+	isc_timer_start(xfr->max_idle_timer, isc_timertype_once, &interval);
+
+	LIBDNS_XFRIN_READ(xfr, xfr->info, result);
+	return (ISC_R_SUCCESS);
+}
+
 static void
 xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 	dns_xfrin_t *xfr = (dns_xfrin_t *)arg;
@@ -1732,8 +1883,13 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 	isc_buffer_init(&buffer, region->base, region->length);
 	isc_buffer_add(&buffer, region->length);
 
+	/*
+	 * The answer section is read straight from the wire below,
+	 * without building names and rdatasets that are only used once.
+	 */
 	result = dns_message_parse(msg, &buffer,
-				   DNS_MESSAGEPARSE_PRESERVEORDER);
+				   DNS_MESSAGEPARSE_PRESERVEORDER |
+					   DNS_MESSAGEPARSE_STREAMANSWER);
 	if (result == ISC_R_SUCCESS) {
 		dns_message_logpacket(
 			msg, "received message from", &xfr->primaryaddr,
@@ -1884,40 +2040,28 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 		goto failure;
 	}
 
-	for (result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
-	     result == ISC_R_SUCCESS;
-	     result = dns_message_nextname(msg, DNS_SECTION_ANSWER))
+	for (result = dns_message_firstrr(msg); result == ISC_R_SUCCESS;
+	     result = dns_message_nextrr(msg))
 	{
-		dns_rdataset_t *rds = NULL;
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_ttl_t ttl;
 
 		LIBDNS_XFRIN_RECV_ANSWER(xfr, xfr->info, msg);
 
 		name = NULL;
-		dns_message_currentname(msg, DNS_SECTION_ANSWER, &name);
-		for (rds = ISC_LIST_HEAD(name->list); rds != NULL;
-		     rds = ISC_LIST_NEXT(rds, link))
-		{
-			for (result = dns_rdataset_first(rds);
-			     result == ISC_R_SUCCESS;
-			     result = dns_rdataset_next(rds))
-			{
-				dns_rdata_t rdata = DNS_RDATA_INIT;
-				dns_rdataset_current(rds, &rdata);
-				CHECK(xfr_rr(xfr, name, rds->ttl, &rdata));
+		dns_message_currentrr(msg, &name, &ttl, &rdata);
+		CHECK(xfr_rr(xfr, name, ttl, &rdata));
 
-				/*
-				 * Did we hit the maximum ixfr diffs limit?
-				 */
-				if (xfr->reqtype == dns_rdatatype_ixfr &&
-				    xfr->ixfr.maxdiffs != 0 &&
-				    xfr->ixfr.diffs >= xfr->ixfr.maxdiffs)
-				{
-					xfrin_log(xfr, ISC_LOG_DEBUG(3),
-						  "too many diffs, "
-						  "retrying with AXFR");
-					goto try_axfr;
-				}
-			}
+		/*
+		 * Did we hit the maximum ixfr diffs limit?
+		 */
+		if (xfr->reqtype == dns_rdatatype_ixfr &&
+		    xfr->ixfr.maxdiffs != 0 &&
+		    xfr->ixfr.diffs >= xfr->ixfr.maxdiffs)
+		{
+			xfrin_log(xfr, ISC_LOG_DEBUG(3),
+				  "too many diffs, retrying with AXFR");
+			goto try_axfr;
 		}
 	}
 	if (result == ISC_R_NOMORE) {
@@ -1985,21 +2129,25 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 		xfrin_cancelio(xfr);
 		break;
 	default:
+		dns_message_detach(&msg);
+
 		/*
-		 * Read the next message.
+		 * If the apply job is falling behind, stop reading
+		 * until it catches up; xfrin_resume() will then read
+		 * the next message with the reference we are holding.
 		 */
-		dns_message_detach(&msg);
-		result = dns_dispatch_getnext(xfr->dispentry);
-		if (result != ISC_R_SUCCESS) {
-			goto failure;
+		if (xfr->diff_queued > dns_xfrin_maxqueued) {
+			xfrin_log(xfr, ISC_LOG_DEBUG(10),
+				  "pausing receive, %u changes queued",
+				  xfr->diff_queued);
+			xfr->recv_paused = true;
+			return;
 		}
 
-		isc_interval_t interval;
-		isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
-		isc_timer_start(xfr->max_idle_timer, isc_timertype_once,
-				&interval);
-
-		LIBDNS_XFRIN_READ(xfr, xfr->info, result);
+		/*
+		 * Read the next message.
+		 */
+		CHECK(xfrin_readnext(xfr));
 		return;
 	}
 
@@ -2055,18 +2203,18 @@ xfrin_destroy(dns_xfrin_t *xfr) {
 		  (unsigned int)(msecs / 1000), (unsigned int)(msecs % 1000),
 		  (unsigned int)persec, atomic_load_relaxed(&xfr->end_serial));
 
-	/* Cleanup unprocessed IXFR data */
+	/* Cleanup unprocessed AXFR and IXFR data */
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&xfr->diff_head, &xfr->diff_tail,
 					  node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+		xfrin_diff_t *data = caa_container_of(node, xfrin_diff_t,
+						      wfcq_node);
 		/* We need to clear and free all data chunks */
 		dns_diff_clear(&data->diff);
 		isc_mem_put(xfr->mctx, data, sizeof(*data));
 	}
 
-	/* Cleanup unprocessed AXFR data */
+	/* Cleanup data that was never queued */
 	dns_diff_clear(&xfr->diff);
 
 	xfrin_cancelio(xfr);
@@ -43,6 +43,7 @@
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/acl.h>
 #include <dns/adb.h>
@@ -79,6 +80,7 @@
 #include <dns/request.h>
 #include <dns/resolver.h>
 #include <dns/rriterator.h>
+#include <dns/sigcache.h>
 #include <dns/skr.h>
 #include <dns/soa.h>
 #include <dns/ssu.h>
@@ -89,11 +91,14 @@
 #include <dns/update.h>
 #include <dns/xfrin.h>
 #include <dns/zone.h>
+#include <dns/zonecounters.h>
 #include <dns/zoneverify.h>
 #include <dns/zt.h>
 
 #include <dst/dst.h>
 
+#include "compactdb_p.h"
+#include "qpzone_p.h"
 #include "zone_p.h"
 
 #define ZONE_MAGIC	     ISC_MAGIC('Z', 'O', 'N', 'E')
@@ -167,7 +172,19 @@
 #define DNS_DUMP_DELAY 900 /*%< 15 minutes */
 #endif			   /* ifndef DNS_DUMP_DELAY */
 
+#ifndef DNS_DEMAND_IDLE
+#define DNS_DEMAND_IDLE 3600 /*%< 1 hour */
+#endif			     /* ifndef DNS_DEMAND_IDLE */
+
+/*%
+ * A destination that keeps answering may be sent up to this many times
+ * 'notify-rate' NOTIFY requests or 'serial-query-rate' SOA queries per
+ * second.
+ */
+#define DEST_RATE_GROWTH 16
+
 typedef struct dns_notify dns_notify_t;
+typedef struct dns_ratedest dns_ratedest_t;
 typedef struct dns_checkds dns_checkds_t;
 typedef struct dns_stub dns_stub_t;
 typedef struct dns_load dns_load_t;
@@ -182,6 +199,8 @@ typedef struct dns_nsfetch dns_nsfetch_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
 typedef struct dns_include dns_include_t;
+typedef struct dns_journalwait dns_journalwait_t;
+typedef struct signbatch signbatch_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -296,6 +315,7 @@ struct dns_zone {
 	isc_time_t refreshtime;
 	isc_time_t dumptime;
 	isc_time_t loadtime;
+	atomic_uint_fast32_t demandtime; /* last query, load-on-demand */
 	isc_time_t notifytime;
 	isc_time_t resigntime;
 	isc_time_t keywarntime;
@@ -368,6 +388,8 @@ struct dns_zone {
 	uint32_t sigvalidityinterval;
 	uint32_t keyvalidityinterval;
 	uint32_t sigresigninginterval;
+	dns_sigcache_t *sigcache;
+	dns_dnsseckeycache_t *keycache;
 	dns_view_t *view;
 	dns_view_t *prev_view;
 	dns_kasp_t *kasp;
@@ -398,6 +420,9 @@ struct dns_zone {
 	isc_stats_t *requeststats;
 	dns_stats_t *rcvquerystats;
 	dns_stats_t *dnssecsignstats;
+	bool counters_on;
+	dns_zonecounters_t *counters;
+	uint32_t counterslot;
 	uint32_t notifydelay;
 	dns_isselffunc_t isself;
 	void *isselfarg;
@@ -415,6 +440,10 @@ struct dns_zone {
 	 * Keys that are signing the zone for the first time.
 	 */
 	dns_signinglist_t signing;
+	/*%
+	 * Signatures being computed for the next zone_sign() pass.
+	 */
+	signbatch_t *signbatch;
 	dns_nsec3chainlist_t nsec3chain;
 	/*%
 	 * List of outstanding NSEC3PARAM change requests.
@@ -442,6 +471,12 @@ struct dns_zone {
 	 */
 	bool automatic;
 
+	/*%
+	 * Hash of the configuration the zone was last configured with,
+	 * or zero if unknown.
+	 */
+	uint64_t confighash;
+
 	/*%
 	 * response policy data to be relayed to the database
 	 */
@@ -480,6 +515,14 @@ struct dns_zone {
 	 */
 	dns_forwardlist_t forwards;
 
+	/*%
+	 * Journal group commit: the journal that transactions are being
+	 * collected in, and the callers waiting for them to be synced.
+	 */
+	isc_mutex_t jglock;
+	dns_journal_t *jgroup;
+	ISC_LIST(dns_journalwait_t) jwaiters;
+
 	dns_zone_t *raw;
 	dns_zone_t *secure;
 
@@ -565,6 +608,8 @@ typedef enum {
 						      * just being loaded for
 						      * the first time. */
 	DNS_ZONEFLG_FIRSTREFRESH = 0x100000000U, /*%< First refresh pending */
+	DNS_ZONEFLG_COMPACTING = 0x200000000U,	 /*%< Journal compaction is
+						  * running in the background */
 	DNS_ZONEFLG___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneflg_t;
 
@@ -609,10 +654,9 @@ struct dns_zonemgr {
 	isc_loopmgr_t *loopmgr;
 	isc_nm_t *netmgr;
 	uint32_t workers;
+	uint32_t firstloop; /* see dns_zonemgr_setmaintloops() */
 	isc_mem_t **mctxpool;
 	isc_ratelimiter_t *checkdsrl;
-	isc_ratelimiter_t *notifyrl;
-	isc_ratelimiter_t *refreshrl;
 	isc_ratelimiter_t *startupnotifyrl;
 	isc_ratelimiter_t *startuprefreshrl;
 	isc_rwlock_t rwlock;
@@ -640,6 +684,45 @@ struct dns_zonemgr {
 
 	isc_tlsctx_cache_t *tlsctx_cache;
 	isc_rwlock_t tlsctx_cache_rwlock;
+
+	/* Zone file loads, one queue per loop; see zonemgr_queueload(). */
+	struct zonemgr_loadq *loadq;
+	atomic_uint_fast64_t loads_pending; /* queued or in progress */
+	atomic_uint_fast64_t loads_done;    /* since loads_started */
+	atomic_uint_fast32_t loads_started;
+
+	/*
+	 * NOTIFY destinations, each with its own rate limiter, and the
+	 * NOTIFY requests waiting to be sent, oldest first.  Locked by
+	 * notifylock.
+	 */
+	isc_mutex_t notifylock;
+	isc_hashmap_t *notifydests;
+	ISC_LIST(dns_notify_t) notifyq;
+	unsigned int notifyqueued;
+	bool notifyshutdown;
+
+	/*
+	 * Primaries SOA queries are sent to, each with its own rate
+	 * limiter.  Locked by refreshlock.
+	 */
+	isc_mutex_t refreshlock;
+	isc_hashmap_t *refreshdests;
+	bool refreshshutdown;
+
+	/* Run times of zone maintenance jobs, in microseconds. */
+	isc_histomulti_t *jobtime[dns_zonejob_max];
+};
+
+/*%
+ * Per-destination pacing of NOTIFY requests and SOA queries: 'rate'
+ * starts at the configured rate, grows while the destination answers
+ * and is halved when it stops answering.
+ */
+struct dns_ratedest {
+	isc_sockaddr_t addr;
+	isc_ratelimiter_t *rl;
+	unsigned int rate;
 };
 
 /*%
@@ -659,6 +742,10 @@ struct dns_notify {
 	dns_transport_t *transport;
 	ISC_LINK(dns_notify_t) link;
 	isc_rlevent_t *rlevent;
+	dns_zonemgr_t *zmgr; /* whose notifyq 'qlink' is on */
+	dns_ratedest_t *dest;
+	isc_time_t queued;
+	ISC_LINK(dns_notify_t) qlink;
 };
 
 typedef enum dns_notify_flags {
@@ -709,6 +796,15 @@ struct dns_load {
 	dns_db_t *db;
 	isc_time_t loadtime;
 	dns_rdatacallbacks_t callbacks;
+	unsigned int options;
+	dns_zonemgr_t *zmgr;
+	ISC_LINK(dns_load_t) link;
+};
+
+struct zonemgr_loadq {
+	isc_mutex_t lock;
+	unsigned int active;
+	ISC_LIST(dns_load_t) pending;
 };
 
 /*%
@@ -819,6 +915,15 @@ struct dns_include {
 	ISC_LINK(dns_include_t) link;
 };
 
+/*%
+ * A transaction waiting for its journal group to be synced
+ */
+struct dns_journalwait {
+	dns_zone_journalcb_t cb;
+	void *arg;
+	ISC_LINK(dns_journalwait_t) link;
+};
+
 /*
  * These can be overridden by the -T mkeytimers option on the command
  * line, so that we can test with shorter periods than specified in
@@ -866,6 +971,10 @@ update_one_rr(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff,
 static void
 zone_unload(dns_zone_t *zone);
 static void
+zone_sign(dns_zone_t *zone);
+static bool
+zone_mayunload(dns_zone_t *zone);
+static void
 zone_expire(dns_zone_t *zone);
 static void
 zone_refresh(dns_zone_t *zone);
@@ -873,6 +982,8 @@ static void
 zone_iattach(dns_zone_t *source, dns_zone_t **target);
 static void
 zone_idetach(dns_zone_t **zonep);
+static void
+zone_journal_flush(dns_zone_t *zone);
 static isc_result_t
 zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump);
 static void
@@ -917,6 +1028,9 @@ queue_soa_query(dns_zone_t *zone);
 static void
 soa_query(void *arg);
 static void
+soa_query_done(dns_zonemgr_t *zmgr, const isc_sockaddr_t *addr,
+	       isc_result_t result);
+static void
 ns_query(dns_zone_t *zone, dns_rdataset_t *soardataset, dns_stub_t *stub);
 static int
 message_count(dns_message_t *msg, dns_section_t section, dns_rdatatype_t type);
@@ -950,6 +1064,10 @@ notify_done(void *arg);
 static void
 notify_send_toaddr(void *arg);
 static isc_result_t
+notify_send_queue(dns_notify_t *notify, bool startup);
+static void
+notify_unqueue(dns_notify_t *notify);
+static isc_result_t
 zone_dump(dns_zone_t *, bool);
 static void
 got_transfer_quota(void *arg);
@@ -994,6 +1112,10 @@ static dns_ttl_t
 zone_nsecttl(dns_zone_t *zone);
 static void
 setrl(isc_ratelimiter_t *rl, unsigned int *rate, unsigned int value);
+static isc_result_t
+zonemgr_queueload(dns_zonemgr_t *zmgr, dns_load_t *load);
+static void
+zonemgr_loaddone(dns_load_t *load);
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial);
 static isc_result_t
@@ -1100,6 +1222,13 @@ inc_stats(dns_zone_t *zone, isc_statscounter_t counter) {
 	}
 }
 
+static void
+add_stats(dns_zone_t *zone, isc_statscounter_t counter, uint64_t value) {
+	if (zone->stats != NULL) {
+		isc_stats_add(zone->stats, counter, (isc_statscounter_t)value);
+	}
+}
+
 /***
  ***	Public functions.
  ***/
@@ -1108,13 +1237,23 @@ void
 dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 	isc_time_t now;
 	dns_zone_t *zone = NULL;
+	isc_mem_t *zmctx = NULL;
 
 	REQUIRE(zonep != NULL && *zonep == NULL);
 	REQUIRE(mctx != NULL);
 
+	/*
+	 * Every zone gets its own accounting context, so that the memory
+	 * used by the zone and its databases shows up separately in the
+	 * statistics; it is renamed whenever the zone name changes.
+	 */
+	isc_mem_createchild(mctx, &zmctx);
+	isc_mem_setname(zmctx, "zone");
+
 	now = isc_time_now();
-	zone = isc_mem_get(mctx, sizeof(*zone));
+	zone = isc_mem_get(zmctx, sizeof(*zone));
 	*zone = (dns_zone_t){
+		.mctx = zmctx,
 		.masterformat = dns_masterformat_none,
 		.journalsize = -1,
 		.rdclass = dns_rdataclass_none,
@@ -1154,6 +1293,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 		.nsec3chain = ISC_LIST_INITIALIZER,
 		.setnsec3param_queue = ISC_LIST_INITIALIZER,
 		.forwards = ISC_LIST_INITIALIZER,
+		.jwaiters = ISC_LIST_INITIALIZER,
 		.link = ISC_LINK_INITIALIZER,
 		.statelink = ISC_LINK_INITIALIZER,
 	};
@@ -1161,8 +1301,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 		.magic = DNS_REMOTE_MAGIC,
 	};
 
-	isc_mem_attach(mctx, &zone->mctx);
 	isc_mutex_init(&zone->lock);
+	isc_mutex_init(&zone->jglock);
 	ZONEDB_INITLOCK(&zone->dblock);
 
 	isc_refcount_init(&zone->references, 1);
@@ -1182,7 +1322,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 	zone->defaultkasp = NULL;
 	ISC_LIST_INIT(zone->keyring);
 
-	isc_stats_create(mctx, &zone->gluecachestats,
+	isc_stats_create(zone->mctx, &zone->gluecachestats,
 			 dns_gluecachestatscounter_max);
 
 	zone->magic = ZONE_MAGIC;
@@ -1230,6 +1370,7 @@ zone_free(dns_zone_t *zone) {
 	INSIST(zone->statelist == NULL);
 	INSIST(zone->view == NULL);
 	INSIST(zone->prev_view == NULL);
+	INSIST(zone->signbatch == NULL);
 
 	/* Unmanaged objects */
 	for (struct np3 *npe = ISC_LIST_HEAD(zone->setnsec3param_queue);
@@ -1273,6 +1414,12 @@ zone_free(dns_zone_t *zone) {
 		isc_mem_free(zone->mctx, zone->masterfile);
 	}
 	zone->masterfile = NULL;
+	if (zone->sigcache != NULL) {
+		dns_sigcache_destroy(&zone->sigcache);
+	}
+	if (zone->keycache != NULL) {
+		dns_dnsseckeycache_destroy(&zone->keycache);
+	}
 	if (zone->keydirectory != NULL) {
 		isc_mem_free(zone->mctx, zone->keydirectory);
 	}
@@ -1311,6 +1458,10 @@ zone_free(dns_zone_t *zone) {
 	if (zone->dnssecsignstats != NULL) {
 		dns_stats_detach(&zone->dnssecsignstats);
 	}
+	if (zone->counters != NULL) {
+		dns_zonecounters_release(zone->counters, zone->counterslot);
+		dns_zonecounters_detach(&zone->counters);
+	}
 	if (zone->db != NULL) {
 		zone_detachdb(zone);
 	}
@@ -1373,7 +1524,10 @@ zone_free(dns_zone_t *zone) {
 	}
 
 	/* last stuff */
+	INSIST(zone->jgroup == NULL);
+	INSIST(ISC_LIST_EMPTY(zone->jwaiters));
 	ZONEDB_DESTROYLOCK(&zone->dblock);
+	isc_mutex_destroy(&zone->jglock);
 	isc_mutex_destroy(&zone->lock);
 	zone->magic = 0;
 	isc_mem_putanddetach(&zone->mctx, zone, sizeof(*zone));
@@ -1433,6 +1587,7 @@ dns_zone_setclass(dns_zone_t *zone, dns_rdataclass_t rdclass) {
 
 	zone_namerd_tostr(zone, namebuf, sizeof namebuf);
 	zone->strnamerd = isc_mem_strdup(zone->mctx, namebuf);
+	isc_mem_setname(zone->mctx, namebuf);
 	zone_rdclass_tostr(zone, namebuf, sizeof namebuf);
 	zone->strrdclass = isc_mem_strdup(zone->mctx, namebuf);
 
@@ -1516,6 +1671,7 @@ dns_zone_settype(dns_zone_t *zone, dns_zonetype_t type) {
 
 	zone_namerd_tostr(zone, namebuf, sizeof namebuf);
 	zone->strnamerd = isc_mem_strdup(zone->mctx, namebuf);
+	isc_mem_setname(zone->mctx, namebuf);
 	UNLOCK_ZONE(zone);
 }
 
@@ -1624,6 +1780,7 @@ dns_zone_setview_helper(dns_zone_t *zone, dns_view_t *view) {
 
 	zone_namerd_tostr(zone, namebuf, sizeof namebuf);
 	zone->strnamerd = isc_mem_strdup(zone->mctx, namebuf);
+	isc_mem_setname(zone->mctx, namebuf);
 	zone_viewname_tostr(zone, namebuf, sizeof namebuf);
 	zone->strviewname = isc_mem_strdup(zone->mctx, namebuf);
 
@@ -1705,6 +1862,7 @@ dns_zone_setorigin(dns_zone_t *zone, const dns_name_t *origin) {
 
 	zone_namerd_tostr(zone, namebuf, sizeof namebuf);
 	zone->strnamerd = isc_mem_strdup(zone->mctx, namebuf);
+	isc_mem_setname(zone->mctx, namebuf);
 	zone_name_tostr(zone, namebuf, sizeof namebuf);
 	zone->strname = isc_mem_strdup(zone->mctx, namebuf);
 
@@ -1926,6 +2084,7 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 		return;
 	}
 	REQUIRE(zone->rpzs != NULL);
+	dns_rpz_setjournal(zone->rpzs->zones[zone->rpz_num], zone->journal);
 	dns_rpz_dbupdate_register(db, zone->rpzs->zones[zone->rpz_num]);
 }
 
@@ -1947,6 +2106,7 @@ dns_zone_catz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(db != NULL);
 
 	if (zone->catzs != NULL) {
+		dns_catz_setjournal(zone->catzs, &zone->origin, zone->journal);
 		dns_catz_dbupdate_register(db, zone->catzs);
 	}
 }
@@ -2616,6 +2776,10 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_MANYERRORS)) {
 		options |= DNS_MASTER_MANYERRORS;
 	}
+	if (zone->masterformat == dns_masterformat_text) {
+		/* Large text zone files are parsed on several threads. */
+		options |= DNS_MASTER_PARALLEL;
+	}
 
 	zone_iattach(zone, &load->zone);
 	dns_db_attach(db, &load->db);
@@ -2630,12 +2794,8 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	}
 
 	if (zone->zmgr != NULL && zone->db != NULL) {
-		result = dns_master_loadfileasync(
-			zone->masterfile, dns_db_origin(db), dns_db_origin(db),
-			zone->rdclass, options, 0, &load->callbacks, zone->loop,
-			zone_loaddone, load, &zone->loadctx,
-			zone_registerinclude, zone, zone->mctx,
-			zone->masterformat, zone->maxttl);
+		load->options = options;
+		result = zonemgr_queueload(zone->zmgr, load);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -4347,6 +4507,46 @@ failure:
 	return (result);
 }
 
+/*
+ * Sync the transactions collected in the journal group of 'zone', if
+ * there are any, and tell the callers that were waiting for them.
+ * This must be done before anything else opens the journal file, as
+ * its header on disk does not include the group yet.
+ */
+static void
+zone_journal_flush(dns_zone_t *zone) {
+	ISC_LIST(dns_journalwait_t) waiters = ISC_LIST_INITIALIZER;
+	dns_journalwait_t *w = NULL, *next = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	LOCK(&zone->jglock);
+	if (zone->jgroup != NULL) {
+		result = dns_journal_sync(zone->jgroup);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "dns_journal_sync -> %s",
+				     isc_result_totext(result));
+		}
+		dns_journal_destroy(&zone->jgroup);
+	}
+	ISC_LIST_MOVE(waiters, zone->jwaiters);
+	UNLOCK(&zone->jglock);
+
+	ISC_LIST_FOREACH_SAFE (waiters, w, link, next) {
+		ISC_LIST_UNLINK(waiters, w, link);
+		(w->cb)(result, w->arg);
+		isc_mem_put(zone->mctx, w, sizeof(*w));
+	}
+}
+
+static void
+zone_journal_groupdone(void *arg) {
+	dns_zone_t *zone = (dns_zone_t *)arg;
+
+	zone_journal_flush(zone);
+	dns_zone_idetach(&zone);
+}
+
 /*
  * Write all transactions in 'diff' to the zone journal file.
  */
@@ -4361,6 +4561,7 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	ENTER;
 	journalfile = dns_zone_getjournal(zone);
 	if (journalfile != NULL) {
+		zone_journal_flush(zone);
 		result = dns_journal_open(zone->mctx, journalfile, mode,
 					  &journal);
 		if (result != ISC_R_SUCCESS) {
@@ -4386,6 +4587,78 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	return (result);
 }
 
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff,
+		      dns_zone_journalcb_t cb, void *arg) {
+	isc_result_t result;
+	dns_journalwait_t *w = NULL;
+	dns_zone_t *dummy = NULL;
+	bool first;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(cb != NULL);
+
+	if (zone->journal == NULL || zone->loop == NULL ||
+	    !DNS_ZONE_OPTION(zone, DNS_ZONEOPT_JOURNALGROUP))
+	{
+		return (zone_journal(zone, diff, NULL, __func__));
+	}
+
+	LOCK(&zone->jglock);
+	first = (zone->jgroup == NULL);
+	if (first) {
+		unsigned int mode = DNS_JOURNAL_CREATE | DNS_JOURNAL_GROUP;
+
+		result = dns_journal_open(zone->mctx, zone->journal, mode,
+					  &zone->jgroup);
+		if (result != ISC_R_SUCCESS) {
+			UNLOCK(&zone->jglock);
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "%s:dns_journal_open -> %s", __func__,
+				     isc_result_totext(result));
+			return (result);
+		}
+	}
+
+	result = dns_journal_write_transaction(zone->jgroup, diff);
+	if (result != ISC_R_SUCCESS) {
+		UNLOCK(&zone->jglock);
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "%s:dns_journal_write_transaction -> %s",
+			     __func__, isc_result_totext(result));
+		/*
+		 * The journal may be left in the middle of the failed
+		 * transaction; sync the rest of the group and start
+		 * over with the next one.
+		 */
+		zone_journal_flush(zone);
+		return (result);
+	}
+
+	w = isc_mem_get(zone->mctx, sizeof(*w));
+	*w = (dns_journalwait_t){
+		.cb = cb,
+		.arg = arg,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	ISC_LIST_APPEND(zone->jwaiters, w, link);
+	UNLOCK(&zone->jglock);
+
+	/*
+	 * Everything that is already queued on the zone's loop, which
+	 * includes the UPDATE requests that arrived while this one was
+	 * being processed, runs before the group is synced.
+	 */
+	if (first) {
+		LOCK_ZONE(zone);
+		zone_iattach(zone, &dummy);
+		UNLOCK_ZONE(zone);
+		isc_async_run(zone->loop, zone_journal_groupdone, dummy);
+	}
+
+	return (DNS_R_CONTINUE);
+}
+
 /*
  * Create an SOA record for a newly-created zone
  */
@@ -4916,6 +5189,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		dns_journal_t *journal = NULL;
 		bool empty = false;
 
+		zone_journal_flush(zone);
 		result = dns_journal_open(zone->mctx, zone->journal,
 					  DNS_JOURNAL_READ, &journal);
 		if (result == ISC_R_SUCCESS) {
@@ -5187,6 +5461,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADED |
 					       DNS_ZONEFLG_NEEDSTARTUPNOTIFY);
+		atomic_store_relaxed(&zone->demandtime, isc_stdtime_now());
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_SENDSECURE) &&
 		    inline_raw(zone))
 		{
@@ -6851,6 +7126,93 @@ failure:
 	return (result);
 }
 
+static char *
+sigcache_filename(dns_zone_t *zone, const char *masterfile) {
+	size_t len = strlen(masterfile) + sizeof(".sigs");
+	char *filename = isc_mem_allocate(zone->mctx, len);
+
+	strlcpy(filename, masterfile, len);
+	strlcat(filename, ".sigs", len);
+	return (filename);
+}
+
+/*
+ * Return the zone's signature cache, or NULL if it does not use one.
+ * The cache is created, and loaded from "<masterfile>.sigs", the first
+ * time it is needed.
+ */
+static dns_sigcache_t *
+zone_getsigcache(dns_zone_t *zone) {
+	dns_sigcache_t *sigcache = NULL;
+	char *filename = NULL;
+	isc_result_t result;
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_SIGCACHE)) {
+		return (NULL);
+	}
+
+	LOCK_ZONE(zone);
+	if (zone->sigcache == NULL) {
+		dns_sigcache_create(zone->mctx, &zone->sigcache);
+		if (zone->masterfile != NULL) {
+			filename = sigcache_filename(zone, zone->masterfile);
+		}
+	}
+	sigcache = zone->sigcache;
+	UNLOCK_ZONE(zone);
+
+	if (filename != NULL) {
+		result = dns_sigcache_load(sigcache, filename);
+		if (result != ISC_R_SUCCESS && result != ISC_R_FILENOTFOUND) {
+			dns_zone_log(zone, ISC_LOG_WARNING,
+				     "loading signature cache '%s': %s",
+				     filename, isc_result_totext(result));
+		}
+		isc_mem_free(zone->mctx, filename);
+	}
+
+	return (sigcache);
+}
+
+/*
+ * Sign 'rdataset' like dns_dnssec_sign() does, unless 'sigcache' has a
+ * signature made with the same key that is already valid and that stays
+ * valid past 'resign', the expiry time of a signature that is due for
+ * re-signing now, for at least half as long as the new one would.  New
+ * signatures are added to the cache.  '*cached' tells whether the cache
+ * was used.
+ */
+static isc_result_t
+sign_rdataset(dns_sigcache_t *sigcache, dns_name_t *name,
+	      dns_rdataset_t *rdataset, dst_key_t *key, isc_stdtime_t now,
+	      isc_stdtime_t resign, isc_stdtime_t *inception,
+	      isc_stdtime_t *expire, isc_mem_t *mctx, isc_buffer_t *buffer,
+	      dns_rdata_t *sigrdata, bool *cached) {
+	isc_result_t result;
+	isc_stdtime_t minexpire = *expire;
+
+	*cached = false;
+
+	if (sigcache != NULL) {
+		if (*expire > resign) {
+			minexpire = resign + (*expire - resign) / 2;
+		}
+		result = dns_sigcache_find(sigcache, name, rdataset, key, now,
+					   minexpire, buffer, sigrdata);
+		if (result == ISC_R_SUCCESS) {
+			*cached = true;
+			return (ISC_R_SUCCESS);
+		}
+	}
+
+	result = dns_dnssec_sign(name, rdataset, key, inception, expire, mctx,
+				 buffer, sigrdata);
+	if (result == ISC_R_SUCCESS && sigcache != NULL) {
+		dns_sigcache_add(sigcache, name, rdataset, key, sigrdata);
+	}
+	return (result);
+}
+
 static isc_result_t
 add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
@@ -6859,6 +7221,9 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 	isc_result_t result;
 	dns_dbnode_t *node = NULL;
 	dns_stats_t *dnssecsignstats;
+	dns_sigcache_t *sigcache = zone_getsigcache(zone);
+	isc_stdtime_t resign = now + zone->sigresigninginterval;
+	bool cached = false;
 	dns_rdataset_t rdataset;
 	dns_rdata_t sig_rdata = DNS_RDATA_INIT;
 	unsigned char data[1024]; /* XXX */
@@ -7010,6 +7375,7 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
+		cached = false;
 
 		if (offlineksk && dns_rdatatype_iskeymaterial(type)) {
 			/* Look up the signature in the SKR bundle */
@@ -7020,9 +7386,10 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 			CHECK(dns_skrbundle_getsig(bundle, keys[i], type,
 						   &sig_rdata));
 		} else {
-			CHECK(dns_dnssec_sign(name, &rdataset, keys[i],
-					      &inception, &expire, mctx,
-					      &buffer, &sig_rdata));
+			CHECK(sign_rdataset(sigcache, name, &rdataset, keys[i],
+					    now, resign, &inception, &expire,
+					    mctx, &buffer, &sig_rdata,
+					    &cached));
 		}
 
 		/* Update the database and journal with the RRSIG. */
@@ -7036,10 +7403,12 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 		dnssecsignstats = dns_zone_getdnssecsignstats(zone);
 		if (dnssecsignstats != NULL) {
 			/* Generated a new signature. */
-			dns_dnssecsignstats_increment(dnssecsignstats,
-						      ID(keys[i]),
-						      (uint8_t)ALG(keys[i]),
-						      dns_dnssecsignstats_sign);
+			if (!cached) {
+				dns_dnssecsignstats_increment(
+					dnssecsignstats, ID(keys[i]),
+					(uint8_t)ALG(keys[i]),
+					dns_dnssecsignstats_sign);
+			}
 			/* This is a refresh. */
 			dns_dnssecsignstats_increment(
 				dnssecsignstats, ID(keys[i]),
@@ -7105,6 +7474,17 @@ calculate_rrsig_validity(dns_zone_t *zone, isc_stdtime_t now,
 	SET_IF_NOT_NULL(fullexpire, *soaexpire - fulljitter - 1);
 }
 
+/*
+ * Whether a signing job that has made some progress ('done' is true)
+ * should stop early and let the loop process other events.  The job is
+ * rescheduled by the zone maintenance as if it had run out of its
+ * node or signature quantum.
+ */
+static bool
+signing_yield(bool done) {
+	return (done && isc_loop_shouldyield());
+}
+
 static void
 zone_resigninc(dns_zone_t *zone) {
 	dns_db_t *db = NULL;
@@ -7190,7 +7570,8 @@ zone_resigninc(dns_zone_t *zone) {
 		/* XXXMPA increase number of RRsets signed pre call */
 		if ((covers == dns_rdatatype_soa &&
 		     dns_name_equal(name, &zone->origin)) ||
-		    i++ > zone->signatures || resign > stop)
+		    i++ > zone->signatures || resign > stop ||
+		    signing_yield(i > 1))
 		{
 			break;
 		}
@@ -7505,67 +7886,492 @@ failure:
 	return (result);
 }
 
-static isc_result_t
-sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
-	    dns_dbnode_t *node, dns_dbversion_t *version, bool build_nsec3,
-	    bool build_nsec, dst_key_t *key, isc_stdtime_t now,
-	    isc_stdtime_t inception, isc_stdtime_t expire, dns_ttl_t nsecttl,
-	    bool both, bool is_ksk, bool is_zsk, bool is_bottom_of_zone,
-	    dns_diff_t *diff, int32_t *signatures, isc_mem_t *mctx) {
-	isc_result_t result;
-	dns_rdatasetiter_t *iterator = NULL;
+/*
+ * The RRSIGs needed by one quantum of zone_sign().
+ *
+ * Walking the zone and updating the database has to happen on the zone's
+ * loop, but the signatures do not depend on each other.  zone_sign()
+ * therefore makes each quantum in two passes.  The first pass walks the
+ * nodes as usual but only queues here the RRsets that need signing,
+ * with copies of their records, and is then rolled back.  The queued
+ * signatures are computed on the offload threads, and when the last of
+ * them is done signbatch_done() calls zone_sign() again.  The second
+ * pass walks the same nodes for real, taking each signature from the
+ * batch if the RRset it covers has not changed in between, and adds it
+ * to the database before the next RRset is looked at, as if it had just
+ * been computed.
+ */
+typedef struct signjob {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdatalist_t rdatalist;
 	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	dns_stats_t *dnssecsignstats;
-	bool offlineksk = false;
-	isc_buffer_t buffer;
+	dns_rdata_t *rdatas;
+	unsigned int nrdatas;
+	unsigned char *rdatabuf;
+	size_t rdatabuflen;
+	dst_key_t *key;
+	isc_stdtime_t inception;
+	isc_stdtime_t expire;
+	dns_rdata_t rdata;
 	unsigned char data[1024];
-	bool seen_soa, seen_ns, seen_rr, seen_nsec, seen_nsec3, seen_ds;
+	isc_result_t result;
+	bool cached;
+} signjob_t;
 
-	if (zone->kasp != NULL) {
-		offlineksk = dns_kasp_offlineksk(zone->kasp);
+/*
+ * Where the signing iterators were when the first pass started.
+ */
+typedef struct signpos {
+	dns_signing_t *signing;
+	dns_fixedname_t fname;
+	bool positioned;
+} signpos_t;
+
+struct signbatch {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	dns_zone_t *zone; /* while the signatures are computed */
+	bool collect;	  /* queue RRsets rather than sign them */
+	signjob_t **jobs;
+	size_t count;
+	size_t size;
+	size_t cursor; /* where signbatch_find() looks first */
+	signpos_t *positions;
+	size_t npositions;
+	dns_sigcache_t *sigcache;
+	isc_stdtime_t now;
+	isc_stdtime_t resign;
+	atomic_size_t next;
+	unsigned int pending; /* offload jobs not done yet [zone loop] */
+	isc_nanosecs_t start; /* when the first pass started */
+};
+
+static signbatch_t *
+signbatch_new(isc_mem_t *mctx) {
+	signbatch_t *batch = isc_mem_get(mctx, sizeof(*batch));
+	*batch = (signbatch_t){
+		.references = ISC_REFCOUNT_INITIALIZER(1),
+		.collect = true,
+		.start = isc_time_monotonic(),
+	};
+	isc_mem_attach(mctx, &batch->mctx);
+
+	return (batch);
+}
+
+static void
+signbatch_detach(signbatch_t **batchp) {
+	signbatch_t *batch = *batchp;
+	*batchp = NULL;
+
+	if (isc_refcount_decrement(&batch->references) > 1) {
+		return;
 	}
 
-	result = dns_db_allrdatasets(db, node, version, 0, 0, &iterator);
-	if (result != ISC_R_SUCCESS) {
-		if (result == ISC_R_NOTFOUND) {
-			result = ISC_R_SUCCESS;
+	INSIST(batch->zone == NULL);
+
+	for (size_t i = 0; i < batch->count; i++) {
+		signjob_t *job = batch->jobs[i];
+		dns_rdataset_disassociate(&job->rdataset);
+		isc_mem_cput(batch->mctx, job->rdatas, job->nrdatas,
+			     sizeof(job->rdatas[0]));
+		isc_mem_put(batch->mctx, job->rdatabuf, job->rdatabuflen);
+		dst_key_free(&job->key);
+		isc_mem_put(batch->mctx, job, sizeof(*job));
+	}
+	if (batch->jobs != NULL) {
+		isc_mem_cput(batch->mctx, batch->jobs, batch->size,
+			     sizeof(batch->jobs[0]));
+	}
+	if (batch->positions != NULL) {
+		isc_mem_cput(batch->mctx, batch->positions, batch->npositions,
+			     sizeof(batch->positions[0]));
+	}
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
+/*
+ * Queue 'rdataset' to be signed with 'key', unless it already is.  The
+ * records are copied, since the first pass is rolled back before the
+ * signatures are computed.
+ */
+static void
+signbatch_add(signbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	      dst_key_t *key, isc_stdtime_t inception, isc_stdtime_t expire) {
+	signjob_t *job = NULL;
+	unsigned char *p = NULL;
+	unsigned int i = 0;
+	size_t length = 0;
+	isc_result_t result;
+
+	for (size_t j = 0; j < batch->count; j++) {
+		job = batch->jobs[j];
+		if (job->rdataset.type == rdataset->type &&
+		    dst_key_alg(job->key) == dst_key_alg(key) &&
+		    dst_key_id(job->key) == dst_key_id(key) &&
+		    dns_name_equal(job->name, name))
+		{
+			return;
 		}
-		return (result);
 	}
 
-	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
-	seen_rr = seen_soa = seen_ns = seen_nsec = seen_nsec3 = seen_ds = false;
-	for (result = dns_rdatasetiter_first(iterator); result == ISC_R_SUCCESS;
-	     result = dns_rdatasetiter_next(iterator))
+	job = isc_mem_get(batch->mctx, sizeof(*job));
+	*job = (signjob_t){
+		.nrdatas = dns_rdataset_count(rdataset),
+		.inception = inception,
+		.expire = expire,
+		.rdata = DNS_RDATA_INIT,
+		.result = ISC_R_UNSET,
+	};
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name);
+	dst_key_attach(key, &job->key);
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
 	{
-		dns_rdatasetiter_current(iterator, &rdataset);
-		if (rdataset.type == dns_rdatatype_soa) {
-			seen_soa = true;
-		} else if (rdataset.type == dns_rdatatype_ns) {
-			seen_ns = true;
-		} else if (rdataset.type == dns_rdatatype_ds) {
-			seen_ds = true;
-		} else if (rdataset.type == dns_rdatatype_nsec) {
-			seen_nsec = true;
-		} else if (rdataset.type == dns_rdatatype_nsec3) {
-			seen_nsec3 = true;
-		}
-		if (rdataset.type != dns_rdatatype_rrsig) {
-			seen_rr = true;
-		}
-		dns_rdataset_disassociate(&rdataset);
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdataset_current(rdataset, &rdata);
+		length += rdata.length;
+	}
+	job->rdatabuflen = ISC_MAX(length, 1);
+	job->rdatabuf = isc_mem_get(batch->mctx, job->rdatabuflen);
+	job->rdatas = isc_mem_cget(batch->mctx, job->nrdatas,
+				   sizeof(job->rdatas[0]));
+
+	dns_rdatalist_init(&job->rdatalist);
+	job->rdatalist.rdclass = rdataset->rdclass;
+	job->rdatalist.type = rdataset->type;
+	job->rdatalist.ttl = rdataset->ttl;
+	p = job->rdatabuf;
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		isc_region_t r;
+
+		INSIST(i < job->nrdatas);
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_toregion(&rdata, &r);
+		memmove(p, r.base, r.length);
+		r.base = p;
+		p += r.length;
+		dns_rdata_init(&job->rdatas[i]);
+		dns_rdata_fromregion(&job->rdatas[i], rdata.rdclass, rdata.type,
+				     &r);
+		ISC_LIST_APPEND(job->rdatalist.rdata, &job->rdatas[i], link);
+		i++;
 	}
-	if (result != ISC_R_NOMORE) {
-		goto failure;
+	dns_rdataset_init(&job->rdataset);
+	dns_rdatalist_tordataset(&job->rdatalist, &job->rdataset);
+
+	if (batch->count == batch->size) {
+		size_t size = batch->size * 2 + 16;
+		batch->jobs = isc_mem_creget(batch->mctx, batch->jobs,
+					     batch->size, size,
+					     sizeof(batch->jobs[0]));
+		batch->size = size;
 	}
-	/*
-	 * Going from insecure to NSEC3.
-	 * Don't generate NSEC3 records for NSEC3 records.
-	 */
-	if (build_nsec3 && !seen_nsec3 && seen_rr) {
-		bool unsecure = !seen_ds && seen_ns && !seen_soa;
+	batch->jobs[batch->count++] = job;
+}
+
+/*
+ * Return true if 'a' and 'b' have the same TTL and records.
+ */
+static bool
+signbatch_samerdataset(dns_rdataset_t *a, dns_rdataset_t *b) {
+	isc_result_t ra, rb;
+
+	if (a->ttl != b->ttl || dns_rdataset_count(a) != dns_rdataset_count(b))
+	{
+		return (false);
+	}
+
+	for (ra = dns_rdataset_first(a), rb = dns_rdataset_first(b);
+	     ra == ISC_R_SUCCESS && rb == ISC_R_SUCCESS;
+	     ra = dns_rdataset_next(a), rb = dns_rdataset_next(b))
+	{
+		dns_rdata_t rdata_a = DNS_RDATA_INIT;
+		dns_rdata_t rdata_b = DNS_RDATA_INIT;
+
+		dns_rdataset_current(a, &rdata_a);
+		dns_rdataset_current(b, &rdata_b);
+		if (dns_rdata_compare(&rdata_a, &rdata_b) != 0) {
+			return (false);
+		}
+	}
+
+	return (ra == ISC_R_NOMORE && rb == ISC_R_NOMORE);
+}
+
+/*
+ * Find the signature of 'rdataset' made with 'key' in the batch.  The
+ * second pass normally asks for the signatures in the order they were
+ * queued, so the search starts after the last one found.
+ */
+static signjob_t *
+signbatch_find(signbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	       dst_key_t *key) {
+	for (size_t n = 0; n < batch->count; n++) {
+		size_t i = (batch->cursor + n) % batch->count;
+		signjob_t *job = batch->jobs[i];
+
+		if (job->result == ISC_R_SUCCESS &&
+		    job->rdataset.type == rdataset->type &&
+		    dst_key_alg(job->key) == dst_key_alg(key) &&
+		    dst_key_id(job->key) == dst_key_id(key) &&
+		    dns_name_equal(job->name, name) &&
+		    signbatch_samerdataset(&job->rdataset, rdataset))
+		{
+			batch->cursor = i + 1;
+			return (job);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Get the signature of 'rdataset' made with 'key': from the batch if it
+ * was computed there, or else right now.
+ */
+static isc_result_t
+signbatch_getsig(signbatch_t *batch, dns_zone_t *zone, dns_name_t *name,
+		 dns_rdataset_t *rdataset, dst_key_t *key, isc_stdtime_t now,
+		 isc_stdtime_t inception, isc_stdtime_t expire,
+		 isc_buffer_t *buffer, dns_rdata_t *sigrdata, bool *cached) {
+	signjob_t *job = signbatch_find(batch, name, rdataset, key);
+
+	if (job != NULL) {
+		dns_rdata_clone(&job->rdata, sigrdata);
+		*cached = job->cached;
+		return (ISC_R_SUCCESS);
+	}
+
+	return (sign_rdataset(zone_getsigcache(zone), name, rdataset, key, now,
+			      now + zone->sigresigninginterval, &inception,
+			      &expire, zone->mctx, buffer, sigrdata, cached));
+}
+
+/*
+ * Remember where the signing iterators are before the first pass.
+ */
+static void
+signbatch_savepositions(signbatch_t *batch, dns_zone_t *zone) {
+	dns_signing_t *signing = NULL;
+	size_t n = 0;
+
+	for (signing = ISC_LIST_HEAD(zone->signing); signing != NULL;
+	     signing = ISC_LIST_NEXT(signing, link))
+	{
+		n++;
+	}
+	if (n == 0) {
+		return;
+	}
+
+	batch->positions = isc_mem_cget(batch->mctx, n,
+					sizeof(batch->positions[0]));
+	batch->npositions = n;
+
+	n = 0;
+	for (signing = ISC_LIST_HEAD(zone->signing); signing != NULL;
+	     signing = ISC_LIST_NEXT(signing, link))
+	{
+		signpos_t *pos = &batch->positions[n++];
+		dns_name_t *name = dns_fixedname_initname(&pos->fname);
+		dns_dbnode_t *node = NULL;
+
+		pos->signing = signing;
+		if (dns_dbiterator_current(signing->dbiterator, &node, name) ==
+		    ISC_R_SUCCESS)
+		{
+			dns_db_detachnode(signing->db, &node);
+			pos->positioned = true;
+		}
+		dns_dbiterator_pause(signing->dbiterator);
+	}
+}
+
+/*
+ * Undo the first pass: put the signings that it finished back in
+ * 'zone->signing', in their original order, and their iterators back
+ * where they were.
+ */
+static void
+signbatch_restorepositions(signbatch_t *batch, dns_zone_t *zone,
+			   dns_signinglist_t *done) {
+	ISC_LIST_APPENDLIST(zone->signing, *done, link);
+
+	for (size_t i = 0; i < batch->npositions; i++) {
+		ISC_LIST_UNLINK(zone->signing, batch->positions[i].signing,
+				link);
+	}
+	INSIST(ISC_LIST_EMPTY(zone->signing));
+
+	for (size_t i = 0; i < batch->npositions; i++) {
+		signpos_t *pos = &batch->positions[i];
+		dns_dbiterator_t *it = pos->signing->dbiterator;
+
+		ISC_LIST_APPEND(zone->signing, pos->signing, link);
+		if (!pos->positioned ||
+		    dns_dbiterator_seek(it, dns_fixedname_name(&pos->fname)) !=
+			    ISC_R_SUCCESS)
+		{
+			/* Signing again what is already signed is harmless */
+			(void)dns_dbiterator_first(it);
+		}
+		dns_dbiterator_pause(it);
+	}
+}
+
+/*
+ * Claim and sign queued jobs until there are none left.
+ */
+static void
+signbatch_work(void *arg) {
+	signbatch_t *batch = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&batch->next, 1)) < batch->count)
+	{
+		signjob_t *job = batch->jobs[i];
+		isc_buffer_t buffer;
+
+		isc_buffer_init(&buffer, job->data, sizeof(job->data));
+		job->result = sign_rdataset(
+			batch->sigcache, job->name, &job->rdataset, job->key,
+			batch->now, batch->resign, &job->inception,
+			&job->expire, batch->mctx, &buffer, &job->rdata,
+			&job->cached);
+	}
+}
+
+/*
+ * Record how long a maintenance job that started at 'start' took.
+ */
+static void
+zone_jobtime(dns_zone_t *zone, dns_zonejob_t job, isc_nanosecs_t start) {
+	if (zone->zmgr != NULL) {
+		isc_histomulti_inc(zone->zmgr->jobtime[job],
+				   (isc_time_monotonic() - start) / NS_PER_US);
+	}
+}
+
+/*
+ * Runs on the zone's loop after each offload job.  Once all of them are
+ * done, make the second pass, and time the job from the first one.
+ */
+static void
+signbatch_done(void *arg) {
+	signbatch_t *batch = arg;
+	dns_zone_t *zone = batch->zone;
+
+	INSIST(batch->pending > 0);
+	if (--batch->pending == 0) {
+		batch->zone = NULL;
+		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
+			signbatch_detach(&zone->signbatch);
+		} else {
+			zone_sign(zone);
+			zone_jobtime(zone, dns_zonejob_sign, batch->start);
+		}
+		dns_zone_idetach(&zone);
+	}
+
+	signbatch_detach(&batch);
+}
+
+/*
+ * Compute the queued signatures on the offload threads.
+ */
+static void
+signbatch_start(signbatch_t *batch, dns_zone_t *zone) {
+	unsigned int helpers;
+
+	REQUIRE(batch->count > 0);
+
+	batch->collect = false;
+	batch->sigcache = zone_getsigcache(zone);
+	batch->now = isc_stdtime_now();
+	batch->resign = batch->now + zone->sigresigninginterval;
+
+	helpers = ISC_MIN(batch->count,
+			  isc_loopmgr_nloops(isc_loop_getloopmgr(zone->loop)));
+	batch->pending = helpers;
+	LOCK_ZONE(zone);
+	zone_iattach(zone, &batch->zone);
+	UNLOCK_ZONE(zone);
+
+	for (unsigned int i = 0; i < helpers; i++) {
+		isc_refcount_increment(&batch->references);
+		isc_work_enqueue_bulk(zone->loop, signbatch_work,
+				      signbatch_done, batch);
+	}
+}
+
+static isc_result_t
+sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
+	    dns_dbnode_t *node, dns_dbversion_t *version, bool build_nsec3,
+	    bool build_nsec, dst_key_t *key, isc_stdtime_t now,
+	    isc_stdtime_t inception, isc_stdtime_t expire, dns_ttl_t nsecttl,
+	    bool both, bool is_ksk, bool is_zsk, bool is_bottom_of_zone,
+	    dns_diff_t *diff, signbatch_t *batch, int32_t *signatures) {
+	isc_result_t result;
+	dns_rdatasetiter_t *iterator = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_stats_t *dnssecsignstats;
+	isc_buffer_t buffer;
+	unsigned char data[1024];
+	bool offlineksk = false;
+	bool cached = false;
+	bool seen_soa, seen_ns, seen_rr, seen_nsec, seen_nsec3, seen_ds;
+
+	if (zone->kasp != NULL) {
+		offlineksk = dns_kasp_offlineksk(zone->kasp);
+	}
+
+	result = dns_db_allrdatasets(db, node, version, 0, 0, &iterator);
+	if (result != ISC_R_SUCCESS) {
+		if (result == ISC_R_NOTFOUND) {
+			result = ISC_R_SUCCESS;
+		}
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	seen_rr = seen_soa = seen_ns = seen_nsec = seen_nsec3 = seen_ds = false;
+	for (result = dns_rdatasetiter_first(iterator); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(iterator))
+	{
+		dns_rdatasetiter_current(iterator, &rdataset);
+		if (rdataset.type == dns_rdatatype_soa) {
+			seen_soa = true;
+		} else if (rdataset.type == dns_rdatatype_ns) {
+			seen_ns = true;
+		} else if (rdataset.type == dns_rdatatype_ds) {
+			seen_ds = true;
+		} else if (rdataset.type == dns_rdatatype_nsec) {
+			seen_nsec = true;
+		} else if (rdataset.type == dns_rdatatype_nsec3) {
+			seen_nsec3 = true;
+		}
+		if (rdataset.type != dns_rdatatype_rrsig) {
+			seen_rr = true;
+		}
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (result != ISC_R_NOMORE) {
+		goto failure;
+	}
+	/*
+	 * Going from insecure to NSEC3.
+	 * Don't generate NSEC3 records for NSEC3 records.
+	 */
+	if (build_nsec3 && !seen_nsec3 && seen_rr) {
+		bool unsecure = !seen_ds && seen_ns && !seen_soa;
 		CHECK(dns_nsec3_addnsec3s(db, version, name, nsecttl, unsecure,
 					  diff));
 		(*signatures)--;
@@ -7628,7 +8434,8 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 		}
 
 		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
+		isc_buffer_init(&buffer, data, sizeof(data));
+		cached = false;
 		if (offlineksk && dns_rdatatype_iskeymaterial(rdataset.type)) {
 			/* Look up the signature in the SKR bundle */
 			dns_skrbundle_t *bundle = dns_zone_getskrbundle(zone);
@@ -7637,9 +8444,19 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 			}
 			CHECK(dns_skrbundle_getsig(bundle, key, rdataset.type,
 						   &rdata));
+		} else if (batch->collect) {
+			/*
+			 * First pass: queue the RRset, the signature is
+			 * computed before the second pass.
+			 */
+			signbatch_add(batch, name, &rdataset, key, inception,
+				      expire);
+			(*signatures)--;
+			goto next_rdataset;
 		} else {
-			CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
-					      &expire, mctx, &buffer, &rdata));
+			CHECK(signbatch_getsig(batch, zone, name, &rdataset,
+					       key, now, inception, expire,
+					       &buffer, &rdata, &cached));
 		}
 
 		/* Update the database and journal with the RRSIG. */
@@ -7652,9 +8469,11 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 		dnssecsignstats = dns_zone_getdnssecsignstats(zone);
 		if (dnssecsignstats != NULL) {
 			/* Generated a new signature. */
-			dns_dnssecsignstats_increment(dnssecsignstats, ID(key),
-						      ALG(key),
-						      dns_dnssecsignstats_sign);
+			if (!cached) {
+				dns_dnssecsignstats_increment(
+					dnssecsignstats, ID(key), ALG(key),
+					dns_dnssecsignstats_sign);
+			}
 			/* This is a refresh. */
 			dns_dnssecsignstats_increment(
 				dnssecsignstats, ID(key), ALG(key),
@@ -8288,6 +9107,60 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Build the whole of 'nsec3chain' with dns_nsec3_buildchain() and sign
+ * it, adding the changes to 'zonediff'.
+ */
+static isc_result_t
+zone_nsec3buildchain(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+		     dns_nsec3chain_t *nsec3chain, dst_key_t *zone_keys[],
+		     unsigned int nkeys, isc_stdtime_t now,
+		     isc_stdtime_t inception, isc_stdtime_t expire,
+		     dns__zonediff_t *zonediff) {
+	dns_diff_t chain, sigs, onesig;
+	dns_difftuple_t *tuple = NULL;
+	isc_result_t result;
+	size_t count = 0;
+	bool seen_nsec = false;
+
+	dns_diff_init(zone->mctx, &chain);
+	dns_diff_init(zone->mctx, &sigs);
+
+	CHECK(dns_nsec3_buildchain(db, version, &nsec3chain->nsec3param,
+				   zone_nsecttl(zone), &seen_nsec, &chain));
+	if (seen_nsec) {
+		nsec3chain->seen_nsec = true;
+	}
+
+	/*
+	 * The records are all new, so they have no signatures to delete.
+	 * Each one is signed into a diff of its own, so that adding the
+	 * signatures does not search through the whole chain.
+	 */
+	for (tuple = ISC_LIST_HEAD(chain.tuples); tuple != NULL;
+	     tuple = ISC_LIST_NEXT(tuple, link))
+	{
+		dns_diff_init(zone->mctx, &onesig);
+		result = add_sigs(db, version, &tuple->name, zone,
+				  dns_rdatatype_nsec3, &onesig, zone_keys,
+				  nkeys, zone->mctx, now, inception, expire);
+		ISC_LIST_APPENDLIST(sigs.tuples, onesig.tuples, link);
+		CHECK(result);
+		count++;
+	}
+
+	dnssec_log(zone, ISC_LOG_INFO,
+		   "zone_nsec3chain: built an NSEC3 chain of %zu records",
+		   count);
+	ISC_LIST_APPENDLIST(zonediff->diff->tuples, chain.tuples, link);
+	ISC_LIST_APPENDLIST(zonediff->diff->tuples, sigs.tuples, link);
+
+failure:
+	dns_diff_clear(&sigs);
+	dns_diff_clear(&chain);
+	return (result);
+}
+
 /*
  * Incrementally build and sign a new NSEC3 chain using the parameters
  * requested.
@@ -8422,7 +9295,9 @@ zone_nsec3chain(dns_zone_t *zone) {
 	 * amount of work performed.  Actual DNSSEC signatures are only
 	 * generated by dns__zone_updatesigs() calls later in this function.
 	 */
-	while (nsec3chain != NULL && nodes-- > 0 && signatures > 0) {
+	while (nsec3chain != NULL && !signing_yield(nodes < zone->nodes) &&
+	       nodes-- > 0 && signatures > 0)
+	{
 		dns_dbiterator_pause(nsec3chain->dbiterator);
 
 		LOCK_ZONE(zone);
@@ -8458,6 +9333,38 @@ zone_nsec3chain(dns_zone_t *zone) {
 			CHECK(delete_nsec(db, version, node, name, &nsec_diff));
 			goto next_addnode;
 		}
+
+		/*
+		 * A chain that has not been started yet is built all at
+		 * once, and the iterator is moved to the last node so that
+		 * it is finished below as if every node had been processed.
+		 */
+		if (first && dns_name_equal(name, &zone->origin)) {
+			dns_dbiterator_pause(nsec3chain->dbiterator);
+			result = zone_nsec3buildchain(zone, db, version,
+						      nsec3chain, zone_keys,
+						      nkeys, now, inception,
+						      expire, &zonediff);
+			if (result == ISC_R_SUCCESS) {
+				delegation = false;
+				dns_db_detachnode(db, &node);
+				result = dns_dbiterator_last(
+					nsec3chain->dbiterator);
+				CHECK(result);
+				dns_dbiterator_current(nsec3chain->dbiterator,
+						       &node, name);
+				goto next_addnode;
+			}
+			if (result != ISC_R_EXISTS &&
+			    result != ISC_R_NOTIMPLEMENTED)
+			{
+				dnssec_log(zone, ISC_LOG_ERROR,
+					   "zone_nsec3chain:"
+					   "dns_nsec3_buildchain -> %s",
+					   isc_result_totext(result));
+				goto failure;
+			}
+		}
 		/*
 		 * On the first pass we need to check if the current node
 		 * has not been obscured.
@@ -8651,7 +9558,9 @@ zone_nsec3chain(dns_zone_t *zone) {
 	UNLOCK_ZONE(zone);
 	first = true;
 	buildnsecchain = false;
-	while (nsec3chain != NULL && nodes-- > 0 && signatures > 0) {
+	while (nsec3chain != NULL && !signing_yield(nodes < zone->nodes) &&
+	       nodes-- > 0 && signatures > 0)
+	{
 		dns_dbiterator_pause(nsec3chain->dbiterator);
 
 		LOCK_ZONE(zone);
@@ -9380,6 +10289,7 @@ zone_sign(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_signing_t *signing, *nextsigning;
 	dns_signinglist_t cleanup;
+	signbatch_t *batch = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	int32_t signatures;
 	bool is_ksk, is_zsk;
@@ -9398,6 +10308,14 @@ zone_sign(dns_zone_t *zone) {
 
 	ENTER;
 
+	if (zone->signbatch != NULL && zone->signbatch->pending != 0) {
+		/* signbatch_done() calls us again when it is done */
+		LOCK_ZONE(zone);
+		isc_time_settoepoch(&zone->signingtime);
+		UNLOCK_ZONE(zone);
+		return;
+	}
+
 	dns_rdataset_init(&rdataset);
 	name = dns_fixedname_initname(&fixed);
 	nextname = dns_fixedname_initname(&nextfixed);
@@ -9405,6 +10323,13 @@ zone_sign(dns_zone_t *zone) {
 	dns_diff_init(zone->mctx, &post_diff);
 	zonediff_init(&zonediff, &_sig_diff);
 	ISC_LIST_INIT(cleanup);
+	if (zone->signbatch != NULL) {
+		/* The second pass, see signbatch_t */
+		batch = zone->signbatch;
+		zone->signbatch = NULL;
+	} else {
+		batch = signbatch_new(zone->mctx);
+	}
 
 	/*
 	 * Updates are disabled.  Pause for 1 minute.
@@ -9486,7 +10411,13 @@ zone_sign(dns_zone_t *zone) {
 		}
 	}
 
-	while (signing != NULL && nodes-- > 0 && signatures > 0) {
+	if (batch->collect) {
+		signbatch_savepositions(batch, zone);
+	}
+
+	while (signing != NULL && !signing_yield(nodes < zone->nodes) &&
+	       nodes-- > 0 && signatures > 0)
+	{
 		bool has_alg = false;
 
 		dns_dbiterator_pause(signing->dbiterator);
@@ -9677,7 +10608,7 @@ zone_sign(dns_zone_t *zone) {
 				build_nsec, zone_keys[i], now, inception,
 				expire, zone_nsecttl(zone), both, is_ksk,
 				is_zsk, is_bottom_of_zone, zonediff.diff,
-				&signatures, zone->mctx));
+				batch, &signatures));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -9762,6 +10693,20 @@ zone_sign(dns_zone_t *zone) {
 		first = true;
 	}
 
+	if (batch->collect && batch->count != 0) {
+		/*
+		 * This was the first pass and it needs signatures: roll it
+		 * back and compute them on the offload threads.
+		 */
+		signbatch_restorepositions(batch, zone, &cleanup);
+		dns_db_closeversion(db, &version, false);
+		signbatch_start(batch, zone);
+		zone->signbatch = batch;
+		batch = NULL;
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = dns__zone_updatesigs(&post_diff, db, version,
 					      zone_keys, nkeys, zone, inception,
@@ -9894,6 +10839,10 @@ cleanup:
 	dns_diff_clear(&_sig_diff);
 	dns_diff_clear(&post_diff);
 
+	if (batch != NULL) {
+		signbatch_detach(&batch);
+	}
+
 	for (i = 0; i < nkeys; i++) {
 		dst_key_free(&zone_keys[i]);
 	}
@@ -9910,7 +10859,10 @@ cleanup:
 	}
 
 	LOCK_ZONE(zone);
-	if (ISC_LIST_HEAD(zone->signing) != NULL) {
+	if (zone->signbatch != NULL) {
+		/* signbatch_done() calls us again */
+		isc_time_settoepoch(&zone->signingtime);
+	} else if (ISC_LIST_HEAD(zone->signing) != NULL) {
 		isc_interval_t interval;
 		if (zone->update_disabled || result != ISC_R_SUCCESS) {
 			isc_interval_set(&interval, 60, 0); /* 1 minute */
@@ -11265,6 +12217,24 @@ zone_maintenance(dns_zone_t *zone) {
 		break;
 	}
 
+	/*
+	 * Unload an idle load-on-demand zone; the next query for it
+	 * will load it again.
+	 */
+	if (zone->type == dns_zone_primary) {
+		LOCK_ZONE(zone);
+		if (zone_mayunload(zone) &&
+		    isc_time_seconds(&now) >=
+			    atomic_load_relaxed(&zone->demandtime) +
+				    DNS_DEMAND_IDLE)
+		{
+			dns_zone_log(zone, ISC_LOG_INFO,
+				     "unloading idle zone");
+			zone_unload(zone);
+		}
+		UNLOCK_ZONE(zone);
+	}
+
 	/*
 	 * Do we need to refresh keys?
 	 */
@@ -11323,12 +12293,29 @@ zone_maintenance(dns_zone_t *zone) {
 			      isc_time_compare(&now, &zone->keywarntime) >= 0;
 		UNLOCK_ZONE(zone);
 
-		if (sign) {
-			zone_sign(zone);
-		} else if (resign) {
-			zone_resigninc(zone);
-		} else if (chain) {
-			zone_nsec3chain(zone);
+		if (sign || resign || chain) {
+			isc_nanosecs_t start = isc_time_monotonic();
+			dns_zonejob_t job;
+
+			if (sign) {
+				job = dns_zonejob_sign;
+				zone_sign(zone);
+			} else if (resign) {
+				job = dns_zonejob_resign;
+				zone_resigninc(zone);
+			} else {
+				job = dns_zonejob_nsec3chain;
+				zone_nsec3chain(zone);
+			}
+
+			/*
+			 * Once zone_sign() has handed its signatures to the
+			 * offload threads, signbatch_done() times the job.
+			 */
+			if (job != dns_zonejob_sign || zone->signbatch == NULL)
+			{
+				zone_jobtime(zone, job, start);
+			}
 		}
 
 		/*
@@ -11545,6 +12532,7 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 		options = 0;
 	}
 
+	zone_journal_flush(zone);
 	result = dns_journal_open(zone->mctx, zone->journal, DNS_JOURNAL_READ,
 				  &journal);
 	if (result == ISC_R_NOTFOUND) {
@@ -11605,6 +12593,65 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 	}
 }
 
+typedef struct zone_compact {
+	dns_zone_t *zone;
+	dns_journalcompact_t *compact;
+	isc_result_t result;
+} zone_compact_t;
+
+static void
+zone_journal_compactlog(dns_zone_t *zone, isc_result_t result) {
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case ISC_R_NOSPACE:
+	case ISC_R_NOTFOUND:
+		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
+			     isc_result_totext(result));
+		break;
+	default:
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_journal_compact failed: %s",
+			     isc_result_totext(result));
+		break;
+	}
+}
+
+/*
+ * Runs on a helper thread: copy the retained transactions into the
+ * new journal.  Neither the zone nor the live journal is touched.
+ */
+static void
+zone_compact_work(void *arg) {
+	zone_compact_t *job = arg;
+
+	job->result = dns_journal_compact_copy(job->compact);
+}
+
+/*
+ * Back on the zone loop: append whatever was committed while the copy
+ * was running and swap the new journal in.
+ */
+static void
+zone_compact_done(void *arg) {
+	zone_compact_t *job = arg;
+	dns_zone_t *zone = job->zone;
+	isc_result_t result = job->result;
+
+	LOCK_ZONE(zone);
+	if (result == ISC_R_SUCCESS) {
+		zone_journal_flush(zone);
+		result = dns_journal_compact_finish(&job->compact);
+	} else {
+		dns_journal_compact_cancel(&job->compact);
+	}
+	zone_journal_compactlog(zone, result);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_COMPACTING);
+	UNLOCK_ZONE(zone);
+
+	isc_mem_put(zone->mctx, job, sizeof(*job));
+	dns_zone_idetach(&zone);
+}
+
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	isc_result_t result;
@@ -11612,6 +12659,8 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	dns_dbversion_t *ver = NULL;
 	uint64_t dbsize;
 	uint32_t options = 0;
+	dns_journalcompact_t *compact = NULL;
+	zone_compact_t *job = NULL;
 
 	INSIST(LOCKED_ZONE(zone));
 	if (inline_raw(zone)) {
@@ -11641,21 +12690,40 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 		zone_debuglog(zone, __func__, 1, "target journal size %d",
 			      journalsize);
 	}
-	result = dns_journal_compact(zone->mctx, zone->journal, serial, options,
-				     journalsize);
-	switch (result) {
-	case ISC_R_SUCCESS:
-	case ISC_R_NOSPACE:
-	case ISC_R_NOTFOUND:
-		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
-			     isc_result_totext(result));
-		break;
-	default:
-		dns_zone_log(zone, ISC_LOG_ERROR,
-			     "dns_journal_compact failed: %s",
-			     isc_result_totext(result));
-		break;
+	zone_journal_flush(zone);
+
+	/*
+	 * Repairing the journal rewrites every transaction and is rare
+	 * enough to be done in place; otherwise the bulk of the copy is
+	 * done on a helper thread so that the zone keeps accepting
+	 * updates while it runs.
+	 */
+	if ((options & DNS_JOURNAL_COMPACTALL) != 0 || zone->loop == NULL) {
+		result = dns_journal_compact(zone->mctx, zone->journal, serial,
+					     options, journalsize);
+		zone_journal_compactlog(zone, result);
+		return;
+	}
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_COMPACTING)) {
+		zone_debuglog(zone, __func__, 1,
+			      "journal compaction already running");
+		return;
 	}
+
+	result = dns_journal_compact_begin(zone->mctx, zone->journal, serial,
+					   options, journalsize, &compact);
+	if (result != ISC_R_SUCCESS || compact == NULL) {
+		zone_journal_compactlog(zone, result);
+		return;
+	}
+
+	job = isc_mem_get(zone->mctx, sizeof(*job));
+	*job = (zone_compact_t){ .compact = compact };
+	zone_iattach(zone, &job->zone);
+	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_COMPACTING);
+	isc_work_enqueue_bulk(zone->loop, zone_compact_work, zone_compact_done,
+			      job);
 }
 
 isc_result_t
@@ -11881,12 +12949,62 @@ dump_done(void *arg, isc_result_t result) {
 	dns_zone_idetach(&zone);
 }
 
+typedef struct zone_sigsave {
+	dns_zone_t *zone;
+	dns_sigcache_t *sigcache;
+	char *filename;
+	isc_result_t result;
+} zone_sigsave_t;
+
+static void
+zone_sigsave_work(void *arg) {
+	zone_sigsave_t *job = arg;
+
+	job->result = dns_sigcache_save(job->sigcache, job->filename,
+					isc_stdtime_now());
+}
+
+static void
+zone_sigsave_done(void *arg) {
+	zone_sigsave_t *job = arg;
+	dns_zone_t *zone = job->zone;
+
+	if (job->result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "saving signature cache '%s': %s", job->filename,
+			     isc_result_totext(job->result));
+	}
+	isc_mem_free(zone->mctx, job->filename);
+	isc_mem_put(zone->mctx, job, sizeof(*job));
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * Write the signature cache next to the zone file, on a helper thread.
+ */
+static void
+zone_savesigcache(dns_zone_t *zone, dns_sigcache_t *sigcache,
+		  const char *masterfile) {
+	zone_sigsave_t *job = isc_mem_get(zone->mctx, sizeof(*job));
+
+	*job = (zone_sigsave_t){
+		.sigcache = sigcache,
+		.filename = sigcache_filename(zone, masterfile),
+	};
+	LOCK_ZONE(zone);
+	zone_iattach(zone, &job->zone);
+	UNLOCK_ZONE(zone);
+	isc_work_enqueue(zone->loop, zone_sigsave_work, zone_sigsave_done,
+			 job);
+}
+
 static isc_result_t
 zone_dump(dns_zone_t *zone, bool compact) {
 	isc_result_t result;
 	dns_dbversion_t *version = NULL;
 	bool again = false;
 	dns_db_t *db = NULL;
+	dns_sigcache_t *sigcache = NULL;
 	char *masterfile = NULL;
 	dns_masterformat_t masterformat = dns_masterformat_none;
 	const dns_master_style_t *masterstyle = NULL;
@@ -11910,6 +13028,7 @@ redo:
 		masterfile = isc_mem_strdup(zone->mctx, zone->masterfile);
 		masterformat = zone->masterformat;
 	}
+	sigcache = zone->sigcache;
 	if (zone->type == dns_zone_key) {
 		masterstyle = &dns_master_style_keyzone;
 	} else if (zone->masterstyle != NULL) {
@@ -11944,7 +13063,7 @@ redo:
 		result = dns_master_dumpasync(
 			zone->mctx, db, version, masterstyle, masterfile,
 			zone->loop, dump_done, zone, &zone->dumpctx,
-			masterformat, &rawdata);
+			masterformat, &rawdata, NULL);
 
 		UNLOCK_ZONE(zone);
 		if (result != ISC_R_SUCCESS) {
@@ -11979,6 +13098,11 @@ fail:
 	if (db != NULL) {
 		dns_db_detach(&db);
 	}
+	if (sigcache != NULL && masterfile != NULL &&
+	    (result == ISC_R_SUCCESS || result == DNS_R_CONTINUE))
+	{
+		zone_savesigcache(zone, sigcache, masterfile);
+	}
 	if (masterfile != NULL) {
 		isc_mem_free(zone->mctx, masterfile);
 		masterfile = NULL;
@@ -12162,6 +13286,25 @@ zone_unload(dns_zone_t *zone) {
 	}
 }
 
+/*
+ * A load-on-demand zone may only be unloaded while it holds nothing
+ * that is not in its zone file, and has nothing left to do.
+ */
+static bool
+zone_mayunload(dns_zone_t *zone) {
+	REQUIRE(LOCKED_ZONE(zone));
+
+	return (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) &&
+		DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) &&
+		!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING) &&
+		!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP) &&
+		!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DUMPING) &&
+		!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDNOTIFY) &&
+		!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDSTARTUPNOTIFY) &&
+		zone->raw == NULL && zone->secure == NULL &&
+		zone->kasp == NULL && !dns_zone_isdynamic(zone, true));
+}
+
 void
 dns_zone_setminrefreshtime(dns_zone_t *zone, uint32_t val) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -12272,10 +13415,9 @@ requeue:
 		}
 
 		notify->flags &= ~DNS_NOTIFY_STARTUP;
-		result = isc_ratelimiter_enqueue(
-			notify->zone->zmgr->notifyrl, notify->zone->loop,
-			notify_send_toaddr, notify, &notify->rlevent);
+		result = notify_send_queue(notify, false);
 		if (result != ISC_R_SUCCESS) {
+			notify_unqueue(notify);
 			return (false);
 		}
 	}
@@ -12336,6 +13478,7 @@ notify_destroy(dns_notify_t *notify, bool locked) {
 
 	REQUIRE(DNS_NOTIFY_VALID(notify));
 
+	notify_unqueue(notify);
 	if (notify->zone != NULL) {
 		if (!locked) {
 			LOCK_ZONE(notify->zone);
@@ -12389,6 +13532,7 @@ notify_create(isc_mem_t *mctx, unsigned int flags, dns_notify_t **notifyp) {
 	isc_sockaddr_any(&notify->dst);
 	dns_name_init(&notify->ns, NULL);
 	ISC_LINK_INIT(notify, link);
+	ISC_LINK_INIT(notify, qlink);
 	notify->magic = NOTIFY_MAGIC;
 	*notifyp = notify;
 	return (ISC_R_SUCCESS);
@@ -12425,59 +13569,211 @@ process_notify_adb_event(void *arg) {
 	notify_destroy(notify, false);
 }
 
-static void
-notify_find_address(dns_notify_t *notify) {
+static void
+notify_find_address(dns_notify_t *notify) {
+	isc_result_t result;
+	unsigned int options;
+	dns_adb_t *adb = NULL;
+
+	REQUIRE(DNS_NOTIFY_VALID(notify));
+
+	options = DNS_ADBFIND_WANTEVENT;
+	if (isc_net_probeipv4() != ISC_R_DISABLED) {
+		options |= DNS_ADBFIND_INET;
+	}
+	if (isc_net_probeipv6() != ISC_R_DISABLED) {
+		options |= DNS_ADBFIND_INET6;
+	}
+
+	dns_view_getadb(notify->zone->view, &adb);
+	if (adb == NULL) {
+		goto destroy;
+	}
+
+	result = dns_adb_createfind(
+		adb, notify->zone->loop, process_notify_adb_event, notify,
+		&notify->ns, dns_rootname, 0, options, 0, NULL,
+		notify->zone->view->dstport, 0, NULL, &notify->find);
+	dns_adb_detach(&adb);
+
+	/* Something failed? */
+	if (result != ISC_R_SUCCESS) {
+		goto destroy;
+	}
+
+	/* More addresses pending? */
+	if ((notify->find->options & DNS_ADBFIND_WANTEVENT) != 0) {
+		return;
+	}
+
+	/* We have as many addresses as we can get. */
+	LOCK_ZONE(notify->zone);
+	notify_send(notify);
+	UNLOCK_ZONE(notify->zone);
+
+destroy:
+	notify_destroy(notify, false);
+}
+
+static bool
+ratedest_match(void *node, const void *key) {
+	const dns_ratedest_t *dest = node;
+
+	return (isc_sockaddr_equal(&dest->addr, key));
+}
+
+/*
+ * Find the rate limiter for 'addr' in 'dests', creating it at 'rate'
+ * if this is a new destination.  The caller must hold the lock that
+ * protects 'dests'.
+ */
+static dns_ratedest_t *
+ratedest_get(dns_zonemgr_t *zmgr, isc_hashmap_t *dests,
+	     const isc_sockaddr_t *addr, unsigned int rate) {
+	dns_ratedest_t *dest = NULL;
+	uint32_t hashval = isc_sockaddr_hash(addr, false);
+	isc_result_t result;
+
+	result = isc_hashmap_find(dests, hashval, ratedest_match, addr,
+				  (void **)&dest);
+	if (result == ISC_R_SUCCESS) {
+		return (dest);
+	}
+
+	dest = isc_mem_get(zmgr->mctx, sizeof(*dest));
+	*dest = (dns_ratedest_t){ .addr = *addr };
+	isc_ratelimiter_create(isc_loop(), &dest->rl);
+	setrl(dest->rl, &dest->rate, rate);
+
+	result = isc_hashmap_add(dests, hashval, ratedest_match, addr, dest,
+				 NULL);
+	INSIST(result == ISC_R_SUCCESS);
+
+	return (dest);
+}
+
+/*
+ * Adjust the pace of requests to 'dest', configured at 'base' per
+ * second, after one of them has completed with 'result'.  The caller
+ * must hold the lock that protects 'dest'.
+ */
+static void
+ratedest_update(dns_ratedest_t *dest, unsigned int base,
+		isc_result_t result) {
+	unsigned int rate = dest->rate;
+
+	if (result == ISC_R_SUCCESS) {
+		if (rate < base * DEST_RATE_GROWTH) {
+			rate++;
+		}
+	} else if (result == ISC_R_TIMEDOUT) {
+		rate = ISC_MAX(rate / 2, 1);
+	}
+	if (rate != dest->rate) {
+		setrl(dest->rl, &dest->rate, rate);
+	}
+}
+
+/*
+ * Shut down ('rate' == 0) or reset to 'rate' every rate limiter in
+ * 'dests'.  The caller must hold the lock that protects 'dests'.
+ */
+static void
+ratedests_reset(isc_hashmap_t *dests, unsigned int rate) {
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_hashmap_iter_create(dests, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(it))
+	{
+		dns_ratedest_t *dest = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&dest);
+		if (rate == 0) {
+			isc_ratelimiter_shutdown(dest->rl);
+		} else {
+			setrl(dest->rl, &dest->rate, rate);
+		}
+	}
+	isc_hashmap_iter_destroy(&it);
+}
+
+static void
+ratedests_destroy(isc_mem_t *mctx, isc_hashmap_t **destsp) {
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_hashmap_iter_create(*destsp, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(it))
+	{
+		dns_ratedest_t *dest = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&dest);
+		isc_ratelimiter_detach(&dest->rl);
+		isc_mem_put(mctx, dest, sizeof(*dest));
+	}
+	isc_hashmap_iter_destroy(&it);
+	isc_hashmap_destroy(destsp);
+}
+
+/*
+ * Startup NOTIFY requests share a single rate limiter; all others are
+ * paced per destination, so that a slow or unreachable secondary does
+ * not hold up the NOTIFY requests to all the others.
+ */
+static isc_result_t
+notify_send_queue(dns_notify_t *notify, bool startup) {
+	dns_zonemgr_t *zmgr = notify->zone->zmgr;
+	isc_ratelimiter_t *rl = zmgr->startupnotifyrl;
 	isc_result_t result;
-	unsigned int options;
-	dns_adb_t *adb = NULL;
 
-	REQUIRE(DNS_NOTIFY_VALID(notify));
-
-	options = DNS_ADBFIND_WANTEVENT;
-	if (isc_net_probeipv4() != ISC_R_DISABLED) {
-		options |= DNS_ADBFIND_INET;
-	}
-	if (isc_net_probeipv6() != ISC_R_DISABLED) {
-		options |= DNS_ADBFIND_INET6;
+	LOCK(&zmgr->notifylock);
+	if (!startup) {
+		if (zmgr->notifyshutdown) {
+			result = ISC_R_SHUTTINGDOWN;
+			goto unlock;
+		}
+		if (notify->dest == NULL) {
+			notify->dest = ratedest_get(zmgr, zmgr->notifydests,
+						    &notify->dst,
+						    zmgr->notifyrate);
+		}
+		rl = notify->dest->rl;
 	}
-
-	dns_view_getadb(notify->zone->view, &adb);
-	if (adb == NULL) {
-		goto destroy;
+	/*
+	 * Put the request on the queue before handing it to the rate
+	 * limiter, so that notify_send_toaddr() always finds it there.
+	 */
+	if (!ISC_LINK_LINKED(notify, qlink)) {
+		notify->zmgr = zmgr;
+		notify->queued = isc_time_now();
+		ISC_LIST_APPEND(zmgr->notifyq, notify, qlink);
+		zmgr->notifyqueued++;
 	}
+	result = isc_ratelimiter_enqueue(rl, notify->zone->loop,
+					 notify_send_toaddr, notify,
+					 &notify->rlevent);
+unlock:
+	UNLOCK(&zmgr->notifylock);
 
-	result = dns_adb_createfind(
-		adb, notify->zone->loop, process_notify_adb_event, notify,
-		&notify->ns, dns_rootname, 0, options, 0, NULL,
-		notify->zone->view->dstport, 0, NULL, &notify->find);
-	dns_adb_detach(&adb);
+	return (result);
+}
 
-	/* Something failed? */
-	if (result != ISC_R_SUCCESS) {
-		goto destroy;
-	}
+static void
+notify_unqueue(dns_notify_t *notify) {
+	dns_zonemgr_t *zmgr = notify->zmgr;
 
-	/* More addresses pending? */
-	if ((notify->find->options & DNS_ADBFIND_WANTEVENT) != 0) {
+	if (zmgr == NULL) {
 		return;
 	}
 
-	/* We have as many addresses as we can get. */
-	LOCK_ZONE(notify->zone);
-	notify_send(notify);
-	UNLOCK_ZONE(notify->zone);
-
-destroy:
-	notify_destroy(notify, false);
-}
-
-static isc_result_t
-notify_send_queue(dns_notify_t *notify, bool startup) {
-	return (isc_ratelimiter_enqueue(
-		startup ? notify->zone->zmgr->startupnotifyrl
-			: notify->zone->zmgr->notifyrl,
-		notify->zone->loop, notify_send_toaddr, notify,
-		&notify->rlevent));
+	LOCK(&zmgr->notifylock);
+	ISC_LIST_UNLINK(zmgr->notifyq, notify, qlink);
+	zmgr->notifyqueued--;
+	UNLOCK(&zmgr->notifylock);
+	notify->zmgr = NULL;
 }
 
 static void
@@ -12495,6 +13791,8 @@ notify_send_toaddr(void *arg) {
 
 	REQUIRE(DNS_NOTIFY_VALID(notify));
 
+	notify_unqueue(notify);
+
 	LOCK_ZONE(notify->zone);
 
 	isc_sockaddr_format(&notify->dst, addrbuf, sizeof(addrbuf));
@@ -13909,6 +15207,11 @@ refresh_callback(void *arg) {
 	isc_sockaddr_format(&curraddr, primary, sizeof(primary));
 	isc_sockaddr_format(&zone->sourceaddr, source, sizeof(source));
 
+	if (zone->zmgr != NULL) {
+		soa_query_done(zone->zmgr, &curraddr,
+			       dns_request_getresult(request));
+	}
+
 	switch (dns_request_getresult(request)) {
 	case ISC_R_SUCCESS:
 		break;
@@ -14303,6 +15606,51 @@ struct soaquery {
 	isc_rlevent_t *rlevent;
 };
 
+/*
+ * SOA queries are paced per primary, so that a slow or unreachable
+ * primary does not hold up the refresh of zones served by the others.
+ */
+static isc_result_t
+soa_query_enqueue(dns_zone_t *zone, struct soaquery *sq) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	isc_sockaddr_t curraddr = dns_remote_curraddr(&zone->primaries);
+	dns_ratedest_t *dest = NULL;
+	isc_result_t result;
+
+	LOCK(&zmgr->refreshlock);
+	if (zmgr->refreshshutdown) {
+		result = ISC_R_SHUTTINGDOWN;
+		goto unlock;
+	}
+	dest = ratedest_get(zmgr, zmgr->refreshdests, &curraddr,
+			    zmgr->serialqueryrate);
+	result = isc_ratelimiter_enqueue(dest->rl, zone->loop, soa_query, sq,
+					 &sq->rlevent);
+unlock:
+	UNLOCK(&zmgr->refreshlock);
+
+	return (result);
+}
+
+/*
+ * Adjust the pace of SOA queries to 'addr' after one of them has
+ * completed with 'result'.
+ */
+static void
+soa_query_done(dns_zonemgr_t *zmgr, const isc_sockaddr_t *addr,
+	       isc_result_t result) {
+	dns_ratedest_t *dest = NULL;
+
+	LOCK(&zmgr->refreshlock);
+	if (isc_hashmap_find(zmgr->refreshdests, isc_sockaddr_hash(addr, false),
+			     ratedest_match, addr,
+			     (void **)&dest) == ISC_R_SUCCESS)
+	{
+		ratedest_update(dest, zmgr->serialqueryrate, result);
+	}
+	UNLOCK(&zmgr->refreshlock);
+}
+
 static void
 queue_soa_query(dns_zone_t *zone) {
 	isc_result_t result;
@@ -14329,8 +15677,7 @@ queue_soa_query(dns_zone_t *zone) {
 	 * Attach so that we won't clean up until the event is delivered.
 	 */
 	zone_iattach(zone, &sq->zone);
-	result = isc_ratelimiter_enqueue(zone->zmgr->refreshrl, zone->loop,
-					 soa_query, sq, &sq->rlevent);
+	result = soa_query_enqueue(zone, sq);
 	if (result != ISC_R_SUCCESS) {
 		zone_idetach(&sq->zone);
 		isc_mem_put(zone->mctx, sq, sizeof(*sq));
@@ -15079,6 +16426,19 @@ zone__settimer(void *arg) {
 				next = zone->nsec3chaintime;
 			}
 		}
+		if (zone_mayunload(zone)) {
+			isc_time_t idletime;
+
+			isc_time_set(&idletime,
+				     atomic_load_relaxed(&zone->demandtime) +
+					     DNS_DEMAND_IDLE,
+				     0);
+			if (isc_time_isepoch(&next) ||
+			    isc_time_compare(&idletime, &next) < 0)
+			{
+				next = idletime;
+			}
+		}
 		break;
 
 	case dns_zone_secondary:
@@ -16161,6 +17521,14 @@ notify_done(void *arg) {
 fail:
 	dns_message_detach(&message);
 
+	if (notify->dest != NULL && notify->zone->zmgr != NULL) {
+		dns_zonemgr_t *zmgr = notify->zone->zmgr;
+
+		LOCK(&zmgr->notifylock);
+		ratedest_update(notify->dest, zmgr->notifyrate, result);
+		UNLOCK(&zmgr->notifylock);
+	}
+
 	if (result == ISC_R_SUCCESS) {
 		notify_log(notify->zone, ISC_LOG_DEBUG(1),
 			   "notify to %s successful", addrbuf);
@@ -16172,8 +17540,11 @@ fail:
 			   addrbuf, isc_result_totext(result));
 		notify->flags |= DNS_NOTIFY_TCP;
 		dns_request_destroy(&notify->request);
-		notify_send_queue(notify, (notify->flags & DNS_NOTIFY_STARTUP));
-		return;
+		result = notify_send_queue(notify,
+					   (notify->flags & DNS_NOTIFY_STARTUP));
+		if (result == ISC_R_SUCCESS) {
+			return;
+		}
 	} else if (result == ISC_R_TIMEDOUT) {
 		notify_log(notify->zone, ISC_LOG_WARNING,
 			   "notify to %s failed: %s: retries exceeded", addrbuf,
@@ -16828,10 +18199,12 @@ receive_secure_serial(void *arg) {
 		 * If that fails, then we'll fall back to a direct comparison
 		 * between raw and secure zones.
 		 */
+		zone_journal_flush(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
 
+		zone_journal_flush(zone);
 		result = dns_journal_open(zone->mctx, zone->journal,
 					  DNS_JOURNAL_READ, &sjournal);
 		if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
@@ -16930,6 +18303,7 @@ receive_secure_serial(void *arg) {
 	}
 
 	if (rjournal == NULL) {
+		zone_journal_flush(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -17689,6 +19063,7 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 			isc_log_write(DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_ZONE, ISC_LOG_DEBUG(3),
 				      "removing journal file");
+			zone_journal_flush(zone);
 			if (remove(zone->journal) < 0 && errno != ENOENT) {
 				char strbuf[ISC_STRERRORSIZE];
 				strerror_r(errno, strbuf, sizeof(strbuf));
@@ -18138,11 +19513,120 @@ again:
 	if (zone->loadctx != NULL) {
 		dns_loadctx_detach(&zone->loadctx);
 	}
+	if (load->zmgr != NULL) {
+		zonemgr_loaddone(load);
+	}
 	isc_mem_put(zone->mctx, load, sizeof(*load));
 
 	dns_zone_idetach(&zone);
 }
 
+/*
+ * Start loading the zone file in the offload threadpool.
+ *
+ * Caller must hold the zone lock.
+ */
+static isc_result_t
+zone_loadfile(dns_load_t *load) {
+	dns_zone_t *zone = load->zone;
+
+	return (dns_master_loadfileasync(
+		zone->masterfile, dns_db_origin(load->db),
+		dns_db_origin(load->db), zone->rdclass, load->options, 0,
+		&load->callbacks, zone->loop, zone_loaddone, load,
+		&zone->loadctx, zone_registerinclude, zone, zone->mctx,
+		zone->masterformat, zone->maxttl));
+}
+
+/*
+ * Start a load that had to wait for a free slot in its loop's queue.
+ */
+static void
+zonemgr_startload(void *arg) {
+	dns_load_t *load = arg;
+	dns_zone_t *zone = load->zone;
+	isc_result_t result;
+
+	LOCK_ZONE(zone);
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
+		result = ISC_R_CANCELED;
+	} else {
+		result = zone_loadfile(load);
+	}
+	UNLOCK_ZONE(zone);
+
+	if (result != ISC_R_SUCCESS) {
+		zone_loaddone(load, result);
+	}
+}
+
+/*
+ * Start loading the zone file now if the zone's loop has fewer than
+ * DNS_ZONEMGR_LOADS_PER_LOOP loads in progress, or queue the load until one
+ * of them finishes (see zonemgr_loaddone()).
+ *
+ * Caller must hold the zone lock.
+ */
+static isc_result_t
+zonemgr_queueload(dns_zonemgr_t *zmgr, dns_load_t *load) {
+	struct zonemgr_loadq *loadq = &zmgr->loadq[load->zone->tid];
+	isc_result_t result;
+
+	if (atomic_fetch_add_relaxed(&zmgr->loads_pending, 1) == 0) {
+		atomic_store_relaxed(&zmgr->loads_done, 0);
+		atomic_store_relaxed(&zmgr->loads_started, isc_stdtime_now());
+	}
+	dns_zonemgr_attach(zmgr, &load->zmgr);
+	ISC_LINK_INIT(load, link);
+
+	LOCK(&loadq->lock);
+	if (loadq->active >= DNS_ZONEMGR_LOADS_PER_LOOP) {
+		ISC_LIST_APPEND(loadq->pending, load, link);
+		UNLOCK(&loadq->lock);
+		return (ISC_R_SUCCESS);
+	}
+	loadq->active++;
+	UNLOCK(&loadq->lock);
+
+	result = zone_loadfile(load);
+	if (result != ISC_R_SUCCESS) {
+		zonemgr_loaddone(load);
+	}
+
+	return (result);
+}
+
+/*
+ * A load started by zonemgr_queueload() has finished: hand its slot
+ * to the next queued load, if any.  That load is started asynchronously
+ * because the caller may be holding the lock of another zone.
+ */
+static void
+zonemgr_loaddone(dns_load_t *load) {
+	dns_zonemgr_t *zmgr = load->zmgr;
+	struct zonemgr_loadq *loadq = &zmgr->loadq[load->zone->tid];
+	dns_load_t *next = NULL;
+
+	LOCK(&loadq->lock);
+	INSIST(loadq->active > 0);
+	next = ISC_LIST_HEAD(loadq->pending);
+	if (next != NULL) {
+		ISC_LIST_UNLINK(loadq->pending, next, link);
+	} else {
+		loadq->active--;
+	}
+	UNLOCK(&loadq->lock);
+
+	if (next != NULL) {
+		isc_async_background(next->zone->loop, zonemgr_startload,
+				     next);
+	}
+
+	atomic_fetch_add_relaxed(&zmgr->loads_done, 1);
+	atomic_fetch_sub_release(&zmgr->loads_pending, 1);
+	dns_zonemgr_detach(&load->zmgr);
+}
+
 void
 dns_zone_getssutable(dns_zone_t *zone, dns_ssutable_t **table) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -19037,8 +20521,6 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_nm_t *netmgr, dns_zonemgr_t **zmgrp) {
 	isc_rwlock_init(&zmgr->urlock);
 
 	isc_ratelimiter_create(loop, &zmgr->checkdsrl);
-	isc_ratelimiter_create(loop, &zmgr->notifyrl);
-	isc_ratelimiter_create(loop, &zmgr->refreshrl);
 	isc_ratelimiter_create(loop, &zmgr->startupnotifyrl);
 	isc_ratelimiter_create(loop, &zmgr->startuprefreshrl);
 
@@ -19049,14 +20531,30 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_nm_t *netmgr, dns_zonemgr_t **zmgrp) {
 		isc_mem_setname(zmgr->mctxpool[i], "zonemgr-mctxpool");
 	}
 
+	zmgr->loadq = isc_mem_cget(zmgr->mctx, zmgr->workers,
+				   sizeof(zmgr->loadq[0]));
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		isc_mutex_init(&zmgr->loadq[i].lock);
+		ISC_LIST_INIT(zmgr->loadq[i].pending);
+	}
+
 	/* Key file I/O locks. */
 	zonemgr_keymgmt_init(zmgr);
 
+	/* NOTIFY destinations. */
+	isc_mutex_init(&zmgr->notifylock);
+	isc_hashmap_create(zmgr->mctx, 8, &zmgr->notifydests);
+	ISC_LIST_INIT(zmgr->notifyq);
+
+	/* SOA query destinations. */
+	isc_mutex_init(&zmgr->refreshlock);
+	isc_hashmap_create(zmgr->mctx, 8, &zmgr->refreshdests);
+
 	/* Default to 20 refresh queries / notifies / checkds per second. */
 	setrl(zmgr->checkdsrl, &zmgr->checkdsrate, 20);
-	setrl(zmgr->notifyrl, &zmgr->notifyrate, 20);
+	zmgr->notifyrate = 20;
 	setrl(zmgr->startupnotifyrl, &zmgr->startupnotifyrate, 20);
-	setrl(zmgr->refreshrl, &zmgr->serialqueryrate, 20);
+	zmgr->serialqueryrate = 20;
 	setrl(zmgr->startuprefreshrl, &zmgr->startupserialqueryrate, 20);
 	isc_ratelimiter_setpushpop(zmgr->startupnotifyrl, true);
 	isc_ratelimiter_setpushpop(zmgr->startuprefreshrl, true);
@@ -19064,6 +20562,11 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_nm_t *netmgr, dns_zonemgr_t **zmgrp) {
 	zmgr->tlsctx_cache = NULL;
 	isc_rwlock_init(&zmgr->tlsctx_cache_rwlock);
 
+	for (size_t i = 0; i < dns_zonejob_max; i++) {
+		isc_histomulti_create(zmgr->mctx, DNS_ZONEJOB_SIGBITS,
+				      &zmgr->jobtime[i]);
+	}
+
 	zmgr->magic = ZONEMGR_MAGIC;
 
 	*zmgrp = zmgr;
@@ -19082,7 +20585,8 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep) {
 		return (ISC_R_FAILURE);
 	}
 
-	tid = isc_random_uniform(zmgr->workers);
+	tid = zmgr->firstloop +
+	      isc_random_uniform(zmgr->workers - zmgr->firstloop);
 
 	mctx = zmgr->mctxpool[tid];
 	if (mctx == NULL) {
@@ -19096,6 +20600,14 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep) {
 	return (ISC_R_SUCCESS);
 }
 
+void
+dns_zonemgr_setmaintloops(dns_zonemgr_t *zmgr, uint32_t nloops) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(nloops <= zmgr->workers);
+
+	zmgr->firstloop = (nloops == 0) ? 0 : zmgr->workers - nloops;
+}
+
 isc_result_t
 dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -19214,11 +20726,19 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
 	isc_ratelimiter_shutdown(zmgr->checkdsrl);
-	isc_ratelimiter_shutdown(zmgr->notifyrl);
-	isc_ratelimiter_shutdown(zmgr->refreshrl);
 	isc_ratelimiter_shutdown(zmgr->startupnotifyrl);
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
 
+	LOCK(&zmgr->notifylock);
+	zmgr->notifyshutdown = true;
+	ratedests_reset(zmgr->notifydests, 0);
+	UNLOCK(&zmgr->notifylock);
+
+	LOCK(&zmgr->refreshlock);
+	zmgr->refreshshutdown = true;
+	ratedests_reset(zmgr->refreshdests, 0);
+	UNLOCK(&zmgr->refreshlock);
+
 	for (size_t i = 0; i < zmgr->workers; i++) {
 		isc_mem_detach(&zmgr->mctxpool[i]);
 	}
@@ -19242,14 +20762,26 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 
 	isc_refcount_destroy(&zmgr->refs);
 	isc_ratelimiter_detach(&zmgr->checkdsrl);
-	isc_ratelimiter_detach(&zmgr->notifyrl);
-	isc_ratelimiter_detach(&zmgr->refreshrl);
 	isc_ratelimiter_detach(&zmgr->startupnotifyrl);
 	isc_ratelimiter_detach(&zmgr->startuprefreshrl);
 
+	INSIST(ISC_LIST_EMPTY(zmgr->notifyq));
+	ratedests_destroy(zmgr->mctx, &zmgr->notifydests);
+	isc_mutex_destroy(&zmgr->notifylock);
+	ratedests_destroy(zmgr->mctx, &zmgr->refreshdests);
+	isc_mutex_destroy(&zmgr->refreshlock);
+
 	isc_mem_cput(zmgr->mctx, zmgr->mctxpool, zmgr->workers,
 		     sizeof(zmgr->mctxpool[0]));
 
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		INSIST(zmgr->loadq[i].active == 0);
+		INSIST(ISC_LIST_EMPTY(zmgr->loadq[i].pending));
+		isc_mutex_destroy(&zmgr->loadq[i].lock);
+	}
+	isc_mem_cput(zmgr->mctx, zmgr->loadq, zmgr->workers,
+		     sizeof(zmgr->loadq[0]));
+
 	isc_rwlock_destroy(&zmgr->urlock);
 	isc_rwlock_destroy(&zmgr->rwlock);
 	isc_rwlock_destroy(&zmgr->tlsctx_cache_rwlock);
@@ -19259,9 +20791,81 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 	if (zmgr->tlsctx_cache != NULL) {
 		isc_tlsctx_cache_detach(&zmgr->tlsctx_cache);
 	}
+
+	for (size_t i = 0; i < dns_zonejob_max; i++) {
+		isc_histomulti_destroy(&zmgr->jobtime[i]);
+	}
+
 	isc_mem_putanddetach(&zmgr->mctx, zmgr, sizeof(*zmgr));
 }
 
+void
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr, uint64_t *pendingp,
+			    uint64_t *loadingp, uint64_t *loadedp,
+			    uint32_t *etap) {
+	uint64_t pending, loading = 0, loaded, eta = 0;
+	isc_stdtime_t started, now = isc_stdtime_now();
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(pendingp != NULL);
+	REQUIRE(loadingp != NULL);
+	REQUIRE(loadedp != NULL);
+	REQUIRE(etap != NULL);
+
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		LOCK(&zmgr->loadq[i].lock);
+		loading += zmgr->loadq[i].active;
+		UNLOCK(&zmgr->loadq[i].lock);
+	}
+
+	pending = atomic_load_acquire(&zmgr->loads_pending);
+	loaded = atomic_load_relaxed(&zmgr->loads_done);
+	started = atomic_load_relaxed(&zmgr->loads_started);
+
+	/* Assume the remaining zones load at the rate seen so far. */
+	if (pending != 0 && loaded != 0 && now > started) {
+		eta = pending * (now - started) / loaded;
+	}
+
+	*pendingp = pending;
+	*loadingp = loading;
+	*loadedp = loaded;
+	*etap = (eta > UINT32_MAX) ? UINT32_MAX : (uint32_t)eta;
+}
+
+void
+dns_zonemgr_getnotifyqueue(dns_zonemgr_t *zmgr, unsigned int *queuedp,
+			   unsigned int *destsp, uint32_t *oldestp) {
+	dns_notify_t *notify = NULL;
+	uint64_t oldest = 0;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(queuedp != NULL);
+	REQUIRE(destsp != NULL);
+	REQUIRE(oldestp != NULL);
+
+	LOCK(&zmgr->notifylock);
+	*queuedp = zmgr->notifyqueued;
+	*destsp = isc_hashmap_count(zmgr->notifydests);
+	notify = ISC_LIST_HEAD(zmgr->notifyq);
+	if (notify != NULL) {
+		isc_time_t now = isc_time_now();
+
+		oldest = isc_time_microdiff(&now, &notify->queued) / US_PER_SEC;
+	}
+	UNLOCK(&zmgr->notifylock);
+
+	*oldestp = (oldest > UINT32_MAX) ? UINT32_MAX : (uint32_t)oldest;
+}
+
+isc_histomulti_t *
+dns_zonemgr_jobtime(dns_zonemgr_t *zmgr, dns_zonejob_t job) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(job < dns_zonejob_max);
+
+	return (zmgr->jobtime[job]);
+}
+
 void
 dns_zonemgr_settransfersin(dns_zonemgr_t *zmgr, uint32_t value) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
@@ -19510,7 +21114,15 @@ void
 dns_zonemgr_setnotifyrate(dns_zonemgr_t *zmgr, unsigned int value) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
-	setrl(zmgr->notifyrl, &zmgr->notifyrate, value);
+	if (value == 0) {
+		value = 1;
+	}
+
+	/* Start every known destination over at the new rate. */
+	LOCK(&zmgr->notifylock);
+	zmgr->notifyrate = value;
+	ratedests_reset(zmgr->notifydests, value);
+	UNLOCK(&zmgr->notifylock);
 }
 
 void
@@ -19524,7 +21136,16 @@ void
 dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
-	setrl(zmgr->refreshrl, &zmgr->serialqueryrate, value);
+	if (value == 0) {
+		value = 1;
+	}
+
+	/* Start every known primary over at the new rate. */
+	LOCK(&zmgr->refreshlock);
+	zmgr->serialqueryrate = value;
+	ratedests_reset(zmgr->refreshdests, value);
+	UNLOCK(&zmgr->refreshlock);
+
 	/* XXXMPA separate out once we have the code to support this. */
 	setrl(zmgr->startuprefreshrl, &zmgr->startupserialqueryrate, value);
 }
@@ -19809,6 +21430,44 @@ dns_zone_getrcvquerystats(dns_zone_t *zone) {
 	}
 }
 
+isc_result_t
+dns_zone_setcounters(dns_zone_t *zone, dns_zonecounters_t *counters) {
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if (counters == NULL) {
+		zone->counters_on = false;
+	} else if (zone->counters == NULL) {
+		result = dns_zonecounters_alloc(counters, &zone->counterslot);
+		if (result == ISC_R_SUCCESS) {
+			dns_zonecounters_attach(counters, &zone->counters);
+			zone->counters_on = true;
+		}
+	} else {
+		zone->counters_on = true;
+	}
+	UNLOCK_ZONE(zone);
+
+	return (result);
+}
+
+/*
+ * See note from dns_zone_getrequeststats()
+ */
+dns_zonecounters_t *
+dns_zone_getcounters(dns_zone_t *zone, uint32_t *slotp) {
+	REQUIRE(slotp != NULL);
+
+	if (!zone->counters_on) {
+		return (NULL);
+	}
+
+	*slotp = zone->counterslot;
+	return (zone->counters);
+}
+
 isc_result_t
 dns_zone_setkeydirectory(dns_zone_t *zone, const char *directory) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -22123,7 +23782,7 @@ zone_rekey(dns_zone_t *zone) {
 	const char *dir = NULL;
 	isc_mem_t *mctx = NULL;
 	isc_stdtime_t now, nexttime = 0;
-	isc_time_t timenow;
+	isc_time_t timenow, keymgrstart, keymgrend;
 	isc_interval_t ival;
 	char timebuf[80];
 
@@ -22312,9 +23971,26 @@ zone_rekey(dns_zone_t *zone) {
 
 	KASP_LOCK(kasp);
 
+	keymgrstart = isc_time_now();
+
+	/*
+	 * The keymgr leaves the key files as it found them in memory, so
+	 * unless they were changed since, there is no need to read them
+	 * again.
+	 */
 	dns_zone_lock_keyfiles(zone);
-	result = dns_dnssec_findmatchingkeys(&zone->origin, kasp, dir,
-					     zone->keystores, now, mctx, &keys);
+	if (kasp != NULL && !offlineksk) {
+		if (zone->keycache == NULL) {
+			dns_dnsseckeycache_create(zone->mctx, &zone->keycache);
+		}
+		result = dns_dnsseckeycache_find(zone->keycache, &zone->origin,
+						 kasp, dir, zone->keystores,
+						 now, mctx, &keys);
+	} else {
+		result = dns_dnssec_findmatchingkeys(&zone->origin, kasp, dir,
+						     zone->keystores, now, mctx,
+						     &keys);
+	}
 	dns_zone_unlock_keyfiles(zone);
 
 	if (result != ISC_R_SUCCESS) {
@@ -22362,8 +24038,18 @@ zone_rekey(dns_zone_t *zone) {
 			result = dns_keymgr_run(&zone->origin, zone->rdclass,
 						mctx, &keys, &dnskeys, dir,
 						kasp, now, &nexttime);
+			if (result == ISC_R_SUCCESS) {
+				dns_dnsseckeycache_update(zone->keycache, kasp,
+							  dir, zone->keystores,
+							  &keys);
+			}
 			dns_zone_unlock_keyfiles(zone);
 
+			keymgrend = isc_time_now();
+			inc_stats(zone, dns_zonestatscounter_keymgrrun);
+			add_stats(zone, dns_zonestatscounter_keymgrtime,
+				  isc_time_microdiff(&keymgrend, &keymgrstart));
+
 			if (result != ISC_R_SUCCESS) {
 				dnssec_log(zone, ISC_LOG_ERROR,
 					   "zone_rekey:dns_keymgr_run "
@@ -23180,6 +24866,21 @@ dns_zone_getadded(dns_zone_t *zone) {
 	return (zone->added);
 }
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, uint64_t hash) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->confighash = hash;
+	UNLOCK_ZONE(zone);
+}
+
+uint64_t
+dns_zone_getconfighash(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	return (zone->confighash);
+}
+
 isc_result_t
 dns_zone_dlzpostload(dns_zone_t *zone, dns_db_t *db) {
 	isc_time_t loadtime;
@@ -24418,6 +26119,26 @@ dns_zone_isloaded(dns_zone_t *zone) {
 	return (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED));
 }
 
+void
+dns_zone_demand(dns_zone_t *zone) {
+	isc_stdtime_t now;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND)) {
+		return;
+	}
+
+	now = isc_stdtime_now();
+	if (atomic_load_relaxed(&zone->demandtime) != now) {
+		atomic_store_relaxed(&zone->demandtime, now);
+	}
+
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		(void)dns_zone_asyncload(zone, false, NULL, NULL);
+	}
+}
+
 isc_result_t
 dns_zone_verifydb(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver) {
 	dns_dbversion_t *version = NULL;
@@ -24449,7 +26170,8 @@ dns_zone_verifydb(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver) {
 
 	origin = dns_db_origin(db);
 	result = dns_zoneverify_dnssec(zone, db, version, origin, secroots,
-				       zone->mctx, true, false, dnssec_report);
+				       zone->mctx, true, false, 1,
+				       dnssec_report);
 
 done:
 	if (secroots != NULL) {
@@ -24558,6 +26280,13 @@ dns_zone_makedb(dns_zone_t *zone, dns_db_t **dbp) {
 	dns_db_setmaxrrperset(db, zone->maxrrperset);
 	dns_db_setmaxtypepername(db, zone->maxtypepername);
 
+	if (zone->view != NULL && zone->view->sharedzonetrie) {
+		dns__compactdb_share(db, zone->view);
+	}
+	if (zone->view != NULL && zone->view->slabstore != NULL) {
+		dns__qpzone_setslabstore(db, zone->view->slabstore);
+	}
+
 	*dbp = db;
 
 	return (ISC_R_SUCCESS);
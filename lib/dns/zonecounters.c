@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/stats.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+#include <dns/rcode.h>
+#include <dns/types.h>
+#include <dns/zonecounters.h>
+
+#define ZONECOUNTERS_MAGIC    ISC_MAGIC('Z', 'C', 't', 'r')
+#define VALID_ZONECOUNTERS(m) ISC_MAGIC_VALID(m, ZONECOUNTERS_MAGIC)
+
+#define CHUNK_COUNTERS (DNS_ZONECOUNTERS_CHUNKSIZE * dns_zonecounter_max)
+
+typedef isc_atomic_statscounter_t chunk_t[CHUNK_COUNTERS];
+
+struct dns_zonecounters {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+
+	/*
+	 * Shard 0 is shared by the threads that are not loops; shard
+	 * 'tid + 1' belongs to loop 'tid'.  The chunks of shard 's' are
+	 * at chunks[s * DNS_ZONECOUNTERS_CHUNKS ...].
+	 */
+	uint32_t nshards;
+	atomic_ptr(chunk_t) *chunks;
+
+	/* Lock covers the slot allocation. */
+	isc_mutex_t lock;
+	uint32_t nslots;    /*%< slots ever allocated */
+	uint32_t *free;	    /*%< released slots */
+	uint32_t nfree;
+	uint32_t freealloc;
+};
+
+void
+dns_zonecounters_create(isc_mem_t *mctx, dns_zonecounters_t **zcp) {
+	dns_zonecounters_t *zc = NULL;
+	size_t n;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(zcp != NULL && *zcp == NULL);
+
+	zc = isc_mem_get(mctx, sizeof(*zc));
+	*zc = (dns_zonecounters_t){
+		.nshards = isc_tid_count() + 1,
+		.references = ISC_REFCOUNT_INITIALIZER(1),
+	};
+	isc_mem_attach(mctx, &zc->mctx);
+	isc_mutex_init(&zc->lock);
+
+	n = (size_t)zc->nshards * DNS_ZONECOUNTERS_CHUNKS;
+	zc->chunks = isc_mem_cget(mctx, n, sizeof(zc->chunks[0]));
+	for (size_t i = 0; i < n; i++) {
+		atomic_init(&zc->chunks[i], NULL);
+	}
+
+	zc->magic = ZONECOUNTERS_MAGIC;
+	*zcp = zc;
+}
+
+static void
+zonecounters_destroy(dns_zonecounters_t *zc) {
+	size_t n = (size_t)zc->nshards * DNS_ZONECOUNTERS_CHUNKS;
+
+	zc->magic = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		chunk_t *chunk = atomic_load_acquire(&zc->chunks[i]);
+		if (chunk != NULL) {
+			isc_mem_put(zc->mctx, chunk, sizeof(*chunk));
+		}
+	}
+	isc_mem_cput(zc->mctx, zc->chunks, n, sizeof(zc->chunks[0]));
+
+	if (zc->free != NULL) {
+		isc_mem_cput(zc->mctx, zc->free, zc->freealloc,
+			     sizeof(zc->free[0]));
+	}
+	isc_mutex_destroy(&zc->lock);
+	isc_mem_putanddetach(&zc->mctx, zc, sizeof(*zc));
+}
+
+ISC_REFCOUNT_IMPL(dns_zonecounters, zonecounters_destroy);
+
+/*
+ * Return the counters of 'slot' in 'shard', or NULL if its chunk has
+ * not been allocated yet and 'create' is false.
+ */
+static isc_atomic_statscounter_t *
+zonecounters_slot(dns_zonecounters_t *zc, uint32_t shard, uint32_t slot,
+		  bool create) {
+	atomic_ptr(chunk_t) *chunkp =
+		&zc->chunks[(size_t)shard * DNS_ZONECOUNTERS_CHUNKS +
+			    slot / DNS_ZONECOUNTERS_CHUNKSIZE];
+	chunk_t *chunk = atomic_load_acquire(chunkp);
+
+	if (chunk == NULL) {
+		chunk_t *expected = NULL;
+
+		if (!create) {
+			return (NULL);
+		}
+
+		chunk = isc_mem_get(zc->mctx, sizeof(*chunk));
+		for (size_t i = 0; i < CHUNK_COUNTERS; i++) {
+			atomic_init(&(*chunk)[i], 0);
+		}
+
+		/*
+		 * The shared shard can be written by several threads at
+		 * once; keep the chunk that was installed first.
+		 */
+		if (!atomic_compare_exchange_strong_acq_rel(chunkp, &expected,
+							    chunk))
+		{
+			isc_mem_put(zc->mctx, chunk, sizeof(*chunk));
+			chunk = expected;
+		}
+	}
+
+	return (&(*chunk)[(slot % DNS_ZONECOUNTERS_CHUNKSIZE) *
+			  dns_zonecounter_max]);
+}
+
+isc_result_t
+dns_zonecounters_alloc(dns_zonecounters_t *zc, uint32_t *slotp) {
+	uint32_t slot;
+
+	REQUIRE(VALID_ZONECOUNTERS(zc));
+	REQUIRE(slotp != NULL);
+
+	LOCK(&zc->lock);
+	if (zc->nfree > 0) {
+		slot = zc->free[--zc->nfree];
+	} else if (zc->nslots < DNS_ZONECOUNTERS_MAXSLOTS) {
+		slot = zc->nslots++;
+	} else {
+		UNLOCK(&zc->lock);
+		return (ISC_R_NOSPACE);
+	}
+	UNLOCK(&zc->lock);
+
+	/*
+	 * A released slot may still hold the counts of its previous
+	 * zone.
+	 */
+	for (uint32_t shard = 0; shard < zc->nshards; shard++) {
+		isc_atomic_statscounter_t *counters =
+			zonecounters_slot(zc, shard, slot, false);
+		if (counters == NULL) {
+			continue;
+		}
+		for (size_t i = 0; i < dns_zonecounter_max; i++) {
+			atomic_store_release(&counters[i], 0);
+		}
+	}
+
+	*slotp = slot;
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_zonecounters_release(dns_zonecounters_t *zc, uint32_t slot) {
+	REQUIRE(VALID_ZONECOUNTERS(zc));
+	REQUIRE(slot < zc->nslots);
+
+	LOCK(&zc->lock);
+	if (zc->nfree == zc->freealloc) {
+		uint32_t newalloc = ISC_MAX(64, zc->freealloc * 2);
+		zc->free = isc_mem_creget(zc->mctx, zc->free, zc->freealloc,
+					  newalloc, sizeof(zc->free[0]));
+		zc->freealloc = newalloc;
+	}
+	zc->free[zc->nfree++] = slot;
+	UNLOCK(&zc->lock);
+}
+
+static void
+zonecounters_add(isc_atomic_statscounter_t *counter, isc_statscounter_t value,
+		 bool shared) {
+	if (shared) {
+		atomic_fetch_add_relaxed(counter, value);
+	} else {
+		atomic_store_relaxed(counter,
+				     atomic_load_relaxed(counter) + value);
+	}
+}
+
+void
+dns_zonecounters_response(dns_zonecounters_t *zc, uint32_t slot,
+			  dns_rcode_t rcode, size_t length,
+			  isc_nanosecs_t latency) {
+	isc_atomic_statscounter_t *counters = NULL;
+	uint32_t tid = isc_tid();
+	uint32_t shard = 0;
+	unsigned int bucket;
+
+	REQUIRE(VALID_ZONECOUNTERS(zc));
+	REQUIRE(slot < DNS_ZONECOUNTERS_MAXSLOTS);
+
+	if (tid < zc->nshards - 1) {
+		shard = tid + 1;
+	}
+	counters = zonecounters_slot(zc, shard, slot, true);
+
+	if (latency < 100 * NS_PER_US) {
+		bucket = dns_zonecounter_latency0;
+	} else if (latency < NS_PER_MS) {
+		bucket = dns_zonecounter_latency1;
+	} else if (latency < 10 * (isc_nanosecs_t)NS_PER_MS) {
+		bucket = dns_zonecounter_latency2;
+	} else if (latency < 100 * (isc_nanosecs_t)NS_PER_MS) {
+		bucket = dns_zonecounter_latency3;
+	} else {
+		bucket = dns_zonecounter_latency4;
+	}
+
+	zonecounters_add(&counters[dns_zonecounter_queries], 1, shard == 0);
+	if (rcode == dns_rcode_nxdomain) {
+		zonecounters_add(&counters[dns_zonecounter_nxdomain], 1,
+				 shard == 0);
+	}
+	zonecounters_add(&counters[dns_zonecounter_bytesout], length,
+			 shard == 0);
+	zonecounters_add(&counters[bucket], 1, shard == 0);
+}
+
+void
+dns_zonecounters_get(dns_zonecounters_t *zc, uint32_t slot,
+		     uint64_t values[dns_zonecounter_max]) {
+	REQUIRE(VALID_ZONECOUNTERS(zc));
+	REQUIRE(slot < DNS_ZONECOUNTERS_MAXSLOTS);
+	REQUIRE(values != NULL);
+
+	for (size_t i = 0; i < dns_zonecounter_max; i++) {
+		values[i] = 0;
+	}
+
+	for (uint32_t shard = 0; shard < zc->nshards; shard++) {
+		isc_atomic_statscounter_t *counters =
+			zonecounters_slot(zc, shard, slot, false);
+		if (counters == NULL) {
+			continue;
+		}
+		for (size_t i = 0; i < dns_zonecounter_max; i++) {
+			values[i] += atomic_load_acquire(&counters[i]);
+		}
+	}
+}
@@ -25,8 +25,10 @@
 #include <isc/iterated_hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/region.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -58,6 +60,7 @@ typedef struct vctx {
 	dns_dbversion_t *ver;
 	dns_name_t *origin;
 	dns_keytable_t *secroots;
+	unsigned int nthreads;
 	bool goodksk;
 	bool goodzsk;
 	dns_rdataset_t keyset;
@@ -806,7 +809,8 @@ verifynsec3s(const vctx_t *vctx, const dns_name_t *name,
 
 static isc_result_t
 verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
-	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys) {
+	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys,
+	  unsigned char *bad_algorithms) {
 	unsigned char set_algorithms[256] = { 0 };
 	char namebuf[DNS_NAME_FORMATSIZE];
 	char algbuf[DNS_SECALG_FORMATSIZE];
@@ -840,7 +844,7 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 				     typebuf);
 		for (size_t i = 0; i < ARRAY_SIZE(set_algorithms); i++) {
 			if (vctx->act_algorithms[i] != 0) {
-				vctx->bad_algorithms[i] = 1;
+				bad_algorithms[i] = 1;
 			}
 		}
 		result = ISC_R_SUCCESS;
@@ -893,7 +897,7 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 						     "No correct %s signature "
 						     "for %s %s",
 						     algbuf, namebuf, typebuf);
-				vctx->bad_algorithms[i] = 1;
+				bad_algorithms[i] = 1;
 			}
 		}
 	}
@@ -907,9 +911,58 @@ done:
 	return (result);
 }
 
+/*
+ * Check the signatures of the RRsets at 'node' that should be signed.
+ * Algorithms lacking a correct signature are flagged in 'bad_algorithms'.
+ */
 static isc_result_t
-verifynode(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
+verifysigs(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
 	   bool delegation, dst_key_t **dstkeys, size_t nkeys,
+	   unsigned char *bad_algorithms) {
+	dns_rdataset_t rdataset;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	isc_result_t result;
+
+	result = dns_db_allrdatasets(vctx->db, node, vctx->ver, 0, 0, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		zoneverify_log_error(vctx, "dns_db_allrdatasets(): %s",
+				     isc_result_totext(result));
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter))
+	{
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+		if (rdataset.type != dns_rdatatype_rrsig &&
+		    (!delegation || rdataset.type == dns_rdatatype_ds ||
+		     rdataset.type == dns_rdatatype_nsec))
+		{
+			result = verifyset(vctx, &rdataset, name, node, dstkeys,
+					   nkeys, bad_algorithms);
+		}
+		dns_rdataset_disassociate(&rdataset);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	dns_rdatasetiter_destroy(&rdsiter);
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+/*
+ * Check the RRsets at 'node' and, if 'vresult' is not NULL, its NSEC
+ * and NSEC3 records.  The signatures are only checked if 'checksigs' is
+ * true; otherwise the caller checks them later with verifysigs().
+ */
+static isc_result_t
+verifynode(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
+	   bool delegation, bool checksigs, dst_key_t **dstkeys, size_t nkeys,
 	   dns_rdataset_t *nsecset, dns_rdataset_t *nsec3paramset,
 	   const dns_name_t *nextname, isc_result_t *vresult) {
 	unsigned char types[8192] = { 0 };
@@ -942,8 +995,11 @@ verifynode(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
 		    (!delegation || rdataset.type == dns_rdatatype_ds ||
 		     rdataset.type == dns_rdatatype_nsec))
 		{
-			result = verifyset(vctx, &rdataset, name, node, dstkeys,
-					   nkeys);
+			if (checksigs) {
+				result = verifyset(vctx, &rdataset, name, node,
+						   dstkeys, nkeys,
+						   vctx->bad_algorithms);
+			}
 			if (result != ISC_R_SUCCESS) {
 				dns_rdataset_disassociate(&rdataset);
 				dns_rdatasetiter_destroy(&rdsiter);
@@ -1284,6 +1340,7 @@ vctx_init(vctx_t *vctx, isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db,
 	vctx->ver = ver;
 	vctx->origin = origin;
 	vctx->secroots = secroots;
+	vctx->nthreads = 1;
 	vctx->goodksk = false;
 	vctx->goodzsk = false;
 
@@ -1691,6 +1748,121 @@ determine_active_algorithms(vctx_t *vctx, bool ignore_kskflag,
  * Check that all the records not yet verified were signed by keys that are
  * present in the DNSKEY RRset.
  */
+/*
+ * When verifying with more than one thread, the walk over the zone still
+ * checks the NSEC and NSEC3 records of each node in order, but defers
+ * the signature checks, which take nearly all of the time.  The nodes
+ * are collected in one batch per thread, and once all the batches are
+ * full, the threads check the signatures of a batch each.
+ */
+#define VERIFY_BATCHSIZE 512
+
+typedef struct verify_batch {
+	dns_fixedname_t names[VERIFY_BATCHSIZE];
+	dns_dbnode_t *nodes[VERIFY_BATCHSIZE];
+	bool delegation[VERIFY_BATCHSIZE];
+	size_t count;
+	unsigned char bad_algorithms[256];
+	isc_result_t result;
+} verify_batch_t;
+
+typedef struct verify_parallel {
+	vctx_t *vctx;
+	dst_key_t **dstkeys;
+	size_t nkeys;
+	verify_batch_t *batches;
+	isc_thread_t *threads;
+	size_t nbatches;
+	size_t current;
+	size_t ready;
+	atomic_size_t next;
+} verify_parallel_t;
+
+/*
+ * Add 'node' to the batch being filled.  Returns true when all the
+ * batches are full and must be flushed with verify_flush().
+ */
+static bool
+verify_defer(verify_parallel_t *vp, const dns_name_t *name,
+	     dns_dbnode_t *node, bool delegation) {
+	verify_batch_t *batch = &vp->batches[vp->current];
+	size_t i = batch->count++;
+
+	dns_name_copy(name, dns_fixedname_initname(&batch->names[i]));
+	batch->nodes[i] = NULL;
+	dns_db_attachnode(vp->vctx->db, node, &batch->nodes[i]);
+	batch->delegation[i] = delegation;
+
+	if (batch->count == VERIFY_BATCHSIZE) {
+		vp->current++;
+	}
+	return (vp->current == vp->nbatches);
+}
+
+static void *
+verify_worker(void *arg) {
+	verify_parallel_t *vp = arg;
+	vctx_t *vctx = vp->vctx;
+	size_t b;
+
+	while ((b = atomic_fetch_add_relaxed(&vp->next, 1)) < vp->ready) {
+		verify_batch_t *batch = &vp->batches[b];
+
+		batch->result = ISC_R_SUCCESS;
+		for (size_t i = 0; i < batch->count; i++) {
+			dns_name_t *name = dns_fixedname_name(&batch->names[i]);
+
+			if (batch->result == ISC_R_SUCCESS) {
+				batch->result = verifysigs(
+					vctx, name, batch->nodes[i],
+					batch->delegation[i], vp->dstkeys,
+					vp->nkeys, batch->bad_algorithms);
+			}
+			dns_db_detachnode(vctx->db, &batch->nodes[i]);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Check the signatures of the nodes collected so far, using a thread
+ * per batch.  The caller must have paused its database iterator.
+ */
+static isc_result_t
+verify_flush(verify_parallel_t *vp) {
+	vctx_t *vctx = vp->vctx;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	vp->ready = ISC_MIN(vp->current + 1, vp->nbatches);
+	atomic_init(&vp->next, 0);
+	for (size_t i = 1; i < vp->ready; i++) {
+		isc_thread_create(verify_worker, vp, &vp->threads[i]);
+	}
+	(void)verify_worker(vp);
+	for (size_t i = 1; i < vp->ready; i++) {
+		isc_thread_join(vp->threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < vp->ready; i++) {
+		verify_batch_t *batch = &vp->batches[i];
+
+		if (result == ISC_R_SUCCESS && batch->count > 0) {
+			result = batch->result;
+		}
+		for (size_t j = 0; j < ARRAY_SIZE(batch->bad_algorithms); j++)
+		{
+			if (batch->bad_algorithms[j] != 0) {
+				vctx->bad_algorithms[j] = 1;
+			}
+		}
+		batch->count = 0;
+	}
+	vp->current = 0;
+
+	return (result);
+}
+
 static isc_result_t
 verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	dns_fixedname_t fname, fnextname, fprevname, fzonecut;
@@ -1700,6 +1872,8 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	dst_key_t **dstkeys;
 	size_t count, nkeys = 0;
 	bool done = false;
+	bool parallel = (vctx->nthreads > 1);
+	verify_parallel_t vp = { .vctx = vctx };
 	isc_result_t tvresult = ISC_R_UNSET;
 	isc_result_t result;
 
@@ -1726,6 +1900,16 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 		}
 	}
 
+	if (parallel) {
+		vp.dstkeys = dstkeys;
+		vp.nkeys = nkeys;
+		vp.nbatches = vctx->nthreads;
+		vp.batches = isc_mem_cget(vctx->mctx, vp.nbatches,
+					  sizeof(vp.batches[0]));
+		vp.threads = isc_mem_cget(vctx->mctx, vp.nbatches,
+					  sizeof(vp.threads[0]));
+	}
+
 	result = dns_db_createiterator(vctx->db, DNS_DB_NONSEC3, &dbiter);
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
@@ -1831,13 +2015,22 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 			dns_db_detachnode(vctx->db, &node);
 			goto done;
 		}
-		result = verifynode(vctx, name, node, isdelegation, dstkeys,
-				    nkeys, &vctx->nsecset, &vctx->nsec3paramset,
-				    nextname, &tvresult);
+		result = verifynode(vctx, name, node, isdelegation, !parallel,
+				    dstkeys, nkeys, &vctx->nsecset,
+				    &vctx->nsec3paramset, nextname, &tvresult);
 		if (result != ISC_R_SUCCESS) {
 			dns_db_detachnode(vctx->db, &node);
 			goto done;
 		}
+		if (parallel && verify_defer(&vp, name, node, isdelegation)) {
+			RUNTIME_CHECK(dns_dbiterator_pause(dbiter) ==
+				      ISC_R_SUCCESS);
+			result = verify_flush(&vp);
+			if (result != ISC_R_SUCCESS) {
+				dns_db_detachnode(vctx->db, &node);
+				goto done;
+			}
+		}
 		if (*vresult == ISC_R_UNSET) {
 			*vresult = ISC_R_SUCCESS;
 		}
@@ -1881,8 +2074,8 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 					     isc_result_totext(result));
 			goto done;
 		}
-		result = verifynode(vctx, name, node, false, dstkeys, nkeys,
-				    NULL, NULL, NULL, NULL);
+		result = verifynode(vctx, name, node, false, !parallel,
+				    dstkeys, nkeys, NULL, NULL, NULL, NULL);
 		if (result != ISC_R_SUCCESS) {
 			zoneverify_log_error(vctx, "verifynode: %s",
 					     isc_result_totext(result));
@@ -1890,6 +2083,13 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 			goto done;
 		}
 		result = record_found(vctx, name, node, &vctx->nsec3paramset);
+		if (result == ISC_R_SUCCESS && parallel &&
+		    verify_defer(&vp, name, node, false))
+		{
+			RUNTIME_CHECK(dns_dbiterator_pause(dbiter) ==
+				      ISC_R_SUCCESS);
+			result = verify_flush(&vp);
+		}
 		dns_db_detachnode(vctx->db, &node);
 		if (result != ISC_R_SUCCESS) {
 			goto done;
@@ -1897,8 +2097,25 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	}
 
 	result = ISC_R_SUCCESS;
+	if (parallel) {
+		dns_dbiterator_destroy(&dbiter);
+		result = verify_flush(&vp);
+	}
 
 done:
+	if (vp.batches != NULL) {
+		for (size_t i = 0; i < vp.nbatches; i++) {
+			verify_batch_t *batch = &vp.batches[i];
+
+			for (size_t j = 0; j < batch->count; j++) {
+				dns_db_detachnode(vctx->db, &batch->nodes[j]);
+			}
+		}
+		isc_mem_cput(vctx->mctx, vp.batches, vp.nbatches,
+			     sizeof(vp.batches[0]));
+		isc_mem_cput(vctx->mctx, vp.threads, vp.nbatches,
+			     sizeof(vp.threads[0]));
+	}
 	while (nkeys-- > 0U) {
 		dst_key_free(&dstkeys[nkeys]);
 	}
@@ -1968,12 +2185,16 @@ isc_result_t
 dns_zoneverify_dnssec(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		      dns_name_t *origin, dns_keytable_t *secroots,
 		      isc_mem_t *mctx, bool ignore_kskflag, bool keyset_kskonly,
-		      void (*report)(const char *, ...)) {
+		      unsigned int nthreads, void (*report)(const char *, ...)) {
 	const char *keydesc = (secroots == NULL ? "self-signed" : "trusted");
 	isc_result_t result, vresult = ISC_R_UNSET;
 	vctx_t vctx;
 
 	vctx_init(&vctx, mctx, zone, db, ver, origin, secroots);
+	if (nthreads == 0) {
+		nthreads = isc_os_ncpus();
+	}
+	vctx.nthreads = nthreads;
 
 	result = check_apex_rrsets(&vctx);
 	if (result != ISC_R_SUCCESS) {
@@ -24,6 +24,7 @@
 #include <isc/result.h>
 #include <isc/string.h>
 #include <isc/tid.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 
 #include <dns/name.h>
@@ -53,6 +54,16 @@ struct zt_load_params {
 	bool newonly;
 };
 
+/*
+ * A zone removed from the table is only detached after an RCU grace
+ * period, so that readers can use it without taking a reference.
+ */
+struct zt_detach {
+	isc_mem_t *mctx;
+	dns_zone_t *zone;
+	struct rcu_head rcu_head;
+};
+
 struct zt_freeze_params {
 	dns_view_t *view;
 	bool freeze;
@@ -65,11 +76,26 @@ ztqpattach(void *uctx ISC_ATTR_UNUSED, void *pval,
 	dns_zone_ref(zone);
 }
 
+static void
+ztdetach_cb(struct rcu_head *rcu_head) {
+	struct zt_detach *ztd = caa_container_of(rcu_head, struct zt_detach,
+						 rcu_head);
+
+	dns_zone_detach(&ztd->zone);
+	isc_mem_putanddetach(&ztd->mctx, ztd, sizeof(*ztd));
+}
+
 static void
 ztqpdetach(void *uctx ISC_ATTR_UNUSED, void *pval,
 	   uint32_t ival ISC_ATTR_UNUSED) {
 	dns_zone_t *zone = pval;
-	dns_zone_detach(&zone);
+	struct zt_detach *ztd = NULL;
+	isc_mem_t *mctx = dns_zone_getmctx(zone);
+
+	ztd = isc_mem_get(mctx, sizeof(*ztd));
+	*ztd = (struct zt_detach){ .zone = zone };
+	isc_mem_attach(mctx, &ztd->mctx);
+	call_rcu(&ztd->rcu_head, ztdetach_cb);
 }
 
 static size_t
@@ -164,8 +190,8 @@ dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 }
 
 isc_result_t
-dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
-	    dns_zone_t **zonep) {
+dns_zt_lookup(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
+	      dns_zone_t **zonep) {
 	isc_result_t result;
 	dns_qpread_t qpr;
 	void *pval = NULL;
@@ -174,6 +200,7 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
 	dns_qpchain_t chain;
 
 	REQUIRE(VALID_ZT(zt));
+	REQUIRE(zonep != NULL && *zonep == NULL);
 	REQUIRE(exactopts != exactmask);
 
 	dns_qpmulti_query(zt->multi, &qpr);
@@ -223,13 +250,31 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
 		{
 			result = ISC_R_NOTFOUND;
 		} else {
-			dns_zone_attach(zone, zonep);
+			*zonep = zone;
 		}
 	}
 
 	return (result);
 }
 
+isc_result_t
+dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
+	    dns_zone_t **zonep) {
+	isc_result_t result;
+	dns_zone_t *zone = NULL;
+
+	REQUIRE(zonep != NULL && *zonep == NULL);
+
+	rcu_read_lock();
+	result = dns_zt_lookup(zt, name, options, &zone);
+	if (zone != NULL) {
+		dns_zone_attach(zone, zonep);
+	}
+	rcu_read_unlock();
+
+	return (result);
+}
+
 void
 dns_zt_attach(dns_zt_t *zt, dns_zt_t **ztp) {
 	REQUIRE(VALID_ZT(zt));
@@ -280,9 +325,24 @@ dns_zt_flush(dns_zt_t *zt) {
 	atomic_store_release(&zt->flush, true);
 }
 
+/*
+ * Return false for a load-on-demand zone that has not been loaded yet,
+ * true for any other zone.
+ */
+static bool
+ondemand_loaded(dns_zone_t *zone) {
+	return ((dns_zone_getoptions(zone) & DNS_ZONEOPT_LOADONDEMAND) == 0 ||
+		dns_zone_isloaded(zone));
+}
+
 static isc_result_t
 load(dns_zone_t *zone, void *uap) {
 	isc_result_t result;
+
+	if (!ondemand_loaded(zone)) {
+		return (ISC_R_SUCCESS);
+	}
+
 	result = dns_zone_load(zone, uap != NULL);
 	if (result == DNS_R_CONTINUE || result == DNS_R_UPTODATE ||
 	    result == DNS_R_DYNAMIC)
@@ -343,6 +403,14 @@ asyncload(dns_zone_t *zone, void *uap) {
 	REQUIRE(VALID_ZT(zt));
 	REQUIRE(zone != NULL);
 
+	/*
+	 * A load-on-demand zone is only registered by name here; it is
+	 * loaded when first queried (see dns_zone_demand()).
+	 */
+	if (!ondemand_loaded(zone)) {
+		return (ISC_R_SUCCESS);
+	}
+
 	isc_refcount_increment(&zt->references);
 	isc_refcount_increment(&zt->loads_pending);
 
@@ -513,6 +581,13 @@ dns_zt_setviewrevert(dns_zt_t *zt) {
 isc_result_t
 dns_zt_apply(dns_zt_t *zt, bool stop, isc_result_t *sub,
 	     isc_result_t (*action)(dns_zone_t *, void *), void *uap) {
+	return (dns_zt_applyfrom(zt, NULL, stop, sub, action, uap));
+}
+
+isc_result_t
+dns_zt_applyfrom(dns_zt_t *zt, const dns_name_t *after, bool stop,
+		 isc_result_t *sub,
+		 isc_result_t (*action)(dns_zone_t *, void *), void *uap) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_result_t tresult = ISC_R_SUCCESS;
 	dns_qpiter_t qpi;
@@ -525,6 +600,22 @@ dns_zt_apply(dns_zt_t *zt, bool stop, isc_result_t *sub,
 	dns_qpmulti_query(zt->multi, &qpr);
 	dns_qpiter_init(&qpr, &qpi);
 
+	if (after != NULL) {
+		/*
+		 * Position the iterator on 'after' or its closest
+		 * predecessor, so that the walk below starts with the
+		 * first zone sorting after it.  If there is no such
+		 * predecessor, start from the beginning.
+		 */
+		(void)dns_qp_lookup(&qpr, after, NULL, &qpi, NULL, NULL, NULL);
+		if (dns_qpiter_current(&qpi, NULL, &zone, NULL) !=
+			    ISC_R_SUCCESS ||
+		    dns_name_compare(dns_zone_getorigin(zone), after) > 0)
+		{
+			dns_qpiter_init(&qpr, &qpi);
+		}
+	}
+
 	while (dns_qpiter_next(&qpi, NULL, &zone, NULL) == ISC_R_SUCCESS) {
 		result = action(zone, uap);
 		if (tresult == ISC_R_SUCCESS) {
@@ -55,10 +55,16 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	 * queue.
 	 *
 	 * The function returns 'false' in case the queue was empty - in such
-	 * case we need to trigger the async callback.
+	 * case we need to trigger the async callback, unless the loop is
+	 * running the async callback right now: it checks the queue again
+	 * before returning (see isc__async_cb() below).
+	 *
+	 * cds_wfcq_enqueue() implies a full memory barrier, so the load below
+	 * cannot be reordered before the enqueue.
 	 */
 	if (!cds_wfcq_enqueue(&loop->async_jobs.head, &loop->async_jobs.tail,
-			      &job->wfcq_node))
+			      &job->wfcq_node) &&
+	    !atomic_load(&loop->async_draining))
 	{
 		int r = uv_async_send(&loop->async_trigger);
 		UV_RUNTIME_CHECK(uv_async_send, r);
@@ -66,11 +72,35 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 }
 
 void
-isc__async_cb(uv_async_t *handle) {
-	isc_loop_t *loop = uv_handle_get_data(handle);
-	isc_jobqueue_t jobs;
-
+isc_async_background(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	isc_job_t *job = isc_mem_get(loop->mctx, sizeof(*job));
+	*job = (isc_job_t){
+		.cb = cb,
+		.cbarg = cbarg,
+	};
+
+	cds_wfcq_node_init(&job->wfcq_node);
+
+	/*
+	 * The background queue is only drained partially, and the async
+	 * callback triggers itself again when it leaves jobs behind (see
+	 * async_run_background() below), so a job added to an empty queue
+	 * always needs a trigger.
+	 */
+	if (!cds_wfcq_enqueue(&loop->async_background.head,
+			      &loop->async_background.tail, &job->wfcq_node))
+	{
+		int r = uv_async_send(&loop->async_trigger);
+		UV_RUNTIME_CHECK(uv_async_send, r);
+	}
+}
+
+static bool
+async_run(isc_loop_t *loop) {
+	isc_jobqueue_t jobs;
 
 	/* Initialize local wfcqueue */
 	__cds_wfcq_init(&jobs.head, &jobs.tail);
@@ -97,7 +127,7 @@ isc__async_cb(uv_async_t *handle) {
 		 * Nothing to do, the source queue was empty - most
 		 * probably we were called from isc__async_close() below.
 		 */
-		return;
+		return (false);
 	}
 
 	/*
@@ -112,11 +142,82 @@ isc__async_cb(uv_async_t *handle) {
 
 		isc_mem_put(loop->mctx, job, sizeof(*job));
 	}
+
+	return (true);
+}
+
+/*
+ * Run the background jobs one by one until the loop tick is over its
+ * time budget.  If any are left, trigger the async callback again: it
+ * runs in the next loop iteration, after the loop has polled for I/O.
+ *
+ * The loop thread is the only consumer of the background queue, so the
+ * unlocked __cds_wfcq_dequeue_blocking() is safe to use here.
+ */
+static void
+async_run_background(isc_loop_t *loop, bool all) {
+	struct cds_wfcq_node *node = NULL;
+
+	while ((node = __cds_wfcq_dequeue_blocking(
+			&loop->async_background.head,
+			&loop->async_background.tail)) != NULL)
+	{
+		isc_job_t *job = caa_container_of(node, isc_job_t, wfcq_node);
+
+		job->cb(job->cbarg);
+
+		isc_mem_put(loop->mctx, job, sizeof(*job));
+
+		if (!all && isc_loop_shouldyield()) {
+			break;
+		}
+	}
+
+	if (!all && !cds_wfcq_empty(&loop->async_background.head,
+				    &loop->async_background.tail))
+	{
+		int r = uv_async_send(&loop->async_trigger);
+		UV_RUNTIME_CHECK(uv_async_send, r);
+	}
+}
+
+void
+isc__async_cb(uv_async_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	REQUIRE(VALID_LOOP(loop));
+
+	/*
+	 * While the jobs are running, isc_async_run() does not wake the
+	 * loop up for jobs it adds to an empty queue.  Those jobs are
+	 * picked up by the second run below, which is done after clearing
+	 * the flag, so any job added later triggers the callback again in
+	 * the usual way.  This saves a wakeup (an eventfd write) per batch
+	 * on busy loops.
+	 */
+	atomic_store(&loop->async_draining, true);
+	(void)async_run(loop);
+	atomic_store(&loop->async_draining, false);
+
+	/* Order the store above before reading the queue state */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (!cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail)) {
+		(void)async_run(loop);
+	}
+
+	async_run_background(loop, false);
 }
 
 void
 isc__async_close(uv_handle_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
 
-	isc__async_cb(&loop->async_trigger);
+	do {
+		while (async_run(loop)) {
+			/* Run everything that is left */
+		}
+		async_run_background(loop, true);
+	} while (!cds_wfcq_empty(&loop->async_jobs.head,
+				 &loop->async_jobs.tail));
 }
@@ -24,6 +24,18 @@
  * b. https://dspace.mit.edu/bitstream/handle/1721.1/130693/1251799942-MIT.pdf
  * c.
  * https://codecapsule.com/2013/11/17/robin-hood-hashing-backward-shift-deletion/
+ *
+ * Hashmaps created with ISC_HASHMAP_GROUPED use a different layout, in
+ * the style of the Swiss tables described in [d]: next to the nodes,
+ * every slot has a control byte that is either EMPTY, DELETED, or the
+ * low 7 bits of the hash value of its node.  The slots are probed in
+ * groups of GROUP_WIDTH, whose control bytes are compared all at once,
+ * with SSE2 or NEON instructions where available, so that only the
+ * nodes with a matching control byte are looked at.  Deleted nodes
+ * leave a tombstone behind, and the table is rebuilt all at once when
+ * it runs out of empty slots.
+ *
+ * d. https://abseil.io/about/design/swisstables
  */
 
 #include <ctype.h>
@@ -41,6 +53,12 @@
 #include <isc/types.h>
 #include <isc/util.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #define APPROX_99_PERCENT(x) (((x) * 1013) >> 10)
 #define APPROX_95_PERCENT(x) (((x) * 972) >> 10)
 #define APPROX_90_PERCENT(x) (((x) * 921) >> 10)
@@ -67,6 +85,21 @@
 #define HASHMAP_MIN_BITS 1U
 #define HASHMAP_MAX_BITS 32U
 
+/*
+ * The grouped table has (GROUP_WIDTH << groupbits) slots, at most 7/8
+ * of which are filled, so a probe always ends at an empty slot.
+ */
+#define GROUP_WIDTH	   16U
+#define GROUP_SHIFT	   4U
+#define GROUP_MIN_BITS	   1U
+#define GROUP_MAX_BITS	   (HASHMAP_MAX_BITS - GROUP_SHIFT)
+#define GROUP_MAXLOAD(cap) ((cap) - (cap) / 8)
+
+#define CTRL_EMPTY	 0x80
+#define CTRL_DELETED	 0xFE
+#define CTRL_ISFULL(c)	 (((c) & 0x80) == 0)
+#define CTRL_H2(hashval) ((uint8_t)((hashval) & 0x7F))
+
 typedef struct hashmap_node {
 	const void *key;
 	void *value;
@@ -89,6 +122,14 @@ struct isc_hashmap {
 	size_t count;
 	hashmap_table_t tables[HASHMAP_NUM_TABLES];
 	atomic_uint_fast32_t iterators;
+
+	/* ISC_HASHMAP_GROUPED */
+	bool grouped;
+	uint8_t groupbits;
+	size_t capacity;
+	size_t growth_left; /* empty slots that can still be filled */
+	uint8_t *ctrl;
+	hashmap_node_t *slots;
 };
 
 struct isc_hashmap_iter {
@@ -206,8 +247,249 @@ hashmap_free_table(isc_hashmap_t *hashmap, const uint8_t idx, bool cleanup) {
 	};
 }
 
+/*
+ * Group matching: return a mask with one bit set for each of the
+ * GROUP_WIDTH control bytes at 'ctrl' that is equal to 'byte', or that
+ * is not full.  The NEON mask has four bits per byte, so the bits are
+ * spaced by (1 << GROUP_MASK_SHIFT).
+ */
+typedef uint64_t group_mask_t;
+
+#if defined(__SSE2__)
+#define GROUP_MASK_SHIFT 0
+
+static group_mask_t
+group_match(const uint8_t *ctrl, uint8_t byte) {
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	__m128i match = _mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte));
+	return ((uint16_t)_mm_movemask_epi8(match));
+}
+
+static group_mask_t
+group_match_free(const uint8_t *ctrl) {
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return ((uint16_t)_mm_movemask_epi8(group));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define GROUP_MASK_SHIFT 2
+
+static group_mask_t
+group_mask(uint8x16_t match) {
+	uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+	return (vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+		UINT64_C(0x8888888888888888));
+}
+
+static group_mask_t
+group_match(const uint8_t *ctrl, uint8_t byte) {
+	return (group_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(byte))));
+}
+
+static group_mask_t
+group_match_free(const uint8_t *ctrl) {
+	int8x16_t group = vreinterpretq_s8_u8(vld1q_u8(ctrl));
+	return (group_mask(vcltq_s8(group, vdupq_n_s8(0))));
+}
+#else
+#define GROUP_MASK_SHIFT 0
+
+static group_mask_t
+group_match(const uint8_t *ctrl, uint8_t byte) {
+	group_mask_t mask = 0;
+
+	for (size_t i = 0; i < GROUP_WIDTH; i++) {
+		mask |= (group_mask_t)(ctrl[i] == byte) << i;
+	}
+	return (mask);
+}
+
+static group_mask_t
+group_match_free(const uint8_t *ctrl) {
+	group_mask_t mask = 0;
+
+	for (size_t i = 0; i < GROUP_WIDTH; i++) {
+		mask |= (group_mask_t)!CTRL_ISFULL(ctrl[i]) << i;
+	}
+	return (mask);
+}
+#endif
+
+static size_t
+group_mask_first(group_mask_t mask) {
+	return (__builtin_ctzll(mask) >> GROUP_MASK_SHIFT);
+}
+
+static size_t
+group_start(const isc_hashmap_t *hashmap, uint32_t hashval) {
+	return (isc_hash_bits32(hashval, hashmap->groupbits));
+}
+
+static size_t
+group_next(const isc_hashmap_t *hashmap, size_t group, size_t step) {
+	/*
+	 * Triangular probing visits every group once when the number of
+	 * groups is a power of two.
+	 */
+	INSIST(step < (HASHSIZE(hashmap->groupbits)));
+	return ((group + step) & (HASHSIZE(hashmap->groupbits) - 1));
+}
+
+static void
+grouped_create_table(isc_hashmap_t *hashmap, uint8_t groupbits) {
+	REQUIRE(groupbits >= GROUP_MIN_BITS && groupbits <= GROUP_MAX_BITS);
+
+	hashmap->groupbits = groupbits;
+	hashmap->capacity = GROUP_WIDTH << groupbits;
+	hashmap->growth_left = GROUP_MAXLOAD(hashmap->capacity);
+	hashmap->ctrl = isc_mem_get(hashmap->mctx, hashmap->capacity);
+	memset(hashmap->ctrl, CTRL_EMPTY, hashmap->capacity);
+	hashmap->slots = isc_mem_cget(hashmap->mctx, hashmap->capacity,
+				      sizeof(hashmap->slots[0]));
+}
+
+static void
+grouped_free_table(isc_hashmap_t *hashmap, uint8_t *ctrl,
+		   hashmap_node_t *slots, size_t capacity) {
+	isc_mem_put(hashmap->mctx, ctrl, capacity);
+	isc_mem_cput(hashmap->mctx, slots, capacity, sizeof(slots[0]));
+}
+
+static hashmap_node_t *
+grouped_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
+	     isc_hashmap_match_fn match, const void *key) {
+	size_t group = group_start(hashmap, hashval);
+
+	for (size_t step = 1;; step++) {
+		const uint8_t *ctrl = &hashmap->ctrl[group * GROUP_WIDTH];
+		group_mask_t bits = group_match(ctrl, CTRL_H2(hashval));
+
+		while (bits != 0) {
+			size_t pos = group * GROUP_WIDTH +
+				     group_mask_first(bits);
+			hashmap_node_t *node = &hashmap->slots[pos];
+
+			if (node->hashval == hashval && match(node->value, key))
+			{
+				return (node);
+			}
+			bits &= bits - 1;
+		}
+
+		if (group_match(ctrl, CTRL_EMPTY) != 0) {
+			return (NULL);
+		}
+
+		group = group_next(hashmap, group, step);
+	}
+}
+
+static void
+grouped_insert(isc_hashmap_t *hashmap, const uint32_t hashval,
+	       const void *key, void *value) {
+	size_t group = group_start(hashmap, hashval);
+	size_t pos;
+
+	for (size_t step = 1;; step++) {
+		group_mask_t bits =
+			group_match_free(&hashmap->ctrl[group * GROUP_WIDTH]);
+
+		if (bits != 0) {
+			pos = group * GROUP_WIDTH + group_mask_first(bits);
+			break;
+		}
+
+		group = group_next(hashmap, group, step);
+	}
+
+	if (hashmap->ctrl[pos] == CTRL_EMPTY) {
+		INSIST(hashmap->growth_left > 0);
+		hashmap->growth_left--;
+	}
+	hashmap->ctrl[pos] = CTRL_H2(hashval);
+	hashmap_node_init(&hashmap->slots[pos], hashval, key, value);
+	hashmap->count++;
+}
+
+static void
+grouped_erase(isc_hashmap_t *hashmap, hashmap_node_t *node) {
+	size_t pos = node - hashmap->slots;
+	const uint8_t *ctrl = &hashmap->ctrl[pos & ~(GROUP_WIDTH - 1)];
+
+	/*
+	 * Probes don't go past a group with an empty slot, so the slot
+	 * can be emptied too; otherwise, it has to be kept as a tombstone
+	 * for the probes that went past it to the next group.
+	 */
+	if (group_match(ctrl, CTRL_EMPTY) != 0) {
+		hashmap->ctrl[pos] = CTRL_EMPTY;
+		hashmap->growth_left++;
+	} else {
+		hashmap->ctrl[pos] = CTRL_DELETED;
+	}
+	*node = (hashmap_node_t){ 0 };
+	hashmap->count--;
+}
+
+/*
+ * Rebuild the table without tombstones, with room for at least as
+ * many nodes again as it holds now.
+ */
+static void
+grouped_rehash(isc_hashmap_t *hashmap) {
+	uint8_t *oldctrl = hashmap->ctrl;
+	hashmap_node_t *oldslots = hashmap->slots;
+	size_t oldcapacity = hashmap->capacity;
+	uint8_t groupbits = GROUP_MIN_BITS;
+
+	INSIST(atomic_load_acquire(&hashmap->iterators) == 0);
+
+	while (groupbits < GROUP_MAX_BITS &&
+	       GROUP_MAXLOAD(GROUP_WIDTH << groupbits) < 2 * hashmap->count + 1)
+	{
+		groupbits++;
+	}
+
+	grouped_create_table(hashmap, groupbits);
+	hashmap->count = 0;
+
+	for (size_t i = 0; i < oldcapacity; i++) {
+		if (CTRL_ISFULL(oldctrl[i])) {
+			grouped_insert(hashmap, oldslots[i].hashval,
+				       oldslots[i].key, oldslots[i].value);
+		}
+	}
+
+	grouped_free_table(hashmap, oldctrl, oldslots, oldcapacity);
+}
+
+static isc_result_t
+grouped_add(isc_hashmap_t *hashmap, const uint32_t hashval,
+	    isc_hashmap_match_fn match, const uint8_t *key, void *value,
+	    void **foundp) {
+	hashmap_node_t *found = NULL;
+
+	INSIST(atomic_load_acquire(&hashmap->iterators) == 0);
+
+	if (match != NULL) {
+		found = grouped_find(hashmap, hashval, match, key);
+	}
+	if (found != NULL) {
+		SET_IF_NOT_NULL(foundp, found->value);
+		return (ISC_R_EXISTS);
+	}
+
+	if (hashmap->growth_left == 0) {
+		grouped_rehash(hashmap);
+	}
+
+	grouped_insert(hashmap, hashval, key, value);
+
+	return (ISC_R_SUCCESS);
+}
+
 void
-isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, isc_hashmap_t **hashmapp) {
+isc_hashmap_create_ex(isc_mem_t *mctx, uint8_t bits, unsigned int options,
+		      isc_hashmap_t **hashmapp) {
 	isc_hashmap_t *hashmap = isc_mem_get(mctx, sizeof(*hashmap));
 
 	REQUIRE(hashmapp != NULL && *hashmapp == NULL);
@@ -216,16 +498,32 @@ isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, isc_hashmap_t **hashmapp) {
 
 	*hashmap = (isc_hashmap_t){
 		.magic = ISC_HASHMAP_MAGIC,
+		.grouped = ((options & ISC_HASHMAP_GROUPED) != 0),
 	};
 	isc_mem_attach(mctx, &hashmap->mctx);
 
-	hashmap_create_table(hashmap, 0, bits);
+	if (hashmap->grouped) {
+		uint8_t groupbits = GROUP_MIN_BITS;
+		while (groupbits < GROUP_MAX_BITS &&
+		       groupbits + GROUP_SHIFT < bits)
+		{
+			groupbits++;
+		}
+		grouped_create_table(hashmap, groupbits);
+	} else {
+		hashmap_create_table(hashmap, 0, bits);
+	}
 
 	hashmap->magic = ISC_HASHMAP_MAGIC;
 
 	*hashmapp = hashmap;
 }
 
+void
+isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, isc_hashmap_t **hashmapp) {
+	isc_hashmap_create_ex(mctx, bits, 0, hashmapp);
+}
+
 void
 isc_hashmap_destroy(isc_hashmap_t **hashmapp) {
 	isc_hashmap_t *hashmap;
@@ -238,6 +536,12 @@ isc_hashmap_destroy(isc_hashmap_t **hashmapp) {
 
 	hashmap->magic = 0;
 
+	if (hashmap->grouped) {
+		grouped_free_table(hashmap, hashmap->ctrl, hashmap->slots,
+				   hashmap->capacity);
+		hashmap->count = 0;
+	}
+
 	for (size_t i = 0; i < HASHMAP_NUM_TABLES; i++) {
 		if (hashmap->tables[i].table != NULL) {
 			hashmap_free_table(hashmap, i, true);
@@ -297,8 +601,14 @@ isc_hashmap_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
 	REQUIRE(valuep == NULL || *valuep == NULL);
 
 	uint8_t idx = hashmap->hindex;
-	hashmap_node_t *node = hashmap_find(hashmap, hashval, match, key,
-					    &(uint32_t){ 0 }, &idx);
+	hashmap_node_t *node = NULL;
+
+	if (hashmap->grouped) {
+		node = grouped_find(hashmap, hashval, match, key);
+	} else {
+		node = hashmap_find(hashmap, hashval, match, key,
+				    &(uint32_t){ 0 }, &idx);
+	}
 	if (node == NULL) {
 		return (ISC_R_NOTFOUND);
 	}
@@ -458,6 +768,15 @@ isc_hashmap_delete(isc_hashmap_t *hashmap, const uint32_t hashval,
 	uint32_t psl = 0;
 	uint8_t idx;
 
+	if (hashmap->grouped) {
+		node = grouped_find(hashmap, hashval, match, key);
+		if (node != NULL) {
+			grouped_erase(hashmap, node);
+			result = ISC_R_SUCCESS;
+		}
+		return (result);
+	}
+
 	if (rehashing_in_progress(hashmap)) {
 		hashmap_rehash_one(hashmap);
 	} else if (under_threshold(hashmap)) {
@@ -570,6 +889,11 @@ isc_hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
 	REQUIRE(ISC_HASHMAP_VALID(hashmap));
 	REQUIRE(key != NULL);
 
+	if (hashmap->grouped) {
+		return (grouped_add(hashmap, hashval, match, key, value,
+				    foundp));
+	}
+
 	if (rehashing_in_progress(hashmap)) {
 		hashmap_rehash_one(hashmap);
 	} else if (over_threshold(hashmap)) {
@@ -632,6 +956,19 @@ static isc_result_t
 isc__hashmap_iter_next(isc_hashmap_iter_t *iter) {
 	isc_hashmap_t *hashmap = iter->hashmap;
 
+	if (hashmap->grouped) {
+		while (iter->i < iter->size &&
+		       !CTRL_ISFULL(hashmap->ctrl[iter->i]))
+		{
+			iter->i++;
+		}
+		if (iter->i < iter->size) {
+			iter->cur = &hashmap->slots[iter->i];
+			return (ISC_R_SUCCESS);
+		}
+		return (ISC_R_NOMORE);
+	}
+
 	while (iter->i < iter->size &&
 	       hashmap->tables[iter->hindex].table[iter->i].key == NULL)
 	{
@@ -660,7 +997,11 @@ isc_hashmap_iter_first(isc_hashmap_iter_t *iter) {
 
 	iter->hindex = iter->hashmap->hindex;
 	iter->i = 0;
-	iter->size = iter->hashmap->tables[iter->hashmap->hindex].size;
+	if (iter->hashmap->grouped) {
+		iter->size = iter->hashmap->capacity;
+	} else {
+		iter->size = iter->hashmap->tables[iter->hashmap->hindex].size;
+	}
 
 	return (isc__hashmap_iter_next(iter));
 }
@@ -680,6 +1021,13 @@ isc_hashmap_iter_delcurrent_next(isc_hashmap_iter_t *iter) {
 	REQUIRE(iter != NULL);
 	REQUIRE(iter->cur != NULL);
 
+	if (iter->hashmap->grouped) {
+		/* Nodes don't move when another one is deleted */
+		grouped_erase(iter->hashmap, iter->cur);
+		iter->i++;
+		return (isc__hashmap_iter_next(iter));
+	}
+
 	hashmap_node_t *node =
 		&iter->hashmap->tables[iter->hindex].table[iter->i];
 
@@ -19,6 +19,11 @@
  *
  *	\li "Algorithms," Second Edition, Sedgewick, Addison-Wesley, 1988,
  *	ISBN 0-201-06673-4, chapter 11.
+ *
+ * With ISC_HEAP_QUATERNARY, every node has four children instead of two,
+ * which halves the depth of the heap, and the array is aligned so that
+ * the children of a node share a cache line; sinking an element down
+ * then touches one cache line per level instead of two.
  */
 
 #include <stdbool.h>
@@ -34,11 +39,13 @@
 /*%
  * Note: to make heap_parent and heap_left easy to compute, the first
  * element of the heap array is not used; i.e. heap subscripts are 1-based,
- * not 0-based.  The parent is index/2, and the left-child is index*2.
- * The right child is index*2+1.
+ * not 0-based.  With two children per node, the parent is index/2, and
+ * the left-child is index*2.  The right child is index*2+1.  With
+ * (1 << shift) children, the children of a node are contiguous and the
+ * first one is always at an index equal to 2 modulo their number.
  */
-#define heap_parent(i) ((i) >> 1)
-#define heap_left(i)   ((i) << 1)
+#define heap_parent(i) (((i) + (1U << heap->shift) - 2) >> heap->shift)
+#define heap_left(i)   ((((i) - 1) << heap->shift) + 2)
 /*@}*/
 
 #define SIZE_INCREMENT 1024
@@ -48,21 +55,33 @@
 
 /*%
  * When the heap is in a consistent state, the following invariant
- * holds true: for every element i > 1, heap_parent(i) has a priority
- * higher than or equal to that of i.
+ * holds true: for every element 1 < i <= heap->ordered, heap_parent(i)
+ * has a priority higher than or equal to that of i.
  */
 #define HEAPCONDITION(i) \
 	((i) == 1 ||     \
 	 !heap->compare(heap->array[(i)], heap->array[heap_parent(i)]))
 
-/*% ISC heap structure. */
+/*%
+ * ISC heap structure.
+ *
+ * The elements 1 to 'ordered' are in heap order; the elements after
+ * them, up to 'last', were added with isc_heap_append() and are put in
+ * order by heapify() when the heap is next used as a priority queue.
+ *
+ * 'array' points into 'base', which has room for 'size' elements and
+ * the padding needed to align the groups of children.
+ */
 struct isc_heap {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	unsigned int size;
 	unsigned int size_increment;
 	unsigned int last;
+	unsigned int ordered;
+	unsigned int shift;
 	void **array;
+	void **base;
 	isc_heapcompare_t compare;
 	isc_heapindex_t index;
 };
@@ -71,7 +90,7 @@ struct isc_heap {
 static void
 heap_check(isc_heap_t *heap) {
 	unsigned int i;
-	for (i = 1; i <= heap->last; i++) {
+	for (i = 1; i <= heap->ordered; i++) {
 		INSIST(HEAPCONDITION(i));
 	}
 }
@@ -82,6 +101,13 @@ heap_check(isc_heap_t *heap) {
 void
 isc_heap_create(isc_mem_t *mctx, isc_heapcompare_t compare, isc_heapindex_t idx,
 		unsigned int size_increment, isc_heap_t **heapp) {
+	isc_heap_create_ex(mctx, compare, idx, size_increment, 0, heapp);
+}
+
+void
+isc_heap_create_ex(isc_mem_t *mctx, isc_heapcompare_t compare,
+		   isc_heapindex_t idx, unsigned int size_increment,
+		   unsigned int options, isc_heap_t **heapp) {
 	isc_heap_t *heap;
 
 	REQUIRE(heapp != NULL && *heapp == NULL);
@@ -98,13 +124,21 @@ isc_heap_create(isc_mem_t *mctx, isc_heapcompare_t compare, isc_heapindex_t idx,
 		heap->size_increment = size_increment;
 	}
 	heap->last = 0;
+	heap->ordered = 0;
+	heap->shift = ((options & ISC_HEAP_QUATERNARY) != 0) ? 2 : 1;
 	heap->array = NULL;
+	heap->base = NULL;
 	heap->compare = compare;
 	heap->index = idx;
 
 	*heapp = heap;
 }
 
+static unsigned int
+padding(isc_heap_t *heap) {
+	return (1U << heap->shift);
+}
+
 void
 isc_heap_destroy(isc_heap_t **heapp) {
 	isc_heap_t *heap;
@@ -114,9 +148,9 @@ isc_heap_destroy(isc_heap_t **heapp) {
 	*heapp = NULL;
 	REQUIRE(VALID_HEAP(heap));
 
-	if (heap->array != NULL) {
-		isc_mem_cput(heap->mctx, heap->array, heap->size,
-			     sizeof(void *));
+	if (heap->base != NULL) {
+		isc_mem_cput(heap->mctx, heap->base,
+			     heap->size + padding(heap), sizeof(void *));
 	}
 	heap->magic = 0;
 	isc_mem_putanddetach(&heap->mctx, heap, sizeof(*heap));
@@ -124,17 +158,37 @@ isc_heap_destroy(isc_heap_t **heapp) {
 
 static void
 resize(isc_heap_t *heap) {
-	unsigned int new_size, new_bytes, old_bytes;
+	unsigned int new_size, new_slots;
+	size_t align = padding(heap) * sizeof(void *);
+	void **new_base = NULL, **new_array = NULL;
 
 	REQUIRE(VALID_HEAP(heap));
 
 	new_size = ISC_CHECKED_ADD(heap->size, heap->size_increment);
-	new_bytes = ISC_CHECKED_MUL(new_size, sizeof(void *));
-	old_bytes = ISC_CHECKED_MUL(heap->size, sizeof(void *));
+	new_slots = ISC_CHECKED_ADD(new_size, padding(heap));
+
+	/*
+	 * Align the first child of the root, and thus every group of
+	 * children, on a multiple of the size of the group.
+	 */
+	new_base = isc_mem_cget(heap->mctx, new_slots, sizeof(void *));
+	new_array = new_base;
+	while (((uintptr_t)&new_array[2] & (align - 1)) != 0 &&
+	       new_array < new_base + padding(heap) - 1)
+	{
+		new_array++;
+	}
+
+	if (heap->base != NULL) {
+		memmove(&new_array[1], &heap->array[1],
+			heap->last * sizeof(void *));
+		isc_mem_cput(heap->mctx, heap->base,
+			     heap->size + padding(heap), sizeof(void *));
+	}
 
 	heap->size = new_size;
-	heap->array = isc_mem_creget(heap->mctx, heap->array, old_bytes,
-				     new_bytes, sizeof(char));
+	heap->base = new_base;
+	heap->array = new_array;
 }
 
 static void
@@ -158,18 +212,18 @@ float_up(isc_heap_t *heap, unsigned int i, void *elt) {
 	heap_check(heap);
 }
 
-static void
-sink_down(isc_heap_t *heap, unsigned int i, void *elt) {
-	unsigned int j, size, half_size;
-	size = heap->last;
-	half_size = size / 2;
-	while (i <= half_size) {
-		/* Find the smallest of the (at most) two children. */
+static unsigned int
+sink(isc_heap_t *heap, unsigned int i, void *elt) {
+	unsigned int j, last, size = heap->ordered;
+
+	while (i <= heap_parent(size)) {
+		/* Find the smallest of the (at most 1 << shift) children. */
 		j = heap_left(i);
-		if (j < size &&
-		    heap->compare(heap->array[j + 1], heap->array[j]))
-		{
-			j++;
+		last = ISC_MIN(j + padding(heap) - 1, size);
+		for (unsigned int k = j + 1; k <= last; k++) {
+			if (heap->compare(heap->array[k], heap->array[j])) {
+				j = k;
+			}
 		}
 		if (heap->compare(elt, heap->array[j])) {
 			break;
@@ -185,25 +239,79 @@ sink_down(isc_heap_t *heap, unsigned int i, void *elt) {
 		(heap->index)(heap->array[i], i);
 	}
 
+	return (i);
+}
+
+static void
+sink_down(isc_heap_t *heap, unsigned int i, void *elt) {
+	i = sink(heap, i, elt);
+
 	INSIST(HEAPCONDITION(i));
 	heap_check(heap);
 }
 
+/*
+ * Put the appended elements in heap order: one by one if there are
+ * few of them, or by rebuilding the whole heap bottom-up, in linear
+ * time, if they are at least as many as the ordered ones.
+ */
 void
-isc_heap_insert(isc_heap_t *heap, void *elt) {
-	unsigned int new_last;
-
+isc_heap_heapify(isc_heap_t *heap) {
 	REQUIRE(VALID_HEAP(heap));
 
+	if (heap->ordered == heap->last) {
+		return;
+	}
+
+	if (heap->last - heap->ordered < heap->ordered) {
+		while (heap->ordered < heap->last) {
+			heap->ordered++;
+			float_up(heap, heap->ordered,
+				 heap->array[heap->ordered]);
+		}
+		return;
+	}
+
+	heap->ordered = heap->last;
+	for (unsigned int i = heap_parent(heap->last); i >= 1; i--) {
+		(void)sink(heap, i, heap->array[i]);
+	}
 	heap_check(heap);
+}
+
+static void
+append(isc_heap_t *heap, void *elt) {
+	unsigned int new_last;
+
 	new_last = heap->last + 1;
 	RUNTIME_CHECK(new_last > 0); /* overflow check */
 	if (new_last >= heap->size) {
 		resize(heap);
 	}
 	heap->last = new_last;
+	heap->array[new_last] = elt;
+	if (heap->index != NULL) {
+		(heap->index)(elt, new_last);
+	}
+}
 
-	float_up(heap, new_last, elt);
+void
+isc_heap_insert(isc_heap_t *heap, void *elt) {
+	REQUIRE(VALID_HEAP(heap));
+
+	isc_heap_heapify(heap);
+	heap_check(heap);
+
+	append(heap, elt);
+	heap->ordered = heap->last;
+	float_up(heap, heap->last, elt);
+}
+
+void
+isc_heap_append(isc_heap_t *heap, void *elt) {
+	REQUIRE(VALID_HEAP(heap));
+
+	append(heap, elt);
 }
 
 void
@@ -218,15 +326,37 @@ isc_heap_delete(isc_heap_t *heap, unsigned int idx) {
 	if (heap->index != NULL) {
 		(heap->index)(heap->array[idx], 0);
 	}
-	if (idx == heap->last) {
+
+	if (idx > heap->ordered) {
+		/* The appended elements are in no particular order */
+		heap->array[idx] = heap->array[heap->last];
+		if (heap->index != NULL && idx != heap->last) {
+			(heap->index)(heap->array[idx], idx);
+		}
 		heap->array[heap->last] = NULL;
 		heap->last--;
+		return;
+	}
+
+	/*
+	 * Take the last ordered element out to fill the hole, and the
+	 * last appended element, if any, to fill its place.
+	 */
+	elt = heap->array[heap->ordered];
+	if (heap->last > heap->ordered) {
+		heap->array[heap->ordered] = heap->array[heap->last];
+		if (heap->index != NULL) {
+			(heap->index)(heap->array[heap->ordered],
+				      heap->ordered);
+		}
+	}
+	heap->array[heap->last] = NULL;
+	heap->last--;
+	heap->ordered--;
+
+	if (idx == heap->ordered + 1) {
 		heap_check(heap);
 	} else {
-		elt = heap->array[heap->last];
-		heap->array[heap->last] = NULL;
-		heap->last--;
-
 		less = heap->compare(elt, heap->array[idx]);
 		heap->array[idx] = elt;
 		if (less) {
@@ -242,7 +372,9 @@ isc_heap_increased(isc_heap_t *heap, unsigned int idx) {
 	REQUIRE(VALID_HEAP(heap));
 	REQUIRE(idx >= 1 && idx <= heap->last);
 
-	float_up(heap, idx, heap->array[idx]);
+	if (idx <= heap->ordered) {
+		float_up(heap, idx, heap->array[idx]);
+	}
 }
 
 void
@@ -250,13 +382,16 @@ isc_heap_decreased(isc_heap_t *heap, unsigned int idx) {
 	REQUIRE(VALID_HEAP(heap));
 	REQUIRE(idx >= 1 && idx <= heap->last);
 
-	sink_down(heap, idx, heap->array[idx]);
+	if (idx <= heap->ordered) {
+		sink_down(heap, idx, heap->array[idx]);
+	}
 }
 
 void *
 isc_heap_element(isc_heap_t *heap, unsigned int idx) {
 	REQUIRE(VALID_HEAP(heap));
 	REQUIRE(idx >= 1);
+	REQUIRE(heap->ordered == heap->last);
 
 	heap_check(heap);
 	if (idx <= heap->last) {
@@ -24,6 +24,8 @@
 #include <isc/util.h>
 
 typedef struct isc_ht_node isc_ht_node_t;
+typedef struct isc_ht_slot isc_ht_slot_t;
+typedef struct ht_arena	   ht_arena_t;
 
 #define ISC_HT_MAGIC	 ISC_MAGIC('H', 'T', 'a', 'b')
 #define ISC_HT_VALID(ht) ISC_MAGIC_VALID(ht, ISC_HT_MAGIC)
@@ -40,6 +42,21 @@ typedef struct isc_ht_node isc_ht_node_t;
 
 #define HASHSIZE(bits) (UINT64_C(1) << (bits))
 
+/*
+ * ISC_HT_FLAT tables keep their entries in an array of slots probed
+ * linearly, filled to at most 3/4 including the deleted slots.  Keys of
+ * up to HT_INLINE_KEYSIZE bytes are stored in the slot itself, and the
+ * longer ones in an arena of HT_ARENA_SIZE chunks that is only
+ * reclaimed when the table is rebuilt.
+ */
+#define HT_INLINE_KEYSIZE 16
+#define HT_ARENA_SIZE	  (64 * 1024)
+
+#define HT_SLOT_EMPTY	0
+#define HT_SLOT_DELETED UINT32_MAX
+
+#define HT_FLAT_FULL(ht, used) ((used) > (ht)->size[0] / 4 * 3)
+
 struct isc_ht_node {
 	void *value;
 	isc_ht_node_t *next;
@@ -48,6 +65,23 @@ struct isc_ht_node {
 	unsigned char key[];
 };
 
+struct isc_ht_slot {
+	void *value;
+	uint32_t hashval;
+	uint32_t keysize; /* or HT_SLOT_EMPTY or HT_SLOT_DELETED */
+	union {
+		unsigned char *ptr;
+		unsigned char buf[HT_INLINE_KEYSIZE];
+	} key;
+};
+
+struct ht_arena {
+	ht_arena_t *next;
+	size_t size;
+	size_t used;
+	unsigned char data[];
+};
+
 struct isc_ht {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -58,6 +92,12 @@ struct isc_ht {
 	isc_ht_node_t **table[2];
 	uint8_t hindex;
 	uint32_t hiter; /* rehashing iterator */
+
+	/* ISC_HT_FLAT: the table size is in size[0] and hashbits[0] */
+	bool flat;
+	size_t deleted;
+	isc_ht_slot_t *slots;
+	ht_arena_t *arena;
 };
 
 struct isc_ht_iter {
@@ -65,6 +105,7 @@ struct isc_ht_iter {
 	size_t i;
 	uint8_t hindex;
 	isc_ht_node_t *cur;
+	isc_ht_slot_t *slot;
 };
 
 static isc_ht_node_t *
@@ -234,11 +275,209 @@ hashtable_free(isc_ht_t *ht, const uint8_t idx) {
 	ht->table[idx] = NULL;
 }
 
+static unsigned char *
+flat_key(isc_ht_slot_t *slot) {
+	return (slot->keysize <= HT_INLINE_KEYSIZE ? slot->key.buf
+						   : slot->key.ptr);
+}
+
+static bool
+flat_slot_match(isc_ht_slot_t *slot, const uint32_t hashval,
+		const uint8_t *key, uint32_t keysize, bool case_sensitive) {
+	return (slot->hashval == hashval && slot->keysize == keysize &&
+		(case_sensitive
+			 ? (memcmp(flat_key(slot), key, keysize) == 0)
+			 : (isc_ascii_lowerequal(flat_key(slot), key,
+						 keysize))));
+}
+
+static unsigned char *
+flat_arena_get(isc_ht_t *ht, size_t size) {
+	ht_arena_t *arena = ht->arena;
+
+	if (arena == NULL || arena->size - arena->used < size) {
+		size_t asize = ISC_MAX(size, HT_ARENA_SIZE);
+
+		arena = isc_mem_get(ht->mctx,
+				    STRUCT_FLEX_SIZE(arena, data, asize));
+		*arena = (ht_arena_t){
+			.next = ht->arena,
+			.size = asize,
+		};
+		ht->arena = arena;
+	}
+
+	arena->used += size;
+	return (&arena->data[arena->used - size]);
+}
+
+static void
+flat_arena_free(isc_ht_t *ht, ht_arena_t *arena) {
+	while (arena != NULL) {
+		ht_arena_t *next = arena->next;
+		isc_mem_put(ht->mctx, arena,
+			    STRUCT_FLEX_SIZE(arena, data, arena->size));
+		arena = next;
+	}
+}
+
+static void
+flat_table_new(isc_ht_t *ht, const uint8_t bits) {
+	REQUIRE(bits >= HT_MIN_BITS);
+	REQUIRE(bits <= HT_MAX_BITS);
+
+	ht->hashbits[0] = bits;
+	ht->size[0] = HASHSIZE(bits);
+	ht->slots = isc_mem_cget(ht->mctx, ht->size[0], sizeof(ht->slots[0]));
+	ht->deleted = 0;
+}
+
+static isc_ht_slot_t *
+flat_find(const isc_ht_t *ht, const unsigned char *key,
+	  const uint32_t keysize, const uint32_t hashval) {
+	size_t mask = ht->size[0] - 1;
+
+	for (size_t i = hash_32(hashval, ht->hashbits[0]);; i = (i + 1) & mask)
+	{
+		isc_ht_slot_t *slot = &ht->slots[i];
+
+		if (slot->keysize == HT_SLOT_EMPTY) {
+			return (NULL);
+		}
+		if (flat_slot_match(slot, hashval, key, keysize,
+				    ht->case_sensitive))
+		{
+			return (slot);
+		}
+	}
+}
+
+static void
+flat_insert(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
+	    const uint32_t hashval, void *value) {
+	size_t mask = ht->size[0] - 1;
+	size_t i = hash_32(hashval, ht->hashbits[0]);
+	isc_ht_slot_t *slot = NULL;
+
+	while (ht->slots[i].keysize != HT_SLOT_EMPTY &&
+	       ht->slots[i].keysize != HT_SLOT_DELETED)
+	{
+		i = (i + 1) & mask;
+	}
+
+	slot = &ht->slots[i];
+	if (slot->keysize == HT_SLOT_DELETED) {
+		ht->deleted--;
+	}
+
+	*slot = (isc_ht_slot_t){
+		.value = value,
+		.hashval = hashval,
+		.keysize = keysize,
+	};
+	if (keysize > HT_INLINE_KEYSIZE) {
+		slot->key.ptr = flat_arena_get(ht, keysize);
+	}
+	memmove(flat_key(slot), key, keysize);
+
+	ht->count++;
+}
+
+static void
+flat_erase(isc_ht_t *ht, isc_ht_slot_t *slot) {
+	size_t next = (slot - ht->slots + 1) & (ht->size[0] - 1);
+
+	/*
+	 * No probe goes past an empty slot, so the slot can be emptied
+	 * if the next one is; otherwise, it must be kept as a tombstone.
+	 */
+	if (ht->slots[next].keysize == HT_SLOT_EMPTY) {
+		*slot = (isc_ht_slot_t){ .keysize = HT_SLOT_EMPTY };
+	} else {
+		*slot = (isc_ht_slot_t){ .keysize = HT_SLOT_DELETED };
+		ht->deleted++;
+	}
+	ht->count--;
+}
+
+/*
+ * Rebuild the table for 'newcount' entries at most half full, without
+ * the tombstones and with the long keys copied to a new arena.
+ */
+static void
+flat_rehash(isc_ht_t *ht, size_t newcount) {
+	isc_ht_slot_t *oldslots = ht->slots;
+	size_t oldsize = ht->size[0];
+	ht_arena_t *oldarena = ht->arena;
+	uint8_t bits = HT_MIN_BITS;
+
+	while (bits < HT_MAX_BITS && HASHSIZE(bits) / 2 < newcount) {
+		bits++;
+	}
+
+	flat_table_new(ht, bits);
+	ht->arena = NULL;
+	ht->count = 0;
+
+	for (size_t i = 0; i < oldsize; i++) {
+		isc_ht_slot_t *slot = &oldslots[i];
+
+		if (slot->keysize != HT_SLOT_EMPTY &&
+		    slot->keysize != HT_SLOT_DELETED)
+		{
+			flat_insert(ht, flat_key(slot), slot->keysize,
+				    slot->hashval, slot->value);
+		}
+	}
+
+	isc_mem_cput(ht->mctx, oldslots, oldsize, sizeof(oldslots[0]));
+	flat_arena_free(ht, oldarena);
+}
+
+static isc_result_t
+flat_add(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
+	 void *value) {
+	uint32_t hashval = isc_hash32(key, keysize, ht->case_sensitive);
+
+	if (flat_find(ht, key, keysize, hashval) != NULL) {
+		return (ISC_R_EXISTS);
+	}
+
+	if (HT_FLAT_FULL(ht, ht->count + ht->deleted + 1)) {
+		flat_rehash(ht, ht->count + 1);
+	}
+
+	flat_insert(ht, key, keysize, hashval, value);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+flat_iter_next(isc_ht_iter_t *it) {
+	isc_ht_t *ht = it->ht;
+
+	while (it->i < ht->size[0] &&
+	       (ht->slots[it->i].keysize == HT_SLOT_EMPTY ||
+		ht->slots[it->i].keysize == HT_SLOT_DELETED))
+	{
+		it->i++;
+	}
+
+	if (it->i < ht->size[0]) {
+		it->slot = &ht->slots[it->i];
+		return (ISC_R_SUCCESS);
+	}
+
+	it->slot = NULL;
+	return (ISC_R_NOMORE);
+}
+
 void
 isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits,
 	    unsigned int options) {
 	isc_ht_t *ht = NULL;
 	bool case_sensitive = ((options & ISC_HT_CASE_INSENSITIVE) == 0);
+	bool flat = ((options & ISC_HT_FLAT) != 0);
 
 	REQUIRE(htp != NULL && *htp == NULL);
 	REQUIRE(mctx != NULL);
@@ -247,17 +486,46 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits,
 	ht = isc_mem_get(mctx, sizeof(*ht));
 	*ht = (isc_ht_t){
 		.case_sensitive = case_sensitive,
+		.flat = flat,
 	};
 
 	isc_mem_attach(mctx, &ht->mctx);
 
-	hashtable_new(ht, 0, bits);
+	if (flat) {
+		flat_table_new(ht, bits);
+	} else {
+		hashtable_new(ht, 0, bits);
+	}
 
 	ht->magic = ISC_HT_MAGIC;
 
 	*htp = ht;
 }
 
+void
+isc_ht_init_sized(isc_ht_t **htp, isc_mem_t *mctx, size_t count,
+		  unsigned int options) {
+	uint8_t bits = HT_MIN_BITS;
+
+	/*
+	 * Leave room for 'count' entries before the first rehash: the
+	 * chained table grows when it holds HT_OVERCOMMIT entries per
+	 * bucket, but its buckets are best kept short, and the flat
+	 * table grows when it is 3/4 full.
+	 */
+	if ((options & ISC_HT_FLAT) != 0) {
+		while (bits < HT_MAX_BITS && HASHSIZE(bits) / 4 * 3 <= count) {
+			bits++;
+		}
+	} else {
+		while (bits < HT_MAX_BITS && HASHSIZE(bits) <= count) {
+			bits++;
+		}
+	}
+
+	isc_ht_init(htp, mctx, bits, options);
+}
+
 void
 isc_ht_destroy(isc_ht_t **htp) {
 	isc_ht_t *ht;
@@ -269,6 +537,13 @@ isc_ht_destroy(isc_ht_t **htp) {
 	*htp = NULL;
 	ht->magic = 0;
 
+	if (ht->flat) {
+		isc_mem_cput(ht->mctx, ht->slots, ht->size[0],
+			     sizeof(ht->slots[0]));
+		flat_arena_free(ht, ht->arena);
+		ht->count = 0;
+	}
+
 	for (size_t i = 0; i <= 1; i++) {
 		if (ht->table[i] != NULL) {
 			hashtable_free(ht, i);
@@ -308,7 +583,11 @@ isc_ht_add(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize,
 	uint32_t hashval;
 
 	REQUIRE(ISC_HT_VALID(ht));
-	REQUIRE(key != NULL && keysize > 0);
+	REQUIRE(key != NULL && keysize > 0 && keysize != HT_SLOT_DELETED);
+
+	if (ht->flat) {
+		return (flat_add(ht, key, keysize, value));
+	}
 
 	if (rehashing_in_progress(ht)) {
 		/* Rehash in progress */
@@ -370,6 +649,15 @@ isc_ht_find(const isc_ht_t *ht, const unsigned char *key,
 
 	hashval = isc_hash32(key, keysize, ht->case_sensitive);
 
+	if (ht->flat) {
+		isc_ht_slot_t *slot = flat_find(ht, key, keysize, hashval);
+		if (slot == NULL) {
+			return (ISC_R_NOTFOUND);
+		}
+		SET_IF_NOT_NULL(valuep, slot->value);
+		return (ISC_R_SUCCESS);
+	}
+
 	node = isc__ht_find(ht, key, keysize, hashval, ht->hindex);
 	if (node == NULL) {
 		return (ISC_R_NOTFOUND);
@@ -418,6 +706,18 @@ isc_ht_delete(isc_ht_t *ht, const unsigned char *key, const uint32_t keysize) {
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
+	if (ht->flat) {
+		isc_ht_slot_t *slot = NULL;
+
+		hashval = isc_hash32(key, keysize, ht->case_sensitive);
+		slot = flat_find(ht, key, keysize, hashval);
+		if (slot == NULL) {
+			return (ISC_R_NOTFOUND);
+		}
+		flat_erase(ht, slot);
+		return (ISC_R_SUCCESS);
+	}
+
 	if (rehashing_in_progress(ht)) {
 		/* Rehash in progress */
 		hashtable_rehash_one(ht);
@@ -479,6 +779,10 @@ isc_ht_iter_first(isc_ht_iter_t *it) {
 	it->hindex = ht->hindex;
 	it->i = 0;
 
+	if (ht->flat) {
+		return (flat_iter_next(it));
+	}
+
 	return (isc__ht_iter_next(it));
 }
 
@@ -510,6 +814,13 @@ isc__ht_iter_next(isc_ht_iter_t *it) {
 isc_result_t
 isc_ht_iter_next(isc_ht_iter_t *it) {
 	REQUIRE(it != NULL);
+
+	if (it->ht->flat) {
+		REQUIRE(it->slot != NULL);
+		it->i++;
+		return (flat_iter_next(it));
+	}
+
 	REQUIRE(it->cur != NULL);
 
 	it->cur = it->cur->next;
@@ -532,9 +843,19 @@ isc_ht_iter_delcurrent_next(isc_ht_iter_t *it) {
 	isc_result_t dresult;
 
 	REQUIRE(it != NULL);
-	REQUIRE(it->cur != NULL);
 
 	ht = it->ht;
+
+	if (ht->flat) {
+		REQUIRE(it->slot != NULL);
+		/* Slots don't move when another one is deleted */
+		flat_erase(ht, it->slot);
+		it->i++;
+		return (flat_iter_next(it));
+	}
+
+	REQUIRE(it->cur != NULL);
+
 	dnode = it->cur;
 	dindex = it->hindex;
 
@@ -550,9 +871,16 @@ isc_ht_iter_delcurrent_next(isc_ht_iter_t *it) {
 void
 isc_ht_iter_current(isc_ht_iter_t *it, void **valuep) {
 	REQUIRE(it != NULL);
-	REQUIRE(it->cur != NULL);
 	REQUIRE(valuep != NULL && *valuep == NULL);
 
+	if (it->ht->flat) {
+		REQUIRE(it->slot != NULL);
+		*valuep = it->slot->value;
+		return;
+	}
+
+	REQUIRE(it->cur != NULL);
+
 	*valuep = it->cur->value;
 }
 
@@ -560,9 +888,17 @@ void
 isc_ht_iter_currentkey(isc_ht_iter_t *it, unsigned char **key,
 		       size_t *keysize) {
 	REQUIRE(it != NULL);
-	REQUIRE(it->cur != NULL);
 	REQUIRE(key != NULL && *key == NULL);
 
+	if (it->ht->flat) {
+		REQUIRE(it->slot != NULL);
+		*key = flat_key(it->slot);
+		*keysize = it->slot->keysize;
+		return;
+	}
+
+	REQUIRE(it->cur != NULL);
+
 	*key = it->cur->key;
 	*keysize = it->cur->keysize;
 }
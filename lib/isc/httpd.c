@@ -19,6 +19,8 @@
 #include <string.h>
 
 #include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hex.h>
 #include <isc/httpd.h>
 #include <isc/list.h>
 #include <isc/mem.h>
@@ -58,8 +60,14 @@ typedef enum httpd_flags {
 	CONNECTION_CLOSE = 1 << 0,	/* connection must close */
 	CONNECTION_KEEP_ALIVE = 1 << 1, /* response needs a keep-alive header */
 	ACCEPT_DEFLATE = 1 << 2,	/* response can be compressed */
+	ACCEPT_GZIP = 1 << 3,		/* response can be gzip compressed */
 } httpd_flags_t;
 
+/*
+ * Size of a weak entity tag: W/"<16 hex digits>".
+ */
+#define HTTP_ETAG_SIZE (sizeof("W/\"\"") + 16)
+
 #define HTTPD_MAGIC    ISC_MAGIC('H', 't', 'p', 'd')
 #define VALID_HTTPD(m) ISC_MAGIC_VALID(m, HTTPD_MAGIC)
 
@@ -110,6 +118,7 @@ struct isc_httpd {
 	const char *path;
 	isc_url_parser_t up;
 	isc_time_t if_modified_since;
+	struct phr_header if_none_match; /* points into recvbuf */
 };
 
 #if ISC_HTTPD_TRACE
@@ -173,7 +182,9 @@ typedef struct isc_httpd_sendreq {
 	 *
 	 * We currently use three buffers total:
 	 *
-	 * sendbuffer - gets filled as we gather the data
+	 * sendbuffer - gets filled with the response headers; the body is
+	 * sent after them straight from one of the buffers below, not
+	 * copied, as the statistics can run to many megabytes
 	 *
 	 * bodybuffer - for the client to fill in (which it manages, it provides
 	 * the space for it, etc) -- we will pass that buffer structure back to
@@ -189,6 +200,8 @@ typedef struct isc_httpd_sendreq {
 
 	isc_buffer_t bodybuffer;
 
+	isc_region_t body; /* in bodybuffer or compbuffer */
+
 	const char *mimetype;
 	unsigned int retcode;
 	const char *retmsg;
@@ -427,6 +440,7 @@ process_request(isc_httpd_t *httpd, size_t last_len) {
 	bool host_header = false;
 
 	isc_time_set(&httpd->if_modified_since, 0, 0);
+	httpd->if_none_match = (struct phr_header){ 0 };
 
 	for (size_t i = 0; i < num_headers; i++) {
 		struct phr_header *header = &headers[i];
@@ -464,6 +478,11 @@ process_request(isc_httpd_t *httpd, size_t last_len) {
 			if (value_match(header, "deflate")) {
 				httpd->flags |= ACCEPT_DEFLATE;
 			}
+			if (value_match(header, "gzip")) {
+				httpd->flags |= ACCEPT_GZIP;
+			}
+		} else if (name_match(header, "If-None-Match")) {
+			httpd->if_none_match = *header;
 		} else if (name_match(header, "If-Modified-Since") &&
 			   header->value_len < ISC_FORMATHTTPTIMESTAMP_SIZE)
 		{
@@ -554,6 +573,7 @@ httpd_free(isc_httpd_t *httpd) {
 	httpd->path = NULL;
 	httpd->up = (isc_url_parser_t){ 0 };
 	isc_time_set(&httpd->if_modified_since, 0, 0);
+	httpd->if_none_match = (struct phr_header){ 0 };
 
 	httpd->magic = 0;
 	httpd->mgr = NULL;
@@ -580,6 +600,12 @@ isc__httpd_sendreq_free(isc_httpd_sendreq_t *req) {
 	/* Clean up buffers */
 
 	isc_buffer_free(&req->sendbuffer);
+	if (req->compbuffer != NULL) {
+		isc_buffer_free(&req->compbuffer);
+	}
+	if (req->freecb != NULL && isc_buffer_length(&req->bodybuffer) > 0) {
+		req->freecb(&req->bodybuffer, req->freecb_arg);
+	}
 
 	isc_mem_putanddetach(&req->mctx, req, sizeof(*req));
 }
@@ -705,8 +731,8 @@ render_500(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo, void *arg,
 
 #ifdef HAVE_ZLIB
 /*%<
- * Tries to compress httpd->bodybuffer to httpd->compbuffer, extending it
- * if necessary.
+ * Tries to compress httpd->bodybuffer to httpd->compbuffer, in the gzip
+ * format if 'gzip' is true and in the zlib ("deflate") format otherwise.
  *
  * Requires:
  *\li	httpd a valid isc_httpd_t object
@@ -718,7 +744,7 @@ render_500(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo, void *arg,
  *			     data would be larger than input data
  */
 static isc_result_t
-httpd_compress(isc_httpd_sendreq_t *req) {
+httpd_compress(isc_httpd_sendreq_t *req, bool gzip) {
 	z_stream zstr;
 	int ret, inputlen;
 
@@ -742,7 +768,13 @@ httpd_compress(isc_httpd_sendreq_t *req) {
 		.next_out = isc_buffer_base(req->compbuffer),
 	};
 
-	ret = deflateInit(&zstr, Z_DEFAULT_COMPRESSION);
+	/*
+	 * Adding 16 to the window bits makes zlib write a gzip header
+	 * and trailer instead of the zlib ones.
+	 */
+	ret = deflateInit2(&zstr, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			   gzip ? MAX_WBITS + 16 : MAX_WBITS, 8,
+			   Z_DEFAULT_STRATEGY);
 	if (ret == Z_OK) {
 		ret = deflate(&zstr, Z_FINISH);
 	}
@@ -757,6 +789,30 @@ httpd_compress(isc_httpd_sendreq_t *req) {
 }
 #endif /* ifdef HAVE_ZLIB */
 
+/*
+ * Make a weak entity tag for the response body.  It is weak because
+ * the same tag is used whatever the content coding, and it lets a
+ * client that polls a resource which hasn't changed get a 304 reply
+ * instead of the whole body again.
+ */
+static void
+httpd_etag(isc_httpd_sendreq_t *req, char *etag, size_t size) {
+	uint64_t hash = isc_hash64(isc_buffer_base(&req->bodybuffer),
+				   isc_buffer_usedlength(&req->bodybuffer),
+				   true);
+
+	snprintf(etag, size, "W/\"%016" PRIx64 "\"", hash);
+}
+
+static bool
+httpd_etag_match(const isc_httpd_t *httpd, const char *etag) {
+	if (httpd->if_none_match.value == NULL) {
+		return (false);
+	}
+	return (value_match(&httpd->if_none_match, etag) ||
+		value_match(&httpd->if_none_match, "*"));
+}
+
 static void
 prepare_response(void *arg) {
 	isc_httpd_sendreq_t *req = arg;
@@ -764,7 +820,9 @@ prepare_response(void *arg) {
 	isc_httpdmgr_t *mgr = httpd->mgr;
 	isc_time_t now = isc_time_now();
 	char datebuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
+	char etag[HTTP_ETAG_SIZE] = { 0 };
 	const char *path = "/";
+	const char *encoding = NULL;
 	size_t path_len = 1;
 	bool is_compressed = false;
 	isc_httpdurl_t *url = NULL;
@@ -807,11 +865,42 @@ prepare_response(void *arg) {
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 
+	if (req->retcode == 200) {
+		httpd_etag(req, etag, sizeof(etag));
+		if (httpd_etag_match(httpd, etag)) {
+			/*
+			 * The client has this version already; drop the
+			 * body.
+			 */
+			req->retcode = 304;
+			req->retmsg = "Not modified";
+			if (req->freecb != NULL &&
+			    isc_buffer_length(&req->bodybuffer) > 0)
+			{
+				req->freecb(&req->bodybuffer, req->freecb_arg);
+			}
+			req->freecb = NULL;
+			isc_buffer_initnull(&req->bodybuffer);
+		}
+	}
+
 #ifdef HAVE_ZLIB
-	if ((httpd->flags & ACCEPT_DEFLATE) != 0) {
-		result = httpd_compress(req);
+	if ((httpd->flags & ACCEPT_GZIP) != 0) {
+		encoding = "gzip";
+	} else if ((httpd->flags & ACCEPT_DEFLATE) != 0) {
+		encoding = "deflate";
+	}
+	if (encoding != NULL && req->retcode != 304) {
+		result = httpd_compress(req, (httpd->flags & ACCEPT_GZIP) != 0);
 		if (result == ISC_R_SUCCESS) {
 			is_compressed = true;
+			/* The uncompressed body is no longer needed */
+			if (req->freecb != NULL &&
+			    isc_buffer_length(&req->bodybuffer) > 0)
+			{
+				req->freecb(&req->bodybuffer, req->freecb_arg);
+			}
+			req->freecb = NULL;
 		}
 	}
 #endif /* ifdef HAVE_ZLIB */
@@ -841,8 +930,15 @@ prepare_response(void *arg) {
 
 	httpd_addheader(req, "Server: libisc", NULL);
 
+	if (etag[0] != '\0') {
+		httpd_addheader(req, "ETag", etag);
+	}
+	if (encoding != NULL) {
+		httpd_addheader(req, "Vary: Accept-Encoding", NULL);
+	}
+
 	if (is_compressed) {
-		httpd_addheader(req, "Content-Encoding", "deflate");
+		httpd_addheader(req, "Content-Encoding", encoding);
 		httpd_addheaderuint(req, "Content-Length",
 				    isc_buffer_usedlength(req->compbuffer));
 	} else {
@@ -853,23 +949,14 @@ prepare_response(void *arg) {
 	httpd_endheaders(req); /* done */
 
 	/*
-	 * Append either the compressed or the non-compressed response body to
-	 * the response headers and store the result in httpd->sendbuffer.
+	 * Either the compressed or the non-compressed response body is sent
+	 * after the headers by prepare_response_done(), and freed with the
+	 * request.
 	 */
 	if (is_compressed) {
-		isc_buffer_putmem(req->sendbuffer,
-				  isc_buffer_base(req->compbuffer),
-				  isc_buffer_usedlength(req->compbuffer));
-		isc_buffer_free(&req->compbuffer);
+		isc_buffer_usedregion(req->compbuffer, &req->body);
 	} else {
-		isc_buffer_putmem(req->sendbuffer,
-				  isc_buffer_base(&req->bodybuffer),
-				  isc_buffer_usedlength(&req->bodybuffer));
-	}
-
-	/* Free the bodybuffer */
-	if (req->freecb != NULL && isc_buffer_length(&req->bodybuffer) > 0) {
-		req->freecb(&req->bodybuffer, req->freecb_arg);
+		isc_buffer_usedregion(&req->bodybuffer, &req->body);
 	}
 
 	/* Consume the request from the recv buffer. */
@@ -883,6 +970,18 @@ prepare_response(void *arg) {
 	httpd->consume = 0;
 }
 
+static void
+httpd_sendbody(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	isc_httpd_sendreq_t *req = arg;
+
+	if (eresult != ISC_R_SUCCESS) {
+		httpd_senddone(handle, eresult, arg);
+		return;
+	}
+
+	isc_nm_send(handle, &req->body, httpd_senddone, req);
+}
+
 static void
 prepare_response_done(void *arg) {
 	isc_region_t r;
@@ -890,11 +989,13 @@ prepare_response_done(void *arg) {
 	isc_httpd_t *httpd = req->httpd;
 
 	/*
-	 * Determine total response size.
+	 * Send the headers, then the body.
 	 */
 	isc_buffer_usedregion(req->sendbuffer, &r);
 
-	isc_nm_send(httpd->handle, &r, httpd_senddone, req);
+	isc_nm_send(httpd->handle, &r,
+		    (req->body.length > 0) ? httpd_sendbody : httpd_senddone,
+		    req);
 }
 
 static void
@@ -1119,3 +1220,67 @@ const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd) {
 	return ((const isc_time_t *)&httpd->if_modified_since);
 }
+
+isc_result_t
+isc_httpd_queryarg(const isc_httpd_t *httpd, const char *key, char *buf,
+		   size_t size) {
+	const char *query = NULL, *end = NULL;
+	size_t keylen;
+
+	REQUIRE(VALID_HTTPD(httpd));
+	REQUIRE(key != NULL);
+	REQUIRE(buf != NULL && size > 0);
+
+	if ((httpd->up.field_set & (1 << ISC_UF_QUERY)) == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	query = &httpd->path[httpd->up.field_data[ISC_UF_QUERY].off];
+	end = query + httpd->up.field_data[ISC_UF_QUERY].len;
+	keylen = strlen(key);
+
+	while (query < end) {
+		const char *arg = query;
+		const char *next = memchr(arg, '&', end - arg);
+		size_t len = 0;
+
+		if (next == NULL) {
+			next = end;
+		}
+		query = next + 1;
+
+		if ((size_t)(next - arg) < keylen ||
+		    strncmp(arg, key, keylen) != 0)
+		{
+			continue;
+		}
+		arg += keylen;
+		if (arg != next && *arg++ != '=') {
+			continue;
+		}
+
+		/*
+		 * Copy the value, decoding %XX escapes on the way.
+		 */
+		while (arg < next) {
+			char c = *arg++;
+
+			if (c == '%' && next - arg >= 2 &&
+			    isc_hex_char(arg[0]) != 0 &&
+			    isc_hex_char(arg[1]) != 0)
+			{
+				c = ((arg[0] - isc_hex_char(arg[0])) << 4) |
+				    (arg[1] - isc_hex_char(arg[1]));
+				arg += 2;
+			}
+			if (c == '\0' || len + 1 >= size) {
+				return (ISC_R_NOSPACE);
+			}
+			buf[len++] = c;
+		}
+		buf[len] = '\0';
+		return (ISC_R_SUCCESS);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
@@ -19,6 +19,14 @@
 
 #include <isc/endian.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ISC_ASCII_VECTOR 16
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ISC_ASCII_VECTOR 16
+#endif
+
 /*
  * ASCII case conversion
  */
@@ -40,11 +48,86 @@ isc__ascii_tolower1(uint8_t c) {
 	return (c + ('a' - 'A') * ('A' <= c && c <= 'Z'));
 }
 
+#ifdef ISC_ASCII_VECTOR
+/*
+ * Convert 16 bytes to lower case in a vector register. The SSE2 and
+ * NEON (AArch64) instructions used here are part of the baseline of
+ * their architectures, so no run-time feature detection is needed.
+ */
+#if defined(__SSE2__)
+typedef __m128i isc__ascii_vec_t;
+
+static inline isc__ascii_vec_t
+isc__ascii_load16(const uint8_t *ptr) {
+	return (_mm_loadu_si128((const __m128i *)ptr));
+}
+
+static inline void
+isc__ascii_store16(uint8_t *ptr, isc__ascii_vec_t vec) {
+	_mm_storeu_si128((__m128i *)ptr, vec);
+}
+
+static inline isc__ascii_vec_t
+isc__ascii_tolower16(isc__ascii_vec_t octets) {
+	/*
+	 * Signed comparisons, so bytes with the top bit set are never
+	 * classified as upper case.
+	 */
+	__m128i is_ge_A = _mm_cmpgt_epi8(octets, _mm_set1_epi8('A' - 1));
+	__m128i is_le_Z = _mm_cmplt_epi8(octets, _mm_set1_epi8('Z' + 1));
+	__m128i is_upper = _mm_and_si128(is_ge_A, is_le_Z);
+	return (_mm_or_si128(octets,
+			     _mm_and_si128(is_upper, _mm_set1_epi8(0x20))));
+}
+
+static inline bool
+isc__ascii_equal16(isc__ascii_vec_t a, isc__ascii_vec_t b) {
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF);
+}
+#else
+typedef uint8x16_t isc__ascii_vec_t;
+
+static inline isc__ascii_vec_t
+isc__ascii_load16(const uint8_t *ptr) {
+	return (vld1q_u8(ptr));
+}
+
+static inline void
+isc__ascii_store16(uint8_t *ptr, isc__ascii_vec_t vec) {
+	vst1q_u8(ptr, vec);
+}
+
+static inline isc__ascii_vec_t
+isc__ascii_tolower16(isc__ascii_vec_t octets) {
+	/*
+	 * Unsigned wraparound turns the range check into one comparison.
+	 */
+	uint8x16_t offset = vsubq_u8(octets, vdupq_n_u8('A'));
+	uint8x16_t is_upper = vcleq_u8(offset, vdupq_n_u8('Z' - 'A'));
+	return (vorrq_u8(octets, vandq_u8(is_upper, vdupq_n_u8(0x20))));
+}
+
+static inline bool
+isc__ascii_equal16(isc__ascii_vec_t a, isc__ascii_vec_t b) {
+	return (vminvq_u8(vceqq_u8(a, b)) == 0xFF);
+}
+#endif
+#endif /* ISC_ASCII_VECTOR */
+
 /*
  * Copy `len` bytes from `src` to `dst`, converting to lower case.
  */
 static inline void
 isc_ascii_lowercopy(uint8_t *dst, const uint8_t *src, unsigned int len) {
+#ifdef ISC_ASCII_VECTOR
+	while (len >= ISC_ASCII_VECTOR) {
+		isc__ascii_store16(dst,
+				   isc__ascii_tolower16(isc__ascii_load16(src)));
+		len -= ISC_ASCII_VECTOR;
+		dst += ISC_ASCII_VECTOR;
+		src += ISC_ASCII_VECTOR;
+	}
+#endif
 	while (len-- > 0) {
 		*dst++ = isc__ascii_tolower1(*src++);
 	}
@@ -62,10 +145,9 @@ isc_ascii_strtolower(char *str) {
 /*
  * Convert 8 bytes to lower case, using SWAR tricks (SIMD within a register).
  * Based on "Hacker's Delight" by Henry S. Warren, "searching for a value in a
- * given range", p. 95. Eight bytes is wider than many labels in DNS names, so
- * it does not seem worth dealing with the portability issues of wide vector
- * registers. If there was a vector string load instruction (analogous to
- * memove() below) the balance might be different.
+ * given range", p. 95. Eight bytes is wider than many labels in DNS names;
+ * the 16-byte vector variants above are only used for the bulk of longer
+ * runs, such as whole names, and this handles what is left over.
  */
 static inline uint64_t
 isc_ascii_tolower8(uint64_t octets) {
@@ -133,6 +215,19 @@ isc__ascii_load8(const uint8_t *ptr) {
 static inline bool
 isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
+#ifdef ISC_ASCII_VECTOR
+	while (len >= ISC_ASCII_VECTOR) {
+		if (!isc__ascii_equal16(
+			    isc__ascii_tolower16(isc__ascii_load16(a)),
+			    isc__ascii_tolower16(isc__ascii_load16(b))))
+		{
+			return (false);
+		}
+		len -= ISC_ASCII_VECTOR;
+		a += ISC_ASCII_VECTOR;
+		b += ISC_ASCII_VECTOR;
+	}
+#endif
 	while (len >= 8) {
 		a8 = isc_ascii_tolower8(isc__ascii_load8(a));
 		b8 = isc_ascii_tolower8(isc__ascii_load8(b));
@@ -160,6 +255,20 @@ isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 static inline int
 isc_ascii_lowercmp(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
+#ifdef ISC_ASCII_VECTOR
+	/*
+	 * Skip over the equal prefix a vector at a time; the word-sized
+	 * loop below works out the order within the block that differs.
+	 */
+	while (len >= ISC_ASCII_VECTOR &&
+	       isc__ascii_equal16(isc__ascii_tolower16(isc__ascii_load16(a)),
+				  isc__ascii_tolower16(isc__ascii_load16(b))))
+	{
+		len -= ISC_ASCII_VECTOR;
+		a += ISC_ASCII_VECTOR;
+		b += ISC_ASCII_VECTOR;
+	}
+#endif
 	while (len >= 8) {
 		a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
 		b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
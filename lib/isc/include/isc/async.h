@@ -50,4 +50,24 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
  * Helper macro to run the job on the current loop
  */
 
+void
+isc_async_background(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+/*%<
+ * Schedule the background job callback 'cb' to be run on the 'loop'
+ * event loop.
+ *
+ * Background jobs run after the jobs scheduled with isc_async_run(), and
+ * only while the current loop tick is within its time budget (see
+ * isc_loop_shouldyield()); at least one is run per tick.  The jobs that
+ * are left wait for the next tick, so the loop processes I/O in between.
+ * Use this for work that is not on the query path, such as zone
+ * maintenance, so that a burst of it does not delay the queries.
+ *
+ * Requires:
+ *
+ *\li	'loop' is a valid isc event loop
+ *\li	'cb' is a callback function, must be non-NULL
+ *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
+ */
+
 ISC_LANG_ENDDECLS
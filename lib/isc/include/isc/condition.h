@@ -58,8 +58,10 @@ typedef pthread_cond_t *isc_condition_t;
 typedef pthread_cond_t isc_condition_t;
 
 #define isc_condition_init(cond)	   isc__condition_init(cond)
-#define isc_condition_wait(cp, mp)	   isc__condition_wait(cp, mp)
-#define isc_condition_waituntil(cp, mp, t) isc__condition_waituntil(cp, mp, t)
+#define isc_condition_wait(cp, mp) \
+	isc__condition_wait(cp, isc__mutex_pthread(mp))
+#define isc_condition_waituntil(cp, mp, t) \
+	isc__condition_waituntil(cp, isc__mutex_pthread(mp), t)
 #define isc_condition_signal(cp)	   isc__condition_signal(cp)
 #define isc_condition_broadcast(cp)	   isc__condition_broadcast(cp)
 #define isc_condition_destroy(cp)	   isc__condition_destroy(cp)
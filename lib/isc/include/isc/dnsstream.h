@@ -41,6 +41,10 @@ typedef struct isc_dnsstream_assembler isc_dnsstream_assembler_t;
  *\li	It tries to use a static buffer for smaller messages, reducing
  *      pressure on the memory manager (hot path);
  *
+ *\li	A dynamically allocated buffer is released as soon as all the data
+ *      in it has been processed, so that idle connections do not keep
+ *      large buffers around;
+ *
  *\li	When allocating dynamic memory for larger messages, it tries to
  *      allocate memory conservatively (generic path).
  *
@@ -364,6 +368,25 @@ isc__dnsstream_assembler_handle_message(
 	return (cont);
 }
 
+static inline void
+isc__dnsstream_assembler_release(isc_dnsstream_assembler_t *restrict dnsasm) {
+	/*
+	 * Switch back to the static buffer once a dynamically allocated
+	 * one has no data left in it.
+	 */
+	if (dnsasm->calling_cb || dnsasm->current != &dnsasm->dnsbuf ||
+	    !dnsasm->dnsbuf.dynamic ||
+	    isc_buffer_remaininglength(&dnsasm->dnsbuf) != 0)
+	{
+		return;
+	}
+
+	isc_buffer_clearmctx(&dnsasm->dnsbuf);
+	isc_buffer_invalidate(&dnsasm->dnsbuf);
+	isc_buffer_init(&dnsasm->dnsbuf, dnsasm->buf, sizeof(dnsasm->buf));
+	isc_buffer_setmctx(&dnsasm->dnsbuf, dnsasm->mctx);
+}
+
 static inline void
 isc__dnsstream_assembler_processing(isc_dnsstream_assembler_t *restrict dnsasm,
 				    void *userarg) {
@@ -507,6 +530,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 			 */
 			isc__dnsstream_assembler_incoming_direct(
 				dnsasm, userarg, buf, buf_size);
+			isc__dnsstream_assembler_release(dnsasm);
 			return;
 		} else if (isc__dnsstream_assembler_incoming_direct_non_empty(
 				   dnsasm, userarg, buf, buf_size))
@@ -520,6 +544,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 			 * copied into the internal buffer to be processed later
 			 * when receiving the next batch of data.
 			 */
+			isc__dnsstream_assembler_release(dnsasm);
 			return;
 		} else if (remaining == 1) {
 			/* Mostly the same case as above, but we have incomplete
@@ -537,6 +562,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 				    dnsasm, userarg, unprocessed_buf,
 				    unprocessed_size))
 			{
+				isc__dnsstream_assembler_release(dnsasm);
 				return;
 			}
 
@@ -558,6 +584,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 	isc__dnsstream_assembler_processing(dnsasm, userarg);
 
 	isc_buffer_trycompact(dnsasm->current);
+	isc__dnsstream_assembler_release(dnsasm);
 }
 
 static inline isc_result_t
@@ -584,5 +611,6 @@ isc_dnsstream_assembler_clear(isc_dnsstream_assembler_t *restrict dnsasm) {
 	if (dnsasm->current != &dnsasm->dnsbuf) {
 		isc_buffer_clear(&dnsasm->dnsbuf);
 	}
+	isc__dnsstream_assembler_release(dnsasm);
 	dnsasm->result = ISC_R_UNSET;
 }
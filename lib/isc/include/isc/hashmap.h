@@ -38,6 +38,31 @@ typedef bool (*isc_hashmap_match_fn)(void *node, const void *key);
 void
 isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, isc_hashmap_t **hashmapp);
 
+/*%
+ * isc_hashmap_create_ex() options
+ */
+#define ISC_HASHMAP_GROUPED 0x0001
+
+/*%
+ * Like isc_hashmap_create(), with 'options':
+ *
+ * \li	#ISC_HASHMAP_GROUPED: use an open addressing table probed a
+ *	group of slots at a time, instead of the Robin Hood table.
+ *	Lookups compare small hash tags of 16 slots at once, so they
+ *	stay short at high load factors, and deleted nodes are never
+ *	moved.  The table is resized all at once instead of
+ *	incrementally, and it only shrinks when it is resized for an
+ *	insertion.
+ *
+ * Requires:
+ * \li	'hashmapp' is not NULL and '*hashmapp' is NULL.
+ * \li	'mctx' is a valid memory context.
+ * \li	'bits' >=1 and 'bits' <=32
+ */
+void
+isc_hashmap_create_ex(isc_mem_t *mctx, uint8_t bits, unsigned int options,
+		      isc_hashmap_t **hashmapp);
+
 /*%
  * Destroy hashmap, freeing everything
  *
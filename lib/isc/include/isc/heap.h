@@ -73,6 +73,24 @@ isc_heap_create(isc_mem_t *mctx, isc_heapcompare_t compare,
  *\li	"heapp" is not NULL, and "*heap" is NULL.
  */
 
+/*%
+ * isc_heap_create_ex() options
+ */
+#define ISC_HEAP_QUATERNARY 0x0001
+
+void
+isc_heap_create_ex(isc_mem_t *mctx, isc_heapcompare_t compare,
+		   isc_heapindex_t index, unsigned int size_increment,
+		   unsigned int options, isc_heap_t **heapp);
+/*!<
+ * \brief Like isc_heap_create(), with 'options':
+ *
+ *\li	#ISC_HEAP_QUATERNARY: give every node four children instead of
+ *	two, with the children of a node in the same cache line.  This
+ *	makes the heap half as deep, for a few more comparisons per level,
+ *	and is meant for large heaps whose elements are often moved down.
+ */
+
 void
 isc_heap_destroy(isc_heap_t **heapp);
 /*!<
@@ -91,6 +109,32 @@ isc_heap_insert(isc_heap_t *heap, void *elt);
  *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
  */
 
+void
+isc_heap_append(isc_heap_t *heap, void *elt);
+/*!<
+ * \brief Adds a new element at the end of a heap, without putting it in
+ * order.  The appended elements are put in order all at once, in linear
+ * time when there are many of them, by isc_heap_heapify() or the next
+ * isc_heap_insert().  Until then, they can be deleted, and changing
+ * their priority needs no call to isc_heap_increased() or
+ * isc_heap_decreased().
+ *
+ * This is meant for adding many elements in a row, e.g. when loading.
+ *
+ * Requires:
+ *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
+ */
+
+void
+isc_heap_heapify(isc_heap_t *heap);
+/*!<
+ * \brief Puts the elements added with isc_heap_append() in order.  This
+ * changes the element indexes.
+ *
+ * Requires:
+ *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
+ */
+
 void
 isc_heap_delete(isc_heap_t *heap, unsigned int index);
 /*!<
@@ -135,6 +179,8 @@ isc_heap_element(isc_heap_t *heap, unsigned int index);
  *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
  *\li	"index" is a valid element index, as provided by the "index" callback
  *	provided during heap creation.
+ *\li	The elements added with isc_heap_append(), if any, have been put
+ *	in order with isc_heap_heapify().
  *
  * Returns:
  *\li	A pointer to the element for the element index.
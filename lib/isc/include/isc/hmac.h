@@ -90,6 +90,18 @@ isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 isc_result_t
 isc_hmac_reset(isc_hmac_t *hmac);
 
+/**
+ * isc_hmac_copy:
+ * @hmac: HMAC context
+ * @source: HMAC context to copy
+ *
+ * This function copies the state of @source, including its key, into @hmac.
+ * Copying a context that was just initialized is cheaper than initializing
+ * another one with the same key.
+ */
+isc_result_t
+isc_hmac_copy(isc_hmac_t *hmac, isc_hmac_t *source);
+
 /**
  * isc_hmac_update:
  * @hmac: HMAC context
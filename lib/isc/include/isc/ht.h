@@ -24,7 +24,11 @@
 typedef struct isc_ht	   isc_ht_t;
 typedef struct isc_ht_iter isc_ht_iter_t;
 
-enum { ISC_HT_CASE_SENSITIVE = 0x00, ISC_HT_CASE_INSENSITIVE = 0x01 };
+enum {
+	ISC_HT_CASE_SENSITIVE = 0x00,
+	ISC_HT_CASE_INSENSITIVE = 0x01,
+	ISC_HT_FLAT = 0x02,
+};
 
 /*%
  * Initialize hashtable at *htp, using memory context and size of (1<<bits)
@@ -33,6 +37,14 @@ enum { ISC_HT_CASE_SENSITIVE = 0x00, ISC_HT_CASE_INSENSITIVE = 0x01 };
  * letters in key values will generate the same hash values; this can be used
  * when the key for a hash table is a DNS name.
  *
+ * If 'options' contains ISC_HT_FLAT, the entries are stored in a single
+ * open addressing array instead of separately allocated nodes chained
+ * from the buckets: short keys are kept in the array itself and longer
+ * ones in large shared chunks, so adding an entry seldom allocates
+ * memory.  A flat table is rebuilt all at once when it grows, so it
+ * must not be added to while it is being iterated; deleting the
+ * current entry with isc_ht_iter_delcurrent_next() is allowed.
+ *
  * Requires:
  *\li	'htp' is not NULL and '*htp' is NULL.
  *\li	'mctx' is a valid memory context.
@@ -43,6 +55,20 @@ void
 isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, uint8_t bits,
 	    unsigned int options);
 
+/*%
+ * Like isc_ht_init(), with a size that fits 'count' entries without
+ * growing.  This is meant for tables built in one go from a known or
+ * previous number of entries, e.g. a new set of names that is then
+ * compared with the old one.
+ *
+ * Requires:
+ *\li	'htp' is not NULL and '*htp' is NULL.
+ *\li	'mctx' is a valid memory context.
+ */
+void
+isc_ht_init_sized(isc_ht_t **htp, isc_mem_t *mctx, size_t count,
+		  unsigned int options);
+
 /*%
  * Destroy hashtable, freeing everything
  *
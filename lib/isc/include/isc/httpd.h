@@ -58,3 +58,19 @@ isc_httpdurl_loadtime(const isc_httpdurl_t *url);
 
 const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd);
+
+isc_result_t
+isc_httpd_queryarg(const isc_httpd_t *httpd, const char *key, char *buf,
+		   size_t size);
+/*%<
+ * Find the argument 'key' in the query string of the request being
+ * processed by 'httpd' and copy its value, with any %XX escapes decoded,
+ * into 'buf' as a NUL-terminated string.  An argument given without a
+ * value ("?key") is returned as an empty string.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		'key' is not in the query string.
+ * \li	#ISC_R_NOSPACE		The value does not fit into 'size' bytes
+ *				or contains a NUL character.
+ */
@@ -27,6 +27,13 @@
  */
 #define NSEC3_MAX_LABEL_HASH 35
 
+/*
+ * The number of hashes that isc_iterated_hash_batch() computes in
+ * parallel; callers get the most out of it by passing a multiple of
+ * this many inputs.
+ */
+#define ISC_ITERATED_HASH_BATCH 8
+
 ISC_LANG_BEGINDECLS
 
 int
@@ -35,6 +42,24 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 		  const int saltlength, const unsigned char *in,
 		  const int inlength);
 
+int
+isc_iterated_hash_batch(unsigned char *out[], const unsigned int hashalg,
+			const int iterations, const unsigned char *salt,
+			const int saltlength, const unsigned char *in[],
+			const int inlength[], const unsigned int count);
+/*%<
+ * Compute the iterated hash of each of the 'count' inputs 'in[i]' of
+ * length 'inlength[i]' into 'out[i]', with the same algorithm, salt
+ * and number of iterations for all of them; the result is the same as
+ * calling isc_iterated_hash() on each input in turn.
+ *
+ * When the salt is short enough, the iterations after the first run
+ * over ISC_ITERATED_HASH_BATCH inputs at a time in parallel; any
+ * inputs left over are hashed one at a time.
+ *
+ * Returns the length of each hash, or 0 on failure.
+ */
+
 /*
  * Private
  */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/lockprof.h
+ * \brief Lock contention profiler.
+ *
+ * When BIND is configured with --enable-lock-profiling, every isc_mutex_t
+ * and every isc_rwlock_t remembers the source location where it was
+ * initialized, and all locks initialized at the same location share a
+ * single set of counters (the "lock class").  While profiling is enabled,
+ * each acquisition records whether it had to wait and for how long, and
+ * each release of an exclusive lock records how long it was held.
+ *
+ * In other builds, the locks are unchanged and isc_lockprof_enable()
+ * returns ISC_R_NOTIMPLEMENTED.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/lang.h>
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+#if ISC_LOCK_PROFILE
+
+#ifdef ISC_TRACK_PTHREADS_OBJECTS
+#error "ISC_LOCK_PROFILE cannot be used with ISC_TRACK_PTHREADS_OBJECTS"
+#endif /* ISC_TRACK_PTHREADS_OBJECTS */
+
+typedef struct isc_lockprof isc_lockprof_t;
+
+struct isc_lockprof {
+	const char	    *kind;
+	char		    *file;
+	unsigned int	     line;
+	atomic_uint_fast64_t locks;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t wait_ns;
+	atomic_uint_fast64_t max_wait_ns;
+	atomic_uint_fast64_t hold_ns;
+	atomic_uint_fast64_t max_hold_ns;
+	isc_lockprof_t	    *next;
+};
+
+extern atomic_bool isc__lockprof_enabled;
+
+/*%
+ * Look up the lock class for the current source location; the result is
+ * cached in a static variable, so the registry is only searched the first
+ * time a lock is initialized at a given location.
+ */
+#define ISC_LOCKPROF_SITE(kind)                                               \
+	({                                                                    \
+		static _Atomic(isc_lockprof_t *) _site = NULL;                \
+		isc_lockprof_t *_prof = atomic_load_acquire(&_site);          \
+		if (_prof == NULL) {                                          \
+			_prof = isc__lockprof_site(kind, __FILE__, __LINE__); \
+			atomic_store_release(&_site, _prof);                  \
+		}                                                             \
+		_prof;                                                        \
+	})
+
+#define isc__lockprof_active() atomic_load_relaxed(&isc__lockprof_enabled)
+
+isc_lockprof_t *
+isc__lockprof_site(const char *kind, const char *file, unsigned int line);
+/*%<
+ * Return the lock class for locks of type 'kind' initialized at
+ * 'file':'line', creating it if necessary.  Lock classes are never freed.
+ */
+
+void
+isc__lockprof_acquired(isc_lockprof_t *prof, bool contended, uint64_t wait);
+/*%<
+ * Record an acquisition of a lock of class 'prof'; 'wait' is the time
+ * in nanoseconds spent waiting for a contended lock.
+ */
+
+void
+isc__lockprof_released(isc_lockprof_t *prof, uint64_t hold);
+/*%<
+ * Record that a lock of class 'prof' was held for 'hold' nanoseconds.
+ */
+
+#endif /* ISC_LOCK_PROFILE */
+
+isc_result_t
+isc_lockprof_enable(bool enable);
+/*%<
+ * Start or stop collecting lock statistics.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	if built without --enable-lock-profiling
+ */
+
+bool
+isc_lockprof_enabled(void);
+/*%<
+ * Return true if lock statistics are being collected.
+ */
+
+void
+isc_lockprof_reset(void);
+/*%<
+ * Zero the counters of all lock classes.
+ */
+
+isc_result_t
+isc_lockprof_dump(isc_buffer_t **text);
+/*%<
+ * Append a table of all lock classes that have been acquired at least
+ * once, sorted by total wait time, to '*text'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	if built without --enable-lock-profiling
+ */
+
+ISC_LANG_ENDDECLS
@@ -68,6 +68,8 @@ typedef struct isc_logconfig isc_logconfig_t; /*%< Log Configuration */
 #define ISC_LOG_PRINTPREFIX   0x00020 /* tag only, no colon */
 #define ISC_LOG_PRINTALL      0x0003F
 #define ISC_LOG_BUFFERED      0x00040
+#define ISC_LOG_ASYNC	      0x00080 /* written by the helper thread */
+#define ISC_LOG_ASYNCBLOCK    0x00100 /* if ASYNC, wait rather than drop */
 #define ISC_LOG_DEBUGONLY     0x01000
 #define ISC_LOG_OPENERR	      0x08000 /* internal */
 #define ISC_LOG_ISO8601	      0x10000 /* if PRINTTIME, use ISO8601 */
@@ -414,6 +416,13 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
  *	debug level of the logging context (see isc_log_setdebuglevel)
  *	is non-zero.
  *
+ *\li	#ISC_LOG_ASYNC makes the logging thread only format the messages
+ *	for the channel and queue them; a helper thread writes them out
+ *	in batches.  When the queue is full, messages are dropped and the
+ *	number dropped is logged to the channel later, unless
+ *	#ISC_LOG_ASYNCBLOCK is also set, in which case the logging thread
+ *	waits for the helper thread to catch up.
+ *
  * Requires:
  *\li	lcfg is a valid logging configuration.
  *
@@ -427,7 +436,8 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
  *\li	level is >= #ISC_LOG_CRITICAL (the most negative logging level).
  *
  *\li	flags does not include any bits aside from the ISC_LOG_PRINT* bits,
- *	#ISC_LOG_DEBUGONLY or #ISC_LOG_BUFFERED.
+ *	#ISC_LOG_DEBUGONLY, #ISC_LOG_BUFFERED, #ISC_LOG_ASYNC or
+ *	#ISC_LOG_ASYNCBLOCK.
  *
  * Ensures:
  *\li	#ISC_R_SUCCESS
@@ -197,6 +197,42 @@ isc_loopmgr_nonblocking(isc_loopmgr_t *loopmgr);
  *\li	'loopmgr' is a valid loop manager.
  */
 
+isc_result_t
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr);
+/*%<
+ * Pin every loop thread to the CPU assigned to it when the loop manager
+ * was created.  The loops are assigned to the CPUs the process may run
+ * on in ascending order, so loop N runs on the Nth allowed CPU.
+ *
+ * Requires:
+ *\li	'loopmgr' is a valid, running loop manager.
+ *\li	We are in the main loop.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	thread affinity is not supported
+ *\li	any error returned by isc_thread_setaffinity()
+ */
+
+bool
+isc_loopmgr_getaffinity(isc_loopmgr_t *loopmgr);
+/*%<
+ * Return true if the loop threads have been pinned to their CPUs.
+ *
+ * Requires:
+ *\li	'loopmgr' is a valid loop manager.
+ */
+
+int
+isc_loop_getcpu(isc_loop_t *loop);
+/*%<
+ * Return the CPU assigned to 'loop'.  The loop only actually runs
+ * there if isc_loopmgr_setaffinity() succeeded.
+ *
+ * Requires:
+ *\li	'loop' is a valid loop.
+ */
+
 isc_loopmgr_t *
 isc_loop_getloopmgr(isc_loop_t *loop);
 /*%<
@@ -225,4 +261,36 @@ isc_loop_shuttingdown(isc_loop_t *loop);
  *
  * \li 'loop' is a valid loop and the loop tid matches the current tid.
  */
+
+#define ISC_LOOP_BUDGET_DEFAULT 10 /* milliseconds */
+
+void
+isc_loopmgr_setbudget(isc_loopmgr_t *loopmgr, uint32_t budget);
+/*%<
+ * Set the time, in milliseconds, that the callbacks run by a loop in one
+ * tick can take before isc_loop_shouldyield() asks long jobs to give the
+ * loop back.  Zero disables yielding.  The default is
+ * ISC_LOOP_BUDGET_DEFAULT.
+ *
+ * Requires:
+ *
+ * \li 'loopmgr' is a valid loop manager.
+ */
+
+bool
+isc_loop_shouldyield(void);
+/*%<
+ * Returns whether the current loop tick has used up its time budget.
+ * A job that does a large amount of work in steps should check this
+ * between the steps and, when it returns true, save its state and
+ * reschedule itself, so that the loop can process I/O in between.
+ *
+ * The tick is measured from the time returned by isc_loop_now(), so the
+ * granularity of the budget is that of the loop clock.
+ *
+ * Requires:
+ *
+ * \li Called from a loop thread.
+ */
+
 ISC_LANG_ENDDECLS
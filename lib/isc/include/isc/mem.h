@@ -232,6 +232,51 @@ isc__mem_create_arena(isc_mem_t **_ISC_MEM_FLARG);
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
 
+#define isc_mem_create_hugepages(cp) \
+	isc__mem_create_hugepages((cp)_ISC_MEM_FILELINE)
+void
+isc__mem_create_hugepages(isc_mem_t **_ISC_MEM_FLARG);
+/*!<
+ * \brief Create a memory context that routes all its operations to a
+ * dedicated jemalloc arena whose memory is backed by transparent huge
+ * pages, to reduce TLB misses when walking large data structures. If
+ * huge pages are not available the arena uses ordinary pages; when
+ * such arenas are not supported at all, the function is an alias to
+ * isc_mem_create_arena().
+ *
+ * Memory freed in such a context is reused, but it is not returned to
+ * the system until the context is destroyed.
+ *
+ * Requires:
+ * mctxp != NULL && *mctxp == NULL */
+/*@}*/
+
+#define isc_mem_createchild(p, cp) \
+	isc__mem_createchild((p), (cp)_ISC_MEM_FILELINE)
+void
+isc__mem_createchild(isc_mem_t *, isc_mem_t **_ISC_MEM_FLARG);
+/*!<
+ * \brief Create an accounting context that allocates from the same
+ * jemalloc arena as 'parent', with the same flags, but keeps its own
+ * usage counter and water marks.  Everything allocated from the child
+ * is also accounted for in 'parent' and its ancestors, so a parent's
+ * water marks cover the memory used by its children.
+ *
+ * The child holds a reference to 'parent' until it is destroyed.  The
+ * arena tuning functions below have no effect on a child.
+ *
+ * Requires:
+ * parent is a valid memory context
+ * mctxp != NULL && *mctxp == NULL */
+/*@}*/
+
+size_t
+isc_mem_hugepages(void);
+/*!<
+ * \brief Return the number of bytes currently mapped by all the memory
+ * contexts created with isc_mem_create_hugepages().
+ */
+
 isc_result_t
 isc_mem_arena_set_muzzy_decay_ms(isc_mem_t *mctx, const ssize_t decay_ms);
 
@@ -351,7 +396,7 @@ isc_mem_setname(isc_mem_t *ctx, const char *name);
  *
  * Notes:
  *
- *\li	Only the first 15 characters of 'name' will be copied.
+ *\li	Only the first 63 characters of 'name' will be copied.
  *
  * Requires:
  *
@@ -400,6 +445,12 @@ isc__mempool_create(isc_mem_t *restrict mctx, const size_t element_size,
 /*%<
  * Create a memory pool.
  *
+ * Notes:
+ *\li	Pools are not locked, so a pool must only be used by one thread.
+ *	Objects that are allocated on every loop should come from a pool
+ *	per loop, which gives each thread its own free list and lets it
+ *	recycle objects without touching shared state.
+ *
  * Requires:
  *\li	mctx is a valid memory context.
  *\li	size > 0
@@ -489,6 +540,19 @@ isc_mempool_setfillcount(isc_mempool_t *restrict mpctx,
  *\li	limit > 0
  */
 
+size_t
+isc_mempool_getgets(isc_mempool_t *restrict mpctx);
+/*%<
+ * Returns the number of items that have been handed out by this pool.
+ */
+
+size_t
+isc_mempool_getmisses(isc_mempool_t *restrict mpctx);
+/*%<
+ * Returns the number of times the free list was empty and had to be
+ * refilled from the parent memory context.
+ */
+
 #if defined(UNIT_TESTING) && defined(malloc)
 /*
  * cmocka.h redefined malloc as a macro, we #undef it
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include <isc/lang.h>
+#include <isc/lockprof.h>
 #include <isc/result.h> /* for ISC_R_ codes */
 #include <isc/util.h>
 
@@ -49,6 +50,41 @@ typedef pthread_mutex_t *isc_mutex_t;
 		free(*mp);               \
 	}
 
+#define isc__mutex_pthread(mp) (*mp)
+
+#elif ISC_LOCK_PROFILE
+
+/*
+ * Every mutex points to the counters of its lock class, which is the
+ * source location of isc_mutex_init(); see isc/lockprof.h.  The hold
+ * time of a mutex includes the time spent waiting on a condition
+ * variable with the mutex.
+ */
+typedef struct isc_mutex {
+	pthread_mutex_t mutex;
+	isc_lockprof_t *prof;
+	uint64_t	acquired;
+} isc_mutex_t;
+
+#define isc_mutex_init(mp) isc__mutex_profinit(mp, ISC_LOCKPROF_SITE("mutex"))
+#define isc_mutex_lock(mp)     isc__mutex_proflock(mp)
+#define isc_mutex_unlock(mp)   isc__mutex_profunlock(mp)
+#define isc_mutex_trylock(mp)  isc__mutex_proftrylock(mp)
+#define isc_mutex_destroy(mp)  isc__mutex_destroy(&(mp)->mutex)
+#define isc__mutex_pthread(mp) (&(mp)->mutex)
+
+void
+isc__mutex_profinit(isc_mutex_t *mp, isc_lockprof_t *prof);
+
+void
+isc__mutex_proflock(isc_mutex_t *mp);
+
+void
+isc__mutex_profunlock(isc_mutex_t *mp);
+
+isc_result_t
+isc__mutex_proftrylock(isc_mutex_t *mp);
+
 #else /* ISC_TRACK_PTHREADS_OBJECTS */
 
 typedef pthread_mutex_t isc_mutex_t;
@@ -59,6 +95,8 @@ typedef pthread_mutex_t isc_mutex_t;
 #define isc_mutex_trylock(mp) isc__mutex_trylock(mp)
 #define isc_mutex_destroy(mp) isc__mutex_destroy(mp)
 
+#define isc__mutex_pthread(mp) (mp)
+
 #endif /* ISC_TRACK_PTHREADS_OBJECTS */
 
 extern pthread_mutexattr_t isc__mutex_init_attr;
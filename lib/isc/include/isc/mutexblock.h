@@ -21,11 +21,21 @@
 
 ISC_LANG_BEGINDECLS
 
+#if ISC_LOCK_PROFILE
+#define isc_mutexblock_init(block, count) \
+	isc__mutexblock_profinit(block, count, ISC_LOCKPROF_SITE("mutex"))
+
+void
+isc__mutexblock_profinit(isc_mutex_t *block, unsigned int count,
+			 isc_lockprof_t *prof);
+#else /* ISC_LOCK_PROFILE */
 void
 isc_mutexblock_init(isc_mutex_t *block, unsigned int count);
+#endif /* ISC_LOCK_PROFILE */
 /*%<
  * Initialize a block of locks.  If an error occurs all initialized locks
- * will be destroyed, if possible.
+ * will be destroyed, if possible.  When profiling locks, all the locks in
+ * the block share the lock class of the caller.
  *
  * Requires:
  *
@@ -31,12 +31,25 @@
 #define HAVE_SO_REUSEPORT_LB 1
 #endif
 
+#if defined(HAVE_SO_REUSEPORT_LB) && defined(SO_ATTACH_REUSEPORT_CBPF) && \
+	defined(SO_INCOMING_CPU)
+#define HAVE_SO_ATTACH_REUSEPORT_CBPF 1
+#endif
+
 /*
  * Convenience macros to specify on how many threads should socket listen
  */
 #define ISC_NM_LISTEN_ALL 0
 #define ISC_NM_LISTEN_ONE 1
 
+/*
+ * Maximum number of datagrams received from a UDP socket in a single
+ * recvmmsg(2) call; this is UV__MMSG_MAXWIDTH taken from the current
+ * libuv source.  A receive batch of 0 means "use the maximum".
+ */
+#define ISC_NM_UDP_RECVBATCH_DEFAULT 0
+#define ISC_NM_UDP_RECVBATCH_MAX     20
+
 /*
  * Replacement for isc_sockettype_t provided by socket.h.
  */
@@ -290,15 +303,24 @@ isc_nmhandle_netmgr(isc_nmhandle_t *handle);
 
 isc_result_t
 isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
-		 isc_nm_recv_cb_t cb, void *cbarg, isc_nmsocket_t **sockp);
+		 uint32_t recv_batch, isc_nm_recv_cb_t cb, void *cbarg,
+		 isc_nmsocket_t **sockp);
 /*%<
  * Start listening for UDP packets on interface 'iface' using net manager
  * 'mgr'.
  *
+ * 'recv_batch' limits the number of datagrams read from the socket with
+ * a single recvmmsg(2) call; ISC_NM_UDP_RECVBATCH_DEFAULT (0) selects
+ * the largest batch supported by libuv.  On systems without recvmmsg(2)
+ * support the value is ignored.
+ *
  * On success, 'sockp' will be updated to contain a new listening UDP socket.
  *
  * When a packet is received on the socket, 'cb' will be called with 'cbarg'
  * as its argument.
+ *
+ * Requires:
+ *\li	'recv_batch' <= ISC_NM_UDP_RECVBATCH_MAX.
  */
 
 void
@@ -328,7 +350,8 @@ isc_nm_routeconnect(isc_nm_t *mgr, isc_nm_cb_t cb, void *cbarg);
 
 isc_result_t
 isc_nm_listenproxyudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
-		      isc_nm_recv_cb_t cb, void *cbarg, isc_nmsocket_t **sockp);
+		      uint32_t recv_batch, isc_nm_recv_cb_t cb, void *cbarg,
+		      isc_nmsocket_t **sockp);
 /*%<
  * The same as `isc_nm_listenudp()`, but PROXYv2 headers are
  * expected at the beginning of the received datagrams.
@@ -569,6 +592,72 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+void
+isc_nm_setudpbusypoll(isc_nm_t *mgr, uint32_t usec);
+/*%<
+ * If not 0, sets the SO_BUSY_POLL socket option to 'usec' microseconds
+ * on the UDP listening sockets created after the call, making the
+ * kernel busy poll the device queue for incoming packets instead of
+ * waiting for the interrupt.  If the option cannot be set, e.g. because
+ * the process lacks CAP_NET_ADMIN, the sockets are used without it and
+ * a warning is logged the first time this happens.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+bool
+isc_nm_getcpusteering(isc_nm_t *mgr);
+void
+isc_nm_setcpusteering(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set CPU steering of the load balanced UDP listening sockets.
+ * When enabled, a classic BPF program is attached to each reuseport
+ * group that selects the socket by the CPU which received the packet
+ * (SO_INCOMING_CPU), so that the datagram received on CPU N is
+ * delivered to the socket owned by loop N (modulo the number of
+ * sockets).  Combined with isc_loopmgr_setaffinity() this keeps each
+ * packet on the CPU that took the NIC interrupt.
+ *
+ * Only affects sockets created after the call; setting has no effect
+ * unless load balanced sockets are enabled and the system supports
+ * SO_ATTACH_REUSEPORT_CBPF.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_setlistenloops(isc_nm_t *mgr, uint32_t nloops);
+/*%<
+ * Make listeners created with ISC_NM_LISTEN_ALL use only the first
+ * 'nloops' loops, leaving the others free for work that does not come
+ * from the listening sockets, such as zone maintenance.  Only affects
+ * listeners created after the call.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ * \li	0 < 'nloops' <= the number of loops.
+ */
+
+bool
+isc_nm_getudpsendcoalesce(isc_nm_t *mgr);
+void
+isc_nm_setudpsendcoalesce(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set UDP send coalescing.  When enabled, the datagrams sent
+ * from UDP listening sockets during a single event loop iteration are
+ * queued and then flushed together with sendmmsg(2); consecutive
+ * datagrams of the same size to the same peer are additionally merged
+ * into a single UDP_SEGMENT (GSO) message where supported.
+ *
+ * Setting has no effect on systems without sendmmsg(2), and the getter
+ * always returns 'false' there.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised);
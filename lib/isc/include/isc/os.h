@@ -35,6 +35,13 @@ isc_os_ncpus(void);
  * be determined.
  */
 
+unsigned int
+isc_os_numanodes(void);
+/*%<
+ * Return the number of NUMA nodes on the system, or 1 if this cannot
+ * be determined. Nodes are assumed to be numbered from zero.
+ */
+
 unsigned long
 isc_os_cacheline(void);
 /*%<
@@ -290,7 +290,6 @@ typedef void (*isc_proxy2_handler_cb_t)(const isc_result_t	   result,
 struct isc_proxy2_handler {
 	isc_buffer_t hdrbuf; /*!< Internal buffer for assembling PROXYv2 header
 			      */
-	uint8_t buf[256];    /*!< Internal buffer static storage */
 
 	int	 state;	      /*!< Current state machine state */
 	uint16_t expect_data; /*!< How much data do we need to switch to the
@@ -320,6 +319,10 @@ struct isc_proxy2_handler {
 				    header */
 	isc_region_t extra_data; /*!< Data past the PROXYv2 header (not
 				    belonging to it) */
+
+	uint8_t buf[256]; /*!< Internal buffer static storage; kept last so
+			     that resetting the state does not need to
+			     touch it */
 };
 
 void
@@ -103,13 +103,22 @@ typedef struct isc_radix_node {
 #define RADIX_TREE_MAGIC    ISC_MAGIC('R', 'd', 'x', 'T')
 #define RADIX_TREE_VALID(a) ISC_MAGIC_VALID(a, RADIX_TREE_MAGIC)
 
+/*
+ * isc_radix_compile() flattens the IPv4 part of a tree into a three
+ * level table indexed by 16, 8 and 8 bits of the address, so an IPv4
+ * host search costs at most three table reads instead of a walk down
+ * the tree.  The table is dropped by any change to the tree.
+ */
+typedef struct isc_radix_v4table isc_radix_v4table_t;
+
 typedef struct isc_radix_tree {
-	unsigned int	  magic;
-	isc_mem_t	 *mctx;
-	isc_radix_node_t *head;
-	uint32_t	  maxbits;	   /* for IP, 32 bit addresses */
-	int		  num_active_node; /* for debugging purposes */
-	int		  num_added_node;  /* total number of nodes */
+	unsigned int	     magic;
+	isc_mem_t	    *mctx;
+	isc_radix_node_t    *head;
+	uint32_t	     maxbits;	      /* for IP, 32 bit addresses */
+	int		     num_active_node; /* for debugging purposes */
+	int		     num_added_node;  /* total number of nodes */
+	isc_radix_v4table_t *v4table;	      /* see isc_radix_compile() */
 } isc_radix_tree_t;
 
 isc_result_t
@@ -181,6 +190,19 @@ isc_radix_destroy(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func);
  * \li	'radix' to be valid.
  */
 
+void
+isc_radix_compile(isc_radix_tree_t *radix);
+/*%<
+ * Build the IPv4 lookup table for 'radix', which isc_radix_search()
+ * then uses for IPv4 host addresses, giving the same answers as the
+ * tree.  Trees with only a few IPv4 prefixes are left alone, since
+ * walking them is already cheap.  The table is freed when the tree is
+ * next changed, so this should be called once the tree is complete.
+ *
+ * Requires:
+ * \li	'radix' to be valid.
+ */
+
 void
 isc_radix_process(isc_radix_tree_t *radix, isc_radix_processfunc_t func);
 /*%<
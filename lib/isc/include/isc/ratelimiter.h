@@ -89,7 +89,7 @@ isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
 /*%<
  * Queue an event for rate-limited execution.
  *
- * This is similar to doing an isc_async_run() to the 'loop', except
+ * This is similar to doing an isc_async_background() to the 'loop', except
  * that the execution may be delayed to achieve the desired rate of
  * execution.
  *
@@ -162,6 +162,7 @@ typedef pthread_rwlock_t isc__rwlock_t;
 #else /* USE_PTHREAD_RWLOCK */
 
 #include <isc/atomic.h>
+#include <isc/lockprof.h>
 #include <isc/os.h>
 
 STATIC_ASSERT(ISC_OS_CACHELINE_SIZE >= sizeof(atomic_uint_fast32_t),
@@ -178,12 +179,29 @@ struct isc_rwlock {
 	atomic_int_fast32_t writers_barrier;
 	uint8_t __padding3[ISC_OS_CACHELINE_SIZE - sizeof(atomic_int_fast32_t)];
 	atomic_bool writers_lock;
+#if ISC_LOCK_PROFILE
+	isc_lockprof_t *prof;
+	uint64_t	wracquired;
+#endif /* ISC_LOCK_PROFILE */
 };
 
 typedef struct isc_rwlock isc_rwlock_t;
 
+#if ISC_LOCK_PROFILE
+/*
+ * The rwlock is assigned to the lock class of the isc_rwlock_init()
+ * caller; see isc/lockprof.h.  Only the write side keeps track of how
+ * long the lock has been held.
+ */
+#define isc_rwlock_init(rwl) \
+	isc__rwlock_profinit(rwl, ISC_LOCKPROF_SITE("rwlock"))
+
+void
+isc__rwlock_profinit(isc_rwlock_t *rwl, isc_lockprof_t *prof);
+#else /* ISC_LOCK_PROFILE */
 void
 isc_rwlock_init(isc_rwlock_t *rwl);
+#endif /* ISC_LOCK_PROFILE */
 
 void
 isc_rwlock_rdlock(isc_rwlock_t *rwl);
@@ -80,6 +80,18 @@ enum {
 	isc_sockstatscounter_tcp4clients,
 	isc_sockstatscounter_tcp6clients,
 
+	isc_sockstatscounter_udp4recvbatch,
+	isc_sockstatscounter_udp6recvbatch,
+
+	isc_sockstatscounter_udp4recvbatchmsgs,
+	isc_sockstatscounter_udp6recvbatchmsgs,
+
+	isc_sockstatscounter_tcp4tlsconnect,
+	isc_sockstatscounter_tcp6tlsconnect,
+
+	isc_sockstatscounter_tcp4tlsresumed,
+	isc_sockstatscounter_tcp6tlsresumed,
+
 	isc_sockstatscounter_max,
 };
 
@@ -107,6 +119,26 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	'statsp' != NULL && '*statsp' == NULL.
  */
 
+void
+isc_stats_create_sharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			 int ncounters);
+/*%<
+ * Like isc_stats_create(), but keep a separate copy of the counters for
+ * each loop, so that loops incrementing the same counter do not contend
+ * for the same cache line.  The values returned by isc_stats_dump() and
+ * isc_stats_get_counter() are the sums over all loops.  This costs
+ * memory and makes reading the counters slower, so it is meant for the
+ * server-wide statistics updated for every query.
+ *
+ * isc_stats_set() and isc_stats_update_if_greater() remain usable for
+ * gauges, but must not be mixed with increments of the same counter.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -141,6 +173,22 @@ isc_statscounter_t
 isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter);
 /*%<
  * Increment the counter-th counter of stats and return the old value.
+ * For statistics created with isc_stats_create_sharded(), the old value
+ * is the one seen by the calling loop only; use isc_stats_get_counter()
+ * for the total.
+ *
+ * Requires:
+ *\li	'stats' is a valid isc_stats_t.
+ *
+ *\li	counter is less than the maximum available ID for the stats specified
+ *	on creation.
+ */
+
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter,
+	      isc_statscounter_t value);
+/*%<
+ * Add 'value' to the counter-th counter of stats.
  *
  * Requires:
  *\li	'stats' is a valid isc_stats_t.
@@ -54,6 +54,17 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu);
+/*%<
+ * Pin 'thread' to the single CPU 'cpu'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FAILURE		the operating system refused the request
+ *\li	#ISC_R_NOTIMPLEMENTED	thread affinity is not supported
+ */
+
 #define isc_thread_self (uintptr_t)pthread_self
 
 ISC_LANG_ENDDECLS
@@ -38,4 +38,22 @@ isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
  * \li 'work_cb' and 'after_work_cb' are not NULL.
  */
 
+void
+isc_work_enqueue_bulk(isc_loop_t *loop, isc_work_cb work_cb,
+		      isc_after_work_cb after_work_cb, void *cbarg);
+/*%<
+ * Like isc_work_enqueue(), but for long-running work that is not
+ * latency sensitive, such as loading, dumping or signing zones.
+ *
+ * All but one of the thread pool threads (but at least one) may run bulk
+ * work at the same time; further bulk work waits, in order of submission,
+ * until one of them is done. This keeps a thread available for work
+ * queued with isc_work_enqueue() even when many zones are being loaded
+ * or signed.
+ *
+ * Requires:
+ * \li 'loop' is a valid event loop.
+ * \li 'work_cb' and 'after_work_cb' are not NULL.
+ */
+
 ISC_LANG_ENDDECLS
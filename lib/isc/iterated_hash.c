@@ -12,7 +12,9 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <openssl/err.h>
 #include <openssl/opensslv.h>
@@ -171,3 +173,204 @@ isc__iterated_hash_shutdown(void) {
 }
 
 #endif /* HAVE_SHA1_INIT */
+
+/*
+ * Multi-buffer SHA-1 for the iterations after the first.
+ *
+ * Once the name has been hashed, every further iteration hashes the
+ * previous digest followed by the salt. When the digest, the salt and
+ * the SHA-1 padding fit in one 64-byte block, each iteration is a
+ * single compression of a block in which only the first five words
+ * change, so we can run several chains side by side in lanes. The
+ * lanes are plain arrays that the compiler can turn into SIMD
+ * registers.
+ */
+
+#define SHA1_LEN	 20
+#define SHA1_BLOCK	 64
+#define SHA1_MAXSALT	 (SHA1_BLOCK - SHA1_LEN - 9)
+#define HASH_BATCH_LANES ISC_ITERATED_HASH_BATCH
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static const uint32_t sha1_iv[5] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0,
+};
+
+static uint32_t
+load_be32(const unsigned char *p) {
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static void
+store_be32(unsigned char *p, uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/*
+ * One SHA-1 round in every lane. Rather than shifting the working
+ * variables along after each round, the caller rotates their names, so
+ * that a round only updates 'e' and 'b'; the lane loops have no
+ * branches, which lets the compiler vectorize them.
+ */
+#define SHA1_ROUND(t, F, K, a, b, c, d, e)                                 \
+	{                                                                  \
+		uint32_t *wt = w[(t) % 16];                                \
+		if ((t) >= 16) {                                           \
+			for (size_t l = 0; l < HASH_BATCH_LANES; l++) {    \
+				uint32_t x = w[((t) + 13) % 16][l] ^       \
+					     w[((t) + 8) % 16][l] ^        \
+					     w[((t) + 2) % 16][l] ^ wt[l]; \
+				wt[l] = ROL(x, 1);                         \
+			}                                                  \
+		}                                                          \
+		for (size_t l = 0; l < HASH_BATCH_LANES; l++) {            \
+			e[l] += ROL(a[l], 5) + F(b[l], c[l], d[l]) + K +   \
+				wt[l];                                     \
+			b[l] = ROL(b[l], 30);                              \
+		}                                                          \
+	}
+
+/*
+ * Twenty rounds in which the boolean function and the constant stay
+ * the same.
+ */
+#define SHA1_ROUNDS(first, F, K)                                  \
+	for (size_t t = first; t < first + 20; t += 5) {         \
+		SHA1_ROUND(t + 0, F, K, a, b, c, d, e);          \
+		SHA1_ROUND(t + 1, F, K, e, a, b, c, d);          \
+		SHA1_ROUND(t + 2, F, K, d, e, a, b, c);          \
+		SHA1_ROUND(t + 3, F, K, c, d, e, a, b);          \
+		SHA1_ROUND(t + 4, F, K, b, c, d, e, a);          \
+	}
+
+#define SHA1_CH(x, y, z)     (((x) & (y)) | (~(x) & (z)))
+#define SHA1_PARITY(x, y, z) ((x) ^ (y) ^ (z))
+#define SHA1_MAJ(x, y, z)    (((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+
+/*
+ * Compress one block per lane, starting from the IV. The message words
+ * 0-4 are the previous digest in each lane, and words 5-15 are the
+ * salt and padding shared by all lanes. The result replaces `h`.
+ */
+static void
+sha1_lanes(uint32_t h[5][HASH_BATCH_LANES], const uint32_t tail[16]) {
+	uint32_t w[16][HASH_BATCH_LANES];
+	uint32_t a[HASH_BATCH_LANES], b[HASH_BATCH_LANES];
+	uint32_t c[HASH_BATCH_LANES], d[HASH_BATCH_LANES];
+	uint32_t e[HASH_BATCH_LANES];
+
+	for (size_t i = 0; i < 16; i++) {
+		for (size_t l = 0; l < HASH_BATCH_LANES; l++) {
+			w[i][l] = i < 5 ? h[i][l] : tail[i];
+		}
+	}
+
+	for (size_t l = 0; l < HASH_BATCH_LANES; l++) {
+		a[l] = sha1_iv[0];
+		b[l] = sha1_iv[1];
+		c[l] = sha1_iv[2];
+		d[l] = sha1_iv[3];
+		e[l] = sha1_iv[4];
+	}
+
+	SHA1_ROUNDS(0, SHA1_CH, 0x5A827999);
+	SHA1_ROUNDS(20, SHA1_PARITY, 0x6ED9EBA1);
+	SHA1_ROUNDS(40, SHA1_MAJ, 0x8F1BBCDC);
+	SHA1_ROUNDS(60, SHA1_PARITY, 0xCA62C1D6);
+
+	for (size_t l = 0; l < HASH_BATCH_LANES; l++) {
+		h[0][l] = sha1_iv[0] + a[l];
+		h[1][l] = sha1_iv[1] + b[l];
+		h[2][l] = sha1_iv[2] + c[l];
+		h[3][l] = sha1_iv[3] + d[l];
+		h[4][l] = sha1_iv[4] + e[l];
+	}
+}
+
+int
+isc_iterated_hash_batch(unsigned char *out[], const unsigned int hashalg,
+			const int iterations, const unsigned char *salt,
+			const int saltlength, const unsigned char *in[],
+			const int inlength[], const unsigned int count) {
+	REQUIRE(out != NULL);
+	REQUIRE(in != NULL);
+	REQUIRE(inlength != NULL);
+
+	unsigned char block[SHA1_BLOCK] = { 0 };
+	uint32_t tail[16];
+	unsigned int batched = count - count % HASH_BATCH_LANES;
+	int len = 0;
+
+	if (hashalg != 1) {
+		return (0);
+	}
+
+	/*
+	 * Whatever does not fill a batch is hashed one chain at a time.
+	 */
+	if (iterations == 0 || saltlength > SHA1_MAXSALT) {
+		batched = 0;
+	}
+
+	for (unsigned int i = batched; i < count; i++) {
+		len = isc_iterated_hash(out[i], hashalg, iterations, salt,
+					saltlength, in[i], inlength[i]);
+		if (len == 0) {
+			return (0);
+		}
+	}
+
+	if (batched == 0) {
+		return (len);
+	}
+
+	/*
+	 * Lay out the constant part of the block: the salt, the end
+	 * marker, and the message length in bits.
+	 */
+	if (saltlength > 0) {
+		memmove(block + SHA1_LEN, salt, saltlength);
+	}
+	block[SHA1_LEN + saltlength] = 0x80;
+	store_be32(block + SHA1_BLOCK - 4, (SHA1_LEN + saltlength) * 8);
+	for (size_t i = 0; i < 16; i++) {
+		tail[i] = load_be32(block + i * 4);
+	}
+
+	for (unsigned int base = 0; base < batched; base += HASH_BATCH_LANES) {
+		uint32_t h[5][HASH_BATCH_LANES];
+
+		/*
+		 * The first iteration covers the name, which can be
+		 * any length, so leave it to the single-chain code.
+		 */
+		for (unsigned int l = 0; l < HASH_BATCH_LANES; l++) {
+			len = isc_iterated_hash(out[base + l], hashalg, 0, salt,
+						saltlength, in[base + l],
+						inlength[base + l]);
+			if (len != SHA1_LEN) {
+				return (0);
+			}
+			for (size_t i = 0; i < 5; i++) {
+				h[i][l] = load_be32(out[base + l] + i * 4);
+			}
+		}
+
+		for (int n = 0; n < iterations; n++) {
+			sha1_lanes(h, tail);
+		}
+
+		for (unsigned int l = 0; l < HASH_BATCH_LANES; l++) {
+			for (size_t i = 0; i < 5; i++) {
+				store_be32(out[base + l] + i * 4, h[i][l]);
+			}
+		}
+	}
+
+	return (SHA1_LEN);
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/lockprof.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#if ISC_LOCK_PROFILE
+
+/*
+ * The registry is protected by a plain pthread mutex rather than by an
+ * isc_mutex_t, which would itself be profiled, and the lock classes are
+ * allocated with malloc() so that they can be created before the memory
+ * contexts exist and outlive any module that registered them.
+ */
+static pthread_mutex_t sites_lock = PTHREAD_MUTEX_INITIALIZER;
+static isc_lockprof_t *sites = NULL;
+static unsigned int nsites = 0;
+
+atomic_bool isc__lockprof_enabled = false;
+
+static void
+update_max(atomic_uint_fast64_t *max, uint64_t value) {
+	uint_fast64_t old = atomic_load_relaxed(max);
+
+	while (value > old) {
+		if (atomic_compare_exchange_weak_relaxed(max, &old, value)) {
+			break;
+		}
+	}
+}
+
+isc_lockprof_t *
+isc__lockprof_site(const char *kind, const char *file, unsigned int line) {
+	isc_lockprof_t *prof = NULL;
+
+	RUNTIME_CHECK(pthread_mutex_lock(&sites_lock) == 0);
+	for (prof = sites; prof != NULL; prof = prof->next) {
+		if (prof->line == line && strcmp(prof->kind, kind) == 0 &&
+		    strcmp(prof->file, file) == 0)
+		{
+			break;
+		}
+	}
+	if (prof == NULL) {
+		prof = malloc(sizeof(*prof));
+		RUNTIME_CHECK(prof != NULL);
+		*prof = (isc_lockprof_t){
+			.kind = kind,
+			.file = strdup(file),
+			.line = line,
+			.next = sites,
+		};
+		RUNTIME_CHECK(prof->file != NULL);
+		sites = prof;
+		nsites++;
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&sites_lock) == 0);
+
+	return (prof);
+}
+
+void
+isc__lockprof_acquired(isc_lockprof_t *prof, bool contended, uint64_t wait) {
+	atomic_fetch_add_relaxed(&prof->locks, 1);
+	if (contended) {
+		atomic_fetch_add_relaxed(&prof->contended, 1);
+		atomic_fetch_add_relaxed(&prof->wait_ns, wait);
+		update_max(&prof->max_wait_ns, wait);
+	}
+}
+
+void
+isc__lockprof_released(isc_lockprof_t *prof, uint64_t hold) {
+	atomic_fetch_add_relaxed(&prof->hold_ns, hold);
+	update_max(&prof->max_hold_ns, hold);
+}
+
+isc_result_t
+isc_lockprof_enable(bool enable) {
+	atomic_store_relaxed(&isc__lockprof_enabled, enable);
+	return (ISC_R_SUCCESS);
+}
+
+bool
+isc_lockprof_enabled(void) {
+	return (atomic_load_relaxed(&isc__lockprof_enabled));
+}
+
+void
+isc_lockprof_reset(void) {
+	RUNTIME_CHECK(pthread_mutex_lock(&sites_lock) == 0);
+	for (isc_lockprof_t *prof = sites; prof != NULL; prof = prof->next) {
+		atomic_store_relaxed(&prof->locks, 0);
+		atomic_store_relaxed(&prof->contended, 0);
+		atomic_store_relaxed(&prof->wait_ns, 0);
+		atomic_store_relaxed(&prof->max_wait_ns, 0);
+		atomic_store_relaxed(&prof->hold_ns, 0);
+		atomic_store_relaxed(&prof->max_hold_ns, 0);
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&sites_lock) == 0);
+}
+
+typedef struct lockprof_row {
+	const isc_lockprof_t *prof;
+	uint64_t locks;
+	uint64_t contended;
+	uint64_t wait_ns;
+	uint64_t max_wait_ns;
+	uint64_t hold_ns;
+	uint64_t max_hold_ns;
+} lockprof_row_t;
+
+static int
+row_compare(const void *a, const void *b) {
+	const lockprof_row_t *ra = a, *rb = b;
+
+	if (ra->wait_ns != rb->wait_ns) {
+		return ((ra->wait_ns < rb->wait_ns) ? 1 : -1);
+	}
+	if (ra->locks != rb->locks) {
+		return ((ra->locks < rb->locks) ? 1 : -1);
+	}
+	return (0);
+}
+
+isc_result_t
+isc_lockprof_dump(isc_buffer_t **text) {
+	lockprof_row_t *rows = NULL;
+	unsigned int count = 0;
+	isc_result_t result;
+
+	REQUIRE(text != NULL && *text != NULL);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&sites_lock) == 0);
+	if (nsites > 0) {
+		rows = calloc(nsites, sizeof(rows[0]));
+		RUNTIME_CHECK(rows != NULL);
+	}
+	for (isc_lockprof_t *prof = sites; prof != NULL; prof = prof->next) {
+		uint64_t locks = atomic_load_relaxed(&prof->locks);
+
+		if (locks == 0) {
+			continue;
+		}
+		rows[count++] = (lockprof_row_t){
+			.prof = prof,
+			.locks = locks,
+			.contended = atomic_load_relaxed(&prof->contended),
+			.wait_ns = atomic_load_relaxed(&prof->wait_ns),
+			.max_wait_ns = atomic_load_relaxed(&prof->max_wait_ns),
+			.hold_ns = atomic_load_relaxed(&prof->hold_ns),
+			.max_hold_ns = atomic_load_relaxed(&prof->max_hold_ns),
+		};
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&sites_lock) == 0);
+
+	if (count > 0) {
+		qsort(rows, count, sizeof(rows[0]), row_compare);
+	}
+
+	result = isc_buffer_printf(*text,
+				   "lock profiling is %s\n"
+				   "%-6s %12s %12s %14s %12s %14s %12s  %s\n",
+				   isc_lockprof_enabled() ? "on" : "off",
+				   "kind", "locks", "contended", "wait-us",
+				   "max-wait-us", "hold-us", "max-hold-us",
+				   "site");
+	for (unsigned int i = 0; result == ISC_R_SUCCESS && i < count; i++) {
+		lockprof_row_t *row = &rows[i];
+
+		result = isc_buffer_printf(
+			*text,
+			"%-6s %12" PRIu64 " %12" PRIu64 " %14" PRIu64
+			" %12" PRIu64 " %14" PRIu64 " %12" PRIu64 "  %s:%u\n",
+			row->prof->kind, row->locks, row->contended,
+			row->wait_ns / 1000, row->max_wait_ns / 1000,
+			row->hold_ns / 1000, row->max_hold_ns / 1000,
+			row->prof->file, row->prof->line);
+	}
+
+	free(rows);
+	return (result);
+}
+
+#else /* ISC_LOCK_PROFILE */
+
+isc_result_t
+isc_lockprof_enable(bool enable) {
+	UNUSED(enable);
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+bool
+isc_lockprof_enabled(void) {
+	return (false);
+}
+
+void
+isc_lockprof_reset(void) {
+	/* nothing to do */
+}
+
+isc_result_t
+isc_lockprof_dump(isc_buffer_t **text) {
+	UNUSED(text);
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+#endif /* ISC_LOCK_PROFILE */
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/errno.h>
 #include <isc/file.h>
@@ -50,6 +51,25 @@ static thread_local bool forcelog = false;
  */
 #define LOG_BUFFER_SIZE (8 * 1024)
 
+/*
+ * A message with all of its prefixes (time, tag, category, module and
+ * level) must fit in this.
+ */
+#define LOG_LINE_SIZE (LOG_BUFFER_SIZE + 256)
+
+/*
+ * The size of each of the two buffers that hold the messages queued
+ * for the asynchronous channels.
+ */
+#define LOG_ASYNC_SIZE (1024 * 1024)
+
+/*
+ * The message and the full line are formatted into per-thread buffers,
+ * so only the output to a synchronous channel needs the context lock.
+ */
+static thread_local char log_buffer[LOG_BUFFER_SIZE];
+static thread_local char log_line[LOG_LINE_SIZE];
+
 /*
  * Private isc_log_t data type.
  */
@@ -72,9 +92,21 @@ struct isc_logchannel {
 	int level;
 	unsigned int flags;
 	isc_logdestination_t destination;
+	atomic_uint_fast32_t dropped; /* queued messages dropped (ASYNC) */
 	ISC_LINK(isc_logchannel_t) link;
 };
 
+/*!
+ * A message queued for an asynchronous channel.  Records are packed
+ * back to back into the fill buffer of the log context.
+ */
+typedef struct isc_logrecord {
+	isc_logchannel_t *channel;
+	int level;
+	size_t size; /* of the whole record, including padding */
+	char text[];
+} isc_logrecord_t;
+
 /*!
  * The logchannellist structure associates categories and modules with
  * channels.  First the appropriate channellist is found based on the
@@ -122,12 +154,14 @@ struct isc_logconfig {
 
 /*!
  * This isc_log structure provides the context for the isc_log functions.
- * The log context locks itself in isc_log_doit, the internal backend to
- * isc_log_write.  The locking is necessary both to provide exclusive access
- * to the buffer into which the message is formatted and to guard against
- * competing threads trying to write to the same syslog resource.
+ * The log context locks itself while writing to a channel, to guard
+ * against competing threads trying to write to the same file or syslog
+ * resource.
  *
- * FIXME: We can remove the locking by using per-thread .buffer.
+ * Messages for asynchronous channels are instead appended to the fill
+ * buffer under the short-lived async lock.  The helper thread swaps the
+ * fill and write buffers and then writes out the whole batch while
+ * holding the context lock once.
  */
 struct isc_log {
 	/* Not locked. */
@@ -137,10 +171,20 @@ struct isc_log {
 	/* RCU-protected pointer */
 	isc_logconfig_t *logconfig;
 	isc_mutex_t lock;
-	/* Locked by isc_log lock. */
-	char buffer[LOG_BUFFER_SIZE];
 	atomic_bool dynamic;
 	atomic_int_fast32_t highest_level;
+
+	/* Locked by async_lock. */
+	isc_mutex_t async_lock;
+	isc_condition_t async_ready; /* records were queued */
+	isc_condition_t async_done;  /* a batch was taken or written */
+	isc_thread_t async_thread;
+	bool async_running;
+	bool async_exiting;
+	bool async_writing;
+	char *async_fill;
+	char *async_write;
+	size_t async_used;
 };
 
 /*!
@@ -300,6 +344,12 @@ sync_highest_level(isc_logconfig_t *lcfg);
 static isc_result_t
 greatest_version(isc_logfile_t *file, int versions, int *greatest);
 
+static void
+log_async_start(void);
+
+static void
+log_async_flush(void);
+
 static void
 isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 	     const char *format, va_list args) ISC_FORMAT_PRINTF(4, 0);
@@ -412,6 +462,11 @@ isc_logconfig_destroy(isc_logconfig_t **lcfgp) {
 
 	mctx = lcfg->lctx->mctx;
 
+	/*
+	 * Write out any messages still queued for the channels.
+	 */
+	log_async_flush();
+
 	while ((channel = ISC_LIST_HEAD(lcfg->channels)) != NULL) {
 		ISC_LIST_UNLINK(lcfg->channels, channel, link);
 
@@ -478,7 +533,8 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	isc_logchannel_t *channel;
 	isc_mem_t *mctx;
 	unsigned int permitted = ISC_LOG_PRINTALL | ISC_LOG_DEBUGONLY |
-				 ISC_LOG_BUFFERED | ISC_LOG_ISO8601 |
+				 ISC_LOG_BUFFERED | ISC_LOG_ASYNC |
+				 ISC_LOG_ASYNCBLOCK | ISC_LOG_ISO8601 |
 				 ISC_LOG_UTC | ISC_LOG_TZINFO;
 
 	REQUIRE(VALID_CONFIG(lcfg));
@@ -501,8 +557,13 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	channel->type = type;
 	channel->level = level;
 	channel->flags = flags;
+	atomic_init(&channel->dropped, 0);
 	ISC_LINK_INIT(channel, link);
 
+	if ((flags & ISC_LOG_ASYNC) != 0) {
+		log_async_start();
+	}
+
 	switch (type) {
 	case ISC_LOG_TOSYSLOG:
 		FACILITY(channel) = destination->facility;
@@ -1254,24 +1315,272 @@ isc_log_wouldlog(int level) {
 	return (false);
 }
 
+/*
+ * Write the formatted 'line' to 'channel'.  The caller must hold the
+ * context lock.
+ */
+static void
+log_output(isc_logchannel_t *channel, int level, const char *line) {
+	int syslog_level;
+	struct stat statbuf;
+	isc_result_t result;
+
+	switch (channel->type) {
+	case ISC_LOG_TOFILE:
+		if (FILE_MAXREACHED(channel)) {
+			/*
+			 * If the file can be rolled, OR
+			 * If the file no longer exists, OR
+			 * If the file is less than the maximum size,
+			 * (such as if it had been renamed and a new one
+			 * touched, or it was truncated in place)
+			 * ... then close it to trigger reopening.
+			 */
+			if (FILE_VERSIONS(channel) != ISC_LOG_ROLLNEVER ||
+			    (stat(FILE_NAME(channel), &statbuf) != 0 &&
+			     errno == ENOENT) ||
+			    statbuf.st_size < FILE_MAXSIZE(channel))
+			{
+				if (FILE_STREAM(channel) != NULL) {
+					(void)fclose(FILE_STREAM(channel));
+					FILE_STREAM(channel) = NULL;
+				}
+				FILE_MAXREACHED(channel) = false;
+			} else {
+				/*
+				 * Eh, skip it.
+				 */
+				break;
+			}
+		}
+
+		if (FILE_STREAM(channel) == NULL) {
+			result = isc_log_open(channel);
+			if (result != ISC_R_SUCCESS && result != ISC_R_MAXSIZE &&
+			    (channel->flags & ISC_LOG_OPENERR) == 0)
+			{
+				syslog(LOG_ERR, "isc_log_open '%s' failed: %s",
+				       FILE_NAME(channel),
+				       isc_result_totext(result));
+				channel->flags |= ISC_LOG_OPENERR;
+			}
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			channel->flags &= ~ISC_LOG_OPENERR;
+		}
+		FALLTHROUGH;
+
+	case ISC_LOG_TOFILEDESC:
+		fprintf(FILE_STREAM(channel), "%s\n", line);
+
+		if ((channel->flags & ISC_LOG_BUFFERED) == 0) {
+			fflush(FILE_STREAM(channel));
+		}
+
+		/*
+		 * If the file now exceeds its maximum size threshold,
+		 * note it so that it will not be logged to any more.
+		 */
+		if (FILE_MAXSIZE(channel) > 0) {
+			INSIST(channel->type == ISC_LOG_TOFILE);
+
+			/* XXXDCL NT fstat/fileno */
+			/* XXXDCL complain if fstat fails? */
+			if (fstat(fileno(FILE_STREAM(channel)), &statbuf) >= 0 &&
+			    statbuf.st_size > FILE_MAXSIZE(channel))
+			{
+				FILE_MAXREACHED(channel) = true;
+			}
+		}
+
+		break;
+
+	case ISC_LOG_TOSYSLOG:
+		if (level > 0) {
+			syslog_level = LOG_DEBUG;
+		} else if (level < ISC_LOG_CRITICAL) {
+			syslog_level = LOG_CRIT;
+		} else {
+			syslog_level = syslog_map[-level];
+		}
+
+		(void)syslog(FACILITY(channel) | syslog_level, "%s", line);
+		break;
+
+	case ISC_LOG_TONULL:
+		break;
+	}
+}
+
+/*
+ * Queue the formatted 'line' for the asynchronous 'channel'.
+ */
+static void
+log_async(isc_logchannel_t *channel, int level, const char *line) {
+	size_t len = strlen(line) + 1;
+	size_t size = ISC_ALIGN(sizeof(isc_logrecord_t) + len,
+				sizeof(isc_logrecord_t *));
+	isc_logrecord_t *record = NULL;
+
+	LOCK(&isc__lctx->async_lock);
+	while (isc__lctx->async_used + size > LOG_ASYNC_SIZE) {
+		if ((channel->flags & ISC_LOG_ASYNCBLOCK) == 0 ||
+		    isc__lctx->async_exiting)
+		{
+			UNLOCK(&isc__lctx->async_lock);
+			atomic_fetch_add_relaxed(&channel->dropped, 1);
+			return;
+		}
+		WAIT(&isc__lctx->async_done, &isc__lctx->async_lock);
+	}
+
+	record = (isc_logrecord_t *)(isc__lctx->async_fill +
+				     isc__lctx->async_used);
+	*record = (isc_logrecord_t){
+		.channel = channel,
+		.level = level,
+		.size = size,
+	};
+	memmove(record->text, line, len);
+
+	if (isc__lctx->async_used == 0) {
+		SIGNAL(&isc__lctx->async_ready);
+	}
+	isc__lctx->async_used += size;
+	UNLOCK(&isc__lctx->async_lock);
+}
+
+/*
+ * Write out the 'used' octets of records in 'buf'.
+ */
+static void
+log_async_write(char *buf, size_t used) {
+	char note[64];
+
+	LOCK(&isc__lctx->lock);
+	for (size_t offset = 0; offset < used;) {
+		isc_logrecord_t *record = (isc_logrecord_t *)(buf + offset);
+		isc_logchannel_t *channel = record->channel;
+		uint_fast32_t dropped;
+
+		log_output(channel, record->level, record->text);
+
+		dropped = atomic_exchange_relaxed(&channel->dropped, 0);
+		if (dropped != 0) {
+			snprintf(note, sizeof(note),
+				 "%" PRIuFAST32 " log messages dropped",
+				 dropped);
+			log_output(channel, ISC_LOG_WARNING, note);
+		}
+
+		offset += record->size;
+	}
+	UNLOCK(&isc__lctx->lock);
+}
+
+static void *
+log_async_run(void *arg ISC_ATTR_UNUSED) {
+	LOCK(&isc__lctx->async_lock);
+	for (;;) {
+		char *buf = NULL;
+		size_t used;
+
+		while (isc__lctx->async_used == 0 && !isc__lctx->async_exiting)
+		{
+			WAIT(&isc__lctx->async_ready, &isc__lctx->async_lock);
+		}
+		if (isc__lctx->async_used == 0) {
+			break;
+		}
+
+		buf = isc__lctx->async_fill;
+		used = isc__lctx->async_used;
+		isc__lctx->async_fill = isc__lctx->async_write;
+		isc__lctx->async_write = buf;
+		isc__lctx->async_used = 0;
+		isc__lctx->async_writing = true;
+		BROADCAST(&isc__lctx->async_done);
+		UNLOCK(&isc__lctx->async_lock);
+
+		log_async_write(buf, used);
+
+		LOCK(&isc__lctx->async_lock);
+		isc__lctx->async_writing = false;
+		BROADCAST(&isc__lctx->async_done);
+	}
+	UNLOCK(&isc__lctx->async_lock);
+
+	return (NULL);
+}
+
+/*
+ * Start the helper thread, unless it is already running.
+ */
+static void
+log_async_start(void) {
+	LOCK(&isc__lctx->async_lock);
+	if (!isc__lctx->async_running) {
+		isc__lctx->async_fill = isc_mem_get(isc__lctx->mctx,
+						    LOG_ASYNC_SIZE);
+		isc__lctx->async_write = isc_mem_get(isc__lctx->mctx,
+						     LOG_ASYNC_SIZE);
+		isc_thread_create(log_async_run, NULL,
+				  &isc__lctx->async_thread);
+		isc_thread_setname(isc__lctx->async_thread, "isc-log");
+		isc__lctx->async_running = true;
+	}
+	UNLOCK(&isc__lctx->async_lock);
+}
+
+/*
+ * Wait until every queued message has been written out.
+ */
+static void
+log_async_flush(void) {
+	LOCK(&isc__lctx->async_lock);
+	while (isc__lctx->async_used != 0 || isc__lctx->async_writing) {
+		WAIT(&isc__lctx->async_done, &isc__lctx->async_lock);
+	}
+	UNLOCK(&isc__lctx->async_lock);
+}
+
+/*
+ * Write out the queued messages and stop the helper thread.
+ */
+static void
+log_async_stop(void) {
+	LOCK(&isc__lctx->async_lock);
+	if (!isc__lctx->async_running) {
+		UNLOCK(&isc__lctx->async_lock);
+		return;
+	}
+	isc__lctx->async_exiting = true;
+	SIGNAL(&isc__lctx->async_ready);
+	UNLOCK(&isc__lctx->async_lock);
+
+	isc_thread_join(isc__lctx->async_thread, NULL);
+
+	isc_mem_put(isc__lctx->mctx, isc__lctx->async_fill, LOG_ASYNC_SIZE);
+	isc_mem_put(isc__lctx->mctx, isc__lctx->async_write, LOG_ASYNC_SIZE);
+	isc__lctx->async_running = false;
+}
+
 static void
 isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 	     const char *format, va_list args) {
-	int syslog_level;
 	const char *time_string;
 	char local_time[64] = { 0 };
 	char iso8601z_string[64] = { 0 };
 	char iso8601l_string[64] = { 0 };
 	char iso8601tz_string[64] = { 0 };
 	char level_string[24] = { 0 };
-	struct stat statbuf;
 	bool matched = false;
 	bool printtime, iso8601, utc, tzinfo, printtag, printcolon;
-	bool printcategory, printmodule, printlevel, buffered;
+	bool printcategory, printmodule, printlevel;
 	isc_logchannel_t *channel;
 	isc_logchannellist_t *category_channels;
 	int_fast32_t dlevel;
-	isc_result_t result;
 
 	REQUIRE(isc__lctx == NULL || VALID_CONTEXT(isc__lctx));
 	REQUIRE(category > ISC_LOGCATEGORY_DEFAULT &&
@@ -1285,9 +1594,8 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 	}
 
 	rcu_read_lock();
-	LOCK(&isc__lctx->lock);
 
-	isc__lctx->buffer[0] = '\0';
+	log_buffer[0] = '\0';
 
 	isc_logconfig_t *lcfg = rcu_dereference(isc__lctx->logconfig);
 	if (lcfg == NULL) {
@@ -1391,9 +1699,8 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 		/*
 		 * Only format the message once.
 		 */
-		if (isc__lctx->buffer[0] == '\0') {
-			(void)vsnprintf(isc__lctx->buffer,
-					sizeof(isc__lctx->buffer), format,
+		if (log_buffer[0] == '\0') {
+			(void)vsnprintf(log_buffer, sizeof(log_buffer), format,
 					args);
 		}
 
@@ -1409,7 +1716,6 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 		printcategory = ((channel->flags & ISC_LOG_PRINTCATEGORY) != 0);
 		printmodule = ((channel->flags & ISC_LOG_PRINTMODULE) != 0);
 		printlevel = ((channel->flags & ISC_LOG_PRINTLEVEL) != 0);
-		buffered = ((channel->flags & ISC_LOG_BUFFERED) != 0);
 
 		if (printtime) {
 			if (iso8601) {
@@ -1427,127 +1733,26 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 			time_string = "";
 		}
 
-		switch (channel->type) {
-		case ISC_LOG_TOFILE:
-			if (FILE_MAXREACHED(channel)) {
-				/*
-				 * If the file can be rolled, OR
-				 * If the file no longer exists, OR
-				 * If the file is less than the maximum
-				 * size, (such as if it had been renamed
-				 * and a new one touched, or it was
-				 * truncated in place)
-				 * ... then close it to trigger
-				 * reopening.
-				 */
-				if (FILE_VERSIONS(channel) !=
-					    ISC_LOG_ROLLNEVER ||
-				    (stat(FILE_NAME(channel), &statbuf) != 0 &&
-				     errno == ENOENT) ||
-				    statbuf.st_size < FILE_MAXSIZE(channel))
-				{
-					if (FILE_STREAM(channel) != NULL) {
-						(void)fclose(
-							FILE_STREAM(channel));
-						FILE_STREAM(channel) = NULL;
-					}
-					FILE_MAXREACHED(channel) = false;
-				} else {
-					/*
-					 * Eh, skip it.
-					 */
-					break;
-				}
-			}
-
-			if (FILE_STREAM(channel) == NULL) {
-				result = isc_log_open(channel);
-				if (result != ISC_R_SUCCESS &&
-				    result != ISC_R_MAXSIZE &&
-				    (channel->flags & ISC_LOG_OPENERR) == 0)
-				{
-					syslog(LOG_ERR,
-					       "isc_log_open '%s' "
-					       "failed: %s",
-					       FILE_NAME(channel),
-					       isc_result_totext(result));
-					channel->flags |= ISC_LOG_OPENERR;
-				}
-				if (result != ISC_R_SUCCESS) {
-					break;
-				}
-				channel->flags &= ~ISC_LOG_OPENERR;
-			}
-			FALLTHROUGH;
-
-		case ISC_LOG_TOFILEDESC:
-			fprintf(FILE_STREAM(channel), "%s%s%s%s%s%s%s%s%s%s\n",
-				printtime ? time_string : "",
-				printtime ? " " : "", printtag ? lcfg->tag : "",
-				printcolon ? ": " : "",
-				printcategory ? categories_description[category]
-					      : "",
-				printcategory ? ": " : "",
-				printmodule ? modules_description[module] : "",
-				printmodule ? ": " : "",
-				printlevel ? level_string : "",
-				isc__lctx->buffer);
-
-			if (!buffered) {
-				fflush(FILE_STREAM(channel));
-			}
-
-			/*
-			 * If the file now exceeds its maximum size
-			 * threshold, note it so that it will not be
-			 * logged to any more.
-			 */
-			if (FILE_MAXSIZE(channel) > 0) {
-				INSIST(channel->type == ISC_LOG_TOFILE);
-
-				/* XXXDCL NT fstat/fileno */
-				/* XXXDCL complain if fstat fails? */
-				if (fstat(fileno(FILE_STREAM(channel)),
-					  &statbuf) >= 0 &&
-				    statbuf.st_size > FILE_MAXSIZE(channel))
-				{
-					FILE_MAXREACHED(channel) = true;
-				}
-			}
-
-			break;
-
-		case ISC_LOG_TOSYSLOG:
-			if (level > 0) {
-				syslog_level = LOG_DEBUG;
-			} else if (level < ISC_LOG_CRITICAL) {
-				syslog_level = LOG_CRIT;
-			} else {
-				syslog_level = syslog_map[-level];
-			}
-
-			(void)syslog(
-				FACILITY(channel) | syslog_level,
-				"%s%s%s%s%s%s%s%s%s%s",
-				printtime ? time_string : "",
-				printtime ? " " : "", printtag ? lcfg->tag : "",
-				printcolon ? ": " : "",
-				printcategory ? categories_description[category]
-					      : "",
-				printcategory ? ": " : "",
-				printmodule ? modules_description[module] : "",
-				printmodule ? ": " : "",
-				printlevel ? level_string : "",
-				isc__lctx->buffer);
-			break;
-
-		case ISC_LOG_TONULL:
-			break;
+		(void)snprintf(
+			log_line, sizeof(log_line), "%s%s%s%s%s%s%s%s%s%s",
+			printtime ? time_string : "", printtime ? " " : "",
+			printtag ? lcfg->tag : "", printcolon ? ": " : "",
+			printcategory ? categories_description[category] : "",
+			printcategory ? ": " : "",
+			printmodule ? modules_description[module] : "",
+			printmodule ? ": " : "", printlevel ? level_string : "",
+			log_buffer);
+
+		if ((channel->flags & ISC_LOG_ASYNC) != 0) {
+			log_async(channel, level, log_line);
+		} else {
+			LOCK(&isc__lctx->lock);
+			log_output(channel, level, log_line);
+			UNLOCK(&isc__lctx->lock);
 		}
 	} while (1);
 
 unlock:
-	UNLOCK(&isc__lctx->lock);
 	rcu_read_unlock();
 }
 
@@ -1570,6 +1775,9 @@ isc__log_initialize(void) {
 	};
 
 	isc_mutex_init(&isc__lctx->lock);
+	isc_mutex_init(&isc__lctx->async_lock);
+	isc_condition_init(&isc__lctx->async_ready);
+	isc_condition_init(&isc__lctx->async_done);
 
 	/* Create default logging configuration */
 	isc_logconfig_t *lcfg = NULL;
@@ -1592,10 +1800,15 @@ isc__log_shutdown(void) {
 	atomic_store_release(&isc__lctx->highest_level, 0);
 	atomic_store_release(&isc__lctx->dynamic, false);
 
+	log_async_stop();
+
 	if (isc__lctx->logconfig != NULL) {
 		isc_logconfig_destroy(&isc__lctx->logconfig);
 	}
 
+	isc_condition_destroy(&isc__lctx->async_done);
+	isc_condition_destroy(&isc__lctx->async_ready);
+	isc_mutex_destroy(&isc__lctx->async_lock);
 	isc_mutex_destroy(&isc__lctx->lock);
 
 	isc_mem_putanddetach(&mctx, isc__lctx, sizeof(*isc__lctx));
@@ -11,6 +11,15 @@
  * information regarding copyright ownership.
  */
 
+#if defined(HAVE_SCHED_GETAFFINITY)
+#include <sched.h>
+#endif /* if defined(HAVE_SCHED_GETAFFINITY) */
+
+#if defined(HAVE_CPUSET_GETAFFINITY)
+#include <sys/cpuset.h>
+#include <sys/param.h>
+#endif /* if defined(HAVE_CPUSET_GETAFFINITY) */
+
 #include <stdlib.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -26,6 +35,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
@@ -195,6 +205,8 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid,
 	};
 
 	__cds_wfcq_init(&loop->async_jobs.head, &loop->async_jobs.tail);
+	__cds_wfcq_init(&loop->async_background.head,
+			&loop->async_background.tail);
 	__cds_wfcq_init(&loop->setup_jobs.head, &loop->setup_jobs.tail);
 	__cds_wfcq_init(&loop->teardown_jobs.head, &loop->teardown_jobs.tail);
 
@@ -256,6 +268,8 @@ helper_close(isc_loop_t *loop) {
 	UV_RUNTIME_CHECK(uv_loop_close, r);
 
 	INSIST(cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail));
+	INSIST(cds_wfcq_empty(&loop->async_background.head,
+			      &loop->async_background.tail));
 
 	isc_mem_detach(&loop->mctx);
 }
@@ -266,6 +280,8 @@ loop_close(isc_loop_t *loop) {
 	UV_RUNTIME_CHECK(uv_loop_close, r);
 
 	INSIST(cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail));
+	INSIST(cds_wfcq_empty(&loop->async_background.head,
+			      &loop->async_background.tail));
 	INSIST(ISC_LIST_EMPTY(loop->run_jobs));
 
 	loop->magic = 0;
@@ -306,6 +322,11 @@ loop_thread(void *arg) {
 
 	isc__tid_init(loop->tid);
 
+	if (loop->tid == 0) {
+		/* The main thread wasn't created by isc_thread_create() */
+		loop->thread = pthread_self();
+	}
+
 	/* Start the helper thread */
 	isc_thread_create(helper_thread, helper, &helper->thread);
 	snprintf(name, sizeof(name), "isc-helper-%04" PRIu32, loop->tid);
@@ -345,7 +366,7 @@ loop_thread(void *arg) {
  * Public
  */
 
-static void
+static uint32_t
 threadpool_initialize(uint32_t workers) {
 	char buf[11];
 	int r = uv_os_getenv("UV_THREADPOOL_SIZE", buf,
@@ -353,7 +374,12 @@ threadpool_initialize(uint32_t workers) {
 	if (r == UV_ENOENT) {
 		snprintf(buf, sizeof(buf), "%" PRIu32, workers);
 		uv_os_setenv("UV_THREADPOOL_SIZE", buf);
+		return (workers);
 	}
+
+	/* Same limits as libuv applies to UV_THREADPOOL_SIZE */
+	workers = (uint32_t)strtoul(buf, NULL, 10);
+	return (ISC_MIN(ISC_MAX(workers, 1), 1024));
 }
 
 static void
@@ -368,6 +394,54 @@ ISC_REFCOUNT_TRACE_IMPL(isc_loop, loop_destroy)
 ISC_REFCOUNT_IMPL(isc_loop, loop_destroy);
 #endif
 
+/*
+ * Assign the loops to the CPUs the process is allowed to run on, in
+ * order; when there are more loops than CPUs, wrap around.  The
+ * mapping is only applied once isc_loopmgr_setaffinity() is called.
+ */
+static void
+loopmgr_cpumap(isc_loopmgr_t *loopmgr) {
+	int cpus[1024];
+	size_t ncpus = 0;
+
+#if defined(HAVE_CPUSET_GETAFFINITY)
+	cpuset_t set;
+	if (cpuset_getaffinity(CPU_LEVEL_WHICH, CPU_WHICH_PID, -1, sizeof(set),
+			       &set) != -1)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE && ncpus < ARRAY_SIZE(cpus);
+		     cpu++)
+		{
+			if (CPU_ISSET(cpu, &set)) {
+				cpus[ncpus++] = cpu;
+			}
+		}
+	}
+#elif defined(HAVE_SCHED_GETAFFINITY)
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) != -1) {
+		for (int cpu = 0; cpu < CPU_SETSIZE && ncpus < ARRAY_SIZE(cpus);
+		     cpu++)
+		{
+			if (CPU_ISSET(cpu, &set)) {
+				cpus[ncpus++] = cpu;
+			}
+		}
+	}
+#endif
+
+	if (ncpus == 0) {
+		ncpus = ISC_MIN((size_t)isc_os_ncpus(), ARRAY_SIZE(cpus));
+		for (size_t cpu = 0; cpu < ncpus; cpu++) {
+			cpus[cpu] = (int)cpu;
+		}
+	}
+
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		loopmgr->loops[i].cpu = cpus[i % ncpus];
+	}
+}
+
 void
 isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	isc_loopmgr_t *loopmgr = NULL;
@@ -375,13 +449,17 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	REQUIRE(loopmgrp != NULL && *loopmgrp == NULL);
 	REQUIRE(nloops > 0);
 
-	threadpool_initialize(nloops);
+	uint32_t nthreads = threadpool_initialize(nloops);
 	isc__tid_initcount(nloops);
 
 	loopmgr = isc_mem_get(mctx, sizeof(*loopmgr));
 	*loopmgr = (isc_loopmgr_t){
 		.nloops = nloops,
+		.work_pending = ISC_LIST_INITIALIZER,
+		.work_max = ISC_MAX(nthreads - 1, 1),
 	};
+	isc_mutex_init(&loopmgr->work_lock);
+	atomic_init(&loopmgr->budget, ISC_LOOP_BUDGET_DEFAULT);
 
 	isc_mem_attach(mctx, &loopmgr->mctx);
 
@@ -397,6 +475,7 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 		isc_loop_t *loop = &loopmgr->loops[i];
 		loop_init(loop, loopmgr, i, "loop");
 	}
+	loopmgr_cpumap(loopmgr);
 
 	loopmgr->helpers = isc_mem_cget(loopmgr->mctx, loopmgr->nloops,
 					sizeof(loopmgr->helpers[0]));
@@ -618,6 +697,10 @@ isc_loopmgr_destroy(isc_loopmgr_t **loopmgrp) {
 	isc_barrier_destroy(&loopmgr->resuming);
 	isc_barrier_destroy(&loopmgr->pausing);
 
+	INSIST(ISC_LIST_EMPTY(loopmgr->work_pending));
+	INSIST(loopmgr->work_running == 0);
+	isc_mutex_destroy(&loopmgr->work_lock);
+
 	isc_mem_putanddetach(&loopmgr->mctx, loopmgr, sizeof(*loopmgr));
 }
 
@@ -666,6 +749,40 @@ isc_loopmgr_nonblocking(isc_loopmgr_t *loopmgr) {
 	isc_signal_start(loopmgr->sigterm);
 }
 
+isc_result_t
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+	REQUIRE(atomic_load(&loopmgr->running));
+	REQUIRE(isc_tid() == 0);
+
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		isc_loop_t *loop = &loopmgr->loops[i];
+		isc_result_t result = isc_thread_setaffinity(loop->thread,
+							     loop->cpu);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	atomic_store(&loopmgr->affinity, true);
+
+	return (ISC_R_SUCCESS);
+}
+
+bool
+isc_loopmgr_getaffinity(isc_loopmgr_t *loopmgr) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+
+	return (atomic_load(&loopmgr->affinity));
+}
+
+int
+isc_loop_getcpu(isc_loop_t *loop) {
+	REQUIRE(VALID_LOOP(loop));
+
+	return (loop->cpu);
+}
+
 isc_loopmgr_t *
 isc_loop_getloopmgr(isc_loop_t *loop) {
 	REQUIRE(VALID_LOOP(loop));
@@ -693,3 +810,24 @@ isc_loop_shuttingdown(isc_loop_t *loop) {
 
 	return (loop->shuttingdown);
 }
+
+void
+isc_loopmgr_setbudget(isc_loopmgr_t *loopmgr, uint32_t budget) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+
+	atomic_store_relaxed(&loopmgr->budget, budget);
+}
+
+bool
+isc_loop_shouldyield(void) {
+	isc_loop_t *loop = isc_loop();
+
+	REQUIRE(VALID_LOOP(loop));
+
+	uint32_t budget = atomic_load_relaxed(&loop->loopmgr->budget);
+	if (budget == 0) {
+		return (false);
+	}
+
+	return (uv_hrtime() / NS_PER_MS >= uv_now(&loop->loop) + budget);
+}
@@ -18,9 +18,11 @@
 #include <isc/barrier.h>
 #include <isc/job.h>
 #include <isc/lang.h>
+#include <isc/list.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
@@ -49,6 +51,9 @@ struct isc_loop {
 	uv_loop_t loop;
 	uint32_t tid;
 
+	/* CPU assigned by isc_loopmgr_create() */
+	int cpu;
+
 	isc_mem_t *mctx;
 
 	/* states */
@@ -58,6 +63,8 @@ struct isc_loop {
 	/* Async queue */
 	uv_async_t async_trigger;
 	isc_jobqueue_t async_jobs;
+	atomic_bool async_draining;
+	isc_jobqueue_t async_background;
 
 	/* Jobs queue */
 	uv_idle_t run_trigger;
@@ -93,6 +100,10 @@ struct isc_loopmgr {
 	atomic_bool shuttingdown;
 	atomic_bool running;
 	atomic_bool paused;
+	atomic_bool affinity;
+
+	/* see isc_loop_shouldyield() */
+	atomic_uint_fast32_t budget;
 
 	/* signal handling */
 	isc_signal_t *sigint;
@@ -111,6 +122,12 @@ struct isc_loopmgr {
 	/* per-thread objects */
 	isc_loop_t *loops;
 	isc_loop_t *helpers;
+
+	/* bulk work throttling, see isc_work_enqueue_bulk() */
+	isc_mutex_t work_lock;
+	ISC_LIST(isc_work_t) work_pending;
+	uint_fast32_t work_running;
+	uint_fast32_t work_max;
 };
 
 /*
@@ -143,6 +160,8 @@ struct isc_work {
 	isc_work_cb work_cb;
 	isc_after_work_cb after_work_cb;
 	void *cbarg;
+	bool bulk;
+	ISC_LINK(isc_work_t) link;
 };
 
 #define DEFAULT_LOOP(loopmgr) (&(loopmgr)->loops[0])
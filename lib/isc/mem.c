@@ -19,6 +19,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include <isc/hash.h>
 #include <isc/magic.h>
@@ -121,11 +122,13 @@ struct isc_mem {
 	unsigned int flags;
 	unsigned int jemalloc_flags;
 	unsigned int jemalloc_arena;
+	bool hugepages;
 	unsigned int debugging;
 	isc_mutex_t lock;
 	bool checkfree;
 	isc_refcount_t references;
-	char name[16];
+	isc_mem_t *parent;
+	char name[64];
 	atomic_size_t inuse;
 	atomic_bool hi_called;
 	atomic_bool is_overmem;
@@ -156,12 +159,22 @@ struct isc_mempool {
 	size_t freecount;	      /*%< # of items on reserved list */
 	size_t freemax;		      /*%< # of items allowed on free list */
 	size_t fillcount;	      /*%< # of items to fetch on each fill */
-	/*%< Stats only. */
-	size_t gets; /*%< # of requests to this pool */
+	/*%<
+	 * Stats only.  The pool is only ever used by a single thread, but
+	 * the statistics can be read from any thread, so they are atomic
+	 * with a single writer and updated without read-modify-write.
+	 */
+	atomic_size_t gets;   /*%< # of requests to this pool */
+	atomic_size_t misses; /*%< # of requests that had to fill */
+	atomic_size_t drains; /*%< # of items returned to the mctx */
 	/*%< Debugging only. */
 	char name[16]; /*%< printed name in stats reports */
 };
 
+#define POOLSTAT_INC(mpctx, counter)         \
+	atomic_store_relaxed(&(mpctx)->counter, \
+			     atomic_load_relaxed(&(mpctx)->counter) + 1)
+
 /*
  * Private Inline-able.
  */
@@ -355,7 +368,9 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
  */
 static void
 mem_getstats(isc_mem_t *ctx, size_t size) {
-	atomic_fetch_add_relaxed(&ctx->inuse, size);
+	for (; ctx != NULL; ctx = ctx->parent) {
+		atomic_fetch_add_relaxed(&ctx->inuse, size);
+	}
 }
 
 /*!
@@ -363,8 +378,10 @@ mem_getstats(isc_mem_t *ctx, size_t size) {
  */
 static void
 mem_putstats(isc_mem_t *ctx, size_t size) {
-	atomic_size_t s = atomic_fetch_sub_relaxed(&ctx->inuse, size);
-	INSIST(s >= size);
+	for (; ctx != NULL; ctx = ctx->parent) {
+		atomic_size_t s = atomic_fetch_sub_relaxed(&ctx->inuse, size);
+		INSIST(s >= size);
+	}
 }
 
 /*
@@ -413,6 +430,135 @@ mem_jemalloc_arena_destroy(unsigned int arenano) {
 #endif /* JEMALLOC_API_SUPPORTED */
 }
 
+#if defined(JEMALLOC_API_SUPPORTED) && defined(MADV_HUGEPAGE)
+#define MEM_HUGEPAGES 1
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/*
+ * Bytes currently mapped by arenas that are backed by huge pages.
+ */
+static atomic_size_t hugepages_mapped = 0;
+
+/*
+ * jemalloc extent hooks for arenas backed by transparent huge pages.
+ * jemalloc grows its arenas in multiples of the huge page size, so we
+ * align each mapping to a huge page boundary and advise the kernel to
+ * back it with huge pages. If that advice is refused (for example,
+ * because transparent huge pages are disabled) the memory is still
+ * usable, just with ordinary pages.
+ *
+ * The purge hooks are left out, so memory that is freed is reused
+ * within the arena but not returned to the system, which would split
+ * the huge pages. It is all released when the arena is destroyed.
+ */
+static void *
+hugepage_alloc(extent_hooks_t *hooks ISC_ATTR_UNUSED, void *new_addr,
+	       size_t size, size_t alignment, bool *zero, bool *commit,
+	       unsigned int arena_ind ISC_ATTR_UNUSED) {
+	size_t align = ISC_MAX(alignment, HUGEPAGE_SIZE);
+	size_t mapsize = size + align;
+	char *map = NULL, *ptr = NULL;
+
+	if (new_addr != NULL || mapsize < size) {
+		return (NULL);
+	}
+
+	map = mmap(NULL, mapsize, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return (NULL);
+	}
+
+	ptr = (char *)(((uintptr_t)map + align - 1) & ~(uintptr_t)(align - 1));
+	if (ptr > map) {
+		(void)munmap(map, ptr - map);
+	}
+	if (ptr + size < map + mapsize) {
+		(void)munmap(ptr + size, map + mapsize - (ptr + size));
+	}
+
+	(void)madvise(ptr, size, MADV_HUGEPAGE);
+	atomic_fetch_add_relaxed(&hugepages_mapped, size);
+
+	*zero = true;
+	*commit = true;
+	return (ptr);
+}
+
+static bool
+hugepage_dalloc(extent_hooks_t *hooks ISC_ATTR_UNUSED, void *addr, size_t size,
+		bool committed ISC_ATTR_UNUSED,
+		unsigned int arena_ind ISC_ATTR_UNUSED) {
+	if (munmap(addr, size) != 0) {
+		return (true);
+	}
+	atomic_fetch_sub_relaxed(&hugepages_mapped, size);
+	return (false);
+}
+
+static void
+hugepage_destroy(extent_hooks_t *hooks, void *addr, size_t size,
+		 bool committed, unsigned int arena_ind) {
+	(void)hugepage_dalloc(hooks, addr, size, committed, arena_ind);
+}
+
+/*
+ * Our extents are all plain anonymous mappings, so they can be split
+ * and merged without doing anything.
+ */
+static bool
+hugepage_split(extent_hooks_t *hooks ISC_ATTR_UNUSED,
+	       void *addr ISC_ATTR_UNUSED, size_t size ISC_ATTR_UNUSED,
+	       size_t size_a ISC_ATTR_UNUSED, size_t size_b ISC_ATTR_UNUSED,
+	       bool committed ISC_ATTR_UNUSED,
+	       unsigned int arena_ind ISC_ATTR_UNUSED) {
+	return (false);
+}
+
+static bool
+hugepage_merge(extent_hooks_t *hooks ISC_ATTR_UNUSED,
+	       void *addr_a ISC_ATTR_UNUSED, size_t size_a ISC_ATTR_UNUSED,
+	       void *addr_b ISC_ATTR_UNUSED, size_t size_b ISC_ATTR_UNUSED,
+	       bool committed ISC_ATTR_UNUSED,
+	       unsigned int arena_ind ISC_ATTR_UNUSED) {
+	return (false);
+}
+
+static extent_hooks_t hugepage_hooks = {
+	.alloc = hugepage_alloc,
+	.dalloc = hugepage_dalloc,
+	.destroy = hugepage_destroy,
+	.split = hugepage_split,
+	.merge = hugepage_merge,
+};
+
+static bool
+mem_jemalloc_hugepage_arena_create(unsigned int *pnew_arenano) {
+	extent_hooks_t *hooks = &hugepage_hooks;
+	unsigned int arenano = 0;
+	size_t len = sizeof(arenano);
+	int res;
+
+	res = mallctl("arenas.create", &arenano, &len, &hooks, sizeof(hooks));
+	if (res != 0) {
+		return (false);
+	}
+
+	*pnew_arenano = arenano;
+	return (true);
+}
+#endif /* defined(JEMALLOC_API_SUPPORTED) && defined(MADV_HUGEPAGE) */
+
+size_t
+isc_mem_hugepages(void) {
+#ifdef MEM_HUGEPAGES
+	return (atomic_load_relaxed(&hugepages_mapped));
+#else
+	return (0);
+#endif
+}
+
 static void
 mem_initialize(void) {
 /*
@@ -510,6 +656,8 @@ mem_create(isc_mem_t **ctxp, unsigned int debugging, unsigned int flags,
 static void
 destroy(isc_mem_t *ctx) {
 	unsigned int arena_no;
+	isc_mem_t *parent = ctx->parent;
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	UNLOCK(&contextslock);
@@ -554,6 +702,11 @@ destroy(isc_mem_t *ctx) {
 	if (arena_no != ISC_MEM_ILLEGAL_ARENA) {
 		RUNTIME_CHECK(mem_jemalloc_arena_destroy(arena_no) == true);
 	}
+
+	/* The parent's arena must outlive the child */
+	if (parent != NULL) {
+		isc_mem_detach(&parent);
+	}
 }
 
 void
@@ -707,6 +860,14 @@ print_active(isc_mem_t *mctx, FILE *out) {
 }
 #endif /* if ISC_MEM_TRACKLINES */
 
+static double
+poolhitrate(size_t gets, size_t misses) {
+	if (gets == 0) {
+		return (0.0);
+	}
+	return (100.0 * (double)(gets - misses) / (double)gets);
+}
+
 /*
  * Print the stats[] on the stream "out" with suitable formatting.
  */
@@ -728,16 +889,22 @@ isc_mem_stats(isc_mem_t *ctx, FILE *out) {
 	pool = ISC_LIST_HEAD(ctx->pools);
 	if (pool != NULL) {
 		fprintf(out, "[Pool statistics]\n");
-		fprintf(out, "%15s %10s %10s %10s %10s %10s %10s %1s\n", "name",
-			"size", "allocated", "freecount", "freemax",
-			"fillcount", "gets", "L");
+		fprintf(out,
+			"%15s %10s %10s %10s %10s %10s %10s %10s %10s %7s\n",
+			"name", "size", "allocated", "freecount", "freemax",
+			"fillcount", "gets", "misses", "drains", "hit%");
 	}
 	while (pool != NULL) {
+		size_t gets = atomic_load_relaxed(&pool->gets);
+		size_t misses = atomic_load_relaxed(&pool->misses);
+
 		fprintf(out,
-			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %s\n",
-			pool->name, pool->size, (size_t)0, pool->allocated,
-			pool->freecount, pool->freemax, pool->fillcount,
-			pool->gets, "N");
+			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %10zu "
+			"%6.2f%%\n",
+			pool->name, pool->size, pool->allocated,
+			pool->freecount, pool->freemax, pool->fillcount, gets,
+			misses, atomic_load_relaxed(&pool->drains),
+			poolhitrate(gets, misses));
 		pool = ISC_LIST_NEXT(pool, link);
 	}
 
@@ -1118,6 +1285,7 @@ isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 		/*
 		 * We need to dip into the well.  Fill up our free list.
 		 */
+		POOLSTAT_INC(mpctx, misses);
 		for (size_t i = 0; i < fillcount; i++) {
 			item = mem_get(mctx, mpctx->size, 0);
 			mem_getstats(mctx, mpctx->size);
@@ -1134,7 +1302,7 @@ isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 
 	INSIST(mpctx->freecount > 0);
 	mpctx->freecount--;
-	mpctx->gets++;
+	POOLSTAT_INC(mpctx, gets);
 
 	ADD_TRACE(mpctx->mctx, item, mpctx->size, file, line);
 
@@ -1166,6 +1334,7 @@ isc__mempool_put(isc_mempool_t *restrict mpctx, void *mem FLARG) {
 	 * If our free list is full, return this to the mctx directly.
 	 */
 	if (freecount >= freemax) {
+		POOLSTAT_INC(mpctx, drains);
 		mem_putstats(mctx, mpctx->size);
 		mem_put(mctx, mem, mpctx->size, 0);
 		return;
@@ -1228,6 +1397,20 @@ isc_mempool_getfillcount(isc_mempool_t *restrict mpctx) {
 	return (mpctx->fillcount);
 }
 
+size_t
+isc_mempool_getgets(isc_mempool_t *restrict mpctx) {
+	REQUIRE(VALID_MEMPOOL(mpctx));
+
+	return (atomic_load_relaxed(&mpctx->gets));
+}
+
+size_t
+isc_mempool_getmisses(isc_mempool_t *restrict mpctx) {
+	REQUIRE(VALID_MEMPOOL(mpctx));
+
+	return (atomic_load_relaxed(&mpctx->misses));
+}
+
 /*
  * Requires contextslock to be held by caller.
  */
@@ -1307,13 +1490,26 @@ xml_renderctx(isc_mem_t *ctx, size_t *inuse, xmlTextWriterPtr writer) {
 		TRY0(xmlTextWriterEndElement(writer)); /* name */
 	}
 
+	if (ctx->parent != NULL) {
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "parent"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%p", ctx->parent));
+		TRY0(xmlTextWriterEndElement(writer)); /* parent */
+	}
+
+	if (ctx->hugepages) {
+		TRY0(xmlTextWriterWriteElement(writer, ISC_XMLCHAR "hugepages",
+					       ISC_XMLCHAR "yes"));
+	}
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "references"));
 	TRY0(xmlTextWriterWriteFormatString(
 		writer, "%" PRIuFAST32,
 		isc_refcount_current(&ctx->references)));
 	TRY0(xmlTextWriterEndElement(writer)); /* references */
 
-	*inuse += isc_mem_inuse(ctx);
+	if (ctx->parent == NULL) {
+		*inuse += isc_mem_inuse(ctx);
+	}
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "inuse"));
 	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "",
 					    (uint64_t)isc_mem_inuse(ctx)));
@@ -1328,6 +1524,30 @@ xml_renderctx(isc_mem_t *ctx, size_t *inuse, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterWriteFormatString(writer, "%u", ctx->poolcnt));
 	TRY0(xmlTextWriterEndElement(writer)); /* pools */
 
+	for (isc_mempool_t *pool = ISC_LIST_HEAD(ctx->pools); pool != NULL;
+	     pool = ISC_LIST_NEXT(pool, link))
+	{
+		size_t gets = atomic_load_relaxed(&pool->gets);
+		size_t misses = atomic_load_relaxed(&pool->misses);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "pool"));
+		TRY0(xmlTextWriterWriteElement(writer, ISC_XMLCHAR "name",
+					       ISC_XMLCHAR pool->name));
+		TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "size",
+						     "%zu", pool->size));
+		TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "gets",
+						     "%zu", gets));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "misses", "%zu", misses));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "drains", "%zu",
+			atomic_load_relaxed(&pool->drains)));
+		TRY0(xmlTextWriterWriteFormatElement(
+			writer, ISC_XMLCHAR "hitrate", "%.2f",
+			poolhitrate(gets, misses)));
+		TRY0(xmlTextWriterEndElement(writer)); /* pool */
+	}
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "hiwater"));
 	TRY0(xmlTextWriterWriteFormatString(
 		writer, "%" PRIu64 "",
@@ -1383,6 +1603,11 @@ isc_mem_renderxml(void *writer0) {
 					    (uint64_t)inuse));
 	TRY0(xmlTextWriterEndElement(writer)); /* InUse */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "HugePages"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "",
+					    (uint64_t)isc_mem_hugepages()));
+	TRY0(xmlTextWriterEndElement(writer)); /* HugePages */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* summary */
 error:
 	return (xmlrc);
@@ -1403,7 +1628,10 @@ json_renderctx(isc_mem_t *ctx, size_t *inuse, json_object *array) {
 
 	MCTXLOCK(ctx);
 
-	*inuse += isc_mem_inuse(ctx);
+	/* Children are already accounted for in their parents */
+	if (ctx->parent == NULL) {
+		*inuse += isc_mem_inuse(ctx);
+	}
 
 	ctxobj = json_object_new_object();
 	CHECKMEM(ctxobj);
@@ -1419,6 +1647,19 @@ json_renderctx(isc_mem_t *ctx, size_t *inuse, json_object *array) {
 		json_object_object_add(ctxobj, "name", obj);
 	}
 
+	if (ctx->parent != NULL) {
+		snprintf(buf, sizeof(buf), "%p", ctx->parent);
+		obj = json_object_new_string(buf);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "parent", obj);
+	}
+
+	if (ctx->hugepages) {
+		obj = json_object_new_boolean(true);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "hugepages", obj);
+	}
+
 	obj = json_object_new_int64(isc_refcount_current(&ctx->references));
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "references", obj);
@@ -1435,6 +1676,48 @@ json_renderctx(isc_mem_t *ctx, size_t *inuse, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "pools", obj);
 
+	if (!ISC_LIST_EMPTY(ctx->pools)) {
+		json_object *poolarray = json_object_new_array();
+		CHECKMEM(poolarray);
+		json_object_object_add(ctxobj, "poolstats", poolarray);
+
+		for (isc_mempool_t *pool = ISC_LIST_HEAD(ctx->pools);
+		     pool != NULL; pool = ISC_LIST_NEXT(pool, link))
+		{
+			size_t gets = atomic_load_relaxed(&pool->gets);
+			size_t misses = atomic_load_relaxed(&pool->misses);
+			json_object *poolobj = json_object_new_object();
+			CHECKMEM(poolobj);
+			json_object_array_add(poolarray, poolobj);
+
+			obj = json_object_new_string(pool->name);
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "name", obj);
+
+			obj = json_object_new_int64(pool->size);
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "size", obj);
+
+			obj = json_object_new_int64(gets);
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "gets", obj);
+
+			obj = json_object_new_int64(misses);
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "misses", obj);
+
+			obj = json_object_new_int64(
+				atomic_load_relaxed(&pool->drains));
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "drains", obj);
+
+			obj = json_object_new_double(
+				poolhitrate(gets, misses));
+			CHECKMEM(obj);
+			json_object_object_add(poolobj, "hitrate", obj);
+		}
+	}
+
 	obj = json_object_new_int64(atomic_load_relaxed(&ctx->hi_water));
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "hiwater", obj);
@@ -1479,6 +1762,10 @@ isc_mem_renderjson(void *memobj0) {
 	CHECKMEM(obj);
 	json_object_object_add(memobj, "Malloced", obj);
 
+	obj = json_object_new_int64(isc_mem_hugepages());
+	CHECKMEM(obj);
+	json_object_object_add(memobj, "HugePages", obj);
+
 	json_object_object_add(memobj, "contexts", ctxarray);
 	return (ISC_R_SUCCESS);
 
@@ -1529,6 +1816,47 @@ isc__mem_create_arena(isc_mem_t **mctxp FLARG) {
 #endif /* ISC_MEM_TRACKLINES */
 }
 
+void
+isc__mem_createchild(isc_mem_t *parent, isc_mem_t **mctxp FLARG) {
+	REQUIRE(VALID_CONTEXT(parent));
+
+	mem_create(mctxp, parent->debugging, parent->flags,
+		   parent->jemalloc_flags);
+	(*mctxp)->hugepages = parent->hugepages;
+	isc_mem_attach(parent, &(*mctxp)->parent);
+#if ISC_MEM_TRACKLINES
+	if ((isc_mem_debugging & ISC_MEM_DEBUGTRACE) != 0) {
+		fprintf(stderr, "create mctx %p file %s line %u child of %p\n",
+			*mctxp, file, line, parent);
+	}
+#endif /* ISC_MEM_TRACKLINES */
+}
+
+void
+isc__mem_create_hugepages(isc_mem_t **mctxp FLARG) {
+#ifdef MEM_HUGEPAGES
+	unsigned int arena_no = ISC_MEM_ILLEGAL_ARENA;
+
+	if (mem_jemalloc_hugepage_arena_create(&arena_no)) {
+		mem_create(mctxp, isc_mem_debugging, isc_mem_defaultflags,
+			   MALLOCX_ARENA(arena_no) | MALLOCX_TCACHE_NONE);
+		(*mctxp)->jemalloc_arena = arena_no;
+		(*mctxp)->hugepages = true;
+#if ISC_MEM_TRACKLINES
+		if ((isc_mem_debugging & ISC_MEM_DEBUGTRACE) != 0) {
+			fprintf(stderr,
+				"create mctx %p file %s line %u for huge page "
+				"jemalloc arena %u\n",
+				*mctxp, file, line, arena_no);
+		}
+#endif /* ISC_MEM_TRACKLINES */
+		return;
+	}
+#endif /* MEM_HUGEPAGES */
+
+	isc__mem_create_arena(mctxp FLARG_PASS);
+}
+
 #ifdef JEMALLOC_API_SUPPORTED
 static bool
 jemalloc_set_ssize_value(const char *valname, ssize_t newval) {
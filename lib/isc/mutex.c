@@ -23,6 +23,7 @@
 #include <isc/once.h>
 #include <isc/strerr.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include "mutex_p.h"
@@ -52,3 +53,60 @@ void
 isc__mutex_shutdown(void) {
 	/* noop */;
 }
+
+#if ISC_LOCK_PROFILE
+
+void
+isc__mutex_profinit(isc_mutex_t *mp, isc_lockprof_t *prof) {
+	isc__mutex_init(&mp->mutex);
+	mp->prof = prof;
+	mp->acquired = 0;
+}
+
+void
+isc__mutex_proflock(isc_mutex_t *mp) {
+	if (!isc__lockprof_active()) {
+		isc__mutex_lock(&mp->mutex);
+		mp->acquired = 0;
+		return;
+	}
+
+	if (pthread_mutex_trylock(&mp->mutex) == 0) {
+		mp->acquired = isc_time_monotonic();
+		isc__lockprof_acquired(mp->prof, false, 0);
+	} else {
+		isc_nanosecs_t start = isc_time_monotonic();
+		isc__mutex_lock(&mp->mutex);
+		mp->acquired = isc_time_monotonic();
+		isc__lockprof_acquired(mp->prof, true, mp->acquired - start);
+	}
+}
+
+isc_result_t
+isc__mutex_proftrylock(isc_mutex_t *mp) {
+	if (pthread_mutex_trylock(&mp->mutex) != 0) {
+		return (ISC_R_LOCKBUSY);
+	}
+
+	if (isc__lockprof_active()) {
+		mp->acquired = isc_time_monotonic();
+		isc__lockprof_acquired(mp->prof, false, 0);
+	} else {
+		mp->acquired = 0;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc__mutex_profunlock(isc_mutex_t *mp) {
+	uint64_t acquired = mp->acquired;
+
+	/* Locks taken while profiling was off are not accounted for */
+	if (acquired != 0) {
+		isc__lockprof_released(mp->prof,
+				       isc_time_monotonic() - acquired);
+	}
+	isc__mutex_unlock(&mp->mutex);
+}
+
+#endif /* ISC_LOCK_PROFILE */
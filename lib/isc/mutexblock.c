@@ -16,6 +16,17 @@
 #include <isc/mutexblock.h>
 #include <isc/util.h>
 
+#if ISC_LOCK_PROFILE
+void
+isc__mutexblock_profinit(isc_mutex_t *block, unsigned int count,
+			 isc_lockprof_t *prof) {
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		isc__mutex_profinit(&block[i], prof);
+	}
+}
+#else  /* ISC_LOCK_PROFILE */
 void
 isc_mutexblock_init(isc_mutex_t *block, unsigned int count) {
 	unsigned int i;
@@ -24,6 +35,7 @@ isc_mutexblock_init(isc_mutex_t *block, unsigned int count) {
 		isc_mutex_init(&block[i]);
 	}
 }
+#endif /* ISC_LOCK_PROFILE */
 
 void
 isc_mutexblock_destroy(isc_mutex_t *block, unsigned int count) {
@@ -866,6 +866,28 @@ send_client_connection_header(isc_nm_http_session_t *session) {
 	{ (uint8_t *)(uintptr_t)(NAME), (uint8_t *)(uintptr_t)(VALUE), \
 	  sizeof(NAME) - 1, sizeof(VALUE) - 1, NGHTTP2_NV_FLAG_NONE }
 
+/*
+ * Headers built from string literals do not need to be copied (and, for
+ * the names, lowercased) by nghttp2 for every response.  The names must
+ * therefore already be in lowercase.
+ */
+#if NGHTTP2_VERSION_NUM >= 0x011100
+#define NV_FLAG_NO_COPY_NAME  NGHTTP2_NV_FLAG_NO_COPY_NAME
+#define NV_FLAG_NO_COPY_VALUE NGHTTP2_NV_FLAG_NO_COPY_VALUE
+#else /* NGHTTP2_VERSION_NUM >= 0x011100 */
+#define NV_FLAG_NO_COPY_NAME  NGHTTP2_NV_FLAG_NONE
+#define NV_FLAG_NO_COPY_VALUE NGHTTP2_NV_FLAG_NONE
+#endif /* NGHTTP2_VERSION_NUM >= 0x011100 */
+
+#define MAKE_NV_CONST(NAME, VALUE)                                     \
+	{ (uint8_t *)(uintptr_t)(NAME), (uint8_t *)(uintptr_t)(VALUE), \
+	  sizeof(NAME) - 1, sizeof(VALUE) - 1,                         \
+	  NV_FLAG_NO_COPY_NAME | NV_FLAG_NO_COPY_VALUE }
+
+#define MAKE_NV_CONST_NAME(NAME, VALUE, VALUELEN)                      \
+	{ (uint8_t *)(uintptr_t)(NAME), (uint8_t *)(uintptr_t)(VALUE), \
+	  sizeof(NAME) - 1, VALUELEN, NV_FLAG_NO_COPY_NAME }
+
 static ssize_t
 client_read_callback(nghttp2_session *ngsession, int32_t stream_id,
 		     uint8_t *buf, size_t length, uint32_t *data_flags,
@@ -1998,7 +2020,7 @@ server_send_response(nghttp2_session *ngsession, int32_t stream_id,
 }
 
 #define MAKE_ERROR_REPLY(tag, code, desc) \
-	{ tag, MAKE_NV2(":status", #code), desc }
+	{ tag, MAKE_NV_CONST(":status", #code), desc }
 
 /*
  * Here we use roughly the same error codes that Unbound uses.
@@ -2288,13 +2310,14 @@ server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 				 sizeof(sock->h2->cache_control_buf),
 				 "max-age=%" PRIu32, sock->h2->min_ttl);
 	}
-	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
-				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
-				    MAKE_NV("Content-Length", sock->h2->clenbuf,
-					    content_len_buf_len),
-				    MAKE_NV("Cache-Control",
-					    sock->h2->cache_control_buf,
-					    cache_control_buf_len) };
+	const nghttp2_nv hdrs[] = {
+		MAKE_NV_CONST(":status", "200"),
+		MAKE_NV_CONST("content-type", DNS_MEDIA_TYPE),
+		MAKE_NV_CONST_NAME("content-length", sock->h2->clenbuf,
+				   content_len_buf_len),
+		MAKE_NV_CONST_NAME("cache-control", sock->h2->cache_control_buf,
+				   cache_control_buf_len)
+	};
 
 	result = server_send_response(handle->httpsession->ngsession,
 				      sock->h2->stream_id, hdrs,
@@ -3196,7 +3219,7 @@ static void
 http_initsocket(isc_nmsocket_t *sock) {
 	REQUIRE(sock != NULL);
 
-	sock->h2 = isc_mem_get(sock->worker->mctx, sizeof(*sock->h2));
+	sock->h2 = isc_mempool_get(sock->worker->h2_pool);
 	*sock->h2 = (isc_nmsocket_h2_t){
 		.request_type = ISC_HTTP_REQ_UNSUPPORTED,
 		.request_scheme = ISC_HTTP_SCHEME_UNSUPPORTED,
@@ -3254,8 +3277,8 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 				isc__nm_httpsession_detach(&sock->h2->session);
 			}
 
-			isc_mem_put(sock->worker->mctx, sock->h2,
-				    sizeof(*sock->h2));
+			isc_mempool_put(sock->worker->h2_pool, sock->h2);
+			sock->h2 = NULL;
 		};
 		break;
 	default:
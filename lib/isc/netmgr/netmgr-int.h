@@ -50,10 +50,13 @@
  */
 #if HAVE_DECL_UV_UDP_MMSG_CHUNK
 /*
- * The value 20 here is UV__MMSG_MAXWIDTH taken from the current libuv source,
- * libuv will not receive more that 20 datagrams in a single recvmmsg call.
+ * libuv splits the receive buffer into chunks of UV__UDP_DGRAM_MAXSIZE
+ * bytes, one per datagram, and will not receive more than
+ * ISC_NM_UDP_RECVBATCH_MAX datagrams in a single recvmmsg call.
  */
-#define ISC_NETMGR_UDP_RECVBUF_SIZE (20 * UINT16_MAX)
+#define ISC_NETMGR_UDP_DGRAM_MAXSIZE (64 * 1024)
+#define ISC_NETMGR_UDP_RECVBUF_SIZE \
+	(ISC_NM_UDP_RECVBATCH_MAX * ISC_NETMGR_UDP_DGRAM_MAXSIZE)
 #else
 /*
  * A single DNS message size
@@ -62,6 +65,22 @@
 #endif
 #define ISC_NETMGR_UDP_SENDBUF_SIZE UINT16_MAX
 
+/*
+ * The maximum number of UDP datagrams queued on a listening socket before
+ * the send queue is flushed with sendmmsg(2); this is also the maximum
+ * number of segments the kernel accepts in a single UDP_SEGMENT send.
+ */
+#define ISC_NETMGR_UDP_SENDQ_MAX 64
+
+/*
+ * Only datagrams up to this size are merged into UDP_SEGMENT sends, so the
+ * segments stay below the common link MTUs, and the merged payload must
+ * fit in a single IPv4 datagram.
+ */
+#define ISC_NETMGR_UDP_GSO_SEGMAX 1232
+#define ISC_NETMGR_UDP_GSO_MAXSIZE \
+	(UINT16_MAX - 20 /* IPv4 header */ - 8 /* UDP header */)
+
 /*
  * The TCP send and receive buffers can fit one maximum sized DNS message plus
  * its size, the receive buffer here affects TCP, DoT and DoH.
@@ -120,6 +139,7 @@ STATIC_ASSERT(ISC_NETMGR_TCP_RECVBUF_SIZE <= ISC_NETMGR_RECVBUF_SIZE,
 #define ISC_NM_NMSOCKET_MAX  64
 #define ISC_NM_NMHANDLES_MAX 64
 #define ISC_NM_UVREQS_MAX    64
+#define ISC_NM_H2_MAX	     64
 
 /*% ISC_PROXY2_MIN_AF_UNIX_SIZE is the largest type when TLVs are not used */
 #define ISC_NM_PROXY2_DEFAULT_BUFFER_SIZE (ISC_PROXY2_MIN_AF_UNIX_SIZE)
@@ -221,6 +241,9 @@ typedef struct isc__networker {
 
 	isc_mempool_t *nmsocket_pool;
 	isc_mempool_t *uvreq_pool;
+#if HAVE_LIBNGHTTP2
+	isc_mempool_t *h2_pool;
+#endif /* HAVE_LIBNGHTTP2 */
 } isc__networker_t;
 
 ISC_REFCOUNT_DECL(isc__networker);
@@ -333,6 +356,7 @@ struct isc_nm {
 	isc_mem_t *mctx;
 	isc_loopmgr_t *loopmgr;
 	uint32_t nloops;
+	uint32_t listenloops; /* see isc_nm_setlistenloops() */
 	isc__networker_t *workers;
 
 	isc_stats_t *stats;
@@ -340,6 +364,16 @@ struct isc_nm {
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
+	bool cpu_steering;
+
+	atomic_bool udp_send_coalesce;
+
+	/*
+	 * SO_BUSY_POLL for the UDP listening sockets, and whether a
+	 * failure to set it has been logged.
+	 */
+	atomic_uint_fast32_t udp_busy_poll;
+	atomic_bool	     udp_busy_poll_warned;
 
 	/*
 	 * Active connections are being closed and new connections are
@@ -391,7 +425,11 @@ typedef enum {
 	STATID_RECVFAIL = 9,
 	STATID_ACTIVE = 10,
 	STATID_CLIENTS = 11,
-	STATID_MAX = 12,
+	STATID_RECVBATCH = 12,
+	STATID_RECVBATCHMSGS = 13,
+	STATID_TLSCONNECT = 14,
+	STATID_TLSRESUMED = 15,
+	STATID_MAX = 16,
 } isc__nm_statid_t;
 
 typedef struct isc_nmsocket_tls_send_req {
@@ -575,12 +613,40 @@ struct isc_nmsocket {
 	 */
 	const isc_statscounter_t *statsindex;
 
+	/*%
+	 * UDP receive batching: the maximum number of datagrams read with
+	 * a single recvmmsg(2) call (0 means the libuv maximum), and the
+	 * number of datagrams received in the current batch.
+	 */
+	uint32_t recv_batch;
+	uint32_t recv_batch_msgs;
+
+	/*%
+	 * UDP send coalescing: the requests queued for sendmmsg(2), the
+	 * job that flushes them at the end of the loop iteration, and
+	 * whether UDP_SEGMENT (GSO) did not work on this socket.
+	 */
+	ISC_LIST(isc__nm_uvreq_t) sendq;
+	size_t sendq_len;
+	isc_job_t sendq_job;
+	bool sendq_scheduled;
+	bool udp_gso_failed;
+
 	/*%
 	 * TCP read/connect timeout timers.
+	 *
+	 * Restarting the read timeout only moves 'read_deadline' forward
+	 * while the timer is armed to fire no later than that; the
+	 * timer callback then re-arms the timer for the remainder
+	 * instead of timing out.  'read_timer_due' is the loop time the
+	 * armed read timeout fires at, or 0 if the timer is not armed
+	 * for a read timeout.
 	 */
 	uv_timer_t read_timer;
 	uint64_t read_timeout;
 	uint64_t connect_timeout;
+	uint64_t read_deadline;
+	uint64_t read_timer_due;
 
 	/*%
 	 * TCP write timeout timer.
@@ -1308,6 +1374,13 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id);
  * Decrement socket-related statistics counters.
  */
 
+void
+isc__nm_addstats(isc_nmsocket_t *sock, isc__nm_statid_t id,
+		 isc_statscounter_t value);
+/*%<
+ * Add 'value' to socket-related statistics counters.
+ */
+
 isc_result_t
 isc__nm_socket(int domain, int type, int protocol, uv_os_sock_t *sockp);
 /*%<
@@ -1332,6 +1405,25 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd);
  * Set the SO_REUSEPORT_LB (or equivalent) socket option on the fd
  */
 
+isc_result_t
+isc__nm_socket_busy_poll(uv_os_sock_t fd, uint32_t usec);
+/*%<
+ * Set the SO_BUSY_POLL socket option on the fd
+ */
+
+isc_result_t
+isc__nm_socket_freebind(uv_os_sock_t fd, sa_family_t sa_family);
+/*%<
+ * Set the IP_FREEBIND (or equivalent) socket option on the fd
+ */
+
+isc_result_t
+isc__nm_socket_reuse_cpu(uv_os_sock_t fd, uint32_t nsockets);
+/*%<
+ * Attach a reuseport BPF program to the reuseport group of the fd that
+ * selects the socket number 'SO_INCOMING_CPU % nsockets'
+ */
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
@@ -1365,6 +1457,14 @@ isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size);
  * Set the TCP maximum segment size
  */
 
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, int backlog);
+/*%<
+ * Enable TCP Fast Open on a listening TCP socket, allowing half of
+ * 'backlog' (but at least one) pending Fast Open requests.  Has no effect
+ * unless the kernel has server-side Fast Open enabled.
+ */
+
 isc_result_t
 isc__nm_socket_min_mtu(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
@@ -65,6 +65,10 @@ static const isc_statscounter_t udp4statsindex[] = {
 	isc_sockstatscounter_udp4recvfail,
 	isc_sockstatscounter_udp4active,
 	-1,
+	isc_sockstatscounter_udp4recvbatch,
+	isc_sockstatscounter_udp4recvbatchmsgs,
+	-1,
+	-1,
 };
 
 static const isc_statscounter_t udp6statsindex[] = {
@@ -80,6 +84,10 @@ static const isc_statscounter_t udp6statsindex[] = {
 	isc_sockstatscounter_udp6recvfail,
 	isc_sockstatscounter_udp6active,
 	-1,
+	isc_sockstatscounter_udp6recvbatch,
+	isc_sockstatscounter_udp6recvbatchmsgs,
+	-1,
+	-1,
 };
 
 static const isc_statscounter_t tcp4statsindex[] = {
@@ -89,6 +97,8 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4acceptfail,  isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,    isc_sockstatscounter_tcp4recvfail,
 	isc_sockstatscounter_tcp4active,      isc_sockstatscounter_tcp4clients,
+	-1,				      -1,
+	isc_sockstatscounter_tcp4tlsconnect,  isc_sockstatscounter_tcp4tlsresumed,
 };
 
 static const isc_statscounter_t tcp6statsindex[] = {
@@ -98,6 +108,8 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6acceptfail,  isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,    isc_sockstatscounter_tcp6recvfail,
 	isc_sockstatscounter_tcp6active,      isc_sockstatscounter_tcp6clients,
+	-1,				      -1,
+	isc_sockstatscounter_tcp6tlsconnect,  isc_sockstatscounter_tcp6tlsresumed,
 };
 
 static void
@@ -176,6 +188,7 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 	*netmgr = (isc_nm_t){
 		.loopmgr = loopmgr,
 		.nloops = isc_loopmgr_nloops(loopmgr),
+		.listenloops = isc_loopmgr_nloops(loopmgr),
 	};
 
 	isc_mem_attach(mctx, &netmgr->mctx);
@@ -186,6 +199,9 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 	atomic_init(&netmgr->send_tcp_buffer_size, 0);
 	atomic_init(&netmgr->recv_udp_buffer_size, 0);
 	atomic_init(&netmgr->send_udp_buffer_size, 0);
+	atomic_init(&netmgr->udp_busy_poll, 0);
+	atomic_init(&netmgr->udp_busy_poll_warned, false);
+	atomic_init(&netmgr->udp_send_coalesce, false);
 #if HAVE_SO_REUSEPORT_LB
 	netmgr->load_balance_sockets = true;
 #else
@@ -226,10 +242,19 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 				   &worker->nmsocket_pool);
 		isc_mempool_setfreemax(worker->nmsocket_pool,
 				       ISC_NM_NMSOCKET_MAX);
+		isc_mempool_setname(worker->nmsocket_pool, "nmsocket");
 
 		isc_mempool_create(worker->mctx, sizeof(isc__nm_uvreq_t),
 				   &worker->uvreq_pool);
 		isc_mempool_setfreemax(worker->uvreq_pool, ISC_NM_UVREQS_MAX);
+		isc_mempool_setname(worker->uvreq_pool, "uvreq");
+
+#if HAVE_LIBNGHTTP2
+		isc_mempool_create(worker->mctx, sizeof(isc_nmsocket_h2_t),
+				   &worker->h2_pool);
+		isc_mempool_setfreemax(worker->h2_pool, ISC_NM_H2_MAX);
+		isc_mempool_setname(worker->h2_pool, "h2");
+#endif /* HAVE_LIBNGHTTP2 */
 
 		isc_loop_attach(loop, &worker->loop);
 		isc_loop_teardown(loop, networker_teardown, worker);
@@ -359,6 +384,14 @@ isc_nm_setnetbuffers(isc_nm_t *mgr, int32_t recv_tcp, int32_t send_tcp,
 	atomic_store_relaxed(&mgr->send_udp_buffer_size, send_udp);
 }
 
+void
+isc_nm_setudpbusypoll(isc_nm_t *mgr, uint32_t usec) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store_relaxed(&mgr->udp_busy_poll, usec);
+	atomic_store_relaxed(&mgr->udp_busy_poll_warned, false);
+}
+
 bool
 isc_nm_getloadbalancesockets(isc_nm_t *mgr) {
 	REQUIRE(VALID_NM(mgr));
@@ -375,6 +408,46 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, ISC_ATTR_UNUSED bool enabled) {
 #endif
 }
 
+bool
+isc_nm_getcpusteering(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->cpu_steering);
+}
+
+void
+isc_nm_setcpusteering(isc_nm_t *mgr, ISC_ATTR_UNUSED bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+	mgr->cpu_steering = enabled;
+#endif
+}
+
+void
+isc_nm_setlistenloops(isc_nm_t *mgr, uint32_t nloops) {
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(nloops > 0 && nloops <= mgr->nloops);
+
+	mgr->listenloops = nloops;
+}
+
+bool
+isc_nm_getudpsendcoalesce(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (atomic_load_relaxed(&mgr->udp_send_coalesce));
+}
+
+void
+isc_nm_setudpsendcoalesce(isc_nm_t *mgr, ISC_ATTR_UNUSED bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if HAVE_SENDMMSG
+	atomic_store_relaxed(&mgr->udp_send_coalesce, enabled);
+#endif
+}
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised) {
@@ -690,6 +763,7 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc__networker_t *worker,
 		.active_handles = ISC_LIST_INITIALIZER,
 		.active_handles_max = ISC_NETMGR_MAX_STREAM_CLIENTS_PER_CONN,
 		.active_link = ISC_LINK_INITIALIZER,
+		.sendq = ISC_LIST_INITIALIZER,
 		.active = true,
 	};
 
@@ -1141,6 +1215,22 @@ isc__nmsocket_readtimeout_cb(uv_timer_t *timer) {
 	REQUIRE(VALID_NMSOCK(sock));
 	REQUIRE(sock->tid == isc_tid());
 
+	/*
+	 * The read timeout has been pushed back while the timer was
+	 * running, re-arm it for the remaining time.
+	 */
+	if (sock->read_deadline > uv_now(timer->loop)) {
+		int r;
+
+		sock->read_timer_due = sock->read_deadline;
+		r = uv_timer_start(timer, isc__nmsocket_readtimeout_cb,
+				   sock->read_deadline - uv_now(timer->loop), 0);
+		UV_RUNTIME_CHECK(uv_timer_start, r);
+		return;
+	}
+
+	sock->read_timer_due = 0;
+
 	if (sock->client) {
 		uv_timer_stop(timer);
 
@@ -1190,6 +1280,7 @@ isc__nmsocket_timer_restart(isc_nmsocket_t *sock) {
 			return;
 		}
 
+		sock->read_timer_due = 0;
 		r = uv_timer_start(&sock->read_timer,
 				   isc__nmsocket_connecttimeout_cb,
 				   sock->connect_timeout + 10, 0);
@@ -1198,10 +1289,28 @@ isc__nmsocket_timer_restart(isc_nmsocket_t *sock) {
 	} else {
 		int r;
 
+		uint64_t now;
+
 		if (sock->read_timeout == 0) {
 			return;
 		}
 
+		/*
+		 * This is called for every read, so avoid taking the timer
+		 * out of the libuv timer heap and putting it back each time:
+		 * if the armed timer fires before the new deadline, just
+		 * record the deadline and let the callback re-arm it.
+		 */
+		now = uv_now(&sock->worker->loop->loop);
+		sock->read_deadline = now + sock->read_timeout;
+		if (sock->read_timer_due != 0 &&
+		    sock->read_timer_due <= sock->read_deadline &&
+		    uv_is_active((uv_handle_t *)&sock->read_timer))
+		{
+			return;
+		}
+
+		sock->read_timer_due = sock->read_deadline;
 		r = uv_timer_start(&sock->read_timer,
 				   isc__nmsocket_readtimeout_cb,
 				   sock->read_timeout, 0);
@@ -1265,6 +1374,8 @@ isc__nmsocket_timer_stop(isc_nmsocket_t *sock) {
 
 	/* uv_timer_stop() is idempotent, no need to check if running */
 
+	sock->read_timer_due = 0;
+	sock->read_deadline = 0;
 	r = uv_timer_stop(&sock->read_timer);
 	UV_RUNTIME_CHECK(uv_timer_stop, r);
 }
@@ -1340,6 +1451,16 @@ isc__nm_alloc_cb(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
 	switch (sock->type) {
 	case isc_nm_udpsocket:
 		buf->len = ISC_NETMGR_UDP_RECVBUF_SIZE;
+#if HAVE_DECL_UV_UDP_MMSG_CHUNK
+		/*
+		 * libuv derives the number of datagrams to receive in
+		 * a single recvmmsg(2) call from the buffer size.
+		 */
+		if (sock->recv_batch > 0) {
+			buf->len = sock->recv_batch *
+				   ISC_NETMGR_UDP_DGRAM_MAXSIZE;
+		}
+#endif
 		break;
 	case isc_nm_tcpsocket:
 		buf->len = ISC_NETMGR_TCP_RECVBUF_SIZE;
@@ -2041,6 +2162,18 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id) {
 	}
 }
 
+void
+isc__nm_addstats(isc_nmsocket_t *sock, isc__nm_statid_t id,
+		 isc_statscounter_t value) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(id < STATID_MAX);
+
+	if (sock->statsindex != NULL && sock->worker->netmgr->stats != NULL) {
+		isc_stats_add(sock->worker->netmgr->stats,
+			      sock->statsindex[id], value);
+	}
+}
+
 isc_result_t
 isc_nm_checkaddr(const isc_sockaddr_t *addr, isc_socktype_t type) {
 	int proto, pf, addrlen, fd, r;
@@ -2573,6 +2706,9 @@ isc__networker_destroy(isc__networker_t *worker) {
 
 	isc_loop_detach(&worker->loop);
 
+#if HAVE_LIBNGHTTP2
+	isc_mempool_destroy(&worker->h2_pool);
+#endif /* HAVE_LIBNGHTTP2 */
 	isc_mempool_destroy(&worker->uvreq_pool);
 	isc_mempool_destroy(&worker->nmsocket_pool);
 
@@ -2634,14 +2770,12 @@ isc__nmhandle_log(const isc_nmhandle_t *handle, int level, const char *fmt,
 	isc__nmsocket_log(handle->sock, level, "handle %p: %s", handle, msgbuf);
 }
 
-void
-isc__nm_received_proxy_header_log(isc_nmhandle_t *handle,
-				  const isc_proxy2_command_t cmd,
-				  const int socktype,
-				  const isc_sockaddr_t *restrict src_addr,
-				  const isc_sockaddr_t *restrict dst_addr,
-				  const isc_region_t *restrict tlvs) {
-	const int log_level = ISC_LOG_DEBUG(1);
+static void
+received_proxy_header_log(isc_nmhandle_t *handle, const int log_level,
+			  const isc_proxy2_command_t cmd, const int socktype,
+			  const isc_sockaddr_t *restrict src_addr,
+			  const isc_sockaddr_t *restrict dst_addr,
+			  const isc_region_t *restrict tlvs) {
 	isc_sockaddr_t real_local, real_peer;
 	char real_local_fmt[ISC_SOCKADDR_FORMATSIZE] = { 0 };
 	char real_peer_fmt[ISC_SOCKADDR_FORMATSIZE] = { 0 };
@@ -2650,10 +2784,6 @@ isc__nm_received_proxy_header_log(isc_nmhandle_t *handle,
 	const char *real_addresses_msg =
 		"real source and destination addresses are used";
 
-	if (!isc_log_wouldlog(log_level)) {
-		return;
-	}
-
 	if (isc_nmhandle_is_stream(handle)) {
 		proto = isc_nm_has_encryption(handle) ? "TLS" : "TCP";
 	} else {
@@ -2723,6 +2853,27 @@ isc__nm_received_proxy_header_log(isc_nmhandle_t *handle,
 	}
 }
 
+void
+isc__nm_received_proxy_header_log(isc_nmhandle_t *handle,
+				  const isc_proxy2_command_t cmd,
+				  const int socktype,
+				  const isc_sockaddr_t *restrict src_addr,
+				  const isc_sockaddr_t *restrict dst_addr,
+				  const isc_region_t *restrict tlvs) {
+	const int log_level = ISC_LOG_DEBUG(1);
+
+	/*
+	 * This is called for every PROXYv2 datagram, so check the log
+	 * level before setting up the message buffers.
+	 */
+	if (!isc_log_wouldlog(log_level)) {
+		return;
+	}
+
+	received_proxy_header_log(handle, log_level, cmd, socktype, src_addr,
+				  dst_addr, tlvs);
+}
+
 void
 isc__nmhandle_set_manual_timer(isc_nmhandle_t *handle, const bool manual) {
 	REQUIRE(VALID_NMHANDLE(handle));
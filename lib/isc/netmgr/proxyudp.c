@@ -318,7 +318,7 @@ failed:
 
 isc_result_t
 isc_nm_listenproxyudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
-		      isc_nm_recv_cb_t cb, void *cbarg,
+		      uint32_t recv_batch, isc_nm_recv_cb_t cb, void *cbarg,
 		      isc_nmsocket_t **sockp) {
 	isc_result_t result;
 	isc_nmsocket_t *listener = NULL;
@@ -352,8 +352,8 @@ isc_nm_listenproxyudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 			&listener->proxy.udp_server_socks[i]->listener);
 	}
 
-	result = isc_nm_listenudp(mgr, workers, iface, proxyudp_read_cb,
-				  listener, &listener->outer);
+	result = isc_nm_listenudp(mgr, workers, iface, recv_batch,
+				  proxyudp_read_cb, listener, &listener->outer);
 
 	if (result == ISC_R_SUCCESS) {
 		listener->active = true;
@@ -11,6 +11,12 @@
  * information regarding copyright ownership.
  */
 
+#include <limits.h>
+
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif /* if defined(__linux__) */
+
 #include <isc/errno.h>
 #include <isc/uv.h>
 
@@ -63,6 +69,11 @@ socket_freebind(uv_os_sock_t fd, sa_family_t sa_family) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_freebind(uv_os_sock_t fd, sa_family_t sa_family) {
+	return (socket_freebind(fd, sa_family));
+}
+
 int
 isc__nm_udp_freebind(uv_udp_t *handle, const struct sockaddr *addr,
 		     unsigned int flags) {
@@ -218,6 +229,60 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_reuse_cpu(uv_os_sock_t fd, uint32_t nsockets) {
+	REQUIRE(nsockets > 0);
+
+	/*
+	 * The program returns the index of the socket in the reuseport
+	 * group, which is the order in which the sockets were bound;
+	 * an index out of range makes the kernel fall back to hashing.
+	 * The program is shared by the whole group, so it's enough to
+	 * attach it to one of the sockets.
+	 */
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+	struct sock_filter code[] = {
+		/* A = raw_smp_processor_id() */
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		/* A = A % nsockets */
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, nsockets },
+		/* return A */
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = ARRAY_SIZE(code),
+		.filter = code,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+isc_result_t
+isc__nm_socket_busy_poll(uv_os_sock_t fd, uint32_t usec) {
+#if defined(SO_BUSY_POLL)
+	int val = (int)ISC_MIN(usec, INT_MAX);
+
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) == -1)
+	{
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(usec);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family) {
 	/*
@@ -348,6 +413,37 @@ isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, int backlog) {
+#if defined(ENABLE_TCP_FASTOPEN) && defined(TCP_FASTOPEN)
+	/*
+	 * Some systems (e.g. FreeBSD) define TCP_FASTOPEN even when the
+	 * running kernel does not support it; setsockopt() then fails and
+	 * the listener simply works without Fast Open.
+	 */
+	int qlen;
+
+#ifdef __APPLE__
+	/* macOS only accepts 1 as the TCP_FASTOPEN value */
+	qlen = 1;
+#else  /* __APPLE__ */
+	qlen = ISC_MAX(backlog / 2, 1);
+#endif /* __APPLE__ */
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, (void *)&qlen,
+		       sizeof(qlen)) == -1)
+	{
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(backlog);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 isc_result_t
 isc__nm_socket_min_mtu(uv_os_sock_t fd, sa_family_t sa_family) {
 	if (sa_family != AF_INET6) {
@@ -317,6 +317,7 @@ start_tcp_child_job(void *arg) {
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 	(void)isc__nm_socket_tcp_maxseg(sock->fd, NM_MAXSEG);
+	(void)isc__nm_socket_tcp_fastopen(sock->fd, sock->backlog);
 
 	r = uv_tcp_init(&loop->loop, &sock->uv_handle.tcp);
 	UV_RUNTIME_CHECK(uv_tcp_init, r);
@@ -453,7 +454,7 @@ isc_nm_listentcp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	REQUIRE(isc_tid() == 0);
 
 	if (workers == 0) {
-		workers = mgr->nloops;
+		workers = mgr->listenloops;
 	}
 	REQUIRE(workers <= mgr->nloops);
 
@@ -464,6 +464,14 @@ tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 		INSIST(SSL_is_init_finished(sock->tlsstream.tls) == 1);
 
 		isc__nmsocket_log_tls_session_reuse(sock, sock->tlsstream.tls);
+		if (!sock->tlsstream.server && sock->outerhandle != NULL) {
+			isc_nmsocket_t *tsock = sock->outerhandle->sock;
+
+			isc__nm_incstats(tsock, STATID_TLSCONNECT);
+			if (SSL_session_reused(sock->tlsstream.tls) == 1) {
+				isc__nm_incstats(tsock, STATID_TLSRESUMED);
+			}
+		}
 		tlshandle = isc__nmhandle_get(sock, &sock->peer, &sock->iface);
 		tls_read_stop(sock);
 
@@ -844,6 +852,13 @@ static isc_result_t
 initialize_tls(isc_nmsocket_t *sock, bool server) {
 	REQUIRE(sock->tid == isc_tid());
 
+	/*
+	 * The TLS layer never touches the TCP socket itself: the records
+	 * are passed to and from the outer TCP socket through memory BIOs.
+	 * This is also why kernel TLS (SSL_OP_ENABLE_KTLS) cannot be used
+	 * here, as OpenSSL only enables it for BIOs that own a socket
+	 * descriptor, while the descriptor belongs to libuv.
+	 */
 	sock->tlsstream.bio_in = BIO_new(BIO_s_mem());
 	if (sock->tlsstream.bio_in == NULL) {
 		isc_tls_free(&sock->tlsstream.tls);
@@ -975,7 +990,7 @@ isc_nm_listentls(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	}
 
 	if (workers == 0) {
-		workers = mgr->nloops;
+		workers = mgr->listenloops;
 	}
 	REQUIRE(workers <= mgr->nloops);
 
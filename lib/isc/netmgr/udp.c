@@ -11,14 +11,21 @@
  * information regarding copyright ownership.
  */
 
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
+#if HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif /* HAVE_SENDMMSG */
+
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/buffer.h>
 #include <isc/condition.h>
 #include <isc/errno.h>
+#include <isc/job.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
@@ -28,6 +35,7 @@
 #include <isc/result.h>
 #include <isc/sockaddr.h>
 #include <isc/stdtime.h>
+#include <isc/strerr.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/uv.h>
@@ -135,7 +143,15 @@ start_udp_child_job(void *arg) {
 		uv_bind_flags |= UV_UDP_IPV6ONLY;
 	}
 
-	if (mgr->load_balance_sockets) {
+	if (mgr->load_balance_sockets && mgr->cpu_steering && sock->tid != 0) {
+		/* The socket was bound in order by start_udp_child() */
+		if (sock->result != ISC_R_UNSET) {
+			result = sock->result;
+			isc__nm_incstats(sock, STATID_BINDFAIL);
+			goto done;
+		}
+		sock->uv_handle.udp.flags = sock->parent->uv_handle.udp.flags;
+	} else if (mgr->load_balance_sockets) {
 		r = isc__nm_udp_freebind(&sock->uv_handle.udp,
 					 &sock->parent->iface.type.sa,
 					 uv_bind_flags);
@@ -143,6 +159,10 @@ start_udp_child_job(void *arg) {
 			isc__nm_incstats(sock, STATID_BINDFAIL);
 			goto done;
 		}
+		if (sock->tid == 0) {
+			sock->parent->uv_handle.udp.flags =
+				sock->uv_handle.udp.flags;
+		}
 	} else if (sock->tid == 0) {
 		/* This thread is first, bind the socket */
 		r = isc__nm_udp_freebind(&sock->uv_handle.udp,
@@ -160,6 +180,27 @@ start_udp_child_job(void *arg) {
 
 	isc__nm_set_network_buffers(mgr, &sock->uv_handle.handle);
 
+	uint32_t busy_poll = atomic_load_relaxed(&mgr->udp_busy_poll);
+	if (busy_poll > 0) {
+		/* Needs CAP_NET_ADMIN above net.core.busy_read */
+		isc_result_t bpresult = isc__nm_socket_busy_poll(sock->fd,
+								 busy_poll);
+		if (bpresult != ISC_R_SUCCESS &&
+		    !atomic_exchange_relaxed(&mgr->udp_busy_poll_warned, true))
+		{
+			char strbuf[ISC_STRERRORSIZE] = "not supported";
+
+			if (bpresult == ISC_R_FAILURE) {
+				strerror_r(errno, strbuf, sizeof(strbuf));
+			}
+			isc__nmsocket_log(sock, ISC_LOG_WARNING,
+					  "unable to set SO_BUSY_POLL to %u "
+					  "microseconds, busy polling is "
+					  "disabled: %s",
+					  busy_poll, strbuf);
+		}
+	}
+
 	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
 			      isc__nm_udp_read_cb);
 	if (r != 0) {
@@ -168,7 +209,9 @@ start_udp_child_job(void *arg) {
 	}
 
 done:
-	result = isc_uverr2result(r);
+	if (result == ISC_R_UNSET) {
+		result = isc_uverr2result(r);
+	}
 
 	sock->result = result;
 
@@ -179,6 +222,24 @@ done:
 	}
 }
 
+static isc_result_t
+udp_bind_ordered(uv_os_sock_t fd, isc_sockaddr_t *iface) {
+	const struct sockaddr *sa = &iface->type.sa;
+	socklen_t salen = iface->length;
+
+	if (bind(fd, sa, salen) == 0) {
+		return (ISC_R_SUCCESS);
+	}
+	if (errno == EADDRNOTAVAIL &&
+	    isc__nm_socket_freebind(fd, sa->sa_family) == ISC_R_SUCCESS &&
+	    bind(fd, sa, salen) == 0)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	return (isc_errno_toresult(errno));
+}
+
 static void
 start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 		uv_os_sock_t fd, int tid) {
@@ -188,6 +249,7 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 	isc__nmsocket_init(csock, worker, isc_nm_udpsocket, iface, sock);
 	csock->recv_cb = sock->recv_cb;
 	csock->recv_cbarg = sock->recv_cbarg;
+	csock->recv_batch = sock->recv_batch;
 	csock->inactive_handles_max = ISC_NM_NMHANDLES_MAX;
 
 	if (mgr->load_balance_sockets) {
@@ -198,6 +260,18 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 	}
 	INSIST(csock->fd >= 0);
 
+	if (mgr->load_balance_sockets && mgr->cpu_steering && tid != 0) {
+		/*
+		 * The reuseport BPF program selects the sockets by their
+		 * position in the reuseport group, so bind them here in
+		 * the order of the loops instead of racing in the loops.
+		 */
+		isc_result_t result = udp_bind_ordered(csock->fd, iface);
+		if (result != ISC_R_SUCCESS) {
+			csock->result = result;
+		}
+	}
+
 	if (tid == 0) {
 		start_udp_child_job(csock);
 	} else {
@@ -207,7 +281,8 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 
 isc_result_t
 isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
-		 isc_nm_recv_cb_t cb, void *cbarg, isc_nmsocket_t **sockp) {
+		 uint32_t recv_batch, isc_nm_recv_cb_t cb, void *cbarg,
+		 isc_nmsocket_t **sockp) {
 	isc_result_t result = ISC_R_UNSET;
 	isc_nmsocket_t *sock = NULL;
 	uv_os_sock_t fd = -1;
@@ -215,6 +290,7 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 
 	REQUIRE(VALID_NM(mgr));
 	REQUIRE(isc_tid() == 0);
+	REQUIRE(recv_batch <= ISC_NM_UDP_RECVBATCH_MAX);
 
 	worker = &mgr->workers[0];
 
@@ -223,7 +299,7 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	}
 
 	if (workers == 0) {
-		workers = mgr->nloops;
+		workers = mgr->listenloops;
 	}
 	REQUIRE(workers <= mgr->nloops);
 
@@ -239,6 +315,7 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 
 	sock->recv_cb = cb;
 	sock->recv_cbarg = cbarg;
+	sock->recv_batch = recv_batch;
 
 	if (!mgr->load_balance_sockets) {
 		fd = isc__nm_udp_lb_socket(mgr, iface->type.sa.sa_family);
@@ -278,6 +355,12 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		return (result);
 	}
 
+	if (mgr->load_balance_sockets && mgr->cpu_steering) {
+		/* Not fatal, the kernel keeps hashing the flows then */
+		(void)isc__nm_socket_reuse_cpu(sock->children[0].fd,
+					       sock->nchildren);
+	}
+
 	sock->active = true;
 
 	*sockp = sock;
@@ -467,6 +550,22 @@ isc__nm_udp_stoplistening(isc_nmsocket_t *sock) {
 	isc__nmsocket_prep_destroy(sock);
 }
 
+/*
+ * Account for the datagrams received since the last call; this is called
+ * at the end of every recvmmsg(2) batch, or at the end of the event loop
+ * iteration when recvmmsg(2) is not in use.
+ */
+static void
+udp_recvbatch_done(isc_nmsocket_t *sock) {
+	if (sock->recv_batch_msgs == 0) {
+		return;
+	}
+
+	isc__nm_incstats(sock, STATID_RECVBATCH);
+	isc__nm_addstats(sock, STATID_RECVBATCHMSGS, sock->recv_batch_msgs);
+	sock->recv_batch_msgs = 0;
+}
+
 /*
  * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
  * reused for a series of packets, so we need to allocate a new one.
@@ -494,6 +593,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
 		INSIST(nrecv == 0);
 		INSIST(addr == NULL);
+		udp_recvbatch_done(sock);
 		goto free;
 	}
 #else
@@ -547,6 +647,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (nrecv == 0 && addr == NULL) {
 		INSIST(flags == 0);
+		udp_recvbatch_done(sock);
 		goto free;
 	}
 
@@ -582,6 +683,8 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 		isc__nmsocket_timer_stop(sock);
 		isc__nm_stop_reading(sock);
 		isc__nmsocket_clearcb(sock);
+	} else {
+		sock->recv_batch_msgs++;
 	}
 
 	REQUIRE(!sock->processing);
@@ -654,6 +757,233 @@ can_log_udp_sends(void) {
 	return (false);
 }
 
+/*
+ * Send a prepared request either synchronously, when the libuv send queue
+ * is full, or asynchronously.
+ */
+static void
+udp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq,
+		const struct sockaddr *sa) {
+	isc__networker_t *worker = sock->worker;
+	isc_result_t result;
+	int r;
+
+	if (uv_udp_get_send_queue_size(&sock->uv_handle.udp) >
+	    ISC_NETMGR_UDP_SENDBUF_SIZE)
+	{
+		/*
+		 * The kernel UDP send queue is full, try sending the UDP
+		 * response synchronously instead of just failing.
+		 */
+		r = uv_udp_try_send(&sock->uv_handle.udp, &uvreq->uvbuf, 1, sa);
+		if (r < 0) {
+			if (can_log_udp_sends()) {
+				isc__netmgr_log(
+					worker->netmgr, ISC_LOG_ERROR,
+					"Sending UDP messages failed: %s",
+					isc_result_totext(isc_uverr2result(r)));
+			}
+
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+			result = isc_uverr2result(r);
+			goto fail;
+		}
+
+		RUNTIME_CHECK(r == (int)uvreq->uvbuf.len);
+		isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, true);
+
+	} else {
+		/* Send the message asynchronously */
+		r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
+				&uvreq->uvbuf, 1, sa, udp_send_cb);
+		if (r < 0) {
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+			result = isc_uverr2result(r);
+			goto fail;
+		}
+	}
+	return;
+fail:
+	isc__nm_failed_send_cb(sock, uvreq, result, true);
+}
+
+#if HAVE_SENDMMSG
+#if HAVE_DECL_UDP_SEGMENT
+/*
+ * Count the requests starting at 'reqs[first]' that can be sent as
+ * a single UDP_SEGMENT message: they must go to the same peer and all
+ * have the same size, except for the last one, which may be shorter.
+ */
+static size_t
+udp_gso_run(isc__nm_uvreq_t **reqs, size_t first, size_t nreqs) {
+	size_t segsize = reqs[first]->uvbuf.len;
+	size_t total = segsize;
+	size_t n = 1;
+
+	if (segsize == 0 || segsize > ISC_NETMGR_UDP_GSO_SEGMAX) {
+		return (1);
+	}
+
+	for (size_t i = first + 1; i < nreqs; i++) {
+		size_t len = reqs[i]->uvbuf.len;
+
+		if (len == 0 || len > segsize ||
+		    total + len > ISC_NETMGR_UDP_GSO_MAXSIZE ||
+		    !isc_sockaddr_equal(&reqs[i]->peer, &reqs[first]->peer))
+		{
+			break;
+		}
+
+		total += len;
+		n++;
+
+		if (len < segsize) {
+			break;
+		}
+	}
+
+	return (n);
+}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+/*
+ * Flush the socket's UDP send queue with as few sendmmsg(2) calls as
+ * possible.  Whatever the kernel does not accept (e.g. because the socket
+ * buffer is full) is handed over to libuv, which queues the datagrams
+ * until the socket is writable again and reports the errors.
+ */
+static void
+udp_sendq_flush(isc_nmsocket_t *sock, bool async) {
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDQ_MAX];
+	struct mmsghdr msgs[ISC_NETMGR_UDP_SENDQ_MAX];
+	struct iovec iovs[ISC_NETMGR_UDP_SENDQ_MAX];
+	size_t nsegs[ISC_NETMGR_UDP_SENDQ_MAX];
+#if HAVE_DECL_UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} cmsgs[ISC_NETMGR_UDP_SENDQ_MAX];
+#endif /* HAVE_DECL_UDP_SEGMENT */
+	size_t nreqs = 0, nmsgs = 0, sent = 0, done = 0;
+	int r = 0;
+
+	REQUIRE(sock->tid == isc_tid());
+
+	while (!ISC_LIST_EMPTY(sock->sendq)) {
+		isc__nm_uvreq_t *req = ISC_LIST_HEAD(sock->sendq);
+		ISC_LIST_UNLINK(sock->sendq, req, link);
+		INSIST(nreqs < ISC_NETMGR_UDP_SENDQ_MAX);
+		reqs[nreqs++] = req;
+	}
+	sock->sendq_len = 0;
+
+	for (size_t i = 0; i < nreqs; i += nsegs[nmsgs++]) {
+		struct msghdr *hdr = &msgs[nmsgs].msg_hdr;
+		size_t n = 1;
+
+		memset(&msgs[nmsgs], 0, sizeof(msgs[nmsgs]));
+		hdr->msg_name = &reqs[i]->peer.type.sa;
+		hdr->msg_namelen = reqs[i]->peer.length;
+		hdr->msg_iov = &iovs[i];
+
+#if HAVE_DECL_UDP_SEGMENT
+		if (!sock->udp_gso_failed) {
+			n = udp_gso_run(reqs, i, nreqs);
+		}
+		if (n > 1) {
+			struct cmsghdr *cmsg = NULL;
+
+			hdr->msg_control = cmsgs[nmsgs].buf;
+			hdr->msg_controllen = sizeof(cmsgs[nmsgs].buf);
+
+			cmsg = CMSG_FIRSTHDR(hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*(uint16_t *)(void *)CMSG_DATA(cmsg) =
+				(uint16_t)reqs[i]->uvbuf.len;
+		}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+		for (size_t k = i; k < i + n; k++) {
+			iovs[k].iov_base = reqs[k]->uvbuf.base;
+			iovs[k].iov_len = reqs[k]->uvbuf.len;
+		}
+		hdr->msg_iovlen = n;
+		nsegs[nmsgs] = n;
+	}
+
+	while (sent < nmsgs) {
+		r = sendmmsg(sock->fd, &msgs[sent], nmsgs - sent, 0);
+		if (r < 0 && errno == EINTR) {
+			continue;
+		} else if (r <= 0) {
+			break;
+		}
+
+		for (int m = 0; m < r; m++) {
+			for (size_t k = 0; k < nsegs[sent + m]; k++) {
+				isc__nm_sendcb(sock, reqs[done++],
+					       ISC_R_SUCCESS, async);
+			}
+		}
+		sent += r;
+	}
+
+	if (sent < nmsgs && r < 0 && nsegs[sent] > 1 &&
+	    (errno == EIO || errno == EINVAL))
+	{
+		/*
+		 * The device or the kernel can't do UDP segmentation
+		 * offload; don't try again on this socket.
+		 */
+		isc__nmsocket_log(
+			sock, ISC_LOG_DEBUG(1),
+			"UDP_SEGMENT send failed, disabling: %s",
+			isc_result_totext(isc_errno_toresult(errno)));
+		sock->udp_gso_failed = true;
+	}
+
+	for (; done < nreqs; done++) {
+		udp_send_direct(sock, reqs[done], &reqs[done]->peer.type.sa);
+	}
+}
+
+static void
+udp_sendq_job(void *arg) {
+	isc_nmsocket_t *sock = arg;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	sock->sendq_scheduled = false;
+
+	if (!ISC_LIST_EMPTY(sock->sendq)) {
+		udp_sendq_flush(sock, false);
+	}
+
+	isc__nmsocket_detach(&sock);
+}
+
+static void
+udp_sendq_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	ISC_LIST_APPEND(sock->sendq, uvreq, link);
+	sock->sendq_len++;
+
+	if (sock->sendq_len == ISC_NETMGR_UDP_SENDQ_MAX) {
+		udp_sendq_flush(sock, true);
+		return;
+	}
+
+	if (!sock->sendq_scheduled) {
+		sock->sendq_scheduled = true;
+		isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+		isc_job_run(sock->worker->loop, &sock->sendq_job,
+			    udp_sendq_job, sock);
+	}
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Send the data in 'region' to a peer via a UDP socket. We try to find
  * a proper sibling/child socket so that we won't have to jump to
@@ -668,7 +998,6 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc__networker_t *worker = NULL;
 	uint32_t maxudp;
-	int r;
 	isc_result_t result;
 
 	REQUIRE(VALID_NMSOCK(sock));
@@ -711,40 +1040,20 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		goto fail;
 	}
 
-	if (uv_udp_get_send_queue_size(&sock->uv_handle.udp) >
-	    ISC_NETMGR_UDP_SENDBUF_SIZE)
+#if HAVE_SENDMMSG
+	/*
+	 * Responses from the listening sockets can be coalesced.
+	 */
+	if (sock->parent != NULL && !sock->connected &&
+	    atomic_load_relaxed(&worker->netmgr->udp_send_coalesce))
 	{
-		/*
-		 * The kernel UDP send queue is full, try sending the UDP
-		 * response synchronously instead of just failing.
-		 */
-		r = uv_udp_try_send(&sock->uv_handle.udp, &uvreq->uvbuf, 1, sa);
-		if (r < 0) {
-			if (can_log_udp_sends()) {
-				isc__netmgr_log(
-					worker->netmgr, ISC_LOG_ERROR,
-					"Sending UDP messages failed: %s",
-					isc_result_totext(isc_uverr2result(r)));
-			}
-
-			isc__nm_incstats(sock, STATID_SENDFAIL);
-			result = isc_uverr2result(r);
-			goto fail;
-		}
-
-		RUNTIME_CHECK(r == (int)region->length);
-		isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, true);
-
-	} else {
-		/* Send the message asynchronously */
-		r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
-				&uvreq->uvbuf, 1, sa, udp_send_cb);
-		if (r < 0) {
-			isc__nm_incstats(sock, STATID_SENDFAIL);
-			result = isc_uverr2result(r);
-			goto fail;
-		}
+		uvreq->peer = *peer;
+		udp_sendq_enqueue(sock, uvreq);
+		return;
 	}
+#endif /* HAVE_SENDMMSG */
+
+	udp_send_direct(sock, uvreq, sa);
 	return;
 fail:
 	isc__nm_failed_send_cb(sock, uvreq, result, true);
@@ -997,6 +1306,13 @@ isc__nm_udp_close(isc_nmsocket_t *sock) {
 	REQUIRE(sock->tid == isc_tid());
 	REQUIRE(!sock->closing);
 
+#if HAVE_SENDMMSG
+	/* Don't leave the queued responses behind */
+	if (!ISC_LIST_EMPTY(sock->sendq)) {
+		udp_sendq_flush(sock, true);
+	}
+#endif /* HAVE_SENDMMSG */
+
 	sock->closing = true;
 
 	isc__nmsocket_clearcb(sock);
@@ -22,6 +22,7 @@
 #include "os_p.h"
 
 static unsigned int isc__os_ncpus = 0;
+static unsigned int isc__os_numanodes = 1;
 static unsigned long isc__os_cacheline = ISC_OS_CACHELINE_SIZE;
 static mode_t isc__os_umask = 0;
 
@@ -170,6 +171,42 @@ ncpus_initialize(void) {
 
 #endif /* UV_VERSION_HEX >= UV_VERSION(1, 38, 0) */
 
+#if defined(__linux__)
+#include <stdio.h>
+
+/*
+ * The online nodes are listed as ranges, like "0-1" or "0,2-3"; we only
+ * need the highest node number.
+ */
+static void
+numanodes_initialize(void) {
+	FILE *fp = fopen("/sys/devices/system/node/online", "r");
+	unsigned int first, last;
+	int n;
+
+	if (fp == NULL) {
+		return;
+	}
+	while ((n = fscanf(fp, "%u-%u", &first, &last)) >= 1) {
+		if (n == 1) {
+			last = first;
+		}
+		if (last + 1 > isc__os_numanodes) {
+			isc__os_numanodes = last + 1;
+		}
+		if (fgetc(fp) != ',') {
+			break;
+		}
+	}
+	(void)fclose(fp);
+}
+#else  /* __linux__ */
+static void
+numanodes_initialize(void) {
+	/* one node */
+}
+#endif /* __linux__ */
+
 static void
 umask_initialize(void) {
 	isc__os_umask = umask(0);
@@ -181,6 +218,11 @@ isc_os_ncpus(void) {
 	return (isc__os_ncpus);
 }
 
+unsigned int
+isc_os_numanodes(void) {
+	return (isc__os_numanodes);
+}
+
 unsigned long
 isc_os_cacheline(void) {
 	return (isc__os_cacheline);
@@ -195,6 +237,7 @@ void
 isc__os_initialize(void) {
 	umask_initialize();
 	ncpus_initialize();
+	numanodes_initialize();
 #if defined(_SC_LEVEL1_DCACHE_LINESIZE)
 	long s = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
 	if (s > 0 && (unsigned long)s > isc__os_cacheline) {
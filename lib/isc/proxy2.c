@@ -11,6 +11,9 @@
  * information regarding copyright ownership.
  */
 
+#include <stddef.h>
+#include <string.h>
+
 #include <isc/proxy2.h>
 
 enum isc_proxy2_states {
@@ -20,13 +23,25 @@ enum isc_proxy2_states {
 	ISC_PROXY2_STATE_END
 };
 
+/*
+ * Zero the handler state, but not the header buffer storage at its end:
+ * it is either overwritten by the received data before it is read, or
+ * not used at all when the data is handled directly, and clearing it
+ * for every header would be wasted work.
+ */
+static inline void
+isc__proxy2_handler_reset(isc_proxy2_handler_t *restrict handler) {
+	memset(handler, 0, offsetof(isc_proxy2_handler_t, buf));
+	handler->result = ISC_R_UNSET;
+}
+
 static inline void
 isc__proxy2_handler_init_direct(isc_proxy2_handler_t *restrict handler,
 				const uint16_t max_size,
 				const isc_region_t *restrict data,
 				isc_proxy2_handler_cb_t cb, void *cbarg) {
-	*handler = (isc_proxy2_handler_t){ .result = ISC_R_UNSET,
-					   .max_size = max_size };
+	isc__proxy2_handler_reset(handler);
+	handler->max_size = max_size;
 	isc_proxy2_handler_setcb(handler, cb, cbarg);
 
 	if (data == NULL) {
@@ -73,12 +88,18 @@ void
 isc_proxy2_handler_clear(isc_proxy2_handler_t *restrict handler) {
 	REQUIRE(handler != NULL);
 
-	*handler = (isc_proxy2_handler_t){ .result = ISC_R_UNSET,
-					   .mctx = handler->mctx,
-					   .cb = handler->cb,
-					   .cbarg = handler->cbarg,
-					   .hdrbuf = handler->hdrbuf,
-					   .max_size = handler->max_size };
+	isc_buffer_t hdrbuf = handler->hdrbuf;
+	isc_mem_t *mctx = handler->mctx;
+	isc_proxy2_handler_cb_t cb = handler->cb;
+	void *cbarg = handler->cbarg;
+	uint16_t max_size = handler->max_size;
+
+	isc__proxy2_handler_reset(handler);
+	handler->hdrbuf = hdrbuf;
+	handler->mctx = mctx;
+	handler->cb = cb;
+	handler->cbarg = cbarg;
+	handler->max_size = max_size;
 
 	isc_buffer_clear(&handler->hdrbuf);
 	isc_buffer_trycompact(&handler->hdrbuf);
@@ -1058,7 +1079,7 @@ isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
 				  const isc_proxy2_handler_cb_t cb,
 				  void *cbarg) {
 	isc_result_t result;
-	isc_proxy2_handler_t handler = { 0 };
+	isc_proxy2_handler_t handler;
 
 	REQUIRE(header_data != NULL);
 	REQUIRE(cb != NULL);
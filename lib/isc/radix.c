@@ -18,6 +18,7 @@
  */
 
 #include <inttypes.h>
+#include <stdlib.h>
 
 #include <isc/mem.h>
 #include <isc/radix.h>
@@ -42,6 +43,29 @@ _comp_with_mask(void *addr, void *dest, u_int mask);
 static void
 _clear_radix(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func);
 
+static void
+_free_v4table(isc_radix_tree_t *radix);
+
+/*
+ * The compiled IPv4 table.  Every entry is either 0 for no match, the
+ * index plus one of the matching node in 'nodes', or V4_CHUNK plus the
+ * number of a chunk of V4_CHUNKSIZE entries for the next 8 bits of the
+ * address.  The first level, indexed by the top 16 bits, is inline.
+ */
+#define V4_MINNODES  64
+#define V4_CHUNK     0x80000000U
+#define V4_L1SIZE    65536
+#define V4_CHUNKSIZE 256
+
+struct isc_radix_v4table {
+	uint32_t	   l1[V4_L1SIZE];
+	uint32_t	  *chunks;
+	size_t		   nchunks;
+	size_t		   chunkalloc;
+	isc_radix_node_t **nodes;
+	size_t		   nnodes;
+};
+
 static isc_result_t
 _new_prefix(isc_mem_t *mctx, isc_prefix_t **target, int family, void *dest,
 	    int bitlen) {
@@ -196,6 +220,7 @@ _clear_radix(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func) {
 void
 isc_radix_destroy(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func) {
 	REQUIRE(radix != NULL);
+	_free_v4table(radix);
 	_clear_radix(radix, func);
 	isc_mem_putanddetach(&radix->mctx, radix, sizeof(*radix));
 }
@@ -213,6 +238,178 @@ isc_radix_process(isc_radix_tree_t *radix, isc_radix_processfunc_t func) {
 	RADIX_WALK_END;
 }
 
+static void
+_free_v4table(isc_radix_tree_t *radix) {
+	isc_radix_v4table_t *t = radix->v4table;
+
+	if (t == NULL) {
+		return;
+	}
+
+	radix->v4table = NULL;
+	if (t->chunks != NULL) {
+		isc_mem_cput(radix->mctx, t->chunks,
+			     t->chunkalloc * V4_CHUNKSIZE, sizeof(t->chunks[0]));
+	}
+	isc_mem_cput(radix->mctx, t->nodes, t->nnodes, sizeof(t->nodes[0]));
+	isc_mem_put(radix->mctx, t, sizeof(*t));
+}
+
+static uint32_t *
+_v4_slot(isc_radix_v4table_t *t, unsigned int level, uint32_t chunk,
+	 uint32_t i) {
+	if (level == 0) {
+		return (&t->l1[i]);
+	}
+	return (&t->chunks[chunk * V4_CHUNKSIZE + i]);
+}
+
+static uint32_t
+_v4_newchunk(isc_mem_t *mctx, isc_radix_v4table_t *t) {
+	if (t->nchunks == t->chunkalloc) {
+		size_t n = ISC_MAX(16, t->chunkalloc * 2);
+		t->chunks = isc_mem_creget(mctx, t->chunks,
+					   t->chunkalloc * V4_CHUNKSIZE,
+					   n * V4_CHUNKSIZE,
+					   sizeof(t->chunks[0]));
+		t->chunkalloc = n;
+	}
+	INSIST(t->nchunks < V4_CHUNK);
+	return (t->nchunks++);
+}
+
+/*
+ * Give every address below slot 'i' that has no match yet the node
+ * 'leaf'.
+ */
+static void
+_v4_fill(isc_radix_v4table_t *t, unsigned int level, uint32_t chunk,
+	 uint32_t i, uint32_t leaf) {
+	uint32_t *slot = _v4_slot(t, level, chunk, i);
+
+	if (*slot == 0) {
+		*slot = leaf;
+	} else if ((*slot & V4_CHUNK) != 0) {
+		uint32_t next = *slot & ~V4_CHUNK;
+		for (uint32_t j = 0; j < V4_CHUNKSIZE; j++) {
+			_v4_fill(t, level + 1, next, j, leaf);
+		}
+	}
+}
+
+/*
+ * Add the prefix 'addr'/'bitlen' to the table.  Prefixes are added
+ * in node_num order, so an address that already has a match keeps it
+ * and "first match" is preserved.
+ */
+static void
+_v4_add(isc_mem_t *mctx, isc_radix_v4table_t *t, unsigned int level,
+	uint32_t chunk, uint32_t addr, uint32_t bitlen, uint32_t leaf) {
+	static const unsigned int shift[] = { 16, 8, 0 };
+	static const unsigned int end[] = { 16, 24, 32 };
+	uint32_t i = addr >> shift[level];
+	uint32_t n;
+
+	i &= (level == 0) ? V4_L1SIZE - 1 : V4_CHUNKSIZE - 1;
+
+	if (bitlen > end[level]) {
+		uint32_t slot = *_v4_slot(t, level, chunk, i);
+
+		if (slot == 0) {
+			slot = V4_CHUNK | _v4_newchunk(mctx, t);
+			*_v4_slot(t, level, chunk, i) = slot;
+		} else if ((slot & V4_CHUNK) == 0) {
+			/* Already matched by an earlier prefix */
+			return;
+		}
+		_v4_add(mctx, t, level + 1, slot & ~V4_CHUNK, addr, bitlen,
+			leaf);
+		return;
+	}
+
+	n = 1U << (end[level] - bitlen);
+	i &= ~(n - 1);
+	for (uint32_t j = i; j < i + n; j++) {
+		_v4_fill(t, level, chunk, j, leaf);
+	}
+}
+
+static int
+_v4_cmp(const void *a, const void *b) {
+	const isc_radix_node_t *na = *(isc_radix_node_t *const *)a;
+	const isc_radix_node_t *nb = *(isc_radix_node_t *const *)b;
+
+	return ((na->node_num[RADIX_V4] > nb->node_num[RADIX_V4]) -
+		(na->node_num[RADIX_V4] < nb->node_num[RADIX_V4]));
+}
+
+void
+isc_radix_compile(isc_radix_tree_t *radix) {
+	isc_radix_v4table_t *t = NULL;
+	isc_radix_node_t *node = NULL;
+	isc_radix_node_t **nodes = NULL;
+	size_t n = 0;
+
+	REQUIRE(radix != NULL);
+
+	_free_v4table(radix);
+
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[RADIX_V4] != -1) {
+			n++;
+		}
+	}
+	RADIX_WALK_END;
+
+	if (n < V4_MINNODES) {
+		return;
+	}
+
+	nodes = isc_mem_cget(radix->mctx, n, sizeof(nodes[0]));
+	n = 0;
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[RADIX_V4] != -1) {
+			nodes[n++] = node;
+		}
+	}
+	RADIX_WALK_END;
+	qsort(nodes, n, sizeof(nodes[0]), _v4_cmp);
+
+	t = isc_mem_get(radix->mctx, sizeof(*t));
+	memset(t, 0, sizeof(*t));
+	for (size_t i = 0; i < n; i++) {
+		isc_prefix_t *prefix = nodes[i]->prefix;
+
+		/*
+		 * The prefix may be an IPv6 one sharing the node, but
+		 * its length and leading bits are the IPv4 prefix's.
+		 */
+		INSIST(prefix->bitlen <= 32);
+		_v4_add(radix->mctx, t, 0, 0, ntohl(prefix->add.sin.s_addr),
+			prefix->bitlen, i + 1);
+	}
+	t->nodes = nodes;
+	t->nnodes = n;
+
+	radix->v4table = t;
+}
+
+static isc_radix_node_t *
+_v4_search(isc_radix_v4table_t *t, uint32_t addr) {
+	uint32_t e = t->l1[addr >> 16];
+
+	if ((e & V4_CHUNK) != 0) {
+		e = t->chunks[(e & ~V4_CHUNK) * V4_CHUNKSIZE +
+			      ((addr >> 8) & 0xff)];
+		if ((e & V4_CHUNK) != 0) {
+			e = t->chunks[(e & ~V4_CHUNK) * V4_CHUNKSIZE +
+				      (addr & 0xff)];
+		}
+	}
+
+	return ((e == 0) ? NULL : t->nodes[e - 1]);
+}
+
 isc_result_t
 isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 		 isc_prefix_t *prefix) {
@@ -229,6 +426,14 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 
 	*target = NULL;
 
+	if (radix->v4table != NULL && prefix->family == AF_INET &&
+	    prefix->bitlen == 32)
+	{
+		*target = _v4_search(radix->v4table,
+				     ntohl(prefix->add.sin.s_addr));
+		return ((*target == NULL) ? ISC_R_NOTFOUND : ISC_R_SUCCESS);
+	}
+
 	node = radix->head;
 
 	if (node == NULL) {
@@ -298,6 +503,8 @@ isc_radix_insert(isc_radix_tree_t *radix, isc_radix_node_t **target,
 	REQUIRE(prefix != NULL || (source != NULL && source->prefix != NULL));
 	RUNTIME_CHECK(prefix == NULL || prefix->bitlen <= radix->maxbits);
 
+	_free_v4table(radix);
+
 	if (prefix == NULL) {
 		prefix = source->prefix;
 	}
@@ -609,6 +816,8 @@ isc_radix_remove(isc_radix_tree_t *radix, isc_radix_node_t *node) {
 	REQUIRE(radix != NULL);
 	REQUIRE(node != NULL);
 
+	_free_v4table(radix);
+
 	if (node->r && node->l) {
 		/*
 		 * This might be a placeholder node -- have to check and
@@ -265,7 +265,7 @@ unlock:
 
 	while ((rle = ISC_LIST_HEAD(pending)) != NULL) {
 		ISC_LIST_UNLINK(pending, rle, link);
-		isc_async_run(rle->loop, rle->cb, rle->arg);
+		isc_async_background(rle->loop, rle->cb, rle->arg);
 	}
 }
 
@@ -60,6 +60,7 @@
 #include <isc/rwlock.h>
 #include <isc/thread.h>
 #include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include "probes.h"
@@ -77,7 +78,7 @@ static atomic_uint_fast16_t isc__crwlock_workers = 128;
 #define RWLOCK_MAX_READER_PATIENCE 500
 #endif /* ifndef RWLOCK_MAX_READER_PATIENCE */
 
-static void
+static uint32_t
 read_indicator_wait_until_empty(isc_rwlock_t *rwl);
 
 #include <stdio.h>
@@ -134,9 +135,67 @@ writers_lock_release(isc_rwlock_t *rwl) {
 
 #define ran_out_of_patience(cnt) (cnt >= RWLOCK_MAX_READER_PATIENCE)
 
+/*
+ * Lock profiling; the wait is only timed once the lock turned out to be
+ * contended, so that uncontended acquisitions read the clock at most once.
+ */
+static uint64_t
+rwlock_prof_start(void) {
+#if ISC_LOCK_PROFILE
+	if (isc__lockprof_active()) {
+		return (isc_time_monotonic());
+	}
+#endif /* ISC_LOCK_PROFILE */
+	return (0);
+}
+
+static void
+rwlock_prof_rdacquired(isc_rwlock_t *rwl, uint64_t start) {
+#if ISC_LOCK_PROFILE
+	if (isc__lockprof_active()) {
+		isc__lockprof_acquired(
+			rwl->prof, start != 0,
+			start != 0 ? isc_time_monotonic() - start : 0);
+	}
+#else  /* ISC_LOCK_PROFILE */
+	UNUSED(rwl);
+	UNUSED(start);
+#endif /* ISC_LOCK_PROFILE */
+}
+
+static void
+rwlock_prof_wracquired(isc_rwlock_t *rwl, uint64_t start) {
+#if ISC_LOCK_PROFILE
+	rwl->wracquired = 0;
+	if (isc__lockprof_active()) {
+		rwl->wracquired = isc_time_monotonic();
+		isc__lockprof_acquired(
+			rwl->prof, start != 0,
+			start != 0 ? rwl->wracquired - start : 0);
+	}
+#else  /* ISC_LOCK_PROFILE */
+	UNUSED(rwl);
+	UNUSED(start);
+#endif /* ISC_LOCK_PROFILE */
+}
+
+static void
+rwlock_prof_wrreleased(isc_rwlock_t *rwl) {
+#if ISC_LOCK_PROFILE
+	if (rwl->wracquired != 0) {
+		isc__lockprof_released(rwl->prof,
+				       isc_time_monotonic() - rwl->wracquired);
+		rwl->wracquired = 0;
+	}
+#else  /* ISC_LOCK_PROFILE */
+	UNUSED(rwl);
+#endif /* ISC_LOCK_PROFILE */
+}
+
 void
 isc_rwlock_rdlock(isc_rwlock_t *rwl) {
 	uint32_t cnt = 0;
+	uint64_t start = 0;
 	bool barrier_raised = false;
 
 	LIBISC_RWLOCK_RDLOCK_REQ(rwl);
@@ -150,6 +209,9 @@ isc_rwlock_rdlock(isc_rwlock_t *rwl) {
 
 		/* Writer has acquired the lock, must reset to 0 and wait */
 		read_indicator_depart(rwl);
+		if (start == 0) {
+			start = rwlock_prof_start();
+		}
 
 		while (writers_lock_islocked(rwl)) {
 			isc_pause();
@@ -162,6 +224,10 @@ isc_rwlock_rdlock(isc_rwlock_t *rwl) {
 	if (barrier_raised) {
 		writers_barrier_lower(rwl);
 	}
+	if (cnt > 0) {
+		LIBISC_RWLOCK_RDLOCK_CONTENDED(rwl, cnt);
+	}
+	rwlock_prof_rdacquired(rwl, start);
 
 	LIBISC_RWLOCK_RDLOCK_ACQ(rwl);
 }
@@ -178,6 +244,7 @@ isc_rwlock_tryrdlock(isc_rwlock_t *rwl) {
 	}
 
 	/* Acquired lock in read-only mode */
+	rwlock_prof_rdacquired(rwl, 0);
 	LIBISC_RWLOCK_TRYRDLOCK(rwl, ISC_R_SUCCESS);
 	return (ISC_R_SUCCESS);
 }
@@ -214,42 +281,65 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 		LIBISC_RWLOCK_TRYUPGRADE(rwl, ISC_R_LOCKBUSY);
 		return (ISC_R_LOCKBUSY);
 	}
+	rwlock_prof_wracquired(rwl, 0);
 	LIBISC_RWLOCK_TRYUPGRADE(rwl, ISC_R_SUCCESS);
 	return (ISC_R_SUCCESS);
 }
 
-static void
+static uint32_t
 read_indicator_wait_until_empty(isc_rwlock_t *rwl) {
+	uint32_t cnt = 0;
+
 	/* Write-lock was acquired, now wait for running Readers to finish */
 	while (true) {
 		if (read_indicator_isempty(rwl)) {
 			break;
 		}
 		isc_pause();
+		cnt++;
 	}
+
+	return (cnt);
 }
 
 void
 isc_rwlock_wrlock(isc_rwlock_t *rwl) {
+	uint32_t cnt = 0;
+	uint64_t start = 0;
+
 	LIBISC_RWLOCK_WRLOCK_REQ(rwl);
 
 	/* Write Barriers has been raised, wait */
 	while (writers_barrier_israised(rwl)) {
+		if (cnt++ == 0) {
+			start = rwlock_prof_start();
+		}
 		isc_pause();
 	}
 
 	/* Try to acquire the write-lock */
 	while (!writers_lock_acquire(rwl)) {
+		if (cnt++ == 0) {
+			start = rwlock_prof_start();
+		}
 		isc_pause();
 	}
 
-	read_indicator_wait_until_empty(rwl);
+	if (cnt == 0 && !read_indicator_isempty(rwl)) {
+		start = rwlock_prof_start();
+	}
+	cnt += read_indicator_wait_until_empty(rwl);
+	if (cnt > 0) {
+		LIBISC_RWLOCK_WRLOCK_CONTENDED(rwl, cnt);
+	}
+	rwlock_prof_wracquired(rwl, start);
 
 	LIBISC_RWLOCK_WRLOCK_ACQ(rwl);
 }
 
 void
 isc_rwlock_wrunlock(isc_rwlock_t *rwl) {
+	rwlock_prof_wrreleased(rwl);
 	writers_lock_release(rwl);
 	LIBISC_RWLOCK_WRUNLOCK(rwl);
 }
@@ -276,6 +366,7 @@ isc_rwlock_trywrlock(isc_rwlock_t *rwl) {
 		return (ISC_R_LOCKBUSY);
 	}
 
+	rwlock_prof_wracquired(rwl, 0);
 	LIBISC_RWLOCK_TRYWRLOCK(rwl, ISC_R_SUCCESS);
 	return (ISC_R_SUCCESS);
 }
@@ -284,13 +375,14 @@ void
 isc_rwlock_downgrade(isc_rwlock_t *rwl) {
 	read_indicator_arrive(rwl);
 
+	rwlock_prof_wrreleased(rwl);
 	writers_lock_release(rwl);
 
 	LIBISC_RWLOCK_DOWNGRADE(rwl);
 }
 
-void
-isc_rwlock_init(isc_rwlock_t *rwl) {
+static void
+rwlock_init(isc_rwlock_t *rwl) {
 	REQUIRE(rwl != NULL);
 
 	atomic_init(&rwl->writers_lock, ISC_RWLOCK_UNLOCKED);
@@ -300,6 +392,20 @@ isc_rwlock_init(isc_rwlock_t *rwl) {
 	LIBISC_RWLOCK_INIT(rwl);
 }
 
+#if ISC_LOCK_PROFILE
+void
+isc__rwlock_profinit(isc_rwlock_t *rwl, isc_lockprof_t *prof) {
+	rwlock_init(rwl);
+	rwl->prof = prof;
+	rwl->wracquired = 0;
+}
+#else  /* ISC_LOCK_PROFILE */
+void
+isc_rwlock_init(isc_rwlock_t *rwl) {
+	rwlock_init(rwl);
+}
+#endif /* ISC_LOCK_PROFILE */
+
 void
 isc_rwlock_destroy(isc_rwlock_t *rwl) {
 	LIBISC_RWLOCK_DESTROY(rwl);
@@ -20,8 +20,10 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC	   ISC_MAGIC('S', 't', 'a', 't')
@@ -37,14 +39,77 @@
 STATIC_ASSERT(sizeof(isc_statscounter_t) <= sizeof(uint64_t),
 	      "Exported statistics must fit into the statistic counter size");
 
+/*
+ * Sharded statistics keep one row of counters per loop thread, plus the
+ * shared row 0 which is used by all the other threads.  Each loop is the
+ * only writer of its own row, so it can update the counters there with a
+ * plain load and store instead of an atomic read-modify-write, and the rows
+ * are padded to the cache line size so that the loops do not contend for
+ * the same cache lines.  The values reported are the sums over all rows.
+ */
+#define STATS_PER_CACHELINE \
+	(ISC_OS_CACHELINE_SIZE / sizeof(isc_atomic_statscounter_t))
+
 struct isc_stats {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	int ncounters;
+	uint32_t nshards;
+	size_t stride;
 	isc_atomic_statscounter_t *counters;
 };
 
+static size_t
+stats_stride(isc_stats_t *stats, int ncounters) {
+	if (stats->nshards == 1) {
+		return (ncounters);
+	}
+	return (ISC_ALIGN((size_t)ncounters, STATS_PER_CACHELINE));
+}
+
+static isc_atomic_statscounter_t *
+stats_alloc(isc_stats_t *stats, size_t stride) {
+	size_t n = stats->nshards * stride;
+	isc_atomic_statscounter_t *counters =
+		isc_mem_get(stats->mctx, n * sizeof(counters[0]));
+
+	for (size_t i = 0; i < n; i++) {
+		atomic_init(&counters[i], 0);
+	}
+
+	return (counters);
+}
+
+static isc_statscounter_t
+stats_add(isc_stats_t *stats, isc_statscounter_t counter,
+	  isc_statscounter_t value) {
+	uint32_t tid = isc_tid();
+
+	if (tid < stats->nshards - 1) {
+		isc_atomic_statscounter_t *local =
+			&stats->counters[(tid + 1) * stats->stride + counter];
+		isc_statscounter_t curr_value = atomic_load_relaxed(local);
+
+		atomic_store_relaxed(local, curr_value + value);
+		return (curr_value);
+	}
+
+	return (atomic_fetch_add_relaxed(&stats->counters[counter], value));
+}
+
+static isc_statscounter_t
+stats_get(isc_stats_t *stats, isc_statscounter_t counter) {
+	isc_statscounter_t value = 0;
+
+	for (uint32_t i = 0; i < stats->nshards; i++) {
+		value += atomic_load_acquire(
+			&stats->counters[i * stats->stride + counter]);
+	}
+
+	return (value);
+}
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp) {
 	REQUIRE(ISC_STATS_VALID(stats));
@@ -65,7 +130,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 
 	if (isc_refcount_decrement(&stats->references) == 1) {
 		isc_refcount_destroy(&stats->references);
-		isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
+		isc_mem_cput(stats->mctx, stats->counters,
+			     stats->nshards * stats->stride,
 			     sizeof(isc_atomic_statscounter_t));
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
 	}
@@ -78,37 +144,62 @@ isc_stats_ncounters(isc_stats_t *stats) {
 	return (stats->ncounters);
 }
 
-void
-isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
+static void
+stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+	     uint32_t nshards) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	isc_stats_t *stats = isc_mem_get(mctx, sizeof(*stats));
-	size_t counters_alloc_size = sizeof(isc_atomic_statscounter_t) *
-				     ncounters;
-	stats->counters = isc_mem_get(mctx, counters_alloc_size);
-	isc_refcount_init(&stats->references, 1);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&stats->counters[i], 0);
-	}
-	stats->mctx = NULL;
+	*stats = (isc_stats_t){
+		.ncounters = ncounters,
+		.nshards = nshards,
+	};
 	isc_mem_attach(mctx, &stats->mctx);
-	stats->ncounters = ncounters;
+	stats->stride = stats_stride(stats, ncounters);
+	stats->counters = stats_alloc(stats, stats->stride);
+	isc_refcount_init(&stats->references, 1);
 	stats->magic = ISC_STATS_MAGIC;
 	*statsp = stats;
 }
 
+void
+isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
+	stats_create(mctx, statsp, ncounters, 1);
+}
+
+void
+isc_stats_create_sharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			 int ncounters) {
+	stats_create(mctx, statsp, ncounters, isc_tid_count() + 1);
+}
+
 isc_statscounter_t
 isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return (atomic_fetch_add_relaxed(&stats->counters[counter], 1));
+	return (stats_add(stats, counter, 1));
+}
+
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter,
+	      isc_statscounter_t value) {
+	REQUIRE(ISC_STATS_VALID(stats));
+	REQUIRE(counter < stats->ncounters);
+
+	(void)stats_add(stats, counter, value);
 }
 
 void
 isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
+
+	if (stats->nshards > 1) {
+		/* Only the sum of the rows can be checked for underflow */
+		(void)stats_add(stats, counter, -1);
+		return;
+	}
 #if ISC_STATS_CHECKUNDERFLOW
 	REQUIRE(atomic_fetch_sub_release(&stats->counters[counter], 1) > 0);
 #else
@@ -124,8 +215,7 @@ isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	REQUIRE(ISC_STATS_VALID(stats));
 
 	for (i = 0; i < stats->ncounters; i++) {
-		isc_statscounter_t counter =
-			atomic_load_acquire(&stats->counters[i]);
+		isc_statscounter_t counter = stats_get(stats, i);
 		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && counter == 0) {
 			continue;
 		}
@@ -138,6 +228,10 @@ isc_stats_set(isc_stats_t *stats, uint64_t val, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	for (uint32_t i = 1; i < stats->nshards; i++) {
+		atomic_store_release(
+			&stats->counters[i * stats->stride + counter], 0);
+	}
 	atomic_store_release(&stats->counters[counter], val);
 }
 
@@ -147,6 +241,10 @@ isc_stats_update_if_greater(isc_stats_t *stats, isc_statscounter_t counter,
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	/*
+	 * Counters maintained this way are never incremented, so in
+	 * sharded statistics their value lives in the shared row.
+	 */
 	isc_statscounter_t curr_value =
 		atomic_load_acquire(&stats->counters[counter]);
 	do {
@@ -162,13 +260,13 @@ isc_stats_get_counter(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return (atomic_load_acquire(&stats->counters[counter]));
+	return (stats_get(stats, counter));
 }
 
 void
 isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
+	size_t newstride;
 	isc_atomic_statscounter_t *newcounters;
 
 	REQUIRE(statsp != NULL && *statsp != NULL);
@@ -182,17 +280,20 @@ isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	}
 
 	/* Grow number of counters. */
-	counters_alloc_size = sizeof(isc_atomic_statscounter_t) * ncounters;
-	newcounters = isc_mem_get(stats->mctx, counters_alloc_size);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&newcounters[i], 0);
-	}
-	for (int i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
-		atomic_store_release(&newcounters[i], counter);
+	newstride = stats_stride(stats, ncounters);
+	newcounters = stats_alloc(stats, newstride);
+	for (uint32_t s = 0; s < stats->nshards; s++) {
+		for (int i = 0; i < stats->ncounters; i++) {
+			isc_statscounter_t counter = atomic_load_acquire(
+				&stats->counters[s * stats->stride + i]);
+			atomic_store_release(&newcounters[s * newstride + i],
+					     counter);
+		}
 	}
-	isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
+	isc_mem_cput(stats->mctx, stats->counters,
+		     stats->nshards * stats->stride,
 		     sizeof(isc_atomic_statscounter_t));
 	stats->counters = newcounters;
+	stats->stride = newstride;
 	stats->ncounters = ncounters;
 }
@@ -15,7 +15,7 @@
 
 #include <stdbool.h>
 
-#include <isc/ascii.h>
+#include <isc/hash.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/string.h>
@@ -109,25 +109,11 @@ isc_symtab_destroy(isc_symtab_t **symtabp) {
 
 static unsigned int
 hash(const char *key, bool case_sensitive) {
-	const char *s;
-	unsigned int h = 0;
-
 	/*
-	 * This hash function is similar to the one Ousterhout
-	 * uses in Tcl.
+	 * The tables grow by doubling, so the bucket is taken modulo a
+	 * size that is not prime; use a hash that mixes all of its bits.
 	 */
-
-	if (case_sensitive) {
-		for (s = key; *s != '\0'; s++) {
-			h += (h << 3) + *s;
-		}
-	} else {
-		for (s = key; *s != '\0'; s++) {
-			h += (h << 3) + isc_ascii_tolower(*s);
-		}
-	}
-
-	return (h);
+	return (isc_hash32(key, strlen(key), case_sensitive));
 }
 
 #define FIND(s, k, t, b, e)                                                   \
@@ -13,14 +13,14 @@
 
 /*! \file */
 
-#if defined(HAVE_SCHED_H)
+#if defined(HAVE_SCHED_H) || defined(HAVE_SCHED_GETAFFINITY)
 #include <sched.h>
-#endif /* if defined(HAVE_SCHED_H) */
+#endif /* if defined(HAVE_SCHED_H) || defined(HAVE_SCHED_GETAFFINITY) */
 
-#if defined(HAVE_CPUSET_H)
+#if defined(HAVE_CPUSET_H) || defined(HAVE_CPUSET_GETAFFINITY)
 #include <sys/cpuset.h>
 #include <sys/param.h>
-#endif /* if defined(HAVE_CPUSET_H) */
+#endif /* if defined(HAVE_CPUSET_H) || defined(HAVE_CPUSET_GETAFFINITY) */
 
 #if defined(HAVE_SYS_PROCSET_H)
 #include <sys/processor.h>
@@ -169,6 +169,39 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 #endif /* if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__) */
 }
 
+isc_result_t
+isc_thread_setaffinity(isc_thread_t thread, int cpu) {
+	REQUIRE(cpu >= 0);
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(HAVE_CPUSET_GETAFFINITY)
+	cpuset_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0) {
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(HAVE_SCHED_GETAFFINITY)
+	cpu_set_t cpus;
+
+	if (cpu >= CPU_SETSIZE) {
+		return (ISC_R_RANGE);
+	}
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0) {
+		return (ISC_R_FAILURE);
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(thread);
+	UNUSED(cpu);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
@@ -13,8 +13,11 @@
 
 #include <stdlib.h>
 
+#include <isc/async.h>
 #include <isc/job.h>
+#include <isc/list.h>
 #include <isc/loop.h>
+#include <isc/mutex.h>
 #include <isc/urcu.h>
 #include <isc/uv.h>
 #include <isc/work.h>
@@ -32,6 +35,39 @@ isc__work_cb(uv_work_t *req) {
 	rcu_unregister_thread();
 }
 
+static void
+isc__work_queue(isc_work_t *work);
+
+static void
+isc__work_queue_job(void *arg) {
+	isc__work_queue(arg);
+}
+
+/*
+ * A bulk work item has finished: hand its slot over to the oldest
+ * pending bulk work item, if there is one.  The pending item may belong
+ * to a different loop, and uv_queue_work() has to be called from the
+ * loop the work will be reported back to.
+ */
+static void
+isc__work_bulk_done(isc_loopmgr_t *loopmgr) {
+	isc_work_t *next = NULL;
+
+	LOCK(&loopmgr->work_lock);
+	next = ISC_LIST_HEAD(loopmgr->work_pending);
+	if (next != NULL) {
+		ISC_LIST_UNLINK(loopmgr->work_pending, next, link);
+	} else {
+		INSIST(loopmgr->work_running > 0);
+		loopmgr->work_running--;
+	}
+	UNLOCK(&loopmgr->work_lock);
+
+	if (next != NULL) {
+		isc_async_run(next->loop, isc__work_queue_job, next);
+	}
+}
+
 static void
 isc__after_work_cb(uv_work_t *req, int status) {
 	isc_work_t *work = uv_req_get_data((uv_req_t *)req);
@@ -39,6 +75,10 @@ isc__after_work_cb(uv_work_t *req, int status) {
 
 	UV_RUNTIME_CHECK(uv_after_work_cb, status);
 
+	if (work->bulk) {
+		isc__work_bulk_done(loop->loopmgr);
+	}
+
 	work->after_work_cb(work->cbarg);
 
 	isc_mem_put(loop->mctx, work, sizeof(*work));
@@ -46,11 +86,17 @@ isc__after_work_cb(uv_work_t *req, int status) {
 	isc_loop_detach(&loop);
 }
 
-void
-isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
-		 isc_after_work_cb after_work_cb, void *cbarg) {
+static void
+isc__work_queue(isc_work_t *work) {
+	int r = uv_queue_work(&work->loop->loop, &work->work, isc__work_cb,
+			      isc__after_work_cb);
+	UV_RUNTIME_CHECK(uv_queue_work, r);
+}
+
+static isc_work_t *
+isc__work_new(isc_loop_t *loop, isc_work_cb work_cb,
+	      isc_after_work_cb after_work_cb, void *cbarg, bool bulk) {
 	isc_work_t *work = NULL;
-	int r;
 
 	REQUIRE(VALID_LOOP(loop));
 	REQUIRE(work_cb != NULL);
@@ -61,13 +107,44 @@ isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
 		.work_cb = work_cb,
 		.after_work_cb = after_work_cb,
 		.cbarg = cbarg,
+		.bulk = bulk,
+		.link = ISC_LINK_INITIALIZER,
 	};
 
 	isc_loop_attach(loop, &work->loop);
 
 	uv_req_set_data((uv_req_t *)&work->work, work);
 
-	r = uv_queue_work(&loop->loop, &work->work, isc__work_cb,
-			  isc__after_work_cb);
-	UV_RUNTIME_CHECK(uv_queue_work, r);
+	return (work);
+}
+
+void
+isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
+		 isc_after_work_cb after_work_cb, void *cbarg) {
+	isc_work_t *work = isc__work_new(loop, work_cb, after_work_cb, cbarg,
+					 false);
+
+	isc__work_queue(work);
+}
+
+void
+isc_work_enqueue_bulk(isc_loop_t *loop, isc_work_cb work_cb,
+		      isc_after_work_cb after_work_cb, void *cbarg) {
+	isc_work_t *work = isc__work_new(loop, work_cb, after_work_cb, cbarg,
+					 true);
+	isc_loopmgr_t *loopmgr = loop->loopmgr;
+	bool queue = false;
+
+	LOCK(&loopmgr->work_lock);
+	if (loopmgr->work_running < loopmgr->work_max) {
+		loopmgr->work_running++;
+		queue = true;
+	} else {
+		ISC_LIST_APPEND(loopmgr->work_pending, work, link);
+	}
+	UNLOCK(&loopmgr->work_lock);
+
+	if (queue) {
+		isc__work_queue(work);
+	}
 }
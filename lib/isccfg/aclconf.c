@@ -969,6 +969,9 @@ cfg_acl_fromconfig(const cfg_obj_t *acl_data, const cfg_obj_t *cctx,
 		INSIST(dacl->length <= dacl->alloc);
 	}
 
+	/* The ACL is complete; flatten large address lists for lookups */
+	isc_radix_compile(dacl->iptable->radix);
+
 	dns_acl_attach(dacl, target);
 	result = ISC_R_SUCCESS;
 
@@ -34,6 +34,7 @@
 #include <isc/md.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
+#include <isc/netmgr.h>
 #include <isc/parseint.h>
 #include <isc/region.h>
 #include <isc/result.h>
@@ -91,6 +92,42 @@ freekey(char *key, unsigned int type, isc_symvalue_t value, void *userarg) {
 	isc_mem_free(userarg, key);
 }
 
+/*
+ * Return a symbol table size that holds 'count' entries without the
+ * table having to grow, and is at least 'min'.
+ */
+static unsigned int
+symtab_size(size_t count, unsigned int min) {
+	return (ISC_MAX(min, ISC_MIN(count / 3 * 4 + 4, UINT_MAX / 2)));
+}
+
+/*
+ * Count the zones configured at the top level and in all views.
+ */
+static size_t
+count_zones(const cfg_obj_t *config) {
+	const cfg_obj_t *zones = NULL, *views = NULL;
+	const cfg_listelt_t *element = NULL;
+	size_t count = 0;
+
+	(void)cfg_map_get(config, "zone", &zones);
+	count += cfg_list_length(zones, false);
+
+	(void)cfg_map_get(config, "view", &views);
+	for (element = cfg_list_first(views); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *view = cfg_listelt_value(element);
+		const cfg_obj_t *voptions = cfg_tuple_get(view, "options");
+
+		zones = NULL;
+		(void)cfg_map_get(voptions, "zone", &zones);
+		count += cfg_list_length(zones, false);
+	}
+
+	return (count);
+}
+
 static isc_result_t
 check_orderent(const cfg_obj_t *ent) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1082,6 +1119,7 @@ check_listener(const cfg_obj_t *listener, const cfg_obj_t *config,
 	const cfg_obj_t *portobj = NULL;
 	const cfg_obj_t *http_server = NULL;
 	const cfg_obj_t *proxyobj = NULL;
+	const cfg_obj_t *batchobj = NULL;
 	bool do_tls = false, no_tls = false;
 	dns_acl_t *acl = NULL;
 
@@ -1146,6 +1184,19 @@ check_listener(const cfg_obj_t *listener, const cfg_obj_t *config,
 		}
 	}
 
+	batchobj = cfg_tuple_get(ltup, "udp-recv-batch");
+	if (cfg_obj_isuint32(batchobj) &&
+	    (cfg_obj_asuint32(batchobj) < 1 ||
+	     cfg_obj_asuint32(batchobj) > ISC_NM_UDP_RECVBATCH_MAX))
+	{
+		cfg_obj_log(batchobj, ISC_LOG_ERROR,
+			    "'udp-recv-batch' must be between 1 and %u",
+			    ISC_NM_UDP_RECVBATCH_MAX);
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
 	proxyobj = cfg_tuple_get(ltup, "proxy");
 	if (proxyobj != NULL && cfg_obj_isstring(proxyobj)) {
 		const char *proxyval = cfg_obj_asstring(proxyobj);
@@ -5444,19 +5495,21 @@ check_viewconf(const cfg_obj_t *config, const cfg_obj_t *voptions,
 	 * Check that all zone statements are syntactically correct and
 	 * there are no duplicate zones.
 	 */
-	tresult = isc_symtab_create(mctx, 1000, freekey, mctx, false, &symtab);
-	if (tresult != ISC_R_SUCCESS) {
-		return (ISC_R_NOMEMORY);
-	}
-
-	cfg_aclconfctx_create(mctx, &actx);
-
 	if (voptions != NULL) {
 		(void)cfg_map_get(voptions, "zone", &zones);
 	} else {
 		(void)cfg_map_get(config, "zone", &zones);
 	}
 
+	tresult = isc_symtab_create(
+		mctx, symtab_size(cfg_list_length(zones, false), 1000),
+		freekey, mctx, false, &symtab);
+	if (tresult != ISC_R_SUCCESS) {
+		return (ISC_R_NOMEMORY);
+	}
+
+	cfg_aclconfctx_create(mctx, &actx);
+
 	for (element = cfg_list_first(zones); element != NULL;
 	     element = cfg_list_next(element))
 	{
@@ -6086,6 +6139,7 @@ isccfg_check_namedconf(const cfg_obj_t *config, unsigned int flags,
 	isc_symtab_t *files = NULL;
 	isc_symtab_t *keydirs = NULL;
 	isc_symtab_t *inview = NULL;
+	unsigned int zonetabsize;
 	bool check_algorithms = (flags & BIND_CHECK_ALGORITHMS) != 0;
 
 	static const char *builtin[] = { "localhost", "localnets", "any",
@@ -6146,19 +6200,24 @@ isccfg_check_namedconf(const cfg_obj_t *config, unsigned int flags,
 	 * case sensitive. This will prevent people using FOO.DB and foo.db
 	 * on case sensitive file systems but that shouldn't be a major issue.
 	 */
-	tresult = isc_symtab_create(mctx, 100, NULL, NULL, false, &files);
+	zonetabsize = symtab_size(count_zones(config), 100);
+
+	tresult = isc_symtab_create(mctx, zonetabsize, NULL, NULL, false,
+				    &files);
 	if (tresult != ISC_R_SUCCESS) {
 		result = tresult;
 		goto cleanup;
 	}
 
-	tresult = isc_symtab_create(mctx, 100, freekey, mctx, false, &keydirs);
+	tresult = isc_symtab_create(mctx, zonetabsize, freekey, mctx, false,
+				    &keydirs);
 	if (tresult != ISC_R_SUCCESS) {
 		result = tresult;
 		goto cleanup;
 	}
 
-	tresult = isc_symtab_create(mctx, 100, freekey, mctx, true, &inview);
+	tresult = isc_symtab_create(mctx, zonetabsize, freekey, mctx, true,
+				    &inview);
 	if (tresult != ISC_R_SUCCESS) {
 		result = tresult;
 		goto cleanup;
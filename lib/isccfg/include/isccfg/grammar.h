@@ -74,6 +74,11 @@
 #define CFG_ZONE_INVIEW	    0x00800000
 #define CFG_ZONE_MIRROR	    0x00400000
 
+/*%
+ * Number of entries in a parser's cache of map clause definitions.
+ */
+#define CFG_CLAUSECACHE_SIZE 256
+
 typedef struct cfg_clausedef	 cfg_clausedef_t;
 typedef struct cfg_tuplefielddef cfg_tuplefielddef_t;
 typedef struct cfg_printer	 cfg_printer_t;
@@ -254,6 +259,16 @@ struct cfg_parser {
 
 	cfg_parsecallback_t callback;
 	void		   *callbackarg;
+
+	/*%
+	 * Map clause definitions found recently, indexed by a hash of
+	 * the clause name, so that they need not be searched for again
+	 * for every option of many similar statements, such as zones.
+	 */
+	struct {
+		const cfg_clausedef_t *const *clausesets;
+		const cfg_clausedef_t	     *clause;
+	} clausecache[CFG_CLAUSECACHE_SIZE];
 };
 
 /* Parser context flags */
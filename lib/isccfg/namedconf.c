@@ -100,6 +100,7 @@ static cfg_type_t cfg_type_dnssecpolicy;
 static cfg_type_t cfg_type_dnstap;
 static cfg_type_t cfg_type_dnstapoutput;
 static cfg_type_t cfg_type_dyndb;
+static cfg_type_t cfg_type_evictionpolicy;
 static cfg_type_t cfg_type_http_description;
 static cfg_type_t cfg_type_ixfrdifftype;
 static cfg_type_t cfg_type_ixfrratio;
@@ -154,6 +155,7 @@ static cfg_tuplefielddef_t listenon_tuple_fields[] = {
 	 * Let's follow the protocols encapsulation order (lower->upper), at
 	 * least roughly.
 	 */
+	{ "udp-recv-batch", &cfg_type_uint32, 0 },
 	{ "proxy", &cfg_type_astring, CFG_CLAUSEFLAG_EXPERIMENTAL },
 	{ "tls", &cfg_type_astring, 0 },
 #if HAVE_LIBNGHTTP2
@@ -857,13 +859,14 @@ static cfg_type_t cfg_type_updatemethod = {
 };
 
 /*
- * zone-statistics: full, terse, or none.
+ * zone-statistics: full, terse, compact, or none.
  *
  * for backward compatibility, we also support boolean values.
  * yes represents "full", no represents "terse". in the future we
  * may change no to mean "none".
  */
-static const char *zonestat_enums[] = { "full", "terse", "none", NULL };
+static const char *zonestat_enums[] = { "full", "terse", "compact", "none",
+					NULL };
 static isc_result_t
 parse_zonestat(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	return (cfg_parse_enum_or_other(pctx, type, &cfg_type_boolean, ret));
@@ -898,6 +901,13 @@ static cfg_type_t cfg_type_keylist = { "keylist",
 				       &cfg_rep_list,
 				       &cfg_type_astring };
 
+/*% A list of file names, as in "cache-snapshot-import". */
+static cfg_type_t cfg_type_bracketed_qstringlist = {
+	"bracketed_qstringlist", cfg_parse_bracketed_list,
+	cfg_print_bracketed_list, cfg_doc_bracketed_list,
+	&cfg_rep_list,		 &cfg_type_qstring
+};
+
 /*% A list of dnssec keys, as in "trusted-keys". Deprecated. */
 static cfg_type_t cfg_type_trustedkeys = { "trustedkeys",
 					   cfg_parse_bracketed_list,
@@ -1226,9 +1236,11 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "avoid-v6-udp-ports", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "bindkeys-file", &cfg_type_qstring, CFG_CLAUSEFLAG_TESTONLY },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
+	{ "cache-snapshot-interval", &cfg_type_duration, 0 },
 	{ "cookie-algorithm", &cfg_type_cookiealg, 0 },
 	{ "cookie-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_MULTI },
 	{ "coresize", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cpu-steering", &cfg_type_boolean, 0 },
 	{ "datasize", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "deallocate-on-exit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "directory", &cfg_type_qstring, CFG_CLAUSEFLAG_CALLBACK },
@@ -1236,11 +1248,13 @@ static cfg_clausedef_t options_clauses[] = {
 #ifdef HAVE_DNSTAP
 	{ "dnstap-output", &cfg_type_dnstapoutput, 0 },
 	{ "dnstap-identity", &cfg_type_serverid, 0 },
+	{ "dnstap-sample", &cfg_type_uint32, 0 },
 	{ "dnstap-version", &cfg_type_qstringornone, 0 },
 #else  /* ifdef HAVE_DNSTAP */
 	{ "dnstap-output", &cfg_type_dnstapoutput,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "dnstap-identity", &cfg_type_serverid, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "dnstap-version", &cfg_type_qstringornone,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif /* ifdef HAVE_DNSTAP */
@@ -1291,9 +1305,11 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "listen-on-v6", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "lock-file", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "maintenance-threads", &cfg_type_uint32, 0 },
 	{ "managed-keys-directory", &cfg_type_qstring, 0 },
 	{ "match-mapped-addresses", &cfg_type_boolean, 0 },
 	{ "max-rsa-exponent-size", &cfg_type_uint32, 0 },
+	{ "memory-hugepages", &cfg_type_boolean, 0 },
 	{ "memstatistics", &cfg_type_boolean, 0 },
 	{ "memstatistics-file", &cfg_type_qstring, 0 },
 	{ "multiple-cnames", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -1319,6 +1335,7 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "random-device", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
+	{ "recursive-clients-adaptive", &cfg_type_boolean, 0 },
 	{ "reuseport", &cfg_type_boolean, 0 },
 	{ "reserved-sockets", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "responselog", &cfg_type_boolean, 0 },
@@ -1354,8 +1371,10 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "transfers-out", &cfg_type_uint32, 0 },
 	{ "transfers-per-ns", &cfg_type_uint32, 0 },
 	{ "treat-cr-as-space", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "udp-busy-poll", &cfg_type_uint32, 0 },
 	{ "udp-receive-buffer", &cfg_type_uint32, 0 },
 	{ "udp-send-buffer", &cfg_type_uint32, 0 },
+	{ "udp-send-coalescing", &cfg_type_boolean, 0 },
 	{ "update-quota", &cfg_type_uint32, 0 },
 	{ "use-id-pool", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "use-ixfr", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -1917,6 +1936,7 @@ static cfg_type_t cfg_type_catz = {
  */
 static cfg_clausedef_t rrl_clauses[] = {
 	{ "all-per-second", &cfg_type_uint32, 0 },
+	{ "early-drop", &cfg_type_boolean, 0 },
 	{ "errors-per-second", &cfg_type_uint32, 0 },
 	{ "exempt-clients", &cfg_type_bracketed_aml, 0 },
 	{ "ipv4-prefix-length", &cfg_type_uint32, 0 },
@@ -2037,9 +2057,16 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "allow-recursion", &cfg_type_bracketed_aml, 0 },
 	{ "allow-recursion-on", &cfg_type_bracketed_aml, 0 },
 	{ "allow-v6-synthesis", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "answer-qname-case", &cfg_type_boolean, 0 },
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, 0 },
+	{ "auth-response-cache", &cfg_type_uint32, 0 },
+	{ "cache-eviction-policy", &cfg_type_evictionpolicy, 0 },
+	{ "cache-pack-records", &cfg_type_boolean, 0 },
+	{ "cache-type", &cfg_type_astring, 0 },
 	{ "cache-file", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cache-snapshot-file", &cfg_type_qstring, 0 },
+	{ "cache-snapshot-import", &cfg_type_bracketed_qstringlist, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2146,6 +2173,9 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "rrset-order", &cfg_type_rrsetorder, 0 },
 	{ "send-cookie", &cfg_type_boolean, 0 },
 	{ "servfail-ttl", &cfg_type_duration, 0 },
+	{ "share-cache", &cfg_type_boolean, 0 },
+	{ "shared-zone-data", &cfg_type_boolean, 0 },
+	{ "shared-zone-trie", &cfg_type_boolean, 0 },
 	{ "sortlist", &cfg_type_bracketed_aml, CFG_CLAUSEFLAG_DEPRECATED },
 	{ "stale-answer-enable", &cfg_type_boolean, 0 },
 	{ "stale-answer-client-timeout", &cfg_type_staleanswerclienttimeout,
@@ -2301,8 +2331,10 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "forwarders", &cfg_type_portiplist,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_STUB |
 		  CFG_ZONE_STATICSTUB | CFG_ZONE_FORWARD },
+	{ "journal-group-commit", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "key-directory", &cfg_type_qstring,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "load-on-demand", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "maintain-ixfr-base", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "masterfile-format", &cfg_type_masterformat,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR |
@@ -2369,6 +2401,8 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "request-ixfr-max-diffs", &cfg_type_uint32,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "serial-update-method", &cfg_type_updatemethod, CFG_ZONE_PRIMARY },
+	{ "sig-cache", &cfg_type_boolean,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-nodes", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-signatures", &cfg_type_uint32,
@@ -2507,9 +2541,13 @@ cfg_type_t cfg_type_dnssecpolicyopts = {
 
 /*% The "dynamically loadable zones" statement syntax. */
 
-static cfg_clausedef_t dlz_clauses[] = { { "database", &cfg_type_astring, 0 },
-					 { "search", &cfg_type_boolean, 0 },
-					 { NULL, NULL, 0 } };
+static cfg_clausedef_t dlz_clauses[] = {
+	{ "async-lookups", &cfg_type_uint32, 0 },
+	{ "cache-ttl", &cfg_type_duration, 0 },
+	{ "database", &cfg_type_astring, 0 },
+	{ "search", &cfg_type_boolean, 0 },
+	{ NULL, NULL, 0 }
+};
 static cfg_clausedef_t *dlz_clausesets[] = { dlz_clauses, NULL };
 static cfg_type_t cfg_type_dlz = { "dlz",	  cfg_parse_named_map,
 				   cfg_print_map, cfg_doc_map,
@@ -2649,6 +2687,19 @@ static cfg_type_t cfg_type_printtime = { "printtime",	    parse_printtime,
 					 cfg_print_ustring, doc_printtime,
 					 &cfg_rep_string,   printtime_enums };
 
+static const char *logasync_enums[] = { "drop", "block", NULL };
+static isc_result_t
+parse_logasync(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
+	return (cfg_parse_enum_or_other(pctx, type, &cfg_type_boolean, ret));
+}
+static void
+doc_logasync(cfg_printer_t *pctx, const cfg_type_t *type) {
+	cfg_doc_enum_or_other(pctx, type, &cfg_type_boolean);
+}
+static cfg_type_t cfg_type_logasync = { "logasync",	    parse_logasync,
+					cfg_print_ustring, doc_logasync,
+					&cfg_rep_string,   logasync_enums };
+
 static cfg_clausedef_t channel_clauses[] = {
 	/* Destinations.  We no longer require these to be first. */
 	{ "file", &cfg_type_logfile, 0 },
@@ -2661,6 +2712,7 @@ static cfg_clausedef_t channel_clauses[] = {
 	{ "print-severity", &cfg_type_boolean, 0 },
 	{ "print-category", &cfg_type_boolean, 0 },
 	{ "buffered", &cfg_type_boolean, 0 },
+	{ "async", &cfg_type_logasync, 0 },
 	{ NULL, NULL, 0 }
 };
 static cfg_clausedef_t *channel_clausesets[] = { channel_clauses, NULL };
@@ -3055,6 +3107,13 @@ static cfg_type_t cfg_type_qminmethod = { "qminmethod",	     cfg_parse_enum,
 					  cfg_print_ustring, cfg_doc_enum,
 					  &cfg_rep_string,   qminmethod_enums };
 
+static const char *evictionpolicy_enums[] = { "lru", "sieve", NULL };
+
+static cfg_type_t cfg_type_evictionpolicy = {
+	"evictionpolicy", cfg_parse_enum,  cfg_print_ustring,
+	cfg_doc_enum,	  &cfg_rep_string, evictionpolicy_enums
+};
+
 /*%
  * A "controls" statement is represented as a map with the multivalued
  * "inet" and "unix" clauses.
@@ -51,6 +51,7 @@
 #include <isc/dir.h>
 #include <isc/errno.h>
 #include <isc/formatcheck.h>
+#include <isc/hash.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/mem.h>
@@ -525,6 +526,7 @@ cfg_parser_create(isc_mem_t *mctx, cfg_parser_t **ret) {
 	pctx->token.type = isc_tokentype_unknown;
 	pctx->flags = 0;
 	pctx->buf_name = NULL;
+	memset(pctx->clausecache, 0, sizeof(pctx->clausecache));
 
 	memset(specials, 0, sizeof(specials));
 	specials['{'] = 1;
@@ -2214,11 +2216,45 @@ cfg_listelt_value(const cfg_listelt_t *elt) {
  * the named.conf syntax, as well as for the body of the
  * options, view, zone, and other statements.
  */
+/*
+ * Find the definition of the clause named by the current token in
+ * 'clausesets', trying the parser's clause cache before searching.
+ */
+static const cfg_clausedef_t *
+find_clause(cfg_parser_t *pctx, const cfg_clausedef_t *const *clausesets) {
+	const char *name = TOKEN_STRING(pctx);
+	size_t length = pctx->token.value.as_textregion.length;
+	const cfg_clausedef_t *const *clauseset;
+	const cfg_clausedef_t *clause;
+	uint32_t hash;
+
+	hash = isc_hash32(name, length, false) ^
+	       (uint32_t)((uintptr_t)clausesets >> 4);
+	hash %= CFG_CLAUSECACHE_SIZE;
+
+	if (pctx->clausecache[hash].clausesets == clausesets &&
+	    strcasecmp(name, pctx->clausecache[hash].clause->name) == 0)
+	{
+		return (pctx->clausecache[hash].clause);
+	}
+
+	for (clauseset = clausesets; *clauseset != NULL; clauseset++) {
+		for (clause = *clauseset; clause->name != NULL; clause++) {
+			if (strcasecmp(name, clause->name) == 0) {
+				pctx->clausecache[hash].clausesets = clausesets;
+				pctx->clausecache[hash].clause = clause;
+				return (clause);
+			}
+		}
+	}
+
+	return (NULL);
+}
+
 isc_result_t
 cfg_parse_mapbody(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	const cfg_clausedef_t *const *clausesets;
 	isc_result_t result;
-	const cfg_clausedef_t *const *clauseset;
 	const cfg_clausedef_t *clause;
 	cfg_obj_t *value = NULL;
 	cfg_obj_t *obj = NULL;
@@ -2305,20 +2341,8 @@ cfg_parse_mapbody(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 			goto redo;
 		}
 
-		clause = NULL;
-		for (clauseset = clausesets; *clauseset != NULL; clauseset++) {
-			for (clause = *clauseset; clause->name != NULL;
-			     clause++)
-			{
-				if (strcasecmp(TOKEN_STRING(pctx),
-					       clause->name) == 0)
-				{
-					goto done;
-				}
-			}
-		}
-	done:
-		if (clause == NULL || clause->name == NULL) {
+		clause = find_clause(pctx, clausesets);
+		if (clause == NULL) {
 			cfg_parser_error(pctx, CFG_LOG_NOPREP,
 					 "unknown option");
 			/*
@@ -35,6 +35,7 @@
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/adb.h>
 #include <dns/badcache.h>
 #include <dns/cache.h>
@@ -55,6 +56,7 @@
 #include <dns/tsig.h>
 #include <dns/view.h>
 #include <dns/zone.h>
+#include <dns/zonecounters.h>
 
 #include <ns/client.h>
 #include <ns/interfacemgr.h>
@@ -63,6 +65,8 @@
 #include <ns/stats.h>
 #include <ns/update.h>
 
+#include "probes.h"
+
 /***
  *** Client
  ***/
@@ -95,6 +99,12 @@
 #define TCP_CLIENT(c) (((c)->attributes & NS_CLIENTATTR_TCP) != 0)
 
 #define COOKIE_SIZE 24U /* 8 + 4 + 4 + 8 */
+
+/*%
+ * A server cookie presented by the client is returned unchanged while it
+ * is younger than this many seconds (RFC 9018 section 4.3).
+ */
+#define COOKIE_REUSE 1800
 #define ECS_SIZE    20U /* 2 + 1 + 1 + [0..16] */
 
 #define USEKEEPALIVE(x) (((x)->attributes & NS_CLIENTATTR_USEKEEPALIVE) != 0)
@@ -132,10 +142,14 @@ can_log_sigchecks_quota(void) {
 static void
 clientmgr_destroy_cb(void *arg);
 static void
+client_put_tcp_buffer(ns_client_t *client);
+static void
 ns_client_dumpmessage(ns_client_t *client, const char *reason);
 static void
 ns_client_request_continue(void *arg);
 static void
+client_aclcache_clear(ns_client_t *client);
+static void
 compute_cookie(ns_client_t *client, uint32_t when, const unsigned char *secret,
 	       isc_buffer_t *buf);
 
@@ -191,26 +205,65 @@ ns_client_recursing(ns_client_t *client) {
 
 	LOCK(&client->manager->reclock);
 	client->state = NS_CLIENTSTATE_RECURSING;
+	client->query.recursestart = isc_time_monotonic();
 	ISC_LIST_APPEND(client->manager->recursing, client, rlink);
 	UNLOCK(&client->manager->reclock);
 }
 
 void
 ns_client_killoldestquery(ns_client_t *client) {
-	ns_client_t *oldest;
+	ns_client_t *oldest, *victim;
+	size_t n = 0;
+
 	REQUIRE(NS_CLIENT_VALID(client));
 
 	LOCK(&client->manager->reclock);
 	oldest = ISC_LIST_HEAD(client->manager->recursing);
-	if (oldest != NULL) {
-		ISC_LIST_UNLINK(client->manager->recursing, oldest, rlink);
-		ns_query_cancel(oldest);
+	victim = oldest;
+
+	/*
+	 * Prefer the query that costs the most to resolve, e.g. one
+	 * following a long CNAME chain or one for a zone that already has
+	 * many fetches outstanding, over one that is merely the oldest.
+	 */
+	for (ns_client_t *c = oldest; c != NULL && n < NS_CLIENT_SHED_SCAN;
+	     c = ISC_LIST_NEXT(c, rlink), n++)
+	{
+		if (c->query.cost > victim->query.cost) {
+			victim = c;
+		}
+	}
+
+	if (victim != NULL) {
+		ISC_LIST_UNLINK(client->manager->recursing, victim, rlink);
+		ns_query_cancel(victim);
 		ns_stats_increment(client->manager->sctx->nsstats,
 				   ns_statscounter_reclimitdropped);
+		if (victim != oldest) {
+			ns_stats_increment(client->manager->sctx->nsstats,
+					   ns_statscounter_reclimitcostly);
+		}
 	}
 	UNLOCK(&client->manager->reclock);
 }
 
+isc_nanosecs_t
+ns_client_oldestrecursion(ns_clientmgr_t *manager) {
+	ns_client_t *oldest = NULL;
+	isc_nanosecs_t start = 0;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	LOCK(&manager->reclock);
+	oldest = ISC_LIST_HEAD(manager->recursing);
+	if (oldest != NULL) {
+		start = oldest->query.recursestart;
+	}
+	UNLOCK(&manager->reclock);
+
+	return (start);
+}
+
 void
 ns_client_settimeout(ns_client_t *client, unsigned int seconds) {
 	UNUSED(client);
@@ -310,6 +363,8 @@ ns_client_endrequest(ns_client_t *client) {
 	}
 
 	client_extendederror_reset(client);
+	client_aclcache_clear(client);
+	memset(client->plugindata, 0, sizeof(client->plugindata));
 	client->signer = NULL;
 	client->udpsize = 512;
 	client->extflags = 0;
@@ -367,6 +422,9 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	 */
 	client->sendhandle = NULL;
 
+	/* The TCP send buffer can be reused by the next response */
+	client_put_tcp_buffer(client);
+
 	if (result != ISC_R_SUCCESS) {
 		if (!TCP_CLIENT(client) && result == ISC_R_MAXSIZE) {
 			ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
@@ -389,20 +447,33 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 
 static void
 client_setup_tcp_buffer(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+
 	REQUIRE(client->tcpbuf == NULL);
 
-	client->tcpbuf = client->manager->tcp_buffer;
+	if (manager->ntcp_buffers > 0) {
+		client->tcpbuf = manager->tcp_buffers[--manager->ntcp_buffers];
+	} else {
+		client->tcpbuf = isc_mem_get(manager->mctx,
+					     NS_CLIENT_TCP_BUFFER_SIZE);
+	}
 	client->tcpbuf_size = NS_CLIENT_TCP_BUFFER_SIZE;
 }
 
 static void
 client_put_tcp_buffer(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+
 	if (client->tcpbuf == NULL) {
 		return;
 	}
 
-	if (client->tcpbuf != client->manager->tcp_buffer) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
+	if (client->tcpbuf_size == NS_CLIENT_TCP_BUFFER_SIZE &&
+	    manager->ntcp_buffers < ARRAY_SIZE(manager->tcp_buffers))
+	{
+		manager->tcp_buffers[manager->ntcp_buffers++] = client->tcpbuf;
+	} else {
+		isc_mem_put(manager->mctx, client->tcpbuf,
 			    client->tcpbuf_size);
 	}
 
@@ -410,9 +481,9 @@ client_put_tcp_buffer(ns_client_t *client) {
 	client->tcpbuf_size = 0;
 }
 
-static void
-client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
-		    unsigned char **datap) {
+void
+ns__client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
+			unsigned char **datap) {
 	unsigned char *data;
 	uint32_t bufsize;
 
@@ -444,6 +515,40 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 	*datap = data;
 }
 
+void
+ns__client_trimsendbuf(ns_client_t *client, isc_buffer_t *buffer,
+		       isc_region_t *r) {
+	unsigned char *data = NULL;
+
+	isc_buffer_usedregion(buffer, r);
+
+	if (client->tcpbuf == NULL || r->base != client->tcpbuf ||
+	    r->length >= NS_CLIENT_TCP_BUFFER_KEEP)
+	{
+		return;
+	}
+
+	/*
+	 * Don't hold a full size TCP buffer for the whole send of a
+	 * small response: copy it into the client's own send buffer,
+	 * which TCP clients don't otherwise use, or into a buffer of the
+	 * right size, and give the full size one back right away.
+	 */
+	if (r->length <= sizeof(client->sendbuf)) {
+		data = client->sendbuf;
+	} else {
+		data = isc_mem_get(client->manager->mctx, r->length);
+	}
+	memmove(data, r->base, r->length);
+	client_put_tcp_buffer(client);
+
+	if (data != client->sendbuf) {
+		client->tcpbuf = data;
+		client->tcpbuf_size = r->length;
+	}
+	r->base = data;
+}
+
 static void
 client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	isc_result_t result;
@@ -452,55 +557,39 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 
 	REQUIRE(client->sendhandle == NULL);
 
-	if (isc_buffer_base(buffer) == client->tcpbuf) {
-		size_t used = isc_buffer_usedlength(buffer);
-		INSIST(client->tcpbuf_size == NS_CLIENT_TCP_BUFFER_SIZE);
+	ns_client_latency(client, ns_latency_total, client->requeststart);
 
-		/*
-		 * Copy the data into a smaller buffer before sending,
-		 * and keep the original big TCP send buffer for reuse
-		 * by other clients.
-		 */
-		if (used > NS_CLIENT_SEND_BUFFER_SIZE) {
-			/*
-			 * We can save space by allocating a new buffer with a
-			 * correct size and freeing the big buffer.
-			 */
-			unsigned char *new_tcpbuf =
-				isc_mem_get(client->manager->mctx, used);
-			memmove(new_tcpbuf, buffer->base, used);
+	LIBNS_CLIENT_REQUEST_END(client, client->message->rcode,
+				 isc_buffer_usedlength(buffer),
+				 client->requeststart != 0
+					 ? isc_time_monotonic() -
+						   client->requeststart
+					 : 0);
 
-			/*
-			 * Put the big buffer so we can replace the pointer
-			 * and the size with the new ones.
-			 */
-			client_put_tcp_buffer(client);
-
-			/*
-			 * Keep the new buffer's information so it can be freed.
-			 */
-			client->tcpbuf = new_tcpbuf;
-			client->tcpbuf_size = used;
-
-			r.base = new_tcpbuf;
-		} else {
-			/*
-			 * The data fits in the available space in
-			 * 'sendbuf', there is no need for a new buffer.
-			 */
-			memmove(client->sendbuf, buffer->base, used);
+	if (client->query.authzone != NULL) {
+		dns_zonecounters_t *counters = NULL;
+		uint32_t slot;
 
-			/*
-			 * Put the big buffer, we don't need a dynamic buffer.
-			 */
-			client_put_tcp_buffer(client);
-
-			r.base = client->sendbuf;
+		counters = dns_zone_getcounters(client->query.authzone, &slot);
+		if (counters != NULL) {
+			dns_zonecounters_response(
+				counters, slot, client->message->rcode,
+				isc_buffer_usedlength(buffer),
+				client->requeststart != 0
+					? isc_time_monotonic() -
+						  client->requeststart
+					: 0);
 		}
-		r.length = used;
-	} else {
-		isc_buffer_usedregion(buffer, &r);
 	}
+
+	/*
+	 * The message was rendered directly into the buffer it is sent
+	 * from: either the client's 'sendbuf' for UDP, or a TCP buffer
+	 * which is held until client_senddone() returns it to the
+	 * manager's cache.  Small TCP responses are moved out of the
+	 * TCP buffer first.
+	 */
+	ns__client_trimsendbuf(client, buffer, &r);
 	isc_nmhandle_attach(client->handle, &client->sendhandle);
 
 	if (isc_nm_is_http_handle(client->handle)) {
@@ -534,7 +623,7 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 		goto done;
 	}
 
-	client_allocsendbuf(client, &buffer, &data);
+	ns__client_allocsendbuf(client, &buffer, &data);
 
 	if (mr->length > isc_buffer_length(&buffer)) {
 		result = ISC_R_NOSPACE;
@@ -580,6 +669,124 @@ done:
 	ns_client_drop(client, result);
 }
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, const isc_region_t *cached) {
+	isc_result_t result;
+	unsigned char *data = NULL;
+	isc_buffer_t buffer;
+	dns_compress_t cctx;
+	unsigned int count = 0;
+	bool opt_included = false;
+	size_t respsize;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(cached != NULL && cached->length >= DNS_MESSAGE_HEADERLEN);
+
+	CTRACE("sendcached");
+
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = ns_client_addopt(client, client->message,
+					  &client->opt);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	ns__client_allocsendbuf(client, &buffer, &data);
+
+	/*
+	 * Copy the cached response and fixup the id.
+	 */
+	result = isc_buffer_copyregion(&buffer, cached);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	data[0] = (client->message->id >> 8) & 0xff;
+	data[1] = client->message->id & 0xff;
+
+	/*
+	 * The cached response may have been rendered for a question
+	 * name that differs in case; restore the client's.
+	 */
+	if (client->query.qname != NULL &&
+	    cached->length >=
+		    DNS_MESSAGE_HEADERLEN + client->query.qname->length)
+	{
+		memmove(data + DNS_MESSAGE_HEADERLEN,
+			client->query.qname->ndata,
+			client->query.qname->length);
+	}
+
+	/*
+	 * The cached ARCOUNT already includes the OPT record which was
+	 * stripped when the response was cached; render the new one.
+	 */
+	if (client->opt != NULL) {
+		dns_compress_init(&cctx, client->manager->mctx,
+				  DNS_COMPRESS_DISABLED);
+		result = dns_rdataset_towire(client->opt, dns_rootname, &cctx,
+					     &buffer, 0, &count);
+		dns_compress_invalidate(&cctx);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		opt_included = true;
+		dns_rdataset_disassociate(client->opt);
+		dns_message_puttemprdataset(client->message, &client->opt);
+	}
+
+	respsize = isc_buffer_usedlength(&buffer);
+
+	if (client->sendcb != NULL) {
+		client->sendcb(&buffer);
+	} else {
+		ns_server_t *sctx = client->manager->sctx;
+		isc_histomulti_t *outstats = NULL;
+
+		client_sendpkg(client, &buffer);
+
+		switch (isc_sockaddr_pf(&client->peeraddr)) {
+		case AF_INET:
+			outstats = TCP_CLIENT(client) ? sctx->tcpoutstats4
+						      : sctx->udpoutstats4;
+			break;
+		case AF_INET6:
+			outstats = TCP_CLIENT(client) ? sctx->tcpoutstats6
+						      : sctx->udpoutstats6;
+			break;
+		default:
+			UNREACHABLE();
+		}
+		isc_histomulti_inc(outstats, DNS_SIZEHISTO_BUCKETOUT(respsize));
+	}
+
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_response);
+	/* Only NOERROR and NXDOMAIN responses are cached. */
+	dns_rcodestats_increment(client->manager->sctx->rcodestats,
+				 data[3] & 0x0f);
+	if (opt_included) {
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_edns0out);
+	}
+
+	client->query.attributes |= NS_QUERYATTR_ANSWERED;
+
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	if (client->tcpbuf != NULL) {
+		client_put_tcp_buffer(client);
+	}
+
+	if (client->opt != NULL) {
+		dns_rdataset_disassociate(client->opt);
+		dns_message_puttemprdataset(client->message, &client->opt);
+	}
+
+	return (result);
+}
+
 void
 ns_client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -592,7 +799,9 @@ ns_client_send(ns_client_t *client) {
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	bool opt_included = false;
+	bool additional_partial = false;
 	size_t respsize;
+	isc_nanosecs_t renderstart = 0;
 	dns_aclenv_t *env = NULL;
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -628,6 +837,17 @@ ns_client_send(ns_client_t *client) {
 		render_opts = DNS_MESSAGERENDER_OMITDNSSEC;
 	}
 
+	/*
+	 * In authoritative answers, records owned by the query name are
+	 * rendered in the case of the question, which spares restoring
+	 * their stored case and lets them compress to the question name.
+	 */
+	if (client->view != NULL && client->view->answerqnamecase &&
+	    (client->message->flags & DNS_MESSAGEFLAG_AA) != 0)
+	{
+		render_opts |= DNS_MESSAGERENDER_QNAMECASE;
+	}
+
 	preferred_glue = 0;
 	if (client->view != NULL) {
 		if (client->view->preferred_glue == dns_rdatatype_a) {
@@ -655,7 +875,7 @@ ns_client_send(ns_client_t *client) {
 		}
 	}
 
-	client_allocsendbuf(client, &buffer, &data);
+	ns__client_allocsendbuf(client, &buffer, &data);
 	compflags = 0;
 	if (client->peeraddr_valid && client->view != NULL) {
 		isc_netaddr_t netaddr;
@@ -680,6 +900,7 @@ ns_client_send(ns_client_t *client) {
 	dns_compress_init(&cctx, client->manager->mctx, compflags);
 	cleanup_cctx = true;
 
+	renderstart = isc_time_monotonic();
 	result = dns_message_renderbegin(client->message, &cctx, &buffer);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
@@ -731,7 +952,9 @@ ns_client_send(ns_client_t *client) {
 	result = dns_message_rendersection(client->message,
 					   DNS_SECTION_ADDITIONAL,
 					   preferred_glue | render_opts);
-	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE) {
+	if (result == ISC_R_NOSPACE) {
+		additional_partial = true;
+	} else if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 renderend:
@@ -740,6 +963,19 @@ renderend:
 		goto cleanup;
 	}
 
+	ns_client_latency(client, ns_latency_render, renderstart);
+
+	/*
+	 * Only complete responses are reused from the response cache.
+	 */
+	if ((client->query.attributes &
+	     (NS_QUERYATTR_RESPCACHE | NS_QUERYATTR_RESPSHARE)) != 0 &&
+	    (client->message->flags & DNS_MESSAGEFLAG_TC) == 0 &&
+	    !additional_partial)
+	{
+		ns__query_respcache_add(client, &buffer, opt_included);
+	}
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1079,6 +1315,29 @@ ns_client_error(ns_client_t *client, isc_result_t result) {
 	ns_client_send(client);
 }
 
+/*
+ * Scale the advertised keepalive timeout down once more than half of the
+ * TCP client quota is in use, reaching zero when it is exhausted, so that
+ * clients holding idle connections give them up while there is still
+ * room for new ones (RFC 7828 section 3.3.2).
+ */
+static uint32_t
+client_keepalive(ns_client_t *client, uint32_t adv) {
+	isc_quota_t *quota = &client->manager->sctx->tcpquota;
+	unsigned int max = isc_quota_getmax(quota);
+	unsigned int used = isc_quota_getused(quota);
+	unsigned int half = max / 2;
+
+	if (max == 0 || used <= half) {
+		return (adv);
+	}
+	if (used >= max) {
+		return (0);
+	}
+
+	return ((uint32_t)((uint64_t)adv * (max - used) / (max - half)));
+}
+
 isc_result_t
 ns_client_addopt(ns_client_t *client, dns_message_t *message,
 		 dns_rdataset_t **opt) {
@@ -1135,8 +1394,25 @@ no_nsid:
 
 		isc_buffer_init(&buf, cookie, sizeof(cookie));
 
-		compute_cookie(client, now, client->manager->sctx->secret,
-			       &buf);
+		if (client->cookiewhen != 0 &&
+		    isc_serial_ge(client->cookiewhen, now - COOKIE_REUSE))
+		{
+			/*
+			 * The client presented a server cookie that is
+			 * still fresh; return it rather than hashing again.
+			 */
+			isc_buffer_putmem(&buf, client->cookie, 8);
+			isc_buffer_putuint8(&buf, NS_COOKIE_VERSION_1);
+			isc_buffer_putuint8(&buf, 0);  /* Reserved */
+			isc_buffer_putuint16(&buf, 0); /* Reserved */
+			isc_buffer_putuint32(&buf, client->cookiewhen);
+			isc_buffer_putmem(&buf, client->cookiehash, 8);
+			ns_stats_increment(client->manager->sctx->nsstats,
+					   ns_statscounter_cookiereused);
+		} else {
+			compute_cookie(client, now,
+				       client->manager->sctx->secret, &buf);
+		}
 
 		INSIST(count < DNS_EDNSOPTIONS);
 		ednsopts[count].code = DNS_OPT_COOKIE;
@@ -1222,6 +1498,7 @@ no_nsid:
 
 		isc_nm_gettimeouts(isc_nmhandle_netmgr(client->handle), NULL,
 				   NULL, NULL, &adv);
+		adv = client_keepalive(client, adv);
 		adv /= 100; /* units of 100 milliseconds */
 		isc_buffer_init(&buf, advtimo, sizeof(advtimo));
 		isc_buffer_putuint16(&buf, (uint16_t)adv);
@@ -1348,6 +1625,7 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 	}
 
 	client->attributes |= NS_CLIENTATTR_WANTCOOKIE;
+	client->cookiewhen = 0;
 
 	ns_stats_increment(client->manager->sctx->nsstats,
 			   ns_statscounter_cookiein);
@@ -1402,6 +1680,10 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		ns_stats_increment(client->manager->sctx->nsstats,
 				   ns_statscounter_cookiematch);
 		client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+		if (when != 0) {
+			client->cookiewhen = when;
+			memmove(client->cookiehash, dbuf + 16, 8);
+		}
 		return;
 	}
 
@@ -1741,6 +2023,28 @@ ns__client_reset_cb(void *client0) {
 #endif /* WANT_SINGLETRACE */
 }
 
+static void
+client_free(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
+
+	/*
+	 * Call this first because it requires a valid client.
+	 */
+	ns_query_free(client);
+
+	client->magic = 0;
+
+	dns_message_detach(&client->message);
+
+	/*
+	 * Destroy the fetchlock mutex that was created in
+	 * ns_query_init().
+	 */
+	isc_mutex_destroy(&client->query.fetchlock);
+
+	isc_mem_put(manager->mctx, client, sizeof(*client));
+}
+
 void
 ns__client_put_cb(void *client0) {
 	ns_client_t *client = client0;
@@ -1750,16 +2054,8 @@ ns__client_put_cb(void *client0) {
 
 	manager = client->manager;
 
-	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
-		      ISC_LOG_DEBUG(3), "freeing client");
-
-	/*
-	 * Call this first because it requires a valid client.
-	 */
-	ns_query_free(client);
 	client_extendederror_reset(client);
-
-	client->magic = 0;
+	client_aclcache_clear(client);
 
 	if (client->opt != NULL) {
 		INSIST(dns_rdataset_isassociated(client->opt));
@@ -1769,19 +2065,57 @@ ns__client_put_cb(void *client0) {
 
 	ns_client_async_reset(client);
 
-	dns_message_detach(&client->message);
+	if (manager->tid == isc_tid() &&
+	    manager->nclients < ARRAY_SIZE(manager->clients))
+	{
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "caching client");
 
-	/*
-	 * Destroy the fetchlock mutex that was created in
-	 * ns_query_init().
-	 */
-	isc_mutex_destroy(&client->query.fetchlock);
+		/*
+		 * Keep the message and the query state, they are reset
+		 * by ns__client_setup() when the client is reused.
+		 */
+		client->magic = 0;
+		manager->clients[manager->nclients++] = client;
+	} else {
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "freeing client");
 
-	isc_mem_put(manager->mctx, client, sizeof(*client));
+		client_free(client);
+	}
 
 	ns_clientmgr_detach(&manager);
 }
 
+static ns_client_t *
+client_get(ns_clientmgr_t *manager) {
+	ns_client_t *client = NULL;
+
+	if (manager->nclients > 0) {
+		client = manager->clients[--manager->nclients];
+
+		client->manager = NULL;
+		ns_clientmgr_attach(manager, &client->manager);
+		client->magic = NS_CLIENT_MAGIC;
+
+		ns__client_setup(client, NULL, false);
+
+		ns_stats_increment(manager->sctx->nsstats,
+				   ns_statscounter_clientreused);
+	} else {
+		client = isc_mem_get(manager->mctx, sizeof(*client));
+
+		ns__client_setup(client, manager, true);
+
+		ns_stats_increment(manager->sctx->nsstats,
+				   ns_statscounter_clientallocated);
+	}
+
+	return (client);
+}
+
 static isc_result_t
 ns_client_setup_view(ns_client_t *client, isc_netaddr_t *netaddr) {
 	isc_result_t result;
@@ -1849,9 +2183,7 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		INSIST(VALID_MANAGER(clientmgr));
 		INSIST(clientmgr->tid == isc_tid());
 
-		client = isc_mem_get(clientmgr->mctx, sizeof(*client));
-
-		ns__client_setup(client, clientmgr, true);
+		client = client_get(clientmgr);
 
 		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
 			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
@@ -1888,6 +2220,7 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	client->state = NS_CLIENTSTATE_WORKING;
 
 	client->requesttime = isc_time_now();
+	client->requeststart = isc_time_monotonic();
 	client->tnow = client->requesttime;
 	client->now = isc_time_seconds(&client->tnow);
 
@@ -2021,6 +2354,7 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 
 	dns_opcodestats_increment(client->manager->sctx->opcodestats,
 				  client->message->opcode);
+	LIBNS_CLIENT_REQUEST_START(client, client->message->opcode, reqsize);
 	switch (client->message->opcode) {
 	case dns_opcode_query:
 	case dns_opcode_update:
@@ -2292,6 +2626,7 @@ ns_client_request_continue(void *arg) {
 	 * not.  We do not log the lack of a signature unless we are
 	 * debugging.
 	 */
+	client_aclcache_clear(client);
 	client->signer = NULL;
 	dns_name_init(&client->signername, NULL);
 	result = dns_message_signer(client->message, &client->signername);
@@ -2543,9 +2878,11 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 
 		ns_clientmgr_attach(mgr, &client->manager);
 
-		dns_message_create(client->manager->mctx,
-				   client->manager->namepool,
-				   client->manager->rdspool,
+		/*
+		 * The message is reused for every request the client
+		 * handles, so it keeps its own names and rdatasets.
+		 */
+		dns_message_create(client->manager->mctx, NULL, NULL,
 				   DNS_MESSAGE_INTENTPARSE, &client->message);
 
 		/*
@@ -2599,6 +2936,20 @@ clientmgr_destroy_cb(void *arg) {
 
 	manager->magic = 0;
 
+	while (manager->nclients > 0) {
+		ns_client_t *client = manager->clients[--manager->nclients];
+
+		INSIST(client->manager == manager);
+		client->magic = NS_CLIENT_MAGIC;
+		client_free(client);
+	}
+
+	while (manager->ntcp_buffers > 0) {
+		isc_mem_put(manager->mctx,
+			    manager->tcp_buffers[--manager->ntcp_buffers],
+			    NS_CLIENT_TCP_BUFFER_SIZE);
+	}
+
 	isc_loop_detach(&manager->loop);
 
 	dns_aclenv_detach(&manager->aclenv);
@@ -2607,8 +2958,6 @@ clientmgr_destroy_cb(void *arg) {
 
 	ns_server_detach(&manager->sctx);
 
-	dns_message_destroypools(&manager->rdspool, &manager->namepool);
-
 	isc_mem_putanddetach(&manager->mctx, manager, sizeof(*manager));
 }
 
@@ -2641,8 +2990,6 @@ ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 	isc_refcount_init(&manager->references, 1);
 	ns_server_attach(sctx, &manager->sctx);
 
-	dns_message_createpools(mctx, &manager->namepool, &manager->rdspool);
-
 	manager->magic = MANAGER_MAGIC;
 
 	MTRACE("create");
@@ -2679,6 +3026,64 @@ ns_client_getdestaddr(ns_client_t *client) {
 	return (&client->destsockaddr);
 }
 
+static void
+client_aclcache_clear(ns_client_t *client) {
+	for (size_t i = 0; i < client->naclcache; i++) {
+		dns_acl_detach(&client->aclcache[i].acl);
+	}
+	client->naclcache = 0;
+}
+
+void *
+ns_client_findplugindata(ns_client_t *client, const void *owner) {
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(owner != NULL);
+
+	for (size_t i = 0; i < ARRAY_SIZE(client->plugindata); i++) {
+		if (client->plugindata[i].owner == owner) {
+			return (client->plugindata[i].data);
+		}
+	}
+
+	return (NULL);
+}
+
+void *
+ns_client_plugindata(ns_client_t *client, const void *owner, size_t size) {
+	void *data = NULL;
+
+	REQUIRE(size <= NS_CLIENT_PLUGINDATA_SIZE);
+
+	data = ns_client_findplugindata(client, owner);
+	if (data != NULL) {
+		return (data);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(client->plugindata); i++) {
+		if (client->plugindata[i].owner == NULL) {
+			client->plugindata[i].owner = owner;
+			memset(client->plugindata[i].data, 0,
+			       sizeof(client->plugindata[i].data));
+			return (client->plugindata[i].data);
+		}
+	}
+
+	return (NULL);
+}
+
+void
+ns_client_releaseplugindata(ns_client_t *client, const void *owner) {
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(owner != NULL);
+
+	for (size_t i = 0; i < ARRAY_SIZE(client->plugindata); i++) {
+		if (client->plugindata[i].owner == owner) {
+			client->plugindata[i].owner = NULL;
+			return;
+		}
+	}
+}
+
 isc_result_t
 ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 			 dns_acl_t *acl, bool default_allow) {
@@ -2687,6 +3092,7 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 	isc_netaddr_t tmpnetaddr;
 	int match;
 	isc_sockaddr_t local;
+	bool allowed;
 
 	if (acl == NULL) {
 		if (default_allow) {
@@ -2701,21 +3107,46 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		netaddr = &tmpnetaddr;
 	}
 
+	for (size_t i = 0; i < client->naclcache; i++) {
+		if (client->aclcache[i].acl == acl &&
+		    isc_netaddr_equal(&client->aclcache[i].addr, netaddr))
+		{
+			ns_stats_increment(client->manager->sctx->nsstats,
+					   ns_statscounter_aclcachehit);
+			allowed = client->aclcache[i].allowed;
+			goto done;
+		}
+	}
+
 	local = isc_nmhandle_localaddr(client->handle);
 	result = dns_acl_match_port_transport(
 		netaddr, isc_sockaddr_getport(&local),
 		isc_nm_socket_type(client->handle),
 		isc_nm_has_encryption(client->handle), client->signer, acl, env,
 		&match, NULL);
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_aclmatch);
 
 	if (result != ISC_R_SUCCESS) {
 		goto deny; /* Internal error, already logged. */
 	}
 
-	if (match > 0) {
+	/* Negative match or no match is a deny. */
+	allowed = (match > 0);
+
+	if (client->naclcache < ARRAY_SIZE(client->aclcache)) {
+		size_t i = client->naclcache++;
+		client->aclcache[i].acl = NULL;
+		dns_acl_attach(acl, &client->aclcache[i].acl);
+		client->aclcache[i].addr = *netaddr;
+		client->aclcache[i].allowed = allowed;
+	}
+
+done:
+	if (allowed) {
 		goto allow;
 	}
-	goto deny; /* Negative match or no match. */
+	goto deny;
 
 allow:
 	return (ISC_R_SUCCESS);
@@ -2972,6 +3403,23 @@ ns_client_sourceip(dns_clientinfo_t *ci, isc_sockaddr_t **addrp) {
 	return (ISC_R_SUCCESS);
 }
 
+void
+ns_client_latency(ns_client_t *client, unsigned int stage,
+		  isc_nanosecs_t start) {
+	isc_nanosecs_t now;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(stage < ns_latency_max);
+
+	if (start == 0) {
+		return;
+	}
+
+	now = isc_time_monotonic();
+	isc_histomulti_inc(client->manager->sctx->latency[stage],
+			   (now - start) / NS_PER_US);
+}
+
 dns_rdataset_t *
 ns_client_newrdataset(ns_client_t *client) {
 	dns_rdataset_t *rdataset;
@@ -83,6 +83,43 @@
 #define NS_CLIENT_TCP_BUFFER_SIZE  65535
 #define NS_CLIENT_SEND_BUFFER_SIZE 4096
 
+/*%
+ * Number of idle TCP send buffers kept by each client manager
+ */
+#define NS_CLIENT_TCP_BUFFER_CACHE 8
+
+/*%
+ * TCP responses shorter than this are copied out of the full size TCP
+ * buffer they were rendered into before they are sent, so that only
+ * the large responses hold on to such a buffer while they are sent.
+ */
+#define NS_CLIENT_TCP_BUFFER_KEEP (NS_CLIENT_TCP_BUFFER_SIZE / 2)
+
+/*%
+ * Number of released, fully initialized clients kept by each client
+ * manager for reuse by new requests
+ */
+#define NS_CLIENT_CACHE_SIZE 64
+
+/*%
+ * Number of ACL match results remembered by a client while it
+ * processes a request
+ */
+#define NS_CLIENT_ACL_CACHE_SIZE 8
+
+/*%
+ * Number of the oldest recursing clients considered when one of them
+ * has to be dropped to make room for a new one
+ */
+#define NS_CLIENT_SHED_SCAN 8
+
+/*%
+ * Number of plugins that can keep per-request data in a client, and the
+ * size of the data each of them can keep
+ */
+#define NS_CLIENT_PLUGINDATA_SLOTS 4
+#define NS_CLIENT_PLUGINDATA_SIZE  32
+
 /*!
  * Client object states.  Ordering is significant: higher-numbered
  * states are generally "more active", meaning that the client can
@@ -144,9 +181,6 @@ struct ns_clientmgr {
 	unsigned int magic;
 
 	isc_mem_t     *mctx;
-	isc_mempool_t *namepool;
-	isc_mempool_t *rdspool;
-
 	ns_server_t   *sctx;
 	isc_refcount_t references;
 	uint32_t       tid;
@@ -158,7 +192,20 @@ struct ns_clientmgr {
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
 
-	uint8_t tcp_buffer[NS_CLIENT_TCP_BUFFER_SIZE];
+	/*
+	 * Idle TCP send buffers; the responses are rendered into one of
+	 * these and sent from it directly, and the buffer is returned
+	 * here when the send completes.
+	 */
+	unsigned char *tcp_buffers[NS_CLIENT_TCP_BUFFER_CACHE];
+	size_t	       ntcp_buffers;
+
+	/*
+	 * Released clients, with their message and query state still
+	 * initialized; these don't hold a reference to the manager.
+	 */
+	ns_client_t *clients[NS_CLIENT_CACHE_SIZE];
+	size_t	     nclients;
 };
 
 /*% nameserver client structure */
@@ -188,6 +235,7 @@ struct ns_client {
 	void (*cleanup)(ns_client_t *);
 	ns_query_t    query;
 	isc_time_t    requesttime;
+	isc_nanosecs_t requeststart; /*%< monotonic, for latency stats */
 	isc_stdtime_t now;
 	isc_time_t    tnow;
 	dns_name_t    signername; /*%< [T]SIG key name */
@@ -206,6 +254,32 @@ struct ns_client {
 
 	dns_ecs_t ecs; /*%< EDNS client subnet sent by client */
 
+	/*%
+	 * Results of ns_client_checkaclsilent() for the current request.
+	 * Everything else an ACL match depends on (the local port, the
+	 * transport and the signer) is fixed once the request has been
+	 * parsed, so an ACL checked again against the same address gives
+	 * the same answer.  The ACLs are attached, and the entries are
+	 * dropped when the request ends or the signer changes.
+	 */
+	struct {
+		dns_acl_t    *acl;
+		isc_netaddr_t addr;
+		bool	      allowed;
+	} aclcache[NS_CLIENT_ACL_CACHE_SIZE];
+	size_t naclcache;
+
+	/*%
+	 * Scratch space for the plugins that need to keep state while
+	 * the client processes a request; see ns_client_plugindata().
+	 * A client is only ever used by one thread, so the slots need
+	 * no locking, and they are released when the request ends.
+	 */
+	struct {
+		const void *owner;
+		uint64_t    data[NS_CLIENT_PLUGINDATA_SIZE / sizeof(uint64_t)];
+	} plugindata[NS_CLIENT_PLUGINDATA_SLOTS];
+
 	/*%
 	 * Information about recent FORMERR response(s), for
 	 * FORMERR loop avoidance.  This is separate for each
@@ -223,6 +297,8 @@ struct ns_client {
 
 	ISC_LINK(ns_client_t) rlink;
 	unsigned char  cookie[8];
+	uint32_t       cookiewhen;	/*%< time of a reusable server cookie */
+	unsigned char  cookiehash[8]; /*%< its hash, if cookiewhen != 0 */
 	uint32_t       expire;
 	unsigned char *keytag;
 	uint16_t       keytag_len;
@@ -296,6 +372,24 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, const isc_region_t *cached);
+/*%<
+ * Finish processing the current client request and send the response
+ * previously rendered into 'cached', using client->message->id for the
+ * id and appending a freshly built OPT record if the client sent one.
+ * 'cached' must not contain an OPT record, but its ARCOUNT must already
+ * account for one if the client requested EDNS.  Its question name must
+ * match client->query.qname but for case; the client's case is copied
+ * into the response.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the response has been sent
+ *\li	#ISC_R_NOSPACE		the response does not fit the client's
+ *				buffer; nothing has been sent
+ *\li	other errors from building the OPT record; nothing has been sent
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -359,6 +453,46 @@ ns_client_getdestaddr(ns_client_t *client);
  * currently being processed.
  */
 
+void *
+ns_client_plugindata(ns_client_t *client, const void *owner, size_t size);
+/*%<
+ * Return the per-request scratch space of the plugin instance 'owner',
+ * allocating 'size' zeroed bytes of it if the plugin has none yet.
+ * The space stays valid until it is released with
+ * ns_client_releaseplugindata() or the request ends.
+ *
+ * Requires:
+ *\li	'client' points to a valid client.
+ *\li	'owner' is not NULL.
+ *\li	'size' is at most #NS_CLIENT_PLUGINDATA_SIZE.
+ *
+ * Returns:
+ *\li	A pointer to the scratch space, or NULL if all the slots are in
+ *	use.
+ */
+
+void *
+ns_client_findplugindata(ns_client_t *client, const void *owner);
+/*%<
+ * Return the per-request scratch space of the plugin instance 'owner',
+ * or NULL if it has none.
+ *
+ * Requires:
+ *\li	'client' points to a valid client.
+ *\li	'owner' is not NULL.
+ */
+
+void
+ns_client_releaseplugindata(ns_client_t *client, const void *owner);
+/*%<
+ * Release the per-request scratch space of the plugin instance 'owner',
+ * if it has any.
+ *
+ * Requires:
+ *\li	'client' points to a valid client.
+ *\li	'owner' is not NULL.
+ */
+
 isc_result_t
 ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 			 dns_acl_t *acl, bool default_allow);
@@ -432,7 +566,18 @@ ns_client_recursing(ns_client_t *client);
 void
 ns_client_killoldestquery(ns_client_t *client);
 /*%<
- * Kill the oldest recursive query (recursing list head).
+ * Kill the most expensive of the oldest recursive queries: among the
+ * first NS_CLIENT_SHED_SCAN entries of the recursing list, the one with
+ * the highest 'query.cost', or the oldest of those with the highest
+ * cost.
+ */
+
+isc_nanosecs_t
+ns_client_oldestrecursion(ns_clientmgr_t *manager);
+/*%<
+ * Return the time, as returned by isc_time_monotonic(), at which the
+ * oldest recursive query of 'manager' started recursing, or 0 if there
+ * is none.
  */
 
 void
@@ -450,6 +595,15 @@ ns_client_qnamereplace(ns_client_t *client, dns_name_t *name);
 isc_result_t
 ns_client_sourceip(dns_clientinfo_t *ci, isc_sockaddr_t **addrp);
 
+void
+ns_client_latency(ns_client_t *client, unsigned int stage,
+		  isc_nanosecs_t start);
+/*%<
+ * Add the time elapsed since 'start', as returned by isc_time_monotonic(),
+ * to the latency histogram of the query processing 'stage' (one of the
+ * ns_latency_* values).  Nothing is recorded if 'start' is zero.
+ */
+
 isc_result_t
 ns_client_addopt(ns_client_t *client, dns_message_t *message,
 		 dns_rdataset_t **opt);
@@ -562,3 +716,21 @@ ns__client_put_cb(void *client0);
  * Free all resources allocated to this client object, so that
  * it can be freed.
  */
+
+void
+ns__client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
+			unsigned char **datap);
+/*%<
+ * Set up 'buffer' to render a response for 'client' into, and store
+ * its memory in '*datap'.  For TCP clients this takes a full size TCP
+ * buffer, which is released when the client is reset.
+ */
+
+void
+ns__client_trimsendbuf(ns_client_t *client, isc_buffer_t *buffer,
+		       isc_region_t *r);
+/*%<
+ * Store the response rendered into 'buffer' in 'r', first moving it
+ * out of the client's full size TCP buffer if it is shorter than
+ * #NS_CLIENT_TCP_BUFFER_KEEP.
+ */
@@ -50,6 +50,7 @@
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/time.h>
 
 #include <dns/geoip.h>
 
@@ -90,6 +91,7 @@ struct ns_interface {
 					   *   connected) */
 	ns_clientmgr_t	   *clientmgr;	  /*%< Client manager. */
 	isc_nm_proxy_type_t proxy_type;
+	uint32_t	    udp_recv_batch;
 	ISC_LINK(ns_interface_t) link;
 };
 
@@ -181,6 +183,14 @@ ns_interface_shutdown(ns_interface_t *ifp);
 void
 ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr);
 
+isc_nanosecs_t
+ns_interfacemgr_oldestrecursion(ns_interfacemgr_t *mgr);
+/*%<
+ * Return the time, as returned by isc_time_monotonic(), at which the
+ * oldest recursive query of any client manager started recursing, or 0
+ * if there is none.
+ */
+
 bool
 ns_interfacemgr_listeningon(ns_interfacemgr_t *mgr, const isc_sockaddr_t *addr);
 
@@ -53,6 +53,7 @@ struct ns_listenelt {
 	uint32_t	    http_max_clients;
 	uint32_t	    max_concurrent_streams;
 	isc_nm_proxy_type_t proxy;
+	uint32_t	    udp_recv_batch;
 	ISC_LINK(ns_listenelt_t) link;
 };
 
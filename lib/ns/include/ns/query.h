@@ -106,6 +106,9 @@ struct ns_query {
 	unsigned int	 attributes;
 	unsigned int	 restarts;
 	bool		 timerset;
+	isc_nanosecs_t	 fetchstart; /*%< for the recursion latency */
+	isc_nanosecs_t	 recursestart; /*%< when it started recursing */
+	unsigned int	 cost;	       /*%< for shedding recursing queries */
 	dns_name_t	*qname;
 	dns_name_t	*origqname;
 	dns_rdatatype_t	 qtype;
@@ -153,6 +156,9 @@ struct ns_query {
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
+
+	uint64_t respcache_versionid;
+	uint32_t respcache_flags;
 };
 
 #define NS_QUERYATTR_RECURSIONOK     0x000001
@@ -174,6 +180,9 @@ struct ns_query {
 #define NS_QUERYATTR_REDIRECT	     0x020000
 #define NS_QUERYATTR_ANSWERED	     0x040000
 #define NS_QUERYATTR_STALEOK	     0x080000
+#define NS_QUERYATTR_RESPCACHE	     0x100000
+#define NS_QUERYATTR_RESPSHARE	     0x200000
+#define NS_QUERYATTR_DLZPREFETCH     0x400000
 
 typedef struct query_ctx query_ctx_t;
 
@@ -212,7 +221,8 @@ struct query_ctx {
 	ns_client_t *client;	    /* client object */
 	bool	     detach_client; /* client needs detaching */
 
-	dns_fetchresponse_t *fresp; /* recursion response */
+	dns_fetchresponse_t *fresp;   /* recursion response */
+	uint64_t	     fetchid; /* dns_resolver_fetchid() of fresp */
 
 	dns_db_t	*db;	  /* zone or cache database */
 	dns_dbversion_t *version; /* DB version */
@@ -324,3 +334,16 @@ ns__query_start(query_ctx_t *qctx);
 /*%<
  * (Must not be used outside this module and its associated unit tests.)
  */
+
+void
+ns__query_respcache_add(ns_client_t *client, isc_buffer_t *buffer,
+			bool opt_included);
+/*%<
+ * Store the response just rendered into 'buffer' in the view's
+ * authoritative response cache, if the query was found eligible for
+ * caching when it was started, or in the view's response sharing table,
+ * if the query was resumed after a fetch that other clients may still
+ * be waiting for; in both cases only if the response is complete.
+ *
+ * (Must not be used outside this module and ns_client_send().)
+ */
@@ -30,6 +30,7 @@
 #include <dns/acl.h>
 #include <dns/types.h>
 
+#include <ns/stats.h>
 #include <ns/types.h>
 
 #define NS_SERVER_LOGQUERIES	 0x00000001U /*%< log queries */
@@ -132,6 +133,12 @@ struct ns_server {
 	isc_histomulti_t *tcpoutstats4;
 	isc_histomulti_t *tcpinstats6;
 	isc_histomulti_t *tcpoutstats6;
+
+	isc_histomulti_t *latency[ns_latency_max];
+
+	/*% Rendered outgoing zone transfers, see xfrout.c */
+	isc_mutex_t xfrcache_lock;
+	ISC_LIST(ns_xfrcache_t) xfrcache;
 };
 
 struct ns_altsecret {
@@ -204,3 +211,14 @@ ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota);
  *\li	'sctx' is valid;
  *\li	'http_quota' is not 'NULL'.
  */
+
+unsigned int
+ns_server_recursionlimit(unsigned int limit, unsigned int max,
+			 bool congested);
+/*%<
+ *	Returns the adaptive recursive-clients limit that follows 'limit'
+ *	after one second with the server 'congested' or not, where 'max'
+ *	is the configured limit: an eighth lower while congested, but not
+ *	below an eighth of 'max', and otherwise 1/32 of 'max' higher, but
+ *	not above 'max'.
+ */
@@ -35,12 +35,48 @@ typedef enum {
 	NS_SORTLISTTYPE_2ELEMENT
 } ns_sortlisttype_t;
 
+/*%
+ * A sortlist compiled into a single table of the client address
+ * prefixes of its statements.
+ */
+typedef struct ns_sortlistindex ns_sortlistindex_t;
+
+isc_result_t
+ns_sortlist_compile(isc_mem_t *mctx, dns_acl_t *acl,
+		    ns_sortlistindex_t **indexp);
+/*%<
+ * Compile the sortlist 'acl' into '*indexp', so that the statement
+ * that applies to a client can be found with a single lookup instead
+ * of matching the client address against each statement in turn.
+ *
+ * This is only possible when the first element of every statement
+ * consists of IP prefixes only; 'localhost', 'localnets', keys,
+ * GeoIP elements and negated prefixes depend on more than the
+ * address, so a sortlist that uses them is left uncompiled.
+ *
+ * Requires:
+ *\li	'acl' is a valid ACL.
+ *\li	'indexp' is not NULL and '*indexp' is NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTIMPLEMENTED if the sortlist cannot be compiled.
+ */
+
+void
+ns_sortlist_freeindex(isc_mem_t *mctx, void **indexp);
+/*%<
+ * Free a sortlist index created by ns_sortlist_compile().
+ */
+
 ns_sortlisttype_t
-ns_sortlist_setup(dns_acl_t *acl, dns_aclenv_t *env, isc_netaddr_t *clientaddr,
-		  void **argp);
+ns_sortlist_setup(dns_acl_t *acl, const ns_sortlistindex_t *index,
+		  dns_aclenv_t *env, isc_netaddr_t *clientaddr, void **argp);
 /*%<
  * Find the sortlist statement in 'acl' (for ACL environment 'env')
- * that applies to 'clientaddr', if any.
+ * that applies to 'clientaddr', if any.  If 'index' is not NULL, it
+ * must have been compiled from 'acl', and it is used to find the
+ * statement.
  *
  * If a 1-element sortlist item applies, return NS_SORTLISTTYPE_1ELEMENT and
  * make '*argp' point to the matching subelement.
@@ -114,9 +114,50 @@ enum {
 
 	ns_statscounter_recurshighwater = 68,
 
-	ns_statscounter_max = 69,
+	ns_statscounter_clientreused = 69,
+	ns_statscounter_clientallocated = 70,
+
+	ns_statscounter_respcachehit = 71,
+	ns_statscounter_respcachemiss = 72,
+
+	ns_statscounter_rpzfilterskip = 73,
+	ns_statscounter_rpzfilterpass = 74,
+	ns_statscounter_rpzfilterfalse = 75,
+
+	ns_statscounter_aclmatch = 76,
+	ns_statscounter_aclcachehit = 77,
+
+	ns_statscounter_respshared = 78,
+
+	ns_statscounter_cookiereused = 79,
+
+	ns_statscounter_reclimitcostly = 80,
+	ns_statscounter_recurslimit = 81,
+	ns_statscounter_recurslimitlowered = 82,
+	ns_statscounter_recurslooplag = 83,
+	ns_statscounter_recursfetchage = 84,
+	ns_statscounter_recursslowrtt = 85,
+
+	ns_statscounter_max = 86,
+};
+
+/*%
+ * Query processing stages with a latency histogram, in microseconds.
+ */
+enum {
+	ns_latency_total = 0,	  /*%< request received to response sent */
+	ns_latency_lookup = 1,	  /*%< local database lookups */
+	ns_latency_recursion = 2, /*%< waiting for the resolver */
+	ns_latency_render = 3,	  /*%< rendering the response */
+
+	ns_latency_max = 4,
 };
 
+/*%
+ * Significant bits of the latency histograms (about 12% precision).
+ */
+#define NS_LATENCY_SIGBITS 3
+
 void
 ns_stats_attach(ns_stats_t *stats, ns_stats_t **statsp);
 
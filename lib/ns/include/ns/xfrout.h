@@ -28,3 +28,9 @@
 
 void
 ns_xfr_start(ns_client_t *client, dns_rdatatype_t xfrtype);
+
+void
+ns_xfr_flushcache(ns_server_t *sctx);
+/*%<
+ * Drop all the rendered zone transfers kept by 'sctx'.
+ */
@@ -15,6 +15,8 @@
 
 #include <stdbool.h>
 
+#include <isc/async.h>
+#include <isc/hashmap.h>
 #include <isc/interfaceiter.h>
 #include <isc/log.h>
 #include <isc/loop.h>
@@ -58,6 +60,8 @@
 #define IFMGR_MAGIC		 ISC_MAGIC('I', 'F', 'M', 'G')
 #define NS_INTERFACEMGR_VALID(t) ISC_MAGIC_VALID(t, IFMGR_MAGIC)
 
+#define INTERFACES_HASHBITS 6
+
 /*% nameserver interface manager structure */
 struct ns_interfacemgr {
 	unsigned int magic; /*%< Magic number */
@@ -74,11 +78,13 @@ struct ns_interfacemgr {
 	ns_listenlist_t *listenon6;
 	dns_aclenv_t *aclenv;		     /*%< Localhost/localnets ACLs */
 	ISC_LIST(ns_interface_t) interfaces; /*%< List of interfaces */
+	isc_hashmap_t *byaddr; /*%< Interfaces by address */
 	ISC_LIST(isc_sockaddr_t) listenon;
 	int backlog;		     /*%< Listen queue size */
 	atomic_bool shuttingdown;    /*%< Interfacemgr shutting down */
 	ns_clientmgr_t **clientmgrs; /*%< Client managers */
 	isc_nmhandle_t *route;
+	bool rescan_pending; /*%< A route socket rescan is scheduled */
 };
 
 static void
@@ -87,6 +93,42 @@ purge_old_interfaces(ns_interfacemgr_t *mgr);
 static void
 clearlistenon(ns_interfacemgr_t *mgr);
 
+/*
+ * The interfaces are indexed by their address alone, so that the
+ * route socket handler, which gets no port from the kernel, can use
+ * the same index as the scanner.
+ */
+static uint32_t
+interface_hash(const isc_sockaddr_t *addr) {
+	return (isc_sockaddr_hash(addr, true));
+}
+
+static bool
+interface_match(void *node, const void *key) {
+	const ns_interface_t *ifp = node;
+
+	return (isc_sockaddr_equal(&ifp->addr, key));
+}
+
+static bool
+interface_match_netaddr(void *node, const void *key) {
+	const ns_interface_t *ifp = node;
+	isc_netaddr_t tmp;
+
+	isc_netaddr_fromsockaddr(&tmp, &ifp->addr);
+	if (tmp.family != AF_INET6) {
+		return (false);
+	}
+
+	/*
+	 * We have to nullify the zone (IPv6 scope ID) because we haven't
+	 * got one from the kernel. Otherwise match could fail even for an
+	 * existing address.
+	 */
+	isc_netaddr_setzone(&tmp, 0);
+	return (isc_netaddr_equal(&tmp, key));
+}
+
 static bool
 need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
 	if (rtm->MSGTYPE != RTM_NEWADDR && rtm->MSGTYPE != RTM_DELADDR) {
@@ -119,10 +161,13 @@ need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
 				bool existed = false;
 				bool was_listening = false;
 				isc_netaddr_t addr = { 0 };
+				isc_sockaddr_t sa;
 				ns_interface_t *ifp = NULL;
+				isc_result_t result;
 
 				isc_netaddr_fromin6(&addr, RTA_DATA(rth));
 				INSIST(isc_netaddr_getzone(&addr) == 0);
+				isc_sockaddr_fromnetaddr(&sa, &addr, 0);
 
 				/*
 				 * Check whether we were listening on the
@@ -133,30 +178,13 @@ need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
 				 * router advertisements?)
 				 */
 				LOCK(&mgr->lock);
-				for (ifp = ISC_LIST_HEAD(mgr->interfaces);
-				     ifp != NULL;
-				     ifp = ISC_LIST_NEXT(ifp, link))
-				{
-					isc_netaddr_t tmp = { 0 };
-					isc_netaddr_fromsockaddr(&tmp,
-								 &ifp->addr);
-					if (tmp.family != AF_INET6) {
-						continue;
-					}
-
-					/*
-					 * We have to nullify the zone (IPv6
-					 * scope ID) because we haven't got one
-					 * from the kernel. Otherwise match
-					 * could fail even for an existing
-					 * address.
-					 */
-					isc_netaddr_setzone(&tmp, 0);
-					if (isc_netaddr_equal(&tmp, &addr)) {
-						was_listening = LISTENING(ifp);
-						existed = true;
-						break;
-					}
+				result = isc_hashmap_find(
+					mgr->byaddr, interface_hash(&sa),
+					interface_match_netaddr, &addr,
+					(void **)&ifp);
+				if (result == ISC_R_SUCCESS) {
+					was_listening = LISTENING(ifp);
+					existed = true;
 				}
 				UNLOCK(&mgr->lock);
 
@@ -193,6 +221,17 @@ need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
 	return (false);
 }
 
+static void
+route_rescan(void *arg) {
+	ns_interfacemgr_t *mgr = (ns_interfacemgr_t *)arg;
+
+	mgr->rescan_pending = false;
+	if (!atomic_load(&mgr->shuttingdown)) {
+		ns_interfacemgr_scan(mgr, false, false);
+	}
+	ns_interfacemgr_unref(mgr);
+}
+
 static void
 route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	   void *arg) {
@@ -243,8 +282,17 @@ route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 
 	REQUIRE(mgr->route != NULL);
 
-	if (need_rescan(mgr, rtm, rtmlen) && mgr->sctx->interface_auto) {
-		ns_interfacemgr_scan(mgr, false, false);
+	/*
+	 * Adding or removing many addresses at once makes the kernel send
+	 * a message for each of them; the ones read before the rescan runs
+	 * are all handled by a single scan.
+	 */
+	if (need_rescan(mgr, rtm, rtmlen) && mgr->sctx->interface_auto &&
+	    !mgr->rescan_pending)
+	{
+		mgr->rescan_pending = true;
+		ns_interfacemgr_ref(mgr);
+		isc_async_run(isc_loop_main(mgr->loopmgr), route_rescan, mgr);
 	}
 
 	isc_nm_read(handle, route_recv, mgr);
@@ -300,6 +348,7 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
+	isc_hashmap_create(mctx, INTERFACES_HASHBITS, &mgr->byaddr);
 
 	/*
 	 * The listen-on lists are initially empty.
@@ -333,6 +382,7 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 	return (ISC_R_SUCCESS);
 
 cleanup_lock:
+	isc_hashmap_destroy(&mgr->byaddr);
 	isc_mutex_destroy(&mgr->lock);
 	ns_server_detach(&mgr->sctx);
 	isc_mem_putanddetach(&mgr->mctx, mgr, sizeof(*mgr));
@@ -384,6 +434,8 @@ ns_interfacemgr__destroy(ns_interfacemgr_t *mgr) {
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 	clearlistenon(mgr);
+	INSIST(isc_hashmap_count(mgr->byaddr) == 0);
+	isc_hashmap_destroy(&mgr->byaddr);
 	isc_mutex_destroy(&mgr->lock);
 	for (size_t i = 0; i < mgr->ncpus; i++) {
 		ns_clientmgr_detach(&mgr->clientmgrs[i]);
@@ -449,6 +501,7 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 		    const char *name, ns_interface_t **ifpret) {
 	ns_interface_t *ifp = NULL;
 	const char *default_name = "default";
+	isc_result_t result;
 
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
 
@@ -473,6 +526,9 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 	ifp->magic = IFACE_MAGIC;
 
 	LOCK(&mgr->lock);
+	result = isc_hashmap_add(mgr->byaddr, interface_hash(&ifp->addr),
+				 interface_match, &ifp->addr, ifp, NULL);
+	INSIST(result == ISC_R_SUCCESS);
 	ISC_LIST_APPEND(mgr->interfaces, ifp, link);
 	UNLOCK(&mgr->lock);
 
@@ -480,19 +536,22 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 }
 
 static isc_result_t
-ns_interface_listenudp(ns_interface_t *ifp, isc_nm_proxy_type_t proxy) {
+ns_interface_listenudp(ns_interface_t *ifp, isc_nm_proxy_type_t proxy,
+		       uint32_t recv_batch) {
 	isc_result_t result;
 
 	/* Reserve space for an ns_client_t with the netmgr handle */
 	if (proxy == ISC_NM_PROXY_NONE) {
 		result = isc_nm_listenudp(ifp->mgr->nm, ISC_NM_LISTEN_ALL,
-					  &ifp->addr, ns_client_request, ifp,
+					  &ifp->addr, recv_batch,
+					  ns_client_request, ifp,
 					  &ifp->udplistensocket);
 	} else {
 		INSIST(proxy == ISC_NM_PROXY_PLAIN);
-		result = isc_nm_listenproxyudp(ifp->mgr->nm, ISC_NM_LISTEN_ALL,
-					       &ifp->addr, ns_client_request,
-					       ifp, &ifp->udplistensocket);
+		result = isc_nm_listenproxyudp(
+			ifp->mgr->nm, ISC_NM_LISTEN_ALL, &ifp->addr,
+			recv_batch, ns_client_request, ifp,
+			&ifp->udplistensocket);
 	}
 	return (result);
 }
@@ -678,6 +737,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 
 	ifp->flags |= NS_INTERFACEFLAG_LISTENING;
 	ifp->proxy_type = elt->proxy;
+	ifp->udp_recv_batch = elt->udp_recv_batch;
 
 	if (elt->is_http) {
 		result = ns_interface_listenhttp(
@@ -700,7 +760,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		return (result);
 	}
 
-	result = ns_interface_listenudp(ifp, elt->proxy);
+	result = ns_interface_listenudp(ifp, elt->proxy, elt->udp_recv_batch);
 	if (result != ISC_R_SUCCESS) {
 		if ((result == ISC_R_ADDRINUSE) && (addr_in_use != NULL)) {
 			*addr_in_use = true;
@@ -792,17 +852,14 @@ interface_destroy(ns_interface_t **interfacep) {
  */
 static ns_interface_t *
 find_matching_interface(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr) {
-	ns_interface_t *ifp;
+	ns_interface_t *ifp = NULL;
+	isc_result_t result;
+
 	LOCK(&mgr->lock);
-	for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL;
-	     ifp = ISC_LIST_NEXT(ifp, link))
-	{
-		if (isc_sockaddr_equal(&ifp->addr, addr)) {
-			break;
-		}
-	}
+	result = isc_hashmap_find(mgr->byaddr, interface_hash(addr),
+				  interface_match, addr, (void **)&ifp);
 	UNLOCK(&mgr->lock);
-	return (ifp);
+	return (result == ISC_R_SUCCESS ? ifp : NULL);
 }
 
 static void
@@ -828,6 +885,10 @@ purge_old_interfaces(ns_interfacemgr_t *mgr) {
 		INSIST(NS_INTERFACE_VALID(ifp));
 		next = ISC_LIST_NEXT(ifp, link);
 		if (ifp->generation != mgr->generation) {
+			isc_result_t result = isc_hashmap_delete(
+				mgr->byaddr, interface_hash(&ifp->addr),
+				interface_match, &ifp->addr);
+			INSIST(result == ISC_R_SUCCESS);
 			ISC_LIST_UNLINK(ifp->mgr->interfaces, ifp, link);
 			ISC_LIST_APPEND(interfaces, ifp, link);
 		}
@@ -1051,9 +1112,11 @@ same_listener_type(ns_interface_t *ifp, ns_listenelt_t *new_le) {
 
 	/*
 	 * Check if transport type of the listener has not changed. That
-	 * implies that PROXY type has not been changed as well.
+	 * implies that PROXY type and the UDP receive batch size have not
+	 * been changed as well.
 	 */
-	return (same_transport_type && new_le->proxy == ifp->proxy_type);
+	return (same_transport_type && new_le->proxy == ifp->proxy_type &&
+		new_le->udp_recv_batch == ifp->udp_recv_batch);
 }
 
 static bool
@@ -1268,9 +1331,18 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 			(void)dns_acl_match(&interface.address, NULL, le->acl,
 					    mgr->aclenv, &match, NULL);
 			if (match <= 0) {
-				ns_interface_t *new = NULL;
-				ns_interface_create(mgr, &listen_sockaddr,
-						    interface.name, &new);
+				ns_interface_t *old = find_matching_interface(
+					mgr, &listen_sockaddr);
+				if (old == NULL) {
+					ns_interface_create(mgr,
+							    &listen_sockaddr,
+							    interface.name,
+							    &old);
+				} else if (!LISTENING(old)) {
+					LOCK(&mgr->lock);
+					old->generation = mgr->generation;
+					UNLOCK(&mgr->lock);
+				}
 				continue;
 			}
 
@@ -1440,6 +1512,25 @@ ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr) {
 	UNLOCK(&mgr->lock);
 }
 
+isc_nanosecs_t
+ns_interfacemgr_oldestrecursion(ns_interfacemgr_t *mgr) {
+	isc_nanosecs_t oldest = 0;
+
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+
+	LOCK(&mgr->lock);
+	for (size_t i = 0; i < mgr->ncpus; i++) {
+		isc_nanosecs_t start =
+			ns_client_oldestrecursion(mgr->clientmgrs[i]);
+		if (start != 0 && (oldest == 0 || start < oldest)) {
+			oldest = start;
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	return (oldest);
+}
+
 bool
 ns_interfacemgr_listeningon(ns_interfacemgr_t *mgr,
 			    const isc_sockaddr_t *addr) {
@@ -198,6 +198,7 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, dns_acl_t *acl,
 	elt->http_max_clients = 0;
 	elt->max_concurrent_streams = 0;
 	elt->proxy = proxy;
+	elt->udp_recv_batch = ISC_NM_UDP_RECVBATCH_DEFAULT;
 
 	*target = elt;
 	return (ISC_R_SUCCESS);
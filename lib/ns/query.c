@@ -56,8 +56,11 @@
 #include <dns/rdatasetiter.h>
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
+#include <dns/refresh.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
+#include <dns/sdlz.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
 #include <dns/types.h>
@@ -479,6 +482,9 @@ query_ncache(query_ctx_t *qctx, isc_result_t result);
 static isc_result_t
 query_coveringnsec(query_ctx_t *qctx);
 
+static isc_result_t
+query_coveringnsec3(query_ctx_t *qctx);
+
 static isc_result_t
 query_zerottl_refetch(query_ctx_t *qctx);
 
@@ -874,6 +880,8 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.respcache_versionid = 0;
+	client->query.respcache_flags = 0;
 }
 
 static void
@@ -1201,6 +1209,7 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 		partial = true;
 	}
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		dns_zone_demand(zone);
 		result = dns_zone_getdb(zone, &db);
 	}
 
@@ -2233,6 +2242,31 @@ query_additional(query_ctx_t *qctx, dns_name_t *name,
 		}
 	}
 
+	/*
+	 * The addresses of the targets of MX and SRV records in an
+	 * authoritative answer can be taken from a cache kept with the
+	 * zone version, as long as they are all in the same zone.
+	 */
+	if ((rdataset->type == dns_rdatatype_mx ||
+	     rdataset->type == dns_rdatatype_srv) &&
+	    qctx->is_zone && qctx->db == client->query.authdb &&
+	    qctx->view->minimalresponses != dns_minimal_yes)
+	{
+		ns_dbversion_t *dbversion = NULL;
+
+		dbversion = ns_client_findversion(client, qctx->db);
+		if (dbversion == NULL) {
+			goto regular;
+		}
+
+		result = dns_db_addadditional(qctx->db, dbversion->version,
+					      rdataset, WANTDNSSEC(client),
+					      client->message);
+		if (result == ISC_R_SUCCESS) {
+			return;
+		}
+	}
+
 regular:
 	/*
 	 * Add other additional data if needed.
@@ -2588,12 +2622,13 @@ recursionquotatype_attach(ns_client_t *client, bool soft_limit) {
 		return (result);
 	}
 
-	recurscount = ns_stats_increment(client->manager->sctx->nsstats,
-					 ns_statscounter_recursclients);
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_recursclients);
+	recurscount = ns_stats_get_counter(client->manager->sctx->nsstats,
+					   ns_statscounter_recursclients);
 
 	ns_stats_update_if_greater(client->manager->sctx->nsstats,
-				   ns_statscounter_recurshighwater,
-				   recurscount + 1);
+				   ns_statscounter_recurshighwater, recurscount);
 
 	return (result);
 }
@@ -2697,6 +2732,42 @@ stale_refresh_aftermath(ns_client_t *client, isc_result_t result) {
 	}
 }
 
+/*%
+ * Track the outage state of the zone cut above 'name' from the result of
+ * a fetch for it: a timeout starts an outage, and an answer ends it.
+ */
+static void
+query_trackoutage(ns_client_t *client, const dns_name_t *name,
+		  isc_result_t result) {
+	if (!dns_view_staleanswerenabled(client->view)) {
+		return;
+	}
+
+	switch (result) {
+	case ISC_R_TIMEDOUT:
+		dns_view_setoutage(client->view, name, isc_stdtime_now());
+		break;
+	case ISC_R_SUCCESS:
+	case DNS_R_GLUE:
+	case DNS_R_ZONECUT:
+	case ISC_R_NOTFOUND:
+	case DNS_R_DELEGATION:
+	case DNS_R_EMPTYNAME:
+	case DNS_R_NXRRSET:
+	case DNS_R_EMPTYWILD:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_COVERINGNSEC:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+	case DNS_R_CNAME:
+	case DNS_R_DNAME:
+		dns_view_clearoutage(client->view, name, isc_stdtime_now());
+		break;
+	default:
+		break;
+	}
+}
+
 static void
 cleanup_after_fetch(dns_fetchresponse_t *resp, const char *ctracestr,
 		    ns_query_rectype_t recursion_type) {
@@ -2722,6 +2793,7 @@ cleanup_after_fetch(dns_fetchresponse_t *resp, const char *ctracestr,
 
 	/* Some type of recursions require a bit of aftermath. */
 	if (recursion_type == RECTYPE_STALE_REFRESH) {
+		query_trackoutage(client, client->query.qname, result);
 		stale_refresh_aftermath(client, result);
 	}
 
@@ -2814,6 +2886,18 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 	       dns_rdataset_t *rdataset) {
 	CTRACE(ISC_LOG_DEBUG(3), "query_prefetch");
 
+	/*
+	 * Hand popular RRsets to the refresher so that they are
+	 * refetched before they expire even if no query arrives in the
+	 * prefetch window.
+	 */
+	if ((rdataset->attributes & DNS_RDATASETATTR_POPULAR) != 0 &&
+	    client->view->refresh != NULL)
+	{
+		dns_refresh_add(client->view->refresh, qname, rdataset->type,
+				client->now + rdataset->ttl);
+	}
+
 	if (FETCH_RECTYPE_PREFETCH(client) != NULL ||
 	    client->view->prefetch_trigger == 0U ||
 	    rdataset->ttl > client->view->prefetch_trigger ||
@@ -3419,6 +3503,7 @@ rpz_rewrite_ip(ns_client_t *client, const isc_netaddr_t *netaddr,
 	dns_dbnode_t *p_node;
 	dns_rpz_policy_t policy;
 	isc_result_t result;
+	bool found = false;
 
 	CTRACE(ISC_LOG_DEBUG(3), "rpz_rewrite_ip");
 
@@ -3431,12 +3516,26 @@ rpz_rewrite_ip(ns_client_t *client, const isc_netaddr_t *netaddr,
 	p_db = NULL;
 	p_node = NULL;
 
+	if (zbits == 0) {
+		return (ISC_R_SUCCESS);
+	}
+	if (!dns_rpz_filter_ip(rpzs, netaddr)) {
+		inc_stats(client, ns_statscounter_rpzfilterskip);
+		return (ISC_R_SUCCESS);
+	}
+	inc_stats(client, ns_statscounter_rpzfilterpass);
+
 	while (zbits != 0) {
 		rpz_num = dns_rpz_find_ip(rpzs, rpz_type, zbits, netaddr,
 					  ip_name, &prefix);
 		if (rpz_num == DNS_RPZ_INVALID_NUM) {
+			if (!found) {
+				inc_stats(client,
+					  ns_statscounter_rpzfilterfalse);
+			}
 			break;
 		}
+		found = true;
 		zbits &= (DNS_RPZ_ZMASK(rpz_num) >> 1);
 
 		/*
@@ -3755,10 +3854,18 @@ rpz_rewrite_name(ns_client_t *client, dns_name_t *trig_name,
 	 * Use the summary database to find the bit mask of policy zones
 	 * with policies for this trigger name. We do this even if there
 	 * is only one eligible policy zone so that wildcard triggers
-	 * are matched correctly, and not into their parent.
+	 * are matched correctly, and not into their parent.  The
+	 * filter first rules out most names without any search.
 	 */
+	if (!dns_rpz_filter_name(rpzs, trig_name)) {
+		inc_stats(client, ns_statscounter_rpzfilterskip);
+		return (ISC_R_SUCCESS);
+	}
+	inc_stats(client, ns_statscounter_rpzfilterpass);
+
 	zbits = dns_rpz_find_name(rpzs, rpz_type, zbits, trig_name);
 	if (zbits == 0) {
+		inc_stats(client, ns_statscounter_rpzfilterfalse);
 		return (ISC_R_SUCCESS);
 	}
 
@@ -5401,131 +5508,593 @@ qctx_setrad(query_ctx_t *qctx) {
 	}
 }
 
+/*
+ * Request properties, besides the question itself, that the rendered
+ * response depends on.  Together with the zone version they form the
+ * response cache key.
+ */
+#define RESPCACHE_HDRFLAGS \
+	(DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_AD | DNS_MESSAGEFLAG_CD)
+#define RESPCACHE_DNSSEC 0x010000
+#define RESPCACHE_EDNS	 0x020000
+#define RESPCACHE_TCP	 0x040000
+#define RESPCACHE_INET6	 0x080000
+#define RESPCACHE_RA	 0x100000
+
+/*
+ * Cached responses are reused for at most this many seconds after they
+ * were rendered.  The zone version id invalidates them when the zone
+ * changes; the lifetime bounds the reuse of additional data that was
+ * taken from other zones or the cache.
+ */
+#define RESPCACHE_LIFETIME 1
+
+static uint32_t
+respcache_flags(ns_client_t *client) {
+	uint32_t flags = client->message->flags & RESPCACHE_HDRFLAGS;
+
+	if (WANTDNSSEC(client)) {
+		flags |= RESPCACHE_DNSSEC;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		flags |= RESPCACHE_EDNS;
+	}
+	if (TCP(client)) {
+		flags |= RESPCACHE_TCP;
+	}
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		flags |= RESPCACHE_INET6;
+	}
+	if ((client->attributes & NS_CLIENTATTR_RA) != 0) {
+		flags |= RESPCACHE_RA;
+	}
+
+	return (flags);
+}
+
 /*%
- * Starting point for a client query or a chaining query.
+ * Check that no per-client or per-response feature (signatures, RRL,
+ * RPZ, DNS64, sortlist, padding, plugins, dnstap, ...) would make the
+ * response to this query different from the response rendered for
+ * another client asking the same question with the same flags.
  *
- * Called first by query_setup(), and then again as often as needed to
- * follow a CNAME chain.  Determines which authoritative database to
- * search, then hands off processing to query_lookup().
+ * EDNS Client Subnet doesn't: zone and cache data are the same for
+ * every subnet, so all answers have global scope, and the ECS option
+ * echoed to each client is part of the OPT record that
+ * ns_client_sendcached() renders for it.
  */
-isc_result_t
-ns__query_start(query_ctx_t *qctx) {
-	isc_result_t result = ISC_R_UNSET;
-	CCTRACE(ISC_LOG_DEBUG(3), "ns__query_start");
-	qctx->want_restart = false;
-	qctx->authoritative = false;
-	qctx->version = NULL;
-	qctx->zversion = NULL;
-	qctx->need_wildcardproof = false;
-	qctx->rpz = false;
+static bool
+respcache_plain(ns_client_t *client) {
+	dns_view_t *view = client->view;
 
-	CALL_HOOK(NS_QUERY_START_BEGIN, qctx);
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    (client->attributes & NS_CLIENTATTR_WANTEXPIRE) != 0 ||
+	    client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta ||
+	    isc_nm_is_http_handle(client->handle))
+	{
+		return (false);
+	}
 
-	/*
-	 * If we require a server cookie or the presented server
-	 * cookie was bad then send back BADCOOKIE before we have
-	 * done too much work.
-	 */
-	if (!TCP(qctx->client) &&
-	    (BADCOOKIE(qctx->client) ||
-	     (qctx->view->requireservercookie && WANTCOOKIE(qctx->client) &&
-	      !HAVECOOKIE(qctx->client))))
+	if (view->rrl != NULL || view->dns64cnt != 0 || view->sortlist != NULL ||
+	    view->padding > 0 || view->nocasecompress != NULL ||
+	    view->hooktable != NULL || view->dtenv != NULL ||
+	    (view->rpzs != NULL && view->rpzs->p.num_zones != 0))
 	{
-		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AA;
-		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AD;
-		qctx->client->message->rcode = dns_rcode_badcookie;
-		qctx->client->attributes &= ~NS_CLIENTATTR_WANTRC;
-		return (ns_query_done(qctx));
+		return (false);
 	}
 
-	/*
-	 * Respond with TC=1 if we need TCP for this request.
-	 */
-	if (!TCP(qctx->client) && NEEDTCP(qctx->client)) {
-		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AA;
-		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AD;
-		qctx->client->message->flags |= DNS_MESSAGEFLAG_TC;
-		return (ns_query_done(qctx));
+	if ((client->manager->sctx->options & NS_SERVER_LOGRESPONSES) != 0) {
+		return (false);
 	}
 
-	if (qctx->view->checknames &&
-	    !dns_rdata_checkowner(qctx->client->query.qname,
-				  qctx->client->message->rdclass, qctx->qtype,
-				  false))
+	return (true);
+}
+
+/*%
+ * Decide whether the response to this query may be served from, and
+ * stored in, the view's response cache: it must be a plain authoritative
+ * answer from a primary or secondary zone.
+ */
+static bool
+respcache_eligible(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+
+	if (qctx->view->respcache == NULL || !qctx->is_zone ||
+	    qctx->zone == NULL || qctx->fresp != NULL ||
+	    client->query.restarts != 0 || RECURSIONOK(client))
 	{
-		char namebuf[DNS_NAME_FORMATSIZE];
-		char typebuf[DNS_RDATATYPE_FORMATSIZE];
-		char classbuf[DNS_RDATACLASS_FORMATSIZE];
+		return (false);
+	}
 
-		dns_name_format(qctx->client->query.qname, namebuf,
-				sizeof(namebuf));
-		dns_rdatatype_format(qctx->qtype, typebuf, sizeof(typebuf));
-		dns_rdataclass_format(qctx->client->message->rdclass, classbuf,
-				      sizeof(classbuf));
-		ns_client_log(qctx->client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_QUERY, ISC_LOG_ERROR,
-			      "check-names failure %s/%s/%s", namebuf, typebuf,
-			      classbuf);
-		QUERY_ERROR(qctx, DNS_R_REFUSED);
-		return (ns_query_done(qctx));
+	switch (dns_zone_gettype(qctx->zone)) {
+	case dns_zone_primary:
+	case dns_zone_secondary:
+		break;
+	default:
+		return (false);
 	}
 
-	/*
-	 * Setup for root key sentinel processing.
-	 */
-	if (qctx->view->root_key_sentinel &&
-	    qctx->client->query.restarts == 0 &&
-	    (qctx->qtype == dns_rdatatype_a ||
-	     qctx->qtype == dns_rdatatype_aaaa) &&
-	    (qctx->client->message->flags & DNS_MESSAGEFLAG_CD) == 0)
-	{
-		root_key_sentinel_detect(qctx);
+	if ((dns_zone_getoptions(qctx->zone) & DNS_ZONEOPT_LOGREPORTS) != 0) {
+		return (false);
 	}
 
-	/*
-	 * First we must find the right database. Reset the options but preserve
-	 * the 'nolog' flag.
-	 */
-	qctx->options = (dns_getdb_options_t){ .nolog = qctx->options.nolog };
-	if (dns_rdatatype_atparent(qctx->qtype) &&
-	    !dns_name_equal(qctx->client->query.qname, dns_rootname))
+	return (respcache_plain(client));
+}
+
+/*%
+ * Decide whether the response to a query resumed after normal recursion
+ * may be shared with the other clients whose fetches joined the same
+ * fetch context: the client must have been waiting for the answer to
+ * its original question, not to a CNAME target.  Queries with an EDNS
+ * Client Subnet option are shared like the rest: the answer is one of
+ * global scope, and ns_client_sendcached() renders each client's own
+ * option.
+ */
+static bool
+respshare_eligible(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+
+	if (qctx->view->respshare == NULL || qctx->fetchid == 0 ||
+	    client->query.restarts != 0 || PARTIALANSWER(client) ||
+	    qctx->fresp->qtype != client->query.qtype)
 	{
-		/*
-		 * If authoritative data for this QTYPE is supposed to live in
-		 * the parent zone, do not look for an exact match for QNAME,
-		 * but rather for its containing zone (unless the QNAME is
-		 * root).
-		 */
-		qctx->options.noexact = true;
+		return (false);
 	}
 
-	result = query_getdb(qctx->client, qctx->client->query.qname,
-			     qctx->qtype, qctx->options, &qctx->zone, &qctx->db,
-			     &qctx->version, &qctx->is_zone);
-	if ((result != ISC_R_SUCCESS || !qctx->is_zone) &&
-	    qctx->qtype == dns_rdatatype_ds && !RECURSIONOK(qctx->client) &&
-	    qctx->options.noexact)
-	{
+	return (respcache_plain(client));
+}
+
+/*%
+ * Responses are shared between clients regardless of the case of the
+ * question name; ns_client_sendcached() restores each client's case.
+ */
+static dns_name_t *
+respshare_name(ns_client_t *client, dns_fixedname_t *fixed) {
+	dns_name_t *name = dns_fixedname_initname(fixed);
+
+	RUNTIME_CHECK(dns_name_downcase(client->query.qname, name, NULL) ==
+		      ISC_R_SUCCESS);
+	return (name);
+}
+
+/*%
+ * Send the response in 'r', found in one of the view's response caches,
+ * and account for it as query_send() would have.
+ */
+static void
+respcache_sent(query_ctx_t *qctx, const isc_region_t *r,
+	       unsigned int counter) {
+	ns_client_t *client = qctx->client;
+	uint16_t flags;
+
+	flags = (r->base[2] << 8) | r->base[3];
+	if ((flags & DNS_MESSAGEFLAG_AA) == 0) {
+		inc_stats(client, ns_statscounter_nonauthans);
+	} else {
+		inc_stats(client, ns_statscounter_authans);
+	}
+	inc_stats(client, (isc_statscounter_t)counter);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+
+	isc_nmhandle_detach(&client->reqhandle);
+	qctx->detach_client = true;
+}
+
+/*%
+ * Answer the query from the view's response cache if a response built
+ * from the current version of the zone is cached.  Otherwise mark the
+ * query so that ns_client_send() caches the response once rendered.
+ *
+ * Returns ISC_R_COMPLETE if query processing should continue.
+ */
+static isc_result_t
+query_respcache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	isc_result_t result;
+	isc_region_t r;
+	unsigned int counter;
+
+	if (!respcache_eligible(qctx)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	client->query.respcache_versionid = dns_db_versionid(qctx->db,
+							     qctx->version);
+	if (client->query.respcache_versionid == 0) {
+		return (ISC_R_COMPLETE);
+	}
+	client->query.respcache_flags = respcache_flags(client);
+	client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+
+	result = dns_respcache_find(
+		qctx->view->respcache, client->query.qname,
+		client->query.qtype, client->message->rdclass,
+		client->query.respcache_flags,
+		client->query.respcache_versionid, client->now, &r, &counter);
+	if (result == ISC_R_SUCCESS) {
 		/*
-		 * This is a non-recursive QTYPE=DS query with QNAME whose
-		 * parent we are not authoritative for.  Check whether we are
-		 * authoritative for QNAME, because if so, we need to send a
-		 * "no data" response as required by RFC 4035, section 3.1.4.1.
+		 * If the cached response doesn't fit, fall back to
+		 * rendering a (possibly truncated) one.
 		 */
-		dns_db_t *tdb = NULL;
-		dns_zone_t *tzone = NULL;
-		dns_dbversion_t *tversion = NULL;
-		isc_result_t tresult;
+		result = ns_client_sendcached(client, &r);
+	}
+	if (result != ISC_R_SUCCESS) {
+		inc_stats(client, ns_statscounter_respcachemiss);
+		return (ISC_R_COMPLETE);
+	}
 
-		dns_getdb_options_t options = { .partial = true };
-		tresult = query_getzonedb(
-			qctx->client, qctx->client->query.qname, qctx->qtype,
-			options, &tzone, &tdb, &tversion);
-		if (tresult == ISC_R_SUCCESS) {
-			/*
-			 * We are authoritative for QNAME.  Attach the relevant
-			 * zone to query context, set result to ISC_R_SUCCESS.
-			 */
+	inc_stats(client, ns_statscounter_respcachehit);
+	respcache_sent(qctx, &r, counter);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Answer a query resumed after recursion with the response already
+ * rendered for another client whose fetch joined the same fetch context,
+ * instead of looking up the cache and rendering the response again.
+ * Otherwise mark the query so that ns_client_send() shares the response
+ * once rendered.
+ *
+ * Returns ISC_R_COMPLETE if query processing should continue.
+ */
+static isc_result_t
+query_respshare(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_fixedname_t fixed;
+	isc_result_t result;
+	isc_region_t r;
+	unsigned int counter;
+
+	if (!respshare_eligible(qctx)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	client->query.respcache_versionid = qctx->fetchid;
+	client->query.respcache_flags = respcache_flags(client);
+	client->query.attributes |= NS_QUERYATTR_RESPSHARE;
+
+	result = dns_respcache_find(
+		qctx->view->respshare, respshare_name(client, &fixed),
+		client->query.qtype, client->message->rdclass,
+		client->query.respcache_flags,
+		client->query.respcache_versionid, client->now, &r, &counter);
+	if (result == ISC_R_SUCCESS) {
+		result = ns_client_sendcached(client, &r);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_COMPLETE);
+	}
+
+	inc_stats(client, ns_statscounter_respshared);
+	respcache_sent(qctx, &r, counter);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns__query_respcache_add(ns_client_t *client, isc_buffer_t *buffer,
+			bool opt_included) {
+	dns_message_t *message = client->message;
+	bool share = (client->query.attributes & NS_QUERYATTR_RESPSHARE) != 0;
+	dns_respcache_t *cache = NULL;
+	const dns_name_t *name = client->query.qname;
+	dns_fixedname_t fixed;
+	isc_statscounter_t counter;
+	isc_region_t r;
+	dns_ttl_t ttl;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE((client->query.attributes &
+		 (NS_QUERYATTR_RESPCACHE | NS_QUERYATTR_RESPSHARE)) != 0);
+
+	if (client->view == NULL || client->query.restarts != 0 ||
+	    PARTIALANSWER(client) || client->ede != NULL)
+	{
+		return;
+	}
+
+	if (share) {
+		cache = client->view->respshare;
+		name = respshare_name(client, &fixed);
+	} else {
+		cache = client->view->respcache;
+	}
+	if (cache == NULL) {
+		return;
+	}
+
+	/*
+	 * This mirrors the counter selection in query_send(), which
+	 * has already run for this response.
+	 */
+	switch (message->rcode) {
+	case dns_rcode_noerror:
+		if (ISC_LIST_EMPTY(message->sections[DNS_SECTION_ANSWER])) {
+			if (client->query.isreferral) {
+				counter = ns_statscounter_referral;
+			} else {
+				counter = ns_statscounter_nxrrset;
+			}
+		} else {
+			counter = ns_statscounter_success;
+		}
+		break;
+	case dns_rcode_nxdomain:
+		counter = ns_statscounter_nxdomain;
+		break;
+	default:
+		return;
+	}
+
+	/*
+	 * Zero TTL answers must not be reused by later queries, but can
+	 * be shared with the clients waiting for the same fetch.
+	 */
+	if (!share &&
+	    dns_message_response_minttl(message, &ttl) == ISC_R_SUCCESS &&
+	    ttl == 0)
+	{
+		return;
+	}
+
+	isc_buffer_usedregion(buffer, &r);
+
+	/*
+	 * The OPT record is rendered last and rebuilt for every client,
+	 * so strip it, but leave ARCOUNT accounting for it: the cached
+	 * response is only served to clients that also sent an OPT.
+	 */
+	if (opt_included) {
+		dns_rdataset_t *opt = dns_message_getopt(message);
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		unsigned int optlen;
+
+		if (opt == NULL || dns_rdataset_first(opt) != ISC_R_SUCCESS) {
+			return;
+		}
+		dns_rdataset_current(opt, &rdata);
+		optlen = 11 + rdata.length;
+		if (r.length < DNS_MESSAGE_HEADERLEN + optlen ||
+		    r.base[r.length - optlen] != 0)
+		{
+			return;
+		}
+		r.length -= optlen;
+	}
+
+	dns_respcache_add(cache, name, client->query.qtype, message->rdclass,
+			  client->query.respcache_flags,
+			  client->query.respcache_versionid,
+			  client->now + RESPCACHE_LIFETIME, &r, counter);
+}
+
+/*
+ * Asynchronous DLZ lookups: the driver is asked on a worker thread, and
+ * the query starts over once the answers are in the DLZ cache.
+ */
+static void
+dlzprefetch_cancel(ns_hookasync_t *ctx) {
+	/*
+	 * The driver can't be interrupted; the query is given up when
+	 * the lookup completes.
+	 */
+	UNUSED(ctx);
+}
+
+static void
+dlzprefetch_destroy(ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = *ctxp;
+
+	*ctxp = NULL;
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
+static void
+dlzprefetch_done(void *arg) {
+	ns_hook_resume_t *rev = arg;
+
+	rev->cb(rev);
+}
+
+static isc_result_t
+dlzprefetch_run(query_ctx_t *qctx, isc_mem_t *mctx, void *arg,
+		isc_loop_t *loop, isc_job_cb cb, void *evarg,
+		ns_hookasync_t **ctxp) {
+	dns_dlzdb_t *dlzdb = arg;
+	ns_hook_resume_t *rev = isc_mem_get(mctx, sizeof(*rev));
+	ns_hookasync_t *ctx = isc_mem_get(mctx, sizeof(*ctx));
+	isc_result_t result;
+
+	*ctx = (ns_hookasync_t){
+		.cancel = dlzprefetch_cancel,
+		.destroy = dlzprefetch_destroy,
+	};
+	isc_mem_attach(mctx, &ctx->mctx);
+
+	*rev = (ns_hook_resume_t){
+		.hookpoint = NS_QUERY_START_BEGIN,
+		.origresult = ISC_R_UNSET,
+		.saved_qctx = qctx,
+		.ctx = ctx,
+		.loop = loop,
+		.cb = cb,
+		.arg = evarg,
+	};
+
+	result = dns_sdlz_prefetch(dlzdb, qctx->view->rdclass,
+				   qctx->client->query.qname, loop,
+				   dlzprefetch_done, rev);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * Too many lookups are running already: start over right
+		 * away and ask the driver synchronously.
+		 */
+		isc_async_run(loop, cb, rev);
+	}
+
+	*ctxp = ctx;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Return true if the query was suspended to look up the query name in
+ * a DLZ database on a worker thread.  This is done only once per
+ * client query, as the answers may not be cacheable.
+ */
+static bool
+query_dlzprefetch(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_dlzdb_t *dlzdb = NULL;
+
+	if ((client->query.attributes & NS_QUERYATTR_DLZPREFETCH) != 0) {
+		return (false);
+	}
+	client->query.attributes |= NS_QUERYATTR_DLZPREFETCH;
+
+	ISC_LIST_FOREACH (qctx->view->dlz_searched, dlzdb, link) {
+		if (dns_sdlz_needprefetch(dlzdb, client->query.qname)) {
+			(void)ns_query_hookasync(qctx, dlzprefetch_run, dlzdb);
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*%
+ * Starting point for a client query or a chaining query.
+ *
+ * Called first by query_setup(), and then again as often as needed to
+ * follow a CNAME chain.  Determines which authoritative database to
+ * search, then hands off processing to query_lookup().
+ */
+isc_result_t
+ns__query_start(query_ctx_t *qctx) {
+	isc_result_t result = ISC_R_UNSET;
+	CCTRACE(ISC_LOG_DEBUG(3), "ns__query_start");
+	qctx->want_restart = false;
+	qctx->authoritative = false;
+	qctx->version = NULL;
+	qctx->zversion = NULL;
+	qctx->need_wildcardproof = false;
+	qctx->rpz = false;
+
+	CALL_HOOK(NS_QUERY_START_BEGIN, qctx);
+
+	/*
+	 * If we require a server cookie or the presented server
+	 * cookie was bad then send back BADCOOKIE before we have
+	 * done too much work.
+	 */
+	if (!TCP(qctx->client) &&
+	    (BADCOOKIE(qctx->client) ||
+	     (qctx->view->requireservercookie && WANTCOOKIE(qctx->client) &&
+	      !HAVECOOKIE(qctx->client))))
+	{
+		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AA;
+		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AD;
+		qctx->client->message->rcode = dns_rcode_badcookie;
+		qctx->client->attributes &= ~NS_CLIENTATTR_WANTRC;
+		return (ns_query_done(qctx));
+	}
+
+	/*
+	 * Respond with TC=1 if we need TCP for this request.
+	 */
+	if (!TCP(qctx->client) && NEEDTCP(qctx->client)) {
+		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AA;
+		qctx->client->message->flags &= ~DNS_MESSAGEFLAG_AD;
+		qctx->client->message->flags |= DNS_MESSAGEFLAG_TC;
+		return (ns_query_done(qctx));
+	}
+
+	if (qctx->view->checknames &&
+	    !dns_rdata_checkowner(qctx->client->query.qname,
+				  qctx->client->message->rdclass, qctx->qtype,
+				  false))
+	{
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char typebuf[DNS_RDATATYPE_FORMATSIZE];
+		char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+		dns_name_format(qctx->client->query.qname, namebuf,
+				sizeof(namebuf));
+		dns_rdatatype_format(qctx->qtype, typebuf, sizeof(typebuf));
+		dns_rdataclass_format(qctx->client->message->rdclass, classbuf,
+				      sizeof(classbuf));
+		ns_client_log(qctx->client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_QUERY, ISC_LOG_ERROR,
+			      "check-names failure %s/%s/%s", namebuf, typebuf,
+			      classbuf);
+		QUERY_ERROR(qctx, DNS_R_REFUSED);
+		return (ns_query_done(qctx));
+	}
+
+	if (query_dlzprefetch(qctx)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	/*
+	 * Setup for root key sentinel processing.
+	 */
+	if (qctx->view->root_key_sentinel &&
+	    qctx->client->query.restarts == 0 &&
+	    (qctx->qtype == dns_rdatatype_a ||
+	     qctx->qtype == dns_rdatatype_aaaa) &&
+	    (qctx->client->message->flags & DNS_MESSAGEFLAG_CD) == 0)
+	{
+		root_key_sentinel_detect(qctx);
+	}
+
+	/*
+	 * First we must find the right database. Reset the options but preserve
+	 * the 'nolog' flag.
+	 */
+	qctx->options = (dns_getdb_options_t){ .nolog = qctx->options.nolog };
+	if (dns_rdatatype_atparent(qctx->qtype) &&
+	    !dns_name_equal(qctx->client->query.qname, dns_rootname))
+	{
+		/*
+		 * If authoritative data for this QTYPE is supposed to live in
+		 * the parent zone, do not look for an exact match for QNAME,
+		 * but rather for its containing zone (unless the QNAME is
+		 * root).
+		 */
+		qctx->options.noexact = true;
+	}
+
+	result = query_getdb(qctx->client, qctx->client->query.qname,
+			     qctx->qtype, qctx->options, &qctx->zone, &qctx->db,
+			     &qctx->version, &qctx->is_zone);
+	if ((result != ISC_R_SUCCESS || !qctx->is_zone) &&
+	    qctx->qtype == dns_rdatatype_ds && !RECURSIONOK(qctx->client) &&
+	    qctx->options.noexact)
+	{
+		/*
+		 * This is a non-recursive QTYPE=DS query with QNAME whose
+		 * parent we are not authoritative for.  Check whether we are
+		 * authoritative for QNAME, because if so, we need to send a
+		 * "no data" response as required by RFC 4035, section 3.1.4.1.
+		 */
+		dns_db_t *tdb = NULL;
+		dns_zone_t *tzone = NULL;
+		dns_dbversion_t *tversion = NULL;
+		isc_result_t tresult;
+
+		dns_getdb_options_t options = { .partial = true };
+		tresult = query_getzonedb(
+			qctx->client, qctx->client->query.qname, qctx->qtype,
+			options, &tzone, &tdb, &tversion);
+		if (tresult == ISC_R_SUCCESS) {
+			/*
+			 * We are authoritative for QNAME.  Attach the relevant
+			 * zone to query context, set result to ISC_R_SUCCESS.
+			 */
 			qctx->options.noexact = false;
 			ns_client_putrdataset(qctx->client, &qctx->rdataset);
 			if (qctx->db != NULL) {
@@ -5642,6 +6211,14 @@ ns__query_start(query_ctx_t *qctx) {
 		qctx->options.stalefirst = true;
 	}
 
+	/*
+	 * Check the authoritative response cache.
+	 */
+	result = query_respcache(qctx);
+	if (result != ISC_R_COMPLETE) {
+		goto cleanup;
+	}
+
 	result = query_lookup(qctx);
 
 	/*
@@ -5739,7 +6316,11 @@ query_lookup(query_ctx_t *qctx) {
 	bool answer_found = false;
 	bool stale_found = false;
 	bool stale_refresh_window = false;
+	bool outage = false;
 	uint16_t ede = 0;
+	isc_nanosecs_t lookupstart;
+	dns_fixedname_t fcut;
+	dns_name_t *cutname = dns_fixedname_initname(&fcut);
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_lookup");
 
@@ -5794,10 +6375,26 @@ query_lookup(query_ctx_t *qctx) {
 		dboptions |= DNS_DBFIND_STALEENABLED;
 	}
 
+	/*
+	 * If the zone cut above the name is known to be unreachable, a
+	 * stale answer can be used straight away, without the refresh
+	 * attempt that would otherwise be made for every RRset below it.
+	 */
+	if (!qctx->is_zone && (dboptions & DNS_DBFIND_STALEENABLED) != 0 &&
+	    (dboptions & (DNS_DBFIND_STALEOK | DNS_DBFIND_STALETIMEOUT)) == 0 &&
+	    dns_view_inoutage(qctx->view, rpzqname, qctx->client->now,
+			      cutname))
+	{
+		dboptions |= DNS_DBFIND_STALETIMEOUT;
+		outage = true;
+	}
+
+	lookupstart = isc_time_monotonic();
 	result = dns_db_findext(qctx->db, rpzqname, qctx->version, qctx->type,
 				dboptions, qctx->client->now, &qctx->node,
 				qctx->fname, &cm, &ci, qctx->rdataset,
 				qctx->sigrdataset);
+	ns_client_latency(qctx->client, ns_latency_lookup, lookupstart);
 
 	/*
 	 * Fixup fname and sigrdataset.
@@ -5838,7 +6435,8 @@ query_lookup(query_ctx_t *qctx) {
 	 * If a stale answer is found, send it to the client, and try to refresh
 	 * the RRset.
 	 */
-	stale_timeout = ((dboptions & DNS_DBFIND_STALETIMEOUT) != 0);
+	stale_timeout = ((dboptions & DNS_DBFIND_STALETIMEOUT) != 0 &&
+			 !outage);
 
 	if (dns_rdataset_isassociated(qctx->rdataset) &&
 	    dns_rdataset_count(qctx->rdataset) > 0 && !STALE(qctx->rdataset))
@@ -5847,7 +6445,7 @@ query_lookup(query_ctx_t *qctx) {
 		answer_found = true;
 	}
 
-	if (dbfind_stale || stale_refresh_window || stale_timeout) {
+	if (dbfind_stale || stale_refresh_window || stale_timeout || outage) {
 		dns_name_format(qctx->client->query.qname, namebuf,
 				sizeof(namebuf));
 		dns_rdatatype_format(qctx->qtype, typebuf, sizeof(typebuf));
@@ -5916,6 +6514,22 @@ query_lookup(query_ctx_t *qctx) {
 			QUERY_ERROR(qctx, DNS_R_SERVFAIL);
 			return (ns_query_done(qctx));
 		}
+	} else if (outage && stale_found) {
+		/*
+		 * The servers for this part of the tree are not answering;
+		 * don't try to refresh the data until the outage is over.
+		 */
+		char cutbuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(cutname, cutbuf, sizeof(cutbuf));
+		isc_log_write(NS_LOGCATEGORY_SERVE_STALE, NS_LOGMODULE_QUERY,
+			      ISC_LOG_INFO,
+			      "%s %s query during outage of %s, stale answer "
+			      "used (%s)",
+			      namebuf, typebuf, cutbuf,
+			      isc_result_totext(result));
+		ns_client_extendederror(qctx->client, ede,
+					"zone cut in outage");
 	} else if (stale_timeout) {
 		if (qctx->options.stalefirst) {
 			if (!stale_found && !answer_found) {
@@ -6006,16 +6620,13 @@ message_clearrdataset(dns_message_t *msg, unsigned int attr) {
 				ISC_LIST_UNLINK(name->list, rds, link);
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				dns_message_puttemprdataset(msg, &rds);
 				rds = next_rds;
 			}
 
 			if (ISC_LIST_EMPTY(name->list)) {
 				ISC_LIST_UNLINK(msg->sections[i], name, link);
-				if (dns_name_dynamic(name)) {
-					dns_name_free(name, msg->mctx);
-				}
-				isc_mempool_put(msg->namepool, name);
+				dns_message_puttempname(msg, &name);
 			}
 
 			name = next_name;
@@ -6055,6 +6666,10 @@ fetch_callback(void *arg) {
 
 	CTRACE(ISC_LOG_DEBUG(3), "fetch_callback");
 
+	ns_client_latency(client, ns_latency_recursion,
+			  client->query.fetchstart);
+	client->query.fetchstart = 0;
+
 	/*
 	 * We are resuming from recursion. Reset any attributes, options
 	 * that a lookup due to stale-answer-client-timeout may have set.
@@ -6129,9 +6744,13 @@ fetch_callback(void *arg) {
 		qctx.detach_client = true;
 		qctx_destroy(&qctx);
 	} else {
+		query_trackoutage(client, client->query.qname,
+				  qctx.fresp->result);
+
 		/*
 		 * Resume the find process.
 		 */
+		qctx.fetchid = dns_resolver_fetchid(fetch);
 		query_trace(&qctx);
 
 		result = query_resume(&qctx);
@@ -6211,6 +6830,31 @@ recursionquota_log(ns_client_t *client, atomic_uint_fast32_t *last_log_time,
 
 static atomic_uint_fast32_t last_soft, last_hard;
 
+/*%
+ * Estimate how expensive the recursion the client is about to start is,
+ * to decide which recursing query to drop first when the recursive
+ * clients quota is exceeded: every restart (a CNAME or DNAME followed)
+ * adds one, and so does every doubling of the number of fetches already
+ * outstanding for the zone 'qdomain', which is what a flood of queries
+ * for random names in one zone looks like.
+ */
+static unsigned int
+recursion_cost(ns_client_t *client, const dns_name_t *qdomain) {
+	unsigned int cost = client->query.restarts;
+	unsigned int fetches = 0;
+
+	if (qdomain != NULL && client->view->resolver != NULL) {
+		fetches = dns_resolver_zonefetches(client->view->resolver,
+						   qdomain);
+	}
+	while (fetches != 0) {
+		cost++;
+		fetches >>= 1;
+	}
+
+	return (cost);
+}
+
 /*%
  * Acquire recursion quota before making the current client "recursing".
  */
@@ -6285,6 +6929,7 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		inc_stats(client, ns_statscounter_recursion);
 	}
 
+	client->query.cost = recursion_cost(client, qdomain);
 	result = acquire_recursionquota(client);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
@@ -6313,6 +6958,7 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	}
 
 	isc_nmhandle_attach(client->handle, &HANDLE_RECTYPE_NORMAL(client));
+	client->query.fetchstart = isc_time_monotonic();
 	result = dns_resolver_createfetch(
 		client->view->resolver, qname, qtype, qdomain, nameservers,
 		NULL, peeraddr, client->message->id, client->query.fetchoptions,
@@ -6445,6 +7091,12 @@ query_resume(query_ctx_t *qctx) {
 		}
 	} else {
 		CCTRACE(ISC_LOG_DEBUG(3), "resume from normal recursion");
+
+		result = query_respshare(qctx);
+		if (result != ISC_R_COMPLETE) {
+			return (result);
+		}
+
 		qctx->authoritative = false;
 
 		qctx->qtype = qctx->fresp->qtype;
@@ -6681,6 +7333,7 @@ ns_query_hookasync(query_ctx_t *qctx, ns_query_starthookasync_t runasync,
 	REQUIRE(client->query.hookactx == NULL);
 	REQUIRE(FETCH_RECTYPE_NORMAL(client) == NULL);
 
+	client->query.cost = recursion_cost(client, NULL);
 	result = acquire_recursionquota(client);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
@@ -6800,6 +7453,17 @@ ns__query_sfcache(query_ctx_t *qctx) {
 	return (ISC_R_COMPLETE);
 }
 
+static void
+query_trace_start(ns_client_t *client) {
+	if (!LIBNS_QUERY_START_ENABLED()) {
+		return;
+	}
+
+	char qnamebuf[DNS_NAME_FORMATSIZE];
+	dns_name_format(client->query.qname, qnamebuf, sizeof(qnamebuf));
+	LIBNS_QUERY_START(client, qnamebuf, client->query.qtype);
+}
+
 static void
 query_trace_rrldrop(query_ctx_t *qctx,
 		    dns_rrl_result_t rrl_result ISC_ATTR_UNUSED) {
@@ -7500,6 +8164,10 @@ root_key_sentinel:
 		return (query_notfound(qctx));
 
 	case DNS_R_DELEGATION:
+		result = query_coveringnsec3(qctx);
+		if (result != ISC_R_COMPLETE) {
+			return (result);
+		}
 		return (query_delegation(qctx));
 
 	case DNS_R_EMPTYNAME:
@@ -8103,7 +8771,8 @@ query_dns64(query_ctx_t *qctx) {
 	dns_view_t *view = client->view;
 	isc_netaddr_t netaddr;
 	dns_dns64_t *dns64;
-	unsigned int flags = 0;
+	bool *matched = NULL;
+	unsigned int flags = 0, nmatched = 0, i;
 	const dns_section_t section = DNS_SECTION_ANSWER;
 
 	/*%
@@ -8195,19 +8864,46 @@ query_dns64(query_ctx_t *qctx) {
 		flags |= DNS_DNS64_DNSSEC;
 	}
 
+	/*
+	 * Whether a dns64 prefix applies to this client doesn't depend
+	 * on the A record, so check the client ACLs once for all of them.
+	 */
+	matched = isc_mem_cget(client->manager->mctx, view->dns64cnt,
+			       sizeof(matched[0]));
+	i = 0;
+	for (dns64 = ISC_LIST_HEAD(view->dns64); dns64 != NULL;
+	     dns64 = dns_dns64_next(dns64))
+	{
+		INSIST(i < view->dns64cnt);
+		result = dns_dns64_match(dns64, &netaddr, client->signer, env,
+					 flags);
+		if (result == ISC_R_SUCCESS) {
+			matched[i] = true;
+			nmatched++;
+		}
+		i++;
+	}
+	if (nmatched == 0) {
+		result = ISC_R_NOMORE;
+		goto cleanup;
+	}
+
 	for (result = dns_rdataset_first(qctx->rdataset);
 	     result == ISC_R_SUCCESS;
 	     result = dns_rdataset_next(qctx->rdataset))
 	{
-		for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
-		     dns64 = dns_dns64_next(dns64))
+		i = 0;
+		for (dns64 = ISC_LIST_HEAD(view->dns64); dns64 != NULL;
+		     dns64 = dns_dns64_next(dns64), i++)
 		{
+			if (!matched[i]) {
+				continue;
+			}
 			dns_rdataset_current(qctx->rdataset, &rdata);
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr,
-						     client->signer, env, flags,
-						     rdata.data, r.base);
+			result = dns_dns64_synthesize(dns64, env, rdata.data,
+						      r.base);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdata_reset(&rdata);
 				continue;
@@ -8248,6 +8944,11 @@ query_dns64(query_ctx_t *qctx) {
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (matched != NULL) {
+		isc_mem_cput(client->manager->mctx, matched, view->dns64cnt,
+			     sizeof(matched[0]));
+	}
+
 	if (buffer != NULL) {
 		isc_buffer_free(&buffer);
 	}
@@ -9853,228 +10554,700 @@ query_coveringnsec(query_ctx_t *qctx) {
 	 */
 	result = checksignames(signer, qctx->sigrdataset);
 	if (result != ISC_R_SUCCESS) {
-		result = ISC_R_SUCCESS;
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
+	/*
+	 * If NSEC or RRSIG are missing from the type map
+	 * reject the NSEC RRset.
+	 */
+	if (!dns_nsec_requiredtypespresent(qctx->rdataset)) {
+		goto cleanup;
+	}
+
+	/*
+	 * Check that we have the correct NOQNAME NSEC record.
+	 */
+	result = dns_nsec_noexistnodata(qctx->qtype, qctx->client->query.qname,
+					qctx->fname, qctx->rdataset, &exists,
+					&data, wild, log_noexistnodata, qctx);
+
+	if (result != ISC_R_SUCCESS || (exists && data)) {
+		goto cleanup;
+	}
+
+	if (exists) {
+		if (qctx->type == dns_rdatatype_any) { /* XXX not yet */
+			goto cleanup;
+		}
+		if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
+		    (qctx->type == dns_rdatatype_a ||
+		     qctx->type == dns_rdatatype_aaaa)) /* XXX not yet */
+		{
+			goto cleanup;
+		}
+		if (!qctx->resuming && !STALE(qctx->rdataset) &&
+		    qctx->rdataset->ttl == 0 && RECURSIONOK(qctx->client))
+		{
+			goto cleanup;
+		}
+
+		soardataset = ns_client_newrdataset(qctx->client);
+		sigsoardataset = ns_client_newrdataset(qctx->client);
+
+		/*
+		 * Look for SOA record to construct NODATA response.
+		 */
+		dns_db_attach(qctx->db, &db);
+		result = dns_db_findext(db, signer, qctx->version,
+					dns_rdatatype_soa, dboptions,
+					qctx->client->now, &node, fname, &cm,
+					&ci, soardataset, sigsoardataset);
+
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		(void)query_synthnodata(qctx, signer, &soardataset,
+					&sigsoardataset);
+		done = true;
+		goto cleanup;
+	}
+
+	/*
+	 * Look up the no-wildcard proof.
+	 */
+	dns_db_attach(qctx->db, &db);
+	result = dns_db_findext(db, wild, qctx->version, qctx->type,
+				dboptions | DNS_DBFIND_COVERINGNSEC,
+				qctx->client->now, &node, nowild, &cm, &ci,
+				&rdataset, &sigrdataset);
+
+	if (rdataset.trust != dns_trust_secure ||
+	    sigrdataset.trust != dns_trust_secure)
+	{
+		goto cleanup;
+	}
+
+	/*
+	 * Zero TTL handling of wildcard record.
+	 *
+	 * We don't yet have code to handle synthesis and type ANY or dns64
+	 * processing so we abort the synthesis here if there would be a
+	 * interaction.
+	 */
+	switch (result) {
+	case ISC_R_SUCCESS:
+		if (qctx->type == dns_rdatatype_any) { /* XXX not yet */
+			goto cleanup;
+		}
+		if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
+		    (qctx->type == dns_rdatatype_a ||
+		     qctx->type == dns_rdatatype_aaaa)) /* XXX not yet */
+		{
+			goto cleanup;
+		}
+		FALLTHROUGH;
+	case DNS_R_CNAME:
+		if (!qctx->resuming && !STALE(&rdataset) && rdataset.ttl == 0 &&
+		    RECURSIONOK(qctx->client))
+		{
+			goto cleanup;
+		}
+	default:
+		break;
+	}
+
+	switch (result) {
+	case DNS_R_COVERINGNSEC:
+		/*
+		 * Check that the covering NSEC record is from the right
+		 * namespace.
+		 */
+		if (!dns_name_issubdomain(nowild, namespace)) {
+			goto cleanup;
+		}
+		result = dns_nsec_noexistnodata(qctx->qtype, wild, nowild,
+						&rdataset, &exists, &data, NULL,
+						log_noexistnodata, qctx);
+		if (result != ISC_R_SUCCESS || (exists && data)) {
+			goto cleanup;
+		}
+		break;
+	case ISC_R_SUCCESS: /* wild card match */
+		(void)query_synthwildcard(qctx, &rdataset, &sigrdataset);
+		done = true;
+		goto cleanup;
+	case DNS_R_CNAME: /* wild card cname */
+		(void)query_synthcnamewildcard(qctx, &rdataset, &sigrdataset);
+		done = true;
+		goto cleanup;
+	case DNS_R_NCACHENXRRSET:  /* wild card nodata */
+	case DNS_R_NCACHENXDOMAIN: /* direct nxdomain */
+	default:
+		goto cleanup;
+	}
+
+	/*
+	 * We now have the proof that we have an NXDOMAIN.  Apply
+	 * NXDOMAIN redirection if configured.
+	 */
+	result = query_redirect(qctx, DNS_R_COVERINGNSEC);
+	if (result != ISC_R_COMPLETE) {
+		redirected = true;
+		goto cleanup;
+	}
+
+	/*
+	 * Must be signed to accept.
+	 */
+	if (!dns_rdataset_isassociated(&sigrdataset)) {
+		goto cleanup;
+	}
+
+	/*
+	 * Check signer signer names again.
+	 */
+	result = checksignames(signer, &sigrdataset);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	soardataset = ns_client_newrdataset(qctx->client);
+	sigsoardataset = ns_client_newrdataset(qctx->client);
+
+	/*
+	 * Look for SOA record to construct NXDOMAIN response.
+	 */
+	result = dns_db_findext(db, signer, qctx->version, dns_rdatatype_soa,
+				dboptions, qctx->client->now, &node, fname, &cm,
+				&ci, soardataset, sigsoardataset);
+
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	(void)query_synthnxdomainnodata(qctx, exists, nowild, &rdataset,
+					&sigrdataset, signer, &soardataset,
+					&sigsoardataset);
+	done = true;
+
+cleanup:
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (dns_rdataset_isassociated(&sigrdataset)) {
+		dns_rdataset_disassociate(&sigrdataset);
+	}
+	if (soardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &soardataset);
+	}
+	if (sigsoardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &sigsoardataset);
+	}
+	if (db != NULL) {
+		if (node != NULL) {
+			dns_db_detachnode(db, &node);
+		}
+		dns_db_detach(&db);
+	}
+
+	if (redirected) {
+		return (result);
+	}
+
+	if (!done) {
+		/*
+		 * No covering NSEC was found; proceed with recursion.
+		 */
+		qctx->findcoveringnsec = false;
+		if (qctx->fname != NULL) {
+			ns_client_releasename(qctx->client, &qctx->fname);
+		}
+		if (qctx->node != NULL) {
+			dns_db_detachnode(qctx->db, &qctx->node);
+		}
+		ns_client_putrdataset(qctx->client, &qctx->rdataset);
+		if (qctx->sigrdataset != NULL) {
+			ns_client_putrdataset(qctx->client, &qctx->sigrdataset);
+		}
+		return (query_lookup(qctx));
+	}
+
+	return (ns_query_done(qctx));
+}
+
+/*%
+ * The NSEC3 records making up a synthesized negative answer: the one
+ * matching the closest encloser (or the QNAME for NODATA), the one
+ * covering the next closer name, and the one covering the wildcard.
+ */
+enum {
+	NSEC3PROOF_CLOSEST = 0,
+	NSEC3PROOF_NEXTCLOSER = 1,
+	NSEC3PROOF_WILDCARD = 2,
+	NSEC3PROOF_MAX = 3
+};
+
+typedef struct nsec3proof {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	dns_rdataset_t *sigrdataset;
+} nsec3proof_t;
+
+/*%
+ * Look up the cached NSEC3 record that matches or potentially covers
+ * the hashed owner name 'hashed' in 'zone'.  The NSEC3 and its RRSIG
+ * must both be secure and signed by 'zone'.
+ *
+ * Returns ISC_R_SUCCESS for a matching NSEC3, DNS_R_COVERINGNSEC for
+ * a potentially covering one, and ISC_R_NOTFOUND otherwise.
+ */
+static isc_result_t
+query_findnsec3(query_ctx_t *qctx, const dns_name_t *hashed,
+		const dns_name_t *zone, nsec3proof_t *proof) {
+	dns_clientinfo_t ci;
+	dns_clientinfomethods_t cm;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fsigner;
+	dns_name_t *signer = NULL;
+	isc_result_t result;
+
+	if (dns_rdataset_isassociated(proof->rdataset)) {
+		dns_rdataset_disassociate(proof->rdataset);
+	}
+	if (dns_rdataset_isassociated(proof->sigrdataset)) {
+		dns_rdataset_disassociate(proof->sigrdataset);
+	}
+
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL);
+
+	result = dns_db_findext(qctx->db, hashed, qctx->version,
+				dns_rdatatype_nsec3,
+				qctx->client->query.dboptions |
+					DNS_DBFIND_COVERINGNSEC |
+					DNS_DBFIND_FORCENSEC3,
+				qctx->client->now, &node, proof->name, &cm, &ci,
+				proof->rdataset, proof->sigrdataset);
+	if (node != NULL) {
+		dns_db_detachnode(qctx->db, &node);
+	}
+	if (result != ISC_R_SUCCESS && result != DNS_R_COVERINGNSEC) {
+		goto notfound;
+	}
+
+	if (proof->rdataset->type != dns_rdatatype_nsec3 ||
+	    !dns_rdataset_isassociated(proof->sigrdataset) ||
+	    proof->rdataset->trust != dns_trust_secure ||
+	    proof->sigrdataset->trust != dns_trust_secure)
+	{
+		goto notfound;
+	}
+
+	signer = dns_fixedname_initname(&fsigner);
+	dns_name_copy(zone, signer);
+	if (checksignames(signer, proof->sigrdataset) != ISC_R_SUCCESS) {
+		goto notfound;
+	}
+
+	return (result);
+
+notfound:
+	if (dns_rdataset_isassociated(proof->rdataset)) {
+		dns_rdataset_disassociate(proof->rdataset);
+	}
+	if (dns_rdataset_isassociated(proof->sigrdataset)) {
+		dns_rdataset_disassociate(proof->sigrdataset);
+	}
+	return (ISC_R_NOTFOUND);
+}
+
+/*%
+ * Hash 'name' with the NSEC3 parameters of 'nsec3' and look up the
+ * cached NSEC3 record that matches or covers it, as query_findnsec3().
+ * A record from a chain with other parameters, as cached before the
+ * zone changed them, doesn't match or cover the hash and is ignored.
+ */
+static isc_result_t
+query_findnsec3name(query_ctx_t *qctx, const dns_name_t *name,
+		    const dns_name_t *zone, const dns_rdata_nsec3_t *nsec3,
+		    nsec3proof_t *proof) {
+	dns_fixedname_t fhashed;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t found;
+	isc_result_t result;
+
+	result = dns_nsec3_hashname(&fhashed, NULL, NULL, name, zone,
+				    nsec3->hash, nsec3->iterations,
+				    nsec3->salt, nsec3->salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	result = query_findnsec3(qctx, dns_fixedname_name(&fhashed), zone,
+				 proof);
+	if (result == ISC_R_NOTFOUND) {
+		return (result);
+	}
+
+	if (dns_rdataset_first(proof->rdataset) != ISC_R_SUCCESS) {
+		goto notfound;
+	}
+	dns_rdataset_current(proof->rdataset, &rdata);
+	RUNTIME_CHECK(dns_rdata_tostruct(&rdata, &found, NULL) ==
+		      ISC_R_SUCCESS);
+	if (found.hash != nsec3->hash ||
+	    found.iterations != nsec3->iterations ||
+	    found.salt_length != nsec3->salt_length ||
+	    memcmp(found.salt, nsec3->salt, nsec3->salt_length) != 0)
+	{
+		goto notfound;
+	}
+
+	return (result);
+
+notfound:
+	dns_rdataset_disassociate(proof->rdataset);
+	dns_rdataset_disassociate(proof->sigrdataset);
+	return (ISC_R_NOTFOUND);
+}
+
+/*%
+ * Synthesize a negative answer from the NSEC3 records in the cache
+ * (RFC 8198, section 5.2).
+ *
+ * The cache lookup for the QNAME ended at the delegation in qctx->fname.
+ * If the NSEC3 chain of that zone has been cached, look for a matching
+ * NSEC3 for the QNAME that proves the type doesn't exist; otherwise
+ * walk up from the QNAME to find the closest encloser, and check that
+ * the next closer name and the wildcard at the closest encloser are
+ * covered.  If the proof is complete and the zone's SOA is cached,
+ * answer NODATA or NXDOMAIN.  Opt-out ranges are never used to prove
+ * that a name doesn't exist.
+ *
+ * Returns ISC_R_COMPLETE, leaving 'qctx' untouched, if no answer was
+ * synthesized.
+ */
+static isc_result_t
+query_coveringnsec3(query_ctx_t *qctx) {
+	static unsigned char anydata[] = "\0010";
+	static unsigned char anyoffsets[] = { 0 };
+	dns_name_t anylabel = DNS_NAME_INITNONABSOLUTE(anydata, anyoffsets);
+	nsec3proof_t proofs[NSEC3PROOF_MAX];
+	dns_clientinfo_t ci;
+	dns_clientinfomethods_t cm;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fzone, fnamespace, fany, fwild, fclosest, fnearest;
+	dns_fixedname_t fzonename, fsoaname;
+	dns_name_t *zone = NULL, *namespace = NULL, *any = NULL, *wild = NULL;
+	dns_name_t *closest = NULL, *nearest = NULL, *zonename = NULL;
+	dns_name_t *soaname = NULL, *name = NULL;
+	dns_name_t *qname = qctx->client->query.qname;
+	dns_name_t encloser, nextcloser;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	dns_rdataset_t *soardataset = NULL, *sigsoardataset = NULL;
+	dns_rdataset_t **sigsoardatasetp = NULL;
+	isc_buffer_t *dbuf, b;
+	unsigned char salt[255];
+	unsigned int labels, zlabels, celabels, i;
+	unsigned int ce = NSEC3PROOF_CLOSEST, nc = NSEC3PROOF_NEXTCLOSER, slot;
+	bool exists = true, data = true, optout = false;
+	bool setclosest = false, setnearest = false;
+	bool found = false, nodata = false, done = false;
+	dns_ttl_t ttl;
+	isc_result_t result;
+
+	if (qctx->is_zone || !qctx->findcoveringnsec || qctx->zfname != NULL ||
+	    qctx->type == dns_rdatatype_any ||
+	    dns_rdatatype_atparent(qctx->qtype) ||
+	    qctx->view->redirect != NULL || qctx->view->redirectzone != NULL)
+	{
+		return (ISC_R_COMPLETE);
+	}
+	if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
+	    (qctx->type == dns_rdatatype_a || qctx->type == dns_rdatatype_aaaa))
+	{
+		return (ISC_R_COMPLETE);
+	}
+
+	/*
+	 * The NSEC3 records must come from the delegation we found, and
+	 * it must be in a namespace we are allowed to synthesize from.
+	 */
+	zone = dns_fixedname_initname(&fzone);
+	dns_name_copy(qctx->fname, zone);
+	if (!dns_name_issubdomain(qname, zone)) {
+		return (ISC_R_COMPLETE);
+	}
+	namespace = dns_fixedname_initname(&fnamespace);
+	dns_view_sfd_find(qctx->view, qname, namespace);
+	if (!dns_name_issubdomain(zone, namespace)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_coveringnsec3");
+
+	for (i = 0; i < NSEC3PROOF_MAX; i++) {
+		proofs[i].name = dns_fixedname_initname(&proofs[i].fixed);
+		proofs[i].rdataset = ns_client_newrdataset(qctx->client);
+		proofs[i].sigrdataset = ns_client_newrdataset(qctx->client);
+	}
+
+	/*
+	 * Find any NSEC3 record in the zone's chain to learn the hash
+	 * parameters.
+	 */
+	any = dns_fixedname_initname(&fany);
+	result = dns_name_concatenate(&anylabel, zone, any, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = query_findnsec3(qctx, any, zone, &proofs[ce]);
+	if (result == ISC_R_NOTFOUND) {
+		goto cleanup;
+	}
+	result = dns_rdataset_first(proofs[ce].rdataset);
+	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
-
-	/*
-	 * If NSEC or RRSIG are missing from the type map
-	 * reject the NSEC RRset.
-	 */
-	if (!dns_nsec_requiredtypespresent(qctx->rdataset)) {
+	dns_rdataset_current(proofs[ce].rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	if (!dns_nsec3_supportedhash(nsec3.hash) ||
+	    nsec3.iterations > dns_nsec3_maxiterations())
+	{
 		goto cleanup;
 	}
+	memmove(salt, nsec3.salt, nsec3.salt_length);
+	nsec3.salt = salt;
 
 	/*
-	 * Check that we have the correct NOQNAME NSEC record.
+	 * Walk up from the QNAME until an NSEC3 matches: that name is
+	 * the closest encloser, and the NSEC3 found one step before it
+	 * covers the next closer name.
 	 */
-	result = dns_nsec_noexistnodata(qctx->qtype, qctx->client->query.qname,
-					qctx->fname, qctx->rdataset, &exists,
-					&data, wild, log_noexistnodata, qctx);
-
-	if (result != ISC_R_SUCCESS || (exists && data)) {
+	labels = dns_name_countlabels(qname);
+	zlabels = dns_name_countlabels(zone);
+	dns_name_init(&encloser, NULL);
+	for (i = labels; i >= zlabels && !found; i--) {
+		dns_name_getlabelsequence(qname, labels - i, i, &encloser);
+		result = query_findnsec3name(qctx, &encloser, zone, &nsec3,
+					     &proofs[ce]);
+		switch (result) {
+		case ISC_R_SUCCESS:
+			found = true;
+			break;
+		case DNS_R_COVERINGNSEC:
+			/*
+			 * Keep this one as the next closer proof and
+			 * look for the next name up in the other slot.
+			 */
+			slot = nc;
+			nc = ce;
+			ce = slot;
+			break;
+		default:
+			goto cleanup;
+		}
+	}
+	if (!found) {
 		goto cleanup;
 	}
+	celabels = dns_name_countlabels(&encloser);
 
-	if (exists) {
-		if (qctx->type == dns_rdatatype_any) { /* XXX not yet */
-			goto cleanup;
-		}
-		if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
-		    (qctx->type == dns_rdatatype_a ||
-		     qctx->type == dns_rdatatype_aaaa)) /* XXX not yet */
+	zonename = dns_fixedname_initname(&fzonename);
+	if (celabels == labels) {
+		/*
+		 * The QNAME exists; check that the type doesn't.
+		 */
+		exists = false;
+		data = true;
+		result = dns_nsec3_noexistnodata(
+			qctx->qtype, qname, proofs[ce].name, proofs[ce].rdataset,
+			zonename, &exists, &data, NULL, NULL, NULL, NULL, NULL,
+			NULL, log_noexistnodata, qctx);
+		if (result != ISC_R_SUCCESS || !exists || data ||
+		    !dns_name_equal(zonename, zone))
 		{
 			goto cleanup;
 		}
-		if (!qctx->resuming && !STALE(qctx->rdataset) &&
-		    qctx->rdataset->ttl == 0 && RECURSIONOK(qctx->client))
+		nodata = true;
+	} else {
+		/*
+		 * Closest encloser proof.
+		 */
+		closest = dns_fixedname_initname(&fclosest);
+		(void)dns_nsec3_noexistnodata(
+			qctx->qtype, qname, proofs[ce].name, proofs[ce].rdataset,
+			zonename, &exists, &data, NULL, NULL, &setclosest, NULL,
+			closest, NULL, log_noexistnodata, qctx);
+		if (!setclosest || !dns_name_equal(closest, &encloser) ||
+		    !dns_name_equal(zonename, zone))
 		{
 			goto cleanup;
 		}
 
-		soardataset = ns_client_newrdataset(qctx->client);
-		sigsoardataset = ns_client_newrdataset(qctx->client);
-
 		/*
-		 * Look for SOA record to construct NODATA response.
+		 * The next closer name must be covered by an NSEC3 that
+		 * is not opt-out.
 		 */
-		dns_db_attach(qctx->db, &db);
-		result = dns_db_findext(db, signer, qctx->version,
-					dns_rdatatype_soa, dboptions,
-					qctx->client->now, &node, fname, &cm,
-					&ci, soardataset, sigsoardataset);
-
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup;
-		}
-		(void)query_synthnodata(qctx, signer, &soardataset,
-					&sigsoardataset);
-		done = true;
-		goto cleanup;
-	}
-
-	/*
-	 * Look up the no-wildcard proof.
-	 */
-	dns_db_attach(qctx->db, &db);
-	result = dns_db_findext(db, wild, qctx->version, qctx->type,
-				dboptions | DNS_DBFIND_COVERINGNSEC,
-				qctx->client->now, &node, nowild, &cm, &ci,
-				&rdataset, &sigrdataset);
-
-	if (rdataset.trust != dns_trust_secure ||
-	    sigrdataset.trust != dns_trust_secure)
-	{
-		goto cleanup;
-	}
-
-	/*
-	 * Zero TTL handling of wildcard record.
-	 *
-	 * We don't yet have code to handle synthesis and type ANY or dns64
-	 * processing so we abort the synthesis here if there would be a
-	 * interaction.
-	 */
-	switch (result) {
-	case ISC_R_SUCCESS:
-		if (qctx->type == dns_rdatatype_any) { /* XXX not yet */
-			goto cleanup;
-		}
-		if (!ISC_LIST_EMPTY(qctx->view->dns64) &&
-		    (qctx->type == dns_rdatatype_a ||
-		     qctx->type == dns_rdatatype_aaaa)) /* XXX not yet */
-		{
-			goto cleanup;
-		}
-		FALLTHROUGH;
-	case DNS_R_CNAME:
-		if (!qctx->resuming && !STALE(&rdataset) && rdataset.ttl == 0 &&
-		    RECURSIONOK(qctx->client))
+		dns_name_init(&nextcloser, NULL);
+		dns_name_getlabelsequence(qname, labels - celabels - 1,
+					  celabels + 1, &nextcloser);
+		nearest = dns_fixedname_initname(&fnearest);
+		exists = true;
+		result = dns_nsec3_noexistnodata(
+			qctx->qtype, &nextcloser, proofs[nc].name,
+			proofs[nc].rdataset, zonename, &exists, &data, &optout,
+			NULL, NULL, &setnearest, NULL, nearest,
+			log_noexistnodata, qctx);
+		if (result != ISC_R_SUCCESS || exists || optout ||
+		    !setnearest || !dns_name_equal(nearest, &nextcloser))
 		{
 			goto cleanup;
 		}
-	default:
-		break;
-	}
 
-	switch (result) {
-	case DNS_R_COVERINGNSEC:
 		/*
-		 * Check that the covering NSEC record is from the right
-		 * namespace.
+		 * The wildcard at the closest encloser must not exist.
 		 */
-		if (!dns_name_issubdomain(nowild, namespace)) {
+		wild = dns_fixedname_initname(&fwild);
+		result = dns_name_concatenate(dns_wildcardname, &encloser,
+					      wild, NULL);
+		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
-		result = dns_nsec_noexistnodata(qctx->qtype, wild, nowild,
-						&rdataset, &exists, &data, NULL,
-						log_noexistnodata, qctx);
-		if (result != ISC_R_SUCCESS || (exists && data)) {
+		result = query_findnsec3name(qctx, wild, zone, &nsec3,
+					     &proofs[NSEC3PROOF_WILDCARD]);
+		if (result != DNS_R_COVERINGNSEC) {
+			goto cleanup;
+		}
+		exists = true;
+		result = dns_nsec3_noexistnodata(
+			qctx->qtype, wild, proofs[NSEC3PROOF_WILDCARD].name,
+			proofs[NSEC3PROOF_WILDCARD].rdataset, zonename, &exists,
+			&data, NULL, NULL, NULL, NULL, NULL, NULL,
+			log_noexistnodata, qctx);
+		if (result != ISC_R_SUCCESS || exists) {
 			goto cleanup;
 		}
-		break;
-	case ISC_R_SUCCESS: /* wild card match */
-		(void)query_synthwildcard(qctx, &rdataset, &sigrdataset);
-		done = true;
-		goto cleanup;
-	case DNS_R_CNAME: /* wild card cname */
-		(void)query_synthcnamewildcard(qctx, &rdataset, &sigrdataset);
-		done = true;
-		goto cleanup;
-	case DNS_R_NCACHENXRRSET:  /* wild card nodata */
-	case DNS_R_NCACHENXDOMAIN: /* direct nxdomain */
-	default:
-		goto cleanup;
 	}
 
 	/*
-	 * We now have the proof that we have an NXDOMAIN.  Apply
-	 * NXDOMAIN redirection if configured.
+	 * Look for the SOA record to construct the response.
 	 */
-	result = query_redirect(qctx, DNS_R_COVERINGNSEC);
-	if (result != ISC_R_COMPLETE) {
-		redirected = true;
+	soardataset = ns_client_newrdataset(qctx->client);
+	sigsoardataset = ns_client_newrdataset(qctx->client);
+	soaname = dns_fixedname_initname(&fsoaname);
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL);
+	result = dns_db_findext(qctx->db, zone, qctx->version,
+				dns_rdatatype_soa, qctx->client->query.dboptions,
+				qctx->client->now, &node, soaname, &cm, &ci,
+				soardataset, sigsoardataset);
+	if (node != NULL) {
+		dns_db_detachnode(qctx->db, &node);
+	}
+	if (result != ISC_R_SUCCESS ||
+	    !dns_rdataset_isassociated(sigsoardataset))
+	{
 		goto cleanup;
 	}
 
 	/*
-	 * Must be signed to accept.
+	 * Determine the correct TTL to use for the SOA and RRSIG
 	 */
-	if (!dns_rdataset_isassociated(&sigrdataset)) {
+	if (nodata) {
+		ttl = query_synthttl(soardataset, sigsoardataset,
+				     proofs[ce].rdataset,
+				     proofs[ce].sigrdataset, NULL, NULL);
+	} else {
+		ttl = query_synthttl(soardataset, sigsoardataset,
+				     proofs[ce].rdataset,
+				     proofs[ce].sigrdataset, proofs[nc].rdataset,
+				     proofs[nc].sigrdataset);
+		ttl = ISC_MIN(ttl, proofs[NSEC3PROOF_WILDCARD].rdataset->ttl);
+		ttl = ISC_MIN(ttl,
+			      proofs[NSEC3PROOF_WILDCARD].sigrdataset->ttl);
+	}
+	if (ttl == 0) {
 		goto cleanup;
 	}
+	soardataset->ttl = sigsoardataset->ttl = ttl;
 
 	/*
-	 * Check signer signer names again.
+	 * We have the answer; drop the delegation we found.
 	 */
-	result = checksignames(signer, &sigrdataset);
-	if (result != ISC_R_SUCCESS) {
-		result = ISC_R_SUCCESS;
-		goto cleanup;
+	ns_client_releasename(qctx->client, &qctx->fname);
+	ns_client_putrdataset(qctx->client, &qctx->rdataset);
+	if (qctx->sigrdataset != NULL) {
+		ns_client_putrdataset(qctx->client, &qctx->sigrdataset);
 	}
-
-	if (node != NULL) {
-		dns_db_detachnode(db, &node);
+	if (qctx->node != NULL) {
+		dns_db_detachnode(qctx->db, &qctx->node);
 	}
 
-	soardataset = ns_client_newrdataset(qctx->client);
-	sigsoardataset = ns_client_newrdataset(qctx->client);
-
 	/*
-	 * Look for SOA record to construct NXDOMAIN response.
+	 * Add SOA record. Omit the RRSIG if DNSSEC was not requested.
 	 */
-	result = dns_db_findext(db, signer, qctx->version, dns_rdatatype_soa,
-				dboptions, qctx->client->now, &node, fname, &cm,
-				&ci, soardataset, sigsoardataset);
-
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
-	}
-	(void)query_synthnxdomainnodata(qctx, exists, nowild, &rdataset,
-					&sigrdataset, signer, &soardataset,
-					&sigsoardataset);
-	done = true;
-
-cleanup:
-	if (dns_rdataset_isassociated(&rdataset)) {
-		dns_rdataset_disassociate(&rdataset);
-	}
-	if (dns_rdataset_isassociated(&sigrdataset)) {
-		dns_rdataset_disassociate(&sigrdataset);
-	}
-	if (soardataset != NULL) {
-		ns_client_putrdataset(qctx->client, &soardataset);
+	dbuf = ns_client_getnamebuf(qctx->client);
+	name = ns_client_newname(qctx->client, dbuf, &b);
+	dns_name_copy(zone, name);
+	if (WANTDNSSEC(qctx->client)) {
+		sigsoardatasetp = &sigsoardataset;
 	}
-	if (sigsoardataset != NULL) {
-		ns_client_putrdataset(qctx->client, &sigsoardataset);
+	query_addrrset(qctx, &name, &soardataset, sigsoardatasetp, dbuf,
+		       DNS_SECTION_AUTHORITY);
+	if (name != NULL) {
+		ns_client_releasename(qctx->client, &name);
 	}
-	if (db != NULL) {
-		if (node != NULL) {
-			dns_db_detachnode(db, &node);
+
+	if (WANTDNSSEC(qctx->client)) {
+		unsigned int order[] = { ce, nc, NSEC3PROOF_WILDCARD };
+
+		/*
+		 * Add the NSEC3 proofs; query_addrrset() skips any that
+		 * are already in the message.
+		 */
+		for (i = 0; i < (nodata ? 1 : ARRAY_SIZE(order)); i++) {
+			nsec3proof_t *proof = &proofs[order[i]];
+
+			dbuf = ns_client_getnamebuf(qctx->client);
+			name = ns_client_newname(qctx->client, dbuf, &b);
+			dns_name_copy(proof->name, name);
+			query_addrrset(qctx, &name, &proof->rdataset,
+				       &proof->sigrdataset, dbuf,
+				       DNS_SECTION_AUTHORITY);
+			if (name != NULL) {
+				ns_client_releasename(qctx->client, &name);
+			}
 		}
-		dns_db_detach(&db);
 	}
 
-	if (redirected) {
-		return (result);
+	if (nodata) {
+		inc_stats(qctx->client, ns_statscounter_nodatasynth);
+	} else {
+		qctx->client->message->rcode = dns_rcode_nxdomain;
+		inc_stats(qctx->client, ns_statscounter_nxdomainsynth);
+	}
+	done = true;
+
+cleanup:
+	for (i = 0; i < NSEC3PROOF_MAX; i++) {
+		ns_client_putrdataset(qctx->client, &proofs[i].rdataset);
+		ns_client_putrdataset(qctx->client, &proofs[i].sigrdataset);
 	}
+	ns_client_putrdataset(qctx->client, &soardataset);
+	ns_client_putrdataset(qctx->client, &sigsoardataset);
 
 	if (!done) {
-		/*
-		 * No covering NSEC was found; proceed with recursion.
-		 */
-		qctx->findcoveringnsec = false;
-		if (qctx->fname != NULL) {
-			ns_client_releasename(qctx->client, &qctx->fname);
-		}
-		if (qctx->node != NULL) {
-			dns_db_detachnode(qctx->db, &qctx->node);
-		}
-		ns_client_putrdataset(qctx->client, &qctx->rdataset);
-		if (qctx->sigrdataset != NULL) {
-			ns_client_putrdataset(qctx->client, &qctx->sigrdataset);
-		}
-		return (query_lookup(qctx));
+		return (ISC_R_COMPLETE);
 	}
 
 	return (ns_query_done(qctx));
@@ -11314,7 +12487,8 @@ query_setup_sortlist(query_ctx_t *qctx) {
 	void *order_arg = NULL;
 
 	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
-	switch (ns_sortlist_setup(client->view->sortlist, env, &netaddr,
+	switch (ns_sortlist_setup(client->view->sortlist,
+				  client->view->sortlistindex, env, &netaddr,
 				  &order_arg))
 	{
 	case NS_SORTLISTTYPE_1ELEMENT:
@@ -11688,6 +12862,70 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level) {
 		      sep2, typep, __FILE__, line);
 }
 
+/*%
+ * With "early-drop", check whether responses to this query name are
+ * already rate limited for the client before looking anything up.
+ * A dropped query is not answered; a slipped one is answered from the
+ * question alone.  Returns DNS_R_DROP if the query has been disposed
+ * of, or ISC_R_SUCCESS to continue with the normal query processing,
+ * after which query_checkrrl() limits the response as usual.
+ */
+static isc_result_t
+query_earlyrrl(ns_client_t *client, dns_rdatatype_t qtype) {
+	dns_rrl_t *rrl = client->view->rrl;
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	dns_rrl_result_t rrl_result;
+	bool wouldlog;
+
+	if (rrl == NULL || !rrl->early_drop || HAVECOOKIE(client) ||
+	    TCP(client))
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	wouldlog = isc_log_wouldlog(DNS_RRL_LOG_DROP);
+	rrl_result = dns_rrl_early(client->view, &client->peeraddr,
+				   client->message->rdclass, qtype,
+				   client->query.qname, client->now, wouldlog,
+				   log_buf, sizeof(log_buf));
+	if (rrl_result == DNS_RRL_RESULT_OK) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * The response has been counted, so it must not be counted
+	 * again by query_checkrrl() when only logging.
+	 */
+	client->query.attributes |= NS_QUERYATTR_RRL_CHECKED;
+
+	if (wouldlog) {
+		ns_client_log(client, DNS_LOGCATEGORY_RRL, NS_LOGMODULE_QUERY,
+			      DNS_RRL_LOG_DROP, "%s", log_buf);
+	}
+
+	if (rrl->log_only) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (rrl_result == DNS_RRL_RESULT_DROP) {
+		inc_stats(client, ns_statscounter_ratedropped);
+		query_next(client, DNS_R_DROP);
+		return (DNS_R_DROP);
+	}
+
+	inc_stats(client, ns_statscounter_rateslipped);
+	client->message->flags &= ~DNS_MESSAGEFLAG_AA;
+	if (WANTCOOKIE(client)) {
+		client->message->flags &= ~DNS_MESSAGEFLAG_AD;
+		client->message->rcode = dns_rcode_badcookie;
+		client->attributes &= ~NS_CLIENTATTR_WANTRC;
+	} else {
+		client->message->flags |= DNS_MESSAGEFLAG_TC;
+	}
+	query_send(client);
+	return (DNS_R_DROP);
+}
+
 void
 ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	isc_result_t result;
@@ -11806,6 +13044,7 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	client->query.qtype = qtype = rdataset->type;
 	dns_rdatatypestats_increment(client->manager->sctx->rcvquerystats,
 				     qtype);
+	query_trace_start(client);
 
 	log_tat(client);
 
@@ -11980,5 +13219,13 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 		message->flags |= DNS_MESSAGEFLAG_AD;
 	}
 
+	/*
+	 * Drop or slip queries whose responses are already being rate
+	 * limited before doing any database work.
+	 */
+	if (query_earlyrrl(client, qtype) != ISC_R_SUCCESS) {
+		return;
+	}
+
 	query_setup(client, qtype);
 }
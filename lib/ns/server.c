@@ -25,10 +25,19 @@
 #include <ns/query.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrout.h>
 
 #define SCTX_MAGIC    ISC_MAGIC('S', 'c', 't', 'x')
 #define SCTX_VALID(s) ISC_MAGIC_VALID(s, SCTX_MAGIC)
 
+/*
+ * The adaptive recursive-clients limit is lowered by 1/RECURSION_DECREASE
+ * of itself, down to 1/RECURSION_DECREASE of the configured limit, and
+ * raised by 1/RECURSION_INCREASE of the configured limit.
+ */
+#define RECURSION_DECREASE 8
+#define RECURSION_INCREASE 32
+
 #define CHECKFATAL(op)                                  \
 	do {                                            \
 		result = (op);                          \
@@ -72,7 +81,7 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 
 	ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats);
 
-	dns_rdatatypestats_create(mctx, &sctx->rcvquerystats);
+	dns_rdatatypestats_create_sharded(mctx, &sctx->rcvquerystats);
 
 	dns_opcodestats_create(mctx, &sctx->opcodestats);
 
@@ -102,8 +111,16 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_histomulti_create(mctx, DNS_SIZEHISTO_SIGBITSOUT,
 			      &sctx->tcpoutstats6);
 
+	for (size_t i = 0; i < ns_latency_max; i++) {
+		isc_histomulti_create(mctx, NS_LATENCY_SIGBITS,
+				      &sctx->latency[i]);
+	}
+
 	ISC_LIST_INIT(sctx->altsecrets);
 
+	isc_mutex_init(&sctx->xfrcache_lock);
+	ISC_LIST_INIT(sctx->xfrcache);
+
 	sctx->magic = SCTX_MAGIC;
 	*sctxp = sctx;
 }
@@ -135,6 +152,9 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_mem_put(sctx->mctx, altsecret, sizeof(*altsecret));
 		}
 
+		ns_xfr_flushcache(sctx);
+		isc_mutex_destroy(&sctx->xfrcache_lock);
+
 		if (sctx->sig0checksquota_exempt != NULL) {
 			dns_acl_detach(&sctx->sig0checksquota_exempt);
 		}
@@ -209,6 +229,12 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_histomulti_destroy(&sctx->tcpoutstats6);
 		}
 
+		for (size_t i = 0; i < ns_latency_max; i++) {
+			if (sctx->latency[i] != NULL) {
+				isc_histomulti_destroy(&sctx->latency[i]);
+			}
+		}
+
 		sctx->magic = 0;
 
 		isc_mem_putanddetach(&sctx->mctx, sctx, sizeof(*sctx));
@@ -258,3 +284,19 @@ ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota) {
 	ISC_LIST_APPEND(sctx->http_quotas, http_quota, link);
 	UNLOCK(&sctx->http_quotas_lock);
 }
+
+unsigned int
+ns_server_recursionlimit(unsigned int limit, unsigned int max,
+			 bool congested) {
+	unsigned int floor = ISC_MAX(max / RECURSION_DECREASE, 1);
+
+	if (congested && limit > floor) {
+		unsigned int step = ISC_MAX(limit / RECURSION_DECREASE, 1);
+		return (ISC_MAX(limit - step, floor));
+	} else if (!congested && limit < max) {
+		unsigned int step = ISC_MAX(max / RECURSION_INCREASE, 1);
+		return (ISC_MIN(limit + step, max));
+	}
+
+	return (limit);
+}
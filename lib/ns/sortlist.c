@@ -18,49 +18,247 @@
 #include <isc/util.h>
 
 #include <dns/acl.h>
+#include <dns/iptable.h>
 #include <dns/message.h>
 
 #include <ns/server.h>
 #include <ns/sortlist.h>
 
+struct ns_sortlistindex {
+	dns_acl_t *table;
+	unsigned int count;
+	int *last;
+};
+
+/*
+ * Split the top level sortlist statement 'e' (see ARM) into the
+ * element that is matched against the client address and the
+ * optional element that orders the addresses in the response.
+ * Return false if the statement is one we cannot sort with.
+ */
+static bool
+split_statement(dns_aclelement_t *e, dns_aclelement_t **tryp,
+		dns_aclelement_t **orderp) {
+	*tryp = NULL;
+	*orderp = NULL;
+
+	if (e->type == dns_aclelementtype_nestedacl) {
+		dns_acl_t *inner = e->nestedacl;
+
+		if (inner->length == 0) {
+			*tryp = e;
+		} else if (inner->length > 2) {
+			return (false);
+		} else if (inner->elements[0].negative) {
+			return (false);
+		} else {
+			*tryp = &inner->elements[0];
+			if (inner->length == 2) {
+				*orderp = &inner->elements[1];
+			}
+		}
+	} else {
+		/*
+		 * BIND 8 allows bare elements at the top level
+		 * as an undocumented feature.
+		 */
+		*tryp = e;
+	}
+
+	return (true);
+}
+
+static ns_sortlisttype_t
+statement_setup(dns_aclelement_t *matched_elt, dns_aclelement_t *order_elt,
+		dns_aclenv_t *env, void **argp) {
+	if (order_elt == NULL) {
+		INSIST(matched_elt != NULL);
+		*argp = matched_elt;
+		return (NS_SORTLISTTYPE_1ELEMENT);
+	}
+
+	if (order_elt->type == dns_aclelementtype_nestedacl) {
+		dns_acl_t *inner = NULL;
+		dns_acl_attach(order_elt->nestedacl, &inner);
+		*argp = inner;
+		return (NS_SORTLISTTYPE_2ELEMENT);
+	}
+
+	if (order_elt->type == dns_aclelementtype_localhost) {
+		rcu_read_lock();
+		dns_acl_t *inner = rcu_dereference(env->localhost);
+		if (inner != NULL) {
+			*argp = dns_acl_ref(inner);
+			rcu_read_unlock();
+			return (NS_SORTLISTTYPE_2ELEMENT);
+		}
+		rcu_read_unlock();
+	}
+
+	if (order_elt->type == dns_aclelementtype_localnets) {
+		rcu_read_lock();
+		dns_acl_t *inner = rcu_dereference(env->localhost);
+		if (inner != NULL) {
+			*argp = dns_acl_ref(inner);
+			rcu_read_unlock();
+			return (NS_SORTLISTTYPE_2ELEMENT);
+		}
+		rcu_read_unlock();
+	}
+
+	/*
+	 * BIND 8 allows a bare IP prefix as
+	 * the 2nd element of a 2-element
+	 * sortlist statement.
+	 */
+	*argp = order_elt;
+	return (NS_SORTLISTTYPE_1ELEMENT);
+}
+
+/*
+ * Merge the IP prefixes of 'acl', and of the ACLs nested in it, into
+ * 'table'.  Fail if 'acl' matches anything but IP prefixes.
+ */
+static isc_result_t
+merge_prefixes(dns_acl_t *table, dns_acl_t *acl) {
+	isc_result_t result;
+
+	if (acl->has_negatives) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = dns_iptable_merge(table->iptable, acl->iptable, true);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	for (unsigned int i = 0; i < acl->length; i++) {
+		dns_aclelement_t *e = &acl->elements[i];
+
+		if (e->negative || e->type != dns_aclelementtype_nestedacl) {
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		result = merge_prefixes(table, e->nestedacl);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+ns_sortlist_compile(isc_mem_t *mctx, dns_acl_t *acl,
+		    ns_sortlistindex_t **indexp) {
+	isc_result_t result = ISC_R_SUCCESS;
+	ns_sortlistindex_t *index = NULL;
+
+	REQUIRE(DNS_ACL_VALID(acl));
+	REQUIRE(indexp != NULL && *indexp == NULL);
+
+	if (acl->length == 0) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	index = isc_mem_get(mctx, sizeof(*index));
+	*index = (ns_sortlistindex_t){ .count = acl->length };
+	index->last = isc_mem_cget(mctx, index->count, sizeof(index->last[0]));
+	dns_acl_create(mctx, 0, &index->table);
+
+	/*
+	 * Merge the prefixes of the statements into one table in order.
+	 * A prefix keeps the node number it had when it was first
+	 * added, so the best match in the table has the node number of
+	 * the first statement that matches, and statement 'i' owns the
+	 * node numbers up to 'last[i]'.
+	 */
+	for (unsigned int i = 0; i < index->count; i++) {
+		dns_aclelement_t *try_elt = NULL, *order_elt = NULL;
+
+		if (!split_statement(&acl->elements[i], &try_elt, &order_elt) ||
+		    try_elt->type != dns_aclelementtype_nestedacl)
+		{
+			result = ISC_R_NOTIMPLEMENTED;
+			goto cleanup;
+		}
+
+		result = merge_prefixes(index->table, try_elt->nestedacl);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		index->last[i] = dns_acl_node_count(index->table);
+	}
+
+	*indexp = index;
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	ns_sortlist_freeindex(mctx, (void **)&index);
+	return (result);
+}
+
+void
+ns_sortlist_freeindex(isc_mem_t *mctx, void **indexp) {
+	ns_sortlistindex_t *index = NULL;
+
+	REQUIRE(indexp != NULL && *indexp != NULL);
+
+	index = *indexp;
+	*indexp = NULL;
+
+	dns_acl_detach(&index->table);
+	isc_mem_cput(mctx, index->last, index->count, sizeof(index->last[0]));
+	isc_mem_put(mctx, index, sizeof(*index));
+}
+
 ns_sortlisttype_t
-ns_sortlist_setup(dns_acl_t *acl, dns_aclenv_t *env, isc_netaddr_t *clientaddr,
-		  void **argp) {
+ns_sortlist_setup(dns_acl_t *acl, const ns_sortlistindex_t *index,
+		  dns_aclenv_t *env, isc_netaddr_t *clientaddr, void **argp) {
 	if (acl == NULL) {
 		goto dont_sort;
 	}
 
+	if (index != NULL) {
+		dns_aclelement_t *try_elt = NULL, *order_elt = NULL;
+		unsigned int lo = 0, hi = index->count;
+		int match;
+
+		INSIST(index->count == acl->length);
+
+		(void)dns_acl_match(clientaddr, NULL, index->table, env, &match,
+				    NULL);
+		if (match <= 0) {
+			goto dont_sort;
+		}
+
+		/* Find the first statement whose node numbers reach it. */
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (index->last[mid] < match) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		INSIST(lo < index->count);
+
+		RUNTIME_CHECK(split_statement(&acl->elements[lo], &try_elt,
+					      &order_elt));
+		return (statement_setup(try_elt, order_elt, env, argp));
+	}
+
 	for (size_t i = 0; i < acl->length; i++) {
 		/*
 		 * 'e' refers to the current 'top level statement'
 		 * in the sortlist (see ARM).
 		 */
 		dns_aclelement_t *e = &acl->elements[i];
-		dns_aclelement_t *try_elt;
+		dns_aclelement_t *try_elt = NULL;
 		dns_aclelement_t *order_elt = NULL;
 		dns_aclelement_t *matched_elt = NULL;
 
-		if (e->type == dns_aclelementtype_nestedacl) {
-			dns_acl_t *inner = e->nestedacl;
-
-			if (inner->length == 0) {
-				try_elt = e;
-			} else if (inner->length > 2) {
-				goto dont_sort;
-			} else if (inner->elements[0].negative) {
-				goto dont_sort;
-			} else {
-				try_elt = &inner->elements[0];
-				if (inner->length == 2) {
-					order_elt = &inner->elements[1];
-				}
-			}
-		} else {
-			/*
-			 * BIND 8 allows bare elements at the top level
-			 * as an undocumented feature.
-			 */
-			try_elt = e;
+		if (!split_statement(e, &try_elt, &order_elt)) {
+			goto dont_sort;
 		}
 
 		if (!dns_aclelement_match(
@@ -70,48 +268,7 @@ ns_sortlist_setup(dns_acl_t *acl, dns_aclenv_t *env, isc_netaddr_t *clientaddr,
 			continue;
 		}
 
-		if (order_elt == NULL) {
-			INSIST(matched_elt != NULL);
-			*argp = matched_elt;
-			return (NS_SORTLISTTYPE_1ELEMENT);
-		}
-
-		if (order_elt->type == dns_aclelementtype_nestedacl) {
-			dns_acl_t *inner = NULL;
-			dns_acl_attach(order_elt->nestedacl, &inner);
-			*argp = inner;
-			return (NS_SORTLISTTYPE_2ELEMENT);
-		}
-
-		if (order_elt->type == dns_aclelementtype_localhost) {
-			rcu_read_lock();
-			dns_acl_t *inner = rcu_dereference(env->localhost);
-			if (inner != NULL) {
-				*argp = dns_acl_ref(inner);
-				rcu_read_unlock();
-				return (NS_SORTLISTTYPE_2ELEMENT);
-			}
-			rcu_read_unlock();
-		}
-
-		if (order_elt->type == dns_aclelementtype_localnets) {
-			rcu_read_lock();
-			dns_acl_t *inner = rcu_dereference(env->localhost);
-			if (inner != NULL) {
-				*argp = dns_acl_ref(inner);
-				rcu_read_unlock();
-				return (NS_SORTLISTTYPE_2ELEMENT);
-			}
-			rcu_read_unlock();
-		}
-
-		/*
-		 * BIND 8 allows a bare IP prefix as
-		 * the 2nd element of a 2-element
-		 * sortlist statement.
-		 */
-		*argp = order_elt;
-		return (NS_SORTLISTTYPE_1ELEMENT);
+		return (statement_setup(matched_elt, order_elt, env, argp));
 	}
 
 dont_sort:
@@ -67,7 +67,7 @@ ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
 
 	isc_refcount_init(&stats->references, 1);
 
-	isc_stats_create(mctx, &stats->counters, ncounters);
+	isc_stats_create_sharded(mctx, &stats->counters, ncounters);
 
 	stats->magic = NS_STATS_MAGIC;
 	stats->mctx = NULL;
@@ -75,6 +75,12 @@
  */
 #define LOGLEVEL_DEBUG ISC_LOG_DEBUG(8)
 
+/*%
+ * Maximum number of queued UPDATEs to a zone that are merged into one
+ * version.
+ */
+#define UPDATE_MAXBATCH 64
+
 /*%
  * Check an operation for failure.  These macros all assume that
  * the function using them has a 'result' variable and a 'failure'
@@ -231,6 +237,9 @@ struct update {
 	dns_message_t *answer;
 	const dns_ssurule_t **rules;
 	size_t ruleslen;
+	bool mergeable;
+	ISC_LINK(update_t) link;
+	ISC_LIST(update_t) merged;
 };
 
 /*%
@@ -261,7 +270,11 @@ typedef struct {
  */
 
 static void
-update_action(void *arg);
+update_enqueue(void *arg);
+static void
+update_finish(update_t *uev, isc_result_t result);
+static void
+update_journaled(isc_result_t result, void *arg);
 static void
 updatedone_action(void *arg);
 static isc_result_t
@@ -1647,6 +1660,7 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 	dns_db_t *db = NULL;
 	dns_dbversion_t *ver = NULL;
 	update_t *uev = NULL;
+	bool mergeable = true;
 
 	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
@@ -1709,6 +1723,13 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 		if (!dns_name_issubdomain(name, zonename)) {
 			FAILC(DNS_R_NOTZONE, "update RR is outside zone");
 		}
+		/*
+		 * Changes at the apex may touch the SOA or the DNSSEC
+		 * keys and parameters, so such UPDATEs are applied alone.
+		 */
+		if (dns_name_equal(name, zonename)) {
+			mergeable = false;
+		}
 		if (update_class == zoneclass) {
 			/*
 			 * Check for meta-RRs.  The RFC2136 pseudocode says
@@ -1886,10 +1907,13 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 		.rules = rules,
 		.ruleslen = ruleslen,
 		.result = ISC_R_SUCCESS,
+		.mergeable = mergeable,
 	};
+	ISC_LINK_INIT(uev, link);
+	ISC_LIST_INIT(uev->merged);
 
 	isc_nmhandle_attach(client->handle, &client->updatehandle);
-	isc_async_run(dns_zone_getloop(zone), update_action, uev);
+	isc_async_run(dns_zone_getloop(zone), update_enqueue, uev);
 	rules = NULL;
 
 failure:
@@ -2725,20 +2749,21 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(void *arg) {
-	update_t *uev = (update_t *)arg;
+/*
+ * Check the prerequisites of the UPDATE in 'uev' against version 'ver'
+ * of 'db', then apply its update section to 'ver', recording the changes
+ * in 'diff'.  '*changed' is set once the zone may have been changed,
+ * and '*soa_serial_changed' if the update set a new SOA serial.
+ */
+static isc_result_t
+update_apply(update_t *uev, dns_db_t *db, dns_dbversion_t *ver,
+	     dns_diff_t *diff, bool *soa_serial_changed, bool *changed) {
 	dns_zone_t *zone = uev->zone;
 	ns_client_t *client = uev->client;
 	const dns_ssurule_t **rules = uev->rules;
 	size_t rule = 0, ruleslen = uev->ruleslen;
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
-	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff; /* Pending updates. */
 	dns_diff_t temp; /* Pending RR existence assertions. */
-	bool soa_serial_changed = false;
 	isc_mem_t *mctx = client->manager->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
@@ -2748,17 +2773,12 @@ update_action(void *arg) {
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
 	dns_zoneopt_t options;
-	bool had_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 	dns_ttl_t maxttl = 0;
-	uint32_t maxrecords;
-	uint64_t records;
 	bool is_inline, is_maintain, is_signing;
 
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
 
-	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
 	zoneclass = dns_db_class(db);
 	dns_zone_getssutable(zone, &ssutable);
@@ -2768,12 +2788,6 @@ update_action(void *arg) {
 	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
 	is_signing = is_inline || (!is_inline && is_maintain);
 
-	/*
-	 * Get old and new versions now that queryacl has been checked.
-	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
-
 	/*
 	 * Check prerequisites.
 	 */
@@ -2894,6 +2908,7 @@ update_action(void *arg) {
 	}
 
 	update_log(client, zone, LOGLEVEL_DEBUG, "prerequisites are OK");
+	*changed = true;
 
 	/*
 	 * Process the Update Section.
@@ -2993,7 +3008,7 @@ update_action(void *arg) {
 						   "ignoring it");
 					continue;
 				}
-				soa_serial_changed = true;
+				*soa_serial_changed = true;
 			}
 
 			if (dns_rdatatype_atparent(rdata.type) &&
@@ -3113,7 +3128,7 @@ update_action(void *arg) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.oldname = name;
 				ctx.update_rr = &rdata;
@@ -3130,11 +3145,11 @@ update_action(void *arg) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
@@ -3142,7 +3157,7 @@ update_action(void *arg) {
 						goto failure;
 					}
 					result = update_one_rr(
-						db, ver, &diff, DNS_DIFFOP_ADD,
+						db, ver, diff, DNS_DIFFOP_ADD,
 						name, ttl, &rdata);
 					if (result != ISC_R_SUCCESS) {
 						update_log(client, zone,
@@ -3171,12 +3186,12 @@ update_action(void *arg) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec, db,
 							ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -3202,7 +3217,7 @@ update_action(void *arg) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -3269,7 +3284,7 @@ update_action(void *arg) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE) {
@@ -3281,11 +3296,11 @@ update_action(void *arg) {
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
 	 * records.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		CHECK(check_dnssec(client, zone, db, ver, &diff));
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
+		CHECK(check_dnssec(client, zone, db, ver, diff));
 	}
 
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		unsigned int errors = 0;
 		CHECK(dns_zone_nscheck(zone, db, ver, &errors));
 		if (errors != 0) {
@@ -3296,7 +3311,7 @@ update_action(void *arg) {
 			goto failure;
 		}
 	}
-	if (!ISC_LIST_EMPTY(diff.tuples) && is_signing) {
+	if (!ISC_LIST_EMPTY(diff->tuples) && is_signing) {
 		result = dns_zone_cdscheck(zone, db, ver);
 		if (result == DNS_R_BADCDS || result == DNS_R_BADCDNSKEY) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
@@ -3310,120 +3325,184 @@ update_action(void *arg) {
 		}
 	}
 
+	result = ISC_R_SUCCESS;
+
+failure:
+	dns_diff_clear(&temp);
+
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
+	}
+
+	return (result);
+}
+
+/*
+ * The changes in 'diff' have been applied to '*verp': increment the SOA
+ * serial number, update RRSIGs and NSECs (if zone is secure), write the
+ * update to the journal and commit the version.  If the journal is
+ * synced later, '*journaled' is set and update_journaled() is called
+ * with 'uev' once it is.  On failure, '*verp' is left open.
+ */
+static isc_result_t
+update_commit(update_t *uev, dns_db_t *db, dns_dbversion_t *oldver,
+	      dns_dbversion_t **verp, dns_diff_t *diff, bool soa_serial_changed,
+	      bool *journaled) {
+	dns_zone_t *zone = uev->zone;
+	ns_client_t *client = uev->client;
+	isc_mem_t *mctx = client->manager->mctx;
+	dns_dbversion_t *ver = *verp;
+	dns_name_t *zonename = dns_db_origin(db);
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	isc_result_t result;
+	char *journalfile;
+	bool had_dnskey, has_dnskey;
+	uint32_t maxrecords;
+	uint64_t records;
+	bool is_inline, is_maintain, is_signing;
+
+	is_inline = (!dns_zone_israw(zone) && dns_zone_issecure(zone));
+	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
+	is_signing = is_inline || (!is_inline && is_maintain);
+
 	/*
-	 * If any changes were made, increment the SOA serial number,
-	 * update RRSIGs and NSECs (if zone is secure), and write the update
-	 * to the journal.
+	 * Increment the SOA serial, but only if it was not
+	 * changed as a result of an update operation.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		char *journalfile;
-		dns_journal_t *journal;
-		bool has_dnskey;
+	if (!soa_serial_changed) {
+		CHECK(update_soa_serial(db, ver, diff, mctx,
+					dns_zone_getserialupdatemethod(zone)));
+	}
 
-		/*
-		 * Increment the SOA serial, but only if it was not
-		 * changed as a result of an update operation.
-		 */
-		if (!soa_serial_changed) {
-			CHECK(update_soa_serial(
-				db, ver, &diff, mctx,
-				dns_zone_getserialupdatemethod(zone)));
-		}
+	CHECK(check_mx(client, zone, db, ver, diff));
 
-		CHECK(check_mx(client, zone, db, ver, &diff));
+	CHECK(remove_orphaned_ds(db, ver, diff));
 
-		CHECK(remove_orphaned_ds(db, ver, &diff));
+	CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
+			   &has_dnskey));
 
-		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
-				   &has_dnskey));
+	CHECK(rrset_exists(db, oldver, zonename, dns_rdatatype_dnskey, 0,
+			   &had_dnskey));
 
-		CHECK(rrset_exists(db, oldver, zonename, dns_rdatatype_dnskey,
-				   0, &had_dnskey));
+	CHECK(rollback_private(db, privatetype, ver, diff));
 
-		CHECK(rollback_private(db, privatetype, ver, &diff));
+	CHECK(add_nsec3param_records(client, zone, db, ver, diff));
 
-		CHECK(add_nsec3param_records(client, zone, db, ver, &diff));
+	if (is_signing && had_dnskey && !has_dnskey) {
+		/*
+		 * We are transitioning from secure to insecure.
+		 * Cause all NSEC3 chains to be deleted.  When the
+		 * the last signature for the DNSKEY records are
+		 * remove any NSEC chain present will also be removed.
+		 */
+		CHECK(dns_nsec3param_deletechains(db, ver, zone, true, diff));
+	} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
+		dns_update_log_t log;
+		uint32_t interval = dns_zone_getsigvalidityinterval(zone);
 
-		if (is_signing && had_dnskey && !has_dnskey) {
-			/*
-			 * We are transitioning from secure to insecure.
-			 * Cause all NSEC3 chains to be deleted.  When the
-			 * the last signature for the DNSKEY records are
-			 * remove any NSEC chain present will also be removed.
-			 */
-			CHECK(dns_nsec3param_deletechains(db, ver, zone, true,
-							  &diff));
-		} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
-			dns_update_log_t log;
-			uint32_t interval =
-				dns_zone_getsigvalidityinterval(zone);
-
-			log.func = update_log_cb;
-			log.arg = client;
-			result = dns_update_signatures(&log, zone, db, oldver,
-						       ver, &diff, interval);
+		log.func = update_log_cb;
+		log.arg = client;
+		result = dns_update_signatures(&log, zone, db, oldver, ver,
+					       diff, interval);
 
-			if (result != ISC_R_SUCCESS) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "RRSIG/NSEC/NSEC3 update failed: %s",
-					   isc_result_totext(result));
-				goto failure;
-			}
+		if (result != ISC_R_SUCCESS) {
+			update_log(client, zone, ISC_LOG_ERROR,
+				   "RRSIG/NSEC/NSEC3 update failed: %s",
+				   isc_result_totext(result));
+			goto failure;
 		}
+	}
 
-		maxrecords = dns_zone_getmaxrecords(zone);
-		if (maxrecords != 0U) {
-			result = dns_db_getsize(db, ver, &records, NULL);
-			if (result == ISC_R_SUCCESS && records > maxrecords) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "records in zone (%" PRIu64 ") "
-					   "exceeds max-records (%u)",
-					   records, maxrecords);
-				result = DNS_R_TOOMANYRECORDS;
-				goto failure;
-			}
+	maxrecords = dns_zone_getmaxrecords(zone);
+	if (maxrecords != 0U) {
+		result = dns_db_getsize(db, ver, &records, NULL);
+		if (result == ISC_R_SUCCESS && records > maxrecords) {
+			update_log(client, zone, ISC_LOG_ERROR,
+				   "records in zone (%" PRIu64 ") "
+				   "exceeds max-records (%u)",
+				   records, maxrecords);
+			result = DNS_R_TOOMANYRECORDS;
+			goto failure;
 		}
+	}
 
-		journalfile = dns_zone_getjournal(zone);
-		if (journalfile != NULL) {
-			update_log(client, zone, LOGLEVEL_DEBUG,
-				   "writing journal %s", journalfile);
+	journalfile = dns_zone_getjournal(zone);
+	if (journalfile != NULL) {
+		update_log(client, zone, LOGLEVEL_DEBUG, "writing journal %s",
+			   journalfile);
 
-			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
-			if (result != ISC_R_SUCCESS) {
-				FAILS(result, "journal open failed");
-			}
+		/*
+		 * With journal-group-commit, the response is sent
+		 * by update_journaled() once the journal is synced.
+		 */
+		result = dns_zone_writejournal(zone, diff, update_journaled,
+					       uev);
+		if (result == DNS_R_CONTINUE) {
+			*journaled = true;
+		} else if (result != ISC_R_SUCCESS) {
+			FAILS(result, "journal write failed");
+		}
+	}
 
-			result = dns_journal_write_transaction(journal, &diff);
-			if (result != ISC_R_SUCCESS) {
-				dns_journal_destroy(&journal);
-				FAILS(result, "journal write failed");
-			}
+	/*
+	 * XXXRTH  Just a note that this committing code will have
+	 *	   to change to handle databases that need two-phase
+	 *	   commit, but this isn't a priority.
+	 */
+	update_log(client, zone, LOGLEVEL_DEBUG,
+		   "committing update transaction");
 
-			dns_journal_destroy(&journal);
-		}
+	dns_db_closeversion(db, verp, true);
 
-		/*
-		 * XXXRTH  Just a note that this committing code will have
-		 *	   to change to handle databases that need two-phase
-		 *	   commit, but this isn't a priority.
-		 */
-		update_log(client, zone, LOGLEVEL_DEBUG,
-			   "committing update transaction");
+	/*
+	 * Mark the zone as dirty so that it will be written to disk.
+	 */
+	dns_zone_markdirty(zone);
 
-		dns_db_closeversion(db, &ver, true);
+	/*
+	 * Notify secondaries of the change we just made.
+	 */
+	dns_zone_notify(zone);
 
-		/*
-		 * Mark the zone as dirty so that it will be written to disk.
-		 */
-		dns_zone_markdirty(zone);
+	return (ISC_R_SUCCESS);
 
-		/*
-		 * Notify secondaries of the change we just made.
-		 */
-		dns_zone_notify(zone);
+failure:
+	return (result);
+}
+
+static void
+update_action(void *arg) {
+	update_t *uev = (update_t *)arg;
+	dns_zone_t *zone = uev->zone;
+	ns_client_t *client = uev->client;
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff; /* Pending updates. */
+	bool soa_serial_changed = false;
+	bool changed = false;
+	bool journaled = false;
+
+	dns_diff_init(client->manager->mctx, &diff);
+
+	CHECK(dns_zone_getdb(zone, &db));
+
+	/*
+	 * Get old and new versions now that queryacl has been checked.
+	 */
+	dns_db_currentversion(db, &oldver);
+	CHECK(dns_db_newversion(db, &ver));
+
+	CHECK(update_apply(uev, db, ver, &diff, &soa_serial_changed,
+			   &changed));
+
+	/*
+	 * If any changes were made, commit them.
+	 */
+	if (!ISC_LIST_EMPTY(diff.tuples)) {
+		CHECK(update_commit(uev, db, oldver, &ver, &diff,
+				    soa_serial_changed, &journaled));
 	} else {
 		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
 		dns_db_closeversion(db, &ver, true);
@@ -3441,7 +3520,6 @@ failure:
 	}
 
 common:
-	dns_diff_clear(&temp);
 	dns_diff_clear(&diff);
 
 	if (oldver != NULL) {
@@ -3452,21 +3530,223 @@ common:
 		dns_db_detach(&db);
 	}
 
-	if (rules != NULL) {
-		isc_mem_cput(mctx, rules, ruleslen, sizeof(*rules));
+	INSIST(ver == NULL);
+	if (!journaled) {
+		update_finish(uev, result);
 	}
+}
 
-	if (ssutable != NULL) {
-		dns_ssutable_detach(&ssutable);
+/*
+ * Apply a run of queued UPDATEs for the same zone in a single version,
+ * so that the SOA serial is incremented, the changes are signed and the
+ * journal is written once for all of them.  Each UPDATE still sees the
+ * changes made by the ones before it.  An UPDATE that fails before
+ * changing anything (typically on a prerequisite) is answered at once.
+ * On any other failure the version is rolled back and the remaining
+ * UPDATEs are processed one at a time by update_action(), so the
+ * outcome is the same as if they had never been merged.
+ */
+static void
+update_batch(update_t **updates, size_t count) {
+	dns_zone_t *zone = updates[0]->zone;
+	isc_mem_t *mctx = updates[0]->client->manager->mctx;
+	update_t *head = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff;
+	size_t merged = 0;
+	bool journaled = false;
+	isc_result_t result;
+
+	dns_diff_init(mctx, &diff);
+
+	result = dns_zone_getdb(zone, &db);
+	if (result != ISC_R_SUCCESS) {
+		goto serial;
+	}
+	dns_db_currentversion(db, &oldver);
+	result = dns_db_newversion(db, &ver);
+	if (result != ISC_R_SUCCESS) {
+		goto serial;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		dns_diff_t udiff;
+		dns_difftuple_t *tuple = NULL;
+		bool soa_serial_changed = false;
+		bool changed = false;
+
+		dns_diff_init(mctx, &udiff);
+		result = update_apply(updates[i], db, ver, &udiff,
+				      &soa_serial_changed, &changed);
+		if (result != ISC_R_SUCCESS && changed) {
+			dns_diff_clear(&udiff);
+			goto serial;
+		}
+		/* UPDATEs touching the apex, and so the SOA, aren't merged. */
+		INSIST(!soa_serial_changed);
+		if (result != ISC_R_SUCCESS) {
+			update_finish(updates[i], result);
+			updates[i] = NULL;
+			continue;
+		}
+		while ((tuple = ISC_LIST_HEAD(udiff.tuples)) != NULL) {
+			ISC_LIST_UNLINK(udiff.tuples, tuple, link);
+			dns_diff_appendminimal(&diff, &tuple);
+		}
+		dns_diff_clear(&udiff);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (updates[i] == NULL) {
+			continue;
+		}
+		merged++;
+		if (head == NULL) {
+			head = updates[i];
+		} else {
+			ISC_LIST_APPEND(head->merged, updates[i], link);
+		}
+	}
+
+	if (head == NULL) {
+		dns_db_closeversion(db, &ver, false);
+	} else if (ISC_LIST_EMPTY(diff.tuples)) {
+		update_log(head->client, zone, LOGLEVEL_DEBUG,
+			   "redundant request");
+		dns_db_closeversion(db, &ver, true);
+	} else {
+		update_log(head->client, zone, LOGLEVEL_DEBUG,
+			   "committing %zu merged updates", merged);
+		result = update_commit(head, db, oldver, &ver, &diff, false,
+				       &journaled);
+		if (result != ISC_R_SUCCESS) {
+			update_t *uev = NULL;
+
+			while ((uev = ISC_LIST_HEAD(head->merged)) != NULL) {
+				ISC_LIST_UNLINK(head->merged, uev, link);
+			}
+			goto serial;
+		}
+	}
+
+	if (head != NULL && !journaled) {
+		update_finish(head, ISC_R_SUCCESS);
+	}
+	goto cleanup;
+
+serial:
+	if (ver != NULL) {
+		update_log(updates[0]->client, zone, LOGLEVEL_DEBUG,
+			   "rolling back merged updates");
+		dns_db_closeversion(db, &ver, false);
+	}
+	dns_diff_clear(&diff);
+	for (size_t i = 0; i < count; i++) {
+		if (updates[i] != NULL) {
+			update_action(updates[i]);
+		}
+	}
+
+cleanup:
+	dns_diff_clear(&diff);
+
+	if (oldver != NULL) {
+		dns_db_closeversion(db, &oldver, false);
+	}
+
+	if (db != NULL) {
+		dns_db_detach(&db);
+	}
+}
+
+/*
+ * UPDATEs waiting to be processed on this loop, in the order they
+ * arrived.
+ */
+static thread_local ISC_LIST(update_t) update_queue = { NULL, NULL };
+
+/*
+ * Process the queued UPDATEs, merging runs of mergeable UPDATEs for the
+ * same zone.
+ */
+static void
+update_run(void *arg) {
+	update_t *batch[UPDATE_MAXBATCH];
+	update_t *uev = NULL;
+
+	UNUSED(arg);
+
+	while ((uev = ISC_LIST_HEAD(update_queue)) != NULL) {
+		update_t *next = NULL;
+		size_t count = 0;
+
+		ISC_LIST_UNLINK(update_queue, uev, link);
+		batch[count++] = uev;
+		while (uev->mergeable && count < ARRAY_SIZE(batch) &&
+		       (next = ISC_LIST_HEAD(update_queue)) != NULL &&
+		       next->zone == uev->zone && next->mergeable)
+		{
+			ISC_LIST_UNLINK(update_queue, next, link);
+			batch[count++] = next;
+		}
+
+		if (count == 1) {
+			update_action(uev);
+		} else {
+			update_batch(batch, count);
+		}
+	}
+}
+
+/*
+ * Queue an UPDATE on the zone's loop.  The queue is processed once
+ * everything that is already scheduled on the loop has run, so that
+ * UPDATEs arriving in a burst can be merged.
+ */
+static void
+update_enqueue(void *arg) {
+	update_t *uev = (update_t *)arg;
+	bool idle = ISC_LIST_EMPTY(update_queue);
+
+	ISC_LIST_APPEND(update_queue, uev, link);
+	if (idle) {
+		isc_async_run(isc_loop(), update_run, NULL);
+	}
+}
+
+/*
+ * Send the response to the UPDATE in 'uev', and to the UPDATEs that
+ * were merged with it, on their clients' loops.
+ */
+static void
+update_finish(update_t *uev, isc_result_t result) {
+	update_t *merged = NULL;
+
+	while ((merged = ISC_LIST_HEAD(uev->merged)) != NULL) {
+		ISC_LIST_UNLINK(uev->merged, merged, link);
+		merged->result = result;
+		isc_async_run(merged->client->manager->loop, updatedone_action,
+			      merged);
 	}
 
 	uev->result = result;
-	if (zone != NULL) {
-		INSIST(uev->zone == zone); /* we use this later */
+	isc_async_run(uev->client->manager->loop, updatedone_action, uev);
+}
+
+static void
+update_journaled(isc_result_t result, void *arg) {
+	update_t *uev = (update_t *)arg;
+	ns_client_t *client = uev->client;
+
+	if (result != ISC_R_SUCCESS) {
+		update_log(client, uev->zone, ISC_LOG_ERROR,
+			   "error: journal sync failed: %s",
+			   isc_result_totext(result));
 	}
 
-	isc_async_run(client->manager->loop, updatedone_action, uev);
-	INSIST(ver == NULL);
+	update_finish(uev, result);
 }
 
 static void
@@ -3491,6 +3771,10 @@ updatedone_action(void *arg) {
 	respond(client, uev->result);
 
 	isc_quota_release(&client->manager->sctx->updquota);
+	if (uev->rules != NULL) {
+		isc_mem_cput(client->manager->mctx, uev->rules, uev->ruleslen,
+			     sizeof(*uev->rules));
+	}
 	if (uev->zone != NULL) {
 		dns_zone_detach(&uev->zone);
 	}
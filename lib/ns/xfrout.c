@@ -13,12 +13,14 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <isc/formatcheck.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
 #include <isc/result.h>
+#include <isc/serial.h>
 #include <isc/stats.h>
 #include <isc/util.h>
 
@@ -624,6 +626,89 @@ static rrstream_methods_t compound_rrstream_methods = {
 
 /**************************************************************************/
 
+/*
+ * Rendered transfer cache.
+ *
+ * Every message of an AXFR after the first one has no question
+ * section, so its answer section only depends on the zone version,
+ * the space reserved for the OPT and TSIG records and the configured
+ * message size.  When a many-answers AXFR is sent over TCP, those
+ * answer sections are kept, and later transfers of the same version
+ * with the same layout copy them into their own messages instead of
+ * compressing the records again; each message still gets its own
+ * header, OPT record and TSIG signature.
+ *
+ * Only complete transfers are published.  At most XFROUT_CACHE_ENTRIES
+ * transfers are kept, none bigger than XFROUT_CACHE_MAXBYTES, and a
+ * new version of a zone replaces the older ones.
+ */
+#define XFROUT_CACHE_ENTRIES  16
+#define XFROUT_CACHE_MAXBYTES (256 * 1024 * 1024)
+
+typedef struct xfrout_chunk {
+	unsigned char *data;
+	unsigned int length;
+	unsigned int count; /*%< Number of RRs in 'data' */
+} xfrout_chunk_t;
+
+struct ns_xfrcache {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	dns_db_t *db;
+	uint32_t serial;
+	unsigned int reserved; /*%< Space reserved by OPT and TSIG */
+	unsigned int msgsize;  /*%< transfer-message-size used */
+	unsigned int first;    /*%< Number of RRs in the first message */
+	bool complete;
+	size_t size;
+	xfrout_chunk_t *chunks;
+	unsigned int nchunks;
+	unsigned int nalloc;
+	ISC_LINK(ns_xfrcache_t) link;
+};
+
+static void
+xfrcache_destroy(ns_xfrcache_t *entry) {
+	for (unsigned int i = 0; i < entry->nchunks; i++) {
+		isc_mem_put(entry->mctx, entry->chunks[i].data,
+			    entry->chunks[i].length);
+	}
+	if (entry->chunks != NULL) {
+		isc_mem_cput(entry->mctx, entry->chunks, entry->nalloc,
+			     sizeof(entry->chunks[0]));
+	}
+	dns_db_detach(&entry->db);
+	isc_mem_putanddetach(&entry->mctx, entry, sizeof(*entry));
+}
+
+ISC_REFCOUNT_STATIC_DECL(ns_xfrcache);
+ISC_REFCOUNT_STATIC_IMPL(ns_xfrcache, xfrcache_destroy);
+
+/*
+ * Unlink 'entry' from the cache and drop the cache's reference.
+ * The cache lock must be held.
+ */
+static void
+xfrcache_unlink(ns_server_t *sctx, ns_xfrcache_t *entry) {
+	if (ISC_LINK_LINKED(entry, link)) {
+		ISC_LIST_UNLINK(sctx->xfrcache, entry, link);
+		ns_xfrcache_detach(&entry);
+	}
+}
+
+void
+ns_xfr_flushcache(ns_server_t *sctx) {
+	ns_xfrcache_t *entry = NULL;
+
+	LOCK(&sctx->xfrcache_lock);
+	while ((entry = ISC_LIST_HEAD(sctx->xfrcache)) != NULL) {
+		xfrcache_unlink(sctx, entry);
+	}
+	UNLOCK(&sctx->xfrcache_lock);
+}
+
+/**************************************************************************/
+
 /*%
  * Structure holding outgoing transfer statistics
  */
@@ -677,6 +762,13 @@ typedef struct {
 
 	/* Delayed send */
 	isc_nm_timer_t *delayed_send_timer;
+
+	/* Rendered transfer cache */
+	ns_xfrcache_t *cache;	 /*%< Messages are copied from here */
+	ns_xfrcache_t *building; /*%< Messages are recorded here */
+	unsigned int cachenext;	 /*%< Next chunk of 'cache' to send */
+	unsigned int firstcount; /*%< RRs in the first message */
+	bool cachechecked;
 } xfrout_ctx_t;
 
 static void
@@ -1358,6 +1450,195 @@ xfrout_enqueue_send(xfrout_ctx_t *xfr) {
 	isc_nm_timer_start(xfr->delayed_send_timer, timeout);
 }
 
+/*
+ * Called when the second message of a transfer is being built, once
+ * the space reserved for OPT and TSIG is known: either find a cached
+ * rendering of the rest of the transfer, or start recording one.
+ */
+static void
+xfrout_cache_start(xfrout_ctx_t *xfr, unsigned int reserved) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	ns_xfrcache_t *entry = NULL;
+	unsigned int count = 0;
+
+	xfr->cachechecked = true;
+
+	if (xfr->zone == NULL || xfr->qtype != dns_rdatatype_axfr ||
+	    !xfr->many_answers)
+	{
+		return;
+	}
+
+	LOCK(&sctx->xfrcache_lock);
+	for (entry = ISC_LIST_HEAD(sctx->xfrcache); entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, link))
+	{
+		if (entry->db == xfr->db && entry->serial == xfr->end_serial &&
+		    entry->reserved == reserved &&
+		    entry->msgsize == sctx->transfer_tcp_message_size)
+		{
+			break;
+		}
+	}
+
+	if (entry != NULL) {
+		/*
+		 * Skip entries that are still being recorded, or whose
+		 * messages would not line up with what has been sent.
+		 */
+		if (entry->complete && entry->first == xfr->firstcount) {
+			ISC_LIST_UNLINK(sctx->xfrcache, entry, link);
+			ISC_LIST_PREPEND(sctx->xfrcache, entry, link);
+			ns_xfrcache_attach(entry, &xfr->cache);
+		}
+		UNLOCK(&sctx->xfrcache_lock);
+		return;
+	}
+
+	entry = isc_mem_get(xfr->mctx, sizeof(*entry));
+	*entry = (ns_xfrcache_t){
+		.references = ISC_REFCOUNT_INITIALIZER(1),
+		.serial = xfr->end_serial,
+		.reserved = reserved,
+		.msgsize = sctx->transfer_tcp_message_size,
+		.first = xfr->firstcount,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_mem_attach(xfr->mctx, &entry->mctx);
+	dns_db_attach(xfr->db, &entry->db);
+	ISC_LIST_PREPEND(sctx->xfrcache, entry, link);
+	ns_xfrcache_attach(entry, &xfr->building);
+
+	/* Make room by dropping the least recently used transfers */
+	for (entry = ISC_LIST_HEAD(sctx->xfrcache); entry != NULL;) {
+		ns_xfrcache_t *next = ISC_LIST_NEXT(entry, link);
+		if (++count > XFROUT_CACHE_ENTRIES) {
+			xfrcache_unlink(sctx, entry);
+		}
+		entry = next;
+	}
+	UNLOCK(&sctx->xfrcache_lock);
+}
+
+/*
+ * Stop recording the transfer; if 'publish' is true the recording
+ * is complete and can be used by other transfers, otherwise it is
+ * thrown away.
+ */
+static void
+xfrout_cache_finish(xfrout_ctx_t *xfr, bool publish) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	ns_xfrcache_t *building = xfr->building;
+	ns_xfrcache_t *entry = NULL, *next = NULL;
+
+	LOCK(&sctx->xfrcache_lock);
+	if (!publish) {
+		xfrcache_unlink(sctx, building);
+	} else if (ISC_LINK_LINKED(building, link)) {
+		building->complete = true;
+
+		/* Older versions of the zone will not be asked for again */
+		for (entry = ISC_LIST_HEAD(sctx->xfrcache); entry != NULL;
+		     entry = next)
+		{
+			next = ISC_LIST_NEXT(entry, link);
+			if (entry != building &&
+			    dns_db_class(entry->db) == dns_db_class(xfr->db) &&
+			    dns_name_equal(dns_db_origin(entry->db),
+					   dns_db_origin(xfr->db)) &&
+			    isc_serial_lt(entry->serial, building->serial))
+			{
+				xfrcache_unlink(sctx, entry);
+			}
+		}
+	}
+	UNLOCK(&sctx->xfrcache_lock);
+
+	ns_xfrcache_detach(&xfr->building);
+}
+
+/*
+ * Record the answer section of a message that has just been rendered
+ * into xfr->txbuf; 'answerend' is where the answer section ended.
+ */
+static void
+xfrout_cache_add(xfrout_ctx_t *xfr, dns_message_t *msg,
+		 unsigned int answerend) {
+	ns_xfrcache_t *entry = xfr->building;
+	xfrout_chunk_t *chunk = NULL;
+	unsigned int length = answerend - DNS_MESSAGE_HEADERLEN;
+
+	INSIST(msg->tcp_continuation);
+
+	if (entry->size + length > XFROUT_CACHE_MAXBYTES) {
+		xfrout_log(xfr, ISC_LOG_DEBUG(3),
+			   "transfer too large to be cached");
+		xfrout_cache_finish(xfr, false);
+		return;
+	}
+
+	if (entry->nchunks == entry->nalloc) {
+		unsigned int nalloc = ISC_MAX(64, entry->nalloc * 2);
+		entry->chunks = isc_mem_creget(entry->mctx, entry->chunks,
+					       entry->nalloc, nalloc,
+					       sizeof(entry->chunks[0]));
+		entry->nalloc = nalloc;
+	}
+
+	chunk = &entry->chunks[entry->nchunks++];
+	*chunk = (xfrout_chunk_t){
+		.data = isc_mem_get(entry->mctx, length),
+		.length = length,
+		.count = msg->counts[DNS_SECTION_ANSWER],
+	};
+	memmove(chunk->data,
+		(unsigned char *)isc_buffer_base(&xfr->txbuf) +
+			DNS_MESSAGE_HEADERLEN,
+		length);
+	entry->size += length;
+
+	if (xfr->end_of_stream) {
+		xfrout_cache_finish(xfr, true);
+	}
+}
+
+/*
+ * Render the next cached answer section into 'msg'.
+ */
+static isc_result_t
+xfrout_rendercached(xfrout_ctx_t *xfr, dns_message_t *msg) {
+	xfrout_chunk_t *chunk = &xfr->cache->chunks[xfr->cachenext];
+	isc_region_t r = { .base = chunk->data, .length = chunk->length };
+	dns_compress_t cctx;
+	isc_result_t result;
+
+	dns_compress_init(&cctx, xfr->mctx,
+			  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
+	result = dns_message_renderbegin(msg, &cctx, &xfr->txbuf);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_renderraw(msg, DNS_SECTION_ANSWER, &r,
+					       chunk->count);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_renderend(msg);
+	}
+	dns_compress_invalidate(&cctx);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	xfr->stats.nrecs += chunk->count;
+	if (++xfr->cachenext == xfr->cache->nchunks) {
+		xfr->end_of_stream = true;
+	}
+
+	xfrout_log(xfr, ISC_LOG_DEBUG(8),
+		   "sending cached TCP message of %d bytes",
+		   isc_buffer_usedlength(&xfr->txbuf));
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Arrange to send as much as we can of "stream" without blocking.
  *
@@ -1379,6 +1660,8 @@ sendstream(xfrout_ctx_t *xfr) {
 	dns_compress_t cctx;
 	bool cleanup_cctx = false;
 	bool is_tcp;
+	bool first = false;
+	unsigned int answerend;
 	int n_rrs;
 
 	isc_buffer_clear(&xfr->buf);
@@ -1474,12 +1757,25 @@ sendstream(xfrout_ctx_t *xfr) {
 
 			dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
 			xfr->question_added = true;
+			first = true;
 		} else {
 			/*
 			 * Reserve space for the 12-byte message header
 			 */
 			isc_buffer_add(&xfr->buf, 12);
 			msg->tcp_continuation = 1;
+
+			if (!xfr->cachechecked) {
+				xfrout_cache_start(xfr, msg->reserved);
+			}
+		}
+
+		if (xfr->cache != NULL) {
+			CHECK(xfrout_rendercached(xfr, msg));
+			xfrout_enqueue_send(xfr);
+			CHECK(dns_message_getquerytsig(msg, xfr->mctx,
+						       &xfr->lasttsig));
+			goto failure;
 		}
 	}
 
@@ -1602,10 +1898,17 @@ sendstream(xfrout_ctx_t *xfr) {
 		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+		answerend = isc_buffer_usedlength(&xfr->txbuf);
 		CHECK(dns_message_renderend(msg));
 		dns_compress_invalidate(&cctx);
 		cleanup_cctx = false;
 
+		if (first) {
+			xfr->firstcount = msg->counts[DNS_SECTION_ANSWER];
+		} else if (xfr->building != NULL) {
+			xfrout_cache_add(xfr, msg, answerend);
+		}
+
 		xfrout_log(xfr, ISC_LOG_DEBUG(8),
 			   "sending TCP message of %d bytes",
 			   isc_buffer_usedlength(&xfr->txbuf));
@@ -1649,6 +1952,13 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 
 	INSIST(xfr->sends == 0);
 
+	if (xfr->building != NULL) {
+		xfrout_cache_finish(xfr, false);
+	}
+	if (xfr->cache != NULL) {
+		ns_xfrcache_detach(&xfr->cache);
+	}
+
 	isc_nm_timer_stop(xfr->delayed_send_timer);
 	isc_nm_timer_detach(&xfr->delayed_send_timer);
 
@@ -64,39 +64,62 @@ main(void) {
 		CHECKRESULT(result, line);
 	}
 
+	static const struct {
+		const char *label;
+		dns_compress_flags_t flags;
+	} modes[] = {
+		{ "case-insensitive", 0 },
+		{ "case-sensitive", DNS_COMPRESS_CASE },
+		{ "large", DNS_COMPRESS_LARGE },
+		{ "large case-sensitive", DNS_COMPRESS_LARGE | DNS_COMPRESS_CASE },
+	};
+
 	unsigned int repeat = 100;
 
-	isc_time_t start;
-	start = isc_time_now_hires();
-
-	for (unsigned int n = 0; n < repeat; n++) {
-		static uint8_t wire[4 * 1024];
-		dns_compress_t cctx;
-
-		isc_buffer_init(&buf, wire, sizeof(wire));
-		dns_compress_init(&cctx, mctx, 0);
-
-		for (unsigned int i = 0; i < count; i++) {
-			dns_name_t *name = dns_fixedname_name(&fixedname[i]);
-			result = dns_name_towire(name, &cctx, &buf, NULL);
-			if (result == ISC_R_NOSPACE) {
-				dns_compress_invalidate(&cctx);
-				dns_compress_init(&cctx, mctx, 0);
-				isc_buffer_init(&buf, wire, sizeof(wire));
-			} else {
-				CHECKRESULT(result, "dns_name_towire");
+	printf("names %u\n", count);
+
+	for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+		size_t bytes = 0;
+
+		isc_time_t start;
+		start = isc_time_now_hires();
+
+		for (unsigned int n = 0; n < repeat; n++) {
+			static uint8_t wire[4 * 1024];
+			dns_compress_t cctx;
+
+			isc_buffer_init(&buf, wire, sizeof(wire));
+			dns_compress_init(&cctx, mctx, modes[m].flags);
+
+			for (unsigned int i = 0; i < count; i++) {
+				dns_name_t *name =
+					dns_fixedname_name(&fixedname[i]);
+				result = dns_name_towire(name, &cctx, &buf,
+							 NULL);
+				if (result == ISC_R_NOSPACE) {
+					bytes += isc_buffer_usedlength(&buf);
+					dns_compress_invalidate(&cctx);
+					dns_compress_init(&cctx, mctx,
+							  modes[m].flags);
+					isc_buffer_init(&buf, wire,
+							sizeof(wire));
+				} else {
+					CHECKRESULT(result, "dns_name_towire");
+				}
 			}
+			bytes += isc_buffer_usedlength(&buf);
+			dns_compress_invalidate(&cctx);
 		}
-		dns_compress_invalidate(&cctx);
-	}
 
-	isc_time_t finish;
-	finish = isc_time_now_hires();
+		isc_time_t finish;
+		finish = isc_time_now_hires();
 
-	uint64_t microseconds = isc_time_microdiff(&finish, &start);
-	printf("time %f / %u\n", (double)microseconds / 1000000.0, repeat);
-
-	printf("names %u\n", count);
+		uint64_t microseconds = isc_time_microdiff(&finish, &start);
+		printf("%s: time %f / %u; %f names/us; %zu bytes\n",
+		       modes[m].label, (double)microseconds / 1000000.0,
+		       repeat, (double)count * repeat / microseconds,
+		       bytes / repeat);
+	}
 
 	isc_mem_destroy(&mctx);
 
@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Drive a cache or zone database from every loop at once with a mix of
+ * reads and writes, and report the throughput and the latency
+ * percentiles of each.
+ *
+ * For a cache (the default), a read is dns_db_find() and a write adds
+ * an A rdataset with dns_db_addrdataset().  The clock advances by one
+ * second every TICK operations of each loop, so entries expire once
+ * their TTL has gone by, and with -m the cache is given a memory limit
+ * so that it has to evict entries as well.
+ *
+ * For a zone (-z), a read is dns_db_findext() in the current version
+ * and a write is a whole update: open a new version, replace an A
+ * rdataset and commit.  Updates are serialized, as they are in named.
+ *
+ * With -d, another registered database implementation is used instead
+ * of "qpcache" or "qpzone", so that cache implementations can be
+ * compared under the same load (see tests/dns/cachedb_test.c for the
+ * matching conformance tests).
+ *
+ * Usage: dbmix [-z] [-d dbtype] [-m megabytes] [-n names]
+ *              [-o operations] [-t ttl] [-w percent]
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#define TICK	 1000 /* operations per second of simulated time */
+#define SAMPLING 16   /* time one operation in SAMPLING */
+
+typedef struct sample {
+	uint64_t *ns;
+	size_t count;
+	size_t size;
+} sample_t;
+
+typedef struct worker {
+	uint64_t reads;
+	uint64_t hits;
+	uint64_t writes;
+	sample_t readlat;
+	sample_t writelat;
+} worker_t;
+
+static bool zone = false;
+static const char *dbtype = NULL;
+static size_t maxmem = 0;
+static uint32_t nnames = 100000;
+static uint64_t operations = 1000000;
+static dns_ttl_t ttl = 300;
+static uint32_t writepct = 10;
+
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_mem_t *mctx = NULL;
+static isc_mem_t *dbmctx = NULL;
+static dns_db_t *db = NULL;
+static dns_fixedname_t *names = NULL;
+static worker_t *workers = NULL;
+static isc_mutex_t updatelock;
+static isc_stdtime_t start_time;
+
+static atomic_uint_fast32_t running;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+addsample(sample_t *sample, uint64_t ns) {
+	if (sample->count == sample->size) {
+		size_t size = ISC_MAX(1024, sample->size * 2);
+		sample->ns = isc_mem_creget(mctx, sample->ns, sample->size,
+					    size, sizeof(sample->ns[0]));
+		sample->size = size;
+	}
+	sample->ns[sample->count++] = ns;
+}
+
+static int
+compare_ns(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Merge the samples of all the workers and print their percentiles.
+ */
+static void
+percentiles(const char *what, size_t offset) {
+	static const double points[] = { 50, 90, 99, 99.9 };
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t *all = NULL;
+	size_t count = 0, n = 0;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		count += ((sample_t *)((char *)&workers[i] + offset))->count;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	all = isc_mem_cget(mctx, count, sizeof(all[0]));
+	for (uint32_t i = 0; i < nloops; i++) {
+		sample_t *sample = (sample_t *)((char *)&workers[i] + offset);
+		memmove(all + n, sample->ns, sample->count * sizeof(all[0]));
+		n += sample->count;
+	}
+	qsort(all, count, sizeof(all[0]), compare_ns);
+
+	printf("%-6s latency:", what);
+	for (size_t i = 0; i < ARRAY_SIZE(points); i++) {
+		size_t at = (size_t)(points[i] / 100 * (count - 1));
+		printf(" p%g %.2f us", points[i], all[at] / 1000.0);
+	}
+	printf("\n");
+
+	isc_mem_cput(mctx, all, count, sizeof(all[0]));
+}
+
+static void
+makerdataset(dns_rdata_t *rdata, unsigned char *address,
+	     dns_rdatalist_t *rdatalist, dns_rdataset_t *rdataset) {
+	rdata->data = address;
+	rdata->length = 4;
+	rdata->rdclass = dns_rdataclass_in;
+	rdata->type = dns_rdatatype_a;
+
+	dns_rdatalist_init(rdatalist);
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->type = dns_rdatatype_a;
+	rdatalist->ttl = ttl;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+
+	dns_rdataset_init(rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+}
+
+static void
+write_name(uint32_t i, isc_stdtime_t now) {
+	unsigned char address[4] = { 192, 0, 2, (unsigned char)i };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbversion_t *version = NULL;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	makerdataset(&rdata, address, &rdatalist, &rdataset);
+
+	if (zone) {
+		LOCK(&updatelock);
+		result = dns_db_newversion(db, &version);
+		CHECKRESULT(result, "dns_db_newversion");
+	}
+
+	result = dns_db_findnode(db, dns_fixedname_name(&names[i]), true,
+				 &node);
+	CHECKRESULT(result, "dns_db_findnode");
+	result = dns_db_addrdataset(db, node, version, now, &rdataset, 0,
+				    NULL);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+	CHECKRESULT(result, "dns_db_addrdataset");
+	dns_db_detachnode(db, &node);
+
+	if (zone) {
+		dns_db_closeversion(db, &version, true);
+		UNLOCK(&updatelock);
+	}
+}
+
+static bool
+read_name(uint32_t i, isc_stdtime_t now) {
+	dns_fixedname_t ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findext(db, dns_fixedname_name(&names[i]), NULL,
+				dns_rdatatype_a, 0, now, NULL, foundname, NULL,
+				NULL, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	return (result == ISC_R_SUCCESS);
+}
+
+static void
+populate(void) {
+	dns_dbversion_t *version = NULL;
+	isc_result_t result;
+
+	if (zone) {
+		result = dns_db_newversion(db, &version);
+		CHECKRESULT(result, "dns_db_newversion");
+	}
+
+	for (uint32_t i = 0; i < nnames; i++) {
+		unsigned char address[4] = { 192, 0, 2, (unsigned char)i };
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+
+		makerdataset(&rdata, address, &rdatalist, &rdataset);
+		result = dns_db_findnode(db, dns_fixedname_name(&names[i]),
+					 true, &node);
+		CHECKRESULT(result, "dns_db_findnode");
+		result = dns_db_addrdataset(db, node, version, start_time,
+					    &rdataset, 0, NULL);
+		CHECKRESULT(result, "dns_db_addrdataset");
+		dns_db_detachnode(db, &node);
+	}
+
+	if (zone) {
+		dns_db_closeversion(db, &version, true);
+	}
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t reads = 0, hits = 0, writes = 0;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		reads += workers[i].reads;
+		hits += workers[i].hits;
+		writes += workers[i].writes;
+	}
+
+	printf("%s, %u loops, %u names, ttl %u, %u%% writes", dbtype, nloops,
+	       nnames, ttl, writepct);
+	if (maxmem != 0) {
+		printf(", %zu MB", maxmem >> 20);
+	}
+	printf("\n");
+	printf("%" PRIu64 " reads (%" PRIu64 " found), %" PRIu64 " writes\n",
+	       reads, hits, writes);
+	printf("%f s; %f reads/us; %f writes/us; %f ops/us/loop\n",
+	       us / 1000000.0, reads / us, writes / us,
+	       (reads + writes) / us / nloops);
+	percentiles("read", offsetof(worker_t, readlat));
+	percentiles("write", offsetof(worker_t, writelat));
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		sample_t *samples[] = { &workers[i].readlat,
+					&workers[i].writelat };
+		for (size_t j = 0; j < ARRAY_SIZE(samples); j++) {
+			if (samples[j]->ns != NULL) {
+				isc_mem_cput(mctx, samples[j]->ns,
+					     samples[j]->size,
+					     sizeof(samples[j]->ns[0]));
+			}
+		}
+	}
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+run(void *arg) {
+	worker_t *worker = arg;
+
+	for (uint64_t op = 0; op < operations; op++) {
+		isc_stdtime_t now = start_time + op / TICK;
+		uint32_t i = isc_random_uniform(nnames);
+		bool write = isc_random_uniform(100) < writepct;
+		bool timed = (op % SAMPLING) == 0;
+		uint64_t before = 0;
+
+		if (timed) {
+			before = isc_time_monotonic();
+		}
+
+		if (write) {
+			write_name(i, now);
+			worker->writes++;
+		} else {
+			worker->hits += read_name(i, now) ? 1 : 0;
+			worker->reads++;
+		}
+
+		if (timed) {
+			addsample(write ? &worker->writelat : &worker->readlat,
+				  isc_time_monotonic() - before);
+		}
+	}
+
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	dns_fixedname_t forigin;
+	const dns_name_t *origin = dns_rootname;
+	char *argv[1] = { (char *)dbmctx };
+	isc_result_t result;
+
+	if (zone) {
+		dns_name_t *name = dns_fixedname_initname(&forigin);
+		result = dns_name_fromstring(name, "example.", dns_rootname, 0,
+					     NULL);
+		CHECKRESULT(result, "dns_name_fromstring");
+		origin = name;
+	}
+
+	/* Cache implementations get a heap memory context in argv[0]. */
+	result = dns_db_create(dbmctx, dbtype, origin,
+			       zone ? dns_dbtype_zone : dns_dbtype_cache,
+			       dns_rdataclass_in, zone ? 0 : 1, argv, &db);
+	CHECKRESULT(result, "dns_db_create");
+
+	start_time = isc_stdtime_now();
+	populate();
+
+	if (maxmem != 0) {
+		isc_mem_setwater(dbmctx, maxmem, maxmem - (maxmem >> 3));
+	}
+
+	atomic_init(&running, nloops);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), run, &workers[i]);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: dbmix [-z] [-d dbtype] [-m megabytes] "
+			"[-n names] [-o operations] [-t ttl] [-w percent]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	uint32_t nloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+	int ch;
+
+	while ((ch = getopt(argc, argv, "d:m:n:o:t:w:z")) != -1) {
+		switch (ch) {
+		case 'd':
+			dbtype = optarg;
+			break;
+		case 'm':
+			maxmem = strtoull(optarg, NULL, 10) << 20;
+			break;
+		case 'n':
+			nnames = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			operations = strtoull(optarg, NULL, 10);
+			break;
+		case 't':
+			ttl = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			writepct = strtoul(optarg, NULL, 10);
+			break;
+		case 'z':
+			zone = true;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || nnames == 0 || writepct > 100 ||
+	    (zone && maxmem != 0))
+	{
+		usage();
+	}
+	if (dbtype == NULL) {
+		dbtype = zone ? "qpzone" : "qpcache";
+	}
+
+	if (env_workers != NULL) {
+		nloops = atoi(env_workers);
+	} else {
+		nloops = isc_os_ncpus();
+	}
+	INSIST(nloops > 0);
+
+	isc_mem_create(&mctx);
+	isc_mem_create(&dbmctx);
+	isc_mutex_init(&updatelock);
+
+	names = isc_mem_cget(mctx, nnames, sizeof(names[0]));
+	for (uint32_t i = 0; i < nnames; i++) {
+		char text[64];
+		dns_name_t *name = dns_fixedname_initname(&names[i]);
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		result = dns_name_fromstring(name, text, dns_rootname, 0,
+					     NULL);
+		CHECKRESULT(result, "dns_name_fromstring");
+	}
+	workers = isc_mem_cget(mctx, nloops, sizeof(workers[0]));
+
+	isc_loopmgr_create(mctx, nloops, &loopmgr);
+	isc_loop_setup(isc_loop_main(loopmgr), startup, NULL);
+	isc_loopmgr_run(loopmgr);
+	isc_loopmgr_destroy(&loopmgr);
+
+	isc_mem_cput(mctx, workers, nloops, sizeof(workers[0]));
+	isc_mem_cput(mctx, names, nnames, sizeof(names[0]));
+	isc_mutex_destroy(&updatelock);
+	isc_mem_destroy(&dbmctx);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -13,19 +13,23 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/ascii.h>
 #include <isc/buffer.h>
 #include <isc/random.h>
+#include <isc/refcount.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
 #include <dns/fixedname.h>
 #include <dns/name.h>
+#include <dns/qp.h>
 
 #include "old.h"
+#include "qp_p.h"
 
 static uint32_t
 old_bench(const uint8_t *data, size_t size) {
@@ -94,6 +98,118 @@ oldnew_bench(const uint8_t *data, size_t size) {
 #define NAMES 1000
 static uint8_t buf[1024 * NAMES];
 
+/*
+ * Decoded copies of the benchmark names, for comparing the vectorized
+ * case folding and key building against byte-at-a-time versions.
+ */
+#define ROUNDS 100
+static uint8_t upper[NAMES][DNS_NAME_MAXWIRE];
+static dns_fixedname_t fixed[NAMES];
+
+static bool
+scalar_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
+	while (len-- > 0) {
+		if (isc_ascii_tolower(*a++) != isc_ascii_tolower(*b++)) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static size_t
+scalar_qpkey(dns_qpkey_t key, const dns_name_t *name) {
+	size_t len = 0, label = name->labels;
+	while (label-- > 0) {
+		const uint8_t *ldata = name->ndata + name->offsets[label];
+		size_t label_len = *ldata++;
+		while (label_len-- > 0) {
+			uint16_t bits = dns_qp_bits_for_byte[*ldata++];
+			key[len++] = bits & 0xFF;
+			if ((bits >> 8) != 0) {
+				key[len++] = bits >> 8;
+			}
+		}
+		key[len++] = SHIFT_NOBYTE;
+	}
+	key[len] = SHIFT_NOBYTE;
+	return (len);
+}
+
+static void
+fold_bench(const uint8_t *data, size_t size) {
+	isc_buffer_t source;
+	unsigned int count = 0;
+
+	isc_buffer_constinit(&source, data, size);
+	isc_buffer_add(&source, size);
+	isc_buffer_setactive(&source, size);
+
+	while (count < NAMES && isc_buffer_consumedlength(&source) < size) {
+		dns_name_t *name = dns_fixedname_initname(&fixed[count]);
+		isc_result_t result = dns_name_fromwire(
+			name, &source, DNS_DECOMPRESS_PERMITTED, NULL);
+		if (result != ISC_R_SUCCESS) {
+			isc_buffer_forward(&source, 1);
+			continue;
+		}
+		for (unsigned int i = 0; i < name->length; i++) {
+			upper[count][i] = isc_ascii_toupper(name->ndata[i]);
+		}
+		count++;
+	}
+
+	isc_time_t t0 = isc_time_now_hires();
+	unsigned int n1 = 0;
+	for (unsigned int r = 0; r < ROUNDS; r++) {
+		for (unsigned int i = 0; i < count; i++) {
+			dns_name_t *name = dns_fixedname_name(&fixed[i]);
+			n1 += scalar_lowerequal(name->ndata, upper[i],
+						name->length);
+		}
+	}
+	isc_time_t t1 = isc_time_now_hires();
+	unsigned int n2 = 0;
+	for (unsigned int r = 0; r < ROUNDS; r++) {
+		for (unsigned int i = 0; i < count; i++) {
+			dns_name_t *name = dns_fixedname_name(&fixed[i]);
+			n2 += isc_ascii_lowerequal(name->ndata, upper[i],
+						   name->length);
+		}
+	}
+	isc_time_t t2 = isc_time_now_hires();
+
+	double t01 = (double)isc_time_microdiff(&t1, &t0);
+	double t12 = (double)isc_time_microdiff(&t2, &t1);
+	printf("  lowerequal scalar %u / %f ms\n", n1, t01 / 1000.0);
+	printf("  lowerequal vector %u / %f ms\n", n2, t12 / 1000.0);
+	printf("  scalar/vector %f\n", t01 / t12);
+
+	dns_qpkey_t key1, key2;
+	size_t k1 = 0, k2 = 0;
+	t0 = isc_time_now_hires();
+	for (unsigned int r = 0; r < ROUNDS; r++) {
+		for (unsigned int i = 0; i < count; i++) {
+			k1 += scalar_qpkey(key1,
+					   dns_fixedname_name(&fixed[i]));
+		}
+	}
+	t1 = isc_time_now_hires();
+	for (unsigned int r = 0; r < ROUNDS; r++) {
+		for (unsigned int i = 0; i < count; i++) {
+			k2 += dns_qpkey_fromname(key2,
+						 dns_fixedname_name(&fixed[i]));
+		}
+	}
+	t2 = isc_time_now_hires();
+	INSIST(k1 == k2);
+
+	t01 = (double)isc_time_microdiff(&t1, &t0);
+	t12 = (double)isc_time_microdiff(&t2, &t1);
+	printf("  qpkey scalar %zu / %f ms\n", k1, t01 / 1000.0);
+	printf("  qpkey branch-free %zu / %f ms\n", k2, t12 / 1000.0);
+	printf("  scalar/branch-free %f\n", t01 / t12);
+}
+
 int
 main(void) {
 	unsigned int p;
@@ -129,6 +245,7 @@ main(void) {
 	}
 	printf("127 sequential labels\n");
 	oldnew_bench(buf, p);
+	fold_bench(buf, p);
 
 	p = 0;
 	for (unsigned int name = 0; name < NAMES; name++) {
@@ -142,4 +259,20 @@ main(void) {
 	}
 	printf("4 long sequential labels\n");
 	oldnew_bench(buf, p);
+	fold_bench(buf, p);
+
+	p = 0;
+	for (unsigned int name = 0; name < NAMES; name++) {
+		static const char *labels[] = { "www", "Example", "COM" };
+		for (unsigned int label = 0; label < 3; label++) {
+			size_t len = strlen(labels[label]);
+			buf[p++] = len;
+			memmove(buf + p, labels[label], len);
+			p += len;
+		}
+		buf[p++] = 0;
+	}
+	printf("3 short mixed-case labels\n");
+	oldnew_bench(buf, p);
+	fold_bench(buf, p);
 }
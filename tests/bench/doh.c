@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure DoH server throughput over plain HTTP/2, so that the run is
+ * dominated by the HTTP/2 layer rather than by TLS: every loop opens a
+ * single connection to an echo server on the loopback interface and
+ * keeps a number of streams in flight on it until all of its queries
+ * have been answered.
+ *
+ * Usage: doh [port]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include "netmgr/netmgr-int.h"
+
+#include <tests/isc.h>
+
+#define QUERIES	 (100 * 1000)
+#define INFLIGHT 32
+#define TIMEOUT	 (30 * 1000)
+
+#define DEFAULT_PORT 5380
+
+typedef struct bench_client {
+	uint64_t sent;
+	uint64_t received;
+	bool broken;
+	bool finished;
+} bench_client_t;
+
+/* example./IN/A */
+static uint8_t query[] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00,
+			   0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 'e',
+			   'x',	 'a',  'm',  'p',  'l',	 'e',  0x00,
+			   0x00, 0x01, 0x00, 0x01 };
+
+static isc_sockaddr_t addr;
+static char uri[256];
+static isc_nmsocket_t *listener = NULL;
+static bench_client_t *clients = NULL;
+
+static atomic_uint_fast32_t running;
+static atomic_uint_fast64_t failed;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t total = (uint64_t)nloops * QUERIES;
+
+	printf("%u loops, %" PRIu64 " queries, %" PRIu64 " failed\n", nloops,
+	       total, atomic_load_relaxed(&failed));
+	printf("%f s; %f queries/us; %f queries/us/loop\n", us / 1000000.0,
+	       total / us, total / us / nloops);
+
+	isc_mem_cput(mctx, clients, nloops, sizeof(clients[0]));
+
+	isc_nm_stoplistening(listener);
+	isc_nmsocket_close(&listener);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+client_done(bench_client_t *client) {
+	if (client->received < QUERIES || client->finished) {
+		return;
+	}
+
+	client->finished = true;
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+server_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	    isc_result_t eresult ISC_ATTR_UNUSED, void *arg ISC_ATTR_UNUSED) {
+	/* nothing to do */
+}
+
+static void
+server_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	    void *arg ISC_ATTR_UNUSED) {
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/* The query is a perfectly good answer for our purposes */
+	isc_nm_send(handle, region, server_sent, NULL);
+}
+
+static void client_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+			isc_region_t *region, void *arg);
+
+static void
+client_send(isc_nmhandle_t *handle, bench_client_t *client) {
+	client->sent++;
+
+	/*
+	 * On failure, client_recv() has already been called with the
+	 * error, so the result does not need to be checked here.
+	 */
+	(void)isc__nm_http_request(
+		handle,
+		&(isc_region_t){ .base = query, .length = sizeof(query) },
+		client_recv, client);
+}
+
+static void
+client_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	    isc_region_t *region ISC_ATTR_UNUSED, void *arg) {
+	bench_client_t *client = arg;
+
+	client->received++;
+
+	if (eresult != ISC_R_SUCCESS) {
+		atomic_fetch_add_relaxed(&failed, 1);
+		if (!client->broken) {
+			/* Give up on the queries that were not sent yet */
+			uint64_t unsent = QUERIES - client->sent;
+
+			client->broken = true;
+			client->sent = QUERIES;
+			client->received += unsent;
+			atomic_fetch_add_relaxed(&failed, unsent);
+		}
+	} else if (client->sent < QUERIES) {
+		client_send(handle, client);
+	}
+
+	client_done(client);
+}
+
+static void
+client_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	bench_client_t *client = arg;
+
+	if (eresult != ISC_R_SUCCESS) {
+		printf("isc_nm_httpconnect: %s\n", isc_result_totext(eresult));
+		client->broken = true;
+		client->sent = client->received = QUERIES;
+		atomic_fetch_add_relaxed(&failed, QUERIES);
+		client_done(client);
+		return;
+	}
+
+	for (unsigned int i = 0; i < INFLIGHT && client->sent < QUERIES; i++) {
+		client_send(handle, client);
+		if (client->broken) {
+			break;
+		}
+	}
+}
+
+static void
+client_start(void *arg) {
+	bench_client_t *client = arg;
+
+	isc_nm_httpconnect(netmgr, NULL, &addr, uri, true, client_connected,
+			   client, NULL, NULL, TIMEOUT, ISC_NM_PROXY_NONE,
+			   NULL);
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	isc_nm_http_endpoints_t *endpoints = NULL;
+	isc_result_t result;
+
+	endpoints = isc_nm_http_endpoints_new(mctx);
+	result = isc_nm_http_endpoints_add(endpoints, ISC_NM_HTTP_DEFAULT_PATH,
+					   server_recv, NULL);
+	CHECKRESULT(result, "isc_nm_http_endpoints_add");
+
+	result = isc_nm_listenhttp(netmgr, ISC_NM_LISTEN_ALL, &addr, 0, NULL,
+				   NULL, endpoints, 0, ISC_NM_PROXY_NONE,
+				   &listener);
+	CHECKRESULT(result, "isc_nm_listenhttp");
+	isc_nm_http_endpoints_detach(&endpoints);
+
+	isc_nm_http_makeuri(false, &addr, NULL, 0, ISC_NM_HTTP_DEFAULT_PATH,
+			    uri, sizeof(uri));
+
+	clients = isc_mem_cget(mctx, nloops, sizeof(clients[0]));
+
+	atomic_init(&running, nloops);
+	atomic_init(&failed, 0);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), client_start,
+			      &clients[i]);
+	}
+}
+
+int
+main(int argc, char **argv) {
+	struct in_addr in = { .s_addr = htonl(INADDR_LOOPBACK) };
+	in_port_t port = DEFAULT_PORT;
+
+	if (argc > 1) {
+		port = atoi(argv[1]);
+	}
+	isc_sockaddr_fromin(&addr, &in, port);
+
+	setup_mctx(NULL);
+	setup_loopmgr(NULL);
+	setup_netmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	teardown_netmgr(NULL);
+	teardown_loopmgr(NULL);
+	teardown_mctx(NULL);
+
+	return (0);
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how fast the resolver can create and join fetches when every
+ * loop is asking for names from the same pool, as happens during a
+ * random subdomain attack. Each fetch is cancelled as soon as it has
+ * been created, so the run is dominated by the fetch context table
+ * rather than by the network.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dispatch.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#define NAMES	4096
+#define FETCHES (64 * 1024)
+
+typedef struct bench_fetch {
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+} bench_fetch_t;
+
+static dns_view_t *view = NULL;
+static dns_dispatch_t *dispatch = NULL;
+static isc_tlsctx_cache_t *tlsctx_cache = NULL;
+static dns_resolver_t *resolver = NULL;
+
+static dns_fixedname_t fixed[NAMES];
+static dns_fixedname_t fdomain;
+static dns_rdata_t nsrdata = DNS_RDATA_INIT;
+static dns_rdatalist_t nslist;
+static dns_rdataset_t nameservers;
+
+static atomic_uint_fast64_t outstanding;
+static atomic_uint_fast64_t failed;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+mkname(dns_fixedname_t *fname, const char *text) {
+	isc_buffer_t buf;
+	isc_result_t result;
+
+	isc_buffer_constinit(&buf, text, strlen(text));
+	isc_buffer_add(&buf, strlen(text));
+	result = dns_name_fromtext(dns_fixedname_initname(fname), &buf,
+				   dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromtext");
+}
+
+static void
+populate(void) {
+	static unsigned char nsname[] = "\002ns\007example";
+
+	for (unsigned int i = 0; i < NAMES; i++) {
+		char text[64];
+
+		snprintf(text, sizeof(text), "r%u.example.", i);
+		mkname(&fixed[i], text);
+	}
+
+	/*
+	 * Give every fetch the same delegation, so that fetch creation
+	 * does not depend on root hints or the cache.
+	 */
+	mkname(&fdomain, "example.");
+
+	nsrdata.data = nsname;
+	nsrdata.length = sizeof(nsname);
+	nsrdata.rdclass = dns_rdataclass_in;
+	nsrdata.type = dns_rdatatype_ns;
+
+	dns_rdatalist_init(&nslist);
+	nslist.rdclass = dns_rdataclass_in;
+	nslist.type = dns_rdatatype_ns;
+	nslist.ttl = 3600;
+	ISC_LIST_APPEND(nslist.rdata, &nsrdata, link);
+
+	dns_rdataset_init(&nameservers);
+	dns_rdatalist_tordataset(&nslist, &nameservers);
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t total = (uint64_t)nloops * FETCHES;
+	isc_buffer_t *text = NULL;
+
+	printf("%u loops, %" PRIu64 " fetches, %" PRIu64 " failed\n", nloops,
+	       total, atomic_load_relaxed(&failed));
+	printf("%f s; %f fetches/us; %f fetches/us/loop\n", us / 1000000.0,
+	       total / us, total / us / nloops);
+
+	isc_buffer_allocate(mctx, &text, 1024);
+	CHECKRESULT(dns_resolver_dumpquota(resolver, &text),
+		    "dns_resolver_dumpquota");
+	printf("%.*s\n", (int)isc_buffer_usedlength(text),
+	       (char *)isc_buffer_base(text));
+	isc_buffer_free(&text);
+
+	dns_rdataset_disassociate(&nameservers);
+	dns_resolver_shutdown(resolver);
+	dns_resolver_detach(&resolver);
+	dns_dispatch_detach(&dispatch);
+	dns_view_detach(&view);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+fetch_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	bench_fetch_t *bf = resp->arg;
+	isc_mem_t *loop_mctx = isc_loop_getmctx(isc_loop());
+
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	if (dns_rdataset_isassociated(resp->rdataset)) {
+		dns_rdataset_disassociate(resp->rdataset);
+	}
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+
+	dns_resolver_destroyfetch(&bf->fetch);
+	isc_mem_put(loop_mctx, bf, sizeof(*bf));
+
+	if (atomic_fetch_sub_release(&outstanding, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+fetches(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+	isc_mem_t *loop_mctx = isc_loop_getmctx(loop);
+
+	for (unsigned int i = 0; i < FETCHES; i++) {
+		dns_name_t *name =
+			dns_fixedname_name(&fixed[isc_random_uniform(NAMES)]);
+		bench_fetch_t *bf = isc_mem_get(loop_mctx, sizeof(*bf));
+		isc_result_t result;
+
+		*bf = (bench_fetch_t){ 0 };
+		dns_rdataset_init(&bf->rdataset);
+
+		result = dns_resolver_createfetch(
+			resolver, name, dns_rdatatype_a,
+			dns_fixedname_name(&fdomain), &nameservers, NULL, NULL,
+			0, 0, 0, NULL, loop, fetch_done, bf, &bf->rdataset,
+			NULL, &bf->fetch);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(loop_mctx, bf, sizeof(*bf));
+			atomic_fetch_add_relaxed(&failed, 1);
+			if (atomic_fetch_sub_release(&outstanding, 1) == 1) {
+				isc_async_run(isc_loop_main(loopmgr), finish,
+					      NULL);
+			}
+			continue;
+		}
+
+		dns_resolver_cancelfetch(bf->fetch);
+	}
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	isc_sockaddr_t local;
+	isc_result_t result;
+
+	result = dns_test_makeview("bench", true, true, &view);
+	CHECKRESULT(result, "dns_test_makeview");
+
+	dispatchmgr = dns_view_getdispatchmgr(view);
+	isc_sockaddr_any(&local);
+	result = dns_dispatch_createudp(dispatchmgr, &local, &dispatch);
+	CHECKRESULT(result, "dns_dispatch_createudp");
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	isc_tlsctx_cache_create(mctx, &tlsctx_cache);
+	result = dns_resolver_create(view, loopmgr, netmgr, 0, tlsctx_cache,
+				     dispatch, NULL, &resolver);
+	CHECKRESULT(result, "dns_resolver_create");
+	dns_resolver_freeze(resolver);
+
+	populate();
+
+	atomic_init(&outstanding, (uint64_t)nloops * FETCHES);
+	atomic_init(&failed, 0);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), fetches, NULL);
+	}
+}
+
+int
+main(void) {
+	setup_mctx(NULL);
+	setup_loopmgr(NULL);
+	setup_netmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	teardown_netmgr(NULL);
+	teardown_loopmgr(NULL);
+	teardown_mctx(NULL);
+
+	return (0);
+}
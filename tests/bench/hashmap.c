@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the Robin Hood and the group-probed (ISC_HASHMAP_GROUPED)
+ * hashmaps: insert, successful and failed lookups, and delete, with
+ * the table filled to various load factors of its initial size.
+ *
+ * Usage: hashmap [-b bits] [-n lookups]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+static uint8_t bits = 20;
+static size_t lookups = 10000000;
+
+static isc_mem_t *mctx = NULL;
+
+typedef struct item {
+	uint32_t hashval;
+	uint64_t key;
+} item_t;
+
+static bool
+item_match(void *node, const void *key) {
+	const item_t *item = node;
+
+	return (item->key == *(const uint64_t *)key);
+}
+
+static double
+rate(size_t count, isc_time_t *t0, isc_time_t *t1) {
+	uint64_t us = isc_time_microdiff(t1, t0);
+
+	return (us == 0 ? 0.0 : (double)count / us);
+}
+
+static void
+bench(const char *name, unsigned int options, item_t *items, size_t count) {
+	isc_hashmap_t *hashmap = NULL;
+	isc_time_t t0, t1;
+	double add, hit, miss, del;
+	size_t found = 0;
+	isc_result_t result;
+
+	isc_hashmap_create_ex(mctx, bits, options, &hashmap);
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, items[i].hashval, item_match,
+					 &items[i].key, &items[i], NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	t1 = isc_time_now_hires();
+	add = rate(count, &t0, &t1);
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < lookups; i++) {
+		item_t *item = &items[i % count];
+
+		if (isc_hashmap_find(hashmap, item->hashval, item_match,
+				     &item->key, NULL) == ISC_R_SUCCESS)
+		{
+			found++;
+		}
+	}
+	t1 = isc_time_now_hires();
+	hit = rate(lookups, &t0, &t1);
+
+	/* The items past 'count' were never added */
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < lookups; i++) {
+		item_t *item = &items[count + i % count];
+
+		if (isc_hashmap_find(hashmap, item->hashval, item_match,
+				     &item->key, NULL) == ISC_R_SUCCESS)
+		{
+			found++;
+		}
+	}
+	t1 = isc_time_now_hires();
+	miss = rate(lookups, &t0, &t1);
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_delete(hashmap, items[i].hashval,
+					    item_match, &items[i].key);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	t1 = isc_time_now_hires();
+	del = rate(count, &t0, &t1);
+
+	RUNTIME_CHECK(found == lookups);
+
+	isc_hashmap_destroy(&hashmap);
+
+	printf("%-8s %9zu items, %8.2f add/us, %8.2f hit/us, %8.2f miss/us, "
+	       "%8.2f del/us\n",
+	       name, count, add, hit, miss, del);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: hashmap [-b bits] [-n lookups]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	static const unsigned int loads[] = { 25, 50, 75, 85, 90 };
+	size_t size, nitems;
+	item_t *items = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "b:n:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bits = atoi(optarg);
+			break;
+		case 'n':
+			lookups = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || bits < 4 || bits > 28 || lookups == 0) {
+		usage();
+	}
+
+	isc_mem_create(&mctx);
+
+	size = (size_t)1 << bits;
+	nitems = 2 * size;
+	items = isc_mem_cget(mctx, nitems, sizeof(items[0]));
+	for (size_t i = 0; i < nitems; i++) {
+		items[i].key = isc_random32() | ((uint64_t)i << 32);
+		items[i].hashval = isc_hash32(&items[i].key,
+					      sizeof(items[i].key), true);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(loads); i++) {
+		size_t count = size * loads[i] / 100;
+
+		printf("load factor %u%% of %zu slots\n", loads[i], size);
+		bench("robin", 0, items, count);
+		bench("grouped", ISC_HASHMAP_GROUPED, items, count);
+	}
+
+	isc_mem_cput(mctx, items, nitems, sizeof(items[0]));
+	isc_mem_detach(&mctx);
+
+	return (0);
+}
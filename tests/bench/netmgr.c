@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the request-response throughput of the network manager on its
+ * own, without any DNS processing: an echo server listens with the
+ * chosen transport, and every loop runs a number of client sessions
+ * against it, each of them keeping one query in flight until the loop
+ * has sent its share of the queries.
+ *
+ * The transports are UDP, DNS over TCP and DNS over TLS (both with
+ * the streamdns layer), and DNS over HTTP/2 without TLS.  The number of
+ * loops is taken from ISC_TASK_WORKERS, and the address can be set so
+ * that the traffic goes through another interface than the loopback,
+ * for instance one end of a veth pair.
+ *
+ * As the client and the server run in the same process, the CPU time
+ * and the context switches that are reported cover both ends.
+ *
+ * Usage: netmgr [-t udp|tcp|tls|doh] [-a address] [-p port]
+ *               [-c sessions] [-q queries]
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include "netmgr/netmgr-int.h"
+
+#include <tests/isc.h>
+
+#define TIMEOUT	    (10 * 1000)
+#define UDP_TIMEOUT 1000
+
+#define DEFAULT_PORT 5300
+
+typedef enum { UDP, TCP, TLS, DOH } transport_t;
+
+static const char *transports[] = { "udp", "tcp", "tls", "doh" };
+
+typedef struct worker {
+	uint64_t sent;
+	uint64_t received;
+	uint64_t lost;
+	uint64_t failed;
+	unsigned int active;
+	uint64_t *latency;
+	size_t nlatency;
+	size_t maxlatency;
+} worker_t;
+
+typedef struct session {
+	worker_t *worker;
+	isc_nmhandle_t *handle;
+	uint64_t start;
+} session_t;
+
+/* example./IN/A */
+static uint8_t query[] = { 0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00,
+			   0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 'e',
+			   'x',	 'a',  'm',  'p',  'l',	 'e',  0x00,
+			   0x00, 0x01, 0x00, 0x01 };
+
+static transport_t transport = UDP;
+static unsigned int nsessions = 16;
+static uint64_t queries = 100000;
+
+static isc_sockaddr_t addr;
+static isc_tlsctx_t *server_tlsctx = NULL;
+static isc_tlsctx_t *client_tlsctx = NULL;
+static isc_nmsocket_t *listener = NULL;
+static worker_t *loopdata = NULL;
+static session_t *sessions = NULL;
+#if HAVE_LIBNGHTTP2
+static char uri[256];
+#endif /* HAVE_LIBNGHTTP2 */
+
+static atomic_uint_fast32_t running;
+static isc_time_t t0;
+static struct rusage ru0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int
+compare_ns(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Merge the latencies measured on all the loops and print their
+ * percentiles.
+ */
+static void
+percentiles(void) {
+	static const double points[] = { 50, 90, 99, 99.9 };
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t *all = NULL;
+	size_t count = 0, n = 0;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		count += loopdata[i].nlatency;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	all = isc_mem_cget(mctx, count, sizeof(all[0]));
+	for (uint32_t i = 0; i < nloops; i++) {
+		memmove(all + n, loopdata[i].latency,
+			loopdata[i].nlatency * sizeof(all[0]));
+		n += loopdata[i].nlatency;
+	}
+	qsort(all, count, sizeof(all[0]), compare_ns);
+
+	printf("latency:");
+	for (size_t i = 0; i < ARRAY_SIZE(points); i++) {
+		size_t at = (size_t)(points[i] / 100 * (count - 1));
+		printf(" p%g %.2f us", points[i], all[at] / 1000.0);
+	}
+	printf("\n");
+
+	isc_mem_cput(mctx, all, count, sizeof(all[0]));
+}
+
+static double
+tv_us(struct timeval *tv) {
+	return ((double)tv->tv_sec * 1000000.0 + tv->tv_usec);
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t sent = 0, received = 0, lost = 0, failed = 0;
+	double user, sys, csw;
+	struct rusage ru1;
+
+	getrusage(RUSAGE_SELF, &ru1);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		sent += loopdata[i].sent;
+		received += loopdata[i].received;
+		lost += loopdata[i].lost;
+		failed += loopdata[i].failed;
+	}
+
+	user = tv_us(&ru1.ru_utime) - tv_us(&ru0.ru_utime);
+	sys = tv_us(&ru1.ru_stime) - tv_us(&ru0.ru_stime);
+	csw = (double)(ru1.ru_nvcsw - ru0.ru_nvcsw) +
+	      (double)(ru1.ru_nivcsw - ru0.ru_nivcsw);
+
+	printf("%s, %u loops, %u sessions per loop\n", transports[transport],
+	       nloops, nsessions);
+	printf("%" PRIu64 " queries, %" PRIu64 " answered, %" PRIu64
+	       " lost, %" PRIu64 " failed\n",
+	       sent, received, lost, failed);
+	printf("%f s; %f queries/s; %f queries/s/loop\n", us / 1000000.0,
+	       received / us * 1000000.0, received / us * 1000000.0 / nloops);
+	if (received != 0) {
+		printf("%.2f us cpu/query (%.2f user, %.2f system); "
+		       "%.3f context switches/query\n",
+		       (user + sys) / received, user / received,
+		       sys / received, csw / received);
+	}
+	percentiles();
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		if (loopdata[i].latency != NULL) {
+			isc_mem_cput(mctx, loopdata[i].latency,
+				     loopdata[i].maxlatency,
+				     sizeof(loopdata[i].latency[0]));
+		}
+	}
+	isc_mem_cput(mctx, sessions, nloops * nsessions, sizeof(sessions[0]));
+	isc_mem_cput(mctx, loopdata, nloops, sizeof(loopdata[0]));
+
+	isc_nm_stoplistening(listener);
+	isc_nmsocket_close(&listener);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+addlatency(worker_t *worker, uint64_t ns) {
+	if (worker->nlatency == worker->maxlatency) {
+		size_t size = ISC_MAX(1024, worker->maxlatency * 2);
+		worker->latency = isc_mem_creget(mctx, worker->latency,
+						 worker->maxlatency, size,
+						 sizeof(worker->latency[0]));
+		worker->maxlatency = size;
+	}
+	worker->latency[worker->nlatency++] = ns;
+}
+
+static void
+session_done(session_t *session) {
+	worker_t *worker = session->worker;
+
+	if (session->handle != NULL) {
+		isc_nmhandle_detach(&session->handle);
+	}
+
+	INSIST(worker->active > 0);
+	if (--worker->active == 0 &&
+	    atomic_fetch_sub_release(&running, 1) == 1)
+	{
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+server_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	    isc_result_t eresult ISC_ATTR_UNUSED, void *arg ISC_ATTR_UNUSED) {
+	/* nothing to do */
+}
+
+static void
+server_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	    isc_region_t *region ISC_ATTR_UNUSED, void *arg ISC_ATTR_UNUSED) {
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/* Every query is the same, so it is a good enough answer */
+	isc_nm_send(handle,
+		    &(isc_region_t){ .base = query, .length = sizeof(query) },
+		    server_sent, NULL);
+}
+
+static isc_result_t
+server_accept(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t eresult,
+	      void *arg ISC_ATTR_UNUSED) {
+	return (eresult);
+}
+
+static void
+client_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	    isc_result_t eresult ISC_ATTR_UNUSED, void *arg ISC_ATTR_UNUSED) {
+	/* a failed send is reported by the read callback */
+}
+
+static void client_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+			isc_region_t *region, void *arg);
+
+static void
+client_send(session_t *session) {
+	isc_region_t region = { .base = query, .length = sizeof(query) };
+	worker_t *worker = session->worker;
+
+	if (worker->sent == queries) {
+		session_done(session);
+		return;
+	}
+
+	worker->sent++;
+	session->start = isc_time_monotonic();
+
+#if HAVE_LIBNGHTTP2
+	if (transport == DOH) {
+		/*
+		 * On failure, client_recv() has already been called with
+		 * the error, so the result does not need to be checked.
+		 */
+		(void)isc__nm_http_request(session->handle, &region,
+					   client_recv, session);
+		return;
+	}
+#endif /* HAVE_LIBNGHTTP2 */
+
+	isc_nm_read(session->handle, client_recv, session);
+	isc_nm_send(session->handle, &region, client_sent, session);
+}
+
+static void
+client_recv(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t eresult,
+	    isc_region_t *region, void *arg) {
+	session_t *session = arg;
+	worker_t *worker = session->worker;
+
+	switch (eresult) {
+	case ISC_R_SUCCESS:
+		if (region->length != sizeof(query)) {
+			worker->failed++;
+			session_done(session);
+			return;
+		}
+		worker->received++;
+		addlatency(worker, isc_time_monotonic() - session->start);
+		break;
+	case ISC_R_TIMEDOUT:
+		if (transport == UDP) {
+			/* the query or the answer was dropped */
+			worker->lost++;
+			break;
+		}
+		FALLTHROUGH;
+	default:
+		worker->failed++;
+		session_done(session);
+		return;
+	}
+
+	client_send(session);
+}
+
+static void
+client_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	session_t *session = arg;
+
+	if (eresult != ISC_R_SUCCESS) {
+		printf("connect: %s\n", isc_result_totext(eresult));
+		session->worker->failed++;
+		session_done(session);
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &session->handle);
+	if (transport == UDP) {
+		isc_nmhandle_settimeout(handle, UDP_TIMEOUT);
+	}
+
+	client_send(session);
+}
+
+static void
+client_start(void *arg) {
+	session_t *session = arg;
+
+	switch (transport) {
+	case UDP:
+		isc_nm_udpconnect(netmgr, NULL, &addr, client_connected,
+				  session, UDP_TIMEOUT);
+		break;
+	case TCP:
+	case TLS:
+		isc_nm_streamdnsconnect(netmgr, NULL, &addr, client_connected,
+					session, TIMEOUT, client_tlsctx, NULL,
+					ISC_NM_PROXY_NONE, NULL);
+		break;
+	case DOH:
+#if HAVE_LIBNGHTTP2
+		isc_nm_httpconnect(netmgr, NULL, &addr, uri, true,
+				   client_connected, session, NULL, NULL,
+				   TIMEOUT, ISC_NM_PROXY_NONE, NULL);
+#endif /* HAVE_LIBNGHTTP2 */
+		break;
+	}
+}
+
+static void
+server_listen(void) {
+	isc_result_t result = ISC_R_NOTIMPLEMENTED;
+
+	switch (transport) {
+	case UDP:
+		result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &addr,
+					  ISC_NM_UDP_RECVBATCH_DEFAULT,
+					  server_recv, NULL, &listener);
+		break;
+	case TLS:
+		result = isc_tlsctx_createserver(NULL, NULL, &server_tlsctx);
+		CHECKRESULT(result, "isc_tlsctx_createserver");
+		result = isc_tlsctx_createclient(&client_tlsctx);
+		CHECKRESULT(result, "isc_tlsctx_createclient");
+		FALLTHROUGH;
+	case TCP:
+		result = isc_nm_listenstreamdns(
+			netmgr, ISC_NM_LISTEN_ALL, &addr, server_recv, NULL,
+			server_accept, NULL, 128, NULL, server_tlsctx,
+			ISC_NM_PROXY_NONE, &listener);
+		break;
+	case DOH: {
+#if HAVE_LIBNGHTTP2
+		isc_nm_http_endpoints_t *endpoints =
+			isc_nm_http_endpoints_new(mctx);
+		result = isc_nm_http_endpoints_add(endpoints,
+						   ISC_NM_HTTP_DEFAULT_PATH,
+						   server_recv, NULL);
+		CHECKRESULT(result, "isc_nm_http_endpoints_add");
+		result = isc_nm_listenhttp(netmgr, ISC_NM_LISTEN_ALL, &addr,
+					   0, NULL, NULL, endpoints, 0,
+					   ISC_NM_PROXY_NONE, &listener);
+		isc_nm_http_endpoints_detach(&endpoints);
+		isc_nm_http_makeuri(false, &addr, NULL, 0,
+				    ISC_NM_HTTP_DEFAULT_PATH, uri, sizeof(uri));
+#endif /* HAVE_LIBNGHTTP2 */
+		break;
+	}
+	}
+	CHECKRESULT(result, "listen");
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	server_listen();
+
+	loopdata = isc_mem_cget(mctx, nloops, sizeof(loopdata[0]));
+	sessions = isc_mem_cget(mctx, nloops * nsessions, sizeof(sessions[0]));
+
+	atomic_init(&running, nloops);
+	t0 = isc_time_now_hires();
+	getrusage(RUSAGE_SELF, &ru0);
+	for (uint32_t i = 0; i < nloops; i++) {
+		loopdata[i].active = nsessions;
+		for (unsigned int j = 0; j < nsessions; j++) {
+			session_t *session = &sessions[i * nsessions + j];
+			session->worker = &loopdata[i];
+			isc_async_run(isc_loop_get(loopmgr, i), client_start,
+				      session);
+		}
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: netmgr [-t udp|tcp|tls|doh] [-a address] "
+			"[-p port] [-c sessions] [-q queries]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	const char *address = "127.0.0.1";
+	in_port_t port = DEFAULT_PORT;
+	struct in_addr in;
+	struct in6_addr in6;
+	size_t i;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "a:c:p:q:t:")) != -1) {
+		switch (ch) {
+		case 'a':
+			address = optarg;
+			break;
+		case 'c':
+			nsessions = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'q':
+			queries = strtoull(optarg, NULL, 10);
+			break;
+		case 't':
+			for (i = 0; i < ARRAY_SIZE(transports); i++) {
+				if (strcmp(optarg, transports[i]) == 0) {
+					break;
+				}
+			}
+			if (i == ARRAY_SIZE(transports)) {
+				usage();
+			}
+			transport = i;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || nsessions == 0) {
+		usage();
+	}
+#if !HAVE_LIBNGHTTP2
+	if (transport == DOH) {
+		fprintf(stderr, "netmgr: built without DNS over HTTP/2\n");
+		exit(EXIT_FAILURE);
+	}
+#endif /* !HAVE_LIBNGHTTP2 */
+
+	if (inet_pton(AF_INET, address, &in) == 1) {
+		isc_sockaddr_fromin(&addr, &in, port);
+	} else if (inet_pton(AF_INET6, address, &in6) == 1) {
+		isc_sockaddr_fromin6(&addr, &in6, port);
+	} else {
+		usage();
+	}
+
+	setup_mctx(NULL);
+	setup_loopmgr(NULL);
+	setup_netmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	if (client_tlsctx != NULL) {
+		isc_tlsctx_free(&client_tlsctx);
+	}
+	if (server_tlsctx != NULL) {
+		isc_tlsctx_free(&server_tlsctx);
+	}
+
+	teardown_netmgr(NULL);
+	teardown_loopmgr(NULL);
+	teardown_mctx(NULL);
+
+	return (0);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure cache lookup throughput when every loop is looking up the
+ * same few popular names, which is where contention on the node locks
+ * shows up. The clock is advanced during the run so that lookups also
+ * have to refresh the LRU timestamps of the entries they find.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#define NAMES	    16
+#define LOOKUPS	    (1024 * 1024)
+#define TTL	    (10 * 24 * 3600)
+#define TIME_STEP   1024 /* lookups per clock tick */
+#define TIME_ADVANCE 601 /* longer than the LRU update interval */
+
+static isc_loopmgr_t *loopmgr = NULL;
+static dns_db_t *db = NULL;
+static dns_fixedname_t fixed[NAMES];
+static isc_stdtime_t start_time;
+
+static atomic_uint_fast32_t running;
+static atomic_uint_fast64_t found;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+populate(void) {
+	static unsigned char address[4] = { 192, 0, 2, 1 };
+
+	for (unsigned int i = 0; i < NAMES; i++) {
+		char text[64];
+		isc_buffer_t buf;
+		dns_name_t *name = dns_fixedname_initname(&fixed[i]);
+		dns_dbnode_t *node = NULL;
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "popular%u.example.", i);
+		isc_buffer_constinit(&buf, text, strlen(text));
+		isc_buffer_add(&buf, strlen(text));
+		result = dns_name_fromtext(name, &buf, dns_rootname, 0, NULL);
+		CHECKRESULT(result, "dns_name_fromtext");
+
+		result = dns_db_findnode(db, name, true, &node);
+		CHECKRESULT(result, "dns_db_findnode");
+
+		rdata.data = address;
+		rdata.length = sizeof(address);
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_a;
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = TTL;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+		result = dns_db_addrdataset(db, node, NULL, start_time,
+					    &rdataset, 0, NULL);
+		CHECKRESULT(result, "dns_db_addrdataset");
+
+		dns_db_detachnode(db, &node);
+	}
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t total = (uint64_t)nloops * LOOKUPS;
+
+	printf("%u loops, %" PRIu64 " lookups, %" PRIu64 " found\n", nloops,
+	       total, atomic_load_relaxed(&found));
+	printf("%f s; %f lookups/us; %f lookups/us/loop\n", us / 1000000.0,
+	       total / us, total / us / nloops);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+lookups(void *arg ISC_ATTR_UNUSED) {
+	dns_fixedname_t ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	uint64_t hits = 0;
+
+	dns_rdataset_init(&rdataset);
+
+	for (unsigned int i = 0; i < LOOKUPS; i++) {
+		isc_stdtime_t now = start_time +
+				    (i / TIME_STEP) * TIME_ADVANCE;
+		isc_result_t result = dns_db_find(
+			db, dns_fixedname_name(&fixed[i % NAMES]), NULL,
+			dns_rdatatype_a, 0, now, NULL, foundname, &rdataset,
+			NULL);
+		if (result == ISC_R_SUCCESS) {
+			hits++;
+		}
+		if (dns_rdataset_isassociated(&rdataset)) {
+			dns_rdataset_disassociate(&rdataset);
+		}
+	}
+
+	atomic_fetch_add_relaxed(&found, hits);
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+	isc_mem_t *mctx = isc_loop_getmctx(loop);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "qpcache", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+
+	start_time = isc_stdtime_now();
+	populate();
+
+	atomic_init(&running, nloops);
+	atomic_init(&found, 0);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), lookups, NULL);
+	}
+}
+
+int
+main(void) {
+	isc_mem_t *mctx = NULL;
+	uint32_t nloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+
+	if (env_workers != NULL) {
+		nloops = atoi(env_workers);
+	} else {
+		nloops = isc_os_ncpus();
+	}
+	INSIST(nloops > 0);
+
+	isc_mem_create(&mctx);
+	isc_loopmgr_create(mctx, nloops, &loopmgr);
+	isc_loop_setup(isc_loop_main(loopmgr), startup, NULL);
+	isc_loopmgr_run(loopmgr);
+	isc_loopmgr_destroy(&loopmgr);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -14,9 +14,14 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 #include <isc/commandline.h>
 #include <isc/file.h>
 #include <isc/ht.h>
+#include <isc/os.h>
 #include <isc/rwlock.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -195,6 +200,116 @@ load_qp(dns_qp_t *qp, const char *filename) {
 	return (names);
 }
 
+#if defined(__linux__)
+
+/*
+ * Pin the current thread to the CPUs of a NUMA node, listed as ranges
+ * like "0-7,16-23"
+ */
+static bool
+pin_to_node(unsigned int node) {
+	char path[64];
+	unsigned int first, last;
+	cpu_set_t cpus;
+	FILE *fp = NULL;
+	int n;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+		 node);
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return (false);
+	}
+
+	CPU_ZERO(&cpus);
+	while ((n = fscanf(fp, "%u-%u", &first, &last)) >= 1) {
+		if (n == 1) {
+			last = first;
+		}
+		for (unsigned int cpu = first; cpu <= last; cpu++) {
+			CPU_SET(cpu, &cpus);
+		}
+		if (fgetc(fp) != ',') {
+			break;
+		}
+	}
+	fclose(fp);
+
+	return (CPU_COUNT(&cpus) > 0 &&
+		sched_setaffinity(0, sizeof(cpus), &cpus) == 0);
+}
+
+/*
+ * Compare the lookup latency seen from each NUMA node, for a trie that
+ * was loaded on one node versus a trie whose chunks are interleaved
+ * across all of them.
+ */
+static void
+lookups_per_node(dns_qp_t *qp, const char *filename, dns_fixedname_t *items,
+		 size_t n) {
+	unsigned int nodes = isc_os_numanodes();
+	dns_qpmulti_t *multi = NULL;
+	dns_qp_t *qpw = NULL;
+	dns_qpread_t qpr;
+	char buf[BUFSIZ];
+
+	if (nodes < 2) {
+		return;
+	}
+
+	dns_qpmulti_create(mctx, &methods, NULL, &multi);
+	dns_qpmulti_interleave(multi);
+	dns_qpmulti_write(multi, &qpw);
+	load_qp(qpw, filename);
+	dns_qp_compact(qpw, DNS_QPGC_ALL);
+	dns_qpmulti_commit(multi, &qpw);
+
+	for (unsigned int node = 0; node < nodes; node++) {
+		isc_nanosecs_t start, stop;
+
+		if (!pin_to_node(node)) {
+			continue;
+		}
+
+		start = isc_time_monotonic();
+		for (size_t i = 0; i < n; i++) {
+			dns_name_t *name = dns_fixedname_name(&items[i]);
+			dns_qp_lookup(qp, name, 0, NULL, NULL, NULL, NULL);
+		}
+		stop = isc_time_monotonic();
+
+		snprintf(buf, sizeof(buf),
+			 "node %u: look up %zd names (one node):", node, n);
+		printf("%-57s%7.3fns\n", buf, (stop - start) / (double)n);
+
+		dns_qpmulti_query(multi, &qpr);
+		start = isc_time_monotonic();
+		for (size_t i = 0; i < n; i++) {
+			dns_name_t *name = dns_fixedname_name(&items[i]);
+			dns_qp_lookup(&qpr, name, 0, NULL, NULL, NULL, NULL);
+		}
+		stop = isc_time_monotonic();
+		dns_qpread_destroy(multi, &qpr);
+
+		snprintf(buf, sizeof(buf),
+			 "node %u: look up %zd names (interleaved):", node, n);
+		printf("%-57s%7.3fns\n", buf, (stop - start) / (double)n);
+	}
+}
+
+#else /* __linux__ */
+
+static void
+lookups_per_node(dns_qp_t *qp, const char *filename, dns_fixedname_t *items,
+		 size_t n) {
+	UNUSED(qp);
+	UNUSED(filename);
+	UNUSED(items);
+	UNUSED(n);
+}
+
+#endif /* __linux__ */
+
 int
 main(int argc, char **argv) {
 	dns_qp_t *qp = NULL;
@@ -283,6 +398,8 @@ main(int argc, char **argv) {
 		 "look up %zd wrong names (dns_qp_lookup):", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
+	lookups_per_node(qp, argv[1], items, n);
+
 	isc_mem_cput(mctx, items, n, sizeof(dns_fixedname_t));
 	return (0);
 }
@@ -0,0 +1,638 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure authoritative query processing end to end, from
+ * ns_client_request() to the rendered response, without the network:
+ * every loop hands wire-format queries to libns on fake netmgr handles
+ * whose isc_nm_send() only records the latency.  The run is dominated
+ * by message parsing, view matching, zone lookups and rendering.
+ *
+ * The netmgr handle functions used by libns are replaced below, so
+ * nothing in this program may use real netmgr sockets; in particular
+ * the zone does not send NOTIFY messages.
+ *
+ * Usage: query [-n queries] origin zonefile queryfile
+ *
+ * The query file has one "name type" pair per line, as used by dnsperf;
+ * empty lines and lines starting with ';' or '#' are ignored.  Each loop
+ * sends the given number of queries, cycling through the list.  The
+ * number of loops is taken from ISC_TASK_WORKERS.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/netmgr.h>
+#include <isc/random.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <ns/client.h>
+#include <ns/interfacemgr.h>
+#include <ns/server.h>
+
+#include <tests/dns.h>
+
+#define DEFAULT_QUERIES (256 * 1024)
+#define MAX_QUERIES	65536
+
+/*
+ * A stand-in for isc_nmhandle_t; libns only ever sees a pointer to it.
+ */
+#define BENCH_HANDLE_MAGIC ISC_MAGIC('B', 'n', 'c', 'H')
+
+typedef struct bench_loop bench_loop_t;
+typedef struct bench_handle bench_handle_t;
+
+struct bench_handle {
+	unsigned int magic;
+	unsigned int references;
+	void *opaque;
+	isc_nm_opaquecb_t doreset;
+	isc_nm_opaquecb_t dofree;
+	isc_nanosecs_t start;
+	bench_loop_t *bl;
+	ISC_LINK(bench_handle_t) link;
+};
+
+struct bench_loop {
+	isc_mem_t *mctx;
+	ISC_LIST(bench_handle_t) handles;
+	uint64_t sent;
+	uint64_t answered;
+	uint64_t rcodes[16];
+};
+
+typedef struct bench_query {
+	unsigned char *base;
+	unsigned int length;
+} bench_query_t;
+
+static bench_query_t queries[MAX_QUERIES];
+static unsigned int nqueries = 0;
+static uint64_t perloop = DEFAULT_QUERIES;
+
+static const char *origin = NULL;
+static const char *zonefile = NULL;
+
+static isc_sockaddr_t peeraddr;
+static isc_sockaddr_t localaddr;
+
+static ns_server_t *server = NULL;
+static ns_interfacemgr_t *ifmgr = NULL;
+static ns_interface_t *interface = NULL;
+static dns_view_t *view = NULL;
+static dns_zone_t *zone = NULL;
+
+static bench_loop_t *loops = NULL;
+static isc_histomulti_t *latency = NULL;
+static atomic_uint_fast32_t running;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static bench_handle_t *
+tohandle(const isc_nmhandle_t *nmhandle) {
+	bench_handle_t *handle = UNCONST(nmhandle);
+
+	INSIST(ISC_MAGIC_VALID(handle, BENCH_HANDLE_MAGIC));
+	return (handle);
+}
+
+/*
+ * The netmgr functions that libns calls for a UDP client.
+ */
+
+static void
+handle_destroy(bench_handle_t *handle) {
+	bench_loop_t *bl = handle->bl;
+	void *opaque = handle->opaque;
+
+	handle->opaque = NULL;
+	if (handle->doreset != NULL) {
+		handle->doreset(opaque);
+	}
+	if (handle->dofree != NULL) {
+		handle->dofree(opaque);
+	}
+	handle->doreset = NULL;
+	handle->dofree = NULL;
+
+	ISC_LIST_PREPEND(bl->handles, handle, link);
+}
+
+#if ISC_NETMGR_TRACE
+isc_nmhandle_t *
+isc_nmhandle__ref(isc_nmhandle_t *ptr, const char *func ISC_ATTR_UNUSED,
+		  const char *file ISC_ATTR_UNUSED,
+		  unsigned int line ISC_ATTR_UNUSED) {
+#else
+isc_nmhandle_t *
+isc_nmhandle_ref(isc_nmhandle_t *ptr) {
+#endif
+	tohandle(ptr)->references++;
+	return (ptr);
+}
+
+#if ISC_NETMGR_TRACE
+void
+isc_nmhandle__unref(isc_nmhandle_t *ptr, const char *func ISC_ATTR_UNUSED,
+		    const char *file ISC_ATTR_UNUSED,
+		    unsigned int line ISC_ATTR_UNUSED) {
+#else
+void
+isc_nmhandle_unref(isc_nmhandle_t *ptr) {
+#endif
+	bench_handle_t *handle = tohandle(ptr);
+
+	INSIST(handle->references > 0);
+	if (--handle->references == 0) {
+		handle_destroy(handle);
+	}
+}
+
+#if ISC_NETMGR_TRACE
+void
+isc_nmhandle__attach(isc_nmhandle_t *ptr, isc_nmhandle_t **ptrp,
+		     const char *func, const char *file, unsigned int line) {
+	*ptrp = isc_nmhandle__ref(ptr, func, file, line);
+}
+#else
+void
+isc_nmhandle_attach(isc_nmhandle_t *ptr, isc_nmhandle_t **ptrp) {
+	*ptrp = isc_nmhandle_ref(ptr);
+}
+#endif
+
+#if ISC_NETMGR_TRACE
+void
+isc_nmhandle__detach(isc_nmhandle_t **ptrp, const char *func,
+		     const char *file, unsigned int line) {
+	isc_nmhandle_t *ptr = *ptrp;
+	*ptrp = NULL;
+	isc_nmhandle__unref(ptr, func, file, line);
+}
+#else
+void
+isc_nmhandle_detach(isc_nmhandle_t **ptrp) {
+	isc_nmhandle_t *ptr = *ptrp;
+	*ptrp = NULL;
+	isc_nmhandle_unref(ptr);
+}
+#endif
+
+void *
+isc_nmhandle_getdata(isc_nmhandle_t *nmhandle) {
+	return (tohandle(nmhandle)->opaque);
+}
+
+void
+isc_nmhandle_setdata(isc_nmhandle_t *nmhandle, void *arg,
+		     isc_nm_opaquecb_t doreset, isc_nm_opaquecb_t dofree) {
+	bench_handle_t *handle = tohandle(nmhandle);
+
+	handle->opaque = arg;
+	handle->doreset = doreset;
+	handle->dofree = dofree;
+}
+
+bool
+isc_nmhandle_is_stream(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (false);
+}
+
+isc_sockaddr_t
+isc_nmhandle_peeraddr(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (peeraddr);
+}
+
+isc_sockaddr_t
+isc_nmhandle_localaddr(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (localaddr);
+}
+
+isc_sockaddr_t
+isc_nmhandle_real_peeraddr(isc_nmhandle_t *nmhandle) {
+	return (isc_nmhandle_peeraddr(nmhandle));
+}
+
+isc_sockaddr_t
+isc_nmhandle_real_localaddr(isc_nmhandle_t *nmhandle) {
+	return (isc_nmhandle_localaddr(nmhandle));
+}
+
+isc_nm_t *
+isc_nmhandle_netmgr(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (netmgr);
+}
+
+void
+isc_nmhandle_keepalive(isc_nmhandle_t *nmhandle, bool value ISC_ATTR_UNUSED) {
+	(void)tohandle(nmhandle);
+}
+
+bool
+isc_nm_is_proxy_handle(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (false);
+}
+
+bool
+isc_nm_is_http_handle(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (false);
+}
+
+isc_nmsocket_type
+isc_nm_socket_type(const isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (isc_nm_udpsocket);
+}
+
+bool
+isc_nm_has_encryption(const isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+	return (false);
+}
+
+void
+isc_nm_bad_request(isc_nmhandle_t *nmhandle) {
+	(void)tohandle(nmhandle);
+}
+
+void
+isc_nm_set_maxage(isc_nmhandle_t *nmhandle,
+		  const uint32_t ttl ISC_ATTR_UNUSED) {
+	(void)tohandle(nmhandle);
+}
+
+void
+isc_nm_send(isc_nmhandle_t *nmhandle, isc_region_t *region, isc_nm_cb_t cb,
+	    void *cbarg) {
+	bench_handle_t *handle = tohandle(nmhandle);
+	bench_loop_t *bl = handle->bl;
+
+	isc_histomulti_inc(latency, isc_time_monotonic() - handle->start);
+
+	bl->answered++;
+	if (region->length >= 4) {
+		bl->rcodes[region->base[3] & 0x0f]++;
+	}
+
+	cb(nmhandle, ISC_R_SUCCESS, cbarg);
+}
+
+/*
+ * Setup and reporting.
+ */
+
+static isc_result_t
+matchview(isc_netaddr_t *srcaddr ISC_ATTR_UNUSED,
+	  isc_netaddr_t *destaddr ISC_ATTR_UNUSED,
+	  dns_message_t *message ISC_ATTR_UNUSED,
+	  dns_aclenv_t *env ISC_ATTR_UNUSED, ns_server_t *lsctx ISC_ATTR_UNUSED,
+	  isc_loop_t *loop ISC_ATTR_UNUSED, isc_job_cb cb ISC_ATTR_UNUSED,
+	  void *cbarg ISC_ATTR_UNUSED, isc_result_t *sigresultp ISC_ATTR_UNUSED,
+	  isc_result_t *viewmatchresultp, dns_view_t **viewp) {
+	dns_view_attach(view, viewp);
+	*viewmatchresultp = ISC_R_SUCCESS;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+addquery(const char *qnamestr, const char *qtypestr) {
+	dns_message_t *message = NULL;
+	dns_rdataset_t *qrdataset = NULL;
+	dns_rdataset_t *opt = NULL;
+	dns_name_t *qname = NULL;
+	dns_rdatatype_t qtype;
+	isc_textregion_t tr;
+	unsigned char wire[512];
+	isc_buffer_t buf;
+	dns_compress_t cctx;
+	isc_result_t result;
+
+	tr.base = UNCONST(qtypestr);
+	tr.length = strlen(qtypestr);
+	result = dns_rdatatype_fromtext(&qtype, &tr);
+	CHECKRESULT(result, "dns_rdatatype_fromtext");
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &message);
+	message->id = isc_random16();
+
+	dns_message_gettemprdataset(message, &qrdataset);
+	dns_message_gettempname(message, &qname);
+	result = dns_name_fromstring(qname, qnamestr, dns_rootname, 0, mctx);
+	CHECKRESULT(result, "dns_name_fromstring");
+	dns_rdataset_makequestion(qrdataset, dns_rdataclass_in, qtype);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+	dns_message_addname(message, qname, DNS_SECTION_QUESTION);
+
+	/* Advertise the same EDNS buffer size as most resolvers do */
+	result = dns_message_buildopt(message, &opt, 0, 1232, 0, NULL, 0);
+	CHECKRESULT(result, "dns_message_buildopt");
+	result = dns_message_setopt(message, opt);
+	CHECKRESULT(result, "dns_message_setopt");
+
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_init(&buf, wire, sizeof(wire));
+	result = dns_message_renderbegin(message, &cctx, &buf);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	CHECKRESULT(result, "dns_message_rendersection");
+	result = dns_message_renderend(message);
+	CHECKRESULT(result, "dns_message_renderend");
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&message);
+
+	queries[nqueries].length = isc_buffer_usedlength(&buf);
+	queries[nqueries].base = isc_mem_get(mctx, queries[nqueries].length);
+	memmove(queries[nqueries].base, wire, queries[nqueries].length);
+	nqueries++;
+}
+
+static void
+readqueries(const char *filename) {
+	char line[1024];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	while (nqueries < MAX_QUERIES && fgets(line, sizeof(line), fp) != NULL)
+	{
+		char qname[DNS_NAME_FORMATSIZE];
+		char qtype[32];
+
+		if (line[0] == ';' || line[0] == '#') {
+			continue;
+		}
+		if (sscanf(line, "%1023s %31s", qname, qtype) != 2) {
+			continue;
+		}
+		addquery(qname, qtype);
+	}
+
+	fclose(fp);
+
+	if (nqueries == 0) {
+		printf("%s: no queries\n", filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+loadzone(void) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_test_makezone(origin, &zone, view, false);
+	CHECKRESULT(result, "dns_test_makezone");
+
+	dns_zone_setnotifytype(zone, dns_notifytype_no);
+
+	dns_test_setupzonemgr();
+	result = dns_test_managezone(zone);
+	CHECKRESULT(result, "dns_test_managezone");
+
+	dns_zone_setfile(zone, zonefile, dns_masterformat_text,
+			 &dns_master_style_default);
+	result = dns_zone_load(zone, false);
+	CHECKRESULT(result, "dns_zone_load");
+
+	result = dns_zone_getdb(zone, &db);
+	CHECKRESULT(result, "dns_zone_getdb");
+	dns_db_detach(&db);
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	const double fraction[] = { 0.999, 0.99, 0.9, 0.5 };
+	uint64_t value[ARRAY_SIZE(fraction)];
+	uint64_t sent = 0, answered = 0, rcodes[16] = { 0 };
+	isc_histo_t *hg = NULL;
+	isc_result_t result;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		sent += loops[i].sent;
+		answered += loops[i].answered;
+		for (size_t r = 0; r < ARRAY_SIZE(rcodes); r++) {
+			rcodes[r] += loops[i].rcodes[r];
+		}
+	}
+
+	printf("%u loops, %" PRIu64 " queries, %" PRIu64 " answered "
+	       "(%" PRIu64 " NOERROR, %" PRIu64 " NXDOMAIN, %" PRIu64
+	       " other)\n",
+	       nloops, sent, answered, rcodes[dns_rcode_noerror],
+	       rcodes[dns_rcode_nxdomain],
+	       answered - rcodes[dns_rcode_noerror] -
+		       rcodes[dns_rcode_nxdomain]);
+	printf("%f s; %f queries/us; %f queries/us/loop\n", us / 1000000.0,
+	       sent / us, sent / us / nloops);
+
+	isc_histomulti_merge(&hg, latency);
+	result = isc_histo_quantiles(hg, ARRAY_SIZE(fraction), fraction,
+				     value);
+	if (result == ISC_R_SUCCESS) {
+		printf("latency ns: p50 %" PRIu64 " p90 %" PRIu64
+		       " p99 %" PRIu64 " p99.9 %" PRIu64 "\n",
+		       value[3], value[2], value[1], value[0]);
+	}
+	isc_histo_destroy(&hg);
+	isc_histomulti_destroy(&latency);
+
+	isc_mem_cput(mctx, loops, nloops, sizeof(loops[0]));
+	for (unsigned int i = 0; i < nqueries; i++) {
+		isc_mem_put(mctx, queries[i].base, queries[i].length);
+	}
+
+	/* This also destroys the interface */
+	ns_interfacemgr_shutdown(ifmgr);
+	ns_interfacemgr_detach(&ifmgr);
+	interface = NULL;
+
+	dns_test_releasezone(zone);
+	dns_test_closezonemgr();
+	dns_zone_detach(&zone);
+	dns_view_detach(&view);
+	ns_server_detach(&server);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+run(void *arg) {
+	bench_loop_t *bl = arg;
+	unsigned int offset = isc_random_uniform(nqueries);
+
+	bl->mctx = isc_loop_getmctx(isc_loop());
+	ISC_LIST_INIT(bl->handles);
+
+	for (uint64_t i = 0; i < perloop; i++) {
+		bench_query_t *query = &queries[(offset + i) % nqueries];
+		isc_region_t region = { .base = query->base,
+					.length = query->length };
+		bench_handle_t *handle = ISC_LIST_HEAD(bl->handles);
+
+		/*
+		 * Queries are normally answered before ns_client_request()
+		 * returns, so one handle per loop is usually enough.
+		 */
+		if (handle != NULL) {
+			ISC_LIST_UNLINK(bl->handles, handle, link);
+		} else {
+			handle = isc_mem_get(bl->mctx, sizeof(*handle));
+			*handle = (bench_handle_t){
+				.magic = BENCH_HANDLE_MAGIC,
+				.bl = bl,
+				.link = ISC_LINK_INITIALIZER,
+			};
+		}
+
+		handle->references = 1;
+		handle->start = isc_time_monotonic();
+		bl->sent++;
+
+		ns_client_request((isc_nmhandle_t *)handle, ISC_R_SUCCESS,
+				  &region, interface);
+		isc_nmhandle_detach((isc_nmhandle_t **)&handle);
+	}
+
+	/* Any query that is still in progress keeps its handle */
+	while (!ISC_LIST_EMPTY(bl->handles)) {
+		bench_handle_t *handle = ISC_LIST_HEAD(bl->handles);
+		ISC_LIST_UNLINK(bl->handles, handle, link);
+		handle->magic = 0;
+		isc_mem_put(bl->mctx, handle, sizeof(*handle));
+	}
+
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	isc_result_t result;
+
+	ns_server_create(mctx, matchview, &server);
+
+	result = ns_interfacemgr_create(mctx, server, loopmgr, netmgr, NULL,
+					NULL, &ifmgr);
+	CHECKRESULT(result, "ns_interfacemgr_create");
+	ns_interface_create(ifmgr, &localaddr, NULL, &interface);
+
+	result = dns_test_makeview("bench", false, false, &view);
+	CHECKRESULT(result, "dns_test_makeview");
+	loadzone();
+	dns_view_freeze(view);
+
+	isc_histomulti_create(mctx, isc_histo_digits_to_bits(2), &latency);
+	loops = isc_mem_cget(mctx, nloops, sizeof(loops[0]));
+
+	atomic_init(&running, nloops);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), run, &loops[i]);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: query [-n queries] origin zonefile "
+			"queryfile\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	struct in_addr in = { .s_addr = htonl(INADDR_LOOPBACK) };
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			perloop = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 3 || perloop == 0) {
+		usage();
+	}
+	origin = argv[0];
+	zonefile = argv[1];
+
+	isc_sockaddr_fromin(&peeraddr, &in, 49152);
+	isc_sockaddr_fromin(&localaddr, &in, 53);
+
+	/*
+	 * Not setup_mctx(), which turns on allocation recording.
+	 */
+	isc_mem_create(&mctx);
+	readqueries(argv[2]);
+
+	setup_loopmgr(NULL);
+	setup_netmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	teardown_netmgr(NULL);
+	teardown_loopmgr(NULL);
+	teardown_mctx(NULL);
+
+	return (0);
+}
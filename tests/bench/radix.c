@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure IPv4 host searches in a radix tree holding many prefixes,
+ * the way a large ACL or blackhole list is searched, first by walking
+ * the tree and then with the table built by isc_radix_compile().
+ *
+ * Usage: radix [-n searches] [-p prefixes]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define ADDRS 65536
+
+static size_t prefixes = 1000000;
+static size_t searches = 10000000;
+
+static isc_mem_t *mctx = NULL;
+static struct in_addr addrs[ADDRS];
+
+static void
+search(isc_radix_tree_t *radix, const char *how) {
+	isc_time_t t0, t1;
+	uint64_t found = 0;
+	double us;
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < searches; i++) {
+		isc_radix_node_t *node = NULL;
+		isc_netaddr_t netaddr;
+		isc_prefix_t prefix;
+
+		isc_netaddr_fromin(&netaddr, &addrs[i % ADDRS]);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, 32);
+		if (isc_radix_search(radix, &node, &prefix) == ISC_R_SUCCESS) {
+			found++;
+		}
+		isc_refcount_destroy(&prefix.refcount);
+	}
+	t1 = isc_time_now_hires();
+
+	us = (double)isc_time_microdiff(&t1, &t0);
+	printf("%-8s %zu searches, %" PRIu64 " found, %f s, %f searches/us\n",
+	       how, searches, found, us / 1000000.0, searches / us);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: radix [-n searches] [-p prefixes]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	static const unsigned int lengths[] = { 16, 20, 24, 24, 24, 28, 32 };
+	isc_radix_tree_t *radix = NULL;
+	isc_time_t t0, t1;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:p:")) != -1) {
+		switch (ch) {
+		case 'n':
+			searches = strtoull(optarg, NULL, 10);
+			break;
+		case 'p':
+			prefixes = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || searches == 0 || prefixes == 0) {
+		usage();
+	}
+
+	isc_mem_create(&mctx);
+	isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < prefixes; i++) {
+		unsigned int bits =
+			lengths[isc_random_uniform(ARRAY_SIZE(lengths))];
+		isc_radix_node_t *node = NULL;
+		isc_netaddr_t netaddr;
+		isc_prefix_t prefix;
+		struct in_addr in;
+		isc_result_t result;
+
+		in.s_addr = htonl(isc_random32() & (~0U << (32 - bits)));
+		isc_netaddr_fromin(&netaddr, &in);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, bits);
+		result = isc_radix_insert(radix, &node, NULL, &prefix);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		isc_refcount_destroy(&prefix.refcount);
+	}
+	t1 = isc_time_now_hires();
+	printf("%zu prefixes inserted in %f s\n", prefixes,
+	       isc_time_microdiff(&t1, &t0) / 1000000.0);
+
+	for (size_t i = 0; i < ADDRS; i++) {
+		addrs[i].s_addr = isc_random32();
+	}
+
+	search(radix, "tree");
+
+	t0 = isc_time_now_hires();
+	isc_radix_compile(radix);
+	t1 = isc_time_now_hires();
+	printf("compiled in %f s\n", isc_time_microdiff(&t1, &t0) / 1000000.0);
+
+	search(radix, "compiled");
+
+	isc_radix_destroy(radix, NULL);
+	isc_mem_detach(&mctx);
+
+	return (0);
+}
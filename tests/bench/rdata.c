@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/rdata.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#include <tests/dns.h>
+
+/*
+ * Time the conversion to and from wire format, and the comparison, of
+ * the record types that make up most of the data in a typical zone.
+ */
+
+static const struct {
+	dns_rdatatype_t type;
+	const char *text;
+} records[] = {
+	{ dns_rdatatype_a, "192.0.2.1" },
+	{ dns_rdatatype_aaaa, "2001:db8::1" },
+	{ dns_rdatatype_ns, "ns1.example." },
+	{ dns_rdatatype_cname, "www.example." },
+	{ dns_rdatatype_soa, "ns1.example. hostmaster.example. "
+			     "2024010101 3600 900 604800 300" },
+	{ dns_rdatatype_ds, "12345 13 2 "
+			    "0123456789ABCDEF0123456789ABCDEF"
+			    "0123456789ABCDEF0123456789ABCDEF" },
+	{ dns_rdatatype_rrsig, "A 13 2 300 20300101000000 20200101000000 "
+			       "12345 example. "
+			       "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+			       "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=" },
+};
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: rdata [-n iterations]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	unsigned int repeat = 1000000;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			repeat = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || repeat == 0) {
+		usage();
+	}
+
+	isc_mem_create(&mctx);
+
+	for (size_t r = 0; r < ARRAY_SIZE(records); r++) {
+		static unsigned char data[512], wire[512], copy[512];
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		char typename[DNS_RDATATYPE_FORMATSIZE];
+		isc_buffer_t buf;
+		isc_result_t result;
+		isc_time_t start, finish;
+		uint64_t towire, fromwire, compare;
+		int order = 0;
+
+		dns_rdatatype_format(records[r].type, typename,
+				     sizeof(typename));
+		result = dns_test_rdatafromstring(
+			&rdata, dns_rdataclass_in, records[r].type, data,
+			sizeof(data), records[r].text, false);
+		CHECKRESULT(result, typename);
+
+		start = isc_time_now_hires();
+		for (unsigned int n = 0; n < repeat; n++) {
+			dns_compress_t cctx;
+
+			dns_compress_init(&cctx, mctx, 0);
+			isc_buffer_init(&buf, wire, sizeof(wire));
+			result = dns_rdata_towire(&rdata, &cctx, &buf);
+			dns_compress_invalidate(&cctx);
+			CHECKRESULT(result, "dns_rdata_towire");
+		}
+		finish = isc_time_now_hires();
+		towire = isc_time_microdiff(&finish, &start);
+
+		start = isc_time_now_hires();
+		for (unsigned int n = 0; n < repeat; n++) {
+			dns_rdata_t parsed = DNS_RDATA_INIT;
+			isc_buffer_t source, target;
+
+			isc_buffer_init(&source, wire, sizeof(wire));
+			isc_buffer_add(&source, isc_buffer_usedlength(&buf));
+			isc_buffer_setactive(&source,
+					     isc_buffer_usedlength(&buf));
+			isc_buffer_init(&target, copy, sizeof(copy));
+			result = dns_rdata_fromwire(
+				&parsed, dns_rdataclass_in, records[r].type,
+				&source, DNS_DECOMPRESS_ALWAYS, &target);
+			CHECKRESULT(result, "dns_rdata_fromwire");
+		}
+		finish = isc_time_now_hires();
+		fromwire = isc_time_microdiff(&finish, &start);
+
+		start = isc_time_now_hires();
+		for (unsigned int n = 0; n < repeat; n++) {
+			order += dns_rdata_compare(&rdata, &rdata);
+		}
+		finish = isc_time_now_hires();
+		compare = isc_time_microdiff(&finish, &start);
+		INSIST(order == 0);
+
+		printf("%-6s towire %7.2f ns  fromwire %7.2f ns  "
+		       "compare %7.2f ns\n",
+		       typename, towire * 1000.0 / repeat,
+		       fromwire * 1000.0 / repeat, compare * 1000.0 / repeat);
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
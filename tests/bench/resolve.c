@@ -0,0 +1,991 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the resolver against a synthetic DNS hierarchy served from the
+ * same process, so that the numbers do not depend on real upstreams.
+ *
+ * The hierarchy has a root, 'tlds' top level domains named tldN. and
+ * 'slds' second level domains dM.tldN. under each of them, which hold
+ * the hosts hK.dM.tldN.  The root server listens on 127.0.0.1, each top
+ * level domain has its own server on 127.0.1.x and the second level
+ * domains are spread over a pool of servers on 127.0.2.x, so this only
+ * runs where the whole of 127/8 can be bound, as on Linux.  The servers
+ * can delay their answers and drop a share of the queries.
+ *
+ * Every loop runs a number of clients, each of them looking up one name
+ * at a time: first in the cache, as a query would, and then with a
+ * fetch on a miss.  The names are the hosts, picked with a Zipf
+ * distribution, and a share of random names under the second level
+ * domains that do not exist.
+ *
+ * The report gives the cache hit rate, the queries that reached the
+ * servers per client query, and the latency of the lookups.  DNSSEC is
+ * not simulated: the zones are unsigned and the view does no validation.
+ *
+ * Usage: resolve [-c clients] [-q queries] [-p port] [-T tlds] [-S slds]
+ *                [-H hosts] [-K servers] [-s zipf] [-r random%]
+ *                [-d delay-ms] [-l loss%] [-t ttl]
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/random.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dispatch.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#define DEFAULT_PORT 5354
+#define MAXLABELS    8
+#define REPLYSIZE    1232
+
+#define ADDR_ROOT 0x7f000001 /* 127.0.0.1 */
+#define ADDR_TLD  0x7f000100 /* 127.0.1.x */
+#define ADDR_SLD  0x7f000200 /* 127.0.2.x */
+#define ADDR_HOST 0xc0000201 /* 192.0.2.1 */
+
+#define SECTION_ANSWER	   0
+#define SECTION_AUTHORITY  1
+#define SECTION_ADDITIONAL 2
+
+typedef enum { ROOT, TLD, SLD } level_t;
+
+typedef struct server {
+	level_t level;
+	unsigned int index;
+	isc_nmsocket_t *sock;
+} server_t;
+
+typedef struct reply {
+	isc_nmhandle_t *handle;
+	isc_timer_t *timer;
+	isc_buffer_t buffer;
+	unsigned char data[REPLYSIZE];
+} reply_t;
+
+typedef struct qname {
+	unsigned int n;
+	char label[MAXLABELS][64];
+} qname_t;
+
+typedef struct worker {
+	uint64_t sent;
+	uint64_t hits;
+	uint64_t fetches;
+	uint64_t failed;
+	unsigned int active;
+	uint64_t *latency;
+	size_t nlatency;
+	size_t maxlatency;
+} worker_t;
+
+typedef struct client {
+	worker_t *worker;
+	dns_fixedname_t fname;
+	dns_rdataset_t rdataset;
+	dns_fetch_t *fetch;
+	uint64_t start;
+} client_t;
+
+static unsigned int nclients = 64;
+static uint64_t queries = 100000;
+static in_port_t port = DEFAULT_PORT;
+static unsigned int ntlds = 4;
+static unsigned int nslds = 1000;
+static unsigned int nhosts = 10;
+static unsigned int nsldservers = 8;
+static double zipf = 1.0;
+static unsigned int randompct = 10;
+static unsigned int delay = 0;
+static unsigned int losspct = 0;
+static dns_ttl_t ttl = 300;
+
+static server_t *servers = NULL;
+static unsigned int nservers = 0;
+static double *cdf = NULL;
+static size_t nnames = 0;
+
+static dns_view_t *view = NULL;
+static dns_dispatch_t *dispatch = NULL;
+static isc_tlsctx_cache_t *tlsctx_cache = NULL;
+static dns_resolver_t *resolver = NULL;
+static worker_t *loopdata = NULL;
+static client_t *clients = NULL;
+
+static atomic_uint_fast64_t upstream;
+static atomic_uint_fast64_t dropped;
+static atomic_uint_fast32_t running;
+static isc_time_t t0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * The authoritative side.
+ */
+
+static void
+setuint16(isc_buffer_t *b, unsigned int offset, uint16_t value) {
+	unsigned char *p = (unsigned char *)b->base + offset;
+
+	p[0] = value >> 8;
+	p[1] = value & 0xff;
+}
+
+static void
+putname(isc_buffer_t *b, const char *text) {
+	if (strcmp(text, ".") != 0) {
+		while (*text != '\0') {
+			const char *dot = strchr(text, '.');
+			INSIST(dot != NULL);
+			isc_buffer_putuint8(b, (uint8_t)(dot - text));
+			isc_buffer_putmem(b, (const unsigned char *)text,
+					  (unsigned int)(dot - text));
+			text = dot + 1;
+		}
+	}
+	isc_buffer_putuint8(b, 0);
+}
+
+static void
+putrrheader(isc_buffer_t *b, const char *owner, dns_rdatatype_t type,
+	    dns_ttl_t rrttl) {
+	putname(b, owner);
+	isc_buffer_putuint16(b, type);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+	isc_buffer_putuint32(b, rrttl);
+}
+
+static void
+put_a(isc_buffer_t *b, uint16_t *counts, int section, const char *owner,
+      dns_ttl_t rrttl, uint32_t address) {
+	putrrheader(b, owner, dns_rdatatype_a, rrttl);
+	isc_buffer_putuint16(b, 4);
+	isc_buffer_putuint32(b, address);
+	counts[section]++;
+}
+
+static void
+put_ns(isc_buffer_t *b, uint16_t *counts, int section, const char *owner,
+       const char *target) {
+	unsigned int rdlen;
+
+	putrrheader(b, owner, dns_rdatatype_ns, 86400);
+	rdlen = isc_buffer_usedlength(b);
+	isc_buffer_putuint16(b, 0);
+	putname(b, target);
+	setuint16(b, rdlen, isc_buffer_usedlength(b) - rdlen - 2);
+	counts[section]++;
+}
+
+static void
+put_soa(isc_buffer_t *b, uint16_t *counts, int section, const char *zone) {
+	char name[256];
+	unsigned int rdlen;
+
+	putrrheader(b, zone, dns_rdatatype_soa, ttl);
+	rdlen = isc_buffer_usedlength(b);
+	isc_buffer_putuint16(b, 0);
+	if (strcmp(zone, ".") == 0) {
+		zone = "";
+	}
+	snprintf(name, sizeof(name), "ns.%s", zone);
+	putname(b, name);
+	snprintf(name, sizeof(name), "hostmaster.%s", zone);
+	putname(b, name);
+	isc_buffer_putuint32(b, 1);	/* serial */
+	isc_buffer_putuint32(b, 3600);	/* refresh */
+	isc_buffer_putuint32(b, 600);	/* retry */
+	isc_buffer_putuint32(b, 86400); /* expire */
+	isc_buffer_putuint32(b, ttl);	/* minimum */
+	setuint16(b, rdlen, isc_buffer_usedlength(b) - rdlen - 2);
+	counts[section]++;
+}
+
+/*
+ * Parse 'label' as 'prefix' followed by a decimal number lower than
+ * 'max', and store the number in '*nump'.
+ */
+static bool
+labelnum(const char *label, const char *prefix, unsigned int max,
+	 unsigned int *nump) {
+	size_t len = strlen(prefix);
+	char *end = NULL;
+	unsigned long num;
+
+	if (strncasecmp(label, prefix, len) != 0 || label[len] < '0' ||
+	    label[len] > '9')
+	{
+		return (false);
+	}
+	num = strtoul(label + len, &end, 10);
+	if (*end != '\0' || num >= max) {
+		return (false);
+	}
+	*nump = (unsigned int)num;
+	return (true);
+}
+
+/* The k-th label from the right of 'q', the top level one being 0 */
+static const char *
+rlabel(const qname_t *q, unsigned int k) {
+	return (q->label[q->n - 1 - k]);
+}
+
+static uint32_t
+sldaddr(unsigned int tld, unsigned int sld) {
+	return (ADDR_SLD + (tld * nslds + sld) % nsldservers + 1);
+}
+
+/*
+ * Answer a query for the apex of 'zone', whose name server is
+ * ns.'zone' at 'address'.
+ */
+static void
+apex(isc_buffer_t *b, uint16_t *counts, const char *zone, uint32_t address,
+     dns_rdatatype_t qtype) {
+	char nsname[256];
+
+	snprintf(nsname, sizeof(nsname), "ns.%s",
+		 strcmp(zone, ".") == 0 ? "" : zone);
+	if (qtype == dns_rdatatype_ns) {
+		put_ns(b, counts, SECTION_ANSWER, zone, nsname);
+		put_a(b, counts, SECTION_ADDITIONAL, nsname, 86400, address);
+	} else if (qtype == dns_rdatatype_soa) {
+		put_soa(b, counts, SECTION_ANSWER, zone);
+	} else {
+		put_soa(b, counts, SECTION_AUTHORITY, zone);
+	}
+}
+
+static void
+referral(isc_buffer_t *b, uint16_t *counts, const char *zone,
+	 uint32_t address) {
+	char nsname[256];
+
+	snprintf(nsname, sizeof(nsname), "ns.%s", zone);
+	put_ns(b, counts, SECTION_AUTHORITY, zone, nsname);
+	put_a(b, counts, SECTION_ADDITIONAL, nsname, 86400, address);
+}
+
+/*
+ * Write the records that 'server' has for 'q'/'qtype' and return the
+ * response code, setting '*aa' for authoritative answers.
+ */
+static dns_rcode_t
+lookup(const server_t *server, const qname_t *q, dns_rdatatype_t qtype,
+       isc_buffer_t *b, uint16_t *counts, bool *aa) {
+	char owner[256], zone[256];
+	unsigned int tld, sld, host;
+
+	*aa = true;
+
+	if (server->level == ROOT) {
+		if (q->n == 0) {
+			apex(b, counts, ".", ADDR_ROOT, qtype);
+			return (dns_rcode_noerror);
+		}
+		if (labelnum(rlabel(q, 0), "tld", ntlds, &tld)) {
+			snprintf(zone, sizeof(zone), "tld%u.", tld);
+			referral(b, counts, zone, ADDR_TLD + tld + 1);
+			*aa = false;
+			return (dns_rcode_noerror);
+		}
+		if (q->n == 1 && strcasecmp(rlabel(q, 0), "ns") == 0) {
+			if (qtype == dns_rdatatype_a) {
+				put_a(b, counts, SECTION_ANSWER, "ns.", 86400,
+				      ADDR_ROOT);
+			} else {
+				put_soa(b, counts, SECTION_AUTHORITY, ".");
+			}
+			return (dns_rcode_noerror);
+		}
+		put_soa(b, counts, SECTION_AUTHORITY, ".");
+		return (dns_rcode_nxdomain);
+	}
+
+	if (q->n == 0 || !labelnum(rlabel(q, 0), "tld", ntlds, &tld) ||
+	    (server->level == TLD && tld != server->index))
+	{
+		return (dns_rcode_refused);
+	}
+	snprintf(zone, sizeof(zone), "tld%u.", tld);
+
+	if (server->level == TLD) {
+		if (q->n == 1) {
+			apex(b, counts, zone, ADDR_TLD + tld + 1, qtype);
+			return (dns_rcode_noerror);
+		}
+		if (labelnum(rlabel(q, 1), "d", nslds, &sld)) {
+			snprintf(zone, sizeof(zone), "d%u.tld%u.", sld, tld);
+			referral(b, counts, zone, sldaddr(tld, sld));
+			*aa = false;
+			return (dns_rcode_noerror);
+		}
+		if (q->n == 2 && strcasecmp(rlabel(q, 1), "ns") == 0) {
+			if (qtype == dns_rdatatype_a) {
+				snprintf(owner, sizeof(owner), "ns.%s", zone);
+				put_a(b, counts, SECTION_ANSWER, owner, 86400,
+				      ADDR_TLD + tld + 1);
+			} else {
+				put_soa(b, counts, SECTION_AUTHORITY, zone);
+			}
+			return (dns_rcode_noerror);
+		}
+		put_soa(b, counts, SECTION_AUTHORITY, zone);
+		return (dns_rcode_nxdomain);
+	}
+
+	if (q->n < 2 || !labelnum(rlabel(q, 1), "d", nslds, &sld) ||
+	    sldaddr(tld, sld) != ADDR_SLD + server->index + 1)
+	{
+		return (dns_rcode_refused);
+	}
+	snprintf(zone, sizeof(zone), "d%u.tld%u.", sld, tld);
+
+	if (q->n == 2) {
+		apex(b, counts, zone, sldaddr(tld, sld), qtype);
+		return (dns_rcode_noerror);
+	}
+	if (q->n == 3 && (strcasecmp(rlabel(q, 2), "ns") == 0 ||
+			  labelnum(rlabel(q, 2), "h", nhosts, &host)))
+	{
+		if (qtype == dns_rdatatype_a) {
+			snprintf(owner, sizeof(owner), "%s.%s", rlabel(q, 2),
+				 zone);
+			put_a(b, counts, SECTION_ANSWER, owner, ttl,
+			      strcasecmp(rlabel(q, 2), "ns") == 0
+				      ? sldaddr(tld, sld)
+				      : ADDR_HOST);
+		} else {
+			put_soa(b, counts, SECTION_AUTHORITY, zone);
+		}
+		return (dns_rcode_noerror);
+	}
+	put_soa(b, counts, SECTION_AUTHORITY, zone);
+	return (dns_rcode_nxdomain);
+}
+
+/*
+ * Build the response of 'server' to the query in 'region' into 'b'.
+ * Queries that cannot be parsed are not answered.
+ */
+static bool
+respond(const server_t *server, const isc_region_t *region, isc_buffer_t *b) {
+	const unsigned char *data = region->base;
+	unsigned int length = region->length, offset = 12;
+	uint16_t counts[3] = { 0 };
+	dns_rdatatype_t qtype;
+	dns_rcode_t rcode;
+	qname_t q = { 0 };
+	bool aa, edns;
+
+	if (length < 12 || data[4] != 0 || data[5] != 1 ||
+	    (data[2] & 0x80) != 0)
+	{
+		return (false);
+	}
+	edns = (data[10] != 0 || data[11] != 0);
+
+	for (;;) {
+		unsigned int len;
+
+		if (offset >= length) {
+			return (false);
+		}
+		len = data[offset];
+		if ((len & 0xc0) != 0 || offset + 1 + len > length) {
+			return (false);
+		}
+		if (len == 0) {
+			offset++;
+			break;
+		}
+		if (q.n == MAXLABELS) {
+			return (false);
+		}
+		memmove(q.label[q.n], data + offset + 1, len);
+		q.label[q.n][len] = '\0';
+		q.n++;
+		offset += 1 + len;
+	}
+	if (offset + 4 > length) {
+		return (false);
+	}
+	qtype = (data[offset] << 8) | data[offset + 1];
+	offset += 4;
+
+	/* The header is written once the counts are known */
+	isc_buffer_add(b, 12);
+	isc_buffer_putmem(b, data + 12, offset - 12);
+
+	rcode = lookup(server, &q, qtype, b, counts, &aa);
+	if (edns) {
+		isc_buffer_putuint8(b, 0);
+		isc_buffer_putuint16(b, dns_rdatatype_opt);
+		isc_buffer_putuint16(b, REPLYSIZE);
+		isc_buffer_putuint32(b, 0);
+		isc_buffer_putuint16(b, 0);
+		counts[SECTION_ADDITIONAL]++;
+	}
+
+	memmove(b->base, data, 2);
+	((unsigned char *)b->base)[2] = 0x80 | (data[2] & 0x79) |
+					(aa ? 0x04 : 0);
+	((unsigned char *)b->base)[3] = rcode;
+	setuint16(b, 4, 1);
+	setuint16(b, 6, counts[SECTION_ANSWER]);
+	setuint16(b, 8, counts[SECTION_AUTHORITY]);
+	setuint16(b, 10, counts[SECTION_ADDITIONAL]);
+
+	return (true);
+}
+
+static void
+reply_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	   isc_result_t eresult ISC_ATTR_UNUSED, void *arg) {
+	reply_t *reply = arg;
+
+	isc_nmhandle_detach(&reply->handle);
+	isc_mem_put(mctx, reply, sizeof(*reply));
+}
+
+static void
+reply_send(void *arg) {
+	reply_t *reply = arg;
+	isc_region_t region;
+
+	if (reply->timer != NULL) {
+		isc_timer_destroy(&reply->timer);
+	}
+
+	isc_buffer_usedregion(&reply->buffer, &region);
+	isc_nm_send(reply->handle, &region, reply_sent, reply);
+}
+
+static void
+server_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	    isc_region_t *region, void *arg) {
+	server_t *server = arg;
+	reply_t *reply = NULL;
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&upstream, 1);
+	if (losspct != 0 && isc_random_uniform(100) < losspct) {
+		atomic_fetch_add_relaxed(&dropped, 1);
+		return;
+	}
+
+	reply = isc_mem_get(mctx, sizeof(*reply));
+	*reply = (reply_t){ 0 };
+	isc_buffer_init(&reply->buffer, reply->data, sizeof(reply->data));
+	if (!respond(server, region, &reply->buffer)) {
+		isc_mem_put(mctx, reply, sizeof(*reply));
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &reply->handle);
+	if (delay == 0) {
+		reply_send(reply);
+	} else {
+		isc_interval_t interval;
+
+		isc_interval_set(&interval, delay / 1000,
+				 (delay % 1000) * 1000000);
+		isc_timer_create(isc_loop(), reply_send, reply, &reply->timer);
+		isc_timer_start(reply->timer, isc_timertype_once, &interval);
+	}
+}
+
+static void
+server_listen(server_t *server, uint32_t address) {
+	struct in_addr in = { .s_addr = htonl(address) };
+	isc_sockaddr_t addr;
+	isc_result_t result;
+
+	isc_sockaddr_fromin(&addr, &in, port);
+	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &addr,
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, server_recv,
+				  server, &server->sock);
+	CHECKRESULT(result, "isc_nm_listenudp");
+}
+
+/*
+ * The resolving side.
+ */
+
+static int
+compare_ns(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Merge the latencies measured on all the loops and print their
+ * percentiles.
+ */
+static void
+percentiles(void) {
+	static const double points[] = { 50, 90, 99, 99.9 };
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t *all = NULL;
+	size_t count = 0, n = 0;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		count += loopdata[i].nlatency;
+	}
+	if (count == 0) {
+		return;
+	}
+
+	all = isc_mem_cget(mctx, count, sizeof(all[0]));
+	for (uint32_t i = 0; i < nloops; i++) {
+		memmove(all + n, loopdata[i].latency,
+			loopdata[i].nlatency * sizeof(all[0]));
+		n += loopdata[i].nlatency;
+	}
+	qsort(all, count, sizeof(all[0]), compare_ns);
+
+	printf("latency:");
+	for (size_t i = 0; i < ARRAY_SIZE(points); i++) {
+		size_t at = (size_t)(points[i] / 100 * (count - 1));
+		printf(" p%g %.2f us", points[i], all[at] / 1000.0);
+	}
+	printf("\n");
+
+	isc_mem_cput(mctx, all, count, sizeof(all[0]));
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t sent = 0, hits = 0, fetches = 0, failed = 0;
+	uint64_t up = atomic_load_relaxed(&upstream);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		sent += loopdata[i].sent;
+		hits += loopdata[i].hits;
+		fetches += loopdata[i].fetches;
+		failed += loopdata[i].failed;
+	}
+
+	printf("%u loops, %u clients per loop, %u tlds, %u slds, "
+	       "%u hosts\n",
+	       nloops, nclients, ntlds, ntlds * nslds,
+	       ntlds * nslds * nhosts);
+	printf("%" PRIu64 " queries, %" PRIu64 " fetches, %" PRIu64
+	       " failed\n",
+	       sent, fetches, failed);
+	printf("%f s; %f queries/s; %f queries/s/loop\n", us / 1000000.0,
+	       sent / us * 1000000.0, sent / us * 1000000.0 / nloops);
+	if (sent != 0) {
+		printf("cache hit rate %.2f%%; %.3f upstream queries/query "
+		       "(%" PRIu64 " upstream, %" PRIu64 " dropped)\n",
+		       100.0 * hits / sent, (double)up / sent, up,
+		       atomic_load_relaxed(&dropped));
+	}
+	percentiles();
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		if (loopdata[i].latency != NULL) {
+			isc_mem_cput(mctx, loopdata[i].latency,
+				     loopdata[i].maxlatency,
+				     sizeof(loopdata[i].latency[0]));
+		}
+	}
+	isc_mem_cput(mctx, clients, nloops * nclients, sizeof(clients[0]));
+	isc_mem_cput(mctx, loopdata, nloops, sizeof(loopdata[0]));
+
+	dns_resolver_detach(&resolver);
+	dns_dispatch_detach(&dispatch);
+	dns_view_detach(&view);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+
+	for (unsigned int i = 0; i < nservers; i++) {
+		isc_nm_stoplistening(servers[i].sock);
+		isc_nmsocket_close(&servers[i].sock);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+addlatency(worker_t *worker, uint64_t ns) {
+	if (worker->nlatency == worker->maxlatency) {
+		size_t size = ISC_MAX(1024, worker->maxlatency * 2);
+		worker->latency = isc_mem_creget(mctx, worker->latency,
+						 worker->maxlatency, size,
+						 sizeof(worker->latency[0]));
+		worker->maxlatency = size;
+	}
+	worker->latency[worker->nlatency++] = ns;
+}
+
+/*
+ * Pick the next name to look up: a random name that does not exist, or
+ * a host chosen by popularity.
+ */
+static void
+pickname(dns_fixedname_t *fname) {
+	char text[256];
+	isc_result_t result;
+
+	if (randompct != 0 && isc_random_uniform(100) < randompct) {
+		snprintf(text, sizeof(text), "x%08x.d%u.tld%u.",
+			 isc_random32(), isc_random_uniform(nslds),
+			 isc_random_uniform(ntlds));
+	} else {
+		double u = isc_random32() / 4294967296.0 * cdf[nnames - 1];
+		size_t lo = 0, hi = nnames - 1;
+
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (cdf[mid] < u) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		snprintf(text, sizeof(text), "h%zu.d%zu.tld%zu.", lo % nhosts,
+			 lo / nhosts % nslds, lo / nhosts / nslds);
+	}
+
+	result = dns_name_fromstring(dns_fixedname_initname(fname), text,
+				     dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+}
+
+static void
+client_done(client_t *client) {
+	worker_t *worker = client->worker;
+
+	INSIST(worker->active > 0);
+	if (--worker->active == 0 &&
+	    atomic_fetch_sub_release(&running, 1) == 1)
+	{
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+fetch_done(void *arg);
+
+/*
+ * Look up names from the cache until one is missing and has to be
+ * fetched, or until the share of queries of the loop has been sent.
+ */
+static void
+client_next(client_t *client) {
+	worker_t *worker = client->worker;
+
+	while (worker->sent < queries) {
+		dns_fixedname_t ffound;
+		dns_name_t *name = NULL;
+		isc_result_t result;
+
+		worker->sent++;
+		pickname(&client->fname);
+		name = dns_fixedname_name(&client->fname);
+		client->start = isc_time_monotonic();
+
+		dns_rdataset_init(&client->rdataset);
+		result = dns_view_find(view, name, dns_rdatatype_a, 0, 0,
+				       false, false, NULL, NULL,
+				       dns_fixedname_initname(&ffound),
+				       &client->rdataset, NULL);
+		if (dns_rdataset_isassociated(&client->rdataset)) {
+			dns_rdataset_disassociate(&client->rdataset);
+		}
+
+		switch (result) {
+		case ISC_R_SUCCESS:
+		case DNS_R_NCACHENXDOMAIN:
+		case DNS_R_NCACHENXRRSET:
+			worker->hits++;
+			addlatency(worker,
+				   isc_time_monotonic() - client->start);
+			continue;
+		default:
+			break;
+		}
+
+		worker->fetches++;
+		result = dns_resolver_createfetch(
+			resolver, name, dns_rdatatype_a, NULL, NULL, NULL,
+			NULL, 0, 0, 0, NULL, isc_loop(), fetch_done, client,
+			&client->rdataset, NULL, &client->fetch);
+		if (result == ISC_R_SUCCESS) {
+			return;
+		}
+		worker->failed++;
+	}
+
+	client_done(client);
+}
+
+static void
+fetch_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	client_t *client = resp->arg;
+	worker_t *worker = client->worker;
+
+	switch (resp->result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NXRRSET:
+	case DNS_R_NCACHENXRRSET:
+		addlatency(worker, isc_time_monotonic() - client->start);
+		break;
+	default:
+		worker->failed++;
+	}
+
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	if (dns_rdataset_isassociated(resp->rdataset)) {
+		dns_rdataset_disassociate(resp->rdataset);
+	}
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+	dns_resolver_destroyfetch(&client->fetch);
+
+	client_next(client);
+}
+
+static void
+client_start(void *arg) {
+	client_next(arg);
+}
+
+/*
+ * The hints point at the root server of the hierarchy.
+ */
+static void
+sethints(void) {
+	static char hints[] = ". 3600000 NS ns.\n"
+			      "ns. 3600000 A 127.0.0.1\n";
+	dns_rdatacallbacks_t callbacks;
+	isc_buffer_t source;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "qpzone", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+
+	isc_buffer_init(&source, hints, strlen(hints));
+	isc_buffer_add(&source, strlen(hints));
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_beginload");
+	result = dns_master_loadbuffer(&source, &db->origin, &db->origin,
+				       dns_rdataclass_in, DNS_MASTER_HINT,
+				       &callbacks, mctx);
+	CHECKRESULT(result, "dns_master_loadbuffer");
+	result = dns_db_endload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_endload");
+
+	dns_view_sethints(view, db);
+	dns_db_detach(&db);
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	isc_sockaddr_t local;
+	isc_result_t result;
+	unsigned int n = 0;
+
+	nservers = 1 + ntlds + nsldservers;
+	servers = isc_mem_cget(mctx, nservers, sizeof(servers[0]));
+	servers[n] = (server_t){ .level = ROOT };
+	server_listen(&servers[n++], ADDR_ROOT);
+	for (unsigned int i = 0; i < ntlds; i++) {
+		servers[n] = (server_t){ .level = TLD, .index = i };
+		server_listen(&servers[n++], ADDR_TLD + i + 1);
+	}
+	for (unsigned int i = 0; i < nsldservers; i++) {
+		servers[n] = (server_t){ .level = SLD, .index = i };
+		server_listen(&servers[n++], ADDR_SLD + i + 1);
+	}
+
+	result = dns_test_makeview("bench", true, true, &view);
+	CHECKRESULT(result, "dns_test_makeview");
+	dns_view_setdstport(view, port);
+	sethints();
+
+	dispatchmgr = dns_view_getdispatchmgr(view);
+	isc_sockaddr_any(&local);
+	result = dns_dispatch_createudp(dispatchmgr, &local, &dispatch);
+	CHECKRESULT(result, "dns_dispatch_createudp");
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	isc_tlsctx_cache_create(mctx, &tlsctx_cache);
+	result = dns_view_createresolver(view, netmgr, 0, tlsctx_cache,
+					 dispatch, NULL);
+	CHECKRESULT(result, "dns_view_createresolver");
+	dns_view_freeze(view);
+	result = dns_view_getresolver(view, &resolver);
+	CHECKRESULT(result, "dns_view_getresolver");
+
+	loopdata = isc_mem_cget(mctx, nloops, sizeof(loopdata[0]));
+	clients = isc_mem_cget(mctx, nloops * nclients, sizeof(clients[0]));
+
+	atomic_init(&upstream, 0);
+	atomic_init(&dropped, 0);
+	atomic_init(&running, nloops);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		loopdata[i].active = nclients;
+		for (unsigned int j = 0; j < nclients; j++) {
+			client_t *client = &clients[i * nclients + j];
+			client->worker = &loopdata[i];
+			isc_async_run(isc_loop_get(loopmgr, i), client_start,
+				      client);
+		}
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: resolve [-c clients] [-q queries] [-p port] "
+			"[-T tlds] [-S slds] [-H hosts]\n"
+			"               [-K servers] [-s zipf] [-r random%%] "
+			"[-d delay-ms] [-l loss%%] [-t ttl]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	double sum = 0;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "c:d:H:K:l:p:q:r:S:s:T:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			nclients = strtoul(optarg, NULL, 10);
+			break;
+		case 'd':
+			delay = strtoul(optarg, NULL, 10);
+			break;
+		case 'H':
+			nhosts = strtoul(optarg, NULL, 10);
+			break;
+		case 'K':
+			nsldservers = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			losspct = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'q':
+			queries = strtoull(optarg, NULL, 10);
+			break;
+		case 'r':
+			randompct = strtoul(optarg, NULL, 10);
+			break;
+		case 'S':
+			nslds = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			zipf = strtod(optarg, NULL);
+			break;
+		case 'T':
+			ntlds = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			ttl = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || nclients == 0 || ntlds == 0 || ntlds > 254 ||
+	    nslds == 0 || nhosts == 0 || nsldservers == 0 ||
+	    nsldservers > 254 || randompct > 100 || losspct >= 100 ||
+	    zipf < 0)
+	{
+		usage();
+	}
+
+	setup_mctx(NULL);
+
+	/* cdf[i] is the weight of the i + 1 most popular hosts */
+	nnames = (size_t)ntlds * nslds * nhosts;
+	cdf = isc_mem_cget(mctx, nnames, sizeof(cdf[0]));
+	for (size_t i = 0; i < nnames; i++) {
+		sum += 1.0 / pow((double)(i + 1), zipf);
+		cdf[i] = sum;
+	}
+
+	setup_loopmgr(NULL);
+	setup_netmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	teardown_netmgr(NULL);
+	teardown_loopmgr(NULL);
+
+	isc_mem_cput(mctx, servers, nservers, sizeof(servers[0]));
+	isc_mem_cput(mctx, cdf, nnames, sizeof(cdf[0]));
+	teardown_mctx(NULL);
+
+	return (0);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how fast every loop can increment the same few statistics
+ * counters, as happens for the per-query server statistics, first with
+ * a single set of counters shared by all loops and then with counters
+ * sharded per loop.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/stats.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define COUNTERS   4
+#define INCREMENTS (16 * 1024 * 1024)
+
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_mem_t *mctx = NULL;
+static isc_stats_t *stats = NULL;
+static bool sharded = false;
+
+static atomic_uint_fast32_t running;
+static isc_time_t t0;
+
+static void
+start(void *arg);
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t total = (uint64_t)nloops * INCREMENTS;
+	uint64_t counted = 0;
+
+	for (int i = 0; i < COUNTERS; i++) {
+		counted += isc_stats_get_counter(stats, i);
+	}
+	INSIST(counted == total);
+
+	printf("%-8s %u loops, %" PRIu64 " increments: %f s; "
+	       "%f increments/us; %f increments/us/loop\n",
+	       sharded ? "sharded" : "shared", nloops, total, us / 1000000.0,
+	       total / us, total / us / nloops);
+
+	isc_stats_detach(&stats);
+
+	if (!sharded) {
+		sharded = true;
+		start(NULL);
+		return;
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+increments(void *arg ISC_ATTR_UNUSED) {
+	for (unsigned int i = 0; i < INCREMENTS; i++) {
+		isc_stats_increment(stats, i % COUNTERS);
+	}
+
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+start(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	if (sharded) {
+		isc_stats_create_sharded(mctx, &stats, COUNTERS);
+	} else {
+		isc_stats_create(mctx, &stats, COUNTERS);
+	}
+
+	atomic_init(&running, nloops);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), increments, NULL);
+	}
+}
+
+int
+main(void) {
+	uint32_t nloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+
+	if (env_workers != NULL) {
+		nloops = atoi(env_workers);
+	} else {
+		nloops = isc_os_ncpus();
+	}
+	INSIST(nloops > 0);
+
+	isc_mem_create(&mctx);
+	isc_loopmgr_create(mctx, nloops, &loopmgr);
+	isc_loop_setup(isc_loop_main(loopmgr), start, NULL);
+	isc_loopmgr_run(loopmgr);
+	isc_loopmgr_destroy(&loopmgr);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure zone table lookups with many zones.  Every loop looks up
+ * names below randomly chosen zones, first with dns_zt_find(), which
+ * attaches and detaches each zone it finds, then with dns_zt_lookup()
+ * inside an RCU read-side critical section, which leaves the zone
+ * reference counts alone.  Several loops finding the same zones show
+ * the cost of the reference count traffic.
+ *
+ * Usage: zt [-n lookups] [-z zones]
+ *
+ * Each loop does the given number of lookups in each pass; the number
+ * of loops is taken from ISC_TASK_WORKERS.  Try -z 1000000 and
+ * -z 10000000 to see how the lookups scale with the zone count.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+#include <dns/zt.h>
+
+#include <tests/dns.h>
+
+#define NAMES 65536
+
+static size_t zonecount = 100000;
+static size_t perloop = 1000000;
+
+static dns_view_t *view = NULL;
+static dns_zt_t *zt = NULL;
+static dns_fixedname_t *names = NULL;
+
+static atomic_uint_fast32_t running;
+static atomic_uint_fast64_t found;
+static isc_time_t t0;
+static bool withref = true;
+
+static void
+run(void *arg);
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+makezones(void) {
+	char buf[DNS_NAME_FORMATSIZE];
+	isc_time_t t1;
+	isc_result_t result;
+
+	t0 = isc_time_now_hires();
+	for (size_t i = 0; i < zonecount; i++) {
+		dns_zone_t *zone = NULL;
+		dns_fixedname_t fixed;
+		dns_name_t *origin = dns_fixedname_initname(&fixed);
+
+		snprintf(buf, sizeof(buf), "z%zu.example.", i);
+		result = dns_name_fromstring(origin, buf, dns_rootname, 0,
+					     NULL);
+		CHECKRESULT(result, "dns_name_fromstring");
+
+		dns_zone_create(&zone, mctx, 0);
+		dns_zone_settype(zone, dns_zone_primary);
+		result = dns_zone_setorigin(zone, origin);
+		CHECKRESULT(result, "dns_zone_setorigin");
+		dns_zone_setclass(zone, dns_rdataclass_in);
+
+		result = dns_zt_mount(zt, zone);
+		CHECKRESULT(result, "dns_zt_mount");
+		dns_zone_detach(&zone);
+	}
+	t1 = isc_time_now_hires();
+	printf("%zu zones mounted in %f s\n", zonecount,
+	       isc_time_microdiff(&t1, &t0) / 1000000.0);
+
+	names = isc_mem_cget(mctx, NAMES, sizeof(names[0]));
+	for (size_t i = 0; i < NAMES; i++) {
+		dns_name_t *name = dns_fixedname_initname(&names[i]);
+
+		snprintf(buf, sizeof(buf), "www.z%u.example.",
+			 isc_random_uniform(zonecount));
+		result = dns_name_fromstring(name, buf, dns_rootname, 0, NULL);
+		CHECKRESULT(result, "dns_name_fromstring");
+	}
+}
+
+static void
+start(void) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	atomic_init(&running, nloops);
+	atomic_init(&found, 0);
+	t0 = isc_time_now_hires();
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), run, NULL);
+	}
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	isc_time_t t1 = isc_time_now_hires();
+	double us = (double)isc_time_microdiff(&t1, &t0);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+	uint64_t lookups = (uint64_t)perloop * nloops;
+
+	printf("%-13s %u loops, %" PRIu64 " lookups, %" PRIu64
+	       " found, %f s, %f lookups/us/loop\n",
+	       withref ? "dns_zt_find" : "dns_zt_lookup", nloops, lookups,
+	       (uint64_t)atomic_load(&found), us / 1000000.0,
+	       lookups / us / nloops);
+
+	if (withref) {
+		withref = false;
+		start();
+		return;
+	}
+
+	isc_mem_cput(mctx, names, NAMES, sizeof(names[0]));
+	dns_zt_detach(&zt);
+	dns_view_detach(&view);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+run(void *arg ISC_ATTR_UNUSED) {
+	uint64_t hits = 0;
+	size_t next = isc_random_uniform(NAMES);
+
+	for (size_t i = 0; i < perloop; i++) {
+		dns_name_t *name = dns_fixedname_name(&names[next]);
+		dns_zone_t *zone = NULL;
+		isc_result_t result;
+
+		if (withref) {
+			result = dns_zt_find(zt, name, 0, &zone);
+			if (zone != NULL) {
+				dns_zone_detach(&zone);
+			}
+		} else {
+			rcu_read_lock();
+			result = dns_zt_lookup(zt, name, 0, &zone);
+			rcu_read_unlock();
+		}
+		if (result == DNS_R_PARTIALMATCH) {
+			hits++;
+		}
+		next = (next + 1) % NAMES;
+	}
+
+	atomic_fetch_add_relaxed(&found, hits);
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_async_run(isc_loop_main(loopmgr), finish, NULL);
+	}
+}
+
+static void
+startup(void *arg ISC_ATTR_UNUSED) {
+	isc_result_t result;
+
+	result = dns_test_makeview("bench", false, false, &view);
+	CHECKRESULT(result, "dns_test_makeview");
+	dns_zt_create(mctx, view, &zt);
+
+	makezones();
+	start();
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: zt [-n lookups] [-z zones]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:z:")) != -1) {
+		switch (ch) {
+		case 'n':
+			perloop = strtoull(optarg, NULL, 10);
+			break;
+		case 'z':
+			zonecount = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || perloop == 0 || zonecount == 0 ||
+	    zonecount > UINT32_MAX)
+	{
+		usage();
+	}
+
+	/*
+	 * Not setup_mctx(), which turns on allocation recording.
+	 */
+	isc_mem_create(&mctx);
+
+	setup_loopmgr(NULL);
+
+	isc_loop_setup(mainloop, startup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	/* The zones are detached from the table after a grace period */
+	rcu_barrier();
+
+	teardown_loopmgr(NULL);
+	teardown_mctx(NULL);
+
+	return (0);
+}
@@ -0,0 +1,490 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Conformance tests for the cache database implementations: each test
+ * is run against every implementation in 'engines', and checks the
+ * behaviour described under "Cache Database Implementations" in
+ * dns/db.h.  A new cache implementation should be added to the list.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/stats.h>
+
+#include <tests/dns.h>
+
+static const char *engines[] = { "qpcache", "rbt" };
+
+static dns_db_t *
+createdb(const char *engine) {
+	char *argv[1] = { (char *)mctx };
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_db_create(mctx, engine, dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 1, argv, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_db_iscache(db));
+
+	return (db);
+}
+
+/*
+ * Add an RRset with a single record to 'db', and check the result.
+ * If 'added' is not NULL, it is bound to the RRset in the cache.
+ */
+static void
+addrrset(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	 const char *text, dns_ttl_t ttl, dns_trust_t trust,
+	 unsigned int options, isc_stdtime_t now, dns_rdataset_t *added,
+	 isc_result_t expect) {
+	unsigned char data[256];
+	dns_fixedname_t fixed;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type,
+					  data, sizeof(data), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, options,
+				    added);
+	assert_int_equal(result, expect);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Look up 'owner'/'type' and check the result and the name found.
+ * If 'rdataset' is not NULL, it is left bound to the RRset found.
+ */
+static void
+lookup(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+       unsigned int options, isc_stdtime_t now, isc_result_t expect,
+       const char *expectname, dns_rdataset_t *rdataset) {
+	dns_fixedname_t fixed, ffound, fexpect;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t tmp;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fixed);
+	dns_rdataset_init(&tmp);
+	if (rdataset == NULL) {
+		rdataset = &tmp;
+	}
+
+	result = dns_db_find(db, dns_fixedname_name(&fixed), NULL, type,
+			     options, now, NULL, found, rdataset, NULL);
+	assert_int_equal(result, expect);
+
+	if (expectname != NULL) {
+		dns_test_namefromstring(expectname, &fexpect);
+		assert_true(
+			dns_name_equal(found, dns_fixedname_name(&fexpect)));
+	}
+
+	if (dns_rdataset_isassociated(&tmp)) {
+		dns_rdataset_disassociate(&tmp);
+	}
+}
+
+/* creation: only implementations with cache semantics are accepted */
+ISC_LOOP_TEST_IMPL(create) {
+	isc_stats_t *stats = NULL;
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	isc_stats_create(mctx, &stats, dns_cachestatscounter_max);
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		db = createdb(engines[i]);
+		assert_false(dns_db_iszone(db));
+
+		result = dns_db_setcachestats(db, stats);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_db_detach(&db);
+
+		result = dns_cache_create(loopmgr, dns_rdataclass_in, "test",
+					  engines[i], mctx, &cache);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_string_equal(dns_cache_getdbtype(cache), engines[i]);
+		dns_cache_detach(&cache);
+	}
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_string_equal(dns_cache_getdbtype(cache), CACHEDB_DEFAULT);
+	dns_cache_detach(&cache);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", "qpzone",
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	assert_null(cache);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test",
+				  "nonexistent", mctx, &cache);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_null(cache);
+
+	isc_stats_detach(&stats);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* find: answers, delegations and TTL expiry */
+ISC_LOOP_TEST_IMPL(find) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+
+		addrrset(db, "example", dns_rdatatype_ns, "ns.example.", 3600,
+			 dns_trust_authauthority, 0, now, NULL, ISC_R_SUCCESS);
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.1", 300,
+			 dns_trust_answer, 0, now, &rdataset, ISC_R_SUCCESS);
+		assert_int_equal(rdataset.type, dns_rdatatype_a);
+		assert_int_equal(rdataset.ttl, 300);
+		dns_rdataset_disassociate(&rdataset);
+
+		/* The TTL of the RRset found counts down. */
+		lookup(db, "www.example", dns_rdatatype_a, 0, now + 100,
+		       ISC_R_SUCCESS, "www.example", &rdataset);
+		assert_int_equal(rdataset.type, dns_rdatatype_a);
+		assert_int_equal(rdataset.ttl, 200);
+		assert_int_equal(dns_rdataset_count(&rdataset), 1);
+		dns_rdataset_disassociate(&rdataset);
+
+		/* Missing data is answered with the closest zone cut. */
+		lookup(db, "www.example", dns_rdatatype_aaaa, 0, now,
+		       DNS_R_DELEGATION, "example", &rdataset);
+		assert_int_equal(rdataset.type, dns_rdatatype_ns);
+		dns_rdataset_disassociate(&rdataset);
+
+		lookup(db, "other.example", dns_rdatatype_a, 0, now,
+		       DNS_R_DELEGATION, "example", NULL);
+		lookup(db, "www.example.org", dns_rdatatype_a, 0, now,
+		       ISC_R_NOTFOUND, NULL, NULL);
+
+		/* Expired data is not returned. */
+		lookup(db, "www.example", dns_rdatatype_a, 0, now + 301,
+		       DNS_R_DELEGATION, "example", NULL);
+		lookup(db, "www.example", dns_rdatatype_a, 0, now + 3601,
+		       ISC_R_NOTFOUND, NULL, NULL);
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* findzonecut: the deepest zone cut at or above a name */
+ISC_LOOP_TEST_IMPL(findzonecut) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_fixedname_t fname, ffound, fexpect;
+		dns_name_t *found = dns_fixedname_initname(&ffound);
+		dns_rdataset_t rdataset;
+		isc_result_t result;
+
+		dns_rdataset_init(&rdataset);
+		dns_test_namefromstring("example", &fexpect);
+
+		addrrset(db, "example", dns_rdatatype_ns, "ns.example.", 3600,
+			 dns_trust_authauthority, 0, now, NULL, ISC_R_SUCCESS);
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.1", 300,
+			 dns_trust_answer, 0, now, NULL, ISC_R_SUCCESS);
+
+		dns_test_namefromstring("www.example", &fname);
+		result = dns_db_findzonecut(db, dns_fixedname_name(&fname), 0,
+					    now, NULL, found, NULL, &rdataset,
+					    NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(
+			dns_name_equal(found, dns_fixedname_name(&fexpect)));
+		assert_int_equal(rdataset.type, dns_rdatatype_ns);
+		dns_rdataset_disassociate(&rdataset);
+
+		result = dns_db_findzonecut(db, dns_fixedname_name(&fexpect),
+					    0, now, NULL, found, NULL,
+					    &rdataset, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(
+			dns_name_equal(found, dns_fixedname_name(&fexpect)));
+		dns_rdataset_disassociate(&rdataset);
+
+		result = dns_db_findzonecut(db, dns_fixedname_name(&fexpect),
+					    DNS_DBFIND_NOEXACT, now, NULL,
+					    found, NULL, &rdataset, NULL);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_false(dns_rdataset_isassociated(&rdataset));
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* addrdataset: less trusted data does not replace more trusted data */
+ISC_LOOP_TEST_IMPL(trust) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.1", 300,
+			 dns_trust_answer, 0, now, NULL, ISC_R_SUCCESS);
+
+		/* Less trusted: the existing RRset is kept and bound. */
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.2", 300,
+			 dns_trust_additional, 0, now, &rdataset,
+			 DNS_R_UNCHANGED);
+		assert_int_equal(rdataset.trust, dns_trust_answer);
+		assert_int_equal(dns_rdataset_first(&rdataset),
+				 ISC_R_SUCCESS);
+		dns_rdataset_current(&rdataset, &rdata);
+		assert_int_equal(rdata.data[3], 1);
+		dns_rdata_reset(&rdata);
+		dns_rdataset_disassociate(&rdataset);
+
+		/* More trusted: the RRset is replaced. */
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.3", 300,
+			 dns_trust_authanswer, 0, now, NULL, ISC_R_SUCCESS);
+		lookup(db, "www.example", dns_rdatatype_a, 0, now,
+		       ISC_R_SUCCESS, "www.example", &rdataset);
+		assert_int_equal(rdataset.trust, dns_trust_authanswer);
+		assert_int_equal(dns_rdataset_first(&rdataset),
+				 ISC_R_SUCCESS);
+		dns_rdataset_current(&rdataset, &rdata);
+		assert_int_equal(rdata.data[3], 3);
+		dns_rdata_reset(&rdata);
+		dns_rdataset_disassociate(&rdataset);
+
+		/* Forced: the RRset is replaced regardless of trust. */
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.4", 300,
+			 dns_trust_answer, DNS_DBADD_FORCE, now, NULL,
+			 ISC_R_SUCCESS);
+		lookup(db, "www.example", dns_rdatatype_a, 0, now,
+		       ISC_R_SUCCESS, "www.example", &rdataset);
+		assert_int_equal(dns_rdataset_first(&rdataset),
+				 ISC_R_SUCCESS);
+		dns_rdataset_current(&rdataset, &rdata);
+		assert_int_equal(rdata.data[3], 4);
+		dns_rdataset_disassociate(&rdataset);
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* deleterdataset: deleted data is gone, bound rdatasets stay valid */
+ISC_LOOP_TEST_IMPL(delete) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_fixedname_t fixed;
+		dns_dbnode_t *node = NULL;
+		dns_rdataset_t rdataset;
+		isc_result_t result;
+
+		dns_rdataset_init(&rdataset);
+		dns_test_namefromstring("www.example", &fixed);
+
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.1", 300,
+			 dns_trust_answer, 0, now, NULL, ISC_R_SUCCESS);
+		lookup(db, "www.example", dns_rdatatype_a, 0, now,
+		       ISC_R_SUCCESS, "www.example", &rdataset);
+
+		result = dns_db_findnode(db, dns_fixedname_name(&fixed), false,
+					 &node);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_deleterdataset(db, node, NULL, dns_rdatatype_a,
+					       0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+
+		lookup(db, "www.example", dns_rdatatype_a, 0, now,
+		       ISC_R_NOTFOUND, NULL, NULL);
+
+		assert_int_equal(dns_rdataset_count(&rdataset), 1);
+		dns_rdataset_disassociate(&rdataset);
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* serve-stale: expired data is only returned when asked for */
+ISC_LOOP_TEST_IMPL(stale) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_rdataset_t rdataset;
+		dns_ttl_t ttl = 0;
+		isc_result_t result;
+
+		dns_rdataset_init(&rdataset);
+
+		result = dns_db_setservestalettl(db, 3600);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_getservestalettl(db, &ttl);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(ttl, 3600);
+
+		addrrset(db, "www.example", dns_rdatatype_a, "192.0.2.1", 1,
+			 dns_trust_answer, 0, now, NULL, ISC_R_SUCCESS);
+
+		lookup(db, "www.example", dns_rdatatype_a, 0, now + 10,
+		       ISC_R_NOTFOUND, NULL, NULL);
+
+		lookup(db, "www.example", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+		       now + 10, ISC_R_SUCCESS, "www.example", &rdataset);
+		assert_int_equal(rdataset.attributes & DNS_RDATASETATTR_STALE,
+				 DNS_RDATASETATTR_STALE);
+		dns_rdataset_disassociate(&rdataset);
+
+		lookup(db, "www.example", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+		       now + 3602, ISC_R_NOTFOUND, NULL, NULL);
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* createiterator: every name with data is visited */
+ISC_LOOP_TEST_IMPL(iterate) {
+	static const char *names[] = { "example", "www.example",
+				       "mail.example", "example.org" };
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < ARRAY_SIZE(engines); i++) {
+		dns_db_t *db = createdb(engines[i]);
+		dns_dbiterator_t *iter = NULL;
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		bool seen[ARRAY_SIZE(names)] = { 0 };
+		isc_result_t result;
+
+		for (size_t n = 0; n < ARRAY_SIZE(names); n++) {
+			addrrset(db, names[n], dns_rdatatype_a, "192.0.2.1",
+				 300, dns_trust_answer, 0, now, NULL,
+				 ISC_R_SUCCESS);
+		}
+		assert_true(dns_db_nodecount(db, dns_dbtree_main) >=
+			    ARRAY_SIZE(names));
+
+		result = dns_db_createiterator(db, 0, &iter);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		for (result = dns_dbiterator_first(iter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_dbiterator_next(iter))
+		{
+			dns_dbnode_t *node = NULL;
+
+			result = dns_dbiterator_current(iter, &node, name);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			dns_dbiterator_pause(iter);
+			dns_db_detachnode(db, &node);
+
+			for (size_t n = 0; n < ARRAY_SIZE(names); n++) {
+				dns_fixedname_t fexpect;
+
+				dns_test_namefromstring(names[n], &fexpect);
+				if (dns_name_equal(
+					    name, dns_fixedname_name(&fexpect)))
+				{
+					assert_false(seen[n]);
+					seen[n] = true;
+				}
+			}
+		}
+		assert_int_equal(result, ISC_R_NOMORE);
+		dns_dbiterator_destroy(&iter);
+
+		for (size_t n = 0; n < ARRAY_SIZE(names); n++) {
+			assert_true(seen[n]);
+		}
+
+		dns_db_detach(&db);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(create, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(find, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(findzonecut, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(trust, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(delete, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(stale, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(iterate, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
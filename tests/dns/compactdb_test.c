@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#include "compactdb_p.h"
+
+#define TESTDIR TESTS_DIR "/testdata/compactdb/"
+
+static dns_db_t *
+loadzone(const char *origin, const char *file, dns_view_t *view) {
+	dns_fixedname_t fixed;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(origin, &fixed);
+
+	result = dns_db_create(mctx, "compact", dns_fixedname_name(&fixed),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	if (view != NULL) {
+		dns__compactdb_share(db, view);
+	}
+
+	result = dns_db_load(db, file, dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (db);
+}
+
+static dns_db_t *
+loaddb(void) {
+	return (loadzone("example.", TESTDIR "example.db", NULL));
+}
+
+static void
+checkfind(dns_db_t *db, dns_dbversion_t *version, const char *qname,
+	  dns_rdatatype_t type, unsigned int options, isc_result_t expect,
+	  const char *expectname, unsigned int count) {
+	dns_fixedname_t fname, ffound, fexpect;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(qname, &fname);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), version, type,
+			     options, 0, &node, foundname, &rdataset, NULL);
+	assert_int_equal(result, expect);
+
+	if (expectname != NULL) {
+		dns_test_namefromstring(expectname, &fexpect);
+		assert_true(dns_name_equal(foundname,
+					   dns_fixedname_name(&fexpect)));
+	}
+	if (count != 0) {
+		assert_true(dns_rdataset_isassociated(&rdataset));
+		assert_int_equal(dns_rdataset_count(&rdataset), count);
+		dns_rdataset_disassociate(&rdataset);
+	} else {
+		assert_false(dns_rdataset_isassociated(&rdataset));
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+}
+
+static void
+findtests(dns_db_t *db) {
+	dns_fixedname_t fname, ffound;
+	dns_name_t *foundname = NULL;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	checkfind(db, NULL, "www.example.", dns_rdatatype_a, 0,
+		  ISC_R_SUCCESS, "www.example.", 2);
+	checkfind(db, NULL, "www.example.", dns_rdatatype_aaaa, 0,
+		  ISC_R_SUCCESS, "www.example.", 1);
+	checkfind(db, NULL, "www.example.", dns_rdatatype_mx, 0,
+		  DNS_R_NXRRSET, "www.example.", 0);
+	checkfind(db, NULL, "alias.example.", dns_rdatatype_a, 0,
+		  DNS_R_CNAME, "alias.example.", 1);
+	checkfind(db, NULL, "b.c.example.", dns_rdatatype_a, 0,
+		  DNS_R_EMPTYNAME, NULL, 0);
+	checkfind(db, NULL, "c.example.", dns_rdatatype_a, 0,
+		  DNS_R_EMPTYNAME, NULL, 0);
+	checkfind(db, NULL, "nonexistent.example.", dns_rdatatype_a, 0,
+		  DNS_R_NXDOMAIN, NULL, 0);
+	checkfind(db, NULL, "x.www.example.", dns_rdatatype_a, 0,
+		  DNS_R_NXDOMAIN, NULL, 0);
+	checkfind(db, NULL, "any.wild.example.", dns_rdatatype_txt, 0,
+		  ISC_R_SUCCESS, "any.wild.example.", 1);
+	checkfind(db, NULL, "any.wild.example.", dns_rdatatype_txt,
+		  DNS_DBFIND_NOWILD, DNS_R_NXDOMAIN, NULL, 0);
+	checkfind(db, NULL, "www.sub.example.", dns_rdatatype_a, 0,
+		  DNS_R_DELEGATION, "sub.example.", 1);
+	checkfind(db, NULL, "sub.example.", dns_rdatatype_a, 0,
+		  DNS_R_DELEGATION, "sub.example.", 1);
+	checkfind(db, NULL, "sub.example.", dns_rdatatype_ds, 0,
+		  DNS_R_NXRRSET, "sub.example.", 0);
+	checkfind(db, NULL, "ns.sub.example.", dns_rdatatype_a,
+		  DNS_DBFIND_GLUEOK, DNS_R_GLUE, "ns.sub.example.", 1);
+	checkfind(db, NULL, "x.dname.example.", dns_rdatatype_a, 0,
+		  DNS_R_DNAME, "dname.example.", 1);
+	checkfind(db, NULL, "www.example.net.", dns_rdatatype_a, 0,
+		  ISC_R_NOTFOUND, NULL, 0);
+
+	/* the wildcard answer carries the query name */
+	dns_test_namefromstring("any.wild.example.", &fname);
+	foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_txt, 0, 0, &node, foundname,
+			     &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(foundname->attributes.wildcard);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+}
+
+/* lookups in a compact zone return what qpzone would */
+ISC_LOOP_TEST_IMPL(find) {
+	dns_db_t *db = loaddb();
+
+	findtests(db);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* zones sharing a trie find their own names, and the same answers */
+ISC_LOOP_TEST_IMPL(shared) {
+	dns_view_t *view = NULL;
+	dns_db_t *db = NULL, *subdb = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_result_t result;
+
+	result = dns_test_makeview("view", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	view->sharedzonetrie = true;
+
+	db = loadzone("example.", TESTDIR "example.db", view);
+	subdb = loadzone("sub.example.", TESTDIR "sub.example.db", view);
+	assert_non_null(view->zonetrie);
+
+	findtests(db);
+
+	/* ns.sub.example is in both zones */
+	checkfind(subdb, NULL, "ns.sub.example.", dns_rdatatype_a, 0,
+		  ISC_R_SUCCESS, "ns.sub.example.", 1);
+	checkfind(subdb, NULL, "sub.example.", dns_rdatatype_ns, 0,
+		  ISC_R_SUCCESS, "sub.example.", 1);
+	checkfind(subdb, NULL, "www.sub.example.", dns_rdatatype_a, 0,
+		  ISC_R_SUCCESS, "www.sub.example.", 1);
+	checkfind(subdb, NULL, "www.example.", dns_rdatatype_a, 0,
+		  ISC_R_NOTFOUND, NULL, 0);
+
+	/* promoting a zone takes its names out of the trie */
+	result = dns_db_newversion(db, &version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, false);
+
+	checkfind(db, NULL, "www.sub.example.", dns_rdatatype_a, 0,
+		  DNS_R_DELEGATION, "sub.example.", 1);
+	checkfind(subdb, NULL, "ns.sub.example.", dns_rdatatype_a, 0,
+		  ISC_R_SUCCESS, "ns.sub.example.", 1);
+
+	dns_db_detach(&subdb);
+	dns_db_detach(&db);
+	dns_view_detach(&view);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* the iterator walks the names in DNSSEC order */
+ISC_LOOP_TEST_IMPL(iterate) {
+	static const char *names[] = {
+		"example.",	    "alias.example.", "a.b.c.example.",
+		"dname.example.",   "ns.example.",    "sub.example.",
+		"ns.sub.example.", "*.wild.example.", "www.example.",
+	};
+	dns_db_t *db = loaddb();
+	dns_dbiterator_t *iter = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_fixedname_t fixed, fexpect;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+	size_t i = 0;
+	unsigned int nsets = 0;
+	uint64_t records;
+
+	result = dns_db_createiterator(db, 0, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (result = dns_dbiterator_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		result = dns_dbiterator_current(iter, &node, name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(i < ARRAY_SIZE(names));
+
+		dns_test_namefromstring(names[i++], &fexpect);
+		assert_true(dns_name_equal(name, dns_fixedname_name(&fexpect)));
+
+		result = dns_db_allrdatasets(db, node, NULL, 0, 0, &rdsiter);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			nsets++;
+		}
+		assert_int_equal(result, ISC_R_NOMORE);
+		dns_rdatasetiter_destroy(&rdsiter);
+
+		dns_db_detachnode(db, &node);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(i, ARRAY_SIZE(names));
+	assert_int_equal(nsets, 11);
+
+	dns_test_namefromstring("x.www.example.", &fixed);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fixed));
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+
+	dns_dbiterator_destroy(&iter);
+
+	result = dns_db_getsize(db, NULL, &records, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(records, 12);
+	assert_int_equal(dns_db_nodecount(db, dns_dbtree_main),
+			 ARRAY_SIZE(names));
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* a new version promotes the zone; older readers still see the blob */
+ISC_LOOP_TEST_IMPL(promote) {
+	dns_db_t *db = loaddb();
+	dns_dbversion_t *ver = NULL, *new = NULL;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *name = NULL, *foundname = NULL;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_db_currentversion(db, &ver);
+
+	dns_test_namefromstring("www.example.", &fname);
+	name = dns_fixedname_name(&fname);
+	foundname = dns_fixedname_initname(&ffound);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, ver, dns_rdatatype_a, 0, 0, &node,
+			     foundname, &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* a node from the blob can be changed in the new version */
+	result = dns_db_deleterdataset(db, node, new, dns_rdatatype_a, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	checkfind(db, new, "www.example.", dns_rdatatype_a, 0, DNS_R_NXRRSET,
+		  "www.example.", 0);
+	checkfind(db, new, "alias.example.", dns_rdatatype_a, 0,
+		  DNS_R_CNAME, "alias.example.", 1);
+
+	dns_db_closeversion(db, &new, true);
+
+	/* the current version is now the full database's... */
+	checkfind(db, NULL, "www.example.", dns_rdatatype_a, 0, DNS_R_NXRRSET,
+		  "www.example.", 0);
+
+	/* ...but the old one still reads the blob */
+	checkfind(db, ver, "www.example.", dns_rdatatype_a, 0, ISC_R_SUCCESS,
+		  "www.example.", 2);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(find, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(shared, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(iterate, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(promote, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
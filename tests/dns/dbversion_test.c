@@ -354,6 +354,34 @@ ISC_RUN_TEST_IMPL(getnsec3parameters) {
 		db1, v2, &hash, &flags, &iterations, salt, &salt_length));
 }
 
+/*
+ * Check dns_db_versionid() returns distinct identifiers for distinct
+ * versions, and asserts with mis-matching db and version.
+ */
+ISC_RUN_TEST_IMPL(versionid) {
+	dns_dbversion_t *current = NULL;
+	uint64_t id1, id2, current_id;
+
+	UNUSED(state);
+
+	id1 = dns_db_versionid(db1, v1);
+	if (id1 == 0) {
+		/* Not supported by this database implementation */
+		skip();
+	}
+	id2 = dns_db_versionid(db2, v2);
+
+	dns_db_currentversion(db1, &current);
+	current_id = dns_db_versionid(db1, current);
+	dns_db_closeversion(db1, &current, false);
+
+	assert_int_not_equal(current_id, 0);
+	assert_int_not_equal(id1, id2);
+	assert_int_not_equal(id1, current_id);
+
+	check_assertion((void)dns_db_versionid(db1, v2));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(find, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(allrdatasets, setup_test, teardown_test)
@@ -364,6 +392,7 @@ ISC_TEST_ENTRY_CUSTOM(addrdataset, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(getnsec3parameters, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(attachversion, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(closeversion, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(versionid, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
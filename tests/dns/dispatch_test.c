@@ -738,7 +738,8 @@ ISC_LOOP_TEST_IMPL(dispatch_timeout_udp_response) {
 
 	/* Server */
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ONE, &udp_server_addr,
-				  noop_nameserver, NULL, &sock);
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, noop_nameserver,
+				  NULL, &sock);
 	assert_int_equal(result, ISC_R_SUCCESS);
 
 	/* ensure we stop listening after the test is done */
@@ -771,7 +772,8 @@ ISC_LOOP_TEST_IMPL(dispatch_getnext) {
 
 	/* Server */
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ONE, &udp_server_addr,
-				  nameserver, NULL, &sock);
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, nameserver,
+				  NULL, &sock);
 	assert_int_equal(result, ISC_R_SUCCESS);
 
 	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, sock);
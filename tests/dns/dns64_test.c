@@ -28,6 +28,7 @@
 #include <isc/string.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/dns64.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
@@ -227,8 +228,77 @@ ISC_RUN_TEST_IMPL(dns64_findprefix) {
 	multiple_prefixes();
 }
 
+/* matching and synthesising separately agrees with dns_dns64_aaaafroma() */
+ISC_RUN_TEST_IMPL(dns64_synthesize) {
+	unsigned char wkp[16] = { 0, 0x64, 0xff, 0x9b };
+	unsigned char expect[16] = { 0,	   0x64, 0xff, 0x9b, 0, 0, 0, 0,
+				     0,	   0,	 0,    0,    192, 0, 2, 1 };
+	unsigned char a[4] = { 192, 0, 2, 1 };
+	unsigned char aaaa[16];
+	struct in6_addr in6;
+	isc_netaddr_t prefix, client;
+	dns_acl_t *none = NULL;
+	dns_aclenv_t *env = NULL;
+	dns_dns64_t *open = NULL, *closed = NULL, *rec = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_aclenv_create(mctx, &env);
+	result = dns_acl_none(mctx, &none);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memmove(in6.s6_addr, wkp, sizeof(in6.s6_addr));
+	isc_netaddr_fromin6(&prefix, &in6);
+	in6.s6_addr[15] = 1;
+	isc_netaddr_fromin6(&client, &in6);
+
+	result = dns_dns64_create(mctx, &prefix, 96, NULL, NULL, NULL, NULL, 0,
+				  &open);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dns64_create(mctx, &prefix, 96, NULL, none, NULL, NULL, 0,
+				  &closed);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dns64_create(mctx, &prefix, 96, NULL, NULL, NULL, NULL,
+				  DNS_DNS64_RECURSIVE_ONLY, &rec);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dns64_match(open, &client, NULL, env, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	memset(aaaa, 0, sizeof(aaaa));
+	result = dns_dns64_synthesize(open, env, a, aaaa);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_memory_equal(aaaa, expect, sizeof(expect));
+
+	memset(aaaa, 0, sizeof(aaaa));
+	result = dns_dns64_aaaafroma(open, &client, NULL, env, 0, a, aaaa);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_memory_equal(aaaa, expect, sizeof(expect));
+
+	/* the client ACL is checked by the match alone */
+	result = dns_dns64_match(closed, &client, NULL, env, 0);
+	assert_int_equal(result, DNS_R_DISALLOWED);
+	result = dns_dns64_match(closed, NULL, NULL, env, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dns64_aaaafroma(closed, &client, NULL, env, 0, a, aaaa);
+	assert_int_equal(result, DNS_R_DISALLOWED);
+
+	result = dns_dns64_match(rec, &client, NULL, env, 0);
+	assert_int_equal(result, DNS_R_DISALLOWED);
+	result = dns_dns64_match(rec, &client, NULL, env,
+				 DNS_DNS64_RECURSIVE);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dns64_destroy(&open);
+	dns_dns64_destroy(&closed);
+	dns_dns64_destroy(&rec);
+	dns_acl_detach(&none);
+	dns_aclenv_detach(&env);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns64_findprefix)
+ISC_TEST_ENTRY(dns64_synthesize)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -26,6 +26,7 @@
 #include <maxminddb.h>
 
 #include <isc/dir.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -89,6 +90,7 @@ load_geoip(const char *dir) {
 
 static void
 close_geoip(void) {
+	dns_geoip_flushcache();
 	MMDB_close(&geoip_country);
 	MMDB_close(&geoip_city);
 	MMDB_close(&geoip_as);
@@ -114,7 +116,7 @@ entry_exists(dns_geoip_subtype_t subtype, const char *addr) {
 
 	db = geoip2_database(&geoip, fix_subtype(&geoip, subtype));
 
-	return (db != NULL && get_entry_for(db, &na) != NULL);
+	return (db != NULL && get_entry_for(&geoip, db, &na) != NULL);
 }
 
 /*
@@ -226,6 +228,56 @@ ISC_RUN_TEST_IMPL(country) {
 	assert_true(match);
 }
 
+/*
+ * Check that repeated matches for the same client are answered from the
+ * lookup cache, and that flushing the cache forces a new lookup.
+ */
+ISC_RUN_TEST_IMPL(cache) {
+	bool match;
+
+	UNUSED(state);
+
+	if (geoip.country == NULL) {
+		skip();
+	}
+
+	isc_stats_create(mctx, &geoip.stats, dns_geoipstatscounter_max);
+
+	match = do_lookup_string("10.53.0.1", dns_geoip_country_code, "AU");
+	assert_true(match);
+	assert_int_equal(isc_stats_get_counter(geoip.stats,
+					       dns_geoipstatscounter_lookup),
+			 1);
+
+	match = do_lookup_string("10.53.0.1", dns_geoip_country_name,
+				 "Australia");
+	assert_true(match);
+	match = do_lookup_string("10.53.0.1", dns_geoip_country_code, "AU");
+	assert_true(match);
+	assert_int_equal(isc_stats_get_counter(geoip.stats,
+					       dns_geoipstatscounter_lookup),
+			 1);
+	assert_int_equal(isc_stats_get_counter(geoip.stats,
+					       dns_geoipstatscounter_cachehit),
+			 2);
+
+	/* A different network needs its own lookup */
+	match = do_lookup_string("192.0.2.128", dns_geoip_country_code, "O1");
+	assert_true(match);
+	assert_int_equal(isc_stats_get_counter(geoip.stats,
+					       dns_geoipstatscounter_lookup),
+			 2);
+
+	dns_geoip_flushcache();
+	match = do_lookup_string("10.53.0.1", dns_geoip_country_code, "AU");
+	assert_true(match);
+	assert_int_equal(isc_stats_get_counter(geoip.stats,
+					       dns_geoipstatscounter_lookup),
+			 3);
+
+	isc_stats_detach(&geoip.stats);
+}
+
 /* GeoIP country (ipv6) matching */
 ISC_RUN_TEST_IMPL(country_v6) {
 	bool match;
@@ -383,6 +435,7 @@ ISC_RUN_TEST_IMPL(domain) {
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(baseline, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(country, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(cache, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(country_v6, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(city, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(city_v6, setup_test, teardown_test)
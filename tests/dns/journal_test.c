@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/util.h>
+
+#include <dns/diff.h>
+#include <dns/journal.h>
+#include <dns/rdata.h>
+#include <dns/rdatatype.h>
+
+#include <tests/dns.h>
+
+#define JOURNAL	 "./compact.jnl"
+#define NEWNAME	 "./compact.jnw"
+#define NSERIALS 200 /* transactions in the journal to compact */
+#define KEEP	 150 /* serial the zone was last dumped at */
+#define TARGET	 4096
+
+static void
+cleanup(void) {
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(NEWNAME);
+}
+
+/*
+ * Append the transaction from 'serial' to 'serial + 1' to 'j': the
+ * SOA serial changes and a TXT record naming the new serial is added.
+ */
+static void
+append(dns_journal_t *j, uint32_t serial) {
+	char soa0[100], soa1[100], txt[100];
+	zonechange_t changes[] = {
+		{ DNS_DIFFOP_DEL, "example.", 300, "SOA", soa0 },
+		{ DNS_DIFFOP_ADD, "example.", 300, "SOA", soa1 },
+		{ DNS_DIFFOP_ADD, "example.", 300, "TXT", txt },
+		ZONECHANGE_SENTINEL,
+	};
+	dns_diff_t diff;
+	isc_result_t result;
+
+	snprintf(soa0, sizeof(soa0), ". . %u 0 0 0 0", serial);
+	snprintf(soa1, sizeof(soa1), ". . %u 0 0 0 0", serial + 1);
+	snprintf(txt, sizeof(txt), "\"t%u with some padding to make the "
+				   "journal grow a little faster\"",
+		 serial + 1);
+
+	result = dns_test_difffromchanges(&diff, changes, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_journal_write_transaction(j, &diff);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_diff_clear(&diff);
+}
+
+/*
+ * Open the journal and append the transactions from 'from' up to
+ * 'to', syncing them as one group if 'group' is true.
+ */
+static void
+appendrange(uint32_t from, uint32_t to, bool group) {
+	dns_journal_t *j = NULL;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, JOURNAL,
+				  DNS_JOURNAL_CREATE |
+					  (group ? DNS_JOURNAL_GROUP : 0),
+				  &j);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	for (uint32_t serial = from; serial < to; serial++) {
+		append(j, serial);
+	}
+	if (group) {
+		result = dns_journal_sync(j);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Check that the journal holds every transaction from a serial no
+ * later than 'first' up to 'last', in order.
+ */
+static void
+check(uint32_t first, uint32_t last) {
+	dns_journal_t *j = NULL;
+	uint32_t begin, serial;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	begin = dns_journal_first_serial(j);
+	assert_true(begin > 1);
+	assert_true(DNS_SERIAL_GE(first, begin));
+	assert_int_equal(dns_journal_last_serial(j), last);
+
+	result = dns_journal_iter_init(j, begin, last, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	serial = begin;
+	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+		char text[200], expect[100];
+		isc_buffer_t b;
+
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		if (rdata->type != dns_rdatatype_txt) {
+			continue;
+		}
+
+		serial++;
+		isc_buffer_init(&b, text, sizeof(text) - 1);
+		result = dns_rdata_totext(rdata, NULL, &b);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		isc_buffer_putuint8(&b, 0);
+		snprintf(expect, sizeof(expect), "\"t%u ", serial);
+		assert_memory_equal(text, expect, strlen(expect));
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(serial, last);
+
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Transactions committed, singly or as a group, while the compacted
+ * copy is being written end up in the renamed journal.
+ */
+ISC_RUN_TEST_IMPL(compact_concurrent) {
+	dns_journalcompact_t *c = NULL;
+	off_t before, after;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	cleanup();
+	appendrange(1, NSERIALS, false);
+	result = isc_file_getsize(JOURNAL, &before);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_journal_compact_begin(mctx, UNCONST(JOURNAL), KEEP, 0,
+					   TARGET, &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(c);
+
+	/* Committed before the copy starts... */
+	appendrange(NSERIALS, NSERIALS + 10, true);
+
+	result = dns_journal_compact_copy(c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* ...and after it is done, before it is renamed */
+	appendrange(NSERIALS + 10, NSERIALS + 15, false);
+	appendrange(NSERIALS + 15, NSERIALS + 30, true);
+
+	result = dns_journal_compact_finish(&c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_null(c);
+	assert_false(isc_file_exists(NEWNAME));
+
+	result = isc_file_getsize(JOURNAL, &after);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(after < before);
+
+	check(KEEP, NSERIALS + 30);
+
+	/* The compacted journal can be written to */
+	appendrange(NSERIALS + 30, NSERIALS + 31, false);
+	check(KEEP, NSERIALS + 31);
+
+	cleanup();
+}
+
+/*
+ * If nothing is committed during the copy, the compacted journal is
+ * just the retained part of the old one.
+ */
+ISC_RUN_TEST_IMPL(compact_quiet) {
+	dns_journalcompact_t *c = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	cleanup();
+	appendrange(1, NSERIALS, false);
+
+	result = dns_journal_compact_begin(mctx, UNCONST(JOURNAL), KEEP, 0,
+					   TARGET, &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(c);
+	result = dns_journal_compact_copy(c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_journal_compact_finish(&c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	check(KEEP, NSERIALS);
+
+	/* Small journals are left alone */
+	result = dns_journal_compact_begin(mctx, UNCONST(JOURNAL), NSERIALS,
+					   0, DNS_JOURNAL_SIZE_MAX, &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_null(c);
+
+	cleanup();
+}
+
+/*
+ * A journal that is replaced while it is being compacted is kept, and
+ * the compacted copy is thrown away.
+ */
+ISC_RUN_TEST_IMPL(compact_replaced) {
+	dns_journalcompact_t *c = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	cleanup();
+	appendrange(1, NSERIALS, false);
+
+	result = dns_journal_compact_begin(mctx, UNCONST(JOURNAL), KEEP, 0,
+					   TARGET, &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(c);
+	result = dns_journal_compact_copy(c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* As after a full zone transfer */
+	(void)isc_file_remove(JOURNAL);
+	appendrange(1000, 1010, false);
+
+	result = dns_journal_compact_finish(&c);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+	assert_null(c);
+	assert_false(isc_file_exists(NEWNAME));
+
+	check(1000, 1010);
+
+	cleanup();
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(compact_concurrent)
+ISC_TEST_ENTRY(compact_quiet)
+ISC_TEST_ENTRY(compact_replaced)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -34,6 +34,8 @@
 #include <dns/name.h>
 #include <dns/nta.h>
 #include <dns/rdataclass.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/rootns.h>
 #include <dns/view.h>
@@ -692,6 +694,163 @@ ISC_LOOP_TEST_IMPL(nta) {
 	dns_view_detach(&myview);
 }
 
+/* parsed DNSKEYs are cached in the key table */
+ISC_LOOP_TEST_IMPL(dstkey) {
+	unsigned char rrdata[4096];
+	isc_buffer_t rrdatabuf;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_dnskey_t dnskey;
+	dns_fixedname_t fn;
+	dns_name_t *keyname = dns_fixedname_name(&fn);
+	dst_key_t *key1 = NULL, *key2 = NULL, *key3 = NULL;
+
+	UNUSED(arg);
+
+	create_tables();
+
+	create_keystruct(257, 3, 5, keystr1, &dnskey);
+	isc_buffer_init(&rrdatabuf, rrdata, sizeof(rrdata));
+	assert_int_equal(dns_rdata_fromstruct(&rdata, dnskey.common.rdclass,
+					      dnskey.common.rdtype, &dnskey,
+					      &rrdatabuf),
+			 ISC_R_SUCCESS);
+	dns_rdata_freestruct(&dnskey);
+
+	/* the second lookup finds the key parsed by the first */
+	dns_test_namefromstring("example.com.", &fn);
+	assert_int_equal(dns_keytable_dstkey(keytable, keyname, &rdata, &key1),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_keytable_dstkey(keytable, keyname, &rdata, &key2),
+			 ISC_R_SUCCESS);
+	assert_ptr_equal(key1, key2);
+	assert_int_equal(dst_key_alg(key1), 5);
+
+	/* the same DNSKEY under another name is another key */
+	dns_test_namefromstring("example.org.", &fn);
+	assert_int_equal(dns_keytable_dstkey(keytable, keyname, &rdata, &key3),
+			 ISC_R_SUCCESS);
+	assert_ptr_not_equal(key1, key3);
+	assert_true(dns_name_equal(dst_key_name(key3), keyname));
+
+	dst_key_free(&key1);
+	dst_key_free(&key2);
+	dst_key_free(&key3);
+
+	destroy_tables();
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* verified signatures are remembered until the trust anchors change */
+ISC_LOOP_TEST_IMPL(sigverified) {
+	unsigned char keybuf[4096], sigbuf[1024], signature[64] = { 0 };
+	unsigned char address[4] = { 192, 0, 2, 1 };
+	unsigned char digest[ISC_MAX_MD_SIZE];
+	isc_buffer_t b;
+	dns_rdata_t keyrdata = DNS_RDATA_INIT;
+	dns_rdata_t sigrdata = DNS_RDATA_INIT;
+	dns_rdata_t sigrdata2 = DNS_RDATA_INIT;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_dnskey_t dnskey;
+	dns_rdata_rrsig_t rrsig;
+	dns_rdata_ds_t ds;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fn;
+	dns_name_t *name = dns_fixedname_name(&fn);
+	dst_key_t *key = NULL;
+	uint64_t hash = 0;
+
+	UNUSED(arg);
+
+	create_tables();
+
+	dns_test_namefromstring("www.example.com.", &fn);
+
+	create_keystruct(257, 3, 5, keystr1, &dnskey);
+	isc_buffer_init(&b, keybuf, sizeof(keybuf));
+	assert_int_equal(dns_rdata_fromstruct(&keyrdata, dnskey.common.rdclass,
+					      dnskey.common.rdtype, &dnskey,
+					      &b),
+			 ISC_R_SUCCESS);
+	dns_rdata_freestruct(&dnskey);
+	assert_int_equal(dns_keytable_dstkey(keytable, str2name("example.com"),
+					     &keyrdata, &key),
+			 ISC_R_SUCCESS);
+
+	/* an A RRset */
+	rdata.data = address;
+	rdata.length = sizeof(address);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	/* and a signature over it; the cache does not check it */
+	rrsig = (dns_rdata_rrsig_t){
+		.common.rdclass = dns_rdataclass_in,
+		.common.rdtype = dns_rdatatype_rrsig,
+		.covered = dns_rdatatype_a,
+		.algorithm = 5,
+		.labels = 3,
+		.originalttl = 300,
+		.timeexpire = 2000000000,
+		.timesigned = 1000000000,
+		.keyid = dst_key_id(key),
+		.siglen = sizeof(signature),
+		.signature = signature,
+	};
+	ISC_LINK_INIT(&rrsig.common, link);
+	dns_name_init(&rrsig.signer, NULL);
+	dns_name_clone(str2name("example.com"), &rrsig.signer);
+	isc_buffer_init(&b, sigbuf, sizeof(sigbuf) / 2);
+	assert_int_equal(dns_rdata_fromstruct(&sigrdata, dns_rdataclass_in,
+					      dns_rdatatype_rrsig, &rrsig, &b),
+			 ISC_R_SUCCESS);
+	signature[0] = 1;
+	isc_buffer_init(&b, sigbuf + sizeof(sigbuf) / 2, sizeof(sigbuf) / 2);
+	assert_int_equal(dns_rdata_fromstruct(&sigrdata2, dns_rdataclass_in,
+					      dns_rdatatype_rrsig, &rrsig, &b),
+			 ISC_R_SUCCESS);
+
+	assert_false(dns_keytable_sigverified(keytable, name, &rdataset, key,
+					      &sigrdata, &hash));
+	assert_int_not_equal(hash, 0);
+	dns_keytable_setsigverified(keytable, hash, &sigrdata);
+	assert_true(dns_keytable_sigverified(keytable, name, &rdataset, key,
+					     &sigrdata, &hash));
+
+	/* a different signature or owner name does not match */
+	assert_false(dns_keytable_sigverified(keytable, name, &rdataset, key,
+					      &sigrdata2, &hash));
+	assert_false(dns_keytable_sigverified(keytable,
+					      str2name("ftp.example.com"),
+					      &rdataset, key, &sigrdata,
+					      &hash));
+
+	/* a new trust anchor flushes the cache */
+	dns_test_namefromstring("example.net.", &fn);
+	create_dsstruct(name, 257, 3, 5, keystr2, digest, &ds);
+	assert_int_equal(dns_keytable_add(keytable, false, false, name, &ds,
+					  NULL, NULL),
+			 ISC_R_SUCCESS);
+	dns_test_namefromstring("www.example.com.", &fn);
+	assert_false(dns_keytable_sigverified(keytable, name, &rdataset, key,
+					      &sigrdata, &hash));
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+
+	destroy_tables();
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(add, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(delete, setup_test, teardown_test)
@@ -699,6 +858,8 @@ ISC_TEST_ENTRY_CUSTOM(deletekey, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(find, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(issecuredomain, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dump, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dstkey, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(sigverified, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(nta, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
@@ -19,6 +19,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
@@ -558,6 +559,362 @@ ISC_RUN_TEST_IMPL(neworigin) {
 	assert_true(warn_expect_result);
 }
 
+/*
+ * Parallel loading: the file is split into pieces of PARALLEL_CHUNKSIZE
+ * bytes, so that small test files are split many times.
+ */
+#define PARALLEL_CHUNKSIZE 256
+#define PARALLEL_FILE	   "./parallel.data"
+#define PARALLEL_INCLUDE   "./parallel-include.data"
+
+typedef struct {
+	char **lines;
+	size_t count;
+	size_t size;
+} rrlines_t;
+
+static char parallel_error[4096];
+
+static void
+parallel_errorcb(struct dns_rdatacallbacks *mycallbacks, const char *fmt,
+		 ...) {
+	va_list ap;
+
+	UNUSED(mycallbacks);
+
+	/* Only the first error of a load is kept */
+	if (parallel_error[0] != '\0') {
+		return;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(parallel_error, sizeof(parallel_error), fmt, ap);
+	va_end(ap);
+}
+
+static isc_result_t
+collect_add(void *arg, const dns_name_t *owner,
+	    dns_rdataset_t *dataset DNS__DB_FLARG) {
+	rrlines_t *rrl = arg;
+	char buf[BIGBUFLEN];
+	isc_buffer_t target;
+	isc_result_t result;
+	char *line = NULL, *next = NULL;
+
+	isc_buffer_init(&target, buf, sizeof(buf) - 1);
+	result = dns_rdataset_totext(dataset, owner, false, false, &target);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_buffer_putuint8(&target, 0);
+
+	for (line = buf; *line != '\0'; line = next) {
+		next = strchr(line, '\n');
+		if (next == NULL) {
+			next = line + strlen(line);
+		} else {
+			*next++ = '\0';
+		}
+		if (rrl->count == rrl->size) {
+			size_t size = rrl->size + 64;
+			rrl->lines = isc_mem_creget(mctx, rrl->lines, rrl->size,
+						    size, sizeof(char *));
+			rrl->size = size;
+		}
+		rrl->lines[rrl->count++] = isc_mem_strdup(mctx, line);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static int
+parallel_cmp(const void *a, const void *b) {
+	return (strcmp(*(char *const *)a, *(char *const *)b));
+}
+
+static void
+parallel_free(rrlines_t *rrl) {
+	for (size_t i = 0; i < rrl->count; i++) {
+		isc_mem_free(mctx, rrl->lines[i]);
+	}
+	if (rrl->lines != NULL) {
+		isc_mem_cput(mctx, rrl->lines, rrl->size, sizeof(char *));
+	}
+	*rrl = (rrlines_t){ 0 };
+}
+
+/*
+ * Load 'file' into 'rrl' as sorted lines of text, keeping the first
+ * error message in 'parallel_error'.
+ */
+static isc_result_t
+parallel_loadfile(const char *file, unsigned int options, rrlines_t *rrl) {
+	dns_rdatacallbacks_t cb;
+	isc_result_t result;
+
+	result = setup_master(NULL, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatacallbacks_init_stdio(&cb);
+	cb.add = collect_add;
+	cb.add_private = rrl;
+	cb.error = parallel_errorcb;
+	cb.warn = nullmsg;
+	parallel_error[0] = '\0';
+
+	result = dns_master_loadfile(file, &dns_origin, &dns_origin,
+				     dns_rdataclass_in, options, 0, &cb, NULL,
+				     NULL, mctx, dns_masterformat_text, 0);
+	if (rrl->count > 0) {
+		qsort(rrl->lines, rrl->count, sizeof(char *), parallel_cmp);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+parallel_load(unsigned int options, rrlines_t *rrl) {
+	return (parallel_loadfile(PARALLEL_FILE, options, rrl));
+}
+
+/*
+ * Load PARALLEL_FILE serially and in parallel, and check that the two
+ * loads return the same result, records and first error.
+ */
+static void
+parallel_compare(isc_result_t expect) {
+	rrlines_t serial = { 0 }, parallel = { 0 };
+	char error[sizeof(parallel_error)];
+	isc_result_t result;
+
+	dns__master_setparallel(PARALLEL_CHUNKSIZE, 4);
+
+	result = parallel_load(0, &serial);
+	assert_int_equal(result, expect);
+	strlcpy(error, parallel_error, sizeof(error));
+
+	result = parallel_load(DNS_MASTER_PARALLEL, &parallel);
+	assert_int_equal(result, expect);
+	assert_string_equal(parallel_error, error);
+
+	if (expect == ISC_R_SUCCESS) {
+		assert_true(serial.count > 0);
+		assert_int_equal(parallel.count, serial.count);
+		for (size_t i = 0; i < serial.count; i++) {
+			assert_string_equal(parallel.lines[i], serial.lines[i]);
+		}
+	}
+
+	parallel_free(&serial);
+	parallel_free(&parallel);
+
+	dns__master_setparallel(0, 0);
+}
+
+/*
+ * Write the start of a zone that is split many times, with multi-line
+ * records and directives in every piece.  Returns the number of lines.
+ */
+static unsigned long
+parallel_writezone(FILE *f) {
+	unsigned long lines = 0;
+
+	fprintf(f, "$TTL 300\n"
+		   "@\tSOA\tns hostmaster (\n"
+		   "\t\t1 3600 600 86400 300 )\n"
+		   "\tNS\tns\n"
+		   "ns\tA\t10.53.0.1\n");
+	lines += 5;
+
+	for (unsigned int i = 0; i < 200; i++) {
+		if (i % 16 == 0) {
+			fprintf(f, "$ORIGIN sub%u.test.\n$TTL %u\n", i / 16,
+				600 + i);
+			lines += 2;
+		}
+		/* Records that span lines, with quotes and comments */
+		fprintf(f,
+			"a%u\tTXT\t( \"first ( line\" ; comment )\n"
+			"\t\t\"second ; line\"\n"
+			"\t\t\"third\\\" line\" )\n"
+			"\tA\t10.53.%u.%u\n"
+			"b%u\t3600\tMX\t10 (\n"
+			"\n"
+			"\t\ta%u )\n",
+			i, i / 256, i % 256, i, i);
+		lines += 7;
+	}
+
+	return (lines);
+}
+
+/* Pieces of a file split inside multi-line records load as a whole */
+ISC_RUN_TEST_IMPL(parallel_multiline) {
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	f = fopen(PARALLEL_FILE, "w");
+	assert_non_null(f);
+	(void)parallel_writezone(f);
+	fclose(f);
+
+	parallel_compare(ISC_R_SUCCESS);
+
+	(void)unlink(PARALLEL_FILE);
+}
+
+/* Files with $INCLUDE are loaded serially, with the same result */
+ISC_RUN_TEST_IMPL(parallel_include) {
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	f = fopen(PARALLEL_INCLUDE, "w");
+	assert_non_null(f);
+	fprintf(f, "$TTL 60\ninc\tA\t10.53.0.2\n");
+	fclose(f);
+
+	f = fopen(PARALLEL_FILE, "w");
+	assert_non_null(f);
+	(void)parallel_writezone(f);
+	fprintf(f, "$INCLUDE " PARALLEL_INCLUDE " inc.test.\n"
+		   "after\tA\t10.53.0.3\n");
+	(void)parallel_writezone(f);
+	fclose(f);
+
+	parallel_compare(ISC_R_SUCCESS);
+
+	(void)unlink(PARALLEL_FILE);
+	(void)unlink(PARALLEL_INCLUDE);
+}
+
+/* Errors found in a piece are reported with their line in the file */
+ISC_RUN_TEST_IMPL(parallel_errorline) {
+	char expect[64];
+	unsigned long line;
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	f = fopen(PARALLEL_FILE, "w");
+	assert_non_null(f);
+	line = parallel_writezone(f);
+	fprintf(f, "bad\tA\tnot-an-address\n");
+	(void)parallel_writezone(f);
+	fclose(f);
+
+	parallel_compare(DNS_R_BADDOTTEDQUAD);
+
+	snprintf(expect, sizeof(expect), PARALLEL_FILE ":%lu:", line + 1);
+	assert_non_null(strstr(parallel_error, expect));
+
+	(void)unlink(PARALLEL_FILE);
+}
+
+#define DUMP_SERIAL   "./dump-serial.data"
+#define DUMP_PARALLEL "./dump-parallel.data"
+#define DUMP_NODES    40000
+
+/*
+ * Dump 'db' to 'file' with parallel dumping from 'minnodes' nodes
+ * using 'nthreads' threads.
+ */
+static void
+dump_file(dns_db_t *db, const char *file, size_t minnodes,
+	  unsigned int nthreads) {
+	dns_dbversion_t *version = NULL;
+	isc_result_t result;
+
+	dns__master_setdumpparallel(minnodes, nthreads);
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 file, dns_masterformat_text, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, false);
+	dns__master_setdumpparallel(0, 0);
+}
+
+static void
+dump_samefile(const char *file1, const char *file2) {
+	FILE *f1 = fopen(file1, "r"), *f2 = fopen(file2, "r");
+	int c1, c2;
+
+	assert_non_null(f1);
+	assert_non_null(f2);
+	do {
+		c1 = fgetc(f1);
+		c2 = fgetc(f2);
+		assert_int_equal(c1, c2);
+	} while (c1 != EOF);
+	fclose(f1);
+	fclose(f2);
+}
+
+/*
+ * A zone dumped in parallel, in several rounds of batches, is dumped
+ * exactly as it is serially, and reloads to the same data.
+ */
+ISC_RUN_TEST_IMPL(dump_parallel) {
+	rrlines_t source = { 0 }, dumped = { 0 };
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	f = fopen(PARALLEL_FILE, "w");
+	assert_non_null(f);
+	fprintf(f, "$TTL 300
+"
+		   "@	SOA	ns hostmaster 1 3600 600 86400 300
+"
+		   "	NS	ns
+"
+		   "ns	A	10.53.0.1
+");
+	for (unsigned int i = 0; i < DUMP_NODES; i++) {
+		fprintf(f, "n%u	%u	A	10.%u.%u.%u
+", i, 300 + i % 7,
+			i >> 16, (i >> 8) & 0xff, i & 0xff);
+		if (i % 3 == 0) {
+			fprintf(f, "	TXT	"n%u"
+", i);
+		}
+	}
+	fclose(f);
+
+	result = setup_master(NULL, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, &dns_origin,
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, PARALLEL_FILE, dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dump_file(db, DUMP_SERIAL, 0, 1);
+	dump_file(db, DUMP_PARALLEL, 1000, 4);
+	dump_samefile(DUMP_SERIAL, DUMP_PARALLEL);
+
+	result = parallel_loadfile(PARALLEL_FILE, 0, &source);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = parallel_loadfile(DUMP_PARALLEL, 0, &dumped);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dumped.count, source.count);
+	for (size_t i = 0; i < source.count; i++) {
+		assert_string_equal(dumped.lines[i], source.lines[i]);
+	}
+
+	parallel_free(&source);
+	parallel_free(&dumped);
+	dns_db_detach(&db);
+
+	(void)unlink(PARALLEL_FILE);
+	(void)unlink(DUMP_SERIAL);
+	(void)unlink(DUMP_PARALLEL);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(load)
 ISC_TEST_ENTRY(unexpected)
@@ -577,6 +934,10 @@ ISC_TEST_ENTRY(dumpraw)
 ISC_TEST_ENTRY(toobig)
 ISC_TEST_ENTRY(maxrdata)
 ISC_TEST_ENTRY(neworigin)
+ISC_TEST_ENTRY(parallel_multiline)
+ISC_TEST_ENTRY(parallel_include)
+ISC_TEST_ENTRY(parallel_errorline)
+ISC_TEST_ENTRY(dump_parallel)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/rdata.h>
+
+#include <tests/dns.h>
+
+/*
+ * A response for "example. A" with an NS record for "example." and an
+ * A record for "www.example." in the answer section, both of them
+ * compressed against the question name.
+ */
+static unsigned char response[] = {
+	0x00, 0x01, 0x84, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+	/* example. A IN */
+	0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x00, 0x00, 0x01, 0x00, 0x01,
+	/* example. 300 IN NS ns.example. */
+	0xc0, 0x0c, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x05,
+	0x02, 'n', 's', 0xc0, 0x0c,
+	/* www.example. 60 IN A 192.0.2.1 */
+	0x03, 'w', 'w', 'w', 0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x3c, 0x00, 0x04, 192, 0, 2, 1
+};
+
+static isc_result_t
+parse(unsigned char *data, size_t length, unsigned int options,
+      dns_message_t **msgp) {
+	isc_buffer_t source;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, msgp);
+	isc_buffer_init(&source, data, length);
+	isc_buffer_add(&source, length);
+	return (dns_message_parse(*msgp, &source, options));
+}
+
+static void
+checkrr(dns_message_t *msg, const char *owner, dns_ttl_t expectttl,
+	dns_rdatatype_t type, const unsigned char *expect, size_t length) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_ttl_t ttl;
+
+	dns_test_namefromstring(owner, &fixed);
+	dns_message_currentrr(msg, &name, &ttl, &rdata);
+	assert_true(dns_name_equal(name, dns_fixedname_name(&fixed)));
+	assert_int_equal(ttl, expectttl);
+	assert_int_equal(rdata.type, type);
+	assert_int_equal(rdata.rdclass, dns_rdataclass_in);
+	assert_int_equal(rdata.length, length);
+	assert_memory_equal(rdata.data, expect, length);
+}
+
+/* read a streamed answer section one RR at a time */
+ISC_RUN_TEST_IMPL(streamanswer) {
+	static const unsigned char ns[] = { 0x02, 'n', 's', 0x07, 'e',
+					    'x',  'a',	'm', 'p',  'l',
+					    'e',  0x00 };
+	static const unsigned char a[] = { 192, 0, 2, 1 };
+	dns_message_t *msg = NULL;
+	isc_result_t result;
+
+	result = parse(response, sizeof(response),
+		       DNS_MESSAGEPARSE_STREAMANSWER, &msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(msg->counts[DNS_SECTION_ANSWER], 2);
+	assert_int_equal(dns_message_firstname(msg, DNS_SECTION_ANSWER),
+			 ISC_R_NOMORE);
+
+	/* the names in the owner and the rdata are decompressed */
+	result = dns_message_firstrr(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	checkrr(msg, "example.", 300, dns_rdatatype_ns, ns, sizeof(ns));
+
+	result = dns_message_nextrr(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	checkrr(msg, "www.example.", 60, dns_rdatatype_a, a, sizeof(a));
+
+	result = dns_message_nextrr(msg);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* the section can be read again */
+	result = dns_message_firstrr(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	checkrr(msg, "example.", 300, dns_rdatatype_ns, ns, sizeof(ns));
+
+	dns_message_detach(&msg);
+}
+
+/* malformed streamed answer sections */
+ISC_RUN_TEST_IMPL(streambad) {
+	unsigned char data[sizeof(response)];
+	dns_message_t *msg = NULL;
+	isc_result_t result;
+
+	/* the message ends in the middle of the last rdata */
+	result = parse(response, sizeof(response) - 1,
+		       DNS_MESSAGEPARSE_STREAMANSWER, &msg);
+	assert_int_equal(result, ISC_R_UNEXPECTEDEND);
+	dns_message_detach(&msg);
+
+	/* an A record with a two octet rdata is only found when read */
+	memmove(data, response, sizeof(data));
+	data[sizeof(data) - 5] = 0x02;
+	result = parse(data, sizeof(data) - 2, DNS_MESSAGEPARSE_STREAMANSWER,
+		       &msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_firstrr(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_nextrr(msg);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+	assert_int_not_equal(result, ISC_R_NOMORE);
+	dns_message_detach(&msg);
+
+	/* a record of another class than the question */
+	memmove(data, response, sizeof(data));
+	data[sizeof(data) - 11] = 0x03;
+	result = parse(data, sizeof(data), DNS_MESSAGEPARSE_STREAMANSWER,
+		       &msg);
+	assert_int_equal(result, DNS_R_FORMERR);
+	dns_message_detach(&msg);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(streamanswer)
+ISC_TEST_ENTRY(streambad)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
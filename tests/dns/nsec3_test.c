@@ -23,11 +23,17 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/buffer.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/diff.h>
+#include <dns/fixedname.h>
 #include <dns/nsec3.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
 
 #include <tests/dns.h>
 
@@ -147,9 +153,128 @@ ISC_RUN_TEST_IMPL(nsec3param_salttotext) {
 	}
 }
 
+/*
+ * Write the NSEC3 records in 'version' of 'db' to 'buffer' as text.
+ */
+static void
+nsec3totext(dns_db_t *db, dns_dbversion_t *version, isc_buffer_t *buffer) {
+	dns_dbiterator_t *dbit = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	result = dns_db_createiterator(db, DNS_DB_NSEC3ONLY, &dbit);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	for (result = dns_dbiterator_first(dbit); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbit))
+	{
+		dns_dbnode_t *node = NULL;
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+		result = dns_dbiterator_current(dbit, &node, name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_findrdataset(db, node, version,
+					     dns_rdatatype_nsec3, 0, 0,
+					     &rdataset, NULL);
+		dns_db_detachnode(db, &node);
+		if (result == ISC_R_NOTFOUND) {
+			continue;
+		}
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_rdataset_totext(&rdataset, name, false, false,
+					     buffer);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	dns_dbiterator_destroy(&dbit);
+}
+
+static void
+buildchain_test(uint8_t flags) {
+	static const char *names[] = { "test.",	   "ns.test.",	 "a.b.c.test.",
+				       "x.test.",  "sub.test.",	 "sec.test.",
+				       "d.test." };
+	dns_rdata_nsec3param_t nsec3param = {
+		.hash = dns_hash_sha1,
+		.flags = DNS_NSEC3FLAG_CREATE | flags,
+		.iterations = 5,
+		.salt = (unsigned char *)"\x12\x34",
+		.salt_length = 2,
+	};
+	char text1[8192], text2[8192];
+	isc_buffer_t buffer1, buffer2;
+	dns_db_t *db1 = NULL, *db2 = NULL;
+	dns_dbversion_t *version1 = NULL, *version2 = NULL;
+	dns_diff_t diff;
+	bool seen_nsec = true;
+	isc_result_t result;
+
+	result = dns_test_loaddb(&db1, dns_dbtype_zone, "test",
+				 TESTS_DIR "/testdata/nsec3/chain.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_loaddb(&db2, dns_dbtype_zone, "test",
+				 TESTS_DIR "/testdata/nsec3/chain.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* the whole chain at once */
+	dns_diff_init(mctx, &diff);
+	result = dns_db_newversion(db1, &version1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_nsec3_buildchain(db1, version1, &nsec3param, 300,
+				      &seen_nsec, &diff);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(seen_nsec);
+	assert_false(ISC_LIST_EMPTY(diff.tuples));
+	dns_diff_clear(&diff);
+
+	/* the chain cannot be built again */
+	result = dns_nsec3_buildchain(db1, version1, &nsec3param, 300,
+				      &seen_nsec, &diff);
+	assert_int_equal(result, ISC_R_EXISTS);
+
+	/* one name at a time, skipping the names hidden by cuts */
+	result = dns_db_newversion(db2, &version2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		dns_fixedname_t fixed;
+		bool unsecure = (strcmp(names[i], "sub.test.") == 0);
+
+		dns_test_namefromstring(names[i], &fixed);
+		result = dns_nsec3_addnsec3(db2, version2,
+					    dns_fixedname_name(&fixed),
+					    &nsec3param, 300, unsecure, &diff);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	dns_diff_clear(&diff);
+
+	isc_buffer_init(&buffer1, text1, sizeof(text1));
+	isc_buffer_init(&buffer2, text2, sizeof(text2));
+	nsec3totext(db1, version1, &buffer1);
+	nsec3totext(db2, version2, &buffer2);
+	assert_int_equal(isc_buffer_usedlength(&buffer1),
+			 isc_buffer_usedlength(&buffer2));
+	assert_memory_equal(text1, text2, isc_buffer_usedlength(&buffer1));
+
+	dns_db_closeversion(db1, &version1, false);
+	dns_db_closeversion(db2, &version2, false);
+	dns_db_detach(&db1);
+	dns_db_detach(&db2);
+}
+
+/* check that dns_nsec3_buildchain() matches dns_nsec3_addnsec3() */
+ISC_RUN_TEST_IMPL(buildchain) {
+	UNUSED(state);
+
+	buildchain_test(0);
+	buildchain_test(DNS_NSEC3FLAG_OPTOUT);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(max_iterations)
 ISC_TEST_ENTRY(nsec3param_salttotext)
+ISC_TEST_ENTRY(buildchain)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
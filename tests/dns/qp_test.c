@@ -23,6 +23,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/histo.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
@@ -927,6 +928,155 @@ ISC_RUN_TEST_IMPL(fixiterator) {
 	dns_qp_destroy(&qp);
 }
 
+#define STEP_ITEMS 200000
+
+static uint32_t step_item[STEP_ITEMS];
+
+static void
+step_check(void *uctx, void *pval, uint32_t ival) {
+	uint32_t *items = uctx;
+	assert_in_range(ival, 0, STEP_ITEMS - 1);
+	assert_ptr_equal(items + ival, pval);
+}
+
+static size_t
+step_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	step_check(uctx, pval, ival);
+
+	char str[8];
+	snprintf(str, sizeof(str), "%06u", ival);
+
+	size_t i = 0;
+	while (str[i] != '\0') {
+		key[i] = str[i] - '0' + SHIFT_BITMAP;
+		i++;
+	}
+	key[i++] = SHIFT_NOBYTE;
+
+	return (i);
+}
+
+const dns_qpmethods_t step_methods = {
+	step_check,
+	step_check,
+	step_makekey,
+	getname,
+};
+
+ISC_RUN_TEST_IMPL(compactstep) {
+	dns_qp_t *qp = NULL;
+	isc_histo_t *hg = NULL;
+	uint64_t min, max, count, pauses = 0;
+	unsigned int steps = 0;
+
+	dns_qp_create(mctx, &step_methods, step_item, &qp);
+	for (uint32_t i = 0; i < STEP_ITEMS; i++) {
+		step_item[i] = i;
+		assert_int_equal(dns_qp_insert(qp, &step_item[i], i),
+				 ISC_R_SUCCESS);
+	}
+
+	/* a full pass over a big trie should take several steps */
+	qp->compact_all = true;
+	do {
+		dns_qp_compact(qp, DNS_QPGC_STEP);
+		steps++;
+	} while (qp->compact_depth > 0);
+	assert_false(qp->compact_all);
+	assert_true(steps > 1);
+
+	/* nothing was lost or moved out from under us */
+	for (uint32_t i = 0; i < STEP_ITEMS; i++) {
+		dns_qpkey_t key;
+		size_t len = step_makekey(key, step_item, &step_item[i], i);
+		void *pval = NULL;
+		uint32_t ival = 0;
+		assert_int_equal(dns_qp_getkey(qp, key, len, &pval, &ival),
+				 ISC_R_SUCCESS);
+		assert_ptr_equal(pval, &step_item[i]);
+		assert_int_equal(ival, i);
+	}
+
+	/* every step was recorded */
+	dns_qp_gcpauses(&hg);
+	for (uint key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		pauses += count;
+	}
+	isc_histo_destroy(&hg);
+	assert_true(pauses >= steps);
+
+	dns_qp_destroy(&qp);
+}
+
+#define BATCH_ITEMS 4000
+#define BATCH_SIZE  64
+
+ISC_RUN_TEST_IMPL(lookupbatch) {
+	dns_qp_t *qp = NULL;
+	dns_qpbatch_t *batch = NULL;
+
+	dns_qp_create(mctx, &step_methods, step_item, &qp);
+
+	/* an empty trie finds nothing */
+	batch = isc_mem_cget(mctx, BATCH_SIZE, sizeof(batch[0]));
+	for (size_t i = 0; i < BATCH_SIZE; i++) {
+		uint32_t ival = i;
+		step_item[ival] = ival;
+		batch[i].keylen = step_makekey(batch[i].key, step_item,
+					       &step_item[ival], ival);
+	}
+	dns_qpbatch_sort(batch, BATCH_SIZE);
+	dns_qp_lookup_batch(qp, batch, BATCH_SIZE);
+	for (size_t i = 0; i < BATCH_SIZE; i++) {
+		assert_int_equal(batch[i].result, ISC_R_NOTFOUND);
+	}
+
+	/* every other item is present */
+	for (uint32_t i = 0; i < BATCH_ITEMS; i += 2) {
+		step_item[i] = i;
+		assert_int_equal(dns_qp_insert(qp, &step_item[i], i),
+				 ISC_R_SUCCESS);
+	}
+
+	for (size_t tests = 0; tests < 100; tests++) {
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			/* sometimes repeat a key */
+			uint32_t ival = (i > 0 && isc_random_uniform(8) == 0)
+						? batch[i - 1].tag
+						: isc_random_uniform(
+							  BATCH_ITEMS);
+			step_item[ival] = ival;
+			batch[i].keylen = step_makekey(batch[i].key,
+						       step_item,
+						       &step_item[ival], ival);
+			batch[i].tag = ival;
+		}
+		dns_qpbatch_sort(batch, BATCH_SIZE);
+		dns_qp_lookup_batch(qp, batch, BATCH_SIZE);
+
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			void *pval = NULL;
+			uint32_t ival = 0;
+			isc_result_t result = dns_qp_getkey(
+				qp, batch[i].key, batch[i].keylen, &pval,
+				&ival);
+			assert_int_equal(batch[i].result, result);
+			assert_int_equal(result == ISC_R_SUCCESS,
+					 batch[i].tag % 2 == 0);
+			if (result == ISC_R_SUCCESS) {
+				assert_ptr_equal(batch[i].pval, pval);
+				assert_int_equal(batch[i].ival, ival);
+			}
+		}
+	}
+
+	isc_mem_cput(mctx, batch, BATCH_SIZE, sizeof(batch[0]));
+	dns_qp_destroy(&qp);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(qpkey_name)
 ISC_TEST_ENTRY(qpkey_sort)
@@ -935,6 +1085,8 @@ ISC_TEST_ENTRY(partialmatch)
 ISC_TEST_ENTRY(qpchain)
 ISC_TEST_ENTRY(predecessors)
 ISC_TEST_ENTRY(fixiterator)
+ISC_TEST_ENTRY(compactstep)
+ISC_TEST_ENTRY(lookupbatch)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -25,6 +25,8 @@
 
 #include <isc/util.h>
 
+#include <dns/cache.h>
+#include <dns/masterdump.h>
 #include <dns/rbt.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
@@ -49,12 +51,12 @@ static bool verbose = false;
  * Add to a cache DB 'db' an rdataset of type 'rtype' at a name
  * <idx>.example.com. The rdataset would contain one data, and rdata_len is
  * its length. 'rtype' is supposed to be some private type whose data can be
- * arbitrary (and it doesn't matter in this test).
+ * arbitrary (and it doesn't matter in this test).  'attributes' are set
+ * on the rdataset before it is added.
  */
 static void
-overmempurge_addrdataset(dns_db_t *db, isc_stdtime_t now, int idx,
-			 dns_rdatatype_t rtype, size_t rdata_len,
-			 bool longname) {
+add_rdataset(dns_db_t *db, isc_stdtime_t now, int idx, dns_rdatatype_t rtype,
+	     size_t rdata_len, bool longname, unsigned int attributes) {
 	isc_result_t result;
 	dns_rdata_t rdata;
 	dns_dbnode_t *node = NULL;
@@ -104,6 +106,7 @@ overmempurge_addrdataset(dns_db_t *db, isc_stdtime_t now, int idx,
 
 	dns_rdataset_init(&rdataset);
 	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.attributes |= attributes;
 
 	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
 	assert_int_equal(result, ISC_R_SUCCESS);
@@ -111,6 +114,13 @@ overmempurge_addrdataset(dns_db_t *db, isc_stdtime_t now, int idx,
 	dns_db_detachnode(db, &node);
 }
 
+static void
+overmempurge_addrdataset(dns_db_t *db, isc_stdtime_t now, int idx,
+			 dns_rdatatype_t rtype, size_t rdata_len,
+			 bool longname) {
+	add_rdataset(db, now, idx, rtype, rdata_len, longname, 0);
+}
+
 ISC_LOOP_TEST_IMPL(overmempurge_bigrdata) {
 	size_t maxcache = 2097152U; /* 2MB - same as DNS_CACHE_MINSIZE */
 	size_t hiwater = maxcache - (maxcache >> 3); /* borrowed from cache.c */
@@ -211,9 +221,679 @@ ISC_LOOP_TEST_IMPL(overmempurge_longname) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+static isc_result_t
+lru_find(dns_db_t *db, isc_stdtime_t now, int idx) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_rdataset_t rdataset;
+	char namebuf[DNS_NAME_FORMATSIZE];
+
+	snprintf(namebuf, sizeof(namebuf), "%d.example.com.", idx);
+	dns_test_namefromstring(namebuf, &fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, 50053, 0,
+			     now, NULL, dns_fixedname_name(&ffound), &rdataset,
+			     NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	return (result);
+}
+
+/*
+ * Lookups only refresh the timestamp of a header; the LRU sweep has to
+ * notice that and keep the header instead of purging it.
+ */
+ISC_LOOP_TEST_IMPL(lru_requeue) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	qpcache_t *qpdb = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_stdtime_t later = now + DNS_QPDB_LRUUPDATE_REGULAR;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (qpcache_t *)db;
+
+	overmempurge_addrdataset(db, now, 0, 50053, 0, false);
+	overmempurge_addrdataset(db, now, 1, 50053, 0, false);
+
+	/* only the first entry is used again */
+	assert_int_equal(lru_find(db, later, 0), ISC_R_SUCCESS);
+
+	qpdb->last_used = now;
+	for (unsigned int i = 0; i < qpdb->node_lock_count; i++) {
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+
+		NODE_WRLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+		expire_lru_headers(qpdb, i, &nlocktype, &tlocktype,
+				   SIZE_MAX DNS__DB_FILELINE);
+		NODE_UNLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+	}
+
+	assert_int_equal(lru_find(db, later, 0), ISC_R_SUCCESS);
+	assert_int_not_equal(lru_find(db, later, 1), ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static unsigned int
+sieve_locknum(dns_db_t *db, int idx) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	unsigned int locknum;
+
+	snprintf(namebuf, sizeof(namebuf), "%d.example.com.", idx);
+	dns_test_namefromstring(namebuf, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	locknum = ((qpcnode_t *)node)->locknum;
+	dns_db_detachnode(db, &node);
+
+	return (locknum);
+}
+
+/*
+ * With the SIEVE policy a lookup only marks the header as visited; the
+ * hand has to skip the visited header and purge the other one.
+ */
+ISC_LOOP_TEST_IMPL(sieve) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	qpcache_t *qpdb = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	unsigned int locknum;
+	int other = 0;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (qpcache_t *)db;
+	dns_db_setevictionpolicy(db, dns_cacheeviction_sieve);
+
+	/*
+	 * Nodes are assigned to buckets at random; keep adding entries
+	 * until one lands in the same bucket as the first one.
+	 */
+	overmempurge_addrdataset(db, now, 0, 50053, 0, false);
+	locknum = sieve_locknum(db, 0);
+	do {
+		overmempurge_addrdataset(db, now, ++other, 50053, 0, false);
+	} while (sieve_locknum(db, other) != locknum);
+
+	/* only the first (oldest) entry is used again */
+	assert_int_equal(lru_find(db, now, 0), ISC_R_SUCCESS);
+
+	NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	expire_sieve_headers(qpdb, locknum, &nlocktype, &tlocktype,
+			     0 DNS__DB_FILELINE);
+	NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+
+	assert_int_equal(lru_find(db, now, 0), ISC_R_SUCCESS);
+	assert_int_not_equal(lru_find(db, now, other), ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * NXDOMAIN entries are added at the cold end of the LRU list, or in
+ * front of the SIEVE hand, so an unused one is purged before older
+ * positive entries.
+ */
+static void
+nxdomain_cold(dns_cacheeviction_t policy) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	qpcache_t *qpdb = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	unsigned int locknum;
+	int other = 0;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (qpcache_t *)db;
+	dns_db_setevictionpolicy(db, policy);
+	qpdb->last_used = now;
+
+	overmempurge_addrdataset(db, now, 0, 50053, 0, false);
+	locknum = sieve_locknum(db, 0);
+	do {
+		add_rdataset(db, now, ++other, 50053, 0, false,
+			     DNS_RDATASETATTR_NXDOMAIN);
+	} while (sieve_locknum(db, other) != locknum);
+
+	NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	if (policy == dns_cacheeviction_sieve) {
+		expire_sieve_headers(qpdb, locknum, &nlocktype, &tlocktype,
+				     0 DNS__DB_FILELINE);
+	} else {
+		expire_lru_headers(qpdb, locknum, &nlocktype, &tlocktype,
+				   0 DNS__DB_FILELINE);
+	}
+	NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+
+	assert_int_equal(lru_find(db, now, 0), ISC_R_SUCCESS);
+	assert_int_not_equal(lru_find(db, now, other), ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(lru_nxdomain) { nxdomain_cold(dns_cacheeviction_lru); }
+
+ISC_LOOP_TEST_IMPL(sieve_nxdomain) { nxdomain_cold(dns_cacheeviction_sieve); }
+
+/*
+ * A cache snapshot written by dns_cache_dump() can be loaded into a new
+ * cache, and keeps the trust level of the cached data.
+ */
+ISC_LOOP_TEST_IMPL(snapshot) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL, *cache2 = NULL;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname, ffound;
+	dns_rdataset_t rdataset;
+	dns_trust_t trust;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+	overmempurge_addrdataset(db, now, 0, 50053, 16, false);
+	dns_db_detach(&db);
+
+	dns_test_namefromstring("0.example.com.", &fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, 50053, 0,
+			     now, NULL, dns_fixedname_name(&ffound), &rdataset,
+			     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	trust = rdataset.trust;
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+
+	result = dns_cache_dump(cache, "qpdb_test.snapshot");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_detach(&cache);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test2", NULL,
+				  mctx, &cache2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_load(cache2, "qpdb_test.snapshot");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	unlink("qpdb_test.snapshot");
+
+	dns_cache_attachdb(cache2, &db);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, 50053, 0,
+			     now, NULL, dns_fixedname_name(&ffound), &rdataset,
+			     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, trust);
+	assert_true(rdataset.ttl <= 3600);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+
+	dns_cache_detach(&cache2);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * A filtered snapshot written in the background by dns_cache_dumpasync()
+ * holds only the names and types that the filter selects.
+ */
+static dns_dumpctx_t *snapshot_dctx = NULL;
+
+static bool
+db_has(dns_db_t *db, const char *name, dns_rdatatype_t type) {
+	dns_fixedname_t fname, ffound;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_test_namefromstring(name, &fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, type, 0,
+			     isc_stdtime_now(), NULL,
+			     dns_fixedname_name(&ffound), &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	return (result == ISC_R_SUCCESS);
+}
+
+static void
+snapshot_filtered_done(void *arg, isc_result_t result) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dumpctx_detach(&snapshot_dctx);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test2", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_load(cache, "qpdb_test.snapshot");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	unlink("qpdb_test.snapshot");
+
+	dns_cache_attachdb(cache, &db);
+	assert_true(db_has(db, "0.example.com.", 50053));
+	assert_false(db_has(db, "0.example.com.", 50054));
+	assert_false(db_has(db, "1.example.com.", 50053));
+	dns_db_detach(&db);
+
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(snapshot_filtered) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname;
+	dns_dumpfilter_t filter = { .type = 50053 };
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+	overmempurge_addrdataset(db, now, 0, 50053, 16, false);
+	overmempurge_addrdataset(db, now, 0, 50054, 16, false);
+	overmempurge_addrdataset(db, now, 1, 50053, 16, false);
+	dns_db_detach(&db);
+
+	dns_test_namefromstring("0.example.com.", &fname);
+	filter.name = dns_fixedname_name(&fname);
+
+	result = dns_cache_dumpasync(cache, "qpdb_test.snapshot", &filter,
+				     isc_loop_main(loopmgr),
+				     snapshot_filtered_done, NULL,
+				     &snapshot_dctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_detach(&cache);
+}
+
+/*
+ * A snapshot of another cache imported in the background by
+ * dns_cache_loadasync() adds what is missing and replaces RRsets of
+ * lower trust, but keeps those of higher trust.
+ */
+static dns_cache_t *import_cache = NULL;
+
+static void
+add_trusted(dns_db_t *db, isc_stdtime_t now, const char *owner,
+	    size_t rdata_len, dns_trust_t trust) {
+	unsigned char rdatabuf[16] = { 0 };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname;
+	isc_result_t result;
+
+	REQUIRE(rdata_len <= sizeof(rdatabuf));
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	rdata.length = rdata_len;
+	rdata.data = rdatabuf;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = 50053;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = 50053;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+}
+
+/* Check the trust and RDATA length of the RRset cached at 'owner' */
+static void
+check_trusted(dns_db_t *db, const char *owner, size_t rdata_len,
+	      dns_trust_t trust) {
+	dns_fixedname_t fname, ffound;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, 50053, 0,
+			     isc_stdtime_now(), NULL,
+			     dns_fixedname_name(&ffound), &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, trust);
+
+	result = dns_rdataset_first(&rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_current(&rdataset, &rdata);
+	assert_int_equal(rdata.length, rdata_len);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+snapshot_import_done(void *arg, isc_result_t result) {
+	dns_db_t *db = NULL;
+
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	unlink("qpdb_test.snapshot");
+
+	dns_cache_attachdb(import_cache, &db);
+	/* Higher trust than the snapshot: kept */
+	check_trusted(db, "0.example.com.", 4, dns_trust_authauthority);
+	/* Lower trust than the snapshot: replaced */
+	check_trusted(db, "1.example.com.", 16, dns_trust_answer);
+	/* Not cached: added */
+	check_trusted(db, "2.example.com.", 16, dns_trust_answer);
+	dns_db_detach(&db);
+
+	dns_cache_detach(&import_cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(snapshot_import) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+
+	/* The snapshot written by the other process */
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+	add_trusted(db, now, "0.example.com.", 16, dns_trust_answer);
+	add_trusted(db, now, "1.example.com.", 16, dns_trust_answer);
+	add_trusted(db, now, "2.example.com.", 16, dns_trust_answer);
+	dns_db_detach(&db);
+	result = dns_cache_dump(cache, "qpdb_test.snapshot");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_detach(&cache);
+
+	/* The cache it is imported into */
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test2", NULL,
+				  mctx, &import_cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(import_cache, &db);
+	add_trusted(db, now, "0.example.com.", 4, dns_trust_authauthority);
+	add_trusted(db, now, "1.example.com.", 4, dns_trust_additional);
+	dns_db_detach(&db);
+
+	result = dns_cache_loadasync(import_cache, "qpdb_test.snapshot",
+				     isc_loop_main(loopmgr),
+				     snapshot_import_done, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Flushing a subtree expires the names at and below it, and nothing else.
+ */
+ISC_LOOP_TEST_IMPL(flushtree) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NULL,
+				  mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+	for (int i = 0; i < 3; i++) {
+		overmempurge_addrdataset(db, now, i, 50053, 16, false);
+	}
+
+	dns_test_namefromstring("1.example.com.", &fname);
+	result = dns_cache_flushnode(cache, dns_fixedname_name(&fname), true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(db_has(db, "0.example.com.", 50053));
+	assert_false(db_has(db, "1.example.com.", 50053));
+	assert_true(db_has(db, "2.example.com.", 50053));
+
+	/* a name that isn't in the cache, with names below it that are */
+	dns_test_namefromstring("example.com.", &fname);
+	result = dns_cache_flushnode(cache, dns_fixedname_name(&fname), true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(db_has(db, "0.example.com.", 50053));
+	assert_false(db_has(db, "2.example.com.", 50053));
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Add an RRset with a single record given as text at 'owner' to 'db'.
+ */
+static void
+add_text(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	 const char *text, isc_stdtime_t now) {
+	unsigned char data[256];
+	dns_fixedname_t fname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type,
+					  data, sizeof(data), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Check the NSEC3 owner name that matches or precedes 'hashed' in the
+ * auxiliary NSEC3 tree of 'db'; NULL means there is none.
+ */
+static void
+nsec3_predecessor_is(dns_db_t *db, const char *hashed, const char *expect) {
+	dns_fixedname_t fname, fpredecessor, fexpect;
+	dns_name_t *predecessor = dns_fixedname_initname(&fpredecessor);
+	isc_result_t result;
+
+	dns_test_namefromstring(hashed, &fname);
+	result = find_nsec3predecessor((qpcache_t *)db,
+				       dns_fixedname_name(&fname), predecessor);
+	if (expect == NULL) {
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		return;
+	}
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_test_namefromstring(expect, &fexpect);
+	assert_true(dns_name_equal(predecessor, dns_fixedname_name(&fexpect)));
+}
+
+/*
+ * Check that 'owner' is in the auxiliary NSEC tree if 'nsec', and in
+ * the auxiliary NSEC3 tree if 'nsec3'.
+ */
+static void
+auxnode_is(dns_db_t *db, const char *owner, bool nsec, bool nsec3) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	name = dns_fixedname_name(&fname);
+
+	result = dns_qp_getname(qpdb->nsec, name, NULL, NULL);
+	assert_int_equal(result == ISC_R_SUCCESS, nsec);
+	result = dns_qp_getname(qpdb->nsec3, name, NULL, NULL);
+	assert_int_equal(result == ISC_R_SUCCESS, nsec3);
+}
+
+#define HASH(c) c "0000000000000000000000000000000"
+
+/*
+ * A hashed name is matched or covered by the NSEC3 record at or before
+ * it in the same zone: the NSEC3 records of a child zone, which sort
+ * in between, are skipped, and a hash sorting before the whole chain
+ * wraps around to the last record in the zone.
+ */
+ISC_LOOP_TEST_IMPL(nsec3_covering) {
+	char *argv[1] = { (char *)mctx };
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "qpcache", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 1, argv,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	add_text(db, "example.", dns_rdatatype_ns, "ns.example.", now);
+	add_text(db, HASH("2") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("4") " A RRSIG", now);
+	add_text(db, HASH("4") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("v") " A RRSIG", now);
+	add_text(db, HASH("v") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("2") " NS SOA RRSIG DNSKEY NSEC3PARAM", now);
+	add_text(db, HASH("3") ".sub.example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("3") " NS SOA RRSIG DNSKEY NSEC3PARAM", now);
+
+	nsec3_predecessor_is(db, HASH("4") ".example.", HASH("4") ".example.");
+	nsec3_predecessor_is(db, HASH("5") ".example.", HASH("4") ".example.");
+	nsec3_predecessor_is(db, HASH("u") ".example.", HASH("4") ".example.");
+	nsec3_predecessor_is(db, HASH("1") ".example.", HASH("v") ".example.");
+	nsec3_predecessor_is(db, HASH("2") ".sub.example.",
+			     HASH("3") ".sub.example.");
+	nsec3_predecessor_is(db, HASH("2") ".other.", NULL);
+	nsec3_predecessor_is(db, "example.", NULL);
+
+	/* A find below the cached zone cut returns the covering NSEC3 */
+	dns_test_namefromstring(HASH("1") ".example.", &fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_nsec3,
+			     DNS_DBFIND_COVERINGNSEC | DNS_DBFIND_FORCENSEC3,
+			     now, NULL, found, &rdataset, NULL);
+	assert_int_equal(result, DNS_R_COVERINGNSEC);
+	assert_int_equal(rdataset.type, dns_rdatatype_nsec3);
+	dns_test_namefromstring(HASH("v") ".example.", &fname);
+	assert_true(dns_name_equal(found, dns_fixedname_name(&fname)));
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * A name that owns both an NSEC and an NSEC3 record, in either order,
+ * is indexed in both auxiliary trees.
+ */
+ISC_LOOP_TEST_IMPL(nsec3_auxnodes) {
+	char *argv[1] = { (char *)mctx };
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "qpcache", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 1, argv,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	add_text(db, HASH("2") ".example.", dns_rdatatype_nsec,
+		 "example. A RRSIG NSEC", now);
+	auxnode_is(db, HASH("2") ".example.", true, false);
+	add_text(db, HASH("2") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("4") " A RRSIG", now);
+	auxnode_is(db, HASH("2") ".example.", true, true);
+
+	add_text(db, HASH("4") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("2") " A RRSIG", now);
+	auxnode_is(db, HASH("4") ".example.", false, true);
+	add_text(db, HASH("4") ".example.", dns_rdatatype_nsec,
+		 "example. A RRSIG NSEC", now);
+	auxnode_is(db, HASH("4") ".example.", true, true);
+
+	/* Adding them again changes nothing */
+	add_text(db, HASH("4") ".example.", dns_rdatatype_nsec3,
+		 "1 0 0 - " HASH("2") " A RRSIG", now);
+	auxnode_is(db, HASH("4") ".example.", true, true);
+
+	nsec3_predecessor_is(db, HASH("2") ".example.", HASH("2") ".example.");
+	nsec3_predecessor_is(db, HASH("5") ".example.", HASH("4") ".example.");
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(overmempurge_bigrdata, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(overmempurge_longname, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(lru_requeue, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(sieve, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(lru_nxdomain, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(sieve_nxdomain, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_filtered, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_import, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(flushtree, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(nsec3_covering, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(nsec3_auxnodes, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -43,6 +43,8 @@
 #undef CHECK
 #include <tests/dns.h>
 
+#define TESTDIR TESTS_DIR "/testdata/qpzone/"
+
 #define CASESET(header)                                \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_CASESET) != 0)
@@ -216,9 +218,178 @@ ISC_RUN_TEST_IMPL(setownercase) {
 	assert_true(dns_name_caseequal(name1, name2));
 }
 
+static dns_db_t *
+loadzone(const char *origin, const char *file, dns_slabstore_t *store) {
+	dns_fixedname_t fixed;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(origin, &fixed);
+
+	result = dns_db_create(mctx, "qpzone", dns_fixedname_name(&fixed),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns__qpzone_setslabstore(db, store);
+
+	result = dns_db_load(db, file, dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (db);
+}
+
+/*
+ * Bind 'rdataset' to the 'type' RRset of 'owner' in 'db', and return
+ * its header.
+ */
+static dns_slabheader_t *
+findheader(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	   dns_rdataset_t *rdataset) {
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false,
+				 &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(rdataset);
+	result = dns_db_findrdataset(db, node, NULL, type, 0, 0, rdataset,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+
+	return (dns_slabheader_fromrdataset(rdataset));
+}
+
+/*
+ * Add or remove the 'type' record 'text' at 'owner' in a new version of
+ * 'db'.
+ */
+static void
+change(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+       const char *text, bool add) {
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char buf[1024];
+	isc_result_t result;
+
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type,
+					  buf, sizeof(buf), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false,
+				 &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_newversion(db, &version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	if (add) {
+		result = dns_db_addrdataset(db, node, version, 0, &rdataset,
+					    DNS_DBADD_MERGE, NULL);
+	} else {
+		result = dns_db_subtractrdataset(db, node, version, &rdataset,
+						 0, NULL);
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, true);
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+}
+
+/* identical RRsets loaded into zones using a slab store share records */
+ISC_LOOP_TEST_IMPL(slabstore) {
+	dns_slabstore_t *store = NULL;
+	dns_db_t *a = NULL, *b = NULL;
+	dns_rdataset_t ra, rb;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_slabheader_t *ha = NULL, *hb = NULL;
+	isc_result_t result;
+
+	dns_slabstore_create(mctx, &store);
+
+	/* NS, MX and the two address RRsets, but not the SOA */
+	a = loadzone("a.example.", TESTDIR "a.example.db", store);
+	assert_int_equal(dns_slabstore_count(store), 4);
+
+	/* only the address of www.b.example is new */
+	b = loadzone("b.example.", TESTDIR "b.example.db", store);
+	assert_int_equal(dns_slabstore_count(store), 5);
+
+	/* each zone keeps its own TTL */
+	ha = findheader(a, "a.example.", dns_rdatatype_ns, &ra);
+	hb = findheader(b, "b.example.", dns_rdatatype_ns, &rb);
+	assert_true(ha->shared && hb->shared);
+	assert_ptr_equal(dns_slabheader_raw(ha), dns_slabheader_raw(hb));
+	assert_int_equal(dns_rdataset_count(&ra), 2);
+	assert_int_equal(dns_rdataset_count(&rb), 2);
+	assert_int_equal(ra.ttl, 300);
+	assert_int_equal(rb.ttl, 600);
+	dns_rdataset_disassociate(&ra);
+	dns_rdataset_disassociate(&rb);
+
+	/* the same records at different names are shared too */
+	ha = findheader(a, "www.a.example.", dns_rdatatype_a, &ra);
+	hb = findheader(b, "ftp.b.example.", dns_rdatatype_a, &rb);
+	assert_ptr_equal(dns_slabheader_raw(ha), dns_slabheader_raw(hb));
+	result = dns_rdataset_first(&rb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_current(&rb, &rdata);
+	assert_int_equal(rdata.length, 4);
+	assert_memory_equal(rdata.data, "\xc0\x00\x02\x01", 4);
+	dns_rdataset_disassociate(&ra);
+	dns_rdataset_disassociate(&rb);
+
+	ha = findheader(a, "a.example.", dns_rdatatype_soa, &ra);
+	assert_false(ha->shared);
+	dns_rdataset_disassociate(&ra);
+
+	/* a changed RRset gets records of its own */
+	change(b, "b.example.", dns_rdatatype_ns, "ns3.hosting.example.", true);
+	hb = findheader(b, "b.example.", dns_rdatatype_ns, &rb);
+	assert_false(hb->shared);
+	assert_int_equal(dns_rdataset_count(&rb), 3);
+	dns_rdataset_disassociate(&rb);
+
+	change(a, "a.example.", dns_rdatatype_ns, "ns2.hosting.example.",
+	       false);
+	ha = findheader(a, "a.example.", dns_rdatatype_ns, &ra);
+	assert_false(ha->shared);
+	assert_int_equal(dns_rdataset_count(&ra), 1);
+	dns_rdataset_disassociate(&ra);
+
+	/* the RRsets that were not changed are still shared */
+	hb = findheader(b, "b.example.", dns_rdatatype_mx, &rb);
+	assert_true(hb->shared);
+	dns_rdataset_disassociate(&rb);
+
+	dns_db_detach(&a);
+	dns_db_detach(&b);
+	dns_slabstore_detach(&store);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(ownercase)
 ISC_TEST_ENTRY(setownercase)
+ISC_TEST_ENTRY_CUSTOM(slabstore, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -23,8 +23,11 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/buffer.h>
 #include <isc/util.h>
 
+#include <dns/compress.h>
+#include <dns/db.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 
@@ -101,8 +104,73 @@ ISC_RUN_TEST_IMPL(trimttl) {
 	assert_int_equal(sigrdataset.ttl, 0);
 }
 
+static void
+checkminsize(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	     unsigned int expect) {
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	unsigned char buf[1024];
+	unsigned int used, count = 0;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, type, 0, 0, &rdataset,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_int_equal(dns_rdataset_minsize(&rdataset), expect);
+
+	/*
+	 * Render the owner name first, so that the owner names of the
+	 * records are compressed; the rdataset still takes at least
+	 * the lower bound.
+	 */
+	isc_buffer_init(&target, buf, sizeof(buf));
+	dns_compress_init(&cctx, mctx, DNS_COMPRESS_CASE);
+	result = dns_name_towire(name, &cctx, &target, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	used = isc_buffer_usedlength(&target);
+	result = dns_rdataset_towire(&rdataset, name, &cctx, &target, 0,
+				     &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(isc_buffer_usedlength(&target) - used >= expect);
+	dns_compress_invalidate(&cctx);
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+}
+
+/* test the lower bound on the rendered size of rdatasets */
+ISC_LOOP_TEST_IMPL(minsize) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* one A record: the fixed fields and four octets of rdata */
+	checkminsize(db, "b.test.test.", dns_rdatatype_a, 16);
+
+	/* the names in NS and SOA rdata may be compressed away */
+	checkminsize(db, "a.test.test.", dns_rdatatype_ns, 3 * 12);
+	checkminsize(db, "test.test.", dns_rdatatype_soa, 12);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(trimttl)
+ISC_TEST_ENTRY_CUSTOM(minsize, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
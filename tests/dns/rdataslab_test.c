@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdataslab.h>
+
+#include <tests/dns.h>
+
+#define MAXRECORDS 8
+
+/*
+ * Make a slab of type 'type' out of the NULL-terminated list of
+ * records in 'texts'.
+ */
+static unsigned char *
+makeslab(dns_rdatatype_t type, const char **texts) {
+	static unsigned char data[MAXRECORDS][256];
+	dns_rdata_t rdata[MAXRECORDS];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	isc_region_t region;
+	isc_result_t result;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 300;
+
+	for (size_t i = 0; texts[i] != NULL; i++) {
+		INSIST(i < MAXRECORDS);
+		dns_rdata_init(&rdata[i]);
+		result = dns_test_rdatafromstring(&rdata[i], dns_rdataclass_in,
+						  type, data[i],
+						  sizeof(data[i]), texts[i],
+						  false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	result = dns_rdataslab_fromrdataset(&rdataset, mctx, &region, 0, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	return (region.base);
+}
+
+static void
+freeslab(unsigned char **slabp) {
+	isc_mem_put(mctx, *slabp, dns_rdataslab_size(*slabp, 0));
+}
+
+/*
+ * Merge 'new' into 'old', and check that the result has the records
+ * in 'expect', or that the merge fails with 'result'.
+ */
+static void
+checkmerge(dns_rdatatype_t type, const char **old, const char **new,
+	   unsigned int flags, isc_result_t expect_result,
+	   const char **expect) {
+	unsigned char *oslab = makeslab(type, old);
+	unsigned char *nslab = makeslab(type, new);
+	unsigned char *tslab = NULL;
+	isc_result_t result;
+
+	result = dns_rdataslab_merge(oslab, nslab, 0, mctx, dns_rdataclass_in,
+				     type, flags, 0, &tslab);
+	assert_int_equal(result, expect_result);
+	if (result == ISC_R_SUCCESS) {
+		unsigned char *eslab = makeslab(type, expect);
+
+		assert_true(dns_rdataslab_equal(tslab, eslab, 0));
+		assert_int_equal(dns_rdataslab_size(tslab, 0),
+				 dns_rdataslab_size(eslab, 0));
+		freeslab(&eslab);
+		freeslab(&tslab);
+	}
+
+	freeslab(&oslab);
+	freeslab(&nslab);
+}
+
+/*
+ * Subtract 'sub' from 'from', and check that the result has the
+ * records in 'expect', or that the subtraction fails with 'result'.
+ */
+static void
+checksubtract(dns_rdatatype_t type, const char **from, const char **sub,
+	      unsigned int flags, isc_result_t expect_result,
+	      const char **expect) {
+	unsigned char *mslab = makeslab(type, from);
+	unsigned char *sslab = makeslab(type, sub);
+	unsigned char *tslab = NULL;
+	isc_result_t result;
+
+	result = dns_rdataslab_subtract(mslab, sslab, 0, mctx,
+					dns_rdataclass_in, type, flags, &tslab);
+	assert_int_equal(result, expect_result);
+	if (result == ISC_R_SUCCESS) {
+		unsigned char *eslab = makeslab(type, expect);
+
+		assert_true(dns_rdataslab_equal(tslab, eslab, 0));
+		assert_int_equal(dns_rdataslab_size(tslab, 0),
+				 dns_rdataslab_size(eslab, 0));
+		freeslab(&eslab);
+		freeslab(&tslab);
+	}
+
+	freeslab(&mslab);
+	freeslab(&sslab);
+}
+
+/* merging slabs whose records compare byte by byte */
+ISC_RUN_TEST_IMPL(merge_bytewise) {
+	const char *a13[] = { "192.0.2.1", "192.0.2.3", NULL };
+	const char *a23[] = { "192.0.2.3", "192.0.2.2", NULL };
+	const char *a123[] = { "192.0.2.1", "192.0.2.2", "192.0.2.3", NULL };
+	const char *a3[] = { "192.0.2.3", NULL };
+	const char *txt1[] = { "\"b\"", "\"a\"", NULL };
+	const char *txt2[] = { "\"ab\"", "\"a\" \"b\"", NULL };
+	const char *txt12[] = { "\"a\"", "\"b\"", "\"ab\"", "\"a\" \"b\"",
+				NULL };
+
+	UNUSED(state);
+
+	checkmerge(dns_rdatatype_a, a13, a23, 0, ISC_R_SUCCESS, a123);
+	checkmerge(dns_rdatatype_a, a23, a13, 0, ISC_R_SUCCESS, a123);
+	checkmerge(dns_rdatatype_a, a13, a23, DNS_RDATASLAB_EXACT,
+		   ISC_R_SUCCESS, a123);
+	checkmerge(dns_rdatatype_a, a123, a3, 0, DNS_R_UNCHANGED, NULL);
+	checkmerge(dns_rdatatype_a, a123, a3, DNS_RDATASLAB_EXACT,
+		   DNS_R_UNCHANGED, NULL);
+	checkmerge(dns_rdatatype_a, a123, a3, DNS_RDATASLAB_FORCE,
+		   ISC_R_SUCCESS, a123);
+	checkmerge(dns_rdatatype_txt, txt1, txt2, DNS_RDATASLAB_EXACT,
+		   ISC_R_SUCCESS, txt12);
+}
+
+/* merging slabs whose records contain names */
+ISC_RUN_TEST_IMPL(merge_names) {
+	const char *ns1[] = { "NS2.example.", "ns1.example.", NULL };
+	const char *ns2[] = { "ns3.example.", "ns2.EXAMPLE.", NULL };
+	const char *ns123[] = { "ns1.example.", "ns2.example.",
+				"ns3.example.", NULL };
+	const char *merged[] = { "ns1.example.", "NS2.example.",
+				 "ns3.example.", NULL };
+
+	UNUSED(state);
+
+	/* where both have the same record, the old one is kept */
+	checkmerge(dns_rdatatype_ns, ns1, ns2, 0, ISC_R_SUCCESS, merged);
+	checkmerge(dns_rdatatype_ns, ns1, ns2, DNS_RDATASLAB_EXACT,
+		   ISC_R_SUCCESS, merged);
+	checkmerge(dns_rdatatype_ns, ns123, ns1, 0, DNS_R_UNCHANGED, NULL);
+}
+
+/* subtracting slabs whose records compare byte by byte */
+ISC_RUN_TEST_IMPL(subtract_bytewise) {
+	const char *a123[] = { "192.0.2.1", "192.0.2.2", "192.0.2.3", NULL };
+	const char *a24[] = { "192.0.2.4", "192.0.2.2", NULL };
+	const char *a13[] = { "192.0.2.1", "192.0.2.3", NULL };
+	const char *a4[] = { "192.0.2.4", NULL };
+
+	UNUSED(state);
+
+	checksubtract(dns_rdatatype_a, a123, a24, 0, ISC_R_SUCCESS, a13);
+	checksubtract(dns_rdatatype_a, a123, a24, DNS_RDATASLAB_EXACT,
+		      DNS_R_NOTEXACT, NULL);
+	checksubtract(dns_rdatatype_a, a123, a4, 0, DNS_R_UNCHANGED, NULL);
+	checksubtract(dns_rdatatype_a, a13, a123, 0, DNS_R_NXRRSET, NULL);
+}
+
+/* subtracting slabs whose records contain names */
+ISC_RUN_TEST_IMPL(subtract_names) {
+	const char *ns123[] = { "ns1.example.", "ns2.example.",
+				"ns3.example.", NULL };
+	const char *ns2[] = { "NS2.Example.", NULL };
+	const char *ns13[] = { "ns3.example.", "ns1.example.", NULL };
+
+	UNUSED(state);
+
+	checksubtract(dns_rdatatype_ns, ns123, ns2, DNS_RDATASLAB_EXACT,
+		      ISC_R_SUCCESS, ns13);
+}
+
+/*
+ * Check whether a slab of type 'type' with the records in 'texts' gets
+ * packed, and that it unpacks to the original.
+ */
+static void
+checkpack(dns_rdatatype_t type, const char **texts, bool expect) {
+	unsigned char *slab = makeslab(type, texts);
+	unsigned char *unpacked = NULL;
+	unsigned int size = dns_rdataslab_size(slab, 0);
+	isc_region_t region = { .base = slab, .length = size };
+
+	assert_int_equal(dns_rdataslab_pack(mctx, &region, 0,
+					    dns_rdataclass_in, type),
+			 expect);
+	if (!expect) {
+		assert_ptr_equal(region.base, slab);
+		freeslab(&slab);
+		return;
+	}
+
+	/* the original slab was freed */
+	slab = makeslab(type, texts);
+	assert_int_equal(dns_rdataslab_size(region.base, 0), region.length);
+	assert_true(region.length < size);
+	assert_int_equal(dns_rdataslab_count(region.base, 0),
+			 dns_rdataslab_count(slab, 0));
+
+	unpacked = dns_rdataslab_unpack(region.base, 0, mctx);
+	assert_int_equal(dns_rdataslab_size(unpacked, 0), size);
+	assert_true(dns_rdataslab_equal(unpacked, slab, 0));
+
+	freeslab(&unpacked);
+	freeslab(&slab);
+	isc_mem_put(mctx, region.base, region.length);
+}
+
+/* packing large TXT and HTTPS RRsets */
+ISC_RUN_TEST_IMPL(pack) {
+	const char *txt[] = {
+		"\"v=spf1 include:_spf.google.com "
+		"include:spf.protection.outlook.com ~all\"",
+		"\"google-site-verification=0123456789abcdefghijklmnopqrstu\"",
+		"\"facebook-domain-verification=abcdefghijklmnopqrst\"",
+		"\"MS=ms12345678\"",
+		"\"an \\127 escape\"",
+		NULL
+	};
+	const char *https[] = {
+		"1 . alpn=\"h3,h2\" ipv4hint=192.0.2.1,192.0.2.2 "
+		"ipv6hint=2001:db8::1,2001:db8::2",
+		"2 . alpn=\"h3,h2\" ipv4hint=192.0.2.3,192.0.2.4 "
+		"ipv6hint=2001:db8::3,2001:db8::4",
+		"3 . alpn=\"h2\" ipv4hint=192.0.2.5 ipv6hint=2001:db8::5",
+		NULL
+	};
+	const char *small[] = { "\"v=spf1 -all\"", NULL };
+	const char *a[] = { "192.0.2.1", "192.0.2.2", NULL };
+
+	UNUSED(state);
+
+	checkpack(dns_rdatatype_txt, txt, true);
+	checkpack(dns_rdatatype_https, https, true);
+	checkpack(dns_rdatatype_txt, small, false);
+	checkpack(dns_rdatatype_a, a, false);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(merge_bytewise)
+ISC_TEST_ENTRY(merge_names)
+ISC_TEST_ENTRY(subtract_bytewise)
+ISC_TEST_ENTRY(subtract_names)
+ISC_TEST_ENTRY(pack)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/region.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+#include <dns/respcache.h>
+
+#include <tests/dns.h>
+
+#define TEST_FLAGS   0x0100
+#define TEST_VERSION 42
+
+static unsigned char response[] = { 0x12, 0x34, 0x84, 0x00, 0x00, 0x01,
+				    0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+
+ISC_LOOP_TEST_IMPL(basic) {
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_region_t r = { response, sizeof(response) };
+	isc_region_t found = { NULL, 0 };
+	unsigned int aux = 0;
+	isc_result_t result;
+
+	dns_name_fromstring(name, "example.com.", NULL, 0, NULL);
+
+	dns_respcache_create(mctx, isc_loopmgr_nloops(loopmgr), 16, &cache);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_add(cache, name, dns_rdatatype_a, dns_rdataclass_in,
+			  TEST_FLAGS, TEST_VERSION, now + 1, &r, 7);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(found.length, sizeof(response));
+	assert_memory_equal(found.base, response, sizeof(response));
+	assert_int_equal(aux, 7);
+
+	/* Every part of the key must match */
+	result = dns_respcache_find(cache, name, dns_rdatatype_aaaa,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_ch, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, 0, TEST_VERSION, now,
+				    &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS,
+				    TEST_VERSION + 1, now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	/* Names are compared case-sensitively */
+	dns_name_fromstring(name, "Example.com.", NULL, 0, NULL);
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&cache);
+	assert_null(cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(expire) {
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_region_t r = { response, sizeof(response) };
+	isc_region_t found = { NULL, 0 };
+	unsigned int aux = 0;
+	isc_result_t result;
+
+	dns_name_fromstring(name, "example.com.", NULL, 0, NULL);
+
+	dns_respcache_create(mctx, isc_loopmgr_nloops(loopmgr), 16, &cache);
+
+	dns_respcache_add(cache, name, dns_rdatatype_a, dns_rdataclass_in,
+			  TEST_FLAGS, TEST_VERSION, now + 1, &r, 0);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now + 1, &found, &aux);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now + 2, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(replace) {
+	dns_respcache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_stdtime_t now = isc_stdtime_now();
+	unsigned char big[DNS_RESPCACHE_MAXWIRE + 1] = { 0 };
+	isc_region_t r = { response, sizeof(response) };
+	isc_region_t found = { NULL, 0 };
+	unsigned int aux = 0;
+	isc_result_t result;
+
+	dns_name_fromstring(name, "example.com.", NULL, 0, NULL);
+
+	dns_respcache_create(mctx, isc_loopmgr_nloops(loopmgr), 1, &cache);
+
+	dns_respcache_add(cache, name, dns_rdatatype_a, dns_rdataclass_in,
+			  TEST_FLAGS, TEST_VERSION, now + 1, &r, 1);
+
+	/* A newer version of the zone replaces the older response */
+	r.length = DNS_MESSAGE_HEADERLEN - 2;
+	dns_respcache_add(cache, name, dns_rdatatype_a, dns_rdataclass_in,
+			  TEST_FLAGS, TEST_VERSION + 1, now + 1, &r, 2);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS, TEST_VERSION,
+				    now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_respcache_find(cache, name, dns_rdatatype_a,
+				    dns_rdataclass_in, TEST_FLAGS,
+				    TEST_VERSION + 1, now, &found, &aux);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(found.length, DNS_MESSAGE_HEADERLEN - 2);
+	assert_int_equal(aux, 2);
+
+	/* Oversized responses are not cached */
+	r.base = big;
+	r.length = sizeof(big);
+	dns_respcache_add(cache, name, dns_rdatatype_aaaa, dns_rdataclass_in,
+			  TEST_FLAGS, TEST_VERSION + 1, now + 1, &r, 3);
+	result = dns_respcache_find(cache, name, dns_rdatatype_aaaa,
+				    dns_rdataclass_in, TEST_FLAGS,
+				    TEST_VERSION + 1, now, &found, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(basic, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(expire, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(replace, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
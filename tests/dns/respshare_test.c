@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * The response sharing table of a view is a dns_respcache_t keyed by
+ * the downcased question name and by the identifier of the fetch
+ * context in place of the zone version, as in lib/ns/query.c.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/region.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+#include <dns/respcache.h>
+
+#include <tests/dns.h>
+
+#define TEST_FLAGS 0x0100
+#define FETCH1	   1
+#define FETCH2	   2
+
+static unsigned char response1[] = { 0x12, 0x34, 0x81, 0x80, 0x00, 0x01,
+				     0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+static unsigned char response2[] = { 0x56, 0x78, 0x81, 0x80, 0x00, 0x01,
+				     0x00, 0x02, 0x00, 0x00, 0x00, 0x00 };
+
+/*
+ * Look up the response shared for 'qname', as the client of fetch
+ * 'fetchid' would.
+ */
+static isc_result_t
+find(dns_respcache_t *cache, const char *qname, uint64_t fetchid,
+     isc_stdtime_t now, isc_region_t *found) {
+	dns_fixedname_t fname, fdown;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *down = dns_fixedname_initname(&fdown);
+	unsigned int aux = 0;
+
+	dns_name_fromstring(name, qname, NULL, 0, NULL);
+	RUNTIME_CHECK(dns_name_downcase(name, down, NULL) == ISC_R_SUCCESS);
+
+	return (dns_respcache_find(cache, down, dns_rdatatype_a,
+				   dns_rdataclass_in, TEST_FLAGS, fetchid, now,
+				   found, &aux));
+}
+
+/*
+ * Share the response 'r' to 'qname' for the clients of fetch 'fetchid'.
+ */
+static void
+share(dns_respcache_t *cache, const char *qname, uint64_t fetchid,
+      isc_stdtime_t expire, isc_region_t *r) {
+	dns_fixedname_t fname, fdown;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *down = dns_fixedname_initname(&fdown);
+
+	dns_name_fromstring(name, qname, NULL, 0, NULL);
+	RUNTIME_CHECK(dns_name_downcase(name, down, NULL) == ISC_R_SUCCESS);
+
+	dns_respcache_add(cache, down, dns_rdatatype_a, dns_rdataclass_in,
+			  TEST_FLAGS, fetchid, expire, r, 0);
+}
+
+/* A response is shared with every client of its fetch, in any case */
+ISC_LOOP_TEST_IMPL(fetch) {
+	dns_respcache_t *cache = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_region_t r = { response1, sizeof(response1) };
+	isc_region_t found = { NULL, 0 };
+	isc_result_t result;
+
+	dns_respcache_create(mctx, isc_loopmgr_nloops(loopmgr), 16, &cache);
+
+	result = find(cache, "www.example.com.", FETCH1, now, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	share(cache, "WWW.example.com.", FETCH1, now + 1, &r);
+
+	result = find(cache, "www.example.com.", FETCH1, now, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(found.length, sizeof(response1));
+	assert_memory_equal(found.base, response1, sizeof(response1));
+
+	result = find(cache, "www.EXAMPLE.com.", FETCH1, now, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Not with the clients of another fetch for the same question */
+	result = find(cache, "www.example.com.", FETCH2, now, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	/* Nor after it expires */
+	result = find(cache, "www.example.com.", FETCH1, now + 2, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* The response to a later fetch for the same question replaces it */
+ISC_LOOP_TEST_IMPL(refetch) {
+	dns_respcache_t *cache = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_region_t r1 = { response1, sizeof(response1) };
+	isc_region_t r2 = { response2, sizeof(response2) };
+	isc_region_t found = { NULL, 0 };
+	isc_result_t result;
+
+	dns_respcache_create(mctx, isc_loopmgr_nloops(loopmgr), 1, &cache);
+
+	share(cache, "www.example.com.", FETCH1, now + 1, &r1);
+	share(cache, "www.example.com.", FETCH2, now + 1, &r2);
+
+	result = find(cache, "www.example.com.", FETCH1, now, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = find(cache, "www.example.com.", FETCH2, now, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(found.length, sizeof(response2));
+	assert_memory_equal(found.base, response2, sizeof(response2));
+
+	dns_respcache_destroy(&cache);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(fetch, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(refetch, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
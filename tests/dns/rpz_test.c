@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/file.h>
+#include <isc/ht.h>
+#include <isc/netaddr.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/diff.h>
+#include <dns/journal.h>
+#include <dns/rpz.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#define ORIGIN	"rpz."
+#define JOURNAL "./rpz.jnl"
+
+/*
+ * Transaction from serial 1 to 2: triggers are removed, added, and
+ * changed without appearing or disappearing.
+ */
+static const zonechange_t changes1[] = {
+	{ DNS_DIFFOP_DEL, ORIGIN, 300, "SOA", ". . 1 0 0 0 0" },
+	{ DNS_DIFFOP_ADD, ORIGIN, 300, "SOA", ". . 2 0 0 0 0" },
+	{ DNS_DIFFOP_DEL, "a.example." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_DEL, "b.example." ORIGIN, 300, "CNAME", "*." },
+	{ DNS_DIFFOP_ADD, "b.example." ORIGIN, 300, "A", "10.53.0.1" },
+	{ DNS_DIFFOP_DEL, "*.c.example." ORIGIN, 300, "CNAME",
+	  "rpz-passthru." },
+	{ DNS_DIFFOP_ADD, "d.example." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_ADD, "*.e.example." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_ADD, "24.0.2.0.192.rpz-ip." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_DEL, "ns.example.rpz-nsdname." ORIGIN, 300, "CNAME",
+	  "." },
+	ZONECHANGE_SENTINEL,
+};
+
+/*
+ * Transaction from serial 2 to 3, of which the journal only records
+ * the SOA and the first trigger.
+ */
+static const zonechange_t changes2[] = {
+	{ DNS_DIFFOP_DEL, ORIGIN, 300, "SOA", ". . 2 0 0 0 0" },
+	{ DNS_DIFFOP_ADD, ORIGIN, 300, "SOA", ". . 3 0 0 0 0" },
+	{ DNS_DIFFOP_ADD, "f.example." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_ADD, "g.example." ORIGIN, 300, "CNAME", "." },
+	ZONECHANGE_SENTINEL,
+};
+#define CHANGES2_JOURNALED 3
+
+/*
+ * Transaction from serial 3 to 4, which is not in the journal.
+ */
+static const zonechange_t changes3[] = {
+	{ DNS_DIFFOP_DEL, ORIGIN, 300, "SOA", ". . 3 0 0 0 0" },
+	{ DNS_DIFFOP_ADD, ORIGIN, 300, "SOA", ". . 4 0 0 0 0" },
+	{ DNS_DIFFOP_ADD, "h.example." ORIGIN, 300, "CNAME", "." },
+	{ DNS_DIFFOP_DEL, "d.example." ORIGIN, 300, "CNAME", "." },
+	ZONECHANGE_SENTINEL,
+};
+
+/* Names looked up to compare summaries */
+static const char *qnames[] = {
+	"a.example.", "b.example.",   "x.c.example.", "d.example.",
+	"e.example.", "x.e.example.", "f.example.",   "g.example.",
+	"h.example.", "example.",     NULL,
+};
+static const char *nsdnames[] = { "ns.example.", NULL };
+static const char *addresses[] = { "127.0.0.1", "192.0.2.1", "192.0.3.1",
+				   NULL };
+
+static dns_view_t *view = NULL;
+static dns_db_t *db = NULL;
+static dns_rpz_zones_t *rpzs = NULL, *fullrpzs = NULL;
+static isc_timer_t *polltimer = NULL;
+static unsigned int step = 0;
+
+static void
+setname(dns_name_t *name, const char *str) {
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, str, NULL, DNS_NAME_DOWNCASE, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Create a set of policy zones with one policy zone summarizing 'db',
+ * and start the update.
+ */
+static dns_rpz_zones_t *
+newrpzs(const char *journal) {
+	dns_rpz_zones_t *zones = NULL;
+	dns_rpz_zone_t *rpz = NULL;
+	isc_result_t result;
+
+	result = dns_rpz_new_zones(view, loopmgr, &zones);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_rpz_new_zone(zones, &rpz);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	setname(&rpz->origin, ORIGIN);
+	setname(&rpz->client_ip, DNS_RPZ_CLIENT_IP_ZONE "." ORIGIN);
+	setname(&rpz->ip, DNS_RPZ_IP_ZONE "." ORIGIN);
+	setname(&rpz->nsdname, DNS_RPZ_NSDNAME_ZONE "." ORIGIN);
+	setname(&rpz->nsip, DNS_RPZ_NSIP_ZONE "." ORIGIN);
+	dns_rpz_setjournal(rpz, journal);
+
+	result = dns_rpz_dbupdate_callback(db, rpz);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (zones);
+}
+
+static void
+freerpzs(dns_rpz_zones_t **zonesp) {
+	dns_rpz_zones_shutdown(*zonesp);
+	dns_rpz_zones_detach(zonesp);
+}
+
+static bool
+busy(dns_rpz_zones_t *zones) {
+	dns_rpz_zone_t *rpz = zones->zones[0];
+	bool result;
+
+	LOCK(&zones->maint_lock);
+	result = rpz->updatepending || rpz->updaterunning;
+	UNLOCK(&zones->maint_lock);
+
+	return (result);
+}
+
+/*
+ * Commit 'changes' to 'db' and the first 'journaled' of them to the
+ * journal, then tell the policy zone.
+ */
+static void
+commit(const zonechange_t *changes, size_t journaled) {
+	dns_dbversion_t *version = NULL;
+	dns_diff_t diff;
+	isc_result_t result;
+
+	result = dns_test_difffromchanges(&diff, changes, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_newversion(db, &version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, true);
+	dns_diff_clear(&diff);
+
+	if (journaled != 0) {
+		dns_journal_t *j = NULL;
+		zonechange_t partial[10];
+
+		assert_true(journaled < ARRAY_SIZE(partial));
+		memmove(partial, changes, journaled * sizeof(partial[0]));
+		partial[journaled] = (zonechange_t)ZONECHANGE_SENTINEL;
+
+		result = dns_test_difffromchanges(&diff, partial, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE,
+					  &j);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_journal_write_transaction(j, &diff);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_journal_destroy(&j);
+		dns_diff_clear(&diff);
+	}
+
+	result = dns_rpz_dbupdate_callback(db, rpzs->zones[0]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static size_t
+nchanges(const zonechange_t *changes) {
+	size_t n = 0;
+
+	while (changes[n].owner != NULL) {
+		n++;
+	}
+	return (n);
+}
+
+static dns_rpz_zbits_t
+findname(dns_rpz_zones_t *zones, dns_rpz_type_t type, const char *str) {
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(str, &fname);
+	return (dns_rpz_find_name(zones, type, DNS_RPZ_ALL_ZBITS,
+				  dns_fixedname_name(&fname)));
+}
+
+static dns_rpz_num_t
+findip(dns_rpz_zones_t *zones, const char *str) {
+	dns_fixedname_t fname;
+	dns_rpz_prefix_t prefix;
+	isc_netaddr_t netaddr;
+	struct in_addr in;
+
+	RUNTIME_CHECK(inet_pton(AF_INET, str, &in) == 1);
+	isc_netaddr_fromin(&netaddr, &in);
+	return (dns_rpz_find_ip(zones, DNS_RPZ_TYPE_IP, DNS_RPZ_ALL_ZBITS,
+				&netaddr, dns_fixedname_initname(&fname),
+				&prefix));
+}
+
+/*
+ * Check that the summary updated from the journal is the one built
+ * from scratch.
+ */
+static void
+compare(void) {
+	dns_rpz_zone_t *rpz = rpzs->zones[0];
+	dns_rpz_zone_t *full = fullrpzs->zones[0];
+	isc_ht_iter_t *iter = NULL;
+	isc_result_t result;
+	uint32_t serial;
+
+	assert_true(rpz->summarized);
+	assert_int_equal(dns_db_getsoaserial(db, NULL, &serial),
+			 ISC_R_SUCCESS);
+	assert_int_equal(rpz->serial, serial);
+
+	assert_int_equal(isc_ht_count(rpz->nodes), isc_ht_count(full->nodes));
+	isc_ht_iter_create(rpz->nodes, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		assert_int_equal(isc_ht_find(full->nodes, key, keysize, NULL),
+				 ISC_R_SUCCESS);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	assert_memory_equal(&rpzs->triggers[0], &fullrpzs->triggers[0],
+			    sizeof(rpzs->triggers[0]));
+
+	for (size_t i = 0; qnames[i] != NULL; i++) {
+		assert_int_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, qnames[i]),
+			findname(fullrpzs, DNS_RPZ_TYPE_QNAME, qnames[i]));
+	}
+	for (size_t i = 0; nsdnames[i] != NULL; i++) {
+		assert_int_equal(
+			findname(rpzs, DNS_RPZ_TYPE_NSDNAME, nsdnames[i]),
+			findname(fullrpzs, DNS_RPZ_TYPE_NSDNAME, nsdnames[i]));
+	}
+	for (size_t i = 0; addresses[i] != NULL; i++) {
+		assert_int_equal(findip(rpzs, addresses[i]),
+				 findip(fullrpzs, addresses[i]));
+	}
+}
+
+static void
+poll_cb(void *arg ISC_ATTR_UNUSED) {
+	if (busy(rpzs) || (fullrpzs != NULL && busy(fullrpzs))) {
+		return;
+	}
+
+	switch (step++) {
+	case 0:
+		/* The first summary is always built from the zone */
+		commit(changes1, nchanges(changes1));
+		break;
+	case 1:
+		fullrpzs = newrpzs(NULL);
+		break;
+	case 2:
+		/* Same as a rebuild */
+		compare();
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "d.example."), 0);
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "x.e.example."), 0);
+		assert_int_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "a.example."), 0);
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "b.example."), 0);
+		assert_int_not_equal(findip(rpzs, "192.0.2.1"),
+				     DNS_RPZ_INVALID_NUM);
+		freerpzs(&fullrpzs);
+
+		commit(changes2, CHANGES2_JOURNALED);
+		break;
+	case 3:
+		/*
+		 * Only the changes in the journal were applied, which
+		 * shows that the zone was not rescanned.
+		 */
+		assert_true(rpzs->zones[0]->summarized);
+		assert_int_equal(rpzs->zones[0]->serial, 3);
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "f.example."), 0);
+		assert_int_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "g.example."), 0);
+
+		/* The journal does not reach serial 4 */
+		commit(changes3, 0);
+		break;
+	case 4:
+		fullrpzs = newrpzs(NULL);
+		break;
+	case 5:
+		/* The fallback rescan picked up everything */
+		compare();
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "g.example."), 0);
+		assert_int_not_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "h.example."), 0);
+		assert_int_equal(
+			findname(rpzs, DNS_RPZ_TYPE_QNAME, "d.example."), 0);
+		freerpzs(&fullrpzs);
+
+		isc_timer_stop(polltimer);
+		isc_timer_destroy(&polltimer);
+		freerpzs(&rpzs);
+		dns_db_detach(&db);
+		dns_view_detach(&view);
+		(void)isc_file_remove(JOURNAL);
+
+		isc_loopmgr_shutdown(loopmgr);
+		break;
+	default:
+		UNREACHABLE();
+	}
+}
+
+/*
+ * Policy zone summaries updated from the journal are the same as when
+ * they are built from the zone, and the zone is rescanned when the
+ * journal does not have the changes.
+ */
+ISC_LOOP_TEST_IMPL(update_from_journal) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	(void)isc_file_remove(JOURNAL);
+
+	result = dns_test_makeview("view", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_loaddb(&db, dns_dbtype_zone, ORIGIN,
+				 TESTS_DIR "/testdata/rpz/rpz.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	rpzs = newrpzs(JOURNAL);
+
+	isc_interval_set(&interval, 0, 10 * NS_PER_MS);
+	isc_timer_create(mainloop, poll_cb, NULL, &polltimer);
+	isc_timer_start(polltimer, isc_timertype_ticker, &interval);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(update_from_journal, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * As a workaround, include an OpenSSL header file before including cmocka.h,
+ * because OpenSSL 3.1.0 uses __attribute__(malloc), conflicting with a
+ * redefined malloc in cmocka.h.
+ */
+#include <openssl/err.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/result.h>
+#include <isc/stdio.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/dnssec.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+#define CACHEFILE "./sigcache.out"
+
+static dns_fixedname_t fname;
+static dns_name_t *name = NULL;
+static dst_key_t *key = NULL;
+static dns_rdata_t rdata = DNS_RDATA_INIT;
+static unsigned char rdatabuf[4];
+static dns_rdatalist_t rdatalist;
+static dns_rdataset_t rdataset;
+
+static int
+setup_test(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("test.", &fname);
+	result = dst_key_fromfile(name, 49130, DST_ALG_ECDSA256,
+				  DST_TYPE_PUBLIC | DST_TYPE_PRIVATE,
+				  TESTS_DIR "/testdata/dst", mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdata_init(&rdata);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_a, rdatabuf,
+					  sizeof(rdatabuf), "192.0.2.1", false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dns_rdataset_disassociate(&rdataset);
+	ISC_LIST_UNLINK(rdatalist.rdata, &rdata, link);
+	dst_key_free(&key);
+	(void)isc_file_remove(CACHEFILE);
+
+	return (0);
+}
+
+/*
+ * Sign 'rdataset' for 'validity' seconds from 'now' and add the signature
+ * to 'cache'.
+ */
+static void
+addsig(dns_sigcache_t *cache, isc_stdtime_t now, isc_stdtime_t validity,
+       unsigned char *data, size_t size, dns_rdata_t *sigrdata) {
+	isc_stdtime_t inception = now - 3600, expire = now + validity;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	isc_buffer_init(&buffer, data, size);
+	result = dns_dnssec_sign(name, &rdataset, key, &inception, &expire,
+				 mctx, &buffer, sigrdata);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_sigcache_add(cache, name, &rdataset, key, sigrdata);
+}
+
+static isc_result_t
+findsig(dns_sigcache_t *cache, isc_stdtime_t now, isc_stdtime_t minexpire,
+	dns_rdata_t *sigrdata) {
+	static unsigned char data[512];
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	dns_rdata_reset(sigrdata);
+	return (dns_sigcache_find(cache, name, &rdataset, key, now, minexpire,
+				  &buffer, sigrdata));
+}
+
+/* signatures are found for the same RRset and key only */
+ISC_RUN_TEST_IMPL(findsig) {
+	dns_sigcache_t *cache = NULL;
+	dns_rdata_t sigrdata = DNS_RDATA_INIT, found = DNS_RDATA_INIT;
+	unsigned char data[512];
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result;
+
+	dns_sigcache_create(mctx, &cache);
+
+	assert_int_equal(findsig(cache, now, now, &found), ISC_R_NOTFOUND);
+
+	addsig(cache, now, 86400, data, sizeof(data), &sigrdata);
+	result = findsig(cache, now, now + 3600, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_rdata_compare(&sigrdata, &found), 0);
+
+	/* not yet valid, or expiring too soon */
+	assert_int_equal(findsig(cache, now - 7200, now, &found),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(findsig(cache, now, now + 2 * 86400, &found),
+			 ISC_R_NOTFOUND);
+
+	/* the TTL is part of the signed data */
+	rdataset.ttl = 600;
+	assert_int_equal(findsig(cache, now, now, &found), ISC_R_NOTFOUND);
+	rdataset.ttl = 300;
+
+	/* a signature that expires later replaces the cached one */
+	dns_rdata_reset(&sigrdata);
+	addsig(cache, now, 2 * 86400, data, sizeof(data), &sigrdata);
+	result = findsig(cache, now, now + 86400 + 3600, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_rdata_compare(&sigrdata, &found), 0);
+
+	dns_sigcache_destroy(&cache);
+}
+
+/* the cache survives being saved and loaded back */
+ISC_RUN_TEST_IMPL(saveload) {
+	dns_sigcache_t *cache = NULL;
+	dns_rdata_t sigrdata = DNS_RDATA_INIT, found = DNS_RDATA_INIT;
+	unsigned char data[512];
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result;
+	FILE *fp = NULL;
+
+	(void)isc_file_remove(CACHEFILE);
+
+	dns_sigcache_create(mctx, &cache);
+	assert_int_equal(dns_sigcache_load(cache, CACHEFILE),
+			 ISC_R_FILENOTFOUND);
+
+	/* nothing is written until there is something new */
+	assert_int_equal(dns_sigcache_save(cache, CACHEFILE, now),
+			 ISC_R_SUCCESS);
+	assert_false(isc_file_exists(CACHEFILE));
+
+	addsig(cache, now, 86400, data, sizeof(data), &sigrdata);
+	assert_int_equal(dns_sigcache_save(cache, CACHEFILE, now),
+			 ISC_R_SUCCESS);
+	dns_sigcache_destroy(&cache);
+
+	dns_sigcache_create(mctx, &cache);
+	assert_int_equal(dns_sigcache_load(cache, CACHEFILE), ISC_R_SUCCESS);
+	result = findsig(cache, now, now + 3600, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_rdata_compare(&sigrdata, &found), 0);
+
+	/* expired signatures are dropped when saving */
+	dns_rdata_reset(&sigrdata);
+	addsig(cache, now, 2 * 86400, data, sizeof(data), &sigrdata);
+	assert_int_equal(dns_sigcache_save(cache, CACHEFILE, now + 3 * 86400),
+			 ISC_R_SUCCESS);
+	dns_sigcache_destroy(&cache);
+
+	dns_sigcache_create(mctx, &cache);
+	assert_int_equal(dns_sigcache_load(cache, CACHEFILE), ISC_R_SUCCESS);
+	assert_int_equal(findsig(cache, now, now, &found), ISC_R_NOTFOUND);
+	dns_sigcache_destroy(&cache);
+
+	/* a file that is not a cache file */
+	result = isc_stdio_open(CACHEFILE, "w", &fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	fputs("not a signature cache\n", fp);
+	result = isc_stdio_close(fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_sigcache_create(mctx, &cache);
+	assert_int_equal(dns_sigcache_load(cache, CACHEFILE), DNS_R_FORMERR);
+	dns_sigcache_destroy(&cache);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(findsig, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(saveload, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
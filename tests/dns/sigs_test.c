@@ -28,18 +28,24 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/stdtime.h>
+#include <isc/timer.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/dbiterator.h>
 #include <dns/diff.h>
 #include <dns/dnssec.h>
 #include <dns/fixedname.h>
+#include <dns/masterdump.h>
 #include <dns/name.h>
 #include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/types.h>
+#include <dns/view.h>
 #include <dns/zone.h>
 
 #include <dst/dst.h>
@@ -412,8 +418,210 @@ ISC_RUN_TEST_IMPL(updatesigs_next) {
 	dns_zone_detach(&zone);
 }
 
+/*
+ * zone_sign() test: the zone is signed in quanta of a few signatures,
+ * each computed on the offload threads between two passes over the
+ * same nodes, while two keys of the same algorithm are being added.
+ */
+#define SIGN_ZONEFILE "./zonesign.data"
+#define SIGN_KSK      20386
+#define SIGN_ZSK      37464
+#define SIGN_NAMES    40
+#define SIGN_SETTLE   20   /* ticks to wait once the zone is signed */
+#define SIGN_TIMEOUT  1000 /* ticks before giving up */
+
+static dns_zone_t *signzone = NULL;
+static isc_timer_t *signtimer = NULL;
+static unsigned int signticks = 0, signedtick = 0;
+
+/*
+ * Check that no key signed 'sigs' more than once.
+ */
+static void
+check_nodup(dns_rdataset_t *sigs) {
+	dns_rdata_rrsig_t seen[16];
+	unsigned int nseen = 0;
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(sigs); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(sigs))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t rrsig;
+
+		dns_rdataset_current(sigs, &rdata);
+		result = dns_rdata_tostruct(&rdata, &rrsig, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		for (unsigned int i = 0; i < nseen; i++) {
+			assert_false(seen[i].algorithm == rrsig.algorithm &&
+				     seen[i].keyid == rrsig.keyid);
+		}
+		assert_true(nseen < ARRAY_SIZE(seen));
+		seen[nseen++] = rrsig;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+}
+
+/*
+ * Return true once every RRset in 'db' is signed.
+ */
+static bool
+check_signed(dns_db_t *db) {
+	dns_dbiterator_t *dbiter = NULL;
+	bool complete = true;
+	isc_result_t result;
+
+	result = dns_db_createiterator(db, 0, &dbiter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		dns_dbnode_t *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+		dns_rdataset_t rdataset, sigs;
+
+		result = dns_dbiterator_current(dbiter, &node, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_dbiterator_pause(dbiter);
+
+		result = dns_db_allrdatasets(db, node, NULL, 0, 0, &rdsiter);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_rdataset_init(&rdataset);
+		dns_rdataset_init(&sigs);
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			if (rdataset.type == dns_rdatatype_rrsig) {
+				check_nodup(&rdataset);
+			} else if (dns_db_findrdataset(
+					   db, node, NULL, dns_rdatatype_rrsig,
+					   rdataset.type, 0, &sigs,
+					   NULL) == ISC_R_SUCCESS)
+			{
+				dns_rdataset_disassociate(&sigs);
+			} else {
+				complete = false;
+			}
+			dns_rdataset_disassociate(&rdataset);
+		}
+		assert_int_equal(result, ISC_R_NOMORE);
+
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(db, &node);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	dns_dbiterator_destroy(&dbiter);
+
+	return (complete);
+}
+
+static void
+sign_tick(void *arg ISC_ATTR_UNUSED) {
+	dns_view_t *view = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	bool complete;
+
+	signticks++;
+	assert_true(signticks < SIGN_TIMEOUT);
+
+	result = dns_zone_getdb(signzone, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	complete = check_signed(db);
+	dns_db_detach(&db);
+
+	if (signedtick == 0) {
+		if (complete) {
+			signedtick = signticks;
+		}
+		return;
+	}
+
+	/* Nothing is signed twice while the last quanta run */
+	assert_true(complete);
+	if (signticks < signedtick + SIGN_SETTLE) {
+		return;
+	}
+
+	isc_timer_stop(signtimer);
+	isc_timer_destroy(&signtimer);
+
+	view = dns_zone_getview(signzone);
+	dns_test_releasezone(signzone);
+	dns_test_closezonemgr();
+	dns_zone_detach(&signzone);
+	dns_view_detach(&view);
+
+	(void)unlink(SIGN_ZONEFILE);
+	(void)unlink(SIGN_ZONEFILE ".jnl");
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static isc_result_t
+sign_loaded(void *arg ISC_ATTR_UNUSED) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	result = dns_zone_signwithkey(signzone, DST_ALG_RSASHA256, SIGN_ZSK,
+				      false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zone_signwithkey(signzone, DST_ALG_RSASHA256, SIGN_KSK,
+				      false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_interval_set(&interval, 0, 10 * NS_PER_MS);
+	isc_timer_create(mainloop, sign_tick, NULL, &signtimer);
+	isc_timer_start(signtimer, isc_timertype_ticker, &interval);
+
+	return (ISC_R_SUCCESS);
+}
+
+ISC_LOOP_TEST_IMPL(zone_sign) {
+	isc_result_t result;
+	FILE *f = NULL;
+
+	f = fopen(SIGN_ZONEFILE, "w");
+	assert_non_null(f);
+	fprintf(f, "$TTL 1000\n"
+		   "@\tSOA\tlocalhost. postmaster.localhost. "
+		   "1 3600 1800 604800 3600\n"
+		   "\tNS\tns\n"
+		   "ns\tA\t10.53.0.1\n"
+		   "$INCLUDE " TESTS_DIR "/testkeys/Kexample.+008+20386.key\n"
+		   "$INCLUDE " TESTS_DIR "/testkeys/Kexample.+008+37464.key\n");
+	for (unsigned int i = 0; i < SIGN_NAMES; i++) {
+		fprintf(f, "a%u\tA\t10.53.1.%u\n\tTXT\t\"a%u\"\n", i, i, i);
+	}
+	fclose(f);
+
+	result = dns_test_makezone("example", &signzone, NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_zone_setfile(signzone, SIGN_ZONEFILE, dns_masterformat_text,
+			 &dns_master_style_default);
+	result = dns_zone_setkeydirectory(signzone, TESTS_DIR "/testkeys");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Many small quanta */
+	dns_zone_setnodes(signzone, 3);
+	dns_zone_setsignatures(signzone, 4);
+
+	dns_test_setupzonemgr();
+	result = dns_test_managezone(signzone);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zone_asyncload(signzone, false, sign_loaded, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(updatesigs_next)
+ISC_TEST_ENTRY_CUSTOM(zone_sign, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/netaddr.h>
+#include <isc/util.h>
+
+#include <dns/acl.h>
+#include <dns/iptable.h>
+#include <dns/view.h>
+#include <dns/viewselect.h>
+
+#include <tests/dns.h>
+
+static void
+makeaddr(isc_netaddr_t *addr, const char *text) {
+	struct in_addr in4;
+	struct in6_addr in6;
+
+	if (inet_pton(AF_INET6, text, &in6) == 1) {
+		isc_netaddr_fromin6(addr, &in6);
+	} else {
+		assert_int_equal(inet_pton(AF_INET, text, &in4), 1);
+		isc_netaddr_fromin(addr, &in4);
+	}
+}
+
+static void
+addprefix(dns_acl_t *acl, const char *text, unsigned int bitlen, bool pos) {
+	isc_netaddr_t addr;
+	isc_result_t result;
+
+	makeaddr(&addr, text);
+	result = dns_iptable_addprefix(acl->iptable, &addr, bitlen, pos);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/*
+ * What the selector should say about 'acl': the ACL's answer when it
+ * can be compiled, and "maybe" otherwise.
+ */
+static bool
+expected(dns_acl_t *acl, isc_netaddr_t *addr, dns_aclenv_t *env) {
+	if (acl == NULL || acl->length != 0) {
+		return (true);
+	}
+	return (dns_acl_allowed(addr, NULL, acl, env));
+}
+
+static void
+addview(dns_viewlist_t *viewlist, const char *name, dns_acl_t *clients,
+	dns_acl_t *destinations) {
+	dns_view_t *view = NULL;
+	isc_result_t result;
+
+	result = dns_test_makeview(name, false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	if (clients != NULL) {
+		dns_acl_attach(clients, &view->matchclients);
+	}
+	if (destinations != NULL) {
+		dns_acl_attach(destinations, &view->matchdestinations);
+	}
+	ISC_LIST_APPEND(*viewlist, view, link);
+}
+
+/* the selector agrees with the view ACLs and keeps uncompiled views */
+ISC_RUN_TEST_IMPL(dns_viewselect) {
+	static const char *sources[] = {
+		"10.2.3.4",   "10.1.2.3", "10.1.255.255", "11.0.0.1",
+		"192.0.2.77", "0.0.0.0",  "2001:db8::1",  "2001:db8:1::1",
+		"::ffff:10.2.3.4",
+	};
+	static const char *destinations[] = {
+		"192.0.2.1",
+		"192.0.2.2",
+		"2001:db8::53",
+	};
+	dns_viewlist_t viewlist;
+	dns_viewselect_t *vsel = NULL;
+	dns_acl_t *inside = NULL, *any = NULL, *v6 = NULL;
+	dns_acl_t *server = NULL, *local = NULL;
+	dns_aclenv_t *env = NULL;
+	dns_aclelement_t *de = NULL;
+	dns_view_t *view = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	ISC_LIST_INIT(viewlist);
+	dns_aclenv_create(mctx, &env);
+
+	/* !10.1.0.0/16; 10.0.0.0/8; */
+	dns_acl_create(mctx, 0, &inside);
+	addprefix(inside, "10.1.0.0", 16, false);
+	addprefix(inside, "10.0.0.0", 8, true);
+
+	result = dns_acl_any(mctx, &any);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* 2001:db8::/32; !2001:db8:1::/48; */
+	dns_acl_create(mctx, 0, &v6);
+	addprefix(v6, "2001:db8::", 32, true);
+	addprefix(v6, "2001:db8:1::", 48, false);
+
+	/* 192.0.2.1; 2001:db8::53; */
+	dns_acl_create(mctx, 0, &server);
+	addprefix(server, "192.0.2.1", 32, true);
+	addprefix(server, "2001:db8::53", 128, true);
+
+	/* localhost; can't be compiled */
+	dns_acl_create(mctx, 1, &local);
+	de = local->elements;
+	de->type = dns_aclelementtype_localhost;
+	de->negative = false;
+	dns_acl_node_count(local)++;
+	de->node_num = dns_acl_node_count(local);
+	local->length++;
+
+	addview(&viewlist, "inside", inside, any);
+	addview(&viewlist, "server", any, server);
+	addview(&viewlist, "v6", v6, NULL);
+	addview(&viewlist, "local", local, server);
+	addview(&viewlist, "default", NULL, NULL);
+
+	dns_viewselect_create(mctx, &viewlist, &vsel);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sources); i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(destinations); j++) {
+			dns_viewselect_match_t match;
+			isc_netaddr_t src, dst;
+			unsigned int index = 0;
+
+			makeaddr(&src, sources[i]);
+			makeaddr(&dst, destinations[j]);
+			dns_viewselect_lookup(vsel, &src, &dst, env, &match);
+
+			for (view = ISC_LIST_HEAD(viewlist); view != NULL;
+			     view = ISC_LIST_NEXT(view, link), index++)
+			{
+				bool candidate =
+					expected(view->matchclients, &src,
+						 env) &&
+					expected(view->matchdestinations, &dst,
+						 env);
+
+				assert_int_equal(
+					dns_viewselect_candidate(&match, index),
+					candidate);
+			}
+
+			/* views past the end are always candidates */
+			assert_true(dns_viewselect_candidate(&match, index));
+		}
+	}
+
+	dns_viewselect_detach(&vsel);
+
+	while ((view = ISC_LIST_HEAD(viewlist)) != NULL) {
+		ISC_LIST_UNLINK(viewlist, view, link);
+		dns_view_detach(&view);
+	}
+	dns_acl_detach(&inside);
+	dns_acl_detach(&any);
+	dns_acl_detach(&v6);
+	dns_acl_detach(&server);
+	dns_acl_detach(&local);
+	dns_aclenv_detach(&env);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(dns_viewselect)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/rcode.h>
+#include <dns/zonecounters.h>
+
+#include <tests/dns.h>
+
+/* Responses are counted in their slot, in the right latency class */
+ISC_RUN_TEST_IMPL(response) {
+	dns_zonecounters_t *zc = NULL;
+	uint64_t values[dns_zonecounter_max];
+	uint32_t slot1, slot2;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_zonecounters_create(mctx, &zc);
+
+	result = dns_zonecounters_alloc(zc, &slot1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zonecounters_alloc(zc, &slot2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_not_equal(slot1, slot2);
+
+	dns_zonecounters_response(zc, slot1, dns_rcode_noerror, 100,
+				  50 * NS_PER_US);
+	dns_zonecounters_response(zc, slot1, dns_rcode_nxdomain, 200,
+				  5 * NS_PER_MS);
+	dns_zonecounters_response(zc, slot1, dns_rcode_noerror, 300,
+				  NS_PER_SEC);
+
+	dns_zonecounters_get(zc, slot1, values);
+	assert_int_equal(values[dns_zonecounter_queries], 3);
+	assert_int_equal(values[dns_zonecounter_nxdomain], 1);
+	assert_int_equal(values[dns_zonecounter_bytesout], 600);
+	assert_int_equal(values[dns_zonecounter_latency0], 1);
+	assert_int_equal(values[dns_zonecounter_latency1], 0);
+	assert_int_equal(values[dns_zonecounter_latency2], 1);
+	assert_int_equal(values[dns_zonecounter_latency3], 0);
+	assert_int_equal(values[dns_zonecounter_latency4], 1);
+
+	/* Nothing was counted in the other slot */
+	dns_zonecounters_get(zc, slot2, values);
+	for (size_t i = 0; i < dns_zonecounter_max; i++) {
+		assert_int_equal(values[i], 0);
+	}
+
+	dns_zonecounters_release(zc, slot1);
+	dns_zonecounters_release(zc, slot2);
+	dns_zonecounters_detach(&zc);
+}
+
+/* A released slot is reused, with its counters reset */
+ISC_RUN_TEST_IMPL(reuse) {
+	dns_zonecounters_t *zc = NULL;
+	uint64_t values[dns_zonecounter_max];
+	uint32_t slot, again;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_zonecounters_create(mctx, &zc);
+
+	result = dns_zonecounters_alloc(zc, &slot);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_zonecounters_response(zc, slot, dns_rcode_nxdomain, 100, 0);
+	dns_zonecounters_release(zc, slot);
+
+	result = dns_zonecounters_alloc(zc, &again);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(again, slot);
+
+	dns_zonecounters_get(zc, again, values);
+	for (size_t i = 0; i < dns_zonecounter_max; i++) {
+		assert_int_equal(values[i], 0);
+	}
+
+	/* Slots in a chunk that was never counted in read as zero */
+	dns_zonecounters_get(zc, DNS_ZONECOUNTERS_MAXSLOTS - 1, values);
+	for (size_t i = 0; i < dns_zonecounter_max; i++) {
+		assert_int_equal(values[i], 0);
+	}
+
+	dns_zonecounters_release(zc, again);
+	dns_zonecounters_detach(&zc);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(response)
+ISC_TEST_ENTRY(reuse)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -32,6 +32,7 @@
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -88,6 +89,95 @@ ISC_LOOP_TEST_IMPL(apply) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+static isc_result_t
+first_zone(dns_zone_t *zone, void *uap) {
+	dns_name_t *name = uap;
+
+	if (dns_name_countlabels(name) == 0) {
+		dns_name_copy(dns_zone_getorigin(zone), name);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static int
+count_from(const char *after) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	int nzones = 0;
+	isc_result_t result;
+
+	if (after != NULL) {
+		name = dns_fixedname_initname(&fixed);
+		result = dns_name_fromstring(name, after, dns_rootname, 0,
+					     NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	result = dns_view_applyfrom(view, name, false, NULL, count_zone,
+				    &nzones);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (nzones);
+}
+
+/* resume walking a zone table after a given name */
+ISC_LOOP_TEST_IMPL(apply_from) {
+	const char *names[] = { "bar", "foo", "sub.foo" };
+	dns_zone_t *zones[ARRAY_SIZE(names)] = { NULL };
+	dns_fixedname_t fixed, ffound, fexpect;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_name_t *expect = dns_fixedname_initname(&fexpect);
+	isc_result_t result;
+
+	result = dns_test_makezone(names[0], &zones[0], NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	view = dns_zone_getview(zones[0]);
+
+	for (size_t i = 1; i < ARRAY_SIZE(names); i++) {
+		result = dns_test_makezone(names[i], &zones[i], view, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	assert_int_equal(count_from(NULL), 3);
+	assert_int_equal(count_from("bar"), 2);
+	assert_int_equal(count_from("foo"), 1);
+	assert_int_equal(count_from("sub.foo"), 0);
+
+	/* 'after' does not have to be the name of a zone */
+	assert_int_equal(count_from("aaa"), 3);
+	assert_int_equal(count_from("baz"), 2);
+	assert_int_equal(count_from("a.foo"), 1);
+	assert_int_equal(count_from("zzz"), 0);
+
+	/* The walk resumes with the next zone in order */
+	result = dns_name_fromstring(expect, "sub.foo", dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(name, "foo", dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_view_applyfrom(view, name, false, NULL, first_zone,
+				    found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, expect));
+
+	/* These steps are necessary so the zones can be detached properly */
+	dns_test_setupzonemgr();
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		result = dns_test_managezone(zones[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		dns_test_releasezone(zones[i]);
+	}
+	dns_test_closezonemgr();
+
+	dns_view_detach(&view);
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		dns_zone_detach(&zones[i]);
+	}
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 static isc_result_t
 load_done_last(void *uap) {
 	dns_zone_t *zone = uap;
@@ -271,10 +361,80 @@ ISC_LOOP_TEST_IMPL(asyncload_zt) {
 	rcu_read_unlock();
 }
 
+#define NBOUNDED (4 * DNS_ZONEMGR_LOADS_PER_LOOP)
+
+static dns_zone_t *bounded[NBOUNDED];
+static unsigned int nbounded_done = 0;
+
+static isc_result_t
+bounded_done(void *arg ISC_ATTR_UNUSED) {
+	uint64_t pending, loading, loaded;
+	uint32_t eta;
+
+	dns_zonemgr_getloadprogress(zonemgr, &pending, &loading, &loaded,
+				    &eta);
+
+	/* All the zones are on the same loop */
+	assert_true(loading <= DNS_ZONEMGR_LOADS_PER_LOOP);
+	assert_true(loading <= pending);
+	if (nbounded_done++ == 0) {
+		/* The other loads were queued, not started */
+		assert_true(pending > DNS_ZONEMGR_LOADS_PER_LOOP);
+	}
+
+	if (nbounded_done < NBOUNDED) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (size_t i = 0; i < NBOUNDED; i++) {
+		assert_int_equal(dns_zone_getdb(bounded[i], &db),
+				 ISC_R_SUCCESS);
+		dns_db_detach(&db);
+		dns_test_releasezone(bounded[i]);
+		dns_zone_detach(&bounded[i]);
+	}
+	dns_test_closezonemgr();
+	dns_view_detach(&view);
+
+	isc_loopmgr_shutdown(loopmgr);
+	return (ISC_R_SUCCESS);
+}
+
+/* the zone manager loads at most a few zone files per loop at a time */
+ISC_LOOP_TEST_IMPL(asyncload_bounded) {
+	isc_result_t result;
+
+	dns_test_setupzonemgr();
+
+	for (size_t i = 0; i < NBOUNDED; i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "zone%zu", i);
+		result = dns_test_makezone(name, &bounded[i], view, i == 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (i == 0) {
+			view = dns_zone_getview(bounded[0]);
+		}
+		dns_zone_setfile(bounded[i], TESTS_DIR "/testdata/zt/zone1.db",
+				 dns_masterformat_text,
+				 &dns_master_style_default);
+		result = dns_test_managezone(bounded[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (size_t i = 0; i < NBOUNDED; i++) {
+		result = dns_zone_asyncload(bounded[i], false, bounded_done,
+					    NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(apply, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(apply_from, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zone, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zt, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(asyncload_bounded, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -25,6 +25,8 @@
 
 #include <tests/isc.h>
 
+#define BYTE_VALUES 256
+
 const char *same[][2] = {
 	{
 		"AaBbCcDdEeFfGgHhIiJjKkLlMmNnOoPpQqRrSsTtUuVvWwXxYyZz",
@@ -86,6 +88,11 @@ struct {
 	{ "barsuffix", "foosuffix", -1 },
 	{ "prefixfoo", "prefixbar", +1 },
 	{ "prefixbar", "prefixfoo", -1 },
+	{ "a-rather-long-prefix.foo", "a-rather-long-prefix.bar", +1 },
+	{ "a-rather-long-prefix.bar", "A-RATHER-LONG-PREFIX.FOO", -1 },
+	{ "foo.followed-by-a-long-suffix", "bar.followed-by-a-long-suffix", +1 },
+	{ "bar.followed-by-a-long-suffix", "FOO.FOLLOWED-BY-A-LONG-SUFFIX", -1 },
+	{ "sixteen-bytes-a\377", "sixteen-bytes-a\177", +1 },
 };
 
 ISC_RUN_TEST_IMPL(upperlower) {
@@ -137,6 +144,30 @@ ISC_RUN_TEST_IMPL(lowercmp) {
 	}
 }
 
+ISC_RUN_TEST_IMPL(lowercopy) {
+	uint8_t src[BYTE_VALUES * 2];
+	uint8_t dst[BYTE_VALUES * 2 + 1];
+
+	for (size_t i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t)i;
+	}
+
+	/* every alignment and length, to cover vector and scalar tails */
+	for (size_t start = 0; start < 32; start++) {
+		for (size_t len = 0; start + len <= sizeof(src); len += 7) {
+			memset(dst, 0xAA, sizeof(dst));
+			isc_ascii_lowercopy(dst, src + start, len);
+			for (size_t i = 0; i < len; i++) {
+				assert_int_equal(dst[i], tolower(src[start + i]));
+			}
+			assert_int_equal(dst[len], 0xAA);
+			assert_true(isc_ascii_lowerequal(dst, src + start, len));
+			assert_int_equal(isc_ascii_lowercmp(dst, src + start, len),
+					 0);
+		}
+	}
+}
+
 ISC_RUN_TEST_IMPL(exhaustive) {
 	for (uint64_t ab = 0; ab < (1 << 16); ab++) {
 		uint8_t a = ab >> 8;
@@ -173,6 +204,7 @@ ISC_TEST_LIST_START
 ISC_TEST_ENTRY(upperlower)
 ISC_TEST_ENTRY(lowerequal)
 ISC_TEST_ENTRY(lowercmp)
+ISC_TEST_ENTRY(lowercopy)
 ISC_TEST_ENTRY(exhaustive)
 ISC_TEST_LIST_END
 
@@ -71,7 +71,7 @@ ISC_RUN_TEST_IMPL(isc_async_run) {
 }
 
 static char string[32] = "";
-int n1 = 1, n2 = 2, n3 = 3, n4 = 4, n5 = 5;
+int n0 = 0, n1 = 1, n2 = 2, n3 = 3, n4 = 4, n5 = 5;
 
 static void
 append(void *arg) {
@@ -101,9 +101,141 @@ ISC_RUN_TEST_IMPL(isc_async_multiple) {
 	assert_string_equal(string, "12345");
 }
 
+static void
+shutdown_cb(void *arg) {
+	UNUSED(arg);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+async_background(void *arg) {
+	isc_loop_t *loop = isc_loop();
+
+	UNUSED(arg);
+
+	isc_async_background(loop, append, &n1);
+	isc_async_background(loop, append, &n2);
+	isc_async_run(loop, append, &n3);
+	isc_async_run(loop, append, &n4);
+	isc_async_background(loop, shutdown_cb, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_async_background) {
+	string[0] = '\0';
+	isc_loop_setup(isc_loop_main(loopmgr), async_background, loopmgr);
+	isc_loopmgr_run(loopmgr);
+	assert_string_equal(string, "3412");
+}
+
+static void
+slow_append(void *arg) {
+	/* longer than the budget set below */
+	usleep(5000);
+	append(arg);
+
+	isc_async_current(append, &n0);
+}
+
+static void
+async_background_yield(void *arg) {
+	isc_loop_t *loop = isc_loop();
+
+	UNUSED(arg);
+
+	isc_async_background(loop, slow_append, &n1);
+	isc_async_background(loop, slow_append, &n2);
+	isc_async_background(loop, slow_append, &n3);
+	isc_async_background(loop, shutdown_cb, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_async_background_yield) {
+	string[0] = '\0';
+	isc_loopmgr_setbudget(loopmgr, 1);
+	isc_loop_setup(isc_loop_main(loopmgr), async_background_yield,
+		       loopmgr);
+	isc_loopmgr_run(loopmgr);
+
+	/* the regular jobs get to run between the slow background jobs */
+	assert_string_equal(string, "102030");
+}
+
+#define RESCHEDULE 1000
+
+static atomic_uint rescheduled = 0;
+
+static void
+async_reschedule(void *arg) {
+	UNUSED(arg);
+
+	/*
+	 * Each job is queued while the previous one is running, i.e. while
+	 * the loop is draining its async queue; it must not get lost.
+	 */
+	if (atomic_fetch_add(&rescheduled, 1) + 1 < RESCHEDULE) {
+		isc_async_run(isc_loop(), async_reschedule, NULL);
+	} else {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_async_reschedule) {
+	atomic_init(&rescheduled, 0);
+	isc_loop_setup(isc_loop_main(loopmgr), async_reschedule, loopmgr);
+	isc_loopmgr_run(loopmgr);
+	assert_int_equal(atomic_load(&rescheduled), RESCHEDULE);
+}
+
+#define CROSSLOOP 10000
+
+static atomic_uint crossloop = 0;
+
+static void
+async_crossloop_cb(void *arg) {
+	UNUSED(arg);
+
+	if (atomic_fetch_add(&crossloop, 1) + 1 ==
+	    CROSSLOOP * isc_loopmgr_nloops(loopmgr))
+	{
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+async_crossloop_send(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < CROSSLOOP; i++) {
+		isc_async_run(isc_loop_main(loopmgr), async_crossloop_cb, NULL);
+	}
+}
+
+static void
+async_crossloop(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < isc_loopmgr_nloops(loopmgr); i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), async_crossloop_send,
+			      NULL);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_async_crossloop) {
+	atomic_init(&crossloop, 0);
+	isc_loop_setup(isc_loop_main(loopmgr), async_crossloop, loopmgr);
+	isc_loopmgr_run(loopmgr);
+	assert_int_equal(atomic_load(&crossloop),
+			 CROSSLOOP * isc_loopmgr_nloops(loopmgr));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_async_run, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_async_multiple, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_background, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_background_yield, setup_loopmgr,
+		      teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_reschedule, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_crossloop, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -455,6 +455,44 @@ ISC_RUN_TEST_IMPL(dnsasm_torn_apart_test) {
 	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_SUCCESS);
 }
 
+ISC_RUN_TEST_IMPL(dnsasm_release_buffer_test) {
+	isc_dnsstream_assembler_t *dnsasm = (isc_dnsstream_assembler_t *)*state;
+	verify_cbdata_t cbdata = { 0 };
+	size_t verified = 0;
+	size_t left = 0;
+
+	cbdata.verify_message = (uint8_t *)response_large;
+	isc_dnsstream_assembler_setcb(dnsasm, verify_dnsmsg, (void *)&cbdata);
+	isc_dnsstream_assembler_incoming(dnsasm, &verified, response_large,
+					 sizeof(response_large) / 3 * 2);
+
+	/* the incomplete message does not fit into the static buffer */
+	assert_true(verified == 0);
+	assert_true(dnsasm->dnsbuf.dynamic);
+	assert_ptr_not_equal(dnsasm->dnsbuf.base, dnsasm->buf);
+
+	left = sizeof(response_large) -
+	       isc_dnsstream_assembler_remaininglength(dnsasm);
+	isc_dnsstream_assembler_incoming(
+		dnsasm, &verified,
+		&response_large[isc_dnsstream_assembler_remaininglength(dnsasm)],
+		left);
+	assert_true(verified == 1);
+	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_SUCCESS);
+
+	/* nothing is left, so the static buffer is in use again */
+	assert_false(dnsasm->dnsbuf.dynamic);
+	assert_ptr_equal(dnsasm->dnsbuf.base, dnsasm->buf);
+	assert_true(isc_dnsstream_assembler_remaininglength(dnsasm) == 0);
+
+	/* and it still works */
+	cbdata.verify_message = (uint8_t *)request;
+	isc_dnsstream_assembler_incoming(dnsasm, &verified, (void *)request,
+					 sizeof(request));
+	assert_true(verified == 2);
+	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_SUCCESS);
+}
+
 ISC_RUN_TEST_IMPL(dnsasm_error_data_test) {
 	isc_dnsstream_assembler_t *dnsasm = (isc_dnsstream_assembler_t *)*state;
 	verify_cbdata_t cbdata = { 0 };
@@ -635,6 +673,8 @@ ISC_TEST_ENTRY_CUSTOM(dnsasm_multiple_messages_test, setup_test_dnsasm,
 		      teardown_test_dnsasm)
 ISC_TEST_ENTRY_CUSTOM(dnsasm_torn_apart_test, setup_test_dnsasm,
 		      teardown_test_dnsasm)
+ISC_TEST_ENTRY_CUSTOM(dnsasm_release_buffer_test, setup_test_dnsasm,
+		      teardown_test_dnsasm)
 ISC_TEST_ENTRY_CUSTOM(dnsasm_error_data_test, setup_test_dnsasm,
 		      teardown_test_dnsasm)
 ISC_TEST_ENTRY_CUSTOM(dnsasm_torn_randomly_test, setup_test_dnsasm,
@@ -65,7 +65,7 @@ upper_nodes_match(void *node0, const void *key) {
 }
 
 static void
-test_hashmap_full(uint8_t init_bits, uintptr_t count) {
+test_hashmap_full(uint8_t init_bits, uintptr_t count, unsigned int options) {
 	isc_hashmap_t *hashmap = NULL;
 	isc_result_t result;
 	test_node_t *nodes, *long_nodes, *upper_nodes;
@@ -74,7 +74,7 @@ test_hashmap_full(uint8_t init_bits, uintptr_t count) {
 	long_nodes = isc_mem_cget(mctx, count, sizeof(nodes[0]));
 	upper_nodes = isc_mem_cget(mctx, count, sizeof(nodes[0]));
 
-	isc_hashmap_create(mctx, init_bits, &hashmap);
+	isc_hashmap_create_ex(mctx, init_bits, options, &hashmap);
 	assert_non_null(hashmap);
 
 	/*
@@ -219,7 +219,7 @@ test_hashmap_full(uint8_t init_bits, uintptr_t count) {
 #include "hashmap_nodes.h"
 
 static void
-test_hashmap_iterator(bool random_data) {
+test_hashmap_iterator(bool random_data, unsigned int options) {
 	isc_hashmap_t *hashmap = NULL;
 	isc_result_t result;
 	isc_hashmap_iter_t *iter = NULL;
@@ -230,7 +230,7 @@ test_hashmap_iterator(bool random_data) {
 	nodes = isc_mem_cget(mctx, count, sizeof(nodes[0]));
 	seen = isc_mem_cget(mctx, count, sizeof(seen[0]));
 
-	isc_hashmap_create(mctx, HASHMAP_MIN_BITS, &hashmap);
+	isc_hashmap_create_ex(mctx, HASHMAP_MIN_BITS, options, &hashmap);
 	assert_non_null(hashmap);
 
 	for (size_t i = 0; i < count; i++) {
@@ -253,7 +253,9 @@ test_hashmap_iterator(bool random_data) {
 	}
 
 	/* We want to iterate while rehashing is in progress */
-	assert_true(rehashing_in_progress(hashmap));
+	if (!hashmap->grouped) {
+		assert_true(rehashing_in_progress(hashmap));
+	}
 
 	memset(seen, 0, count * sizeof(seen[0]));
 	isc_hashmap_iter_create(hashmap, &iter);
@@ -348,7 +350,9 @@ test_hashmap_iterator(bool random_data) {
 	assert_int_equal(result, ISC_R_NOMORE);
 
 	/* Iterator doesn't progress rehashing */
-	assert_true(rehashing_in_progress(hashmap));
+	if (!hashmap->grouped) {
+		assert_true(rehashing_in_progress(hashmap));
+	}
 
 	isc_hashmap_iter_destroy(&iter);
 	assert_null(iter);
@@ -362,43 +366,70 @@ test_hashmap_iterator(bool random_data) {
 
 /* 1 bit, 120 elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_hashmap_1_120) {
-	test_hashmap_full(1, 120);
+	test_hashmap_full(1, 120, 0);
 	return;
 }
 
 /* 6 bit, 1000 elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_hashmap_6_1000) {
-	test_hashmap_full(6, 1000);
+	test_hashmap_full(6, 1000, 0);
 	return;
 }
 
 /* 24 bit, 200K elements test, no rehashing */
 ISC_RUN_TEST_IMPL(isc_hashmap_24_200000) {
-	test_hashmap_full(24, 200000);
+	test_hashmap_full(24, 200000, 0);
 	return;
 }
 
 /* 15 bit, 45K elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_hashmap_1_48000) {
-	test_hashmap_full(1, 48000);
+	test_hashmap_full(1, 48000, 0);
 	return;
 }
 
 /* 8 bit, 20k elements test, partial rehashing */
 ISC_RUN_TEST_IMPL(isc_hashmap_8_20000) {
-	test_hashmap_full(8, 20000);
+	test_hashmap_full(8, 20000, 0);
 	return;
 }
 
 /* test hashmap iterator */
 
 ISC_RUN_TEST_IMPL(isc_hashmap_iterator) {
-	test_hashmap_iterator(true);
+	test_hashmap_iterator(true, 0);
 	return;
 }
 
 ISC_RUN_TEST_IMPL(isc_hashmap_iterator_static) {
-	test_hashmap_iterator(false);
+	test_hashmap_iterator(false, 0);
+	return;
+}
+
+/* the same tests, with the group-probed table */
+
+ISC_RUN_TEST_IMPL(isc_hashmap_grouped_1_120) {
+	test_hashmap_full(1, 120, ISC_HASHMAP_GROUPED);
+	return;
+}
+
+ISC_RUN_TEST_IMPL(isc_hashmap_grouped_24_200000) {
+	test_hashmap_full(24, 200000, ISC_HASHMAP_GROUPED);
+	return;
+}
+
+ISC_RUN_TEST_IMPL(isc_hashmap_grouped_1_48000) {
+	test_hashmap_full(1, 48000, ISC_HASHMAP_GROUPED);
+	return;
+}
+
+ISC_RUN_TEST_IMPL(isc_hashmap_grouped_iterator) {
+	test_hashmap_iterator(true, ISC_HASHMAP_GROUPED);
+	return;
+}
+
+ISC_RUN_TEST_IMPL(isc_hashmap_grouped_iterator_static) {
+	test_hashmap_iterator(false, ISC_HASHMAP_GROUPED);
 	return;
 }
 
@@ -512,6 +543,11 @@ ISC_TEST_ENTRY(isc_hashmap_1_48000)
 ISC_TEST_ENTRY(isc_hashmap_8_20000)
 ISC_TEST_ENTRY(isc_hashmap_iterator)
 ISC_TEST_ENTRY(isc_hashmap_iterator_static)
+ISC_TEST_ENTRY(isc_hashmap_grouped_1_120)
+ISC_TEST_ENTRY(isc_hashmap_grouped_24_200000)
+ISC_TEST_ENTRY(isc_hashmap_grouped_1_48000)
+ISC_TEST_ENTRY(isc_hashmap_grouped_iterator)
+ISC_TEST_ENTRY(isc_hashmap_grouped_iterator_static)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -26,6 +26,7 @@
 
 #include <isc/heap.h>
 #include <isc/mem.h>
+#include <isc/random.h>
 #include <isc/util.h>
 
 #include <tests/isc.h>
@@ -70,9 +71,98 @@ ISC_RUN_TEST_IMPL(isc_heap_delete) {
 	assert_null(heap);
 }
 
+static void
+check_heap(isc_heap_t *heap, struct e *elts, size_t count, bool *inheap) {
+	unsigned int previous = 0;
+	struct e *e = NULL;
+
+	isc_heap_heapify(heap);
+
+	for (size_t i = 0; i < count; i++) {
+		if (inheap[i]) {
+			assert_ptr_equal(isc_heap_element(heap, elts[i].index),
+					 &elts[i]);
+		} else {
+			assert_int_equal(elts[i].index, 0);
+		}
+	}
+
+	/* the elements come out in order */
+	while ((e = isc_heap_element(heap, 1)) != NULL) {
+		assert_true(e->value >= previous);
+		previous = e->value;
+		isc_heap_delete(heap, 1);
+		assert_int_equal(e->index, 0);
+	}
+}
+
+static void
+test_heap_random(unsigned int options) {
+	isc_heap_t *heap = NULL;
+	struct e elts[2000];
+	bool inheap[2000] = { false };
+
+	isc_heap_create_ex(mctx, compare, idx, 100, options, &heap);
+
+	for (size_t i = 0; i < ARRAY_SIZE(elts); i++) {
+		elts[i] = (struct e){ .value = isc_random_uniform(1000) };
+		/* append the first half, then mix both */
+		if (i < ARRAY_SIZE(elts) / 2 || isc_random_uniform(2) == 0) {
+			isc_heap_append(heap, &elts[i]);
+		} else {
+			isc_heap_insert(heap, &elts[i]);
+		}
+		inheap[i] = true;
+	}
+
+	for (size_t n = 0; n < 5000; n++) {
+		size_t i = isc_random_uniform(ARRAY_SIZE(elts));
+
+		if (!inheap[i]) {
+			isc_heap_append(heap, &elts[i]);
+			inheap[i] = true;
+			continue;
+		}
+
+		switch (isc_random_uniform(3)) {
+		case 0:
+			isc_heap_delete(heap, elts[i].index);
+			inheap[i] = false;
+			break;
+		case 1:
+			elts[i].value /= 2;
+			isc_heap_increased(heap, elts[i].index);
+			break;
+		case 2:
+			elts[i].value += isc_random_uniform(1000);
+			isc_heap_decreased(heap, elts[i].index);
+			break;
+		}
+	}
+
+	check_heap(heap, elts, ARRAY_SIZE(elts), inheap);
+
+	isc_heap_destroy(&heap);
+}
+
+/* random operations, with appended elements */
+ISC_RUN_TEST_IMPL(isc_heap_random) {
+	UNUSED(state);
+
+	test_heap_random(0);
+}
+
+ISC_RUN_TEST_IMPL(isc_heap_random_quaternary) {
+	UNUSED(state);
+
+	test_heap_random(ISC_HEAP_QUATERNARY);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_heap_delete)
+ISC_TEST_ENTRY(isc_heap_random)
+ISC_TEST_ENTRY(isc_heap_random_quaternary)
 
 ISC_TEST_LIST_END
 
@@ -207,6 +207,40 @@ ISC_RUN_TEST_IMPL(isc_hmac_reset) {
 #endif /* if 0 */
 }
 
+ISC_RUN_TEST_IMPL(isc_hmac_copy) {
+	isc_hmac_t *hmac_st = *state;
+	static const char *inputs[] = { "", "abc", "The quick brown fox" };
+	unsigned char digest[ISC_MAX_MD_SIZE], expected[ISC_MAX_MD_SIZE];
+	unsigned int digestlen, expectedlen;
+
+	assert_non_null(hmac_st);
+
+	assert_int_equal(isc_hmac_init(hmac_st, "key", 3, ISC_MD_SHA256),
+			 ISC_R_SUCCESS);
+
+	/* Every copy of the keyed context computes the HMAC with the key */
+	for (size_t i = 0; i < ARRAY_SIZE(inputs); i++) {
+		const unsigned char *buf = (const unsigned char *)inputs[i];
+		isc_hmac_t *copy = isc_hmac_new();
+
+		assert_int_equal(isc_hmac_copy(copy, hmac_st), ISC_R_SUCCESS);
+		assert_int_equal(isc_hmac_update(copy, buf, strlen(inputs[i])),
+				 ISC_R_SUCCESS);
+		digestlen = sizeof(digest);
+		assert_int_equal(isc_hmac_final(copy, digest, &digestlen),
+				 ISC_R_SUCCESS);
+		isc_hmac_free(copy);
+
+		expectedlen = sizeof(expected);
+		assert_int_equal(isc_hmac(ISC_MD_SHA256, "key", 3, buf,
+					  strlen(inputs[i]), expected,
+					  &expectedlen),
+				 ISC_R_SUCCESS);
+		assert_int_equal(digestlen, expectedlen);
+		assert_memory_equal(digest, expected, digestlen);
+	}
+}
+
 ISC_RUN_TEST_IMPL(isc_hmac_final) {
 	isc_hmac_t *hmac_st = *state;
 	assert_non_null(hmac_st);
@@ -921,6 +955,7 @@ ISC_TEST_ENTRY(isc_hmac_new)
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_init, _reset, _reset)
 
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_reset, _reset, _reset)
+ISC_TEST_ENTRY_CUSTOM(isc_hmac_copy, _reset, _reset)
 
 ISC_TEST_ENTRY(isc_hmac_md5)
 ISC_TEST_ENTRY(isc_hmac_sha1)
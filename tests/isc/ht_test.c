@@ -38,12 +38,12 @@
 #undef mctx
 
 static void
-test_ht_full(uint8_t init_bits, uintptr_t count) {
+test_ht_full(uint8_t init_bits, uintptr_t count, unsigned int options) {
 	isc_ht_t *ht = NULL;
 	isc_result_t result;
 	uintptr_t i;
 
-	isc_ht_init(&ht, mctx, init_bits, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&ht, mctx, init_bits, ISC_HT_CASE_SENSITIVE | options);
 	assert_non_null(ht);
 
 	for (i = 1; i < count; i++) {
@@ -178,7 +178,7 @@ test_ht_full(uint8_t init_bits, uintptr_t count) {
 }
 
 static void
-test_ht_iterator(void) {
+test_ht_iterator(unsigned int options) {
 	isc_ht_t *ht = NULL;
 	isc_result_t result;
 	isc_ht_iter_t *iter = NULL;
@@ -188,7 +188,7 @@ test_ht_iterator(void) {
 	unsigned char key[16];
 	size_t tksize;
 
-	isc_ht_init(&ht, mctx, HT_MIN_BITS, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&ht, mctx, HT_MIN_BITS, ISC_HT_CASE_SENSITIVE | options);
 	assert_non_null(ht);
 	for (i = 1; i <= count; i++) {
 		/*
@@ -202,7 +202,9 @@ test_ht_iterator(void) {
 	}
 
 	/* We want to iterate while rehashing is in progress */
-	assert_true(rehashing_in_progress(ht));
+	if (!ht->flat) {
+		assert_true(rehashing_in_progress(ht));
+	}
 
 	walked = 0;
 	isc_ht_iter_create(ht, &iter);
@@ -284,7 +286,9 @@ test_ht_iterator(void) {
 	assert_int_equal(walked, 0);
 
 	/* Iterator doesn't progress rehashing */
-	assert_true(rehashing_in_progress(ht));
+	if (!ht->flat) {
+		assert_true(rehashing_in_progress(ht));
+	}
 
 	isc_ht_iter_destroy(&iter);
 	assert_null(iter);
@@ -295,39 +299,96 @@ test_ht_iterator(void) {
 
 /* 1 bit, 120 elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_ht_1_120) {
-	test_ht_full(1, 120);
+	test_ht_full(1, 120, 0);
 	return;
 }
 
 /* 6 bit, 1000 elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_ht_6_1000) {
-	test_ht_full(6, 1000);
+	test_ht_full(6, 1000, 0);
 	return;
 }
 
 /* 24 bit, 200K elements test, no rehashing */
 ISC_RUN_TEST_IMPL(isc_ht_24_200000) {
 	UNUSED(state);
-	test_ht_full(24, 200000);
+	test_ht_full(24, 200000, 0);
 }
 
 /* 15 bit, 45K elements test, full rehashing */
 ISC_RUN_TEST_IMPL(isc_ht_1_48000) {
 	UNUSED(state);
-	test_ht_full(1, 48000);
+	test_ht_full(1, 48000, 0);
 }
 
 /* 8 bit, 20k elements test, partial rehashing */
 ISC_RUN_TEST_IMPL(isc_ht_8_20000) {
 	UNUSED(state);
-	test_ht_full(8, 20000);
+	test_ht_full(8, 20000, 0);
 }
 
 /* test hashtable iterator */
 
 ISC_RUN_TEST_IMPL(isc_ht_iterator) {
 	UNUSED(state);
-	test_ht_iterator();
+	test_ht_iterator(0);
+}
+
+/* the same tests, with flat tables */
+
+ISC_RUN_TEST_IMPL(isc_ht_flat_1_120) {
+	UNUSED(state);
+	test_ht_full(1, 120, ISC_HT_FLAT);
+}
+
+ISC_RUN_TEST_IMPL(isc_ht_flat_24_200000) {
+	UNUSED(state);
+	test_ht_full(24, 200000, ISC_HT_FLAT);
+}
+
+ISC_RUN_TEST_IMPL(isc_ht_flat_1_48000) {
+	UNUSED(state);
+	test_ht_full(1, 48000, ISC_HT_FLAT);
+}
+
+ISC_RUN_TEST_IMPL(isc_ht_flat_iterator) {
+	UNUSED(state);
+	test_ht_iterator(ISC_HT_FLAT);
+}
+
+/* a sized table is not rebuilt while it is filled */
+ISC_RUN_TEST_IMPL(isc_ht_init_sized) {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+	uint8_t bits;
+
+	UNUSED(state);
+
+	isc_ht_init_sized(&ht, mctx, 10000, ISC_HT_FLAT);
+	bits = ht->hashbits[0];
+	for (uintptr_t i = 0; i < 10000; i++) {
+		unsigned char key[32];
+		snprintf((char *)key, sizeof(key), "sized key %u",
+			 (unsigned int)i);
+		result = isc_ht_add(ht, key, strlen((char *)key), (void *)i);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(ht->hashbits[0], bits);
+	assert_int_equal(isc_ht_count(ht), 10000);
+	isc_ht_destroy(&ht);
+
+	isc_ht_init_sized(&ht, mctx, 10000, 0);
+	bits = ht->hashbits[ht->hindex];
+	for (uintptr_t i = 0; i < 10000; i++) {
+		unsigned char key[32];
+		snprintf((char *)key, sizeof(key), "sized key %u",
+			 (unsigned int)i);
+		result = isc_ht_add(ht, key, strlen((char *)key), (void *)i);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_false(rehashing_in_progress(ht));
+	assert_int_equal(ht->hashbits[ht->hindex], bits);
+	isc_ht_destroy(&ht);
 }
 
 ISC_RUN_TEST_IMPL(isc_ht_case) {
@@ -387,6 +448,11 @@ ISC_TEST_ENTRY(isc_ht_24_200000)
 ISC_TEST_ENTRY(isc_ht_1_48000)
 ISC_TEST_ENTRY(isc_ht_8_20000)
 ISC_TEST_ENTRY(isc_ht_iterator)
+ISC_TEST_ENTRY(isc_ht_flat_1_120)
+ISC_TEST_ENTRY(isc_ht_flat_24_200000)
+ISC_TEST_ENTRY(isc_ht_flat_1_48000)
+ISC_TEST_ENTRY(isc_ht_flat_iterator)
+ISC_TEST_ENTRY(isc_ht_init_sized)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/iterated_hash.h>
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* H(example) from RFC 5155 appendix A */
+static const unsigned char example_salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+static const unsigned char example_name[] = "\007example";
+static const unsigned char example_hash[] = {
+	0x06, 0x53, 0x68, 0xab, 0xee, 0xd7, 0xec, 0x6e, 0x9f, 0xeb,
+	0xa9, 0x6b, 0x8c, 0x8b, 0xc3, 0xe8, 0xb7, 0x91, 0xf7, 0x16,
+};
+
+ISC_RUN_TEST_IMPL(isc_iterated_hash) {
+	unsigned char out[NSEC3_MAX_HASH_LENGTH];
+	int len;
+
+	len = isc_iterated_hash(out, 1, 12, example_salt, sizeof(example_salt),
+				example_name, sizeof(example_name));
+	assert_int_equal(len, sizeof(example_hash));
+	assert_memory_equal(out, example_hash, sizeof(example_hash));
+
+	len = isc_iterated_hash(out, 2, 12, example_salt, sizeof(example_salt),
+				example_name, sizeof(example_name));
+	assert_int_equal(len, 0);
+}
+
+#define INPUTS (ISC_ITERATED_HASH_BATCH * 3 + 5)
+
+/* the batch must give the same hashes as one chain at a time */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_batch) {
+	static const int saltlengths[] = { 0, 1, 4, 8, 16, 35, 36, 64, 255 };
+	static const int iterations[] = { 0, 1, 12, 50 };
+	unsigned char salt[255];
+	unsigned char names[INPUTS][64];
+	unsigned char single[INPUTS][NSEC3_MAX_HASH_LENGTH];
+	unsigned char batch[INPUTS][NSEC3_MAX_HASH_LENGTH];
+	const unsigned char *in[INPUTS];
+	unsigned char *out[INPUTS];
+	int inlength[INPUTS];
+	int len;
+
+	isc_random_buf(salt, sizeof(salt));
+	isc_random_buf(names, sizeof(names));
+	for (size_t i = 0; i < INPUTS; i++) {
+		in[i] = names[i];
+		inlength[i] = 1 + i % sizeof(names[i]);
+		out[i] = batch[i];
+	}
+
+	for (size_t s = 0; s < ARRAY_SIZE(saltlengths); s++) {
+		for (size_t it = 0; it < ARRAY_SIZE(iterations); it++) {
+			for (unsigned int count = 1; count <= INPUTS; count++) {
+				for (size_t i = 0; i < count; i++) {
+					len = isc_iterated_hash(
+						single[i], 1, iterations[it],
+						salt, saltlengths[s], in[i],
+						inlength[i]);
+					assert_int_equal(len, 20);
+				}
+				len = isc_iterated_hash_batch(
+					out, 1, iterations[it], salt,
+					saltlengths[s], in, inlength, count);
+				assert_int_equal(len, 20);
+				for (size_t i = 0; i < count; i++) {
+					assert_memory_equal(batch[i], single[i],
+							    len);
+				}
+			}
+		}
+	}
+
+	in[0] = example_name;
+	inlength[0] = sizeof(example_name);
+	len = isc_iterated_hash_batch(out, 1, 12, example_salt,
+				      sizeof(example_salt), in, inlength,
+				      ISC_ITERATED_HASH_BATCH);
+	assert_int_equal(len, sizeof(example_hash));
+	assert_memory_equal(batch[0], example_hash, sizeof(example_hash));
+
+	len = isc_iterated_hash_batch(out, 2, 12, example_salt,
+				      sizeof(example_salt), in, inlength,
+				      ISC_ITERATED_HASH_BATCH);
+	assert_int_equal(len, 0);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_iterated_hash)
+ISC_TEST_ENTRY(isc_iterated_hash_batch)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
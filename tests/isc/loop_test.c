@@ -130,10 +130,38 @@ ISC_RUN_TEST_IMPL(isc_loopmgr_sigterm) {
 	isc_loopmgr_run(loopmgr);
 }
 
+static void
+setaffinity_loopmgr(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		isc_loop_t *loop = isc_loop_get(loopmgr, i);
+		assert_true(isc_loop_getcpu(loop) >= 0);
+	}
+
+	assert_false(isc_loopmgr_getaffinity(loopmgr));
+
+	isc_result_t result = isc_loopmgr_setaffinity(loopmgr);
+	if (result == ISC_R_SUCCESS) {
+		assert_true(isc_loopmgr_getaffinity(loopmgr));
+	} else {
+		assert_false(isc_loopmgr_getaffinity(loopmgr));
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_RUN_TEST_IMPL(isc_loopmgr_setaffinity) {
+	isc_loop_setup(mainloop, setaffinity_loopmgr, loopmgr);
+	isc_loopmgr_run(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_pause, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_runjob, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_setaffinity, setup_loopmgr,
+		      teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigint, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigterm, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
@@ -86,6 +86,16 @@ ISC_RUN_TEST_IMPL(isc_mem_get) {
 	rval = isc_mempool_getallocated(mp1);
 	assert_int_equal(rval, 19);
 
+	/*
+	 * The 30 items were fetched from the parent context in three
+	 * fills of 10.
+	 */
+	assert_int_equal(isc_mempool_getgets(mp1), MP1_MAXALLOC);
+#if !__SANITIZE_ADDRESS__
+	assert_int_equal(isc_mempool_getmisses(mp1),
+			 MP1_MAXALLOC / MP1_FILLCNT);
+#endif /* !__SANITIZE_ADDRESS__ */
+
 	/*
 	 * Now, beat up on mp2 for a while.  Allocate 50 items, then free
 	 * them, then allocate 50 more, etc.
@@ -325,6 +335,52 @@ ISC_RUN_TEST_IMPL(isc_mem_overmem) {
 	isc_mem_destroy(&omctx);
 }
 
+/* child contexts are accounted for in their parents */
+ISC_RUN_TEST_IMPL(isc_mem_child) {
+	isc_mem_t *parent = NULL, *child = NULL, *grandchild = NULL;
+	void *data1 = NULL, *data2 = NULL, *data3 = NULL;
+
+	isc_mem_create(&parent);
+	isc_mem_createchild(parent, &child);
+	isc_mem_createchild(child, &grandchild);
+
+	/* the child keeps the parent alive */
+	assert_int_equal(isc_mem_references(parent), 2);
+
+	data1 = isc_mem_get(parent, 100);
+	data2 = isc_mem_get(child, 200);
+	data3 = isc_mem_get(grandchild, 400);
+
+	assert_int_equal(isc_mem_inuse(parent), 700);
+	assert_int_equal(isc_mem_inuse(child), 600);
+	assert_int_equal(isc_mem_inuse(grandchild), 400);
+
+	/* a parent's water marks cover its children ... */
+	isc_mem_setwater(parent, 512, 256);
+	assert_true(isc_mem_isovermem(parent));
+
+	/* ... but a child's only cover itself */
+	isc_mem_setwater(grandchild, 512, 256);
+	assert_false(isc_mem_isovermem(grandchild));
+
+	isc_mem_put(grandchild, data3, 400);
+	assert_int_equal(isc_mem_inuse(child), 200);
+	assert_int_equal(isc_mem_inuse(parent), 300);
+	assert_true(isc_mem_isovermem(parent));
+
+	isc_mem_put(child, data2, 200);
+	assert_false(isc_mem_isovermem(parent));
+
+	isc_mem_put(parent, data1, 100);
+	assert_int_equal(isc_mem_inuse(parent), 0);
+
+	isc_mem_detach(&grandchild);
+	assert_int_equal(isc_mem_references(child), 1);
+	isc_mem_detach(&child);
+	assert_int_equal(isc_mem_references(parent), 1);
+	isc_mem_destroy(&parent);
+}
+
 #if ISC_MEM_TRACKLINES
 
 /* test mem with no flags */
@@ -521,6 +577,7 @@ ISC_TEST_ENTRY(isc_mem_zeroget)
 ISC_TEST_ENTRY(isc_mem_reget)
 ISC_TEST_ENTRY(isc_mem_reallocate)
 ISC_TEST_ENTRY(isc_mem_overmem)
+ISC_TEST_ENTRY(isc_mem_child)
 
 #if ISC_MEM_TRACKLINES
 ISC_TEST_ENTRY(isc_mem_noflags)
@@ -111,6 +111,7 @@ bool stream = false;
 in_port_t stream_port = 0;
 
 bool udp_use_PROXY = false;
+uint32_t udp_recv_batch = ISC_NM_UDP_RECVBATCH_DEFAULT;
 
 isc_nm_recv_cb_t connect_readcb = NULL;
 
@@ -1354,11 +1355,12 @@ udp_start_listening(uint32_t nworkers, isc_nm_recv_cb_t cb) {
 
 	if (udp_use_PROXY) {
 		result = isc_nm_listenproxyudp(netmgr, nworkers,
-					       &udp_listen_addr, cb, NULL,
-					       &listen_sock);
+					       &udp_listen_addr, udp_recv_batch,
+					       cb, NULL, &listen_sock);
 	} else {
 		result = isc_nm_listenudp(netmgr, nworkers, &udp_listen_addr,
-					  cb, NULL, &listen_sock);
+					  udp_recv_batch, cb, NULL,
+					  &listen_sock);
 	}
 
 	assert_int_equal(result, ISC_R_SUCCESS);
@@ -2263,6 +2265,50 @@ udp_recv_send(void **arg ISC_ATTR_UNUSED) {
 	}
 }
 
+int
+udp_recv_send_batch_setup(void **state) {
+	udp_recv_batch = 1;
+	return (udp_recv_send_setup(state));
+}
+
+int
+udp_recv_send_batch_teardown(void **state) {
+	int ret = udp_recv_send_teardown(state);
+	udp_recv_batch = ISC_NM_UDP_RECVBATCH_DEFAULT;
+	return (ret);
+}
+
+int
+udp_recv_send_coalesce_setup(void **state) {
+	int ret = udp_recv_send_setup(state);
+	isc_nm_setudpsendcoalesce(netmgr, true);
+	return (ret);
+}
+
+int
+udp_recv_send_coalesce_teardown(void **state) {
+	return (udp_recv_send_teardown(state));
+}
+
+int
+udp_recv_send_busypoll_setup(void **state) {
+	int ret = udp_recv_send_setup(state);
+
+	/*
+	 * Unprivileged test runs cannot set SO_BUSY_POLL; the listener
+	 * must carry on without it.
+	 */
+	isc_nm_setudpbusypoll(netmgr, 50);
+	return (ret);
+}
+
+int
+udp_recv_send_busypoll_teardown(void **state) {
+	int ret = udp_recv_send_teardown(state);
+	isc_nm_setudpbusypoll(netmgr, 0);
+	return (ret);
+}
+
 int
 proxyudp_recv_send_setup(void **state) {
 	udp_use_PROXY = true;
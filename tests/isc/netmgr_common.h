@@ -140,6 +140,7 @@ extern bool stream;
 extern in_port_t stream_port;
 
 extern bool udp_use_PROXY;
+extern uint32_t udp_recv_batch;
 
 extern isc_nm_recv_cb_t connect_readcb;
 
@@ -592,6 +593,24 @@ udp_recv_send_teardown(void **state);
 void
 udp_recv_send(void **arg ISC_ATTR_UNUSED);
 
+int
+udp_recv_send_batch_setup(void **state);
+
+int
+udp_recv_send_batch_teardown(void **state);
+
+int
+udp_recv_send_coalesce_setup(void **state);
+
+int
+udp_recv_send_coalesce_teardown(void **state);
+
+int
+udp_recv_send_busypoll_setup(void **state);
+
+int
+udp_recv_send_busypoll_teardown(void **state);
+
 int
 proxyudp_recv_send_setup(void **state);
 
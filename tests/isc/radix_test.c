@@ -25,6 +25,7 @@
 #include <isc/mem.h>
 #include <isc/netaddr.h>
 #include <isc/radix.h>
+#include <isc/random.h>
 #include <isc/result.h>
 #include <isc/util.h>
 
@@ -125,10 +126,82 @@ ISC_RUN_TEST_IMPL(isc_radix_search) {
 	isc_radix_destroy(radix, NULL);
 }
 
+/* test that a compiled tree gives the same answers as the tree walk */
+ISC_RUN_TEST_IMPL(isc_radix_compile) {
+	isc_radix_tree_t *radix = NULL;
+	isc_radix_node_t *node = NULL, *cnode = NULL;
+	isc_prefix_t prefix;
+	isc_result_t result, cresult;
+	struct in_addr in_addr;
+	isc_netaddr_t netaddr;
+	static const unsigned int lengths[] = { 8, 12, 16, 20, 24, 28, 32 };
+
+	UNUSED(state);
+
+	isc_radix_create(mctx, &radix, 32);
+
+	/*
+	 * Overlapping prefixes of every length, all in 10/8 so that
+	 * most of the test addresses below match something.
+	 */
+	for (size_t i = 0; i < 1000; i++) {
+		unsigned int bits = lengths[isc_random_uniform(
+			ARRAY_SIZE(lengths))];
+
+		in_addr.s_addr = htonl(0x0a000000 |
+				       (isc_random32() & 0x00ffffff));
+		isc_netaddr_fromin(&netaddr, &in_addr);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, bits);
+
+		node = NULL;
+		result = isc_radix_insert(radix, &node, NULL, &prefix);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		isc_refcount_destroy(&prefix.refcount);
+	}
+
+	isc_radix_compile(radix);
+	assert_non_null(radix->v4table);
+
+	for (size_t i = 0; i < 100000; i++) {
+		in_addr.s_addr = htonl(0x0a000000 |
+				       (isc_random32() & 0x00ffffff));
+		isc_netaddr_fromin(&netaddr, &in_addr);
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, 32);
+
+		cnode = NULL;
+		cresult = isc_radix_search(radix, &cnode, &prefix);
+
+		isc_radix_v4table_t *table = radix->v4table;
+		radix->v4table = NULL;
+		node = NULL;
+		result = isc_radix_search(radix, &node, &prefix);
+		radix->v4table = table;
+
+		assert_int_equal(cresult, result);
+		assert_ptr_equal(cnode, node);
+
+		isc_refcount_destroy(&prefix.refcount);
+	}
+
+	/* Any change to the tree drops the table */
+	in_addr.s_addr = inet_addr("192.0.2.0");
+	isc_netaddr_fromin(&netaddr, &in_addr);
+	NETADDR_TO_PREFIX_T(&netaddr, prefix, 24);
+
+	node = NULL;
+	result = isc_radix_insert(radix, &node, NULL, &prefix);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_refcount_destroy(&prefix.refcount);
+	assert_null(radix->v4table);
+
+	isc_radix_destroy(radix, NULL);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_radix_remove)
 ISC_TEST_ENTRY(isc_radix_search)
+ISC_TEST_ENTRY(isc_radix_compile)
 
 ISC_TEST_LIST_END
 ISC_TEST_MAIN
@@ -22,6 +22,9 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/stats.h>
@@ -57,6 +60,14 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 		assert_int_equal(isc_stats_get_counter(stats, i), 0);
 	}
 
+	/* Test add. */
+	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
+		isc_stats_add(stats, i, i + 3);
+		assert_int_equal(isc_stats_get_counter(stats, i), i + 3);
+		isc_stats_add(stats, i, 2);
+		assert_int_equal(isc_stats_get_counter(stats, i), i + 5);
+	}
+
 	/* Test set. */
 	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
 		isc_stats_set(stats, i, i);
@@ -91,9 +102,76 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 	isc_stats_detach(&stats);
 }
 
+#define SHARDED_INCREMENTS 1000
+
+static isc_stats_t *sharded = NULL;
+static atomic_uint_fast32_t sharded_running;
+
+static void
+sharded_done(void *arg ISC_ATTR_UNUSED) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	/* The values from all the loops are added up */
+	assert_int_equal(isc_stats_get_counter(sharded, 0),
+			 nloops * SHARDED_INCREMENTS);
+	assert_int_equal(isc_stats_get_counter(sharded, 1), 0);
+	assert_int_equal(isc_stats_get_counter(sharded, 2), nloops);
+
+	isc_stats_detach(&sharded);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+sharded_job(void *arg ISC_ATTR_UNUSED) {
+	for (size_t i = 0; i < SHARDED_INCREMENTS; i++) {
+		isc_stats_increment(sharded, 0);
+		isc_stats_increment(sharded, 1);
+		isc_stats_decrement(sharded, 1);
+	}
+	isc_stats_update_if_greater(sharded, 2, isc_loopmgr_nloops(loopmgr));
+
+	if (atomic_fetch_sub_release(&sharded_running, 1) == 1) {
+		isc_async_run(mainloop, sharded_done, NULL);
+	}
+}
+
+ISC_LOOP_TEST_IMPL(isc_stats_sharded) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	isc_stats_create_sharded(mctx, &sharded, 3);
+	assert_int_equal(isc_stats_ncounters(sharded), 3);
+
+	/* Increments on this loop and values set directly are combined */
+	isc_stats_add(sharded, 0, 5);
+	isc_stats_set(sharded, 5, 1);
+	isc_stats_increment(sharded, 1);
+	assert_int_equal(isc_stats_get_counter(sharded, 0), 5);
+	assert_int_equal(isc_stats_get_counter(sharded, 1), 6);
+
+	/* Setting a counter discards the increments */
+	isc_stats_set(sharded, 0, 0);
+	isc_stats_set(sharded, 0, 1);
+	assert_int_equal(isc_stats_get_counter(sharded, 0), 0);
+	assert_int_equal(isc_stats_get_counter(sharded, 1), 0);
+
+	/* Resizing keeps the values */
+	isc_stats_increment(sharded, 0);
+	isc_stats_resize(&sharded, 40);
+	assert_int_equal(isc_stats_ncounters(sharded), 40);
+	assert_int_equal(isc_stats_get_counter(sharded, 0), 1);
+	assert_int_equal(isc_stats_get_counter(sharded, 39), 0);
+	isc_stats_decrement(sharded, 0);
+
+	atomic_init(&sharded_running, nloops);
+	for (size_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), sharded_job, NULL);
+	}
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_stats_basic)
+ISC_TEST_ENTRY_CUSTOM(isc_stats_sharded, setup_loopmgr, teardown_loopmgr)
 
 ISC_TEST_LIST_END
 
@@ -80,7 +80,8 @@ ISC_LOOP_TEST_IMPL(mock_listenudp_uv_udp_open) {
 	WILL_RETURN(uv_udp_open, UV_ENOMEM);
 
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &udp_listen_addr,
-				  mock_recv_cb, NULL, &listen_sock);
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, mock_recv_cb,
+				  NULL, &listen_sock);
 	assert_int_not_equal(result, ISC_R_SUCCESS);
 	assert_null(listen_sock);
 
@@ -95,7 +96,8 @@ ISC_LOOP_TEST_IMPL(mock_listenudp_uv_udp_bind) {
 	WILL_RETURN(uv_udp_bind, UV_EADDRINUSE);
 
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &udp_listen_addr,
-				  mock_recv_cb, NULL, &listen_sock);
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, mock_recv_cb,
+				  NULL, &listen_sock);
 	assert_int_not_equal(result, ISC_R_SUCCESS);
 	assert_null(listen_sock);
 
@@ -110,7 +112,8 @@ ISC_LOOP_TEST_IMPL(mock_listenudp_uv_udp_recv_start) {
 	WILL_RETURN(uv_udp_recv_start, UV_EADDRINUSE);
 
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &udp_listen_addr,
-				  mock_recv_cb, NULL, &listen_sock);
+				  ISC_NM_UDP_RECVBATCH_DEFAULT, mock_recv_cb,
+				  NULL, &listen_sock);
 	assert_int_not_equal(result, ISC_R_SUCCESS);
 	assert_null(listen_sock);
 
@@ -192,6 +195,12 @@ ISC_LOOP_TEST_IMPL(udp_recv_two) { udp_recv_two(arg); }
 
 ISC_LOOP_TEST_IMPL(udp_recv_send) { udp_recv_send(arg); }
 
+ISC_LOOP_TEST_IMPL(udp_recv_send_batch) { udp_recv_send(arg); }
+
+ISC_LOOP_TEST_IMPL(udp_recv_send_coalesce) { udp_recv_send(arg); }
+
+ISC_LOOP_TEST_IMPL(udp_recv_send_busypoll) { udp_recv_send(arg); }
+
 ISC_LOOP_TEST_IMPL(udp_double_read) { udp_double_read(arg); }
 
 ISC_TEST_LIST_START
@@ -230,6 +239,12 @@ ISC_TEST_ENTRY_CUSTOM(udp_recv_one, udp_recv_one_setup, udp_recv_one_teardown)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_two, udp_recv_two_setup, udp_recv_two_teardown)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_send, udp_recv_send_setup,
 		      udp_recv_send_teardown)
+ISC_TEST_ENTRY_CUSTOM(udp_recv_send_batch, udp_recv_send_batch_setup,
+		      udp_recv_send_batch_teardown)
+ISC_TEST_ENTRY_CUSTOM(udp_recv_send_coalesce, udp_recv_send_coalesce_setup,
+		      udp_recv_send_coalesce_teardown)
+ISC_TEST_ENTRY_CUSTOM(udp_recv_send_busypoll, udp_recv_send_busypoll_setup,
+		      udp_recv_send_busypoll_teardown)
 
 ISC_TEST_LIST_END
 
@@ -24,6 +24,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/loop.h>
 #include <isc/os.h>
@@ -75,8 +76,77 @@ ISC_RUN_TEST_IMPL(isc_work_enqueue) {
 	assert_int_equal(atomic_load(&scheduled), 1);
 }
 
+#define BULK_PER_LOOP 4
+
+static atomic_uint bulk_running = 0;
+static atomic_uint bulk_max_running = 0;
+static atomic_uint bulk_done = 0;
+
+static void
+bulk_work_cb(void *arg) {
+	UNUSED(arg);
+
+	unsigned int running = atomic_fetch_add(&bulk_running, 1) + 1;
+	unsigned int max = atomic_load(&bulk_max_running);
+	while (running > max &&
+	       !atomic_compare_exchange_weak(&bulk_max_running, &max, running))
+	{
+		/* retry */
+	}
+
+	usleep(1000);
+
+	atomic_fetch_sub(&bulk_running, 1);
+}
+
+static void
+bulk_after_work_cb(void *arg) {
+	UNUSED(arg);
+
+	unsigned int total = isc_loopmgr_nloops(loopmgr) * BULK_PER_LOOP;
+	if (atomic_fetch_add(&bulk_done, 1) + 1 == total) {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+bulk_enqueue_cb(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < BULK_PER_LOOP; i++) {
+		isc_work_enqueue_bulk(isc_loop(), bulk_work_cb,
+				      bulk_after_work_cb, NULL);
+	}
+}
+
+static void
+bulk_setup_cb(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < isc_loopmgr_nloops(loopmgr); i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), bulk_enqueue_cb, NULL);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_work_enqueue_bulk) {
+	atomic_init(&bulk_running, 0);
+	atomic_init(&bulk_max_running, 0);
+	atomic_init(&bulk_done, 0);
+
+	isc_loop_setup(isc_loop_main(loopmgr), bulk_setup_cb, NULL);
+
+	isc_loopmgr_run(loopmgr);
+
+	assert_int_equal(atomic_load(&bulk_done),
+			 isc_loopmgr_nloops(loopmgr) * BULK_PER_LOOP);
+	assert_true(atomic_load(&bulk_max_running) <= loopmgr->work_max);
+	assert_int_equal(loopmgr->work_running, 0);
+	assert_true(ISC_LIST_EMPTY(loopmgr->work_pending));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue_bulk, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
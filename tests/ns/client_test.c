@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <ns/client.h>
+#include <ns/server.h>
+#include <ns/stats.h>
+
+#include <tests/ns.h>
+
+/*
+ * Render 'length' octets into a TCP send buffer of 'client' and check
+ * where ns__client_trimsendbuf() leaves them.
+ */
+static void
+trimsendbuf(ns_client_t *client, unsigned int length) {
+	ns_clientmgr_t *manager = client->manager;
+	unsigned char *data = NULL;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	size_t ncached;
+
+	client->state = NS_CLIENTSTATE_WORKING;
+	client->attributes |= NS_CLIENTATTR_TCP;
+
+	ns__client_allocsendbuf(client, &buffer, &data);
+	assert_ptr_equal(data, client->tcpbuf);
+	assert_int_equal(client->tcpbuf_size, NS_CLIENT_TCP_BUFFER_SIZE);
+	ncached = manager->ntcp_buffers;
+
+	for (unsigned int i = 0; i < length; i++) {
+		isc_buffer_putuint8(&buffer, i & 0xff);
+	}
+
+	ns__client_trimsendbuf(client, &buffer, &r);
+	assert_int_equal(r.length, length);
+	for (unsigned int i = 0; i < length; i++) {
+		assert_int_equal(r.base[i], i & 0xff);
+	}
+
+	if (length <= sizeof(client->sendbuf)) {
+		/* Moved to the client's own buffer */
+		assert_ptr_equal(r.base, client->sendbuf);
+		assert_null(client->tcpbuf);
+		assert_int_equal(manager->ntcp_buffers, ncached + 1);
+	} else if (length < NS_CLIENT_TCP_BUFFER_KEEP) {
+		/* Moved to a buffer of the right size */
+		assert_ptr_equal(r.base, client->tcpbuf);
+		assert_int_equal(client->tcpbuf_size, length);
+		assert_int_equal(manager->ntcp_buffers, ncached + 1);
+	} else {
+		/* Sent from the full size buffer */
+		assert_ptr_equal(r.base, data);
+		assert_ptr_equal(client->tcpbuf, data);
+		assert_int_equal(client->tcpbuf_size,
+				 NS_CLIENT_TCP_BUFFER_SIZE);
+		assert_int_equal(manager->ntcp_buffers, ncached);
+	}
+
+	/* As client_senddone() would */
+	ns__client_reset_cb(client);
+	assert_null(client->tcpbuf);
+}
+
+/* Only large TCP responses keep a full size buffer while they are sent */
+ISC_LOOP_TEST_IMPL(tcp_sendbuf) {
+	ns_client_t *client = NULL;
+	isc_nmhandle_t *handle = NULL;
+
+	ns_test_getclient(NULL, true, &client);
+
+	trimsendbuf(client, 12);
+	trimsendbuf(client, NS_CLIENT_SEND_BUFFER_SIZE);
+	trimsendbuf(client, NS_CLIENT_SEND_BUFFER_SIZE + 1);
+	trimsendbuf(client, NS_CLIENT_TCP_BUFFER_KEEP - 1);
+	trimsendbuf(client, NS_CLIENT_TCP_BUFFER_KEEP);
+	trimsendbuf(client, NS_CLIENT_TCP_BUFFER_SIZE);
+
+	handle = client->handle;
+	isc_nmhandle_detach(&client->handle);
+	isc_nmhandle_detach(&handle);
+
+	isc_loop_teardown(mainloop, shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+#define NRECURSING (NS_CLIENT_SHED_SCAN + 2)
+
+/*
+ * Drop one recursing client, check that it is 'victim', and whether
+ * it counted as dropped for its cost.
+ */
+static void
+killoldest(ns_client_t **clients, size_t victim, bool costly) {
+	ns_stats_t *stats = clients[0]->manager->sctx->nsstats;
+	uint64_t dropped, costlies;
+
+	dropped = ns_stats_get_counter(stats, ns_statscounter_reclimitdropped);
+	costlies = ns_stats_get_counter(stats, ns_statscounter_reclimitcostly);
+
+	ns_client_killoldestquery(clients[0]);
+	assert_false(ISC_LINK_LINKED(clients[victim], rlink));
+
+	assert_int_equal(
+		ns_stats_get_counter(stats, ns_statscounter_reclimitdropped),
+		dropped + 1);
+	assert_int_equal(
+		ns_stats_get_counter(stats, ns_statscounter_reclimitcostly),
+		costlies + (costly ? 1 : 0));
+}
+
+/*
+ * The most costly of the oldest NS_CLIENT_SHED_SCAN recursing clients
+ * is dropped, or the oldest of them if they cost the same.
+ */
+ISC_LOOP_TEST_IMPL(killoldestquery) {
+	ns_client_t *clients[NRECURSING];
+
+	for (size_t i = 0; i < NRECURSING; i++) {
+		clients[i] = NULL;
+		ns_test_getclient(NULL, false, &clients[i]);
+		clients[i]->state = NS_CLIENTSTATE_WORKING;
+		ns_client_recursing(clients[i]);
+	}
+
+	/* All cost the same: the oldest */
+	killoldest(clients, 0, false);
+	for (size_t i = 1; i < NRECURSING; i++) {
+		assert_true(ISC_LINK_LINKED(clients[i], rlink));
+	}
+
+	/* The costliest one, the older of two */
+	clients[2]->query.cost = 1;
+	clients[4]->query.cost = 3;
+	clients[6]->query.cost = 3;
+	clients[9]->query.cost = 5;
+	killoldest(clients, 4, true);
+
+	/* Only the oldest NS_CLIENT_SHED_SCAN are looked at */
+	killoldest(clients, 9, true);
+	killoldest(clients, 6, true);
+
+	killoldest(clients, 2, true);
+
+	/* The oldest again */
+	killoldest(clients, 1, false);
+
+	for (size_t i = 0; i < NRECURSING; i++) {
+		isc_nmhandle_t *handle = clients[i]->handle;
+
+		isc_nmhandle_detach(&clients[i]->handle);
+		isc_nmhandle_detach(&handle);
+	}
+
+	isc_loop_teardown(mainloop, shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * The adaptive recursive-clients limit steps down by an eighth while
+ * the server is congested, and back up by 1/32 of the configured limit.
+ */
+ISC_RUN_TEST_IMPL(recursionlimit) {
+	unsigned int limit = 1000;
+
+	UNUSED(state);
+
+	/* Down by an eighth of the current limit, to an eighth of 1000 */
+	limit = ns_server_recursionlimit(limit, 1000, true);
+	assert_int_equal(limit, 875);
+	limit = ns_server_recursionlimit(limit, 1000, true);
+	assert_int_equal(limit, 766);
+	for (int i = 0; i < 100; i++) {
+		limit = ns_server_recursionlimit(limit, 1000, true);
+	}
+	assert_int_equal(limit, 125);
+
+	/* Up by 31 at a time, to 1000 */
+	limit = ns_server_recursionlimit(limit, 1000, false);
+	assert_int_equal(limit, 156);
+	for (int i = 0; i < 100; i++) {
+		limit = ns_server_recursionlimit(limit, 1000, false);
+	}
+	assert_int_equal(limit, 1000);
+
+	/* Small limits still move, but not below 1 */
+	assert_int_equal(ns_server_recursionlimit(5, 5, true), 4);
+	assert_int_equal(ns_server_recursionlimit(1, 5, true), 1);
+	assert_int_equal(ns_server_recursionlimit(1, 5, false), 2);
+	assert_int_equal(ns_server_recursionlimit(5, 5, false), 5);
+
+	/* A limit above the configured one (after reconfiguration) */
+	assert_int_equal(ns_server_recursionlimit(2000, 1000, false), 2000);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(tcp_sendbuf, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(killoldestquery, setup_server, teardown_server)
+ISC_TEST_ENTRY(recursionlimit)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
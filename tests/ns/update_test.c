@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/rcode.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <ns/client.h>
+
+/* Include the main file */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#undef CHECK
+#include "../../lib/ns/update.c"
+#pragma GCC diagnostic pop
+
+#undef CHECK
+#include <tests/ns.h>
+
+#define ZONENAME "example.com"
+#define ZONEFILE "./update_test.db"
+#define JOURNAL	 "./update_test.db.jnl"
+#define NUPDATES 16
+
+static dns_view_t *view = NULL;
+static dns_zone_t *zone = NULL;
+static ns_client_t *clients[NUPDATES];
+static update_t *updates[NUPDATES];
+static dns_rcode_t rcodes[NUPDATES];
+static size_t queued = 0, answered = 0;
+static uint32_t serial0;
+static void (*check)(void) = NULL;
+
+static void
+cleanup(void) {
+	(void)isc_file_remove(ZONEFILE);
+	(void)isc_file_remove(JOURNAL);
+}
+
+static int
+setup_test(void **state) {
+	cleanup();
+	return (setup_server(state));
+}
+
+static int
+teardown_test(void **state) {
+	int ret = teardown_server(state);
+
+	cleanup();
+	return (ret);
+}
+
+static uint32_t
+zoneserial(void) {
+	uint32_t serial = 0;
+	isc_result_t result;
+
+	result = dns_zone_getserial(zone, &serial);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	return (serial);
+}
+
+static uint64_t
+zonerecords(void) {
+	dns_db_t *db = NULL;
+	uint64_t records = 0;
+	isc_result_t result;
+
+	result = dns_zone_getdb(zone, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_getsize(db, NULL, &records, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+	return (records);
+}
+
+/* Whether 'owner' has an A record in the current version of the zone */
+static bool
+exists(const char *owner) {
+	dns_fixedname_t fname, ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_zone_getdb(zone, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_a, 0, 0, NULL, foundname, NULL,
+			     NULL);
+	dns_db_detach(&db);
+
+	return (result == ISC_R_SUCCESS);
+}
+
+/*
+ * Load a zone with three records, and start collecting the responses
+ * to UPDATEs; 'checkfn' is called once they have all been answered.
+ */
+static void
+start(void (*checkfn)(void)) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	FILE *f = NULL;
+
+	f = fopen(ZONEFILE, "w");
+	assert_non_null(f);
+	fprintf(f, "$TTL 300\n"
+		   "@\tSOA\tns hostmaster 1 3600 600 86400 300\n"
+		   "\tNS\tns\n"
+		   "ns\tA\t10.53.0.1\n");
+	fclose(f);
+
+	result = dns_test_makeview("view", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = ns_test_serve_zone(ZONENAME, ZONEFILE, view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring(ZONENAME, &fname);
+	result = dns_view_findzone(view, dns_fixedname_name(&fname),
+				   DNS_ZTFIND_EXACT, &zone);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	serial0 = zoneserial();
+	queued = 0;
+	answered = 0;
+	check = checkfn;
+}
+
+static void
+done(void *arg) {
+	UNUSED(arg);
+
+	check();
+
+	for (size_t i = 0; i < queued; i++) {
+		isc_nmhandle_t *handle = clients[i]->handle;
+
+		isc_nmhandle_detach(&clients[i]->handle);
+		isc_nmhandle_detach(&handle);
+		clients[i] = NULL;
+	}
+
+	dns_zone_detach(&zone);
+	ns_test_cleanup_zone();
+	dns_view_detach(&view);
+
+	isc_loop_teardown(mainloop, shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Record the rcode of a response; the message ID is the position of
+ * the UPDATE in the queue.
+ */
+static void
+sendcb(isc_buffer_t *buf) {
+	dns_message_t *message = NULL;
+	isc_result_t result;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &message);
+	result = dns_message_parse(message, buf, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(message->opcode, dns_opcode_update);
+	assert_true(message->id < queued);
+	rcodes[message->id] = message->rcode;
+	dns_message_detach(&message);
+
+	/* Check once updatedone_action() has finished */
+	if (++answered == queued) {
+		isc_async_run(mainloop, done, NULL);
+	}
+}
+
+static void
+putname(isc_buffer_t *buf, const char *text) {
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+
+	dns_test_namefromstring(text, &fname);
+	name = dns_fixedname_name(&fname);
+	isc_buffer_putmem(buf, name->ndata, name->length);
+}
+
+/*
+ * Prepare an UPDATE adding an A record to 'owner', with a prerequisite
+ * that 'prereq' exists unless it is NULL, as send_update() does once
+ * the UPDATE has passed the access checks.
+ */
+static void
+queue(const char *prereq, const char *owner) {
+	unsigned char data[512];
+	isc_buffer_t buf;
+	dns_message_t *message = NULL;
+	ns_client_t *client = NULL;
+	update_t *uev = NULL;
+	isc_result_t result;
+	uint16_t id = queued;
+
+	REQUIRE(queued < NUPDATES);
+
+	isc_buffer_init(&buf, data, sizeof(data));
+	isc_buffer_putuint16(&buf, id);
+	isc_buffer_putuint16(&buf, dns_opcode_update << 11); /* flags */
+	isc_buffer_putuint16(&buf, 1);
+	isc_buffer_putuint16(&buf, (prereq != NULL) ? 1 : 0);
+	isc_buffer_putuint16(&buf, 1);
+	isc_buffer_putuint16(&buf, 0);
+
+	putname(&buf, ZONENAME);
+	isc_buffer_putuint16(&buf, dns_rdatatype_soa);
+	isc_buffer_putuint16(&buf, dns_rdataclass_in);
+
+	if (prereq != NULL) {
+		/* Name is in use */
+		putname(&buf, prereq);
+		isc_buffer_putuint16(&buf, dns_rdatatype_any);
+		isc_buffer_putuint16(&buf, dns_rdataclass_any);
+		isc_buffer_putuint32(&buf, 0);
+		isc_buffer_putuint16(&buf, 0);
+	}
+
+	putname(&buf, owner);
+	isc_buffer_putuint16(&buf, dns_rdatatype_a);
+	isc_buffer_putuint16(&buf, dns_rdataclass_in);
+	isc_buffer_putuint32(&buf, 300);
+	isc_buffer_putuint16(&buf, 4);
+	isc_buffer_putuint32(&buf, 0x0a350000 + id);
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &message);
+	result = dns_message_parse(message, &buf, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_clonebuffer(message);
+
+	ns_test_getclient(NULL, false, &client);
+	dns_view_attach(view, &client->view);
+	if (client->message != NULL) {
+		dns_message_detach(&client->message);
+	}
+	client->message = message;
+	client->sendcb = sendcb;
+	clients[queued] = client;
+
+	isc_nmhandle_attach(client->handle, &client->reqhandle);
+
+	result = isc_quota_acquire(&client->manager->sctx->updquota);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	uev = isc_mem_get(client->manager->mctx, sizeof(*uev));
+	*uev = (update_t){
+		.client = client,
+		.result = ISC_R_SUCCESS,
+		.mergeable = true,
+	};
+	dns_zone_attach(zone, &uev->zone);
+	ISC_LINK_INIT(uev, link);
+	ISC_LIST_INIT(uev->merged);
+
+	isc_nmhandle_attach(client->handle, &client->updatehandle);
+	updates[queued++] = uev;
+}
+
+static void
+enqueue(void *arg) {
+	UNUSED(arg);
+
+	for (size_t i = 0; i < queued; i++) {
+		update_enqueue(updates[i]);
+		updates[i] = NULL;
+	}
+}
+
+/*
+ * Queue the prepared UPDATEs on the zone's loop at once, so that they
+ * are all waiting when update_run() is called.
+ */
+static void
+burst(void) {
+	isc_async_run(dns_zone_getloop(zone), enqueue, NULL);
+}
+
+static void
+check_merged(void) {
+	for (size_t i = 0; i < queued; i++) {
+		assert_int_equal(rcodes[i], dns_rcode_noerror);
+	}
+	assert_true(exists("a.example.com"));
+	assert_true(exists("j.example.com"));
+
+	/* One version, so one SOA serial increment */
+	assert_int_equal(zoneserial(), serial0 + 1);
+}
+
+/* A burst of UPDATEs to a zone is committed as one version */
+ISC_LOOP_TEST_IMPL(update_merged) {
+	start(check_merged);
+
+	for (char c = 'a'; c <= 'j'; c++) {
+		char owner[] = "?.example.com";
+
+		owner[0] = c;
+		queue(NULL, owner);
+	}
+	burst();
+}
+
+static void
+check_prereq(void) {
+	assert_int_equal(rcodes[0], dns_rcode_noerror);
+	assert_int_equal(rcodes[1], dns_rcode_nxdomain);
+	assert_int_equal(rcodes[2], dns_rcode_noerror);
+	assert_int_equal(rcodes[3], dns_rcode_noerror);
+
+	assert_true(exists("a.example.com"));
+	assert_false(exists("b.example.com"));
+	assert_true(exists("c.example.com"));
+	assert_true(exists("d.example.com"));
+
+	assert_int_equal(zoneserial(), serial0 + 1);
+}
+
+/*
+ * An UPDATE whose prerequisite fails is answered on its own, while
+ * the rest of the burst, which sees the changes made before it, is
+ * still committed together.
+ */
+ISC_LOOP_TEST_IMPL(update_prereq) {
+	start(check_prereq);
+
+	queue(NULL, "a.example.com");
+	queue("missing.example.com", "b.example.com");
+	queue(NULL, "c.example.com");
+	/* Added by the first UPDATE of the burst */
+	queue("a.example.com", "d.example.com");
+	burst();
+}
+
+static void
+check_rollback(void) {
+	assert_int_equal(rcodes[0], dns_rcode_noerror);
+	assert_int_equal(rcodes[1], dns_rcode_noerror);
+	assert_int_equal(rcodes[2], dns_rcode_servfail);
+
+	assert_true(exists("a.example.com"));
+	assert_true(exists("b.example.com"));
+	assert_false(exists("c.example.com"));
+
+	/* Replayed one at a time, in separate versions */
+	assert_int_equal(zoneserial(), serial0 + 2);
+}
+
+/*
+ * If the merged version can't be committed, it is rolled back and the
+ * UPDATEs are applied one at a time, as if they had never been merged.
+ */
+ISC_LOOP_TEST_IMPL(update_rollback) {
+	start(check_rollback);
+
+	/* Room for two of the three records */
+	dns_zone_setmaxrecords(zone, zonerecords() + 2);
+
+	queue(NULL, "a.example.com");
+	queue(NULL, "b.example.com");
+	queue(NULL, "c.example.com");
+	burst();
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(update_merged, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(update_prereq, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(update_rollback, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN